@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "batch_stereo/main.h"
+
+using namespace eos;
+
+//------------------------------------------------------------------------------
+int main(int argc,char ** argv)
+{
+ if (argc<4)
+ {
+  std::cout << "Usage:\nbatch_stereo [list] [min_disp] [max_disp] <in_flight> <memory>\n";
+  std::cout << "Each line of the list is a left image, right image, .pcc calibration and\n";
+  std::cout << "output .svt filename, seperated by whitespace.\n";
+  std::cout << "Every pair is loaded, rectified, matched with coarse to fine SGM, refined\n";
+  std::cout << "and saved, with the stages overlapped between pairs.\n";
+  std::cout << "in_flight is how many pairs to process at once, defaults to 3.\n";
+  std::cout << "memory is the budget in megabytes, defaults to 512.\n";
+  return 1;
+ }
+
+ str::TokenTable tt;
+ svt::Core core(tt);
+
+ int32 minDisp = str::ToInt32(argv[2]);
+ int32 maxDisp = str::ToInt32(argv[3]);
+ nat32 inFlight = 3;
+ if (argc>4) inFlight = str::ToInt32(argv[4]);
+ nat32 memory = 512;
+ if (argc>5) memory = str::ToInt32(argv[5]);
+
+
+ // Build the pipeline...
+  stereo::Batch batch(core);
+  batch.SetInFlight(inFlight);
+  batch.SetMemory(nat64(memory)*1024*1024);
+
+  stereo::BatchMatch * match = new stereo::BatchMatch(stereo::SGMSolver());
+  match->SetRange(minDisp,maxDisp);
+
+  batch.Add(new stereo::BatchLoad());
+  batch.Add(new stereo::BatchRectify());
+  batch.Add(match);
+  batch.Add(new stereo::BatchRefine());
+  batch.Add(new stereo::BatchSave());
+
+
+ // Read the list...
+  std::ifstream list(argv[1]);
+  if (!list)
+  {
+   std::cout << "Could not open the list\n";
+   return 1;
+  }
+
+  std::string leftFn, rightFn, pairFn, outFn;
+  while (list >> leftFn >> rightFn >> pairFn >> outFn)
+  {
+   cam::CameraPair pair;
+   if (!pair.Load(pairFn.c_str()))
+   {
+    std::cout << "Could not load " << pairFn << ", skipping\n";
+    continue;
+   }
+
+   batch.Add(str::String(leftFn.c_str()),str::String(rightFn.c_str()),pair,str::String(outFn.c_str()));
+  }
+  std::cout << "Processing " << batch.Jobs() << " pairs\n";
+
+
+ // Run...
+  batch.Run();
+
+
+ // Report...
+  for (nat32 i=0;i<batch.Jobs();i++)
+  {
+   if (batch.Failed(i)) std::cout << "Pair " << i << " failed\n";
+  }
+
+  std::cout << "Done " << batch.Jobs() << " pairs in " << batch.WallTime() << "s, with " << batch.Failures() << " failures\n";
+  std::cout << "Peak memory " << (batch.PeakMemory()/(1024*1024)) << "MB\n";
+  for (nat32 s=0;s<batch.Stages();s++)
+  {
+   std::cout << batch.StageName(s) << ": " << batch.StageJobs(s) << " pairs in " << batch.StageTime(s) << "s, "
+             << batch.StageThroughput(s) << " pairs/s\n";
+  }
+
+ return 0;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,103 @@
+#ifndef BENCH_BENCHES_H
+#define BENCH_BENCHES_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+// The benchmarks, each a fixed problem with a timed part and an untimed setup,
+// so the driver can warm up, repeat and take statistics. Every input is either
+// synthesised from a fixed seed or loaded from a given file, so the same build
+// always does the same work.
+
+#include "bench/main.h"
+
+//------------------------------------------------------------------------------
+// The data the benchmarks work on. By default a synthetic stereo pair, a
+// textured plane with a raised square in the middle, generated from a fixed
+// seed; the macro benchmarks can be given a real pair instead...
+class Dataset
+{
+ public:
+  // left and right are image filenames, or null for the synthetic pair...
+   Dataset(svt::Core & core,cstrconst left = null<cstrconst>(),cstrconst right = null<cstrconst>());
+  ~Dataset() {}
+
+   svt::Core & GetCore() const {return core;}
+
+  // true if a real pair was given...
+   bit Real() const {return left!=null<cstrconst>();}
+
+  // Disparity range, of the synthetic pair unless set...
+   int32 MinDisp() const {return minDisp;}
+   int32 MaxDisp() const {return maxDisp;}
+   void SetDisp(int32 minD,int32 maxD) {minDisp = minD; maxDisp = maxD;}
+
+  // Makes a new image with an "rgb" field, which the caller then owns. If
+  // useReal is set and a real pair was given its loaded, otherwise its the
+  // synthetic image of the given size. Returns null on failure...
+   svt::Var * Left(nat32 width,nat32 height,bit useReal = false) const;
+   svt::Var * Right(nat32 width,nat32 height,bit useReal = false) const;
+
+
+ private:
+  svt::Core & core;
+  cstrconst left;
+  cstrconst right;
+  int32 minDisp;
+  int32 maxDisp;
+
+  svt::Var * Synthetic(nat32 width,nat32 height,bit r) const;
+};
+
+//------------------------------------------------------------------------------
+// A single benchmark. Setup is called once, then Prepare and Run for every
+// repetition, with only Run timed. Run returns a checksum of its result, which
+// should be the same every time, so a build that changes the answer as well as
+// the speed is noticed, and so the compiler can't optimise the work away...
+class Bench
+{
+ public:
+   Bench(cstrconst n,cstrconst g):name(n),group(g) {}
+   virtual ~Bench() {}
+
+   cstrconst Name() const {return name;}
+   cstrconst Group() const {return group;}
+
+  // Builds the inputs, returns false if it can't, e.g. a missing file, in
+  // which case the benchmark is skipped...
+   virtual bit Setup(const Dataset & data) {return true;}
+
+  // Called before every Run, for benchmarks that consume their input...
+   virtual void Prepare() {}
+
+  // The timed part...
+   virtual real64 Run() = 0;
+
+
+ private:
+  cstrconst name;
+  cstrconst group;
+};
+
+//------------------------------------------------------------------------------
+// Appends the benchmarks, in the order they are run, the caller then owns
+// them...
+void MicroBenches(ds::List<Bench*> & out);
+void MacroBenches(ds::List<Bench*> & out);
+
+//------------------------------------------------------------------------------
+#endif
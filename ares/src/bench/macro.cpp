@@ -0,0 +1,237 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "bench/benches.h"
+
+//------------------------------------------------------------------------------
+// Base for the end to end stereo pipelines - holds the pair, the real one if
+// given, and the disparity range. Everything the pipeline makes, including
+// the colour conversions, is done in the timed part...
+class PipelineBench : public Bench
+{
+ public:
+  PipelineBench(cstrconst name,nat32 w,nat32 h)
+  :Bench(name,"macro"),width(w),height(h),core(null<svt::Core*>()),
+  left(null<svt::Var*>()),right(null<svt::Var*>()),minDisp(0),maxDisp(0) {}
+  ~PipelineBench() {delete left; delete right;}
+
+  bit Setup(const Dataset & data)
+  {
+   core = &data.GetCore();
+   left = data.Left(width,height,true);
+   right = data.Right(width,height,true);
+   minDisp = data.MinDisp();
+   maxDisp = data.MaxDisp();
+   return (left!=null<svt::Var*>())&&(right!=null<svt::Var*>());
+  }
+
+ protected:
+  nat32 width;
+  nat32 height;
+  svt::Core * core;
+  svt::Var * left;
+  svt::Var * right;
+  int32 minDisp;
+  int32 maxDisp;
+
+  // Makes a Var the size of the given image with a luminance field, filled
+  // in from its rgb...
+   svt::Var * Luminance(svt::Var * image)
+   {
+    svt::Var * ret = new svt::Var(*core);
+    ret->Setup2D(image->Size(0),image->Size(1));
+    bs::ColourL lIni(0.0);
+    ret->Add("l",lIni);
+    ret->Commit();
+
+    svt::Field<bs::ColourRGB> rgb(image,"rgb");
+    svt::Field<bs::ColourL> l(ret,"l");
+    filter::RGBtoL(rgb,l);
+    return ret;
+   }
+};
+
+//------------------------------------------------------------------------------
+// Luminance, a Sad cost volume with a 7x7 window and winner takes all...
+class SadWtaBench : public PipelineBench
+{
+ public:
+  SadWtaBench():PipelineBench("stereo_sad_wta",640,480) {}
+
+  real64 Run()
+  {
+   svt::Var * lVar = Luminance(left);
+   svt::Var * rVar = Luminance(right);
+   svt::Field<bs::ColourL> lc(lVar,"l"); svt::Field<real32> l; lc.SubField(0,l);
+   svt::Field<bs::ColourL> rc(rVar,"l"); svt::Field<real32> r; rc.SubField(0,r);
+
+   svt::Var vol(*core);
+   vol.Setup3D(l.Size(0),l.Size(1),nat32(maxDisp-minDisp+1));
+   real32 costIni = 0.0;
+   vol.Add("cost",costIni);
+   vol.Commit();
+   svt::Field<real32> cost(&vol,"cost");
+
+   stereo::Sad sad;
+   sad.AddField(l,r);
+   sad.SetRadius(3);
+   sad.SetRange(minDisp,maxDisp);
+   sad.SetOutput(cost);
+   sad.SetParallel();
+   sad.Run();
+
+   real64 sum = 0.0;
+   for (nat32 y=0;y<cost.Size(1);y++)
+   {
+    for (nat32 x=0;x<cost.Size(0);x++)
+    {
+     nat32 best = 0;
+     for (nat32 d=1;d<cost.Size(2);d++)
+     {
+      if (cost.Get(x,y,d)<cost.Get(x,y,best)) best = d;
+     }
+     sum += int32(best) + minDisp;
+    }
+   }
+
+   delete lVar;
+   delete rVar;
+   return sum;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Luminance and the Felzenszwalb & Huttenlocher belief propagation stereo...
+class SimpleBpBench : public PipelineBench
+{
+ public:
+  SimpleBpBench():PipelineBench("stereo_simple_bp",320,240) {}
+
+  real64 Run()
+  {
+   svt::Var * lVar = Luminance(left);
+   svt::Var * rVar = Luminance(right);
+   svt::Field<bs::ColourL> lc(lVar,"l"); svt::Field<real32> l; lc.SubField(0,l);
+   svt::Field<bs::ColourL> rc(rVar,"l"); svt::Field<real32> r; rc.SubField(0,r);
+
+   stereo::SimpleBP bp;
+   bp.SetPair(l,r);
+   bp.SetDisp(minDisp,maxDisp);
+   bp.Run();
+
+   svt::Var dispVar(*core);
+   dispVar.Setup2D(l.Size(0),l.Size(1));
+   int32 dispIni = 0;
+   dispVar.Add("disp",dispIni);
+   dispVar.Commit();
+   svt::Field<int32> disp(&dispVar,"disp");
+   bp.GetDisparity(disp);
+
+   real64 sum = 0.0;
+   for (nat32 y=0;y<disp.Size(1);y++)
+   {
+    for (nat32 x=0;x<disp.Size(0);x++) sum += disp.Get(x,y);
+   }
+
+   delete lVar;
+   delete rVar;
+   return sum;
+  }
+};
+
+//------------------------------------------------------------------------------
+// The sad_stereo program - Synergism segmentation of the left image followed
+// by segment based Sad stereo, with its pruning...
+class SegSadBench : public PipelineBench
+{
+ public:
+  SegSadBench():PipelineBench("stereo_seg_sad",320,240) {}
+
+  real64 Run()
+  {
+   svt::Var work(*core);
+   work.Setup2D(left->Size(0),left->Size(1));
+    bs::ColourL lIni(0.0);
+    work.Add("l",lIni);
+    bs::ColourLuv luvIni(0.0,0.0,0.0);
+    work.Add("luv",luvIni);
+    nat32 segsIni = 0;
+    work.Add("segs",segsIni);
+    real32 dispIni = 0.0;
+    work.Add("disp",dispIni);
+    bit validIni = false;
+    work.Add("valid",validIni);
+   work.Commit();
+
+   svt::Field<bs::ColourRGB> leftRGB(left,"rgb");
+   svt::Field<bs::ColourRGB> rightRGB(right,"rgb");
+   svt::Field<bs::ColourL> l(&work,"l");
+   svt::Field<bs::ColourLuv> luv(&work,"luv");
+   filter::RGBtoL(leftRGB,l);
+   filter::RGBtoLuv(leftRGB,luv);
+
+   filter::Synergism syn;
+   syn.SetImage(l,luv);
+   syn.Run();
+   svt::Field<nat32> segs(&work,"segs");
+   syn.GetSegments(segs);
+
+   stereo::SadSegStereo sss;
+   sss.SetSegments(syn.Segments(),segs);
+
+   svt::Field<real32> lr; leftRGB.SubField(0,lr);
+   svt::Field<real32> lg; leftRGB.SubField(sizeof(real32),lg);
+   svt::Field<real32> lb; leftRGB.SubField(2*sizeof(real32),lb);
+   svt::Field<real32> rr; rightRGB.SubField(0,rr);
+   svt::Field<real32> rg; rightRGB.SubField(sizeof(real32),rg);
+   svt::Field<real32> rb; rightRGB.SubField(2*sizeof(real32),rb);
+   sss.AddField(lr,rr);
+   sss.AddField(lg,rg);
+   sss.AddField(lb,rb);
+
+   sss.SetRange(minDisp,maxDisp);
+   sss.SetMinCluster(32);
+   sss.SetMaxRadius(3);
+   sss.Run();
+
+   svt::Field<real32> disp(&work,"disp");
+   svt::Field<bit> valid(&work,"valid");
+   sss.GetDisparity(disp);
+   sss.GetMask(valid);
+
+   real64 sum = 0.0;
+   for (nat32 y=0;y<disp.Size(1);y++)
+   {
+    for (nat32 x=0;x<disp.Size(0);x++)
+    {
+     if (valid.Get(x,y)) sum += disp.Get(x,y);
+    }
+   }
+   return sum;
+  }
+};
+
+//------------------------------------------------------------------------------
+void MacroBenches(ds::List<Bench*> & out)
+{
+ out.AddBack(new SadWtaBench());
+ out.AddBack(new SimpleBpBench());
+ out.AddBack(new SegSadBench());
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,375 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "bench/benches.h"
+
+//------------------------------------------------------------------------------
+// A repeatable texture, blocky noise plus slow colour gradients, so that
+// matching is unambiguous but not trivial...
+static bs::ColourRGB Texture(int32 u,int32 v)
+{
+ nat32 h = (nat32(u>>1)*73856093) ^ (nat32(v>>1)*19349663);
+ h = (h^(h>>13))*1274126177;
+ real32 n = real32(h>>8)/16777216.0;
+ real32 s = 0.5 + 0.5*math::Sin(real32(u)*0.05 + real32(v)*0.03);
+ return bs::ColourRGB(0.6*n + 0.4*s,0.6*real32(h&0xFF)/255.0 + 0.4*(1.0-s),0.5*n + 0.5*s);
+}
+
+Dataset::Dataset(svt::Core & c,cstrconst l,cstrconst r)
+:core(c),left(l),right(r),minDisp(-24),maxDisp(0)
+{}
+
+svt::Var * Dataset::Left(nat32 width,nat32 height,bit useReal) const
+{
+ if (useReal&&Real()) return filter::LoadImageRGB(core,left);
+ return Synthetic(width,height,false);
+}
+
+svt::Var * Dataset::Right(nat32 width,nat32 height,bit useReal) const
+{
+ if (useReal&&Real()) return filter::LoadImageRGB(core,right);
+ return Synthetic(width,height,true);
+}
+
+svt::Var * Dataset::Synthetic(nat32 width,nat32 height,bit r) const
+{
+ svt::Var * ret = new svt::Var(core);
+ ret->Setup2D(width,height);
+ bs::ColourRGB rgbIni(0.0,0.0,0.0);
+ ret->Add("rgb",rgbIni);
+ ret->Commit();
+
+ // The background is at disparity -6, the square in the middle at -18...
+  svt::Field<bs::ColourRGB> rgb(ret,"rgb");
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    int32 shift = 0;
+    if (r)
+    {
+     bit square = (x>width/3)&&(x<(2*width)/3)&&(y>height/3)&&(y<(2*height)/3);
+     shift = square?18:6;
+    }
+    rgb.Get(x,y) = Texture(int32(x)+shift,int32(y));
+   }
+  }
+
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// The timings of one benchmark, in seconds...
+struct Timing
+{
+ nat32 reps;
+ real64 min;
+ real64 p10;
+ real64 median;
+ real64 p90;
+ real64 max;
+ real64 mean;
+ real64 checksum;
+ bit stable; // false if the checksum changed between runs.
+};
+
+// Nearest rank percentile of a sorted array...
+static real64 Percentile(const ds::Array<real64> & sorted,real64 p)
+{
+ return sorted[nat32(p*real64(sorted.Size()-1) + 0.5)];
+}
+
+static void Measure(Bench & bench,nat32 warmup,nat32 reps,Timing & out)
+{
+ for (nat32 i=0;i<warmup;i++)
+ {
+  bench.Prepare();
+  out.checksum = bench.Run();
+ }
+
+ ds::Array<real64> taken(reps);
+ out.stable = true;
+ for (nat32 i=0;i<reps;i++)
+ {
+  bench.Prepare();
+  real64 start = time::UltraTime();
+  real64 sum = bench.Run();
+  taken[i] = time::UltraTime() - start;
+
+  if (((i!=0)||(warmup!=0))&&((sum<out.checksum)||(sum>out.checksum))) out.stable = false;
+  out.checksum = sum;
+ }
+
+ taken.SortNorm();
+ out.reps = reps;
+ out.min = taken[0];
+ out.p10 = Percentile(taken,0.1);
+ out.median = Percentile(taken,0.5);
+ out.p90 = Percentile(taken,0.9);
+ out.max = taken[reps-1];
+ out.mean = 0.0;
+ for (nat32 i=0;i<reps;i++) out.mean += taken[i];
+ out.mean /= real64(reps);
+}
+
+//------------------------------------------------------------------------------
+// A row of a results file, for comparing...
+struct Result
+{
+ cstr name;
+ real64 median;
+ real64 checksum;
+};
+
+// Loads the results from a file written by a previous run, returns false if
+// the file could not be opened...
+static bit LoadResults(cstrconst fn,ds::List<Result> & out)
+{
+ std::ifstream in(fn);
+ if (!in) return false;
+
+ std::string line;
+ while (std::getline(in,line))
+ {
+  // Split into fields, every one quoted by file::Csv...
+   ds::List<std::string> field;
+   std::string f;
+   for (nat32 i=0;i<line.size();i++)
+   {
+    if (line[i]==',') {field.AddBack(f); f.clear();}
+    else if (line[i]!='"') f += line[i];
+   }
+   field.AddBack(f);
+   if (field.Size()<11) continue;
+
+  // Columns are tag, name, group, reps, min, p10, median, p90, max, mean, checksum...
+   ds::Array<std::string> col(field.Size());
+   ds::List<std::string>::Cursor targ = field.FrontPtr();
+   for (nat32 i=0;i<col.Size();i++,++targ) col[i] = *targ;
+   if (col[1]=="name") continue;
+
+   Result res;
+   res.name = str::Duplicate(col[1].c_str());
+   res.median = atof(col[6].c_str());
+   res.checksum = atof(col[10].c_str());
+   out.AddBack(res);
+ }
+ return true;
+}
+
+// Prints the change in median time of every benchmark in both files, returns
+// 0 if nothing got slower by more than the threshold, given as a fraction,
+// or changed its answer, 1 otherwise...
+static int Compare(cstrconst before,cstrconst after,real64 threshold)
+{
+ ds::List<Result> prev;
+ ds::List<Result> next;
+ if (!LoadResults(before,prev)) {std::cout << "Could not read " << before << "\n"; return 2;}
+ if (!LoadResults(after,next)) {std::cout << "Could not read " << after << "\n"; return 2;}
+
+ int ret = 0;
+ std::cout << "benchmark, before ms, after ms, change\n";
+ ds::List<Result>::Cursor targ = next.FrontPtr();
+ while (!targ.Bad())
+ {
+  ds::List<Result>::Cursor match = prev.FrontPtr();
+  while ((!match.Bad())&&(str::Compare((*match).name,(*targ).name)!=0)) ++match;
+
+  if (match.Bad()) std::cout << (*targ).name << ", -, " << (1000.0*(*targ).median) << ", new\n";
+  else
+  {
+   real64 change = (*targ).median/(*match).median - 1.0;
+   std::cout << (*targ).name << ", " << (1000.0*(*match).median) << ", " << (1000.0*(*targ).median)
+             << ", " << (100.0*change) << "%";
+   if (change>threshold) {std::cout << " SLOWER"; ret = 1;}
+   if (change<-threshold) std::cout << " faster";
+
+   real64 scale = math::Max(math::Abs((*match).checksum),1.0);
+   if (math::Abs((*targ).checksum-(*match).checksum)>1e-4*scale) {std::cout << " DIFFERENT ANSWER"; ret = 1;}
+   std::cout << "\n";
+  }
+  ++targ;
+ }
+
+ while (prev.Size()!=0) {mem::Free(prev.Front().name); prev.RemFront();}
+ while (next.Size()!=0) {mem::Free(next.Front().name); next.RemFront();}
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+int main(int argc,char ** argv)
+{
+ // Parse the options...
+  nat32 warmup = 2;
+  nat32 reps = 15;
+  cstrconst filter = null<cstrconst>();
+  cstrconst group = null<cstrconst>();
+  cstrconst csv = null<cstrconst>();
+  cstrconst tag = __DATE__ " " __TIME__;
+  cstrconst left = null<cstrconst>();
+  cstrconst right = null<cstrconst>();
+  bit setDisp = false;
+  int32 minDisp = 0;
+  int32 maxDisp = 0;
+  bit list = false;
+
+  for (int i=1;i<argc;i++)
+  {
+   if ((str::Compare(argv[i],"-compare")==0)&&(i+2<argc))
+   {
+    real64 threshold = (i+3<argc)?(0.01*str::ToReal32(argv[i+3])):0.05;
+    return Compare(argv[i+1],argv[i+2],threshold);
+   }
+   else if ((str::Compare(argv[i],"-warmup")==0)&&(i+1<argc)) warmup = str::ToInt32(argv[++i]);
+   else if ((str::Compare(argv[i],"-reps")==0)&&(i+1<argc)) reps = math::Max(str::ToInt32(argv[++i]),int32(1));
+   else if ((str::Compare(argv[i],"-filter")==0)&&(i+1<argc)) filter = argv[++i];
+   else if ((str::Compare(argv[i],"-group")==0)&&(i+1<argc)) group = argv[++i];
+   else if ((str::Compare(argv[i],"-csv")==0)&&(i+1<argc)) csv = argv[++i];
+   else if ((str::Compare(argv[i],"-tag")==0)&&(i+1<argc)) tag = argv[++i];
+   else if ((str::Compare(argv[i],"-pair")==0)&&(i+2<argc)) {left = argv[i+1]; right = argv[i+2]; i += 2;}
+   else if ((str::Compare(argv[i],"-disp")==0)&&(i+2<argc))
+   {
+    setDisp = true;
+    minDisp = str::ToInt32(argv[i+1]);
+    maxDisp = str::ToInt32(argv[i+2]);
+    i += 2;
+   }
+   else if (str::Compare(argv[i],"-list")==0) list = true;
+   else
+   {
+    std::cout << "Usage:\n";
+    std::cout << "bench <options>\n";
+    std::cout << "  -warmup [n]  Untimed runs before timing, default 2.\n";
+    std::cout << "  -reps [n]  Timed runs, default 15.\n";
+    std::cout << "  -filter [text]  Only runs benchmarks with the text in their name.\n";
+    std::cout << "  -group [micro|macro]  Only runs the given group.\n";
+    std::cout << "  -csv [file]  Writes the results to the given file, overwriting it.\n";
+    std::cout << "  -tag [text]  Names this build in the csv, defaults to its build time.\n";
+    std::cout << "  -pair [left] [right]  Real image pair for the macro benchmarks, instead\n";
+    std::cout << "                        of the synthetic one.\n";
+    std::cout << "  -disp [min] [max]  Disparity range of the pair, default -24 to 0.\n";
+    std::cout << "  -list  Lists the benchmarks without running them.\n";
+    std::cout << "bench -compare [before.csv] [after.csv] <threshold %>\n";
+    std::cout << "  Compares the medians of two runs, marking anything more than threshold,\n";
+    std::cout << "  default 5, slower, or that gives a different answer. Returns 1 if so.\n";
+    return 1;
+   }
+  }
+
+
+ // Build the list of benchmarks...
+  ds::List<Bench*> all;
+  MicroBenches(all);
+  MacroBenches(all);
+
+  ds::List<Bench*> todo;
+  while (all.Size()!=0)
+  {
+   Bench * b = all.Front();
+   all.RemFront();
+
+   bit use = true;
+   if (group&&(str::Compare(group,b->Group())!=0)) use = false;
+   if (filter&&(strstr(b->Name(),filter)==null<cstrconst>())) use = false;
+
+   if (use) todo.AddBack(b);
+       else delete b;
+  }
+
+  if (list)
+  {
+   while (todo.Size()!=0)
+   {
+    std::cout << todo.Front()->Group() << " " << todo.Front()->Name() << "\n";
+    delete todo.Front();
+    todo.RemFront();
+   }
+   return 0;
+  }
+
+
+ // Run them, one at a time, setting up each just before it runs so only
+ // one set of inputs is in memory at once...
+  str::TokenTable tt;
+  svt::Core core(tt);
+  Dataset data(core,left,right);
+  if (setDisp) data.SetDisp(minDisp,maxDisp);
+
+  file::Csv * out = null<file::Csv*>();
+  if (csv)
+  {
+   out = new file::Csv(csv,true);
+   if (!out->Active())
+   {
+    std::cout << "Could not open " << csv << "\n";
+    delete out;
+    return 1;
+   }
+   *out << "tag" << file::EndField() << "name" << file::EndField() << "group" << file::EndField()
+        << "reps" << file::EndField() << "min" << file::EndField() << "p10" << file::EndField()
+        << "median" << file::EndField() << "p90" << file::EndField() << "max" << file::EndField()
+        << "mean" << file::EndField() << "checksum" << file::EndRow();
+  }
+
+  std::cout << "benchmark, min ms, median ms, p90 ms, max ms, checksum\n";
+  int ret = 0;
+  while (todo.Size()!=0)
+  {
+   Bench * b = todo.Front();
+   todo.RemFront();
+
+   if (!b->Setup(data))
+   {
+    std::cout << b->Name() << ", skipped as its setup failed\n";
+    delete b;
+    ret = 1;
+    continue;
+   }
+
+   Timing t;
+   Measure(*b,warmup,reps,t);
+
+   std::cout << b->Name() << ", " << (1000.0*t.min) << ", " << (1000.0*t.median) << ", "
+             << (1000.0*t.p90) << ", " << (1000.0*t.max) << ", " << t.checksum;
+   if (!t.stable) std::cout << " (varies between runs)";
+   std::cout << "\n";
+
+   if (out)
+   {
+    *out << tag << file::EndField() << b->Name() << file::EndField() << b->Group() << file::EndField()
+         << t.reps << file::EndField() << t.min << file::EndField() << t.p10 << file::EndField()
+         << t.median << file::EndField() << t.p90 << file::EndField() << t.max << file::EndField()
+         << t.mean << file::EndField() << t.checksum << file::EndRow();
+    out->Flush();
+   }
+
+   delete b;
+  }
+
+  delete out;
+
+ return ret;
+}
+
+//------------------------------------------------------------------------------
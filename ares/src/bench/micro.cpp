@@ -0,0 +1,567 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "bench/benches.h"
+
+//------------------------------------------------------------------------------
+// Splits the rgb field of an image into its three channels...
+static void Channels(svt::Var * var,svt::Field<real32> & r,svt::Field<real32> & g,svt::Field<real32> & b)
+{
+ svt::Field<bs::ColourRGB> rgb(var,"rgb");
+ rgb.SubField(0,r);
+ rgb.SubField(sizeof(real32),g);
+ rgb.SubField(2*sizeof(real32),b);
+}
+
+//------------------------------------------------------------------------------
+// The DSC costs of every pixel of a 640x480 pair over 32 disparities, either
+// with the batched CostRun or a call to Cost for each...
+class DscBench : public Bench
+{
+ public:
+  DscBench(bit b):Bench(b?"dsc_cost":"dsc_cost_scalar","micro"),batch(b),
+                  left(null<svt::Var*>()),right(null<svt::Var*>()),dsc(null<stereo::DSC*>()) {}
+  ~DscBench() {delete dsc; delete left; delete right;}
+
+  bit Setup(const Dataset & data)
+  {
+   left = data.Left(640,480);
+   right = data.Right(640,480);
+
+   svt::Field<real32> lr,lg,lb; Channels(left,lr,lg,lb);
+   svt::Field<real32> rr,rg,rb; Channels(right,rr,rg,rb);
+   dsc = new stereo::DifferenceDSC(lr,rr);
+   return true;
+  }
+
+  real64 Run()
+  {
+   static const nat32 range = 32;
+   real32 cost[range];
+   real64 sum = 0.0;
+   for (nat32 y=0;y<dsc->HeightLeft();y++)
+   {
+    for (nat32 x=0;x+range<=dsc->WidthRight();x++)
+    {
+     if (batch) dsc->CostRun(x,x,y,range,cost);
+     else
+     {
+      for (nat32 i=0;i<range;i++) cost[i] = dsc->Cost(x,x+i,y);
+     }
+     for (nat32 i=0;i<range;i++) sum += cost[i];
+    }
+   }
+   return sum;
+  }
+
+ private:
+  bit batch;
+  svt::Var * left;
+  svt::Var * right;
+  stereo::DSC * dsc;
+};
+
+//------------------------------------------------------------------------------
+// Sad::Run for a 320x240 colour pair, 25 disparities and a 5x5 window...
+class SadBench : public Bench
+{
+ public:
+  SadBench(bit p):Bench(p?"sad_parallel":"sad","micro"),parallel(p),
+                  left(null<svt::Var*>()),right(null<svt::Var*>()),vol(null<svt::Var*>()) {}
+  ~SadBench() {delete vol; delete left; delete right;}
+
+  bit Setup(const Dataset & data)
+  {
+   left = data.Left(320,240);
+   right = data.Right(320,240);
+   Channels(left,lr,lg,lb);
+   Channels(right,rr,rg,rb);
+
+   vol = new svt::Var(data.GetCore());
+   vol->Setup3D(320,240,25);
+   real32 costIni = 0.0;
+   vol->Add("cost",costIni);
+   vol->Commit();
+   cost = svt::Field<real32>(vol,"cost");
+   return true;
+  }
+
+  real64 Run()
+  {
+   stereo::Sad sad;
+   sad.AddField(lr,rr);
+   sad.AddField(lg,rg);
+   sad.AddField(lb,rb);
+   sad.SetRadius(2);
+   sad.SetRange(-24,0);
+   sad.SetOutput(cost);
+   if (parallel) sad.SetParallel();
+   sad.Run();
+
+   real64 sum = 0.0;
+   for (nat32 y=0;y<cost.Size(1);y+=3)
+   {
+    for (nat32 x=0;x<cost.Size(0);x+=7)
+    {
+     for (nat32 d=0;d<cost.Size(2);d++) sum += cost.Get(x,y,d);
+    }
+   }
+   return sum;
+  }
+
+ private:
+  bit parallel;
+  svt::Var * left;
+  svt::Var * right;
+  svt::Var * vol;
+  svt::Field<real32> lr,lg,lb,rr,rg,rb;
+  svt::Field<real32> cost;
+};
+
+//------------------------------------------------------------------------------
+// BP2D with a truncated linear smoothing cost on a 96x96 grid of 16 labels,
+// the data cost being the distance from a noisy piecewise planar target...
+struct BpProblem
+{
+ nat32 width;
+ ds::Array<real32> target;
+};
+
+real32 BenchBpD(const BpProblem & p,nat32 x,nat32 y,nat32 label)
+{
+ real32 d = math::Abs(real32(label) - p.target[y*p.width + x]);
+ return (d<4.0)?d:4.0;
+}
+
+real32 BenchBpVM(const BpProblem & p) {return 1.0;}
+
+real32 BenchBpVT(const BpProblem & p) {return 3.0;}
+
+class BpBench : public Bench
+{
+ public:
+  BpBench(bit p):Bench(p?"bp2d_parallel":"bp2d","micro"),parallel(p),var(null<svt::Var*>()) {}
+  ~BpBench() {delete var;}
+
+  bit Setup(const Dataset & data)
+  {
+   data::Random rand(true,135);
+   prob.width = side;
+   prob.target.Size(side*side);
+   for (nat32 y=0;y<side;y++)
+   {
+    for (nat32 x=0;x<side;x++)
+    {
+     real32 t = (x<side/2)?(4.0 + real32(y)*0.05):(12.0 - real32(x)*0.03);
+     prob.target[y*side + x] = t + rand.Normal();
+    }
+   }
+
+   var = new svt::Var(data.GetCore());
+   var->Setup2D(side,side);
+   nat32 labelIni = 0;
+   var->Add("label",labelIni);
+   var->Commit();
+   out = svt::Field<nat32>(var,"label");
+   return true;
+  }
+
+  real64 Run()
+  {
+   alg::BP2D<alg::TruncLinearMsgBP2D<BpProblem,BenchBpD,BenchBpVM,BenchBpVT> > bp;
+   bp.SetLabels(labels);
+   bp.SetPT(prob);
+   bp.SetOutput(out);
+   bp.SetIterations(48);
+   bp.Run(null<time::Progress*>(),parallel?&mt::DefaultPool():null<mt::TaskPool*>());
+
+   real64 sum = 0.0;
+   for (nat32 y=0;y<side;y++)
+   {
+    for (nat32 x=0;x<side;x++) sum += out.Get(x,y);
+   }
+   return sum;
+  }
+
+ private:
+  static const nat32 side = 96;
+  static const nat32 labels = 16;
+
+  bit parallel;
+  BpProblem prob;
+  svt::Var * var;
+  svt::Field<nat32> out;
+};
+
+//------------------------------------------------------------------------------
+// Loopy sum-product on a FactorGraph, a 48x48 grid of 8 label variables with
+// Potts smoothing, for 20 iterations. The graph is rebuilt, untimed, for each
+// run...
+class FactorGraphBench : public Bench
+{
+ public:
+  FactorGraphBench():Bench("fg_loopy","micro"),fg(null<inf::FactorGraph*>()) {}
+  ~FactorGraphBench() {delete fg;}
+
+  bit Setup(const Dataset & data)
+  {
+   data::Random rand(true,136);
+   freq.Size(side*side*labels);
+   for (nat32 i=0;i<side*side;i++)
+   {
+    nat32 truth = ((i%side)*labels)/side;
+    for (nat32 l=0;l<labels;l++)
+    {
+     freq[i*labels + l] = ((l==truth)?0.5:0.1) + 0.4*rand.Real(0.0,1.0);
+    }
+   }
+   return true;
+  }
+
+  void Prepare()
+  {
+   delete fg;
+   fg = new inf::FactorGraph(false,true);
+   fg->SetIters(20);
+
+   inf::Distribution * unary = new inf::Distribution(side*side,labels);
+   for (nat32 i=0;i<side*side;i++) unary->SetFreq(i,&freq[i*labels]);
+
+   static const nat32 edges = 2*side*(side-1);
+   static const nat32 vert = side*(side-1); // Offset of the vertical edges.
+   inf::EqualPotts * potts = new inf::EqualPotts(edges,labels);
+   for (nat32 i=0;i<edges;i++) potts->Set(i,3.0);
+
+   nat32 uf = fg->MakeFuncs(unary,side*side);
+   nat32 pf = fg->MakeFuncs(potts,edges);
+
+   handle.Size(side*side);
+   inf::Variable var;
+   for (nat32 y=0;y<side;y++)
+   {
+    for (nat32 x=0;x<side;x++)
+    {
+     fg->MakeLink(&var,uf,y*side + x,0);
+     if (x!=0) fg->MakeLink(&var,pf,y*(side-1) + x-1,1);
+     if (x+1!=side) fg->MakeLink(&var,pf,y*(side-1) + x,0);
+     if (y!=0) fg->MakeLink(&var,pf,vert + (y-1)*side + x,1);
+     if (y+1!=side) fg->MakeLink(&var,pf,vert + y*side + x,0);
+     handle[y*side + x] = fg->MakeVar(&var);
+    }
+   }
+  }
+
+  real64 Run()
+  {
+   fg->Run();
+
+   real64 sum = 0.0;
+   for (nat32 i=0;i<handle.Size();i++)
+   {
+    inf::Frequency f = fg->Prob<inf::Frequency>(handle[i]);
+    nat32 best = 0;
+    for (nat32 l=1;l<labels;l++)
+    {
+     if (f[l]>f[best]) best = l;
+    }
+    sum += best;
+   }
+   return sum;
+  }
+
+ private:
+  static const nat32 side = 48;
+  static const nat32 labels = 8;
+
+  ds::Array<real32> freq;
+  ds::Array<nat32> handle;
+  inf::FactorGraph * fg;
+};
+
+//------------------------------------------------------------------------------
+// The Segmenter on the rgb of a 320x240 image, a new one for each run as it
+// can only be run once...
+class SegmenterBench : public Bench
+{
+ public:
+  SegmenterBench():Bench("segmenter","micro"),image(null<svt::Var*>()),seg(null<filter::Segmenter*>()) {}
+  ~SegmenterBench() {delete seg; delete image;}
+
+  bit Setup(const Dataset & data)
+  {
+   image = data.Left(320,240);
+   Channels(image,r,g,b);
+   return true;
+  }
+
+  void Prepare()
+  {
+   delete seg;
+   seg = new filter::Segmenter();
+   seg->SetCutoff(0.05);
+   seg->SetMinimum(16);
+   seg->SetAverageSteps(2);
+   seg->AddField(r);
+   seg->AddField(g);
+   seg->AddField(b);
+  }
+
+  real64 Run()
+  {
+   seg->Run();
+   return seg->Segments();
+  }
+
+ private:
+  svt::Var * image;
+  svt::Field<real32> r,g,b;
+  filter::Segmenter * seg;
+};
+
+//------------------------------------------------------------------------------
+// Synergism segmentation of a 320x240 image, with the mean shift accelerated
+// or not, a new one for each run as it can only be run once. The Luv and
+// luminance images are made in the setup...
+class SynergismBench : public Bench
+{
+ public:
+  SynergismBench(bit a):Bench(a?"synergism":"synergism_serial","micro"),accel(a),
+                        image(null<svt::Var*>()),syn(null<filter::Synergism*>()) {}
+  ~SynergismBench() {delete syn; delete image;}
+
+  bit Setup(const Dataset & data)
+  {
+   image = data.Left(320,240);
+   bs::ColourL lIni(0.0);
+   image->Add("l",lIni);
+   bs::ColourLuv luvIni(0.0,0.0,0.0);
+   image->Add("luv",luvIni);
+   image->Commit();
+
+   svt::Field<bs::ColourRGB> rgb(image,"rgb");
+   l = svt::Field<bs::ColourL>(image,"l");
+   luv = svt::Field<bs::ColourLuv>(image,"luv");
+   filter::RGBtoL(rgb,l);
+   filter::RGBtoLuv(rgb,luv);
+   return true;
+  }
+
+  void Prepare()
+  {
+   delete syn;
+   syn = new filter::Synergism();
+   syn->SetImage(l,luv);
+   syn->Accelerate(accel);
+  }
+
+  real64 Run()
+  {
+   syn->Run();
+   return syn->Segments();
+  }
+
+ private:
+  bit accel;
+  svt::Var * image;
+  svt::Field<bs::ColourL> l;
+  svt::Field<bs::ColourLuv> luv;
+  filter::Synergism * syn;
+};
+
+//------------------------------------------------------------------------------
+// KdTree of 100000 random points in 3D, building the balanced tree and then
+// 20000 nearest neighbour queries against it...
+typedef math::Vect<3,real32> KdPoint;
+
+class KdTreeBench : public Bench
+{
+ public:
+  KdTreeBench(bit b):Bench(b?"kdtree_build":"kdtree_nearest","micro"),build(b) {}
+  ~KdTreeBench() {}
+
+  bit Setup(const Dataset & data)
+  {
+   data::Random rand(true,137);
+   point.Size(100000);
+   for (nat32 i=0;i<point.Size();i++)
+   {
+    for (nat32 j=0;j<3;j++) point[i][j] = rand.Real(0.0,1.0);
+   }
+
+   query.Size(20000);
+   for (nat32 i=0;i<query.Size();i++)
+   {
+    for (nat32 j=0;j<3;j++) query[i][j] = rand.Real(0.0,1.0);
+   }
+
+   if (!build) tree.Build(point);
+   return true;
+  }
+
+  real64 Run()
+  {
+   if (build)
+   {
+    tree.Build(point);
+    return tree.Size();
+   }
+
+   real64 sum = 0.0;
+   for (nat32 i=0;i<query.Size();i++)
+   {
+    const KdPoint & n = tree.Nearest(query[i]);
+    sum += n[0] + n[1] + n[2];
+   }
+   return sum;
+  }
+
+ private:
+  bit build;
+  ds::Array<KdPoint> point;
+  ds::Array<KdPoint> query;
+  ds::KdTree<KdPoint,3> tree;
+};
+
+//------------------------------------------------------------------------------
+// RGBtoLuv on a 1024x768 image...
+class LuvBench : public Bench
+{
+ public:
+  LuvBench():Bench("rgb_to_luv","micro"),image(null<svt::Var*>()) {}
+  ~LuvBench() {delete image;}
+
+  bit Setup(const Dataset & data)
+  {
+   image = data.Left(1024,768);
+   bs::ColourLuv luvIni(0.0,0.0,0.0);
+   image->Add("luv",luvIni);
+   image->Commit();
+   return true;
+  }
+
+  real64 Run()
+  {
+   filter::RGBtoLuv(image);
+
+   svt::Field<bs::ColourLuv> luv(image,"luv");
+   real64 sum = 0.0;
+   for (nat32 y=0;y<luv.Size(1);y+=5)
+   {
+    for (nat32 x=0;x<luv.Size(0);x+=5) sum += luv.Get(x,y).l + luv.Get(x,y).u + luv.Get(x,y).v;
+   }
+   return sum;
+  }
+
+ private:
+  svt::Var * image;
+};
+
+//------------------------------------------------------------------------------
+// Simplify of a bumpy 128x128 vertex grid of quads down to 10% of its
+// vertices, serial or in patches. The mesh is rebuilt, untimed, for each
+// run...
+class SimplifyBench : public Bench
+{
+ public:
+  SimplifyBench(bit p):Bench(p?"simplify_parallel":"simplify","micro"),parallel(p),
+                       tt(null<str::TokenTable*>()),mesh(null<sur::Mesh*>()) {}
+  ~SimplifyBench() {delete mesh;}
+
+  bit Setup(const Dataset & data)
+  {
+   tt = &data.GetCore().GetTT();
+
+   data::Random rand(true,138);
+   height.Size(side*side);
+   for (nat32 y=0;y<side;y++)
+   {
+    for (nat32 x=0;x<side;x++)
+    {
+     height[y*side + x] = 0.1*math::Sin(real32(x)*0.2)*math::Cos(real32(y)*0.15) + 0.002*rand.Normal();
+    }
+   }
+   return true;
+  }
+
+  void Prepare()
+  {
+   delete mesh;
+   mesh = new sur::Mesh(tt);
+
+   ds::Array<sur::Vertex> vert(side*side);
+   for (nat32 y=0;y<side;y++)
+   {
+    for (nat32 x=0;x<side;x++)
+    {
+     bs::Vert pos;
+     pos[0] = real32(x)/real32(side);
+     pos[1] = real32(y)/real32(side);
+     pos[2] = height[y*side + x];
+     vert[y*side + x] = mesh->NewVertex(pos);
+    }
+   }
+
+   for (nat32 y=0;y+1<side;y++)
+   {
+    for (nat32 x=0;x+1<side;x++)
+    {
+     mesh->NewFace(vert[y*side + x],vert[y*side + x+1],vert[(y+1)*side + x+1],vert[(y+1)*side + x]);
+    }
+   }
+  }
+
+  real64 Run()
+  {
+   sur::Simplify simp;
+   simp.Set(mesh);
+   simp.SetMerge(0.0);
+   if (parallel) simp.SetPatches(0);
+   simp.RunP(0.1);
+   return mesh->VertexCount() + mesh->FaceCount();
+  }
+
+ private:
+  static const nat32 side = 128;
+
+  bit parallel;
+  str::TokenTable * tt;
+  ds::Array<real32> height;
+  sur::Mesh * mesh;
+};
+
+//------------------------------------------------------------------------------
+void MicroBenches(ds::List<Bench*> & out)
+{
+ out.AddBack(new DscBench(true));
+ out.AddBack(new DscBench(false));
+ out.AddBack(new SadBench(false));
+ out.AddBack(new SadBench(true));
+ out.AddBack(new BpBench(false));
+ out.AddBack(new BpBench(true));
+ out.AddBack(new FactorGraphBench());
+ out.AddBack(new SegmenterBench());
+ out.AddBack(new SynergismBench(false));
+ out.AddBack(new SynergismBench(true));
+ out.AddBack(new KdTreeBench(true));
+ out.AddBack(new KdTreeBench(false));
+ out.AddBack(new LuvBench());
+ out.AddBack(new SimplifyBench(false));
+ out.AddBack(new SimplifyBench(true));
+}
+
+//------------------------------------------------------------------------------
@@ -456,86 +456,20 @@ void AlbedoEst::Run(gui::Base * obj,gui::Event * event)
   }
 
 
- // Count the number of segments and the size of each...
-  nat32 segCount = 0;
-  for (nat32 y=0;y<seg.Size(1);y++)
-  {
-   for (nat32 x=0;x<seg.Size(0);x++) segCount = math::Max(segCount,seg.Get(x,y)+1);
-  }
-  
-  ds::Array<nat32> segSize(segCount);
-  for (nat32 i=0;i<segCount;i++) segSize[i] = 0;
-  
-  for (nat32 y=0;y<seg.Size(1);y++)
-  {
-   for (nat32 x=0;x<seg.Size(0);x++)
-   {
-    if (mask.Get(x,y)) segSize[seg.Get(x,y)] += 1;
-   }
-  }
- 
- 
- // Iterate each segment, collect all estimates together and calculate the mode...
+ // Calculate the weighted median of the estimates of each segment...
   time::Progress * prog = cyclops.BeginProg();
-  albedo.Size(segSize.Size());
-  prog->Push();
-  for (nat32 s=0;s<segSize.Size();s++)
   {
-   prog->Report(s,segSize.Size());
-   if (segSize[s]>0)
-   {
-    ds::Array<WeightEst> estimate(segSize[s]);
-    nat32 pos = 0;
-    for (nat32 y=0;y<irradiance.Size(1);y++)
-    {
-     for (nat32 x=0;x<irradiance.Size(0);x++)
-     {
-      if (mask.Get(x,y)&&(seg.Get(x,y)==s))
-      {
-       real32 dot = needle.Get(x,y) * toLight;
-       estimate[pos].estimate = irradiance.Get(x,y) / dot;
-       estimate[pos].weight = dot;
-       
-       if ((!math::IsFinite(estimate[pos].estimate))||(!math::IsFinite(estimate[pos].weight)))
-       {
-        estimate[pos].estimate = 0.0;
-        estimate[pos].weight = 0.0;
-       }
-       
-       pos += 1;
-      }
-     }
-    }   
-    eos::log::Assert(pos==segSize[s]);
+   sfs::SegAlbedoEstimate sae;
+   sae.Set(irradiance);
+   sae.Set(needle);
+   sae.Set(seg);
+   sae.SetMask(mask);
+   sae.SetLight(toLight);
+   sae.Run(prog);
    
-    estimate.SortNorm();
-    
-    real32 weightSum = 0.0;
-    for (nat32 i=0;i<estimate.Size();i++) weightSum += estimate[i].weight;
-    weightSum /= 2.0;
-    
-    nat32 end = 0;
-    real32 endWeight = estimate[0].weight;
-    while (endWeight<weightSum)
-    {
-     end += 1;
-     endWeight += estimate[end].weight;
-    }
-    
-    if (end!=0)
-    {
-     real32 w = (weightSum - endWeight + estimate[end].weight) / estimate[end].weight;
-     albedo[s] = (1.0-w)*estimate[end-1].estimate + w*estimate[end].estimate;
-    }
-    else albedo[s] = estimate[end].estimate;
-    albedo[s] = math::Min(albedo[s],cap);
-   }
-   else
-   {
-    albedo[s] = 0.0;
-   }
+   albedo.Size(sae.Segments());
+   for (nat32 s=0;s<albedo.Size();s++) albedo[s] = math::Min(sae.Albedo(s),cap);
   }
-  prog->Pop();
   cyclops.EndProg();
 
 
@@ -378,17 +378,26 @@ void Capture::CaptureNow(gui::Base * obj,gui::Event * event)
   if (rightConfig) right.SetConf(rightConfig);
 
 
- // Create a thread for each camera into which the final capture and return shall go...
-  CaptureThread leftCT(left,leftVar,leftImage);
-  CaptureThread rightCT(right,rightVar,rightImage);
-  
-  leftCT.Run();
-  leftCT.Wait(); // ****************************
-  rightCT.Run();
+ // Fire both cameras at once through a capture pipeline, which downloads and
+ // decodes them in parallel...
+  {
+   os::CapturePipeline pipe(cyclops.Core(),true,1);
+   nat32 leftCam = pipe.Add(left);
+   pipe.Add(right);
+   pipe.Start();
+   pipe.Trigger();
+   pipe.Stop();
+
+   while (os::CapturePipeline::Frame * frame = pipe.Get(0))
+   {
+    if (frame->camera==leftCam) StoreFrame(frame->image,leftVar,leftImage);
+                           else StoreFrame(frame->image,rightVar,rightImage);
+    pipe.Release(frame);
+   }
 
- // Wait for the threads to finish...
-  //leftCT.Wait();
-  rightCT.Wait();
+   if (pipe.Failures()!=0) {LogAlways("[cyclops.capture] Capture failed to return both images");}
+   pipe.LogStats();
+  }
 
  // Disconnect and cleanup...
   left.Deactivate();
@@ -461,6 +470,19 @@ void Capture::CaptureRight(gui::Base * obj,gui::Event * event)
   this->right->Redraw();    
 }
 
+void Capture::StoreFrame(svt::Var * img,svt::Var * out,svt::Field<bs::ColRGB> & field)
+{
+ svt::Field<bs::ColourRGB> rgb(img,"rgb");
+ out->Setup2D(rgb.Size(0),rgb.Size(1));
+ out->Commit();
+
+ out->ByName("rgb",field);
+ for (nat32 y=0;y<rgb.Size(1);y++)
+ {
+  for (nat32 x=0;x<rgb.Size(0);x++) field.Get(x,y) = rgb.Get(x,y);
+ }
+}
+
 void Capture::SaveLeft(gui::Base * obj,gui::Event * event)
 {
  // Get the filename...
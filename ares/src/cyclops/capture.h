@@ -76,6 +76,9 @@ class Capture
   
   void SaveLeft(gui::Base * obj,gui::Event * event); 
   void SaveRight(gui::Base * obj,gui::Event * event); 
+
+  // Copies a frame from the capture pipeline into one of the images...
+   void StoreFrame(svt::Var * img,svt::Var * out,svt::Field<bs::ColRGB> & field);
 };
 
 //------------------------------------------------------------------------------
@@ -618,7 +618,7 @@ void Fundamental::AutoMatch(gui::Base * obj,gui::Event * event)
 
    // Do the matching - a single function call...
     ds::Array<Pair<bs::Pnt,bs::Pnt> > matFnd;
-    filter::MatchImages(leftRGB,rightRGB,matFnd,1500,5,0.7,cyclops.BeginProg());
+    filter::MatchImages(leftRGB,rightRGB,matFnd,1500,5,0.7,-1.0,cyclops.BeginProg());
     cyclops.EndProg();
 
 
@@ -17,6 +17,7 @@
 
 
 #include "cyclops/main.h"
+#include "cyclops/worker.h"
 #include "cyclops/intrinsic.h"
 #include "cyclops/protractor.h"
 #include "cyclops/fundamental.h"
@@ -61,7 +62,8 @@
 //------------------------------------------------------------------------------
 // Code for cyclops class...
 Cyclops::Cyclops()
-:tokTab(),core(tokTab),guiFact(tokTab),app(null<gui::App*>()),win(null<gui::Window*>())
+:tokTab(),core(tokTab),guiFact(tokTab),app(null<gui::App*>()),win(null<gui::Window*>()),
+worker(null<Worker*>())
 {
  if (guiFact.Active()==false) return;
 
@@ -81,6 +83,8 @@ Cyclops::Cyclops()
   prog->SetSize(256,24);
   grid->Attach(0,1,prog,6);
 
+  worker = new Worker(*app,prog);
+
   gui::Vertical * vert0 = static_cast<gui::Vertical*>(guiFact.Make("Vertical"));
   gui::Vertical * vert1 = static_cast<gui::Vertical*>(guiFact.Make("Vertical"));
   gui::Vertical * vert2 = static_cast<gui::Vertical*>(guiFact.Make("Vertical"));
@@ -387,6 +391,7 @@ Cyclops::Cyclops()
 
 Cyclops::~Cyclops()
 {
+ delete worker;
  delete app;
 }
 
@@ -24,6 +24,9 @@ using namespace eos;
 
 #define CYCLOPS_ABOUT "Cyclops Beta; " __DATE__ "; Copyright 2004-2008 Tom SF Haines. I may be contacted via e-mail at tom@thaines.net, the website for this program is at www.thaines.net/cyclops. By using this software you are agreeing to the terms in license.txt which must be in the executables directory and avaliable for you to access."
 
+//------------------------------------------------------------------------------
+class Worker;
+
 //------------------------------------------------------------------------------
 class Cyclops
 {
@@ -39,6 +42,9 @@ class Cyclops
   time::Progress * BeginProg() {return prog->Begin();}
   void EndProg() {prog->End();}
 
+  // For running long operations in the background...
+   Worker & Work() {return *worker;}
+
 
  private:
   str::TokenTable tokTab;
@@ -48,6 +54,7 @@ class Cyclops
   gui::App * app;
   gui::Window * win;
   gui::ProgressBar * prog;
+  Worker * worker;
 
   void Quit(gui::Base * obj,gui::Event * event);
   void StartIntrinsic(gui::Base * obj,gui::Event * event);
@@ -246,6 +246,7 @@ void MeshOps::Simplify(gui::Base * obj,gui::Event * event)
    simp.Set(mesh);
    simp.SetMerge(range);
    simp.SetEdge(edgeCost);
+   if (mesh->FaceCount()>100000) simp.SetPatches(0); // Big enough to be worth doing in parallel.
    
    if (fact<1.0) simp.RunP(fact,cyclops.BeginProg());
             else simp.Run(nat32(fact),cyclops.BeginProg());
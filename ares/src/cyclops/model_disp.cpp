@@ -148,30 +148,20 @@ void ModelDisp::AddModel(gui::Base * obj,gui::Event * event)
   }
 
 
- // Then triangulate...
+ // Then convert to a flat triangle mesh, which triangulates...
   prog->Report(1,3);
-  mesh->Triangulate();
+  sur::IndexedMesh tris;
+  tris.FromMesh(*mesh);
+  delete mesh;
 
 
- // Then iterate all triangles...
+ // Then add all the triangles...
   prog->Report(2,3);
-  ds::Array<sur::Face> face;
-  mesh->GetFaces(face);
-
-  ds::Array<sur::Vertex> tri(3);
-  prog->Push();
-   for (nat32 i=0;i<face.Size();i++)
-   {
-    prog->Report(i,face.Size());
-    face[i].GetVertices(tri);
-    makeDisp.Add(tri[0].Pos(),tri[1].Pos(),tri[2].Pos());
-   }
-  prog->Pop();
+  makeDisp.Add(tris);
   cyclops.EndProg();
 
 
- // Clean up and redraw...
-  delete mesh;
+ // Redraw...
   RenderDisp();
   canvas->Redraw();
 }
@@ -29,12 +29,6 @@ ModelRender::ModelRender(Cyclops & cyc)
   floatVar->Add("rgb",colourIni);
   floatVar->Commit();
   floatVar->ByName("rgb",floatImage);
-  
-  depth.Resize(floatVar->Size(0),floatVar->Size(1));
-  for (nat32 y=0;y<depth.Height();y++)
-  {
-   for (nat32 x=0;x<depth.Width();x++) depth.Get(x,y) = -math::Infinity<real32>();
-  }  
  
   var = new svt::Var(cyclops.Core());
   var->Setup2D(320,240);
@@ -51,8 +45,7 @@ ModelRender::ModelRender(Cyclops & cyc)
   camera.dim[0] = 320.0;
   camera.dim[1] = 240.0;
   
-  camRays.Resize(floatVar->Size(0),floatVar->Size(1));
-  //cam::CamToRays(camera,camRays);
+  raster.Reset(camera);
   
   UpdateImage();
 
@@ -144,15 +137,7 @@ void ModelRender::LoadCam(gui::Base * obj,gui::Event * event)
    floatVar->Commit();
    floatVar->ByName("rgb",floatImage);
    
-   depth.Resize(floatVar->Size(0),floatVar->Size(1));
-   for (nat32 y=0;y<depth.Height();y++)
-   {
-    for (nat32 x=0;x<depth.Width();x++) depth.Get(x,y) = -math::Infinity<real32>();
-   }
-   
-   camRays.Resize(floatVar->Size(0),floatVar->Size(1));
-   cam::CamToRays(camera,camRays,cyclops.BeginProg());
-   cyclops.EndProg();
+   raster.Reset(camera);
    
    
    UpdateImage();
@@ -186,9 +171,11 @@ void ModelRender::AddModelNeedle(gui::Base * obj,gui::Event * event)
   }
 
 
- // Then triangulate...
+ // Then convert to a flat triangle mesh, which triangulates...
   prog->Report(1,3);
-  mesh->Triangulate();
+  sur::IndexedMesh tris;
+  tris.FromMesh(*mesh);
+  delete mesh;
     
   
   math::Mat<3,3,real64> rot;
@@ -202,15 +189,14 @@ void ModelRender::AddModelNeedle(gui::Base * obj,gui::Event * event)
 
  // Then iterate all triangles...
   prog->Report(2,3);
-  ds::Array<sur::Face> face;
-  mesh->GetFaces(face);
-
-  ds::Array<sur::Vertex> tri(3);
+  bs::Vert tri[3];
+  nat32 base = raster.Triangles();
+  ds::Array<bs::ColourRGB> colour(tris.TriCount());
   prog->Push();
-   for (nat32 i=0;i<face.Size();i++)
+   for (nat32 i=0;i<tris.TriCount();i++)
    {
-    prog->Report(i,face.Size());
-    face[i].GetVertices(tri);
+    prog->Report(i,tris.TriCount());
+    tris.GetTri(i,tri[0],tri[1],tri[2]);
  
     // Calculate the triangles normal...
      math::Vect<3,real64> dir;
@@ -219,8 +205,8 @@ void ModelRender::AddModelNeedle(gui::Base * obj,gui::Event * event)
       math::Vect<3,real64> dirB;
       for (nat32 i=0;i<3;i++)
       {
-       dirA[i] = tri[1].Pos()[i] - tri[0].Pos()[i];
-       dirB[i] = tri[2].Pos()[i] - tri[0].Pos()[i];
+       dirA[i] = tri[1][i] - tri[0][i];
+       dirB[i] = tri[2][i] - tri[0][i];
       }
       math::CrossProduct(dirA,dirB,dir);
      }
@@ -233,16 +219,27 @@ void ModelRender::AddModelNeedle(gui::Base * obj,gui::Event * event)
      cDir[2] = math::Abs(cDir[2]); // *********************************************
      //if (cDir[2]<0.0) continue;
    
-    // Render the triangle...
-     bs::ColourRGB c(0.5*(1.0+cDir[0]),0.5*(1.0+cDir[1]),cDir[2]);
-     cam::RenderTri(camera,camRays,floatImage,depth,tri[0].Pos(),c,tri[1].Pos(),c,tri[2].Pos(),c);
+    // Add the triangle...
+     nat32 ind = raster.Add(tri[0],tri[1],tri[2]);
+     colour[ind-base] = bs::ColourRGB(0.5*(1.0+cDir[0]),0.5*(1.0+cDir[1]),cDir[2]);
    }
   prog->Pop();
+
+
+ // Render them all, and fill in the colour of everything that is new...
+  raster.Render(prog);
+  for (nat32 y=0;y<floatImage.Size(1);y++)
+  {
+   for (nat32 x=0;x<floatImage.Size(0);x++)
+   {
+    nat32 ind = raster.Tri(x,y);
+    if ((ind!=nat32(-1))&&(ind>=base)) floatImage.Get(x,y) = colour[ind-base];
+   }
+  }
   cyclops.EndProg();
 
 
- // Clean up and redraw...
-  delete mesh;
+ // Redraw...
   UpdateImage();
   canvas->Redraw();
 }
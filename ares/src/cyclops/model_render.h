@@ -36,11 +36,10 @@ class ModelRender
   gui::Canvas * canvas;
 
   cam::CameraFull camera;
-  ds::Array2D<bs::Ray> camRays; // Optimisation data structure.
+  cam::TriRaster raster; // Does the rendering, holds the depth map.
   
   svt::Var * floatVar;
   svt::Field<bs::ColourRGB> floatImage;
-  ds::Array2D<real32> depth; // Depth map, used for rendering.
 
   svt::Var * var;
   svt::Field<bs::ColRGB> image;
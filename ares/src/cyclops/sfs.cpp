@@ -18,6 +18,22 @@
 
 #include "cyclops/sfs.h"
 
+//------------------------------------------------------------------------------
+// Runs a shape from shading algorithm in the worker thread...
+class SfSJob : public Job
+{
+ public:
+  SfSJob(SfS & s,const SfS::Paras & p):Job(&s),self(s),paras(p) {}
+
+  void Run(time::Progress * prog) {self.Compute(paras,prog);}
+  void Done(bit cancelled) {self.Finish(cancelled);}
+  cstrconst Name() const {return "Shape from shading";}
+
+ private:
+  SfS & self;
+  SfS::Paras paras;
+};
+
 //------------------------------------------------------------------------------
 SfS::SfS(Cyclops & cyc)
 :cyclops(cyc),win(null<gui::Window*>()),
@@ -584,6 +600,7 @@ static_cast<gui::Button*>(cyclops.Fact().Make("Button"));
 
 SfS::~SfS()
 {
+ cyclops.Work().Abandon(this);
  delete win;
  delete dataVar;
  delete albedoVar;
@@ -598,6 +615,13 @@ void SfS::Quit(gui::Base * obj,gui::Event * event)
  delete this;
 }
 
+bit SfS::Busy()
+{
+ if (cyclops.Work().Jobs(this)==0) return false;
+ cyclops.App().MessageDialog(gui::App::MsgErr,"Wait for shape from shading to finish, or cancel it.");
+ return true;
+}
+
 void SfS::Resize(gui::Base * obj,gui::Event * event)
 {
  // Clear the canvas to a nice shade of grey...
@@ -614,6 +638,8 @@ void SfS::Resize(gui::Base * obj,gui::Event * event)
 
 void SfS::LoadImage(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  str::String fn;
  if (cyclops.App().LoadFileDialog("Select Image","*.bmp,*.jpg,*.png,*.tif",fn))
  {
@@ -647,6 +673,8 @@ void SfS::LoadImage(gui::Base * obj,gui::Event * event)
 
 void SfS::LoadAlbedo(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  str::String fn;
  if (cyclops.App().LoadFileDialog("Select Image","*.bmp,*.jpg,*.png,*.tif",fn))
  {
@@ -672,6 +700,8 @@ void SfS::LoadAlbedo(gui::Base * obj,gui::Event * event)
 
 void SfS::LoadInitialNeedle(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  str::String fn;
  if (cyclops.App().LoadFileDialog("Select Needle Image","*.bmp,*.jpg,*.png,*.tif",fn))
  {
@@ -697,6 +727,8 @@ void SfS::LoadInitialNeedle(gui::Base * obj,gui::Event * event)
 
 void SfS::LoadCalib(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  str::String fn;
  if (cyclops.App().LoadFileDialog("Select Camera Response Function","*.crf",fn))
  {
@@ -709,13 +741,82 @@ void SfS::LoadCalib(gui::Base * obj,gui::Event * event)
 }
 
 void SfS::Run(gui::Base * obj,gui::Event * event)
+{
+ if (cyclops.Work().Jobs(this)!=0)
+ {
+  if (cyclops.App().ChoiceDialog(gui::App::QuestYesNo,"Shape from shading is still running, cancel it?"))
+  {
+   cyclops.Work().Cancel(this);
+  }
+  return;
+ }
+
+ // Take a copy of the parameters, as the worker can't touch the gui...
+  Paras p;
+  p.albedo = albedo->GetReal(1.0);
+  p.lightDir = lightDir->Get();
+  p.whichAlg = whichAlg->Get();
+  p.lakOuterIters = lakOuterIters->GetInt(16);
+  p.lakInnerIters = lakInnerIters->GetInt(64);
+  p.lakTolerance = lakTolerance->GetReal(0.001);
+  p.lakInitRad = lakInitRad->GetReal(32.0);
+  p.lakStartLambda = lakStartLambda->GetReal(0.1);
+  p.lakEndLambda = lakEndLambda->GetReal(0.1);
+  p.lakSpeed = lakSpeed->GetReal(0.5);
+  p.wahIters = wahIters->GetInt(200);
+  p.hawBlur = hawBlur->GetReal(math::Sqrt(2.0));
+  p.hawLength = hawLength->GetInt(8);
+  p.hawExp = hawExp->GetReal(12.0);
+  p.hawStopChance = hawStopChance->GetReal(0.0);
+  p.hawSimK = hawSimK->GetReal(4.5);
+  p.hawConeK = hawConeK->GetReal(16.0);
+  p.hawFadeTo = hawFadeTo->GetReal(0.0);
+  p.hawIters = hawIters->GetInt(8);
+  p.hawGradDisc = hawGradDisc->GetReal(4.0);
+  p.hawGradBias = hawGradBias->GetReal(4.0);
+  p.hawBorderK = hawBorderK->GetReal(0.0);
+  p.hawProject = hawProject->Ticked();
+  p.haw2SimK = haw2SimK->GetReal(4.5);
+  p.haw2ConeK = haw2ConeK->GetReal(16.0);
+  p.haw2FadeTo = haw2FadeTo->GetReal(1.0);
+  p.haw2Iters = haw2Iters->GetInt(8);
+  p.haw2AngMult = haw2AngMult->GetReal(1.0);
+  p.haw2Momentum = haw2Momentum->GetReal(0.01);
+  p.haw2BoundK = haw2BoundK->GetReal(0.0);
+  p.haw2BoundLength = haw2BoundLength->GetInt(8);
+  p.haw2BoundExp = haw2BoundExp->GetReal(6.0);
+  p.haw2GradK = haw2GradK->GetReal(2.0);
+  p.haw2GradLength = haw2GradLength->GetInt(8);
+  p.haw2GradExp = haw2GradExp->GetReal(6.0);
+  p.haw3SmoothChance = haw3SmoothChance->GetReal(0.02);
+  p.haw3SmoothBase = haw3SmoothBase->GetReal(2.0);
+  p.haw3SmoothMult = haw3SmoothMult->GetReal(0.5);
+  p.haw3SmoothMinK = haw3SmoothMinK->GetReal(0.1);
+  p.haw3SmoothMaxK = haw3SmoothMaxK->GetReal(8.0);
+  p.haw3Cone0 = haw3Cone0->GetReal(24.0);
+  p.haw3Cone45 = haw3Cone45->GetReal(32.0);
+  p.haw3Cone90 = haw3Cone90->GetReal(24.0);
+  p.haw3Iters = haw3Iters->GetInt(10);
+  p.haw3BoundK = haw3BoundK->GetReal(16.0);
+  p.haw3BoundLength = haw3BoundLength->GetInt(8);
+  p.haw3BoundExp = haw3BoundExp->GetReal(6.0);
+  p.haw3GradK = haw3GradK->GetReal(2.0);
+  p.haw3GradLength = haw3GradLength->GetInt(8);
+  p.haw3GradExp = haw3GradExp->GetReal(6.0);
+  p.haw3AngMult = haw3AngMult->GetReal(1.0);
+  p.haw3Momentum = haw3Momentum->GetReal(0.01);
+
+ cyclops.Work().Add(new SfSJob(*this,p));
+}
+
+void SfS::Compute(const Paras & p,time::Progress * prog)
 {
  // Read in basic paramterers, remembering to compensate for the response 
  // function for albedo...
-  real32 alb = crf(albedo->GetReal(1.0));
+  real32 alb = crf(p.albedo);
   bs::Normal toLight;
   {
-   str::String s = lightDir->Get();
+   str::String s = p.lightDir;
    str::String::Cursor cur = s.GetCursor();
    cur.ClearError();
    cur >> toLight;
@@ -746,7 +847,7 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
 
  
  // Run the selected algorithm...
-  switch (whichAlg->Get())
+  switch (p.whichAlg)
   {
    /*case 0: // Zheng & Chellappa...
    {
@@ -763,8 +864,7 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
       alg.SetParas(mu,iters,delta);
       
     // Run...
-     alg.Run(cyclops.BeginProg());
-     cyclops.EndProg();
+     alg.Run(prog);
     
     // Extract the result...
      alg.GetNeedle(needle);
@@ -773,13 +873,13 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
    case 0: // Lee & Kuo...
    {
     // Get algorithm specific parameters...
-     nat32 outerIters = lakOuterIters->GetInt(16);
-     nat32 innerIters = lakInnerIters->GetInt(64);
-     real32 tolerance = lakTolerance->GetReal(0.001);
-     real32 initRad = lakInitRad->GetReal(32.0);
-     real32 startLambda = lakStartLambda->GetReal(0.1);
-     real32 endLambda = lakEndLambda->GetReal(0.1);
-     real32 speed = lakSpeed->GetReal(0.5);
+     nat32 outerIters = p.lakOuterIters;
+     nat32 innerIters = p.lakInnerIters;
+     real32 tolerance = p.lakTolerance;
+     real32 initRad = p.lakInitRad;
+     real32 startLambda = p.lakStartLambda;
+     real32 endLambda = p.lakEndLambda;
+     real32 speed = p.lakSpeed;
      
     // Make and setup the algorithm object...
       sfs::Lee alg;
@@ -789,8 +889,7 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
       alg.SetParas(outerIters,initRad,startLambda,endLambda,innerIters,tolerance,speed);
       
     // Run...
-     alg.Run(cyclops.BeginProg());
-     cyclops.EndProg();
+     alg.Run(prog);
     
     // Extract the result...
      alg.GetNeedle(needle);
@@ -799,7 +898,7 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
    case 1: // Worthington & Hancock...
    {
     // Get algorithm specific parameters...
-     nat32 iters = wahIters->GetInt(200);
+     nat32 iters = p.wahIters;
      
     // Make and setup the algorithm object...
       sfs::Worthington alg;
@@ -810,8 +909,7 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
       if (iniNeedleVar) alg.UseIniNeedle(iniNeedle);
       
     // Run...
-     alg.Run(cyclops.BeginProg());
-     cyclops.EndProg();
+     alg.Run(prog);
     
     // Extract the result...
      alg.GetNeedle(needle);
@@ -820,18 +918,18 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
    case 2: // Haines & Wilson #1...
    {
     // Get algorithm specific parameters...
-     real32 blur = hawBlur->GetReal(math::Sqrt(2.0));
-     nat32 length = hawLength->GetInt(8);
-     real32 exp = hawExp->GetReal(12.0);
-     real32 stopChance = hawStopChance->GetReal(0.0);
-     real32 simK = hawSimK->GetReal(4.5);
-     real32 coneK = hawConeK->GetReal(16.0);
-     real32 fadeTo = hawFadeTo->GetReal(0.0);
-     nat32 iters = hawIters->GetInt(8);
-     real32 gradDisc = hawGradDisc->GetReal(4.0);
-     real32 gradBias = hawGradBias->GetReal(4.0);
-     real32 borderK = hawBorderK->GetReal(0.0);
-     bit project = hawProject->Ticked();
+     real32 blur = p.hawBlur;
+     nat32 length = p.hawLength;
+     real32 exp = p.hawExp;
+     real32 stopChance = p.hawStopChance;
+     real32 simK = p.hawSimK;
+     real32 coneK = p.hawConeK;
+     real32 fadeTo = p.hawFadeTo;
+     nat32 iters = p.hawIters;
+     real32 gradDisc = p.hawGradDisc;
+     real32 gradBias = p.hawGradBias;
+     real32 borderK = p.hawBorderK;
+     bit project = p.hawProject;
      
     // Make and setup the algorithm object...
       sfs::SfS_BP_Nice alg;
@@ -843,8 +941,7 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
       alg.SetParasExtra(gradDisc,gradBias,borderK,project);
       
     // Run...
-     alg.Run(cyclops.BeginProg());
-     cyclops.EndProg();
+     alg.Run(prog);
     
     // Extract the result...
      alg.GetNeedle(needle);
@@ -854,18 +951,18 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
    case 3: // Haines & Wilson #2...
    {
     // Get algorithm specific parameters...
-     real32 simK = haw2SimK->GetReal(4.5);
-     real32 coneK = haw2ConeK->GetReal(16.0);
-     real32 fadeTo = haw2FadeTo->GetReal(1.0);
-     nat32 iters = haw2Iters->GetInt(8);
-     real32 angMult = haw2AngMult->GetReal(1.0);
-     real32 momentum = haw2Momentum->GetReal(0.01);
-     real32 boundK = haw2BoundK->GetReal(0.0);
-     nat32 boundLength = haw2BoundLength->GetInt(8);
-     real32 boundExp = haw2BoundExp->GetReal(6.0);
-     real32 gradK = haw2GradK->GetReal(2.0);
-     nat32 gradLength = haw2GradLength->GetInt(8);
-     real32 gradExp = haw2GradExp->GetReal(6.0);
+     real32 simK = p.haw2SimK;
+     real32 coneK = p.haw2ConeK;
+     real32 fadeTo = p.haw2FadeTo;
+     nat32 iters = p.haw2Iters;
+     real32 angMult = p.haw2AngMult;
+     real32 momentum = p.haw2Momentum;
+     real32 boundK = p.haw2BoundK;
+     nat32 boundLength = p.haw2BoundLength;
+     real32 boundExp = p.haw2BoundExp;
+     real32 gradK = p.haw2GradK;
+     nat32 gradLength = p.haw2GradLength;
+     real32 gradExp = p.haw2GradExp;
      
     // Make and setup the algorithm object...
      sfs::SfS_BP_Nice2 alg;
@@ -878,8 +975,7 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
       alg.SetParasExtract(angMult,momentum);
       
     // Run...
-     alg.Run(cyclops.BeginProg());
-     cyclops.EndProg();
+     alg.Run(prog);
     
     // Extract the result...
      alg.GetNeedle(needle);
@@ -889,23 +985,23 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
    case 4: // Haines & Wilson #3...
    {
     // Get algorithm specific parameters...
-     real32 smoothChance = haw3SmoothChance->GetReal(0.02);
-     real32 smoothBase = haw3SmoothBase->GetReal(2.0);
-     real32 smoothMult = haw3SmoothMult->GetReal(0.5);
-     real32 smoothMinK = haw3SmoothMinK->GetReal(0.1);
-     real32 smoothMaxK = haw3SmoothMaxK->GetReal(8.0);
-     real32 cone0 = haw3Cone0->GetReal(24.0);
-     real32 cone45 = haw3Cone45->GetReal(32.0);
-     real32 cone90 = haw3Cone90->GetReal(24.0);
-     nat32 iters = haw3Iters->GetInt(10);
-     real32 boundK = haw3BoundK->GetReal(16.0);
-     nat32 boundLength = haw3BoundLength->GetInt(8);
-     real32 boundExp = haw3BoundExp->GetReal(6.0);
-     real32 gradK = haw3GradK->GetReal(2.0);
-     nat32 gradLength = haw3GradLength->GetInt(8);
-     real32 gradExp = haw3GradExp->GetReal(6.0);
-     real32 angMult = haw3AngMult->GetReal(1.0);
-     real32 momentum = haw3Momentum->GetReal(0.01);
+     real32 smoothChance = p.haw3SmoothChance;
+     real32 smoothBase = p.haw3SmoothBase;
+     real32 smoothMult = p.haw3SmoothMult;
+     real32 smoothMinK = p.haw3SmoothMinK;
+     real32 smoothMaxK = p.haw3SmoothMaxK;
+     real32 cone0 = p.haw3Cone0;
+     real32 cone45 = p.haw3Cone45;
+     real32 cone90 = p.haw3Cone90;
+     nat32 iters = p.haw3Iters;
+     real32 boundK = p.haw3BoundK;
+     nat32 boundLength = p.haw3BoundLength;
+     real32 boundExp = p.haw3BoundExp;
+     real32 gradK = p.haw3GradK;
+     nat32 gradLength = p.haw3GradLength;
+     real32 gradExp = p.haw3GradExp;
+     real32 angMult = p.haw3AngMult;
+     real32 momentum = p.haw3Momentum;
     
     // Make and setup the algorithm object...
      sfs::SfS_BP_Nice3 alg;
@@ -920,24 +1016,28 @@ void SfS::Run(gui::Base * obj,gui::Event * event)
       alg.SetExtract(angMult,momentum);
       
     // Run...
-     alg.Run(cyclops.BeginProg());
-     cyclops.EndProg();
+     alg.Run(prog);
     
     // Extract the result...
      alg.GetNeedle(needle);
      alg.GetDist(dist);
    }
    break;  
-  }      
-
+  }
+}
 
- // Update the visualisation...
+void SfS::Finish(bit cancelled)
+{
+ // Update the visualisation, even if cancelled, as the algorithms leave a
+ // valid but unfinished needle map...
   hasRun = true;
   UpdateView();
 }
 
 void SfS::SaveNeedle(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  if (hasRun==false)
  {
   cyclops.App().MessageDialog(gui::App::MsgErr,"Algorithm has not been run!");
@@ -990,6 +1090,8 @@ void SfS::SaveNeedle(gui::Base * obj,gui::Event * event)
 
 void SfS::SaveDistText(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  if (hasRun==false)
  {
   cyclops.App().MessageDialog(gui::App::MsgErr,"Algorithm has not been run!");
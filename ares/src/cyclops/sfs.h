@@ -19,11 +19,13 @@
 
 
 #include "cyclops/main.h"
+#include "cyclops/worker.h"
 
 //------------------------------------------------------------------------------
 // Runs assorted shape from shading algorithms to produce needle maps.
 class SfS
 {
+ friend class SfSJob;
  public:
    SfS(Cyclops & cyclops);
   ~SfS();
@@ -121,9 +123,70 @@ class SfS
   svt::Field<bs::ColRGB> visible;
   bit hasRun;
 
+  // The parameters of Run, copied from the gui for the worker...
+   struct Paras
+   {
+     real32 albedo;
+     str::String lightDir;
+     nat32 whichAlg;
+     int32 lakOuterIters;
+     int32 lakInnerIters;
+     real32 lakTolerance;
+     real32 lakInitRad;
+     real32 lakStartLambda;
+     real32 lakEndLambda;
+     real32 lakSpeed;
+     int32 wahIters;
+     real32 hawBlur;
+     int32 hawLength;
+     real32 hawExp;
+     real32 hawStopChance;
+     real32 hawSimK;
+     real32 hawConeK;
+     real32 hawFadeTo;
+     int32 hawIters;
+     real32 hawGradDisc;
+     real32 hawGradBias;
+     real32 hawBorderK;
+     bit hawProject;
+     real32 haw2SimK;
+     real32 haw2ConeK;
+     real32 haw2FadeTo;
+     int32 haw2Iters;
+     real32 haw2AngMult;
+     real32 haw2Momentum;
+     real32 haw2BoundK;
+     int32 haw2BoundLength;
+     real32 haw2BoundExp;
+     real32 haw2GradK;
+     int32 haw2GradLength;
+     real32 haw2GradExp;
+     real32 haw3SmoothChance;
+     real32 haw3SmoothBase;
+     real32 haw3SmoothMult;
+     real32 haw3SmoothMinK;
+     real32 haw3SmoothMaxK;
+     real32 haw3Cone0;
+     real32 haw3Cone45;
+     real32 haw3Cone90;
+     int32 haw3Iters;
+     real32 haw3BoundK;
+     int32 haw3BoundLength;
+     real32 haw3BoundExp;
+     real32 haw3GradK;
+     int32 haw3GradLength;
+     real32 haw3GradExp;
+     real32 haw3AngMult;
+     real32 haw3Momentum;
+   };
+
 
   void Quit(gui::Base * obj,gui::Event * event);
 
+  // Returns true, after telling the user, if a run is queued or in progress,
+  // during which the inputs and results must be left alone...
+   bit Busy();
+
   void Resize(gui::Base * obj,gui::Event * event);
 
   void LoadImage(gui::Base * obj,gui::Event * event);
@@ -131,6 +194,8 @@ class SfS
   void LoadCalib(gui::Base * obj,gui::Event * event);
   void LoadInitialNeedle(gui::Base * obj,gui::Event * event);
   void Run(gui::Base * obj,gui::Event * event);
+  void Compute(const Paras & p,time::Progress * prog); // In the worker.
+  void Finish(bit cancelled); // Back in the gui thread.
   void SaveNeedle(gui::Base * obj,gui::Event * event);
   void SaveDistText(gui::Base * obj,gui::Event * event);
 
@@ -18,6 +18,22 @@
 
 #include "cyclops/stereopsis.h"
 
+//------------------------------------------------------------------------------
+// Runs a stereopsis in the worker thread...
+class StereopsisJob : public Job
+{
+ public:
+  StereopsisJob(Stereopsis & s,const Stereopsis::Paras & p):Job(&s),self(s),paras(p) {}
+
+  void Run(time::Progress * prog) {self.Compute(paras,prog);}
+  void Done(bit cancelled) {self.Finish(cancelled);}
+  cstrconst Name() const {return "Stereopsis";}
+
+ private:
+  Stereopsis & self;
+  Stereopsis::Paras paras;
+};
+
 //------------------------------------------------------------------------------
 Stereopsis::Stereopsis(Cyclops & cyc)
 :cyclops(cyc),win(null<gui::Window*>()),
@@ -97,6 +113,7 @@ result(null<svt::Var*>()),segmentation(null<svt::Var*>())
    whichAlg->Append("Hierarchical DP");
    whichAlg->Append("Hierarchical BP");
    whichAlg->Append("Diffusion Correlation");
+   whichAlg->Append("Semi-Global Matching");
    whichAlg->Set(2);
    horiz6->AttachRight(whichAlg,false);
 
@@ -349,6 +366,62 @@ result(null<svt::Var*>()),segmentation(null<svt::Var*>())
 
 
 
+   alg8 = static_cast<gui::Expander*>(cyclops.Fact().Make("Expander"));
+   vert1->AttachBottom(alg8,false);
+   alg8->Visible(false);
+   gui::Vertical * vert8 = static_cast<gui::Vertical*>(cyclops.Fact().Make("Vertical"));
+   alg8->SetChild(vert8);
+   alg8->Set("Semi-Global Matching Parameters");
+   alg8->Expand(false);
+
+   gui::Horizontal * horiz12a = static_cast<gui::Horizontal*>(cyclops.Fact().Make("Horizontal"));
+   gui::Horizontal * horiz12b = static_cast<gui::Horizontal*>(cyclops.Fact().Make("Horizontal"));
+   vert8->AttachBottom(horiz12a,false);
+   vert8->AttachBottom(horiz12b,false);
+
+   gui::Label * lab110 = static_cast<gui::Label*>(cyclops.Fact().Make("Label"));
+   gui::Label * lab111 = static_cast<gui::Label*>(cyclops.Fact().Make("Label"));
+   gui::Label * lab112 = static_cast<gui::Label*>(cyclops.Fact().Make("Label"));
+   gui::Label * lab113 = static_cast<gui::Label*>(cyclops.Fact().Make("Label"));
+   gui::Label * lab114 = static_cast<gui::Label*>(cyclops.Fact().Make("Label"));
+   gui::Label * lab115 = static_cast<gui::Label*>(cyclops.Fact().Make("Label"));
+
+   lab110->Set("    Small Step Cost:");
+   lab111->Set("Large Step Cost:");
+   lab112->Set("Match Diff Cap:");
+   lab113->Set("    Min Disparity:");
+   lab114->Set("Max Disparity:");
+   lab115->Set("Paths:");
+
+   sgmP1 = static_cast<gui::EditBox*>(cyclops.Fact().Make("EditBox"));
+   sgmP2 = static_cast<gui::EditBox*>(cyclops.Fact().Make("EditBox"));
+   sgmMatchLim = static_cast<gui::EditBox*>(cyclops.Fact().Make("EditBox"));
+   sgmMinDisp = static_cast<gui::EditBox*>(cyclops.Fact().Make("EditBox"));
+   sgmMaxDisp = static_cast<gui::EditBox*>(cyclops.Fact().Make("EditBox"));
+   sgmPaths = static_cast<gui::EditBox*>(cyclops.Fact().Make("EditBox"));
+
+   horiz12a->AttachRight(lab110,false);
+   horiz12a->AttachRight(sgmP1,false);
+   horiz12a->AttachRight(lab111,false);
+   horiz12a->AttachRight(sgmP2,false);
+   horiz12a->AttachRight(lab112,false);
+   horiz12a->AttachRight(sgmMatchLim,false);
+   horiz12b->AttachRight(lab113,false);
+   horiz12b->AttachRight(sgmMinDisp,false);
+   horiz12b->AttachRight(lab114,false);
+   horiz12b->AttachRight(sgmMaxDisp,false);
+   horiz12b->AttachRight(lab115,false);
+   horiz12b->AttachRight(sgmPaths,false);
+
+   sgmP1->Set("2.0"); sgmP1->SetSize(48,24);
+   sgmP2->Set("16.0"); sgmP2->SetSize(48,24);
+   sgmMatchLim->Set("36.0"); sgmMatchLim->SetSize(48,24);
+   sgmMinDisp->Set("-32"); sgmMinDisp->SetSize(48,24);
+   sgmMaxDisp->Set("32"); sgmMaxDisp->SetSize(48,24);
+   sgmPaths->Set("8"); sgmPaths->SetSize(48,24);
+
+
+
    post2 = static_cast<gui::Expander*>(cyclops.Fact().Make("Expander"));
    vert1->AttachBottom(post2,false);
    gui::Vertical * vert3 = static_cast<gui::Vertical*>(cyclops.Fact().Make("Vertical"));
@@ -808,6 +881,7 @@ result(null<svt::Var*>()),segmentation(null<svt::Var*>())
 
 Stereopsis::~Stereopsis()
 {
+ cyclops.Work().Abandon(this);
  delete win;
  delete leftVar;
  delete rightVar;
@@ -825,6 +899,13 @@ void Stereopsis::Quit(gui::Base * obj,gui::Event * event)
  delete this;
 }
 
+bit Stereopsis::Busy()
+{
+ if (cyclops.Work().Jobs(this)==0) return false;
+ cyclops.App().MessageDialog(gui::App::MsgErr,"Wait for stereopsis to finish, or cancel it.");
+ return true;
+}
+
 void Stereopsis::ResizeLeft(gui::Base * obj,gui::Event * event)
 {
  // Clear the canvas to a nice shade of grey...
@@ -855,6 +936,8 @@ void Stereopsis::ResizeRight(gui::Base * obj,gui::Event * event)
 
 void Stereopsis::LoadLeft(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  str::String fn;
  if (cyclops.App().LoadFileDialog("Select Left Image","*.bmp,*.jpg,*.png,*.tif",fn))
  {
@@ -916,6 +999,8 @@ void Stereopsis::LoadLeft(gui::Base * obj,gui::Event * event)
 
 void Stereopsis::LoadRight(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  str::String fn;
  if (cyclops.App().LoadFileDialog("Select Right Image","*.bmp,*.jpg,*.png,*.tif",fn))
  {
@@ -978,6 +1063,8 @@ void Stereopsis::LoadRight(gui::Base * obj,gui::Event * event)
 
 void Stereopsis::LoadCalibration(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  str::String fn;
  if (cyclops.App().LoadFileDialog("Load Camera Pair","*.pcc",fn))
  {
@@ -991,6 +1078,8 @@ void Stereopsis::LoadCalibration(gui::Base * obj,gui::Event * event)
 
 void Stereopsis::LoadSeg(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  str::String fn;
  if (cyclops.App().LoadFileDialog("Select Segmentation File","*.seg",fn))
  {
@@ -1031,6 +1120,8 @@ void Stereopsis::LoadSeg(gui::Base * obj,gui::Event * event)
 
 void Stereopsis::LoadExisting(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  str::String fn;
  if (cyclops.App().LoadFileDialog("Select Disparity","*.obf,*.dis",fn))
  {
@@ -1081,24 +1172,35 @@ void Stereopsis::ChangePost(gui::Base * obj,gui::Event * event)
    alg5->Visible(false);
    alg6->Visible(false);
    alg7->Visible(false);
+   alg8->Visible(false);
   break;
   case 1:
    but7->Visible(false);
    alg5->Visible(true);
    alg6->Visible(false);
    alg7->Visible(false);
+   alg8->Visible(false);
   break;
   case 2:
    but7->Visible(false);
    alg5->Visible(false);
    alg6->Visible(true);
    alg7->Visible(false);
+   alg8->Visible(false);
   break;
   case 3:
    but7->Visible(false);
    alg5->Visible(false);
    alg6->Visible(false);
    alg7->Visible(true);
+   alg8->Visible(false);
+  break;
+  case 4:
+   but7->Visible(false);
+   alg5->Visible(false);
+   alg6->Visible(false);
+   alg7->Visible(false);
+   alg8->Visible(true);
   break;
  }
 
@@ -1152,33 +1254,102 @@ void Stereopsis::SwitchFisher(gui::Base * obj,gui::Event * event)
 
 void Stereopsis::Run(gui::Base * obj,gui::Event * event)
 {
- if ((leftImg==null<svt::Var*>())||(rightImg==null<svt::Var*>()))
+ if (cyclops.Work().Jobs(this)!=0)
+ {
+  if (cyclops.App().ChoiceDialog(gui::App::QuestYesNo,"Stereopsis is still running, cancel it?"))
+  {
+   cyclops.Work().Cancel(this);
+  }
+ }
+ else if ((leftImg==null<svt::Var*>())||(rightImg==null<svt::Var*>()))
  {
   cyclops.App().MessageDialog(gui::App::MsgErr,"You are a slug.");
  }
  else
  {
-  // Create luv fields for both images, as needed...
-   if (!leftImg->Exists("luv"))
-   {
-    bs::ColourLuv luvIni(0.0,0.0,0.0);
-    leftImg->Add("luv",luvIni);
-    leftImg->Commit();
-    filter::RGBtoLuv(leftImg);
-   }
-
-   if (!rightImg->Exists("luv"))
-   {
-    bs::ColourLuv luvIni(0.0,0.0,0.0);
-    rightImg->Add("luv",luvIni);
-    rightImg->Commit();
-    filter::RGBtoLuv(rightImg);
-   }
+  // Take a copy of the parameters, as the worker can't touch the gui...
+   Paras p;
+   p.augGaussian = augGaussian->Ticked();
+   p.augFisher = augFisher->Ticked();
+   p.whichAlg = whichAlg->Get();
+   p.whichPost = whichPost->Get();
+   p.occCost = occCost->GetReal(1.0);
+   p.vertCost = vertCost->GetReal(0.0);
+   p.vertMult = vertMult->GetReal(0.33);
+   p.errLim = errLim->GetInt(1);
+   p.matchLim = matchLim->GetReal(10.0);
+   p.bpOccLim = bpOccLim->GetReal(6.0);
+   p.bpOccCostHigh = bpOccCostHigh->GetReal(16.0);
+   p.bpOccCostLow = bpOccCostLow->GetReal(8.0);
+   p.bpOccLimMult = bpOccLimMult->GetReal(2.0);
+   p.bpIters = bpIters->GetInt(6);
+   p.bpOutput = bpOutput->GetInt(1);
+   p.bpMatchLim = bpMatchLim->GetReal(36.0);
+   p.dcUseHalfX = dcUseHalfX->Ticked();
+   p.dcUseHalfY = dcUseHalfY->Ticked();
+   p.dcUseCorners = dcUseCorners->Ticked();
+   p.dcHalfHeight = dcHalfHeight->Ticked();
+   p.dcDistMult = dcDistMult->GetReal(0.1);
+   p.dcDiffSteps = dcDiffSteps->GetInt(5);
+   p.dcMinimaLimit = dcMinimaLimit->GetInt(8);
+   p.dcBaseDistCap = dcBaseDistCap->GetReal(4.0);
+   p.dcDistCapMult = dcDistCapMult->GetReal(2.0);
+   p.dcDistCapThreshold = dcDistCapThreshold->GetReal(0.5);
+   p.dcDispRange = dcDispRange->GetInt(2);
+   p.dcDoLR = dcDoLR->Ticked();
+   p.dcDistCapDifference = dcDistCapDifference->GetReal(0.25);
+   p.sgmMatchLim = sgmMatchLim->GetReal(36.0);
+   p.sgmMinDisp = sgmMinDisp->GetInt(-32);
+   p.sgmMaxDisp = sgmMaxDisp->GetInt(32);
+   p.sgmP1 = sgmP1->GetReal(2.0);
+   p.sgmP2 = sgmP2->GetReal(16.0);
+   p.sgmPaths = sgmPaths->GetInt(8);
+   p.gaussianRadius = gaussianRadius->GetInt(4);
+   p.gaussianFalloff = gaussianFalloff->GetReal(0.5);
+   p.altAugG = altAugG->Ticked();
+   p.agCostMult = agCostMult->GetReal(1.0);
+   p.agSd = agSd->GetReal(7.0);
+   p.agMin = agMin->GetReal(0.1);
+   p.agMax = agMax->GetReal(16.0);
+   p.agSdMult = agSdMult->GetReal(3.0);
+   p.gaussianMult = gaussianMult->GetReal(1.0);
+   p.gaussianRange = gaussianRange->GetInt(20);
+   p.gaussianSdMult = gaussianSdMult->GetReal(2.0);
+   p.gaussianMinK = gaussianMinK->GetReal(2.5);
+   p.gaussianMaxK = gaussianMaxK->GetReal(10.0);
+   p.gaussianMin = gaussianMin->GetReal(0.1);
+   p.gaussianMax = gaussianMax->GetReal(10.0);
+   p.gaussianIters = gaussianIters->GetInt(1000);
+   p.smoothStrength = smoothStrength->GetReal(16.0);
+   p.smoothCutoff = smoothCutoff->GetReal(16.0);
+   p.smoothWidth = smoothWidth->GetReal(2.0);
+   p.smoothIters = smoothIters->GetInt(256);
+   p.planeRadius = planeRadius->GetReal(0.6);
+   p.planeOcc = planeOcc->GetReal(0.078);
+   p.planeDisc = planeDisc->GetReal(0.01);
+   p.planeBailOut = planeBailOut->GetInt(12);
+   p.segSpatial = segSpatial->GetReal(7.0);
+   p.segRange = segRange->GetReal(4.5);
+   p.segMin = segMin->GetInt(20);
+   p.segRad = segRad->GetInt(2);
+   p.segMix = segMix->GetReal(0.3);
+   p.segEdge = segEdge->GetReal(0.9);
+   p.polyUseHalfX = polyUseHalfX->Ticked();
+   p.polyUseHalfY = polyUseHalfY->Ticked();
+   p.polyUseCorners = polyUseCorners->Ticked();
+   p.polyDistMult = polyDistMult->GetReal(0.01);
+   p.polyDiffSteps = polyDiffSteps->GetInt(7);
+   p.polyDistCap = polyDistCap->GetReal(64.0);
+   p.polyPrune = polyPrune->GetReal(0.25);
+   p.fisherMin = fisherMin->GetReal(0.0);
+   p.fisherMax = fisherMax->GetReal(16.0);
+   p.fisherProb = fisherProb->GetReal(0.1);
+   p.fisherMult = fisherMult->GetReal(1.0);
 
 
   // Create the result to extract into...
-   bit aGaussian = augGaussian->Ticked();
-   bit aFisher = augFisher->Ticked();
+   bit aGaussian = p.augGaussian;
+   bit aFisher = p.augFisher;
    if (aFisher) aGaussian = true; // Need Gaussian as input - might as well force it as storage is cheap.
   
    delete result;
@@ -1193,131 +1364,218 @@ void Stereopsis::Run(gui::Base * obj,gui::Event * event)
    if (aFisher) result->Add("fish",fishIni);
    result->Commit(false);
 
-   svt::Field<real32> disp(result,"disp");
-   svt::Field<bit> mask(result,"mask");
-   svt::Field<real32> sd(result,"sd");
-   svt::Field<math::Fisher> fish(result,"fish");
 
+  // Queue it...
+   cyclops.Work().Add(new StereopsisJob(*this,p));
+ }
+}
 
-  // Prep progress bar...
-   time::Progress * prog = cyclops.BeginProg();
-   nat32 step = 0;
-   nat32 steps = 0;
-   switch (whichAlg->Get())
-   {
-    case 0: break; // Existing
-    case 1: steps += 1; break; // Dynamic Programming
-    case 2: steps += 1; break; // Belief Propagation
-    case 3: steps += 1; break; // Diffusion Correlation
-   }
-   switch (whichPost->Get())
-   {
-    case 1: steps += 2; break; // Smoothing. (Has sd fitting step.)
-    case 2: steps += 1; break; // Plane fit + Seg
-    case 3: steps += 1; break; // Poly fitting
-   }
-   
-   if (aGaussian) steps += 1;
-   if (aFisher) steps += 1;
+void Stereopsis::Compute(const Paras & p,time::Progress * prog)
+{
+ // Create luv fields for both images, as needed...
+  if (!leftImg->Exists("luv"))
+  {
+   bs::ColourLuv luvIni(0.0,0.0,0.0);
+   leftImg->Add("luv",luvIni);
+   leftImg->Commit();
+   filter::RGBtoLuv(leftImg);
+  }
+
+  if (!rightImg->Exists("luv"))
+  {
+   bs::ColourLuv luvIni(0.0,0.0,0.0);
+   rightImg->Add("luv",luvIni);
+   rightImg->Commit();
+   filter::RGBtoLuv(rightImg);
+  }
+
+
+ // Get at the result, as created by Run...
+  bit aGaussian = p.augGaussian||p.augFisher;
+  bit aFisher = p.augFisher;
 
+  svt::Field<real32> disp(result,"disp");
+  svt::Field<bit> mask(result,"mask");
+  svt::Field<real32> sd(result,"sd");
+  svt::Field<math::Fisher> fish(result,"fish");
 
-  // Run the algorithm...
-   stereo::DSC * dsc = null<stereo::DSC*>();
-   stereo::DSI * dsi = null<stereo::DSI*>();
 
-   svt::Field<bs::ColourLuv> leftLuv(leftImg,"luv");
-   svt::Field<bs::ColourLuv> rightLuv(rightImg,"luv");
-   svt::Field<bit> leftMask(leftImg,"mask");
-   svt::Field<bit> rightMask(rightImg,"mask");
+ // Prep progress bar...
+  nat32 step = 0;
+  nat32 steps = 0;
+  switch (p.whichAlg)
+  {
+   case 0: break; // Existing
+   case 1: steps += 1; break; // Dynamic Programming
+   case 2: steps += 1; break; // Belief Propagation
+   case 3: steps += 1; break; // Diffusion Correlation
+   case 4: steps += 1; break; // Semi-Global Matching
+  }
+  switch (p.whichPost)
+  {
+   case 1: steps += 2; break; // Smoothing. (Has sd fitting step.)
+   case 2: steps += 1; break; // Plane fit + Seg
+   case 3: steps += 1; break; // Poly fitting
+  }
+  
+  if (aGaussian) steps += 1;
+  if (aFisher) steps += 1;
+
 
-   switch (whichAlg->Get())
+ // Run the algorithm...
+  stereo::DSC * dsc = null<stereo::DSC*>();
+  stereo::DSI * dsi = null<stereo::DSI*>();
+
+  svt::Field<bs::ColourLuv> leftLuv(leftImg,"luv");
+  svt::Field<bs::ColourLuv> rightLuv(rightImg,"luv");
+  svt::Field<bit> leftMask(leftImg,"mask");
+  svt::Field<bit> rightMask(rightImg,"mask");
+  
+  // Diffusion correlation and its refinement share weights when they can...
+   stereo::DiffusionCache leftDiffCache;
+   stereo::DiffusionCache rightDiffCache;
+
+  switch (p.whichAlg)
+  {
+   case 0: // Existing...
+   {     
+    // Create a dsi to expose the existing disparity map correctly...
+     svt::Field<real32> dispEx(existing,"disp");
+     svt::Field<bit> maskEx(existing,"mask");
+    
+     dsi = new stereo::DummyDSI(dispEx,&maskEx);
+   }
+   break;
+   case 1: // Hierachical DP...
    {
-    case 0: // Existing...
-    {     
-     // Create a dsi to expose the existing disparity map correctly...
-      svt::Field<real32> dispEx(existing,"disp");
-      svt::Field<bit> maskEx(existing,"mask");
-     
-      dsi = new stereo::DummyDSI(dispEx,&maskEx);
-    }
-    break;
-    case 1: // Hierachical DP...
-    {
-     prog->Report(step++,steps);
-     
-     stereo::SparseDSI2 * sdsi = new stereo::SparseDSI2();
-     dsi = sdsi;
+    prog->Report(step++,steps);
+    
+    stereo::SparseDSI2 * sdsi = new stereo::SparseDSI2();
+    dsi = sdsi;
 
-     sdsi->Set(occCost->GetReal(1.0),vertCost->GetReal(0.0),
-              vertMult->GetReal(0.33),errLim->GetInt(1));
-     dsc = new stereo::HalfBoundLuvDSC(leftLuv,rightLuv,1.0,matchLim->GetReal(10.0));
-     sdsi->Set(dsc);
-     sdsi->Set(leftMask,rightMask);
+    sdsi->Set(p.occCost,p.vertCost,
+             p.vertMult,p.errLim);
+    dsc = new stereo::HalfBoundLuvDSC(leftLuv,rightLuv,1.0,p.matchLim);
+    sdsi->Set(dsc);
+    sdsi->Set(leftMask,rightMask);
 
-     sdsi->Run(prog);
-    }
-    break;
-    case 2: // Hierachical BP...
-    {
-     prog->Report(step++,steps);
-     
-     stereo::HEBP * sdsi = new stereo::HEBP();
-     dsi = sdsi;
+    sdsi->Run(prog);
+   }
+   break;
+   case 2: // Hierachical BP...
+   {
+    prog->Report(step++,steps);
+    
+    stereo::HEBP * sdsi = new stereo::HEBP();
+    dsi = sdsi;
+
+    real32 costCap = p.bpOccLim;
+    real32 occCostBase = p.bpOccCostHigh;
+    real32 occCostMult = (p.bpOccCostLow-occCostBase) / costCap;
+
+    sdsi->Set(occCostBase,occCostMult,p.bpOccLimMult,p.bpIters,p.bpOutput);
+    dsc = new stereo::SqrBoundLuvDSC(leftLuv,rightLuv,1.0,p.bpMatchLim);
+    sdsi->Set(dsc);
+    stereo::LuvDSC dscOcc(leftLuv,rightLuv,1.0,costCap);
+    sdsi->SetOcc(&dscOcc);
+    sdsi->Set(leftMask,rightMask);
+    sdsi->SetParallel();
+
+    sdsi->Run(prog);
+   }
+   break;
+   case 3: // Diffusion correlation
+   {
+    prog->Report(step++,steps);
+    
+    stereo::DiffCorrStereo * dcs = new stereo::DiffCorrStereo();
+    dsi = dcs;
+    
+    dcs->SetImages(leftLuv,rightLuv);
+    dcs->SetMasks(leftMask,rightMask);
+    
+    bit useHalfX = p.dcUseHalfX;
+    bit useHalfY = p.dcUseHalfY;
+    bit useCorners = p.dcUseCorners;
+    bit halfHeight = p.dcHalfHeight;
+    real32 distMult = p.dcDistMult;
+    nat32 diffSteps = p.dcDiffSteps;
+    nat32 minimaLimit = p.dcMinimaLimit;
+    real32 baseDistCap = p.dcBaseDistCap;
+    real32 distCapMult = p.dcDistCapMult;
+    real32 distCapThreshold = p.dcDistCapThreshold;
+    nat32 dispRange = p.dcDispRange;
+    bit doLR = p.dcDoLR;
+    real32 distCapDifference = p.dcDistCapDifference;
+    
+    dcs->SetPyramid(useHalfX,useHalfY,useCorners,halfHeight);
+    dcs->SetDiff(distMult,diffSteps);
+    dcs->SetCorr(minimaLimit,baseDistCap,distCapMult,distCapThreshold,dispRange);
+    dcs->SetRefine(doLR,distCapDifference);
+    dcs->SetCache(&leftDiffCache,&rightDiffCache);
+    
+    dcs->Run(prog);
+   }
+   break;
+   case 4: // Semi-global matching...
+   {
+    prog->Report(step++,steps);
 
-     real32 costCap = bpOccLim->GetReal(6.0);
-     real32 occCostBase = bpOccCostHigh->GetReal(16.0);
-     real32 occCostMult = (bpOccCostLow->GetReal(8.0)-occCostBase) / costCap;
+    stereo::SGM * sgm = new stereo::SGM();
+    dsi = sgm;
 
-     sdsi->Set(occCostBase,occCostMult,bpOccLimMult->GetReal(2.0),bpIters->GetInt(6),bpOutput->GetInt(1));
-     dsc = new stereo::SqrBoundLuvDSC(leftLuv,rightLuv,1.0,bpMatchLim->GetReal(36.0));
-     sdsi->Set(dsc);
-     stereo::LuvDSC dscOcc(leftLuv,rightLuv,1.0,costCap);
-     sdsi->SetOcc(&dscOcc);
-     sdsi->Set(leftMask,rightMask);
+    real32 matchLim = p.sgmMatchLim;
+    sgm->SetRange(p.sgmMinDisp,p.sgmMaxDisp);
+    sgm->SetSmooth(p.sgmP1,p.sgmP2);
+    sgm->SetCost(matchLim);
+    sgm->SetPaths(p.sgmPaths);
+    dsc = new stereo::SqrBoundLuvDSC(leftLuv,rightLuv,1.0,matchLim);
+    sgm->Set(dsc);
+    sgm->Set(leftMask,rightMask);
 
-     sdsi->Run(prog);
-    }
-    break;
-    case 3: // Diffusion correlation
-    {
-     prog->Report(step++,steps);
-     
-     stereo::DiffCorrStereo * dcs = new stereo::DiffCorrStereo();
-     dsi = dcs;
-     
-     dcs->SetImages(leftLuv,rightLuv);
-     dcs->SetMasks(leftMask,rightMask);
-     
-     bit useHalfX = dcUseHalfX->Ticked();
-     bit useHalfY = dcUseHalfY->Ticked();
-     bit useCorners = dcUseCorners->Ticked();
-     bit halfHeight = dcHalfHeight->Ticked();
-     real32 distMult = dcDistMult->GetReal(0.1);
-     nat32 diffSteps = dcDiffSteps->GetInt(5);
-     nat32 minimaLimit = dcMinimaLimit->GetInt(8);
-     real32 baseDistCap = dcBaseDistCap->GetReal(4.0);
-     real32 distCapMult = dcDistCapMult->GetReal(2.0);
-     real32 distCapThreshold = dcDistCapThreshold->GetReal(0.5);
-     nat32 dispRange = dcDispRange->GetInt(2);
-     bit doLR = dcDoLR->Ticked();
-     real32 distCapDifference = dcDistCapDifference->GetReal(0.25);
-     
-     dcs->SetPyramid(useHalfX,useHalfY,useCorners,halfHeight);
-     dcs->SetDiff(distMult,diffSteps);
-     dcs->SetCorr(minimaLimit,baseDistCap,distCapMult,distCapThreshold,dispRange);
-     dcs->SetRefine(doLR,distCapDifference);
-     
-     dcs->Run(prog);
-    }
-    break;
+    sgm->Run(prog);
    }
+   break;
+  }
 
 
-  // Run the post-proccessor...
-   switch (whichPost->Get())
+ // Run the post-proccessor...
+  switch (p.whichPost)
+  {
+   case 0: // None - simply select the best...
    {
-    case 0: // None - simply select the best...
+    for (nat32 y=0;y<disp.Size(1);y++)
     {
+     for (nat32 x=0;x<disp.Size(0);x++)
+     {
+      if (dsi->Size(x,y)!=0)
+      {
+       real32 bestCost = dsi->Cost(x,y,0);
+       disp.Get(x,y) = dsi->Disp(x,y,0);
+       for (nat32 i=1;i<dsi->Size(x,y);i++)
+       {
+        if (dsi->Cost(x,y,i)<bestCost)
+        {
+         bestCost = dsi->Cost(x,y,i);
+         disp.Get(x,y) = dsi->Disp(x,y,i);
+        }
+       }
+       mask.Get(x,y) = true;
+      }
+      else
+      {
+       disp.Get(x,y) = 0.0;
+       mask.Get(x,y) = false;
+      }
+     }
+    }
+   }
+   break;
+   case 1: // Smoothing...
+   {
+    prog->Report(step++,steps);
+    
+    // Extract a disparity map...
      for (nat32 y=0;y<disp.Size(1);y++)
      {
       for (nat32 x=0;x<disp.Size(0);x++)
@@ -1343,347 +1601,328 @@ void Stereopsis::Run(gui::Base * obj,gui::Event * event)
        }
       }
      }
-    }
-    break;
-    case 1: // Smoothing...
-    {
-     prog->Report(step++,steps);
-     
-     // Extract a disparity map...
-      for (nat32 y=0;y<disp.Size(1);y++)
-      {
-       for (nat32 x=0;x<disp.Size(0);x++)
-       {
-        if (dsi->Size(x,y)!=0)
-        {
-         real32 bestCost = dsi->Cost(x,y,0);
-         disp.Get(x,y) = dsi->Disp(x,y,0);
-         for (nat32 i=1;i<dsi->Size(x,y);i++)
-         {
-          if (dsi->Cost(x,y,i)<bestCost)
-          {
-           bestCost = dsi->Cost(x,y,i);
-           disp.Get(x,y) = dsi->Disp(x,y,i);
-          }
-         }
-         mask.Get(x,y) = true;
-        }
-        else
-        {
-         disp.Get(x,y) = 0.0;
-         mask.Get(x,y) = false;
-        }
-       }
-      }
 
-     // Create tempory standard deviation storage...
-      svt::Var sdTemp(leftLuv);
-      {
-       real32 realIni = 0.0;
-       sdTemp.Add("sd",realIni);
-       sdTemp.Commit();
-      }
-      svt::Field<real32> sdOR(&sdTemp,"sd");
+    // Create tempory standard deviation storage...
+     svt::Var sdTemp(leftLuv);
+     {
+      real32 realIni = 0.0;
+      sdTemp.Add("sd",realIni);
+      sdTemp.Commit();
+     }
+     svt::Field<real32> sdOR(&sdTemp,"sd");
 
 
-     // Calculate standard deviations for the disparity values...
-      stereo::LuvDSC luvDSC(leftLuv,rightLuv);
-      stereo::RegionDSC regionDSC(&luvDSC,gaussianRadius->GetInt(4),gaussianFalloff->GetReal(0.5));
-      
-      if (altAugG->Ticked())
-      {
-       fit::LaplaceDispNorm laplaceDispNorm;
-       laplaceDispNorm.Set(disp,regionDSC, agCostMult->GetReal(1.0));
-       laplaceDispNorm.SetMask(leftMask);
-       laplaceDispNorm.SetParam(agSd->GetReal(7.0), agMin->GetReal(0.1), agMax->GetReal(16.0), agSdMult->GetReal(3.0));
+    // Calculate standard deviations for the disparity values...
+     stereo::LuvDSC luvDSC(leftLuv,rightLuv);
+     stereo::RegionDSC regionDSC(&luvDSC,p.gaussianRadius,p.gaussianFalloff);
      
-       laplaceDispNorm.Run(prog);
+     if (p.altAugG)
+     {
+      fit::LaplaceDispNorm laplaceDispNorm;
+      laplaceDispNorm.Set(disp,regionDSC, p.agCostMult);
+      laplaceDispNorm.SetMask(leftMask);
+      laplaceDispNorm.SetParam(p.agSd, p.agMin, p.agMax, p.agSdMult);
     
-       laplaceDispNorm.Get(sdOR);      
-      }
-      else
-      {
-       fit::DispNorm dispNorm;
-       dispNorm.Set(disp,regionDSC,gaussianMult->GetReal(1.0));
-       dispNorm.SetMask(leftMask);
-       dispNorm.SetRange(gaussianRange->GetInt(20),gaussianSdMult->GetReal(2.0));
-       dispNorm.SetClampK(gaussianMinK->GetReal(2.5),gaussianMaxK->GetReal(10.0));
-       dispNorm.SetClamp(gaussianMin->GetReal(0.1),gaussianMax->GetReal(10.0));
-       dispNorm.SetMaxIters(gaussianIters->GetInt(1000));
-     
-       dispNorm.Run(prog);
+      laplaceDispNorm.Run(prog);
+   
+      laplaceDispNorm.Get(sdOR);      
+     }
+     else
+     {
+      fit::DispNorm dispNorm;
+      dispNorm.Set(disp,regionDSC,p.gaussianMult);
+      dispNorm.SetMask(leftMask);
+      dispNorm.SetRange(p.gaussianRange,p.gaussianSdMult);
+      dispNorm.SetClampK(p.gaussianMinK,p.gaussianMaxK);
+      dispNorm.SetClamp(p.gaussianMin,p.gaussianMax);
+      dispNorm.SetMaxIters(p.gaussianIters);
     
-       dispNorm.Get(sdOR);
-      }
+      dispNorm.Run(prog);
+   
+      dispNorm.Get(sdOR);
+     }
 
 
-     // Smooth it...
-      prog->Report(step++,steps);
-      stereo::CleanDSI cdsi;
-      cdsi.Set(leftLuv);
-      cdsi.Set(*dsi);
-      cdsi.SetMask(leftMask);
-      cdsi.SetSD(sdOR);
-      cdsi.Set(smoothStrength->GetReal(16.0),smoothCutoff->GetReal(16.0),
-               smoothWidth->GetReal(2.0),smoothIters->GetInt(256));
+    // Smooth it...
+     prog->Report(step++,steps);
+     stereo::CleanDSI cdsi;
+     cdsi.Set(leftLuv);
+     cdsi.Set(*dsi);
+     cdsi.SetMask(leftMask);
+     cdsi.SetSD(sdOR);
+     cdsi.Set(p.smoothStrength,p.smoothCutoff,
+              p.smoothWidth,p.smoothIters);
 
-      cdsi.Run(prog);
+     cdsi.Run(prog);
 
-      cdsi.GetMap(disp);
-     
-      for (nat32 y=0;y<disp.Size(1);y++)
+     cdsi.GetMap(disp);
+    
+     for (nat32 y=0;y<disp.Size(1);y++)
+     {
+      for (nat32 x=0;x<disp.Size(0);x++)
       {
-       for (nat32 x=0;x<disp.Size(0);x++)
-       {
-        mask.Get(x,y) = math::IsFinite(disp.Get(x,y))&&leftMask.Get(x,y);
-       }
+       mask.Get(x,y) = math::IsFinite(disp.Get(x,y))&&leftMask.Get(x,y);
       }
-    }
-    break;
-    case 2: // Plane fitting...
-    {
-     prog->Report(step++,steps);
-     // First fill in the disparity map and mask from the result, so we can pass
-     // them to the Bleyer04 algorithm as overrides...
-      for (nat32 y=0;y<disp.Size(1);y++)
+     }
+   }
+   break;
+   case 2: // Plane fitting...
+   {
+    prog->Report(step++,steps);
+    // First fill in the disparity map and mask from the result, so we can pass
+    // them to the Bleyer04 algorithm as overrides...
+     for (nat32 y=0;y<disp.Size(1);y++)
+     {
+      for (nat32 x=0;x<disp.Size(0);x++)
       {
-       for (nat32 x=0;x<disp.Size(0);x++)
+       if (dsi->Size(x,y)!=0)
        {
-        if (dsi->Size(x,y)!=0)
+        real32 bestCost = dsi->Cost(x,y,0);
+        disp.Get(x,y) = dsi->Disp(x,y,0);
+        for (nat32 i=1;i<dsi->Size(x,y);i++)
         {
-         real32 bestCost = dsi->Cost(x,y,0);
-         disp.Get(x,y) = dsi->Disp(x,y,0);
-         for (nat32 i=1;i<dsi->Size(x,y);i++)
+         if (dsi->Cost(x,y,i)<bestCost)
          {
-          if (dsi->Cost(x,y,i)<bestCost)
-          {
-           bestCost = dsi->Cost(x,y,i);
-           disp.Get(x,y) = dsi->Disp(x,y,i);
-          }
+          bestCost = dsi->Cost(x,y,i);
+          disp.Get(x,y) = dsi->Disp(x,y,i);
          }
-         mask.Get(x,y) = true;
-        }
-        else
-        {
-         disp.Get(x,y) = 0.0;
-         mask.Get(x,y) = false;
         }
+        mask.Get(x,y) = true;
+       }
+       else
+       {
+        disp.Get(x,y) = 0.0;
+        mask.Get(x,y) = false;
        }
       }
+     }
 
-     // Create the Bleyers04 object, set parameters...
-      svt::Field<bs::ColourRGB> leftRGB(leftImg,"rgb");
-      svt::Field<bs::ColourRGB> rightRGB(rightImg,"rgb");
-
-      stereo::Bleyer04 bleyer;
-      bleyer.SetImages(leftRGB,rightRGB);
-      bleyer.BootOverride(disp,mask);
-      bleyer.SetMasks(leftMask,rightMask);
-      bleyer.SetPlaneRadius(planeRadius->GetReal(0.6));
-      bleyer.SetWarpCost(planeOcc->GetReal(0.078),planeDisc->GetReal(0.01));
-      bleyer.SetBailOut(planeBailOut->GetInt(12));
-      bleyer.SetSegment(segSpatial->GetReal(7.0),segRange->GetReal(4.5),segMin->GetInt(20));
-      bleyer.SetSegmentExtra(segRad->GetInt(2),segMix->GetReal(0.3),segEdge->GetReal(0.9));
-      
-      if ((segmentation!=null<svt::Var*>())&&
-          (segmentation->Size(0)==leftImg->Size(0))&&
-          (segmentation->Size(0)==leftImg->Size(1)))
-      {
-       svt::Field<nat32> segs(segmentation,"seg");
-       bleyer.SegmentOverride(segs);
-      }
+    // Create the Bleyers04 object, set parameters...
+     svt::Field<bs::ColourRGB> leftRGB(leftImg,"rgb");
+     svt::Field<bs::ColourRGB> rightRGB(rightImg,"rgb");
+
+     stereo::Bleyer04 bleyer;
+     bleyer.SetImages(leftRGB,rightRGB);
+     bleyer.BootOverride(disp,mask);
+     bleyer.SetMasks(leftMask,rightMask);
+     bleyer.SetPlaneRadius(p.planeRadius);
+     bleyer.SetWarpCost(p.planeOcc,p.planeDisc);
+     bleyer.SetBailOut(p.planeBailOut);
+     bleyer.SetSegment(p.segSpatial,p.segRange,p.segMin);
+     bleyer.SetSegmentExtra(p.segRad,p.segMix,p.segEdge);
+     
+     if ((segmentation!=null<svt::Var*>())&&
+         (segmentation->Size(0)==leftImg->Size(0))&&
+         (segmentation->Size(0)==leftImg->Size(1)))
+     {
+      svt::Field<nat32> segs(segmentation,"seg");
+      bleyer.SegmentOverride(segs);
+     }
 
-     // Run...
-      bleyer.Run(prog);
+    // Run...
+     bleyer.Run(prog);
 
-     // Extract the results...
-      bleyer.GetDisparity(disp);
-      mask.CopyFrom(leftMask);
-    }
-    break;
-    case 3: // Polynomial fitting...
-    {
-     prog->Report(step++,steps);
+    // Extract the results...
+     bleyer.GetDisparity(disp);
+     mask.CopyFrom(leftMask);
+   }
+   break;
+   case 3: // Polynomial fitting...
+   {
+    prog->Report(step++,steps);
 
-     // First run the selection of best code, but drop any where there is more than 1 match...
-      for (nat32 y=0;y<disp.Size(1);y++)
+    // First run the selection of best code, but drop any where there is more than 1 match...
+     for (nat32 y=0;y<disp.Size(1);y++)
+     {
+      for (nat32 x=0;x<disp.Size(0);x++)
       {
-       for (nat32 x=0;x<disp.Size(0);x++)
+       if (dsi->Size(x,y)==1)
        {
-        if (dsi->Size(x,y)==1)
+        real32 bestCost = dsi->Cost(x,y,0);
+        disp.Get(x,y) = dsi->Disp(x,y,0);
+        for (nat32 i=1;i<dsi->Size(x,y);i++)
         {
-         real32 bestCost = dsi->Cost(x,y,0);
-         disp.Get(x,y) = dsi->Disp(x,y,0);
-         for (nat32 i=1;i<dsi->Size(x,y);i++)
+         if (dsi->Cost(x,y,i)<bestCost)
          {
-          if (dsi->Cost(x,y,i)<bestCost)
-          {
-           bestCost = dsi->Cost(x,y,i);
-           disp.Get(x,y) = dsi->Disp(x,y,i);
-          }
+          bestCost = dsi->Cost(x,y,i);
+          disp.Get(x,y) = dsi->Disp(x,y,i);
          }
-         mask.Get(x,y) = true;
-        }
-        else
-        {
-         disp.Get(x,y) = 0.0;
-         mask.Get(x,y) = false;
         }
+        mask.Get(x,y) = true;
+       }
+       else
+       {
+        disp.Get(x,y) = 0.0;
+        mask.Get(x,y) = false;
        }
       }
-      
-     // Now do the refinement...
-      bit useHalfX = polyUseHalfX->Ticked();
-      bit useHalfY = polyUseHalfY->Ticked();
-      bit useCorners = polyUseCorners->Ticked();
-      real32 distMult = polyDistMult->GetReal(0.01);
-      nat32 diffSteps = polyDiffSteps->GetInt(7);
-      real32 distCap = polyDistCap->GetReal(64.0);
-      real32 prune = polyPrune->GetReal(0.25);
-  
-      stereo::DiffCorrRefine dcr;
-      dcr.SetImages(leftLuv,rightLuv);
-      dcr.SetMasks(leftMask,rightMask);
-      dcr.SetDisparity(disp);
-      dcr.SetDisparityMask(mask);
-      dcr.SetFlags(useHalfX,useHalfY,useCorners);
-      dcr.SetDiff(distMult,diffSteps);
-      dcr.SetDist(distCap,prune);
-      
-      dcr.Run(prog);
-      
-      dcr.GetDisp(disp);
-      dcr.GetMask(mask);
-    }
-    break;
+     }
+     
+    // Now do the refinement...
+     bit useHalfX = p.polyUseHalfX;
+     bit useHalfY = p.polyUseHalfY;
+     bit useCorners = p.polyUseCorners;
+     real32 distMult = p.polyDistMult;
+     nat32 diffSteps = p.polyDiffSteps;
+     real32 distCap = p.polyDistCap;
+     real32 prune = p.polyPrune;
+ 
+     stereo::DiffCorrRefine dcr;
+     dcr.SetImages(leftLuv,rightLuv);
+     dcr.SetMasks(leftMask,rightMask);
+     dcr.SetDisparity(disp);
+     dcr.SetDisparityMask(mask);
+     dcr.SetFlags(useHalfX,useHalfY,useCorners);
+     dcr.SetDiff(distMult,diffSteps);
+     dcr.SetDist(distCap,prune);
+     dcr.SetCache(&leftDiffCache,&rightDiffCache);
+     
+     dcr.Run(prog);
+     
+     dcr.GetDisp(disp);
+     dcr.GetMask(mask);
    }
+   break;
+  }
+  
+  
+ // If needed augment with standard deviations...
+  if (aGaussian)
+  {
+   prog->Report(step++,steps);
    
+   stereo::LuvDSC luvDSC(leftLuv,rightLuv);
+   stereo::RegionDSC regionDSC(&luvDSC,p.gaussianRadius,p.gaussianFalloff);
+   //stereo::LuvRegionDSC regionDSC(leftLuv,rightLuv,&luvDSC,p.gaussianRadius,0.1,p.gaussianFalloff);
    
-  // If needed augment with standard deviations...
-   if (aGaussian)
+   if (p.altAugG)
    {
-    prog->Report(step++,steps);
+    fit::LaplaceDispNorm laplaceDispNorm;
+    laplaceDispNorm.Set(disp,regionDSC, p.agCostMult);
+    laplaceDispNorm.SetMask(leftMask);
+    laplaceDispNorm.SetParam(p.agSd, p.agMin, p.agMax, p.agSdMult);
     
-    stereo::LuvDSC luvDSC(leftLuv,rightLuv);
-    stereo::RegionDSC regionDSC(&luvDSC,gaussianRadius->GetInt(4),gaussianFalloff->GetReal(0.5));
-    //stereo::LuvRegionDSC regionDSC(leftLuv,rightLuv,&luvDSC,gaussianRadius->GetInt(4),0.1,gaussianFalloff->GetReal(0.5));
-    
-    if (altAugG->Ticked())
-    {
-     fit::LaplaceDispNorm laplaceDispNorm;
-     laplaceDispNorm.Set(disp,regionDSC, agCostMult->GetReal(1.0));
-     laplaceDispNorm.SetMask(leftMask);
-     laplaceDispNorm.SetParam(agSd->GetReal(7.0), agMin->GetReal(0.1), agMax->GetReal(16.0), agSdMult->GetReal(3.0));
-     
-     laplaceDispNorm.Run(prog);
-    
-     laplaceDispNorm.Get(sd);      
-    }
-    else
-    {
-     fit::DispNorm dispNorm;
-     dispNorm.Set(disp,regionDSC,gaussianMult->GetReal(1.0));
-     dispNorm.SetMask(mask);
-     dispNorm.SetRange(gaussianRange->GetInt(20),gaussianSdMult->GetReal(2.0));
-     dispNorm.SetClampK(gaussianMinK->GetReal(2.5),gaussianMaxK->GetReal(10.0));
-     dispNorm.SetClamp(gaussianMin->GetReal(0.1),gaussianMax->GetReal(10.0));
-     dispNorm.SetMaxIters(gaussianIters->GetInt(1000));
-    
-     dispNorm.Run(prog);
-    
-     dispNorm.Get(sd);
-    }
+    laplaceDispNorm.Run(prog);
+   
+    laplaceDispNorm.Get(sd);      
    }
-  
-
-  // If needed augment with Fisher distributions...
-   if (aFisher)
+   else
    {
-    prog->Report(step++,steps);
-    
-    /*stereo::LuvDSC luvDSC(leftLuv,rightLuv);
-    
-    fit::DispFish dispFish;
-    dispFish.Set(disp,luvDSC);
-    dispFish.SetMask(mask);
-    dispFish.SetPair(pair);
-    dispFish.SetRange(fisherRange->GetInt(4));
-    dispFish.SetBias(fisherBias->GetReal(0.0));
-    dispFish.SetClamp(fisherMin->GetReal(0.0),fisherMax->GetReal(16.0));
+    fit::DispNorm dispNorm;
+    dispNorm.Set(disp,regionDSC,p.gaussianMult);
+    dispNorm.SetMask(mask);
+    dispNorm.SetRange(p.gaussianRange,p.gaussianSdMult);
+    dispNorm.SetClampK(p.gaussianMinK,p.gaussianMaxK);
+    dispNorm.SetClamp(p.gaussianMin,p.gaussianMax);
+    dispNorm.SetMaxIters(p.gaussianIters);
    
-    dispFish.Run(prog);
-    
-    dispFish.Get(fish);*/
-    
-    fit::DispNormFish dnf;
-    dnf.Set(disp,sd);
-    dnf.SetMask(mask);
-    dnf.SetPair(pair);
-    dnf.SetRegion(fisherProb->GetReal(0.1),fisherMult->GetReal(1.0));
-    dnf.SetRange(fisherMin->GetReal(0.0),fisherMax->GetReal(16.0));
-    
-    dnf.Run(prog);
-    
-    dnf.Get(fish);
+    dispNorm.Run(prog);
+   
+    dispNorm.Get(sd);
    }
+  }
+ 
 
+ // If needed augment with Fisher distributions...
+  if (aFisher)
+  {
+   prog->Report(step++,steps);
+   
+   /*stereo::LuvDSC luvDSC(leftLuv,rightLuv);
+   
+   fit::DispFish dispFish;
+   dispFish.Set(disp,luvDSC);
+   dispFish.SetMask(mask);
+   dispFish.SetPair(pair);
+   dispFish.SetRange(fisherRange->GetInt(4));
+   dispFish.SetBias(fisherBias->GetReal(0.0));
+   dispFish.SetClamp(p.fisherMin,p.fisherMax);
+  
+   dispFish.Run(prog);
+   
+   dispFish.Get(fish);*/
+   
+   fit::DispNormFish dnf;
+   dnf.Set(disp,sd);
+   dnf.SetMask(mask);
+   dnf.SetPair(pair);
+   dnf.SetRegion(p.fisherProb,p.fisherMult);
+   dnf.SetRange(p.fisherMin,p.fisherMax);
+   
+   dnf.Run(prog);
+   
+   dnf.Get(fish);
+  }
 
-  // Clean up...
-   delete dsc;
-   delete dsi;
-   cyclops.EndProg();
 
+ // Clean up...
+  delete dsc;
+  delete dsi;
+}
+
+void Stereopsis::Finish(bit cancelled)
+{
+ if (cancelled)
+ {
+  delete result;
+  result = null<svt::Var*>();
+  return;
+ }
+
+ svt::Field<real32> disp(result,"disp");
+ svt::Field<bit> mask(result,"mask");
 
-  // Update the visualisation of the left image, so as to represent the disparity map...
-   real32 minDisp = 0.0;
-   real32 maxDisp = 0.0;
-   for (nat32 y=0;y<disp.Size(1);y++)
+ // Update the visualisation of the left image, so as to represent the disparity map...
+  real32 minDisp = 0.0;
+  real32 maxDisp = 0.0;
+  for (nat32 y=0;y<disp.Size(1);y++)
+  {
+   for (nat32 x=0;x<disp.Size(0);x++)
    {
-    for (nat32 x=0;x<disp.Size(0);x++)
+    if (mask.Get(x,y))
     {
-     if (mask.Get(x,y))
-     {
-      minDisp = math::Min(minDisp,disp.Get(x,y));
-      maxDisp = math::Max(maxDisp,disp.Get(x,y));
-     }
+     minDisp = math::Min(minDisp,disp.Get(x,y));
+     maxDisp = math::Max(maxDisp,disp.Get(x,y));
     }
    }
+  }
 
-   for (nat32 y=0;y<leftImage.Size(1);y++)
+  for (nat32 y=0;y<leftImage.Size(1);y++)
+  {
+   for (nat32 x=0;x<leftImage.Size(0);x++)
    {
-    for (nat32 x=0;x<leftImage.Size(0);x++)
+    bs::ColRGB & targ = leftImage.Get(x,y);
+    if (mask.Get(x,y))
     {
-     bs::ColRGB & targ = leftImage.Get(x,y);
-     if (mask.Get(x,y))
+     real32 rxc = real32(x) + disp.Get(x,y);
+     targ.r = byte(math::Clamp<real32>(255.0*(disp.Get(x,y)-minDisp)/(maxDisp-minDisp),0,255));
+     if ((rxc>=0.0)&&(rxc<rightImage.Size(0)))
      {
-      real32 rxc = real32(x) + disp.Get(x,y);
-      targ.r = byte(math::Clamp<real32>(255.0*(disp.Get(x,y)-minDisp)/(maxDisp-minDisp),0,255));
-      if ((rxc>=0.0)&&(rxc<rightImage.Size(0)))
-      {
-       targ.g = targ.r;
-       targ.b = targ.r;
-      }
-      else
-      {
-       targ.g = 127;
-       targ.b = 0;
-      }
+      targ.g = targ.r;
+      targ.b = targ.r;
      }
      else
      {
-      targ.r = 0;
-      targ.g = 0;
-      targ.b = 255;
+      targ.g = 127;
+      targ.b = 0;
      }
     }
+    else
+    {
+     targ.r = 0;
+     targ.g = 0;
+     targ.b = 255;
+    }
    }
+  }
 
-   left->Redraw();
- }
+ left->Redraw();
 }
 
 void Stereopsis::SaveSVT(gui::Base * obj,gui::Event * event)
 {
+ if (Busy()) return;
+
  if (result)
  {
   // Get the filename...
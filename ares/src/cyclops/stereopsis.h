@@ -19,11 +19,13 @@
 
 
 #include "cyclops/main.h"
+#include "cyclops/worker.h"
 
 //------------------------------------------------------------------------------
 // Allows a user to apply various stereo algorithms to an image pair.
 class Stereopsis
 {
+ friend class StereopsisJob;
  public:
    Stereopsis(Cyclops & cyc);
   ~Stereopsis();
@@ -48,6 +50,7 @@ class Stereopsis
   gui::Expander * alg5;
   gui::Expander * alg6;
   gui::Expander * alg7;
+  gui::Expander * alg8;
   gui::Expander * post2;
   gui::Expander * post3a;
   gui::Expander * post3b;
@@ -84,6 +87,13 @@ class Stereopsis
   gui::TickBox * dcDoLR;
   gui::EditBox * dcDistCapDifference;
 
+  gui::EditBox * sgmP1;
+  gui::EditBox * sgmP2;
+  gui::EditBox * sgmMatchLim;
+  gui::EditBox * sgmMinDisp;
+  gui::EditBox * sgmMaxDisp;
+  gui::EditBox * sgmPaths;
+
   gui::EditBox * smoothStrength;
   gui::EditBox * smoothCutoff;
   gui::EditBox * smoothWidth;
@@ -147,8 +157,93 @@ class Stereopsis
   
   svt::Var * segmentation;
 
+  // The parameters of Run, copied from the gui for the worker...
+   struct Paras
+   {
+     bit augGaussian;
+     bit augFisher;
+     nat32 whichAlg;
+     nat32 whichPost;
+     real32 occCost;
+     real32 vertCost;
+     real32 vertMult;
+     int32 errLim;
+     real32 matchLim;
+     real32 bpOccLim;
+     real32 bpOccCostHigh;
+     real32 bpOccCostLow;
+     real32 bpOccLimMult;
+     int32 bpIters;
+     int32 bpOutput;
+     real32 bpMatchLim;
+     bit dcUseHalfX;
+     bit dcUseHalfY;
+     bit dcUseCorners;
+     bit dcHalfHeight;
+     real32 dcDistMult;
+     int32 dcDiffSteps;
+     int32 dcMinimaLimit;
+     real32 dcBaseDistCap;
+     real32 dcDistCapMult;
+     real32 dcDistCapThreshold;
+     int32 dcDispRange;
+     bit dcDoLR;
+     real32 dcDistCapDifference;
+     real32 sgmMatchLim;
+     int32 sgmMinDisp;
+     int32 sgmMaxDisp;
+     real32 sgmP1;
+     real32 sgmP2;
+     int32 sgmPaths;
+     int32 gaussianRadius;
+     real32 gaussianFalloff;
+     bit altAugG;
+     real32 agCostMult;
+     real32 agSd;
+     real32 agMin;
+     real32 agMax;
+     real32 agSdMult;
+     real32 gaussianMult;
+     int32 gaussianRange;
+     real32 gaussianSdMult;
+     real32 gaussianMinK;
+     real32 gaussianMaxK;
+     real32 gaussianMin;
+     real32 gaussianMax;
+     int32 gaussianIters;
+     real32 smoothStrength;
+     real32 smoothCutoff;
+     real32 smoothWidth;
+     int32 smoothIters;
+     real32 planeRadius;
+     real32 planeOcc;
+     real32 planeDisc;
+     int32 planeBailOut;
+     real32 segSpatial;
+     real32 segRange;
+     int32 segMin;
+     int32 segRad;
+     real32 segMix;
+     real32 segEdge;
+     bit polyUseHalfX;
+     bit polyUseHalfY;
+     bit polyUseCorners;
+     real32 polyDistMult;
+     int32 polyDiffSteps;
+     real32 polyDistCap;
+     real32 polyPrune;
+     real32 fisherMin;
+     real32 fisherMax;
+     real32 fisherProb;
+     real32 fisherMult;
+   };
+
   void Quit(gui::Base * obj,gui::Event * event);
 
+  // Returns true, after telling the user, if a run is queued or in progress,
+  // during which the images and result must be left alone...
+   bit Busy();
+
   void ResizeLeft(gui::Base * obj,gui::Event * event);
   void ResizeRight(gui::Base * obj,gui::Event * event);
 
@@ -166,6 +261,8 @@ class Stereopsis
   void SwitchFisher(gui::Base * obj,gui::Event * event);
 
   void Run(gui::Base * obj,gui::Event * event);
+  void Compute(const Paras & p,time::Progress * prog); // In the worker.
+  void Finish(bit cancelled); // Back in the gui thread.
 
   void SaveSVT(gui::Base * obj,gui::Event * event);
 };
@@ -359,142 +359,63 @@ void ToMesh::SaveModel(gui::Base * obj,gui::Event * event)
 
 
    
-   // Create a mesh, with uv coordinates...
-    str::TokenTable tokTab;
-    sur::Mesh mesh(&tokTab);
-    
-    real32 realIni = 0.0;
-    mesh.AddVertProp("u",realIni);
-    mesh.AddVertProp("v",realIni);
-    mesh.Commit();
-    
-    data::Property<sur::Vertex,real32> propU = mesh.GetVertProp<real32>("u");
-    data::Property<sur::Vertex,real32> propV = mesh.GetVertProp<real32>("v");
-    
-    
-   // Create the vertices...
-    prog->Report(0,3);
-    
+   // Check the stride...
     nat32 width = disp.Size(0)/stride;
     nat32 height = disp.Size(1)/stride;
-
     if ((width==0)||(height==0))
     {
      cyclops.App().MessageDialog(gui::App::MsgErr,"Stride is too high");
+     cyclops.EndProg();
      return;
-    }    
+    }
     
-    ds::Array2D<sur::Vertex> hand(width,height); // Won't all be valid.
-
+   // Convert the entire disparity map to positions in one go...
+    prog->Report(0,3);
+    cam::DispConvPlane dc;
+    dc.Set(pair,nat32(pair.leftDim[0]),nat32(pair.leftDim[1]),nat32(pair.rightDim[0]),nat32(pair.rightDim[1]));
+    bs::Vert vertIni(0.0,0.0,0.0);
+    bit validIni = false;
+    svt::Var temp(disp);
+     temp.Add("pos",vertIni);
+     temp.Add("valid",validIni);
+    temp.Commit(false);
+    svt::Field<bs::Vert> pos(&temp,"pos");
+    svt::Field<bit> valid(&temp,"valid");
+    dc.Convert(disp,pos,valid);
+    
+   // Fold the mask and the sanity checks on position into the validity of 
+   // the sampled points...
     prog->Push();
     for (nat32 y=0;y<height;y++)
     {
      prog->Report(y,height);
      for (nat32 x=0;x<width;x++)
      {
-      if (dispMask.Get(x,y))
-      {
-       // First get the points...
-        math::Vect<3,real64> li;
-        li[0] = x*stride; li[1] = y*stride; li[2] = 1.0;
-
-        math::Vect<3,real64> ri;
-        ri = li;
-        ri[0] += disp.Get(x*stride,y*stride);
-
-       // Scale for image size...
-        real64 scaleX = pair.leftDim[0]/real64(disp.Size(0));
-        real64 scaleY = pair.leftDim[1]/real64(disp.Size(1));
-        li[0] *= scaleX; li[1] *= scaleY;
-        ri[0] *= scaleX; ri[1] *= scaleY;
-
-       // Unrectify them...
-        math::Vect<3,real64> lp;
-        math::Vect<3,real64> rp;
-        math::MultVect(pair.unRectLeft,li,lp);
-        math::MultVect(pair.unRectRight,ri,rp);
-
-       // Convert from homogenous...
-        math::Vect<2,real64> lf;
-         lf[0] = lp[0]/lp[2];
-         lf[1] = lp[1]/lp[2];
-        math::Vect<2,real64> rf;
-         rf[0] = rp[0]/rp[2];
-         rf[1] = rp[1]/rp[2];
-
-       // Triangulate...
-        math::Vect<4,real64> loc;
-        if (cam::Triangulate(lf,rf,pair.lp,pair.rp,loc)==false)
-        {
-         hand.Get(x,y) = sur::Vertex();
-         continue;
-        }
-        loc.Normalise();
-        if (math::IsZero(loc[3]))
-        {
-         hand.Get(x,y) = sur::Vertex();
-         continue;
-        }
-
-       // Check its in front of the camera...
-        if (pair.lp.Depth(loc)>0.0)
-        {
-	 hand.Get(x,y) = sur::Vertex();
-         continue;
-        }
-
-       // Store...
-        bs::Vert vert;
-         vert[0] = loc[0]/loc[3];
-         vert[1] = loc[1]/loc[3];
-         vert[2] = loc[2]/loc[3];
-        if (vert.Length()>10000.0) // Simple distance cap.
-        {
-         hand.Get(x,y) = sur::Vertex();
-         continue;
-        }
-        hand.Get(x,y) = mesh.NewVertex(vert);
-
-       // Tack on the uv...
-        propU.Get(hand.Get(x,y)) = real64(x)/real64(width);
-        propV.Get(hand.Get(x,y)) = 1.0 - (real64(y)/real64(height));
-      }
-      else
-      {
-       hand.Get(x,y) = sur::Vertex();
-      }
+      bit & v = valid.Get(x*stride,y*stride);
+      if (!v) continue;
+      if (!dispMask.Get(x*stride,y*stride)) {v = false; continue;}
+
+      const bs::Vert & vert = pos.Get(x*stride,y*stride);
+      // Check its in front of the camera...
+       math::Vect<4,real64> loc;
+        loc[0] = vert[0];
+        loc[1] = vert[1];
+        loc[2] = vert[2];
+        loc[3] = 1.0;
+       if (pair.lp.Depth(loc)>0.0) {v = false; continue;}
+
+      // Simple distance cap...
+       if (vert.Length()>10000.0) v = false;
      }
     }
     prog->Pop();
 
-
-   // Wire them up...
+   // Triangulate, straight into an indexed mesh with uv coordinates, dropping
+   // triangles that cross disparity discontinuities...
     prog->Report(1,3);
-    prog->Push();
-    for (nat32 y=0;y<height-1;y++)
-    {
-     prog->Report(y,height-1);
-     for (nat32 x=0;x<width-1;x++)
-     {
-      if ((hand.Get(x,y).Valid())&&
-          (hand.Get(x+1,y).Valid())&&
-          (hand.Get(x,y+1).Valid())&&
-          (hand.Get(x+1,y+1).Valid()))
-      {
-       real32 minDisp = math::Min(disp.Get(x*stride,y*stride),disp.Get(x*stride,(y+1)*stride),
-                                    disp.Get((x+1)*stride,y*stride),disp.Get((x+1)*stride,(y+1)*stride));
-       real32 maxDisp = math::Max(disp.Get(x*stride,y*stride),disp.Get(x*stride,(y+1)*stride),
-                                    disp.Get((x+1)*stride,y*stride),disp.Get((x+1)*stride,(y+1)*stride));
-       if ((maxDisp-minDisp)<=conCap)
-       {
-        mesh.NewFace(hand.Get(x,y),hand.Get(x+1,y),hand.Get(x+1,y+1),hand.Get(x,y+1));
-       }
-      }
-     }
-    }
-    prog->Pop();
-
-
+    sur::IndexedMesh mesh;
+    sur::GridMesh(pos,valid,disp,conCap,stride,mesh);
+    
    // Save the file...
     prog->Report(2,3);
     if ((!fn.EndsWith(".obj"))&&(!fn.EndsWith(".ply"))) fn << ".ply";
@@ -300,28 +300,19 @@ void Undistorter::Undistort(gui::Base * obj,gui::Event * event)
     }
 
 
-   // Sample from the old image into the new image...
+   // Sample from the old image into the new image, via a remap table so the
+   // distortion maths is done once per pixel rather than in the inner loop...
     prog->Report(1,3);
-    prog->Push();
-    for (int32 y=0;y<int32(udImage.Size(1));y++)
     {
-     prog->Report(y,udImage.Size(1));
-     for (int32 x=0;x<int32(udImage.Size(0));x++)
-     {
-      // Find where we are sampling...
-       math::Vect<2,real64> loc;
-       loc[0] = real64(x+minX);
-       loc[1] = real64(y+minY);
-       cc.radial.Dis(loc,loc);
-
-      // Take the sample...
-       if (svt::SampleColourRGBLin2D(udImage.Get(x,y),loc[0],loc[1],floatImage,&mask)==false)
-       {
-	udImage.Get(x,y) = bs::ColourRGB(1.0,0.0,1.0);
-       }
-     }
+     math::Mat<3,3,real64> offset;
+     math::Identity(offset);
+     offset[0][2] = minX;
+     offset[1][2] = minY;
+
+     cam::RectifyMap remap;
+     remap.Build(offset,cc.radial,floatImage.Size(0),floatImage.Size(1),udImage.Size(0),udImage.Size(1),1,prog);
+     remap.Apply(floatImage,udImage,&mask);
     }
-    prog->Pop();
 
 
    // Book-keeping...
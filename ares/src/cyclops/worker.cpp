@@ -0,0 +1,232 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "cyclops/worker.h"
+
+//------------------------------------------------------------------------------
+Worker::Worker(gui::App & a,gui::ProgressBar * b)
+:app(a),bar(b),quit(false),running(null<Job*>()),prog(*this),fraction(0.0)
+{
+ // The bar is updated via the message pump, so no point updating more often
+ // than the pump does...
+  prog.SetInterval(200);
+
+ Run();
+}
+
+Worker::~Worker()
+{
+ lock.Lock();
+  quit = true;
+  while (queued.Size()!=0)
+  {
+   delete queued.Front();
+   queued.RemFront();
+  }
+  if (running) prog.Cancel();
+ lock.Unlock();
+
+ wake.Add();
+ Wait();
+
+ while (finished.Size()!=0)
+ {
+  delete finished.Front();
+  finished.RemFront();
+ }
+}
+
+void Worker::Add(Job * job)
+{
+ lock.Lock();
+  queued.AddBack(job);
+ lock.Unlock();
+ wake.Add();
+}
+
+void Worker::Cancel(void * owner)
+{
+ lock.Lock();
+  for (nat32 i=queued.Size();i!=0;i--)
+  {
+   Job * job = queued.Front();
+   queued.RemFront();
+   if (job->Owner()==owner) delete job;
+                       else queued.AddBack(job);
+  }
+
+  if (running&&(running->Owner()==owner)) prog.Cancel();
+ lock.Unlock();
+}
+
+void Worker::Abandon(void * owner)
+{
+ Cancel(owner);
+
+ // Wait for a running job to notice...
+  while (true)
+  {
+   lock.Lock();
+    bit waiting = running&&(running->Owner()==owner);
+   lock.Unlock();
+   if (!waiting) break;
+   mt::Sleep(10);
+  }
+
+ // Throw away its results...
+  lock.Lock();
+   for (nat32 i=finished.Size();i!=0;i--)
+   {
+    Job * job = finished.Front();
+    bit cancelled = finishedCancelled.Front();
+    finished.RemFront();
+    finishedCancelled.RemFront();
+    if (job->Owner()==owner) delete job;
+    else
+    {
+     finished.AddBack(job);
+     finishedCancelled.AddBack(cancelled);
+    }
+   }
+  lock.Unlock();
+}
+
+nat32 Worker::Jobs(void * owner) const
+{
+ nat32 ret = 0;
+ lock.Lock();
+  ds::List<Job*>::Cursor targ = queued.FrontPtr();
+  while (!targ.Bad())
+  {
+   if ((*targ)->Owner()==owner) ret += 1;
+   ++targ;
+  }
+
+  if (running&&(running->Owner()==owner)) ret += 1;
+
+  targ = finished.FrontPtr();
+  while (!targ.Bad())
+  {
+   if ((*targ)->Owner()==owner) ret += 1;
+   ++targ;
+  }
+ lock.Unlock();
+ return ret;
+}
+
+void Worker::Execute()
+{
+ while (true)
+ {
+  wake.Get();
+
+  // Get the next job, if any. The progress is reset under the lock, so a
+  // Cancel can't fall between it being taken and the reset...
+   lock.Lock();
+    if (quit) {lock.Unlock(); break;}
+    if (queued.Size()==0) {lock.Unlock(); continue;}
+    running = queued.Front();
+    queued.RemFront();
+    prog.Reset();
+   lock.Unlock();
+
+  // Do it...
+   running->Run(&prog);
+
+  // Pass it back to the gui thread...
+   lock.Lock();
+    finished.AddBack(running);
+    finishedCancelled.AddBack(prog.Cancelled());
+    running = null<Job*>();
+   lock.Unlock();
+
+   app.Invoke(MakeCB(this,&Worker::Finish));
+ }
+}
+
+void Worker::WorkerProg::OnChange()
+{
+ real64 done;
+ real64 remaining;
+ Time(done,remaining);
+ real32 p = Prog();
+
+ worker.lock.Lock();
+  worker.fraction = p;
+  worker.text.SetSize(0);
+  worker.text << worker.running->Name() << " " << nat32(math::RoundDown(100.0*p)) << "% "
+              << time::FormatSeconds(done) << "/" << time::FormatSeconds(done+remaining);
+
+  // The innermost stage, so a slow step shows up as such...
+   if (Depth()>1)
+   {
+    nat32 x,y;
+    Part(Depth()-1,x,y);
+    real64 elapsed,left,rate;
+    Stage(Depth()-1,elapsed,left,rate);
+    worker.text << " (step " << x << "/" << y;
+    if (left>=0.0) worker.text << ", " << time::FormatSeconds(left) << " left";
+    worker.text << ")";
+   }
+  if (Cancelled()) worker.text << " (cancelling)";
+ worker.lock.Unlock();
+
+ if (worker.showPending.CompareSwap(0,1)) worker.app.Invoke(MakeCB(&worker,&Worker::ShowProg));
+}
+
+void Worker::Finish(gui::Base * obj,gui::Event * event)
+{
+ while (true)
+ {
+  lock.Lock();
+   if (finished.Size()==0) {lock.Unlock(); break;}
+   Job * job = finished.Front();
+   bit cancelled = finishedCancelled.Front();
+   finished.RemFront();
+   finishedCancelled.RemFront();
+   bit idle = (running==null<Job*>())&&(queued.Size()==0);
+  lock.Unlock();
+
+  if (idle)
+  {
+   str::String s;
+   s << job->Name() << (cancelled?" cancelled":" done");
+   cstr cs = s.ToStr();
+   bar->Show(0.0,cs);
+   mem::Free(cs);
+  }
+
+  job->Done(cancelled);
+  delete job;
+ }
+}
+
+void Worker::ShowProg(gui::Base * obj,gui::Event * event)
+{
+ showPending.Set(0);
+
+ lock.Lock();
+  real32 f = fraction;
+  cstr cs = text.ToStr();
+ lock.Unlock();
+
+ bar->Show(f,cs);
+ mem::Free(cs);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,129 @@
+#ifndef CYCLOPS_WORKER_H
+#define CYCLOPS_WORKER_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos.h"
+
+using namespace eos;
+
+//------------------------------------------------------------------------------
+// A long running operation, to be done by the Worker so the gui keeps going.
+// The owner is whatever panel queued it, so all its jobs can be cancelled
+// together.
+class Job : public Deletable
+{
+ public:
+   Job(void * o):owner(o) {}
+  ~Job() {}
+
+  // Does the work, in the worker thread, so must not touch the gui or
+  // anything the gui might change in the meantime. Should return early if
+  // prog->Cancelled(), which the algorithms it calls will ushally check too...
+   virtual void Run(time::Progress * prog) = 0;
+
+  // Called in the gui thread once Run has returned, to hand the results over.
+  // cancelled is true if the job was cancelled whilst running, in which case
+  // the results are partial...
+   virtual void Done(bit cancelled) = 0;
+
+  // Returns a short description, for the progress bar...
+   virtual cstrconst Name() const = 0;
+
+   void * Owner() const {return owner;}
+
+   cstrconst TypeString() const {return "Job";}
+
+
+ private:
+  void * owner;
+};
+
+//------------------------------------------------------------------------------
+// A background thread that runs Job's one at a time, in the order queued.
+// Progress is shown on the main progress bar, through App::Invoke, and
+// finished jobs are handed back to the gui thread the same way. Everything
+// other than the thread itself is called from the gui thread.
+class Worker : public mt::Thread
+{
+ public:
+   Worker(gui::App & app,gui::ProgressBar * bar);
+
+  // Cancels everything and waits for the thread, must be called before the
+  // App is deleted...
+  ~Worker();
+
+
+  // Queues a job, which the worker now owns...
+   void Add(Job * job);
+
+  // Cancels all jobs of the given owner. Queued jobs are deleted without
+  // being run, a running job has its progress cancelled and will get
+  // Done(true) when it returns...
+   void Cancel(void * owner);
+
+  // As Cancel, but blocks until a running job of the owner returns, then
+  // deletes it without calling Done. For use by an owner that is about to be
+  // deleted...
+   void Abandon(void * owner);
+
+  // Returns how many jobs the given owner has queued or running...
+   nat32 Jobs(void * owner) const;
+
+
+   void Execute();
+
+   cstrconst TypeString() const {return "Worker";}
+
+
+ private:
+  gui::App & app;
+  gui::ProgressBar * bar;
+
+  // The progress object jobs are run with...
+   class WorkerProg : public time::Progress
+   {
+    public:
+     WorkerProg(Worker & w):worker(w) {}
+     void OnChange();
+
+    private:
+     Worker & worker;
+   };
+
+  mt::OwnedLock lock; // Protects everything below.
+  mt::EventLock wake; // One event per job queued, plus one to quit.
+  bit quit;
+
+  ds::List<Job*> queued;
+  Job * running;
+  WorkerProg prog; // Progress of running.
+  ds::List<Job*> finished; // Waiting for Done, with cancelled flags below.
+  ds::List<bit> finishedCancelled;
+
+  mt::Atomic showPending; // 1 if a ShowProg is waiting to be Invoke-d.
+  real32 fraction;
+  str::String text;
+
+  // These are Invoke-d on the gui thread...
+   void Finish(gui::Base * obj,gui::Event * event);
+   void ShowProg(gui::Base * obj,gui::Event * event);
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,393 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "cyclops_batch/jobs.h"
+
+//------------------------------------------------------------------------------
+svt::Var * LoadStereoImage(svt::Core & core,cstrconst fn)
+{
+ svt::Var * ret = filter::LoadImageRGB(core,fn);
+ if (ret==null<svt::Var*>()) return null<svt::Var*>();
+
+ bit maskIni = true;
+ bs::ColourLuv luvIni(0.0,0.0,0.0);
+ ret->Add("mask",maskIni);
+ ret->Add("luv",luvIni);
+ ret->Commit();
+
+ svt::Field<bs::ColourRGB> rgb(ret,"rgb");
+ svt::Field<bit> mask(ret,"mask");
+ for (nat32 y=0;y<mask.Size(1);y++)
+ {
+  for (nat32 x=0;x<mask.Size(0);x++)
+  {
+   if (math::Equal(rgb.Get(x,y).r,real32(1.0))&&
+       math::Equal(rgb.Get(x,y).g,real32(0.0))&&
+       math::Equal(rgb.Get(x,y).b,real32(1.0)))
+   {
+    mask.Get(x,y) = false;
+   }
+  }
+ }
+
+ filter::RGBtoLuv(ret);
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+StereoJob::StereoJob(const bs::Element & job)
+:svt::Algorithm(2,1)
+{
+ str::Token algTok = job.GetToken("alg",job.TokTab()("sgm"));
+ if (algTok==job.TokTab()("dp")) alg = 0;
+ else if (algTok==job.TokTab()("bp")) alg = 1;
+ else alg = 2;
+
+ occCost = job.GetReal("occ_cost",1.0);
+ vertCost = job.GetReal("vert_cost",0.0);
+ vertMult = job.GetReal("vert_mult",0.33);
+ errLim = job.GetInt("err_lim",1);
+ matchLim = job.GetReal("match_lim",10.0);
+
+ bpOccLim = job.GetReal("occ_lim",6.0);
+ bpOccCostHigh = job.GetReal("occ_cost_high",16.0);
+ bpOccCostLow = job.GetReal("occ_cost_low",8.0);
+ bpOccLimMult = job.GetReal("occ_lim_mult",2.0);
+ bpIters = job.GetInt("iters",6);
+ bpOutput = job.GetInt("output",1);
+ bpMatchLim = job.GetReal("match_lim",36.0);
+
+ sgmMinDisp = job.GetInt("min_disp",-32);
+ sgmMaxDisp = job.GetInt("max_disp",32);
+ sgmP1 = job.GetReal("p1",2.0);
+ sgmP2 = job.GetReal("p2",16.0);
+ sgmMatchLim = job.GetReal("match_lim",36.0);
+ sgmPaths = job.GetInt("paths",8);
+}
+
+void StereoJob::Run(time::Progress * prog)
+{
+ LogTime("StereoJob::Run");
+ svt::Var * leftImg = static_cast<svt::Var*>(GetInput(0));
+ svt::Var * rightImg = static_cast<svt::Var*>(GetInput(1));
+
+ svt::Field<bs::ColourLuv> leftLuv(leftImg,"luv");
+ svt::Field<bs::ColourLuv> rightLuv(rightImg,"luv");
+ svt::Field<bit> leftMask(leftImg,"mask");
+ svt::Field<bit> rightMask(rightImg,"mask");
+
+
+ // Run the algorithm...
+  stereo::DSC * dsc = null<stereo::DSC*>();
+  stereo::DSI * dsi = null<stereo::DSI*>();
+  switch (alg)
+  {
+   case 0: // Hierachical DP...
+   {
+    stereo::SparseDSI2 * sdsi = new stereo::SparseDSI2();
+    dsi = sdsi;
+
+    sdsi->Set(occCost,vertCost,vertMult,errLim);
+    dsc = new stereo::HalfBoundLuvDSC(leftLuv,rightLuv,1.0,matchLim);
+    sdsi->Set(dsc);
+    sdsi->Set(leftMask,rightMask);
+
+    sdsi->Run(prog);
+   }
+   break;
+   case 1: // Hierachical BP...
+   {
+    stereo::HEBP * sdsi = new stereo::HEBP();
+    dsi = sdsi;
+
+    real32 occCostMult = (bpOccCostLow-bpOccCostHigh) / bpOccLim;
+    sdsi->Set(bpOccCostHigh,occCostMult,bpOccLimMult,bpIters,bpOutput);
+    dsc = new stereo::SqrBoundLuvDSC(leftLuv,rightLuv,1.0,bpMatchLim);
+    sdsi->Set(dsc);
+    stereo::LuvDSC dscOcc(leftLuv,rightLuv,1.0,bpOccLim);
+    sdsi->SetOcc(&dscOcc);
+    sdsi->Set(leftMask,rightMask);
+    sdsi->SetParallel();
+
+    sdsi->Run(prog);
+   }
+   break;
+   default: // Semi-global matching...
+   {
+    stereo::SGM * sgm = new stereo::SGM();
+    dsi = sgm;
+
+    sgm->SetRange(sgmMinDisp,sgmMaxDisp);
+    sgm->SetSmooth(sgmP1,sgmP2);
+    sgm->SetCost(sgmMatchLim);
+    sgm->SetPaths(sgmPaths);
+    dsc = new stereo::SqrBoundLuvDSC(leftLuv,rightLuv,1.0,sgmMatchLim);
+    sgm->Set(dsc);
+    sgm->Set(leftMask,rightMask);
+
+    sgm->Run(prog);
+   }
+   break;
+  }
+
+
+ // Extract the best disparity of each pixel...
+  svt::Var * result = new svt::Var(leftImg->GetCore());
+  result->Setup2D(leftImg->Size(0),leftImg->Size(1));
+  real32 dispIni = 0.0;
+  bit maskIni = true;
+  result->Add("disp",dispIni);
+  result->Add("mask",maskIni);
+  result->Commit(false);
+
+  svt::Field<real32> disp(result,"disp");
+  svt::Field<bit> mask(result,"mask");
+  for (nat32 y=0;y<disp.Size(1);y++)
+  {
+   for (nat32 x=0;x<disp.Size(0);x++)
+   {
+    if (dsi->Size(x,y)!=0)
+    {
+     real32 bestCost = dsi->Cost(x,y,0);
+     disp.Get(x,y) = dsi->Disp(x,y,0);
+     for (nat32 i=1;i<dsi->Size(x,y);i++)
+     {
+      if (dsi->Cost(x,y,i)<bestCost)
+      {
+       bestCost = dsi->Cost(x,y,i);
+       disp.Get(x,y) = dsi->Disp(x,y,i);
+      }
+     }
+     mask.Get(x,y) = true;
+    }
+    else
+    {
+     disp.Get(x,y) = 0.0;
+     mask.Get(x,y) = false;
+    }
+   }
+  }
+
+ delete dsi;
+ delete dsc;
+ SetOutput(0,result);
+}
+
+bit StereoJob::CacheKey(data::Md5 & key) const
+{
+ key.Write(&alg,sizeof(alg));
+ switch (alg)
+ {
+  case 0:
+   key.Write(&occCost,sizeof(occCost));
+   key.Write(&vertCost,sizeof(vertCost));
+   key.Write(&vertMult,sizeof(vertMult));
+   key.Write(&errLim,sizeof(errLim));
+   key.Write(&matchLim,sizeof(matchLim));
+  break;
+  case 1:
+   key.Write(&bpOccLim,sizeof(bpOccLim));
+   key.Write(&bpOccCostHigh,sizeof(bpOccCostHigh));
+   key.Write(&bpOccCostLow,sizeof(bpOccCostLow));
+   key.Write(&bpOccLimMult,sizeof(bpOccLimMult));
+   key.Write(&bpIters,sizeof(bpIters));
+   key.Write(&bpOutput,sizeof(bpOutput));
+   key.Write(&bpMatchLim,sizeof(bpMatchLim));
+  break;
+  default:
+   key.Write(&sgmMinDisp,sizeof(sgmMinDisp));
+   key.Write(&sgmMaxDisp,sizeof(sgmMaxDisp));
+   key.Write(&sgmP1,sizeof(sgmP1));
+   key.Write(&sgmP2,sizeof(sgmP2));
+   key.Write(&sgmMatchLim,sizeof(sgmMatchLim));
+   key.Write(&sgmPaths,sizeof(sgmPaths));
+  break;
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------------
+SfsJob::SfsJob(const bs::Element & job)
+:svt::Algorithm(1,1),toLight(0.0,0.0,1.0)
+{
+ str::Token algTok = job.GetToken("alg",job.TokTab()("lee"));
+ if (algTok==job.TokTab()("worthington")) alg = 1;
+                                     else alg = 0;
+
+ albedo = job.GetReal("albedo",1.0);
+ {
+  str::String s = job.GetString("light",str::String("0 0 1"));
+  str::String::Cursor cur = s.GetCursor();
+  cur.ClearError();
+  cur >> toLight;
+  if (cur.Error()) toLight = bs::Normal(0.0,0.0,1.0);
+ }
+
+ outerIters = job.GetInt("outer_iters",16);
+ innerIters = job.GetInt("inner_iters",64);
+ tolerance = job.GetReal("tolerance",0.001);
+ initRad = job.GetReal("init_rad",32.0);
+ startLambda = job.GetReal("start_lambda",0.1);
+ endLambda = job.GetReal("end_lambda",0.1);
+ speed = job.GetReal("speed",0.5);
+
+ iters = job.GetInt("iters",200);
+}
+
+void SfsJob::Run(time::Progress * prog)
+{
+ LogTime("SfsJob::Run");
+ svt::Var * image = static_cast<svt::Var*>(GetInput(0));
+ svt::Field<bs::ColourRGB> rgb(image,"rgb");
+
+ // Irradiance and albedo maps...
+  real32 realIni = 0.0;
+  svt::Var tempVar(rgb);
+  tempVar.Add("irr",realIni);
+  tempVar.Add("albedo",realIni);
+  tempVar.Commit();
+
+  svt::Field<real32> l(&tempVar,"irr");
+  svt::Field<real32> a(&tempVar,"albedo");
+  for (nat32 y=0;y<tempVar.Size(1);y++)
+  {
+   for (nat32 x=0;x<tempVar.Size(0);x++)
+   {
+    l.Get(x,y) = (rgb.Get(x,y).r+rgb.Get(x,y).g+rgb.Get(x,y).b)/3.0;
+    a.Get(x,y) = albedo;
+   }
+  }
+
+ // The output...
+  svt::Var * result = new svt::Var(rgb);
+  bs::Normal needleIni(0.0,0.0,1.0);
+  result->Add("needle",needleIni);
+  result->Commit();
+  svt::Field<bs::Normal> needle(result,"needle");
+
+ // Run the selected algorithm...
+  bs::Normal light = toLight;
+  if (alg==0)
+  {
+   sfs::Lee lee;
+   lee.SetImage(l);
+   lee.SetAlbedo(a);
+   lee.SetLight(light);
+   lee.SetParas(outerIters,initRad,startLambda,endLambda,innerIters,tolerance,speed);
+   lee.Run(prog);
+   lee.GetNeedle(needle);
+  }
+  else
+  {
+   sfs::Worthington wah;
+   wah.SetImage(l);
+   wah.SetAlbedo(a);
+   wah.SetLight(light);
+   wah.SetIters(iters);
+   wah.Run(prog);
+   wah.GetNeedle(needle);
+  }
+
+ SetOutput(0,result);
+}
+
+bit SfsJob::CacheKey(data::Md5 & key) const
+{
+ key.Write(&alg,sizeof(alg));
+ key.Write(&albedo,sizeof(albedo));
+ for (nat32 i=0;i<3;i++) key.Write(&toLight[i],sizeof(toLight[i]));
+ if (alg==0)
+ {
+  key.Write(&outerIters,sizeof(outerIters));
+  key.Write(&innerIters,sizeof(innerIters));
+  key.Write(&tolerance,sizeof(tolerance));
+  key.Write(&initRad,sizeof(initRad));
+  key.Write(&startLambda,sizeof(startLambda));
+  key.Write(&endLambda,sizeof(endLambda));
+  key.Write(&speed,sizeof(speed));
+ }
+ else
+ {
+  key.Write(&iters,sizeof(iters));
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------------
+bit DispToMesh(svt::Var * dispVar,const cam::CameraPair & pair,real32 conCap,nat32 stride,
+               cstrconst fn,time::Progress * prog)
+{
+ LogTime("DispToMesh");
+ svt::Field<real32> disp(dispVar,"disp");
+ svt::Field<bit> dispMask(dispVar,"mask");
+ if ((!disp.Valid())||(stride==0)) return false;
+
+ nat32 width = disp.Size(0)/stride;
+ nat32 height = disp.Size(1)/stride;
+ if ((width==0)||(height==0)) return false;
+
+ prog->Push();
+
+ // Convert the entire disparity map to positions in one go...
+  prog->Report(0,3);
+  cam::DispConvPlane dc;
+  dc.Set(pair,nat32(pair.leftDim[0]),nat32(pair.leftDim[1]),nat32(pair.rightDim[0]),nat32(pair.rightDim[1]));
+  bs::Vert vertIni(0.0,0.0,0.0);
+  bit validIni = false;
+  svt::Var temp(disp);
+   temp.Add("pos",vertIni);
+   temp.Add("valid",validIni);
+  temp.Commit(false);
+  svt::Field<bs::Vert> pos(&temp,"pos");
+  svt::Field<bit> valid(&temp,"valid");
+  dc.Convert(disp,pos,valid);
+
+ // Fold in the mask and sanity checks on position...
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    bit & v = valid.Get(x*stride,y*stride);
+    if (!v) continue;
+    if (dispMask.Valid()&&(!dispMask.Get(x*stride,y*stride))) {v = false; continue;}
+
+    const bs::Vert & vert = pos.Get(x*stride,y*stride);
+    math::Vect<4,real64> loc;
+     loc[0] = vert[0];
+     loc[1] = vert[1];
+     loc[2] = vert[2];
+     loc[3] = 1.0;
+    if (pair.lp.Depth(loc)>0.0) {v = false; continue;}
+
+    if (vert.Length()>10000.0) v = false;
+   }
+  }
+
+ // Triangulate and save...
+  prog->Report(1,3);
+  sur::IndexedMesh mesh;
+  sur::GridMesh(pos,valid,disp,conCap,stride,mesh);
+
+  prog->Report(2,3);
+  bit ret = file::SaveMesh(mesh,fn,true,prog);
+
+ prog->Pop();
+ return ret;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,127 @@
+#ifndef CYCLOPS_BATCH_JOBS_H
+#define CYCLOPS_BATCH_JOBS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+// The operations of Cyclops, without the gui, as svt::Algorithm's so the
+// driver can run them through a result cache. Parameters are read from the
+// element of the job, with the same names and defaults as the Cyclops panels.
+
+#include "cyclops_batch/main.h"
+
+//------------------------------------------------------------------------------
+// Loads an image for stereo, adding a mask, where pure magenta is masked out,
+// and a luv field, exactly as the stereopsis panel does. Returns null on
+// failure...
+svt::Var * LoadStereoImage(svt::Core & core,cstrconst fn);
+
+//------------------------------------------------------------------------------
+// Stereopsis, input 0 is the left image and input 1 the right, as given by
+// LoadStereoImage. The one output is a Var with "disp" and "mask" fields, the
+// best disparity of each pixel, i.e. the 'None' post-processor. alg is one of
+// "dp", "bp" or "sgm"...
+class StereoJob : public svt::Algorithm
+{
+ public:
+   StereoJob(const bs::Element & job);
+  ~StereoJob() {}
+
+   void Run(time::Progress * prog = null<time::Progress*>());
+
+   cstrconst TypeString() const {return "cyclops_batch::StereoJob";}
+
+
+ protected:
+   bit CacheKey(data::Md5 & key) const;
+
+
+ private:
+  nat32 alg; // 0 = dp, 1 = bp, 2 = sgm.
+
+  // dp...
+   real32 occCost;
+   real32 vertCost;
+   real32 vertMult;
+   int32 errLim;
+   real32 matchLim;
+
+  // bp...
+   real32 bpOccLim;
+   real32 bpOccCostHigh;
+   real32 bpOccCostLow;
+   real32 bpOccLimMult;
+   int32 bpIters;
+   int32 bpOutput;
+   real32 bpMatchLim;
+
+  // sgm...
+   int32 sgmMinDisp;
+   int32 sgmMaxDisp;
+   real32 sgmP1;
+   real32 sgmP2;
+   real32 sgmMatchLim;
+   int32 sgmPaths;
+};
+
+//------------------------------------------------------------------------------
+// Shape from shading, input 0 is an image with an "rgb" field, the one output a
+// Var with a "needle" field of bs::Normal. alg is "lee" or "worthington". The
+// irradiance is taken as the mean of the channels, i.e. a linear camera
+// response is assumed...
+class SfsJob : public svt::Algorithm
+{
+ public:
+   SfsJob(const bs::Element & job);
+  ~SfsJob() {}
+
+   void Run(time::Progress * prog = null<time::Progress*>());
+
+   cstrconst TypeString() const {return "cyclops_batch::SfsJob";}
+
+
+ protected:
+   bit CacheKey(data::Md5 & key) const;
+
+
+ private:
+  nat32 alg; // 0 = lee, 1 = worthington.
+  real32 albedo;
+  bs::Normal toLight;
+
+  // lee...
+   int32 outerIters;
+   int32 innerIters;
+   real32 tolerance;
+   real32 initRad;
+   real32 startLambda;
+   real32 endLambda;
+   real32 speed;
+
+  // worthington...
+   int32 iters;
+};
+
+//------------------------------------------------------------------------------
+// Converts a disparity map, with "disp" and "mask" fields, to a mesh using the
+// given calibration and saves it, as the to mesh panel does. Returns false on
+// failure...
+bit DispToMesh(svt::Var * dispVar,const cam::CameraPair & pair,real32 conCap,nat32 stride,
+               cstrconst fn,time::Progress * prog = null<time::Progress*>());
+
+//------------------------------------------------------------------------------
+#endif
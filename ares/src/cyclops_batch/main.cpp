@@ -0,0 +1,255 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include <iostream>
+
+#include "cyclops_batch/main.h"
+#include "cyclops_batch/jobs.h"
+
+//------------------------------------------------------------------------------
+// Runs an algorithm, through the cache if there is one...
+void RunJob(svt::Algorithm & alg,svt::Cache * cache,svt::Core & core,time::Progress * prog)
+{
+ if (cache) alg.RunCached(*cache,core,prog);
+       else alg.Run(prog);
+}
+
+// Prints the top level stages of a job, the ones its algorithm pushed
+// directly, with the slowest marked...
+void PrintStages(const time::Progress & prog)
+{
+ nat32 slowest = prog.Stages();
+ for (nat32 i=0;i<prog.Stages();i++)
+ {
+  const time::Progress::StageStats & targ = prog.GetStage(i);
+  if (targ.depth!=1) continue;
+  if ((slowest==prog.Stages())||(targ.time>prog.GetStage(slowest).time)) slowest = i;
+ }
+
+ for (nat32 i=0;i<prog.Stages();i++)
+ {
+  const time::Progress::StageStats & targ = prog.GetStage(i);
+  if (targ.depth!=1) continue;
+  std::cout << "  " << (targ.name?targ.name:"stage") << " " << targ.time << "s, "
+            << targ.items << " steps at " << targ.Rate() << "/s" << ((i==slowest)?" (slowest)":"") << "\n";
+ }
+}
+
+// Saves the output of an algorithm and deletes it, returns false on failure...
+bit SaveOutput(svt::Algorithm & alg,const str::String & fn)
+{
+ svt::Node * out = alg.GetOutput(0);
+ if (out==null<svt::Node*>()) return false;
+
+ cstr filename = fn.ToStr();
+ bit ret = svt::Save(filename,out,true);
+ mem::Free(filename);
+
+ delete out;
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// Each of these does one job, returning false on failure...
+bit Stereopsis(svt::Core & core,svt::Cache * cache,const bs::Element & job,time::Progress * prog)
+{
+ str::String leftFn = job.GetString("left",str::String(""));
+ str::String rightFn = job.GetString("right",str::String(""));
+ str::String outFn = job.GetString("out",str::String(""));
+
+ cstr fn = leftFn.ToStr();
+ svt::Var * left = LoadStereoImage(core,fn);
+ mem::Free(fn);
+ fn = rightFn.ToStr();
+ svt::Var * right = LoadStereoImage(core,fn);
+ mem::Free(fn);
+
+ bit ret = false;
+ if (left&&right)
+ {
+  StereoJob alg(job);
+  alg.SetInput(0,left);
+  alg.SetInput(1,right);
+  RunJob(alg,cache,core,prog);
+  ret = SaveOutput(alg,outFn);
+ }
+
+ delete left;
+ delete right;
+ return ret;
+}
+
+bit ShapeFromShading(svt::Core & core,svt::Cache * cache,const bs::Element & job,time::Progress * prog)
+{
+ str::String imageFn = job.GetString("image",str::String(""));
+ str::String outFn = job.GetString("out",str::String(""));
+
+ cstr fn = imageFn.ToStr();
+ svt::Var * image = filter::LoadImageRGB(core,fn);
+ mem::Free(fn);
+ if (image==null<svt::Var*>()) return false;
+
+ SfsJob alg(job);
+ alg.SetInput(0,image);
+ RunJob(alg,cache,core,prog);
+ bit ret = SaveOutput(alg,outFn);
+
+ delete image;
+ return ret;
+}
+
+bit ToMesh(svt::Core & core,const bs::Element & job)
+{
+ str::String dispFn = job.GetString("disp",str::String(""));
+ str::String pairFn = job.GetString("pair",str::String(""));
+ str::String outFn = job.GetString("out",str::String(""));
+
+ cam::CameraPair pair;
+ if (!pair.Load(pairFn)) return false;
+
+ cstr fn = dispFn.ToStr();
+ svt::Node * node = svt::Load(core,fn);
+ mem::Free(fn);
+ if (node==null<svt::Node*>()) return false;
+
+ bit ret = false;
+ if (str::Compare(typestring(*node),"eos::svt::Var")==0)
+ {
+  fn = outFn.ToStr();
+  ret = DispToMesh(static_cast<svt::Var*>(node),pair,job.GetReal("con_limit",8.0),
+                   job.GetInt("stride",1),fn);
+  mem::Free(fn);
+ }
+
+ delete node;
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+int main(int argc,char ** argv)
+{
+ if (argc<2)
+ {
+  std::cout << "Usage:\ncyclops_batch [jobs.xml] <cache dir> <tokens>\n";
+  std::cout << "Runs the operations of Cyclops without the gui, one per element of the\n";
+  std::cout << "jobs file, in order, so start up is paid once for the lot:\n";
+  std::cout << "  <stereopsis left=\"\" right=\"\" out=\".svt\" alg=\"dp|bp|sgm\" .../>\n";
+  std::cout << "  <sfs image=\"\" out=\".svt\" alg=\"lee|worthington\" light=\"0 0 1\" .../>\n";
+  std::cout << "  <to_mesh disp=\".svt\" pair=\".pcc\" out=\".ply|.obj\" con_limit=\"8\" stride=\"1\"/>\n";
+  std::cout << "Remaining attributes are the parameters of the Cyclops panels, with the\n";
+  std::cout << "same defaults. With a cache directory the results of stereopsis and sfs\n";
+  std::cout << "are kept there, so rerunning a job with unchanged inputs and parameters\n";
+  std::cout << "just copies the result. The time of each stage of a job is printed; if\n";
+  std::cout << "the root element has a stages=\"timings.csv\" attribute every stage, at\n";
+  std::cout << "every depth, is also appended to that file. If a tokens file is given\n";
+  std::cout << "(with \"\" for no cache) and exists the token table is filled from it\n";
+  std::cout << "before anything else, otherwise it is written at the end, for next\n";
+  std::cout << "time. Set EOS_STARTUP to see where start up time goes.\n";
+  return 1;
+ }
+
+ str::TokenTable tt;
+ cstrconst tokens = (argc>3)?argv[3]:null<cstrconst>();
+ bit haveTokens = false;
+ if (tokens)
+ {
+  haveTokens = tt.Load(tokens);
+  time::StartupMark("tokens");
+ }
+ 
+ svt::Core core(tt);
+
+ svt::Cache * cache = null<svt::Cache*>();
+ if ((argc>2)&&(str::Length(argv[2])!=0))
+ {
+  str::String dir(argv[2]);
+  if (!dir.EndsWith("/")) dir << "/";
+  cstr d = dir.ToStr();
+  cache = new svt::Cache(d);
+  mem::Free(d);
+ }
+
+
+ // Load the jobs...
+  bs::Element * root = file::LoadXML(tt,argv[1]);
+  if (root==null<bs::Element*>())
+  {
+   std::cout << "Could not load the jobs file\n";
+   delete cache;
+   return 1;
+  }
+  time::StartupMark("ready");
+
+
+ // Do each job in turn...
+  str::String stagesFn = root->GetString("stages",str::String(""));
+  cstr stages = (stagesFn.Size()!=0)?stagesFn.ToStr():null<cstr>();
+
+  nat32 jobs = 0;
+  nat32 failures = 0;
+  real64 start = time::UltraTime();
+
+  for (bs::Element * job = root->Front();job!=root->Bad();job = job->Next())
+  {
+   real64 jobStart = time::UltraTime();
+   cstrconst name = tt.Str(job->Name());
+   time::Progress prog;
+
+   bit ok;
+   if (job->Name()==tt("stereopsis")) ok = Stereopsis(core,cache,*job,&prog);
+   else if (job->Name()==tt("sfs")) ok = ShapeFromShading(core,cache,*job,&prog);
+   else if (job->Name()==tt("to_mesh")) ok = ToMesh(core,*job);
+   else
+   {
+    std::cout << "Unknown job " << name << ", skipping\n";
+    continue;
+   }
+
+   jobs += 1;
+   if (!ok) failures += 1;
+   std::cout << "Job " << jobs << " (" << name << ") " << (ok?"done":"failed")
+             << " in " << (time::UltraTime()-jobStart) << "s\n";
+   PrintStages(prog);
+
+   if (stages)
+   {
+    str::String label;
+    label << jobs << " " << name;
+    cstr l = label.ToStr();
+    if (!prog.WriteStages(stages,l,false)) std::cout << "Could not write the stage timings\n";
+    mem::Free(l);
+   }
+  }
+  mem::Free(stages);
+
+  std::cout << "Done " << jobs << " jobs in " << (time::UltraTime()-start) << "s, with "
+            << failures << " failures\n";
+
+ // Save the tokens for next time, if requested and not allready loaded...
+  if (tokens&&(!haveTokens))
+  {
+   if (!tt.Save(tokens)) std::cout << "Could not write the tokens file\n";
+  }
+
+
+ delete root;
+ delete cache;
+ return (failures==0)?0:1;
+}
+
+//------------------------------------------------------------------------------
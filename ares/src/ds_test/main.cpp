@@ -18,6 +18,57 @@
 
 #include "ds_test/main.h"
 
+//------------------------------------------------------------------------------
+// Helpers for the concurrent queue benchmark - threads that push a sequence
+// of numbers into a queue or sum whatever they pull out...
+template <typename Q>
+class Producer : public eos::mt::Thread
+{
+ public:
+  Q * q;
+  eos::nat32 count;
+
+  void Execute()
+  {
+   for (eos::nat32 i=1;i<=count;i++) q->Add(i);
+  }
+};
+
+template <typename Q>
+class Consumer : public eos::mt::Thread
+{
+ public:
+  Q * q;
+  eos::nat32 count;
+  eos::nat64 sum;
+
+  void Execute()
+  {
+   sum = 0;
+   for (eos::nat32 i=0;i<count;i++)
+   {
+    eos::nat32 v;
+    q->Rem(v);
+    sum += v;
+   }
+  }
+};
+
+//------------------------------------------------------------------------------
+// Item for the heap benchmark, a tentative distance for a key, ordered by
+// distance with ties broken by key so every heap pops in the same order...
+struct HeapItem
+{
+ eos::nat32 dist;
+ eos::nat32 key;
+
+ eos::bit operator < (const HeapItem & rhs) const
+ {
+  if (dist!=rhs.dist) return dist<rhs.dist;
+  return key<rhs.key;
+ }
+};
+
 //------------------------------------------------------------------------------
 int main()
 {
@@ -259,6 +310,311 @@ int main()
  }
 
 
+ // Test the vector kd-tree with sift sized vectors - check the exact search
+ // against brute force and time the approximate search at various numbers of
+ // checks, reporting how often it finds the true nearest...
+ {
+  static const nat32 dims = 128;
+  static const nat32 items = 20000;
+  static const nat32 queries = 1000;
+
+  real32 * vec = new real32[items*dims];
+  real32 * query = new real32[queries*dims];
+  for (nat32 i=0;i<items*dims;i++) vec[i] = rand.Normal();
+  for (nat32 i=0;i<queries;i++)
+  {
+   nat32 src = rand.Int(0,items-1);
+   for (nat32 j=0;j<dims;j++) query[i*dims+j] = vec[src*dims+j] + 0.5*rand.Normal();
+  }
+
+  ds::VectorKdTree tree;
+  tree.Build(dims,items,vec);
+
+  nat32 * truth = new nat32[queries];
+  real64 start = time::UltraTime();
+  for (nat32 i=0;i<queries;i++)
+  {
+   real32 best = math::Infinity<real32>();
+   for (nat32 j=0;j<items;j++)
+   {
+    real32 dist = 0.0;
+    for (nat32 d=0;d<dims;d++) dist += math::Sqr(query[i*dims+d] - vec[j*dims+d]);
+    if (dist<best) {best = dist; truth[i] = j;}
+   }
+  }
+  real64 bruteTime = time::UltraTime() - start;
+  con << "VectorKdTree, brute force: " << bruteTime << " seconds.\n";
+
+  ds::VectorKdTree::Match * match = new ds::VectorKdTree::Match[queries*2];
+  nat32 checks[4] = {0,100,400,2000};
+  for (nat32 c=0;c<4;c++)
+  {
+   start = time::UltraTime();
+   tree.Nearest(queries,query,dims,2,match,checks[c]);
+   real64 taken = time::UltraTime() - start;
+
+   nat32 correct = 0;
+   for (nat32 i=0;i<queries;i++) {if (match[i*2].index==truth[i]) ++correct;}
+   con << "VectorKdTree, " << checks[c] << " checks: " << taken << " seconds, "
+       << correct << " of " << queries << " correct.\n";
+  }
+
+  delete[] match;
+  delete[] truth;
+  delete[] query;
+  delete[] vec;
+ }
+
+
+
+ // Benchmark the concurrent queues - push numbers through them with multiple
+ // threads and check the sums come out right...
+ {
+  static const nat32 items = 1000000;
+  static const nat32 threads = 4;
+
+  // Many producers to many consumers...
+  {
+   ds::ConcurrentQueue<nat32> q(256);
+   Producer< ds::ConcurrentQueue<nat32> > prod[threads];
+   Consumer< ds::ConcurrentQueue<nat32> > cons[threads];
+
+   real64 start = time::UltraTime();
+   for (nat32 i=0;i<threads;i++)
+   {
+    prod[i].q = &q; prod[i].count = items;
+    cons[i].q = &q; cons[i].count = items;
+    cons[i].Run();
+    prod[i].Run();
+   }
+
+   nat64 sum = 0;
+   for (nat32 i=0;i<threads;i++)
+   {
+    prod[i].Wait();
+    cons[i].Wait();
+    sum += cons[i].sum;
+   }
+   real64 taken = time::UltraTime() - start;
+
+   nat64 expected = nat64(threads) * ((nat64(items)*nat64(items+1))/2);
+   con << "ConcurrentQueue, " << threads << " to " << threads << ": " << (sum==expected?"correct":"WRONG")
+       << ", " << (real64(threads*items)/taken)*1e-6 << " million items per second.\n";
+  }
+
+  // One producer to one consumer...
+  {
+   ds::RingBuffer<nat32> q(256);
+   Producer< ds::RingBuffer<nat32> > prod;
+   Consumer< ds::RingBuffer<nat32> > cons;
+
+   real64 start = time::UltraTime();
+   prod.q = &q; prod.count = items;
+   cons.q = &q; cons.count = items;
+   cons.Run();
+   prod.Run();
+   prod.Wait();
+   cons.Wait();
+   real64 taken = time::UltraTime() - start;
+
+   nat64 expected = (nat64(items)*nat64(items+1))/2;
+   con << "RingBuffer, 1 to 1: " << (cons.sum==expected?"correct":"WRONG")
+       << ", " << (real64(items)/taken)*1e-6 << " million items per second.\n";
+  }
+ }
+
+
+ // Benchmark the hash tables - fill each with token like indices, then do
+ // lookups in a scattered order, half of which miss, checking they agree...
+ {
+  static const nat32 lookups = 20000000;
+  for (nat32 n=16;n<=1000000;n*=25)
+  {
+   nat32 reps = lookups/n;
+   ds::FlatHash<nat32> flat;
+   ds::SparseHash<nat32> sparse;
+   ds::DenseHash<nat32> dense;
+   nat32 * denseVal = new nat32[n];
+
+   for (nat32 i=0;i<n;i++)
+   {
+    flat.Set(i*7,i);
+    sparse.Set(i*7,i);
+    denseVal[i] = i;
+    dense[i*7] = &denseVal[i];
+   }
+
+   nat64 flatSum = 0;
+   real64 start = time::UltraTime();
+   for (nat32 r=0;r<reps;r++)
+   {
+    for (nat32 i=0;i<n;i++)
+    {
+     nat32 * v = flat.Get(((i*2654435761u)%n)*7 + (r&1));
+     if (v) flatSum += *v;
+    }
+   }
+   real64 flatTime = time::UltraTime() - start;
+
+   nat64 sparseSum = 0;
+   start = time::UltraTime();
+   for (nat32 r=0;r<reps;r++)
+   {
+    for (nat32 i=0;i<n;i++)
+    {
+     nat32 * v = sparse.Get(((i*2654435761u)%n)*7 + (r&1));
+     if (v) sparseSum += *v;
+    }
+   }
+   real64 sparseTime = time::UltraTime() - start;
+
+   nat64 denseSum = 0;
+   start = time::UltraTime();
+   for (nat32 r=0;r<reps;r++)
+   {
+    for (nat32 i=0;i<n;i++)
+    {
+     nat32 ind = ((i*2654435761u)%n)*7 + (r&1);
+     if (dense.Exists(ind)) denseSum += *dense[ind];
+    }
+   }
+   real64 denseTime = time::UltraTime() - start;
+
+   real64 mult = 1e9/(real64(reps)*real64(n));
+   con << "Hash lookups, " << n << " items: " << ((flatSum==sparseSum)&&(sparseSum==denseSum)?"correct":"WRONG")
+       << ", FlatHash " << flatTime*mult << "ns, SparseHash " << sparseTime*mult << "ns, DenseHash " << denseTime*mult << "ns.\n";
+
+   delete[] denseVal;
+  }
+ }
+
+
+ // Benchmark the heaps on a Dijkstra like decrease-key workload - every key
+ // starts with a random distance, then each pop relaxes a fixed set of other
+ // keys, lowering those it can. The priority queue has to re-insert and skip
+ // stale entries, the lazy heap versions its entries, the index heap moves the
+ // entry in place. The pop orders are checksummed to confirm they agree...
+ {
+  static const nat32 keys = 250000;
+  static const nat32 fan = 8;
+  ds::Array<nat32> initDist(keys);
+  ds::Array<nat32> edgeTarg(keys*fan);
+  ds::Array<nat32> edgeWeight(keys*fan);
+  for (nat32 i=0;i<keys;i++) initDist[i] = nat32(rand.Int(0,10000000));
+  for (nat32 i=0;i<keys*fan;i++)
+  {
+   edgeTarg[i] = nat32(rand.Int(0,keys-1));
+   edgeWeight[i] = nat32(rand.Int(1,1000));
+  }
+
+  ds::Array<nat32> dist(keys);
+  ds::Array<bit> done(keys);
+  HeapItem hi;
+
+  // PriorityQueue, re-inserting and skipping stale entries...
+   for (nat32 i=0;i<keys;i++) {dist[i] = initDist[i]; done[i] = false;}
+   nat64 pqSum = 0;
+   nat32 pqPeak = 0;
+   real64 start = time::UltraTime();
+   {
+    ds::PriorityQueue<HeapItem> pq(keys);
+    for (nat32 i=0;i<keys;i++) {hi.dist = dist[i]; hi.key = i; pq.Add(hi);}
+
+    nat32 step = 0;
+    while (pq.Size()!=0)
+    {
+     pqPeak = math::Max(pqPeak,pq.Size());
+     HeapItem top = pq.Peek();
+     pq.Rem();
+     if (done[top.key]||(top.dist!=dist[top.key])) continue;
+     done[top.key] = true;
+     pqSum = pqSum*31 + top.key;
+
+     for (nat32 j=0;j<fan;j++)
+     {
+      nat32 t = edgeTarg[step*fan+j];
+      nat32 nd = top.dist + edgeWeight[step*fan+j];
+      if ((!done[t])&&(nd<dist[t]))
+      {
+       dist[t] = nd;
+       hi.dist = nd; hi.key = t;
+       pq.Add(hi);
+      }
+     }
+     ++step;
+    }
+   }
+   real64 pqTime = time::UltraTime() - start;
+
+  // LazyHeap, replacing by key...
+   for (nat32 i=0;i<keys;i++) {dist[i] = initDist[i]; done[i] = false;}
+   nat64 lazySum = 0;
+   start = time::UltraTime();
+   {
+    ds::LazyHeap<HeapItem> lazy;
+    for (nat32 i=0;i<keys;i++) {hi.dist = dist[i]; hi.key = i; lazy.Add(i,hi);}
+
+    nat32 step = 0;
+    nat32 key;
+    HeapItem top;
+    while (lazy.Pop(key,top))
+    {
+     done[key] = true;
+     lazySum = lazySum*31 + key;
+
+     for (nat32 j=0;j<fan;j++)
+     {
+      nat32 t = edgeTarg[step*fan+j];
+      nat32 nd = top.dist + edgeWeight[step*fan+j];
+      if ((!done[t])&&(nd<dist[t]))
+      {
+       dist[t] = nd;
+       hi.dist = nd; hi.key = t;
+       lazy.Add(t,hi);
+      }
+     }
+     ++step;
+    }
+   }
+   real64 lazyTime = time::UltraTime() - start;
+
+  // IndexHeap, with a true decrease-key...
+   for (nat32 i=0;i<keys;i++) {dist[i] = initDist[i]; done[i] = false;}
+   nat64 indexSum = 0;
+   start = time::UltraTime();
+   {
+    ds::IndexHeap<HeapItem> index;
+    for (nat32 i=0;i<keys;i++) {hi.dist = dist[i]; hi.key = i; index.Add(i,hi);}
+
+    nat32 step = 0;
+    nat32 key;
+    HeapItem top;
+    while (index.Pop(key,top))
+    {
+     done[key] = true;
+     indexSum = indexSum*31 + key;
+
+     for (nat32 j=0;j<fan;j++)
+     {
+      nat32 t = edgeTarg[step*fan+j];
+      nat32 nd = top.dist + edgeWeight[step*fan+j];
+      if ((!done[t])&&(nd<dist[t]))
+      {
+       dist[t] = nd;
+       hi.dist = nd; hi.key = t;
+       index.DecreaseKey(t,hi);
+      }
+     }
+     ++step;
+    }
+   }
+   real64 indexTime = time::UltraTime() - start;
+
+  con << "Heaps, " << keys << " keys, fan " << fan << ": " << ((pqSum==lazySum)&&(lazySum==indexSum)?"correct":"WRONG")
+      << ", PriorityQueue " << pqTime << "s (peak " << pqPeak << "), LazyHeap " << lazyTime << "s, IndexHeap " << indexTime << "s.\n";
+ }
+
+
  con << "End.\n";
  return 0;
 }
@@ -27,12 +27,40 @@ int main(int argc,char ** argv)
 
  if (argc<2)
  {
-  con << "Usage:\nexif [image]\n";
-  con << "Prints out recognised exif information\n";
+  con << "Usage:\nexif [image]\nexif [directory/]\n";
+  con << "Prints out recognised exif information, for a directory a line for\n";
+  con << "each jpeg within.\n";
   return 1;
  }
 
 
+ // A directory, as indicated by the trailing slash, is scanned in one go...
+  file::Dir dir(argv[1]);
+  if (dir.Type()==file::TypeDir)
+  {
+   ds::List<cstr,mem::KillFree<char> > names;
+   ds::Array<file::ExifSummary> sum;
+   file::ExifScan(dir,names,sum);
+
+   ds::List<cstr,mem::KillFree<char> >::Cursor targ = names.FrontPtr();
+   for (nat32 i=0;i<sum.Size();i++)
+   {
+    con << *targ << ": ";
+    if (sum[i].valid)
+    {
+     con << sum[i].make << " " << sum[i].model << ", " << sum[i].dateTime << ", "
+         << sum[i].exposureTime << "s, f" << sum[i].fStop << ", ISO " << sum[i].iso << ", "
+         << sum[i].focalLength << "mm";
+     if (sum[i].flash) con << ", flash";
+     con << "\n";
+    }
+    else con << "no exif\n";
+    ++targ;
+   }
+   return 0;
+  }
+
+
  file::Exif exif;
  
  if (exif.Load(argv[1])==false)
@@ -0,0 +1,146 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include <iostream>
+
+#include "helios/main.h"
+
+//------------------------------------------------------------------------------
+// Serves jobs forever...
+int Serve(nat32 port,cstrconst iface,const svt::Plugins & plugins)
+{
+ str::TokenTable tt;
+ svt::Core core(tt);
+
+ svt::RemoteServer server(core);
+ server.Register(plugins);
+
+ std::cout << "Serving " << plugins.Size() << " algorithms on " << (iface?iface:"all interfaces") << " port " << port << "\n";
+ if (!server.Serve(port,iface))
+ {
+  std::cout << "Could not listen on port " << port << "\n";
+  return 1;
+ }
+ return 0;
+}
+
+// Runs a pipeline with every algorithm sent to the workers, then prints where
+// the time went for each...
+int Dispatch(cstrconst fn,const svt::Plugins & plugins,nat32 rows,nat32 overlap,nat32 workers,char ** worker)
+{
+ str::TokenTable tt;
+ svt::Core core(tt);
+
+ svt::RemoteDispatcher dispatcher(core);
+ for (nat32 i=0;i<workers;i++)
+ {
+  str::String w(worker[i]);
+  nat32 port = 7420;
+  cstr host = w.ToStr();
+  for (nat32 j=0;host[j];j++)
+  {
+   if (host[j]==':')
+   {
+    host[j] = 0;
+    port = str::ToInt32(host+j+1);
+    break;
+   }
+  }
+  dispatcher.AddWorker(host,port);
+  mem::Free(host);
+ }
+
+ ds::Array<svt::RemoteMeta*> remote(plugins.Size());
+ svt::Pipeline pipe;
+ for (nat32 i=0;i<remote.Size();i++)
+ {
+  remote[i] = new svt::RemoteMeta(dispatcher,plugins[i],rows,overlap);
+  pipe.Register(*remote[i]);
+ }
+
+ int ret = 0;
+ if (!pipe.Load(tt,fn))
+ {
+  std::cout << "Bad pipeline: " << pipe.Error() << "\n";
+  ret = 1;
+ }
+ else
+ {
+  real64 start = time::UltraTime();
+  if (!pipe.Run(core)) ret = 1;
+  real64 wall = time::UltraTime() - start;
+
+  for (nat32 i=0;i<pipe.Steps();i++)
+  {
+   std::cout << "Step " << pipe.StepName(i) << (pipe.StepFailed(i)?" failed":" done")
+             << " in " << pipe.StepTime(i) << "s\n";
+  }
+
+  std::cout << "\nalgorithm, tiles, retries, MB sent, MB received, pack s, network s, compute s, wall s\n";
+  for (nat32 i=0;i<dispatcher.History();i++)
+  {
+   svt::RemoteStats st = dispatcher.History(i);
+   std::cout << tt.Str(st.alg) << ", " << st.tiles << ", " << st.retries << ", "
+             << (st.sent/(1024.0*1024.0)) << ", " << (st.received/(1024.0*1024.0)) << ", "
+             << st.pack << ", " << st.network << ", " << st.compute << ", " << st.wall << "\n";
+  }
+  std::cout << "\nTotal " << wall << "s\n";
+ }
+
+ for (nat32 i=0;i<remote.Size();i++) delete remote[i];
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+int main(int argc,char ** argv)
+{
+ if (argc<3)
+ {
+  std::cout << "Usage:\n";
+  std::cout << "helios serve [plugin dir] <port> <interface>\n";
+  std::cout << "  Runs a worker, serving the algorithms of the plugin directory. Only\n";
+  std::cout << "  listens on loopback unless given an interface address, * for all.\n";
+  std::cout << "helios run [plugin dir] [pipeline.xml] [rows] [overlap] [host:port] ...\n";
+  std::cout << "  Runs a pipeline, as aegle does, but with every algorithm run on the\n";
+  std::cout << "  given workers. Image inputs are split into bands of rows, with overlap\n";
+  std::cout << "  rows of context either side, 0 rows to send them whole. Prints the\n";
+  std::cout << "  network/compute breakdown of each job afterwards.\n";
+  std::cout << "The default port is 7420. There is no security, trusted networks only.\n";
+  return 1;
+ }
+
+ svt::Plugins plugins;
+ plugins.AddDir(file::Dir(argv[2]));
+
+ if (str::Compare(argv[1],"serve")==0)
+ {
+  nat32 port = (argc>3)?str::ToInt32(argv[3]):7420;
+  cstrconst iface = (argc>4)?argv[4]:"127.0.0.1";
+  if (str::Compare(iface,"*")==0) iface = null<cstrconst>();
+  return Serve(port,iface,plugins);
+ }
+ else if ((str::Compare(argv[1],"run")==0)&&(argc>6))
+ {
+  return Dispatch(argv[3],plugins,str::ToInt32(argv[4]),str::ToInt32(argv[5]),argc-6,argv+6);
+ }
+
+ std::cout << "Unknown command, or missing arguments\n";
+ return 1;
+}
+
+//------------------------------------------------------------------------------
@@ -569,6 +569,70 @@ int main()
  }
 
 
+ // Benchmark the expression templates against the old way of doing things,
+ // with temporaries and the mat_ops functions...
+ {
+  con << "\nBenchmarking expressions against temporaries:\n";
+  static const nat32 iters = 4000000;
+
+  math::Vect<3,real32> a,b,c;
+  math::Mat<3,3,real32> m,n;
+  for (nat32 i=0;i<3;i++)
+  {
+   a[i] = rand.Signed(); b[i] = rand.Signed(); c[i] = rand.Signed();
+   for (nat32 j=0;j<3;j++) {m[i][j] = rand.Signed(); n[i][j] = rand.Signed();}
+  }
+  real32 s = 0.5;
+
+  // res = m*(a + s*b - c), accumulated so it can't be optimised out...
+  {
+   math::Vect<3,real32> acc(0.0);
+   math::Vect<3,real32> tmp,sum,res;
+   real64 start = time::UltraTime();
+   for (nat32 i=0;i<iters;i++)
+   {
+    tmp = b; tmp *= s;
+    sum = a; sum += tmp; sum -= c;
+    math::MultVect(m,sum,res);
+    acc += res;
+    a[i%3] += 1e-6;
+   }
+   real64 mid = time::UltraTime();
+   for (nat32 i=0;i<iters;i++)
+   {
+    acc += m*(a + s*b - c);
+    a[i%3] -= 1e-6;
+   }
+   real64 end = time::UltraTime();
+   con << "  m*(a + s*b - c): temporaries " << (mid-start) << "s, expression " << (end-mid) << "s (" << acc[0] << ")\n";
+  }
+
+  // out = m*n + n*s, again accumulated...
+  {
+   math::Mat<3,3,real32> acc;
+   math::Zero(acc);
+   math::Mat<3,3,real32> tmp,res;
+   real64 start = time::UltraTime();
+   for (nat32 i=0;i<iters/4;i++)
+   {
+    math::Mult(m,n,res);
+    tmp = n; tmp *= s;
+    res += tmp;
+    acc += res;
+    m[i%3][0] += 1e-6;
+   }
+   real64 mid = time::UltraTime();
+   for (nat32 i=0;i<iters/4;i++)
+   {
+    acc += m*n + n*s;
+    m[i%3][0] -= 1e-6;
+   }
+   real64 end = time::UltraTime();
+   con << "  m*n + n*s: temporaries " << (mid-start) << "s, expression " << (end-mid) << "s (" << acc[0][0] << ")\n";
+  }
+ }
+
+
  con.WaitSize(1);
  return 0;
 }
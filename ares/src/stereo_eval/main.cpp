@@ -0,0 +1,355 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "stereo_eval/presets.h"
+
+//------------------------------------------------------------------------------
+// One image pair of the dataset, with its ground truth...
+struct Example
+{
+ std::string left;
+ std::string right;
+ std::string truth;
+ std::string known; // Empty if every pixel with a truth value is evaluated.
+ real32 scale;
+ int32 minDisp;
+ int32 maxDisp;
+};
+
+// Loads a left or right image, adding the luv field every preset wants...
+static svt::Var * LoadImage(svt::Core & core,const std::string & fn)
+{
+ svt::Var * ret = filter::LoadImageRGB(core,fn.c_str());
+ if (ret==null<svt::Var*>()) return ret;
+
+ bs::ColourLuv luvIni(0.0,0.0,0.0);
+ ret->Add("luv",luvIni);
+ ret->Commit();
+ filter::RGBtoLuv(ret);
+ return ret;
+}
+
+// Loads a Middlebury ground truth, an image where the disparity is the grey
+// level divided by the scale, 0 meaning unknown, optionally with a mask
+// image that is white where pixels are to be evaluated, e.g. nonocc.png.
+// Makes a Var with a "disp" field, negated for the convention of this
+// library, and a "known" field. Returns null on failure...
+static svt::Var * LoadTruth(svt::Core & core,const Example & pair)
+{
+ svt::Var * img = filter::LoadImageL(core,pair.truth.c_str());
+ if (img==null<svt::Var*>()) return img;
+
+ svt::Var * mask = null<svt::Var*>();
+ if (!pair.known.empty())
+ {
+  mask = filter::LoadImageL(core,pair.known.c_str());
+  if ((mask==null<svt::Var*>())||(mask->Size(0)!=img->Size(0))||(mask->Size(1)!=img->Size(1)))
+  {
+   delete mask;
+   delete img;
+   return null<svt::Var*>();
+  }
+ }
+
+ svt::Var * ret = new svt::Var(core);
+ ret->Setup2D(img->Size(0),img->Size(1));
+ real32 dispIni = 0.0;
+ bit knownIni = false;
+ ret->Add("disp",dispIni);
+ ret->Add("known",knownIni);
+ ret->Commit();
+
+ svt::Field<bs::ColourL> l(img,"l");
+ svt::Field<real32> disp(ret,"disp");
+ svt::Field<bit> known(ret,"known");
+ for (nat32 y=0;y<disp.Size(1);y++)
+ {
+  for (nat32 x=0;x<disp.Size(0);x++)
+  {
+   real32 level = math::Round(255.0*l.Get(x,y).l);
+   disp.Get(x,y) = -level/pair.scale;
+   known.Get(x,y) = level>0.5;
+  }
+ }
+
+ if (mask)
+ {
+  svt::Field<bs::ColourL> m(mask,"l");
+  for (nat32 y=0;y<disp.Size(1);y++)
+  {
+   for (nat32 x=0;x<disp.Size(0);x++)
+   {
+    if (m.Get(x,y).l<0.99) known.Get(x,y) = false;
+   }
+  }
+  delete mask;
+ }
+
+ delete img;
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// Totals for a preset over the dataset...
+struct Summary
+{
+ nat32 pairs;
+ nat32 pixels;
+ nat32 bad;
+ nat32 missing;
+ real64 badRateSum;
+ real64 time;
+ nat64 peak;
+};
+
+static void PrintRow(cstrconst image,cstrconst preset,real64 badRate,real64 missingRate,real64 rms,real64 time,nat64 peak,bit peakGood)
+{
+ std::cout << std::setw(16) << image << " " << std::setw(16) << preset << " "
+           << std::setw(8) << std::setprecision(4) << (100.0*badRate) << " "
+           << std::setw(9) << std::setprecision(4) << (100.0*missingRate) << " "
+           << std::setw(8) << std::setprecision(4) << rms << " "
+           << std::setw(9) << std::setprecision(4) << time << " "
+           << std::setw(9) << (peak/(1024*1024)) << (peakGood?"":"*") << "\n";
+}
+
+//------------------------------------------------------------------------------
+int main(int argc,char ** argv)
+{
+ // Parse the options...
+  cstrconst listFn = null<cstrconst>();
+  real32 threshold = 1.0;
+  cstrconst csv = null<cstrconst>();
+  ds::List<cstrconst> only;
+  bit usage = false;
+
+  for (int i=1;i<argc;i++)
+  {
+   if ((str::Compare(argv[i],"-threshold")==0)&&(i+1<argc)) threshold = str::ToReal32(argv[++i]);
+   else if ((str::Compare(argv[i],"-csv")==0)&&(i+1<argc)) csv = argv[++i];
+   else if ((str::Compare(argv[i],"-preset")==0)&&(i+1<argc)) only.AddBack(argv[++i]);
+   else if ((argv[i][0]!='-')&&(listFn==null<cstrconst>())) listFn = argv[i];
+   else usage = true;
+  }
+
+  ds::List<Preset*> all;
+  MakePresets(all);
+
+  if (usage||(listFn==null<cstrconst>()))
+  {
+   std::cout << "Usage:\nstereo_eval [list] <options>\n";
+   std::cout << "Runs stereo presets over a dataset and reports the accuracy, time and memory\n";
+   std::cout << "of each, as a table. Each line of the list is a pair in Middlebury style:\n";
+   std::cout << "  [left] [right] [truth] [scale] [min_disp] [max_disp] <eval_mask>\n";
+   std::cout << "where the truth is an image whose grey level over scale is the disparity, 0\n";
+   std::cout << "being unknown, the range is as for the truth, and the optional mask is white\n";
+   std::cout << "where pixels are evaluated, e.g. nonocc.png.\n";
+   std::cout << "Options:\n";
+   std::cout << "  -threshold [t]  Error above which a pixel is bad, defaults to 1.\n";
+   std::cout << "  -csv [file]  Also writes the table to a csv file, overwriting it.\n";
+   std::cout << "  -preset [name]  Only runs the named preset, can be repeated.\n";
+   std::cout << "Presets:";
+   ds::List<Preset*>::Cursor targ = all.FrontPtr();
+   while (!targ.Bad()) {std::cout << " " << (*targ)->Name(); ++targ;}
+   std::cout << "\n";
+   std::cout << "Peak memory is that used above the loaded images, starred where the OS can't\n";
+   std::cout << "reset its peak, so it is for the whole run so far.\n";
+   return 1;
+  }
+
+
+ // Drop the presets not asked for...
+  ds::List<Preset*> preset;
+  while (all.Size()!=0)
+  {
+   Preset * p = all.Front();
+   all.RemFront();
+
+   bit use = only.Size()==0;
+   ds::List<cstrconst>::Cursor targ = only.FrontPtr();
+   while (!targ.Bad())
+   {
+    if (str::Compare(*targ,p->Name())==0) use = true;
+    ++targ;
+   }
+
+   if (use) preset.AddBack(p);
+       else delete p;
+  }
+
+
+ // Read the list...
+  ds::List<Example> pairs;
+  {
+   std::ifstream list(listFn);
+   if (!list)
+   {
+    std::cout << "Could not open the list\n";
+    return 1;
+   }
+
+   std::string line;
+   while (std::getline(list,line))
+   {
+    std::istringstream parts(line);
+    Example p;
+    if (parts >> p.left >> p.right >> p.truth >> p.scale >> p.minDisp >> p.maxDisp)
+    {
+     if (!(parts >> p.known)) p.known.clear();
+     pairs.AddBack(p);
+    }
+   }
+  }
+
+
+ // Run every preset on every pair...
+  str::TokenTable tt;
+  svt::Core core(tt);
+
+  file::Csv * out = null<file::Csv*>();
+  if (csv)
+  {
+   out = new file::Csv(csv,true);
+   *out << "image" << file::EndField() << "preset" << file::EndField() << "bad" << file::EndField()
+        << "missing" << file::EndField() << "rms" << file::EndField() << "seconds" << file::EndField()
+        << "peak_bytes" << file::EndField() << "peak_reset" << file::EndRow();
+  }
+
+  ds::Array<Summary> sum(preset.Size());
+  for (nat32 i=0;i<sum.Size();i++) mem::Null(&sum[i]);
+
+  std::cout << std::setw(16) << "image" << " " << std::setw(16) << "preset" << " "
+            << std::setw(8) << "bad %" << " " << std::setw(9) << "missing %" << " "
+            << std::setw(8) << "rms" << " " << std::setw(9) << "seconds" << " "
+            << std::setw(9) << "peak MB" << "\n";
+
+  ds::List<Example>::Cursor pt = pairs.FrontPtr();
+  while (!pt.Bad())
+  {
+   const Example & pair = *pt;
+   ++pt;
+
+   svt::Var * left = LoadImage(core,pair.left);
+   svt::Var * right = LoadImage(core,pair.right);
+   svt::Var * truth = LoadTruth(core,pair);
+   if ((left==null<svt::Var*>())||(right==null<svt::Var*>())||(truth==null<svt::Var*>())||
+       (truth->Size(0)!=left->Size(0))||(truth->Size(1)!=left->Size(1)))
+   {
+    std::cout << "Could not load " << pair.left << ", skipping\n";
+    delete left;
+    delete right;
+    delete truth;
+    continue;
+   }
+
+   svt::Field<real32> truthDisp(truth,"disp");
+   svt::Field<bit> truthKnown(truth,"known");
+
+   // Image name for the table, the directory of the left image if it has one,
+   // as Middlebury pairs are all called im2/im6...
+    std::string name = pair.left;
+    std::string::size_type slash = name.find_last_of("/\\");
+    if ((slash!=std::string::npos)&&(slash!=0))
+    {
+     std::string dir = name.substr(0,slash);
+     std::string::size_type prev = dir.find_last_of("/\\");
+     name = (prev==std::string::npos)?dir:dir.substr(prev+1);
+    }
+
+   ds::List<Preset*>::Cursor targ = preset.FrontPtr();
+   for (nat32 p=0;!targ.Bad();p++,++targ)
+   {
+    svt::Var result(core);
+    result.Setup2D(left->Size(0),left->Size(1));
+    real32 dispIni = 0.0;
+    bit validIni = false;
+    result.Add("disp",dispIni);
+    result.Add("valid",validIni);
+    result.Commit();
+    svt::Field<real32> disp(&result,"disp");
+    svt::Field<bit> valid(&result,"valid");
+
+    nat64 base = os::CurrentMemory();
+    bit peakGood = os::ResetPeakMemory();
+
+    real64 start = time::UltraTime();
+    (*targ)->Match(left,right,-pair.maxDisp,-pair.minDisp,disp,valid);
+    real64 taken = time::UltraTime() - start;
+
+    nat64 peak = os::PeakMemory();
+    if (peakGood) peak = (peak>base)?(peak-base):0;
+
+    stereo::DispStats stats;
+    stereo::DispError(disp,valid,truthDisp,truthKnown,threshold,stats);
+    real64 missingRate = (stats.pixels==0)?0.0:(real64(stats.missing)/real64(stats.pixels));
+
+    PrintRow(name.c_str(),(*targ)->Name(),stats.BadRate(),missingRate,stats.rms,taken,peak,peakGood);
+    if (out)
+    {
+     *out << name.c_str() << file::EndField() << (*targ)->Name() << file::EndField()
+          << stats.BadRate() << file::EndField() << missingRate << file::EndField()
+          << stats.rms << file::EndField() << taken << file::EndField()
+          << peak << file::EndField() << peakGood << file::EndRow();
+     out->Flush();
+    }
+
+    sum[p].pairs += 1;
+    sum[p].pixels += stats.pixels;
+    sum[p].bad += stats.bad;
+    sum[p].missing += stats.missing;
+    sum[p].badRateSum += stats.BadRate();
+    sum[p].time += taken;
+    sum[p].peak = math::Max(sum[p].peak,peak);
+   }
+
+   delete left;
+   delete right;
+   delete truth;
+  }
+
+
+ // Summary, the mean bad rate over the pairs, as Middlebury ranks by, the
+ // total time and the largest peak...
+  std::cout << "\n";
+  ds::List<Preset*>::Cursor targ = preset.FrontPtr();
+  for (nat32 p=0;!targ.Bad();p++,++targ)
+  {
+   if (sum[p].pairs==0) continue;
+   real64 missingRate = (sum[p].pixels==0)?0.0:(real64(sum[p].missing)/real64(sum[p].pixels));
+   PrintRow("mean",(*targ)->Name(),sum[p].badRateSum/real64(sum[p].pairs),missingRate,0.0,
+            sum[p].time,sum[p].peak,true);
+  }
+
+
+ // Clean up...
+  delete out;
+  while (preset.Size()!=0)
+  {
+   delete preset.Front();
+   preset.RemFront();
+  }
+
+ return 0;
+}
+
+//------------------------------------------------------------------------------
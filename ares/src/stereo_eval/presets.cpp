@@ -0,0 +1,194 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "stereo_eval/presets.h"
+
+//------------------------------------------------------------------------------
+// DSC settings shared by all the DSI based presets, as BatchMatch...
+static const real32 dscMult = 1.0;
+static const real32 dscCap = 36.0;
+
+// Takes the lowest cost disparity of every pixel of a DSI...
+static void BestDisp(const stereo::DSI & dsi,svt::Field<real32> & disp,svt::Field<bit> & valid)
+{
+ for (nat32 y=0;y<disp.Size(1);y++)
+ {
+  for (nat32 x=0;x<disp.Size(0);x++)
+  {
+   nat32 size = dsi.Size(x,y);
+   disp.Get(x,y) = 0.0;
+   valid.Get(x,y) = size!=0;
+   real32 best = math::Infinity<real32>();
+   for (nat32 i=0;i<size;i++)
+   {
+    if (dsi.Cost(x,y,i)<best)
+    {
+     best = dsi.Cost(x,y,i);
+     disp.Get(x,y) = dsi.Disp(x,y,i);
+    }
+   }
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+// A LevelSolver run through CoarseToFine, 0 levels being a plain full
+// resolution run over the entire range. Optionally left-right checked...
+class LevelPreset : public Preset
+{
+ public:
+  LevelPreset(cstrconst name,stereo::LevelSolver * s,nat32 l,bit c = false,nat32 g = 2,nat32 sp = 1)
+  :Preset(name),solver(s),levels(l),check(c),grow(g),spread(sp) {}
+  ~LevelPreset() {delete solver;}
+
+  void Match(svt::Var * left,svt::Var * right,int32 minDisp,int32 maxDisp,
+             svt::Field<real32> & disp,svt::Field<bit> & valid)
+  {
+   svt::Field<bs::ColourLuv> leftLuv(left,"luv");
+   svt::Field<bs::ColourLuv> rightLuv(right,"luv");
+   stereo::SqrBoundLuvDSC dsc(leftLuv,rightLuv,dscMult,dscCap);
+
+   stereo::CoarseToFine leftC2F;
+   leftC2F.Set(&dsc);
+   leftC2F.Set(solver);
+   leftC2F.SetRange(minDisp,maxDisp);
+   leftC2F.SetLevels(levels);
+   leftC2F.SetGrow(grow,spread);
+   leftC2F.Run();
+
+   if (check)
+   {
+    stereo::SwapDSC swap(&dsc);
+
+    stereo::CoarseToFine rightC2F;
+    rightC2F.Set(&swap);
+    rightC2F.Set(solver);
+    rightC2F.SetRange(-maxDisp,-minDisp);
+    rightC2F.SetLevels(levels);
+    rightC2F.SetGrow(grow,spread);
+    rightC2F.Run();
+
+    stereo::CrossCheck(leftC2F,rightC2F,disp,valid,1.0,stereo::FillBackground);
+   }
+   else BestDisp(leftC2F,disp,valid);
+  }
+
+ private:
+  stereo::LevelSolver * solver;
+  nat32 levels;
+  bit check;
+  nat32 grow;
+  nat32 spread;
+};
+
+//------------------------------------------------------------------------------
+// Hierarchical EBP, as cyclops runs it...
+class HebpPreset : public Preset
+{
+ public:
+  HebpPreset():Preset("hebp") {}
+
+  void Match(svt::Var * left,svt::Var * right,int32 minDisp,int32 maxDisp,
+             svt::Field<real32> & disp,svt::Field<bit> & valid)
+  {
+   svt::Field<bs::ColourLuv> leftLuv(left,"luv");
+   svt::Field<bs::ColourLuv> rightLuv(right,"luv");
+   stereo::SqrBoundLuvDSC dsc(leftLuv,rightLuv,dscMult,dscCap);
+
+   stereo::HEBP hebp;
+   hebp.Set(1.0,-0.1,2.0,8,1);
+   hebp.Set(&dsc);
+   hebp.SetParallel();
+   hebp.Run();
+
+   BestDisp(hebp,disp,valid);
+  }
+};
+
+//------------------------------------------------------------------------------
+// The sad_stereo program - Synergism segments and segment based Sad...
+class SadSegPreset : public Preset
+{
+ public:
+  SadSegPreset():Preset("sad_seg") {}
+
+  void Match(svt::Var * left,svt::Var * right,int32 minDisp,int32 maxDisp,
+             svt::Field<real32> & disp,svt::Field<bit> & valid)
+  {
+   svt::Var work(left->GetCore());
+   work.Setup2D(left->Size(0),left->Size(1));
+    bs::ColourL lIni(0.0);
+    work.Add("l",lIni);
+    nat32 segsIni = 0;
+    work.Add("segs",segsIni);
+   work.Commit();
+
+   svt::Field<bs::ColourRGB> leftRGB(left,"rgb");
+   svt::Field<bs::ColourRGB> rightRGB(right,"rgb");
+   svt::Field<bs::ColourLuv> leftLuv(left,"luv");
+   svt::Field<bs::ColourL> l(&work,"l");
+   filter::RGBtoL(leftRGB,l);
+
+   filter::Synergism syn;
+   syn.SetImage(l,leftLuv);
+   syn.Run();
+   svt::Field<nat32> segs(&work,"segs");
+   syn.GetSegments(segs);
+
+   stereo::SadSegStereo sss;
+   sss.SetSegments(syn.Segments(),segs);
+   for (nat32 c=0;c<3;c++)
+   {
+    svt::Field<real32> lc; leftRGB.SubField(c*sizeof(real32),lc);
+    svt::Field<real32> rc; rightRGB.SubField(c*sizeof(real32),rc);
+    sss.AddField(lc,rc);
+   }
+   sss.SetRange(minDisp,maxDisp);
+   sss.SetMinCluster(32);
+   sss.SetMaxRadius(3);
+   sss.Run();
+
+   sss.GetDisparity(disp);
+   sss.GetMask(valid);
+  }
+};
+
+//------------------------------------------------------------------------------
+void MakePresets(ds::List<Preset*> & out)
+{
+ // SGM, the fast option...
+  out.AddBack(new LevelPreset("sgm8",new stereo::SGMSolver(1.0,8.0,32.0,8),0));
+  out.AddBack(new LevelPreset("sgm16",new stereo::SGMSolver(1.0,8.0,32.0,16),0));
+  out.AddBack(new LevelPreset("sgm8_check",new stereo::SGMSolver(1.0,8.0,32.0,8),0,true));
+  out.AddBack(new LevelPreset("sgm8_c2f",new stereo::SGMSolver(1.0,8.0,32.0,8),2));
+  out.AddBack(new LevelPreset("sgm8_c2f_tight",new stereo::SGMSolver(1.0,8.0,32.0,8),2,false,1,0));
+  out.AddBack(new LevelPreset("sgm8_c2f_check",new stereo::SGMSolver(1.0,8.0,32.0,8),2,true));
+
+ // EBP, the quality option...
+  stereo::EBPSolver ebp;
+  ebp.SetParallel();
+  out.AddBack(new LevelPreset("ebp",ebp.Clone(),0));
+  out.AddBack(new LevelPreset("ebp_c2f",ebp.Clone(),2));
+  out.AddBack(new LevelPreset("ebp_c2f_tight",ebp.Clone(),2,false,1,0));
+  out.AddBack(new HebpPreset());
+
+ // The segment based approach...
+  out.AddBack(new SadSegPreset());
+}
+
+//------------------------------------------------------------------------------
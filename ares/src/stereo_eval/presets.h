@@ -0,0 +1,53 @@
+#ifndef STEREO_EVAL_PRESETS_H
+#define STEREO_EVAL_PRESETS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+// The stereo algorithms and parameter settings that get evaluated, each
+// turning a pair into a disparity map. The DSI based ones all use the
+// SqrBoundLuvDSC that stereo::BatchMatch uses, so only the algorithm differs.
+
+#include "stereo_eval/main.h"
+
+//------------------------------------------------------------------------------
+// A stereo algorithm with its parameters...
+class Preset
+{
+ public:
+   Preset(cstrconst n):name(n) {}
+   virtual ~Preset() {}
+
+   cstrconst Name() const {return name;}
+
+  // Matches the pair, which have "rgb" and "luv" fields, filling in the
+  // disparity and which pixels have one. The range is inclusive, in the
+  // convention of this library...
+   virtual void Match(svt::Var * left,svt::Var * right,int32 minDisp,int32 maxDisp,
+                      svt::Field<real32> & disp,svt::Field<bit> & valid) = 0;
+
+
+ private:
+  cstrconst name;
+};
+
+//------------------------------------------------------------------------------
+// Appends every preset, the caller then owns them...
+void MakePresets(ds::List<Preset*> & out);
+
+//------------------------------------------------------------------------------
+#endif
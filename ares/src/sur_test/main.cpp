@@ -181,6 +181,100 @@ int main()
   }
 
 
+  // Do the same with an IndexedMesh, both levels in one go, plus a flat
+  // subdivision...
+  {
+   sur::IndexedMesh im;
+   im.FromMesh(mesh2);
+
+   sur::IndexedMesh sd;
+   sur::CatmullClark(im,2,sd);
+   file::SaveMesh(sd,"cube-5.obj",true);
+
+   sur::IndexedMesh flat;
+   sur::Subdivide(im,3,flat);
+   file::SaveMesh(flat,"cube-6.obj",true);
+  }
+
+
+  // Cast a ray at the smoothed cube, through a bounding volume hierarchy...
+  {
+   sur::IndexedMesh im;
+   im.FromMesh(mesh2);
+   sur::IndexedMesh sd;
+   sur::CatmullClark(im,3,sd);
+
+   sur::Bvh bvh;
+   bvh.Build(sd);
+
+   bs::Ray ray;
+   ray.s = bs::Vert(5.0,0.1,0.2);
+   ray.n = bs::Vert(-1.0,0.0,0.0);
+   sur::Bvh::Hit hit;
+   if (bvh.Nearest(ray,hit)) con << "Ray hit triangle " << hit.tri << " of " << bvh.TriCount() << " at " << hit.dist << ".\n";
+                        else con << "Ray missed.\n";
+  }
+
+
+  // Benchmark projecting colour between two big meshes, both rippled grids of
+  // about 5 million vertices, the second offset so no vertex lands exactly on a
+  // vertex of the first...
+  {
+   static const nat32 side = 2237;
+   real32 zero = 0.0;
+
+   sur::Mesh from(&tt);
+   sur::Mesh to(&tt);
+   for (nat32 m=0;m<2;m++)
+   {
+    sur::Mesh & targ = (m==0)?from:to;
+    targ.AddVertProp("red",zero);
+    targ.AddVertProp("green",zero);
+    targ.AddVertProp("blue",zero);
+    targ.Commit();
+
+    data::Property<sur::Vertex,real32> red = targ.GetVertProp<real32>("red");
+    data::Property<sur::Vertex,real32> green = targ.GetVertProp<real32>("green");
+    data::Property<sur::Vertex,real32> blue = targ.GetVertProp<real32>("blue");
+
+    real32 offset = (m==0)?0.0:0.37;
+    ds::Array<sur::Vertex> vert(side*side);
+    for (nat32 y=0;y<side;y++)
+    {
+     for (nat32 x=0;x<side;x++)
+     {
+      real32 px = (real32(x)+offset)/real32(side);
+      real32 py = (real32(y)+offset)/real32(side);
+      real32 pz = 0.05*math::Sin(20.0*px)*math::Cos(20.0*py) + ((m==0)?0.0:0.01);
+
+      sur::Vertex & v = vert[y*side+x];
+      v = targ.NewVertex(bs::Vert(px,py,pz));
+      if (m==0)
+      {
+       red.Get(v) = px;
+       green.Get(v) = py;
+       blue.Get(v) = 0.5;
+      }
+     }
+    }
+
+    for (nat32 y=0;y+1<side;y++)
+    {
+     for (nat32 x=0;x+1<side;x++)
+     {
+      targ.NewFace(vert[y*side+x],vert[y*side+x+1],vert[(y+1)*side+x+1],vert[(y+1)*side+x]);
+     }
+    }
+   }
+
+   sur::MeshTransfer mt(from,to);
+   real64 start = time::UltraTime();
+   nat32 done = mt.Project();
+   real64 taken = time::UltraTime() - start;
+   con << "MeshTransfer::Project, " << done << " of " << to.VertexCount() << " vertices: " << taken << " seconds.\n";
+  }
+
+
  delete asSvt;
  con << "Done.\n";
  return 0;
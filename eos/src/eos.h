@@ -88,6 +88,7 @@
 #include "eos/io/functions.h"
 
 #include "eos/log/logs.h"
+#include "eos/log/profile.h"
 
 #include "eos/bs/colours.h"
 #include "eos/bs/geo2d.h"
@@ -101,12 +102,17 @@
 #include "eos/ds/arrays2d.h"
 #include "eos/ds/stacks.h"
 #include "eos/ds/queues.h"
+#include "eos/ds/concurrent_queues.h"
+#include "eos/ds/lazy_heaps.h"
+#include "eos/ds/index_heaps.h"
 #include "eos/ds/lists.h"
 #include "eos/ds/sort_lists.h"
 #include "eos/ds/priority_queues.h"
 #include "eos/ds/sparse_hash.h"
 #include "eos/ds/dense_hash.h"
+#include "eos/ds/flat_hash.h"
 #include "eos/ds/graphs.h"
+#include "eos/ds/csr_graphs.h"
 #include "eos/ds/voronoi.h"
 #include "eos/ds/kd_tree.h"
 #include "eos/ds/scheduling.h"
@@ -122,6 +128,7 @@
 
 #include "eos/math/constants.h"
 #include "eos/math/functions.h"
+#include "eos/math/expressions.h"
 #include "eos/math/vectors.h"
 #include "eos/math/matrices.h"
 #include "eos/math/mat_ops.h"
@@ -133,13 +140,17 @@
 #include "eos/math/gaussian_mix.h"
 #include "eos/math/interpolation.h"
 #include "eos/math/distance.h"
+#include "eos/math/dist_trans.h"
 #include "eos/math/svd.h"
 #include "eos/math/func.h"
 #include "eos/math/bessel.h"
 #include "eos/math/stats_dir.h"
+#include "eos/math/sparse.h"
+#include "eos/math/compact.h"
 
 #include "eos/time/times.h"
 #include "eos/time/progress.h"
+#include "eos/time/startup.h"
 #include "eos/time/format.h"
 
 #include "eos/data/blocks.h"
@@ -164,6 +175,7 @@
 #include "eos/file/ply.h"
 #include "eos/file/meshes.h"
 #include "eos/file/exif.h"
+#include "eos/file/manifest.h"
 
 #include "eos/svt/core.h"
 #include "eos/svt/node.h"
@@ -174,6 +186,11 @@
 #include "eos/svt/file.h"
 #include "eos/svt/calculation.h"
 #include "eos/svt/sample.h"
+#include "eos/svt/tiled.h"
+#include "eos/svt/cache.h"
+#include "eos/svt/plugins.h"
+#include "eos/svt/pipeline.h"
+#include "eos/svt/remote.h"
 
 #include "eos/alg/mean_shift.h"
 #include "eos/alg/fitting.h"
@@ -211,6 +228,8 @@
 #include "eos/filter/smoothing.h"
 #include "eos/filter/mscr.h"
 #include "eos/filter/seg_k_mean_grid.h"
+#include "eos/filter/integral.h"
+#include "eos/filter/permutohedral.h"
 
 #include "eos/stereo/sad.h"
 #include "eos/stereo/sad_seg_stereo.h"
@@ -236,6 +255,11 @@
 #include "eos/stereo/dsr.h"
 #include "eos/stereo/hebp.h"
 #include "eos/stereo/diffuse_correlation.h"
+#include "eos/stereo/sgm.h"
+#include "eos/stereo/coarse_to_fine.h"
+#include "eos/stereo/batch.h"
+#include "eos/stereo/sequence.h"
+#include "eos/stereo/dsc_dispatch.h"
 
 #include "eos/mya/surfaces.h"
 #include "eos/mya/ied.h"
@@ -276,6 +300,7 @@
 #include "eos/cam/resectioning.h"
 #include "eos/cam/make_disp.h"
 #include "eos/cam/cam_render.h"
+#include "eos/cam/rig_cache.h"
 
 #include "eos/gui/base.h"
 #include "eos/gui/callbacks.h"
@@ -287,6 +312,7 @@
 #include "eos/inf/fg_vars.h"
 #include "eos/inf/factor_graphs.h"
 #include "eos/inf/field_graphs.h"
+#include "eos/inf/grid_graphs.h"
 #include "eos/inf/fig_variables.h"
 #include "eos/inf/fig_factors.h"
 #include "eos/inf/gauss_integration.h"
@@ -295,11 +321,16 @@
 #include "eos/inf/bin_bp_2d.h"
 
 #include "eos/os/cameras.h"
+#include "eos/os/capture_pipeline.h"
+#include "eos/os/compute.h"
 #include "eos/os/console.h"
 #include "eos/os/command.h"
+#include "eos/os/sockets.h"
+#include "eos/os/memory.h"
 
 #include "eos/mt/threads.h"
 #include "eos/mt/locks.h"
+#include "eos/mt/tasks.h"
 
 #include "eos/sur/mesh.h"
 #include "eos/sur/mesh_iter.h"
@@ -308,6 +339,10 @@
 #include "eos/sur/intersection.h"
 #include "eos/sur/subdivide.h"
 #include "eos/sur/simplify.h"
+#include "eos/sur/indexed_mesh.h"
+#include "eos/sur/indexed_subdivide.h"
+#include "eos/sur/bvh.h"
+#include "eos/sur/grid_mesh.h"
 
 #include "eos/sfs/worthington.h"
 #include "eos/sfs/lambertian_fit.h"
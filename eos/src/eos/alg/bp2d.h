@@ -30,9 +30,15 @@
 #include "eos/svt/var.h"
 #include "eos/svt/field.h"
 #include "eos/math/mat_ops.h"
+#include "eos/math/dist_trans.h"
 #include "eos/time/progress.h"
 #include "eos/mem/alloc.h"
 #include "eos/ds/arrays2d.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE__
+ #include <xmmintrin.h>
+#endif
 
 namespace eos
 {
@@ -97,6 +103,97 @@ class EOS_CLASS MsgBP2D
    nat32 Label(nat32 x,nat32 y,real32 * in[4],real32 * out);
 };
 
+//------------------------------------------------------------------------------
+// Helper for the MsgBP2D implimentors - the loops over labels that all the
+// message calculators share. L is the label count if known at compile time, so
+// the loops can be unrolled, or 0 to use the labels given at runtime. Uses SSE
+// for blocks of 4 labels where available, so the results only depend on the
+// label count and not if it was fixed. The implimentors have a MsgL<L> method
+// that the Msg method calls with the common sizes fixed...
+template <nat32 L>
+class EOS_CLASS BP2DKernel
+{
+ public:
+  // Sets out to d plus the 3 in messages...
+   static inline void Gather(nat32 labels,const real32 * d,real32 * in[3],real32 * out)
+   {
+    const nat32 n = (L==0)?labels:L;
+    nat32 i = 0;
+    #ifdef __SSE__
+     for (;i+4<=n;i+=4)
+     {
+      __m128 v = _mm_add_ps(_mm_loadu_ps(d+i),_mm_loadu_ps(in[0]+i));
+      v = _mm_add_ps(v,_mm_loadu_ps(in[1]+i));
+      _mm_storeu_ps(out+i,_mm_add_ps(v,_mm_loadu_ps(in[2]+i)));
+     }
+    #endif
+    for (;i<n;i++) out[i] = d[i] + in[0][i] + in[1][i] + in[2][i];
+   }
+
+  // Returns the minimum of a[i] + b[i], b can be null for just the minimum of a...
+   static inline real32 MinSum(nat32 labels,const real32 * a,const real32 * b)
+   {
+    const nat32 n = (L==0)?labels:L;
+    nat32 i = 0;
+    real32 ret = b?(a[0]+b[0]):a[0];
+    #ifdef __SSE__
+     if (n>=4)
+     {
+      __m128 best = b?_mm_add_ps(_mm_loadu_ps(a),_mm_loadu_ps(b)):_mm_loadu_ps(a);
+      for (i=4;i+4<=n;i+=4)
+      {
+       __m128 v = b?_mm_add_ps(_mm_loadu_ps(a+i),_mm_loadu_ps(b+i)):_mm_loadu_ps(a+i);
+       best = _mm_min_ps(best,v);
+      }
+      best = _mm_min_ps(best,_mm_movehl_ps(best,best));
+      best = _mm_min_ss(best,_mm_shuffle_ps(best,best,1));
+      _mm_store_ss(&ret,best);
+     }
+    #endif
+    for (;i<n;i++) ret = math::Min(ret,b?(a[i]+b[i]):a[i]);
+    return ret;
+   }
+
+  // Caps every value of out at the given maximum...
+   static inline void Cap(nat32 labels,real32 * out,real32 cap)
+   {
+    const nat32 n = (L==0)?labels:L;
+    nat32 i = 0;
+    #ifdef __SSE__
+     __m128 c = _mm_set1_ps(cap);
+     for (;i+4<=n;i+=4) _mm_storeu_ps(out+i,_mm_min_ps(_mm_loadu_ps(out+i),c));
+    #endif
+    for (;i<n;i++) out[i] = math::Min(out[i],cap);
+   }
+
+  // Offsets out so its mean is zero...
+   static inline void ZeroMean(nat32 labels,real32 * out)
+   {
+    const nat32 n = (L==0)?labels:L;
+    nat32 i = 0;
+    real32 sum = 0.0;
+    #ifdef __SSE__
+     if (n>=4)
+     {
+      __m128 s = _mm_loadu_ps(out);
+      for (i=4;i+4<=n;i+=4) s = _mm_add_ps(s,_mm_loadu_ps(out+i));
+      s = _mm_add_ps(s,_mm_movehl_ps(s,s));
+      s = _mm_add_ss(s,_mm_shuffle_ps(s,s,1));
+      _mm_store_ss(&sum,s);
+     }
+    #endif
+    for (;i<n;i++) sum += out[i];
+    sum /= real32(n);
+
+    i = 0;
+    #ifdef __SSE__
+     __m128 m = _mm_set1_ps(sum);
+     for (;i+4<=n;i+=4) _mm_storeu_ps(out+i,_mm_sub_ps(_mm_loadu_ps(out+i),m));
+    #endif
+    for (;i<n;i++) out[i] -= sum;
+   }
+};
+
 //------------------------------------------------------------------------------
 /// The most basic of possible MsgBP2D classes, is simply given a D and V function
 /// from which it calculates messages. It does cache both given functions however.
@@ -164,8 +261,6 @@ class EOS_CLASS AnyMsgBP2D : public MsgBP2D<PT>
      for (nat32 l1=0;l1<labels;l1++) cacheV[labels*l2 + l1] = V(data,l1,l2);
     }
     
-   // A tempory variable used within methods...
-    temp.SetSize(labels);
   }
   
   ~AnyMsgBP2D()
@@ -178,29 +273,40 @@ class EOS_CLASS AnyMsgBP2D : public MsgBP2D<PT>
   
   void Msg(nat32 x,nat32 y,nat32 level,real32 * in[3],real32 * out)
   {
-   // First calculate the costs for each label of the D function and message alone...    
-    for (nat32 i=0;i<labels;i++)
+   // Fix the label count at compile time for the common sizes...
+    switch (labels)
     {
-     temp[i] = cacheD[level][labels*(y*(width>>level) + x) + i];
-     for (nat32 j=0;j<3;j++) temp[i] += in[j][i];
+     case 2: MsgL<2>(x,y,level,in,out); break;
+     case 4: MsgL<4>(x,y,level,in,out); break;
+     case 8: MsgL<8>(x,y,level,in,out); break;
+     case 16: MsgL<16>(x,y,level,in,out); break;
+     case 32: MsgL<32>(x,y,level,in,out); break;
+     case 64: MsgL<64>(x,y,level,in,out); break;
+     default: MsgL<0>(x,y,level,in,out); break;
     }
+  }
+
+  template <nat32 L>
+  void MsgL(nat32 x,nat32 y,nat32 level,real32 * in[3],real32 * out)
+  {
+   typedef BP2DKernel<L> K;
+   const nat32 n = (L==0)?labels:L;
+
+   // Tempory storage is on the stack where possible, as this can be called by
+   // several threads at once...
+    real32 tempBuf[(L==0)?256:L];
+    real32 * temp = (n<=((L==0)?256:L))?tempBuf:mem::Malloc<real32>(n);
+
+   // First calculate the costs for each label of the D function and message alone...    
+    K::Gather(n,&cacheD[level][n*(y*(width>>level) + x)],in,temp);
     
    // Then find the minimum for each field considering the V function...
-    for (nat32 j=0;j<labels;j++)
-    {
-     out[j] = temp[0] + cacheV[labels*j];
-     for (nat32 i=1;i<labels;i++)
-     {
-      real32 val = temp[i] + cacheV[labels*j + i];
-      if (val<out[j]) out[j] = val;	     
-     }	    
-    }
+    for (nat32 j=0;j<n;j++) out[j] = K::MinSum(n,temp,&cacheV[n*j]);
     
    // And zero mean the vector...
-    real32 sum = 0.0;
-    for (nat32 i=0;i<labels;i++) sum += out[i];
-    sum /= real32(labels);
-    for (nat32 i=0;i<labels;i++) out[i] -= sum;
+    K::ZeroMean(n,out);
+
+    if (temp!=tempBuf) mem::Free(temp);
   }
   
   nat32 Label(nat32 x,nat32 y,real32 * in[4],real32 * out)
@@ -241,8 +347,6 @@ class EOS_CLASS AnyMsgBP2D : public MsgBP2D<PT>
   // Creates math::Min(TopBit(width),TopBit(height)) levels in cacheD.
   real32 ** cacheD; // cacheD[level][labels*(y*(width>>level)+x)+label];
   real32 * cacheV; // cacheV[labels*lab2 + lab1].
-  
-  math::Vector<real32> temp;
 };
 
 //------------------------------------------------------------------------------
@@ -317,26 +421,35 @@ class EOS_CLASS PottsMsgBP2D : public MsgBP2D<PT>
   
   void Msg(nat32 x,nat32 y,nat32 level,real32 * in[3],real32 * out)
   {
-   // First calculate the costs for each label of the D function and message alone...    
-    for (nat32 i=0;i<labels;i++)
+    switch (labels)
     {
-     out[i] = cacheD[level][labels*(y*(width>>level) + x) + i];
-     for (nat32 j=0;j<3;j++) out[i] += in[j][i];
+     case 2: MsgL<2>(x,y,level,in,out); break;
+     case 4: MsgL<4>(x,y,level,in,out); break;
+     case 8: MsgL<8>(x,y,level,in,out); break;
+     case 16: MsgL<16>(x,y,level,in,out); break;
+     case 32: MsgL<32>(x,y,level,in,out); break;
+     case 64: MsgL<64>(x,y,level,in,out); break;
+     default: MsgL<0>(x,y,level,in,out); break;
     }
+  }
+
+  template <nat32 L>
+  void MsgL(nat32 x,nat32 y,nat32 level,real32 * in[3],real32 * out)
+  {
+   typedef BP2DKernel<L> K;
+   const nat32 n = (L==0)?labels:L;
+
+   // First calculate the costs for each label of the D function and message alone...    
+    K::Gather(n,&cacheD[level][n*(y*(width>>level) + x)],in,out);
     
    // Find the minimum of the temp array + diffCost...
-    real32 minDiff = out[0];
-    for (nat32 i=1;i<labels;i++) minDiff = math::Min(minDiff,out[i]);
-    minDiff += diffCost;
+    real32 minDiff = K::MinSum(n,out,null<real32*>()) + diffCost;
         
    // Then find the minimum for each field considering the V function...
-    for (nat32 i=0;i<labels;i++) out[i] = math::Min(out[i],minDiff);     
+    K::Cap(n,out,minDiff);
 
    // And zero mean the vector...
-    real32 sum = 0.0;
-    for (nat32 i=0;i<labels;i++) sum += out[i];
-    sum /= real32(labels);
-    for (nat32 i=0;i<labels;i++) out[i] -= sum;
+    K::ZeroMean(n,out);
   }
   
   nat32 Label(nat32 x,nat32 y,real32 * in[4],real32 * out)
@@ -452,22 +565,32 @@ class EOS_CLASS LinearMsgBP2D : public MsgBP2D<PT>
   
   void Msg(nat32 x,nat32 y,nat32 level,real32 * in[3],real32 * out)
   {
-   // First calculate the costs for each label of the D function and message alone...    
-    for (nat32 i=0;i<labels;i++)
+    switch (labels)
     {
-     out[i] = cacheD[level][labels*(y*(width>>level) + x) + i];
-     for (nat32 j=0;j<3;j++) out[i] += in[j][i];
+     case 2: MsgL<2>(x,y,level,in,out); break;
+     case 4: MsgL<4>(x,y,level,in,out); break;
+     case 8: MsgL<8>(x,y,level,in,out); break;
+     case 16: MsgL<16>(x,y,level,in,out); break;
+     case 32: MsgL<32>(x,y,level,in,out); break;
+     case 64: MsgL<64>(x,y,level,in,out); break;
+     default: MsgL<0>(x,y,level,in,out); break;
     }
+  }
 
-   // Make two passes over the output array to apply the linear constraint...
-    for (nat32 i=1;i<labels;i++) out[i] = math::Min(out[i],out[i-1]+linMult);
-    for (int32 i=labels-2;i>=0;i--) out[i] = math::Min(out[i],out[i+1]+linMult);
+  template <nat32 L>
+  void MsgL(nat32 x,nat32 y,nat32 level,real32 * in[3],real32 * out)
+  {
+   typedef BP2DKernel<L> K;
+   const nat32 n = (L==0)?labels:L;
+
+   // First calculate the costs for each label of the D function and message alone...    
+    K::Gather(n,&cacheD[level][n*(y*(width>>level) + x)],in,out);
+
+   // Apply the linear constraint, as a distance transform...
+    math::DistTransLinear(out,n,linMult);
 
    // And zero mean the vector...
-    real32 sum = 0.0;
-    for (nat32 i=0;i<labels;i++) sum += out[i];
-    sum /= real32(labels);
-    for (nat32 i=0;i<labels;i++) out[i] -= sum;
+    K::ZeroMean(n,out);
   }
   
   nat32 Label(nat32 x,nat32 y,real32 * in[4],real32 * out)
@@ -586,30 +709,32 @@ class EOS_CLASS TruncLinearMsgBP2D : public MsgBP2D<PT>
   
   void Msg(nat32 x,nat32 y,nat32 level,real32 * in[3],real32 * out)
   {
-   // First calculate the costs for each label of the D function and message alone...    
-    for (nat32 i=0;i<labels;i++)
+    switch (labels)
     {
-     out[i] = cacheD[level][labels*(y*(width>>level) + x) + i];
-     for (nat32 j=0;j<3;j++) out[i] += in[j][i];
+     case 2: MsgL<2>(x,y,level,in,out); break;
+     case 4: MsgL<4>(x,y,level,in,out); break;
+     case 8: MsgL<8>(x,y,level,in,out); break;
+     case 16: MsgL<16>(x,y,level,in,out); break;
+     case 32: MsgL<32>(x,y,level,in,out); break;
+     case 64: MsgL<64>(x,y,level,in,out); break;
+     default: MsgL<0>(x,y,level,in,out); break;
     }
+  }
+
+  template <nat32 L>
+  void MsgL(nat32 x,nat32 y,nat32 level,real32 * in[3],real32 * out)
+  {
+   typedef BP2DKernel<L> K;
+   const nat32 n = (L==0)?labels:L;
+
+   // First calculate the costs for each label of the D function and message alone...    
+    K::Gather(n,&cacheD[level][n*(y*(width>>level) + x)],in,out);
     
-   // Find the minimum with linTrunc added...
-    real32 maxVal = out[0];
-    for (nat32 i=1;i<labels;i++) maxVal = math::Min(maxVal,out[i]);
-    maxVal += linTrunc;
-     
-   // Make two passes over the output array to apply the linear constraint...
-    for (nat32 i=1;i<labels;i++) out[i] = math::Min(out[i],out[i-1]+linMult);
-    for (int32 i=labels-2;i>=0;i--) out[i] = math::Min(out[i],out[i+1]+linMult);
-    
-   // Apply the truncation...
-    for (nat32 i=0;i<labels;i++) out[i] = math::Min(out[i],maxVal);
+   // Apply the truncated linear constraint, as a distance transform...
+    math::DistTransTruncLinear(out,n,linMult,linTrunc);
 
    // And zero mean the vector...
-    real32 sum = 0.0;
-    for (nat32 i=0;i<labels;i++) sum += out[i];
-    sum /= real32(labels);
-    for (nat32 i=0;i<labels;i++) out[i] -= sum;
+    K::ZeroMean(n,out);
   }
   
   nat32 Label(nat32 x,nat32 y,real32 * in[4],real32 * out)
@@ -653,6 +778,130 @@ class EOS_CLASS TruncLinearMsgBP2D : public MsgBP2D<PT>
   real32 linTrunc;
 };
 
+//------------------------------------------------------------------------------
+// Helper for BP2D and HBP2D - updates all the messages sent by the nodes of one
+// colour of the checkerboard for a range of rows. As nodes only read messages
+// stored at nodes of the other colour any set of rows can be done at the same
+// time as any other, which is how the multi-threaded mode works...
+template <typename MSGBP>
+class EOS_CLASS BP2DRows
+{
+ public:
+  MSGBP * msg;
+  real32 * md; // Indexed as [labels*(4*(stride*y + x) + dir) + label].
+  real32 * zeroMsg;
+  nat32 labels;
+  nat32 stride; // Width at level 0.
+  nat32 width; // Width and height at the current level.
+  nat32 height;
+  nat32 level;
+  nat32 parity; // Which colour to update.
+
+  void operator()(nat32 y0,nat32 y1)
+  {
+   enum Dir {north,east,south,west}; // +ve x = east; +ve y = north.
+
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=((y+parity)%2);x<width;x+=2)
+    {
+     real32 * rm[3];
+
+     if (x!=0) rm[0] = &md[labels*(4*(stride*y + x-1) + east)];
+          else rm[0] = zeroMsg;
+     if (x!=width-1) rm[1] = &md[labels*(4*(stride*y + x+1) + west)];
+                else rm[1] = zeroMsg;
+     if (y!=0) rm[2] = &md[labels*(4*(stride*(y-1) + x) + north)];
+          else rm[2] = zeroMsg;
+     msg->Msg(x,y,level,rm,&md[labels*(4*(stride*y + x) + north)]);
+
+     if (x!=0) rm[0] = &md[labels*(4*(stride*y + x-1) + east)];
+          else rm[0] = zeroMsg;
+     if (x!=width-1) rm[1] = &md[labels*(4*(stride*y + x+1) + west)];
+                else rm[1] = zeroMsg;
+     if (y!=height-1) rm[2] = &md[labels*(4*(stride*(y+1) + x) + south)];
+                 else rm[2] = zeroMsg;
+     msg->Msg(x,y,level,rm,&md[labels*(4*(stride*y + x) + south)]);
+
+     if (x!=0) rm[0] = &md[labels*(4*(stride*y + x-1) + east)];
+          else rm[0] = zeroMsg;
+     if (y!=0) rm[1] = &md[labels*(4*(stride*(y-1) + x) + north)];
+          else rm[1] = zeroMsg;
+     if (y!=height-1) rm[2] = &md[labels*(4*(stride*(y+1) + x) + south)];
+                 else rm[2] = zeroMsg;
+     msg->Msg(x,y,level,rm,&md[labels*(4*(stride*y + x) + east)]);
+
+     if (x!=width-1) rm[0] = &md[labels*(4*(stride*y + x+1) + west)];
+                else rm[0] = zeroMsg;
+     if (y!=0) rm[1] = &md[labels*(4*(stride*(y-1) + x) + north)];
+          else rm[1] = zeroMsg;
+     if (y!=height-1) rm[2] = &md[labels*(4*(stride*(y+1) + x) + south)];
+                 else rm[2] = zeroMsg;
+     msg->Msg(x,y,level,rm,&md[labels*(4*(stride*y + x) + west)]);
+    }
+   }
+  }
+
+  // Runs either directly or with the given pool, if its not null...
+   void Go(mt::TaskPool * pool)
+   {
+    if (pool) mt::ParallelFor(0,height,*this,4,*pool);
+         else (*this)(0,height);
+   }
+};
+
+// Helper for BP2D and HBP2D - extracts the final labeling for a range of rows...
+template <typename MSGBP>
+class EOS_CLASS BP2DLabels
+{
+ public:
+  MSGBP * msg;
+  real32 * md;
+  real32 * zeroMsg;
+  nat32 labels;
+  svt::Field<nat32> * out;
+  svt::Field<real32> * dOut;
+
+  void operator()(nat32 y0,nat32 y1)
+  {
+   enum Dir {north,east,south,west};
+
+   real32 * costOut = null<real32*>();
+   if (dOut->Valid()) costOut = mem::Malloc<real32>(labels);
+
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=0;x<out->Size(0);x++)
+    {
+     real32 * rm[4];
+      if (x!=0) rm[0] = &md[labels*(4*(out->Size(0)*y + x-1) + east)];
+           else rm[0] = zeroMsg;
+      if (x!=out->Size(0)-1) rm[1] = &md[labels*(4*(out->Size(0)*y + x+1) + west)];
+                        else rm[1] = zeroMsg;
+      if (y!=0) rm[2] = &md[labels*(4*(out->Size(0)*(y-1) + x) + north)];
+           else rm[2] = zeroMsg;
+      if (y!=out->Size(1)-1) rm[3] = &md[labels*(4*(out->Size(0)*(y+1) + x) + south)];
+                        else rm[3] = zeroMsg;
+
+     out->Get(x,y) = msg->Label(x,y,rm,costOut);
+
+     if (costOut)
+     {
+      for (nat32 l=0;l<labels;l++) dOut->Get(x,y,l) = costOut[l];
+     }
+    }
+   }
+
+   if (costOut) mem::Free(costOut);
+  }
+
+  void Go(mt::TaskPool * pool)
+  {
+   if (pool) mt::ParallelFor(0,out->Size(1),*this,4,*pool);
+        else (*this)(0,out->Size(1));
+  }
+};
+
 //------------------------------------------------------------------------------
 /// This is a basic loopy max product 2d grid BP implimentation. It is included for
 /// comparing the hierachical version against, to check its correctness.
@@ -718,8 +967,10 @@ class EOS_CLASS BP2D
    }
   
   /// Runs the algorithm, providing a progress report. The given output field will
-  /// contain the results once this returns.
-   void Run(time::Progress * prog = null<time::Progress*>())
+  /// contain the results once this returns. If given a pool the rows of each
+  /// half of the checkerboard are split between its threads, giving the
+  /// exact same answer as when run without.
+   void Run(time::Progress * prog = null<time::Progress*>(),mt::TaskPool * pool = null<mt::TaskPool*>())
    {
     prog->Push();    
     
@@ -729,8 +980,6 @@ class EOS_CLASS BP2D
      real32 * md = mem::Malloc<real32>(out.Size(0)*out.Size(1)*4*labels);
      for (nat32 i=0;i<out.Size(0)*out.Size(1)*4*labels;i++) md[i] = 0.0;          
      
-     enum Dir {north,east,south,west}; // +ve x = east; +ve y = north.
-     
     // Zeroed out message, used for the border...
      real32 * zeroMsg = mem::Malloc<real32>(labels);
      for (nat32 i=0;i<labels;i++) zeroMsg[i] = 0.0;
@@ -740,80 +989,36 @@ class EOS_CLASS BP2D
      MSGBP msg(*pt,out.Size(0),out.Size(1),labels,false);
     
     // Do the iterations, updating the messages in the checkboard pattern...
+     BP2DRows<MSGBP> rows;
+     rows.msg = &msg;
+     rows.md = md;
+     rows.zeroMsg = zeroMsg;
+     rows.labels = labels;
+     rows.stride = out.Size(0);
+     rows.width = out.Size(0);
+     rows.height = out.Size(1);
+     rows.level = 0;
+
      for (nat32 i=0;i<iters;i++)
      {
       prog->Report(i+2,iters+3);
-      for (nat32 y=0;y<out.Size(1);y++)
-      {
-       for (nat32 x=((y+i)%2);x<out.Size(0);x+=2)
-       {
-        real32 * rm[3];
-        
-        if (x!=0) rm[0] = &md[labels*(4*(out.Size(0)*y + x-1) + east)];
-             else rm[0] = zeroMsg;
-        if (x!=out.Size(0)-1) rm[1] = &md[labels*(4*(out.Size(0)*y + x+1) + west)];
-                         else rm[1] = zeroMsg;
-        if (y!=0) rm[2] = &md[labels*(4*(out.Size(0)*(y-1) + x) + north)];
-             else rm[2] = zeroMsg;
-	msg.Msg(x,y,0,rm,&md[labels*(4*(out.Size(0)*y + x) + north)]);
-	       
-        if (x!=0) rm[0] = &md[labels*(4*(out.Size(0)*y + x-1) + east)];
-             else rm[0] = zeroMsg;
-        if (x!=out.Size(0)-1) rm[1] = &md[labels*(4*(out.Size(0)*y + x+1) + west)];
-                         else rm[1] = zeroMsg;
-        if (y!=out.Size(1)-1) rm[2] = &md[labels*(4*(out.Size(0)*(y+1) + x) + south)];
-                         else rm[2] = zeroMsg;
-	msg.Msg(x,y,0,rm,&md[labels*(4*(out.Size(0)*y + x) + south)]);
-	       
-        if (x!=0) rm[0] = &md[labels*(4*(out.Size(0)*y + x-1) + east)];
-             else rm[0] = zeroMsg;
-        if (y!=0) rm[1] = &md[labels*(4*(out.Size(0)*(y-1) + x) + north)];
-             else rm[1] = zeroMsg;
-        if (y!=out.Size(1)-1) rm[2] = &md[labels*(4*(out.Size(0)*(y+1) + x) + south)];
-                         else rm[2] = zeroMsg;
-	msg.Msg(x,y,0,rm,&md[labels*(4*(out.Size(0)*y + x) + east)]);
-	
-        if (x!=out.Size(0)-1) rm[0] = &md[labels*(4*(out.Size(0)*y + x+1) + west)];
-                         else rm[0] = zeroMsg;
-        if (y!=0) rm[1] = &md[labels*(4*(out.Size(0)*(y-1) + x) + north)];
-             else rm[1] = zeroMsg;
-        if (y!=out.Size(1)-1) rm[2] = &md[labels*(4*(out.Size(0)*(y+1) + x) + south)];
-                         else rm[2] = zeroMsg;
-	msg.Msg(x,y,0,rm,&md[labels*(4*(out.Size(0)*y + x) + west)]);
-       }
-      }
+      rows.parity = i;
+      rows.Go(pool);
      }
     
     // Extract the final labeling...
      prog->Report(iters+2,iters+3);
-     real32 * costOut = null<real32*>();
-     if (dOut.Valid()) costOut = mem::Malloc<real32>(labels);
-     
-     for (nat32 y=0;y<out.Size(1);y++)
-     {
-      for (nat32 x=0;x<out.Size(0);x++)
-      {
-       real32 * rm[4];
-        if (x!=0) rm[0] = &md[labels*(4*(out.Size(0)*y + x-1) + east)];
-             else rm[0] = zeroMsg;
-        if (x!=out.Size(0)-1) rm[1] = &md[labels*(4*(out.Size(0)*y + x+1) + west)];
-                         else rm[1] = zeroMsg;
-        if (y!=0) rm[2] = &md[labels*(4*(out.Size(0)*(y-1) + x) + north)];
-             else rm[2] = zeroMsg;
-        if (y!=out.Size(1)-1) rm[3] = &md[labels*(4*(out.Size(0)*(y+1) + x) + south)];
-                         else rm[3] = zeroMsg;
-
-       out.Get(x,y) = msg.Label(x,y,rm,costOut);
-
-       if (costOut)
-       {
-        for (nat32 l=0;l<labels;l++) dOut.Get(x,y,l) = costOut[l];
-       }
-      }
-     }
+     BP2DLabels<MSGBP> lab;
+     lab.msg = &msg;
+     lab.md = md;
+     lab.zeroMsg = zeroMsg;
+     lab.labels = labels;
+     lab.out = &out;
+     lab.dOut = &dOut;
+     lab.Go(pool);
      
-     if (costOut) mem::Free(costOut);
      mem::Free(zeroMsg);
+     mem::Free(md);
     
     prog->Pop();
    }
@@ -906,8 +1111,10 @@ class EOS_CLASS HBP2D
    }
   
   /// Runs the algorithm, providing a progress report. The given output field will
-  /// contain the results once this returns.
-   void Run(time::Progress * prog = null<time::Progress*>())
+  /// contain the results once this returns. If given a pool the rows of each
+  /// half of the checkerboard are split between its threads, giving the
+  /// exact same answer as when run without.
+   void Run(time::Progress * prog = null<time::Progress*>(),mt::TaskPool * pool = null<mt::TaskPool*>())
    {
     prog->Push();    
     
@@ -919,8 +1126,6 @@ class EOS_CLASS HBP2D
      real32 * md = mem::Malloc<real32>(out.Size(0)*out.Size(1)*4*labels);
      for (nat32 i=0;i<out.Size(0)*out.Size(1)*4*labels;i++) md[i] = 0.0;     
      
-     enum Dir {north,east,south,west}; // +ve x = east; +ve y = north.
-     
     // Zeroed out message, used for the border...
      real32 * zeroMsg = mem::Malloc<real32>(labels);
      for (nat32 i=0;i<labels;i++) zeroMsg[i] = 0.0;     
@@ -936,49 +1141,22 @@ class EOS_CLASS HBP2D
       nat32 level = (levelCount-1) - i;
       nat32 width = out.Size(0)>>level;
       nat32 height = out.Size(1)>>level;
+      BP2DRows<MSGBP> rows;
+      rows.msg = &msg;
+      rows.md = md;
+      rows.zeroMsg = zeroMsg;
+      rows.labels = labels;
+      rows.stride = out.Size(0);
+      rows.width = width;
+      rows.height = height;
+      rows.level = level;
+
       for (nat32 j=0;j<levelIters;j++)
       {
        prog->Report(2+i*levelIters+j,levelCount*levelIters+3);
        // Do the messages for this level...
-       	for (nat32 y=0;y<height;y++)
-        {
-         for (nat32 x=((y+j)%2);x<width;x+=2)
-         {
-	  real32 * rm[3];
-        
-          if (x!=0) rm[0] = &md[labels*(4*(out.Size(0)*y + x-1) + east)];
-               else rm[0] = zeroMsg;
-          if (x!=width-1) rm[1] = &md[labels*(4*(out.Size(0)*y + x+1) + west)];
-                     else rm[1] = zeroMsg;
-          if (y!=0) rm[2] = &md[labels*(4*(out.Size(0)*(y-1) + x) + north)];
-               else rm[2] = zeroMsg;
-	  msg.Msg(x,y,level,rm,&md[labels*(4*(out.Size(0)*y + x) + north)]);
-	         
-          if (x!=0) rm[0] = &md[labels*(4*(out.Size(0)*y + x-1) + east)];
-               else rm[0] = zeroMsg;
-          if (x!=width-1) rm[1] = &md[labels*(4*(out.Size(0)*y + x+1) + west)];
-                     else rm[1] = zeroMsg;
-          if (y!=height-1) rm[2] = &md[labels*(4*(out.Size(0)*(y+1) + x) + south)];
-                      else rm[2] = zeroMsg;
-	  msg.Msg(x,y,level,rm,&md[labels*(4*(out.Size(0)*y + x) + south)]);
-	         
-          if (x!=0) rm[0] = &md[labels*(4*(out.Size(0)*y + x-1) + east)];
-               else rm[0] = zeroMsg;
-          if (y!=0) rm[1] = &md[labels*(4*(out.Size(0)*(y-1) + x) + north)];
-               else rm[1] = zeroMsg;
-          if (y!=height-1) rm[2] = &md[labels*(4*(out.Size(0)*(y+1) + x) + south)];
-                      else rm[2] = zeroMsg;
-	  msg.Msg(x,y,level,rm,&md[labels*(4*(out.Size(0)*y + x) + east)]);
-	  
-          if (x!=width-1) rm[0] = &md[labels*(4*(out.Size(0)*y + x+1) + west)];
-                     else rm[0] = zeroMsg;
-          if (y!=0) rm[1] = &md[labels*(4*(out.Size(0)*(y-1) + x) + north)];
-               else rm[1] = zeroMsg;
-          if (y!=height-1) rm[2] = &md[labels*(4*(out.Size(0)*(y+1) + x) + south)];
-                      else rm[2] = zeroMsg;
-	  msg.Msg(x,y,level,rm,&md[labels*(4*(out.Size(0)*y + x) + west)]);
-         }
-        }      
+        rows.parity = j;
+        rows.Go(pool);
       }
       
       // If level 0 we break out here - isn't another level to scale upto...
@@ -1001,34 +1179,17 @@ class EOS_CLASS HBP2D
     
     // Extract the final labeling...
      prog->Report(levelCount*levelIters+2,levelCount*levelIters+3);
-     real32 * costOut = null<real32*>();
-     if (dOut.Valid()) costOut = mem::Malloc<real32>(labels);
-     
-     for (nat32 y=0;y<out.Size(1);y++)
-     {
-      for (nat32 x=0;x<out.Size(0);x++)
-      {
-       real32 * rm[4];
-        if (x!=0) rm[0] = &md[labels*(4*(out.Size(0)*y + x-1) + east)];
-             else rm[0] = zeroMsg;
-        if (x!=out.Size(0)-1) rm[1] = &md[labels*(4*(out.Size(0)*y + x+1) + west)];
-                         else rm[1] = zeroMsg;
-        if (y!=0) rm[2] = &md[labels*(4*(out.Size(0)*(y-1) + x) + north)];
-             else rm[2] = zeroMsg;
-        if (y!=out.Size(1)-1) rm[3] = &md[labels*(4*(out.Size(0)*(y+1) + x) + south)];                     
-                         else rm[3] = zeroMsg;
-
-       out.Get(x,y) = msg.Label(x,y,rm,costOut);
-
-       if (costOut)
-       {
-        for (nat32 l=0;l<labels;l++) dOut.Get(x,y,l) = costOut[l];
-       }
-      }
-     }
+     BP2DLabels<MSGBP> lab;
+     lab.msg = &msg;
+     lab.md = md;
+     lab.zeroMsg = zeroMsg;
+     lab.labels = labels;
+     lab.out = &out;
+     lab.dOut = &dOut;
+     lab.Go(pool);
      
-     if (costOut) mem::Free(costOut);
      mem::Free(zeroMsg);
+     mem::Free(md);
     
     prog->Pop();
    }
@@ -26,7 +26,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 DepthPlane::DepthPlane()
-:norm(0.0,0.0,1.0)
+:norm(0.0,0.0,1.0),size(0)
 {
  result.n = bs::Normal(0.0,0.0,1.0);
  result.d = 0.0;
@@ -42,7 +42,14 @@ void DepthPlane::Set(const bs::Normal & n)
 
 void DepthPlane::Add(const bs::Vertex & pos)
 {
- list.AddBack(pos);
+ if (size==data.Size()) data.Size(data.Size()*2+incSize);
+ data[size] = pos;
+ size += 1;
+}
+
+void DepthPlane::Reset()
+{
+ size = 0;
 }
 
 void DepthPlane::Run()
@@ -59,26 +66,20 @@ void DepthPlane::Run()
 
   // Projected points onto the line, assign depths, record in estimator...
    math::UniDensityEstimate ude;
+   for (nat32 i=0;i<size;i++)
    {
-    ds::List<bs::Vertex>::Cursor targ = list.FrontPtr();
-    while (!targ.Bad())
-    {
-     // Project...
-      math::Vect<4> proj;
-      math::PluckerProj(line,*targ,proj);
+    // Project...
+     math::Vect<4> proj;
+     math::PluckerProj(line,data[i],proj);
       
-     // Depth...
-      proj.Normalise();
-      if (!math::IsZero(proj[3])) // Points at infinity tend to cause problems.
-      {
-       proj /= proj[3];
-       real32 depth = proj[0]*norm[0] + proj[1]*norm[1] + proj[2]*norm[2];
-       ude.Add(depth);
-      }
-
-     // To next...
-      ++targ;
-    }
+    // Depth...
+     proj.Normalise();
+     if (!math::IsZero(proj[3])) // Points at infinity tend to cause problems.
+     {
+      proj /= proj[3];
+      real32 depth = proj[0]*norm[0] + proj[1]*norm[1] + proj[2]*norm[2];
+      ude.Add(depth);
+     }
    }
 
 
@@ -24,7 +24,7 @@
 
 #include "eos/types.h"
 #include "eos/bs/geo3d.h"
-#include "eos/ds/lists.h"
+#include "eos/ds/arrays.h"
 #include "eos/time/progress.h"
 
 namespace eos
@@ -53,6 +53,10 @@ class EOS_CLASS DepthPlane
   /// Adds a coordinate to the set to be fitted against.
    void Add(const bs::Vertex & pos);
 
+  /// Removes all coordinates, ready for a new fit. Keeps its memory, so one
+  /// object can be reused for many small fits without allocation.
+   void Reset();
+
 
   /// Calculates an answer.
    void Run();
@@ -67,8 +71,11 @@ class EOS_CLASS DepthPlane
 
 
  private:
+  static const nat32 incSize = 64; // Minimum growth of data when it fills up.
+
   bs::Normal norm;
-  ds::List<bs::Vertex> list;
+  nat32 size; // Number of coordinates in use, data is grown but never shrunk.
+  ds::Array<bs::Vertex> data;
   
   bs::Plane result;
 };
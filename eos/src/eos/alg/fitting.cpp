@@ -59,6 +59,46 @@ void PlaneFit::Add(real32 x,real32 y,real32 z)
  Add(v);
 }
 
+void PlaneFit::Rem(const math::Vect<3> & v)
+{
+ mat[0][0] -= v[0]*v[0]; mat[0][1] -= v[0]*v[1]; mat[0][2] -= v[0];
+ mat[1][0] -= v[0]*v[1]; mat[1][1] -= v[1]*v[1]; mat[1][2] -= v[1];
+ mat[2][0] -= v[0];      mat[2][1] -= v[1];      mat[2][2] -= 1.0;
+
+ vec[0] -= v[0]*v[2];
+ vec[1] -= v[1]*v[2];
+ vec[2] -= v[2];
+}
+
+void PlaneFit::Rem(real32 x,real32 y,real32 z)
+{
+ math::Vect<3> v;
+  v[0] = x;
+  v[1] = y;
+  v[2] = z;
+ Rem(v);
+}
+
+PlaneFit & PlaneFit::operator += (const PlaneFit & rhs)
+{
+ for (nat32 r=0;r<3;r++)
+ {
+  for (nat32 c=0;c<3;c++) mat[r][c] += rhs.mat[r][c];
+  vec[r] += rhs.vec[r];
+ }
+ return *this;
+}
+
+PlaneFit & PlaneFit::operator -= (const PlaneFit & rhs)
+{
+ for (nat32 r=0;r<3;r++)
+ {
+  for (nat32 c=0;c<3;c++) mat[r][c] -= rhs.mat[r][c];
+  vec[r] -= rhs.vec[r];
+ }
+ return *this;
+}
+
 bit PlaneFit::Valid()
 {
  return !math::Equal(math::Determinant(mat),0.0);
@@ -78,6 +118,7 @@ void PlaneFit::Get(bs::PlaneABC & out)
 
 //------------------------------------------------------------------------------
 LinePlaneFit::LinePlaneFit()
+:size(0)
 {}
 
 LinePlaneFit::~LinePlaneFit()
@@ -88,7 +129,9 @@ void LinePlaneFit::Add(const bs::Vertex & a,const bs::Vertex & b,real32 weight)
   bs::Vertex aa = a; aa /= aa[3];
   bs::Vertex bb = b; bb /= bb[3];
 
- Entry n;
+ if (size==data.Size()) data.Size(data.Size()*2+incSize);
+ Entry & n = data[size];
+ size += 1;
   n.c[0] = 0.5*(aa[0] + bb[0]);
   n.c[1] = 0.5*(aa[1] + bb[1]);
   n.c[2] = 0.5*(aa[2] + bb[2]);
@@ -97,19 +140,28 @@ void LinePlaneFit::Add(const bs::Vertex & a,const bs::Vertex & b,real32 weight)
   n.length = bb.Length();
 
   n.weight = weight;
- data.AddBack(n);
+}
+
+void LinePlaneFit::Reset()
+{
+ size = 0;
 }
 
 void LinePlaneFit::Run()
+{
+ math::Matrix<real32> mat;
+ Run(mat);
+}
+
+void LinePlaneFit::Run(math::Matrix<real32> & mat)
 {
  // Fill in the data matrix, normalising each vector and calculating the 
  // mean of all the points...
-  math::Matrix<real32> mat(data.Size(),4);
+  mat.SetSize(size,4);
   bs::Vert mean(0.0,0.0,0.0);
-  ds::List<Entry>::Cursor targ = data.FrontPtr();
-  for (nat32 i=0;i<data.Size();i++)
+  for (nat32 i=0;i<size;i++)
   {
-   bs::Vert pos = targ->c;
+   bs::Vert pos = data[i].c;
 
    // Stick it in the data matrix...    
     real32 scale = math::InvSqrt(pos.LengthSqr()+1.0);
@@ -123,20 +175,17 @@ void LinePlaneFit::Run()
     pos -= mean;
     pos /= real32(i+1);
     mean += pos;
-    
-   ++targ;
   }
 
 
  // Second pass - calculate the covariance matrix for the data...
   math::Mat<3> covar;
   math::Zero(covar);
-  targ = data.FrontPtr();
-  for (nat32 i=0;i<data.Size();i++)
+  for (nat32 i=0;i<size;i++)
   {
-   real32 xo = targ->c[0] - mean[0];
-   real32 yo = targ->c[1] - mean[1];
-   real32 zo = targ->c[2] - mean[2];
+   real32 xo = data[i].c[0] - mean[0];
+   real32 yo = data[i].c[1] - mean[1];
+   real32 zo = data[i].c[2] - mean[2];
    
    real32 div = 1.0/real32(i+1);
    
@@ -146,8 +195,6 @@ void LinePlaneFit::Run()
    covar[1][1] += ((yo*yo)-covar[1][1])*div;
    covar[1][2] += ((yo*zo)-covar[1][2])*div;
    covar[2][2] += ((zo*zo)-covar[2][2])*div;
-   
-   ++targ;
   }
   
   covar[1][0] = covar[0][1];
@@ -161,13 +208,12 @@ void LinePlaneFit::Run()
 
  // Third pass, apply a weighting consisting of the expectation of the data point
  // multiplied by one over the line length multiplied by the user provided weighting...
-  targ = data.FrontPtr();
-  for (nat32 i=0;i<data.Size();i++)
+  for (nat32 i=0;i<size;i++)
   {
-   real32 mult = targ->weight;
-   mult *= math::Exp(-targ->length);
+   real32 mult = data[i].weight;
+   mult *= math::Exp(-data[i].length);
    
-   bs::Vert pos = targ->c;
+   bs::Vert pos = data[i].c;
    pos -= mean;
    
    bs::Vert pos2;
@@ -179,8 +225,6 @@ void LinePlaneFit::Run()
    mat[i][1] *= mult;
    mat[i][2] *= mult;
    mat[i][3] *= mult;
-   
-   ++targ;
   }
 
 
@@ -53,6 +53,21 @@ class EOS_CLASS PlaneFit
   /// Adds a data point to fit the plane to.
    void Add(real32 x,real32 y,real32 z);
 
+  /// Removes a data point previously added, as the fit is kept as moments this
+  /// is constant time, so a fit can follow data as it comes and goes.
+   void Rem(const math::Vect<3> & vertex);
+
+  /// Removes a data point previously added.
+   void Rem(real32 x,real32 y,real32 z);
+
+  /// Adds in all the data points of another PlaneFit, in constant time, so 
+  /// groups of points can be summarised and then combined at will.
+   PlaneFit & operator += (const PlaneFit & rhs);
+
+  /// Removes all the data points of another PlaneFit, which must have been 
+  /// previously added.
+   PlaneFit & operator -= (const PlaneFit & rhs);
+
   /// Returns true if enough data to fit a plane has been provided.
    bit Valid();
 
@@ -89,10 +104,18 @@ class EOS_CLASS LinePlaneFit
 
   /// Adds a line segment to be fitted to.
    void Add(const bs::Vertex & a,const bs::Vertex & b,real32 weight);
+
+  /// Removes all line segments, ready for a new fit. Keeps its memory, so one
+  /// object can be reused for many small fits without allocation.
+   void Reset();
    
   /// Does the fitting.
    void Run();
 
+  /// Does the fitting, using the given matrix as workspace. Reusing the same
+  /// matrix for fits with the same number of line segments avoids allocation.
+   void Run(math::Matrix<real32> & mat);
+
   /// Returns the fitted plane.
    const bs::Plane & Plane() const;
 
@@ -109,7 +132,10 @@ class EOS_CLASS LinePlaneFit
    real32 weight;
   };
   
-  ds::List<Entry> data;
+  static const nat32 incSize = 64; // Minimum growth of data when it fills up.
+
+  nat32 size; // Number of entries in use, data is grown but never shrunk.
+  ds::Array<Entry> data;
   
   bs::Plane result;
 };
@@ -18,15 +18,59 @@
 #include "eos/alg/genetic.h"
 
 #include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace alg
  {
+//------------------------------------------------------------------------------
+class GeneticReal::EvalFitness
+{
+ public:
+  EvalFitness(const GeneticRealFunc & f,ds::Array<Organism,mem::MakeNew<Organism>,mem::KillOnlyDel<Organism> > & p)
+  :func(f),pop(p)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++)
+   {
+    if (pop[i].fitness<0.0) pop[i].fitness = func.Fitness(pop[i].paras,null<time::Progress*>());
+   }
+  }
+
+
+ private:
+  const GeneticRealFunc & func;
+  ds::Array<Organism,mem::MakeNew<Organism>,mem::KillOnlyDel<Organism> > & pop;
+};
+
+//------------------------------------------------------------------------------
+class GeneticReal::IslandRun
+{
+ public:
+  IslandRun(ds::Array<GeneticReal*> & i)
+  :gens(0),isle(i)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++) isle[i]->Run(gens,null<time::Progress*>());
+  }
+
+  nat32 gens;
+
+
+ private:
+  ds::Array<GeneticReal*> & isle;
+};
+
 //------------------------------------------------------------------------------
 GeneticReal::GeneticReal(data::Random & r)
 :rand(r),func(null<GeneticRealFunc*>()),
-fitnessCrossover(true),mutationRate(0.01),maintainBest(1),immigrants(0)
+fitnessCrossover(true),mutationRate(0.01),maintainBest(1),immigrants(0),
+islands(1),interval(10),migrants(1)
 {}
 
 GeneticReal::~GeneticReal()
@@ -111,8 +155,27 @@ nat32 GeneticReal::Immigrants(nat32 imm)
  return immigrants;
 }
 
+void GeneticReal::Islands(nat32 count,nat32 inter,nat32 mig)
+{
+ islands = math::Max<nat32>(count,1);
+ interval = inter;
+ migrants = mig;
+}
+
+nat32 GeneticReal::Islands() const
+{
+ return islands;
+}
+
 void GeneticReal::Run(nat32 generations,time::Progress * prog)
 {
+ nat32 count = math::Min<nat32>(islands,pop.Size()/(maintainBest+immigrants+2));
+ if (count>1)
+ {
+  RunIslands(count,generations,prog);
+  return;
+ }
+
  prog->Push();
  prog->Report(0,generations*2+1);
  CalcFitness(prog);
@@ -142,32 +205,38 @@ real32 GeneticReal::GetFitness(nat32 index) const
 void GeneticReal::CalcFitness(time::Progress * prog)
 {
  prog->Push();
+ prog->Report(0,2);
 
- // First calcualte fitnesss for all uncalculated souls...
+ // First calcualte fitnesss for all uncalculated souls, in parallel - the
+ // elites have theirs cached from previous generations...
   bit change = false;
   for (nat32 i=0;i<pop.Size();i++)
   {
-   prog->Report(i,pop.Size()+1);
-   if (pop[i].fitness<0.0)
-   {
-    change = true;
-    pop[i].fitness = func->Fitness(pop[i].paras,prog);
-   }
+   if (pop[i].fitness<0.0) {change = true; break;}
   }
-  prog->Report(pop.Size(),pop.Size()+1);
- 
- // If a change has happened sort the entire population then update the fitnessSum's...
+  
   if (change)
   {
-   pop.Sort<OrganismSort>();
-   
-   pop[0].fitnessSum = 0.0;
-   for (nat32 i=1;i<pop.Size();i++) pop[i].fitnessSum = pop[i-1].fitnessSum + pop[i-1].fitness;
+   EvalFitness ef(*func,pop);
+   mt::ParallelFor(nat32(0),pop.Size(),ef);
   }
+  prog->Report(1,2);
+ 
+ // If a change has happened sort the entire population then update the fitnessSum's...
+  if (change) Rank();
 
  prog->Pop();
 }
 
+void GeneticReal::Rank()
+{
+ if (pop.Size()==0) return;
+ pop.Sort<OrganismSort>();
+   
+ pop[0].fitnessSum = 0.0;
+ for (nat32 i=1;i<pop.Size();i++) pop[i].fitnessSum = pop[i-1].fitnessSum + pop[i-1].fitness;
+}
+
 void GeneticReal::Breed(time::Progress * prog)
 {
  prog->Push();
@@ -251,6 +320,74 @@ void GeneticReal::Breed(time::Progress * prog)
  prog->Pop();
 }
 
+void GeneticReal::RunIslands(nat32 count,nat32 generations,time::Progress * prog)
+{
+ LogTime("eos::alg::GeneticReal::RunIslands");
+ prog->Push();
+
+ // Sort the population, so dealing it out gives each island a fair share
+ // of the good and the bad...
+  prog->Report(0,generations+2);
+  CalcFitness(null<time::Progress*>());
+
+ // Create the islands, each with its own random number generator...
+  ds::Array<data::Random*> rands(count);
+  ds::Array<GeneticReal*> isle(count);
+  for (nat32 i=0;i<count;i++)
+  {
+   rands[i] = new data::Random(true,rand.Int(0,0x7fffffff));
+   isle[i] = new GeneticReal(*rands[i]);
+   isle[i]->func = func;
+   isle[i]->fitnessCrossover = fitnessCrossover;
+   isle[i]->mutationRate = mutationRate;
+   isle[i]->maintainBest = maintainBest;
+   isle[i]->immigrants = immigrants;
+   isle[i]->pop.Size((pop.Size()+count-1-i)/count);
+  }
+  
+  for (nat32 i=0;i<pop.Size();i++) isle[i%count]->pop[i/count] = pop[i];
+
+
+ // Evolve them in epochs of interval generations, migrating between each...
+  nat32 mig = math::Min(migrants,pop.Size()/count);
+  IslandRun ir(isle);
+  nat32 done = 0;
+  while (done<generations)
+  {
+   prog->Report(done+1,generations+2);
+   ir.gens = generations - done;
+   if (interval!=0) ir.gens = math::Min(interval,ir.gens);
+   mt::ParallelFor(nat32(0),count,ir);
+   done += ir.gens;
+   
+   if (done<generations)
+   {
+    // Each island passes its best to the next, in a ring...
+     for (nat32 m=0;m<mig;m++)
+     {
+      Organism temp = isle[count-1]->pop[m];
+      for (nat32 i=count-1;i>0;i--) isle[i]->pop[m] = isle[i-1]->pop[m];
+      isle[0]->pop[m] = temp;
+     }
+     for (nat32 i=0;i<count;i++) isle[i]->Rank();
+   }
+  }
+
+
+ // Gather the islands back into the one population, and clean up...
+  prog->Report(generations+1,generations+2);
+  for (nat32 i=0;i<pop.Size();i++) pop[i] = isle[i%count]->pop[i/count];
+  Rank();
+  
+  for (nat32 i=0;i<count;i++)
+  {
+   delete isle[i];
+   delete rands[i];
+  }
+
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
 GeneticOrg::~GeneticOrg()
 {}
@@ -258,10 +395,50 @@ GeneticOrg::~GeneticOrg()
 void GeneticOrg::Del(void *) const
 {}
 
+//------------------------------------------------------------------------------
+class Genetic::EvalFitness
+{
+ public:
+  EvalFitness(const GeneticOrg & g,ds::ArrayRS<byte> & d)
+  :go(g),data(d)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++) go.Fitness(&(data[i]));
+  }
+
+
+ private:
+  const GeneticOrg & go;
+  ds::ArrayRS<byte> & data;
+};
+
+//------------------------------------------------------------------------------
+class Genetic::IslandRun
+{
+ public:
+  IslandRun(ds::Array<Genetic*> & i)
+  :gens(0),isle(i)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++) isle[i]->Run(gens);
+  }
+
+  nat32 gens;
+
+
+ private:
+  ds::Array<Genetic*> & isle;
+};
+
 //------------------------------------------------------------------------------
 Genetic::Genetic(data::Random & r)
 :rand(r),go(null<GeneticOrg*>()),
 population(0),keptBest(1),immigrants(0),mutationRate(0.0),
+islands(1),interval(10),migrants(1),
 data(1)
 {}
 
@@ -328,6 +505,18 @@ real32 Genetic::MutationRate() const
  return mutationRate;
 }
 
+void Genetic::Islands(nat32 count,nat32 inter,nat32 mig)
+{
+ islands = math::Max<nat32>(count,1);
+ interval = inter;
+ migrants = mig;
+}
+
+nat32 Genetic::Islands() const
+{
+ return islands;
+}
+
 void Genetic::Run(nat32 generations,time::Progress * prog)
 {
  prog->Push();
@@ -346,6 +535,16 @@ void Genetic::Run(nat32 generations,time::Progress * prog)
   }
 
 
+ // Hand over to the island model if requested...
+  nat32 count = math::Min<nat32>(islands,population/(keptBest+immigrants+2));
+  if (count>1)
+  {
+   RunIslands(count,generations,prog);
+   prog->Pop();
+   return;
+  }
+
+
  // Create tempory storage for new children, and storage for the incrimental
  // fitness...
   ds::ArrayRS<byte> nursery(go->Size(),population-keptBest-immigrants);
@@ -358,9 +557,9 @@ void Genetic::Run(nat32 generations,time::Progress * prog)
    prog->Report(step++,steps);
    prog->Push();
    
-    // First sort the population by fitness...
+    // First sort the population by fitness, calculating it in parallel...
      prog->Report(0,4);
-     data.Sort(&GreaterThan,go);
+     Rank();
 
 
     // Now breed the population to create a new set, weight breeding probability
@@ -418,6 +617,9 @@ void Genetic::Run(nat32 generations,time::Progress * prog)
    
    prog->Pop();
   }
+  
+ // Sort the final generation, so the best is at the front...
+  Rank();
 
  prog->Pop();
 }
@@ -445,6 +647,89 @@ bit Genetic::GreaterThan(byte * lhs,byte * rhs,GeneticOrg * go)
  return lF > rF;
 }
 
+void Genetic::Rank()
+{
+ EvalFitness ef(*go,data);
+ mt::ParallelFor(nat32(0),data.Size(),ef);
+ 
+ data.Sort(&GreaterThan,go);
+}
+
+void Genetic::RunIslands(nat32 count,nat32 generations,time::Progress * prog)
+{
+ LogTime("eos::alg::Genetic::RunIslands");
+ prog->Push();
+ const nat32 es = go->Size();
+
+ // Sort the population, so dealing it out gives each island a fair share
+ // of the good and the bad...
+  prog->Report(0,generations+2);
+  Rank();
+
+ // Create the islands, each with its own random number generator. The
+ // organisms are moved with a memory copy, as the nursery does, so ownership
+ // goes with them...
+  ds::Array<data::Random*> rands(count);
+  ds::Array<Genetic*> isle(count);
+  for (nat32 i=0;i<count;i++)
+  {
+   rands[i] = new data::Random(true,rand.Int(0,0x7fffffff));
+   isle[i] = new Genetic(*rands[i]);
+   isle[i]->go = go;
+   isle[i]->population = (population+count-1-i)/count;
+   isle[i]->keptBest = keptBest;
+   isle[i]->immigrants = immigrants;
+   isle[i]->mutationRate = mutationRate;
+   isle[i]->data.Rebuild(es,isle[i]->population);
+  }
+  
+  for (nat32 i=0;i<population;i++) mem::Copy(&(isle[i%count]->data[i/count]),&(data[i]),es);
+
+
+ // Evolve them in epochs of interval generations, migrating between each...
+  nat32 mig = math::Min(migrants,population/count);
+  byte * temp = new byte[es];
+  IslandRun ir(isle);
+  nat32 done = 0;
+  while (done<generations)
+  {
+   prog->Report(done+1,generations+2);
+   ir.gens = generations - done;
+   if (interval!=0) ir.gens = math::Min(interval,ir.gens);
+   mt::ParallelFor(nat32(0),count,ir);
+   done += ir.gens;
+   
+   if (done<generations)
+   {
+    // Each island passes its best to the next, in a ring...
+     for (nat32 m=0;m<mig;m++)
+     {
+      mem::Copy(temp,&(isle[count-1]->data[m]),es);
+      for (nat32 i=count-1;i>0;i--) mem::Copy(&(isle[i]->data[m]),&(isle[i-1]->data[m]),es);
+      mem::Copy(&(isle[0]->data[m]),temp,es);
+     }
+     for (nat32 i=0;i<count;i++) isle[i]->data.Sort(&GreaterThan,go);
+   }
+  }
+  delete[] temp;
+
+
+ // Gather the islands back into the one population, and clean up - the
+ // islands are emptied first so they don't delete the organisms...
+  prog->Report(generations+1,generations+2);
+  for (nat32 i=0;i<population;i++) mem::Copy(&(data[i]),&(isle[i%count]->data[i/count]),es);
+  Rank();
+  
+  for (nat32 i=0;i<count;i++)
+  {
+   isle[i]->data.Size(0);
+   delete isle[i];
+   delete rands[i];
+  }
+
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
  };
 };
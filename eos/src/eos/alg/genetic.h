@@ -51,6 +51,8 @@ class EOS_CLASS GeneticRealFunc : public Deletable
    
   /// Given a parameter set this should return the fitness of the particular
   /// parameter set. As it can take some time a progress object is also provided.
+  /// A generation is evaluated in parallel, on the task pool, so this will be
+  /// called from several threads at once, with prog then null.
    virtual real32 Fitness(const math::Vector<real32> & paras,time::Progress * prog) const = 0;
 };
 
@@ -125,6 +127,20 @@ class EOS_CLASS GeneticReal
    nat32 Immigrants(nat32 imm);
 
 
+  /// Sets up the island model, where the population is split into count
+  /// sub-populations that evolve independently, each on its own core, with
+  /// migration between them every interval generations - the best migrants
+  /// of each island move to the next, in a ring. Keeping the islands apart
+  /// maintains diversity, whilst migration spreads the good genes around.
+  /// MaintainBest and Immigrants then apply to each island. The number of islands
+  /// is reduced if the population is too small for them. Defaults to 1,
+  /// which is the plain algorithm.
+   void Islands(nat32 count,nat32 interval = 10,nat32 migrants = 1);
+
+  /// Returns the number of islands requested.
+   nat32 Islands() const;
+
+
 
   /// Runs the system for a given number of generations, with progress reporting.
    void Run(nat32 generations,time::Progress * prog);
@@ -153,6 +169,9 @@ class EOS_CLASS GeneticReal
   real32 mutationRate;
   nat32 maintainBest;
   nat32 immigrants;
+  nat32 islands;
+  nat32 interval;
+  nat32 migrants;
   
   struct Organism
   {
@@ -178,7 +197,13 @@ class EOS_CLASS GeneticReal
 
   // Various internal use functions that do actual work...
    void CalcFitness(time::Progress * prog); // Calculates the fitness & fitnessSum for any organisms with negative fitness, and sorts them.
+   void Rank(); // Sorts and calculates the fitnessSum's.
    void Breed(time::Progress * prog); // Creates a new unsorted and unranked organism set from the current batch.
+   void RunIslands(nat32 count,nat32 generations,time::Progress * prog); // Run for the island model.
+
+  // Functors for the task pool...
+   class EvalFitness;
+   class IslandRun;
 };
 
 //------------------------------------------------------------------------------
@@ -210,6 +235,8 @@ class EOS_CLASS GeneticOrg : public Deletable
   /// should cache fitness so it is only calculated once.
   /// Fitness should increase as the organism gets better, negative numbers are
   /// not suported. A fitness of 0 is a definite death sentence.
+  /// Each generation is evaluated in parallel, on the task pool, so this will
+  /// be called for different organisms from several threads at once.
    virtual real32 Fitness(const void * org) const = 0;
    
   /// This breeds two organisms and outputs a new organism into child.
@@ -221,6 +248,9 @@ class EOS_CLASS GeneticOrg : public Deletable
    
   /// This mutates an organism.
    virtual void Mutate(void * org,data::Random & rand) const = 0;
+   
+  // Note that when Genetic is using islands New, Breed and Mutate are also
+  // called from several threads at once, each with its own data::Random.
 
 
   /// &nbsp;
@@ -287,13 +317,27 @@ class EOS_CLASS Genetic
    real32 MutationRate() const;
 
 
+  /// Sets up the island model, where the population is split into count
+  /// sub-populations that evolve independently, each on its own core, with
+  /// migration between them every interval generations - the best migrants
+  /// of each island move to the next, in a ring. Keeping the islands apart
+  /// maintains diversity, whilst migration spreads the good genes around.
+  /// KeptBest and Immigrants then apply to each island. The number of islands
+  /// is reduced if the population is too small for them. Defaults to 1,
+  /// which is the plain algorithm.
+   void Islands(nat32 count,nat32 interval = 10,nat32 migrants = 1);
+
+  /// Returns the number of islands requested.
+   nat32 Islands() const;
+
+
   /// Runs the system for a given number of generations, with progress reporting.
   /// Can be called repetedly, so you can decide when fitness is low
   /// enough/unchanging enough to stop.
    void Run(nat32 generations,time::Progress * prog = null<time::Progress*>());
 
 
-  /// After Run has been called this returns the organism at the given indoex. 
+  /// After Run has been called this returns the organism at the given index. 
   /// The organisms are sorted by fitness, so the best will allways be at index
   /// 0 and the worst at index Population()-1.
    const void * Organism(nat32 index) const;
@@ -315,12 +359,26 @@ class EOS_CLASS Genetic
    nat32 keptBest;
    nat32 immigrants;
    real32 mutationRate;
+   nat32 islands;
+   nat32 interval;
+   nat32 migrants;
 
   // State...
    ds::ArrayRS<byte> data;
    
   // Helper function for sorting by fitness...
    static bit GreaterThan(byte * lhs,byte * rhs,GeneticOrg * go);
+
+  // Makes sure every organism has its fitness cached, in parallel, and then
+  // sorts them...
+   void Rank();
+
+  // Run for the island model...
+   void RunIslands(nat32 count,nat32 generations,time::Progress * prog);
+
+  // Functors for the task pool...
+   class EvalFitness;
+   class IslandRun;
 };
 
 //------------------------------------------------------------------------------
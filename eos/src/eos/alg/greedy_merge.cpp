@@ -18,7 +18,8 @@
 #include "eos/alg/greedy_merge.h"
 
 #include "eos/file/csv.h"
-#include "eos/ds/priority_queues.h"
+#include "eos/ds/index_heaps.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -60,6 +61,56 @@ void GreedyMerge::AddEdge(nat32 a,nat32 b)
  inEdge.AddBack(e);
 }
 
+class GreedyMerge::NodeCosts
+{
+ public:
+  NodeCosts(const GreedyMergeInterface * g,const ds::ArrayPtr<Deletable> & i,ds::Array<real32> & c)
+  :gmi(g),in(i),cost(c)
+  {}
+
+  void operator () (nat32 i0,nat32 i1)
+  {
+   for (nat32 i=i0;i<i1;i++)
+   {
+    LogTime("eos::alg::GreedyMerge::Run node");
+    cost[i] = gmi->Cost(in[i]);
+   }
+  }
+
+
+ private:
+  const GreedyMergeInterface * gmi;
+  const ds::ArrayPtr<Deletable> & in;
+  ds::Array<real32> & cost;
+};
+
+//------------------------------------------------------------------------------
+class GreedyMerge::PairCosts
+{
+ public:
+  PairCosts(const GreedyMergeInterface * g,const ds::Array<const Deletable*> & a,
+            const ds::Array<const Deletable*> & b,ds::Array<real32> & c)
+  :gmi(g),dataA(a),dataB(b),cost(c)
+  {}
+
+  void operator () (nat32 i0,nat32 i1)
+  {
+   for (nat32 i=i0;i<i1;i++)
+   {
+    LogTime("eos::alg::GreedyMerge::Run pair");
+    cost[i] = gmi->Cost(dataA[i],dataB[i]);
+   }
+  }
+
+
+ private:
+  const GreedyMergeInterface * gmi;
+  const ds::Array<const Deletable*> & dataA;
+  const ds::Array<const Deletable*> & dataB;
+  ds::Array<real32> & cost;
+};
+
+//------------------------------------------------------------------------------
 void GreedyMerge::Run(time::Progress * prog)
 {
  LogBlock("eos::alg::GreedyMerge::Run","-");
@@ -69,78 +120,102 @@ void GreedyMerge::Run(time::Progress * prog)
   prog->Report(0,4);
   LG graph;  
 
-  prog->Push();
+  ds::Array<real32> nodeCost(in.Size());
+  {
+   NodeCosts nc(gmi,in,nodeCost);
+   mt::ParallelFor(nat32(0),in.Size(),nc);
+  }
+
   ds::Array<LG::NodeHand> nh(in.Size());
   for (nat32 i=0;i<nh.Size();i++)
   {
-   LogTime("eos::alg::GreedyMerge::Run node");
-   prog->Report(i,nh.Size());
-
    nh[i] = graph.AddNode();
-   nh[i]->cost = gmi->Cost(in[i]);
+   nh[i]->cost = nodeCost[i];
    nh[i]->data = in[i];
   }
-  prog->Pop();
 
 
 
  // Create A work queue, fill it in with every possible work item...
   prog->Report(1,4);
-  ds::PriorityQueue<WorkItem> workQueue(inEdge.Size()*2);
+  ds::IndexHeap<WorkItem> workQueue; // Keyed by the edge each item merges.
   graph.AddLayer();
   
-  prog->Push();
   {
-   ds::List<Edge>::Cursor targ = inEdge.FrontPtr();
-   for (nat32 i=0;i<inEdge.Size();i++)
+   // Add the edges to the graph and collect the node pairs to cost...
+    ds::Array<const Deletable*> dataA(inEdge.Size());
+    ds::Array<const Deletable*> dataB(inEdge.Size());
+    ds::Array<real32> pairCost(inEdge.Size());
+
+    ds::List<Edge>::Cursor targ = inEdge.FrontPtr();
+    for (nat32 i=0;i<inEdge.Size();i++)
+    {
+     *graph.AddEdge(0,nh[targ->a],nh[targ->b]) = i;
+     dataA[i] = nh[targ->a]->data;
+     dataB[i] = nh[targ->b]->data;
+     ++targ;
+    }
+
+   // Calculate the cost of merging the nodes associated with each edge...
    {
-    LogTime("eos::alg::GreedyMerge::Run edge");
-    prog->Report(i,inEdge.Size());
-    
-    // Add edge to graph...
-     graph.AddEdge(0,nh[targ->a],nh[targ->b]);
-     
-    // Calculate cost of merging the nodes associated with the edge, compare to 
-    // cost of not merging and store work item if its an improvment...
-     real32 mergedCost = gmi->Cost(nh[targ->a]->data,nh[targ->b]->data);
+    PairCosts pc(gmi,dataA,dataB,pairCost);
+    mt::ParallelFor(nat32(0),inEdge.Size(),pc);
+   }
+
+   // Compare to the cost of not merging and store work items for improvments...
+    targ = inEdge.FrontPtr();
+    for (nat32 i=0;i<inEdge.Size();i++)
+    {
      real32 unmergedCost = nh[targ->a]->cost + nh[targ->b]->cost;
-     if (mergedCost<unmergedCost)
+     if (pairCost[i]<unmergedCost)
      {
       WorkItem wi;
-      wi.costDec = unmergedCost - mergedCost;
+      wi.costDec = unmergedCost - pairCost[i];
       wi.a = nh[targ->a];
       wi.b = nh[targ->b];
       
-      workQueue.Add(wi);
+      workQueue.Add(i,wi);
      }
 
-    ++targ;
-   }
+     ++targ;
+    }
   }
-  prog->Pop();
 
 
 
  // Keep eatting the work queue, grabbing the best job to do at each bite.
- // When a job is eatten add on all consequental jobs, keep going until the
- // queue is empty.
- // Note that work items can be invalidated by earlier work items...
+ // When a job is eatten remove every job involving the two merged nodes, then
+ // add on all consequental jobs, keep going until the queue is empty...
   prog->Report(2,4);
   prog->Push();
   nat32 done = 0;
+  ds::Array<LG::NodeHand> newA;
+  ds::Array<LG::NodeHand> newB;
+  ds::Array<nat32> newKey;
+  ds::Array<const Deletable*> dataA;
+  ds::Array<const Deletable*> dataB;
+  ds::Array<real32> pairCost;
   while (workQueue.Size()!=0)
   {
    LogTime("eos::alg::GreedyMerge::Run job");
    prog->Report(done,math::Min(done + workQueue.Size(),in.Size()-1));
 
-   // Remove the best operation...
-    WorkItem wi = workQueue.Peek();
-    workQueue.Rem();
-
-   // Check its still valid...
-    if ((!wi.a.Current())||(!wi.b.Current())) continue;
+   // Remove the best operation, and all the others its about to invalidate...
+    nat32 key;
+    WorkItem wi;
+    workQueue.Pop(key,wi);
     ++done;
 
+    for (nat32 s=0;s<2;s++)
+    {
+     LG::EdgeIter targ = ((s==0)?wi.a:wi.b).LayerFront().Targ().EdgeFront();
+     while (!targ.Bad())
+     {
+      workQueue.Rem(*targ.Targ());
+      ++targ;
+     }
+    }
+
    // Apply it...
     LG::NodeHand nn = graph.MergeNodes(wi.a,wi.b);
     nn->cost = wi.a->cost + wi.b->cost - wi.costDec;
@@ -149,27 +224,54 @@ void GreedyMerge::Run(time::Progress * prog)
     delete wi.a->data;
     delete wi.b->data;
    
-   // Generate all follow through work items...
-    LG::EdgeIter targ = nn.LayerFront().Targ().EdgeFront();
-    while (!targ.Bad())
+   // Collect all follow through work items...
+    nat32 count = 0;
     {
-     LogTime("eos::alg::GreedyMerge::Run new_job");
-     LG::NodeHand na = targ.Targ().A().GetNode();
-     LG::NodeHand nb = targ.Targ().B().GetNode();
-     
-     real32 mergedCost = gmi->Cost(na->data,nb->data);
-     real32 unmergedCost = na->cost + nb->cost;
-     if (mergedCost<unmergedCost)
+     LG::EdgeIter targ = nn.LayerFront().Targ().EdgeFront();
+     while (!targ.Bad()) {++count; ++targ;}
+    }
+
+    if (newA.Size()<count)
+    {
+     newA.Size(count);
+     newB.Size(count);
+     newKey.Size(count);
+     dataA.Size(count);
+     dataB.Size(count);
+     pairCost.Size(count);
+    }
+
+    {
+     LG::EdgeIter targ = nn.LayerFront().Targ().EdgeFront();
+     for (nat32 i=0;i<count;i++)
+     {
+      newA[i] = targ.Targ().A().GetNode();
+      newB[i] = targ.Targ().B().GetNode();
+      newKey[i] = *targ.Targ();
+      dataA[i] = newA[i]->data;
+      dataB[i] = newB[i]->data;
+      ++targ;
+     }
+    }
+
+   // Cost them as a batch, then add the improvments to the queue...
+    {
+     PairCosts pc(gmi,dataA,dataB,pairCost);
+     mt::ParallelFor(nat32(0),count,pc);
+    }
+
+    for (nat32 i=0;i<count;i++)
+    {
+     real32 unmergedCost = newA[i]->cost + newB[i]->cost;
+     if (pairCost[i]<unmergedCost)
      {
       WorkItem wi;
-      wi.costDec = unmergedCost - mergedCost;
-      wi.a = na;
-      wi.b = nb;
+      wi.costDec = unmergedCost - pairCost[i];
+      wi.a = newA[i];
+      wi.b = newB[i];
       
-      workQueue.Add(wi);
+      workQueue.Add(newKey[i],wi);
      }
-    
-     ++targ;
     }
   }
   prog->Pop();
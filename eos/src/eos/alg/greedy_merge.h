@@ -35,7 +35,10 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 /// Interface that must be implimented to use the GreedyMerge class, provides
-/// problem specific methods.
+/// problem specific methods. The costs are evaluated in batches using the task
+/// pool, so both Cost methods can be called from several threads at once, with
+/// the same node data appearing in several calls. Merge is only ever called
+/// from one thread at a time.
 class EOS_CLASS GreedyMergeInterface : public Deletable
 {
  public:
@@ -89,7 +92,8 @@ class EOS_CLASS GreedyMerge
    void AddEdge(nat32 a,nat32 b);
    
    
-  /// Runs the algorithm.
+  /// Runs the algorithm, using the task pool for the costs. The merges are
+  /// done in the same order as they would be by a single thread.
    void Run(time::Progress * prog = null<time::Progress*>());
    
   
@@ -136,7 +140,7 @@ class EOS_CLASS GreedyMerge
     nat32 index; // Used in the output constructing step.
     Deletable * data;
    };
-   typedef ds::LayeredGraph<NodeData,Nothing,Nothing,Nothing> LG;
+   typedef ds::LayeredGraph<NodeData,Nothing,nat32,Nothing> LG; // Edges store their work queue key.
    
    struct WorkItem
    {
@@ -146,6 +150,10 @@ class EOS_CLASS GreedyMerge
     
     bit operator < (const WorkItem & rhs) const {return costDec > rhs.costDec;}
    };
+
+  // Functors for the task pool, to cost a batch of nodes or node pairs...
+   class NodeCosts;
+   class PairCosts;
 };
 
 //------------------------------------------------------------------------------
@@ -17,13 +17,126 @@
 
 #include "eos/alg/mean_shift.h"
 
+#include "eos/mt/tasks.h"
+
 namespace eos
 {
  namespace alg
  {
+//------------------------------------------------------------------------------
+// Converges blocks of samples for the accelerated mode, each with its own
+// tempory storage...
+class MeanShift::Block
+{
+ public:
+  Block(MeanShift & s,nat32 bs,nat32 * p,real32 * d,nat32 * st)
+  :self(s),blockSize(bs),pods(p),data(d),stride(st)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 * mi = mem::Malloc<nat32>(self.dim.Size());
+   nat32 * ma = mem::Malloc<nat32>(self.dim.Size());
+   nat32 * pos = mem::Malloc<nat32>(self.dim.Size());
+   real32 * mean = mem::Malloc<real32>(self.fvSize);
+
+   for (nat32 b=begin;b<end;b++)
+   {
+    nat32 first = b*blockSize;
+    nat32 last = math::Min(first+blockSize,self.samples);
+    for (nat32 i=first;i<last;i++) self.Converge(i,first,last,pods,mi,ma,pos,data,stride,mean);
+   }
+
+   mem::Free(mean);
+   mem::Free(pos);
+   mem::Free(ma);
+   mem::Free(mi);
+  }
+
+ private:
+  MeanShift & self;
+  nat32 blockSize;
+  nat32 * pods;
+  real32 * data;
+  nat32 * stride;
+};
+
+//------------------------------------------------------------------------------
+// The distance tests, for inlining into SumRun...
+struct DefaultTest
+{
+ DefaultTest(nat32 fs):fvSize(fs) {}
+ bit operator () (const real32 * fv1,const real32 * fv2) const
+ {
+  real32 ret = 0.0;
+  for (nat32 i=0;i<fvSize;i++)
+  {
+   ret += math::Sqr(fv1[i] - fv2[i]);
+   if (ret>1.0) return false;
+  }
+  return true;
+ }
+
+ nat32 fvSize;
+};
+
+struct JointTest
+{
+ JointTest(nat32 fs,nat32 s):fvSize(fs),split(s) {}
+ bit operator () (const real32 * fv1,const real32 * fv2) const
+ {
+  // The parts are short, so its quicker to sum each in full than to check
+  // after every term...
+   real32 a = 0.0;
+   for (nat32 i=0;i<split;i++) a += math::Sqr(fv1[i] - fv2[i]);
+   if (a>1.0) return false;
+
+   real32 b = 0.0;
+   for (nat32 i=split;i<fvSize;i++) b += math::Sqr(fv1[i] - fv2[i]);
+  return b<=1.0;
+ }
+
+ nat32 fvSize;
+ nat32 split;
+};
+
+struct FuncTest
+{
+ FuncTest(bit (*d)(nat32,real32*,real32*,real32),nat32 fs,real32 p):Distance(d),fvSize(fs),pt(p) {}
+ bit operator () (const real32 * fv1,const real32 * fv2) const
+ {
+  return Distance(fvSize,const_cast<real32*>(fv1),const_cast<real32*>(fv2),pt);
+ }
+
+ bit (*Distance)(nat32,real32*,real32*,real32);
+ nat32 fvSize;
+ real32 pt;
+};
+
+// Sums into mean and weight the contribution of count consecutive samples,
+// starting at data, which pass the distance test against vector, both
+// including the weight at the front...
+template <typename D>
+static inline void SumRun(const D & dist,nat32 fvSize,const real32 * data,nat32 count,
+                          const real32 * vector,real32 * mean,real32 & weight)
+{
+ for (nat32 j=0;j<count;j++)
+ {
+  if (dist(data+1,vector+1))
+  {
+   real32 we = data[0];
+   weight += we;
+   for (nat32 i=0;i<fvSize;i++) mean[i] += we*(data[i+1] - vector[i+1]);
+  }
+  data += fvSize + 1;
+ }
+}
+
 //------------------------------------------------------------------------------
 MeanShift::MeanShift()
-:cutoff(0.01),max_iter(100),passOpt(false),window(1.0),out(null<real32*>()),Distance(&DistDefault) 
+:cutoff(0.01),max_iter(100),passOpt(false),accel(false),window(1.0),
+useGrid(false),gridDims(0),gridStart(null<nat32*>()),gridItem(null<nat32*>()),
+out(null<real32*>()),Distance(&DistDefault),passThrough(0.0),split(0)
 {}
 
 MeanShift::~MeanShift() {mem::Free(out);}
@@ -34,6 +147,13 @@ void MeanShift::SetDistance(bit (*D)(nat32 fvSize,real32 * fv1,real32 * fv2,real
  passThrough = pt;
 }
 
+void MeanShift::SetJointDistance(nat32 s)
+{
+ Distance = &DistJoint;
+ passThrough = real32(s);
+ split = s;
+}
+
 void MeanShift::AddFeature(const svt::Field<real32> & field,real32 scale)
 {
  nat32 ind = sf.Size();
@@ -72,6 +192,11 @@ void MeanShift::Passover(bit enabled)
  passOpt = enabled;
 }
 
+void MeanShift::Accelerate(bit enabled)
+{
+ accel = enabled;
+}
+
 void MeanShift::SetWindowSize(real32 size)
 {
  window = size;
@@ -160,73 +285,35 @@ void MeanShift::Run(time::Progress * prog)
     
 
  // For each vector we apply the mean shift algorithm till convergance...
-  targ = out;
-  for (nat32 i=0;i<samples;i++,targ += fvSize+1)
+  if (accel)
   {
-   prog->Report(i,samples);
-   // Run this particular node till convergence...
-    // Converge it, different code depending on if the passover optimisation
-    // is on or not...     
-     if ((!passOpt)||(pods[i]==i))
-     {
-      nat32 lastOver = i; // Used for a quick break out, saves a bit of pissing about.
-      for (nat32 k=0;k<max_iter;k++)
-      {
-       if (passOpt)
-       {
-        // Check if we are over a sample that has not converged, if so we become
-        // its parent, so it will be forced to converge to the same place this
-        // sample converges...
-         // Find the offset of the sample...
-          nat32 over = 0;
-          for (nat32 j=0;j<dim.Size();j++) over += nat32(math::Round(targ[j+1]/dim[j].scale))*stride[j];          
-         
-         // If its not us check if we can save some sampling...
-          if ((over!=lastOver)&&(over!=i))
-          { 
-	   lastOver = over;         
-           // We only concider matching to this pixel if the remainder of the
-           // feature vector, the non-dimensional features, eucledian distance
-           // in the scaled space is less than half.
-            real32 * ot = out + (fvSize+1)*over + 1 + dim.Size();
-            real32 dist = 0.0;
-            for (nat32 j=0;j<sf.Size();j++) dist += math::Sqr(ot[j]-targ[j+1+dim.Size()]);
-            if (dist<0.5)
-            {
-             // Two scenarios - either the node has not converged, and we arrange
-             // for it to converge to the same point we do, or it has converged 
-             // so we go where it is going...
-              if (pods[over]==over) pods[over] = i;
-              else
-              {
-               // Instead of doing any more mean shifting just head straight to the
-               // convergence point of the node found...
-                nat32 toUse = pods[over];
-                while (toUse!=pods[toUse]) toUse = pods[toUse];
-                
-                real32 * from = out + (fvSize+1)*toUse; 
-                for (nat32 j=0;j<fvSize;j++) targ[j+1] = from[j+1];
-              }
-            }
-          }
-       }
-       CalcShift(mi,ma,ipos,vect,stride,targ,mean);      
-       for (nat32 j=0;j<fvSize;j++) targ[j+1] += mean[j];
-    
-       real32 shift = 0.0;
-       for (nat32 j=0;j<fvSize;j++)
-       {
-        shift += math::Sqr(mean[j]);
-        if (shift>=cutoff) break;
-       }
-       if (shift<cutoff) break;
-      }     
-     }
-     else
-     {
-      real32 * from = out + (fvSize+1)*pods[i]; 
-      for (nat32 j=0;j<fvSize;j++) targ[j+1] = from[j+1];
-     }
+   useGrid = BuildGrid(vect);
+
+   // Fixed size blocks, farmed out in batches so progress can be reported...
+    nat32 blockSize = math::Max<nat32>(4096,samples/512);
+    nat32 blocks = (samples+blockSize-1)/blockSize;
+    nat32 batch = mt::DefaultPool().Concurrency()*4;
+
+    Block block(*this,blockSize,pods,vect,stride);
+    for (nat32 b=0;b<blocks;b+=batch)
+    {
+     prog->Report(b,blocks);
+     mt::ParallelFor(b,math::Min(b+batch,blocks),block,1);
+    }
+
+   mem::Free(gridStart);
+   mem::Free(gridItem);
+   gridStart = null<nat32*>();
+   gridItem = null<nat32*>();
+   useGrid = false;
+  }
+  else
+  {
+   for (nat32 i=0;i<samples;i++)
+   {
+    prog->Report(i,samples);
+    Converge(i,0,samples,pods,mi,ma,ipos,vect,stride,mean);
+   }
   }
 
  // If the passover optimisation was used we need to clean up...
@@ -335,6 +422,11 @@ void MeanShift::CalcShift(nat32 * mi,nat32 * ma,nat32 * pos,real32 * data,nat32
   real32 weight = 0.0;
 
 
+ // Note if the distance is one of the built in ones, so it can be inlined...
+  bit inlDefault = Distance==&DistDefault;
+  bit inlJoint = Distance==&DistJoint;
+
+
  // Generate the minimum/maximum values for each coordinate, to save repeated 
  // recalculation in the inner loop...
   nat32 vecPos = 1;
@@ -354,38 +446,31 @@ void MeanShift::CalcShift(nat32 * mi,nat32 * ma,nat32 * pos,real32 * data,nat32
   }
 
 
- // Iterate every relevent node and sum in its contribution...
-  for (nat32 i=0;i<dim.Size();i++) pos[i] = mi[i];
-  
-  bit ok = true;
-  while (ok)
+ // Iterate every relevent node and sum in its contribution, a run along the
+ // first dimension at a time so the inner loop just steps through memory...
+  nat32 step = fvSize + 1;
+  nat32 run = ma[0] - mi[0] + 1;
+  for (nat32 i=1;i<dim.Size();i++) pos[i] = mi[i];
+
+  while (true)
   {
-   // Sum in this particular node...
-    // Get the relevent pointer to the vector including the weight...
-     real32 * targ = data;
-     for (nat32 i=0;i<dim.Size();i++) targ += pos[i]*stride[i]*(fvSize+1);
-
-    // Calculate the distance of this vector from our vector, if its too far skip it...
-     if (Distance(fvSize,targ+1,vector+1,passThrough))
-     {
-      // The distance multiplied by the points weight is now the weighting for the point,
-      // sum this in...
-       real32 we = targ[0];
-       weight += we;
-       for (nat32 i=0;i<fvSize;i++) mean[i] += we*(targ[i+1] - vector[i+1]);
-     }
-
-   // Incriment to the next position...
-    ++pos[0];
-
-   // Do the pos incriment count along...
-    for (nat32 i=0;i<dim.Size();i++)
+   // Get the pointer to the start of the run, including the weight...
+    real32 * targ = data + mi[0]*step;
+    for (nat32 i=1;i<dim.Size();i++) targ += pos[i]*stride[i]*step;
+
+   // Sum it in, with the distance test inlined if its one of the built in ones...
+    if (inlDefault) SumRun(DefaultTest(fvSize),fvSize,targ,run,vector,mean,weight);
+    else if (inlJoint) SumRun(JointTest(fvSize,split),fvSize,targ,run,vector,mean,weight);
+    else SumRun(FuncTest(Distance,fvSize,passThrough),fvSize,targ,run,vector,mean,weight);
+
+   // Move to the next run...
+    nat32 i = 1;
+    for (;i<dim.Size();i++)
     {
-     if (pos[i]<=ma[i]) break;
-     if (i==dim.Size()-1) {ok = false; break;}
+     if (pos[i]<ma[i]) {++pos[i]; break;}
      pos[i] = mi[i];
-     ++pos[i+1];
     }
+    if (i>=dim.Size()) break;
   }
 
 
@@ -397,6 +482,199 @@ void MeanShift::CalcShift(nat32 * mi,nat32 * ma,nat32 * pos,real32 * data,nat32
   }
 }
 
+void MeanShift::Converge(nat32 i,nat32 begin,nat32 end,nat32 * pods,nat32 * mi,nat32 * ma,nat32 * pos,real32 * data,nat32 * stride,real32 * mean)
+{
+ real32 * targ = out + (fvSize+1)*i;
+
+ // Converge it, different code depending on if the passover optimisation
+ // is on or not...     
+  if ((!passOpt)||(pods[i]==i))
+  {
+   nat32 lastOver = i; // Used for a quick break out, saves a bit of pissing about.
+   for (nat32 k=0;k<max_iter;k++)
+   {
+    if (passOpt)
+    {
+     // Check if we are over a sample that has not converged, if so we become
+     // its parent, so it will be forced to converge to the same place this
+     // sample converges...
+      // Find the offset of the sample...
+       nat32 over = 0;
+       for (nat32 j=0;j<dim.Size();j++) over += nat32(math::Round(targ[j+1]/dim[j].scale))*stride[j];          
+      
+      // If its not us check if we can save some sampling...
+       if ((over!=lastOver)&&(over!=i)&&(over>=begin)&&(over<end))
+       { 
+	   lastOver = over;         
+        // We only concider matching to this pixel if the remainder of the
+        // feature vector, the non-dimensional features, eucledian distance
+        // in the scaled space is less than half.
+         real32 * ot = out + (fvSize+1)*over + 1 + dim.Size();
+         real32 dist = 0.0;
+         for (nat32 j=0;j<sf.Size();j++) dist += math::Sqr(ot[j]-targ[j+1+dim.Size()]);
+         if (dist<0.5)
+         {
+          // Two scenarios - either the node has not converged, and we arrange
+          // for it to converge to the same point we do, or it has converged 
+          // so we go where it is going...
+           if (pods[over]==over) pods[over] = i;
+           else
+           {
+            // Instead of doing any more mean shifting just head straight to the
+            // convergence point of the node found...
+             nat32 toUse = pods[over];
+             while (toUse!=pods[toUse]) toUse = pods[toUse];
+             
+             real32 * from = out + (fvSize+1)*toUse; 
+             for (nat32 j=0;j<fvSize;j++) targ[j+1] = from[j+1];
+           }
+         }
+       }
+    }
+    if (useGrid) CalcShiftGrid(data,targ,mean);
+            else CalcShift(mi,ma,pos,data,stride,targ,mean);
+    for (nat32 j=0;j<fvSize;j++) targ[j+1] += mean[j];
+ 
+    real32 shift = 0.0;
+    for (nat32 j=0;j<fvSize;j++)
+    {
+     shift += math::Sqr(mean[j]);
+     if (shift>=cutoff) break;
+    }
+    if (shift<cutoff) break;
+   }     
+  }
+  else
+  {
+   real32 * from = out + (fvSize+1)*pods[i]; 
+   for (nat32 j=0;j<fvSize;j++) targ[j+1] = from[j+1];
+  }
+}
+
+bit MeanShift::BuildGrid(real32 * data)
+{
+ // Only applicable if the lattice can't bound the search and the distance is
+ // known to be eucledian...
+  if (Distance!=&DistDefault) return false;
+  if (sf.Size()==0) return false;
+  bit bounded = true;
+  for (nat32 i=0;i<dim.Size();i++) {if (!dim[i].use) bounded = false;}
+  if (bounded) return false;
+
+ // Find the range of the first few field features...
+  gridDims = math::Min<nat32>(sf.Size(),3);
+  for (nat32 g=0;g<gridDims;g++)
+  {
+   gridEntry[g] = diUsed + g;
+   real32 low = data[1+gridEntry[g]];
+   real32 high = low;
+   for (nat32 i=1;i<samples;i++)
+   {
+    real32 v = data[i*(fvSize+1) + 1 + gridEntry[g]];
+    low = math::Min(low,v);
+    high = math::Max(high,v);
+   }
+   gridMin[g] = int32(math::RoundDown(low));
+   gridRes[g] = nat32(int32(math::RoundDown(high)) - gridMin[g]) + 1;
+  }
+
+ // Drop dimensions till the cell count is sane...
+  nat32 cells;
+  while (true)
+  {
+   real64 c = 1.0;
+   for (nat32 g=0;g<gridDims;g++) c *= real64(gridRes[g]);
+   if ((c<=real64(samples)*4.0+64.0)||(gridDims==1))
+   {
+    cells = nat32(c);
+    break;
+   }
+   --gridDims;
+  }
+  if (real64(cells)>real64(samples)*4.0+64.0) return false; // Single dimension with a crazy range.
+
+ // Counting sort the samples into the cells...
+  gridStart = mem::Malloc<nat32>(cells+1);
+  gridItem = mem::Malloc<nat32>(samples);
+  for (nat32 c=0;c<=cells;c++) gridStart[c] = 0;
+
+  nat32 * cell = mem::Malloc<nat32>(samples);
+  for (nat32 i=0;i<samples;i++)
+  {
+   real32 * v = data + i*(fvSize+1) + 1;
+   nat32 c = 0;
+   for (nat32 g=gridDims;g>0;g--)
+   {
+    nat32 gc = nat32(int32(math::RoundDown(v[gridEntry[g-1]])) - gridMin[g-1]);
+    c = c*gridRes[g-1] + gc;
+   }
+   cell[i] = c;
+   ++gridStart[c+1];
+  }
+
+  for (nat32 c=0;c<cells;c++) gridStart[c+1] += gridStart[c];
+  for (nat32 i=0;i<samples;i++) gridItem[gridStart[cell[i]]++] = i;
+  for (nat32 c=cells;c>0;c--) gridStart[c] = gridStart[c-1];
+  gridStart[0] = 0;
+
+  mem::Free(cell);
+
+ return true;
+}
+
+void MeanShift::CalcShiftGrid(real32 * data,real32 * vector,real32 * mean)
+{
+ for (nat32 i=0;i<fvSize;i++) mean[i] = 0.0;
+ real32 weight = 0.0;
+
+ // The range of cells to visit - as the window is of radius 1 and the cells
+ // are unit sized its at most 3 per dimension...
+  nat32 low[3];
+  nat32 high[3];
+  for (nat32 g=0;g<gridDims;g++)
+  {
+   int32 c = int32(math::RoundDown(vector[1+gridEntry[g]])) - gridMin[g];
+   low[g] = nat32(math::Max<int32>(c-1,0));
+   high[g] = nat32(math::Min<int32>(c+1,int32(gridRes[g])-1));
+   if (int32(low[g])>int32(high[g])) return;
+  }
+
+ // Iterate the cells, and the samples within them...
+  nat32 at[3];
+  for (nat32 g=0;g<gridDims;g++) at[g] = low[g];
+
+  while (true)
+  {
+   nat32 c = 0;
+   for (nat32 g=gridDims;g>0;g--) c = c*gridRes[g-1] + at[g-1];
+
+   for (nat32 j=gridStart[c];j<gridStart[c+1];j++)
+   {
+    real32 * targ = data + gridItem[j]*(fvSize+1);
+    if (DistInline(fvSize,targ+1,vector+1))
+    {
+     real32 we = targ[0];
+     weight += we;
+     for (nat32 i=0;i<fvSize;i++) mean[i] += we*(targ[i+1] - vector[i+1]);
+    }
+   }
+
+   nat32 g = 0;
+   for (;g<gridDims;g++)
+   {
+    if (at[g]<high[g]) {++at[g]; break;}
+    at[g] = low[g];
+   }
+   if (g==gridDims) break;
+  }
+
+ if (weight>0.0)
+ {
+  weight = 1.0/weight;
+  for (nat32 i=0;i<fvSize;i++) mean[i] = mean[i]*weight;
+ }
+}
+
 bit MeanShift::DistDefault(nat32 fvSize,real32 * fv1,real32 * fv2,real32)
 {
  real32 ret = 0.0;
@@ -408,6 +686,12 @@ bit MeanShift::DistDefault(nat32 fvSize,real32 * fv1,real32 * fv2,real32)
  return true;
 }
 
+bit MeanShift::DistJoint(nat32 fvSize,real32 * fv1,real32 * fv2,real32 pt)
+{
+ JointTest test(fvSize,nat32(pt));
+ return test(fv1,fv2);
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -30,6 +30,7 @@
 #include "eos/svt/field.h"
 #include "eos/ds/arrays.h"
 #include "eos/ds/lists.h"
+#include "eos/math/functions.h"
 #include "eos/time/progress.h"
 
 namespace eos
@@ -78,6 +79,13 @@ class EOS_CLASS MeanShift
   /// variables, if less than 1 return true, else return false.
    void SetDistance(bit (*Distance)(nat32 fvSize,real32 * fv1,real32 * fv2,real32 pt),real32 pt);
 
+  /// Changes the distance measure to a joint window, as used for image
+  /// smoothing - the first split entries of the feature vector and the
+  /// remainder must each be within a eucledian distance of 1, rather than the
+  /// vector as a whole. Unlike a function given to SetDistance this is done
+  /// inline, so is considerably faster. SetDistance replaces it.
+   void SetJointDistance(nat32 split);
+
   /// This registers a svt::Field which must go to a real32 as an element in the
   /// feature vector. You also supply a weighting, which will multiply any 
   /// extracted value before it is used. All fields must have the same dimensions and
@@ -108,6 +116,20 @@ class EOS_CLASS MeanShift
   /// behaviour for a mean shift image smoothing:-)
    void Passover(bit enabled);
 
+  /// Enables the accelerated mode, which defaults to off. The samples are split
+  /// into fixed size blocks that are converged in parallel. If the default
+  /// distance is in use and some dimensions are not features, so the lattice
+  /// optimisation can not bound the window in them, a uniform grid of unit
+  /// cells over the first few field features is built instead, so only the
+  /// samples in the neighbouring cells are visited rather than all of them.
+  /// The samples summed are the same as without it, but with the grid the
+  /// summation order differs so results match only to rounding. With the
+  /// passover optimisation samples are only passed over within there own
+  /// block, which gets slightly more of the accuracy back, and the block size
+  /// depends only on the sample count, so the result is the same regardless
+  /// of how many threads there are.
+   void Accelerate(bit enabled);
+
   /// A conveniance, allows you to set the window size independently of the scales set.
    void SetWindowSize(real32 size);
    
@@ -148,6 +170,7 @@ class EOS_CLASS MeanShift
    real32 cutoff; // When the shift eucledian distance is less than the square-root of this stop shifting.
    real32 max_iter; // Maximum number of iterations to do before giving up, assuming above is not reached.
    bit passOpt; // When true the pass-over optimisation is done.
+   bit accel; // When true the accelerated mode is used.
 
   // Methods used during the calculation...
    // Calculates the starting vector for a particular entry.
@@ -156,6 +179,16 @@ class EOS_CLASS MeanShift
    // data is the array to get values from, stride is the offset for each dimension, vector as 
    // the vector+weight of the vector to calculate for and mean as the output mean value for the window.
     void CalcShift(nat32 * mi,nat32 * ma,nat32 * pos,real32 * data,nat32 * stride,real32 * vector,real32 * mean);
+   // As above, but using the grid, for the accelerated mode...
+    void CalcShiftGrid(real32 * data,real32 * vector,real32 * mean);
+   // Converges sample i, with passover restricted to samples in [begin,end).
+   // mi, ma, pos and mean are tempory storage, as for CalcShift...
+    void Converge(nat32 i,nat32 begin,nat32 end,nat32 * pods,nat32 * mi,nat32 * ma,nat32 * pos,real32 * data,nat32 * stride,real32 * mean);
+   // Builds the grid for the accelerated mode, returns false if its not
+   // applicable...
+    bit BuildGrid(real32 * data);
+
+   class Block;
 
   // Inputs...
    real32 window; // Size of window.
@@ -182,6 +215,18 @@ class EOS_CLASS MeanShift
    nat32 fvSize; // Feature vector size.
 
 
+  // The grid, only for the accelerated mode, cells are unit sized and indexed
+  // by the floor of the feature minus gridMin, with gridStart giving the range
+  // of gridItem that contains the samples of each cell...
+   bit useGrid;
+   nat32 gridDims;
+   nat32 gridEntry[3]; // Offset in the feature vector, excluding the weight.
+   int32 gridMin[3];
+   nat32 gridRes[3];
+   nat32 * gridStart;
+   nat32 * gridItem;
+
+
   // Outputs...
    real32 * out;
 
@@ -190,8 +235,23 @@ class EOS_CLASS MeanShift
     bit (*Distance)(nat32 fvSize,real32 * fv1,real32 * fv2,real32 pt);
    // The pass through variable, passed into the distance function, ushally a scaler.
     real32 passThrough;
+   // Where the feature vector is split for the joint distance.
+    nat32 split;
    // The default feature vector distance proccessor...
     static bit DistDefault(nat32 fvSize,real32 * fv1,real32 * fv2,real32 pt);
+   // The same, but inline, used directly when the above is selected...
+    static inline bit DistInline(nat32 fvSize,const real32 * fv1,const real32 * fv2)
+    {
+     real32 ret = 0.0;
+     for (nat32 i=0;i<fvSize;i++)
+     {
+      ret += math::Sqr(fv1[i] - fv2[i]);
+      if (ret>1.0) return false;
+     }
+     return true;
+    }
+   // The joint distance, selected with SetJointDistance, with pt the split...
+    static bit DistJoint(nat32 fvSize,real32 * fv1,real32 * fv2,real32 pt);
 };
 
 //------------------------------------------------------------------------------
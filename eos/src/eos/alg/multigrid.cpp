@@ -18,14 +18,275 @@
 #include "eos/alg/multigrid.h"
 
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace alg
  {
+//------------------------------------------------------------------------------
+// Does one colour of the RedBlack smoother, for a range of rows, summing the
+// change of each row into rowSum...
+class Multigrid2D::ColourSweep
+{
+ public:
+  ColourSweep(Multigrid2D & s,Level & l,nat32 kk,nat32 ss,nat32 cc)
+  :self(s),lev(l),k(kk),step(ss),colour(cc)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   const real32 * a = lev.a.Ptr();
+   const real32 * b = lev.b.Ptr();
+   const int32 * off = lev.offset.Ptr();
+   real32 * x = lev.x.Ptr();
+
+   for (nat32 y=y0;y<y1;y++)
+   {
+    real64 change = 0.0;
+    nat32 start = (colour + k - ((step*y)%k))%k;
+    for (nat32 xx=start;xx<lev.width;xx+=k)
+    {
+     nat32 i = y*lev.width + xx;
+     const real32 * ai = a + i*lev.ss;
+
+     real32 val = 0.0;
+     for (nat32 se=1;se<lev.ss;se++)
+     {
+      if (!math::IsZero(ai[se])) val += ai[se] * x[int32(i)+off[se]];
+     }
+
+     real32 newX = (b[i] - val)/ai[0];
+     if (math::IsFinite(newX))
+     {
+      change += math::Abs(x[i] - newX);
+      x[i] = newX;
+     }
+    }
+    self.rowSum[y] = change;
+   }
+  }
+
+
+ private:
+  Multigrid2D & self;
+  Level & lev;
+  nat32 k;
+  nat32 step;
+  nat32 colour;
+};
+
+//------------------------------------------------------------------------------
+// Calculates the weighted Jacobi update for a range of rows, into r, summing
+// the change of each row into rowSum...
+class Multigrid2D::JacobiSweep
+{
+ public:
+  JacobiSweep(Multigrid2D & s,Level & l,real32 w)
+  :self(s),lev(l),weight(w)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   const real32 * a = lev.a.Ptr();
+   const real32 * b = lev.b.Ptr();
+   const int32 * off = lev.offset.Ptr();
+   const real32 * x = lev.x.Ptr();
+   real32 * r = lev.r.Ptr();
+
+   for (nat32 y=y0;y<y1;y++)
+   {
+    real64 change = 0.0;
+    for (nat32 i=y*lev.width;i<(y+1)*lev.width;i++)
+    {
+     const real32 * ai = a + i*lev.ss;
+
+     real32 val = 0.0;
+     for (nat32 se=1;se<lev.ss;se++)
+     {
+      if (!math::IsZero(ai[se])) val += ai[se] * x[int32(i)+off[se]];
+     }
+
+     real32 newX = (b[i] - val)/ai[0];
+     if (math::IsFinite(newX))
+     {
+      newX = (1.0-weight)*x[i] + weight*newX;
+      change += math::Abs(x[i] - newX);
+      r[i] = newX;
+     }
+     else r[i] = x[i];
+    }
+    self.rowSum[y] = change;
+   }
+  }
+
+
+ private:
+  Multigrid2D & self;
+  Level & lev;
+  real32 weight;
+};
+
+//------------------------------------------------------------------------------
+// Calculates the residual of each node into r, for a range of rows, with the
+// sum of squares of each row into rowSum, and the sum of squares of b into
+// bSum if its provided...
+class Multigrid2D::Residuals
+{
+ public:
+  Residuals(Multigrid2D & s,Level & l,real64 * bs = null<real64*>())
+  :self(s),lev(l),bSum(bs)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   const real32 * a = lev.a.Ptr();
+   const real32 * b = lev.b.Ptr();
+   const int32 * off = lev.offset.Ptr();
+   const real32 * x = lev.x.Ptr();
+   real32 * r = lev.r.Ptr();
+
+   for (nat32 y=y0;y<y1;y++)
+   {
+    real64 sum = 0.0;
+    real64 sumB = 0.0;
+    for (nat32 i=y*lev.width;i<(y+1)*lev.width;i++)
+    {
+     const real32 * ai = a + i*lev.ss;
+
+     r[i] = b[i];
+     for (nat32 se=0;se<lev.ss;se++)
+     {
+      if (!math::IsZero(ai[se])) r[i] -= ai[se] * x[int32(i)+off[se]];
+     }
+     sum += math::Sqr(r[i]);
+     sumB += math::Sqr(b[i]);
+    }
+    self.rowSum[y] = sum;
+    if (bSum) bSum[y] = sumB;
+   }
+  }
+
+
+ private:
+  Multigrid2D & self;
+  Level & lev;
+  real64 * bSum;
+};
+
+//------------------------------------------------------------------------------
+// Downsamples the residual of one level into the b's of the next, zeroing its
+// x's, for a range of rows of the coarser level...
+class Multigrid2D::Restrict
+{
+ public:
+  Restrict(const Level & f,Level & c)
+  :fine(f),coarse(c)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   const real32 * r = fine.r.Ptr();
+   nat32 fw = fine.width;
+
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=0;x<coarse.width;x++)
+    {
+     nat32 i = y*coarse.width + x;
+
+     // Zero the x, which is now an error vector...
+      coarse.x[i] = 0.0;
+
+     // Calculate the b's as the residual from the previous layer, down sampled...
+      nat32 twX = x*2;
+      nat32 twY = y*2;
+      nat32 j = twY*fw + twX;
+
+      bit incX = (twX+1)<fine.width;
+      bit decX = twX>0;
+      bit incY = (twY+1)<fine.height;
+      bit decY = twY>0;
+
+      if (incX&&decX&&incY&&decY)
+      {
+       coarse.b[i] = 0.25 * r[j] +
+                     0.125 * (r[j+1] + r[j-1] + r[j+fw] + r[j-fw]) +
+                     0.0625 * (r[j+fw+1] + r[j-fw+1] + r[j+fw-1] + r[j-fw-1]);
+      }
+      else
+      {
+       coarse.b[i] = r[j];
+      }
+    }
+   }
+  }
+
+
+ private:
+  const Level & fine;
+  Level & coarse;
+};
+
+//------------------------------------------------------------------------------
+// Offsets the x's of one level by the linearly interpolated x's of the next,
+// for a range of rows of the finer level...
+class Multigrid2D::Prolong
+{
+ public:
+  Prolong(Level & f,const Level & c)
+  :fine(f),coarse(c)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   const real32 * cx = coarse.x.Ptr();
+   nat32 cw = coarse.width;
+
+   for (nat32 y=y0;y<y1;y++)
+   {
+    nat32 halfY = y/2;
+    bit oddY = (y%2)==1;
+    nat32 nextY = math::Min(halfY+1,coarse.height-1);
+
+    for (nat32 x=0;x<fine.width;x++)
+    {
+     nat32 halfX = x/2;
+     bit oddX = (x%2)==1;
+     nat32 nextX = math::Min(halfX+1,cw-1);
+
+     real32 offset;
+     if (oddX)
+     {
+      if (oddY)
+      {
+       offset = 0.25 * (cx[halfY*cw+halfX] + cx[halfY*cw+nextX] +
+                        cx[nextY*cw+halfX] + cx[nextY*cw+nextX]);
+      }
+      else offset = 0.5 * (cx[halfY*cw+halfX] + cx[halfY*cw+nextX]);
+     }
+     else
+     {
+      if (oddY) offset = 0.5 * (cx[halfY*cw+halfX] + cx[nextY*cw+halfX]);
+           else offset = cx[halfY*cw+halfX];
+     }
+     fine.x[y*fine.width + x] += offset;
+    }
+   }
+  }
+
+
+ private:
+  Level & fine;
+  const Level & coarse;
+};
+
 //------------------------------------------------------------------------------
 Multigrid2D::Multigrid2D()
-:speed(0.5),tolerance(0.001),maxIters(1024)
+:speed(0.5),tolerance(0.001),maxIters(1024),
+smoother(GaussSeidel),weight(0.8),
+cycle(VCycle),maxCycles(1),cycleTol(0.0),
+startResidual(0.0),stats(0,16,16),sweeps(0)
 {}
 
 Multigrid2D::~Multigrid2D()
@@ -48,36 +309,40 @@ void Multigrid2D::SetSize(nat32 width,nat32 height,nat32 stencilSize)
  }
 
 
- nat32 nodeSize = sizeof(Node) + sizeof(real32)*(stencilSize-1);
- data.Size(0); // Needed to make sure all data entrys are ready for construction finishing.
  data.Size(levels);
- 
- data[0].FinishCons(nodeSize,width,height);
- for (nat32 y=0;y<data[0].Height();y++)
+ for (nat32 l=0;l<data.Size();l++)
  {
-  for (nat32 x=0;x<data[0].Width();x++)
+  Level & lev = data[l];
+  if (l==0)
   {
-   data[0].Get(x,y).b = 0.0;
-   data[0].Get(x,y).x = 0.0;
-   for (nat32 s=0;s<stencil[0].Size();s++) data[0].Get(x,y).a[s] = 0.0;
+   lev.width = width;
+   lev.height = height;
   }
- }
- 
- for (nat32 l=1;l<data.Size();l++)
- {
-  nat32 newWidth = (data[l-1].Width()/2) + (((data[l-1].Width()%2)==1)?1:0);
-  nat32 newHeight = (data[l-1].Height()/2) + (((data[l-1].Height()%2)==1)?1:0);
-  data[l].FinishCons(nodeSize,newWidth,newHeight);
-  for (nat32 y=0;y<data[l].Height();y++)
+  else
   {
-   for (nat32 x=0;x<data[l].Width();x++)
-   {
-    data[l].Get(x,y).b = 0.0;
-    data[l].Get(x,y).x = 0.0;
-    for (nat32 s=0;s<stencil[l].Size();s++) data[l].Get(x,y).a[s] = 0.0;
-   }
-  }  
+   lev.width = (data[l-1].width/2) + (((data[l-1].width%2)==1)?1:0);
+   lev.height = (data[l-1].height/2) + (((data[l-1].height%2)==1)?1:0);
+  }
+  lev.ss = stencilSize;
+
+  nat32 nodes = lev.width*lev.height;
+  lev.b.Size(nodes);
+  lev.x.Size(nodes);
+  lev.r.Size(nodes);
+  lev.a.Size(nodes*stencilSize);
+  for (nat32 i=0;i<nodes;i++)
+  {
+   lev.b[i] = 0.0;
+   lev.x[i] = 0.0;
+   lev.r[i] = 0.0;
+  }
+  for (nat32 i=0;i<lev.a.Size();i++) lev.a[i] = 0.0;
+
+  lev.offset.Size(stencilSize);
+  PrepOffsets(l);
  }
+
+ if (levels!=0) rowSum.Size(data[0].height);
 }
 
 nat32 Multigrid2D::Levels() const
@@ -87,12 +352,12 @@ nat32 Multigrid2D::Levels() const
 
 nat32 Multigrid2D::Width(nat32 level) const
 {
- return data[level].Width();
+ return data[level].width;
 }
 
 nat32 Multigrid2D::Height(nat32 level) const
 {
- return data[level].Height();
+ return data[level].height;
 }
 
 void Multigrid2D::SetOffset(nat32 level,nat32 se,int32 offX,int32 offY)
@@ -101,6 +366,7 @@ void Multigrid2D::SetOffset(nat32 level,nat32 se,int32 offX,int32 offY)
  {
   stencil[level][se].x = offX;
   stencil[level][se].y = offY;
+  PrepOffsets(level);
  }
 }
 
@@ -109,70 +375,71 @@ void Multigrid2D::SpreadFirstStencil()
  for (nat32 l=1;l<stencil.Size();l++)
  {
   for (nat32 se=0;se<stencil[l].Size();se++) stencil[l][se] = stencil[0][se];
+  PrepOffsets(l);
  }
 }
 
 void Multigrid2D::SetB(nat32 level,nat32 x,nat32 y,real32 val)
 {
- data[level].Get(x,y).b = val;
+ data[level].b[y*data[level].width + x] = val;
 }
 
 void Multigrid2D::SetA(nat32 level,nat32 x,nat32 y,nat32 se,real32 val)
 {
  int32 posX = int32(x) + stencil[level][se].x;
- if ((posX<0)||(posX>=int32(data[level].Width()))) return;
+ if ((posX<0)||(posX>=int32(data[level].width))) return;
  
  int32 posY = int32(y) + stencil[level][se].y; 
- if ((posY<0)||(posY>=int32(data[level].Height()))) return;
+ if ((posY<0)||(posY>=int32(data[level].height))) return;
  
- data[level].Get(x,y).a[se] = val;
+ data[level].a[(y*data[level].width + x)*data[level].ss + se] = val;
 }
 
 void Multigrid2D::ZeroA(nat32 level,nat32 x,nat32 y)
 {
- for (nat32 se=0;se<stencil[level].Size();se++) data[level].Get(x,y).a[se] = 0.0;
+ real32 * a = &data[level].a[(y*data[level].width + x)*data[level].ss];
+ for (nat32 se=0;se<stencil[level].Size();se++) a[se] = 0.0;
 }
   
 void Multigrid2D::AddA(nat32 level,nat32 x,nat32 y,nat32 se,real32 val)
 {
  int32 posX = int32(x) + stencil[level][se].x;
- if ((posX<0)||(posX>=int32(data[level].Width()))) return;
+ if ((posX<0)||(posX>=int32(data[level].width))) return;
  
  int32 posY = int32(y) + stencil[level][se].y; 
- if ((posY<0)||(posY>=int32(data[level].Height()))) return;
+ if ((posY<0)||(posY>=int32(data[level].height))) return;
  
- data[level].Get(x,y).a[se] += val;
+ data[level].a[(y*data[level].width + x)*data[level].ss + se] += val;
 }
 
 real32 Multigrid2D::GetA(nat32 level,nat32 x,nat32 y,nat32 se)
 {
  int32 posX = int32(x) + stencil[level][se].x;
- if ((posX<0)||(posX>=int32(data[level].Width()))) return 0.0;
+ if ((posX<0)||(posX>=int32(data[level].width))) return 0.0;
  
  int32 posY = int32(y) + stencil[level][se].y; 
- if ((posY<0)||(posY>=int32(data[level].Height()))) return 0.0;
+ if ((posY<0)||(posY>=int32(data[level].height))) return 0.0;
  
- return data[level].Get(x,y).a[se];
+ return data[level].a[(y*data[level].width + x)*data[level].ss + se];
 }
    
 void Multigrid2D::Fix(nat32 level,nat32 x,nat32 y,real32 val)
 {
- data[level].Get(x,y).b = val;
- data[level].Get(x,y).a[0] = 1.0;
- for (nat32 se=1;se<stencil[level].Size();se++) data[level].Get(x,y).a[se] = 0.0;
+ nat32 i = y*data[level].width + x;
+ real32 * a = &data[level].a[i*data[level].ss];
+ data[level].b[i] = val;
+ a[0] = 1.0;
+ for (nat32 se=1;se<stencil[level].Size();se++) a[se] = 0.0;
 }
 
 void Multigrid2D::SetX(nat32 level,nat32 x,nat32 y,real32 val)
 {
- data[level].Get(x,y).x = val;
+ data[level].x[y*data[level].width + x] = val;
 }
 
 void Multigrid2D::OffsetX(nat32 level,real32 offset)
 {
- for (nat32 y=0;y<data[level].Height();y++)
- {
-  for (nat32 x=0;x<data[level].Width();x++) data[level].Get(x,y).x += offset;
- }
+ for (nat32 i=0;i<data[level].x.Size();i++) data[level].x[i] += offset;
 }
 
 void Multigrid2D::SetSpeed(real32 s)
@@ -186,6 +453,19 @@ void Multigrid2D::SetIters(real32 t,nat32 mi)
  maxIters = mi;
 }
 
+void Multigrid2D::SetSmoother(Smoother s,real32 w)
+{
+ smoother = s;
+ weight = w;
+}
+
+void Multigrid2D::SetCycle(Cycle c,nat32 mc,real32 t)
+{
+ cycle = c;
+ maxCycles = mc;
+ cycleTol = t;
+}
+
 void Multigrid2D::Run(time::Progress * prog)
 {
  LogTime("eos::alg::Multigrid2D::Run");
@@ -249,44 +529,58 @@ void Multigrid2D::ReRun(time::Progress * prog)
 {
  LogTime("eos::alg::Multigrid2D::ReRun");
  prog->Push();
- nat32 step = 0;
- nat32 steps = (data.Size()-1)*4 + 1;
- 
- // First attempt...
-  //LogDebug("Start ReRun");
-  prog->Report(step++,steps);
-  //LogDebug("(U) Pre residual at level 0 is " << TotalResidual(0));
-  Solve(0,prog);  
-  //LogDebug("(U) Post residual at level 0 is " << TotalResidual(0));
 
+ stats.Size(0);
+ startResidual = RelResidual(0);
 
- // Go up to the top of the hierachy...
-  for (int32 l=1;l<int32(data.Size());l++)
-  {
-   prog->Report(step++,steps);
-   TransferUp(l-1,prog);
-   
-   prog->Report(step++,steps);
-   //LogDebug("(U) Pre residual at level " << l << " is " << TotalResidual(l));
-   Solve(l,prog);
-   //LogDebug("(U) Post residual at level " << l << " is " << TotalResidual(l));
-  }
+ for (nat32 c=0;c<maxCycles;c++)
+ {
+  prog->Report(c,maxCycles);
+  if ((cycleTol>0.0)&&(startResidual<cycleTol)&&(c==0)) break;
+  sweeps = 0;
 
- 
- // And all the way back down again...
-  for (int32 l=int32(data.Size())-2;l>=0;l--)
+  switch (cycle)
   {
-   prog->Report(step++,steps);
-   TransferDown(l,prog);
-   
-   prog->Report(step++,steps);
-   //LogDebug("(D) Pre residual at level " << l << " is " << TotalResidual(l));
-   Solve(l,prog);
-   //LogDebug("(D) Post residual at level " << l << " is " << TotalResidual(l));
+   case VCycle: DoCycle(0,1,prog); break;
+   case WCycle: DoCycle(0,2,prog); break;
+   case FullCycle:
+   {
+    // Transfer the residual all the way up, solve at the top and come back
+    // down, doing a V cycle from each level on the way...
+     prog->Push();
+     nat32 step = 0;
+     nat32 steps = data.Size()*2;
+     for (nat32 l=1;l<data.Size();l++)
+     {
+      prog->Report(step++,steps);
+      TransferUp(l-1,prog);
+     }
+
+     prog->Report(step++,steps);
+     Solve(data.Size()-1,prog);
+
+     for (int32 l=int32(data.Size())-2;l>=0;l--)
+     {
+      prog->Report(step++,steps);
+      TransferDown(l,prog);
+
+      prog->Report(step++,steps);
+      DoCycle(l,1,prog);
+     }
+     prog->Pop();
+   }
+   break;
   }
-  
-  //LogDebug("End ReRun");
- 
+
+  nat32 ind = stats.Size();
+  stats.Size(ind+1);
+  stats[ind].residual = RelResidual(0);
+  stats[ind].sweeps = sweeps;
+  LogDebug("[multigrid] cycle {cycle,residual,sweeps}" << LogDiv() << c << LogDiv() << stats[ind].residual << LogDiv() << sweeps);
+
+  if (stats[ind].residual<cycleTol) break;
+ }
+
  prog->Pop();
 }
 
@@ -295,54 +589,66 @@ void Multigrid2D::ZeroMean()
  // Calculate the mean, incrimentally for stability...
   real32 mean = 0.0;
   nat32 count = 0;
-  for (nat32 y=0;y<data[0].Height();y++)
+  for (nat32 i=0;i<data[0].x.Size();i++)
   {
-   for (nat32 x=0;x<data[0].Width();x++)
-   {
-    count += 1;
-    mean += (data[0].Get(x,y).x-mean)/real32(count);
-   }
+   count += 1;
+   mean += (data[0].x[i]-mean)/real32(count);
   }
   
  // Apply the offset...
-  for (nat32 y=0;y<data[0].Height();y++)
-  {
-   for (nat32 x=0;x<data[0].Width();x++) data[0].Get(x,y).x -= mean;
-  }
+  for (nat32 i=0;i<data[0].x.Size();i++) data[0].x[i] -= mean;
 }
 
 void Multigrid2D::GetX(ds::Array2D<real32> & out) const
 {
- for (nat32 y=0;y<data[0].Height();y++)
+ for (nat32 y=0;y<data[0].height;y++)
  {
-  for (nat32 x=0;x<data[0].Width();x++) out.Get(x,y) = data[0].Get(x,y).x;
+  for (nat32 x=0;x<data[0].width;x++) out.Get(x,y) = data[0].x[y*data[0].width + x];
  }
 }
 
 void Multigrid2D::GetX(svt::Field<real32> & out) const
 {
- for (nat32 y=0;y<data[0].Height();y++)
+ for (nat32 y=0;y<data[0].height;y++)
  {
-  for (nat32 x=0;x<data[0].Width();x++) out.Get(x,y) = data[0].Get(x,y).x;
+  for (nat32 x=0;x<data[0].width;x++) out.Get(x,y) = data[0].x[y*data[0].width + x];
  }
 }
 
 real32 Multigrid2D::Residual(nat32 level,nat32 x,nat32 y)
 {
- real32 ret = data[level].Get(x,y).b;
-   
- for (nat32 se=0;se<stencil[level].Size();se++)
+ const Level & lev = data[level];
+ nat32 i = y*lev.width + x;
+ const real32 * a = &lev.a[i*lev.ss];
+
+ real32 ret = lev.b[i];
+ for (nat32 se=0;se<lev.ss;se++)
  {
-  if (!math::IsZero(data[level].Get(x,y).a[se]))
-  {
-   real32 rx = data[level].Get(x+stencil[level][se].x,y+stencil[level][se].y).x;
-   ret -= data[level].Get(x,y).a[se] * rx;
-  }
+  if (!math::IsZero(a[se])) ret -= a[se] * lev.x[int32(i)+lev.offset[se]];
  }
  
  return ret;
 }
 
+real32 Multigrid2D::RelResidual(nat32 level)
+{
+ Level & lev = data[level];
+ ds::Array<real64> bSum(lev.height);
+ Residuals residuals(*this,lev,bSum.Ptr());
+ mt::ParallelFor(nat32(0),lev.height,residuals,16);
+
+ real64 sum = 0.0;
+ real64 sumB = 0.0;
+ for (nat32 y=0;y<lev.height;y++)
+ {
+  sum += rowSum[y];
+  sumB += bSum[y];
+ }
+
+ if (math::IsZero(sumB)) return math::Sqrt(sum);
+ return math::Sqrt(sum/sumB);
+}
+
 cstrconst Multigrid2D::TypeString() const
 {
 return "eos::alg::Multigrid2D";
@@ -355,67 +661,17 @@ void Multigrid2D::TransferUp(nat32 from,time::Progress * prog)
  prog->Push();
  // First pass to calculate the residual...
   prog->Report(0,2);
-  prog->Push();
-  for (nat32 y=0;y<data[from].Height();y++)
   {
-   prog->Report(y,data[from].Height());
-   for (nat32 x=0;x<data[from].Width();x++)
-   {
-    data[from].Get(x,y).r = data[from].Get(x,y).b;
-    
-    for (nat32 se=0;se<stencil[from].Size();se++)
-    {
-     if (!math::IsZero(data[from].Get(x,y).a[se]))
-     {
-      real32 rx = data[from].Get(x+stencil[from][se].x,y+stencil[from][se].y).x;
-      data[from].Get(x,y).r -= data[from].Get(x,y).a[se] * rx;
-     }
-    }
-   }
+   Residuals residuals(*this,data[from]);
+   mt::ParallelFor(nat32(0),data[from].height,residuals,16);
   }
-  prog->Pop();
 
  // Second pass to transfer the residual up into the b vector and zero the x's...
   prog->Report(1,2);
-  prog->Push();
-  for (nat32 y=0;y<data[from+1].Height();y++)
   {
-   prog->Report(y,data[from+1].Height());
-   for (nat32 x=0;x<data[from+1].Width();x++)
-   {
-    // Zero the x, which is now an error vector...
-     data[from+1].Get(x,y).x = 0.0;
-  
-    // Calculate the b's as the residual from the previous layer, down sampled...
-     nat32 twX = x*2;
-     nat32 twY = y*2;
-    
-     bit incX = (twX+1)<data[from].Width();
-     bit decX = twX>0;
-     bit incY = (twY+1)<data[from].Height();
-     bit decY = twY>0;
-     
-     if (incX&&decX&&incY&&decY)
-     {
-      data[from+1].Get(x,y).b = 0.25 * data[from].Get(twX,twY).r;
-     
-      data[from+1].Get(x,y).b += 0.125 * data[from].Get(twX+1,twY).r;
-      data[from+1].Get(x,y).b += 0.125 * data[from].Get(twX-1,twY).r;
-      data[from+1].Get(x,y).b += 0.125 * data[from].Get(twX,twY+1).r;
-      data[from+1].Get(x,y).b += 0.125 * data[from].Get(twX,twY-1).r;
-     
-      data[from+1].Get(x,y).b += 0.0625 * data[from].Get(twX+1,twY+1).r;
-      data[from+1].Get(x,y).b += 0.0625 * data[from].Get(twX+1,twY-1).r;
-      data[from+1].Get(x,y).b += 0.0625 * data[from].Get(twX-1,twY+1).r;
-      data[from+1].Get(x,y).b += 0.0625 * data[from].Get(twX-1,twY-1).r;
-     }
-     else
-     {
-      data[from+1].Get(x,y).b = data[from].Get(twX,twY).r;
-     }
-   }
+   Restrict restrict(data[from],data[from+1]);
+   mt::ParallelFor(nat32(0),data[from+1].height,restrict,16);
   }
-  prog->Pop();
   
  prog->Pop();
 }
@@ -423,140 +679,180 @@ void Multigrid2D::TransferUp(nat32 from,time::Progress * prog)
 void Multigrid2D::TransferDown(nat32 to,time::Progress * prog)
 {
  LogTime("eos::alg::Multigrid2D::TransferDown");
- prog->Push();
- 
  // Below uses simple linear interpolation.
-  for (nat32 y=0;y<data[to].Height();y++)
-  {
-   prog->Report(y,data[to].Height());
-   for (nat32 x=0;x<data[to].Width();x++)
-   {
-    nat32 halfX = x/2;
-    nat32 halfY = y/2;
-    bit oddX = (x%2)==1;
-    bit oddY = (y%2)==1;
-   
-    real32 offset = 0.0;
-     if (oddX)
-     {
-      if (oddY)
-      {
-       offset = data[to+1].Get(halfX,halfY).x + data[to+1].ClampGet(halfX+1,halfY).x +
-                data[to+1].ClampGet(halfX,halfY+1).x + data[to+1].ClampGet(halfX+1,halfY+1).x;
-       offset *= 0.25;
-      }
-      else
-      {
-       offset = data[to+1].Get(halfX,halfY).x + data[to+1].ClampGet(halfX+1,halfY).x;
-       offset *= 0.5;
-      }
-     }
-     else
-     {
-      if (oddY)
-      {
-       offset = data[to+1].Get(halfX,halfY).x + data[to+1].ClampGet(halfX,halfY+1).x;
-       offset *= 0.5;
-      }
-      else
-      {
-       offset = data[to+1].Get(halfX,halfY).x;
-      }
-     }
-    data[to].Get(x,y).x += offset;
-   }
-  }
-  
- prog->Pop();
+  Prolong prolong(data[to],data[to+1]);
+  mt::ParallelFor(nat32(0),data[to].height,prolong,16);
 }
 
 void Multigrid2D::Solve(nat32 level,time::Progress * prog)
 {
  LogTime("eos::alg::Multigrid2D::Solve");
  prog->Push();
+ Level & lev = data[level];
+
+ Smoother method = smoother;
+ nat32 k = 1;
+ nat32 s = 0;
+ if ((method==RedBlack)&&(!Colouring(level,k,s))) method = GaussSeidel;
+
  real32 lastChange = 0.0; 
  for (nat32 iter=0;iter<maxIters;iter++)
  {
   prog->Report(iter,maxIters);
+  ++sweeps;
   real32 change = 0.0;
-  // Symmetric implimentation - direction depends on iter number...
-   if ((iter%2)==0)
+  switch (method)
+  {
+   case GaussSeidel:
    {
-    for (int32 y=0;y<int32(data[level].Height());y++)
-    {
-     for (int32 x=0;x<int32(data[level].Width());x++)
+    const real32 * b = lev.b.Ptr();
+    const int32 * off = lev.offset.Ptr();
+    real32 * x = lev.x.Ptr();
+
+    // Symmetric implimentation - direction depends on iter number...
+     if ((iter%2)==0)
      {
-      real32 val = 0.0;
-      for (nat32 se=1;se<stencil[level].Size();se++)
+      for (int32 i=0;i<int32(lev.x.Size());i++)
       {
-       if (!math::IsZero(data[level].Get(x,y).a[se]))
+       const real32 * a = &lev.a[i*lev.ss];
+       real32 val = 0.0;
+       for (nat32 se=1;se<lev.ss;se++)
        {
-        val += data[level].Get(x,y).a[se] * data[level].Get(x+stencil[level][se].x,y+stencil[level][se].y).x;
+        if (!math::IsZero(a[se])) val += a[se] * x[i+off[se]];
+       }
+
+       real32 newX = (b[i] - val)/a[0];
+       if (math::IsFinite(newX))
+       {
+        change += math::Abs(x[i] - newX);
+        x[i] = newX;
        }
-      }
-      
-      real32 newX = (data[level].Get(x,y).b - val)/data[level].Get(x,y).a[0];
-      if (math::IsFinite(newX))
-      {
-       change += math::Abs(data[level].Get(x,y).x - newX);
-       data[level].Get(x,y).x = newX;
       }
      }
-    }
-   }
-   else
-   {
-    for (int32 y=int32(data[level].Height())-1;y>=0;y--)
-    {
-     for (int32 x=int32(data[level].Width())-1;x>=0;x--)
+     else
      {
-      real32 val = 0.0;
-      for (nat32 se=1;se<stencil[level].Size();se++)
+      for (int32 i=int32(lev.x.Size())-1;i>=0;i--)
       {
-       if (!math::IsZero(data[level].Get(x,y).a[se]))
+       const real32 * a = &lev.a[i*lev.ss];
+       real32 val = 0.0;
+       for (nat32 se=1;se<lev.ss;se++)
        {
-        val += data[level].Get(x,y).a[se] * data[level].Get(x+stencil[level][se].x,y+stencil[level][se].y).x;
+        if (!math::IsZero(a[se])) val += a[se] * x[i+off[se]];
+       }
+
+       real32 newX = (b[i] - val)/a[0];
+       if (math::IsFinite(newX))
+       {
+        change += math::Abs(x[i] - newX);
+        x[i] = (1.0-speed)*x[i] + speed*newX;
        }
-      }
-      
-      real32 newX = (data[level].Get(x,y).b - val)/data[level].Get(x,y).a[0];
-      if (math::IsFinite(newX))
-      {
-       change += math::Abs(data[level].Get(x,y).x - newX);
-       data[level].Get(x,y).x = (1.0-speed)*data[level].Get(x,y).x + speed*newX;
       }
      }
+   }
+   break;
+   case RedBlack:
+   {
+    real64 sum = 0.0;
+    for (nat32 c=0;c<k;c++)
+    {
+     ColourSweep sweep(*this,lev,k,s,c);
+     mt::ParallelFor(nat32(0),lev.height,sweep,16);
+     for (nat32 y=0;y<lev.height;y++) sum += rowSum[y];
     }
+    change = sum;
    }
+   break;
+   case Jacobi:
+   {
+    JacobiSweep sweep(*this,lev,weight);
+    mt::ParallelFor(nat32(0),lev.height,sweep,16);
+    mem::Copy(lev.x.Ptr(),lev.r.Ptr(),lev.x.Size());
+
+    real64 sum = 0.0;
+    for (nat32 y=0;y<lev.height;y++) sum += rowSum[y];
+    change = sum;
+   }
+   break;
+  }
 
   if (change<tolerance) break;
   if (math::Abs(change-lastChange)<(math::Sqr(tolerance)*0.1)) break;
-  if (lastChange<change) break;
+  if ((iter!=0)&&(lastChange<change)) break;
   lastChange = change;
  }
  prog->Pop();
 }
 
-real32 Multigrid2D::TotalResidual(nat32 level)
+void Multigrid2D::DoCycle(nat32 level,nat32 gamma,time::Progress * prog)
 {
- real32 residual = 0.0;
- for (nat32 y=0;y<data[level].Height();y++)
+ prog->Push();
+ if (level+1>=data.Size())
+ {
+  prog->Report(0,1);
+  Solve(level,prog);
+ }
+ else
  {
-  for (nat32 x=0;x<data[level].Width();x++)
+  nat32 step = 0;
+  nat32 steps = gamma + 3;
+
+  // Smooth, then solve for the error of that on the next level up...
+   prog->Report(step++,steps);
+   Solve(level,prog);
+
+   prog->Report(step++,steps);
+   TransferUp(level,prog);
+   for (nat32 g=0;g<gamma;g++)
+   {
+    prog->Report(step++,steps);
+    DoCycle(level+1,gamma,prog);
+   }
+
+  // Apply the correction and smooth again...
+   TransferDown(level,prog);
+   prog->Report(step++,steps);
+   Solve(level,prog);
+ }
+ prog->Pop();
+}
+
+void Multigrid2D::PrepOffsets(nat32 level)
+{
+ Level & lev = data[level];
+ for (nat32 se=0;se<lev.offset.Size();se++)
+ {
+  lev.offset[se] = stencil[level][se].x + stencil[level][se].y*int32(lev.width);
+ }
+}
+
+bit Multigrid2D::Colouring(nat32 level,nat32 & k,nat32 & s) const
+{
+ // Try each colour count in turn, with each step, and return the first where no 
+ // stencil entry links two nodes of the same colour...
+  for (k=2;k<=32;k++)
   {
-   real32 diff = data[level].Get(x,y).b;
-   
-   for (nat32 se=0;se<stencil[level].Size();se++)
+   for (s=1;s<k;s++)
    {
-    if (!math::IsZero(data[level].Get(x,y).a[se]))
+    bit ok = true;
+    for (nat32 se=1;se<stencil[level].Size();se++)
     {
-     real32 rx = data[level].Get(x+stencil[level][se].x,y+stencil[level][se].y).x;
-     diff -= data[level].Get(x,y).a[se] * rx;
+     int32 v = stencil[level][se].x + int32(s)*stencil[level][se].y;
+     if ((v%int32(k))==0) {ok = false; break;}
     }
+    if (ok) return true;
    }
-   residual += math::Sqr(diff);
   }
- }
+ return false;
+}
+
+real32 Multigrid2D::TotalResidual(nat32 level)
+{
+ Level & lev = data[level];
+ Residuals residuals(*this,lev);
+ mt::ParallelFor(nat32(0),lev.height,residuals,16);
+
+ real64 residual = 0.0;
+ for (nat32 y=0;y<lev.height;y++) residual += rowSum[y];
  return math::Pow<real32>(2.0,level)*math::Sqrt(residual);
 }
 
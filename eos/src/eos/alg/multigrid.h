@@ -26,6 +26,7 @@
 #include "eos/time/progress.h"
 #include "eos/ds/arrays.h"
 #include "eos/ds/arrays2d.h"
+#include "eos/ds/arrays_resize.h"
 #include "eos/svt/field.h"
 
 
@@ -47,6 +48,12 @@ namespace eos
 /// levels of the hierachy is implimented internally, using linear interpolation.
 /// Uses the FMG update scheme, for those who care, with symmetric
 /// Gauss-Seidel.
+///
+/// The smoother and, for ReRun, the cycle can be changed. The RedBlack and
+/// Jacobi smoothers split each level between the threads of the task pool, for
+/// large problems. Each level stores its x, b and stencil values as seperate
+/// contiguous arrays, the stencil values for each node together, with the
+/// stencil offsets turned into index offsets.
 class EOS_CLASS Multigrid2D
 {
  public:
@@ -128,6 +135,27 @@ class EOS_CLASS Multigrid2D
   /// tolerance under which to stop.
   /// Default tolerance is 0.001, maxIters is 1024.
    void SetIters(real32 tolerance,nat32 maxIters);
+
+  /// The smoothers avaliable.
+   enum Smoother {GaussSeidel, ///< Symmetric Gauss-Seidel, as above, single threaded. The default.
+                  RedBlack, ///< Gauss-Seidel in colours, such that no two nodes of a colour are in each others stencil, each colour done in parallel. For a 5 point stencil this is the traditional red-black checkerboard, larger stencils need more colours. speed is not used.
+                  Jacobi ///< Weighted Jacobi, in parallel. Converges slower than the others, but is the same regardless of thread count.
+                 };
+
+  /// Sets the smoother used on each level, with the weight of the new value for
+  /// the Jacobi smoother, 0.8 by default.
+   void SetSmoother(Smoother smoother,real32 weight = 0.8);
+
+  /// The cycles avaliable for ReRun.
+   enum Cycle {VCycle, ///< Down to the coarsest level and back again. The default.
+               WCycle, ///< As VCycle, but each coarser level is visited twice for each visit of the level below.
+               FullCycle ///< Transfers the residual all the way up, solves at the top and then comes down doing a V cycle from each level.
+              };
+
+  /// Sets the cycle used by ReRun, how many it may do and the relative residual,
+  /// |b-Ax|/|b| on level 0, under which it stops doing them. Defaults to a single
+  /// VCycle, with the tolerance of 0 meaning never stop early.
+   void SetCycle(Cycle cycle,nat32 maxCycles = 1,real32 tolerance = 0.0);
   
   /// Runs the algorithm.
   /// Finds a set of x's such that each b is calculated from multiplication of
@@ -144,7 +172,21 @@ class EOS_CLASS Multigrid2D
   /// Uses just the first level of the x matrix if you are providing 
   /// initialisation there.
   /// Can be called after a first call of Run, or without ever calling Run.
+  /// Does the cycles given to SetCycle, collecting the statistics below.
    void ReRun(time::Progress * prog = null<time::Progress*>());
+
+  /// After ReRun returns how many cycles were done.
+   nat32 CyclesDone() const {return stats.Size();}
+
+  /// After ReRun returns the relative residual before the first cycle.
+   real32 StartResidual() const {return startResidual;}
+
+  /// After ReRun returns the relative residual after the given cycle.
+   real32 CycleResidual(nat32 cycle) const {return stats[cycle].residual;}
+
+  /// After ReRun returns how many smoothing iterations were done during the given
+  /// cycle, summed over all levels.
+   nat32 CycleSweeps(nat32 cycle) const {return stats[cycle].sweeps;}
    
   
   /// This zero means the x values - an be called between re-runs or before 
@@ -156,7 +198,7 @@ class EOS_CLASS Multigrid2D
   /// Returns an x value. The x values will all be zero before tha algorithm is first run.
    real32 Get(nat32 x,nat32 y) const
    {
-    return data[0].Get(x,y).x;
+    return data[0].x[y*data[0].width + x];
    }
    
   /// Extracts a 2D array of x values.
@@ -171,6 +213,9 @@ class EOS_CLASS Multigrid2D
   /// for debug and analysis stuff.
    real32 Residual(nat32 level,nat32 x,nat32 y);
 
+  /// Returns the relative residual, |b-Ax|/|b|, of the given level.
+   real32 RelResidual(nat32 level);
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -180,6 +225,24 @@ class EOS_CLASS Multigrid2D
   real32 speed;
   real32 tolerance;
   nat32 maxIters;
+
+  Smoother smoother;
+  real32 weight;
+
+  Cycle cycle;
+  nat32 maxCycles;
+  real32 cycleTol;
+
+  // Statistics for each cycle of the last ReRun...
+   struct Stats
+   {
+    real32 residual;
+    nat32 sweeps;
+   };
+
+   real32 startResidual;
+   ds::ArrayResize<Stats> stats;
+   nat32 sweeps; // Smoothing iterations done since it was last zeroed.
  
   // Structure to store a stencil entry offste details...
    struct Offset
@@ -192,24 +255,43 @@ class EOS_CLASS Multigrid2D
    ds::ArrayDel<ds::Array<Offset> > stencil; // Indexed [level][se].
   
  
-  // Structure to store relevant details for each node.
-   struct Node
+  // Everything for a level, each an array indexed y*width + x, except for a,
+  // which has the stencil for each node in sequence...
+   struct Level
    {
-    real32 b;
-    real32 x;
-    real32 r; // Used as tempory for transfering up, to save repeated calculation of residual.
-    real32 a[1]; // Will be extended to the stencil size. sizeof(Node) + sizeof(real32)*(stencil.Size()-1)
+    nat32 width;
+    nat32 height;
+    nat32 ss; // Stencil size.
+
+    ds::Array<real32> b;
+    ds::Array<real32> x;
+    ds::Array<real32> r; // Used as tempory for transfering up, to save repeated calculation of residual, and by the Jacobi smoother.
+    ds::Array<real32> a; // Indexed (y*width + x)*ss + se.
+    ds::Array<int32> offset; // For each stencil entry the index offset, so a[i*ss+se] multiplies x[i+offset[se]].
    };
-   
+
   // Super structure that stores everything but the stencil shape.
   // Note that its partially trashed at run time.
-   ds::ArrayDel<ds::Array2DRS<Node> > data; // Indexed as data[level].Get(x,y).<...>
-   
-   
+   ds::ArrayDel<Level> data; // Indexed as data[level].
+
+  // Per row sums, for the parallel smoothers...
+   ds::Array<real64> rowSum;
+
+
   // Helper methods...
    void TransferUp(nat32 from,time::Progress * prog); // Fills in from+1 b's with the residual of from, zeroes from+1 x's.
    void TransferDown(nat32 to,time::Progress * prog); // Offsets to's x's by the interpolated x's of to+1.
-   void Solve(nat32 level,time::Progress * prog); // Runs symmetric Gauss-Seidel iterations on the given level till convergance.
+   void Solve(nat32 level,time::Progress * prog); // Runs the smoother on the given level till convergance.
+   void DoCycle(nat32 level,nat32 gamma,time::Progress * prog); // Does a V (gamma=1) or W (gamma=2) cycle from the given level.
+   void PrepOffsets(nat32 level); // Fills in the index offsets from the stencil.
+   bit Colouring(nat32 level,nat32 & k,nat32 & s) const; // Finds a colouring (x + s*y)%k for RedBlack, false if none.
+
+  // Functors for the task pool...
+   class ColourSweep;
+   class JacobiSweep;
+   class Residuals;
+   class Restrict;
+   class Prolong;
 
 
   // Debugging methods...
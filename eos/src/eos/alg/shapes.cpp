@@ -17,9 +17,10 @@
 
 #include "eos/alg/shapes.h"
 
-#include "eos/mem/safety.h"
-#include "eos/math/mat_ops.h"
-#include "eos/sur/subdivide.h"
+#include "eos/math/functions.h"
+#include "eos/ds/arrays.h"
+#include "eos/ds/arrays_resize.h"
+#include "eos/mt/locks.h"
 
 namespace eos
 {
@@ -108,120 +109,338 @@ real32 Icosphere::SubToAng(nat32 subdivs)
 
 Icosphere::Icosphere(nat32 subdivs)
 {
- // First create a mesh object that contains an icosahedron...
-  sur::Mesh base;
-  sur::Vertex baseVert[12];
-  for (nat32 i=0;i<12;i++) baseVert[i] = base.NewVertex(bs::Vert(Icosahedron::vert[i][0],
-                                                                 Icosahedron::vert[i][1],
-                                                                 Icosahedron::vert[i][2]));
-  
-  for (nat32 i=0;i<20;i++) base.NewFace(baseVert[Icosahedron::tri[i][0]],
-                                        baseVert[Icosahedron::tri[i][1]],
-                                        baseVert[Icosahedron::tri[i][2]]);
+ static mt::OwnedLock lock;
+ static ds::ArrayResize<Shape*> cache;
+ 
+ mt::AutoLock al(lock);
+ if (cache.Size()<=subdivs)
+ {
+  nat32 prev = cache.Size();
+  cache.Size(subdivs+1);
+  for (nat32 i=prev;i<cache.Size();i++) cache[i] = null<Shape*>();
+ }
+ 
+ if (cache[subdivs]==null<Shape*>()) cache[subdivs] = Build(subdivs);
+ shape = cache[subdivs];
+}
+
+Icosphere::~Icosphere()
+{}
 
+nat32 Icosphere::Nearest(const bs::Normal & dir) const
+{
+ // Start from the best of the Icosahedron's vertices...
+  nat32 ret = 0;
+  real32 best = dir[0]*shape->vert[0] + dir[1]*shape->vert[1] + dir[2]*shape->vert[2];
+  for (nat32 i=1;i<12;i++)
+  {
+   real32 dot = dir[0]*shape->vert[i*3] + dir[1]*shape->vert[i*3+1] + dir[2]*shape->vert[i*3+2];
+   if (dot>best) {best = dot; ret = i;}
+  }
 
- // Subdivide the mesh the requisit number of times...
-  mem::StackPtr<sur::Mesh> sdm(sur::Subdivide(base,subdivs));
+ // Climb the adjacency until no neighbour is better...
+  while (true)
+  {
+   nat32 next = ret;
+   for (nat32 j=shape->adjStart[ret];j<shape->adjStart[ret+1];j++)
+   {
+    const real32 * v = &shape->vert[shape->adj[j]*3];
+    real32 dot = dir[0]*v[0] + dir[1]*v[1] + dir[2]*v[2];
+    if (dot>best) {best = dot; next = shape->adj[j];}
+   }
+   if (next==ret) break;
+   ret = next;
+  }
+  
+ return ret;
+}
 
+Icosphere::Shape * Icosphere::Build(nat32 subdivs)
+{
+ // Each face of the Icosahedron is split into a triangular grid with s steps
+ // along each side, the vertices are the Icosahedron's, then the insides of
+ // each edge, then the insides of each face...
+  Shape * ret = new Shape;
+  nat32 s = subdivs + 1;
+  ret->verts = SubToVert(subdivs);
+  ret->edges = SubToEdge(subdivs);
+  ret->tris = SubToTri(subdivs);
+  
+  ret->vert = new real32[3*ret->verts];
+  ret->edge = new nat32[2*ret->edges];
+  ret->tri = new nat32[3*ret->tris];
+  ret->adjStart = new nat32[ret->verts+1];
+  ret->adj = new nat32[2*ret->edges];
 
- // Create storage for this final mesh in the stored form of this object...
-  ds::Array<sur::Vertex> tempVert;
-  ds::Array<sur::Edge> tempEdge;
-  ds::Array<sur::Face> tempTri;
 
-  sdm->GetVertices(tempVert);
-  sdm->GetEdges(tempEdge);
-  sdm->GetFaces(tempTri);
+ // Helper to interpolate between the corners of a face and put the result
+ // back on the unit sphere...
+  struct Interp
+  {
+   static void Do(real32 * out,const real32 * a,const real32 * b,const real32 * c,real32 u,real32 v)
+   {
+    for (nat32 k=0;k<3;k++) out[k] = a[k] + (b[k]-a[k])*u + (c[k]-a[k])*v;
+    real32 len = math::Sqrt(math::Sqr(out[0]) + math::Sqr(out[1]) + math::Sqr(out[2]));
+    for (nat32 k=0;k<3;k++) out[k] /= len;
+   }
+  };
   
-  verts = tempVert.Size();
-  edges = tempEdge.Size();
-  tris = tempTri.Size();
 
-  vert = new real32[3*verts];
-  edge = new nat32[2*edges];
-  tri = new nat32[3*tris];
+ // The Icosahedron's vertices...
+  for (nat32 i=0;i<12;i++)
+  {
+   for (nat32 k=0;k<3;k++) ret->vert[i*3+k] = Icosahedron::vert[i][k];
+  }
+
+ // The insides of the edges, s-1 per edge, going from the first to the second 
+ // vertex, each only done once so the faces either side agree...
+  for (nat32 e=0;e<30;e++)
+  {
+   for (nat32 k=1;k<s;k++)
+   {
+    nat32 ind = 12 + e*(s-1) + (k-1);
+    Interp::Do(&ret->vert[ind*3],Icosahedron::vert[Icosahedron::edge[e][0]],
+               Icosahedron::vert[Icosahedron::edge[e][1]],Icosahedron::vert[Icosahedron::edge[e][0]],
+               real32(k)/real32(s),0.0);
+   }
+  }
+
+ // The insides of the faces and their triangles, which need a grid of indices
+ // for each face, (i,j) being i steps towards corner 1 and j towards corner 2...
+  nat32 faceInner = ((s-1)*(s-2))/2;
+  ds::Array<nat32> grid((s+1)*(s+1));
+  nat32 triInd = 0;
+  for (nat32 f=0;f<20;f++)
+  {
+   const nat32 * corner = Icosahedron::tri[f];
+   
+   // The corners...
+    grid[0] = corner[0];
+    grid[s] = corner[1];
+    grid[s*(s+1)] = corner[2];
+    
+   // The sides, finding the edge of each so the shared vertices are used...
+    for (nat32 side=0;side<3;side++)
+    {
+     nat32 from = corner[side];
+     nat32 to = corner[(side+1)%3];
+     nat32 e = 0;
+     while (!(((Icosahedron::edge[e][0]==from)&&(Icosahedron::edge[e][1]==to))||
+              ((Icosahedron::edge[e][0]==to)&&(Icosahedron::edge[e][1]==from)))) ++e;
+     
+     for (nat32 k=1;k<s;k++)
+     {
+      nat32 along = (Icosahedron::edge[e][0]==from)?k:(s-k);
+      nat32 ind = 12 + e*(s-1) + (along-1);
+      switch (side)
+      {
+       case 0: grid[k] = ind; break; // (k,0)
+       case 1: grid[(s-k) + k*(s+1)] = ind; break; // (s-k,k)
+       case 2: grid[(s-k)*(s+1)] = ind; break; // (0,s-k)
+      }
+     }
+    }
+    
+   // The inside...
+    nat32 ind = 12 + 30*(s-1) + f*faceInner;
+    for (nat32 j=1;j<s;j++)
+    {
+     for (nat32 i=1;i+j<s;i++)
+     {
+      grid[i + j*(s+1)] = ind;
+      Interp::Do(&ret->vert[ind*3],Icosahedron::vert[corner[0]],Icosahedron::vert[corner[1]],
+                 Icosahedron::vert[corner[2]],real32(i)/real32(s),real32(j)/real32(s));
+      ++ind;
+     }
+    }
+    
+   // The triangles, which keep the orientation of the face...
+    for (nat32 j=0;j<s;j++)
+    {
+     for (nat32 i=0;i+j<s;i++)
+     {
+      ret->tri[triInd*3+0] = grid[i + j*(s+1)];
+      ret->tri[triInd*3+1] = grid[(i+1) + j*(s+1)];
+      ret->tri[triInd*3+2] = grid[i + (j+1)*(s+1)];
+      ++triInd;
+      
+      if (i+j+1<s)
+      {
+       ret->tri[triInd*3+0] = grid[(i+1) + j*(s+1)];
+       ret->tri[triInd*3+1] = grid[(i+1) + (j+1)*(s+1)];
+       ret->tri[triInd*3+2] = grid[i + (j+1)*(s+1)];
+       ++triInd;
+      }
+     }
+    }
+  }
 
 
- // Extract the subdivided icosphere, pushing the vertices back to there unit
- // sphere positions...
-  for (nat32 i=0;i<verts;i++)
+ // The edges - every edge is in two triangles, going in opposite directions, 
+ // so taking the one that goes up gets each once...
+  nat32 edgeInd = 0;
+  for (nat32 t=0;t<ret->tris;t++)
   {
-   tempVert[i].Pos().Normalise();
-   vert[i*3+0] = tempVert[i].Pos()[0];
-   vert[i*3+1] = tempVert[i].Pos()[1];
-   vert[i*3+2] = tempVert[i].Pos()[2];
+   for (nat32 k=0;k<3;k++)
+   {
+    nat32 a = ret->tri[t*3+k];
+    nat32 b = ret->tri[t*3+(k+1)%3];
+    if (a<b)
+    {
+     ret->edge[edgeInd*2+0] = a;
+     ret->edge[edgeInd*2+1] = b;
+     ++edgeInd;
+    }
+   }
   }
 
-  for (nat32 i=0;i<edges;i++)
+
+ // And the adjacency, from the edges...
+  for (nat32 i=0;i<=ret->verts;i++) ret->adjStart[i] = 0;
+  for (nat32 e=0;e<ret->edges;e++)
   {
-   edge[i*2+0] = tempEdge[i].VertexA().Index();
-   edge[i*2+1] = tempEdge[i].VertexB().Index();
+   ret->adjStart[ret->edge[e*2+0]+1] += 1;
+   ret->adjStart[ret->edge[e*2+1]+1] += 1;
   }
+  for (nat32 i=0;i<ret->verts;i++) ret->adjStart[i+1] += ret->adjStart[i];
   
-  ds::Array<sur::Vertex> corner(3);
-  for (nat32 i=0;i<tris;i++)
+  ds::Array<nat32> fill(ret->verts);
+  for (nat32 i=0;i<ret->verts;i++) fill[i] = ret->adjStart[i];
+  for (nat32 e=0;e<ret->edges;e++)
   {
-   tempTri[i].GetVertices(corner);
-   tri[i*3+0] = corner[0].Index();
-   tri[i*3+1] = corner[1].Index();
-   tri[i*3+2] = corner[2].Index();
+   nat32 a = ret->edge[e*2+0];
+   nat32 b = ret->edge[e*2+1];
+   ret->adj[fill[a]] = b; ++fill[a];
+   ret->adj[fill[b]] = a; ++fill[b];
   }
-}
 
-Icosphere::~Icosphere()
-{
- delete[] vert;
- delete[] edge;
- delete[] tri;
+ return ret;
 }
 
 //------------------------------------------------------------------------------
 HemiOfNorm::HemiOfNorm(nat32 subdivs)
-:norms(0),norm(null<bs::Normal*>()),spacing(Icosphere::SubToAng(subdivs))
 {
- Icosphere ico(subdivs);
- for (nat32 i=0;i<ico.Verts();i++)
- {
-  if (ico.Vert(i)[2]>=0.0) ++norms;
- }
+ static mt::OwnedLock lock;
+ static ds::ArrayResize<Shape*> cache;
  
- norm = new bs::Normal[norms];
- norms = 0;
- for (nat32 i=0;i<ico.Verts();i++)
+ mt::AutoLock al(lock);
+ if (cache.Size()<=subdivs)
  {
-  if (ico.Vert(i)[2]>=0.0)
-  {
-   norm[norms] = bs::Normal(ico.Vert(i)[0],ico.Vert(i)[1],ico.Vert(i)[2]);
-   ++norms;
-  }
+  nat32 prev = cache.Size();
+  cache.Size(subdivs+1);
+  for (nat32 i=prev;i<cache.Size();i++) cache[i] = null<Shape*>();
  }
-}
-
-HemiOfNorm::HemiOfNorm(const HemiOfNorm & rhs)
-{
- norms = rhs.norms;
- norm = new bs::Normal[norms];
- for (nat32 i=0;i<norms;i++) norm[i] = rhs.norm[i];
- spacing = rhs.spacing;
+ 
+ if (cache[subdivs]==null<Shape*>()) cache[subdivs] = Build(subdivs);
+ shape = cache[subdivs];
 }
 
 HemiOfNorm::~HemiOfNorm()
+{}
+
+nat32 HemiOfNorm::Nearest(const bs::Normal & dir) const
 {
- delete[] norm;
+ // Start from the best of the normals from the Icosahedron...
+  nat32 ret = shape->seed[0];
+  real32 best = dir * shape->norm[ret];
+  for (nat32 i=1;i<shape->seeds;i++)
+  {
+   real32 dot = dir * shape->norm[shape->seed[i]];
+   if (dot>best) {best = dot; ret = shape->seed[i];}
+  }
+
+ // Climb, but as the rim of the hemisphere cuts some triangles off the
+ // neighbours of a neighbour are checked before giving up...
+  while (true)
+  {
+   nat32 next = ret;
+   for (nat32 j=shape->adjStart[ret];j<shape->adjStart[ret+1];j++)
+   {
+    real32 dot = dir * shape->norm[shape->adj[j]];
+    if (dot>best) {best = dot; next = shape->adj[j];}
+   }
+   
+   if (next==ret)
+   {
+    for (nat32 j=shape->adjStart[ret];j<shape->adjStart[ret+1];j++)
+    {
+     nat32 n = shape->adj[j];
+     for (nat32 k=shape->adjStart[n];k<shape->adjStart[n+1];k++)
+     {
+      real32 dot = dir * shape->norm[shape->adj[k]];
+      if (dot>best) {best = dot; next = shape->adj[k];}
+     }
+    }
+    if (next==ret) break;
+   }
+   
+   ret = next;
+  }
+
+ return ret;
 }
 
-HemiOfNorm & HemiOfNorm::operator = (const HemiOfNorm & rhs)
+HemiOfNorm::Shape * HemiOfNorm::Build(nat32 subdivs)
 {
- norms = rhs.norms;
+ Shape * ret = new Shape;
+ ret->spacing = Icosphere::SubToAng(subdivs);
  
- delete[] norm;
- norm = new bs::Normal[norms];
-
- for (nat32 i=0;i<norms;i++) norm[i] = rhs.norm[i];
+ // Select the vertices of the icosphere in the hemisphere, noting there new
+ // indices...
+  Icosphere ico(subdivs);
+  ds::Array<nat32> remap(ico.Verts());
+  ret->norms = 0;
+  for (nat32 i=0;i<ico.Verts();i++)
+  {
+   if (ico.Vert(i)[2]>=0.0) {remap[i] = ret->norms; ++ret->norms;}
+                       else remap[i] = nat32(-1);
+  }
  
- spacing = rhs.spacing;
+  ret->norm = new bs::Normal[ret->norms];
+  ret->seeds = 0;
+  for (nat32 i=0;i<ico.Verts();i++)
+  {
+   if (remap[i]!=nat32(-1))
+   {
+    ret->norm[remap[i]] = bs::Normal(ico.Vert(i)[0],ico.Vert(i)[1],ico.Vert(i)[2]);
+    if (i<12) {ret->seed[ret->seeds] = remap[i]; ++ret->seeds;}
+   }
+  }
 
- return *this;
+ // Adjacency, keeping only the neighbours that are also in the hemisphere...
+  ret->adjStart = new nat32[ret->norms+1];
+  ret->adjStart[0] = 0;
+  for (nat32 i=0;i<ico.Verts();i++)
+  {
+   if (remap[i]!=nat32(-1))
+   {
+    nat32 count = 0;
+    for (nat32 n=0;n<ico.Neighbours(i);n++)
+    {
+     if (remap[ico.Neighbour(i,n)]!=nat32(-1)) ++count;
+    }
+    ret->adjStart[remap[i]+1] = ret->adjStart[remap[i]] + count;
+   }
+  }
+  
+  ret->adj = new nat32[ret->adjStart[ret->norms]];
+  for (nat32 i=0;i<ico.Verts();i++)
+  {
+   if (remap[i]!=nat32(-1))
+   {
+    nat32 pos = ret->adjStart[remap[i]];
+    for (nat32 n=0;n<ico.Neighbours(i);n++)
+    {
+     if (remap[ico.Neighbour(i,n)]!=nat32(-1))
+     {
+      ret->adj[pos] = remap[ico.Neighbour(i,n)];
+      ++pos;
+     }
+    }
+   }
+  }
+  
+ return ret;
 }
 
 //------------------------------------------------------------------------------
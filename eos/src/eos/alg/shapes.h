@@ -56,6 +56,11 @@ struct EOS_CLASS Icosahedron
 /// the subdivision count on construction. Note that unlike Blender we use a 
 /// single step method where the subdivisions are the number of splits on each
 /// side of the original icosahedron edges. This allows for more control.
+///
+/// Each subdivision level is only built once, the first time it is asked for,
+/// and then shared by every Icosphere of that level for the rest of the
+/// program, so construction and copying are cheap enough to do in a loop. This
+/// is thread safe.
 class EOS_CLASS Icosphere
 {
  public:
@@ -79,31 +84,51 @@ class EOS_CLASS Icosphere
   /// a given subdivision level will produce prior to construction.
   /// subdivs==0 will produce an Icosahedron.
    Icosphere(nat32 subdivs);
+   
+  /// &nbsp;
+   Icosphere(const Icosphere & rhs):shape(rhs.shape) {}
  
   /// &nbsp;
    ~Icosphere();
+   
+  /// &nbsp;
+   Icosphere & operator = (const Icosphere & rhs) {shape = rhs.shape; return *this;}
 
 
   /// Returns the number of vertices.
-   nat32 Verts() const {return verts;}
+   nat32 Verts() const {return shape->verts;}
    
   /// Returns the number of edges.
-   nat32 Edges() const {return edges;}
+   nat32 Edges() const {return shape->edges;}
    
   /// Returns the number of triangles.
-   nat32 Tris() const {return tris;}
+   nat32 Tris() const {return shape->tris;}
    
    
   /// Indexes the vertices, there stored as normals so you can take
   /// the centre of the object and add the normal multiplied by the radius
   /// to get actual vertices. Returns a pointer to 3 real32's.
-   const real32 * Vert(nat32 i) const {return &vert[i*3];}
+  /// The first 12 are the vertices of the Icosahedron, in the same order.
+   const real32 * Vert(nat32 i) const {return &shape->vert[i*3];}
    
-  /// Indexes the edges, returns pairs of indexes to vertices.  
-   const nat32 * Edge(nat32 i) const {return &edge[i*2];}
+  /// Indexes the edges, returns pairs of indexes to vertices, the lower first.
+   const nat32 * Edge(nat32 i) const {return &shape->edge[i*2];}
    
   /// Indexes the triangles, returns triplets of indexes to vertices.
-   const nat32 * Tri(nat32 i) const {return &tri[i*3];}
+  /// All given to go anti-clockwise when looking at the facing out side.
+   const nat32 * Tri(nat32 i) const {return &shape->tri[i*3];}
+   
+   
+  /// Returns how many vertices share an edge with vertex i, 5 or 6.
+   nat32 Neighbours(nat32 i) const {return shape->adjStart[i+1] - shape->adjStart[i];}
+   
+  /// Returns the index of the n'th neighbour of vertex i.
+   nat32 Neighbour(nat32 i,nat32 n) const {return shape->adj[shape->adjStart[i]+n];}
+   
+  /// Returns the index of the vertex closest to the given direction, which
+  /// need not be normalised. Walks the adjacency from the closest vertex
+  /// of the Icosahedron, so is O(subdivs).
+   nat32 Nearest(const bs::Normal & dir) const;
 
 
   /// &nbsp;
@@ -111,13 +136,25 @@ class EOS_CLASS Icosphere
 
 
  private:
-  nat32 verts;
-  nat32 edges;
-  nat32 tris;
+  // The shared geometry of a subdivision level, never deleted...
+   struct Shape
+   {
+    nat32 verts;
+    nat32 edges;
+    nat32 tris;
   
-  real32 * vert;
-  nat32 * edge;
-  nat32 * tri;
+    real32 * vert;
+    nat32 * edge;
+    nat32 * tri;
+    
+    nat32 * adjStart; // verts+1 entries, the neighbours of vertex i are adj[adjStart[i]] to adj[adjStart[i+1]-1].
+    nat32 * adj;
+   };
+   
+  const Shape * shape;
+  
+  // Builds a level, called with the cache locked...
+   static Shape * Build(nat32 subdivs);
 };
 
 //------------------------------------------------------------------------------
@@ -125,6 +162,8 @@ class EOS_CLASS Icosphere
 /// hemisphere, you specify the number of subdivisions of an icosphere, it then 
 /// acts as an indexable array of normals. You find out how many post-construction.
 /// All the normals have z>=0.
+/// As for the Icosphere each subdivision level is built once and then shared,
+/// so construction and copying are cheap and thread safe.
 class EOS_CLASS HemiOfNorm
 {
  public:
@@ -132,25 +171,37 @@ class EOS_CLASS HemiOfNorm
    HemiOfNorm(nat32 subdivs);
    
   /// &nbsp;
-   HemiOfNorm(const HemiOfNorm & rhs);
+   HemiOfNorm(const HemiOfNorm & rhs):shape(rhs.shape) {}
    
   /// &nbsp;
    ~HemiOfNorm();
 
  
   /// &nbsp;
-   HemiOfNorm & operator = (const HemiOfNorm & rhs);
+   HemiOfNorm & operator = (const HemiOfNorm & rhs) {shape = rhs.shape; return *this;}
 
 
   /// Returns the number of normals distributed over the sphere.
-   nat32 Norms() const {return norms;}   
+   nat32 Norms() const {return shape->norms;}   
   
   /// Returns a const reference to the indexed normal.
-   const bs::Normal & Norm(nat32 ind) const {return norm[ind];}
+   const bs::Normal & Norm(nat32 ind) const {return shape->norm[ind];}
    
   /// Returns the angle between 'adjacent' vertices, taken through the centre of
   /// a sphere.
-   real32 Spacing() const {return spacing;};
+   real32 Spacing() const {return shape->spacing;};
+   
+   
+  /// Returns how many normals are adjacent to normal i on the icosphere.
+   nat32 Neighbours(nat32 i) const {return shape->adjStart[i+1] - shape->adjStart[i];}
+   
+  /// Returns the index of the n'th neighbour of normal i.
+   nat32 Neighbour(nat32 i,nat32 n) const {return shape->adj[shape->adjStart[i]+n];}
+   
+  /// Returns the index of the normal closest to the given direction, which
+  /// need not be normalised, by walking the adjacency from the closest normal
+  /// that came from the Icosahedron.
+   nat32 Nearest(const bs::Normal & dir) const;
 
 
   /// &nbsp;
@@ -158,9 +209,24 @@ class EOS_CLASS HemiOfNorm
 
 
  private:
-  nat32 norms;
-  bs::Normal * norm;
-  real32 spacing;
+  // The shared normals of a subdivision level, never deleted...
+   struct Shape
+   {
+    nat32 norms;
+    bs::Normal * norm;
+    real32 spacing;
+    
+    nat32 * adjStart; // As for Icosphere.
+    nat32 * adj;
+    
+    nat32 seeds; // Normals that came from the Icosahedron, where Nearest starts.
+    nat32 seed[12];
+   };
+   
+  const Shape * shape;
+  
+  // Builds a level, called with the cache locked...
+   static Shape * Build(nat32 subdivs);
 };
 
 //------------------------------------------------------------------------------
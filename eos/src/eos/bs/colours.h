@@ -30,6 +30,7 @@
 #include "eos/types.h"
 #include "eos/typestring.h"
 #include "eos/math/functions.h"
+#include "eos/math/compact.h"
 #include "eos/io/inout.h"
 
 namespace eos
@@ -601,6 +602,119 @@ class EOS_CLASS ColRGB : public Colour
  byte b; ///< &nbsp;
 };
 
+//------------------------------------------------------------------------------
+/// A ColourRGB stored as three halfs, for large images and intermediates where
+/// the memory matters more than the last few bits of precision. Unlike ColRGB 
+/// it can hold values outside [0,1]. Converts to and from ColourRGB.
+class EOS_CLASS ColourRGBh : public Colour
+{
+ public:
+  /// &nbsp;
+   ColourRGBh() {}
+
+  /// &nbsp;
+   ColourRGBh(real32 rr,real32 gg,real32 bb):r(rr),g(gg),b(bb) {}
+
+  /// &nbsp;
+   ColourRGBh(const ColourRGBh & rhs):r(rhs.r),g(rhs.g),b(rhs.b) {}
+
+  /// &nbsp;
+   ColourRGBh(const ColourRGB & rhs):r(rhs.r),g(rhs.g),b(rhs.b) {}
+
+
+  /// &nbsp;
+   ColourRGBh & operator = (const ColourRGBh & rhs) {r = rhs.r; g = rhs.g; b = rhs.b; return *this;}
+
+  /// &nbsp;
+   ColourRGBh & operator = (const ColourRGB & rhs) {r = rhs.r; g = rhs.g; b = rhs.b; return *this;}
+
+  /// &nbsp;
+   operator ColourRGB () const {return ColourRGB(r,g,b);}
+
+
+  /// &nbsp;
+   static cstrconst TypeString() {return "eos::bs::ColourRGBh";}
+
+
+ math::Half r; ///< &nbsp;
+ math::Half g; ///< &nbsp;
+ math::Half b; ///< &nbsp;
+};
+
+//------------------------------------------------------------------------------
+/// A ColourLuv stored as three halfs. l is in [0,100], so is held to within
+/// 0.05 or better. Converts to and from ColourLuv.
+class EOS_CLASS ColourLuvh : public Colour
+{
+ public:
+  /// &nbsp;
+   ColourLuvh() {}
+
+  /// &nbsp;
+   ColourLuvh(real32 ll,real32 uu,real32 vv):l(ll),u(uu),v(vv) {}
+
+  /// &nbsp;
+   ColourLuvh(const ColourLuvh & rhs):l(rhs.l),u(rhs.u),v(rhs.v) {}
+
+  /// &nbsp;
+   ColourLuvh(const ColourLuv & rhs):l(rhs.l),u(rhs.u),v(rhs.v) {}
+
+
+  /// &nbsp;
+   ColourLuvh & operator = (const ColourLuvh & rhs) {l = rhs.l; u = rhs.u; v = rhs.v; return *this;}
+
+  /// &nbsp;
+   ColourLuvh & operator = (const ColourLuv & rhs) {l = rhs.l; u = rhs.u; v = rhs.v; return *this;}
+
+  /// &nbsp;
+   operator ColourLuv () const {return ColourLuv(l,u,v);}
+
+
+  /// &nbsp;
+   static cstrconst TypeString() {return "eos::bs::ColourLuvh";}
+
+
+ math::Half l; ///< &nbsp;
+ math::Half u; ///< &nbsp;
+ math::Half v; ///< &nbsp;
+};
+
+//------------------------------------------------------------------------------
+/// A RGB colour with 16 bits per channel, each a math::Unorm16, for images 
+/// from sources with more than 8 bits that still fit in [0,1]. Converts to and
+/// from ColourRGB, clamping.
+class EOS_CLASS ColRGB16 : public Colour
+{
+ public:
+  /// &nbsp;
+   ColRGB16() {}
+
+  /// &nbsp;
+   ColRGB16(const ColRGB16 & rhs):r(rhs.r),g(rhs.g),b(rhs.b) {}
+
+  /// &nbsp;
+   ColRGB16(const ColourRGB & rhs):r(rhs.r),g(rhs.g),b(rhs.b) {}
+
+
+  /// &nbsp;
+   ColRGB16 & operator = (const ColRGB16 & rhs) {r = rhs.r; g = rhs.g; b = rhs.b; return *this;}
+
+  /// &nbsp;
+   ColRGB16 & operator = (const ColourRGB & rhs) {r = rhs.r; g = rhs.g; b = rhs.b; return *this;}
+
+  /// &nbsp;
+   operator ColourRGB () const {return ColourRGB(r,g,b);}
+
+
+  /// &nbsp;
+   static cstrconst TypeString() {return "eos::bs::ColRGB16";}
+
+
+ math::Unorm16 r; ///< &nbsp;
+ math::Unorm16 g; ///< &nbsp;
+ math::Unorm16 b; ///< &nbsp;
+};
+
 //------------------------------------------------------------------------------
 // Operators thet can not be defined earlier due to the problems of forward decleration...
 inline ColourL & ColourL::operator = (const ColourRGB & rhs)
@@ -17,10 +17,70 @@
 
 #include "eos/bs/dom.h"
 
+#include "eos/mem/packer.h"
+#include "eos/mt/locks.h"
+
 namespace eos
 {
  namespace bs
  {
+//------------------------------------------------------------------------------
+// The node pools for Attribute and Element. These are never deleted, as
+// static Elements could outlive them otherwise...
+struct DomPool
+{
+ mt::OwnedLock lock;
+ mem::NodePool pool;
+};
+
+static DomPool & AttributePool()
+{
+ static DomPool * ret = new DomPool();
+ return *ret;
+}
+
+static DomPool & ElementPool()
+{
+ static DomPool * ret = new DomPool();
+ return *ret;
+}
+
+static void * PoolAlloc(DomPool & dp,size_t size)
+{
+ dp.lock.Lock();
+  void * ret = dp.pool.Alloc(size);
+ dp.lock.Unlock();
+ return ret;
+}
+
+static void PoolFree(DomPool & dp,void * ptr)
+{
+ dp.lock.Lock();
+  dp.pool.Free(ptr);
+ dp.lock.Unlock();
+}
+
+//------------------------------------------------------------------------------
+void * Attribute::operator new(size_t size)
+{
+ return PoolAlloc(AttributePool(),size);
+}
+
+void Attribute::operator delete(void * ptr,size_t size)
+{
+ if (ptr) PoolFree(AttributePool(),ptr);
+}
+
+void * Element::operator new(size_t size)
+{
+ return PoolAlloc(ElementPool(),size);
+}
+
+void Element::operator delete(void * ptr,size_t size)
+{
+ if (ptr) PoolFree(ElementPool(),ptr);
+}
+
 //------------------------------------------------------------------------------
 void Item::Prepend(Item * node)
 {
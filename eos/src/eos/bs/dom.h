@@ -260,6 +260,14 @@ class EOS_CLASS Attribute : public Item
    cstrconst TypeString() const {return "eos::bs::Attribute";}
 
 
+  /// Attributes come from a pool, as a dom is built and destroyed a node at
+  /// a time.
+   static void * operator new(size_t size);
+
+  /// &nbsp;
+   static void operator delete(void * ptr,size_t size);
+
+
  private:
   str::Token name;
   str::String asString;
@@ -306,13 +314,15 @@ class EOS_CLASS Element : public Tree
   /// &nbsp;
    ~Element()
    {
+    while (Front()!=Bad()) delete Front();
     while (FrontAttribute()!=BadAttribute()) delete FrontAttribute();
    }
 
-  /// This removes all attributes and children.
+  /// This removes all attributes and children. Children are deleted as
+  /// Elements, so they come apart properly and go back to the pool.
    void MakeEmpty()
    {
-    Tree::MakeEmpty();
+    while (Front()!=Bad()) delete Front();
     while (FrontAttribute()!=BadAttribute()) delete FrontAttribute();
     aValid = false;
     eValid = false;
@@ -373,6 +383,12 @@ class EOS_CLASS Element : public Tree
    /// &nbsp;
     const Attribute * BadAttribute() const {return static_cast<const Attribute*>(&attributes);}
     
+   /// Adds an attribute to the end of the list, taking ownership, without
+   /// checking if one with the same name allready exists. For building a dom
+   /// from a file, where the cost of updating the index for every attribute
+   /// is a waste. Marks the index invalid.
+    void AppendAttribute(Attribute * attr) {attributes.Prepend(attr); aValid = false;}
+
    /// After updating attributes you must call this, unlike the Element editting scheme
    /// there is no way for attributes to feed back they have been editted so the index
    /// data can be marked invalid for update next time its used. Internally it just 
@@ -583,6 +599,14 @@ class EOS_CLASS Element : public Tree
 
   /// &nbsp;
    cstrconst TypeString() const {return "eos::bs::Element";}
+
+
+  /// Elements come from a pool, as a dom is built and destroyed a node at a
+  /// time.
+   static void * operator new(size_t size);
+
+  /// &nbsp;
+   static void operator delete(void * ptr,size_t size);
    
    
   // Helper functions used by the i/o system...
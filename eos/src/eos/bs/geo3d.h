@@ -25,6 +25,7 @@
 #include "eos/math/functions.h"
 #include "eos/math/vectors.h"
 #include "eos/math/mat_ops.h"
+#include "eos/math/compact.h"
 
 namespace eos
 {
@@ -131,6 +132,45 @@ class EOS_CLASS Normal : public Vert
    static inline cstrconst TypeString() {return "eos::bs::Normal";}
 };
 
+//------------------------------------------------------------------------------
+/// A Normal stored as three halfs, for normal maps and the like where a full
+/// Normal per pixel is more memory than the precision justifies. Converts to
+/// and from Normal; do any maths with a Normal.
+class EOS_CLASS Normalh
+{
+ public:
+  /// Leaves the contained data random.
+   Normalh() {}
+
+  /// &nbsp;
+   Normalh(real32 xx,real32 yy,real32 zz):x(xx),y(yy),z(zz) {}
+
+  /// &nbsp;
+   Normalh(const Normal & rhs):x(rhs[0]),y(rhs[1]),z(rhs[2]) {}
+
+  /// &nbsp;
+   Normalh(const Normalh & rhs):x(rhs.x),y(rhs.y),z(rhs.z) {}
+
+
+  /// &nbsp;
+   Normalh & operator = (const Normal & rhs) {x = rhs[0]; y = rhs[1]; z = rhs[2]; return *this;}
+
+  /// &nbsp;
+   Normalh & operator = (const Normalh & rhs) {x = rhs.x; y = rhs.y; z = rhs.z; return *this;}
+
+  /// &nbsp;
+   operator Normal () const {return Normal(x,y,z);}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::bs::Normalh";}
+
+
+ math::Half x; ///< &nbsp;
+ math::Half y; ///< &nbsp;
+ math::Half z; ///< &nbsp;
+};
+
 //------------------------------------------------------------------------------
 /// A Vertex, homogenous in nature, inherits from and hence provides the 
 /// functionality of the Vect class.
@@ -20,6 +20,7 @@
 #include "eos/ds/arrays.h"
 #include "eos/cam/homography.h"
 #include "eos/math/iter_min.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -27,7 +28,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 Zhang98::Zhang98()
-:targQ(high)
+:targQ(high),robust(-1.0)
 {}
 
 Zhang98::~Zhang98()
@@ -87,6 +88,101 @@ void Zhang98::SetQuality(ResQuality rq)
  targQ = rq;	
 }
 
+void Zhang98::SetRobust(real64 tolerance)
+{
+ robust = tolerance;
+}
+
+void Zhang98::SetNonRobust()
+{
+ robust = -1.0;
+}
+
+//------------------------------------------------------------------------------
+class Zhang98::ShotHomography
+{
+ public:
+  ShotHomography(Shot * s,const math::Mat<3,3,real64> & fn,const math::Mat<3,3,real64> & sn,real64 r)
+  :sd(s),firstNorm(fn),secondNorm(sn),robust(r)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++)
+   {
+    // If robust find and remove the outliers first...
+     if (robust>=0.0)
+     {
+      Homography2D h2d;
+      h2d.SetRobust(robust);
+      ds::List<Node>::Cursor targ = sd[i].data.FrontPtr();
+      while (!targ.Bad())
+      {
+       h2d.Add(targ->first,targ->second);
+       ++targ;
+      }
+
+      math::Mat<3,3,real64> dummy;
+      h2d.Result(dummy);
+
+      if (h2d.Inliers()!=sd[i].data.Size())
+      {
+       LogDebug("[cam.calibration] Outliers removed {shot,inliers,points}" << LogDiv()
+                << i << LogDiv() << h2d.Inliers() << LogDiv() << sd[i].data.Size());
+       ds::List<Node> inliers;
+       targ = sd[i].data.FrontPtr();
+       for (nat32 j=0;!targ.Bad();j++,++targ)
+       {
+        if (h2d.Inlier(j)) inliers.AddBack(*targ);
+       }
+       sd[i].data.Reset();
+       targ = inliers.FrontPtr();
+       while (!targ.Bad())
+       {
+        sd[i].data.AddBack(*targ);
+        ++targ;
+       }
+      }
+     }
+
+    // Calculate the normalised version, as this is robust...
+    {
+     Homography2D h2d;
+      ds::List<Node>::Cursor targ = sd[i].data.FrontPtr();
+      while (!targ.Bad())
+      {
+       math::Vect<2,real64> f;
+       math::Vect<2,real64> s;
+        MultVectEH(firstNorm,targ->first,f);
+        MultVectEH(secondNorm,targ->second,s);
+       h2d.Add(f,s);
+       ++targ;	     
+      }
+     sd[i].residual = h2d.Result(sd[i].hgNorm);          
+    }
+
+    // Calculate the un-normalised from the normalised...
+    {
+     math::Mat<3,3,real64> temp[2];
+     
+     temp[0] = secondNorm;
+     math::Inverse(temp[0],temp[1]);
+     math::Mult(temp[0],sd[i].hgNorm,temp[1]);
+     math::Mult(temp[1],firstNorm,sd[i].hg);
+    }
+   }
+  }
+
+
+ private:
+  Shot * sd;
+  const math::Mat<3,3,real64> & firstNorm;
+  const math::Mat<3,3,real64> & secondNorm;
+  real64 robust;
+};
+
+//------------------------------------------------------------------------------
+
 void Zhang98::Calculate(time::Progress * prog)
 {
  LogBlock("void Zhang98::Calculate()","-");
@@ -185,36 +281,15 @@ void Zhang98::Calculate(time::Progress * prog)
  prog->Report(1,prog_steps);
  prog->Push();
  {
-  // Calculate a homography for each shot, we make an un-adjusted one and a normalised one in each case...
-   for (nat32 i=0;i<shots;i++)
+  // Calculate a homography for each shot, we make an un-adjusted one and a
+  // normalised one in each case. Each is independent, so in parallel...
    {
-    prog->Report(i,shots+2);
-    // Calculate the normalised version, as this is robust...
-    {
-     Homography2D h2d;
-      targ = sd[i].data.FrontPtr();
-      while (!targ.Bad())
-      {
-       math::Vect<2,real64> f;
-       math::Vect<2,real64> s;
-        MultVectEH(firstNorm,targ->first,f);
-        MultVectEH(secondNorm,targ->second,s);
-       h2d.Add(f,s);
-       ++targ;	     
-      }
-     sd[i].residual = h2d.Result(sd[i].hgNorm);          
-    }
+    ShotHomography sh(sd,firstNorm,secondNorm,robust);
+    mt::ParallelFor(nat32(0),shots,sh);
+   }
 
-    // Calculate the un-normalised from the normalised...
-    {
-     math::Mat<3,3,real64> temp[2];
-     
-     temp[0] = secondNorm;
-     math::Inverse(temp[0],temp[1]);
-     math::Mult(temp[0],sd[i].hgNorm,temp[1]);
-     math::Mult(temp[1],firstNorm,sd[i].hg);
-    }
-        
+   for (nat32 i=0;i<shots;i++)
+   {
     LogDebug("[cam.calibration] Initial homography {i,residual,h,h-norm}" << LogDiv()
              << i << LogDiv() << sd[i].residual << LogDiv() << sd[i].hg << LogDiv() << sd[i].hgNorm);
    }
@@ -453,15 +528,7 @@ void Zhang98::Calculate(time::Progress * prog)
 
 
   // Run LM...
-   LMdata lmd;
-    lmd.shots = shots;
-    lmd.sd = sd;
-    
-   nat32 evs = 0;
-   for (nat32 i=0;i<shots;i++) evs += sd[i].data.Size();
-   evs *= 2;
- 
-   residual = LM(evs,vec,lmd,&FirstLM);
+   residual = Refine(vec,7,sd,shots,&FirstErr);
    LogDebug("[cam.calibration] Output of second steps LM. {vec}" << LogDiv() << vec);
 
 
@@ -569,15 +636,7 @@ void Zhang98::Calculate(time::Progress * prog)
 
 
   // Run LM...
-   LMdata lmd;
-    lmd.shots = shots;
-    lmd.sd = sd;
-    
-   nat32 evs = 0;
-   for (nat32 i=0;i<shots;i++) evs += sd[i].data.Size();
-   evs *= 2;
- 
-   real64 nRes = LM(evs,vec,lmd,&SecondLM);
+   real64 nRes = Refine(vec,11,sd,shots,&SecondErr);
 
 
   // if this has gone wrong we break on the ushall level of refinement.
@@ -637,132 +696,159 @@ void Zhang98::Calculate(time::Progress * prog)
  prog->Pop();
 }
 
-void Zhang98::FirstLM(const math::Vector<real64> & pv,math::Vector<real64> & err,const LMdata & oi)
+real64 Zhang98::Refine(math::Vector<real64> & vec,nat32 globalSize,Shot * sd,nat32 shots,
+                       void (*F)(const math::Vector<real64> & a,const math::Vector<real64> & b,
+                                 const math::Vector<real64> & m,math::Vector<real64> & err))
+{
+ LogTime("eos::cam::Zhang98::Refine");
+
+ // Every shot gets an error vector the size of the largest...
+  nat32 maxPoints = 0;
+  for (nat32 i=0;i<shots;i++) maxPoints = math::Max(maxPoints,sd[i].data.Size());
+
+ // Fill in the parameters...
+  math::SparseLM lm;
+  lm.SetSizes(globalSize,6,2*maxPoints);
+  {
+   math::Vector<real64> global(globalSize);
+   for (nat32 i=0;i<globalSize;i++) global[i] = vec[i];
+   lm.AddParaA(global);
+
+   math::Vector<real64> shot(6);
+   for (nat32 i=0;i<shots;i++)
+   {
+    for (nat32 j=0;j<6;j++) shot[j] = vec[globalSize + i*6 + j];
+    lm.AddParaB(shot);
+   }
+  }
+
+ // Add the error for each shot, packing its points into the measurement...
+  {
+   math::Vector<real64> m(1 + 4*maxPoints);
+   for (nat32 i=0;i<shots;i++)
+   {
+    for (nat32 j=0;j<m.Size();j++) m[j] = 0.0;
+    m[0] = sd[i].data.Size();
+
+    ds::List<Node>::Cursor targ = sd[i].data.FrontPtr();
+    for (nat32 j=0;!targ.Bad();j++,++targ)
+    {
+     m[1 + j*4 + 0] = targ->first[0];
+     m[1 + j*4 + 1] = targ->first[1];
+     m[1 + j*4 + 2] = targ->second[0];
+     m[1 + j*4 + 3] = targ->second[1];
+    }
+
+    lm.AddError(0,i,m,F);
+   }
+  }
+
+ // Run and extract...
+  real64 ret = lm.Run();
+  {
+   math::Vector<real64> global(globalSize);
+   lm.GetParaA(0,global);
+   for (nat32 i=0;i<globalSize;i++) vec[i] = global[i];
+
+   math::Vector<real64> shot(6);
+   for (nat32 i=0;i<shots;i++)
+   {
+    lm.GetParaB(i,shot);
+    for (nat32 j=0;j<6;j++) vec[globalSize + i*6 + j] = shot[j];
+   }
+  }
+
+ return ret;
+}
+
+void Zhang98::FirstErr(const math::Vector<real64> & a,const math::Vector<real64> & b,
+                       const math::Vector<real64> & m,math::Vector<real64> & err)
 {
  // Construct the intrinsic matrix object...
   Intrinsic intrinsic;
-    intrinsic.PrincipalX() = pv[0];
-    intrinsic.PrincipalY() = pv[1];
-    intrinsic.FocalX() = pv[2];
-    intrinsic.FocalY() = pv[3];
-    intrinsic.Skew() = pv[4];
+    intrinsic.PrincipalX() = a[0];
+    intrinsic.PrincipalY() = a[1];
+    intrinsic.FocalX() = a[2];
+    intrinsic.FocalY() = a[3];
+    intrinsic.Skew() = a[4];
  
  // Construct the radial distortion object...
   Radial radial;
    radial.aspectRatio = intrinsic.AspectRatio();
    radial.centre[0] = intrinsic.PrincipalX();
    radial.centre[1] = intrinsic.PrincipalY();
-   radial.k[0] = pv[5];
-   radial.k[1] = pv[6];
+   radial.k[0] = a[5];
+   radial.k[1] = a[6];
    radial.k[2] = 0.0;
    radial.k[3] = 0.0;
-    
- // For each shot calculate the relevent homography, then transform each point
- // and subtract the visualised point to get a mother of an error vector.
- nat32 ep = 0;
- for (nat32 i=0;i<oi.shots;i++)
- {
-  // Calculate the homography...
-   math::Mat<3,3,real64> hgo;
-   math::Vect<3,real64> aa;
-    aa[0] = pv[7 + i*6 + 0];
-    aa[1] = pv[7 + i*6 + 1];
-    aa[2] = pv[7 + i*6 + 2];
-   AngAxisToRotMat(aa,hgo);
-   
-   hgo[0][2] = pv[7 + i*6 + 3];
-   hgo[1][2] = pv[7 + i*6 + 4];
-   hgo[2][2] = pv[7 + i*6 + 5];
-   
-   math::Mat<3,3,real64> hg;
-   Mult(intrinsic,hgo,hg);
 
-      
-  // Iterate all points, for each one output the difference between our
-  // calculated and actual value in x and y seperatly...
-   ds::List<Node>::Cursor targ = oi.sd[i].data.FrontPtr();
-   while (!targ.Bad())
-   {
-    // Apply homography...
-     math::Vect<2,real64> t1;
-     MultVectEH(hg,targ->first,t1);
-     
-    // Apply radial...
-     math::Vect<2,real64> t2;
-     radial.Dis(t1,t2);
-    
-    // Output difference...   
-     err[ep]   = t2[0] - targ->second[0];
-     err[ep+1] = t2[1] - targ->second[1];
-    
-    ep += 2;
-    ++targ;	   
-   }
- }
+ ShotErr(intrinsic,radial,b,m,err);
 }
 
-void Zhang98::SecondLM(const math::Vector<real64> & pv,math::Vector<real64> & err,const LMdata & oi)
+void Zhang98::SecondErr(const math::Vector<real64> & a,const math::Vector<real64> & b,
+                        const math::Vector<real64> & m,math::Vector<real64> & err)
 {
  // Construct the intrinsic matrix object...
   Intrinsic intrinsic;
-    intrinsic.PrincipalX() = pv[0];
-    intrinsic.PrincipalY() = pv[1];
-    intrinsic.FocalX() = pv[2];
-    intrinsic.FocalY() = pv[3];
-    intrinsic.Skew() = pv[4];
+    intrinsic.PrincipalX() = a[0];
+    intrinsic.PrincipalY() = a[1];
+    intrinsic.FocalX() = a[2];
+    intrinsic.FocalY() = a[3];
+    intrinsic.Skew() = a[4];
  
  // Construct the radial distortion object...
   Radial radial;
    radial.aspectRatio = intrinsic.AspectRatio();
-   radial.centre[0] = pv[5];
-   radial.centre[1] = pv[6];
-   radial.k[0] = pv[7];
-   radial.k[1] = pv[8];
-   radial.k[2] = pv[9];
-   radial.k[3] = pv[10];
-    
- // For each shot calculate the relevent homography, then transform each point
- // and subtract the visualised point to get a mother of an error vector.
- nat32 ep = 0;
- for (nat32 i=0;i<oi.shots;i++)
- {
-  // Calculate the homography...
-   math::Mat<3,3,real64> hgo;
-   math::Vect<3,real64> aa;
-    aa[0] = pv[11 + i*6 + 0];
-    aa[1] = pv[11 + i*6 + 1];
-    aa[2] = pv[11 + i*6 + 2];
-   AngAxisToRotMat(aa,hgo);
+   radial.centre[0] = a[5];
+   radial.centre[1] = a[6];
+   radial.k[0] = a[7];
+   radial.k[1] = a[8];
+   radial.k[2] = a[9];
+   radial.k[3] = a[10];
+
+ ShotErr(intrinsic,radial,b,m,err);
+}
+
+void Zhang98::ShotErr(const Intrinsic & intrinsic,const Radial & radial,const math::Vector<real64> & b,
+                      const math::Vector<real64> & m,math::Vector<real64> & err)
+{
+ // Calculate the homography...
+  math::Mat<3,3,real64> hgo;
+  math::Vect<3,real64> aa;
+   aa[0] = b[0];
+   aa[1] = b[1];
+   aa[2] = b[2];
+  AngAxisToRotMat(aa,hgo);
    
-   hgo[0][2] = pv[11 + i*6 + 3];
-   hgo[1][2] = pv[11 + i*6 + 4];
-   hgo[2][2] = pv[11 + i*6 + 5];
+  hgo[0][2] = b[3];
+  hgo[1][2] = b[4];
+  hgo[2][2] = b[5];
       
-   math::Mat<3,3,real64> hg;
-   Mult(intrinsic,hgo,hg);   
+  math::Mat<3,3,real64> hg;
+  Mult(intrinsic,hgo,hg);   
 
+
+ // Iterate all points, for each one output the difference between our
+ // calculated and actual value in x and y seperatly, zeroing the padding...
+  nat32 points = nat32(m[0]);
+  for (nat32 i=0;i<points;i++)
+  {
+   // Apply homography...
+    math::Vect<2,real64> p;
+     p[0] = m[1 + i*4 + 0];
+     p[1] = m[1 + i*4 + 1];
+    math::Vect<2,real64> t1;
+    MultVectEH(hg,p,t1);
      
-  // Iterate all points, for each one output the difference between our
-  // calculated and actual value in x and y seperatly...
-   ds::List<Node>::Cursor targ = oi.sd[i].data.FrontPtr();
-   while (!targ.Bad())
-   {
-    // Apply homography...
-     math::Vect<2,real64> t1;
-     MultVectEH(hg,targ->first,t1);
-     
-    // Apply radial...
-     math::Vect<2,real64> t2;
-     radial.Dis(t1,t2);
+   // Apply radial...
+    math::Vect<2,real64> t2;
+    radial.Dis(t1,t2);
     
-    // Output difference...   
-     err[ep]   = t2[0] - targ->second[0];
-     err[ep+1] = t2[1] - targ->second[1];
-    
-    ep += 2;
-    ++targ;	   
-   }
- }
+   // Output difference...   
+    err[i*2]   = t2[0] - m[1 + i*4 + 2];
+    err[i*2+1] = t2[1] - m[1 + i*4 + 3];
+  }
+  for (nat32 i=points*2;i<err.Size();i++) err[i] = 0.0;
 }
 
 //------------------------------------------------------------------------------
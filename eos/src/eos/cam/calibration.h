@@ -97,6 +97,15 @@ class EOS_CLASS Zhang98
   /// Sets the maximum quality level to obtain, defaults to high.
    void SetQuality(ResQuality rq);
 
+  /// Makes the per-shot homographies robust, using RANSAC with the given
+  /// tolerance, in image coordinates - points found to be outliers are then
+  /// left out of the rest of the calibration. For when the pattern detector
+  /// is not to be trusted.
+   void SetRobust(real64 tolerance);
+
+  /// Goes back to using every point, the default.
+   void SetNonRobust();
+
   
   /// Once enough data has been provided this calculates the calibration. The various
   /// Get* methods will start producing sensible results after a call to this.
@@ -138,6 +147,7 @@ class EOS_CLASS Zhang98
    };
   
    ResQuality targQ; // Maximum quality to get to.
+   real64 robust; // RANSAC tolerance for the homographies, negative for off.
    ds::List<Node> data;
    
   // Data types used by the algorithm during run-time...
@@ -149,12 +159,7 @@ class EOS_CLASS Zhang98
     real64 residual; // Just for logging purposes.
    };
      
-   struct LMdata
-   {
-    nat32 shots;
-    Shot * sd;
-   };
-   
+
   // Data for the actual results...
    ResQuality resQ;
    real64 residual;
@@ -163,9 +168,28 @@ class EOS_CLASS Zhang98
    ds::Array<Extrinsic> extrinsic;
 
 
-  // Error metrics for the two LM steps...
-   static void FirstLM(const math::Vector<real64> & pv,math::Vector<real64> & err,const LMdata & oi);
-   static void SecondLM(const math::Vector<real64> & pv,math::Vector<real64> & err,const LMdata & oi);
+  // Does the homographies of a range of shots, so they can be done in parallel...
+   class ShotHomography;
+
+  // The refinements are done with a SparseLM, the intrinsic and radial
+  // parameters being the first list and the extrinsic parameters of each shot
+  // the second, as each shot is otherwise independent. Each shot gets one
+  // error vector, padded with zeros to the size of the largest - m is the
+  // point count followed by the points, as (model x,model y,image x,image y).
+   static void FirstErr(const math::Vector<real64> & a,const math::Vector<real64> & b,
+                        const math::Vector<real64> & m,math::Vector<real64> & err);
+   static void SecondErr(const math::Vector<real64> & a,const math::Vector<real64> & b,
+                         const math::Vector<real64> & m,math::Vector<real64> & err);
+
+  // Helper for the above, the shared part...
+   static void ShotErr(const Intrinsic & intrinsic,const Radial & radial,const math::Vector<real64> & b,
+                       const math::Vector<real64> & m,math::Vector<real64> & err);
+
+  // Runs a refinement, on a vector of the global parameters followed by 6 for
+  // each shot, updating it in place. Returns the residual...
+   static real64 Refine(math::Vector<real64> & vec,nat32 globalSize,Shot * sd,nat32 shots,
+                        void (*F)(const math::Vector<real64> & a,const math::Vector<real64> & b,
+                                  const math::Vector<real64> & m,math::Vector<real64> & err));
 };
 
 //------------------------------------------------------------------------------
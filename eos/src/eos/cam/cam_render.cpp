@@ -20,6 +20,11 @@
 #include "eos/math/mat_ops.h"
 #include "eos/cam/triangulation.h"
 #include "eos/sur/intersection.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace eos
 {
@@ -37,6 +42,9 @@ void EOS_FUNC CamToRays(const CameraFull & cam,ds::Array2D<bs::Ray> & rays,time:
  math::Mat<4,3,real64> invCam;
  cam.camera.GetInverse(invCam);
 
+ UnDisMap unDisMap;
+ unDisMap.Build(cam.radial,rays.Width(),rays.Height());
+
  for (nat32 y=0;y<rays.Height();y++)
  {
   prog->Report(y,rays.Height());
@@ -52,7 +60,7 @@ void EOS_FUNC CamToRays(const CameraFull & cam,ds::Array2D<bs::Ray> & rays,time:
     dis[2] = 1.0;
 
     math::Vect<3,real64> undis;
-    cam.radial.UnDis(dis,undis);
+    unDisMap.UnDis(dis,undis);
 
    // Multiply by the inverse projection matrix...
     math::Vect<4,real64> loc;
@@ -166,6 +174,531 @@ void EOS_FUNC RenderTri(const CameraFull & cam,const ds::Array2D<bs::Ray> & rays
   }
 }
 
+//------------------------------------------------------------------------------
+// Renders a range of tiles, each one independently, given the triangles of
+// each as a run of indices...
+class TriRaster::RenderTiles
+{
+ public:
+  RenderTiles(TriRaster & s,const ds::Array<nat32> & st,const ds::Array<nat32> & l)
+  :self(s),start(st),list(l)
+  {}
+
+  void operator () (nat32 t0,nat32 t1)
+  {
+   static const nat32 ts = TriRaster::tileSize;
+   static const nat32 area = ts*ts;
+
+   #ifdef __SSE2__
+   __m128 zx[area/4]; // Forces alignment for the rest.
+   real32 * ux = (real32*)zx;
+   __m128 zy[area/4];
+   real32 * uy = (real32*)zy;
+   __m128 zz[area/4];
+   real32 * z = (real32*)zz;
+   __m128 zw0[area/4];
+   real32 * w0 = (real32*)zw0;
+   __m128 zw1[area/4];
+   real32 * w1 = (real32*)zw1;
+   #else
+   real32 ux[area];
+   real32 uy[area];
+   real32 z[area];
+   real32 w0[area];
+   real32 w1[area];
+   #endif
+   nat32 tri[area];
+
+   for (nat32 t=t0;t<t1;t++)
+   {
+    if (start[t]==start[t+1]) continue;
+
+    // Pixel range of the tile...
+     int32 x0 = int32((t%self.tilesX)*ts);
+     int32 y0 = int32((t/self.tilesX)*ts);
+     int32 x1 = math::Min(x0+int32(ts),int32(self.frag.Width()));
+     int32 y1 = math::Min(y0+int32(ts),int32(self.frag.Height()));
+
+    // Undistorted coordinates of every pixel, relative to the tiles bounding
+    // box to keep the precision of the edge functions, plus a local copy of
+    // the output. Pixels outside the image get an infinite depth, so nothing
+    // can be drawn to them...
+     real64 ox = self.tile[t].min[0];
+     real64 oy = self.tile[t].min[1];
+     for (nat32 v=0;v<ts;v++)
+     {
+      for (nat32 u=0;u<ts;u++)
+      {
+       nat32 i = v*ts + u;
+       int32 x = x0 + int32(u);
+       int32 y = y0 + int32(v);
+       if ((x<x1)&&(y<y1))
+       {
+        math::Vect<2,real64> p;
+        p[0] = x;
+        p[1] = y;
+        if (self.distort) self.unDisMap.UnDis(p,p);
+        ux[i] = real32(p[0] - ox);
+        uy[i] = real32(p[1] - oy);
+
+        const Frag & f = self.frag.Get(x,y);
+        tri[i] = f.tri;
+        z[i] = f.depth;
+        w0[i] = f.w[0];
+        w1[i] = f.w[1];
+       }
+       else
+       {
+        ux[i] = 0.0;
+        uy[i] = 0.0;
+        tri[i] = nat32(-1);
+        z[i] = math::Infinity<real32>();
+        w0[i] = 0.0;
+        w1[i] = 0.0;
+       }
+      }
+     }
+
+    // Do each triangle in turn...
+     for (nat32 j=start[t];j<start[t+1];j++)
+     {
+      const Triangle & targ = self.tris[list[j]];
+      nat32 index = self.base + list[j];
+
+      // Relevant rows and columns, the columns in groups of 4...
+       int32 rowLow = math::Max(targ.box[1],y0) - y0;
+       int32 rowHigh = math::Min(targ.box[3],y1-1) - y0;
+       int32 colLow = (math::Max(targ.box[0],x0) - x0)&(~3);
+       int32 colHigh = math::Min(targ.box[2],x1-1) - x0;
+       if ((rowLow>rowHigh)||(colLow>colHigh)) continue;
+
+      // Edge functions relative to the tile...
+       real32 ea[3];
+       real32 eb[3];
+       real32 ec[3];
+       for (nat32 e=0;e<3;e++)
+       {
+        ea[e] = real32(targ.edge[e][0]);
+        eb[e] = real32(targ.edge[e][1]);
+        ec[e] = real32(targ.edge[e][2] + targ.edge[e][0]*ox + targ.edge[e][1]*oy);
+       }
+       real32 dm = -real32(self.depthMult);
+
+      // Pixels are allowed to be this far outside in terms of the barycentric
+      // weights, so rounding error does not leave cracks along shared edges -
+      // the z-buffer sorts out the overlap...
+       static const real32 slack = 1e-5;
+
+      #ifdef __SSE2__
+       __m128 a0 = _mm_set1_ps(ea[0]); __m128 b0 = _mm_set1_ps(eb[0]); __m128 c0 = _mm_set1_ps(ec[0]);
+       __m128 a1 = _mm_set1_ps(ea[1]); __m128 b1 = _mm_set1_ps(eb[1]); __m128 c1 = _mm_set1_ps(ec[1]);
+       __m128 a2 = _mm_set1_ps(ea[2]); __m128 b2 = _mm_set1_ps(eb[2]); __m128 c2 = _mm_set1_ps(ec[2]);
+       __m128 zero = _mm_setzero_ps();
+       __m128 dm4 = _mm_set1_ps(dm);
+       __m128 nslack4 = _mm_set1_ps(-slack);
+
+       for (int32 v=rowLow;v<=rowHigh;v++)
+       {
+        for (int32 u=colLow;u<=colHigh;u+=4)
+        {
+         nat32 i = nat32(v)*ts + nat32(u);
+         __m128 px = _mm_load_ps(ux+i);
+         __m128 py = _mm_load_ps(uy+i);
+
+         __m128 f0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0,px),_mm_mul_ps(b0,py)),c0);
+         __m128 f1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a1,px),_mm_mul_ps(b1,py)),c1);
+         __m128 f2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a2,px),_mm_mul_ps(b2,py)),c2);
+         __m128 sum = _mm_add_ps(_mm_add_ps(f0,f1),f2);
+         __m128 slack = _mm_mul_ps(sum,nslack4);
+
+         __m128 in = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(f0,slack),_mm_cmpge_ps(f1,slack)),
+                                _mm_and_ps(_mm_cmpge_ps(f2,slack),_mm_cmpgt_ps(sum,zero)));
+         if (_mm_movemask_ps(in)==0) continue;
+
+         __m128 inv = _mm_div_ps(_mm_set1_ps(1.0),sum);
+         __m128 d = _mm_mul_ps(dm4,inv);
+         __m128 old = _mm_load_ps(z+i);
+         __m128 win = _mm_and_ps(in,_mm_cmpgt_ps(d,old));
+         int bits = _mm_movemask_ps(win);
+         if (bits==0) continue;
+
+         _mm_store_ps(z+i,_mm_or_ps(_mm_and_ps(win,d),_mm_andnot_ps(win,old)));
+         _mm_store_ps(w0+i,_mm_or_ps(_mm_and_ps(win,_mm_mul_ps(f0,inv)),_mm_andnot_ps(win,_mm_load_ps(w0+i))));
+         _mm_store_ps(w1+i,_mm_or_ps(_mm_and_ps(win,_mm_mul_ps(f1,inv)),_mm_andnot_ps(win,_mm_load_ps(w1+i))));
+         for (nat32 k=0;k<4;k++)
+         {
+          if (bits&(1<<k)) tri[i+k] = index;
+         }
+        }
+       }
+      #else
+       for (int32 v=rowLow;v<=rowHigh;v++)
+       {
+        for (int32 u=colLow;u<=colHigh;u++)
+        {
+         nat32 i = nat32(v)*ts + nat32(u);
+         real32 f0 = ea[0]*ux[i] + eb[0]*uy[i] + ec[0];
+         real32 f1 = ea[1]*ux[i] + eb[1]*uy[i] + ec[1];
+         real32 f2 = ea[2]*ux[i] + eb[2]*uy[i] + ec[2];
+         real32 sum = f0 + f1 + f2;
+         real32 low = -slack*sum;
+         if ((f0<low)||(f1<low)||(f2<low)||(!(sum>0.0))) continue;
+
+         real32 inv = 1.0/sum;
+         real32 d = dm*inv;
+         if (!(d>z[i])) continue;
+
+         z[i] = d;
+         w0[i] = f0*inv;
+         w1[i] = f1*inv;
+         tri[i] = index;
+        }
+       }
+      #endif
+     }
+
+    // Write the tile back...
+     for (int32 y=y0;y<y1;y++)
+     {
+      for (int32 x=x0;x<x1;x++)
+      {
+       nat32 i = nat32(y-y0)*ts + nat32(x-x0);
+       Frag & f = self.frag.Get(x,y);
+       f.tri = tri[i];
+       f.depth = z[i];
+       f.w[0] = w0[i];
+       f.w[1] = w1[i];
+      }
+     }
+   }
+  }
+
+ private:
+  TriRaster & self;
+  const ds::Array<nat32> & start;
+  const ds::Array<nat32> & list;
+};
+
+//------------------------------------------------------------------------------
+TriRaster::TriRaster()
+:distort(false),side(1.0),depthMult(1.0),tilesX(0),tilesY(0),base(0),tris(0,256),bins(0,1024)
+{}
+
+TriRaster::~TriRaster()
+{}
+
+void TriRaster::Reset(const Camera & c,const Radial * rad,nat32 width,nat32 height)
+{
+ LogTime("eos::cam::TriRaster::Reset");
+
+ // Camera...
+  cam = c;
+  distort = rad!=null<Radial*>();
+  if (distort)
+  {
+   radial = *rad;
+   unDisMap.Build(radial,width,height);
+  }
+
+  math::Mat<3,3,real64> m;
+  math::SubSet(m,cam,0,0);
+  side = (math::Determinant(m)<0.0)?1.0:-1.0;
+  depthMult = math::InvSqrt(math::Sqr(m[2][0]) + math::Sqr(m[2][1]) + math::Sqr(m[2][2]));
+
+ // Empty output...
+  frag.Resize(width,height);
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    Frag & f = frag.Get(x,y);
+    f.tri = nat32(-1);
+    f.depth = -math::Infinity<real32>();
+    f.w[0] = 0.0;
+    f.w[1] = 0.0;
+   }
+  }
+
+ // Tiles, with the undistorted bounds found from their perimeters...
+  tilesX = (width+tileSize-1)/tileSize;
+  tilesY = (height+tileSize-1)/tileSize;
+  tile.Size(tilesX*tilesY);
+  allMin[0] = math::Infinity<real64>();  allMin[1] = math::Infinity<real64>();
+  allMax[0] = -math::Infinity<real64>(); allMax[1] = -math::Infinity<real64>();
+
+  for (nat32 ty=0;ty<tilesY;ty++)
+  {
+   for (nat32 tx=0;tx<tilesX;tx++)
+   {
+    Tile & targ = tile[ty*tilesX + tx];
+    nat32 x0 = tx*tileSize;
+    nat32 y0 = ty*tileSize;
+    nat32 x1 = math::Min(x0+tileSize,width) - 1;
+    nat32 y1 = math::Min(y0+tileSize,height) - 1;
+
+    if (distort)
+    {
+     targ.min[0] = math::Infinity<real64>();  targ.min[1] = math::Infinity<real64>();
+     targ.max[0] = -math::Infinity<real64>(); targ.max[1] = -math::Infinity<real64>();
+     for (nat32 y=y0;y<=y1;y++)
+     {
+      nat32 step = ((y==y0)||(y==y1))?1:(x1-x0);
+      for (nat32 x=x0;x<=x1;x+=math::Max(step,nat32(1)))
+      {
+       math::Vect<2,real64> p;
+       p[0] = x;
+       p[1] = y;
+       unDisMap.UnDis(p,p);
+       for (nat32 i=0;i<2;i++)
+       {
+        targ.min[i] = math::Min(targ.min[i],p[i]);
+        targ.max[i] = math::Max(targ.max[i],p[i]);
+       }
+      }
+     }
+    }
+    else
+    {
+     targ.min[0] = x0; targ.min[1] = y0;
+     targ.max[0] = x1; targ.max[1] = y1;
+    }
+
+    for (nat32 i=0;i<2;i++)
+    {
+     allMin[i] = math::Min(allMin[i],targ.min[i]);
+     allMax[i] = math::Max(allMax[i],targ.max[i]);
+    }
+   }
+  }
+
+ // No triangles...
+  base = 0;
+  tris.Size(0);
+  bins.Size(0);
+}
+
+void TriRaster::Reset(const CameraFull & c)
+{
+ Reset(c.camera,&c.radial,nat32(c.dim[0]),nat32(c.dim[1]));
+}
+
+nat32 TriRaster::Add(const sur::IndexedMesh & mesh)
+{
+ nat32 ret = Triangles();
+ for (nat32 t=0;t<mesh.TriCount();t++)
+ {
+  bs::Vert a,b,c;
+  mesh.GetTri(t,a,b,c);
+  Add(a,b,c);
+ }
+ return ret;
+}
+
+nat32 TriRaster::Add(const bs::Vert & a,const bs::Vert & b,const bs::Vert & c)
+{
+ nat32 ind = tris.Size();
+ tris.Size(ind+1);
+ Triangle & targ = tris[ind];
+
+ // Project the corners, homogenous...
+  math::Vect<3,real64> p[3];
+  {
+   const bs::Vert * corner[3] = {&a,&b,&c};
+   for (nat32 i=0;i<3;i++)
+   {
+    math::Vect<4,real64> h;
+    h[0] = (*corner[i])[0];
+    h[1] = (*corner[i])[1];
+    h[2] = (*corner[i])[2];
+    h[3] = 1.0;
+    math::MultVect(cam,h,p[i]);
+   }
+  }
+
+ // Edge functions, the cross products of pairs of corners, scaled so they are
+ // barycentric coordinates at the projected corners, with a sign fix so
+ // positive is in front...
+  for (nat32 i=0;i<3;i++)
+  {
+   math::Vect<3,real64> e;
+   math::CrossProduct(p[(i+1)%3],p[(i+2)%3],e);
+   for (nat32 j=0;j<3;j++) targ.edge[i][j] = e[j];
+  }
+
+  real64 det = p[0][0]*targ.edge[0][0] + p[0][1]*targ.edge[0][1] + p[0][2]*targ.edge[0][2];
+  real64 scale = math::Sqrt(p[0].LengthSqr()*p[1].LengthSqr()*p[2].LengthSqr());
+  if (math::Abs(det)<=1e-12*scale)
+  {
+   for (nat32 i=0;i<3;i++)
+   {
+    for (nat32 j=0;j<3;j++) targ.edge[i][j] = 0.0;
+   }
+   return base + ind;
+  }
+
+  real64 mult = side/det;
+  for (nat32 i=0;i<3;i++)
+  {
+   for (nat32 j=0;j<3;j++) targ.edge[i][j] *= mult;
+  }
+
+
+ // Bounding box in the undistorted image plane - the whole image if any
+ // corner is behind the camera...
+  real64 low[2];
+  real64 high[2];
+  bit inFront = ((side*p[0][2])>0.0) && ((side*p[1][2])>0.0) && ((side*p[2][2])>0.0);
+  if (inFront)
+  {
+   for (nat32 i=0;i<2;i++)
+   {
+    low[i] = math::Min(p[0][i]/p[0][2],p[1][i]/p[1][2],p[2][i]/p[2][2]);
+    high[i] = math::Max(p[0][i]/p[0][2],p[1][i]/p[1][2],p[2][i]/p[2][2]);
+    low[i] = math::Max(low[i],allMin[i]);
+    high[i] = math::Min(high[i],allMax[i]);
+    if (low[i]>high[i]) return base + ind;
+   }
+  }
+  else
+  {
+   for (nat32 i=0;i<2;i++)
+   {
+    low[i] = allMin[i];
+    high[i] = allMax[i];
+   }
+  }
+
+
+ // Convert to a box in the image - with distortion this is done by sampling
+ // the edge of the box, and then padding...
+  real64 dim[2];
+  dim[0] = frag.Width();
+  dim[1] = frag.Height();
+  if (distort&&inFront)
+  {
+   real64 dLow[2] = {math::Infinity<real64>(),math::Infinity<real64>()};
+   real64 dHigh[2] = {-math::Infinity<real64>(),-math::Infinity<real64>()};
+   static const nat32 samples = 4;
+   for (nat32 s=0;s<=samples;s++)
+   {
+    real64 t = real64(s)/real64(samples);
+    math::Vect<2,real64> q[4];
+     q[0][0] = low[0] + t*(high[0]-low[0]); q[0][1] = low[1];
+     q[1][0] = low[0] + t*(high[0]-low[0]); q[1][1] = high[1];
+     q[2][0] = low[0]; q[2][1] = low[1] + t*(high[1]-low[1]);
+     q[3][0] = high[0]; q[3][1] = low[1] + t*(high[1]-low[1]);
+
+    for (nat32 k=0;k<4;k++)
+    {
+     radial.Dis(q[k],q[k]);
+     for (nat32 i=0;i<2;i++)
+     {
+      dLow[i] = math::Min(dLow[i],q[k][i]);
+      dHigh[i] = math::Max(dHigh[i],q[k][i]);
+     }
+    }
+   }
+
+   for (nat32 i=0;i<2;i++)
+   {
+    real64 pad = 1.0 + 0.125*(dHigh[i]-dLow[i]);
+    targ.box[i] = int32(math::Max(math::RoundDown(dLow[i]-pad),-1.0));
+    targ.box[2+i] = int32(math::Min(math::RoundUp(dHigh[i]+pad),dim[i]));
+   }
+  }
+  else
+  {
+   if (inFront)
+   {
+    for (nat32 i=0;i<2;i++)
+    {
+     targ.box[i] = int32(math::Max(math::RoundUp(low[i]-0.01),0.0));
+     targ.box[2+i] = int32(math::Min(math::RoundDown(high[i]+0.01),dim[i]-1.0));
+    }
+   }
+   else
+   {
+    targ.box[0] = 0;
+    targ.box[1] = 0;
+    targ.box[2] = int32(frag.Width()) - 1;
+    targ.box[3] = int32(frag.Height()) - 1;
+   }
+  }
+
+  targ.box[0] = math::Max(targ.box[0],int32(0));
+  targ.box[1] = math::Max(targ.box[1],int32(0));
+  targ.box[2] = math::Min(targ.box[2],int32(frag.Width())-1);
+  targ.box[3] = math::Min(targ.box[3],int32(frag.Height())-1);
+  if ((targ.box[0]>targ.box[2])||(targ.box[1]>targ.box[3])) return base + ind;
+
+
+ // Bin it into the tiles it overlaps, culling those that are entirely outside
+ // an edge...
+  nat32 lowTX = nat32(targ.box[0])/tileSize;
+  nat32 lowTY = nat32(targ.box[1])/tileSize;
+  nat32 highTX = nat32(targ.box[2])/tileSize;
+  nat32 highTY = nat32(targ.box[3])/tileSize;
+  for (nat32 ty=lowTY;ty<=highTY;ty++)
+  {
+   for (nat32 tx=lowTX;tx<=highTX;tx++)
+   {
+    nat32 t = ty*tilesX + tx;
+    const Tile & tt = tile[t];
+    if ((tt.max[0]<low[0])||(tt.min[0]>high[0])||(tt.max[1]<low[1])||(tt.min[1]>high[1])) continue;
+
+    bit outside = false;
+    for (nat32 e=0;e<3;e++)
+    {
+     real64 cx = targ.edge[e][0]*((targ.edge[e][0]>0.0)?tt.max[0]:tt.min[0]);
+     real64 cy = targ.edge[e][1]*((targ.edge[e][1]>0.0)?tt.max[1]:tt.min[1]);
+     if (cx+cy+targ.edge[e][2]<0.0) {outside = true; break;}
+    }
+    if (outside) continue;
+
+    nat32 bi = bins.Size();
+    bins.Size(bi+1);
+    bins[bi].tile = t;
+    bins[bi].tri = ind;
+   }
+  }
+
+ return base + ind;
+}
+
+void TriRaster::Render(time::Progress * prog)
+{
+ LogTime("eos::cam::TriRaster::Render");
+ prog->Push();
+
+ // Sort the bins by tile, keeping the order of the triangles within...
+  ds::Array<nat32> start(tile.Size()+1);
+  for (nat32 i=0;i<start.Size();i++) start[i] = 0;
+  for (nat32 i=0;i<bins.Size();i++) start[bins[i].tile+1] += 1;
+  for (nat32 i=1;i<start.Size();i++) start[i] += start[i-1];
+
+  ds::Array<nat32> list(bins.Size());
+  {
+   ds::Array<nat32> pos(tile.Size());
+   for (nat32 i=0;i<tile.Size();i++) pos[i] = start[i];
+   for (nat32 i=0;i<bins.Size();i++)
+   {
+    list[pos[bins[i].tile]] = bins[i].tri;
+    pos[bins[i].tile] += 1;
+   }
+  }
+
+ // Render the tiles...
+  RenderTiles rt(*this,start,list);
+  mt::ParallelFor(nat32(0),tile.Size(),rt,nat32(1));
+
+ // Done with the triangles...
+  base += tris.Size();
+  tris.Size(0);
+  bins.Size(0);
+
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -21,15 +21,19 @@
 /// \file cam_render.h
 /// Provides functions for rendering 3D triangles to an image with a .cam file,
 /// its most critical capability is it handles radial distortion by a 
-/// scanline/raytracing hybrid.
+/// scanline/raytracing hybrid. Also provides TriRaster, a z-buffered
+/// rasteriser for when there are a lot of triangles.
 
 #include "eos/types.h"
 #include "eos/cam/files.h"
 #include "eos/ds/arrays.h"
+#include "eos/ds/arrays2d.h"
+#include "eos/ds/arrays_resize.h"
 #include "eos/svt/field.h"
 #include "eos/bs/colours.h"
 #include "eos/bs/geo3d.h"
 #include "eos/time/progress.h"
+#include "eos/sur/indexed_mesh.h"
 
 namespace eos
 {
@@ -48,6 +52,8 @@ void EOS_FUNC CamToRays(const CameraFull & cam,ds::Array2D<bs::Ray> & rays,time:
 /// then interpolated.
 /// In addition to the camera you also provide a ray image generated for the 
 /// camera with the partner function - this is an optimisation.
+/// For more than a handful of triangles TriRaster is faster, and does not need
+/// the ray image.
 void EOS_FUNC RenderTri(const CameraFull & cam,const ds::Array2D<bs::Ray> & rays,
                         svt::Field<bs::ColourRGB> & image,
                         ds::Array2D<real32> & depth,
@@ -55,6 +61,139 @@ void EOS_FUNC RenderTri(const CameraFull & cam,const ds::Array2D<bs::Ray> & rays
                         const bs::Vert & b,const bs::ColourRGB & bc,
                         const bs::Vert & c,const bs::ColourRGB & cc);
 
+//------------------------------------------------------------------------------
+/// A z-buffered triangle rasteriser, for rendering large meshes into the view
+/// of a camera, optionally with radial distortion. For each pixel it records
+/// which triangle is visible, its depth and the barycentric weights of the
+/// corners, leaving it to the user to turn that into colour, disparity or
+/// whatever.
+///
+/// Triangles are binned into 16x16 tiles as they are added, then Render does
+/// the tiles in parallel, each one testing its triangles in order against edge
+/// functions, 4 pixels at a time with sse2. Each pixel is undistorted
+/// and the edge functions are those of the projected triangle, which are exact
+/// in the undistorted image plane, so unlike the scanline approach distortion
+/// needs no special treatment, and there is no per-pixel ray to store.
+/// The edge functions are homogenous, which makes the weights perspective
+/// correct and clips triangles against the plane of the camera for free.
+class EOS_CLASS TriRaster
+{
+ public:
+  /// You must call Reset before use.
+   TriRaster();
+
+  /// &nbsp;
+   ~TriRaster();
+
+
+  /// Sets the camera and the size of the image, emptying the rendering.
+  /// rad can be null for no radial distortion.
+   void Reset(const Camera & cam,const Radial * rad,nat32 width,nat32 height);
+
+  /// Sets the camera from a CameraFull, with an image of its size.
+   void Reset(const CameraFull & cam);
+
+
+  /// Adds a triangle, returning its index, which is what Tri reports it as
+  /// - indices keep counting up between renders. The triangle is not drawn
+  /// until Render is called. Triangles edge on to the camera are ignored.
+   nat32 Add(const bs::Vert & a,const bs::Vert & b,const bs::Vert & c);
+
+  /// Adds every triangle of a mesh, in order, returning the index of the first
+  /// - triangle t of the mesh gets the returned value plus t.
+   nat32 Add(const sur::IndexedMesh & mesh);
+
+  /// Returns how many triangles have been added since the last Reset, i.e. the
+  /// index the next triangle will get.
+   nat32 Triangles() const {return base + tris.Size();}
+
+  /// Renders all triangles added since the last call, z-buffered against all
+  /// that has gone before. Where two triangles are at the same depth the
+  /// first added wins.
+   void Render(time::Progress * prog = null<time::Progress*>());
+
+
+  /// &nbsp;
+   nat32 Width() const {return frag.Width();}
+
+  /// &nbsp;
+   nat32 Height() const {return frag.Height();}
+
+  /// Returns the index of the triangle visible at a pixel, nat32(-1) if there
+  /// is none.
+   nat32 Tri(nat32 x,nat32 y) const {return frag.Get(x,y).tri;}
+
+  /// Returns the depth of the visible surface at a pixel, as for
+  /// Camera::Depth, so negative, with -infinity if there is nothing.
+   real32 Depth(nat32 x,nat32 y) const {return frag.Get(x,y).depth;}
+
+  /// Outputs the barycentric weights of the three corners of the visible
+  /// triangle at a pixel, in the order given to Add.
+   void Weights(nat32 x,nat32 y,real32 & wa,real32 & wb,real32 & wc) const
+   {
+    const Frag & f = frag.Get(x,y);
+    wa = f.w[0];
+    wb = f.w[1];
+    wc = 1.0 - f.w[0] - f.w[1];
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::cam::TriRaster";}
+
+
+ private:
+  static const nat32 tileSize = 16;
+
+  Camera cam;
+  bit distort;
+  Radial radial;
+  UnDisMap unDisMap;
+  real64 side; // -1 or 1, so the edge functions are positive in front of the camera.
+  real64 depthMult; // Depth is -depthMult divided by the sum of the edge functions.
+
+  // The output...
+   struct Frag
+   {
+    nat32 tri;
+    real32 depth;
+    real32 w[2];
+   };
+   ds::Array2D<Frag> frag;
+
+  // The tiles, with the undistorted bounding box of each...
+   nat32 tilesX;
+   nat32 tilesY;
+   struct Tile
+   {
+    real64 min[2];
+    real64 max[2];
+   };
+   ds::Array<Tile> tile;
+   real64 allMin[2]; // Of all tiles.
+   real64 allMax[2]; // "
+
+  // Triangles waiting to be rendered, as edge functions of undistorted image
+  // coordinates, positive inside and in front of the camera...
+   struct Triangle
+   {
+    real64 edge[3][3];
+    int32 box[4]; // Conservative bounds in the image - min x, min y, max x, max y, inclusive.
+   };
+   nat32 base; // Index of the first triangle in tris.
+   ds::ArrayResize<Triangle> tris;
+
+  // Which triangles go to which tile, as (tile,triangle) pairs...
+   struct Bin
+   {
+    nat32 tile;
+    nat32 tri;
+   };
+   ds::ArrayResize<Bin> bins;
+
+  class RenderTiles;
+};
+
 //------------------------------------------------------------------------------
  };
 };
@@ -230,6 +230,105 @@ bit Radial::Save(const str::String & fn,bit overwrite)
   return file::SaveXML(&root,fn,overwrite);
 }
 
+//------------------------------------------------------------------------------
+UnDisMap::UnDisMap()
+:invStep(1.0)
+{
+ rad.aspectRatio = 1.0;
+ rad.centre[0] = 0.0;
+ rad.centre[1] = 0.0;
+ for (nat32 i=0;i<4;i++) rad.k[i] = 0.0;
+}
+
+UnDisMap::~UnDisMap()
+{}
+
+void UnDisMap::Build(const Radial & r,real64 width,real64 height,real64 step)
+{
+ rad = r;
+ invStep = 1.0/step;
+
+ // Find the furthest corner, in distorted radius, and add a few steps for
+ // luck, as people do ask for points just off the edge...
+  real64 maxRad = 0.0;
+  for (nat32 c=0;c<4;c++)
+  {
+   real64 ox = ((c&1)?(width-1.0):0.0) - rad.centre[0];
+   real64 oy = ((c&2)?(height-1.0):0.0) - rad.centre[1];
+   maxRad = math::Max(maxRad,math::Sqrt(math::Sqr(rad.aspectRatio*ox) + math::Sqr(oy)));
+  }
+  nat32 size = nat32(math::RoundUp(maxRad*invStep)) + 4;
+
+ // Solve for each entry, via a point straight up from the centre, so the
+ // aspect ratio doesn't get involved...
+  scale.Size(size);
+  scale[0] = 1.0;
+  for (nat32 i=1;i<size;i++)
+  {
+   math::Vect<2,real64> dis;
+   dis[0] = rad.centre[0];
+   dis[1] = rad.centre[1] + real64(i)*step;
+
+   math::Vect<2,real64> unDis;
+   rad.UnDis(dis,unDis);
+
+   scale[i] = (unDis[1] - rad.centre[1])/(dis[1] - rad.centre[1]);
+  }
+}
+
+bit UnDisMap::Write(io::OutVirt<io::Binary> & out) const
+{
+ real64 head[8];
+  head[0] = rad.aspectRatio;
+  head[1] = rad.centre[0];
+  head[2] = rad.centre[1];
+  for (nat32 i=0;i<4;i++) head[3+i] = rad.k[i];
+  head[7] = invStep;
+ nat32 size = scale.Size();
+
+ if (out.Write(head,sizeof(head))!=sizeof(head)) return false;
+ if (out.Write(&size,sizeof(size))!=sizeof(size)) return false;
+ if (size==0) return true;
+
+ nat32 bytes = size*sizeof(real64);
+ return out.Write(&scale[0],bytes)==bytes;
+}
+
+bit UnDisMap::Read(io::InVirt<io::Binary> & in)
+{
+ real64 head[8];
+ nat32 size = 0;
+ bit ok = (in.Read(head,sizeof(head))==sizeof(head))&&(in.Read(&size,sizeof(size))==sizeof(size));
+ ok = ok&&(size<(1<<24));
+
+ if (ok)
+ {
+  scale.Size(size);
+  nat32 bytes = size*sizeof(real64);
+  if (bytes!=0) ok = in.Read(scale.Ptr(),bytes)==bytes;
+ }
+
+ if (ok)
+ {
+  rad.aspectRatio = head[0];
+  rad.centre[0] = head[1];
+  rad.centre[1] = head[2];
+  for (nat32 i=0;i<4;i++) rad.k[i] = head[3+i];
+  invStep = head[7];
+ }
+ else
+ {
+  rad.aspectRatio = 1.0;
+  rad.centre[0] = 0.0;
+  rad.centre[1] = 0.0;
+  for (nat32 i=0;i<4;i++) rad.k[i] = 0.0;
+  invStep = 1.0;
+  scale.Size(0);
+ }
+
+ return ok;
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC real32 FocalLength35mmHoriz(real64 width,real64 height,
                                      const Intrinsic & intrinsic,
@@ -33,10 +33,12 @@
 #include "eos/math/matrices.h"
 #include "eos/math/mat_ops.h"
 #include "eos/math/iter_min.h"
+#include "eos/ds/arrays.h"
 #include "eos/str/strings.h"
 #include "eos/bs/dom.h"
 #include "eos/bs/geo2d.h"
 #include "eos/bs/geo3d.h"
+#include "eos/io/out.h"
 
 namespace eos
 {
@@ -279,6 +281,91 @@ class EOS_CLASS Radial
    }
 };
 
+//------------------------------------------------------------------------------
+/// A fast stand in for Radial::UnDis, for when a lot of points are to be
+/// undistorted with the same parameters, such as every pixel of an image.
+/// As the distortion only depends on the distance from the centre the inverse
+/// is a function of one variable - this solves it, with the same LM method,
+/// at regular steps of distorted radius out to the corners of the image, and
+/// then linearly interpolates. Points further out than the table fall back to
+/// Radial::UnDis, so it is never wrong, just slow for them.
+class EOS_CLASS UnDisMap
+{
+ public:
+  /// Sets it up for no distortion at all.
+   UnDisMap();
+
+  /// &nbsp;
+   ~UnDisMap();
+
+
+  /// Builds the table for the given distortion, to cover an image of the given
+  /// size. step is the spacing of the table, in pixels of distorted radius.
+   void Build(const Radial & rad,real64 width,real64 height,real64 step = 0.25);
+
+  /// Returns how many entries are in the table.
+   nat32 Size() const {return scale.Size();}
+
+  /// Returns the Radial object the table was built for.
+   const Radial & Parameters() const {return rad;}
+
+  /// Writes the table, so it can be stored rather than rebuilt, see RigCache.
+  /// Returns false if writing fails.
+   bit Write(io::OutVirt<io::Binary> & out) const;
+
+  /// Reads a table saved with Write, returning false on failure, in which
+  /// case it is left set up for no distortion.
+   bit Read(io::InVirt<io::Binary> & in);
+
+
+  /// Converts from distorted to un-distorted coordinates, as for
+  /// Radial::UnDis. dis and unDis can be the same variable.
+   void UnDis(const math::Vect<2,real64> & dis,math::Vect<2,real64> & unDis) const
+   {
+    real64 ox = dis[0] - rad.centre[0];
+    real64 oy = dis[1] - rad.centre[1];
+    real64 pos = math::Sqrt(math::Sqr(rad.aspectRatio*ox) + math::Sqr(oy)) * invStep;
+
+    nat32 i = nat32(pos);
+    if ((i+1)>=scale.Size())
+    {
+     rad.UnDis(dis,unDis);
+     return;
+    }
+
+    real64 t = pos - real64(i);
+    real64 mult = (1.0-t)*scale[i] + t*scale[i+1];
+    unDis[0] = rad.centre[0] + ox*mult;
+    unDis[1] = rad.centre[1] + oy*mult;
+   }
+
+  /// Converts from distorted to un-distorted coordinates, as for
+  /// Radial::UnDis. dis and unDis can be the same variable.
+  /// The output will be normalised so that w=1.
+   void UnDis(const math::Vect<3,real64> & dis,math::Vect<3,real64> & unDis) const
+   {
+    math::Vect<2,real64> disNorm,unDisNorm;
+    disNorm[0] = dis[0]/dis[2];
+    disNorm[1] = dis[1]/dis[2];
+
+    UnDis(disNorm,unDisNorm);
+
+    unDis[0] = unDisNorm[0];
+    unDis[1] = unDisNorm[1];
+    unDis[2] = 1.0;
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::cam::UnDisMap";}
+
+
+ private:
+  Radial rad;
+  real64 invStep;
+  ds::Array<real64> scale; // Undistorted radius over distorted radius, for a distorted radius of index*step.
+};
+
 //------------------------------------------------------------------------------
 /// Given an intrinsic matrix and (optionally) radial parameters this calculates
 /// its 35mm equivalent focal length using the horizontal.
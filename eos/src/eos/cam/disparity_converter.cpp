@@ -18,12 +18,240 @@
 #include "eos/cam/disparity_converter.h"
 
 #include "eos/cam/triangulation.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace eos
 {
  namespace cam
  {
 //------------------------------------------------------------------------------
+// The generalised cross product of three 4-vectors, i.e. the vector orthogonal
+// to all three, as the cofactors of the 3x4 matrix they make...
+inline void Cross4(const real64 * a,const real64 * b,const real64 * c,real64 * out)
+{
+ real64 s01 = b[0]*c[1] - b[1]*c[0];
+ real64 s02 = b[0]*c[2] - b[2]*c[0];
+ real64 s03 = b[0]*c[3] - b[3]*c[0];
+ real64 s12 = b[1]*c[2] - b[2]*c[1];
+ real64 s13 = b[1]*c[3] - b[3]*c[1];
+ real64 s23 = b[2]*c[3] - b[3]*c[2];
+
+ out[0] =   a[1]*s23 - a[2]*s13 + a[3]*s12;
+ out[1] = -(a[0]*s23 - a[2]*s03 + a[3]*s02);
+ out[2] =   a[0]*s13 - a[1]*s03 + a[3]*s01;
+ out[3] = -(a[0]*s12 - a[1]*s02 + a[2]*s01);
+}
+
+// Evaluates the bilinear function given by coefficients for uv, u, v and 1,
+// for n of 2 or 4 outputs...
+#ifdef __SSE2__
+inline void Bilinear2(const real64 k[4][2],real64 u,real64 v,real64 * out)
+{
+ __m128d r = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(u*v),_mm_loadu_pd(k[0])),
+                                   _mm_mul_pd(_mm_set1_pd(u),_mm_loadu_pd(k[1]))),
+                        _mm_add_pd(_mm_mul_pd(_mm_set1_pd(v),_mm_loadu_pd(k[2])),
+                                   _mm_loadu_pd(k[3])));
+ _mm_storeu_pd(out,r);
+}
+
+inline void Bilinear4(const real64 k[4][4],real64 u,real64 v,real64 * out)
+{
+ __m128d uv = _mm_set1_pd(u*v);
+ __m128d uu = _mm_set1_pd(u);
+ __m128d vv = _mm_set1_pd(v);
+ for (nat32 i=0;i<4;i+=2)
+ {
+  __m128d r = _mm_add_pd(_mm_add_pd(_mm_mul_pd(uv,_mm_loadu_pd(k[0]+i)),
+                                    _mm_mul_pd(uu,_mm_loadu_pd(k[1]+i))),
+                         _mm_add_pd(_mm_mul_pd(vv,_mm_loadu_pd(k[2]+i)),
+                                    _mm_loadu_pd(k[3]+i)));
+  _mm_storeu_pd(out+i,r);
+ }
+}
+#else
+inline void Bilinear2(const real64 k[4][2],real64 u,real64 v,real64 * out)
+{
+ real64 uv = u*v;
+ for (nat32 i=0;i<2;i++) out[i] = uv*k[0][i] + u*k[1][i] + v*k[2][i] + k[3][i];
+}
+
+inline void Bilinear4(const real64 k[4][4],real64 u,real64 v,real64 * out)
+{
+ real64 uv = u*v;
+ for (nat32 i=0;i<4;i++) out[i] = uv*k[0][i] + u*k[1][i] + v*k[2][i] + k[3][i];
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Setup with the outputs wanted, any combination, then Run. With the rectified
+// cameras L and R a pixel at rectified (u,w) with match (v,w) gives the
+// constraints (uL_3 - L_1)X = 0 and (vR_3 - R_1)X = 0 for the x coordinates,
+// plus the y constraints, which for a rectified pair are the same plane and
+// only depend on w. X is hence the generalised cross product of the three,
+// which is bilinear in u and v, so a rows coefficients are calculated up front.
+class DispConvPlane::ConvertRows
+{
+ public:
+  ConvertRows(const DispConvPlane & self,const svt::Field<real32> & d)
+  :depth(null<svt::Field<real32>*>()),pos(null<svt::Field<bs::Vertex>*>()),
+  vert(null<svt::Field<bs::Vert>*>()),valid(null<svt::Field<bit>*>()),
+  disp(d),mask(self.leftMask)
+  {
+   // Scaling from the disparity map to the images...
+    scaleX = self.pair.leftDim[0]/real64(disp.Size(0));
+    scaleY = self.pair.leftDim[1]/real64(disp.Size(1));
+
+   // Rectified cameras...
+    math::Mat<3,3,real64> temp;
+    math::Mat<3,3,real64> rect;
+
+    rect = self.pair.unRectLeft;
+    math::Inverse(rect,temp);
+    math::Mult(rect,self.pair.lp,left);
+
+    rect = self.pair.unRectRight;
+    math::Inverse(rect,temp);
+    math::Mult(rect,self.pair.rp,right);
+
+   // Depth is the third row of the left camera adjusted for handedness and
+   // scale, as for cam::Depth...
+    math::Mat<3,3,real64> m;
+    math::SubSet(m,self.pair.lp,0,0);
+    real64 mult = math::Sign(math::Determinant(m))/math::Length3(m[2][0],m[2][1],m[2][2]);
+    for (nat32 i=0;i<4;i++) toDepth[i] = mult*self.pair.lp[2][i];
+
+   // Where masked positions go...
+    self.pair.lp.Centre(centre);
+  }
+
+  void Run()
+  {
+   nat32 grain = math::Max(nat32(1),nat32(4096/math::Max(disp.Size(0),nat32(1))));
+   mt::ParallelFor(nat32(0),disp.Size(1),*this,grain);
+  }
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    // The y constraints, normalised and averaged in case the rectification
+    // is not perfect...
+     real64 w = scaleY*real64(y);
+     real64 yl[4];
+     real64 yr[4];
+     real64 lenL = 0.0;
+     real64 lenR = 0.0;
+     real64 dot = 0.0;
+     for (nat32 i=0;i<4;i++)
+     {
+      yl[i] = w*left[2][i] - left[1][i];
+      yr[i] = w*right[2][i] - right[1][i];
+      lenL += math::Sqr(yl[i]);
+      lenR += math::Sqr(yr[i]);
+      dot += yl[i]*yr[i];
+     }
+     lenL = math::InvSqrt(lenL);
+     lenR = math::InvSqrt(lenR);
+     if (dot<0.0) lenR = -lenR;
+
+     real64 yc[4];
+     for (nat32 i=0;i<4;i++) yc[i] = yl[i]*lenL + yr[i]*lenR;
+
+    // The coefficients of the homogenous position and of the depth numerator
+    // and denominator...
+     real64 k[4][4];
+     Cross4(left[2],yc,right[2],k[0]);
+     Cross4(left[2],yc,right[0],k[1]);
+     Cross4(left[0],yc,right[2],k[2]);
+     Cross4(left[0],yc,right[0],k[3]);
+     for (nat32 i=0;i<4;i++)
+     {
+      k[1][i] = -k[1][i];
+      k[2][i] = -k[2][i];
+     }
+
+     real64 kd[4][2];
+     for (nat32 j=0;j<4;j++)
+     {
+      kd[j][0] = toDepth[0]*k[j][0] + toDepth[1]*k[j][1] + toDepth[2]*k[j][2] + toDepth[3]*k[j][3];
+      kd[j][1] = k[j][3];
+     }
+
+    // Do the pixels...
+     for (nat32 x=0;x<disp.Size(0);x++)
+     {
+      if (mask.Valid()&&(!mask.Get(x,y)))
+      {
+       if (depth) depth->Get(x,y) = 0.0;
+       if (pos) pos->Get(x,y) = centre;
+       if (vert) vert->Get(x,y) = bs::Vert(0.0,0.0,0.0);
+       if (valid) valid->Get(x,y) = false;
+       continue;
+      }
+
+      real64 u = scaleX*real64(x);
+      real64 v = scaleX*(real64(x) + real64(disp.Get(x,y)));
+
+      if (depth)
+      {
+       real64 nd[2];
+       Bilinear2(kd,u,v,nd);
+       if (!math::IsZero(nd[1])) depth->Get(x,y) = real32(nd[0]/nd[1]);
+                  else depth->Get(x,y) = math::Infinity<real32>();
+      }
+
+      if (pos||vert)
+      {
+       real64 p[4];
+       Bilinear4(k,u,v,p);
+
+       real64 len = math::Sqr(p[0]) + math::Sqr(p[1]) + math::Sqr(p[2]) + math::Sqr(p[3]);
+       bit ok = len>0.0;
+       if (ok)
+       {
+        len = math::InvSqrt(len);
+        if (p[3]<0.0) len = -len;
+        for (nat32 i=0;i<4;i++) p[i] *= len;
+       }
+
+       if (pos)
+       {
+        if (ok) pos->Get(x,y) = bs::Vertex(p[0],p[1],p[2],p[3]);
+           else pos->Get(x,y) = bs::Vertex(0.0,0.0,-1.0,0.0);
+       }
+
+       if (vert)
+       {
+        ok = ok && (!math::IsZero(p[3]));
+        if (ok) vert->Get(x,y) = bs::Vert(p[0]/p[3],p[1]/p[3],p[2]/p[3]);
+           else vert->Get(x,y) = bs::Vert(0.0,0.0,0.0);
+        valid->Get(x,y) = ok;
+       }
+      }
+     }
+   }
+  }
+
+  svt::Field<real32> * depth;
+  svt::Field<bs::Vertex> * pos;
+  svt::Field<bs::Vert> * vert;
+  svt::Field<bit> * valid; // Goes with vert.
+
+ private:
+  const svt::Field<real32> & disp;
+  const svt::Field<bit> & mask;
+
+  real64 scaleX;
+  real64 scaleY;
+  math::Mat<3,4,real64> left;
+  math::Mat<3,4,real64> right;
+  real64 toDepth[4];
+  math::Vect<4,real64> centre;
+};
 
 //------------------------------------------------------------------------------
 DispConvPlane::DispConvPlane()
@@ -190,82 +418,20 @@ void DispConvPlane::Ray(real32 x,real32 y,bs::Vertex & start,bs::Vertex & offset
 
 void DispConvPlane::Convert(svt::Field<real32> & disp,svt::Field<real32> & depth) const
 {
- for (nat32 y=0;y<disp.Size(1);y++)
- {
-  for (nat32 x=0;x<disp.Size(0);x++)
-  {
-   if ((!leftMask.Valid())||(leftMask.Get(x,y)))
-   {
-    // Get rectified image coordinates...
-     math::Vect<3,real64> rlp;
-      rlp[0] = x; rlp[1] = y; rlp[2] = 1.0;
-     math::Vect<3,real64> rrp = rlp;
-      rrp[0] += disp.Get(x,y);
-     
-    // Convert to true image coordinates...
-     math::Vect<3,real64> tlp;
-      math::MultVect(pair.unRectLeft,rlp,tlp);
-     math::Vect<3,real64> trp;
-      math::MultVect(pair.unRectLeft,rrp,trp);
-    
-    // Make non-homogenous...
-     math::Vect<2,real64> lp;
-      tlp /= tlp[2]; lp[0] = tlp[0]; lp[1] = tlp[1];
-     math::Vect<2,real64> rp;
-      trp /= trp[2]; rp[0] = trp[0]; rp[1] = trp[1];
-    
-    // Calculate depth...
-     real64 o;
-     if (Depth(lp,rp,pair.lp,pair.rp,o)) depth.Get(x,y) = real32(o);
-                                    else depth.Get(x,y) = math::Infinity<real32>();
-   }
-   else
-   {
-    depth.Get(x,y) = 0.0;
-   }
-  }
- }
+ LogTime("eos::cam::DispConvPlane::Convert");
+
+ ConvertRows cr(*this,disp);
+ cr.depth = &depth;
+ cr.Run();
 }
 
 void DispConvPlane::Convert(svt::Field<real32> & disp,svt::Field<bs::Vertex> & pos) const
 {
- for (nat32 y=0;y<disp.Size(1);y++)
- {
-  for (nat32 x=0;x<disp.Size(0);x++)
-  {
-   if ((!leftMask.Valid())||(leftMask.Get(x,y)))
-   {
-    // Get rectified image coordinates...
-     math::Vect<3,real64> rlp;
-      rlp[0] = x; rlp[1] = y; rlp[2] = 1.0;
-     math::Vect<3,real64> rrp = rlp;
-      rrp[0] += disp.Get(x,y);
-     
-    // Convert to true image coordinates...
-     math::Vect<3,real64> tlp;
-      math::MultVect(pair.unRectLeft,rlp,tlp);
-     math::Vect<3,real64> trp;
-      math::MultVect(pair.unRectLeft,rrp,trp);
-    
-    // Make non-homogenous...
-     math::Vect<2,real64> lp;
-      tlp /= tlp[2]; lp[0] = tlp[0]; lp[1] = tlp[1];
-     math::Vect<2,real64> rp;
-      trp /= trp[2]; rp[0] = trp[0]; rp[1] = trp[1];
-    
-    // Calculate position...
-     math::Vect<4,real64> v;
-     if (Triangulate(lp,rp,pair.lp,pair.rp,v)==false) pos.Get(x,y) = bs::Vertex(0.0,0.0,-1.0,0.0);
-                                                 else pos.Get(x,y) = v;
-   }
-   else
-   {
-    math::Vect<4,real64> v;
-    pair.lp.Centre(v);
-    pos.Get(x,y) = v;
-   }
-  }
- }
+ LogTime("eos::cam::DispConvPlane::Convert");
+
+ ConvertRows cr(*this,disp);
+ cr.pos = &pos;
+ cr.Run();
 }
 
 void DispConvPlane::Convert(svt::Field<real32> & disp,svt::Field<bs::Normal> & needle) const
@@ -280,40 +446,36 @@ void DispConvPlane::Convert(svt::Field<real32> & disp,svt::Field<bs::Normal> & n
    toCam[2] = -rot[2][2];
   //LogDebug("toCam" << LogDiv() << toCam);
 
- // Iterate it all, bar the borders...
+ // Triangulate the lot in one go...
+  bs::Vert vertIni(0.0,0.0,0.0);
+  bit validIni = false;
+  svt::Var temp(disp);
+   temp.Add("pos",vertIni);
+   temp.Add("valid",validIni);
+  temp.Commit(false);
+  svt::Field<bs::Vert> pos(&temp,"pos");
+  svt::Field<bit> valid(&temp,"valid");
+
+  Convert(disp,pos,valid);
+
+ // Iterate it all, bar the borders, using the 4 neighbours rather than the
+ // output location...
   for (nat32 y=1;y<disp.Size(1)-1;y++)
   {
    for (nat32 x=1;x<disp.Size(0)-1;x++)
    {
-    // Check the 4 neighbours for being valid, rather than the output location...
-     if ((!leftMask.Valid())||
-         (leftMask.Get(x-1,y)&&leftMask.Get(x+1,y)&&leftMask.Get(x,y-1)&&leftMask.Get(x,y+1)))
-     {
-      bs::Vert v[4];
-      bit ok = true;
-       ok &= CalcPos(x-1,y,disp.Get(x-1,y),disp.Size(0),disp.Size(1),v[0]);
-       ok &= CalcPos(x+1,y,disp.Get(x+1,y),disp.Size(0),disp.Size(1),v[1]);
-       ok &= CalcPos(x,y-1,disp.Get(x,y-1),disp.Size(0),disp.Size(1),v[2]);
-       ok &= CalcPos(x,y+1,disp.Get(x,y+1),disp.Size(0),disp.Size(1),v[3]);
-      
-      if (ok)
-      {
-       v[1] -= v[0];
-       v[3] -= v[2];
-      
-       math::CrossProduct(v[1],v[3],needle.Get(x,y));
-       needle.Get(x,y).Normalise();
-      //LogDebug("{x,y,norm}" << LogDiv() << x << LogDiv() << y << LogDiv() << needle.Get(x,y));
-      }
-      else
-      {
-       needle.Get(x,y) = toCam;
-      }
-     }
-     else
-     {
-      needle.Get(x,y) = toCam;
-     }
+    if (valid.Get(x-1,y)&&valid.Get(x+1,y)&&valid.Get(x,y-1)&&valid.Get(x,y+1))
+    {
+     bs::Vert dx = pos.Get(x+1,y); dx -= pos.Get(x-1,y);
+     bs::Vert dy = pos.Get(x,y+1); dy -= pos.Get(x,y-1);
+
+     math::CrossProduct(dx,dy,needle.Get(x,y));
+     needle.Get(x,y).Normalise();
+    }
+    else
+    {
+     needle.Get(x,y) = toCam;
+    }
    }
   }
   
@@ -338,51 +500,19 @@ void DispConvPlane::Convert(svt::Field<real32> & disp,svt::Field<bs::Normal> & n
    }
 }
 
-cstrconst DispConvPlane::TypeString() const
+void DispConvPlane::Convert(svt::Field<real32> & disp,svt::Field<bs::Vert> & pos,svt::Field<bit> & valid) const
 {
- return "eos::cam::DispConvPlane";
+ LogTime("eos::cam::DispConvPlane::Convert");
+
+ ConvertRows cr(*this,disp);
+ cr.vert = &pos;
+ cr.valid = &valid;
+ cr.Run();
 }
 
-bit DispConvPlane::CalcPos(nat32 x,nat32 y,real32 disp,nat32 width,nat32 height,bs::Vert & out) const
+cstrconst DispConvPlane::TypeString() const
 {
- // Get rectified image coordinates...
-  math::Vect<3,real64> rlp;
-   rlp[0] = x; rlp[1] = y; rlp[2] = 1.0;
-  math::Vect<3,real64> rrp = rlp;
-   rrp[0] += disp;
-
- // Adjust for scale...
-  real64 mult[2];
-   mult[0] = pair.leftDim[0]/real64(width);
-   mult[1] = pair.leftDim[1]/real64(height);
-  
-  rlp[0] *= mult[0];
-  rlp[1] *= mult[1];
-  rrp[0] *= mult[0]; // We assume the same scaling was applied to both left and right images, certainly has to be true in y.
-  rrp[1] *= mult[1];
-
- // Convert to true image coordinates...
-  math::Vect<3,real64> tlp;
-   math::MultVect(pair.unRectLeft,rlp,tlp);
-  math::Vect<3,real64> trp;
-   math::MultVect(pair.unRectRight,rrp,trp);
-    
- // Make non-homogenous...
-  math::Vect<2,real64> lp;
-   tlp /= tlp[2]; lp[0] = tlp[0]; lp[1] = tlp[1];
-  math::Vect<2,real64> rp;
-   trp /= trp[2]; rp[0] = trp[0]; rp[1] = trp[1];
-    
- // Calculate depth...
-  math::Vect<4,real64> pos;
-  if (Triangulate(lp,rp,pair.lp,pair.rp,pos)==false) return false;
-  if (math::Equal(pos[3],0.0)) return false;
-
-  pos /= pos[3];
-  out[0] = pos[0];
-  out[1] = pos[1];
-  out[2] = pos[2];    
-  return true;
+ return "eos::cam::DispConvPlane";
 }
 
 //------------------------------------------------------------------------------
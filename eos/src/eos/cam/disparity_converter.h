@@ -96,6 +96,13 @@ class EOS_CLASS DispConv : public Deletable
 /// It is given a CameraPair for which this is the left image.
 /// This camera pair should include the un-rectification matrices.
 /// Can also be given a mask to indicate which areas are game for calculation.
+/// The whole map Convert methods make use of the homogenous position being a
+/// bilinear function of the left and right rectified x coordinates along any
+/// given scanline, so after a little work per row each pixel costs a handful of
+/// multiplies rather than a null space, with the rows split between the threads
+/// of the task pool. For perfectly rectified input this is identical to 
+/// Triangulate, otherwise the two y constraints are averaged.
+/// If the disparity map is not the size given to Set it is scaled to match.
 class EOS_CLASS DispConvPlane : public DispConv
 {
  public:
@@ -149,6 +156,11 @@ class EOS_CLASS DispConvPlane : public DispConv
  /// &nbsp;
   void Convert(svt::Field<real32> & disp,svt::Field<bs::Normal> & needle) const;
 
+ /// Outputs non-homogenous positions, with valid set to false where the mask
+ /// excludes a pixel or its point is at infinity, the position then being left
+ /// at the origin. Saves the divides when homogenous output is not wanted.
+  void Convert(svt::Field<real32> & disp,svt::Field<bs::Vert> & pos,svt::Field<bit> & valid) const;
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -160,10 +172,8 @@ class EOS_CLASS DispConvPlane : public DispConv
   svt::Field<bit> rightMask;
   
  // Helper stuff...
-  // Calculates the non-homogenous position of the given disparity/coordinate,
-  // returns false if the point is at infinity or the calculation fails.
-  // Used for the normal field calculation.
-   bit CalcPos(nat32 x,nat32 y,real32 disp,nat32 width,nat32 height,bs::Vert & out) const;
+  // Does the work of the whole map Convert methods, a row at a time...
+   class ConvertRows;
    
  // Cached data, for acceleration purposes...
   mutable bit rectValid; // true if the below are the inverses of the unrectification matrices.
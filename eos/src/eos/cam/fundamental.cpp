@@ -22,6 +22,7 @@
 #include "eos/data/randoms.h"
 #include "eos/file/csv.h"
 #include "eos/mem/safety.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -380,8 +381,107 @@ real64 ManyPointFun(nat32 matchSize,FunMatch ** match,Fundamental & fun,real64 t
  return residual;
 }
 
+//------------------------------------------------------------------------------
+class FunCalc::Hypothesise
+{
+ public:
+  Hypothesise(const ds::Array<FunMatch*> & p,FunMatch ** r,nat32 rc,const ds::Array<real64> & g,
+              nat32 pre,real64 t,nat64 s,nat32 f,nat32 b,Fundamental * o,nat32 * c)
+  :pts(p),rel(r),relCount(rc),growth(g),preemptive(pre),tol(t),seed(s),first(f),beat(b),out(o),count(c)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   const nat32 m = 7 - relCount;
+   const nat32 n = pts.Size();
+
+   for (nat32 h=b0;h<b1;h++)
+   {
+    count[h] = 0;
+    data::RandomStream rand(seed,first+h); // Stream per hypothesis, so threads don't matter.
+
+    // Find the size of the pool to sample from - all of them unless guided...
+     nat32 pool = n;
+     if (growth.Size()!=0)
+     {
+      real64 t = real64(first+h+1);
+      if (t<=growth[growth.Size()-1])
+      {
+       nat32 low = 0;
+       nat32 high = growth.Size()-1;
+       while (low<high)
+       {
+        nat32 mid = (low+high)/2;
+        if (growth[mid]<t) low = mid+1;
+                      else high = mid;
+       }
+       pool = m + low;
+      }
+     }
+
+    // Select the sample, without duplication. Whilst the pool is growing the
+    // newest member of it is allways used, as PROSAC does...
+     FunMatch * smp[7];
+     nat32 ind[7];
+     for (nat32 i=0;i<relCount;i++) smp[i] = rel[i];
+
+     nat32 k = 0;
+     nat32 range = pool;
+     if (pool<n) {ind[k++] = pool-1; range = pool-1;}
+     while (k<m)
+     {
+      nat32 r = nat32(rand.Int(0,int32(range)-1));
+      bit dup = false;
+      for (nat32 i=0;i<k;i++) {if (ind[i]==r) {dup = true; break;}}
+      if (!dup) ind[k++] = r;
+     }
+     for (nat32 i=0;i<m;i++) smp[relCount+i] = pts[ind[i]];
+
+    // Calculate the hypothesis...
+     Fundamental & fun = out[h];
+     if (SevenPointFun(smp,fun)==false) continue;
+
+    // The T(d,d) test, reject it if any of a few random matches are outliers...
+     bit pass = true;
+     for (nat32 i=0;i<preemptive;i++)
+     {
+      if (pts[rand.Int(0,int32(n)-1)]->Dist(fun)>=tol) {pass = false; break;}
+     }
+     if (!pass) continue;
+
+    // Count how many matches are within tolerance, giving up once it can't
+    // beat the best from previous batches...
+     nat32 inliers = 0;
+     for (nat32 i=0;i<n;i++)
+     {
+      if (pts[i]->Dist(fun)<tol) ++inliers;
+      else
+      {
+       if (inliers+(n-1-i)<=beat) break;
+      }
+     }
+     count[h] = inliers;
+   }
+  }
+
+
+ private:
+  const ds::Array<FunMatch*> & pts;
+  FunMatch ** rel;
+  nat32 relCount;
+  const ds::Array<real64> & growth;
+  nat32 preemptive;
+  real64 tol;
+  nat64 seed;
+  nat32 first;
+  nat32 beat;
+  Fundamental * out;
+  nat32 * count;
+};
+
 //------------------------------------------------------------------------------
 FunCalc::FunCalc()
+:preemptive(0),hypotheses(0)
 {
  math::Identity(fun);
  residual = -1.0;
@@ -390,7 +490,7 @@ FunCalc::FunCalc()
 FunCalc::~FunCalc()
 {}
 
-nat32 FunCalc::AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable)
+nat32 FunCalc::AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable,real64 quality)
 {
  Match match;
   match.left[0] = left[0];
@@ -398,12 +498,13 @@ nat32 FunCalc::AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable)
   match.right[0] = right[0];
   match.right[1] = right[1];
   match.reliable = reliable;
+  match.quality = quality;
  nat32 ret = data.Size();
  data.AddBack(match);
  return ret;
 }
 
-nat32 FunCalc::AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,real64> & right,bit reliable)
+nat32 FunCalc::AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,real64> & right,bit reliable,real64 quality)
 {
  Match match;
   match.left[0] = left[0];
@@ -411,6 +512,7 @@ nat32 FunCalc::AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,rea
   match.right[0] = right[0];
   match.right[1] = right[1];
   match.reliable = reliable;
+  match.quality = quality;
  nat32 ret = data.Size();
  data.AddBack(match);
  return ret;
@@ -530,81 +632,100 @@ bit FunCalc::Run(time::Progress * prog,real64 reliability,nat32 cap)
  // otherwise the next step will cope...
   prog->Report(1,4);
   prog->Push();
+  hypotheses = 0;
   if (rCount<7)
   {
    // Ransac...
-    // Create an array of matches, so we can select points efficiently,
-    // fill in the relible matches into our sampling array...
+    // Seperate out the reliable matches, which go in every sample, and sort
+    // the others by quality, so the best can be sampled first...
      prog->Report(0,2);
-     nat32 rCount = 0;
-     FunMatch * smp[7];
+     FunMatch * rel[7];
+     nat32 relCount = 0;
+     ds::Array<Ranked> ranked(data.Size()-rCount);
+     bit guided = false;
      targ = data.FrontPtr();
      for (nat32 i=0,j=0;i<data.Size();i++)
      {
-      if (targ->reliable)
-      {
-       smp[rCount] = &(targ->norm);
-       ++rCount;
-      }
+      if (targ->reliable) rel[relCount++] = &(targ->norm);
       else
       {
-       fmp[j] = &(targ->norm);
+       ranked[j].quality = targ->quality;
+       ranked[j].match = &(targ->norm);
+       if (!math::Equal(ranked[j].quality,ranked[0].quality)) guided = true;
        ++j;
       }
       ++targ;
      }
-     for (nat32 i=0;i<rCount;i++)
+     if (guided) ranked.SortNorm();
+
+     ds::Array<FunMatch*> pts(ranked.Size());
+     for (nat32 i=0;i<pts.Size();i++) pts[i] = ranked[i].match;
+
+
+    // For guided sampling calculate the PROSAC growth function, which gives
+    // how many hypotheses are drawn before each increase in the size of the
+    // pool of top matches being sampled from, such that it reaches them all
+    // when cap hypotheses have been tried...
+     const nat32 m = 7 - relCount;
+     const nat32 n = pts.Size();
+     ds::Array<real64> growth;
+     if (guided)
      {
-      fmp[data.Size()-1-i] = smp[i];
+      growth.Size(n-m+1);
+      real64 tn = real64(cap);
+      for (nat32 i=0;i<m;i++) tn *= real64(m-i)/real64(n-i);
+      growth[0] = 1.0;
+      for (nat32 i=1;i<growth.Size();i++)
+      {
+       real64 tn1 = tn * real64(m+i)/real64(i);
+       growth[i] = growth[i-1] + math::RoundUp(tn1-tn);
+       tn = tn1;
+      }
      }
 
 
-    // Now iterate trying random sets of matches, till we reach conditions
-    // that mean its time to stop this monkey business...
+    // Now iterate trying batches of random sets of matches, till we reach
+    // conditions that mean its time to stop this monkey business...
      prog->Report(1,2);
      prog->Push();
      data::Random rand;
-     nat32 mostInliers = 1;
-     for (nat32 i=0;i<cap;i++)
-     {
-      // Fill in remaining match array with randomly selected matches...
-      // (Without duplication.)
-       for (nat32 j=rCount;j<7;j++)
-       {
-        nat32 ri = rand.Int(0,data.Size()-j-1);
-        smp[j] = fmp[ri];
-        math::Swap(fmp[ri],fmp[data.Size()-j-1]);
-       }
+     nat64 seed = nat32(rand.Int(0,0x7fffffff));
 
-      // Calculate the result...
-       Fundamental funTemp;
-       if (SevenPointFun(smp,funTemp)==false) continue;
+     const nat32 batch = 8*mt::DefaultPool().Concurrency();
+     ds::Array<Fundamental> funBatch(batch);
+     ds::Array<nat32> inliers(batch);
 
-      // Count how many matches are within tolerance...
-       nat32 inlierCount = 0;
-       for (nat32 j=0;j<data.Size();j++)
-       {
-        if (fmp[j]->Dist(funTemp)<adjTol) ++inlierCount;
-       }
-
-      // If best so far, store it...
-       if (inlierCount>mostInliers)
+     nat32 mostInliers = 0;
+     while (hypotheses<cap)
+     {
+      nat32 size = math::Min(batch,cap-hypotheses);
+      Hypothesise hyp(pts,rel,relCount,growth,preemptive,adjTol,seed,hypotheses,mostInliers,
+                      funBatch.Ptr(),inliers.Ptr());
+      mt::ParallelFor(nat32(0),size,hyp);
+      hypotheses += size;
+
+      // Keep the best, in order so the result does not depend on the threads...
+       for (nat32 i=0;i<size;i++)
        {
-	mostInliers = inlierCount;
-	fun = funTemp;
+        if (inliers[i]>mostInliers)
+        {
+         mostInliers = inliers[i];
+         fun = funBatch[i];
+        }
        }
 
-      // Check if we can break due to having done enough samples...
-       real64 sr = math::Ln(1.0-reliability)/math::Ln(1.0-math::Pow(real64(mostInliers)/real64(data.Size()),7.0));
+      // Check if we can break due to having done enough samples, noting that
+      // a good sample also has to survive the T(d,d) test...
+       real64 sr = math::Ln(1.0-reliability)/math::Ln(1.0-math::Pow(real64(mostInliers)/real64(n),real64(m+preemptive)));
        if (math::IsFinite(sr))
        {
-	if (sr<=real64(i)) break;
-	prog->Report(i,nat32(sr));
+        if (sr<=real64(hypotheses)) break;
+        prog->Report(hypotheses,nat32(math::Min(sr,real64(cap))));
        }
      }
      prog->Pop();
 
-     LogDebug("[fun.calculate] RANSAC result {fun,mostInliers}" << LogDiv() << fun << LogDiv() << mostInliers);
+     LogDebug("[fun.calculate] RANSAC result {fun,mostInliers,hypotheses}" << LogDiv() << fun << LogDiv() << mostInliers << LogDiv() << hypotheses);
   }
   prog->Pop();
 
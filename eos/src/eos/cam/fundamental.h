@@ -114,6 +114,14 @@ bit ManyPointMirth(nat32 matchSize,FunMatch ** match,Fundamental & out);
 /// it can latter be ignored if it is found to not be good enough.)
 /// Uses the most advanced techneques avaliable: ransac with the 7 point
 /// algorithm and refinement using LM assumping Gaussian noise on input matches.
+///
+/// The ransac generates and scores its hypotheses in parallel batches on the
+/// task pool, stopping as soon as the inlier ratio found so far says enough
+/// have been tried. If the matches are given qualities it samples the best
+/// matches first, as PROSAC does, which finds a good hypothesis far sooner
+/// when the qualities mean something. Optionally each hypothesis is checked
+/// against a few random matches before being scored against them all, the
+/// T(d,d) test, so bad ones are thrown away cheaply.
 class EOS_CLASS FunCalc
 {
  public:
@@ -128,17 +136,19 @@ class EOS_CLASS FunCalc
   /// \param left Coordinate in the left view.
   /// \param right Coordinate in te right view.
   /// \param reliable True if it should presume the pair to definatly be correct, false if it might be wrong.
+  /// \param quality How good the match is thought to be, higher is better, e.g. the negative of the feature distance. Only the order matters. If they are all the same, as they are by default, sampling is uniform.
   /// \returns The index of the point, acts like a growing array so it will be one
   ///          greater than the last point entered/equal to the current point count.
-   nat32 AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable = false);
+   nat32 AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable = false,real64 quality = 0.0);
 
   /// Adds a matching point pair, returns its index.
   /// \param left Coordinate in the left view.
   /// \param right Coordinate in te right view.
   /// \param reliable True if it should presume the pair to definatly be correct, false if it might be wrong.
+  /// \param quality How good the match is thought to be, higher is better, e.g. the negative of the feature distance. Only the order matters. If they are all the same, as they are by default, sampling is uniform.
   /// \returns The index of the point, acts like a growing array so it will be one
   ///          greater than the last point entered/equal to the current point count.
-   nat32 AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,real64> & right,bit reliable = false);
+   nat32 AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,real64> & right,bit reliable = false,real64 quality = 0.0);
 
   /// Returns how many matches are contained within.
    nat32 Matches() const;
@@ -155,6 +165,19 @@ class EOS_CLASS FunCalc
   /// maximum number of ransac runs to try before giving up and declaring failure.
    bit Run(time::Progress * prog = null<time::Progress*>(),real64 reliability = 0.99,nat32 cap = 10000);
 
+  /// Sets d for the T(d,d) test, the number of random matches a ransac
+  /// hypothesis must fit before it is scored against all of them. Defaults to
+  /// 0, which is off. Worth switching on, with a d of 1, when there are a lot
+  /// of matches, as scoring then dominates, but even a good hypothesis only
+  /// survives with a probability of the inlier ratio to the power d, so more
+  /// of them are needed - the stopping rule accounts for this, but the cap
+  /// given to Run should be raised to match.
+   void SetPreemptive(nat32 d) {preemptive = d;}
+
+  /// Returns how many ransac hypotheses the last Run tried, 0 if it had enough
+  /// reliable matches to not need ransac.
+   nat32 Hypotheses() const {return hypotheses;}
+
 
   /// After Run returns true you can extract the fundamental matrix using this.
   /// It will go from the left view to the right view, you can reverse this by
@@ -191,15 +214,29 @@ class EOS_CLASS FunCalc
   {
    bit reliable; // True if the match is to be assumed correct, false if not.
    bit used; // True if the match was used, false if it wasn't.
+   real64 quality; // For guided sampling.
    FunMatch norm; // Normalised version of the match, used during the calculation.
   };
 
+  struct Ranked
+  {
+   bit operator < (const Ranked & rhs) const {return quality > rhs.quality;} // Reversed, so the best come first.
+
+   real64 quality;
+   FunMatch * match;
+  };
+
   ds::List<Match> data;
+  nat32 preemptive;
+  nat32 hypotheses;
 
   Fundamental fun;
   real64 residual;
   real64 meanError;
   nat32 usedCount;
+
+  // Functor for the task pool, generates and scores a batch of hypotheses...
+   class Hypothesise;
 };
 
 //------------------------------------------------------------------------------
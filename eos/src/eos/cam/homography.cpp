@@ -18,6 +18,7 @@
 #include "eos/cam/homography.h"
 
 #include "eos/math/iter_min.h"
+#include "eos/data/randoms.h"
 
 namespace eos
 {
@@ -25,6 +26,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 Homography2D::Homography2D()
+:tolerance(-1.0),confidence(0.99),maxIters(2000),inliers(0)
 {}
 
 Homography2D::~Homography2D()
@@ -33,6 +35,8 @@ Homography2D::~Homography2D()
 void Homography2D::Reset()
 {
  data.Reset();
+ inlier.Size(0);
+ inliers = 0;
 }
 
 void Homography2D::Add(const math::Vect<2,real32> & f,const math::Vect<2,real32> & s)
@@ -75,6 +79,18 @@ void Homography2D::Add(const math::Vect<3,real64> & f,const math::Vect<3,real64>
  data.AddBack(ne);	
 }
 
+void Homography2D::SetRobust(real64 tol,real64 conf,nat32 iters)
+{
+ tolerance = tol;
+ confidence = conf;
+ maxIters = iters;
+}
+
+void Homography2D::SetNonRobust()
+{
+ tolerance = -1.0;
+}
+
 real64 Homography2D::Result(math::Mat<3,3,real32> & out)
 {
  math::Mat<3,3,real64> temp;
@@ -89,6 +105,158 @@ real64 Homography2D::Result(math::Mat<3,3,real32> & out)
 real64 Homography2D::Result(math::Mat<3,3,real64> & out)
 {
  LogTime("eos::cam::Homography2D::Result");
+ inlier.Size(0);
+ inliers = data.Size();
+ if (tolerance<0.0) return Fit(data,out);
+
+ // Robust - find the inliers and fit to just them...
+  Ransac();
+  if (inliers==data.Size()) return Fit(data,out);
+
+  ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > sub;
+  ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > >::Cursor targ = data.FrontPtr();
+  for (nat32 i=0;!targ.Bad();i++,++targ)
+  {
+   if (inlier[i]) sub.AddBack(*targ);
+  }
+  return Fit(sub,out);
+}
+
+void Homography2D::Ransac()
+{
+ LogTime("eos::cam::Homography2D::Ransac");
+ const nat32 n = data.Size();
+ inlier.Size(n);
+ for (nat32 i=0;i<n;i++) inlier[i] = true;
+ inliers = n;
+ if (n<=4) return;
+
+ // Copy into an array for random access...
+  ds::Array< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > pts(n);
+  {
+   ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > >::Cursor targ = data.FrontPtr();
+   for (nat32 i=0;i<n;i++,++targ) pts[i] = *targ;
+  }
+
+ // Normalise, same as Fit, so the 4 point solutions are stable...
+  math::Vect<2,real64> fM(0.0);
+  math::Vect<2,real64> sM(0.0);
+  for (nat32 i=0;i<n;i++)
+  {
+   fM[0] += pts[i].first[0]; fM[1] += pts[i].first[1];
+   sM[0] += pts[i].second[0]; sM[1] += pts[i].second[1];
+  }
+  fM /= real64(n);
+  sM /= real64(n);
+
+  math::Vect<2,real64> fS(0.0);
+  math::Vect<2,real64> sS(0.0);
+  for (nat32 i=0;i<n;i++)
+  {
+   fS[0] += math::Abs(pts[i].first[0]-fM[0]); fS[1] += math::Abs(pts[i].first[1]-fM[1]);
+   sS[0] += math::Abs(pts[i].second[0]-sM[0]); sS[1] += math::Abs(pts[i].second[1]-sM[1]);
+  }
+  fS /= real64(n);
+  sS /= real64(n);
+  for (nat32 i=0;i<2;i++)
+  {
+   if (math::IsZero(fS[i])) fS[i] = 1.0;
+   if (math::IsZero(sS[i])) sS[i] = 1.0;
+  }
+
+
+ // The main loop, keeping the hypothesis with the most inliers and stopping
+ // once the chance of there being a better one is small enough...
+  data::Random rand;
+  ds::Array<bit> curr(n);
+  nat32 bestCount = 0;
+  const real64 tolSqr = math::Sqr(tolerance);
+  nat32 needed = maxIters;
+  for (nat32 iter=0;iter<needed;iter++)
+  {
+   // Select 4 different pairs...
+    nat32 ind[4];
+    for (nat32 i=0;i<4;i++)
+    {
+     bit again = true;
+     while (again)
+     {
+      ind[i] = rand.Int(0,n-1);
+      again = false;
+      for (nat32 j=0;j<i;j++) again |= ind[j]==ind[i];
+     }
+    }
+
+   // Solve for the homography they define, in normalised coordinates...
+    math::Mat<9,9,real64> mat;
+    math::Zero(mat);
+    for (nat32 i=0;i<4;i++)
+    {
+     real64 fx = (pts[ind[i]].first[0]-fM[0])/fS[0];
+     real64 fy = (pts[ind[i]].first[1]-fM[1])/fS[1];
+     real64 sx = (pts[ind[i]].second[0]-sM[0])/sS[0];
+     real64 sy = (pts[ind[i]].second[1]-sM[1])/sS[1];
+
+     mat[i*2][0] = fx; mat[i*2][1] = fy; mat[i*2][2] = 1.0;
+     mat[i*2][6] = -sx*fx; mat[i*2][7] = -sx*fy; mat[i*2][8] = -sx;
+
+     mat[i*2+1][3] = fx; mat[i*2+1][4] = fy; mat[i*2+1][5] = 1.0;
+     mat[i*2+1][6] = -sy*fx; mat[i*2+1][7] = -sy*fy; mat[i*2+1][8] = -sy;
+    }
+
+    math::Vect<9,real64> h;
+    RightNullSpace(mat,h);
+
+   // Count the inliers, transforming into normalised coordinates and back
+   // rather than making the un-normalised homography...
+    nat32 count = 0;
+    for (nat32 i=0;i<n;i++)
+    {
+     real64 fx = (pts[i].first[0]-fM[0])/fS[0];
+     real64 fy = (pts[i].first[1]-fM[1])/fS[1];
+     real64 tw = h[6]*fx + h[7]*fy + h[8];
+     curr[i] = false;
+     if (math::IsZero(tw)) continue;
+
+     real64 tx = (h[0]*fx + h[1]*fy + h[2])/tw;
+     real64 ty = (h[3]*fx + h[4]*fy + h[5])/tw;
+     real64 dx = tx*sS[0] + sM[0] - pts[i].second[0];
+     real64 dy = ty*sS[1] + sM[1] - pts[i].second[1];
+     if ((math::Sqr(dx) + math::Sqr(dy))<=tolSqr)
+     {
+      curr[i] = true;
+      ++count;
+     }
+    }
+
+   // Keep it if its the best, updating the stopping condition...
+    if (count>bestCount)
+    {
+     bestCount = count;
+     for (nat32 i=0;i<n;i++) inlier[i] = curr[i];
+
+     real64 w4 = math::Sqr(math::Sqr(real64(count)/real64(n)));
+     if (w4>=1.0) needed = iter+1;
+     else
+     {
+      real64 est = math::Ln(1.0-confidence)/math::Ln(1.0-w4);
+      if (est<real64(maxIters)) needed = math::Max(nat32(est)+1,iter+1);
+     }
+    }
+  }
+
+ // If nothing sensible was found fall back to using everything...
+  if (bestCount<4)
+  {
+   for (nat32 i=0;i<n;i++) inlier[i] = true;
+   bestCount = n;
+  }
+  inliers = bestCount;
+}
+
+real64 Homography2D::Fit(const ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > & data,
+                         math::Mat<3,3,real64> & out)
+{
 
  // First we need to get a good approximation to the answer using a standard 
  // least-squares techneque with the right null vector as the answer, calcualted
@@ -210,7 +378,7 @@ real64 Homography2D::Result(math::Mat<3,3,real64> & out)
    aV[3] = out[1][0]; aV[4] = out[1][1]; aV[5] = out[1][2];
    aV[6] = out[2][0]; aV[7] = out[2][1]; aV[8] = out[2][2];
    
-  real64 ret = LM(2*data.Size(),aV,*this,&LMfunc);
+  real64 ret = LM(2*data.Size(),aV,data,&LMfunc);
 
 
  // And one last bit of code to copy from the vector to the matrix...
@@ -221,10 +389,11 @@ real64 Homography2D::Result(math::Mat<3,3,real64> & out)
  return ret;
 }
 
-void Homography2D::LMfunc(const math::Vector<real64> & pv,math::Vector<real64> & err,const Homography2D & self)
+void Homography2D::LMfunc(const math::Vector<real64> & pv,math::Vector<real64> & err,
+                          const ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > & data)
 {
- ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > >::Cursor targ = self.data.FrontPtr();
- for (nat32 i=0;i<self.data.Size();i++)
+ ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > >::Cursor targ = data.FrontPtr();
+ for (nat32 i=0;i<data.Size();i++)
  {
   // Transform the first point by the given 'matrix' to get something that
   // should be equal to the second point...
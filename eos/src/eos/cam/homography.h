@@ -23,6 +23,7 @@
 
 #include "eos/types.h"
 #include "eos/ds/lists.h"
+#include "eos/ds/arrays.h"
 #include "eos/math/vectors.h"
 #include "eos/math/matrices.h"
 #include "eos/math/mat_ops.h"
@@ -41,6 +42,8 @@ namespace eos
 /// Uses SVD followed by LM to produce its answer. A slow implimentation, but
 /// should produce very good results - the sampson method.
 /// Includes normalisation.
+/// Can optionally be made robust, see SetRobust, in which case RANSAC is used
+/// to find the inliers before the above is applied to just them.
 class EOS_CLASS Homography2D
 {
  public:
@@ -67,6 +70,17 @@ class EOS_CLASS Homography2D
    void Add(const math::Vect<3,real64> & f,const math::Vect<3,real64> & s);
 
 
+  /// Switches on RANSAC, so Result can cope with outliers. tolerance is the
+  /// distance, in the coordinates of the second point, a pair can be from
+  /// the transformed first point and still count as an inlier. Hypotheses are
+  /// made from 4 random pairs till there is the given confidence of having
+  /// found the best, or maxIters is reached.
+   void SetRobust(real64 tolerance,real64 confidence = 0.99,nat32 maxIters = 2000);
+
+  /// Switches RANSAC back off, so all pairs are used. The default.
+   void SetNonRobust();
+
+
   /// Extracts the result, a matrix such that for each pair s = Mf, or at 
   /// least a best fit to this constraint. Note that before calling this Add
   /// must be called at least 4 times, more if there is degenerate data.
@@ -80,6 +94,14 @@ class EOS_CLASS Homography2D
    real64 Result(math::Mat<3,3,real64> & out);
 
 
+  /// Returns how many pairs the last Result used, all of them unless robust.
+   nat32 Inliers() const {return inliers;}
+
+  /// Returns true if the given pair, indexed by the order they were added in,
+  /// was used by the last Result.
+   bit Inlier(nat32 i) const {return (inlier.Size()==0)||inlier[i];}
+
+
   /// &nbsp;
    static inline cstrconst TypeString() {return "eos::cam::Homography2D";}
 
@@ -87,9 +109,26 @@ class EOS_CLASS Homography2D
  private:  
   // Linked list, used to store all the collected pairs.
    ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > data;
+
+  // RANSAC settings, tolerance is negative when its off...
+   real64 tolerance;
+   real64 confidence;
+   nat32 maxIters;
+
+  // Results of the last Result...
+   nat32 inliers;
+   ds::Array<bit> inlier; // Empty if they all were.
+
+  // Does the actual fitting, for a given set of pairs...
+   static real64 Fit(const ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > & pairs,
+                     math::Mat<3,3,real64> & out);
+
+  // Finds the inliers with RANSAC, filling in inlier and inliers...
+   void Ransac();
    
   // Error metric function for LM.
-   static void LMfunc(const math::Vector<real64> & pv,math::Vector<real64> & err,const Homography2D & self);
+   static void LMfunc(const math::Vector<real64> & pv,math::Vector<real64> & err,
+                      const ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > & pairs);
 };
 
 //------------------------------------------------------------------------------
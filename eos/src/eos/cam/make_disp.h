@@ -28,6 +28,7 @@
 #include "eos/ds/arrays2d.h"
 #include "eos/svt/field.h"
 #include "eos/cam/files.h"
+#include "eos/cam/cam_render.h"
 
 
 namespace eos
@@ -39,8 +40,10 @@ namespace eos
 /// keep feeding it triangles which it uses to render a disparity map. When done
 /// you can extract the disparity map with a mask - this is used to generate
 /// ground truth for a scene.
-/// This is basically a scanline renderer, except it renders disparity rather
-/// than anything remotly normal.
+/// This is basically a z-buffered renderer, except it renders disparity rather
+/// than anything remotly normal. Triangles are collected and then drawn by a
+/// TriRaster the next time the output is asked for, so feed it everything
+/// before looking.
 class EOS_CLASS MakeDisp
 {
  public:
@@ -62,6 +65,9 @@ class EOS_CLASS MakeDisp
   /// Adds a triangle to the rendering - provide the 3 corner coordinates.
    void Add(const bs::Vert & a,const bs::Vert & b,const bs::Vert & c);
 
+  /// Adds every triangle of a mesh to the rendering.
+   void Add(const sur::IndexedMesh & mesh);
+
 
   /// Width of output, for conveniance.
    nat32 Width() const;
@@ -90,20 +96,19 @@ class EOS_CLASS MakeDisp
  private:
   CameraPair pair;
 
-  math::Mat<3,3,real64> rectLeft;  // So we don't need to re-calculate them every triangle.
-  math::Mat<3,3,real64> rectRight; // "  
-  math::Vect<4,real64> centreLeft; // "
-  math::Mat<4,3,real64> invLP;     // "
+  math::Mat<3,3,real64> rectLeft;  // So we don't need to re-calculate them every pixel.
+  math::Mat<3,3,real64> rectRight; // "
   bs::Vert dirLeft;                // "
-  
-
-  ds::Array2D<real32> disp;
-  ds::Array2D<real32> depth; // Depth map, used to save on SVD's.
-  ds::Array2D<bit> mask; // True where disparity is valid.
-  
-  // Helper method - simply a wrapper around the Project method of CameraPair,
-  // for conveniance.
-   void Project(bs::Vert & loc,bs::Pnt & out,real32 * disp = null<real32*>());
+
+  mutable TriRaster raster;
+  mutable ds::ArrayResize<bs::Vert> corners; // Of triangles not yet rendered, 3 each.
+  mutable nat32 firstPending; // Index in the raster of the first triangle in corners.
+
+  mutable ds::Array2D<real32> disp;
+  mutable ds::Array2D<bit> mask; // True where disparity is valid.
+
+  // Renders any triangles waiting, updating the disparity map...
+   void Update() const;
 };
 
 //------------------------------------------------------------------------------
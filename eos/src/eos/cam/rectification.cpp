@@ -22,6 +22,11 @@
 #include "eos/file/csv.h"
 #include "eos/cam/triangulation.h"
 #include "eos/svt/sample.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#endif
 
 namespace eos
 {
@@ -484,153 +489,17 @@ bit RawRectify(const Fundamental & fun,
 }
 
 //------------------------------------------------------------------------------
-// This is given an input and output field of real32's plus a matrix
-// transforming from the output to the input and a sampling count, an optional
-// input mask can also be provided, an output mask is a must.
-// It fills in the output as it can from the input using the transform, sets
-// the mask to false where no data is avaliable...
-void RectifySampleReal(const svt::Field<real32> & in,svt::Field<real32> & out,
-                       const svt::Field<bit> * inMask,svt::Field<bit> * outMask,
-                       const math::Mat<3,3,real64> & o2i,const Radial & rad,nat32 samples,time::Progress * prog)
+EOS_FUNC bit PlaneRectifyTransforms(const Radial & radA,const Radial & radB,const Fundamental & fun,
+                                    nat32 widthA,nat32 heightA,nat32 widthB,nat32 heightB,
+                                    math::Mat<3,3,real64> & outTA,math::Mat<3,3,real64> & outTB,
+                                    nat32 & outWidthA,nat32 & outWidthB,nat32 & outHeight)
 {
- prog->Push();
- for (nat32 y=0;y<out.Size(1);y++)
- {
-  prog->Report(y,out.Size(1));
-  for (nat32 x=0;x<out.Size(0);x++)
-  {
-   out.Get(x,y) = 0.0;
-   nat32 ss = 0;
-   for (nat32 v=0;v<samples;v++)
-   {
-    for (nat32 u=0;u<samples;u++)
-    {
-     // Calculate position to sample...
-      // Output position...
-       math::Vect<3,real64> sa;
-        sa[0] = x + real64(u+1)/real64(samples+1) - 0.5;
-        sa[1] = y + real64(v+1)/real64(samples+1) - 0.5;
-        sa[2] = 1.0;
-
-      // Undistorted input position...
-       math::Vect<3,real64> sb;
-       math::MultVect(o2i,sa,sb);
-       sb /= sb[2];
-
-       math::Vect<2,real64> sc;
-       sc[0] = sb[0];
-       sc[1] = sb[1];
-
-      // Distorted input position...
-       math::Vect<2,real64> sd;
-       rad.Dis(sc,sd);
-
-
-     // Sample it, handling if the location is bad...
-      real32 sample;
-      if (SampleRealLin2D(sample,sd[0],sd[1],in,inMask))
-      {
-       ++ss;
-       out.Get(x,y) += sample;
-      }
-    }
-   }
-
-   if (ss!=0)
-   {
-    if (outMask) outMask->Get(x,y) = true;
-    out.Get(x,y) /= ss;
-   }
-   else
-   {
-    if (outMask) outMask->Get(x,y) = false;
-   }
-  }
- }
- prog->Pop();
-}
-
-// The colour version of above...
-void RectifySampleColour(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGB> & out,
-                         const svt::Field<bit> * inMask,svt::Field<bit> * outMask,
-                         const math::Mat<3,3,real64> & o2i,const Radial & rad,nat32 samples,time::Progress * prog)
-{
- prog->Push();
- for (nat32 y=0;y<out.Size(1);y++)
- {
-  prog->Report(y,out.Size(1));
-  for (nat32 x=0;x<out.Size(0);x++)
-  {
-   out.Get(x,y) = bs::ColourRGB(0.0,0.0,0.0);
-   nat32 ss = 0;
-   for (nat32 v=0;v<samples;v++)
-   {
-    for (nat32 u=0;u<samples;u++)
-    {
-     // Calculate position to sample...
-      // Output position...
-       math::Vect<3,real64> sa;
-        sa[0] = x + real64(u+1)/real64(samples+1) - 0.5;
-        sa[1] = y + real64(v+1)/real64(samples+1) - 0.5;
-        sa[2] = 1.0;
-
-      // Undistorted input position...
-       math::Vect<3,real64> sb;
-       math::MultVect(o2i,sa,sb);
-       sb /= sb[2];
-
-       math::Vect<2,real64> sc;
-       sc[0] = sb[0];
-       sc[1] = sb[1];
-
-      // Distorted input position...
-       math::Vect<2,real64> sd;
-       rad.Dis(sc,sd);
-
-
-     // Check if its a valid location...
-      bs::ColourRGB sample;
-      if (SampleColourRGBLin2D(sample,sd[0],sd[1],in,inMask))
-      {
-       ++ss;
-       out.Get(x,y) += sample;
-      }
-    }
-   }
-
-   if (ss!=0)
-   {
-    if (outMask) outMask->Get(x,y) = true;
-    out.Get(x,y) /= ss;
-   }
-   else
-   {
-    if (outMask) outMask->Get(x,y) = false;
-    out.Get(x,y) = bs::ColourRGB(1.0,0.0,1.0);
-   }
-  }
- }
- prog->Pop();
-}
-
-//------------------------------------------------------------------------------
-EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
-                          const Radial & radA,const Radial & radB,const Fundamental & fun,
-                          svt::Var * outA,svt::Var * outB,
-                          math::Mat<3,3,real64> * outTA,math::Mat<3,3,real64> * outTB,
-                          nat32 samples,bit doOriginal,bit doMask,time::Progress * prog)
-{
- LogBlock("eos::cam::PlaneRectify(...)","{fun}" << LogDiv() << fun);
- prog->Push();
- prog->Report(0,3);
-
-
+ LogBlock("eos::cam::PlaneRectifyTransforms(...)","{fun}" << LogDiv() << fun);
  // Use an external function to do the 'heavy' maths...
   math::Mat<3,3,real64> traA;
   math::Mat<3,3,real64> traB;
-  if (RawRectify(fun,inA->Size(0),inA->Size(1),inB->Size(0),inB->Size(1),traA,traB)==false)
+  if (RawRectify(fun,widthA,heightA,widthB,heightB,traA,traB)==false)
   {
-   prog->Pop();
    return false;
   }
 
@@ -646,11 +515,11 @@ EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
    math::Vect<2,real64> val[8];
     val[0][0] = 0.0;              val[0][1] = 0.0;
     val[1][0] = radA.centre[0];   val[1][1] = 0.0;
-    val[2][0] = inA->Size(0)-1.0; val[2][1] = 0.0;
-    val[3][0] = inA->Size(0)-1.0; val[3][1] = radA.centre[1];
-    val[4][0] = inA->Size(0)-1.0; val[4][1] = inA->Size(1)-1.0;
-    val[5][0] = radA.centre[0];   val[5][1] = inA->Size(1)-1.0;
-    val[6][0] = 0.0;              val[6][1] = inA->Size(1)-1.0;
+    val[2][0] = widthA-1.0; val[2][1] = 0.0;
+    val[3][0] = widthA-1.0; val[3][1] = radA.centre[1];
+    val[4][0] = widthA-1.0; val[4][1] = heightA-1.0;
+    val[5][0] = radA.centre[0];   val[5][1] = heightA-1.0;
+    val[6][0] = 0.0;              val[6][1] = heightA-1.0;
     val[7][0] = 0.0;              val[7][1] = radA.centre[1];
 
    math::Vect<3,real64> lowCorner;
@@ -700,11 +569,11 @@ EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
    math::Vect<2,real64> val[8];
     val[0][0] = 0.0;              val[0][1] = 0.0;
     val[1][0] = radB.centre[0];   val[1][1] = 0.0;
-    val[2][0] = inB->Size(0)-1.0; val[2][1] = 0.0;
-    val[3][0] = inB->Size(0)-1.0; val[3][1] = radB.centre[1];
-    val[4][0] = inB->Size(0)-1.0; val[4][1] = inB->Size(1)-1.0;
-    val[5][0] = radB.centre[0];   val[5][1] = inB->Size(1)-1.0;
-    val[6][0] = 0.0;              val[6][1] = inB->Size(1)-1.0;
+    val[2][0] = widthB-1.0; val[2][1] = 0.0;
+    val[3][0] = widthB-1.0; val[3][1] = radB.centre[1];
+    val[4][0] = widthB-1.0; val[4][1] = heightB-1.0;
+    val[5][0] = radB.centre[0];   val[5][1] = heightB-1.0;
+    val[6][0] = 0.0;              val[6][1] = heightB-1.0;
     val[7][0] = 0.0;              val[7][1] = radB.centre[1];
 
    math::Vect<3,real64> lowCorner;
@@ -777,8 +646,8 @@ EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
   // Calculate and normalise the epipolar line through the centre point of each image...
    math::Vect<3,real64> centreA;
    math::Vect<3,real64> centreB;
-    centreA[0] = 0.5*inA->Size(0); centreA[1] = 0.5*inA->Size(1); centreA[2] = 1.0;
-    centreB[0] = 0.5*inB->Size(0); centreB[1] = 0.5*inB->Size(1); centreB[2] = 1.0;
+    centreA[0] = 0.5*widthA; centreA[1] = 0.5*heightA; centreA[2] = 1.0;
+    centreB[0] = 0.5*widthB; centreB[1] = 0.5*heightB; centreB[2] = 1.0;
    math::Vect<3,real64> lineA;
    math::Vect<3,real64> lineB;
     math::CrossProduct(centreA,epiA,lineA);
@@ -917,7 +786,6 @@ EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
 
  // Offset the transformations so the output starts at 0,
  // just a conveniance, and calculate the actual dimensions of the output...
-  nat32 sizeXA,sizeXB,sizeY;
   {
    math::Mat<3,3,real64> offset;
     math::Identity(offset);
@@ -927,16 +795,16 @@ EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
    offset[0][2] = -minAX; math::Mult(offset,traA,temp2); traA = temp2;
    offset[0][2] = -minBX; math::Mult(offset,traB,temp2); traB = temp2;
 
-   sizeXA = nat32(math::RoundUp(maxAX - minAX));
-   sizeXB = nat32(math::RoundUp(maxBX - minBX));
-   sizeY = nat32(math::RoundUp(math::Min(maxAY,maxBY) - math::Max(minAY,minBY)));
+   outWidthA = nat32(math::RoundUp(maxAX - minAX));
+   outWidthB = nat32(math::RoundUp(maxBX - minBX));
+   outHeight = nat32(math::RoundUp(math::Min(maxAY,maxBY) - math::Max(minAY,minBY)));
   }
   traA /= math::FrobNorm(traA);
   traB /= math::FrobNorm(traB);
 
   LogDebug("[cam.rectify] Final transforms {a,b}" << LogDiv() << traA << LogDiv() << traB);
   LogDebug("[cam.rectify] Image sizes {A's width,B's width,Shared height}" <<
-           LogDiv() << sizeXA << LogDiv() << sizeXB << LogDiv() << sizeY);
+           LogDiv() << outWidthA << LogDiv() << outWidthB << LogDiv() << outHeight);
 
 
  // Invert the transforms - we take a sampling approach and
@@ -947,8 +815,8 @@ EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
   math::Inverse(traA,temp);
   math::Inverse(traB,temp);
 
-  if (outTA) *outTA = traA;
-  if (outTB) *outTB = traB;
+  outTA = traA;
+  outTB = traB;
  }
 
  LogDebug("[cam.rectify] Inverse transforms {a,b}" << LogDiv() << traA << LogDiv() << traB);
@@ -969,170 +837,568 @@ EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
  }
  #endif
 
+ return true;
+}
 
- // Tok's needed below...
-  str::Token maskTok = outA->GetCore().GetTT()("mask");
-  str::Token realTok = outA->GetCore().GetTT()(typestring<real32>());
-  str::Token greyTok = outA->GetCore().GetTT()(typestring<bs::ColourL>());
-  str::Token colTok = outA->GetCore().GetTT()(typestring<bs::ColourRGB>());
+EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
+                          const Radial & radA,const Radial & radB,const Fundamental & fun,
+                          svt::Var * outA,svt::Var * outB,
+                          math::Mat<3,3,real64> * outTA,math::Mat<3,3,real64> * outTB,
+                          nat32 samples,bit doOriginal,bit doMask,time::Progress * prog)
+{
+ LogBlock("eos::cam::PlaneRectify(...)","{fun}" << LogDiv() << fun);
+ prog->Push();
+ prog->Report(0,3);
 
+ // Work out the transforms, and hence the sizes of the outputs...
+  math::Mat<3,3,real64> traA;
+  math::Mat<3,3,real64> traB;
+  nat32 sizeXA,sizeXB,sizeY;
+  if (PlaneRectifyTransforms(radA,radB,fun,inA->Size(0),inA->Size(1),inB->Size(0),inB->Size(1),
+                             traA,traB,sizeXA,sizeXB,sizeY)==false)
+  {
+   prog->Pop();
+   return false;
+  }
+  if (outTA) *outTA = traA;
+  if (outTB) *outTB = traB;
 
- // Generate the output Var's...
+
+ // Build a map for each image and apply it - the maps are the same as a
+ // RectifyMap made from the outTA/outTB matrices, so anything that repeatedly
+ // rectifies with the same transform can skip all of this, see RigCache...
  prog->Report(1,3);
+  RectifyMap mapA;
+  RectifyMap mapB;
+  {
+   prog->Push();
+   prog->Report(0,2);
+   mapA.Build(traA,radA,inA->Size(0),inA->Size(1),sizeXA,sizeY,samples,prog);
+   prog->Report(1,2);
+   mapB.Build(traB,radB,inB->Size(0),inB->Size(1),sizeXB,sizeY,samples,prog);
+   prog->Pop();
+  }
+
+ prog->Report(2,3);
  {
   prog->Push();
   prog->Report(0,2);
+  mapA.Apply(inA,outA,doOriginal,doMask,prog);
+  prog->Report(1,2);
+  mapB.Apply(inB,outB,doOriginal,doMask,prog);
+  prog->Pop();
+ }
 
-  bit maskIni = false;
-  bs::Pnt originalIni = bs::Pnt(0.0,0.0);
+ prog->Pop();
+ return true;
+}
 
-  outA->Setup2D(sizeXA,sizeY);
-   for (nat32 i=0;i<inA->Fields();i++)
-   {
-    if ((inA->FieldType(i)==realTok)||(inA->FieldType(i)==greyTok)||(inA->FieldType(i)==colTok))
-    {
-     outA->Add(inA->FieldName(i),inA->FieldType(i),inA->FieldSize(i),inA->FieldDef(i));
-    }
-   }
-   if (doMask) outA->Add(maskTok,maskIni);
-   if (doOriginal) outA->Add("original",originalIni);
-  outA->Commit();
+//------------------------------------------------------------------------------
+#ifdef __SSE2__
+// Helpers for the below, for working with the taps 4 corners at once...
+static inline __m128 TapWeights(const nat16 * w)
+{
+ return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)w),_mm_setzero_si128()));
+}
 
-  prog->Report(1,2);
-  outB->Setup2D(sizeXB,sizeY);
-   for (nat32 i=0;i<inB->Fields();i++)
+static inline __m128 TapMask(const svt::Field<bit> & mask,nat32 x,nat32 y)
+{
+ return _mm_castsi128_ps(_mm_setr_epi32(-int32(mask.Get(x,y)),-int32(mask.Get(x+1,y)),
+                                        -int32(mask.Get(x,y+1)),-int32(mask.Get(x+1,y+1))));
+}
+
+static inline real32 TapSum(__m128 v)
+{
+ __m128 s = _mm_add_ps(v,_mm_movehl_ps(v,v));
+ s = _mm_add_ss(s,_mm_shuffle_ps(s,s,0x55));
+ return _mm_cvtss_f32(s);
+}
+#endif
+
+//------------------------------------------------------------------------------
+class RectifyMap::Builder
+{
+ public:
+  Builder(const math::Mat<3,3,real64> & h,const Radial & r,nat32 iw,nat32 ih,nat32 w,nat32 s,ds::Array<Tap> & t)
+  :o2i(h),rad(r),inWidth(iw),inHeight(ih),width(w),samples(s),tap(t)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   nat32 ind = y0*width*samples*samples;
+   for (nat32 y=y0;y<y1;y++)
    {
-    if ((inB->FieldType(i)==realTok)||(inB->FieldType(i)==greyTok)||(inB->FieldType(i)==colTok))
+    for (nat32 x=0;x<width;x++)
     {
-     outB->Add(inB->FieldName(i),inB->FieldType(i),inB->FieldSize(i),inB->FieldDef(i));
+     for (nat32 v=0;v<samples;v++)
+     {
+      for (nat32 u=0;u<samples;u++,ind++)
+      {
+       Tap & targ = tap[ind];
+       targ.x = 0;
+       targ.y = 0;
+       for (nat32 i=0;i<4;i++) targ.w[i] = 0;
+
+       // Calculate position to sample, exactly as PlaneRectify allways has...
+        math::Vect<3,real64> sa;
+         sa[0] = x + real64(u+1)/real64(samples+1) - 0.5;
+         sa[1] = y + real64(v+1)/real64(samples+1) - 0.5;
+         sa[2] = 1.0;
+
+        math::Vect<3,real64> sb;
+        math::MultVect(o2i,sa,sb);
+        sb /= sb[2];
+
+        math::Vect<2,real64> sc;
+         sc[0] = sb[0];
+         sc[1] = sb[1];
+
+        math::Vect<2,real64> sd;
+        rad.Dis(sc,sd);
+
+       // Work out the footprint, with the same boundary handling as
+       // svt::SampleRealLin2D, but with the corners off the edge given zero
+       // weight and the base moved so all four are in the image...
+        if ((inWidth<2)||(inHeight<2)) continue;
+        real32 px = sd[0];
+        real32 py = sd[1];
+        int32 xb = int32(math::RoundDown(px));
+        int32 yb = int32(math::RoundDown(py));
+        if ((xb<-1)||(yb<-1)||(xb>=int32(inWidth))||(yb>=int32(inHeight))) continue;
+
+        int32 bx = math::Clamp(xb,int32(0),int32(inWidth)-2);
+        int32 by = math::Clamp(yb,int32(0),int32(inHeight)-2);
+
+        real32 xw[2];
+         xw[1] = px - xb;
+         xw[0] = 1.0 - xw[1];
+        real32 yw[2];
+         yw[1] = py - yb;
+         yw[0] = 1.0 - yw[1];
+
+        real32 w[4] = {0.0,0.0,0.0,0.0};
+        real32 weight = 0.0;
+        for (int32 cv=0;cv<2;cv++)
+        {
+         for (int32 cu=0;cu<2;cu++)
+         {
+          int32 cx = xb + cu;
+          int32 cy = yb + cv;
+          if ((cx<0)||(cy<0)||(cx>=int32(inWidth))||(cy>=int32(inHeight))) continue;
+          w[(cy-by)*2 + (cx-bx)] += xw[cu]*yw[cv];
+          weight += xw[cu]*yw[cv];
+         }
+        }
+        if (math::IsZero(weight)) continue;
+
+        targ.x = bx;
+        targ.y = by;
+        for (nat32 i=0;i<4;i++) targ.w[i] = nat16(math::RoundDown(w[i]*32768.0/weight + 0.5));
+      }
+     }
     }
    }
-   if (doMask) outB->Add(maskTok,maskIni);
-   if (doOriginal) outB->Add("original",originalIni);
-  outB->Commit();
-
-  prog->Pop();
- }
-
+  }
 
- // And finally apply the two transforms. This is also dam complicated,
- // so we impliment it elsewhere and just have to loop the fields here...
- // (This is the time consuming bit)
- {
-  prog->Report(2,3);
-  prog->Push();
 
+ private:
+  const math::Mat<3,3,real64> & o2i;
+  const Radial & rad;
+  nat32 inWidth;
+  nat32 inHeight;
+  nat32 width;
+  nat32 samples;
+  ds::Array<Tap> & tap;
+};
 
+//------------------------------------------------------------------------------
+class RectifyMap::RemapReal
+{
+ public:
+  RemapReal(const RectifyMap & m,const svt::Field<real32> & i,svt::Field<real32> & o,
+            const svt::Field<bit> * im,svt::Field<bit> * om)
+  :map(m),in(i),out(o),inMask(im),outMask(om)
+  {}
 
-   // All fields in image A...
-    nat32 steps = outA->Fields() + outB->Fields();
-    svt::Field<bit> inMaskA(inA,"mask");
-    svt::Field<bit> outMaskA(outA,"mask");
-    for (nat32 i=0;i<outA->Fields();i++)
+  void operator () (nat32 y0,nat32 y1)
+  {
+   const nat32 spp = map.samples*map.samples;
+   nat32 ind = y0*map.width*spp;
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=0;x<map.width;x++)
     {
-     LogDebug("[cam.rectify] Considering A field {field}" << LogDiv() << inA->GetCore().GetTT().Str(outA->FieldName(i)));
-     prog->Report(i,steps);
-     if ((outA->FieldType(i)==realTok)||(outA->FieldType(i)==greyTok))
-     {
-      LogDebug("[cam.rectify] Rectifying field of real32's in A");
-      svt::Field<real32> in(inA,outA->FieldName(i));
-      svt::Field<real32> out(outA,outA->FieldName(i));
-      RectifySampleReal(in,out,inMaskA.Valid()?(&inMaskA):null<svt::Field<bit>*>(),outMaskA.Valid()?(&outMaskA):null<svt::Field<bit>*>(),traA,radA,samples,prog);
-     }
-     else if (outA->FieldType(i)==colTok)
-     {
-      LogDebug("[cam.rectify] Rectifying field of ColourRGB's in A");
-      svt::Field<bs::ColourRGB> in(inA,outA->FieldName(i));
-      svt::Field<bs::ColourRGB> out(outA,outA->FieldName(i));
-      RectifySampleColour(in,out,inMaskA.Valid()?(&inMaskA):null<svt::Field<bit>*>(),outMaskA.Valid()?(&outMaskA):null<svt::Field<bit>*>(),traA,radA,samples,prog);
-     }
-     else if (outA->FieldType(i)==maskTok)
-     {
-      // Do nothing:-)
-     }
-     else
+     real32 sum = 0.0;
+     nat32 ss = 0;
+     for (nat32 s=0;s<spp;s++,ind++)
      {
-      // Must be the "original" field...
-       svt::Field<bs::Pnt> oriA(outA,"original");
-       prog->Push();
-       for (nat32 y=0;y<oriA.Size(1);y++)
+      const Tap & t = map.tap[ind];
+      if ((t.w[0]|t.w[1]|t.w[2]|t.w[3])==0) continue;
+
+      #ifdef __SSE2__
+       __m128 w = TapWeights(t.w);
+       if (inMask) w = _mm_and_ps(w,TapMask(*inMask,t.x,t.y));
+       real32 weight = TapSum(w);
+       if (weight<0.5) continue;
+
+       __m128 c = _mm_setr_ps(in.Get(t.x,t.y),in.Get(t.x+1,t.y),in.Get(t.x,t.y+1),in.Get(t.x+1,t.y+1));
+       sum += TapSum(_mm_mul_ps(c,w))/weight;
+      #else
+       real32 w[4];
+       for (nat32 i=0;i<4;i++) w[i] = t.w[i];
+       if (inMask)
        {
-        prog->Report(y,oriA.Size(1));
-        for (nat32 x=0;x<oriA.Size(0);x++)
-        {
-         math::Vect<3,real64> a;
-          a[0] = x; a[1] = y; a[2] = 1.0;
-         math::Vect<3,real64> b;
-         math::MultVect(traA,a,b);
-         b /= b[2];
-         oriA.Get(x,y)[0] = b[0];
-         oriA.Get(x,y)[1] = b[1];
-        }
+        if (!inMask->Get(t.x,t.y)) w[0] = 0.0;
+        if (!inMask->Get(t.x+1,t.y)) w[1] = 0.0;
+        if (!inMask->Get(t.x,t.y+1)) w[2] = 0.0;
+        if (!inMask->Get(t.x+1,t.y+1)) w[3] = 0.0;
        }
-       prog->Pop();
+       real32 weight = w[0] + w[1] + w[2] + w[3];
+       if (weight<0.5) continue;
+
+       sum += (in.Get(t.x,t.y)*w[0] + in.Get(t.x+1,t.y)*w[1] +
+               in.Get(t.x,t.y+1)*w[2] + in.Get(t.x+1,t.y+1)*w[3])/weight;
+      #endif
+      ++ss;
      }
+
+     if (ss!=0) out.Get(x,y) = sum/real32(ss);
+           else out.Get(x,y) = 0.0;
+     if (outMask) outMask->Get(x,y) = ss!=0;
     }
+   }
+  }
+
 
-   // All fields in image B...
-    svt::Field<bit> inMaskB(inB,"mask");
-    svt::Field<bit> outMaskB(outB,"mask");
-    for (nat32 i=0;i<outB->Fields();i++)
+ private:
+  const RectifyMap & map;
+  const svt::Field<real32> & in;
+  svt::Field<real32> & out;
+  const svt::Field<bit> * inMask;
+  svt::Field<bit> * outMask;
+};
+
+//------------------------------------------------------------------------------
+class RectifyMap::RemapColour
+{
+ public:
+  RemapColour(const RectifyMap & m,const svt::Field<bs::ColourRGB> & i,svt::Field<bs::ColourRGB> & o,
+              const svt::Field<bit> * im,svt::Field<bit> * om)
+  :map(m),in(i),out(o),inMask(im),outMask(om)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   const nat32 spp = map.samples*map.samples;
+   nat32 ind = y0*map.width*spp;
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=0;x<map.width;x++)
     {
-     LogDebug("[cam.rectify] Considering B field {field}" << LogDiv() << inB->GetCore().GetTT().Str(outB->FieldName(i)));
-     prog->Report(outA->Fields() + i,steps);
-     if ((outB->FieldType(i)==realTok)||(outB->FieldType(i)==greyTok))
-     {
-      LogDebug("[cam.rectify] Rectifying field of real32's in B");
-      svt::Field<real32> in(inB,outB->FieldName(i));
-      svt::Field<real32> out(outB,outB->FieldName(i));
-      RectifySampleReal(in,out,inMaskB.Valid()?(&inMaskB):null<svt::Field<bit>*>(),outMaskB.Valid()?(&outMaskB):null<svt::Field<bit>*>(),traB,radB,samples,prog);
-     }
-     else if (outB->FieldType(i)==colTok)
-     {
-      LogDebug("[cam.rectify] Rectifying field of ColourRGB's in B");
-      svt::Field<bs::ColourRGB> in(inB,outB->FieldName(i));
-      svt::Field<bs::ColourRGB> out(outB,outB->FieldName(i));
-      RectifySampleColour(in,out,inMaskB.Valid()?(&inMaskB):null<svt::Field<bit>*>(),outMaskB.Valid()?(&outMaskB):null<svt::Field<bit>*>(),traB,radB,samples,prog);
-     }
-     else if (outB->FieldType(i)==maskTok)
+     nat32 ss = 0;
+     #ifdef __SSE2__
+      __m128 sum = _mm_setzero_ps();
+     #else
+      bs::ColourRGB sum(0.0,0.0,0.0);
+     #endif
+
+     for (nat32 s=0;s<spp;s++,ind++)
      {
-      // Do nothing:-)
-     }
-     else
-     {
-      // Must be the "original" field...
-       svt::Field<bs::Pnt> oriB(outB,"original");
-       prog->Push();
-       for (nat32 y=0;y<oriB.Size(1);y++)
+      const Tap & t = map.tap[ind];
+      if ((t.w[0]|t.w[1]|t.w[2]|t.w[3])==0) continue;
+
+      #ifdef __SSE2__
+       __m128 w = TapWeights(t.w);
+       if (inMask) w = _mm_and_ps(w,TapMask(*inMask,t.x,t.y));
+       real32 weight = TapSum(w);
+       if (weight<0.5) continue;
+       w = _mm_mul_ps(w,_mm_set1_ps(1.0/weight));
+
+       const bs::ColourRGB & c0 = in.Get(t.x,t.y);
+       const bs::ColourRGB & c1 = in.Get(t.x+1,t.y);
+       const bs::ColourRGB & c2 = in.Get(t.x,t.y+1);
+       const bs::ColourRGB & c3 = in.Get(t.x+1,t.y+1);
+       sum = _mm_add_ps(sum,_mm_mul_ps(_mm_setr_ps(c0.r,c0.g,c0.b,0.0),_mm_shuffle_ps(w,w,0x00)));
+       sum = _mm_add_ps(sum,_mm_mul_ps(_mm_setr_ps(c1.r,c1.g,c1.b,0.0),_mm_shuffle_ps(w,w,0x55)));
+       sum = _mm_add_ps(sum,_mm_mul_ps(_mm_setr_ps(c2.r,c2.g,c2.b,0.0),_mm_shuffle_ps(w,w,0xAA)));
+       sum = _mm_add_ps(sum,_mm_mul_ps(_mm_setr_ps(c3.r,c3.g,c3.b,0.0),_mm_shuffle_ps(w,w,0xFF)));
+      #else
+       real32 w[4];
+       for (nat32 i=0;i<4;i++) w[i] = t.w[i];
+       if (inMask)
+       {
+        if (!inMask->Get(t.x,t.y)) w[0] = 0.0;
+        if (!inMask->Get(t.x+1,t.y)) w[1] = 0.0;
+        if (!inMask->Get(t.x,t.y+1)) w[2] = 0.0;
+        if (!inMask->Get(t.x+1,t.y+1)) w[3] = 0.0;
+       }
+       real32 weight = w[0] + w[1] + w[2] + w[3];
+       if (weight<0.5) continue;
+
+       for (nat32 v=0;v<2;v++)
        {
-        prog->Report(y,oriB.Size(1));
-        for (nat32 x=0;x<oriB.Size(0);x++)
+        for (nat32 u=0;u<2;u++)
         {
-         math::Vect<3,real64> a;
-          a[0] = x; a[1] = y; a[2] = 1.0;
-         math::Vect<3,real64> b;
-         math::MultVect(traB,a,b);
-         b /= b[2];
-         oriB.Get(x,y)[0] = b[0];
-         oriB.Get(x,y)[1] = b[1];
+         bs::ColourRGB c = in.Get(t.x+u,t.y+v);
+         c *= w[v*2+u]/weight;
+         sum += c;
         }
        }
-       prog->Pop();
+      #endif
+      ++ss;
+     }
+
+     bs::ColourRGB & targ = out.Get(x,y);
+     if (ss!=0)
+     {
+      #ifdef __SSE2__
+       real32 res[4];
+       _mm_storeu_ps(res,_mm_mul_ps(sum,_mm_set1_ps(1.0/real32(ss))));
+       targ.r = res[0];
+       targ.g = res[1];
+       targ.b = res[2];
+      #else
+       targ = sum;
+       targ /= real32(ss);
+      #endif
      }
+     else targ = bs::ColourRGB(1.0,0.0,1.0);
+     if (outMask) outMask->Get(x,y) = ss!=0;
     }
+   }
+  }
 
 
-  prog->Pop();
- }
+ private:
+  const RectifyMap & map;
+  const svt::Field<bs::ColourRGB> & in;
+  svt::Field<bs::ColourRGB> & out;
+  const svt::Field<bit> * inMask;
+  svt::Field<bit> * outMask;
+};
+
+//------------------------------------------------------------------------------
+RectifyMap::RectifyMap()
+:inWidth(0),inHeight(0),width(0),height(0),samples(1)
+{
+ math::Identity(o2i);
+}
+
+RectifyMap::~RectifyMap()
+{}
+
+void RectifyMap::Build(const math::Mat<3,3,real64> & h,const Radial & rad,
+                       nat32 inW,nat32 inH,nat32 outW,nat32 outH,
+                       nat32 s,time::Progress * prog)
+{
+ LogTime("eos::cam::RectifyMap::Build");
+ prog->Push();
+
+ inWidth = inW;
+ inHeight = inH;
+ width = outW;
+ height = outH;
+ samples = math::Max(s,nat32(1));
+ o2i = h;
+
+ tap.Size(width*height*samples*samples);
+ nat32 grain = math::Max(nat32(1),nat32(4096/math::Max(width*samples*samples,nat32(1))));
+ Builder builder(o2i,rad,inWidth,inHeight,width,samples,tap);
+ mt::ParallelFor(nat32(0),height,builder,grain);
 
  prog->Pop();
+}
+
+void RectifyMap::Build(const CameraPair & pair,bit right,nat32 s,time::Progress * prog)
+{
+ if (right)
+ {
+  Build(pair.unRectRight,pair.right.radial,nat32(pair.right.dim[0]),nat32(pair.right.dim[1]),
+        nat32(pair.rightDim[0]),nat32(pair.rightDim[1]),s,prog);
+ }
+ else
+ {
+  Build(pair.unRectLeft,pair.left.radial,nat32(pair.left.dim[0]),nat32(pair.left.dim[1]),
+        nat32(pair.leftDim[0]),nat32(pair.leftDim[1]),s,prog);
+ }
+}
+
+bit RectifyMap::Write(io::OutVirt<io::Binary> & out) const
+{
+ nat32 head[5];
+  head[0] = inWidth;
+  head[1] = inHeight;
+  head[2] = width;
+  head[3] = height;
+  head[4] = samples;
+ real64 tra[9];
+  for (nat32 i=0;i<9;i++) tra[i] = o2i[i/3][i%3];
+
+ if (out.Write(head,sizeof(head))!=sizeof(head)) return false;
+ if (out.Write(tra,sizeof(tra))!=sizeof(tra)) return false;
+ if (tap.Size()==0) return true;
+
+ nat32 bytes = tap.Size()*sizeof(Tap);
+ return out.Write(&tap[0],bytes)==bytes;
+}
+
+bit RectifyMap::Read(io::InVirt<io::Binary> & in)
+{
+ nat32 head[5];
+ real64 tra[9];
+ bit ok = (in.Read(head,sizeof(head))==sizeof(head))&&(in.Read(tra,sizeof(tra))==sizeof(tra));
+
+ // Sanity check the header, so a damaged file can't make us allocate
+ // silly amounts of memory...
+  nat64 taps = 0;
+  if (ok)
+  {
+   ok = (head[0]<=32767)&&(head[1]<=32767)&&(head[2]<=32767)&&(head[3]<=32767)&&
+        (head[4]!=0)&&(head[4]<=16);
+   taps = nat64(head[2])*nat64(head[3])*nat64(head[4])*nat64(head[4]);
+   ok = ok&&((taps*sizeof(Tap))<nat64(0x80000000));
+  }
+
+ if (ok)
+ {
+  tap.Size(nat32(taps));
+  nat32 bytes = tap.Size()*sizeof(Tap);
+  if (bytes!=0) ok = in.Read(tap.Ptr(),bytes)==bytes;
+ }
+
+ if (ok)
+ {
+  inWidth = head[0];
+  inHeight = head[1];
+  width = head[2];
+  height = head[3];
+  samples = head[4];
+  for (nat32 i=0;i<9;i++) o2i[i/3][i%3] = tra[i];
+ }
+ else
+ {
+  inWidth = 0;
+  inHeight = 0;
+  width = 0;
+  height = 0;
+  samples = 1;
+  math::Identity(o2i);
+  tap.Size(0);
+ }
+
+ return ok;
+}
+
+bit RectifyMap::Apply(const svt::Field<real32> & in,svt::Field<real32> & out,
+                      const svt::Field<bit> * inMask,svt::Field<bit> * outMask) const
+{
+ if ((in.Size(0)!=inWidth)||(in.Size(1)!=inHeight)) return false;
+ if ((out.Size(0)!=width)||(out.Size(1)!=height)) return false;
+ if (inMask&&((inMask->Size(0)!=inWidth)||(inMask->Size(1)!=inHeight))) return false;
+ if (outMask&&((outMask->Size(0)!=width)||(outMask->Size(1)!=height))) return false;
+
+ nat32 grain = math::Max(nat32(1),nat32(4096/math::Max(width*samples*samples,nat32(1))));
+ RemapReal remap(*this,in,out,inMask,outMask);
+ mt::ParallelFor(nat32(0),height,remap,grain);
  return true;
 }
 
-//------------------------------------------------------------------------------
+bit RectifyMap::Apply(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGB> & out,
+                      const svt::Field<bit> * inMask,svt::Field<bit> * outMask) const
+{
+ if ((in.Size(0)!=inWidth)||(in.Size(1)!=inHeight)) return false;
+ if ((out.Size(0)!=width)||(out.Size(1)!=height)) return false;
+ if (inMask&&((inMask->Size(0)!=inWidth)||(inMask->Size(1)!=inHeight))) return false;
+ if (outMask&&((outMask->Size(0)!=width)||(outMask->Size(1)!=height))) return false;
+
+ nat32 grain = math::Max(nat32(1),nat32(4096/math::Max(width*samples*samples,nat32(1))));
+ RemapColour remap(*this,in,out,inMask,outMask);
+ mt::ParallelFor(nat32(0),height,remap,grain);
+ return true;
+}
 
+bit RectifyMap::Apply(svt::Var * in,svt::Var * out,bit doOriginal,bit doMask,time::Progress * prog) const
+{
+ LogTime("eos::cam::RectifyMap::Apply");
+ if ((in->Size(0)!=inWidth)||(in->Size(1)!=inHeight)) return false;
+ prog->Push();
+
+ // Tok's needed below...
+  str::Token maskTok = out->GetCore().GetTT()("mask");
+  str::Token realTok = out->GetCore().GetTT()(typestring<real32>());
+  str::Token greyTok = out->GetCore().GetTT()(typestring<bs::ColourL>());
+  str::Token colTok = out->GetCore().GetTT()(typestring<bs::ColourRGB>());
 
 
+ // Generate the output Var...
+ {
+  bit maskIni = false;
+  bs::Pnt originalIni = bs::Pnt(0.0,0.0);
+
+  out->Setup2D(width,height);
+   for (nat32 i=0;i<in->Fields();i++)
+   {
+    if ((in->FieldType(i)==realTok)||(in->FieldType(i)==greyTok)||(in->FieldType(i)==colTok))
+    {
+     out->Add(in->FieldName(i),in->FieldType(i),in->FieldSize(i),in->FieldDef(i));
+    }
+   }
+   if (doMask) out->Add(maskTok,maskIni);
+   if (doOriginal) out->Add("original",originalIni);
+  out->Commit();
+ }
+
+
+ // Apply the map to every field - the output mask gets written by each,
+ // but they all agree unless the input has a mask of its own...
+ {
+  svt::Field<bit> inMask(in,"mask");
+  svt::Field<bit> outMask(out,"mask");
+  for (nat32 i=0;i<out->Fields();i++)
+  {
+   LogDebug("[cam.rectify] Considering field {field}" << LogDiv() << in->GetCore().GetTT().Str(out->FieldName(i)));
+   prog->Report(i,out->Fields());
+   if ((out->FieldType(i)==realTok)||(out->FieldType(i)==greyTok))
+   {
+    svt::Field<real32> inF(in,out->FieldName(i));
+    svt::Field<real32> outF(out,out->FieldName(i));
+    Apply(inF,outF,inMask.Valid()?(&inMask):null<svt::Field<bit>*>(),outMask.Valid()?(&outMask):null<svt::Field<bit>*>());
+   }
+   else if (out->FieldType(i)==colTok)
+   {
+    svt::Field<bs::ColourRGB> inF(in,out->FieldName(i));
+    svt::Field<bs::ColourRGB> outF(out,out->FieldName(i));
+    Apply(inF,outF,inMask.Valid()?(&inMask):null<svt::Field<bit>*>(),outMask.Valid()?(&outMask):null<svt::Field<bit>*>());
+   }
+   else if (out->FieldName(i)==maskTok)
+   {
+    // Do nothing:-)
+   }
+   else
+   {
+    // Must be the "original" field...
+     svt::Field<bs::Pnt> ori(out,"original");
+     for (nat32 y=0;y<ori.Size(1);y++)
+     {
+      for (nat32 x=0;x<ori.Size(0);x++)
+      {
+       math::Vect<3,real64> a;
+        a[0] = x; a[1] = y; a[2] = 1.0;
+       math::Vect<3,real64> b;
+       math::MultVect(o2i,a,b);
+       b /= b[2];
+       ori.Get(x,y)[0] = b[0];
+       ori.Get(x,y)[1] = b[1];
+      }
+     }
+   }
+  }
+ }
+
+ prog->Pop();
+ return true;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -24,7 +24,11 @@
 
 #include "eos/types.h"
 #include "eos/svt/field.h"
+#include "eos/ds/arrays.h"
+#include "eos/bs/colours.h"
 #include "eos/cam/cameras.h"
+#include "eos/cam/files.h"
+#include "eos/io/out.h"
 #include "eos/time/progress.h"
 
 namespace eos
@@ -73,6 +77,136 @@ EOS_FUNC bit PlaneRectify(svt::Var * inA,svt::Var * inB,
                           nat32 samples = 1,bit doOriginal = true,bit doMask = true,
                           time::Progress * prog = null<time::Progress*>());
 
+/// The first half of PlaneRectify - calculates the transforms and the sizes of
+/// the rectified images without touching any image data, so the rectification
+/// can be done with RectifyMap's that are kept around, see RigCache.
+/// Parameters are as for PlaneRectify, except the input image sizes are given
+/// directly and outWidthA, outWidthB and outHeight are set to the output
+/// sizes. Returns false on failure.
+EOS_FUNC bit PlaneRectifyTransforms(const Radial & radA,const Radial & radB,const Fundamental & fun,
+                                    nat32 widthA,nat32 heightA,nat32 widthB,nat32 heightB,
+                                    math::Mat<3,3,real64> & outTA,math::Mat<3,3,real64> & outTB,
+                                    nat32 & outWidthA,nat32 & outWidthB,nat32 & outHeight);
+
+//------------------------------------------------------------------------------
+/// A precomputed rectification, for when the same mapping is applied to frame
+/// after frame, as with a fixed rig. PlaneRectify works out a homography and
+/// then, for every pixel of every field, transforms and distorts each sample
+/// position before interpolating - this does the transforming and distorting
+/// once, in Build, storing for each sample the clamped integer coordinates of
+/// its bilinear footprint and the four weights, in 16 bit fixed point. Apply
+/// then only has to gather and sum, which it does with sse2 when avaliable,
+/// with the rows split between the threads of the task pool - its memory bound.
+/// Matches the results of PlaneRectify, within the precision of the weights,
+/// which in fact uses this internally.
+class EOS_CLASS RectifyMap
+{
+ public:
+  /// Creates an empty map, for a 0x0 output.
+   RectifyMap();
+
+  /// &nbsp;
+   ~RectifyMap();
+
+
+  /// Builds the map. Inputs can be at most 32767 pixels in each dimension.
+  /// \param o2i Homography from rectified output coordinates to undistorted
+  ///            input coordinates, as given by outTA/outTB of PlaneRectify.
+  /// \param rad Radial distortion of the input image.
+  /// \param inWidth Width of the input image.
+  /// \param inHeight Height of the input image.
+  /// \param outWidth Width of the rectified image.
+  /// \param outHeight Height of the rectified image.
+  /// \param samples Samples to take in each dimension, as for PlaneRectify.
+  /// \param prog Optional progress reporter.
+   void Build(const math::Mat<3,3,real64> & o2i,const Radial & rad,
+              nat32 inWidth,nat32 inHeight,nat32 outWidth,nat32 outHeight,
+              nat32 samples = 1,time::Progress * prog = null<time::Progress*>());
+
+  /// Builds the map for one side of a camera pair, using its un-rectifying
+  /// matrix, radial distortion and the image sizes it records.
+   void Build(const CameraPair & pair,bit right,nat32 samples = 1,
+              time::Progress * prog = null<time::Progress*>());
+
+
+  /// Width of the input images the map expects.
+   nat32 InWidth() const {return inWidth;}
+
+  /// Height of the input images the map expects.
+   nat32 InHeight() const {return inHeight;}
+
+  /// Width of the rectified images it produces.
+   nat32 Width() const {return width;}
+
+  /// Height of the rectified images it produces.
+   nat32 Height() const {return height;}
+
+  /// Samples taken in each dimension.
+   nat32 Samples() const {return samples;}
+
+  /// Returns the homography the map was built with, from output coordinates
+  /// to undistorted input coordinates.
+   const math::Mat<3,3,real64> & Transform() const {return o2i;}
+
+
+  /// Writes the map, so it can be stored rather than rebuilt, see RigCache.
+  /// Returns false if writing fails.
+   bit Write(io::OutVirt<io::Binary> & out) const;
+
+  /// Reads a map saved with Write, returning false on failure, in which case
+  /// the map is left empty.
+   bit Read(io::InVirt<io::Binary> & in);
+
+
+  /// Rectifies a field of real32's. in must be InWidth() x InHeight() and out
+  /// Width() x Height(), otherwise it returns false and does nothing. Areas of
+  /// the input masked off by inMask are ignored, and outMask, if provided, is
+  /// set to indicate which output pixels got any valid samples. Pixels without
+  /// are set to 0.
+   bit Apply(const svt::Field<real32> & in,svt::Field<real32> & out,
+             const svt::Field<bit> * inMask = null<svt::Field<bit>*>(),
+             svt::Field<bit> * outMask = null<svt::Field<bit>*>()) const;
+
+  /// The colour version - pixels without valid samples are set to magenta.
+   bit Apply(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGB> & out,
+             const svt::Field<bit> * inMask = null<svt::Field<bit>*>(),
+             svt::Field<bit> * outMask = null<svt::Field<bit>*>()) const;
+
+  /// Rectifies an entire image, with the same output as PlaneRectify - out is
+  /// set up with every real32, bs::ColourRGB and bs::ColourL field of in, plus
+  /// optionally a mask and an 'original' field of the coordinates in the
+  /// undistorted input.
+  /// Returns false if in is the wrong size.
+   bit Apply(svt::Var * in,svt::Var * out,bit doOriginal = true,bit doMask = true,
+             time::Progress * prog = null<time::Progress*>()) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::cam::RectifyMap";}
+
+
+ private:
+  nat32 inWidth;
+  nat32 inHeight;
+  nat32 width;
+  nat32 height;
+  nat32 samples;
+  math::Mat<3,3,real64> o2i;
+
+  // One of these per sample, samples^2 consecutive for each output pixel...
+   struct Tap
+   {
+    int16 x; // Clamped so all four corners are in the image.
+    int16 y;
+    nat16 w[4]; // (x,y), (x+1,y), (x,y+1), (x+1,y+1), 1<<15 is 1. All 0 means no sample.
+   };
+   ds::Array<Tap> tap;
+
+  class Builder;
+  class RemapReal;
+  class RemapColour;
+};
+
 //------------------------------------------------------------------------------
 
 
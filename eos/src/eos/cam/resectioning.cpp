@@ -18,14 +18,125 @@
 #include "eos/cam/resectioning.h"
 
 #include "eos/math/iter_min.h"
+#include "eos/data/randoms.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace cam
  {
+//------------------------------------------------------------------------------
+// Functor used by Ransac - makes and scores a range of hypotheses, each from
+// a 6 point DLT in normalised coordinates...
+class CalculateCamera::Hypothesise
+{
+ public:
+  Hypothesise(const ds::Array<Match> & r,const ds::Array<Match> & nm,
+              const math::Mat<4,4,real64> & nw,const math::Mat<3,3,real64> & ini,
+              real64 ts,nat64 s,nat32 f,nat32 b,Camera * o,nat32 * c)
+  :raw(r),norm(nm),normWorld(nw),invNormImage(ini),tolSqr(ts),seed(s),first(f),beat(b),out(o),count(c)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   const nat32 n = raw.Size();
+
+   for (nat32 h=b0;h<b1;h++)
+   {
+    count[h] = 0;
+    data::RandomStream rand(seed,first+h); // Stream per hypothesis, so threads don't matter.
+
+    // Select 6 different matches...
+     nat32 ind[6];
+     nat32 k = 0;
+     while (k<6)
+     {
+      nat32 r = nat32(rand.Int(0,int32(n)-1));
+      bit dup = false;
+      for (nat32 i=0;i<k;i++) {if (ind[i]==r) {dup = true; break;}}
+      if (!dup) ind[k++] = r;
+     }
+
+    // Solve for the camera they define, in normalised coordinates...
+     math::Mat<12,12,real64> a;
+     math::Zero(a);
+     for (nat32 i=0;i<6;i++)
+     {
+      const Match & m = norm[ind[i]];
+
+      a[i*2][4]  = m.world[0];
+      a[i*2][5]  = m.world[1];
+      a[i*2][6]  = m.world[2];
+      a[i*2][7]  = 1.0;
+      a[i*2][8]  = -m.image[1]*m.world[0];
+      a[i*2][9]  = -m.image[1]*m.world[1];
+      a[i*2][10] = -m.image[1]*m.world[2];
+      a[i*2][11] = -m.image[1];
+
+      a[i*2+1][0]  = m.world[0];
+      a[i*2+1][1]  = m.world[1];
+      a[i*2+1][2]  = m.world[2];
+      a[i*2+1][3]  = 1.0;
+      a[i*2+1][8]  = -m.image[0]*m.world[0];
+      a[i*2+1][9]  = -m.image[0]*m.world[1];
+      a[i*2+1][10] = -m.image[0]*m.world[2];
+      a[i*2+1][11] = -m.image[0];
+     }
+
+     math::Vect<12,real64> b;
+     if (math::RightNullSpace(a,b)==false) continue;
+
+    // Un-normalise, so the reprojection error is in pixels...
+     Camera cn;
+     for (nat32 r=0;r<3;r++)
+     {
+      for (nat32 c=0;c<4;c++) cn[r][c] = b[r*4+c];
+     }
+
+     Camera temp;
+     Camera & cam = out[h];
+     math::Mult(cn,normWorld,temp);
+     math::Mult(invNormImage,temp,cam);
+
+     real64 fn = math::FrobNorm(cam);
+     if (!math::IsFinite(fn)) continue;
+     cam /= fn;
+
+    // Count how many matches are within tolerance, giving up once it can't
+    // beat the best from previous batches...
+     nat32 inl = 0;
+     for (nat32 i=0;i<n;i++)
+     {
+      math::Vect<2,real64> proj;
+      math::MultVectEH(cam,raw[i].world,proj);
+      if ((math::Sqr(proj[0]-raw[i].image[0]) + math::Sqr(proj[1]-raw[i].image[1]))<tolSqr) ++inl;
+      else
+      {
+       if (inl+(n-1-i)<=beat) break;
+      }
+     }
+     count[h] = inl;
+   }
+  }
+
+
+ private:
+  const ds::Array<Match> & raw;
+  const ds::Array<Match> & norm;
+  const math::Mat<4,4,real64> & normWorld;
+  const math::Mat<3,3,real64> & invNormImage;
+  real64 tolSqr;
+  nat64 seed;
+  nat32 first;
+  nat32 beat;
+  Camera * out;
+  nat32 * count;
+};
+
 //------------------------------------------------------------------------------
 CalculateCamera::CalculateCamera()
-:targQ(normal),resQ(failure),residual(-1.0)
+:targQ(normal),tolerance(-1.0),confidence(0.99),maxIters(2000),
+resQ(failure),residual(-1.0),inliers(0)
 {
  radial.aspectRatio = 1.0;
  radial.centre[0] = 0.0;
@@ -60,12 +171,50 @@ void CalculateCamera::AddMatch(const bs::Vertex & world,const bs::Point & image)
  data.AddBack(m);
 }
 
+void CalculateCamera::SetRobust(real64 tol,real64 conf,nat32 mi)
+{
+ tolerance = tol;
+ confidence = conf;
+ maxIters = mi;
+}
+
+void CalculateCamera::SetNonRobust()
+{
+ tolerance = -1.0;
+}
+
 void CalculateCamera::Calculate(time::Progress * prog)
 {
  LogTime("eos::cam::CalculateCamera::Calculate");
  resQ = failure;
  residual = -1.0;
- if (data.Size()<6) {LogDebug("[cam::CalculateCamera] Insufficient matches."); return;}
+ inliers = data.Size();
+ inlier.Size(0);
+
+ if ((tolerance<0.0)||(data.Size()<=6)) {Fit(data,prog); return;}
+
+ prog->Push();
+  prog->Report(0,2);
+  Ransac();
+
+  prog->Report(1,2);
+  if (inliers==data.Size()) Fit(data,prog);
+  else
+  {
+   ds::List<Match> sub;
+   ds::List<Match>::Cursor targ = data.FrontPtr();
+   for (nat32 i=0;!targ.Bad();i++,++targ)
+   {
+    if (inlier[i]) sub.AddBack(*targ);
+   }
+   Fit(sub,prog);
+  }
+ prog->Pop();
+}
+
+void CalculateCamera::Fit(const ds::List<Match> & pts,time::Progress * prog)
+{
+ if (pts.Size()<6) {LogDebug("[cam::CalculateCamera] Insufficient matches."); return;}
 
  prog->Push();
  nat32 steps;
@@ -85,7 +234,7 @@ void CalculateCamera::Calculate(time::Progress * prog)
    math::Vect<3,real64> worldMean(0.0);
    math::Vect<2,real64> imageMean(0.0);
    nat32 matchCount = 0;
-   ds::List<Match>::Cursor targ = data.FrontPtr();
+   ds::List<Match>::Cursor targ = pts.FrontPtr();
    while (!targ.Bad())
    {
     ++matchCount;
@@ -104,7 +253,7 @@ void CalculateCamera::Calculate(time::Progress * prog)
    math::Vect<3,real64> worldSd(0.0);
    math::Vect<2,real64> imageSd(0.0);
    matchCount = 0;
-   targ = data.FrontPtr();
+   targ = pts.FrontPtr();
    while (!targ.Bad())
    {
     ++matchCount;
@@ -134,7 +283,7 @@ void CalculateCamera::Calculate(time::Progress * prog)
 
   // Build the matrix to be passed into SVD, normalising as we go...
    math::Matrix<real64> a(2*matchCount,12);
-   targ = data.FrontPtr();
+   targ = pts.FrontPtr();
    for (nat32 i=0;i<matchCount;i++)
    {
     // Calculate normalised points...
@@ -178,7 +327,7 @@ void CalculateCamera::Calculate(time::Progress * prog)
   // Run SVD and extract the projection matrix, un-normalise...
    // Calculate...
     math::Vect<12,real64> b;
-    if (math::RightNullSpace(a,b)==false) return;
+    if (math::RightNullSpace(a,b)==false) {prog->Pop(); return;}
     b.Normalise();
 
    // Extract...
@@ -195,14 +344,14 @@ void CalculateCamera::Calculate(time::Progress * prog)
     math::Mult(normImage,temp,camera);
 
     real64 fn = math::FrobNorm(camera);
-    if (!math::IsFinite(fn)) return;
+    if (!math::IsFinite(fn)) {prog->Pop(); return;}
     camera /= fn;
 
 
    // Calculate the residual, as it kinda sucks to not know...
    {
     residual = 0.0;
-    targ = data.FrontPtr();
+    targ = pts.FrontPtr();
     for (nat32 i=0;i<matchCount;i++)
     {
      math::Vect<2,real64> proj;
@@ -215,7 +364,7 @@ void CalculateCamera::Calculate(time::Progress * prog)
    }
  }
  resQ = low;
- if (resQ==targQ) return;
+ if (resQ==targQ) {prog->Pop(); return;}
 
 
 
@@ -240,11 +389,11 @@ void CalculateCamera::Calculate(time::Progress * prog)
 
 
   // Apply the LM...
-   residual = math::LM(data.Size(),para,data,&FirstLM,null<void(*)(const math::Vector<real64>&,math::Matrix<real64>&,const ds::List<Match>&)>(),&FirstCon);
+   residual = math::LM(pts.Size(),para,pts,&FirstLM,null<void(*)(const math::Vector<real64>&,math::Matrix<real64>&,const ds::List<Match>&)>(),&FirstCon);
 
 
   // Decompose the parameter vector back into the camera matrix...
-   if (!math::IsFinite(para.Length())) return;
+   if (!math::IsFinite(para.Length())) {prog->Pop(); return;}
    camera[0][0] = para[0];
    camera[0][1] = para[1];
    camera[0][2] = para[2];
@@ -259,7 +408,7 @@ void CalculateCamera::Calculate(time::Progress * prog)
    camera[2][3] = para[11];
  }
  resQ = normal;
- if (resQ==targQ) return;
+ if (resQ==targQ) {prog->Pop(); return;}
 
 
 
@@ -297,12 +446,12 @@ void CalculateCamera::Calculate(time::Progress * prog)
 
 
   // Apply the LM...
-   residual = math::LM(data.Size(),para,data,&SecondLM,null<void(*)(const math::Vector<real64>&,math::Matrix<real64>&,const ds::List<Match>&)>(),&SecondCon);
+   residual = math::LM(pts.Size(),para,pts,&SecondLM,null<void(*)(const math::Vector<real64>&,math::Matrix<real64>&,const ds::List<Match>&)>(),&SecondCon);
 
 
   // Decompose the parameter vector back into the camera matrix and radial
   // parameters data structure...
-   if (!math::IsFinite(para.Length())) return;
+   if (!math::IsFinite(para.Length())) {prog->Pop(); return;}
    camera[0][0] = para[0];
    camera[0][1] = para[1];
    camera[0][2] = para[2];
@@ -330,6 +479,121 @@ void CalculateCamera::Calculate(time::Progress * prog)
  prog->Pop();
 }
 
+//------------------------------------------------------------------------------
+void CalculateCamera::Ransac()
+{
+ LogTime("eos::cam::CalculateCamera::Ransac");
+ const nat32 n = data.Size();
+
+ // Copy into an array for random access...
+  ds::Array<Match> raw(n);
+  {
+   ds::List<Match>::Cursor targ = data.FrontPtr();
+   for (nat32 i=0;i<n;i++,++targ) raw[i] = *targ;
+  }
+
+ // Normalise, same as Fit, so the 6 point solutions are stable...
+  math::Vect<3,real64> worldMean(0.0);
+  math::Vect<2,real64> imageMean(0.0);
+  for (nat32 i=0;i<n;i++)
+  {
+   worldMean += raw[i].world;
+   imageMean += raw[i].image;
+  }
+  worldMean /= real64(n);
+  imageMean /= real64(n);
+
+  math::Vect<3,real64> worldSd(0.0);
+  math::Vect<2,real64> imageSd(0.0);
+  for (nat32 i=0;i<n;i++)
+  {
+   for (nat32 j=0;j<3;j++) worldSd[j] += math::Abs(raw[i].world[j]-worldMean[j]);
+   for (nat32 j=0;j<2;j++) imageSd[j] += math::Abs(raw[i].image[j]-imageMean[j]);
+  }
+  worldSd /= real64(n);
+  imageSd /= real64(n);
+  for (nat32 j=0;j<3;j++) {if (math::IsZero(worldSd[j])) worldSd[j] = 1.0;}
+  for (nat32 j=0;j<2;j++) {if (math::IsZero(imageSd[j])) imageSd[j] = 1.0;}
+
+  math::Mat<4,4,real64> normWorld;
+  math::Identity(normWorld);
+  math::Mat<3,3,real64> invNormImage;
+  math::Identity(invNormImage);
+  for (nat32 j=0;j<3;j++)
+  {
+   normWorld[j][j] = 1.0/worldSd[j];
+   normWorld[j][3] = -worldMean[j]/worldSd[j];
+  }
+  for (nat32 j=0;j<2;j++)
+  {
+   invNormImage[j][j] = imageSd[j];
+   invNormImage[j][2] = imageMean[j];
+  }
+
+  ds::Array<Match> norm(n);
+  for (nat32 i=0;i<n;i++)
+  {
+   for (nat32 j=0;j<3;j++) norm[i].world[j] = (raw[i].world[j]-worldMean[j])/worldSd[j];
+   for (nat32 j=0;j<2;j++) norm[i].image[j] = (raw[i].image[j]-imageMean[j])/imageSd[j];
+  }
+
+
+ // Iterate batches of hypotheses, keeping the one with the most inliers and
+ // stopping once the chance of there being a better one is small enough...
+  data::Random rand;
+  nat64 seed = nat32(rand.Int(0,0x7fffffff));
+  const real64 tolSqr = math::Sqr(tolerance);
+
+  const nat32 batch = 8*mt::DefaultPool().Concurrency();
+  ds::Array<Camera> camBatch(batch);
+  ds::Array<nat32> count(batch);
+
+  Camera best;
+  nat32 mostInliers = 0;
+  nat32 hypotheses = 0;
+  while (hypotheses<maxIters)
+  {
+   nat32 size = math::Min(batch,maxIters-hypotheses);
+   Hypothesise hyp(raw,norm,normWorld,invNormImage,tolSqr,seed,hypotheses,mostInliers,
+                   camBatch.Ptr(),count.Ptr());
+   mt::ParallelFor(nat32(0),size,hyp);
+   hypotheses += size;
+
+   // Keep the best, in order so the result does not depend on the threads...
+    for (nat32 i=0;i<size;i++)
+    {
+     if (count[i]>mostInliers)
+     {
+      mostInliers = count[i];
+      best = camBatch[i];
+     }
+    }
+
+   // Check if we have done enough samples...
+    real64 sr = math::Ln(1.0-confidence)/math::Ln(1.0-math::Pow(real64(mostInliers)/real64(n),6.0));
+    if (math::IsFinite(sr)&&(sr<=real64(hypotheses))) break;
+  }
+  LogDebug("[cam::CalculateCamera] RANSAC result {inliers,hypotheses}" << LogDiv() << mostInliers << LogDiv() << hypotheses);
+
+
+ // Mark the inliers of the best...
+  inlier.Size(n);
+  inliers = 0;
+  for (nat32 i=0;i<n;i++)
+  {
+   inlier[i] = false;
+   if (mostInliers==0) continue;
+
+   math::Vect<2,real64> proj;
+   math::MultVectEH(best,raw[i].world,proj);
+   if ((math::Sqr(proj[0]-raw[i].image[0]) + math::Sqr(proj[1]-raw[i].image[1]))<tolSqr)
+   {
+    inlier[i] = true;
+    ++inliers;
+   }
+  }
+}
+
 //------------------------------------------------------------------------------
 void CalculateCamera::FirstLM(const math::Vector<real64> & pv,math::Vector<real64> & err,const ds::List<Match> & oi)
 {
@@ -411,6 +675,39 @@ void CalculateCamera::SecondCon(math::Vector<real64> & pv,const ds::List<Match>
  for (nat32 i=0;i<12;i++) pv[i] *= length;
 }
 
+//------------------------------------------------------------------------------
+// Functor used by CalculateCameras...
+class CalculateJobs
+{
+ public:
+  CalculateJobs(CalculateCamera ** j):job(j) {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++) job[i]->Calculate();
+  }
+
+ private:
+  CalculateCamera ** job;
+};
+
+void CalculateCameras(CalculateCamera ** job,nat32 count,time::Progress * prog)
+{
+ LogTime("eos::cam::CalculateCameras");
+ prog->Push();
+
+ // Done in batches of a few per thread, so progress can be reported...
+  const nat32 batch = 4*mt::DefaultPool().Concurrency();
+  for (nat32 i=0;i<count;i+=batch)
+  {
+   prog->Report(i,count);
+   CalculateJobs cj(job+i);
+   mt::ParallelFor(nat32(0),math::Min(batch,count-i),cj);
+  }
+
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -26,6 +26,7 @@
 #include "eos/cam/cameras.h"
 #include "eos/bs/geo2d.h"
 #include "eos/bs/geo3d.h"
+#include "eos/ds/arrays.h"
 #include "eos/time/progress.h"
 
 namespace eos
@@ -41,6 +42,9 @@ namespace eos
 /// To do radial parameter estimation you will need a lot more matchesthan 6.
 /// For LM assumes noise is in the image coordinates, i.e. that the 3d positions
 /// are perfect.
+/// Can optionally be made robust, see SetRobust, in which case RANSAC with the
+/// 6 point DLT is used to find the inliers before the above is applied to just
+/// them. Hypotheses are scored in parallel, using the task pool.
 class EOS_CLASS CalculateCamera
 {
  public:
@@ -70,6 +74,16 @@ class EOS_CLASS CalculateCamera
   /// (As high requires lots of data.)
    void SetQuality(ResQuality rq) {targQ = rq;}
 
+  /// Switches on RANSAC, so Calculate can cope with outliers. tolerance is the
+  /// distance, in pixels, a match can reproject from its image position and
+  /// still count as an inlier. Hypotheses are made from 6 random matches till
+  /// there is the given confidence of having found the best, or maxIters is
+  /// reached.
+   void SetRobust(real64 tolerance,real64 confidence = 0.99,nat32 maxIters = 2000);
+
+  /// Switches RANSAC back off, so all matches are used. The default.
+   void SetNonRobust();
+
 
   /// Calculates the result to the required quality, af6ter this adding is
   /// pointless but the get methods will return real data.
@@ -89,6 +103,14 @@ class EOS_CLASS CalculateCamera
   /// Returns the calculated camera matrix.
    const Camera & GetCamera() const {return camera;}
 
+  /// Returns how many matches the last Calculate used, all of them unless
+  /// robust.
+   nat32 Inliers() const {return inliers;}
+
+  /// Returns true if the given match, indexed by the order they were added
+  /// in, was used by the last Calculate.
+   bit Inlier(nat32 i) const {return (inlier.Size()==0)||inlier[i];}
+
 
 
   /// &nbsp;
@@ -105,12 +127,27 @@ class EOS_CLASS CalculateCamera
    };
    ds::List<Match> data;
 
+  // RANSAC settings, tolerance is negative when its off...
+   real64 tolerance;
+   real64 confidence;
+   nat32 maxIters;
+
 
   // Out...
    ResQuality resQ;
    real64 residual;
    Radial radial;
    Camera camera;
+   nat32 inliers;
+   ds::Array<bit> inlier; // Empty if they all were.
+
+
+  // Does the actual fitting, for a given set of matches...
+   void Fit(const ds::List<Match> & pts,time::Progress * prog);
+
+  // Finds the inliers with RANSAC, filling in inlier and inliers...
+   void Ransac();
+   class Hypothesise;
 
 
   // Helper functions for LM...
@@ -120,6 +157,14 @@ class EOS_CLASS CalculateCamera
    static void SecondCon(math::Vector<real64> & pv,const ds::List<Match> & oi);
 };
 
+//------------------------------------------------------------------------------
+/// Runs Calculate on an array of CalculateCamera objects, for when many images
+/// are being resectioned at once, e.g. adding a batch of frames to a
+/// reconstruction. The objects are spread across the threads of the task
+/// pool, so must all be distinct; progress is reported as they complete.
+EOS_FUNC void CalculateCameras(CalculateCamera ** job,nat32 count,
+                               time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
  };
 };
@@ -0,0 +1,353 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/cam/rig_cache.h"
+
+#include "eos/data/checksums.h"
+#include "eos/file/files.h"
+#include "eos/io/to_virt.h"
+
+namespace eos
+{
+ namespace cam
+ {
+//------------------------------------------------------------------------------
+// Identifies the file format, 'RIG' followed by a version number...
+static const nat32 rigMagic = 0x01474952;
+
+//------------------------------------------------------------------------------
+RigCache::RigCache()
+{
+ Clear();
+}
+
+RigCache::~RigCache()
+{}
+
+bit RigCache::Get(const CameraPair & pair,nat32 leftWidth,nat32 leftHeight,
+                  nat32 rightWidth,nat32 rightHeight,nat32 samples,
+                  cstrconst fn,time::Progress * prog)
+{
+ if (Matches(pair,leftWidth,leftHeight,rightWidth,rightHeight,samples)) return true;
+
+ if (fn)
+ {
+  if (Load(fn)&&Matches(pair,leftWidth,leftHeight,rightWidth,rightHeight,samples))
+  {
+   LogDebug("[cam::RigCache] Loaded {fn}" << LogDiv() << fn);
+   return true;
+  }
+ }
+
+ if (!Build(pair,leftWidth,leftHeight,rightWidth,rightHeight,samples,prog)) return false;
+
+ if (fn)
+ {
+  if (!Save(fn,true)) LogDebug("[cam::RigCache] Failed to save {fn}" << LogDiv() << fn);
+ }
+ return true;
+}
+
+bit RigCache::Build(const CameraPair & pair,nat32 leftWidth,nat32 leftHeight,
+                    nat32 rightWidth,nat32 rightHeight,nat32 samples,
+                    time::Progress * prog)
+{
+ LogTime("eos::cam::RigCache::Build");
+ prog->Push();
+ prog->Report(0,4);
+ Clear();
+
+ // Adjust the calibration to the size of the images...
+  Fundamental fun = pair.fun;
+  Radial leftRad = pair.left.radial;
+  Radial rightRad = pair.right.radial;
+
+  fun.ChangeSize(bs::Pnt(pair.left.dim[0],pair.left.dim[1]),
+                 bs::Pnt(pair.right.dim[0],pair.right.dim[1]),
+                 bs::Pnt(leftWidth,leftHeight),
+                 bs::Pnt(rightWidth,rightHeight));
+  leftRad.ChangeSize(bs::Pnt(pair.left.dim[0],pair.left.dim[1]),
+                     bs::Pnt(leftWidth,leftHeight));
+  rightRad.ChangeSize(bs::Pnt(pair.right.dim[0],pair.right.dim[1]),
+                      bs::Pnt(rightWidth,rightHeight));
+
+
+ // The transforms and the maps that apply them...
+  math::Mat<3,3,real64> traLeft;
+  math::Mat<3,3,real64> traRight;
+  nat32 outLeftWidth,outRightWidth,outHeight;
+  if (!PlaneRectifyTransforms(leftRad,rightRad,fun,leftWidth,leftHeight,rightWidth,rightHeight,
+                              traLeft,traRight,outLeftWidth,outRightWidth,outHeight))
+  {
+   prog->Pop();
+   return false;
+  }
+
+  prog->Report(1,4);
+  leftMap.Build(traLeft,leftRad,leftWidth,leftHeight,outLeftWidth,outHeight,samples,prog);
+  prog->Report(2,4);
+  rightMap.Build(traRight,rightRad,rightWidth,rightHeight,outRightWidth,outHeight,samples,prog);
+
+
+ // The undistortion tables...
+  prog->Report(3,4);
+  leftUnDis.Build(leftRad,leftWidth,leftHeight);
+  rightUnDis.Build(rightRad,rightWidth,rightHeight);
+
+
+ // The rectified calibration, as BatchRectify would leave it...
+  rect = pair;
+  rect.unRectLeft = traLeft;
+  rect.unRectRight = traRight;
+  for (nat32 i=0;i<4;i++)
+  {
+   rect.left.radial.k[i] = 0.0;
+   rect.right.radial.k[i] = 0.0;
+  }
+  rect.leftDim[0] = outLeftWidth;
+  rect.leftDim[1] = outHeight;
+  rect.rightDim[0] = outRightWidth;
+  rect.rightDim[1] = outHeight;
+
+
+ // Everything else...
+  math::Mat<3,3,real64> temp;
+  rectLeft = traLeft;
+  math::Inverse(rectLeft,temp);
+  rectRight = traRight;
+  math::Inverse(rectRight,temp);
+
+  fun.EpipoleA(epiLeft);
+  fun.EpipoleB(epiRight);
+
+  // (IsRectified is too strict to use here, with its tolerances, so trust
+  // the rectification and just check the numbers are sane.)
+  rect.GetDispToDepth(dispA,dispB);
+  hasDisp = math::IsFinite(dispA)&&math::IsFinite(dispB);
+
+  MakeKey(pair,leftWidth,leftHeight,rightWidth,rightHeight,samples,key);
+  valid = true;
+
+ prog->Pop();
+ return true;
+}
+
+bit RigCache::Matches(const CameraPair & pair,nat32 leftWidth,nat32 leftHeight,
+                      nat32 rightWidth,nat32 rightHeight,nat32 samples) const
+{
+ if (!valid) return false;
+
+ nat32 k[4];
+ MakeKey(pair,leftWidth,leftHeight,rightWidth,rightHeight,samples,k);
+ return (k[0]==key[0])&&(k[1]==key[1])&&(k[2]==key[2])&&(k[3]==key[3]);
+}
+
+//------------------------------------------------------------------------------
+bit RigCache::Save(cstrconst fn,bit overwrite) const
+{
+ LogTime("eos::cam::RigCache::Save");
+ if (!valid) return false;
+
+ file::File<io::Binary> f(fn,overwrite?file::way_ow:file::way_new,file::mode_write);
+ if (!f.Active()) return false;
+
+ file::Cursor<io::Binary> cursor = f.GetCursor();
+ io::VirtOut<file::Cursor<io::Binary> > out(cursor);
+
+ // The header and the key...
+  nat32 head[6];
+  head[0] = rigMagic;
+  for (nat32 i=0;i<4;i++) head[1+i] = key[i];
+  head[5] = hasDisp?1:0;
+  if (out.Write(head,sizeof(head))!=sizeof(head)) return false;
+
+ // All the numbers...
+  real64 num[pairReals+18+6+2];
+  Flatten(rect,num);
+  for (nat32 i=0;i<9;i++)
+  {
+   num[pairReals+i] = rectLeft[i/3][i%3];
+   num[pairReals+9+i] = rectRight[i/3][i%3];
+  }
+  for (nat32 i=0;i<3;i++)
+  {
+   num[pairReals+18+i] = epiLeft[i];
+   num[pairReals+21+i] = epiRight[i];
+  }
+  num[pairReals+24] = dispA;
+  num[pairReals+25] = dispB;
+  if (out.Write(num,sizeof(num))!=sizeof(num)) return false;
+
+ // The maps and tables...
+  return leftMap.Write(out) && rightMap.Write(out) &&
+         leftUnDis.Write(out) && rightUnDis.Write(out);
+}
+
+bit RigCache::Save(const str::String & fn,bit overwrite) const
+{
+ cstr ts = fn.ToStr();
+ bit ret = Save(ts,overwrite);
+ mem::Free(ts);
+ return ret;
+}
+
+bit RigCache::Load(cstrconst fn)
+{
+ LogTime("eos::cam::RigCache::Load");
+ Clear();
+
+ file::File<io::Binary> f(fn,file::way_edit,file::mode_read);
+ if (!f.Active()) return false;
+
+ file::Cursor<io::Binary> cursor = f.GetCursor();
+ io::VirtIn<file::Cursor<io::Binary> > in(cursor);
+
+ // The header and the key...
+  nat32 head[6];
+  if (in.Read(head,sizeof(head))!=sizeof(head)) return false;
+  if (head[0]!=rigMagic) return false;
+
+ // All the numbers...
+  real64 num[pairReals+18+6+2];
+  if (in.Read(num,sizeof(num))!=sizeof(num)) return false;
+
+ // The maps and tables...
+  if (!(leftMap.Read(in) && rightMap.Read(in) && leftUnDis.Read(in) && rightUnDis.Read(in)))
+  {
+   Clear();
+   return false;
+  }
+
+ // Success - fill in...
+  for (nat32 i=0;i<4;i++) key[i] = head[1+i];
+  hasDisp = head[5]!=0;
+
+  Unflatten(num,rect);
+  for (nat32 i=0;i<9;i++)
+  {
+   rectLeft[i/3][i%3] = num[pairReals+i];
+   rectRight[i/3][i%3] = num[pairReals+9+i];
+  }
+  for (nat32 i=0;i<3;i++)
+  {
+   epiLeft[i] = num[pairReals+18+i];
+   epiRight[i] = num[pairReals+21+i];
+  }
+  dispA = num[pairReals+24];
+  dispB = num[pairReals+25];
+
+  valid = true;
+
+ return true;
+}
+
+bit RigCache::Load(const str::String & fn)
+{
+ cstr ts = fn.ToStr();
+ bit ret = Load(ts);
+ mem::Free(ts);
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+void RigCache::MakeKey(const CameraPair & pair,nat32 leftWidth,nat32 leftHeight,
+                       nat32 rightWidth,nat32 rightHeight,nat32 samples,nat32 out[4])
+{
+ real64 num[pairReals];
+ Flatten(pair,num);
+
+ nat32 size[5];
+  size[0] = leftWidth;
+  size[1] = leftHeight;
+  size[2] = rightWidth;
+  size[3] = rightHeight;
+  size[4] = samples;
+
+ data::Md5 md5;
+ md5.Write(num,sizeof(num));
+ md5.Write(size,sizeof(size));
+ md5.Get(out);
+}
+
+void RigCache::Flatten(const CameraPair & pair,real64 * out)
+{
+ const CameraCalibration * cal[2] = {&pair.left,&pair.right};
+ for (nat32 c=0;c<2;c++)
+ {
+  for (nat32 i=0;i<9;i++) *out++ = cal[c]->intrinsic[i/3][i%3];
+  *out++ = cal[c]->radial.aspectRatio;
+  *out++ = cal[c]->radial.centre[0];
+  *out++ = cal[c]->radial.centre[1];
+  for (nat32 i=0;i<4;i++) *out++ = cal[c]->radial.k[i];
+  *out++ = cal[c]->dim[0];
+  *out++ = cal[c]->dim[1];
+ }
+
+ for (nat32 i=0;i<9;i++) *out++ = pair.fun[i/3][i%3];
+ *out++ = pair.gap;
+ for (nat32 i=0;i<12;i++) *out++ = pair.lp[i/4][i%4];
+ for (nat32 i=0;i<12;i++) *out++ = pair.rp[i/4][i%4];
+ for (nat32 i=0;i<9;i++) *out++ = pair.unRectLeft[i/3][i%3];
+ *out++ = pair.leftDim[0];
+ *out++ = pair.leftDim[1];
+ for (nat32 i=0;i<9;i++) *out++ = pair.unRectRight[i/3][i%3];
+ *out++ = pair.rightDim[0];
+ *out++ = pair.rightDim[1];
+}
+
+void RigCache::Unflatten(const real64 * in,CameraPair & pair)
+{
+ CameraCalibration * cal[2] = {&pair.left,&pair.right};
+ for (nat32 c=0;c<2;c++)
+ {
+  for (nat32 i=0;i<9;i++) cal[c]->intrinsic[i/3][i%3] = *in++;
+  cal[c]->radial.aspectRatio = *in++;
+  cal[c]->radial.centre[0] = *in++;
+  cal[c]->radial.centre[1] = *in++;
+  for (nat32 i=0;i<4;i++) cal[c]->radial.k[i] = *in++;
+  cal[c]->dim[0] = *in++;
+  cal[c]->dim[1] = *in++;
+ }
+
+ for (nat32 i=0;i<9;i++) pair.fun[i/3][i%3] = *in++;
+ pair.gap = *in++;
+ for (nat32 i=0;i<12;i++) pair.lp[i/4][i%4] = *in++;
+ for (nat32 i=0;i<12;i++) pair.rp[i/4][i%4] = *in++;
+ for (nat32 i=0;i<9;i++) pair.unRectLeft[i/3][i%3] = *in++;
+ pair.leftDim[0] = *in++;
+ pair.leftDim[1] = *in++;
+ for (nat32 i=0;i<9;i++) pair.unRectRight[i/3][i%3] = *in++;
+ pair.rightDim[0] = *in++;
+ pair.rightDim[1] = *in++;
+}
+
+void RigCache::Clear()
+{
+ valid = false;
+ for (nat32 i=0;i<4;i++) key[i] = 0;
+ math::Identity(rectLeft);
+ math::Identity(rectRight);
+ epiLeft[0] = 0.0; epiLeft[1] = 0.0; epiLeft[2] = 1.0;
+ epiRight[0] = 0.0; epiRight[1] = 0.0; epiRight[2] = 1.0;
+ hasDisp = false;
+ dispA = 0.0;
+ dispB = 0.0;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,175 @@
+#ifndef EOS_CAM_RIG_CACHE_H
+#define EOS_CAM_RIG_CACHE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file rig_cache.h
+/// Provides a cache of everything derived from a CameraPair for processing
+/// images captured with it, so a fixed rig only has to work it out once.
+
+#include "eos/types.h"
+#include "eos/cam/cameras.h"
+#include "eos/cam/files.h"
+#include "eos/cam/rectification.h"
+#include "eos/str/strings.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace cam
+ {
+//------------------------------------------------------------------------------
+/// Holds the per rig data for a calibrated camera pair - the rectifying
+/// transforms and the RectifyMap's that apply them, undistortion tables for the
+/// input images, the epipoles, the inverse of the un-rectifying matrices that
+/// CameraPair::Project wants and the disparity to depth relationship of the
+/// rectified pair. All are calculated exactly as a single call to PlaneRectify
+/// would, given the calibration scaled to the size of the input images.
+///
+/// The cache is keyed by an md5 of the calibration, the image sizes and the
+/// samples, so it can be handed pair after pair and only does any work when
+/// the rig changes. It can also be saved, next to the .pcc, so the work is
+/// shared between runs - Get handles all of this.
+class EOS_CLASS RigCache
+{
+ public:
+  /// Creates an empty cache, that matches nothing.
+   RigCache();
+
+  /// &nbsp;
+   ~RigCache();
+
+
+  /// Makes the cache valid for the given calibration and input image sizes,
+  /// doing nothing if it allready is. Otherwise, if fn is given and a cache
+  /// saved there matches it is loaded, else it is built, and then saved to fn
+  /// if given, overwriting whatever was there. samples is as for PlaneRectify.
+  /// Returns false if the pair can not be rectified.
+   bit Get(const CameraPair & pair,nat32 leftWidth,nat32 leftHeight,
+           nat32 rightWidth,nat32 rightHeight,nat32 samples = 1,
+           cstrconst fn = null<cstrconst>(),time::Progress * prog = null<time::Progress*>());
+
+  /// Builds the cache, regardless of what it currently holds. Returns false if
+  /// the pair can not be rectified, in which case it is left empty.
+   bit Build(const CameraPair & pair,nat32 leftWidth,nat32 leftHeight,
+             nat32 rightWidth,nat32 rightHeight,nat32 samples = 1,
+             time::Progress * prog = null<time::Progress*>());
+
+  /// Returns true if the cache holds the data for the given calibration and
+  /// sizes. Costs an md5 of the calibration.
+   bit Matches(const CameraPair & pair,nat32 leftWidth,nat32 leftHeight,
+               nat32 rightWidth,nat32 rightHeight,nat32 samples = 1) const;
+
+  /// Returns true if the cache holds anything.
+   bit Valid() const {return valid;}
+
+
+  /// Returns the calibration after rectification, as the images made by
+  /// the maps need - the un-rectifying matrices and sizes are set and the
+  /// radial distortion is zeroed.
+   const CameraPair & Pair() const {return rect;}
+
+  /// The map to rectify the left image with.
+   const RectifyMap & LeftMap() const {return leftMap;}
+
+  /// The map to rectify the right image with.
+   const RectifyMap & RightMap() const {return rightMap;}
+
+  /// An undistortion table for the left input image.
+   const UnDisMap & LeftUnDis() const {return leftUnDis;}
+
+  /// An undistortion table for the right input image.
+   const UnDisMap & RightUnDis() const {return rightUnDis;}
+
+  /// The inverse of Pair().unRectLeft, to pass to CameraPair::Project.
+   const math::Mat<3,3,real64> & RectLeft() const {return rectLeft;}
+
+  /// The inverse of Pair().unRectRight, to pass to CameraPair::Project.
+   const math::Mat<3,3,real64> & RectRight() const {return rectRight;}
+
+  /// The epipole in the left input image, undistorted coordinates.
+   const math::Vect<3,real64> & EpipoleLeft() const {return epiLeft;}
+
+  /// The epipole in the right input image, undistorted coordinates.
+   const math::Vect<3,real64> & EpipoleRight() const {return epiRight;}
+
+  /// Outputs the parameters of depth = a/(disparity+b) for the rectified
+  /// pair, as CameraPair::GetDispToDepth. Returns false, leaving them alone,
+  /// if they could not be calculated.
+   bit DispToDepth(real64 & a,real64 & b) const
+   {
+    if (!hasDisp) return false;
+    a = dispA; b = dispB;
+    return true;
+   }
+
+
+  /// Saves the cache, returning true on success.
+   bit Save(cstrconst fn,bit overwrite = false) const;
+
+  /// Saves the cache, returning true on success.
+   bit Save(const str::String & fn,bit overwrite = false) const;
+
+  /// Loads a cache saved with Save, returning true on success. On failure the
+  /// cache is left empty. Use Matches to check it is the right one.
+   bit Load(cstrconst fn);
+
+  /// Loads a cache saved with Save, returning true on success. On failure the
+  /// cache is left empty. Use Matches to check it is the right one.
+   bit Load(const str::String & fn);
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::cam::RigCache";}
+
+
+ private:
+  bit valid;
+  nat32 key[4]; // md5 of the calibration, sizes and samples.
+
+  CameraPair rect;
+  RectifyMap leftMap;
+  RectifyMap rightMap;
+  UnDisMap leftUnDis;
+  UnDisMap rightUnDis;
+  math::Mat<3,3,real64> rectLeft;
+  math::Mat<3,3,real64> rectRight;
+  math::Vect<3,real64> epiLeft;
+  math::Vect<3,real64> epiRight;
+  bit hasDisp;
+  real64 dispA;
+  real64 dispB;
+
+  // Calculates the key for a calibration...
+   static void MakeKey(const CameraPair & pair,nat32 leftWidth,nat32 leftHeight,
+                       nat32 rightWidth,nat32 rightHeight,nat32 samples,nat32 out[4]);
+
+  // Converts a pair to and from a flat array of numbers, for hashing and
+  // saving...
+   static const nat32 pairReals = 92;
+   static void Flatten(const CameraPair & pair,real64 * out);
+   static void Unflatten(const real64 * in,CameraPair & pair);
+
+  // Empties the cache...
+   void Clear();
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -19,6 +19,7 @@
 
 #include "eos/svt/var.h"
 #include "eos/math/eigen.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -60,6 +61,9 @@ EOS_FUNC void RectifiedPos(const Intrinsic & intr,const Radial * rad,
  math::Mat<3,3,real64> temp;
  math::Inverse(invIntr,temp);
 
+ UnDisMap unDis;
+ if (rad) unDis.Build(*rad,disp.Size(0),disp.Size(1));
+
  for (nat32 y=0;y<disp.Size(1);y++)
  {
   for (nat32 x=0;x<disp.Size(0);x++)
@@ -80,7 +84,7 @@ EOS_FUNC void RectifiedPos(const Intrinsic & intr,const Radial * rad,
 
       in[0] = x;
       in[1] = y;
-      rad->UnDis(in,out);
+      unDis.UnDis(in,out);
 
       p[0] = out[0];
       p[1] = out[1];
@@ -127,6 +131,9 @@ EOS_FUNC void RectifiedNeedle(const Intrinsic & intr,const Radial * rad,
   math::Mat<3,3,real64> temp;
   math::Inverse(invIntr,temp);
 
+  UnDisMap unDis;
+  if (rad) unDis.Build(*rad,disp.Size(0),disp.Size(1));
+
   for (nat32 y=1;y<disp.Size(1)-1;y++)
   {
    for (nat32 x=1;x<disp.Size(0)-1;x++)
@@ -145,7 +152,7 @@ EOS_FUNC void RectifiedNeedle(const Intrinsic & intr,const Radial * rad,
 
        in[0] = x;
        in[1] = y;
-       rad->UnDis(in,out);
+       unDis.UnDis(in,out);
 
        p[0] = out[0];
        p[1] = out[1];
@@ -203,6 +210,9 @@ EOS_FUNC void OrthoNeedle(const Intrinsic & intr,const Radial * rad,
  math::Mat<3,3,real64> temp;
  math::Inverse(invIntr,temp);
 
+ UnDisMap unDis;
+ if (rad) unDis.Build(*rad,needle.Size(0),needle.Size(1));
+
  for (nat32 y=0;y<needle.Size(1);y++)
  {
   for (nat32 x=0;x<needle.Size(0);x++)
@@ -217,7 +227,7 @@ EOS_FUNC void OrthoNeedle(const Intrinsic & intr,const Radial * rad,
 
      in[0] = x;
      in[1] = y;
-     rad->UnDis(in,out);
+     unDis.UnDis(in,out);
 
      p[0] = out[0];
      p[1] = out[1];
@@ -252,10 +262,13 @@ EOS_FUNC void OrthoNeedle(const Intrinsic & intr,const Radial * rad,
 }
 
 //------------------------------------------------------------------------------
-EOS_FUNC bit CorrectMatch(math::Vect<2,real64> & pa,math::Vect<2,real64> & pb,
-                          const Fundamental & fun)
+// The guts of CorrectMatch, given the epipoles of fun, which are the only
+// decomposition it needs - this way a batch of matches only has to find them
+// once...
+static bit CorrectMatchEpi(math::Vect<2,real64> & pa,math::Vect<2,real64> & pb,
+                           const Fundamental & fun,
+                           const math::Vect<3,real64> & epiA,const math::Vect<3,real64> & epiB)
 {
- //LogBlock("eos::cam::CorrectMatch","{pa,pb,fun}" << LogDiv() << pa << LogDiv() << pb << LogDiv() << fun);
  // This is all taken directly from the eyeball book, page 318 in 2nd edition...
   // Create the inverse transformations...
    math::Mat<3,3,real64> ta;
@@ -280,17 +293,19 @@ EOS_FUNC bit CorrectMatch(math::Vect<2,real64> & pa,math::Vect<2,real64> & pb,
 
    //LogDebug("{fun2}" << LogDiv() << fun2);
 
-  // Compute both epipoles of the 2nd fun matrix, normalise them both...
+  // Compute both epipoles of the 2nd fun matrix, by translating the
+  // epipoles of the original, normalise them both...
    math::Vect<3,real64> ea;
    math::Vect<3,real64> eb;
 
-   Fundamental fun3;
-   fun3 = fun2;
-   math::RightNullSpace(fun3,ea);
-   fun3 = fun2;
-   math::Transpose(fun3);
-   math::RightNullSpace(fun3,eb);
+   ea[0] = epiA[0] - pa[0]*epiA[2];
+   ea[1] = epiA[1] - pa[1]*epiA[2];
+   ea[2] = epiA[2];
+   eb[0] = epiB[0] - pb[0]*epiB[2];
+   eb[1] = epiB[1] - pb[1]*epiB[2];
+   eb[2] = epiB[2];
 
+   Fundamental fun3;
    ea /= math::Sqrt(math::Sqr(ea[0]) + math::Sqr(ea[1]));
    eb /= math::Sqrt(math::Sqr(eb[0]) + math::Sqr(eb[1]));
 
@@ -439,6 +454,22 @@ EOS_FUNC bit CorrectMatch(math::Vect<2,real64> & pa,math::Vect<2,real64> & pb,
  return true;
 }
 
+EOS_FUNC bit CorrectMatch(math::Vect<2,real64> & pa,math::Vect<2,real64> & pb,
+                          const Fundamental & fun)
+{
+ //LogBlock("eos::cam::CorrectMatch","{pa,pb,fun}" << LogDiv() << pa << LogDiv() << pb << LogDiv() << fun);
+ math::Vect<3,real64> epiA;
+ math::Vect<3,real64> epiB;
+
+ Fundamental temp = fun;
+ math::RightNullSpace(temp,epiA);
+ temp = fun;
+ math::Transpose(temp);
+ math::RightNullSpace(temp,epiB);
+
+ return CorrectMatchEpi(pa,pb,fun,epiA,epiB);
+}
+
 
 //------------------------------------------------------------------------------
 EOS_FUNC bit Triangulate(const math::Vect<2,real64> & pa,const math::Vect<2,real64> & pb,
@@ -497,6 +528,101 @@ EOS_FUNC bit Triangulate(const math::Vect<3,real64> & pa,const math::Vect<3,real
  return true;
 }
 
+//------------------------------------------------------------------------------
+// Functor used by CorrectTriangulate...
+class CorrectTriangulateRange
+{
+ public:
+  CorrectTriangulateRange(const ds::Array<math::Vect<2,real64> > & a,const ds::Array<math::Vect<2,real64> > & b,
+                          const Fundamental & f,const math::Vect<3,real64> & ea,const math::Vect<3,real64> & eb,
+                          const Camera & cA,const Camera & cB,
+                          ds::Array<math::Vect<4,real64> > & o,ds::Array<bit> & v,
+                          ds::Array<math::Vect<2,real64> > * crA,ds::Array<math::Vect<2,real64> > * crB)
+  :pa(a),pb(b),fun(f),epiA(ea),epiB(eb),ca(cA),cb(cB),out(o),valid(v),corrA(crA),corrB(crB)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++)
+   {
+    math::Vect<2,real64> a = pa[i];
+    math::Vect<2,real64> b = pb[i];
+
+    bit ok = CorrectMatchEpi(a,b,fun,epiA,epiB);
+    if (ok) ok = Triangulate(a,b,ca,cb,out[i]);
+    if (!ok) for (nat32 j=0;j<4;j++) out[i][j] = 0.0;
+    valid[i] = ok;
+
+    if (corrA) (*corrA)[i] = a;
+    if (corrB) (*corrB)[i] = b;
+   }
+  }
+
+
+ private:
+  const ds::Array<math::Vect<2,real64> > & pa;
+  const ds::Array<math::Vect<2,real64> > & pb;
+  const Fundamental & fun;
+  const math::Vect<3,real64> & epiA;
+  const math::Vect<3,real64> & epiB;
+  const Camera & ca;
+  const Camera & cb;
+  ds::Array<math::Vect<4,real64> > & out;
+  ds::Array<bit> & valid;
+  ds::Array<math::Vect<2,real64> > * corrA;
+  ds::Array<math::Vect<2,real64> > * corrB;
+};
+
+EOS_FUNC nat32 CorrectTriangulate(const ds::Array<math::Vect<2,real64> > & pa,
+                                  const ds::Array<math::Vect<2,real64> > & pb,
+                                  const Fundamental & fun,const Camera & ca,const Camera & cb,
+                                  ds::Array<math::Vect<4,real64> > & out,ds::Array<bit> & valid,
+                                  ds::Array<math::Vect<2,real64> > * corrA,
+                                  ds::Array<math::Vect<2,real64> > * corrB)
+{
+ LogTime("eos::cam::CorrectTriangulate");
+ log::Assert(pa.Size()==pb.Size(),"cam::CorrectTriangulate");
+
+ // Prepare the outputs...
+  out.Size(pa.Size());
+  valid.Size(pa.Size());
+  if (corrA) corrA->Size(pa.Size());
+  if (corrB) corrB->Size(pa.Size());
+
+ // The epipoles, shared by all matches...
+  math::Vect<3,real64> epiA;
+  math::Vect<3,real64> epiB;
+  {
+   Fundamental temp = fun;
+   math::RightNullSpace(temp,epiA);
+   temp = fun;
+   math::Transpose(temp);
+   math::RightNullSpace(temp,epiB);
+  }
+
+ // Do the work...
+  CorrectTriangulateRange ctr(pa,pb,fun,epiA,epiB,ca,cb,out,valid,corrA,corrB);
+  mt::ParallelFor(nat32(0),pa.Size(),ctr,64);
+
+ // Count the survivors...
+  nat32 ret = 0;
+  for (nat32 i=0;i<valid.Size();i++)
+  {
+   if (valid[i]) ++ret;
+  }
+ return ret;
+}
+
+EOS_FUNC nat32 CorrectTriangulate(const ds::Array<math::Vect<2,real64> > & pa,
+                                  const ds::Array<math::Vect<2,real64> > & pb,
+                                  const CameraPair & pair,
+                                  ds::Array<math::Vect<4,real64> > & out,ds::Array<bit> & valid,
+                                  ds::Array<math::Vect<2,real64> > * corrA,
+                                  ds::Array<math::Vect<2,real64> > * corrB)
+{
+ return CorrectTriangulate(pa,pb,pair.fun,pair.lp,pair.rp,out,valid,corrA,corrB);
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC bit Depth(const math::Vect<2,real64> & pa,const math::Vect<2,real64> & pb,
                    const Camera & ca,const Camera & cb,
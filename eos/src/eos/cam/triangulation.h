@@ -25,6 +25,8 @@
 
 #include "eos/types.h"
 #include "eos/cam/cameras.h"
+#include "eos/cam/files.h"
+#include "eos/ds/arrays.h"
 #include "eos/svt/field.h"
 #include "eos/bs/geo3d.h"
 
@@ -110,6 +112,33 @@ EOS_FUNC bit Triangulate(const math::Vect<3,real64> & pa,const math::Vect<3,real
                          const Camera & ca,const Camera & cb,
                          math::Vect<4,real64> & out);
 
+//------------------------------------------------------------------------------
+/// Does CorrectMatch followed by Triangulate for an array of matches at once,
+/// as for sparse reconstruction from feature matches. The matches are split
+/// between the threads of the task pool, and the epipoles CorrectMatch needs
+/// are only found once rather than for every match. pa and pb must be the same
+/// size, out and valid are resized to match. A match is invalid if correcting
+/// or triangulating it fails, in which case its position is zeroed.
+/// corrA and corrB, if given, are resized and set to the corrected matches,
+/// which are left as given where correction fails.
+/// Returns how many matches are valid.
+EOS_FUNC nat32 CorrectTriangulate(const ds::Array<math::Vect<2,real64> > & pa,
+                                  const ds::Array<math::Vect<2,real64> > & pb,
+                                  const Fundamental & fun,const Camera & ca,const Camera & cb,
+                                  ds::Array<math::Vect<4,real64> > & out,ds::Array<bit> & valid,
+                                  ds::Array<math::Vect<2,real64> > * corrA = null<ds::Array<math::Vect<2,real64> >*>(),
+                                  ds::Array<math::Vect<2,real64> > * corrB = null<ds::Array<math::Vect<2,real64> >*>());
+
+/// Version of CorrectTriangulate that takes the fundamental matrix and cameras
+/// from a CameraPair. The matches must be in the coordinates of its lp and rp,
+/// i.e. undistorted and without the un-rectifying transforms applied.
+EOS_FUNC nat32 CorrectTriangulate(const ds::Array<math::Vect<2,real64> > & pa,
+                                  const ds::Array<math::Vect<2,real64> > & pb,
+                                  const CameraPair & pair,
+                                  ds::Array<math::Vect<4,real64> > & out,ds::Array<bit> & valid,
+                                  ds::Array<math::Vect<2,real64> > * corrA = null<ds::Array<math::Vect<2,real64> >*>(),
+                                  ds::Array<math::Vect<2,real64> > * corrB = null<ds::Array<math::Vect<2,real64> >*>());
+
 //------------------------------------------------------------------------------
 /// Identical to triangulate, except it outputs depth as in distance along the 
 /// cameras principal axis rather than an actual coordinate.
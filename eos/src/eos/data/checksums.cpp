@@ -18,6 +18,13 @@
 #include "eos/data/checksums.h"
 
 #include "eos/mem/functions.h"
+#include "eos/math/functions.h"
+#include "eos/ds/arrays.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE4_2__
+ #include <nmmintrin.h>
+#endif
 
 namespace eos
 {
@@ -60,10 +67,10 @@ const nat16 crc16Table[256] = {
 	                       0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
 	                      };
 
-nat32 Crc16::Write(void * in,nat32 bytes)
+nat32 Crc16::Write(const void * in,nat32 bytes)
 {
- byte * targ = static_cast<byte*>(in);
- byte * end = targ + bytes;
+ const byte * targ = static_cast<const byte*>(in);
+ const byte * end = targ + bytes;
  while (targ!=end)
  {
   crc = crc16Table[targ[0]^(crc>>8)] ^ (crc<<8);
@@ -132,7 +139,10 @@ void Md5::Get(nat32 out[4]) const
  for (nat32 i=0;i<4;i++) out[i] = md5[i];
  
  // Add in the last bit of the calculation, either 2 chunks or one chunk depending on remaider.
+ // The data is terminated with a single set bit before the padding...
  nat32 rem = amount%64;
+ const_cast<byte*>(data)[rem] = 0x80;
+ ++rem;
  if (rem>56)
  {
   // 2 blocks - pad with zeros the last block then add in, before creating a final 
@@ -156,30 +166,52 @@ void Md5::Get(nat32 out[4]) const
  }
 }
 
-nat32 Md5::Write(void * in,nat32 bytes)
+nat32 Md5::Write(const void * in,nat32 bytes)
 {
  nat32 ret = bytes;
-  while (true)
+ const byte * targ = static_cast<const byte*>(in);
+
+ // Top up a partial block first...
+  nat32 dsf = amount%64;
+  if (dsf!=0)
   {
-   nat32 dsf = amount%64;
-   if (dsf+bytes>=64)
+   nat32 atd = math::Min(64-dsf,bytes);
+   mem::Copy(data+dsf,targ,atd);
+   targ += atd;
+   bytes -= atd;
+   amount += atd;
+   if (dsf+atd!=64) return ret;
+   AddBlock((nat32*)data,md5);
+  }
+
+ // Then whole blocks straight from the input, skipping the copy when it is
+ // aligned...
+  if ((reinterpret_cast<size_t>(targ)&3)==0)
+  {
+   while (bytes>=64)
    {
-    nat32 atd = 64-dsf;
-    
-    mem::Copy(data+dsf,(byte*)in,atd);
-    AddBlock((nat32*)data,md5);
-    
-    bytes -= atd;
-    in = (byte*)in + atd;
-    amount += atd;       
+    AddBlock(reinterpret_cast<const nat32*>(targ),md5);
+    targ += 64;
+    bytes -= 64;
+    amount += 64;
    }
-   else
+  }
+  else
+  {
+   while (bytes>=64)
    {
-    mem::Copy(data+dsf,(byte*)in,bytes);
-    amount += bytes;
-    break;       
+    mem::Copy(data,targ,64);
+    AddBlock((nat32*)data,md5);
+    targ += 64;
+    bytes -= 64;
+    amount += 64;
    }
   }
+
+ // Keep the remainder...
+  mem::Copy(data,targ,bytes);
+  amount += bytes;
+
  return ret;       
 }
     
@@ -209,7 +241,7 @@ nat32 Md5::Pad(nat32 bytes)
  return ret;       
 }
     
-void Md5::AddBlock(nat32 block[16],nat32 md5[4])
+void Md5::AddBlock(const nat32 block[16],nat32 md5[4])
 {
  nat32 a = md5[0];
  nat32 b = md5[1];
@@ -254,6 +286,301 @@ void Md5::AddBlock(nat32 block[16],nat32 md5[4])
  md5[3] += d;
 }
 
+//------------------------------------------------------------------------------
+// Slice-by-8 tables for the crc32, the first is the normal byte at a time table
+// and table k advances the crc by k further zero bytes...
+class Crc32Tables
+{
+ public:
+  nat32 t[8][256];
+
+  Crc32Tables()
+  {
+   for (nat32 i=0;i<256;i++)
+   {
+    nat32 c = i;
+    for (nat32 j=0;j<8;j++) c = (c>>1) ^ ((c&1)?0x82F63B78:0);
+    t[0][i] = c;
+   }
+
+   for (nat32 k=1;k<8;k++)
+   {
+    for (nat32 i=0;i<256;i++) t[k][i] = (t[k-1][i]>>8) ^ t[0][t[k-1][i]&0xFF];
+   }
+  }
+};
+
+static const Crc32Tables crc32Tables;
+
+nat32 Crc32::Write(const void * in,nat32 bytes)
+{
+ const byte * targ = static_cast<const byte*>(in);
+ const byte * end = targ + bytes;
+ nat32 c = crc;
+
+ #ifdef __SSE4_2__
+  while ((targ!=end)&&((reinterpret_cast<size_t>(targ)&7)!=0)) c = _mm_crc32_u8(c,*targ++);
+  #ifdef __x86_64__
+   nat64 c64 = c;
+   while (end-targ>=8)
+   {
+    c64 = _mm_crc32_u64(c64,*reinterpret_cast<const nat64*>(targ));
+    targ += 8;
+   }
+   c = nat32(c64);
+  #else
+   while (end-targ>=4)
+   {
+    c = _mm_crc32_u32(c,*reinterpret_cast<const nat32*>(targ));
+    targ += 4;
+   }
+  #endif
+  while (targ!=end) c = _mm_crc32_u8(c,*targ++);
+ #else
+  const nat32 (*t)[256] = crc32Tables.t;
+  while ((targ!=end)&&((reinterpret_cast<size_t>(targ)&3)!=0)) c = (c>>8) ^ t[0][(c^*targ++)&0xFF];
+  while (end-targ>=8)
+  {
+   nat32 a = c ^ (nat32(targ[0]) | (nat32(targ[1])<<8) | (nat32(targ[2])<<16) | (nat32(targ[3])<<24));
+   c = t[7][a&0xFF] ^ t[6][(a>>8)&0xFF] ^ t[5][(a>>16)&0xFF] ^ t[4][a>>24] ^
+       t[3][targ[4]] ^ t[2][targ[5]] ^ t[1][targ[6]] ^ t[0][targ[7]];
+   targ += 8;
+  }
+  while (targ!=end) c = (c>>8) ^ t[0][(c^*targ++)&0xFF];
+ #endif
+
+ crc = c;
+ return bytes;
+}
+
+nat32 Crc32::Pad(nat32 bytes)
+{
+ static const byte zeros[64] = {0};
+ nat32 ret = bytes;
+ while (bytes!=0)
+ {
+  nat32 amount = math::Min<nat32>(bytes,64);
+  Write(zeros,amount);
+  bytes -= amount;
+ }
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// Constants and helpers for Hash64...
+static const nat64 xxPrime1 = 11400714785074694791ULL;
+static const nat64 xxPrime2 = 14029467366897019727ULL;
+static const nat64 xxPrime3 = 1609587929392839161ULL;
+static const nat64 xxPrime4 = 9650029242287828579ULL;
+static const nat64 xxPrime5 = 2870177450012600261ULL;
+
+inline nat64 XxRot(nat64 x,nat32 r)
+{
+ return (x<<r) | (x>>(64-r));
+}
+
+inline nat64 XxRead64(const byte * in)
+{
+ nat64 ret;
+ mem::Copy(reinterpret_cast<byte*>(&ret),in,8);
+ return ret;
+}
+
+inline nat32 XxRead32(const byte * in)
+{
+ nat32 ret;
+ mem::Copy(reinterpret_cast<byte*>(&ret),in,4);
+ return ret;
+}
+
+inline nat64 XxRound(nat64 acc,nat64 in)
+{
+ acc += in * xxPrime2;
+ acc = XxRot(acc,31);
+ return acc * xxPrime1;
+}
+
+inline nat64 XxMerge(nat64 acc,nat64 val)
+{
+ acc ^= XxRound(0,val);
+ return acc*xxPrime1 + xxPrime4;
+}
+
+Hash64::Hash64(nat64 s)
+{
+ Reset(s);
+}
+
+Hash64::Hash64(const Hash64 & rhs)
+{
+ *this = rhs;
+}
+
+void Hash64::Reset(nat64 s)
+{
+ seed = s;
+ amount = 0;
+ v[0] = seed + xxPrime1 + xxPrime2;
+ v[1] = seed + xxPrime2;
+ v[2] = seed;
+ v[3] = seed - xxPrime1;
+}
+
+Hash64 & Hash64::operator = (const Hash64 & rhs)
+{
+ for (nat32 i=0;i<4;i++) v[i] = rhs.v[i];
+ seed = rhs.seed;
+ amount = rhs.amount;
+ mem::Copy(data,rhs.data,amount%32);
+ return *this;
+}
+
+nat64 Hash64::Get() const
+{
+ nat64 ret;
+ if (amount>=32)
+ {
+  ret = XxRot(v[0],1) + XxRot(v[1],7) + XxRot(v[2],12) + XxRot(v[3],18);
+  for (nat32 i=0;i<4;i++) ret = XxMerge(ret,v[i]);
+ }
+ else ret = seed + xxPrime5;
+ ret += amount;
+
+ // Mix in the tail...
+  const byte * targ = data;
+  const byte * end = data + amount%32;
+  while (end-targ>=8)
+  {
+   ret ^= XxRound(0,XxRead64(targ));
+   ret = XxRot(ret,27)*xxPrime1 + xxPrime4;
+   targ += 8;
+  }
+  if (end-targ>=4)
+  {
+   ret ^= nat64(XxRead32(targ)) * xxPrime1;
+   ret = XxRot(ret,23)*xxPrime2 + xxPrime3;
+   targ += 4;
+  }
+  while (targ!=end)
+  {
+   ret ^= nat64(*targ) * xxPrime5;
+   ret = XxRot(ret,11)*xxPrime1;
+   ++targ;
+  }
+
+ // Avalanche...
+  ret ^= ret>>33;
+  ret *= xxPrime2;
+  ret ^= ret>>29;
+  ret *= xxPrime3;
+  ret ^= ret>>32;
+
+ return ret;
+}
+
+nat32 Hash64::Write(const void * in,nat32 bytes)
+{
+ nat32 ret = bytes;
+ const byte * targ = static_cast<const byte*>(in);
+
+ // Top up a partial stripe first...
+  nat32 dsf = amount%32;
+  if (dsf!=0)
+  {
+   nat32 atd = math::Min(32-dsf,bytes);
+   mem::Copy(data+dsf,targ,atd);
+   targ += atd;
+   bytes -= atd;
+   amount += atd;
+   if (dsf+atd!=32) return ret;
+   for (nat32 i=0;i<4;i++) v[i] = XxRound(v[i],XxRead64(data+8*i));
+  }
+
+ // Whole stripes straight from the input, with the accumulators in registers...
+  nat64 v0 = v[0];
+  nat64 v1 = v[1];
+  nat64 v2 = v[2];
+  nat64 v3 = v[3];
+  const byte * end = targ + (bytes&~nat32(31));
+  while (targ!=end)
+  {
+   v0 = XxRound(v0,XxRead64(targ));
+   v1 = XxRound(v1,XxRead64(targ+8));
+   v2 = XxRound(v2,XxRead64(targ+16));
+   v3 = XxRound(v3,XxRead64(targ+24));
+   targ += 32;
+  }
+  v[0] = v0;
+  v[1] = v1;
+  v[2] = v2;
+  v[3] = v3;
+  amount += bytes&~nat32(31);
+
+ // Keep the remainder...
+  bytes &= 31;
+  mem::Copy(data,targ,bytes);
+  amount += bytes;
+
+ return ret;
+}
+
+nat32 Hash64::Pad(nat32 bytes)
+{
+ static const byte zeros[64] = {0};
+ nat32 ret = bytes;
+ while (bytes!=0)
+ {
+  nat32 a = math::Min<nat32>(bytes,64);
+  Write(zeros,a);
+  bytes -= a;
+ }
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// Helper for TreeHash - hashes a range of chunks...
+class TreeHashRange
+{
+ public:
+  TreeHashRange(const byte * d,nat64 b,nat64 s,nat32 c,nat64 * o)
+  :data(d),bytes(b),seed(s),chunk(c),out(o) {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   Hash64 hash;
+   for (nat32 i=begin;i<end;i++)
+   {
+    nat64 start = nat64(i)*nat64(chunk);
+    hash.Reset(seed);
+    hash.Write(data+start,nat32(math::Min<nat64>(chunk,bytes-start)));
+    out[i] = hash.Get();
+   }
+  }
+
+ private:
+  const byte * data;
+  nat64 bytes;
+  nat64 seed;
+  nat32 chunk;
+  nat64 * out;
+};
+
+EOS_FUNC nat64 TreeHash(const void * in,nat64 bytes,nat64 seed,nat32 chunk)
+{
+ if (chunk==0) chunk = 1024*1024;
+ nat32 chunks = nat32((bytes+chunk-1)/chunk);
+ 
+ ds::Array<nat64> leaf(chunks);
+ TreeHashRange range(static_cast<const byte*>(in),bytes,seed,chunk,leaf.Ptr());
+ if (chunks>1) mt::ParallelFor(0,chunks,range);
+          else range(0,chunks);
+
+ Hash64 ret(seed);
+ ret.Write(leaf.Ptr(),chunks*sizeof(nat64));
+ ret.Write(&bytes,sizeof(nat64));
+ return ret.Get();
+}
+
 //------------------------------------------------------------------------------
  };
 };
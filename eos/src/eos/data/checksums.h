@@ -70,7 +70,7 @@ class EOS_CLASS Crc16 : public io::Out<io::Binary>
   
   // For the Out interface...
    /// &nbsp;
-    nat32 Write(void * in,nat32 bytes);    
+    nat32 Write(const void * in,nat32 bytes);    
     
    /// &nbsp;
     nat32 Pad(nat32 bytes);
@@ -121,7 +121,7 @@ class EOS_CLASS Md5 : public io::Out<io::Binary>
   
   // For the Out interface...
    /// &nbsp;
-    nat32 Write(void * in,nat32 bytes);    
+    nat32 Write(const void * in,nat32 bytes);    
     
    /// &nbsp;
     nat32 Pad(nat32 bytes);
@@ -135,9 +135,130 @@ class EOS_CLASS Md5 : public io::Out<io::Binary>
   nat32 amount; // How much data has been absorbed into the object as a whole, amount%64 to get size of below.
   byte data[64]; // The data collected recently, when full its added into the md5 collected so far. 
   
-  static void AddBlock(nat32 block[16],nat32 md5[4]); // block is the chunk of data to be added, md5 is in and out.
+  static void AddBlock(const nat32 block[16],nat32 md5[4]); // block is the chunk of data to be added, md5 is in and out.
 };
 
+//------------------------------------------------------------------------------
+/// A crc32, using the Castagnoli polynomial (CRC-32C, as used by iSCSI and
+/// ext4), which has better error detection than the common zip polynomial and
+/// hardware support on recent x86 processors. Same interface as Crc16. Uses the
+/// SSE 4.2 crc32 instruction when compiled with it enabled, slice-by-8 tables
+/// otherwise, so it is several times faster than Crc16 either way.
+class EOS_CLASS Crc32 : public io::Out<io::Binary>
+{
+ public:
+  /// &nbsp;
+   Crc32():crc(0xFFFFFFFF) {}
+   
+  /// &nbsp;
+   Crc32(const Crc32 & rhs):crc(rhs.crc) {}
+   
+  /// &nbsp; 
+   ~Crc32() {}
+
+  /// Resets the structure as though no data has been fed into it.
+   void Reset() {crc = 0xFFFFFFFF;}
+    
+   
+  /// &nbsp;
+   Crc32 & operator = (const Crc32 & rhs) {crc = rhs.crc; return *this;}
+  
+  /// &nbsp;
+   bit operator == (const Crc32 & rhs) const {return crc==rhs.crc;}
+   
+  /// &nbsp;
+   bit operator != (const Crc32 & rhs) const {return crc!=rhs.crc;}
+  
+   
+  /// Returns the crc for all the data entered so far.
+   nat32 Get() const {return ~crc;}
+   
+  /// For setting the crc, from another source.
+   void Set(nat32 c) {crc = ~c;}
+  
+  // For the Out interface...
+   /// &nbsp;
+    nat32 Write(const void * in,nat32 bytes);    
+    
+   /// &nbsp;
+    nat32 Pad(nat32 bytes);
+
+    
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::data::Crc32";}
+  
+ private:
+  nat32 crc; // Kept inverted, as the algorithm wants.
+};
+
+//------------------------------------------------------------------------------
+/// A fast 64 bit non-cryptographic hash, the xxHash64 algorithm, for when you
+/// want to know if two large blocks of data are the same, e.g. for cache keys,
+/// rather than protect against someone making them collide on purpose. Runs
+/// at memory bandwidth, an order of magnitude faster than Md5. Has the same
+/// streaming interface as the other checksums, and a seed so independent
+/// hashes of the same data can be made.
+class EOS_CLASS Hash64 : public io::Out<io::Binary>
+{
+ public:
+  /// &nbsp;
+   Hash64(nat64 seed = 0);
+   
+  /// &nbsp;
+   Hash64(const Hash64 & rhs);
+   
+  /// &nbsp; 
+   ~Hash64() {}
+   
+  /// Resets the structure as though no data has been fed into it, with the
+  /// given seed.
+   void Reset(nat64 seed = 0);
+  
+   
+  /// &nbsp;
+   Hash64 & operator = (const Hash64 & rhs);
+  
+  /// &nbsp;
+   bit operator == (const Hash64 & rhs) const {return Get()==rhs.Get();}
+   
+  /// &nbsp;
+   bit operator != (const Hash64 & rhs) const {return Get()!=rhs.Get();}
+  
+   
+  /// Returns the hash for all the data entered so far. Involves a little
+  /// processing, so isn't a simple getter.
+   nat64 Get() const;
+  
+  // For the Out interface...
+   /// &nbsp;
+    nat32 Write(const void * in,nat32 bytes);    
+    
+   /// &nbsp;
+    nat32 Pad(nat32 bytes);
+
+    
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::data::Hash64";}
+  
+ private:
+  nat64 v[4]; // The 4 accumulators, one per 8 byte lane of each 32 byte stripe.
+  nat64 seed;
+  nat64 amount; // Total bytes absorbed, amount%32 is how much of data is in use.
+  byte data[32]; // Partial stripe waiting for more data.
+};
+
+//------------------------------------------------------------------------------
+/// Hashes a large block of memory with Hash64 using all the threads of the
+/// default mt::TaskPool. The block is divided into chunks of the given size,
+/// each is hashed independently, then the chunk hashes and total size are
+/// hashed to give the result. The result is therefore not the same as Hash64
+/// of the block, but only depends on the data and chunk size, not the number
+/// of threads. Blocks of a single chunk or less are hashed in the calling
+/// thread.
+EOS_FUNC nat64 TreeHash(const void * in,nat64 bytes,nat64 seed = 0,nat32 chunk = 1024*1024);
+
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
  };
 };
@@ -216,6 +337,64 @@ inline T & StreamWrite(T & lhs,const eos::data::Md5 & rhs,Text)
  return lhs;       
 }
 
+//------------------------------------------------------------------------------
+// Crc32...
+template <typename T>
+inline T & StreamWrite(T & lhs,const eos::data::Crc32 & rhs,Binary)
+{
+ lhs << rhs.Get();
+ return lhs;
+}
+
+template <typename T>
+inline T & StreamRead(T & lhs,eos::data::Crc32 & rhs,Binary)
+{
+ nat32 temp;
+ lhs >> temp;
+ rhs.Set(temp);
+ return lhs;
+}
+
+template <typename T>
+inline T & StreamWrite(T & lhs,const eos::data::Crc32 & rhs,Text)
+{
+ cstrchar t[9];
+ str::ToHex(rhs.Get(),t);
+ lhs << t;
+ return lhs;       
+}
+
+template <typename T>
+inline T & StreamRead(T & lhs,eos::data::Crc32 & rhs,Text)
+{
+ cstrchar d[8];
+ bit err = lhs.Read(d,8)!=8;
+ if (err) {lhs.SetError(err); return lhs;}
+ 
+ rhs.Set(str::FromHex<nat32>(d,err));
+ 
+ lhs.SetError(err);	
+ return lhs;
+}
+
+//------------------------------------------------------------------------------
+// Hash64 (no reading, as for Md5)...
+template <typename T>
+inline T & StreamWrite(T & lhs,const eos::data::Hash64 & rhs,Binary)
+{
+ lhs << rhs.Get();
+ return lhs;
+}
+
+template <typename T>
+inline T & StreamWrite(T & lhs,const eos::data::Hash64 & rhs,Text)
+{
+ cstrchar t[17];
+ str::ToHex(rhs.Get(),t);
+ lhs << t;
+ return lhs;       
+}
+
 //------------------------------------------------------------------------------	 
  };
 };
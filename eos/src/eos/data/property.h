@@ -20,9 +20,10 @@
 
 /// \file property.h
 /// Defines a templated class for accessing properties of a class. 
-/// Such properties could of been optionaly added at run-time via overloaded
-/// class allocation. For providing a typesafe interface to something 
-/// inherantly un-typesafe.
+/// Such properties could of been optionaly added at run-time, and are stored
+/// outside the class in columns, one per property, indexed by an id the class
+/// provides. For providing a typesafe interface to something inherantly
+/// un-typesafe.
 
 #include "eos/types.h"
 
@@ -31,15 +32,14 @@ namespace eos
  namespace data
  {
 //------------------------------------------------------------------------------
-// Function which returns the pointer given to it as a void*...
-template <typename T>
-void * DoNothing(T * t) {return t;}
-
-//------------------------------------------------------------------------------
-/// A property acts as an accessor for 'something' in a given class - it is 
-/// internally nothing more than a templated class that has an offset in bytes
-/// from the pointers given to the relevant data. Provided to encapsulate the
-/// extremely unsafe nature of anything using such a system.
+/// A property acts as an accessor for 'something' attached to a given class - 
+/// the values of each property are stored in a column, an array with one entry
+/// per instance, and this is nothing more than a templated class holding a
+/// pointer to where the column is stored and a function that gets an instances
+/// id, i.e. its entry in the column. As it holds a pointer to the column
+/// pointer the column may be moved, for instance when it grows, without 
+/// invalidating the property. Provided to encapsulate the extremely unsafe 
+/// nature of anything using such a system.
 /// Templated type T is the class it may be called on, templated class P is the
 /// type of the property itself.
 template <typename T,typename P>
@@ -47,54 +47,54 @@ class EOS_CLASS Property
 {
  public:
   /// Leaves it as a (dangerous) dud - make sure to assign to it before use!
-   Property():offset(0),F(DoNothing<T>) {}
+   Property():column(null<byte**>()),stride(0),F(null<nat32 (*)(T*)>()) {}
 
   /// &nbsp;
-   Property(const Property<T,P> & rhs):offset(rhs.offset),F(rhs.F) {}
+   Property(const Property<T,P> & rhs):column(rhs.column),stride(rhs.stride),F(rhs.F) {}
 
-  /// Constructs it - this should only be called by a class that 'knows' the 
-  /// structure of T. An Offset of 0 is used to indicate a dud, so you can't 
-  /// have a data blob that is entirelly dedicated to Propertys.
-  /// os is the offset, func is called on the object pointer before use, 
-  /// the offset is then in bytes from the returned value. The default
-  /// returns what it is given.
-   Property(nat32 os,void * (*func)(T * t) = DoNothing<T>)
-   :offset(os),F(func) {}
+  /// Constructs it - this should only be called by a class that 'knows' how
+  /// T stores its properties. col is where the pointer to the column is kept,
+  /// st the size of each entry in bytes and func returns the entry index for
+  /// an instance.
+   Property(byte * const * col,nat32 st,nat32 (*func)(T * t))
+   :column(col),stride(st),F(func) {}
 
   /// &nbsp;
    ~Property() {}
 
 
   /// &nbsp;
-   Property & operator = (const Property & rhs) {offset = rhs.offset; F = rhs.F; return *this;}
+   Property & operator = (const Property & rhs) {column = rhs.column; stride = rhs.stride; F = rhs.F; return *this;}
 
 
   /// Returns true if the class is suposed to be safe to use.
-   bit Valid() const {return offset!=0;}
+   bit Valid() const {return column!=null<byte**>();}
 
 
   /// This provides access to the property - you give it an instance of T and it
   /// returns a reference to a P.
    P & Get(T & t) const 
    {
-    void * start = F(&t);
-    void * pos = (byte*)start + offset;
-    return *(P*)pos;
+    return *(P*)(void*)(*column + F(&t)*stride);
    }
 
   /// This provides access to the property - you give it an instance of T and it
   /// returns a reference to a P.
    const P & Get(const T & t) const
    {
-    void * start = F(const_cast<T*>(&t));
-    void * pos = (byte*)start + offset;
-    return *(P*)pos;
+    return *(P*)(void*)(*column + F(const_cast<T*>(&t))*stride);
    }
 
+  /// Returns the column itself, for bulk operations, indexed by the id. Only
+  /// valid until the column next moves, and only meaningful when P is the 
+  /// type actually stored.
+   P * Column() const {return (P*)(void*)*column;}
+
 
  private:
-  nat32 offset;
-  void * (*F)(T * t);
+  byte * const * column;
+  nat32 stride;
+  nat32 (*F)(T * t);
 };
 
 //------------------------------------------------------------------------------
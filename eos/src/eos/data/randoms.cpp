@@ -19,6 +19,11 @@
 
 #include "eos/time/times.h"
 #include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#endif
  
 namespace eos
 {
@@ -235,6 +240,257 @@ nat32 Random::Next()
  return val;
 }
 
+//------------------------------------------------------------------------------
+// The constants of Philox4x32...
+ static const nat32 philoxM0 = 0xD2511F53;
+ static const nat32 philoxM1 = 0xCD9E8D57;
+ static const nat32 philoxW0 = 0x9E3779B9;
+ static const nat32 philoxW1 = 0xBB67AE85;
+
+// Outputs the 4 words of a block. The counter is the block index in the
+// first two words and the stream in the second two...
+inline void Philox(const nat32 key[2],nat64 stream,nat64 block,nat32 out[4])
+{
+ nat32 c0 = nat32(block);
+ nat32 c1 = nat32(block>>32);
+ nat32 c2 = nat32(stream);
+ nat32 c3 = nat32(stream>>32);
+ nat32 k0 = key[0];
+ nat32 k1 = key[1];
+
+ for (nat32 r=0;r<10;r++)
+ {
+  nat64 p0 = nat64(philoxM0) * nat64(c0);
+  nat64 p1 = nat64(philoxM1) * nat64(c2);
+
+  c0 = nat32(p1>>32) ^ c1 ^ k0;
+  c1 = nat32(p1);
+  c2 = nat32(p0>>32) ^ c3 ^ k1;
+  c3 = nat32(p0);
+
+  k0 += philoxW0;
+  k1 += philoxW1;
+ }
+
+ out[0] = c0;
+ out[1] = c1;
+ out[2] = c2;
+ out[3] = c3;
+}
+
+// Outputs a run of blocks, 4*count words, doing 4 blocks at once when SSE2 is
+// available. Identical results either way...
+static void PhiloxRun(const nat32 key[2],nat64 stream,nat64 block,nat32 count,nat32 * out)
+{
+ nat32 i = 0;
+ #ifdef __SSE2__
+  const __m128i m0 = _mm_set1_epi32(philoxM0);
+  const __m128i m1 = _mm_set1_epi32(philoxM1);
+  const __m128i w0 = _mm_set1_epi32(philoxW0);
+  const __m128i w1 = _mm_set1_epi32(philoxW1);
+  const __m128i lowMask = _mm_set_epi32(0,-1,0,-1);
+
+  for (;i+4<=count;i+=4)
+  {
+   // Each lane is a block...
+    nat64 b = block + i;
+    __m128i c0 = _mm_set_epi32(nat32(b+3),nat32(b+2),nat32(b+1),nat32(b));
+    __m128i c1 = _mm_set_epi32(nat32((b+3)>>32),nat32((b+2)>>32),nat32((b+1)>>32),nat32(b>>32));
+    __m128i c2 = _mm_set1_epi32(nat32(stream));
+    __m128i c3 = _mm_set1_epi32(nat32(stream>>32));
+    __m128i k0 = _mm_set1_epi32(key[0]);
+    __m128i k1 = _mm_set1_epi32(key[1]);
+
+   // The rounds - _mm_mul_epu32 only does lanes 0 and 2, so the odd lanes are
+   // shifted down and done seperatly...
+    for (nat32 r=0;r<10;r++)
+    {
+     __m128i p0e = _mm_mul_epu32(c0,m0);
+     __m128i p0o = _mm_mul_epu32(_mm_srli_epi64(c0,32),m0);
+     __m128i lo0 = _mm_or_si128(_mm_and_si128(p0e,lowMask),_mm_slli_epi64(p0o,32));
+     __m128i hi0 = _mm_or_si128(_mm_srli_epi64(p0e,32),_mm_andnot_si128(lowMask,p0o));
+
+     __m128i p1e = _mm_mul_epu32(c2,m1);
+     __m128i p1o = _mm_mul_epu32(_mm_srli_epi64(c2,32),m1);
+     __m128i lo1 = _mm_or_si128(_mm_and_si128(p1e,lowMask),_mm_slli_epi64(p1o,32));
+     __m128i hi1 = _mm_or_si128(_mm_srli_epi64(p1e,32),_mm_andnot_si128(lowMask,p1o));
+
+     c0 = _mm_xor_si128(_mm_xor_si128(hi1,c1),k0);
+     c1 = lo1;
+     c2 = _mm_xor_si128(_mm_xor_si128(hi0,c3),k1);
+     c3 = lo0;
+
+     k0 = _mm_add_epi32(k0,w0);
+     k1 = _mm_add_epi32(k1,w1);
+    }
+
+   // Transpose, so each block is contiguous...
+    __m128i t0 = _mm_unpacklo_epi32(c0,c1);
+    __m128i t1 = _mm_unpacklo_epi32(c2,c3);
+    __m128i t2 = _mm_unpackhi_epi32(c0,c1);
+    __m128i t3 = _mm_unpackhi_epi32(c2,c3);
+
+    __m128i * targ = (__m128i*)(out + i*4);
+    _mm_storeu_si128(targ,_mm_unpacklo_epi64(t0,t1));
+    _mm_storeu_si128(targ+1,_mm_unpackhi_epi64(t0,t1));
+    _mm_storeu_si128(targ+2,_mm_unpacklo_epi64(t2,t3));
+    _mm_storeu_si128(targ+3,_mm_unpackhi_epi64(t2,t3));
+  }
+ #endif
+
+ for (;i<count;i++) Philox(key,stream,block+i,out + i*4);
+}
+
+//------------------------------------------------------------------------------
+// Functor for the fill methods of RandomStream - converts the words of a range
+// of blocks, relative to the first block of the fill...
+class RandomStream::Fill
+{
+ public:
+  Fill(const RandomStream & s,nat64 f,real32 * o,nat32 nn,bit g,real32 a,real32 b)
+  :self(s),first(f),out(o),n(nn),gauss(g),add(a),mult(b)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   static const nat32 run = 64;
+   nat32 words[run*4];
+
+   for (nat32 b=b0;b<b1;b+=run)
+   {
+    nat32 blocks = math::Min(run,b1-b);
+    PhiloxRun(self.key,self.stream,first+b,blocks,words);
+
+    nat32 base = b*4;
+    nat32 num = math::Min(blocks*4,n-base);
+    real32 * o = out + base;
+
+    if (gauss)
+    {
+     // Box-Muller, on pairs...
+      for (nat32 i=0;i<num;i+=2)
+      {
+       real32 u = (real32(words[i]>>8) + 0.5) * (1.0/16777216.0);
+       real32 r = math::Sqrt(-2.0*math::Ln(u)) * mult;
+       real32 theta = real32(words[i+1]>>8) * (2.0*math::pi/16777216.0);
+
+       o[i] = r * math::Cos(theta);
+       if (i+1<num) o[i+1] = r * math::Sin(theta);
+      }
+    }
+    else
+    {
+     real32 m = mult * (1.0/16777216.0);
+     for (nat32 i=0;i<num;i++) o[i] = add + real32(words[i]>>8) * m;
+    }
+   }
+  }
+
+
+ private:
+  const RandomStream & self;
+  nat64 first;
+  real32 * out;
+  nat32 n;
+  bit gauss;
+  real32 add;
+  real32 mult;
+};
+
+//------------------------------------------------------------------------------
+RandomStream::RandomStream(nat64 seed,nat64 str)
+{
+ SetSeed(seed,str);
+}
+
+RandomStream::~RandomStream()
+{}
+
+void RandomStream::SetSeed(nat64 seed,nat64 str)
+{
+ key[0] = nat32(seed);
+ key[1] = nat32(seed>>32);
+ stream = str;
+ pos = 0;
+ bufBlock = nat64(-1);
+ gaussValid = false;
+}
+
+real64 RandomStream::Normal()
+{
+ nat64 a = Next()>>5;
+ nat64 b = Next()>>6;
+ return real64((a<<26) | b) * (1.0/9007199254740992.0);
+}
+
+real64 RandomStream::NormalInc()
+{
+ return real64(Next()) * (1.0/4294967295.0);
+}
+
+real64 RandomStream::Signed()
+{
+ return (real64(Next()) + 0.5) * (1.0/2147483648.0) - 1.0;
+}
+
+real64 RandomStream::Gaussian(real64 sd)
+{
+ if (gaussValid)
+ {
+  gaussValid = false;
+  return gaussVal * sd;
+ }
+
+ // Box-Muller rather than the polar method, so a fixed number of outputs is
+ // used...
+  real64 r = math::Sqrt(-2.0*math::Ln((real64(Next()) + 0.5) * (1.0/4294967296.0)));
+  real64 theta = real64(Next()) * (2.0*math::pi/4294967296.0);
+
+  gaussValid = true;
+  gaussVal = r * math::Sin(theta);
+ return r * math::Cos(theta) * sd;
+}
+
+void RandomStream::FillNormal(real32 * out,nat32 n)
+{
+ FillReal(out,n,0.0,1.0);
+}
+
+void RandomStream::FillReal(real32 * out,nat32 n,real32 min,real32 max)
+{
+ nat64 first = Align();
+ nat32 blocks = n/4 + ((n%4)!=0?1:0);
+
+ Fill fill(*this,first,out,n,false,min,max-min);
+ mt::ParallelFor(nat32(0),blocks,fill,4096);
+
+ pos = (first+blocks)*4;
+}
+
+void RandomStream::FillGaussian(real32 * out,nat32 n,real32 sd)
+{
+ nat64 first = Align();
+ nat32 blocks = n/4 + ((n%4)!=0?1:0);
+
+ Fill fill(*this,first,out,n,true,0.0,sd);
+ mt::ParallelFor(nat32(0),blocks,fill,4096);
+
+ pos = (first+blocks)*4;
+}
+
+void RandomStream::Refill()
+{
+ bufBlock = pos>>2;
+ Philox(key,stream,bufBlock,buf);
+}
+
+nat64 RandomStream::Align()
+{
+ gaussValid = false;
+ if ((pos&3)!=0) pos = (pos|3) + 1;
+ return pos>>2;
+}
+
 
 //------------------------------------------------------------------------------
  };
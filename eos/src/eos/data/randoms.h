@@ -21,6 +21,8 @@
 /// \file randoms.h
 /// This provides a standard psuedo-random number sequence generator.
 /// The algorithm is stolen from Data Structures & Algorithm Analysis in C++ by Weiss
+/// Also provides a counter based generator, for when multiple threads need
+/// random numbers without sharing a sequence.
 
 #include "eos/types.h"
 #include "eos/math/stats.h"
@@ -137,6 +139,130 @@ class EOS_CLASS Random
    real64 gaussVal;
 };
 
+//------------------------------------------------------------------------------
+/// A counter based random number generator, Philox4x32-10 from 'Parallel
+/// Random Numbers: As Easy as 1, 2, 3' by Salmon et al. Instead of a state
+/// that is updated each block of 4 32 bit outputs is a function of the seed,
+/// a stream number and the block index, being a few rounds of a weak block
+/// cipher. Any position can therefore be jumped to for free, and each stream
+/// is an independent sequence, which suits parallel code - either give each
+/// item of work its own stream with Split, or Seek to where the item would be
+/// in a serial run, and the results will be the same regardless of how many
+/// threads there are. With no locking, each thread must have its own object.
+/// Provides the commonly used methods of Random, plus the filling of arrays,
+/// which uses SSE2 when available and the task pool for large arrays, giving
+/// the same results either way.
+class EOS_CLASS RandomStream
+{
+ public:
+  /// Starts at the beginning of the given stream for the given seed.
+   RandomStream(nat64 seed = 0,nat64 stream = 0);
+
+  /// &nbsp;
+   ~RandomStream();
+
+
+  /// Sets the seed and stream, returning to the start of the stream.
+   void SetSeed(nat64 seed,nat64 stream = 0);
+
+  /// &nbsp;
+   nat64 Seed() const {return (nat64(key[1])<<32) | nat64(key[0]);}
+
+  /// &nbsp;
+   nat64 Stream() const {return stream;}
+
+  /// Returns a generator for another stream of the same seed, at its start.
+  /// Ushally given the index of a task or item of work.
+   RandomStream Split(nat64 str) const {return RandomStream(Seed(),str);}
+
+
+  /// Returns the position, in 32 bit outputs from the start of the stream.
+   nat64 Tell() const {return pos;}
+
+  /// Moves to the given position, as returned by Tell.
+   void Seek(nat64 p) {pos = p; gaussValid = false;}
+
+  /// Skips forward the given number of 32 bit outputs.
+   void Jump(nat64 n) {pos += n; gaussValid = false;}
+
+
+  /// Returns 32 random bits.
+   nat32 Next()
+   {
+    if ((pos>>2)!=bufBlock) Refill();
+    return buf[(pos++)&3];
+   }
+
+  /// Returns a random byte, [0..255].
+   byte Byte() {return byte(Next()>>24);}
+
+  /// Returns a random integer in the given range, inclusive.
+   int32 Int(int32 min,int32 max) {return min + int32((nat64(Next()) * (nat64(max-min)+1))>>32);}
+
+  /// Returns a random real in the given range, inclusive.
+   real64 Real(real64 min,real64 max) {return NormalInc()*(max-min)+min;}
+
+  /// Returns a random true/false.
+   bit Bool() {return (Next()&0x80000000)!=0;}
+
+  /// Returns a random real in the [0..1) range, with 53 bits of precision -
+  /// uses two outputs.
+   real64 Normal();
+
+  /// Returns a random real in the [0..1] range.
+   real64 NormalInc();
+
+  /// Returns a random real in the (-1..1) range.
+   real64 Signed();
+
+  /// Returns a random sample from a gaussian distribution arround 0 with the
+  /// given sd. As for Random they are generated in pairs.
+   real64 Gaussian(real64 sd);
+
+  /// Given a 0..1 probability of an event this samples the event,
+  /// returning true if it happens and false if it doesn't.
+   bit Event(real64 prob) {return Normal()<prob;}
+
+
+  /// Fills an array with uniform values in [0..1), with 24 bits of precision.
+  /// Starts at the next whole block of 4 outputs, skipping the rest of the
+  /// current block if any of it has been used, with each value using one
+  /// output, and leaves the position at the start of the block after the
+  /// last used. Large arrays are split between the threads of the task pool.
+   void FillNormal(real32 * out,nat32 n);
+
+  /// Fills an array with uniform values in the given range, as FillNormal.
+   void FillReal(real32 * out,nat32 n,real32 min,real32 max);
+
+  /// Fills an array with samples from a gaussian with a mean of 0 and the
+  /// given sd. Uses one output per value, with the same positioning as
+  /// FillNormal.
+   void FillGaussian(real32 * out,nat32 n,real32 sd);
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::data::RandomStream";}
+
+
+ private:
+  nat32 key[2];
+  nat64 stream;
+  nat64 pos; // Position of the next output.
+  nat64 bufBlock; // Index of the block in buf.
+  nat32 buf[4];
+
+  bit gaussValid;
+  real64 gaussVal;
+
+  // Fills buf with the block pos is in...
+   void Refill();
+
+  // Moves to the start of the next unused block, returning its index...
+   nat64 Align();
+
+  class Fill;
+};
+
 //------------------------------------------------------------------------------
  };
 };
@@ -66,6 +66,12 @@ class EOS_CLASS ArrayCode
 
   nat32 Rebuild(nat32 elementSize,nat32 newSize,void (*Make)(void * ptr)); // Allways deletes previous data and copys none over. Call Del first.
 
+  void Swap(ArrayCode & rhs) // Exchanges the contents, no copying.
+  {
+   nat32 te = elements; elements = rhs.elements; rhs.elements = te;
+   byte * td = data; data = rhs.data; rhs.data = td;
+  }
+
   byte * Item(nat32 elementSize,nat32 i) const {return data + elementSize*i;}
 
   void SortRange(nat32 elementSize,bit (*LessThan)(void * lhs,void * rhs),int32 left,int32 right,byte * temp);
@@ -76,6 +82,7 @@ class EOS_CLASS ArrayCode
 
   friend class KdTreeCode;
   friend class CollectorCode;
+  friend class ConcurrentCollectorCode;
 
 
  nat32 elements;
@@ -98,6 +105,10 @@ class EOS_CLASS Array : public ArrayCode
    template <typename MTT,typename DTT>
    Array(const Array<T,MTT,DTT> & rhs):ArrayCode(sizeof(T),rhs) {}
 
+  // Copy constructor for the same type, as the templated one above does not
+  // count and the default would share the data...
+   Array(const Array<T,MT,DT> & rhs):ArrayCode(sizeof(T),rhs) {}
+
   /// &nbsp;
   ~Array() {Del(sizeof(T),&DelFunc);}
 
@@ -106,6 +117,29 @@ class EOS_CLASS Array : public ArrayCode
    template <typename MTT,typename DTT>
    Array<T,MT,DT> & operator = (const Array<T,MTT,DTT> & rhs) {Del(sizeof(T),&DelFunc); Copy(sizeof(T),rhs); return *this;}
 
+  // Same type version of the above, for the same reason as the copy constructor...
+   Array<T,MT,DT> & operator = (const Array<T,MT,DT> & rhs)
+   {
+    if (this!=&rhs) {Del(sizeof(T),&DelFunc); Copy(sizeof(T),rhs);}
+    return *this;
+   }
+
+  /// Exchanges the contents of two arrays in constant time, without copying
+  /// or allocating anything. Assignment and the copy constructor copy every
+  /// element, so this is how to move an array, e.g. out of a function.
+   void Swap(Array<T,MT,DT> & rhs) {ArrayCode::Swap(rhs);}
+
+  /// Identical to operator =, except it also emptys the right hand side at the
+  /// same time, taking its data rather than copying it. Constant time
+  /// excluding the deallocator being called on the current contents.
+   void Take(Array<T,MT,DT> & rhs)
+   {
+    if (this==&rhs) return;
+    Del(sizeof(T),&DelFunc);
+    elements = 0;
+    ArrayCode::Swap(rhs);
+   }
+
   /// Assignment from a linked list, conveniant.
    template <typename DTT>
    Array<T,MT,DT> & operator = (const List<T,DTT> & rhs)
@@ -141,6 +175,9 @@ class EOS_CLASS Array : public ArrayCode
   /// for compatability and other silly reasons.
    T * Ptr() {return (T*)data;}
 
+  /// &nbsp;
+   const T * Ptr() const {return (const T*)data;}
+
   /// &nbsp;
    T & operator[] (nat32 i) const {return *(T*)Item(sizeof(T),i);}
 
@@ -302,6 +339,9 @@ class EOS_CLASS ArrayRS : public ArrayCode
    template <typename MTT,typename DTT>
    ArrayRS<T,MT,DT> & operator = (const ArrayRS<T,MTT,DTT> & rhs) {Del(es,&DelFunc); Copy(es,rhs); return *this;}
 
+  /// Exchanges the contents, including the element size, in constant time.
+   void Swap(ArrayRS<T,MT,DT> & rhs) {ArrayCode::Swap(rhs); nat32 te = es; es = rhs.es; rhs.es = te;}
+
   /// Returns the size of the array.
    nat32 Size() const {return elements;}
 
@@ -425,6 +465,143 @@ class EOS_CLASS ArrayRS : public ArrayCode
   nat32 es; // Size of each element in the array.
 };
 
+//------------------------------------------------------------------------------
+/// An array that keeps upto N elements inside itself, only going to the heap if
+/// it grows past that, for the small arrays that get made and destroyed in
+/// inner loops, where Array would cost a malloc and a free each time. Has the
+/// basic interface of Array - Size, Ptr, [] and assignment from an Array - so
+/// it can be dropped in where only that is used. As with Array the elements are
+/// moved with a bitwise copy when the storage changes. Shrinking keeps the
+/// storage, so an array that has gone to the heap stays there until it dies.
+template <typename T,nat32 N = 16,typename MT = mem::MakeDont<T>,typename DT = mem::KillNull<T> >
+class EOS_CLASS ArraySBO
+{
+ public:
+  /// &nbsp;
+  /// \param sz Size of the array.
+   ArraySBO(nat32 sz = 0):elements(0),capacity(N),data((T*)(void*)local) {Size(sz);}
+
+  /// &nbsp;
+   ArraySBO(const ArraySBO<T,N,MT,DT> & rhs):elements(0),capacity(N),data((T*)(void*)local)
+   {Copy(rhs.elements,rhs.data);}
+
+  /// Copies an Array, with the same warnings as the Array copy constructor.
+   template <typename MTT,typename DTT>
+   ArraySBO(const Array<T,MTT,DTT> & rhs):elements(0),capacity(N),data((T*)(void*)local)
+   {Copy(rhs.Size(),rhs.Ptr());}
+
+  /// &nbsp;
+   ~ArraySBO()
+   {
+    for (nat32 i=0;i<elements;i++) DT::Kill(&data[i]);
+    if (!Inline()) mem::Free(data);
+   }
+
+
+  /// &nbsp;
+   ArraySBO<T,N,MT,DT> & operator = (const ArraySBO<T,N,MT,DT> & rhs)
+   {
+    if (this!=&rhs)
+    {
+     for (nat32 i=0;i<elements;i++) DT::Kill(&data[i]);
+     elements = 0;
+     Copy(rhs.elements,rhs.data);
+    }
+    return *this;
+   }
+
+  /// &nbsp;
+   template <typename MTT,typename DTT>
+   ArraySBO<T,N,MT,DT> & operator = (const Array<T,MTT,DTT> & rhs)
+   {
+    for (nat32 i=0;i<elements;i++) DT::Kill(&data[i]);
+    elements = 0;
+    Copy(rhs.Size(),rhs.Ptr());
+    return *this;
+   }
+
+  /// Exchanges the contents of two arrays. Constant time if both are on the
+  /// heap, otherwise it copies the inline storage.
+   void Swap(ArraySBO<T,N,MT,DT> & rhs)
+   {
+    bit li = Inline();
+    bit ri = rhs.Inline();
+
+    byte temp[sizeof(ArraySBO<T,N,MT,DT>)];
+    mem::Copy(temp,(byte*)(void*)this,sizeof(ArraySBO<T,N,MT,DT>));
+    mem::Copy((byte*)(void*)this,(byte*)(void*)&rhs,sizeof(ArraySBO<T,N,MT,DT>));
+    mem::Copy((byte*)(void*)&rhs,temp,sizeof(ArraySBO<T,N,MT,DT>));
+
+    if (ri) data = (T*)(void*)local;
+    if (li) rhs.data = (T*)(void*)rhs.local;
+   }
+
+
+  /// Returns the size of the array.
+   nat32 Size() const {return elements;}
+
+  /// Changes the size of the array, returning the new size. Same rules on new
+  /// items as for Array.
+   nat32 Size(nat32 size)
+   {
+    if (size>capacity) Grow(size);
+    for (nat32 i=size;i<elements;i++) DT::Kill(&data[i]);
+    for (nat32 i=elements;i<size;i++) MT::Make(&data[i]);
+    elements = size;
+    return elements;
+   }
+
+  /// Returns true if the elements are currently stored inside the object,
+  /// false if they have gone to the heap.
+   bit Inline() const {return data==(const T*)(const void*)local;}
+
+  /// Returns how many bytes of data the structure is using, excluding data at
+  /// the other ends of pointers stored in the contained objects.
+   nat32 Memory() const {return sizeof(ArraySBO<T,N,MT,DT>) + (Inline()?0:capacity*sizeof(T));}
+
+
+  /// &nbsp;
+   T * Ptr() {return data;}
+
+  /// &nbsp;
+   const T * Ptr() const {return data;}
+
+  /// &nbsp;
+   T & operator[] (nat32 i) const {return data[i];}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::ds::ArraySBO<" << typestring<T>() << "," << typestring<MT>() << "," << typestring<DT>() << ">");
+    return ret;
+   }
+
+
+ private:
+  nat32 elements;
+  nat32 capacity;
+  T * data; // Points to local or a mem::Malloc-ed block of capacity elements.
+  real64 local[(N*sizeof(T)+sizeof(real64)-1)/sizeof(real64)]; // real64 for the alignment.
+
+  void Grow(nat32 size)
+  {
+   T * nd = mem::Malloc<T>(size);
+   mem::Copy((byte*)(void*)nd,(byte*)(void*)data,elements*sizeof(T));
+   if (!Inline()) mem::Free(data);
+   data = nd;
+   capacity = size;
+  }
+
+  // Copies in the given elements, the array must be empty...
+   void Copy(nat32 size,const T * from)
+   {
+    if (size>capacity) Grow(size);
+    mem::Copy((byte*)(void*)data,(const byte*)(const void*)from,size*sizeof(T));
+    elements = size;
+   }
+};
+
 //------------------------------------------------------------------------------
 /// This is an array class that automatically uses mem::MakeNew and
 /// mem::KillOnlyDel on its subject, this makes it safe to use this version with
@@ -17,6 +17,8 @@
 
 #include "eos/ds/collectors.h"
 
+#include "eos/mt/tasks.h"
+
 namespace eos
 {
  namespace ds
@@ -65,6 +67,122 @@ void CollectorCode::Reverse()
  last = newLast;
 }
 
+//------------------------------------------------------------------------------
+ConcurrentCollectorCode::ConcurrentCollectorCode(nat32 bs)
+:blockSize(bs),first(null<Local*>())
+{}
+
+ConcurrentCollectorCode::~ConcurrentCollectorCode()
+{
+ Reset();
+ while (first)
+ {
+  Local * victim = first;
+  first = first->next;
+  delete victim;
+ }
+}
+
+void ConcurrentCollectorCode::Reset()
+{
+ // The Locals are kept, as the threads still point to them...
+  for (Local * targ = first;targ;targ = targ->next)
+  {
+   while (targ->first)
+   {
+    Block * victim = targ->first;
+    targ->first = victim->next;
+    mem::Free((byte*)(void*)victim);
+   }
+   targ->last = null<Block*>();
+   targ->size = 0;
+  }
+}
+
+nat32 ConcurrentCollectorCode::Size() const
+{
+ nat32 ret = 0;
+ for (Local * targ = first;targ;targ = targ->next) ret += targ->size;
+ return ret;
+}
+
+// Copies blocks into their places in the output, for Fill...
+class ConcurrentCollectorFill
+{
+ public:
+  ConcurrentCollectorFill(nat32 es,const ds::Array<void*> & b,const ds::Array<nat32> & o,byte * d)
+  :elementSize(es),block(b),offset(o),out(d) {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   for (nat32 i=begin;i<end;i++)
+   {
+    mem::Copy(out + elementSize*offset[i],(byte*)block[i],elementSize*(offset[i+1]-offset[i]));
+   }
+  }
+
+ private:
+  nat32 elementSize;
+  const ds::Array<void*> & block;
+  const ds::Array<nat32> & offset;
+  byte * out;
+};
+
+void ConcurrentCollectorCode::Fill(nat32 elementSize,ArrayCode & out) const
+{
+ // Find every block and where it goes...
+  nat32 blocks = 0;
+  for (Local * targ = first;targ;targ = targ->next)
+  {
+   for (Block * b = targ->first;b;b = b->next) ++blocks;
+  }
+
+  ds::Array<void*> data(blocks);
+  ds::Array<nat32> offset(blocks+1);
+  offset[0] = 0;
+  nat32 i = 0;
+  for (Local * targ = first;targ;targ = targ->next)
+  {
+   for (Block * b = targ->first;b;b = b->next)
+   {
+    data[i] = b->Data();
+    offset[i+1] = offset[i] + b->used;
+    ++i;
+   }
+  }
+
+ // Copy them over...
+  out.Resize(elementSize,offset[blocks],NoOp,NoOp);
+  if (blocks==0) return;
+  ConcurrentCollectorFill fill(elementSize,data,offset,out.Item(elementSize,0));
+  mt::ParallelFor(nat32(0),blocks,fill,1 + 16384/(blockSize+1));
+}
+
+ConcurrentCollectorCode::Local * ConcurrentCollectorCode::NewLocal()
+{
+ Local * ret = new Local;
+ ret->first = null<Block*>();
+ ret->last = null<Block*>();
+ ret->size = 0;
+ lock.Lock();
+  ret->next = first;
+  first = ret;
+ lock.Unlock();
+ slot.Set(ret);
+ return ret;
+}
+
+ConcurrentCollectorCode::Block * ConcurrentCollectorCode::NewBlock(nat32 elementSize,Local * local)
+{
+ Block * ret = (Block*)(void*)mem::Malloc<byte>(sizeof(Block) + elementSize*blockSize);
+ ret->next = null<Block*>();
+ ret->used = 0;
+ if (local->last) local->last->next = ret;
+             else local->first = ret;
+ local->last = ret;
+ return ret;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -20,12 +20,15 @@
 
 /// \file collectors.h
 /// Simple data structure for collecting data of some kind, designed for speed
-/// by using the mem::Packer memory manager.
+/// by using the mem::Packer memory manager. Also provides a version that many
+/// threads can add to at once.
 
 #include "eos/types.h"
 #include "eos/typestring.h"
 #include "eos/ds/arrays.h"
 #include "eos/mem/packer.h"
+#include "eos/mt/threads.h"
+#include "eos/mt/locks.h"
 
 namespace eos
 {
@@ -169,6 +172,184 @@ class EOS_CLASS Collector : public CollectorCode
    }   
 };
 
+//------------------------------------------------------------------------------
+// Code for flat template...
+class EOS_CLASS ConcurrentCollectorCode
+{
+ protected:
+   ConcurrentCollectorCode(nat32 blockSize);
+  ~ConcurrentCollectorCode();
+
+  void Reset();
+  nat32 Size() const;
+  void Fill(nat32 elementSize,ArrayCode & out) const;
+
+
+ // Variables...
+  struct Block
+  {
+   Block * next;
+   nat32 used;
+   nat32 pad; // So the data stays 8 byte aligned.
+   void * Data() {return (void*)(this+1);}
+  };
+
+  struct Local // One per thread that has added to it.
+  {
+   Local * next;
+   Block * first;
+   Block * last;
+   nat32 size;
+  };
+
+  nat32 blockSize;
+  mt::ThreadSlot slot; // Local of the current thread.
+  mt::OwnedLock lock; // Protects first, which only changes when a new thread turns up.
+  Local * first;
+
+  // Returns space for one more element in the calling threads blocks...
+   void * Add(nat32 elementSize)
+   {
+    Local * local = (Local*)slot.Get();
+    if (local==null<Local*>()) local = NewLocal();
+    Block * block = local->last;
+    if ((block==null<Block*>())||(block->used==blockSize)) block = NewBlock(elementSize,local);
+    local->size += 1;
+    return (byte*)block->Data() + elementSize*(block->used++);
+   }
+
+  Local * NewLocal();
+  Block * NewBlock(nat32 elementSize,Local * local);
+
+ private:
+  static void NoOp(void * ptr)
+  {}
+};
+
+//------------------------------------------------------------------------------
+/// A Collector that any number of threads can add to at the same time, without
+/// locking - each thread appends to its own chain of blocks. Once they are all
+/// done the items can be iterated where they lie, or copied into one array, a
+/// block per task in parallel. Items stay in the order added within each
+/// thread, but the threads come in no particular order, so this is for when
+/// the order does not matter, e.g. the matches found by a ParallelFor. As with
+/// Collector the records must be simple - no constructors/destructors. Only
+/// Add may be called whilst other threads are using it, everything else
+/// requires that all adding has finished.
+template <typename T>
+class EOS_CLASS ConcurrentCollector : public ConcurrentCollectorCode
+{
+ public:
+  /// You must provide the number of records to allocate at a time, the size of
+  /// the blocks each thread gets.
+   ConcurrentCollector(nat32 blockSize = 256):ConcurrentCollectorCode(blockSize) {}
+
+  /// &nbsp;
+   ~ConcurrentCollector() {}
+
+  /// Empties it, freeing the blocks.
+   void Reset() {ConcurrentCollectorCode::Reset();}
+
+
+  /// Adds an item, can be called by any number of threads at once.
+   void Add(const T & rhs) {*(T*)ConcurrentCollectorCode::Add(sizeof(T)) = rhs;}
+
+  /// Returns how many items it contains, summed over the threads.
+   nat32 Size() const {return ConcurrentCollectorCode::Size();}
+
+  /// Will resize the array as needed. The data will be grouped by thread, in
+  /// the order added within each group. The copying is done in parallel.
+   void Fill(ds::Array<T> & out) const {ConcurrentCollectorCode::Fill(sizeof(T),out);}
+
+
+  /// Cursor class, allows you to iterate the stored structures where they are,
+  /// a thread at a time.
+   class EOS_CLASS Cursor
+   {
+    public:
+     // Not for public consumption...
+      Cursor(Local * start):local(start),block(null<Block*>()),index(0)
+      {
+       while (local&&(local->first==null<Block*>())) local = local->next;
+       if (local) block = local->first;
+      }
+
+     /// &nbsp;
+      Cursor():local(null<Local*>()),block(null<Block*>()),index(0) {}
+
+     /// &nbsp;
+      Cursor(const Cursor & rhs):local(rhs.local),block(rhs.block),index(rhs.index) {}
+
+     /// &nbsp;
+      ~Cursor() {}
+
+     /// &nbsp;
+      Cursor & operator = (const Cursor & rhs) {local = rhs.local; block = rhs.block; index = rhs.index; return *this;}
+
+
+     /// Returns true if the class is unsafe to use.
+      bit Bad() const {return block==null<Block*>();}
+
+     /// Returns true if the class is safe to use.
+      bit Good() const {return block!=null<Block*>();}
+
+     /// Moves to next item.
+      Cursor & operator++ ()
+      {
+       ++index;
+       if (index==block->used)
+       {
+        index = 0;
+        block = block->next;
+        if (block==null<Block*>())
+        {
+         local = local->next;
+         while (local&&(local->first==null<Block*>())) local = local->next;
+         if (local) block = local->first;
+        }
+       }
+       return *this;
+      }
+
+
+     /// &nbsp;
+      T * Ptr() {return (T*)block->Data() + index;}
+
+     /// &nbsp;
+      const T * Ptr() const {return (T*)block->Data() + index;}
+
+     /// &nbsp;
+      T & operator* () {return *Ptr();}
+
+     /// &nbsp;
+      const T & operator* () const {return *Ptr();}
+
+     /// &nbsp;
+      T * operator->() {return Ptr();}
+
+     /// &nbsp;
+      const T * operator->() const {return Ptr();}
+
+
+    private:
+     Local * local;
+     Block * block;
+     nat32 index;
+   };
+
+
+  /// Returns a cursor to the first item.
+   Cursor Ptr() const {return Cursor(first);}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::ds::ConcurrentCollector<" << typestring<T>() << ">");
+    return ret;
+   }
+};
+
 //------------------------------------------------------------------------------
  };
 };
@@ -0,0 +1,330 @@
+#ifndef EOS_DS_CONCURRENT_QUEUES_H
+#define EOS_DS_CONCURRENT_QUEUES_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file concurrent_queues.h
+/// Contains queues that can be used by multiple threads at once without any
+/// locking, for passing work between the stages of a pipeline. Both are fixed
+/// size ring buffers, and provide both blocking and non-blocking versions of
+/// adding and removing items.
+
+#include "eos/types.h"
+#include "eos/typestring.h"
+#include "eos/mt/locks.h"
+
+namespace eos
+{
+ namespace ds
+ {
+//------------------------------------------------------------------------------
+/// Helper for the queues below, allows threads to wait for something to
+/// happen, with the thread that makes it happen only paying for a system call
+/// if someone is actually waiting. Waiters call Enter(), check if they still
+/// need to wait, call Wait() if so, and then Leave(). The thread doing the
+/// work calls Notify() after every change. Can result in spurious wake ups, so
+/// whatever is waited on must be rechecked.
+class EOS_CLASS WaitPoint
+{
+ public:
+  /// &nbsp;
+   WaitPoint() {}
+
+  /// &nbsp;
+   ~WaitPoint() {}
+
+
+  /// &nbsp;
+   void Enter() {waiting.Inc();}
+
+  /// Returns false on timeout, in milliseconds.
+   bit Wait(nat32 timeout = 0xFFFFFFFF) {return event.Get(timeout);}
+
+  /// &nbsp;
+   void Leave() {waiting.Dec();}
+
+
+  /// Wakes up a waiting thread, if there are any.
+   void Notify() {if (waiting.Get()!=0) event.Add(1);}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::ds::WaitPoint";}
+
+
+ private:
+  mt::Atomic waiting;
+  mt::EventLock event;
+};
+
+//------------------------------------------------------------------------------
+/// A bounded first in first out queue, safe for any number of threads to be
+/// adding and removing items at the same time. Lock free, using the sequence
+/// number per slot approach, so a thread never waits on another thread unless
+/// the queue is full or empty and it uses the blocking methods. The size is
+/// rounded up to a power of two. T must be copyable, and is copied in and out,
+/// so ideally small, e.g. a pointer.
+template <typename T>
+class EOS_CLASS ConcurrentQueue
+{
+ public:
+  /// The size is the maximum number of items it can contain.
+   ConcurrentQueue(nat32 size = 1024)
+   {
+    nat32 s = 2;
+    while (s<size) s *= 2;
+    mask = s-1;
+
+    cell = new Cell[s];
+    for (nat32 i=0;i<s;i++) cell[i].seq.Set(int32(i));
+   }
+
+  /// Any items still in the queue are simply deleted.
+   ~ConcurrentQueue() {delete[] cell;}
+
+
+  /// Returns the maximum number of items.
+   nat32 Capacity() const {return mask+1;}
+
+  /// Returns how many items are in the queue. Only a snapshot, as it could
+  /// change at any moment.
+   nat32 Size() const {return nat32(tail.Get()) - nat32(head.Get());}
+
+
+  /// Adds an item to the back of the queue, returns false if the queue is
+  /// full, in which case it does nothing.
+   bit TryAdd(const T & in)
+   {
+    nat32 pos = nat32(tail.Get());
+    while (true)
+    {
+     Cell & targ = cell[pos&mask];
+     int32 diff = int32(nat32(targ.seq.Get()) - pos);
+     if (diff==0)
+     {
+      if (tail.CompareSwap(int32(pos),int32(pos+1)))
+      {
+       targ.data = in;
+       targ.seq.Set(int32(pos+1));
+       notEmpty.Notify();
+       return true;
+      }
+     }
+     else
+     {
+      if (diff<0) return false;
+     }
+     pos = nat32(tail.Get());
+    }
+   }
+
+  /// Removes the item at the front of the queue and writes it to out, returns
+  /// false if the queue is empty, in which case out is not touched.
+   bit TryRem(T & out)
+   {
+    nat32 pos = nat32(head.Get());
+    while (true)
+    {
+     Cell & targ = cell[pos&mask];
+     int32 diff = int32(nat32(targ.seq.Get()) - (pos+1));
+     if (diff==0)
+     {
+      if (head.CompareSwap(int32(pos),int32(pos+1)))
+      {
+       out = targ.data;
+       targ.seq.Set(int32(pos+mask+1));
+       notFull.Notify();
+       return true;
+      }
+     }
+     else
+     {
+      if (diff<0) return false;
+     }
+     pos = nat32(head.Get());
+    }
+   }
+
+
+  /// Adds an item, blocking whilst the queue is full. The timeout is in
+  /// milliseconds, returns false if it expires, 0xFFFFFFFF means forever.
+   bit Add(const T & in,nat32 timeout = 0xFFFFFFFF)
+   {
+    while (true)
+    {
+     if (TryAdd(in)) return true;
+     notFull.Enter();
+      if (TryAdd(in)) {notFull.Leave(); return true;}
+      bit woken = notFull.Wait(timeout);
+     notFull.Leave();
+     if (!woken) return TryAdd(in);
+    }
+   }
+
+  /// Removes an item, blocking whilst the queue is empty. The timeout is in
+  /// milliseconds, returns false if it expires, 0xFFFFFFFF means forever.
+   bit Rem(T & out,nat32 timeout = 0xFFFFFFFF)
+   {
+    while (true)
+    {
+     if (TryRem(out)) return true;
+     notEmpty.Enter();
+      if (TryRem(out)) {notEmpty.Leave(); return true;}
+      bit woken = notEmpty.Wait(timeout);
+     notEmpty.Leave();
+     if (!woken) return TryRem(out);
+    }
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::ds::ConcurrentQueue<" << typestring<T>() << ">");
+    return ret;
+   }
+
+
+ private:
+  struct Cell
+  {
+   mt::Atomic seq;
+   T data;
+  };
+
+  nat32 mask;
+  Cell * cell;
+
+  mt::Atomic head; // Next position to remove from.
+  mt::Atomic tail; // Next position to add at.
+
+  WaitPoint notEmpty;
+  WaitPoint notFull;
+};
+
+//------------------------------------------------------------------------------
+/// A bounded first in first out queue for passing items from exactly one
+/// thread to exactly one other thread, i.e. between two stages of a pipeline.
+/// Lighter than ConcurrentQueue, as each side only writes its own position.
+/// Behaviour is undefined if more than one thread adds or more than one thread
+/// removes. The size is rounded up to a power of two.
+template <typename T>
+class EOS_CLASS RingBuffer
+{
+ public:
+  /// The size is the maximum number of items it can contain.
+   RingBuffer(nat32 size = 1024):head(0),tail(0)
+   {
+    nat32 s = 2;
+    while (s<size) s *= 2;
+    mask = s-1;
+    data = new T[s];
+   }
+
+  /// Any items still in the queue are simply deleted.
+   ~RingBuffer() {delete[] data;}
+
+
+  /// Returns the maximum number of items.
+   nat32 Capacity() const {return mask+1;}
+
+  /// Returns how many items are in the queue. Only a snapshot.
+   nat32 Size() const {return tail - head;}
+
+
+  /// Adds an item, returns false if full. Only call from the producing thread.
+   bit TryAdd(const T & in)
+   {
+    nat32 t = tail;
+    if (t-head>mask) return false;
+    data[t&mask] = in;
+    __sync_synchronize();
+    tail = t+1;
+    notEmpty.Notify();
+    return true;
+   }
+
+  /// Removes an item, returns false if empty. Only call from the consuming
+  /// thread.
+   bit TryRem(T & out)
+   {
+    nat32 h = head;
+    if (tail==h) return false;
+    __sync_synchronize();
+    out = data[h&mask];
+    __sync_synchronize();
+    head = h+1;
+    notFull.Notify();
+    return true;
+   }
+
+
+  /// Adds an item, blocking whilst the buffer is full. The timeout is in
+  /// milliseconds, returns false if it expires, 0xFFFFFFFF means forever.
+   bit Add(const T & in,nat32 timeout = 0xFFFFFFFF)
+   {
+    while (true)
+    {
+     if (TryAdd(in)) return true;
+     notFull.Enter();
+      if (TryAdd(in)) {notFull.Leave(); return true;}
+      bit woken = notFull.Wait(timeout);
+     notFull.Leave();
+     if (!woken) return TryAdd(in);
+    }
+   }
+
+  /// Removes an item, blocking whilst the buffer is empty. The timeout is in
+  /// milliseconds, returns false if it expires, 0xFFFFFFFF means forever.
+   bit Rem(T & out,nat32 timeout = 0xFFFFFFFF)
+   {
+    while (true)
+    {
+     if (TryRem(out)) return true;
+     notEmpty.Enter();
+      if (TryRem(out)) {notEmpty.Leave(); return true;}
+      bit woken = notEmpty.Wait(timeout);
+     notEmpty.Leave();
+     if (!woken) return TryRem(out);
+    }
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::ds::RingBuffer<" << typestring<T>() << ">");
+    return ret;
+   }
+
+
+ private:
+  nat32 mask;
+  T * data;
+
+  volatile nat32 head; // Only written by the consumer.
+  volatile nat32 tail; // Only written by the producer.
+
+  WaitPoint notEmpty;
+  WaitPoint notFull;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -0,0 +1,264 @@
+#ifndef EOS_DS_CSR_GRAPHS_H
+#define EOS_DS_CSR_GRAPHS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file csr_graphs.h
+/// Provides an immutable graph in compressed sparse row form, for graphs that
+/// are built once and then traversed many times, where ds::Graph would spend
+/// its time chasing pointers.
+
+#include "eos/types.h"
+#include "eos/typestring.h"
+
+#include "eos/ds/arrays.h"
+#include "eos/ds/sorting.h"
+#include "eos/mt/tasks.h"
+
+namespace eos
+{
+ namespace ds
+ {
+//------------------------------------------------------------------------------
+/// A graph with vertices numbered 0..Vertices()-1, stored as an offset per
+/// vertex into one array of neighbours and one array of weights, the
+/// neighbours of each vertex sorted by index. Built in one go from a list of
+/// edges, after which it can not be changed, only rebuilt. Duplicate edges are
+/// merged with their weights summed, using +=, and edges from a vertex to
+/// itself are dropped. W should be a simple type, nat32 by default, so the
+/// weights can count how many times each edge was given.
+template <typename W = nat32>
+class EOS_CLASS CsrGraph
+{
+ public:
+  /// An input edge, for building.
+   struct Edge
+   {
+    nat32 from;
+    nat32 to;
+    W weight;
+   };
+
+
+  /// Starts with no vertices.
+   CsrGraph() {offset.Size(1); offset[0] = 0;}
+
+  /// &nbsp;
+   ~CsrGraph() {}
+
+
+  /// Replaces the contents with the graph of the given vertex count and
+  /// edges. If symmetric each edge is stored in both directions, so the
+  /// graph is undirected, otherwise only from from to to. The sorting and
+  /// merging of each vertices neighbours is done in parallel.
+   void Build(nat32 vertices,nat32 edgeCount,const Edge * edge,bit symmetric = true);
+
+  /// &nbsp;
+   void Build(nat32 vertices,const ds::Array<Edge> & edge,bit symmetric = true)
+   {
+    Build(vertices,edge.Size(),(edge.Size()!=0)?&edge[0]:null<const Edge*>(),symmetric);
+   }
+
+
+  /// Returns how many vertices it has.
+   nat32 Vertices() const {return offset.Size()-1;}
+
+  /// Returns how many edges it stores, counting both directions of a
+  /// symmetric edge.
+   nat32 Edges() const {return offset[offset.Size()-1];}
+
+  /// Returns how many neighbours the given vertex has.
+   nat32 Degree(nat32 v) const {return offset[v+1] - offset[v];}
+
+  /// Returns neighbour n of vertex v, in increasing order of index.
+   nat32 Neighbour(nat32 v,nat32 n) const {return to[offset[v]+n];}
+
+  /// Returns the weight of the edge to neighbour n of vertex v.
+   const W & Weight(nat32 v,nat32 n) const {return weight[offset[v]+n];}
+
+  /// Returns the neighbour n would be found at, if it exists, for the given
+  /// vertex, or Degree(v) if they are not connected.
+   nat32 Find(nat32 v,nat32 u) const
+   {
+    nat32 low = offset[v];
+    nat32 high = offset[v+1];
+    while (low<high)
+    {
+     nat32 mid = (low+high)/2;
+     if (to[mid]<u) low = mid+1;
+               else high = mid;
+    }
+    if ((low<offset[v+1])&&(to[low]==u)) return low - offset[v];
+    return Degree(v);
+   }
+
+
+  /// Direct access to the offsets, Vertices()+1 of them, with the neighbours of
+  /// v being in [Offset()[v],Offset()[v+1]) of the other two arrays.
+   const nat32 * Offset() const {return &offset[0];}
+
+  /// &nbsp;
+   const nat32 * Neighbours() const {return (Edges()!=0)?&to[0]:null<const nat32*>();}
+
+  /// &nbsp;
+   const W * Weights() const {return (Edges()!=0)?&weight[0]:null<const W*>();}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::ds::CsrGraph<" << typestring<W>() << ">");
+    return ret;
+   }
+
+
+ private:
+  ds::Array<nat32> offset;
+  ds::Array<nat32> to;
+  ds::Array<W> weight;
+
+  // Used during building, an edge as scattered to its source vertex...
+   struct Entry
+   {
+    nat32 to;
+    W weight;
+
+    bit operator < (const Entry & rhs) const {return to<rhs.to;}
+   };
+
+  // Functors for the parallel parts of building...
+   class SortMerge
+   {
+    public:
+     SortMerge(ds::Array<Entry> & e,const ds::Array<nat32> & o,ds::Array<nat32> & d)
+     :entry(e),offset(o),degree(d) {}
+
+     void operator () (nat32 begin,nat32 end) const
+     {
+      for (nat32 v=begin;v<end;v++)
+      {
+       nat32 start = offset[v];
+       nat32 finish = offset[v+1];
+       if (finish==start) {degree[v] = 0; continue;}
+
+       entry.SortRangeNorm(start,finish-1);
+
+       nat32 out = start;
+       for (nat32 i=start+1;i<finish;i++)
+       {
+        if (entry[i].to==entry[out].to) entry[out].weight += entry[i].weight;
+        else
+        {
+         ++out;
+         entry[out] = entry[i];
+        }
+       }
+       degree[v] = out + 1 - start;
+      }
+     }
+
+    private:
+     ds::Array<Entry> & entry;
+     const ds::Array<nat32> & offset;
+     ds::Array<nat32> & degree;
+   };
+
+   class Compact
+   {
+    public:
+     Compact(CsrGraph<W> & g,const ds::Array<Entry> & e,const ds::Array<nat32> & f)
+     :graph(g),entry(e),from(f) {}
+
+     void operator () (nat32 begin,nat32 end) const
+     {
+      for (nat32 v=begin;v<end;v++)
+      {
+       nat32 base = from[v];
+       for (nat32 i=graph.offset[v];i<graph.offset[v+1];i++)
+       {
+        graph.to[i] = entry[base].to;
+        graph.weight[i] = entry[base].weight;
+        ++base;
+       }
+      }
+     }
+
+    private:
+     CsrGraph<W> & graph;
+     const ds::Array<Entry> & entry;
+     const ds::Array<nat32> & from;
+   };
+};
+
+//------------------------------------------------------------------------------
+template <typename W>
+inline void CsrGraph<W>::Build(nat32 vertices,nat32 edgeCount,const Edge * edge,bit symmetric)
+{
+ // Count the entries for each vertex, and turn them into offsets...
+  ds::Array<nat32> start(vertices+1);
+  for (nat32 i=0;i<=vertices;i++) start[i] = 0;
+  for (nat32 i=0;i<edgeCount;i++)
+  {
+   if (edge[i].from==edge[i].to) continue;
+   start[edge[i].from+1] += 1;
+   if (symmetric) start[edge[i].to+1] += 1;
+  }
+  for (nat32 i=0;i<vertices;i++) start[i+1] += start[i];
+
+ // Scatter the edges to their vertices...
+  ds::Array<Entry> entry(start[vertices]);
+  {
+   ds::Array<nat32> fill(vertices);
+   for (nat32 i=0;i<vertices;i++) fill[i] = start[i];
+   for (nat32 i=0;i<edgeCount;i++)
+   {
+    if (edge[i].from==edge[i].to) continue;
+
+    Entry & e = entry[fill[edge[i].from]++];
+    e.to = edge[i].to;
+    e.weight = edge[i].weight;
+
+    if (symmetric)
+    {
+     Entry & r = entry[fill[edge[i].to]++];
+     r.to = edge[i].from;
+     r.weight = edge[i].weight;
+    }
+   }
+  }
+
+ // Sort each vertices entries and merge the duplicates...
+  ds::Array<nat32> degree(vertices);
+  SortMerge sortMerge(entry,start,degree);
+  mt::ParallelFor(nat32(0),vertices,sortMerge,256);
+
+ // Build the final offsets and copy the merged entries over...
+  offset.Size(vertices+1);
+  offset[0] = 0;
+  for (nat32 i=0;i<vertices;i++) offset[i+1] = offset[i] + degree[i];
+
+  to.Size(offset[vertices]);
+  weight.Size(offset[vertices]);
+  Compact compact(*this,entry,start);
+  mt::ParallelFor(nat32(0),vertices,compact,256);
+}
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
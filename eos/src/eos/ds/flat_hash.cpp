@@ -0,0 +1,216 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/ds/flat_hash.h"
+
+#include "eos/mem/alloc.h"
+#include "eos/mem/functions.h"
+#include "eos/math/functions.h"
+
+namespace eos
+{
+ namespace ds
+ {
+//------------------------------------------------------------------------------
+FlatHashCode::FlatHashCode(nat32 es,nat32 align,nat32 reserve)
+:elementSize(es),capacity(0),elements(0),dead(0),ctrl(null<byte*>()),slot(null<byte*>())
+{
+ if (align<sizeof(nat32)) align = sizeof(nat32);
+ valueOffset = align;
+ slotSize = ((valueOffset + elementSize + align - 1)/align)*align;
+
+ Reserve(reserve);
+}
+
+FlatHashCode::FlatHashCode(const FlatHashCode & rhs)
+:elementSize(rhs.elementSize),valueOffset(rhs.valueOffset),slotSize(rhs.slotSize),
+capacity(0),elements(0),dead(0),ctrl(null<byte*>()),slot(null<byte*>())
+{
+ Copy(rhs);
+}
+
+FlatHashCode::~FlatHashCode()
+{}
+
+void FlatHashCode::Del(void (*Term)(void * ptr))
+{
+ for (nat32 s=0;s<capacity;s++)
+ {
+  if ((ctrl[s]&0x80)==0) Term(slot + s*slotSize + valueOffset);
+ }
+
+ mem::Free(ctrl);
+ mem::Free(slot);
+ ctrl = null<byte*>();
+ slot = null<byte*>();
+ capacity = 0;
+ elements = 0;
+ dead = 0;
+}
+
+void FlatHashCode::Reset(nat32 reserve)
+{
+ Reserve(reserve);
+}
+
+void FlatHashCode::Copy(const FlatHashCode & rhs)
+{
+ capacity = rhs.capacity;
+ elements = rhs.elements;
+ dead = rhs.dead;
+ if (capacity!=0)
+ {
+  ctrl = mem::Malloc<byte>(capacity+groupSize-1);
+  slot = mem::Malloc<byte>(capacity*slotSize);
+  mem::Copy(ctrl,rhs.ctrl,capacity+groupSize-1);
+  mem::Copy(slot,rhs.slot,capacity*slotSize);
+ }
+}
+
+void FlatHashCode::Reserve(nat32 count)
+{
+ if (count==0) return;
+ nat32 cap = CapacityFor(count);
+ if ((cap>capacity)||(count+dead>capacity-capacity/8)) Resize(math::Max(cap,capacity));
+}
+
+void FlatHashCode::Rehash()
+{
+ if (elements==0)
+ {
+  mem::Free(ctrl);
+  mem::Free(slot);
+  ctrl = null<byte*>();
+  slot = null<byte*>();
+  capacity = 0;
+  dead = 0;
+ }
+ else Resize(CapacityFor(elements));
+}
+
+void * FlatHashCode::GetCreate(nat32 index)
+{
+ nat32 s = Find(index);
+ if (s==0xFFFFFFFF)
+ {
+  // Make sure there is room, doubling if its getting full of real elements,
+  // otherwise just clearing out the deleted slots...
+   if (elements+dead+1>capacity-capacity/8)
+   {
+    nat32 cap = CapacityFor(elements+1);
+    if (cap<=capacity) cap = (elements+1>(capacity/16)*7)?(capacity*2):capacity;
+    Resize(cap);
+   }
+
+  nat32 h = Hash(index);
+  s = FreeSlot(h);
+  if (ctrl[s]==deleted) --dead;
+  SetCtrl(s,byte(h&0x7F));
+  ++elements;
+
+  byte * targ = slot + s*slotSize;
+  *(nat32*)(void*)targ = index;
+  mem::Null(targ+valueOffset,elementSize);
+ }
+ return slot + s*slotSize + valueOffset;
+}
+
+void FlatHashCode::Set(nat32 index,const void * in)
+{
+ mem::Copy((byte*)GetCreate(index),(const byte*)in,elementSize);
+}
+
+bit FlatHashCode::Unset(nat32 index,void (*Term)(void * ptr))
+{
+ nat32 s = Find(index);
+ if (s==0xFFFFFFFF) return false;
+
+ Term(slot + s*slotSize + valueOffset);
+ --elements;
+
+ // If there is no run of groupSize non-empty slots that includes this one
+ // then no probe sequence can of passed over it, so it can be set empty
+ // rather than deleted...
+  nat32 after = MatchEmpty(ctrl + s);
+  nat32 before = MatchEmpty(ctrl + ((s-groupSize)&(capacity-1)));
+  nat32 runAfter = (after==0)?groupSize:__builtin_ctz(after);
+  nat32 runBefore = (before==0)?groupSize:(__builtin_clz(before) - (32-groupSize));
+  if (runAfter+runBefore<groupSize)
+  {
+   SetCtrl(s,empty);
+  }
+  else
+  {
+   SetCtrl(s,deleted);
+   ++dead;
+  }
+
+ return true;
+}
+
+void FlatHashCode::Resize(nat32 newCapacity)
+{
+ byte * oldCtrl = ctrl;
+ byte * oldSlot = slot;
+ nat32 oldCapacity = capacity;
+
+ capacity = newCapacity;
+ dead = 0;
+ ctrl = mem::Malloc<byte>(capacity+groupSize-1);
+ slot = mem::Malloc<byte>(capacity*slotSize);
+ for (nat32 i=0;i<capacity+groupSize-1;i++) ctrl[i] = empty;
+
+ for (nat32 i=0;i<oldCapacity;i++)
+ {
+  if ((oldCtrl[i]&0x80)==0)
+  {
+   byte * from = oldSlot + i*slotSize;
+   nat32 h = Hash(*(nat32*)(void*)from);
+   nat32 s = FreeSlot(h);
+   SetCtrl(s,byte(h&0x7F));
+   mem::Copy(slot + s*slotSize,from,slotSize);
+  }
+ }
+
+ mem::Free(oldCtrl);
+ mem::Free(oldSlot);
+}
+
+nat32 FlatHashCode::FreeSlot(nat32 h) const
+{
+ nat32 mask = capacity-1;
+ nat32 pos = (h>>7)&mask;
+ nat32 step = 0;
+ while (true)
+ {
+  nat32 m = MatchFree(ctrl+pos);
+  if (m) return (pos+__builtin_ctz(m))&mask;
+  step += groupSize;
+  pos = (pos+step)&mask;
+ }
+}
+
+nat32 FlatHashCode::CapacityFor(nat32 count)
+{
+ nat32 ret = groupSize;
+ while (count>ret-ret/8) ret *= 2;
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,279 @@
+#ifndef EOS_DS_FLAT_HASH_H
+#define EOS_DS_FLAT_HASH_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file flat_hash.h
+/// An open addressing hash table, where the keys and values are stored inline
+/// in a single flat array, so a lookup touches very little memory. Intended
+/// for the hot paths where SparseHash and DenseHash thrash the cache.
+
+#include "eos/types.h"
+#include "eos/typestring.h"
+#include "eos/mem/safety.h"
+
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#endif
+
+namespace eos
+{
+ namespace ds
+ {
+//------------------------------------------------------------------------------
+// The code for the FlatHash template...
+class EOS_CLASS FlatHashCode
+{
+ protected:
+   FlatHashCode(nat32 elementSize,nat32 elementAlign,nat32 reserve);
+   FlatHashCode(const FlatHashCode & rhs);
+  ~FlatHashCode(); // Doesn't clean up - must call Del to do that.
+
+  void Del(void (*Term)(void * ptr)); // The actual deconstructor, Term is called with a pointer to every stored element.
+  void Reset(nat32 reserve); // Sets the structure to be empty, call Del first.
+  void Copy(const FlatHashCode & rhs); // Call Del first, copys by mem::Copy, so fancy stuff can only be stored by pointer.
+
+  void Reserve(nat32 count); // Makes sure count elements can be stored without a resize.
+  void Rehash(); // Resizes to the smallest capacity that fits, which also clears out deleted slots.
+
+  void * GetCreate(nat32 index); // Never returns null, newly created elements are zeroed.
+  void Set(nat32 index,const void * in);
+  bit Unset(nat32 index,void (*Term)(void * ptr)); // Returns false if it wasn't there.
+
+  nat32 Memory() const {return (capacity==0)?sizeof(FlatHashCode):(capacity*(slotSize+1) + groupSize-1 + sizeof(FlatHashCode));}
+
+  // Returns a pointer to the element with the given index, null if its not
+  // there. This is the hot path so is inline...
+   void * Get(nat32 index) const
+   {
+    nat32 s = Find(index);
+    return (s==0xFFFFFFFF)?null<void*>():(slot + s*slotSize + valueOffset);
+   }
+
+  // Returns the slot containing index, or 0xFFFFFFFF if its not there...
+   nat32 Find(nat32 index) const
+   {
+    if (elements==0) return 0xFFFFFFFF;
+    nat32 h = Hash(index);
+    byte tag = byte(h&0x7F);
+    nat32 mask = capacity-1;
+    nat32 pos = (h>>7)&mask;
+    nat32 step = 0;
+    while (true)
+    {
+     nat32 m = MatchTag(ctrl+pos,tag);
+     while (m)
+     {
+      nat32 s = (pos+__builtin_ctz(m))&mask;
+      if (*(nat32*)(void*)(slot + s*slotSize)==index) return s;
+      m &= m-1;
+     }
+     if (MatchEmpty(ctrl+pos)) return 0xFFFFFFFF;
+     step += groupSize;
+     pos = (pos+step)&mask;
+    }
+   }
+
+
+  // Each slot has a control byte, which is either one of the below or a
+  // 7 bit tag taken from the hash of the key it contains. The control array
+  // has groupSize-1 extra bytes on the end, which mirror the start, so a group
+  // can allways be read in one go...
+   static const byte empty = 0x80;
+   static const byte deleted = 0xFE;
+   static const nat32 groupSize = 16;
+
+  // Bit masks of which bytes of the group match the condition...
+   static inline nat32 MatchTag(const byte * g,byte tag)
+   {
+    #ifdef __SSE2__
+     __m128i grp = _mm_loadu_si128((const __m128i*)(const void*)g);
+     return _mm_movemask_epi8(_mm_cmpeq_epi8(grp,_mm_set1_epi8(tag)));
+    #else
+     nat32 ret = 0;
+     for (nat32 i=0;i<groupSize;i++) {if (g[i]==tag) ret |= 1<<i;}
+     return ret;
+    #endif
+   }
+
+   static inline nat32 MatchEmpty(const byte * g) {return MatchTag(g,empty);}
+
+   static inline nat32 MatchFree(const byte * g) // Empty or deleted, i.e. the top bit is set.
+   {
+    #ifdef __SSE2__
+     return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(const void*)g));
+    #else
+     nat32 ret = 0;
+     for (nat32 i=0;i<groupSize;i++) {if (g[i]&0x80) ret |= 1<<i;}
+     return ret;
+    #endif
+   }
+
+  // A mixing function, as the indices are often tokens, which are sequential...
+   static inline nat32 Hash(nat32 index)
+   {
+    index ^= index>>16;
+    index *= 0x85ebca6b;
+    index ^= index>>13;
+    index *= 0xc2b2ae35;
+    index ^= index>>16;
+    return index;
+   }
+
+
+  nat32 elementSize;
+  nat32 valueOffset; // Offset of the element in a slot, after the nat32 key.
+  nat32 slotSize;
+
+  nat32 capacity; // Number of slots, 0 or a power of 2 that is at least groupSize.
+  nat32 elements; // Number of full slots.
+  nat32 dead; // Number of deleted slots.
+
+  byte * ctrl; // capacity + groupSize-1 control bytes.
+  byte * slot; // capacity slots.
+
+
+ private:
+  void Resize(nat32 newCapacity);
+  nat32 FreeSlot(nat32 h) const; // Returns the first empty or deleted slot in the probe sequence.
+  void SetCtrl(nat32 s,byte c) // Keeps the mirrored bytes up to date.
+  {
+   ctrl[s] = c;
+   if (s<groupSize-1) ctrl[capacity+s] = c;
+  }
+  static nat32 CapacityFor(nat32 count); // Smallest capacity that will hold count elements.
+};
+
+//------------------------------------------------------------------------------
+/// A hash table indexed by nat32, with the same interface as SparseHash so it
+/// can replace it. Open addressing is used, so the keys and values are stored
+/// inline in one flat array, and the table is probed 16 slots at a time by
+/// comparing a control byte per slot, with SSE2 when avaliable. This makes
+/// lookups far cheaper than SparseHash or DenseHash, which chase pointers,
+/// especially for misses. The table is kept at most 7/8 full, growing by
+/// doubling, and Size() is constant time. The cost is that resizing moves the
+/// elements, so any pointers into the table are invalidated by adding to it.
+/// As with SparseHash data is copied with mem::Copy, so T must be a plain type
+/// or a pointer, and DT only makes sense when T is a pointer for which Kill
+/// can be sensibly done.
+template <typename T,typename DT = mem::KillNull<T> >
+class EOS_CLASS FlatHash : public FlatHashCode
+{
+ public:
+  /// reserve is how many elements to make room for, to avoid resizing.
+   FlatHash(nat32 reserve = 0):FlatHashCode(sizeof(T),__alignof__(T),reserve) {}
+
+  /// &nbsp;
+   FlatHash(const FlatHash<T,DT> & rhs):FlatHashCode(rhs) {}
+
+  /// The copy constructor is templated on the type of DT, so any DT type can be
+  /// assigned to any other. Note that assignments should only be a deleting type
+  /// and a non-deleting type, as between two deleting types will result in double
+  /// deletion. Which is bad.
+   template <typename DTT>
+   FlatHash(const FlatHash<T,DTT> & rhs):FlatHashCode(rhs) {}
+
+  /// &nbsp;
+   ~FlatHash() {Del(&DelFunc);}
+
+
+  /// &nbsp;
+   FlatHash<T,DT> & operator = (const FlatHash<T,DT> & rhs)
+   {
+    if (this!=&rhs) {Del(&DelFunc); Copy(rhs);}
+    return *this;
+   }
+
+  /// This works on the same design principals as the copy constructor.
+   template <typename DTT>
+   FlatHash<T,DT> & operator = (const FlatHash<T,DTT> & rhs) {Del(&DelFunc); Copy(rhs); return *this;}
+
+
+  /// Resets the hash table to contain no data.
+   void Reset(nat32 reserve = 0) {Del(&DelFunc); FlatHashCode::Reset(reserve);}
+
+  /// Returns how many items are in the table.
+   nat32 Size() const {return elements;}
+
+  /// Returns how many slots the table has, it resizes when more than 7/8 of
+  /// them are full or deleted.
+   nat32 Capacity() const {return capacity;}
+
+  /// Returns how much memory the table is consuming.
+   nat32 Memory() const {return FlatHashCode::Memory();}
+
+  /// Makes room for the given number of items, so they can be added without a
+  /// resize.
+   void Reserve(nat32 count) {FlatHashCode::Reserve(count);}
+
+  /// Rebuilds the table at the smallest capacity that will hold its contents,
+  /// which also clears out the slots of unset items. Worth calling after a
+  /// lot of Unset calls.
+   void Rehash() {FlatHashCode::Rehash();}
+
+
+  /// This sets a value in the table, copying the given data in.
+   void Set(nat32 i,const T & in) {FlatHashCode::Set(i,&in);}
+
+  /// This returns a pointer to an item in the table, or null if the index given
+  /// does not map anywhere. Only valid until the table is next added to.
+   T * Get(nat32 i) const {return (T*)FlatHashCode::Get(i);}
+
+  /// This unsets the given index, assuming it exists, and deletes it etc as
+  /// relevent to the template definition, so it no longer appears to exist
+  /// and any associated resources are freed.
+   void Unset(nat32 i) {FlatHashCode::Unset(i,&DelFunc);}
+
+  /// This tests if an item exists, returning true if it does and false otherwise.
+   bit Exists(nat32 i) const {return Find(i)!=0xFFFFFFFF;}
+
+  /// This provides an array like interface to the structure, in the event the
+  /// requested index doesn't allready exist it is created, zeroed.
+   T & operator [] (nat32 i) {return *(T*)GetCreate(i);}
+
+
+  /// For iterating the contents, in no particular order - slots are numbered
+  /// 0..Capacity()-1, and this returns true if the given slot contains an item.
+   bit Full(nat32 s) const {return (ctrl[s]&0x80)==0;}
+
+  /// Returns the index of the item in a full slot.
+   nat32 Index(nat32 s) const {return *(nat32*)(void*)(slot + s*slotSize);}
+
+  /// Returns the item in a full slot.
+   T & Value(nat32 s) const {return *(T*)(void*)(slot + s*slotSize + valueOffset);}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::ds::FlatHash<" << typestring<T>() << "," << typestring<DT>() << ">");
+    return ret;
+   }
+
+
+ protected:
+  static void DelFunc(void * ptr)
+  {
+   DT::Kill((T*)ptr);
+  }
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
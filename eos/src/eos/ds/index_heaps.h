@@ -0,0 +1,231 @@
+#ifndef EOS_DS_INDEX_HEAPS_H
+#define EOS_DS_INDEX_HEAPS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file index_heaps.h
+/// Provides a keyed priority queue with true decrease-key, where each key knows
+/// where its item is in the heap so it can be moved or removed in place.
+
+#include "eos/types.h"
+#include "eos/typestring.h"
+
+#include "eos/math/functions.h"
+#include "eos/ds/arrays.h"
+#include "eos/ds/sorting.h"
+
+namespace eos
+{
+ namespace ds
+ {
+//------------------------------------------------------------------------------
+/// A priority queue of items that each have a key, a nat32 that should be
+/// densely packed from 0, which acts as the handle for the item. At most one
+/// item exists per key. Unlike LazyHeap an index from each key to its position
+/// in the heap is maintained, so changing an item sifts it to its new position
+/// and removing it takes it straight out - the heap never holds stale entries,
+/// which suits workloads where most items are changed or removed before they
+/// reach the top. All operations are logarithmic.
+///
+/// The heap is D-ary, 4 by default, with the comparison SO a compile time
+/// parameter so it gets inlined. The smallest item, as decided by SO, is
+/// returned first, with ties broken by key. Items are copied about, so should
+/// be small and simple.
+template <typename T, typename SO = SortOp<T>, nat32 D = 4>
+class EOS_CLASS IndexHeap
+{
+ public:
+  /// Starts empty.
+   IndexHeap():entries(0) {heap.Size(16);}
+
+  /// &nbsp;
+   ~IndexHeap() {}
+
+
+  /// Empties it, which also forgets all the keys.
+   void MakeEmpty()
+   {
+    entries = 0;
+    heap.Size(16);
+    pos.Size(0);
+   }
+
+  /// Returns how many items it contains.
+   nat32 Size() const {return entries;}
+
+  /// Returns true if the given key has an item.
+   bit Exists(nat32 k) const {return (k<pos.Size())&&(pos[k]!=nat32(-1));}
+
+  /// Returns the item for the given key, which must exist.
+   const T & Get(nat32 k) const {return heap[pos[k]].item;}
+
+
+  /// Adds an item for the given key, replacing any existing one.
+   void Add(nat32 k,const T & item)
+   {
+    if (Exists(k)) {Update(k,item); return;}
+
+    if (k>=pos.Size())
+    {
+     nat32 oldSize = pos.Size();
+     pos.Size(math::Max(k+1,oldSize*2));
+     for (nat32 i=oldSize;i<pos.Size();i++) pos[i] = nat32(-1);
+    }
+
+    if (entries==heap.Size()) heap.Size(heap.Size()*2);
+    heap[entries].item = item;
+    heap[entries].key = k;
+    pos[k] = entries;
+    Up(entries);
+    ++entries;
+   }
+
+  /// Replaces the item for an existing key with one that is no larger, as
+  /// decided by SO, so it only needs to move towards the top.
+   void DecreaseKey(nat32 k,const T & item)
+   {
+    nat32 i = pos[k];
+    heap[i].item = item;
+    Up(i);
+   }
+
+  /// Replaces the item for an existing key with an arbitrary new one.
+   void Update(nat32 k,const T & item)
+   {
+    nat32 i = pos[k];
+    heap[i].item = item;
+    if ((i!=0)&&Less(i,(i-1)/D)) Up(i);
+                            else Down(i);
+   }
+
+  /// Removes the item for the given key, if any.
+   void Rem(nat32 k)
+   {
+    if (!Exists(k)) return;
+    nat32 i = pos[k];
+    pos[k] = nat32(-1);
+
+    --entries;
+    if (i!=entries)
+    {
+     Move(entries,i);
+     if ((i!=0)&&Less(i,(i-1)/D)) Up(i);
+                             else Down(i);
+    }
+   }
+
+
+  /// Returns the smallest item, outputting its key. Do not call if Size()==0.
+   const T & Peek(nat32 & k) const
+   {
+    k = heap[0].key;
+    return heap[0].item;
+   }
+
+  /// Removes the smallest item, outputting it and its key. Returns false if
+  /// empty.
+   bit Pop(nat32 & k,T & out)
+   {
+    if (entries==0) return false;
+
+    k = heap[0].key;
+    out = heap[0].item;
+    Rem(k);
+    return true;
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::ds::IndexHeap<" << typestring<T>() << "," << typestring<SO>() << ">");
+    return ret;
+   }
+
+
+ private:
+  struct Entry
+  {
+   T item;
+   nat32 key;
+  };
+
+  ds::Array<Entry> heap; // Capacity doubles as needed, entries in use.
+  nat32 entries;
+  ds::Array<nat32> pos; // Index into heap for each key, nat32(-1) if absent.
+
+  static bit Less(const Entry & a,const Entry & b)
+  {
+   if (SO::LessThan(a.item,b.item)) return true;
+   if (SO::LessThan(b.item,a.item)) return false;
+   return a.key<b.key; // So ties come out the same every time.
+  }
+
+  bit Less(nat32 a,nat32 b) const {return Less(heap[a],heap[b]);}
+
+  // Copies entry from to entry to, updating the key index...
+   void Move(nat32 from,nat32 to)
+   {
+    heap[to] = heap[from];
+    pos[heap[to].key] = to;
+   }
+
+  // Both sifts carry the entry in a temporary and only write it at the end...
+   void Up(nat32 i)
+   {
+    if (i==0) return;
+    Entry temp = heap[i];
+    while (i!=0)
+    {
+     nat32 parent = (i-1)/D;
+     if (!Less(temp,heap[parent])) break;
+     Move(parent,i);
+     i = parent;
+    }
+    heap[i] = temp;
+    pos[temp.key] = i;
+   }
+
+   void Down(nat32 i)
+   {
+    Entry temp = heap[i];
+    while (true)
+    {
+     nat32 first = i*D + 1;
+     if (first>=entries) break;
+     nat32 last = math::Min(first+D,entries);
+
+     nat32 best = first;
+     for (nat32 j=first+1;j<last;j++)
+     {
+      if (Less(j,best)) best = j;
+     }
+
+     if (!Less(heap[best],temp)) break;
+     Move(best,i);
+     i = best;
+    }
+    heap[i] = temp;
+    pos[temp.key] = i;
+   }
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -20,6 +20,10 @@
 #include "eos/math/functions.h"
 #include "eos/file/csv.h"
 
+#ifdef __SSE__
+ #include <xmmintrin.h>
+#endif
+
 namespace eos
 {
  namespace ds
@@ -783,12 +787,356 @@ InplaceKdTreeCode::Node * InplaceKdTreeCode::NearestEuc(nat32 dims,nat32 element
  return ret;
 }
 
-InplaceKdTreeCode::Node * InplaceKdTreeCode::Index(nat32 dims,nat32 elementSize,nat32 index)
+InplaceKdTreeCode::Node * InplaceKdTreeCode::Index(nat32 dims,nat32 elementSize,nat32 index) const
 {
  nat32 nodeSize = sizeof(Node) + dims*sizeof(real32) + elementSize;
  return (Node*)(void*)(data + nodeSize*index);
 }
 
+//------------------------------------------------------------------------------
+// Helpers for VectorKdTree...
+
+// Partially sorts perm[0..n-1], by the given dimension of the vectors it
+// indexes, so that perm[nth] is in its sorted position with everything before
+// less than or equal and everything after greater than or equal...
+static void SelectNth(nat32 * perm,nat32 n,nat32 nth,const real32 * in,nat32 stride,nat32 dim)
+{
+ int32 lo = 0;
+ int32 hi = n-1;
+ while (hi>lo)
+ {
+  real32 pivot = in[perm[(lo+hi)/2]*stride + dim];
+  int32 i = lo;
+  int32 j = hi;
+  while (i<=j)
+  {
+   while (in[perm[i]*stride + dim]<pivot) ++i;
+   while (in[perm[j]*stride + dim]>pivot) --j;
+   if (i<=j)
+   {
+    math::Swap(perm[i],perm[j]);
+    ++i;
+    --j;
+   }
+  }
+
+  if (int32(nth)<=j) hi = j;
+  else
+  {
+   if (int32(nth)>=i) lo = i;
+                 else break;
+  }
+ }
+}
+
+// Squared distance between two vectors of padDims entrys, both 16 byte 
+// aligned. Gives up early, returning something at least limit, once the 
+// partial sum reaches limit...
+static inline real32 DistSqr(const real32 * a,const real32 * b,nat32 padDims,real32 limit)
+{
+ #ifdef __SSE__
+  __m128 sum = _mm_setzero_ps();
+  nat32 i = 0;
+  for (;i+16<=padDims;i+=16)
+  {
+   __m128 d0 = _mm_sub_ps(_mm_load_ps(a+i),_mm_load_ps(b+i));
+   __m128 d1 = _mm_sub_ps(_mm_load_ps(a+i+4),_mm_load_ps(b+i+4));
+   __m128 d2 = _mm_sub_ps(_mm_load_ps(a+i+8),_mm_load_ps(b+i+8));
+   __m128 d3 = _mm_sub_ps(_mm_load_ps(a+i+12),_mm_load_ps(b+i+12));
+   sum = _mm_add_ps(sum,_mm_add_ps(_mm_add_ps(_mm_mul_ps(d0,d0),_mm_mul_ps(d1,d1)),
+                                   _mm_add_ps(_mm_mul_ps(d2,d2),_mm_mul_ps(d3,d3))));
+
+   __m128 t = _mm_add_ps(sum,_mm_movehl_ps(sum,sum));
+   t = _mm_add_ss(t,_mm_shuffle_ps(t,t,1));
+   if (_mm_cvtss_f32(t)>=limit) return limit;
+  }
+  for (;i<padDims;i+=4)
+  {
+   __m128 d = _mm_sub_ps(_mm_load_ps(a+i),_mm_load_ps(b+i));
+   sum = _mm_add_ps(sum,_mm_mul_ps(d,d));
+  }
+
+  __m128 t = _mm_add_ps(sum,_mm_movehl_ps(sum,sum));
+  t = _mm_add_ss(t,_mm_shuffle_ps(t,t,1));
+  return _mm_cvtss_f32(t);
+ #else
+  real32 ret = 0.0;
+  for (nat32 i=0;i<padDims;i+=4)
+  {
+   real32 d0 = a[i] - b[i];
+   real32 d1 = a[i+1] - b[i+1];
+   real32 d2 = a[i+2] - b[i+2];
+   real32 d3 = a[i+3] - b[i+3];
+   ret += (d0*d0 + d1*d1) + (d2*d2 + d3*d3);
+   if (((i&12)==12)&&(ret>=limit)) return limit;
+  }
+  return ret;
+ #endif
+}
+
+//------------------------------------------------------------------------------
+// Does the searching for a VectorKdTree, has the scratch memory so a batch of
+// queries only allocates once...
+class VectorKdTree::Searcher
+{
+ public:
+   Searcher(const VectorKdTree & t)
+   :tree(t),queue(64)
+   {
+    q = mem::AlignedMalloc<real32>(math::Max<nat32>(tree.padDims,4),16);
+    for (nat32 i=0;i<tree.padDims;i++) q[i] = 0.0;
+   }
+
+  ~Searcher() {mem::AlignedFree(q);}
+
+   nat32 Run(const real32 * query,nat32 kk,Match * o,nat32 checks)
+   {
+    k = kk;
+    out = o;
+    found = 0;
+    checked = 0;
+    worst = math::Infinity<real32>();
+    for (nat32 i=0;i<k;i++)
+    {
+     out[i].index = 0xFFFFFFFF;
+     out[i].dist = math::Infinity<real32>();
+    }
+    if ((k==0)||(tree.size==0)) return 0;
+
+    for (nat32 i=0;i<tree.dims;i++) q[i] = query[i];
+
+    // Best bin first - descend to the nearest leaf, storing the branches not
+    // taken, then keep taking the nearest branch until out of checks or all 
+    // branches are further than the k-th best so far...
+     queue.MakeEmpty();
+     Descend(0,0.0);
+     while (queue.Size()!=0)
+     {
+      if ((checks!=0)&&(checked>=checks)) break;
+      Branch br = queue.Peek();
+      queue.Rem();
+      if (br.bound>=worst) break;
+      Descend(br.node,br.bound);
+     }
+
+    for (nat32 i=0;i<found;i++) out[i].index = tree.index[out[i].index];
+    return found;
+   }
+
+
+ private:
+  struct Branch
+  {
+   real32 bound; // Lower bound on the squared distance to anything in the branch.
+   nat32 node;
+
+   bit operator < (const Branch & rhs) const {return bound<rhs.bound;}
+  };
+
+  const VectorKdTree & tree;
+  real32 * q; // The query, padded and aligned.
+  PriorityQueue<Branch> queue;
+
+  nat32 k;
+  Match * out; // Sorted, the first found entrys valid.
+  nat32 found;
+  real32 worst; // Distance of the k-th best, or infinity if not found k yet.
+  nat32 checked;
+
+  void Descend(nat32 n,real32 bound)
+  {
+   const Node * targ = tree.node + n;
+   while (targ->dim!=leaf)
+   {
+    real32 diff = q[targ->dim] - targ->split;
+    nat32 nearer = (diff<0.0)?targ->a:targ->b;
+    nat32 further = (diff<0.0)?targ->b:targ->a;
+
+    Branch br;
+    br.bound = math::Max(bound,diff*diff);
+    br.node = further;
+    if (br.bound<worst) queue.Add(br);
+
+    targ = tree.node + nearer;
+   }
+
+   for (nat32 i=targ->a;i<targ->b;i++)
+   {
+    real32 d = DistSqr(q,tree.vec + i*tree.padDims,tree.padDims,worst);
+    if (d<worst) Offer(i,d);
+   }
+   checked += targ->b - targ->a;
+  }
+
+  void Offer(nat32 i,real32 d)
+  {
+   nat32 pos = (found<k)?found:(k-1);
+   if (found<k) ++found;
+   while ((pos>0)&&(out[pos-1].dist>d))
+   {
+    out[pos] = out[pos-1];
+    --pos;
+   }
+   out[pos].index = i;
+   out[pos].dist = d;
+
+   if (found==k) worst = out[k-1].dist;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Functor for running a batch of queries with ParallelFor...
+class VectorKdTree::Batch
+{
+ public:
+  const VectorKdTree * tree;
+  const real32 * query;
+  nat32 stride;
+  nat32 k;
+  Match * out;
+  nat32 checks;
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   Searcher s(*tree);
+   for (nat32 i=begin;i<end;i++) s.Run(query + nat64(i)*stride,k,out + nat64(i)*k,checks);
+  }
+};
+
+//------------------------------------------------------------------------------
+VectorKdTree::VectorKdTree()
+:dims(0),padDims(0),size(0),vec(null<real32*>()),index(null<nat32*>()),nodes(0),node(null<Node*>())
+{}
+
+VectorKdTree::~VectorKdTree()
+{
+ mem::AlignedFree(vec);
+ mem::Free(index);
+ mem::Free(node);
+}
+
+void VectorKdTree::Build(nat32 d,nat32 count,const real32 * in,nat32 stride)
+{
+ LogTime("eos::ds::VectorKdTree::Build");
+
+ mem::AlignedFree(vec);
+ mem::Free(index);
+ mem::Free(node);
+
+ dims = d;
+ padDims = (dims+3)&(~nat32(3));
+ size = count;
+ if (stride==0) stride = dims;
+
+ // Build the tree, which sorts the permutation into tree order...
+  index = mem::Malloc<nat32>(size);
+  for (nat32 i=0;i<size;i++) index[i] = i;
+
+  nodes = (size==0)?0:CountNodes(size);
+  node = mem::Malloc<Node>(nodes);
+  if (size!=0)
+  {
+   real64 * temp = new real64[dims*2];
+   nat32 next = 0;
+   MakeNode(next,index,0,size,in,stride,temp);
+   delete[] temp;
+  }
+
+ // Copy the vectors into a contiguous block, in tree order...
+  vec = mem::AlignedMalloc<real32>(math::Max<nat32>(size*padDims,1));
+  for (nat32 i=0;i<size;i++)
+  {
+   real32 * targ = vec + i*padDims;
+   const real32 * from = in + nat64(index[i])*stride;
+   for (nat32 j=0;j<dims;j++) targ[j] = from[j];
+   for (nat32 j=dims;j<padDims;j++) targ[j] = 0.0;
+  }
+}
+
+nat32 VectorKdTree::Nearest(const real32 * query,nat32 k,Match * out,nat32 checks) const
+{
+ Searcher s(*this);
+ return s.Run(query,k,out,checks);
+}
+
+void VectorKdTree::Nearest(nat32 count,const real32 * query,nat32 stride,nat32 k,Match * out,
+                           nat32 checks,mt::TaskPool & pool) const
+{
+ LogTime("eos::ds::VectorKdTree::Nearest");
+
+ Batch batch;
+ batch.tree = this;
+ batch.query = query;
+ batch.stride = (stride==0)?dims:stride;
+ batch.k = k;
+ batch.out = out;
+ batch.checks = checks;
+
+ mt::ParallelFor(0,count,batch,16,pool);
+}
+
+nat32 VectorKdTree::CountNodes(nat32 n)
+{
+ if (n<=leafSize) return 1;
+ return 1 + CountNodes(n/2) + CountNodes(n-n/2);
+}
+
+nat32 VectorKdTree::MakeNode(nat32 & next,nat32 * perm,nat32 begin,nat32 end,const real32 * in,nat32 stride,real64 * temp)
+{
+ nat32 ret = next;
+ ++next;
+
+ nat32 n = end - begin;
+ if (n<=leafSize)
+ {
+  node[ret].dim = leaf;
+  node[ret].split = 0.0;
+  node[ret].a = begin;
+  node[ret].b = end;
+  return ret;
+ }
+
+ // Split on the dimension with the greatest variance, estimated from a 
+ // sample so large nodes don't cost to much...
+  real64 * sum = temp;
+  real64 * sqr = temp + dims;
+  for (nat32 i=0;i<dims;i++) {sum[i] = 0.0; sqr[i] = 0.0;}
+
+  nat32 step = math::Max<nat32>(n/64,1);
+  for (nat32 i=begin;i<end;i+=step)
+  {
+   const real32 * v = in + nat64(perm[i])*stride;
+   for (nat32 j=0;j<dims;j++)
+   {
+    sum[j] += v[j];
+    sqr[j] += math::Sqr(real64(v[j]));
+   }
+  }
+
+  nat32 dim = 0;
+  real64 best = -1.0;
+  for (nat32 j=0;j<dims;j++)
+  {
+   real64 var = sqr[j] - math::Sqr(sum[j])/real64((n+step-1)/step);
+   if (var>best) {best = var; dim = j;}
+  }
+
+ // Split at the median...
+  nat32 mid = n/2;
+  SelectNth(perm+begin,n,mid,in,stride,dim);
+
+  node[ret].dim = dim;
+  node[ret].split = in[nat64(perm[begin+mid])*stride + dim];
+
+ // Recurse...
+  nat32 left = MakeNode(next,perm,begin,begin+mid,in,stride,temp);
+  nat32 right = MakeNode(next,perm,begin+mid,end,in,stride,temp);
+  node[ret].a = left;
+  node[ret].b = right;
+
+ return ret;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -34,6 +34,7 @@
 #include "eos/ds/arrays.h"
 #include "eos/ds/priority_queues.h"
 #include "eos/math/vectors.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -281,7 +282,7 @@ class EOS_CLASS InplaceKdTreeCode
    
    Node * NearestMan(nat32 dims,nat32 elementSize,const real32 * pos,real32 * dist);
    Node * NearestEuc(nat32 dims,nat32 elementSize,const real32 * pos,real32 * dist);
-   Node * Index(nat32 dims,nat32 elementSize,nat32 index);
+   Node * Index(nat32 dims,nat32 elementSize,nat32 index) const;
    
 
   // Variables...
@@ -405,6 +406,122 @@ class EOS_CLASS InplaceKdTree : public InplaceKdTreeCode
    }
 };
 
+//------------------------------------------------------------------------------
+/// A kd-tree for matching high dimensional feature vectors, such as the 128
+/// dimensional descriptors of filter::SiftFeature. Unlike KdTree the vectors
+/// are copied into one contiguous block of real32, in tree order, with the
+/// dimensions padded to a multiple of 4 so distances can be done with SSE,
+/// and each leaf holds a small bucket of vectors rather than just one.
+///
+/// Queries return the k nearest neighbours by squared euclidean distance,
+/// either exactly or approximately using the same best bin first search as 
+/// KdTree::ApproxNearest, which stops after a given number of vectors have 
+/// been checked. At 128 dimensions an exact search will visit most of the 
+/// tree, so the approximate search is the one to use, with a few hundred 
+/// checks being typical. Queries are const, so once built the tree can be 
+/// queried from multiple threads, and a batch query that runs in parallel 
+/// is provided.
+class EOS_CLASS VectorKdTree
+{
+ public:
+  /// &nbsp;
+   VectorKdTree();
+
+  /// &nbsp;
+   ~VectorKdTree();
+
+
+  /// Builds the tree, replacing any previous contents.
+  /// \param dims Number of dimensions of each vector.
+  /// \param count Number of vectors.
+  /// \param vec The vectors, vector i starting at vec + i*stride. Copied, so need not be kept arround.
+  /// \param stride Number of real32 between the start of each vector, 0 to use dims.
+   void Build(nat32 dims,nat32 count,const real32 * vec,nat32 stride = 0);
+
+  /// Builds the tree from an array of vectors.
+   template <nat32 S,typename MTT,typename DTT>
+   void Build(const Array<math::Vect<S,real32>,MTT,DTT> & in)
+   {
+    Build(S,in.Size(),(in.Size()==0)?null<const real32*>():in[0].Ptr(),sizeof(math::Vect<S,real32>)/sizeof(real32));
+   }
+
+
+  /// Returns how many vectors are in the tree.
+   nat32 Size() const {return size;}
+
+  /// Returns the dimensionality of the vectors.
+   nat32 Dims() const {return dims;}
+
+  /// Returns how much memory is being used, in bytes.
+   nat32 Memory() const {return sizeof(*this) + size*(padDims*sizeof(real32) + sizeof(nat32)) + nodes*sizeof(Node);}
+
+
+  /// The result of a query - the index of a vector, as given to Build, and its
+  /// squared distance from the query.
+   struct Match
+   {
+    nat32 index;
+    real32 dist;
+   };
+
+  /// Finds the k nearest neighbours of the given query vector, which has Dims()
+  /// entrys.
+  /// \param query The vector to find the neighbours of.
+  /// \param k How many neighbours to find.
+  /// \param out Output, k Match structures sorted nearest first. If fewer than k
+  ///            are found the remainder have an index of 0xFFFFFFFF and an 
+  ///            infinite distance.
+  /// \param checks Maximum number of vectors to check before giving up, for 
+  ///               approximate search. 0 to do an exact search.
+  /// \returns The number of neighbours found.
+   nat32 Nearest(const real32 * query,nat32 k,Match * out,nat32 checks = 0) const;
+
+  /// The batch version of Nearest, finds the k nearest neighbours of count 
+  /// queries, query i starting at query + i*stride, outputting to out + i*k.
+  /// The queries are spread over the given TaskPool.
+   void Nearest(nat32 count,const real32 * query,nat32 stride,nat32 k,Match * out,
+                nat32 checks = 0,mt::TaskPool & pool = mt::DefaultPool()) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::ds::VectorKdTree";}
+
+
+ private:
+  class Searcher;
+  friend class Searcher;
+  class Batch;
+  friend class Batch;
+
+  static const nat32 leafSize = 8;
+  static const nat32 leaf = 0xFFFFFFFF; // Value of dim for a leaf.
+
+  struct Node
+  {
+   nat32 dim; // Dimension split on, leaf for a leaf.
+   real32 split; // Values less than go left, greater or equal right.
+   nat32 a; // For internal nodes the left and right children, for leaves the range [a,b) of vectors.
+   nat32 b;
+  };
+
+  nat32 dims;
+  nat32 padDims; // dims rounded up to a multiple of 4, the padding being zeros.
+  nat32 size;
+  real32 * vec; // mem::AlignedMalloc-ed, size*padDims, in tree order.
+  nat32 * index; // For each vector in tree order its index as given to Build.
+
+  nat32 nodes;
+  Node * node; // Node 0 is the root.
+
+  // Recursive helpers for Build...
+   static nat32 CountNodes(nat32 n);
+   nat32 MakeNode(nat32 & next,nat32 * perm,nat32 begin,nat32 end,const real32 * in,nat32 stride,real64 * temp);
+
+  // Not copyable...
+   VectorKdTree(const VectorKdTree &);
+   VectorKdTree & operator = (const VectorKdTree &);
+};
+
 //------------------------------------------------------------------------------
  };
 };
@@ -17,19 +17,31 @@
 
 #include "eos/ds/layered_graphs.h"
 
+#include "eos/math/functions.h"
+
 namespace eos
 {
  namespace ds
  {
 //------------------------------------------------------------------------------
-LayeredGraphCode::LayeredGraphCode()
+namespace
 {
- // Setup the 'all' lists...
-  allNodes.MakeEmpty();
-  allLayers.MakeEmpty();
-  allEdges.MakeEmpty();
-  allSupers.MakeEmpty();
+ // Rounds an object size up to keep the arena aligned, and picks a block size
+ // that fits plenty of them...
+  nat32 ObjectSize(nat32 size) {return (size+7)&~nat32(7);}
+  nat32 BlockSize(nat32 size) {return math::Max(nat32(64*1024),ObjectSize(size)*64+nat32(sizeof(byte*)));}
+}
 
+LayeredGraphCode::LayeredGraphCode(const Size & size)
+:nodeStore(BlockSize(sizeof(Node)+size.node)),
+layerStore(BlockSize(sizeof(Layer)+size.layer)),
+edgeStore(BlockSize(sizeof(Edge)+size.edge)),
+superStore(BlockSize(sizeof(Super)+size.super)),
+nodeSize(ObjectSize(sizeof(Node)+size.node)),
+layerSize(ObjectSize(sizeof(Layer)+size.layer)),
+edgeSize(ObjectSize(sizeof(Edge)+size.edge)),
+superSize(ObjectSize(sizeof(Super)+size.super))
+{
  // Setup the 'current' lists...
   currentNodes.MakeEmpty();
   currentLayers.MakeEmpty();
@@ -42,38 +54,7 @@ LayeredGraphCode::LayeredGraphCode()
 
 LayeredGraphCode::~LayeredGraphCode()
 {
- // Iterate each 'all' list, terminate...
-  NodeLink * targNode = allNodes.next;
-  while (targNode->ptr)
-  {
-   Node * victim = targNode->ptr;
-   targNode = targNode->next;
-   mem::Free(victim);
-  }
-  
-  LayerLink * targLayer = allLayers.next;
-  while (targLayer->ptr)
-  {
-   Layer * victim = targLayer->ptr;
-   targLayer = targLayer->next;
-   mem::Free(victim);
-  }
-  
-  EdgeLink * targEdge = allEdges.next;
-  while (targEdge->ptr)
-  {
-   Edge * victim = targEdge->ptr;
-   targEdge = targEdge->next;
-   mem::Free(victim);
-  }
-  
-  SuperLink * targSuper = allSupers.next;
-  while (targSuper->ptr)
-  {
-   Super * victim = targSuper->ptr;
-   targSuper = targSuper->next;
-   mem::Free(victim);
-  }    
+ // Nothing - the arenas free everything...
 }
 
 nat32 LayeredGraphCode::AddLayer(const Size & size)
@@ -118,11 +99,9 @@ nat32 LayeredGraphCode::AddLayer(const Size & size)
   NodeLink * targNode = currentNodes.next;
   while (targNode->ptr)
   {
-   Layer * nl = (Layer*)(void*)mem::Malloc<byte>(sizeof(Layer) + size.layer);
+   Layer * nl = NewLayer();
    nl->index = ret;
    nl->successor = null<Layer*>();
-   nl->all.ptr = nl;
-   nl->all.AddEnd(allLayers);
    nl->current.ptr = nl;
    nl->current.AddEnd(currentLayers);
    nl->layer.ptr = nl;
@@ -142,20 +121,16 @@ nat32 LayeredGraphCode::AddLayer(const Size & size)
 LayeredGraphCode::Node * LayeredGraphCode::AddNode(const Size & size)
 {
  // Create the node itself...
-  Node * nn = (Node*)(void*)mem::Malloc<byte>(sizeof(Node) + size.node);
+  Node * nn = NewNode();
   nn->successor = null<Node*>();
-  nn->all.ptr = nn;
-  nn->all.AddEnd(allNodes);
   nn->current.ptr = nn;
   nn->current.AddEnd(currentNodes);
   nn->layer.MakeEmpty();
 
 
  // Create the nodes Super...
-  Super * ns = (Super*)(void*)mem::Malloc<byte>(sizeof(Super) + size.super);
+  Super * ns = NewSuper();
   ns->successor = null<Super*>();
-  ns->all.ptr = ns;
-  ns->all.AddEnd(allSupers);
   ns->current.ptr = ns;
   ns->current.AddEnd(currentSupers);
   ns->children.MakeEmpty();
@@ -168,11 +143,9 @@ LayeredGraphCode::Node * LayeredGraphCode::AddNode(const Size & size)
  // Create the Layer nodes for each layer... 
   for (nat32 i=0;i<layer.Size();i++)
   {
-   Layer * nl = (Layer*)(void*)mem::Malloc<byte>(sizeof(Layer) + size.layer);
+   Layer * nl = NewLayer();
    nl->index = i;
    nl->successor = null<Layer*>();
-   nl->all.ptr = nl;
-   nl->all.AddEnd(allLayers);
    nl->current.ptr = nl;
    nl->current.AddEnd(currentLayers);
    nl->layer.ptr = nl;
@@ -196,10 +169,8 @@ LayeredGraphCode::Edge * LayeredGraphCode::AddEdge(const Size & size,Layer * a,L
  while (b->successor) b = b->successor;
  if (a==b) return null<Edge*>();
 
- Edge * ne = (Edge*)(void*)mem::Malloc<byte>(sizeof(Edge) + size.edge);
+ Edge * ne = NewEdge();
  ne->successor = null<Edge*>();
- ne->all.ptr = ne;
- ne->all.AddEnd(allEdges);
  ne->current.ptr = ne;
  ne->current.AddEnd(currentEdges);
  ne->layer.ptr = ne;
@@ -231,10 +202,8 @@ LayeredGraphCode::Edge * LayeredGraphCode::AddEdge(const Size & size,nat32 l,Nod
 LayeredGraphCode::Node * LayeredGraphCode::MergeNodes(const Size & size,Node * a,Node * b)
 {
  // Create the merged node, fiddle with its predecessors...
-  Node * nn = (Node*)(void*)mem::Malloc<byte>(sizeof(Node) + size.node);
+  Node * nn = NewNode();
   nn->successor = null<Node*>();
-  nn->all.ptr = nn;
-  nn->all.AddEnd(allNodes);
   nn->current.ptr = nn;
   nn->current.AddEnd(currentNodes);
   nn->layer.MakeEmpty();
@@ -257,10 +226,8 @@ LayeredGraphCode::Node * LayeredGraphCode::MergeNodes(const Size & size,Node * a
   }
   else
   {
-   Super * ns = (Super*)(void*)mem::Malloc<byte>(sizeof(Super) + size.super);
+   Super * ns = NewSuper();
    ns->successor = null<Super*>();
-   ns->all.ptr = ns;
-   ns->all.AddEnd(allSupers);
    ns->current.ptr = ns;
    ns->current.AddEnd(currentSupers);
 
@@ -310,11 +277,9 @@ LayeredGraphCode::Node * LayeredGraphCode::MergeNodes(const Size & size,Node * a
     else
     {
      // Make a new head...
-      Layer * nl = (Layer*)(void*)mem::Malloc<byte>(sizeof(Layer) + size.layer);
+      Layer * nl = NewLayer();
       nl->index = headA->index;
       nl->successor = null<Layer*>();
-      nl->all.ptr = nl;
-      nl->all.AddEnd(allLayers);
       nl->current.ptr = nl;
       nl->current.AddEnd(currentLayers);
       nl->layer.ptr = nl;
@@ -353,11 +318,9 @@ LayeredGraphCode::Layer * LayeredGraphCode::MergeLayers(const Size & size,Layer
   if (a==b) return a;
 
  // Create new layer...
-  Layer * nl = (Layer*)(void*)mem::Malloc<byte>(sizeof(Layer) + size.layer);
+  Layer * nl = NewLayer();
   nl->index = a->index;
-  nl->successor = null<Layer*>();
-  nl->all.ptr = nl;
-  nl->all.AddEnd(allLayers);  
+  nl->successor = null<Layer*>();  
   nl->current.ptr = nl;
   nl->current.AddEnd(currentLayers);
   nl->layer.ptr = nl;
@@ -25,6 +25,7 @@
 /// structure, where there are multiple things that may be equal between nodes.
 
 #include "eos/types.h"
+#include "eos/mem/packer.h"
 #include "eos/ds/arrays.h"
 
 namespace eos
@@ -35,8 +36,9 @@ namespace eos
 // Code for the layered graph flat template...
 // (Its quite nasty.)
 // Notes:
-// - All data storage malloced.
-// - Other than 'all' lists all other lists only contain the 'current' model.
+// - All data storage comes from an arena per type, so its all freed at once and
+//   objects of a type are laid out in creation order.
+// - All lists only contain the 'current' model.
 // - The previous model is never deleted however, so you can always work from old 
 //   pointers to current state representatives.
 // - If iterating a list from which your current item is removed the handle will
@@ -189,11 +191,10 @@ class EOS_CLASS LayeredGraphCode
   // Structure to store a Node...
    struct Node
    {
-    // Standard data set - all linked list that contains everything,
-    // current linked list which contains non-superceded nodes, and successor
-    // which points to the successor Node when it has been replaced...
+    // Standard data set - current linked list which contains non-superceded
+    // nodes, and successor which points to the successor Node when it has
+    // been replaced...
      Node * successor;
-     NodeLink all;
      NodeLink current; // Will be nulled (next) if not current.
 
     // For linked list of its Layer nodes - these are kept in layer order...
@@ -214,11 +215,10 @@ class EOS_CLASS LayeredGraphCode
    {
     nat32 index; // Its layer number.
 
-    // Standard data set - all linked list that contains everything,
-    // current linked list which contains non-superceded nodes, and successor
-    // which points to the successor Node when it has been replaced...
+    // Standard data set - current linked list which contains non-superceded
+    // nodes, and successor which points to the successor Node when it has
+    // been replaced...
      Layer * successor;
-     LayerLink all;
      LayerLink current; // Will be nulled (next) if not current.
 
     // Linked list of the layer it is in...
@@ -245,11 +245,10 @@ class EOS_CLASS LayeredGraphCode
   // Structure to store an edge...
    struct Edge
    {
-    // Standard data set - all linked list that contains everything,
-    // current linked list which contains non-superceded nodes, and successor
-    // which points to the successor Node when it has been replaced...
+    // Standard data set - current linked list which contains non-superceded
+    // nodes, and successor which points to the successor Node when it has
+    // been replaced...
      Edge * successor;
-     EdgeLink all;
      EdgeLink current; // Will be nulled (next) if not current.
 
     // Linked list for the layer its in...
@@ -270,11 +269,10 @@ class EOS_CLASS LayeredGraphCode
   // Structure to store a Super...
    struct Super
    {
-    // Standard data set - all linked list that contains everything,
-    // current linked list which contains non-superceded nodes, and successor
-    // which points to the successor Node when it has been replaced...
+    // Standard data set - current linked list which contains non-superceded
+    // nodes, and successor which points to the successor Node when it has
+    // been replaced...
      Super * successor;
-     SuperLink all;
      SuperLink current; // Will be nulled (next) if not current.
      
     // Linked list of nodes that form part of the super. Nulled if successor.
@@ -286,11 +284,17 @@ class EOS_CLASS LayeredGraphCode
 
 
   // Storage...
-   // Storage of everything, for deletion...
-    NodeLink allNodes;
-    LayerLink allLayers;
-    EdgeLink allEdges;
-    SuperLink allSupers;
+   // Arenas that everything is allocated from, never freed until destruction,
+   // with the size of each object rounded up to keep them aligned...
+    mem::Packer nodeStore;
+    mem::Packer layerStore;
+    mem::Packer edgeStore;
+    mem::Packer superStore;
+
+    nat32 nodeSize;
+    nat32 layerSize;
+    nat32 edgeSize;
+    nat32 superSize;
 
    // Storage of only the current state, without any depreciated stuff...
     NodeLink currentNodes;
@@ -313,7 +317,7 @@ class EOS_CLASS LayeredGraphCode
 
 
   // Methods (All passed input should be current)...
-    LayeredGraphCode();
+    LayeredGraphCode(const Size & size);
    ~LayeredGraphCode();
   
    nat32 AddLayer(const Size & size);
@@ -328,6 +332,12 @@ class EOS_CLASS LayeredGraphCode
    bit Merged(Node * a,Node * b) const;
 
 
+  // Allocators, from the arenas...
+   Node * NewNode() {return (Node*)(void*)nodeStore.Malloc<byte>(nodeSize);}
+   Layer * NewLayer() {return (Layer*)(void*)layerStore.Malloc<byte>(layerSize);}
+   Edge * NewEdge() {return (Edge*)(void*)edgeStore.Malloc<byte>(edgeSize);}
+   Super * NewSuper() {return (Super*)(void*)superStore.Malloc<byte>(superSize);}
+
   // Helper method - this merges edges from two Layers into a single Layer.
   // Done twice in above methods, hence seperated to here...
   // (out must contain an empty edge list.)
@@ -872,7 +882,7 @@ class EOS_CLASS LayeredGraph : public LayeredGraphCode
    
  // Methods...   
   /// &nbsp;
-   LayeredGraph() {}
+   LayeredGraph():LayeredGraphCode(Size(sizeof(NT),sizeof(LT),sizeof(ET),sizeof(ST))) {}
    
   /// &nbsp;
    ~LayeredGraph() {}
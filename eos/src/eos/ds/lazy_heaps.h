@@ -0,0 +1,259 @@
+#ifndef EOS_DS_LAZY_HEAPS_H
+#define EOS_DS_LAZY_HEAPS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file lazy_heaps.h
+/// Provides a keyed priority queue where changing or removing an item is
+/// constant time, for algorithms that constantly re-prioritise things, e.g.
+/// greedy mesh simplification.
+
+#include "eos/types.h"
+#include "eos/typestring.h"
+
+#include "eos/math/functions.h"
+#include "eos/ds/arrays.h"
+#include "eos/ds/sorting.h"
+
+namespace eos
+{
+ namespace ds
+ {
+//------------------------------------------------------------------------------
+/// A priority queue of items that each have a key, a nat32 that should be
+/// densely packed from 0. At most one item exists per key, adding a new one
+/// replacing the old, and items can be removed by key. Both are constant time
+/// as they are lazy - the heap entries are versioned, and changing a key simply
+/// increments its version, so the old entry is stale and discarded when it
+/// reaches the top. When stale entries come to outnumber the live ones the heap
+/// is rebuilt without them, so memory stays proportional to the live count.
+///
+/// The heap is D-ary, 4 by default, which is shallower than a binary heap and
+/// keeps each nodes children in the same cache line. The smallest item, as
+/// decided by SO, is returned first. Items are copied about, so should be
+/// small and simple.
+template <typename T, typename SO = SortOp<T>, nat32 D = 4>
+class EOS_CLASS LazyHeap
+{
+ public:
+  /// Starts empty.
+   LazyHeap():entries(0),live(0) {heap.Size(16);}
+
+  /// &nbsp;
+   ~LazyHeap() {}
+
+
+  /// Empties it, which also forgets all the keys.
+   void MakeEmpty()
+   {
+    entries = 0;
+    live = 0;
+    heap.Size(16);
+    key.Size(0);
+   }
+
+  /// Returns how many live items it contains.
+   nat32 Size() const {return live;}
+
+  /// Returns how many entries are in the heap, which includes stale ones.
+   nat32 Entries() const {return entries;}
+
+  /// Returns true if the given key has an item.
+   bit Exists(nat32 k) const {return (k<key.Size())&&key[k].live;}
+
+
+  /// Adds an item for the given key, replacing any existing one.
+   void Add(nat32 k,const T & item)
+   {
+    Rem(k);
+
+    if (k>=key.Size())
+    {
+     nat32 oldSize = key.Size();
+     key.Size(math::Max(k+1,oldSize*2));
+     for (nat32 i=oldSize;i<key.Size();i++)
+     {
+      key[i].version = 0;
+      key[i].live = false;
+     }
+    }
+    key[k].live = true;
+    ++live;
+
+    if (entries==heap.Size()) heap.Size(heap.Size()*2);
+    heap[entries].item = item;
+    heap[entries].key = k;
+    heap[entries].version = key[k].version;
+    Up(entries);
+    ++entries;
+   }
+
+  /// Removes the item for the given key, if any.
+   void Rem(nat32 k)
+   {
+    if (!Exists(k)) return;
+    key[k].version += 1;
+    key[k].live = false;
+    --live;
+
+    if (entries>2*live+64) Compact();
+   }
+
+
+  /// Returns the smallest item, outputting its key. Do not call if Size()==0.
+   const T & Peek(nat32 & k)
+   {
+    Clean();
+    k = heap[0].key;
+    return heap[0].item;
+   }
+
+  /// Removes the smallest item, outputting it and its key. Returns false if
+  /// empty.
+   bit Pop(nat32 & k,T & out)
+   {
+    if (live==0) return false;
+    Clean();
+
+    k = heap[0].key;
+    out = heap[0].item;
+    Rem(k);
+    return true;
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::ds::LazyHeap<" << typestring<T>() << "," << typestring<SO>() << ">");
+    return ret;
+   }
+
+
+ private:
+  struct Entry
+  {
+   T item;
+   nat32 key;
+   nat32 version;
+  };
+
+  struct Key
+  {
+   nat32 version;
+   bit live;
+  };
+
+  ds::Array<Entry> heap; // Capacity doubles as needed, entries in use.
+  nat32 entries;
+  ds::Array<Key> key;
+  nat32 live;
+
+  bit Stale(nat32 i) const
+  {
+   const Key & k = key[heap[i].key];
+   return (!k.live)||(k.version!=heap[i].version);
+  }
+
+  bit Less(nat32 a,nat32 b) const
+  {
+   if (SO::LessThan(heap[a].item,heap[b].item)) return true;
+   if (SO::LessThan(heap[b].item,heap[a].item)) return false;
+   return heap[a].key<heap[b].key; // So ties come out the same every time.
+  }
+
+  void Swap(nat32 a,nat32 b)
+  {
+   Entry temp = heap[a];
+   heap[a] = heap[b];
+   heap[b] = temp;
+  }
+
+  void Up(nat32 i)
+  {
+   while (i!=0)
+   {
+    nat32 parent = (i-1)/D;
+    if (!Less(i,parent)) break;
+    Swap(i,parent);
+    i = parent;
+   }
+  }
+
+  void Down(nat32 i)
+  {
+   while (true)
+   {
+    nat32 first = i*D + 1;
+    if (first>=entries) break;
+    nat32 last = math::Min(first+D,entries);
+
+    nat32 best = first;
+    for (nat32 j=first+1;j<last;j++)
+    {
+     if (Less(j,best)) best = j;
+    }
+
+    if (!Less(best,i)) break;
+    Swap(i,best);
+    i = best;
+   }
+  }
+
+  // Removes the top entry...
+   void RemTop()
+   {
+    --entries;
+    if (entries!=0)
+    {
+     heap[0] = heap[entries];
+     Down(0);
+    }
+   }
+
+  // Pops stale entries until the top is live, which it must be if live!=0...
+   void Clean()
+   {
+    while (Stale(0)) RemTop();
+   }
+
+  // Throws away every stale entry and re-heapifies...
+   void Compact()
+   {
+    nat32 out = 0;
+    for (nat32 i=0;i<entries;i++)
+    {
+     if (!Stale(i))
+     {
+      if (out!=i) heap[out] = heap[i];
+      ++out;
+     }
+    }
+    entries = out;
+
+    if (entries>1)
+    {
+     for (int32 i=int32((entries-2)/D);i>=0;i--) Down(nat32(i));
+    }
+   }
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -30,12 +30,10 @@ void ListCode::Del(void (*Term)(void * ptr))
  Node * targ = dummy.next;
  while (targ!=&dummy)
  {
-  Node * victim = targ;
+  Term((byte*)targ + sizeof(Node));
   targ = targ->next;
-  
-  Term((byte*)victim + sizeof(Node));
-  mem::Free((byte*)victim);
- }	
+ }
+ pool.Release();
 }
 
 void ListCode::Copy(nat32 elementSize,const ListCode & rhs)
@@ -52,10 +50,39 @@ void ListCode::Copy(nat32 elementSize,const ListCode & rhs)
  }
 }
 
+void ListCode::MakeEmpty(void (*Term)(void * ptr))
+{
+ Del(Term);
+ elements = 0;
+ dummy.next = &dummy;
+ dummy.last = &dummy;
+}
+
+void ListCode::Take(ListCode & rhs)
+{
+ pool.Swap(rhs.pool);
+ elements = rhs.elements;
+ if (elements==0)
+ {
+  dummy.next = &dummy;
+  dummy.last = &dummy;
+ }
+ else
+ {
+  dummy.next = rhs.dummy.next;
+  dummy.last = rhs.dummy.last;
+  dummy.next->last = &dummy;
+  dummy.last->next = &dummy;
+ }
+
+ rhs.elements = 0;
+ rhs.dummy.next = &rhs.dummy;
+ rhs.dummy.last = &rhs.dummy;
+}
+
 void ListCode::AddFront(nat32 elementSize,byte * data)
 {
- Node * nn = (Node*)mem::Malloc<byte>(sizeof(Node) + elementSize);
- mem::Copy((byte*)nn + sizeof(Node),data,elementSize);
+ Node * nn = NewNode(elementSize,data);
  
  nn->last = &dummy;
  nn->next = dummy.next;
@@ -67,8 +94,7 @@ void ListCode::AddFront(nat32 elementSize,byte * data)
 
 void ListCode::AddBack(nat32 elementSize,byte * data)
 {
- Node * nn = (Node*)mem::Malloc<byte>(sizeof(Node) + elementSize);
- mem::Copy((byte*)nn + sizeof(Node),data,elementSize);
+ Node * nn = NewNode(elementSize,data);
  
  nn->last = dummy.last;
  nn->next = &dummy;
@@ -85,8 +111,7 @@ void ListCode::RemFront()
  victim->next->last = victim->last;	
  victim->last->next = victim->next;
  
- mem::Free(victim);
- --elements;
+ FreeNode(victim);
 }
 
 void ListCode::RemBack()
@@ -96,8 +121,7 @@ void ListCode::RemBack()
  victim->next->last = victim->last;	
  victim->last->next = victim->next;
  
- mem::Free(victim);
- --elements;
+ FreeNode(victim);
 }
 
 void ListCode::RemFrontKill(void (*Term)(void * ptr))
@@ -108,8 +132,7 @@ void ListCode::RemFrontKill(void (*Term)(void * ptr))
  victim->last->next = victim->next;
  
  Term((byte*)victim + sizeof(Node));
- mem::Free(victim);
- --elements;
+ FreeNode(victim);
 }
 
 void ListCode::RemBackKill(void (*Term)(void * ptr))
@@ -120,8 +143,7 @@ void ListCode::RemBackKill(void (*Term)(void * ptr))
  victim->last->next = victim->next;
  
  Term((byte*)victim + sizeof(Node));
- mem::Free(victim);
- --elements;
+ FreeNode(victim);
 }
 
 void ListCode::Rem(ListCode::Node * victim)
@@ -129,8 +151,7 @@ void ListCode::Rem(ListCode::Node * victim)
  victim->next->last = victim->last;	
  victim->last->next = victim->next;
  
- mem::Free(victim);
- --elements;	
+ FreeNode(victim);
 }
 
 void ListCode::RemKill(ListCode::Node * victim,void (*Term)(void * ptr))
@@ -139,14 +160,12 @@ void ListCode::RemKill(ListCode::Node * victim,void (*Term)(void * ptr))
  victim->last->next = victim->next;
  
  Term((byte*)victim + sizeof(Node));
- mem::Free(victim);
- --elements;
+ FreeNode(victim);
 }
 
 ListCode::Node * ListCode::AddBefore(nat32 elementSize,byte * data,ListCode::Node * targ)
 {
- Node * nn = (Node*)mem::Malloc<byte>(sizeof(Node) + elementSize);
- mem::Copy((byte*)nn + sizeof(Node),data,elementSize);
+ Node * nn = NewNode(elementSize,data);
 
  nn->next = targ;
  nn->last = targ->last;
@@ -160,8 +179,7 @@ ListCode::Node * ListCode::AddBefore(nat32 elementSize,byte * data,ListCode::Nod
 
 ListCode::Node * ListCode::AddAfter(nat32 elementSize,byte * data,ListCode::Node * targ)
 {
- Node * nn = (Node*)mem::Malloc<byte>(sizeof(Node) + elementSize);
- mem::Copy((byte*)nn + sizeof(Node),data,elementSize);
+ Node * nn = NewNode(elementSize,data);
  
  nn->last = targ;
  nn->next = targ->next;
@@ -173,6 +191,20 @@ ListCode::Node * ListCode::AddAfter(nat32 elementSize,byte * data,ListCode::Node
  return nn;
 }
 
+ListCode::Node * ListCode::NewNode(nat32 elementSize,byte * data)
+{
+ Node * nn = (Node*)pool.Alloc(sizeof(Node) + elementSize);
+ mem::Copy((byte*)nn + sizeof(Node),data,elementSize);
+ return nn;
+}
+
+void ListCode::FreeNode(Node * victim)
+{
+ --elements;
+ if (elements==0) pool.Release();
+             else pool.Free(victim);
+}
+
 //------------------------------------------------------------------------------
  };
 };
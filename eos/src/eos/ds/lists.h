@@ -24,6 +24,7 @@
 #include "eos/types.h"
 #include "eos/typestring.h"
 #include "eos/mem/safety.h"
+#include "eos/mem/packer.h"
 
 namespace eos
 {
@@ -33,12 +34,14 @@ namespace eos
 class EOS_CLASS ListCode
 {
  public:
-  ListCode():elements(0) {dummy.next = &dummy; dummy.last = &dummy;}
+  ListCode(mem::Packer * packer = null<mem::Packer*>()):elements(0),pool(packer) {dummy.next = &dummy; dummy.last = &dummy;}
   ListCode(nat32 elementSize,const ListCode & rhs) {Copy(elementSize,rhs);}
   ~ListCode() {}
   
   void Del(void (*Term)(void * ptr)); // Call before the class dies, and before Copy, leaves class in dangerous state.
   void Copy(nat32 elementSize,const ListCode & rhs); // Does not delete the existing data, call Del first.
+  void MakeEmpty(void (*Term)(void * ptr)); // Del, then leaves it as a valid empty list.
+  void Take(ListCode & rhs); // Call Del first, moves the nodes and pool of rhs over, leaving it empty.
 
   void AddFront(nat32 elementSize,byte * data);
   void AddBack(nat32 elementSize,byte * data);
@@ -65,18 +68,27 @@ class EOS_CLASS ListCode
  Node * AddBefore(nat32 elementSize,byte * data,Node * targ); // Returns the node just created.
  Node * AddAfter(nat32 elementSize,byte * data,Node * targ); // Returns the node just created.
  
+ Node * NewNode(nat32 elementSize,byte * data);
+ void FreeNode(Node * victim); // Also decriments elements.
+
  nat32 elements;
  Node dummy; // Dummy node, marks the end and start of the list. Has no tail data.
+ mem::NodePool pool; // All the nodes come from here, released when the list empties.
 };
 
 //------------------------------------------------------------------------------
-/// A linked list implimentation, comes with an iterator as well.
+/// A linked list implimentation, comes with an iterator as well. The nodes are
+/// allocated in slabs, which are only released when the list is emptied.
 template <typename T, typename DT = mem::KillNull<T> >
 class EOS_CLASS List : protected ListCode
 {
  public:
   /// &nbsp;
    List() {}
+
+  /// Takes the memory for its nodes from the given Packer, which can be shared
+  /// between many containers and must outlive the list.
+   explicit List(mem::Packer * packer):ListCode(packer) {}
   
   /// A copy constructor designed to take an arbitary deallocator. Remember that
   /// storing an object pointer in two objects that are going to delete it is
@@ -89,13 +101,40 @@ class EOS_CLASS List : protected ListCode
    ~List() {Del(&DelFunc);}
   
   
-  /// This emptys the list, by calling RemFrontKill() until it is empty.
-   void Reset() {while (Size()!=0) RemFrontKill();}
+  /// This emptys the list, calling the deallocator on every item.
+   void Reset() {MakeEmpty(&DelFunc);}
+
+  /// Emptys the list without calling the deallocator, for when the items have
+  /// been copied elsewhere, which is then responsible for them.
+   void MakeEmptyUnsafe() {MakeEmpty(&NullDelFunc);}
+
+  /// Moves every item into the given array, in order, resizing it to match, and
+  /// leaves the list empty. The array takes over responsibility for the items,
+  /// so the deallocator is not called. Much faster than emptying the list one
+  /// item at a time for big lists.
+   template <typename AT>
+   void MoveTo(AT & out)
+   {
+    out.Size(elements);
+    nat32 i = 0;
+    for (Node * targ = dummy.next;targ!=&dummy;targ = targ->next)
+    {
+     out[i] = *(T*)((byte*)targ + sizeof(Node));
+     ++i;
+    }
+    MakeEmptyUnsafe();
+   }
    
   /// Same design as the copy constructor.
    template <typename DTT>
    List<T,DT> & operator = (const List<T,DTT> & rhs) {Del(&DelFunc); Copy(sizeof(T),rhs); return *this;}
 
+  /// Identical to operator =, except it also emptys the right hand side at the
+  /// same time, taking its nodes rather than copying them, in constant time
+  /// excluding the deallocator being called on the current contents. The node
+  /// pools are swapped, so if either list was given a Packer it changes sides.
+   void Take(List<T,DT> & rhs) {if (this!=&rhs) {Del(&DelFunc); ListCode::Take(rhs);}}
+
 
   /// Retursn the size of the list. When the list contains 0 items most of the methods will do bad
   /// things, so don't call them!
@@ -239,6 +278,9 @@ class EOS_CLASS List : protected ListCode
   {
    DT::Kill((T*)ptr);
   }
+
+  static void NullDelFunc(void * ptr)
+  {}
 };
 
 //------------------------------------------------------------------------------
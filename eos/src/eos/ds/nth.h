@@ -20,9 +20,12 @@
 
 /// \file nth.h
 /// The very definition of esoteric. A data structure for finding the minimum 
-/// out of several sets of the n-th smallest item within each data set.
+/// out of several sets of the n-th smallest item within each data set. Also
+/// provides selection, for finding the n-th smallest item of an array without
+/// sorting it.
 
 #include "eos/types.h"
+#include "eos/ds/sorting.h"
 
 namespace eos
 {
@@ -79,6 +82,115 @@ class EOS_CLASS MultiNth
   real32 * data; // sets*nth, as sets heaps.
 };
 
+//------------------------------------------------------------------------------
+/// Helper for HeapSort, moves item i down the max heap of the given size until
+/// it is in the right place.
+template <typename SO,typename T>
+inline void HeapDown(T * data,nat32 i,nat32 size)
+{
+ T item = data[i];
+ while (true)
+ {
+  nat32 child = 2*i + 1;
+  if (child>=size) break;
+  if ((child+1<size)&&SO::LessThan(data[child],data[child+1])) ++child;
+  if (!SO::LessThan(item,data[child])) break;
+  data[i] = data[child];
+  i = child;
+ }
+ data[i] = item;
+}
+
+/// Heap sorts the given array, using the given Sort. Slower than the quick sort
+/// of ds::Array, but never worse than O(n log n) and needs no extra memory - used
+/// by Select when it is getting nowhere.
+template <typename SO,typename T>
+inline void HeapSort(T * data,nat32 size)
+{
+ for (nat32 i=size/2;i>0;i--) HeapDown<SO>(data,i-1,size);
+ for (nat32 end=size;end>1;end--)
+ {
+  T temp = data[0]; data[0] = data[end-1]; data[end-1] = temp;
+  HeapDown<SO>(data,0,end-1);
+ }
+}
+
+/// Rearranges the given array so data[nth] is the item that would be there if
+/// it were sorted, with nothing before it greater and nothing after it less,
+/// i.e. order statistics without doing a sort. An introselect - a quick select
+/// with median of 3 pivots that falls back to a heap sort of what remains if
+/// the partitioning goes badly, so its expected linear time but never worse
+/// than O(n log n). Small ranges are finished with an insertion sort. For the
+/// median of an array of size n use nth = n/2, or (n-1)/2 for the lower median.
+/// Does nothing if nth is not less than size.
+template <typename SO,typename T>
+inline void Select(T * data,nat32 size,nat32 nth)
+{
+ if (nth>=size) return;
+
+ nat32 left = 0;
+ nat32 right = size-1;
+ nat32 depth = 0;
+ for (nat32 s=size;s>1;s>>=1) depth += 2;
+
+ while (right-left>16)
+ {
+  if (depth==0)
+  {
+   HeapSort<SO>(data+left,right-left+1);
+   return;
+  }
+  --depth;
+
+  // Sort the first, middle and last, then stick the middle, which is the
+  // pivot, into right-1; the first and last then act as sentinels...
+   nat32 mid = left + (right-left)/2;
+   T temp;
+   if (SO::LessThan(data[mid],data[left])) {temp = data[mid]; data[mid] = data[left]; data[left] = temp;}
+   if (SO::LessThan(data[right],data[left])) {temp = data[right]; data[right] = data[left]; data[left] = temp;}
+   if (SO::LessThan(data[right],data[mid])) {temp = data[right]; data[right] = data[mid]; data[mid] = temp;}
+   temp = data[mid]; data[mid] = data[right-1]; data[right-1] = temp;
+   T pivot = data[right-1];
+
+  // Partition...
+   nat32 i = left;
+   nat32 j = right-1;
+   while (true)
+   {
+    while (SO::LessThan(data[++i],pivot));
+    while (SO::LessThan(pivot,data[--j]));
+    if (i>=j) break;
+    temp = data[i]; data[i] = data[j]; data[j] = temp;
+   }
+   temp = data[i]; data[i] = data[right-1]; data[right-1] = temp;
+
+  // Keep the side with nth in...
+   if (nth==i) return;
+   if (nth<i) right = i-1;
+         else left = i+1;
+ }
+
+ // Insertion sort whats left...
+  for (nat32 i=left+1;i<=right;i++)
+  {
+   T item = data[i];
+   nat32 j = i;
+   while ((j>left)&&SO::LessThan(item,data[j-1]))
+   {
+    data[j] = data[j-1];
+    --j;
+   }
+   data[j] = item;
+  }
+}
+
+/// As Select, but uses the types own < operator.
+template <typename T>
+inline void SelectNorm(T * data,nat32 size,nat32 nth)
+{
+ Select< SortOp<T> >(data,size,nth);
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -68,10 +68,11 @@ void PriorityQueueCode::Copy(nat32 elementSize,const PriorityQueueCode & rhs)
 
 void PriorityQueueCode::Add(nat32 elementSize,void * in,bit (*LessThan)(void * lhs,void * rhs))
 {
- // On overflow, get larger...
+ // On overflow, get larger, doubling so big queues aren't copied on every few
+ // additions...
   if (elements==size)
   {
-   size += growthFactor;
+   size += (size>growthFactor)?size:growthFactor;
    byte * newData = mem::Malloc<byte>(size * elementSize);
    mem::Copy(newData,data,elementSize * elements);
    mem::Free(data);
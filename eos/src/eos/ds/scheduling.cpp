@@ -26,7 +26,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 SchedulerCode::SchedulerCode()
-:verts(0),edges(0),first(null<Vert*>())
+:verts(0),edges(0),first(null<Vert*>()),waveSize(0),waveTotal(0)
 {}
 
 SchedulerCode::~SchedulerCode()
@@ -58,6 +58,7 @@ void * SchedulerCode::MakeVert(nat32 elementSize,const void * data)
   nv->first = null<Edge*>();
   nv->incomming = 0;
   nv->inLeft = 0;
+  nv->wave = null<Vert*>();
 
  nv->next = first;
  nv->prev = null<Vert*>();
@@ -213,6 +214,47 @@ bit SchedulerCode::Sort()
   }
 }
 
+void * SchedulerCode::FirstWave()
+{
+ Vert * ret = null<Vert*>();
+ waveSize = 0;
+ for (Vert * targ = first;targ;targ = targ->next)
+ {
+  targ->inLeft = targ->incomming;
+  if (targ->incomming==0)
+  {
+   targ->wave = ret;
+   ret = targ;
+   ++waveSize;
+  }
+ }
+ 
+ waveTotal = waveSize;
+ return ret;
+}
+
+void * SchedulerCode::NextWave(void * wave)
+{
+ Vert * ret = null<Vert*>();
+ waveSize = 0;
+ for (Vert * targ = (Vert*)wave;targ;targ = targ->wave)
+ {
+  for (Edge * et = targ->first;et;et = et->next)
+  {
+   et->to->inLeft -= 1;
+   if (et->to->inLeft==0)
+   {
+    et->to->wave = ret;
+    ret = et->to;
+    ++waveSize;
+   }
+  }
+ }
+ 
+ waveTotal += waveSize;
+ return ret;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -29,6 +29,7 @@
 #include "eos/mem/alloc.h"
 #include "eos/mem/safety.h"
 #include "eos/mem/preempt.h"
+#include "eos/ds/arrays.h"
 
 namespace eos
 {
@@ -52,6 +53,8 @@ class EOS_CLASS SchedulerCode
 
   bit Sort(); // Makes the first linked list the correct order. Returns true on success, false on failure to having a cycle.
 
+  void * FirstWave(); // Returns the vertices with no incomming edges, linked by wave, ready for NextWave.
+  void * NextWave(void * wave); // Given the last wave returns the vertices freed by it, null when there are none left.
   
   struct Edge;
   
@@ -64,6 +67,7 @@ class EOS_CLASS SchedulerCode
    nat32 inLeft; // Number of edges that need to be 'deleted' before we can do this node.
    Vert * next; // Linked list in execution order, so it can be traversed. Also stored in non-execution order, and used to make a queue of nodes to be proccessed during the actual algorithm run.
    Vert * prev; // Previous node, a doubly linked list is easier to manage.
+   Vert * wave; // Next node in the same wave, when stepping through waves rather than the sorted order.
   };
   
   struct Edge // Allocated using the mem::pre8 or mem::pre16 allocator, depending on platform.
@@ -84,6 +88,9 @@ class EOS_CLASS SchedulerCode
   nat32 verts;
   nat32 edges;
   Vert * first;
+
+  nat32 waveSize; // Number of vertices in the last wave returned.
+  nat32 waveTotal; // Number of vertices in all waves returned so far.
 };
 
 //------------------------------------------------------------------------------
@@ -94,6 +101,12 @@ class EOS_CLASS SchedulerCode
 /// schedule, though you can't trust the handle after that point. If a cycle is
 /// created making a schedule impossible the schedular will return a bad handle,
 /// you can then either give up or delete constraints to remove the cycle.
+///
+/// Alternativly the jobs can be stepped through in waves, where each wave is
+/// every job whose constraints are only on jobs in earlier waves, so the jobs
+/// within a wave can all be done at once, in any order or in parallel. Only
+/// the current wave is ever linked together, so no schedule is built, and
+/// Levels gathers all the waves into arrays if they are wanted in one go.
 template <typename T,typename DT = mem::KillNull<T> >
 class EOS_CLASS Scheduler : public SchedulerCode
 {
@@ -137,6 +150,58 @@ class EOS_CLASS Scheduler : public SchedulerCode
    }
 
 
+  /// Starts stepping through the waves, returning the first job of the first
+  /// wave, which is the jobs with no constraints on them. Bad if there are no
+  /// jobs or every job is constrained, which can only happen with a cycle.
+  /// Use WaveNext to get the other jobs in the wave.
+   Job FirstWave() {return SchedulerCode::FirstWave();}
+
+  /// Given the first job of the current wave returns the first job of the
+  /// next, the jobs that were waiting on only the current and earlier waves.
+  /// Bad when they have all been done, at which point Complete says if that
+  /// is because there are none left or because of a cycle. The current wave
+  /// must be finished with, and no jobs or constraints may be added or deleted
+  /// whilst stepping through the waves.
+   Job NextWave(Job wave) {return SchedulerCode::NextWave(wave);}
+
+  /// Given a Job in a wave returns the next Job in the same wave, bad at the
+  /// end of the wave. The order within a wave is arbitary.
+   static Job WaveNext(Job job) {return ((Vert*)job)->wave;}
+
+  /// Returns how many jobs are in the wave last returned by FirstWave or
+  /// NextWave.
+   nat32 WaveSize() const {return waveSize;}
+
+  /// Returns true if every job has been in a wave returned so far, so once
+  /// NextWave has returned bad it is false only if there is a cycle.
+   bit Complete() const {return waveTotal==verts;}
+
+  /// Steps through every wave, outputting the jobs in wave order to job and
+  /// the offset of each wave into job to start, with one extra on the end, so
+  /// wave i is [start[i],start[i+1]). Returns false if there is a cycle, in
+  /// which case the outputs contain only the waves before it.
+   bit Levels(ds::Array<Job> & job,ds::Array<nat32> & start)
+   {
+    job.Size(verts);
+    start.Size(verts+1);
+
+    nat32 waves = 0;
+    nat32 out = 0;
+    Job wave = FirstWave();
+    while (Good(wave))
+    {
+     start[waves] = out; ++waves;
+     for (Job targ = wave;Good(targ);targ = WaveNext(targ)) job[out++] = targ;
+     wave = NextWave(wave);
+    }
+    start[waves] = out;
+
+    job.Size(out);
+    start.Size(waves+1);
+    return Complete();
+   }
+
+
   /// Converts a Job into its associated item.
    static T & Item(Job job) {return *(T*)(((Vert*)job)->Data());}
    
@@ -31,7 +31,7 @@ SortListCode::SortListCode(nat32 elementSize,const SortListCode & rhs)
 {
  if (rhs.top)
  {
-  top = Node::MakeNode(elementSize,*rhs.top);
+  top = Node::MakeNode(pool,elementSize,*rhs.top);
   top->parent = null<Node*>();
  }
  else top = null<Node*>();
@@ -43,6 +43,7 @@ void SortListCode::Del(void (*Term)(void * ptr))
  {
   top->Del(Term);
   top = null<Node*>();
+  pool.Release();
  }
 }
 
@@ -50,7 +51,7 @@ void SortListCode::Copy(nat32 elementSize,const SortListCode & rhs)
 {
  if (rhs.top)
  {
-  top = Node::MakeNode(elementSize,*rhs.top);
+  top = Node::MakeNode(pool,elementSize,*rhs.top);
   top->parent = null<Node*>();
  }
  else top = null<Node*>();
@@ -58,10 +59,10 @@ void SortListCode::Copy(nat32 elementSize,const SortListCode & rhs)
 
 void SortListCode::Add(nat32 elementSize,byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr))
 {
- if (top) top = top->Insert(elementSize,data,LessThan,Term);
+ if (top) top = top->Insert(pool,elementSize,data,LessThan,Term);
  else
  {
-  top = Node::MakeNode(elementSize,data);
+  top = Node::MakeNode(pool,elementSize,data);
   top->parent = null<Node*>();
  }
 }
@@ -100,7 +101,11 @@ void * SortListCode::Largest(byte * dummy,bit (*LessThan)(void * lhs,void * rhs)
 
 void SortListCode::Rem(byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr))
 {
- if (top) top = top->Remove(data,LessThan,Term);
+ if (top)
+ {
+  top = top->Remove(pool,data,LessThan,Term);
+  if (top==null<Node*>()) pool.Release();
+ }
 }
 
 void SortListCode::Iter(void (*Func)(void * item,void * ptr),void * ptr) const
@@ -164,10 +169,10 @@ bit SortListCode::Invariant() const
 }
 
 //------------------------------------------------------------------------------
-SortListCode::Node * SortListCode::Node::MakeNode(nat32 elementSize,void * data)
+SortListCode::Node * SortListCode::Node::MakeNode(mem::NodePool & pool,nat32 elementSize,void * data)
 {
  log::Assert(data,"SortList: ::MakeNode with null data");
- Node * ret = (Node*)mem::Malloc<byte>(sizeof(Node) + elementSize); log::Assert(ret,"SortList: Failed to malloc in MakeNode");
+ Node * ret = (Node*)pool.Alloc(sizeof(Node) + elementSize); log::Assert(ret,"SortList: Failed to malloc in MakeNode");
   ret->height = 0;
   ret->children = 0;
   ret->left = null<Node*>();
@@ -176,10 +181,10 @@ SortListCode::Node * SortListCode::Node::MakeNode(nat32 elementSize,void * data)
  return ret;
 }
 
-SortListCode::Node * SortListCode::Node::MakeNode(nat32 elementSize,const Node & copy)
+SortListCode::Node * SortListCode::Node::MakeNode(mem::NodePool & pool,nat32 elementSize,const Node & copy)
 {
  log::Assert(&copy,"SortList: Null copy given to MakeNode");
- Node * ret = (Node*)mem::Malloc<byte>(sizeof(Node) + elementSize);
+ Node * ret = (Node*)pool.Alloc(sizeof(Node) + elementSize);
  log::Assert(ret,"SortList: Failed to malloc in MakeNode copy");
  mem::Copy<byte>((byte*)ret + sizeof(Node),(byte*)(&copy) + sizeof(Node),elementSize);
 
@@ -188,14 +193,14 @@ SortListCode::Node * SortListCode::Node::MakeNode(nat32 elementSize,const Node &
 
  if (copy.left)
  {
-  ret->left = MakeNode(elementSize,*copy.left);
+  ret->left = MakeNode(pool,elementSize,*copy.left);
   ret->left->parent = ret;
  }
  else ret->left = null<Node*>();
  
  if (copy.right)
  {
-  ret->right = MakeNode(elementSize,*copy.right);
+  ret->right = MakeNode(pool,elementSize,*copy.right);
   ret->right->parent = ret;
  }
  else ret->right = null<Node*>();
@@ -209,7 +214,6 @@ SortListCode::Node * SortListCode::Node::MakeNode(nat32 elementSize,const Node &
  if (right) right->Del(Term);
 
  Term((byte*)this + sizeof(Node));
- mem::Free<byte>((byte*)this);
 }
 
 int32 SortListCode::Node::Height() const
@@ -272,7 +276,7 @@ SortListCode::Node * SortListCode::Node::RotDoubleRight()
  return RotRight();
 }
 
-SortListCode::Node * SortListCode::Node::Insert(nat32 elementSize,byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr))
+SortListCode::Node * SortListCode::Node::Insert(mem::NodePool & pool,nat32 elementSize,byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr))
 {
  log::Assert(this,"SortList: Null this in insert");
  Node * ret = this;
@@ -280,10 +284,10 @@ SortListCode::Node * SortListCode::Node::Insert(nat32 elementSize,byte * data,bi
  if (LessThan(data,(byte*)this + sizeof(Node)))
  {
   // We go left...
-   if (left) left = left->Insert(elementSize,data,LessThan,Term);
+   if (left) left = left->Insert(pool,elementSize,data,LessThan,Term);
    else
    {
-    left = (Node*)mem::Malloc<byte>(sizeof(Node) + elementSize);
+    left = (Node*)pool.Alloc(sizeof(Node) + elementSize);
     left->height = 0;
     left->children = 0;
     left->parent = this;
@@ -301,10 +305,10 @@ SortListCode::Node * SortListCode::Node::Insert(nat32 elementSize,byte * data,bi
  else if (LessThan((byte*)this + sizeof(Node),data))
  {
   // We go right...
-   if (right) right = right->Insert(elementSize,data,LessThan,Term);
+   if (right) right = right->Insert(pool,elementSize,data,LessThan,Term);
    else
    {
-    right = (Node*)mem::Malloc<byte>(sizeof(Node) + elementSize);
+    right = (Node*)pool.Alloc(sizeof(Node) + elementSize);
     right->height = 0;
     right->children = 0;
     right->parent = this;
@@ -332,7 +336,7 @@ SortListCode::Node * SortListCode::Node::Insert(nat32 elementSize,byte * data,bi
  return ret;
 }
 
-SortListCode::Node * SortListCode::Node::Remove(byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr))
+SortListCode::Node * SortListCode::Node::Remove(mem::NodePool & pool,byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr))
 {
  // Attempt to find the node to die...
   Node * targ = this;
@@ -356,7 +360,7 @@ SortListCode::Node * SortListCode::Node::Remove(byte * data,bit (*LessThan)(void
     log::Assert(targ==this);
     Node * ret = targ->right;
      Term((byte*)targ + sizeof(Node));
-     mem::Free<byte>((byte*)targ);
+     pool.Free(targ);
     if (ret) ret->parent = null<Node*>();
     return ret;
    }
@@ -370,7 +374,7 @@ SortListCode::Node * SortListCode::Node::Remove(byte * data,bit (*LessThan)(void
     // Delete, and rebalance from parent...
      Node * p = targ->parent;
      Term((byte*)targ + sizeof(Node));
-     mem::Free<byte>((byte*)targ);
+     pool.Free(targ);
      targ = p;
    }
   }
@@ -383,7 +387,7 @@ SortListCode::Node * SortListCode::Node::Remove(byte * data,bit (*LessThan)(void
      log::Assert(targ==this);
      Node * ret = targ->left;
       Term((byte*)targ + sizeof(Node));
-      mem::Free<byte>((byte*)targ);
+      pool.Free(targ);
      if (ret) ret->parent = null<Node*>();
      return ret;
     }
@@ -397,7 +401,7 @@ SortListCode::Node * SortListCode::Node::Remove(byte * data,bit (*LessThan)(void
      // Delete, and rebalance from parent...
       Node * p = targ->parent;
       Term((byte*)targ + sizeof(Node));
-      mem::Free<byte>((byte*)targ);
+      pool.Free(targ);
       targ = p;
     }
    }
@@ -458,7 +462,7 @@ SortListCode::Node * SortListCode::Node::Remove(byte * data,bit (*LessThan)(void
 
       // Deletion...
        Term((byte*)toDie + sizeof(Node));
-       mem::Free<byte>((byte*)toDie);
+       pool.Free(toDie);
    }  
   }
 
@@ -27,6 +27,7 @@
 #include "eos/types.h"
 #include "eos/typestring.h"
 #include "eos/mem/safety.h"
+#include "eos/mem/packer.h"
 #include "eos/ds/sorting.h"
 #include "eos/ds/iteration.h"
 #include "eos/ds/stacks.h"
@@ -40,7 +41,7 @@ namespace eos
 class EOS_CLASS SortListCode
 {
  protected:
-   SortListCode():top(null<Node*>()) {}
+   SortListCode(mem::Packer * packer = null<mem::Packer*>()):top(null<Node*>()),pool(packer) {}
    SortListCode(nat32 elementSize,const SortListCode & rhs);
   ~SortListCode() {}
 
@@ -66,9 +67,9 @@ class EOS_CLASS SortListCode
    class EOS_CLASS Node
    {
     public:
-     static Node * MakeNode(nat32 elementSize,void * data); // A constructor, essentially.
-     static Node * MakeNode(nat32 elementSize,const Node & copy); // A recursive function used to Copy sets of nodes, essentially a constructor.
-     void Del(void (*Term)(void * ptr)); // Deletes all children and then comits suicide.
+     static Node * MakeNode(mem::NodePool & pool,nat32 elementSize,void * data); // A constructor, essentially.
+     static Node * MakeNode(mem::NodePool & pool,nat32 elementSize,const Node & copy); // A recursive function used to Copy sets of nodes, essentially a constructor.
+     void Del(void (*Term)(void * ptr)); // Calls Term on itself and all children, the memory goes when the pool is released.
      int32 Height() const; // Can be saftly called with this==null.
      nat32 Count() const; // Includes node it is called on, safe to call when this==null.
 
@@ -81,10 +82,10 @@ class EOS_CLASS SortListCode
 
      // Does an insertion returning the new this. If it has to replace data it calls
      // Term on it first...
-      Node * Insert(nat32 elementSize,byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr));
+      Node * Insert(mem::NodePool & pool,nat32 elementSize,byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr));
 
      // Removes a node. Calls Term on the data before its is blown away.
-      Node * Remove(byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr));
+      Node * Remove(mem::NodePool & pool,byte * data,bit (*LessThan)(void * lhs,void * rhs),void (*Term)(void * ptr));
 
 
      // Iterates every item...
@@ -109,6 +110,8 @@ class EOS_CLASS SortListCode
      Node * right;
    } * top;
 
+  mem::NodePool pool; // All the nodes come from here, released when the list empties.
+
   // Internal class, used for iterating the entire list...
    class EOS_CLASS CursorCode
    {
@@ -143,6 +146,10 @@ class EOS_CLASS SortList : public SortListCode
   /// &nbsp;
    SortList() {}
 
+  /// Takes the memory for its nodes from the given Packer, which can be shared
+  /// between many containers and must outlive the list.
+   explicit SortList(mem::Packer * packer):SortListCode(packer) {}
+
   /// The copy constructor is templated on the type of DT, so any DT type can be
   /// assigned to any other. Note that assignments should only be a deleting type
   /// and a non-deleting type, as between two deleting types will result in double
@@ -175,7 +182,23 @@ class EOS_CLASS SortList : public SortListCode
   /// it makes sense.
    template <typename DTT>
    void Take(SortList<T,SO,DTT> & rhs)
-   {Del(&DelFunc); top = rhs.top; rhs.top = null<Node*>();}
+   {Del(&DelFunc); top = rhs.top; rhs.top = null<Node*>(); pool.Swap(rhs.pool);}
+
+  /// Moves every item into the given array, in sorted order, resizing it to
+  /// match, and leaves the list empty. The array takes over responsibility for
+  /// the items, so the deallocator is not called.
+   template <typename AT>
+   void MoveTo(AT & out)
+   {
+    out.Size(Size());
+    nat32 i = 0;
+    for (Cursor targ = FrontPtr();!targ.Bad();++targ)
+    {
+     out[i] = *targ;
+     ++i;
+    }
+    MakeEmptyUnsafe();
+   }
 
 
   /// Given another list of the same type this adds to this list all items in
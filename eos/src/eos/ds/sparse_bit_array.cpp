@@ -19,6 +19,10 @@
 
 #include "eos/file/csv.h"
 
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#endif
+
 namespace eos
 {
  namespace ds
@@ -64,6 +68,11 @@ void SparseBitArray::Set(nat32 index)
  {
   size += 1;
   targ3->n[offset[4]] ^= 1<<offset[5];
+
+  data.used |= nat64(1)<<offset[0];
+  targ0->used |= nat64(1)<<offset[1];
+  targ1->used |= nat64(1)<<offset[2];
+  targ2->used |= nat64(1)<<offset[3];
  }
 }
 
@@ -90,10 +99,25 @@ void SparseBitArray::Unset(nat32 index)
  offset[4] = (index>>5)&0x07;
  offset[5] = index&0x1F; 
  
- if (targ3->n[offset[4]]>>offset[5])
+ if ((targ3->n[offset[4]]>>offset[5])&1)
  {
   size -= 1;
   targ3->n[offset[4]] ^= 1<<offset[5];
+
+  // Clear the used flags of any nodes that have just become empty...
+   if (targ3->Empty())
+   {
+    targ2->used &= ~(nat64(1)<<offset[3]);
+    if (targ2->Empty())
+    {
+     targ1->used &= ~(nat64(1)<<offset[2]);
+     if (targ1->Empty())
+     {
+      targ0->used &= ~(nat64(1)<<offset[1]);
+      if (targ0->Empty()) data.used &= ~(nat64(1)<<offset[0]);
+     }
+    }
+   }
  }
 }
 
@@ -119,7 +143,7 @@ bit SparseBitArray::operator[](nat32 index) const
  
  offset[4] = (index>>5)&0x07;
  offset[5] = index&0x1F; 
- return bit(targ3->n[offset[4]]>>offset[5]);
+ return bit((targ3->n[offset[4]]>>offset[5])&1);
 }
 
 nat32 SparseBitArray::Size() const
@@ -129,180 +153,115 @@ nat32 SparseBitArray::Size() const
 
 bit SparseBitArray::NextInc(nat32 & index) const
 {
- nat32 offset[5];
- offset[0] = index>>26;
- offset[1] = (index>>20)&0x3F;
- offset[2] = (index>>14)&0x3F;
- offset[3] = (index>>8)&0x3F;
- offset[4] = index&0xFF;
+ return data.NextInc(index);
+}
 
- for (nat32 i0=offset[0];i0<64;i0++)
- {
-  Split64< Split64< Split64<Bit256> > > * targ0 = data.ptr[i0];
-  if (targ0)
-  {
-   for (nat32 i1=offset[1];i1<64;i1++)
-   {
-    Split64< Split64<Bit256> > * targ1 = targ0->ptr[i1];
-    if (targ1)
-    {
-     for (nat32 i2=offset[2];i2<64;i2++)
-     {
-      Split64<Bit256> * targ2 = targ1->ptr[i2];
-      if (targ2)
-      {
-       for (nat32 i3=offset[3];i3<64;i3++)
-       {
-        Bit256 * targ3 = targ2->ptr[i3]; 
-        if (targ3)
-        {
-         // We have a 256 bit block to check, and an offset to check from...          
-          bit ret = targ3->NextInc(offset[4]);
-          if (ret)
-          {
-           index = (i0<<26) | (i1<<20) | (i2<<14) | (i3<<8) | offset[4];
-           return true;
-          }
-        }
-        offset[4] = 0;
-       }
-      }
-      offset[3] = 0;
-     }
-    }
-    offset[2] = 0;
-   }
-  }
-  offset[1] = 0;
- }
- return false;
+void SparseBitArray::Or(const SparseBitArray & rhs)
+{
+ size += data.Or(rhs.data);
+}
+
+void SparseBitArray::And(const SparseBitArray & rhs)
+{
+ size -= data.And(rhs.data);
+}
+
+void SparseBitArray::Xor(const SparseBitArray & rhs)
+{
+ size += data.Xor(rhs.data);
+}
+
+void SparseBitArray::AndNot(const SparseBitArray & rhs)
+{
+ size -= data.AndNot(rhs.data);
+}
+
+nat32 SparseBitArray::Count(const SparseBitArray & rhs) const
+{
+ return data.CountAnd(rhs.data);
 }
 
 //------------------------------------------------------------------------------
-// Helper for below...
-bit NextIncByte(byte b,nat32 & index)
+bit SparseBitArray::Bit256::NextInc(nat32 & index) const
 {
- if ((b&0x0F)&&(index<4))
- {
-  if ((b&0x03)&&(index<2))
-  {
-   if ((b&0x01)&&(index==0))
-   {
-    return true;
-   }
-   if (b&0x02)
-   {
-    index = 1;
-    return true;
-   }
-  }
-  if (b&0x0C)
-  {
-   if ((b&0x04)&&(index<3))
-   {
-    index = 2;
-    return true;
-   }
-   if (b&0x08)
-   {
-    index = 3;
-    return true;
-   }
-  }
- }
- if (b&0xF0)
+ nat32 i = index>>5;
+ nat32 m = n[i] & (nat32(0xFFFFFFFF)<<(index&0x1F));
+ while (true)
  {
-  if ((b&0x30)&&(index<6))
+  if (m)
   {
-   if ((b&0x10)&&(index<5))
-   {
-    index = 4;
-    return true;
-   }
-   if (b&0x20)
-   {
-    index = 5;
-    return true;
-   }
-  }
-  if (b&0xC0)
-  {
-   if ((b&0x40)&&(index<7))
-   {
-    index = 6;
-    return true;
-   }
-   if (b&0x80)
-   {
-    index = 7;
-    return true;
-   }
+   index = (i<<5) | nat32(__builtin_ctz(m));
+   return true;
   }
+  ++i;
+  if (i==8) return false;
+  m = n[i];
  }
- return false;
 }
 
-bit SparseBitArray::Bit256::NextInc(nat32 & index) const
+nat32 SparseBitArray::Bit256::Count() const
 {
- nat32 offset = index&0x1F;
- for (nat32 i=(index>>5);i<8;i++)
- {
-  if ((n[i]&0x0000FFFF)&&(offset<16))
-  {
-   if ((n[i]&0x000000FF)&&(offset<8))
-   {
-    bit ret = NextIncByte(byte(n[i]&0xFF),offset);
-    if (ret)
-    {
-     index = (i<<5) | offset;
-     return true;
-    }
-   }
-   if (n[i]&0x0000FF00)
-   {
-    nat32 temp;
-    if (offset>8) temp = offset - 8;
-             else temp = 0;
-    bit ret = NextIncByte(byte((n[i]>>8)&0xFF),temp);
-    if (ret)
-    {
-     index = (i<<5) | (temp+8);
-     return true;
-    }    
-   }
-  }
-  if (n[i]&0xFFFF0000)
-  {
-   if ((n[i]&0x00FF0000)&&(offset<24))
-   {
-    nat32 temp;
-    if (offset>16) temp = offset - 16;
-              else temp = 0;
-    bit ret = NextIncByte(byte((n[i]>>16)&0xFF),temp);
-    if (ret)
-    {
-     index = (i<<5) | (temp+16);
-     return true;
-    }   
-   }
-   if (n[i]&0xFF000000)
-   {
-    nat32 temp;
-    if (offset>24) temp = offset - 24;
-              else temp = 0;
-    bit ret = NextIncByte(byte((n[i]>>24)&0xFF),temp);
-    if (ret)
-    {
-     index = (i<<5) | (temp+24);
-     return true;
-    }
-   }
-  }
+ const nat64 * w = (const nat64*)(const void*)n;
+ return __builtin_popcountll(w[0]) + __builtin_popcountll(w[1]) +
+        __builtin_popcountll(w[2]) + __builtin_popcountll(w[3]);
+}
 
-  offset = 0;
- }
+// The combining methods do the 256 bits as two 128 bit operations when SSE2 is
+// avaliable, or eight 32 bit operations otherwise; the counts before and after
+// give the change in size...
+#ifdef __SSE2__
+ #define EOS_BIT256_OP(sse,op) \
+  __m128i * a = (__m128i*)(void*)n; \
+  const __m128i * b = (const __m128i*)(const void*)rhs.n; \
+  _mm_storeu_si128(a,sse(_mm_loadu_si128(a),_mm_loadu_si128(b))); \
+  _mm_storeu_si128(a+1,sse(_mm_loadu_si128(a+1),_mm_loadu_si128(b+1)));
+ #define EOS_BIT256_ANDNOT \
+  __m128i * a = (__m128i*)(void*)n; \
+  const __m128i * b = (const __m128i*)(const void*)rhs.n; \
+  _mm_storeu_si128(a,_mm_andnot_si128(_mm_loadu_si128(b),_mm_loadu_si128(a))); \
+  _mm_storeu_si128(a+1,_mm_andnot_si128(_mm_loadu_si128(b+1),_mm_loadu_si128(a+1)));
+#else
+ #define EOS_BIT256_OP(sse,op) for (nat32 i=0;i<8;i++) n[i] op rhs.n[i];
+ #define EOS_BIT256_ANDNOT for (nat32 i=0;i<8;i++) n[i] &= ~rhs.n[i];
+#endif
+
+nat32 SparseBitArray::Bit256::Or(const Bit256 & rhs)
+{
+ nat32 before = Count();
+ EOS_BIT256_OP(_mm_or_si128,|=)
+ return Count() - before;
+}
+
+nat32 SparseBitArray::Bit256::And(const Bit256 & rhs)
+{
+ nat32 before = Count();
+ EOS_BIT256_OP(_mm_and_si128,&=)
+ return before - Count();
+}
+
+int32 SparseBitArray::Bit256::Xor(const Bit256 & rhs)
+{
+ int32 before = Count();
+ EOS_BIT256_OP(_mm_xor_si128,^=)
+ return int32(Count()) - before;
+}
+
+nat32 SparseBitArray::Bit256::AndNot(const Bit256 & rhs)
+{
+ nat32 before = Count();
+ EOS_BIT256_ANDNOT
+ return before - Count();
+}
+
+#undef EOS_BIT256_OP
+#undef EOS_BIT256_ANDNOT
 
- return false;
+nat32 SparseBitArray::Bit256::CountAnd(const Bit256 & rhs) const
+{
+ const nat64 * a = (const nat64*)(const void*)n;
+ const nat64 * b = (const nat64*)(const void*)rhs.n;
+ return __builtin_popcountll(a[0]&b[0]) + __builtin_popcountll(a[1]&b[1]) +
+        __builtin_popcountll(a[2]&b[2]) + __builtin_popcountll(a[3]&b[3]);
 }
 
 //------------------------------------------------------------------------------
@@ -35,7 +35,10 @@ namespace eos
 /// Bits can be set and unset, you can also reset all bits to false again. Uses
 /// a sparse data structure, with efficient memory allocation.
 /// Designed with the expectation that bits will clump, as blocks of bits are 
-/// used.
+/// used. It is a tree of 64 way nodes with 256 bit blocks for leaves, where
+/// each node records which of its children contain set bits, so the empty
+/// parts of the index range cost nothing to skip whether the set bits are
+/// dense or scattered. Sets can be combined a block at a time.
 class EOS_CLASS SparseBitArray
 {
  public:
@@ -46,10 +49,8 @@ class EOS_CLASS SparseBitArray
    ~SparseBitArray();
 
 
-  /// Resets all bits to be false. Run time is very roughly O(n) where n 
-  /// is the number of bits set true. It has an inner loop so tight though
-  /// that you would need extremelly tight values for this to become time
-  /// consuming.
+  /// Resets all bits to be false. Run time is O(n) where n is the number of
+  /// blocks containing set bits. The memory is kept for the next use.
    void Reset();
 
   /// Sets a bit true. Approximatly O(1).
@@ -72,15 +73,41 @@ class EOS_CLASS SparseBitArray
   /// Approximatly O(1).
    bit NextInc(nat32 & index) const;
 
+  /// Calls func(nat32 index) for every bit that is true, in increasing order
+  /// of index. Faster than looping with NextInc, as it never has to search.
+   template <typename F>
+   void ForEach(F & func) const {data.ForEach(0,func);}
+
+
+  /// Sets this to the union of itself and the given array.
+   void Or(const SparseBitArray & rhs);
+
+  /// Sets this to the intersection of itself and the given array.
+   void And(const SparseBitArray & rhs);
+
+  /// Sets this to the bits that are true in exactly one of itself and the
+  /// given array.
+   void Xor(const SparseBitArray & rhs);
+
+  /// Unsets every bit that is true in the given array.
+   void AndNot(const SparseBitArray & rhs);
+
+  /// Returns how many bits are true in both this and the given array, without
+  /// changing either.
+   nat32 Count(const SparseBitArray & rhs) const;
+
 
   /// &nbsp;
    cstrconst TypeString() const {return "eos::ds::SparseBitArray";}
 
 
  private:
-  // Structure of bits, with helper methods...
+  // Structure of bits, with helper methods. The combining methods return how
+  // many bits were added or removed, Xor the change...
    struct Bit256
    {
+    static const nat32 bits = 8; // log2 of the number of indices covered.
+
     Bit256() {mem::Null(n,8);}
    
     void * operator new(size_t size) {log::Assert(size==32); return mem::pre32.Malloc<Bit256>();}
@@ -91,18 +118,153 @@ class EOS_CLASS SparseBitArray
     bit NextInc(nat32 & index) const;
     void Reset() {mem::Null(n,8);}
 
+    bit Empty() const {return (n[0]|n[1]|n[2]|n[3]|n[4]|n[5]|n[6]|n[7])==0;}
+    nat32 Count() const;
+
+    nat32 Or(const Bit256 & rhs);
+    nat32 And(const Bit256 & rhs);
+    int32 Xor(const Bit256 & rhs);
+    nat32 AndNot(const Bit256 & rhs);
+    nat32 CountAnd(const Bit256 & rhs) const;
+
+    template <typename F>
+    void ForEach(nat32 base,F & func) const
+    {
+     for (nat32 i=0;i<8;i++)
+     {
+      nat32 m = n[i];
+      while (m)
+      {
+       func(base | (i<<5) | nat32(__builtin_ctz(m)));
+       m &= m-1;
+      }
+     }
+    }
+
     nat32 n[8]; // 32 bytes. We count the low (&0x01) bits as being first in the sequence, for each nat32.
    };
 
-  // Structure used for the below...
+  // Structure used for the below. used has bit i set if ptr[i] exists and
+  // contains a set bit - children can exist and be empty, so there memory is
+  // reused after a Reset...
    template <typename T>
    struct Split64
    {
-     Split64() {for (nat32 i=0;i<64;i++) ptr[i] = null<T*>();}
+     static const nat32 bits = T::bits + 6;
+
+     Split64():used(0) {for (nat32 i=0;i<64;i++) ptr[i] = null<T*>();}
     ~Split64() {for (nat32 i=0;i<64;i++) delete ptr[i];}
     
-    void Reset() {for (nat32 i=0;i<64;i++) {if (ptr[i]) ptr[i]->Reset();}}
+    void Reset()
+    {
+     for (nat64 m=used;m;m&=m-1) ptr[__builtin_ctzll(m)]->Reset();
+     used = 0;
+    }
+
+    bit Empty() const {return used==0;}
+
+    nat32 Count() const
+    {
+     nat32 ret = 0;
+     for (nat64 m=used;m;m&=m-1) ret += ptr[__builtin_ctzll(m)]->Count();
+     return ret;
+    }
+
+    bit NextInc(nat32 & index) const
+    {
+     nat32 first = index>>T::bits;
+     nat32 local = index & ((nat32(1)<<T::bits)-1);
+     for (nat64 m=used&(nat64(0xFFFFFFFFFFFFFFFFULL)<<first);m;m&=m-1)
+     {
+      nat32 i = __builtin_ctzll(m);
+      if (i!=first) local = 0;
+      if (ptr[i]->NextInc(local))
+      {
+       index = (i<<T::bits) | local;
+       return true;
+      }
+     }
+     return false;
+    }
+
+    template <typename F>
+    void ForEach(nat32 base,F & func) const
+    {
+     for (nat64 m=used;m;m&=m-1)
+     {
+      nat32 i = __builtin_ctzll(m);
+      ptr[i]->ForEach(base | (i<<T::bits),func);
+     }
+    }
+
+    nat32 Or(const Split64<T> & rhs)
+    {
+     nat32 ret = 0;
+     for (nat64 m=rhs.used;m;m&=m-1)
+     {
+      nat32 i = __builtin_ctzll(m);
+      if (ptr[i]==null<T*>()) ptr[i] = new T();
+      ret += ptr[i]->Or(*rhs.ptr[i]);
+     }
+     used |= rhs.used;
+     return ret;
+    }
+
+    nat32 And(const Split64<T> & rhs)
+    {
+     nat32 ret = 0;
+     for (nat64 m=used;m;m&=m-1)
+     {
+      nat32 i = __builtin_ctzll(m);
+      if (rhs.used&(nat64(1)<<i)) ret += ptr[i]->And(*rhs.ptr[i]);
+      else
+      {
+       ret += ptr[i]->Count();
+       ptr[i]->Reset();
+      }
+      if (ptr[i]->Empty()) used &= ~(nat64(1)<<i);
+     }
+     return ret;
+    }
+
+    int32 Xor(const Split64<T> & rhs)
+    {
+     int32 ret = 0;
+     for (nat64 m=rhs.used;m;m&=m-1)
+     {
+      nat32 i = __builtin_ctzll(m);
+      if (ptr[i]==null<T*>()) ptr[i] = new T();
+      ret += ptr[i]->Xor(*rhs.ptr[i]);
+      if (ptr[i]->Empty()) used &= ~(nat64(1)<<i);
+                      else used |= nat64(1)<<i;
+     }
+     return ret;
+    }
+
+    nat32 AndNot(const Split64<T> & rhs)
+    {
+     nat32 ret = 0;
+     for (nat64 m=used&rhs.used;m;m&=m-1)
+     {
+      nat32 i = __builtin_ctzll(m);
+      ret += ptr[i]->AndNot(*rhs.ptr[i]);
+      if (ptr[i]->Empty()) used &= ~(nat64(1)<<i);
+     }
+     return ret;
+    }
+
+    nat32 CountAnd(const Split64<T> & rhs) const
+    {
+     nat32 ret = 0;
+     for (nat64 m=used&rhs.used;m;m&=m-1)
+     {
+      nat32 i = __builtin_ctzll(m);
+      ret += ptr[i]->CountAnd(*rhs.ptr[i]);
+     }
+     return ret;
+    }
    
+    nat64 used;
     T * ptr[64]; // 256 bytes on a 32 bit computer.
    };
   
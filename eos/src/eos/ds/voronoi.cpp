@@ -28,7 +28,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 Delaunay2DCode::Delaunay2DCode()
-:first(null<Site*>()),sites(0),triangles(1),oldTriangles(0)
+:triStore(64*1024),first(null<Site*>()),sites(0),triangles(1),oldTriangles(0)
 {
  root.children = 0;
  for (nat32 i=0;i<3;i++)
@@ -57,7 +57,7 @@ Delaunay2DCode::~Delaunay2DCode()
 
 void Delaunay2DCode::Del(void (*Term)(void * ptr))
 {
- root.DelChildren();
+ triStore.Reset();
  root.children = 0;
  for (nat32 i=0;i<3;i++) root.next[i] = null<Triangle*>();
 
@@ -80,27 +80,125 @@ void Delaunay2DCode::Reset(void (*Term)(void * ptr))
  triangles = 1;
  oldTriangles = 0;
 
- root.children = 0;
- for (nat32 i=0;i<3;i++)
+ // The infinite vertices are kept...
+  root.children = 0;
+  for (nat32 i=0;i<3;i++)
+  {
+   root.partner[i] = null<Triangle*>();
+   root.next[i] = null<Triangle*>();
+
+   root.vert[i]->neighbours = 1;
+   root.vert[i]->tri = &root;
+  }
+}
+
+Delaunay2DCode::Site * Delaunay2DCode::Add(nat32 elementSize,real64 x,real64 y,const void * ptr)
+{
+ return Insert(elementSize,x,y,ptr,root.FindTri(x,y));
+}
+
+// Helpers for the bulk insertion - the Hilbert curve index of a point on a
+// 2^16 grid, and the entries sorted to get the insertion order...
+namespace
+{
+ nat32 HilbertIndex(nat32 x,nat32 y)
  {
-  root.vert[i] = mem::Malloc<Site>();
-  root.partner[i] = null<Triangle*>();
-  root.next[i] = null<Triangle*>();
+  nat32 ret = 0;
+  for (nat32 s=nat32(1)<<15;s>0;s>>=1)
+  {
+   nat32 rx = ((x&s)!=0)?1:0;
+   nat32 ry = ((y&s)!=0)?1:0;
+   ret += s*s*((3*rx)^ry);
 
-  root.vert[i]->infinite = true;
-  root.vert[i]->neighbours = 1;
-  root.vert[i]->tri = &root;
+   if (ry==0)
+   {
+    if (rx==1)
+    {
+     x = 0xFFFF - x;
+     y = 0xFFFF - y;
+    }
+    nat32 temp = x; x = y; y = temp;
+   }
+  }
+  return ret;
  }
 
- root.vert[0]->x = 1.0;
- root.vert[0]->y = 0.0;
- root.vert[1]->x = -1.0;
- root.vert[1]->y = 1.0;
- root.vert[2]->x = -1.0;
- root.vert[2]->y = -1.0;
+ struct BulkOrder
+ {
+  nat32 key;
+  nat32 index;
+
+  bit operator < (const BulkOrder & rhs) const {return key<rhs.key;}
+ };
 }
 
-Delaunay2DCode::Site * Delaunay2DCode::Add(nat32 elementSize,real64 x,real64 y,const void * ptr)
+void Delaunay2DCode::AddBulk(nat32 elementSize,nat32 count,const real64 * xy,const byte * data,Site ** out)
+{
+ if (count==0) return;
+
+ // Fill in the Hilbert indices, over the bounding box of the points...
+  real64 minX = xy[0];
+  real64 maxX = xy[0];
+  real64 minY = xy[1];
+  real64 maxY = xy[1];
+  for (nat32 i=1;i<count;i++)
+  {
+   minX = math::Min(minX,xy[i*2]);
+   maxX = math::Max(maxX,xy[i*2]);
+   minY = math::Min(minY,xy[i*2+1]);
+   maxY = math::Max(maxY,xy[i*2+1]);
+  }
+  real64 range = math::Max(maxX-minX,maxY-minY);
+  real64 mult = (range>0.0)?(65535.0/range):0.0;
+
+  ds::Array<BulkOrder> order(count);
+  for (nat32 i=0;i<count;i++)
+  {
+   order[i].key = HilbertIndex(nat32((xy[i*2]-minX)*mult),nat32((xy[i*2+1]-minY)*mult));
+   order[i].index = i;
+  }
+
+ // Shuffle, with a fixed seed so its repeatable, then split into rounds that
+ // double in size, each sorted along the curve - the randomness between rounds
+ // keeps the expected cost down, the sorting within them makes the walks
+ // short...
+  nat32 rand = 0x9E3779B9;
+  for (nat32 i=count-1;i>0;i--)
+  {
+   rand ^= rand<<13;
+   rand ^= rand>>17;
+   rand ^= rand<<5;
+   nat32 j = rand%(i+1);
+   BulkOrder temp = order[i];
+   order[i] = order[j];
+   order[j] = temp;
+  }
+
+  for (nat32 start=0,end=1;start<count;start=end,end*=2)
+  {
+   nat32 last = math::Min(end,count) - 1;
+   if (last>start) order.SortRange< SortOp<BulkOrder> >(start,last);
+  }
+
+ // Insert them all, walking from the last triangle made...
+  Triangle * hint = null<Triangle*>();
+  for (nat32 i=0;i<count;i++)
+  {
+   nat32 ind = order[i].index;
+   real64 x = xy[ind*2];
+   real64 y = xy[ind*2+1];
+
+   Triangle * into = null<Triangle*>();
+   if (hint) into = Walk(hint,x,y);
+   if (into==null<Triangle*>()) into = root.FindTri(x,y);
+
+   Site * ns = Insert(elementSize,x,y,data + ind*elementSize,into);
+   if (out) out[ind] = ns;
+   hint = ns->tri;
+  }
+}
+
+Delaunay2DCode::Site * Delaunay2DCode::Insert(nat32 elementSize,real64 x,real64 y,const void * ptr,Triangle * into)
 {
  // Make the new site to be added...
   Site * ns = mem::Malloc<Site>(sizeof(Site) + elementSize);
@@ -113,13 +211,10 @@ Delaunay2DCode::Site * Delaunay2DCode::Add(nat32 elementSize,real64 x,real64 y,c
 
    mem::Copy<byte>((byte*)ns->Data(),(byte*)ptr,elementSize);
 
- // Find the triangle to add it into...
-  Triangle * into = root.FindTri(x,y);
-
  // Add it in by creating 3 more triangles as children...
   into->children = 3;
   into->delChildren = true;
-  for (nat32 j=0;j<3;j++) into->child[j] = new Triangle();
+  for (nat32 j=0;j<3;j++) into->child[j] = NewTri();
 
   for (nat32 j=0;j<3;j++)
   {
@@ -190,16 +285,36 @@ Delaunay2DCode::Site * Delaunay2DCode::Nearest(real64 x,real64 y) const
  return ret;
 }
 
-void Delaunay2DCode::Triangle::DelChildren()
+Delaunay2DCode::Triangle * Delaunay2DCode::Walk(Triangle * start,real64 x,real64 y) const
 {
- if (delChildren)
- {
-  for (nat32 i=0;i<children;i++)
+ // Step across any edge the point is strictly outside of, which has to arrive
+ // for a Delaunay triangulation - the step limit is just a safety net...
+  Triangle * targ = start;
+  for (nat32 step=0;step<sites+16;step++)
   {
-   child[i]->DelChildren();
-   delete child[i];
+   if (targ->children!=0) return null<Triangle*>();
+   if (targ->vert[0]->infinite||targ->vert[1]->infinite||targ->vert[2]->infinite) return null<Triangle*>();
+
+   nat32 i = 0;
+   for (;i<3;i++)
+   {
+    Site * a = targ->vert[i];
+    Site * b = targ->vert[(i+1)%3];
+    if ((b->x-a->x)*(y-a->y) - (b->y-a->y)*(x-a->x) < 0.0) break;
+   }
+   if (i==3) return targ;
+
+   targ = targ->partner[i];
+   if (targ==null<Triangle*>()) return null<Triangle*>();
   }
- }
+ return null<Triangle*>();
+}
+
+Delaunay2DCode::Triangle * Delaunay2DCode::NewTri()
+{
+ Triangle * ret = triStore.Malloc<Triangle>();
+ mem::Null(ret);
+ return ret;
 }
 
 Delaunay2DCode::Triangle * Delaunay2DCode::Triangle::FindTri(real64 x,real64 y) const
@@ -257,13 +372,20 @@ void Delaunay2DCode::Triangle::MabyFlip(Delaunay2DCode * parent,nat32 ind)
  // If either vertex on the line is infinite we have to do a different check.
   if ((!other->vert[otherToThis]->infinite)&&(!other->vert[(otherToThis+1)%3]->infinite))
   {
-   math::Mat<4,4> ftm;
-    ftm[0][0] = math::Sqr(vert[ind]->x)      + math::Sqr(vert[ind]->y);      ftm[0][1] = vert[ind]->x;      ftm[0][2] = vert[ind]->y;       ftm[0][3] = 1.0;
-    ftm[1][0] = math::Sqr(other->vert[0]->x) + math::Sqr(other->vert[0]->y); ftm[1][1] = other->vert[0]->x; ftm[1][2] = other->vert[0]->y;  ftm[1][3] = 1.0;
-    ftm[2][0] = math::Sqr(other->vert[1]->x) + math::Sqr(other->vert[1]->y); ftm[2][1] = other->vert[1]->x; ftm[2][2] = other->vert[1]->y;  ftm[2][3] = 1.0;
-    ftm[3][0] = math::Sqr(other->vert[2]->x) + math::Sqr(other->vert[2]->y); ftm[3][1] = other->vert[2]->x; ftm[3][2] = other->vert[2]->y;  ftm[3][3] = 1.0;
+   // The in-circle test, relative to the point being checked so the
+   // squared terms keep their precision...
+    real64 m[3][3];
+    for (nat32 i=0;i<3;i++)
+    {
+     m[i][0] = other->vert[i]->x - vert[ind]->x;
+     m[i][1] = other->vert[i]->y - vert[ind]->y;
+     m[i][2] = math::Sqr(m[i][0]) + math::Sqr(m[i][1]);
+    }
 
-   if (Determinant(ftm)>=0.0) return;
+    real64 det = m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+               - m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+               + m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+    if (det<=0.0) return;
   }
   else
   {
@@ -291,8 +413,8 @@ void Delaunay2DCode::Triangle::MabyFlip(Delaunay2DCode * parent,nat32 ind)
   children = 2;
   delChildren = true;
   other->children = 2;
-  child[0] = new Triangle(); other->child[0] = child[0];
-  child[1] = new Triangle(); other->child[1] = child[1];
+  child[0] = parent->NewTri(); other->child[0] = child[0];
+  child[1] = parent->NewTri(); other->child[1] = child[1];
 
   for (nat32 i=0;i<3;i++)
   {
@@ -25,6 +25,7 @@
 #include "eos/types.h"
 #include "eos/typestring.h"
 #include "eos/mem/safety.h"
+#include "eos/mem/packer.h"
 #include "eos/math/mat_ops.h"
 #include "eos/ds/arrays.h"
 
@@ -60,10 +61,8 @@ class EOS_CLASS Delaunay2DCode
    };
 
   // Triangle data structure...
-   struct EOS_CLASS Triangle // new-ed.
+   struct EOS_CLASS Triangle // From the triangle Packer, all freed together.
    {
-    void DelChildren();
-
     Triangle * FindTri(real64 x,real64 y) const; // Returns the containing triangle for the point, recursive, assumes this triangle contains the given point.
 
     // Checks if the given vertex in this is close enough to its opposing edge
@@ -77,6 +76,7 @@ class EOS_CLASS Delaunay2DCode
     // is infinite....
      static bit Side(Site * a,Site * b,real64 x,real64 y);
 
+
     Site * vert[3]; // The 3 verticies that make it up, in counter-clockwise order. If vert[i]==null then its an infinite point.
 
     // Number of child triangles, if 0 then it is part of the final triangulation, otherwise its an
@@ -113,11 +113,30 @@ class EOS_CLASS Delaunay2DCode
   // Adds a new node in, returning the resulting Site...
    Site * Add(nat32 elementSize,real64 x,real64 y,const void * ptr);
 
+  // Adds count nodes, with interleaved coordinates in xy and the data packed
+  // into data. Inserts them in a biased randomised order with each round
+  // Hilbert sorted, and locates each by walking from the last. If out is
+  // provided it gets the resulting Site for each...
+   void AddBulk(nat32 elementSize,nat32 count,const real64 * xy,const byte * data,Site ** out);
+
   // Finds the nearest Site to a given position...
    Site * Nearest(real64 x,real64 y) const;
 
 
+  // Adds a node into the given leaf triangle, which must contain it...
+   Site * Insert(nat32 elementSize,real64 x,real64 y,const void * ptr,Triangle * into);
+
+  // Walks from the given leaf triangle to the leaf containing the given point,
+  // via the partner links. Returns null if it walks into a triangle with an
+  // infinite vertex, in which case the search tree has to be used instead...
+   Triangle * Walk(Triangle * start,real64 x,real64 y) const;
+
+  // Returns a new triangle, nulled...
+   Triangle * NewTri();
+
+
   Triangle root; // The root triangle - the only infinite one, so it can contain all the other triangles.
+  mem::Packer triStore; // Every other triangle comes from here.
   Site * first; // Linked list of all the Sites.
 
   nat32 sites; // Number of sites contained.
@@ -139,8 +158,9 @@ class EOS_CLASS Delaunay2DCode
 /// processing. It also allows you to use it as a Voronoi diagram, by providing
 /// a suitable interface to the data in addition to the Delaunay style interface.
 /// Whilst this method is not slower than other possible methods by complexity it
-/// does have a poor inner loop, so faster is possible if you just want to create
-/// the triangulation without the incrimental capability of this one.
+/// does have a poor inner loop, so when adding many sites at once use AddBulk,
+/// which inserts them in a spatially coherent order and finds where each goes
+/// by walking from the last, rather than searching down the tree.
 template <typename T, typename DT = mem::KillNull<T> >
 class EOS_CLASS Delaunay2D : public Delaunay2DCode
 {
@@ -336,11 +356,11 @@ class EOS_CLASS Delaunay2D : public Delaunay2DCode
 
 
   /// Returns the number of locations stored withing the structure.
-   void PosCount() const {return sites;}
+   nat32 PosCount() const {return sites;}
 
   /// Returns the number of vertices as a consequence of the dual structure,
   /// the Voronoi tessalation.
-   void MidCount() const {return triangles;}
+   nat32 MidCount() const {return triangles;}
 
   /// Returns how much memory the structure is consuming in bytes.
    nat32 Memory() const {return sizeof(Delaunay2D) + sizeof(Delaunay2DCode::Site)*sites + sizeof(Delaunay2DCode::Triangle)*(triangles+oldTriangles);}
@@ -363,6 +383,37 @@ class EOS_CLASS Delaunay2D : public Delaunay2DCode
    {return Pos(Delaunay2DCode::Add(sizeof(T),x,y,&obj));}
 
 
+  /// Adds many pos at once, one for each entry in pos with the corresponding
+  /// entry of obj, much faster than calling Add for each. The result is
+  /// identical to adding them one by one, in some order, so Add etc. can
+  /// continue to be used afterwards. If out is provided it is resized and
+  /// filled with the Pos for each.
+   void AddBulk(const ds::Array<math::Vect<2,real64> > & pos,const ds::Array<T> & obj,
+                ds::Array<Pos> * out = null<ds::Array<Pos>*>())
+   {
+    ds::Array<real64> xy(pos.Size()*2);
+    for (nat32 i=0;i<pos.Size();i++)
+    {
+     xy[i*2] = pos[i][0];
+     xy[i*2+1] = pos[i][1];
+    }
+    Bulk(xy,obj,out);
+   }
+
+  /// &nbsp;
+   void AddBulk(const ds::Array<math::Vect<2,real32> > & pos,const ds::Array<T> & obj,
+                ds::Array<Pos> * out = null<ds::Array<Pos>*>())
+   {
+    ds::Array<real64> xy(pos.Size()*2);
+    for (nat32 i=0;i<pos.Size();i++)
+    {
+     xy[i*2] = pos[i][0];
+     xy[i*2+1] = pos[i][1];
+    }
+    Bulk(xy,obj,out);
+   }
+
+
   /// Given a coordinate returns the nearest Pos. Do not call when PosCount()==0
    Pos Nearest(const math::Vect<2,real32> & pos)
    {return Pos(Delaunay2DCode::Nearest(pos[0],pos[1]));}
@@ -459,6 +510,19 @@ class EOS_CLASS Delaunay2D : public Delaunay2DCode
   {
    DT::Kill((T*)ptr);
   }
+
+  void Bulk(const ds::Array<real64> & xy,const ds::Array<T> & obj,ds::Array<Pos> * out)
+  {
+   nat32 count = xy.Size()/2;
+   if (count==0) {if (out) out->Size(0); return;}
+   ds::Array<Site*> site(count);
+   Delaunay2DCode::AddBulk(sizeof(T),count,&xy[0],(const byte*)(const void*)&obj[0],&site[0]);
+   if (out)
+   {
+    out->Size(count);
+    for (nat32 i=0;i<count;i++) (*out)[i] = Pos(site[i]);
+   }
+  }
 };
 
 //------------------------------------------------------------------------------
@@ -23,23 +23,30 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 Csv::Csv(cstrconst fn,bit overwrite)
-:startOfRow(true),file(fn,overwrite?way_ow:way_append,mode_write)
+:startOfRow(true),file(fn,overwrite?way_ow:way_append,mode_write),
+buf(mem::Malloc<cstrchar>(bufSize)),fill(0)
 {}
 
 Csv::Csv(const str::String & fn,bit overwrite)
-:startOfRow(true),file(fn,overwrite?way_ow:way_append,mode_write)
+:startOfRow(true),file(fn,overwrite?way_ow:way_append,mode_write),
+buf(mem::Malloc<cstrchar>(bufSize)),fill(0)
 {}
 
 Csv::Csv(const Dir & dir,cstrconst fn,bit overwrite)
-:startOfRow(true),file(dir,fn,overwrite?way_ow:way_append,mode_write)
+:startOfRow(true),file(dir,fn,overwrite?way_ow:way_append,mode_write),
+buf(mem::Malloc<cstrchar>(bufSize)),fill(0)
 {}
 
 Csv::Csv(const Dir & dir,const str::String & fn,bit overwrite)
-:startOfRow(true),file(dir,fn,overwrite?way_ow:way_append,mode_write)
+:startOfRow(true),file(dir,fn,overwrite?way_ow:way_append,mode_write),
+buf(mem::Malloc<cstrchar>(bufSize)),fill(0)
 {}
 
 Csv::~Csv()
-{}
+{
+ Spill();
+ mem::Free(buf);
+}
 
 bit Csv::Active()
 {
@@ -53,39 +60,27 @@ nat32 Csv::Write(const void * inv,nat32 bytes)
  if (startOfRow)
  {
   startOfRow = false;
-  file.GetCursor(file.Size()).Write("\"",1);
+  Put("\"",1);
  }
 
- nat32 ret = 0;
- nat32 base = 0;
-  for (nat32 i=0;i<bytes;i++)
+ for (nat32 i=0;i<bytes;i++)
+ {
+  if (fill+2>bufSize) Spill();
+  switch (in[i])
   {
-   if (in[i]=='"')
-   {
-    ret += file.GetCursor(file.Size()).Write(in+base,i-base);
-    file.GetCursor(file.Size()).Write("\\\"",2);
-    base = i;
-   }
-   else if (in[i]=='\n')
-   {
-    ret += file.GetCursor(file.Size()).Write(in+base,i-base);
-    file.GetCursor(file.Size()).Write("\\n",2);
-    base = i;    
-   }
-   else if (in[i]=='\\')
-   {
-    ret += file.GetCursor(file.Size()).Write(in+base,i-base);
-    file.GetCursor(file.Size()).Write("\\\\",2);
-    base = i;    
-   }   
+   case '"':  buf[fill++] = '\\'; buf[fill++] = '"'; break;
+   case '\n': buf[fill++] = '\\'; buf[fill++] = 'n'; break;
+   case '\\': buf[fill++] = '\\'; buf[fill++] = '\\'; break;
+   default: buf[fill++] = in[i]; break;
   }
- ret += file.GetCursor(file.Size()).Write(in+base,bytes-base);
- return ret;
+ }
+ return bytes;
 }
 
 nat32 Csv::Pad(nat32 bytes)
 {
- return file.GetCursor(file.Size()).Pad(bytes);
+ for (nat32 i=0;i<bytes;i++) Put(" ",1);
+ return bytes;
 }
 
 void Csv::FieldEnd()
@@ -93,23 +88,32 @@ void Csv::FieldEnd()
  if (startOfRow)
  {
   startOfRow = false;
-  file.GetCursor(file.Size()).Write("\"",1);
+  Put("\"",1);
  }
- file.GetCursor(file.Size()).Write("\",\"",3);
+ Put("\",\"",3);
 }
 
 void Csv::RowEnd()
 {
- if (startOfRow) file.GetCursor(file.Size()).Write("\"",1); 
- file.GetCursor(file.Size()).Write("\"\n",2);
+ if (startOfRow) Put("\"",1);
+ Put("\"\n",2);
  startOfRow = true;
+ if (fill>=rowSpill) Spill();
 }
 
 void Csv::Flush()
 {
+ Spill();
  file.Flush();
 }
 
+void Csv::Spill()
+{
+ if (fill==0) return;
+ file.GetCursor(file.Size()).Write(buf,fill);
+ fill = 0;
+}
+
 //------------------------------------------------------------------------------
  };
 };
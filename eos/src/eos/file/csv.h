@@ -47,7 +47,8 @@ inline CsvEndRow EndRow() {CsvEndRow ret; return ret;}
 //------------------------------------------------------------------------------
 /// The csv file, for output only. Standard streamable interface, except it
 /// provides special objects that can be passed in to end fields and rows, 
-/// and escapes bad characters as needed.
+/// and escapes bad characters as needed. Output is gathered in a buffer and
+/// written out a block of rows at a time, or when Flush is called.
 class EOS_CLASS Csv : public io::Out<io::Text>
 {
  public:
@@ -87,18 +88,65 @@ class EOS_CLASS Csv : public io::Out<io::Text>
    void RowEnd();
    
    
-  /// Required by the logging system, for obvious reasons.
+  /// Required by the logging system, for obvious reasons. Writes out the
+  /// buffer and makes sure it is on disk.
    void Flush();
 
 
+  /// Writes an array of values as a row, i.e. a field each, followed by the
+  /// end of the row.
+   template <typename T>
+   void WriteRow(const T * data,nat32 count)
+   {
+    for (nat32 i=0;i<count;i++)
+    {
+     if (i!=0) FieldEnd();
+     *this << data[i];
+    }
+    RowEnd();
+   }
+   
+  /// Writes a 2D grid of values, a row of the csv file for each y, for
+  /// dumping an svt::Field or anything else with the same Size and Get
+  /// methods.
+   template <typename F>
+   void WriteGrid(const F & field)
+   {
+    for (nat32 y=0;y<field.Size(1);y++)
+    {
+     for (nat32 x=0;x<field.Size(0);x++)
+     {
+      if (x!=0) FieldEnd();
+      *this << field.Get(x,y);
+     }
+     RowEnd();
+    }
+   }
+
 
   /// &nbsp;
    static inline cstrconst TypeString() {return "eos::file::Csv";}
 
 
  private:
+  static const nat32 bufSize = 64*1024;
+  static const nat32 rowSpill = 48*1024; // Written out once a row ends with this much buffered.
+
   bit startOfRow; // true when we should add a " before doing anything else.
   File<io::Text> file;
+  
+  cstr buf;
+  nat32 fill;
+  
+  // Appends a few bytes unescaped...
+  void Put(cstrconst data,nat32 size)
+  {
+   if (fill+size>bufSize) Spill();
+   for (nat32 i=0;i<size;i++) buf[fill+i] = data[i];
+   fill += size;
+  }
+  
+  void Spill();
 };
 
 //------------------------------------------------------------------------------
@@ -32,6 +32,7 @@
 #include "eos/file/devil_funcs.h"
 
 #include "eos/file/dlls.h"
+#include "eos/time/startup.h"
 
 namespace eos
 {
@@ -53,6 +54,8 @@ EOS_VAR_DEF stringTobool ilLoadImage;
 EOS_VAR_DEF stringTobool ilSaveImage;
 EOS_VAR_DEF tiFunc       ilTexImage;
 EOS_VAR_DEF cpFunc       ilCopyPixels;
+EOS_VAR_DEF intintTobool ilConvertImage;
+EOS_VAR_DEF voidToptr    ilGetData;
 
 
 EOS_FUNC bit DevilActive()
@@ -81,11 +84,13 @@ EOS_FUNC bit DevilActive()
  ilSaveImage = (stringTobool)devil.Get("ilSaveImage");
  ilTexImage = (tiFunc)devil.Get("ilTexImage");
  ilCopyPixels = (cpFunc)devil.Get("ilCopyPixels");
+ ilConvertImage = (intintTobool)devil.Get("ilConvertImage");
+ ilGetData = (voidToptr)devil.Get("ilGetData");
    
  if ((ilInit==0)||(ilShutdown==0)||(ilGetError==0)||(ilGenImages==0)||
      (ilBindImage==0)||(ilDeleteImages==0)||(ilEnable==0)||(ilDisable==0)||
      (ilGetInteger==0)||(ilOriginFunc==0)||(ilLoadImage==0)||(ilSaveImage==0)||
-     (ilTexImage==0)||(ilCopyPixels==0))
+     (ilTexImage==0)||(ilCopyPixels==0)||(ilConvertImage==0)||(ilGetData==0))
  {
   ilInit = 0;
   return false;	 
@@ -93,6 +98,7 @@ EOS_FUNC bit DevilActive()
  
  devil.UnloadKeep();
  ilInit();
+ time::StartupMark("devil");
  return true;	
 }
 
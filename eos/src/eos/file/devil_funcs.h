@@ -52,6 +52,8 @@ typedef unsigned char EOS_STDCALL (*stringTobool)(const char *);
 typedef void EOS_STDCALL (*handFunc)(int,unsigned int *);
 typedef int EOS_STDCALL (*cpFunc)(unsigned int,unsigned int,unsigned int,unsigned int,unsigned int,unsigned int,unsigned int,unsigned int,void *);  
 typedef unsigned char EOS_STDCALL (*tiFunc)(unsigned int,unsigned int,unsigned int,unsigned char,unsigned int,unsigned int,void *);
+typedef unsigned char EOS_STDCALL (*intintTobool)(unsigned int,unsigned int);
+typedef unsigned char * EOS_STDCALL (*voidToptr)();
 
  
 // The functions...
@@ -69,6 +71,8 @@ EOS_VAR stringTobool ilLoadImage;
 EOS_VAR stringTobool ilSaveImage;
 EOS_VAR tiFunc       ilTexImage;
 EOS_VAR cpFunc       ilCopyPixels;
+EOS_VAR intintTobool ilConvertImage;
+EOS_VAR voidToptr    ilGetData;
 
 // Constants...
 static const nat32 DEVIL_FORM_L = 0x1909;
@@ -331,22 +331,62 @@ void Dir::Go(const str::String & obj)
  Optimise();
 }
 
-void Dir::Children(ds::List<cstr,mem::KillDel<cstr> > & out,cstrconst pattern,DirType type)
+//------------------------------------------------------------------------------
+EOS_FUNC bit WildMatch(cstrconst pattern,cstrconst name)
+{
+ cstrconst star = null<cstrconst>();
+ cstrconst back = name;
+ while (*name)
+ {
+  if ((*pattern=='?')||((*pattern==*name)&&(*pattern!='*'))) {++pattern; ++name;}
+  else if (*pattern=='*') {star = ++pattern; back = name;}
+  else if (star) {pattern = star; name = ++back;}
+  else return false;
+ }
+ while (*pattern=='*') ++pattern;
+ return *pattern==0;
+}
+
+//------------------------------------------------------------------------------
+void Dir::Children(ds::List<cstr,mem::KillFree<char> > & out,cstrconst pattern,DirType type)
 {
  cstr p = path.ToStr();
  DIR * dir = opendir(p); 
- mem::Free(p);
  
  if (dir)
  {
+  nat32 pLength = str::Length(p);
   while (true)
   {
    dirent * ent = readdir(dir);
-   if (ent==0) break;   
+   if (ent==0) break;
+   if (pattern&&(!WildMatch(pattern,ent->d_name))) continue;
+
+   if (type!=(TypeDir|TypeFile|TypeLink))
+   {
+    cstr full = mem::Malloc<cstrchar>(pLength+str::Length(ent->d_name)+1);
+    str::Copy(full,p);
+    str::Copy(full+pLength,ent->d_name);
+    
+    struct stat info;
+    bit keep = false;
+    #ifdef EOS_LINUX
+    if ((lstat(full,&info)==0)&&S_ISLNK(info.st_mode)) keep = (type&TypeLink)!=0;
+    #endif
+    if ((!keep)&&(stat(full,&info)==0))
+    {
+     if (S_ISDIR(info.st_mode)) keep = (type&TypeDir)!=0;
+                           else keep = (type&TypeFile)!=0;
+    }
+    mem::Free(full);
+    if (!keep) continue;
+   }
+
    out.AddBack(str::Duplicate(ent->d_name));
   }
   closedir(dir);
  }
+ mem::Free(p);
 }
 
 void Dir::Optimise()
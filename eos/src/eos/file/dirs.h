@@ -132,10 +132,10 @@ class EOS_CLASS Dir
   /// This allows you to obtain a list of all children of this location,
   /// with a set of restrictions on which children types to allow in the
   /// list.
-  /// \param out A linked list to which all children found are added as strings that will work with the Go methods.
+  /// \param out A linked list to which all children found are added as strings that will work with the Go methods, allocated with mem::Malloc.
   /// \param pattern Pattern of filenames to accept, things such as "*.bmp" etc.
   /// \param type Types to output, or'ed together.
-   void Children(ds::List<cstr,mem::KillDel<cstr> > & out,
+   void Children(ds::List<cstr,mem::KillFree<char> > & out,
                  cstrconst pattern = null<cstrconst>(),DirType type = DirType(TypeDir | TypeFile | TypeLink));
 
 
@@ -152,6 +152,11 @@ class EOS_CLASS Dir
   void MakePath(); // Makes path match osPath.
 };
 
+//------------------------------------------------------------------------------
+/// Matches a filename against a pattern as used by Dir::Children, where * 
+/// matches any run of characters and ? any one character. Case sensitive.
+EOS_FUNC bit WildMatch(cstrconst pattern,cstrconst name);
+
 //------------------------------------------------------------------------------
  };
 };
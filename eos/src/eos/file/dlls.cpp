@@ -82,6 +82,22 @@ void Dll::Load(cstrconst filename,bool delayed)
  #endif
 }
 
+void Dll::LoadPath(cstrconst filename,bool delayed)
+{
+ Unload();
+
+ #ifdef EOS_WIN32
+  handle = (void*)LoadLibrary(filename);
+ #else
+  int flag = RTLD_NOW;
+  #ifdef EOS_RELEASE
+   if (delayed) flag = RTLD_LAZY;
+  #endif
+
+  handle = dlopen(filename,flag | RTLD_GLOBAL);
+ #endif
+}
+
 void Dll::Unload()
 {
  #ifdef EOS_WIN32
@@ -68,6 +68,11 @@ class EOS_CLASS Dll : public Deletable
   /// my.dll or libmy.dll.
    void Load(cstrconst filename,bool delayed = false);
 
+  /// Identical to Load, except the filename is used exactly as given, as
+  /// is wanted for plugins found by searching a directory. delayed has the
+  /// same meaning.
+   void LoadPath(cstrconst filename,bool delayed = false);
+
   /// Unloads the dll currently loaded into the object, or does nothing if 
   /// Active()==false. Note that the moment this is called (or the object 
   /// is deconstructed) all function pointers obtained become invalid.
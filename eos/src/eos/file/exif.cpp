@@ -20,6 +20,8 @@
 #include "eos/mem/alloc.h"
 #include "eos/mem/safety.h"
 #include "eos/file/csv.h"
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -36,64 +38,115 @@ Exif::~Exif()
 
 bit Exif::Load(cstrconst fn)
 {
+ cstrconst error = Read(fn);
+ if (error) {LogError("Exif: " << error); return false;}
+ return true;
+}
+
+bit Exif::Try(cstrconst fn)
+{
+ return Read(fn)==null<cstrconst>();
+}
+
+cstrconst Exif::Read(cstrconst fn)
+{
+ static const nat32 headSize = 4096;
  Reset();
 
  File<io::Binary> fo;
- if (fo.Open(fn,way_edit,mode_read)==false) {LogError("Exif: Can't open file"); return false;}
+ if (fo.Open(fn,way_edit,mode_read)==false) return "Can't open file";
  
- Cursor<io::Binary> f = fo.GetCursor();
+ // Read in the start of the file, and check the jpeg header...
+  if (block.Size()<headSize) block.Size(headSize);
+  nat32 avaliable = fo.GetCursor(0).Read(block.Ptr(),headSize);
+  if (avaliable<4) return "Can't read jpeg header";
+  if ((block[0]!=0xFF)||(block[1]!=0xD8)) return "Jpeg header is wrong";
  
- // Read in the jpeg header...
-  byte jpegHead[2];
-  if (f.Read(jpegHead,2)!=2) {LogError("Exif: Can't read jpeg header"); return false;}
-  if ((jpegHead[0]!=0xFF)||(jpegHead[1]!=0xD8)) {LogError("Exif: Jpeg header is wrong"); return false;}
- 
- // Now check if exif data exists...
-  byte exifHead[2];
-  if (f.Read(exifHead,2)!=2) {LogError("Exif: Can't read exif header"); return false;}
-  if ((exifHead[0]!=0xFF)||(exifHead[1]!=0xE1)) {LogError("Exif: Exif header is wrong"); return false;}
+ // Walk the markers until we find the exif segment, skipping anything else,
+ // such as a JFIF segment. base is the file position of block[0]...
+  nat32 base = 0;
+  nat32 pos = 2; // File position of the marker being considered.
+  nat32 size; // Size of the exif segment, excluding its marker.
+  while (true)
+  {
+   if (pos+4>base+avaliable)
+   {
+    base = pos;
+    avaliable = fo.GetCursor(base).Read(block.Ptr(),headSize);
+    if (avaliable<4) return "Exif header is missing";
+   }
+   
+   const byte * m = &block[pos-base];
+   if (m[0]!=0xFF) return "Exif header is wrong";
+   if (m[1]==0xFF) {++pos; continue;} // Padding.
+   if ((m[1]==0xD9)||(m[1]==0xDA)) return "No exif header found";
+   if ((m[1]==0x01)||((m[1]>=0xD0)&&(m[1]<=0xD8))) {pos += 2; continue;} // No length.
+   
+   size = (nat32(m[2])<<8) | nat32(m[3]);
+   if (size<2) return "Read exif size impossibly small";
+   
+   if (m[1]==0xE1)
+   {
+    // Make sure its start is loaded, then check the identifier...
+     if (pos+10>base+avaliable)
+     {
+      base = pos;
+      avaliable = fo.GetCursor(base).Read(block.Ptr(),headSize);
+      if (avaliable<10) return "Exif ident can't be read";
+      m = block.Ptr();
+     }
+     if ((m[4]=='E')&&(m[5]=='x')&&(m[6]=='i')&&(m[7]=='f')&&(m[8]==0)&&(m[9]==0)) break;
+   }
+   pos += 2 + size;
+  }
+  if (size<8) return "Read exif size to small";
+  size -= 8;
   
- // Get its size - Motorola format...
-  nat16 size;
-  if (f.Read(&size,2)!=2) {LogError("Exif: Can't read exif size"); return false;}
-  size = io::FromBigEndian(size);
-  if (size<2) {LogError("Exif: Read exif size impossibly small"); return false;}
-  size -= 2; // For the data already read.
- 
- // Get the exif identifier... 
-  byte exifIdent[6];
-  if (f.Read(exifIdent,6)!=6) {LogError("Exif: Exif ident can't be read"); return false;}
-  if ((exifIdent[0]!='E')||
-      (exifIdent[1]!='x')||
-      (exifIdent[2]!='i')||
-      (exifIdent[3]!='f')||
-      (exifIdent[4]!=0)||
-      (exifIdent[5]!=0)) {LogError("Exif: Exif ident is wrong"); return false;}
-  if (size<6) {LogError("Exif: Read exif size to small"); return false;}
-  size -= 6;
+ // Move the tiff part to the start of the block, as tag offsets are relative
+ // to it...
+  {
+   nat32 start = pos + 10 - base;
+   avaliable -= start;
+   if (avaliable>size) avaliable = size;
+   mem::Copy(block.Ptr(),block.Ptr()+start,avaliable);
+  }
   
- // Now, because we are going to have to do offsets, we read in the entire
- // block, such that indexes into this block match the offsets...
-  mem::StackPtr<byte,mem::KillFree<byte> > tiff = mem::Malloc<byte>(size);
-  if (f.Read(tiff.Ptr(),size)!=size) {LogError("Exif: Failed to read exif block"); return false;}
+ // Parse, and if it wants more than was read get all of the segment and try
+ // again...
+  bit more = false;
+  cstrconst ret = Parse(avaliable,size,more);
+  if (more)
+  {
+   Reset();
+   if (block.Size()<size) block.Size(size);
+   if (fo.GetCursor(pos+10).Read(block.Ptr(),size)!=size) return "Failed to read exif block";
+   ret = Parse(size,size,more);
+  }
   
-  nat32 offset = 0;
+ if (ret) Reset();
+ return ret;
+}
 
+cstrconst Exif::Parse(nat32 avaliable,nat32 size,bit & more)
+{
+ byte * tiff = block.Ptr();
+ more = false;
+ nat32 offset = 0;
+ if (avaliable<8) {more = avaliable<size; return "Tiff header missing";}
 
  // Read in the tiff header - note the byte convention...
   // Endiness...
-   if (tiff[offset]!=tiff[offset+1]) {LogError("Exif: Bad endiness indicator"); return false;}
+   if (tiff[offset]!=tiff[offset+1]) return "Bad endiness indicator";
    motorola = false;
    if (tiff[offset]!='I')
    {
     if (tiff[offset]=='M') motorola = true;
-                      else {LogError("Exif: Unrecognised endiness"); return false;}
+                      else return "Unrecognised endiness";
    }
    offset += 2;
    
   // 42...
-   if (io::ToCurrent(io::Nat16FromBS(&tiff[offset]),motorola)!=42)
-      {LogError("Exif: The tiff header has no 42"); return false;}
+   if (io::ToCurrent(io::Nat16FromBS(&tiff[offset]),motorola)!=42) return "The tiff header has no 42";
    offset += 2;
    
   // Offset to first IFD...
@@ -105,41 +158,39 @@ bit Exif::Load(cstrconst fn)
   while (true)
   {
    // Get the number of tags...
+    if (offset+2>avaliable) {more = offset+2<=size; return "IFD outside of data block";}
     nat16 count = io::ToCurrent(io::Nat16FromBS(&tiff[offset]),motorola);
     offset += 2;
-    if (offset+count*12+4>=size)
-       {LogError("Exif:IFD data outside of data block"); Reset(); return false;}
+    if (offset+count*12+4>avaliable) {more = offset+count*12+4<=size; return "IFD data outside of data block";}
   
    // Now process each tag, adding them each to the array...
     for (nat32 i=0;i<count;i++)
     {
      nat32 to = tags.Size();
      tags.Size(to+1);
-     tags[to].data = null<byte*>();
   
      // Read tag number, format and component count...
       tags[to].tag = io::ToCurrent(io::Nat16FromBS(&tiff[offset]),motorola); offset += 2;
       tags[to].type = io::ToCurrent(io::Nat16FromBS(&tiff[offset]),motorola); offset += 2;
       tags[to].count = io::ToCurrent(io::Nat32FromBS(&tiff[offset]),motorola); offset += 4;
     
-      if ((tags[to].type==0)||(tags[to].type>12))
-         {LogError("Exif: Unrecognised tag type - " << tags[to].type); Reset(); return false;}
-      if (tags[to].count==0) {LogError("Exif: Tag entry count of 0 makes no sense"); Reset(); return false;}
+      if ((tags[to].type==0)||(tags[to].type>12)) return "Unrecognised tag type";
+      if (tags[to].count==0) return "Tag entry count of 0 makes no sense";
     
       static const nat32 type_size[13] = {0,1,1,2,4,8,1,1,2,4,8,4,8};
-      nat32 data_size = type_size[tags[to].type] * tags[to].count;
+      nat64 data_size = nat64(type_size[tags[to].type]) * nat64(tags[to].count);
    
      // Now handle the fiddly data/pointer system...
-      tags[to].data = mem::Malloc<byte>(data_size);
-      if (data_size<=4)
-      {
-       mem::Copy(tags[to].data,&tiff[offset],data_size);
-      }
+      if (data_size<=4) tags[to].offset = offset;
       else
       {
        nat32 pd = io::ToCurrent(io::Nat32FromBS(&tiff[offset]),motorola);
-       if (pd+data_size>=size) {LogError("Exif: Tag data index outside of data block"); Reset(); return false;}
-       mem::Copy(tags[to].data,&tiff[pd],data_size);
+       if (nat64(pd)+data_size>avaliable)
+       {
+        more = nat64(pd)+data_size<=size;
+        return "Tag data index outside of data block";
+       }
+       tags[to].offset = pd;
       }
       offset += 4;
     }
@@ -156,9 +207,8 @@ bit Exif::Load(cstrconst fn)
       {
        if (tags[i].tag==0x8769)
        {
-        if ((tags[i].type!=4)||(tags[i].count!=1))
-           {LogError("Exif: ExifOffset is badly formated"); Reset(); return false;}
-        offset = io::ToCurrent(io::Nat32FromBS(tags[i].data),motorola);
+        if ((tags[i].type!=4)||(tags[i].count!=1)) return "ExifOffset is badly formated";
+        offset = GetNat32(i);
         break;
        }
       }
@@ -166,8 +216,7 @@ bit Exif::Load(cstrconst fn)
     }
   }
 
-
- return true;
+ return null<cstrconst>();
 }
 
 bit Exif::Load(const str::String & fn)
@@ -189,10 +238,112 @@ int32 Exif::GetName(nat16 name) const
 
 void Exif::Reset()
 {
- for (nat32 i=0;i<tags.Size();i++) mem::Free(tags[i].data);
  tags.Size(0);
 }
 
+void Exif::Summarise(ExifSummary & out) const
+{
+ out.valid = true;
+ out.flash = HasFlash() ? GetFlash() : false;
+ out.iso = HasISO() ? GetISO() : 0;
+ out.focalLength = HasFocalLength() ? GetFocalLength() : 0.0;
+ out.exposureTime = HasExposureTime() ? GetExposureTime() : 0.0;
+ out.fStop = HasFStop() ? GetFStop() : 0.0;
+
+ struct Str
+ {
+  static void Copy(const Exif & exif,nat16 name,cstr out,nat32 size)
+  {
+   out[0] = 0;
+   int32 ind = exif.GetName(name);
+   if ((ind<0)||(exif.Type(ind)!=2)) return;
+   
+   nat32 len = math::Min(exif.Count(ind),size-1);
+   cstrconst str = exif.GetStr(ind);
+   nat32 i = 0;
+   for (;(i<len)&&(str[i]!=0);i++) out[i] = str[i];
+   out[i] = 0;
+  }
+ };
+ Str::Copy(*this,0x010f,out.make,sizeof(out.make));
+ Str::Copy(*this,0x0110,out.model,sizeof(out.model));
+ Str::Copy(*this,0x0132,out.dateTime,sizeof(out.dateTime));
+}
+
+//------------------------------------------------------------------------------
+// Functor for ExifScan, with an Exif object per range so its buffers get
+// reused...
+class ExifScanRange
+{
+ public:
+  ExifScanRange(const cstrconst * f,ExifSummary * o):fn(f),out(o) {}
+  
+  void operator () (nat32 begin,nat32 end) const
+  {
+   Exif exif;
+   for (nat32 i=begin;i<end;i++)
+   {
+    if (exif.Try(fn[i])) exif.Summarise(out[i]);
+    else
+    {
+     mem::Null(&out[i]);
+     out[i].valid = false;
+    }
+   }
+  }
+  
+ private:
+  const cstrconst * fn;
+  ExifSummary * out;
+};
+
+EOS_FUNC void ExifScan(nat32 count,const cstrconst * fn,ExifSummary * out,time::Progress * prog)
+{
+ static const nat32 step = 1024; // Files between progress reports.
+ prog->Push();
+ ExifScanRange range(fn,out);
+ for (nat32 i=0;i<count;i+=step)
+ {
+  prog->Report(i,count);
+  mt::ParallelFor(i,math::Min(i+step,count),range,8);
+ }
+ prog->Pop();
+}
+
+EOS_FUNC void ExifScan(const Dir & dir,ds::List<cstr,mem::KillFree<char> > & names,ds::Array<ExifSummary> & out,
+                       cstrconst pattern,time::Progress * prog)
+{
+ prog->Push();
+ prog->Report(0,2);
+ 
+ // Get the listing, and turn it into full paths...
+  nat32 start = names.Size();
+  Dir d = dir;
+  d.Children(names,pattern,TypeFile);
+  
+  nat32 count = names.Size() - start;
+  ds::Array<cstr> fn(count);
+  {
+   ds::List<cstr,mem::KillFree<char> >::Cursor targ = names.FrontPtr();
+   for (nat32 i=0;i<start;i++) ++targ;
+   for (nat32 i=0;i<count;i++)
+   {
+    str::String full = dir.RealPath();
+    full += *targ;
+    fn[i] = full.ToStr();
+    ++targ;
+   }
+  }
+ 
+ // Do the work...
+  prog->Report(1,2);
+  out.Size(names.Size());
+  ExifScan(count,(const cstrconst*)fn.Ptr(),out.Ptr()+start,prog);
+  
+  for (nat32 i=0;i<count;i++) mem::Free(fn[i]);
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -19,12 +19,16 @@
 
 
 /// \file exif.h
-/// Reads a jpeg file, gets its exif data and
+/// Reads a jpeg file, gets its exif data and provides access to it, both one
+/// file at a time and as a summary of many files in parallel.
 
 #include "eos/types.h"
 #include "eos/typestring.h"
 #include "eos/file/files.h"
 #include "eos/ds/arrays_resize.h"
+#include "eos/ds/arrays.h"
+#include "eos/ds/lists.h"
+#include "eos/time/progress.h"
 #include "eos/str/strings.h"
 #include "eos/io/functions.h"
 
@@ -32,9 +36,31 @@ namespace eos
 {
  namespace file
  {
+//------------------------------------------------------------------------------
+/// The exif details most often wanted from a photo, as extracted for many files
+/// at once by ExifScan. Anything the file does not provide is left as 0 or an
+/// empty string.
+struct EOS_CLASS ExifSummary
+{
+ bit valid; ///< false if the file could not be opened or has no exif data.
+ bit flash; ///< true if the flash fired.
+ nat16 iso; ///< &nbsp;
+ real32 focalLength; ///< In milli-meters.
+ real32 exposureTime; ///< In seconds.
+ real32 fStop; ///< &nbsp;
+ cstrchar make[32]; ///< Camera make, truncated if need be.
+ cstrchar model[32]; ///< Camera model, truncated if need be.
+ cstrchar dateTime[20]; ///< When taken, as "YYYY:MM:DD HH:MM:SS".
+};
+
 //------------------------------------------------------------------------------
 /// Loads a jpeg file and provides access to its exif data - provides a
 /// conveniant interface for a subset of tags that I tend to find useful.
+/// Only the start of the file is read, walking the jpeg markers to the exif
+/// block, with the whole block read only if the tags point outside the first
+/// few kilobytes. The tags are left in the block as read, so loading does not
+/// allocate memory once the object has been used, and one object should be
+/// reused for many files.
 class EOS_CLASS Exif
 {
  public:
@@ -53,6 +79,11 @@ class EOS_CLASS Exif
   /// true on success, false on failure.
    bit Load(const str::String & fn);
 
+  /// As for Load, except failure is silent, rather than being logged as an
+  /// error, for when working through lots of files that may not all have exif
+  /// data.
+   bit Try(cstrconst fn);
+
 
   /// Returns how many tags have been loaded - good for checking that something exists.
    nat32 TagCount() const {return tags.Size();}
@@ -70,43 +101,43 @@ class EOS_CLASS Exif
    nat32 Count(nat32 ind) const {return tags[ind].count;}
    
   /// Returns a type 1, a byte.
-   byte GetByte(nat32 ind,nat32 which=0) const {return tags[ind].data[which];}
+   byte GetByte(nat32 ind,nat32 which=0) const {return Data(ind)[which];}
    
   /// Returns a type 2, a string.
-   cstrconst GetStr(nat32 ind) const {return cstrconst(tags[ind].data);}
+   cstrconst GetStr(nat32 ind) const {return cstrconst(Data(ind));}
    
   /// Returns a type 3, a nat16.
    nat16 GetNat16(nat32 ind,nat32 which=0) const 
-   {return io::ToCurrent(io::Nat16FromBS(tags[ind].data+2*which),motorola);}
+   {return io::ToCurrent(io::Nat16FromBS(Data(ind)+2*which),motorola);}
    
   /// Returns a type 4, a nat32.
    nat32 GetNat32(nat32 ind,nat32 which=0) const 
-   {return io::ToCurrent(io::Nat32FromBS(tags[ind].data+4*which),motorola);}
+   {return io::ToCurrent(io::Nat32FromBS(Data(ind)+4*which),motorola);}
    
   /// Returns a type 5, an unsigned rational, as a float.
    real32 GetUR(nat32 ind,nat32 which=0) const
    {
-    nat32 a = io::ToCurrent(io::Nat32FromBS(tags[ind].data+8*which),motorola);
-    nat32 b = io::ToCurrent(io::Nat32FromBS(tags[ind].data+4+8*which),motorola);
+    nat32 a = io::ToCurrent(io::Nat32FromBS(Data(ind)+8*which),motorola);
+    nat32 b = io::ToCurrent(io::Nat32FromBS(Data(ind)+4+8*which),motorola);
     return real32(a)/real32(b);
    }
 
   /// Returns a type 6, an int8.
-   int8 GetInt8(nat32 ind,nat32 which=0) const {return *(int8*)(void*)&tags[ind].data[which];}
+   int8 GetInt8(nat32 ind,nat32 which=0) const {return *(int8*)(void*)&Data(ind)[which];}
    
   /// Returns a type 8, an int16.
    int16 GetInt16(nat32 ind,nat32 which=0) const 
-   {return io::ToCurrent(io::Int16FromBS(tags[ind].data+2*which),motorola);}
+   {return io::ToCurrent(io::Int16FromBS(Data(ind)+2*which),motorola);}
 
   /// Returns a type 9, an int32.
    int32 GetInt32(nat32 ind,nat32 which=0) const 
-   {return io::ToCurrent(io::Int32FromBS(tags[ind].data+4*which),motorola);}
+   {return io::ToCurrent(io::Int32FromBS(Data(ind)+4*which),motorola);}
 
   /// Returns a type 10, a signed rational, as a float.
    real32 GetSR(nat32 ind,nat32 which=0) const
    {
-    int32 a = io::ToCurrent(io::Int32FromBS(tags[ind].data+8*which),motorola);
-    int32 b = io::ToCurrent(io::Int32FromBS(tags[ind].data+4+8*which),motorola);
+    int32 a = io::ToCurrent(io::Int32FromBS(Data(ind)+8*which),motorola);
+    int32 b = io::ToCurrent(io::Int32FromBS(Data(ind)+4+8*which),motorola);
     return real32(a)/real32(b);
    }
    
@@ -154,10 +185,14 @@ class EOS_CLASS Exif
    real32 GetFocalLength() const {return GetUR(GetName(0x920a));}
    
   /// Returns true if Flash usage is avaliable.
-   bit HasFlash() const {return GetName(0x8827)!=-1;}
+   bit HasFlash() const {return GetName(0x9209)!=-1;}
    
   /// If HasFlash() is true you can call this to get it - false for no flash, true for flash.
-   bit GetFlash() const {return GetNat16(GetName(0x8827))==1;} 
+   bit GetFlash() const {return (GetNat16(GetName(0x9209))&1)!=0;} 
+
+
+  /// Fills in a summary of the currently loaded exif data.
+   void Summarise(ExifSummary & out) const;
 
 
   /// &nbsp;
@@ -171,7 +206,7 @@ class EOS_CLASS Exif
     nat16 tag;
     nat16 type;
     nat32 count;
-    byte * data; // Unlike the other this is not corrected for endiness.
+    nat32 offset; // Of the data in block, which is not corrected for endiness.
    };
   
   // Tells you if the data is using big endian rather than little endian...
@@ -180,10 +215,37 @@ class EOS_CLASS Exif
   // Array of IFD's that have been loaded from current file...
    ds::ArrayResize<Tag> tags;
    
-  // Helper - zeros the length of ifds and deletes all data.
+  // The start of the exif block from the file, from the tiff header on...
+   ds::Array<byte> block;
+   
+  // Returns the data of a tag...
+   byte * Data(nat32 ind) const {return const_cast<byte*>(&block[tags[ind].offset]);}
+   
+  // Helper - zeros the length of ifds.
    void Reset();
+   
+  // Does the work of Load, returning null on success or a description of the
+  // failure...
+   cstrconst Read(cstrconst fn);
+   
+  // Parses the IFD's in the first avaliable bytes of block, with the whole
+  // block being size bytes. Sets more and fails if it needs bytes beyond
+  // avaliable...
+   cstrconst Parse(nat32 avaliable,nat32 size,bit & more);
 };
 
+//------------------------------------------------------------------------------
+/// Extracts the exif summary of many files, in parallel, one output per file.
+/// Files that can not be read or have no exif get valid set to false.
+EOS_FUNC void ExifScan(nat32 count,const cstrconst * fn,ExifSummary * out,time::Progress * prog = null<time::Progress*>());
+
+/// Lists the files in the given directory that match the pattern, adding their
+/// names to the end of names, allocated with mem::Malloc as for
+/// Dir::Children, and then extracts their exif summaries into out, which is
+/// resized to match names.
+EOS_FUNC void ExifScan(const Dir & dir,ds::List<cstr,mem::KillFree<char> > & names,ds::Array<ExifSummary> & out,
+                       cstrconst pattern = "*.jpg",time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
  };
 };
@@ -18,6 +18,8 @@
 #include "eos/file/files.h"
 
 #include "eos/math/functions.h"
+#include "eos/mt/threads.h"
+#include "eos/mt/locks.h"
 
 #include <stdio.h>
 #include <sys/types.h>
@@ -25,6 +27,10 @@
 #include <fcntl.h>
 #ifdef EOS_WIN32
  #include <io.h>
+#else
+ #include <sys/mman.h>
+ #include <sys/uio.h>
+ #include <limits.h>
 #endif
 #include <unistd.h>
 #include <string.h>
@@ -177,7 +183,7 @@ void FileCode::Close()
  handle = -1;
 }
 
-nat32 FileCode::Size() const
+nat64 FileCode::Size() const
 {
  struct stat info;
  if (fstat(handle,&info)==-1) return 0;
@@ -191,23 +197,23 @@ nat32 FileCode::SetSize(nat32 size)
                            else return Size();
 }
 
-nat32 FileCode::Read(nat32 pos,void * data,nat32 amount) const
+nat32 FileCode::Read(nat64 pos,void * data,nat32 amount) const
 {
- lseek(handle,pos,SEEK_SET);
+ lseek(handle,off_t(pos),SEEK_SET);
  return read(handle,data,amount);
 }
 
-nat32 FileCode::Write(nat32 pos,const void * data,nat32 amount)
+nat32 FileCode::Write(nat64 pos,const void * data,nat32 amount)
 {
- lseek(handle,pos,SEEK_SET);
+ lseek(handle,off_t(pos),SEEK_SET);
  return write(handle,data,amount);
 }
 
-nat32 FileCode::Pad(nat32 pos,byte item,nat32 amount)
+nat32 FileCode::Pad(nat64 pos,byte item,nat32 amount)
 {
  static const nat32 buf_size = 32;
  byte buf[buf_size]; memset(buf,item,buf_size);
- lseek(handle,pos,SEEK_SET); 
+ lseek(handle,off_t(pos),SEEK_SET); 
  nat32 ret = 0;
   while (amount!=ret)
   {
@@ -219,6 +225,442 @@ nat32 FileCode::Pad(nat32 pos,byte item,nat32 amount)
  return ret;
 }
 
+nat32 FileCode::WriteV(nat64 pos,nat32 count,const void * const * data,const nat32 * amount)
+{
+ nat32 ret = 0;
+ #ifdef EOS_WIN32
+  for (nat32 i=0;i<count;i++)
+  {
+   nat32 done = Write(pos+ret,data[i],amount[i]);
+   ret += done;
+   if (done!=amount[i]) break;
+  }
+ #else
+  #ifdef IOV_MAX
+   static const nat32 maxVec = IOV_MAX;
+  #else
+   static const nat32 maxVec = 16;
+  #endif
+  lseek(handle,off_t(pos),SEEK_SET);
+  
+  struct iovec vec[64];
+  nat32 i = 0;
+  while (i<count)
+  {
+   nat32 n = math::Min(math::Min(count-i,nat32(64)),maxVec);
+   nat32 want = 0;
+   for (nat32 j=0;j<n;j++)
+   {
+    vec[j].iov_base = (void*)data[i+j];
+    vec[j].iov_len = amount[i+j];
+    want += amount[i+j];
+   }
+   
+   ssize_t done = writev(handle,vec,n);
+   if (done<0) break;
+   ret += nat32(done);
+   if (nat32(done)!=want)
+   {
+    // Partial write - finish the blocks of this batch one at a time, so the
+    // amount returned is still exact...
+     nat32 skip = nat32(done);
+     for (nat32 j=0;j<n;j++)
+     {
+      if (skip>=amount[i+j]) {skip -= amount[i+j]; continue;}
+      nat32 left = amount[i+j] - skip;
+      ssize_t more = write(handle,(const byte*)data[i+j] + skip,left);
+      if (more<0) return ret;
+      ret += nat32(more);
+      if (nat32(more)!=left) return ret;
+      skip = 0;
+     }
+   }
+   i += n;
+  }
+ #endif
+ return ret;
+}
+
+void FileCode::Sequential() const
+{
+ #if !defined(EOS_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+  posix_fadvise(handle,0,0,POSIX_FADV_SEQUENTIAL);
+ #endif
+}
+
+void FileCode::WillNeed(nat64 pos,nat32 amount) const
+{
+ #if !defined(EOS_WIN32) && defined(POSIX_FADV_WILLNEED)
+  posix_fadvise(handle,off_t(pos),off_t(amount),POSIX_FADV_WILLNEED);
+ #endif
+}
+
+//------------------------------------------------------------------------------
+ReadBufferCode::ReadBufferCode(FileCode & f,nat64 pos,nat32 bs,bit ra)
+:fc(f),readahead(ra),at(pos),bufPos(pos),bufSize(math::Max(bs,nat32(4096))),fill(0)
+{
+ buf = mem::AlignedMalloc<byte>(bufSize,4096);
+ if (readahead)
+ {
+  fc.Sequential();
+  fc.WillNeed(at,bufSize);
+ }
+}
+
+ReadBufferCode::~ReadBufferCode()
+{
+ mem::AlignedFree(buf);
+}
+
+bit ReadBufferCode::EOS() const
+{
+ return at>=fc.Size();
+}
+
+nat32 ReadBufferCode::Avaliable() const
+{
+ nat64 size = fc.Size();
+ if (at>=size) return 0;
+ nat64 ret = size - at;
+ return (ret>nat64(0xFFFFFFFF))?0xFFFFFFFF:nat32(ret); 
+}
+
+nat32 ReadBufferCode::Read(void * out,nat32 bytes)
+{
+ byte * targ = (byte*)out;
+ nat32 ret = 0;
+ while (ret<bytes)
+ {
+  if ((at>=bufPos)&&(at<bufPos+fill))
+  {
+   nat32 offset = nat32(at - bufPos);
+   nat32 toDo = math::Min(bytes-ret,fill-offset);
+   memcpy(targ+ret,buf+offset,toDo);
+   ret += toDo;
+   at += toDo;
+  }
+  else if (bytes-ret>=bufSize)
+  {
+   // Big read, go straight into the callers memory...
+    nat32 done = fc.Read(at,targ+ret,bytes-ret);
+    if ((done==0)||(done>bytes-ret)) break;
+    ret += done;
+    at += done;
+  }
+  else
+  {
+   if (!Refill()) break;
+  }
+ }
+ return ret;
+}
+
+nat32 ReadBufferCode::Peek(void * out,nat32 bytes) const
+{
+ if ((at>=bufPos)&&(at+bytes<=bufPos+fill))
+ {
+  memcpy(out,buf+nat32(at-bufPos),bytes);
+  return bytes;
+ }
+ return fc.Read(at,out,bytes);
+}
+
+bit ReadBufferCode::Refill()
+{
+ bufPos = at;
+ fill = fc.Read(bufPos,buf,bufSize);
+ if (fill>bufSize) fill = 0; // Error.
+ if ((fill!=0)&&readahead) fc.WillNeed(bufPos+fill,bufSize);
+ return fill!=0;
+}
+
+//------------------------------------------------------------------------------
+// The write-behind thread, which owns a second buffer. Buffers are handed over
+// in order, each one with a job giving its position and size - the thread
+// writes them out in the same order, alternating between the two. The free
+// lock counts buffers the thread has finished with and the caller has not yet
+// taken back...
+class WriteBufferCode::Behind : public mt::Thread
+{
+ public:
+  Behind(FileCode & f,nat32 bufSize)
+  :fc(f),failed(false),writer(0)
+  {
+   buf[0] = mem::AlignedMalloc<byte>(bufSize,4096);
+   buf[1] = mem::AlignedMalloc<byte>(bufSize,4096);
+   job[0].size = 0; job[0].stop = false;
+   job[1].size = 0; job[1].stop = false;
+   free.Add(1);
+  }
+  
+  ~Behind()
+  {
+   mem::AlignedFree(buf[0]);
+   mem::AlignedFree(buf[1]);
+  }
+  
+  byte * Buffer(nat32 i) {return buf[i];}
+  
+  
+  // Hands over buffer cur, containing size bytes for the given position,
+  // then returns the buffer to fill next once the thread is done with it...
+   byte * Submit(nat32 & cur,nat64 pos,nat32 size)
+   {
+    job[cur].pos = pos;
+    job[cur].size = size;
+    job[cur].stop = false;
+    full.Add();
+    cur ^= 1;
+    free.Get();
+    return buf[cur];
+   }
+   
+  // Hands over no buffer, but waits for the thread to finish with the one it
+  // has, so all data given so far is written...
+   void Sync()
+   {
+    free.Get();
+    free.Add();
+   }
+   
+  // Stops the thread, which must have no outstanding work...
+   void Stop(nat32 cur)
+   {
+    job[cur].size = 0;
+    job[cur].stop = true;
+    full.Add();
+    Wait();
+   }
+   
+   bit Failed() const {return failed;}
+
+
+ protected:
+  void Execute()
+  {
+   while (true)
+   {
+    full.Get();
+    Job & j = job[writer];
+    if (j.stop) break;
+    if ((!failed)&&(j.size!=0))
+    {
+     if (fc.Write(j.pos,buf[writer],j.size)!=j.size) failed = true;
+    }
+    writer ^= 1;
+    free.Add();
+   }
+  }
+
+
+ private:
+  struct Job
+  {
+   nat64 pos;
+   nat32 size;
+   bit stop;
+  };
+  
+  FileCode & fc;
+  byte * buf[2];
+  Job job[2];
+  volatile bit failed;
+  nat32 writer; // Index of the next buffer for the thread to write.
+  
+  mt::EventLock full; // Buffers waiting to be written.
+  mt::EventLock free; // Buffers written but not yet reclaimed.
+};
+
+//------------------------------------------------------------------------------
+WriteBufferCode::WriteBufferCode(FileCode & f,nat64 p,nat32 bs,bit b)
+:fc(f),pos(p),bufSize(math::Max(bs,nat32(4096))),fill(0),failed(false),cur(0),behind(null<Behind*>())
+{
+ if (b)
+ {
+  behind = new Behind(fc,bufSize);
+  if (behind->Run()) buf = behind->Buffer(0);
+  else
+  {
+   delete behind;
+   behind = null<Behind*>();
+  }
+ }
+ if (behind==null<Behind*>()) buf = mem::AlignedMalloc<byte>(bufSize,4096);
+}
+
+WriteBufferCode::~WriteBufferCode()
+{
+ Flush();
+ if (behind)
+ {
+  behind->Stop(cur);
+  delete behind;
+ }
+ else mem::AlignedFree(buf);
+}
+
+nat32 WriteBufferCode::Write(const void * in,nat32 bytes)
+{
+ if (failed) return 0;
+ const byte * data = (const byte*)in;
+
+ if ((behind==null<Behind*>())&&(fill+bytes>bufSize))
+ {
+  Drain();
+  if (failed) return 0;
+  if (bytes>=bufSize)
+  {
+   nat32 done = fc.Write(pos,data,bytes);
+   if (done>bytes) done = 0;
+   pos += done;
+   if (done!=bytes) failed = true;
+   return done;
+  }
+ }
+
+ nat32 ret = 0;
+ while (ret<bytes)
+ {
+  nat32 toDo = math::Min(bytes-ret,bufSize-fill);
+  memcpy(buf+fill,data+ret,toDo);
+  fill += toDo;
+  ret += toDo;
+  if (fill==bufSize)
+  {
+   Drain();
+   if (failed) break;
+  }
+ }
+ return ret;
+}
+
+nat32 WriteBufferCode::Pad(byte item,nat32 bytes)
+{
+ if (failed) return 0;
+ nat32 ret = 0;
+ while (ret<bytes)
+ {
+  nat32 toDo = math::Min(bytes-ret,bufSize-fill);
+  memset(buf+fill,item,toDo);
+  fill += toDo;
+  ret += toDo;
+  if (fill==bufSize)
+  {
+   Drain();
+   if (failed) break;
+  }
+ }
+ return ret;
+}
+
+nat32 WriteBufferCode::WriteV(nat32 count,const void * const * data,const nat32 * amount)
+{
+ if (failed) return 0;
+ nat32 ret = 0;
+ if (behind)
+ {
+  // The other thread owns the file position, so just buffer everything...
+   for (nat32 i=0;i<count;i++)
+   {
+    nat32 done = Write(data[i],amount[i]);
+    ret += done;
+    if (done!=amount[i]) break;
+   }
+ }
+ else
+ {
+  nat32 want = 0;
+  for (nat32 i=0;i<count;i++) want += amount[i];
+  if (fill+want<=bufSize)
+  {
+   for (nat32 i=0;i<count;i++) ret += Write(data[i],amount[i]);
+  }
+  else
+  {
+   Drain();
+   if (failed) return 0;
+   ret = fc.WriteV(pos,count,data,amount);
+   pos += ret;
+   if (ret!=want) failed = true;
+  }
+ }
+ return ret;
+}
+
+bit WriteBufferCode::Flush()
+{
+ Drain();
+ if (behind)
+ {
+  behind->Sync();
+  if (behind->Failed()) failed = true;
+ }
+ return !failed;
+}
+
+bit WriteBufferCode::Failed() const
+{
+ return failed || (behind && behind->Failed());
+}
+
+void WriteBufferCode::Drain()
+{
+ if ((fill==0)||failed) {fill = 0; return;}
+ if (behind)
+ {
+  buf = behind->Submit(cur,pos,fill);
+  if (behind->Failed()) failed = true;
+ }
+ else
+ {
+  if (fc.Write(pos,buf,fill)!=fill) failed = true;
+ }
+ pos += fill;
+ fill = 0;
+}
+
+//------------------------------------------------------------------------------
+FileMap::FileMap(cstrconst fn,bit copyOnWrite)
+:cow(copyOnWrite),ptr(null<byte*>()),size(0)
+{
+ int handle = open(fn,O_RDONLY | O_LARGEFILE);
+ if (handle==-1) return;
+
+ struct stat info;
+ if ((fstat(handle,&info)==-1)||(info.st_size==0)) {close(handle); return;}
+ size = info.st_size;
+
+ #ifdef EOS_WIN32
+  // No mmap, so just read it all in...
+   ptr = mem::Malloc<byte>(size);
+   if (ptr)
+   {
+    nat64 done = 0;
+    while (done<size)
+    {
+     int amount = read(handle,ptr+done,nat32(math::Min<nat64>(size-done,1<<30)));
+     if (amount<=0) {mem::Free(ptr); ptr = null<byte*>(); break;}
+     done += amount;
+    }
+   }
+ #else
+  void * m = mmap(0,size_t(size),cow?(PROT_READ|PROT_WRITE):PROT_READ,MAP_PRIVATE,handle,0);
+  if (m!=MAP_FAILED) ptr = (byte*)m;
+ #endif
+ 
+ if (ptr==null<byte*>()) size = 0;
+ close(handle);
+}
+
+FileMap::~FileMap()
+{
+ #ifdef EOS_WIN32
+  mem::Free(ptr);
+ #else
+  if (ptr) munmap(ptr,size_t(size));
+ #endif
+}
+
 //------------------------------------------------------------------------------
  };
 };
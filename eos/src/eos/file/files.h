@@ -92,12 +92,16 @@ class EOS_CLASS FileCode
   bit Open(const str::String & fn,Way way,Mode mode,Safe safe = safe_none);
   void Close();
   
-  nat32 Size() const;
+  nat64 Size() const;
   nat32 SetSize(nat32 size);
   
-  nat32 Read(nat32 pos,void * data,nat32 amount) const;
-  nat32 Write(nat32 pos,const void * data,nat32 amount);
-  nat32 Pad(nat32 pos,byte item,nat32 amount);
+  nat32 Read(nat64 pos,void * data,nat32 amount) const;
+  nat32 Write(nat64 pos,const void * data,nat32 amount);
+  nat32 Pad(nat64 pos,byte item,nat32 amount);
+  nat32 WriteV(nat64 pos,nat32 count,const void * const * data,const nat32 * amount);
+
+  void Sequential() const;
+  void WillNeed(nat64 pos,nat32 amount) const;
 
 
  private:
@@ -108,10 +112,16 @@ class EOS_CLASS FileCode
 };
 
 //------------------------------------------------------------------------------
-// A predeclaraction needed for below...
+// Predeclaractions needed for below...
 template <typename ET>
 class EOS_CLASS File;
 
+template <typename ET>
+class EOS_CLASS ReadBuffer;
+
+template <typename ET>
+class EOS_CLASS WriteBuffer;
+
 //------------------------------------------------------------------------------
 /// The File I/O cursor class, specific instances are extracted from the File 
 /// class. Where actual i/o happens.
@@ -120,7 +130,7 @@ class EOS_CLASS Cursor : public io::InOut<ET>
 {
  protected:
   friend class File<ET>;
-  Cursor(FileCode & f,nat32 p):fc(&f),pos(p) {}
+  Cursor(FileCode & f,nat64 p):fc(&f),pos(p) {}
   
  public:
 
@@ -144,16 +154,17 @@ class EOS_CLASS Cursor : public io::InOut<ET>
    /// Safe to call when not active, will return false.
     bit CanWrite() {if (fc) return fc->CanWrite(); else return false;}
         
-   /// &nbsp;
-    nat32 Size() const {return fc->Size();}
+   /// Files over 4 gig report 0xFFFFFFFF.
+    nat32 Size() const {return Clamp(fc->Size());}
 
 
   // From io::In...
    /// &nbsp;
     bit EOS() const {return pos>=fc->Size();}
     
-   /// &nbsp;
-    nat32 Avaliable() const {if (pos<fc->Size()) return fc->Size()-pos; else return 0;}
+   /// Capped at 0xFFFFFFFF, so with large files you can keep reading after
+   /// this many bytes.
+    nat32 Avaliable() const {nat64 size = fc->Size(); if (pos<size) return Clamp(size-pos); else return 0;}
     
    /// &nbsp;
     nat32 Read(void * out,nat32 bytes) {nat32 p = fc->Read(pos,out,bytes); pos += p; return p;}
@@ -182,7 +193,9 @@ class EOS_CLASS Cursor : public io::InOut<ET>
 
  private:
   FileCode * fc;
-  nat32 pos;
+  nat64 pos; // 64 bit, so files over 4 gig can be streamed.
+  
+  static nat32 Clamp(nat64 v) {return (v>nat64(0xFFFFFFFF))?0xFFFFFFFF:nat32(v);}
 };
 
 //------------------------------------------------------------------------------
@@ -247,8 +260,8 @@ class EOS_CLASS File : public io::Seekable<ET>
  
  
   // From seekable...
-   /// &nbsp;
-    nat32 Size() const {return fc.Size();}
+   /// Files over 4 gig report 0xFFFFFFFF.
+    nat32 Size() const {nat64 s = fc.Size(); return (s>nat64(0xFFFFFFFF))?0xFFFFFFFF:nat32(s);}
 
    /// Returns true.
     bit CanResize() const {return true;}
@@ -270,9 +283,243 @@ class EOS_CLASS File : public io::Seekable<ET>
 
 
  private:
+  friend class ReadBuffer<ET>;
+  friend class WriteBuffer<ET>;
   FileCode fc;
 };
 
+//------------------------------------------------------------------------------
+// Code for the ReadBuffer flat template.
+class EOS_CLASS ReadBufferCode
+{
+ public:
+   ReadBufferCode(FileCode & fc,nat64 pos,nat32 bufSize,bit readahead);
+  ~ReadBufferCode();
+
+  bit EOS() const;
+  nat32 Avaliable() const;
+  nat32 Read(void * out,nat32 bytes);
+  nat32 Peek(void * out,nat32 bytes) const;
+  nat32 Skip(nat32 bytes) {at += bytes; return bytes;}
+
+  nat64 Position() const {return at;}
+
+
+ private:
+  FileCode & fc;
+  bit readahead;
+  nat64 at; // Position of the next byte to read.
+  nat64 bufPos; // File position of buf[0].
+  nat32 bufSize;
+  nat32 fill; // How much of the buffer is valid.
+  byte * buf;
+
+  bit Refill();
+};
+
+//------------------------------------------------------------------------------
+/// A buffered alternative to Cursor for reading a file from start to finish.
+/// Rather than a system call for each Read it reads in large blocks, into a
+/// page aligned buffer, and tells the OS that the file is being streamed so it
+/// reads ahead whilst the data is being parsed. Reads bigger than the buffer go
+/// straight into the callers memory. The File must outlive it, and nothing
+/// else should write to the file whilst it exists.
+template <typename ET>
+class EOS_CLASS ReadBuffer : public io::In<ET>
+{
+ public:
+  /// Starts reading at the given position, with a buffer of the given size.
+  /// If readahead is true the OS is asked to fetch the block after the
+  /// current one whenever the buffer is refilled.
+   ReadBuffer(File<ET> & file,nat64 pos = 0,nat32 bufSize = 1024*1024,bit readahead = true)
+   :rbc(file.fc,pos,bufSize,readahead) {}
+
+  /// &nbsp;
+   ~ReadBuffer() {}
+
+
+  /// Returns the file position of the next byte to be read.
+   nat64 Position() const {return rbc.Position();}
+
+
+  // From io::In...
+   /// &nbsp;
+    bit EOS() const {return rbc.EOS();}
+
+   /// Capped at 0xFFFFFFFF, as for Cursor.
+    nat32 Avaliable() const {return rbc.Avaliable();}
+
+   /// &nbsp;
+    nat32 Read(void * out,nat32 bytes) {return rbc.Read(out,bytes);}
+
+   /// &nbsp;
+    nat32 Peek(void * out,nat32 bytes) const {return rbc.Peek(out,bytes);}
+
+   /// &nbsp;
+    nat32 Skip(nat32 bytes) {return rbc.Skip(bytes);}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::file::ReadBuffer<" << typestring<ET>() << ">");
+    return ret;
+   }
+
+
+ private:
+  ReadBufferCode rbc;
+};
+
+//------------------------------------------------------------------------------
+// Code for the WriteBuffer flat template.
+class EOS_CLASS WriteBufferCode
+{
+ public:
+   WriteBufferCode(FileCode & fc,nat64 pos,nat32 bufSize,bit behind);
+  ~WriteBufferCode();
+
+  nat32 Write(const void * in,nat32 bytes);
+  nat32 Pad(byte item,nat32 bytes);
+  nat32 WriteV(nat32 count,const void * const * data,const nat32 * amount);
+  bit Flush();
+
+  nat64 Position() const {return pos + fill;}
+  bit Failed() const;
+
+
+ private:
+  class Behind;
+
+  FileCode & fc;
+  nat64 pos; // File position of buf[0].
+  nat32 bufSize;
+  nat32 fill;
+  byte * buf;
+  bit failed;
+  nat32 cur; // Which of the threads buffers buf is, when behind.
+  Behind * behind; // null if writes happen in the calling thread, otherwise it owns buf.
+
+  void Drain();
+};
+
+//------------------------------------------------------------------------------
+/// A buffered alternative to Cursor for writing a file from start to finish.
+/// Small writes are gathered into a large page aligned buffer which is written
+/// out in one go when full, whilst writes bigger than the buffer skip it. In
+/// write-behind mode the full buffer is handed to a seperate thread, which
+/// writes it out whilst the caller carries on filling a second buffer, so
+/// serialisation and disk i/o overlap. Remember to call Flush and check its
+/// return value - the destructor flushes as well, but has no way to report
+/// failure. Once a write has failed the error flag is set and all further
+/// writes return 0. The File must outlive it.
+template <typename ET>
+class EOS_CLASS WriteBuffer : public io::Out<ET>
+{
+ public:
+  /// Starts writing at the given position, with a buffer of the given size.
+  /// If behind is true a thread is created to do the writting, with two
+  /// buffers of the given size.
+   WriteBuffer(File<ET> & file,nat64 pos = 0,nat32 bufSize = 1024*1024,bit behind = false)
+   :wbc(file.fc,pos,bufSize,behind) {}
+
+  /// &nbsp;
+   ~WriteBuffer() {}
+
+
+  /// Writes out everything given so far, returning true on success. Only
+  /// returns once the data has been handed to the OS, even in write-behind
+  /// mode.
+   bit Flush() {bit ret = wbc.Flush(); if (!ret) this->SetError(true); return ret;}
+
+  /// Returns the file position the next byte will be written to.
+   nat64 Position() const {return wbc.Position();}
+
+  /// Writes count blocks one after another, as a single gathering system call
+  /// when possible, so a set of seperate arrays, such as the data blocks of an
+  /// svt::Var, can be written without copying them together first. Returns
+  /// the total number of bytes written.
+   nat32 WriteV(nat32 count,const void * const * data,const nat32 * amount)
+   {
+    nat32 ret = wbc.WriteV(count,data,amount);
+    if (wbc.Failed()) this->SetError(true);
+    return ret;
+   }
+
+
+  // From io::Out...
+   /// &nbsp;
+    nat32 Write(const void * in,nat32 bytes)
+    {
+     nat32 ret = wbc.Write(in,bytes);
+     if (ret!=bytes) this->SetError(true);
+     return ret;
+    }
+
+   /// &nbsp;
+    nat32 Pad(nat32 bytes)
+    {
+     nat32 ret = wbc.Pad(GetPadByte(ET()),bytes);
+     if (ret!=bytes) this->SetError(true);
+     return ret;
+    }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::file::WriteBuffer<" << typestring<ET>() << ">");
+    return ret;
+   }
+
+
+ private:
+  WriteBufferCode wbc;
+};
+
+//------------------------------------------------------------------------------
+/// Maps an entire file into memory, so it can be accessed as a simple block of
+/// bytes, with the operating system paging it in as needed rather than it
+/// being read in one go. The mapping is either read only or copy on write,
+/// where writes alter the memory but never the file. Reference counted, as it
+/// is ushally shared by the objects that point into it, so the mapping stays 
+/// valid until the last of them releases it.
+/// On platforms without mmap it falls back to reading the file into memory.
+class EOS_CLASS FileMap : public RefCounter
+{
+ public:
+  /// Maps the given file, check Active() to see if it worked.
+  /// \param fn The file to map.
+  /// \param copyOnWrite If true the memory can be written to, without it effecting the file, otherwise it is read only and writting will crash.
+   FileMap(cstrconst fn,bit copyOnWrite = true);
+
+  /// &nbsp;
+   ~FileMap();
+
+
+  /// Returns true if the file was mapped succesfully.
+   bit Active() const {return ptr!=null<byte*>();}
+
+  /// Returns true if the mapping can be written to.
+   bit CopyOnWrite() const {return cow;}
+
+  /// Returns a pointer to the start of the file, aligned to at least a page.
+   byte * Ptr() const {return ptr;}
+
+  /// Returns the size of the file, and hence the mapping, in bytes.
+   nat64 Size() const {return size;}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::file::FileMap";}
+
+
+ private:
+  bit cow;
+  byte * ptr;
+  nat64 size;
+};
+
 //------------------------------------------------------------------------------
  };
 };
@@ -18,6 +18,7 @@
 
 #include "eos/file/images.h"
 #include "eos/file/devil_funcs.h"
+#include "eos/mt/locks.h"
 
 namespace eos
 {
@@ -25,6 +26,9 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 // Helper code for DevIL...
+
+// DevIL keeps global state, so only one thread can be in it at a time...
+static mt::OwnedLock devilLock;
   
 // First part of a 2 stage file loader...
 bit DevilLoadStart(cstrconst filename,nat32 & handle,nat32 & outWidth,nat32 & outHeight)
@@ -106,6 +110,7 @@ ImageL::ImageL(nat32 w,nat32 h,const bs::ColourL & colour)
 bit ImageL::Load(cstrconst filename)
 {
  nat32 handle,width,height;
+ mt::AutoLock lock(devilLock);
  if (DevilActive()==false) return false;
  if (DevilLoadStart(filename,handle,width,height))
  {
@@ -117,6 +122,7 @@ bit ImageL::Load(cstrconst filename)
 
 bit ImageL::Save(cstrconst filename,bit overwrite)
 {
+ mt::AutoLock lock(devilLock);
  if (DevilActive()==false) return false;
  return DevilSave(filename,width,height,DEVIL_FORM_L,DEVIL_TYPE_FLOAT,data,overwrite);
 }
@@ -172,6 +178,7 @@ bit ImageRGB::Load(cstrconst filename)
 
 bit ImageRGB::Save(cstrconst filename,bit overwrite)
 {
+ mt::AutoLock lock(devilLock);
  if (DevilActive()==false) return false;
  return DevilSave(filename,width,height,DEVIL_FORM_RGB,DEVIL_TYPE_FLOAT,data,overwrite);
 }
@@ -201,6 +208,45 @@ ImageRGB * ImageRGB::AsRGB() const
  return ret;
 }
 
+//------------------------------------------------------------------------------
+bit ImageBytes::Load(cstrconst filename)
+{
+ Release();
+
+ mt::AutoLock lock(devilLock);
+ if (DevilActive()==false) return false;
+ if (DevilLoadStart(filename,handle,width,height)==false)
+ {
+  handle = 0;
+  width = 0;
+  height = 0;
+  return false;
+ }
+
+ if (!ilConvertImage(DEVIL_FORM_RGB,DEVIL_TYPE_BYTE))
+ {
+  ilDeleteImages(1,(unsigned int *)&handle);
+  handle = 0;
+  width = 0;
+  height = 0;
+  return false;
+ }
+ data = ilGetData();
+ return true;
+}
+
+void ImageBytes::Release()
+{
+ if (data==null<const byte*>()) return;
+
+ mt::AutoLock lock(devilLock);
+ ilDeleteImages(1,(unsigned int *)&handle);
+ handle = 0;
+ width = 0;
+ height = 0;
+ data = null<const byte*>();
+}
+
 //------------------------------------------------------------------------------
  };
 };
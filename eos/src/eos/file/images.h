@@ -222,6 +222,54 @@ class EOS_CLASS ImageRGB : public Image
   bs::ColourRGB * data;
 };
 
+//------------------------------------------------------------------------------
+/// An image as decoded by DevIL, converted to 8 bit rgb, interleaved with the
+/// top row first, and left where DevIL put it rather than being copied out.
+/// For loading straight into some other format in one pass, e.g. by
+/// filter::LoadImage. DevIL is only locked whilst loading and releasing, so
+/// several threads can be reading there ImageBytes at once.
+class EOS_CLASS ImageBytes
+{
+ public:
+  /// &nbsp;
+   ImageBytes():handle(0),width(0),height(0),data(null<const byte*>()) {}
+
+  /// &nbsp;
+   ~ImageBytes() {Release();}
+
+
+  /// Loads the given file, returning true on success. Releases any previous
+  /// image first.
+   bit Load(cstrconst filename);
+
+  /// Hands the memory back to DevIL, called automatically on deletion.
+   void Release();
+
+
+  /// &nbsp;
+   nat32 Width() const {return width;}
+
+  /// &nbsp;
+   nat32 Height() const {return height;}
+
+  /// Returns the start of the given row, width*3 bytes of r, g and b.
+   const byte * Row(nat32 y) const {return data + y*Stride();}
+
+  /// Returns how many bytes apart the rows are.
+   nat32 Stride() const {return width*3;}
+
+
+  /// &nbsp;
+   cstrconst TypeString() const {return "eos::file::ImageBytes";}
+
+
+ private:
+  nat32 handle;
+  nat32 width;
+  nat32 height;
+  const byte * data;
+};
+
 //------------------------------------------------------------------------------
  };
 };
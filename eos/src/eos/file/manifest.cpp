@@ -0,0 +1,505 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/file/manifest.h"
+
+#include "eos/mem/alloc.h"
+#include "eos/file/files.h"
+#include "eos/io/to_virt.h"
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+namespace eos
+{
+ namespace file
+ {
+//------------------------------------------------------------------------------
+// Identifies a saved manifest, and its version...
+static const nat32 manifestMagic = 0x4D464E31; // "MFN1"
+
+//------------------------------------------------------------------------------
+// The results of scanning a single directory...
+struct FolderScan
+{
+ FolderScan():path(null<cstr>()),time(0),exists(false),read(false),files(0),subs(0) {}
+ ~FolderScan()
+ {
+  mem::Free(path);
+  for (nat32 i=0;i<files;i++) mem::Free(file[i].fn);
+  for (nat32 i=0;i<subs;i++) mem::Free(sub[i]);
+ }
+
+ cstr path;
+ nat64 time;
+ bit exists;
+ bit read;
+
+ ds::Array<Manifest::Entry> file;
+ nat32 files;
+ ds::Array<cstr> sub;
+ nat32 subs;
+
+ void AddFile(cstr fn,nat64 size,nat64 time)
+ {
+  if (files==file.Size()) file.Size(math::Max<nat32>(2*files,16));
+  file[files].fn = fn;
+  file[files].size = size;
+  file[files].time = time;
+  ++files;
+ }
+
+ void AddSub(cstr name)
+ {
+  if (subs==sub.Size()) sub.Size(math::Max<nat32>(2*subs,16));
+  sub[subs++] = name;
+ }
+};
+
+// For sorting the above by path...
+struct FolderRef
+{
+ FolderScan * fs;
+
+ bit operator < (const FolderRef & rhs) const {return str::Compare(fs->path,rhs.fs->path)<0;}
+};
+
+// And the files...
+struct EntryRef
+{
+ Manifest::Entry * e;
+
+ bit operator < (const EntryRef & rhs) const {return str::Compare(e->fn,rhs.e->fn)<0;}
+};
+
+//------------------------------------------------------------------------------
+// Scans a range of the directories of a level, with ParallelFor. old is the
+// previous state of the manifest, null if it can't be used...
+class ManifestLevel
+{
+ public:
+  ManifestLevel(FolderScan * s,const Manifest * o,cstrconst p)
+  :scan(s),old(o),pattern(p) {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   for (nat32 i=begin;i<end;i++) Do(scan[i]);
+  }
+
+
+ private:
+  FolderScan * scan;
+  const Manifest * old;
+  cstrconst pattern;
+
+  void Do(FolderScan & fs) const
+  {
+   struct stat info;
+   if (stat(fs.path,&info)!=0) return;
+   fs.exists = true;
+   fs.time = info.st_mtime;
+
+   // If the directory is unchanged take its contents from the old manifest...
+    if (old)
+    {
+     nat32 ind = old->Find(fs.path);
+     if ((ind!=old->Folders())&&(old->folder[ind].time==fs.time))
+     {
+      const Manifest::Folder & targ = old->folder[ind];
+      for (nat32 j=0;j<targ.files;j++)
+      {
+       const Manifest::Entry & e = old->file[targ.file+j];
+       fs.AddFile(str::Duplicate(e.fn),e.size,e.time);
+      }
+      for (nat32 j=0;j<targ.subs;j++) fs.AddSub(str::Duplicate(old->sub[targ.sub+j]));
+      return;
+     }
+    }
+
+   // Otherwise read it...
+    fs.read = true;
+    DIR * dir = opendir(fs.path);
+    if (dir==0) return;
+
+    nat32 pLength = str::Length(fs.path);
+    while (true)
+    {
+     dirent * ent = readdir(dir);
+     if (ent==0) break;
+     if ((str::Compare(ent->d_name,".")==0)||(str::Compare(ent->d_name,"..")==0)) continue;
+
+     // Where the filesystem tells us the type we can skip the stat for
+     // directories and non-matching files...
+      bit isDir = false;
+      bit known = false;
+      #ifdef _DIRENT_HAVE_D_TYPE
+       if (ent->d_type==DT_DIR) {isDir = true; known = true;}
+       else if (ent->d_type==DT_REG) known = true;
+      #endif
+
+      if (known&&(!isDir)&&pattern&&(!WildMatch(pattern,ent->d_name))) continue;
+
+      cstr full = mem::Malloc<cstrchar>(pLength+str::Length(ent->d_name)+1);
+      str::Copy(full,fs.path);
+      str::Copy(full+pLength,ent->d_name);
+
+      if (!(known&&isDir))
+      {
+       #ifdef EOS_LINUX
+        if ((!known)&&(lstat(full,&info)==0)&&S_ISLNK(info.st_mode))
+        {
+         // Links are only followed to files...
+          if ((stat(full,&info)!=0)||(!S_ISREG(info.st_mode))) {mem::Free(full); continue;}
+        }
+        else
+       #endif
+        if (stat(full,&info)!=0) {mem::Free(full); continue;}
+       isDir = S_ISDIR(info.st_mode);
+      }
+
+      if (isDir)
+      {
+       fs.AddSub(str::Duplicate(ent->d_name));
+       mem::Free(full);
+      }
+      else if ((pattern==null<cstrconst>())||WildMatch(pattern,ent->d_name))
+      {
+       fs.AddFile(full,info.st_size,info.st_mtime);
+      }
+      else mem::Free(full);
+    }
+    closedir(dir);
+  }
+};
+
+//------------------------------------------------------------------------------
+Manifest::Manifest()
+:rescanned(0)
+{}
+
+Manifest::~Manifest()
+{
+ Clear();
+}
+
+void Manifest::Clear()
+{
+ for (nat32 i=0;i<folder.Size();i++) mem::Free(folder[i].path);
+ for (nat32 i=0;i<file.Size();i++) mem::Free(file[i].fn);
+ for (nat32 i=0;i<sub.Size();i++) mem::Free(sub[i]);
+
+ root = "";
+ pattern = "";
+ folder.Size(0);
+ file.Size(0);
+ sub.Size(0);
+ rescanned = 0;
+}
+
+void Manifest::Scan(const Dir & r,cstrconst pat,time::Progress * prog)
+{
+ prog->Push();
+
+ // Decide on the root path, with a trailing '/', and if the current contents
+ // are of any use...
+  str::String newRoot(r.RealPath());
+  {
+   cstr rp = newRoot.ToStr();
+   nat32 rpLength = str::Length(rp);
+   if ((rpLength==0)||(rp[rpLength-1]!='/')) newRoot << "/";
+   mem::Free(rp);
+  }
+  str::String newPattern(pat?pat:"");
+
+  bit useOld = (folder.Size()!=0) && (root==newRoot) && (pattern==newPattern);
+
+ // Walk the tree a level at a time, keeping every level...
+  ds::Array<FolderScan*> level;
+  ds::Array<nat32> levelSize;
+  nat32 levels = 0;
+  nat32 folders = 0;
+
+  FolderScan * current = new FolderScan[1];
+  current[0].path = newRoot.ToStr();
+  nat32 currentSize = 1;
+  while (currentSize!=0)
+  {
+   prog->Report(levels,levels+1);
+
+   ManifestLevel ml(current,useOld?this:null<Manifest*>(),pat);
+   mt::ParallelFor(0,currentSize,ml);
+
+   if (levels==level.Size())
+   {
+    level.Size(math::Max<nat32>(2*levels,16));
+    levelSize.Size(level.Size());
+   }
+   level[levels] = current;
+   levelSize[levels] = currentSize;
+   ++levels;
+   folders += currentSize;
+
+   // Next level is every subdirectory of this one...
+    nat32 nextSize = 0;
+    for (nat32 i=0;i<currentSize;i++) nextSize += current[i].subs;
+
+    FolderScan * next = (nextSize!=0)?new FolderScan[nextSize]:null<FolderScan*>();
+    nat32 pos = 0;
+    for (nat32 i=0;i<currentSize;i++)
+    {
+     for (nat32 j=0;j<current[i].subs;j++)
+     {
+      str::String p(current[i].path);
+      p << current[i].sub[j] << "/";
+      next[pos++].path = p.ToStr();
+     }
+    }
+    current = next;
+    currentSize = nextSize;
+  }
+
+ // Sort the directories, and count up...
+  ds::Array<FolderRef> order(folders);
+  nat32 files = 0;
+  nat32 subs = 0;
+  nat32 read = 0;
+  {
+   nat32 pos = 0;
+   for (nat32 l=0;l<levels;l++)
+   {
+    for (nat32 i=0;i<levelSize[l];i++)
+    {
+     FolderScan & fs = level[l][i];
+     if (!fs.exists) continue;
+     order[pos++].fs = &fs;
+     files += fs.files;
+     subs += fs.subs;
+     if (fs.read) ++read;
+    }
+   }
+   order.Size(pos);
+   order.SortNorm();
+  }
+
+ // Replace the contents, taking ownership of the strings...
+  Clear();
+  root = newRoot;
+  pattern = newPattern;
+  rescanned = read;
+
+  folder.Size(order.Size());
+  file.Size(files);
+  sub.Size(subs);
+
+  nat32 filePos = 0;
+  nat32 subPos = 0;
+  for (nat32 i=0;i<order.Size();i++)
+  {
+   FolderScan & fs = *order[i].fs;
+   Folder & targ = folder[i];
+   targ.path = fs.path;
+   targ.time = fs.time;
+   targ.file = filePos;
+   targ.files = fs.files;
+   targ.sub = subPos;
+   targ.subs = fs.subs;
+
+   // The files of a directory are sorted, which with the directories
+   // being sorted gives the whole list in path order...
+    ds::Array<EntryRef> fo(fs.files);
+    for (nat32 j=0;j<fs.files;j++) fo[j].e = &fs.file[j];
+    fo.SortNorm();
+    for (nat32 j=0;j<fs.files;j++) file[filePos++] = *fo[j].e;
+    for (nat32 j=0;j<fs.subs;j++) sub[subPos++] = fs.sub[j];
+
+   fs.path = null<cstr>();
+   fs.files = 0;
+   fs.subs = 0;
+  }
+
+ // Clean up...
+  for (nat32 l=0;l<levels;l++) delete[] level[l];
+
+ prog->Pop();
+}
+
+bit Manifest::Load(cstrconst fn)
+{
+ Clear();
+
+ file::File<io::Binary> f(fn,file::way_edit,file::mode_read);
+ if (!f.Active()) return false;
+
+ file::Cursor<io::Binary> cursor = f.GetCursor();
+ io::VirtIn<file::Cursor<io::Binary> > in(cursor);
+
+ // Strings are stored with a length...
+  struct Helper
+  {
+   static cstr ReadStr(io::VirtIn<file::Cursor<io::Binary> > & in,bit & ok)
+   {
+    nat32 length;
+    if (in.Read(&length,sizeof(nat32))!=sizeof(nat32)) {ok = false; return null<cstr>();}
+    cstr ret = mem::Malloc<cstrchar>(length+1);
+    if (in.Read(ret,length)!=length) ok = false;
+    ret[length] = 0;
+    return ret;
+   }
+  };
+
+ // Header...
+  nat32 head[4];
+  if (in.Read(head,sizeof(head))!=sizeof(head)) return false;
+  if (head[0]!=manifestMagic) return false;
+
+  bit ok = true;
+  cstr rs = Helper::ReadStr(in,ok);
+  cstr ps = Helper::ReadStr(in,ok);
+  root = rs;
+  pattern = ps;
+  mem::Free(rs);
+  mem::Free(ps);
+
+ // Contents, zeroed first so a failure part way through can be cleared...
+  folder.Size(head[1]);
+  file.Size(head[2]);
+  sub.Size(head[3]);
+  for (nat32 i=0;i<folder.Size();i++) folder[i].path = null<cstr>();
+  for (nat32 i=0;i<file.Size();i++) file[i].fn = null<cstr>();
+  for (nat32 i=0;i<sub.Size();i++) sub[i] = null<cstr>();
+
+  for (nat32 i=0;ok&&(i<folder.Size());i++)
+  {
+   Folder & targ = folder[i];
+   targ.path = Helper::ReadStr(in,ok);
+   nat32 range[4];
+   ok = ok && (in.Read(&targ.time,sizeof(nat64))==sizeof(nat64)) && (in.Read(range,sizeof(range))==sizeof(range));
+   targ.file = range[0];
+   targ.files = range[1];
+   targ.sub = range[2];
+   targ.subs = range[3];
+   ok = ok && (targ.file+targ.files<=file.Size()) && (targ.sub+targ.subs<=sub.Size());
+  }
+
+  for (nat32 i=0;ok&&(i<file.Size());i++)
+  {
+   Entry & targ = file[i];
+   targ.fn = Helper::ReadStr(in,ok);
+   ok = ok && (in.Read(&targ.size,sizeof(nat64))==sizeof(nat64)) && (in.Read(&targ.time,sizeof(nat64))==sizeof(nat64));
+  }
+
+  for (nat32 i=0;ok&&(i<sub.Size());i++) sub[i] = Helper::ReadStr(in,ok);
+
+ if (!ok) Clear();
+ return ok;
+}
+
+bit Manifest::Load(const str::String & fn)
+{
+ cstr ts = fn.ToStr();
+ bit ret = Load(ts);
+ mem::Free(ts);
+ return ret;
+}
+
+bit Manifest::Save(cstrconst fn,bit overwrite) const
+{
+ file::File<io::Binary> f(fn,overwrite?file::way_ow:file::way_new,file::mode_write);
+ if (!f.Active()) return false;
+
+ file::Cursor<io::Binary> cursor = f.GetCursor();
+ io::VirtOut<file::Cursor<io::Binary> > out(cursor);
+
+ struct Helper
+ {
+  static bit WriteStr(io::VirtOut<file::Cursor<io::Binary> > & out,cstrconst s)
+  {
+   nat32 length = str::Length(s);
+   return (out.Write(&length,sizeof(nat32))==sizeof(nat32)) && (out.Write(s,length)==length);
+  }
+ };
+
+ // Header...
+  nat32 head[4];
+  head[0] = manifestMagic;
+  head[1] = folder.Size();
+  head[2] = file.Size();
+  head[3] = sub.Size();
+  if (out.Write(head,sizeof(head))!=sizeof(head)) return false;
+
+  cstr rs = root.ToStr();
+  cstr ps = pattern.ToStr();
+  bit ok = Helper::WriteStr(out,rs) && Helper::WriteStr(out,ps);
+  mem::Free(rs);
+  mem::Free(ps);
+
+ // Contents...
+  for (nat32 i=0;ok&&(i<folder.Size());i++)
+  {
+   const Folder & targ = folder[i];
+   nat32 range[4];
+   range[0] = targ.file;
+   range[1] = targ.files;
+   range[2] = targ.sub;
+   range[3] = targ.subs;
+   ok = Helper::WriteStr(out,targ.path) &&
+        (out.Write(&targ.time,sizeof(nat64))==sizeof(nat64)) &&
+        (out.Write(range,sizeof(range))==sizeof(range));
+  }
+
+  for (nat32 i=0;ok&&(i<file.Size());i++)
+  {
+   const Entry & targ = file[i];
+   ok = Helper::WriteStr(out,targ.fn) &&
+        (out.Write(&targ.size,sizeof(nat64))==sizeof(nat64)) &&
+        (out.Write(&targ.time,sizeof(nat64))==sizeof(nat64));
+  }
+
+  for (nat32 i=0;ok&&(i<sub.Size());i++) ok = Helper::WriteStr(out,sub[i]);
+
+ return ok;
+}
+
+bit Manifest::Save(const str::String & fn,bit overwrite) const
+{
+ cstr ts = fn.ToStr();
+ bit ret = Save(ts,overwrite);
+ mem::Free(ts);
+ return ret;
+}
+
+nat32 Manifest::Find(cstrconst path) const
+{
+ nat32 low = 0;
+ nat32 high = folder.Size();
+ while (low<high)
+ {
+  nat32 mid = (low+high)/2;
+  int32 c = str::Compare(folder[mid].path,path);
+  if (c==0) return mid;
+  if (c<0) low = mid+1;
+      else high = mid;
+ }
+ return folder.Size();
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,156 @@
+#ifndef EOS_FILE_MANIFEST_H
+#define EOS_FILE_MANIFEST_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file manifest.h
+/// Provides a recursive, parallel, directory walker that remembers what it
+/// found, so the file list of a large dataset can be saved and brought up to
+/// date on later runs without reading every directory again.
+
+#include "eos/types.h"
+#include "eos/file/dirs.h"
+#include "eos/ds/arrays.h"
+#include "eos/str/strings.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace file
+ {
+//------------------------------------------------------------------------------
+// Predeclarations of the helpers of Manifest...
+class ManifestLevel;
+struct FolderScan;
+struct EntryRef;
+
+//------------------------------------------------------------------------------
+/// A list of every file under a directory whose name matches a pattern, with
+/// sizes and modification times. Scan walks the tree a level at a time, reading
+/// all the directories of each level at once with the default mt::TaskPool,
+/// which is what makes it fast on network storage, where each directory read
+/// is mostly waiting.
+///
+/// A manifest can be saved and loaded. Scanning with a loaded manifest only
+/// reads directories whose modification time has changed, as a directory's
+/// time changes whenever a file is added, removed or renamed within it. The
+/// tree is still walked, with a stat per directory, as a change deep down does
+/// not change the times of the directories above. The catch is that a file
+/// rewritten in place, without changing its directory, keeps its old size and
+/// time in the manifest - rename into place, as most tools do, if that matters.
+///
+/// Files are listed in order of their full path, so the results of a scan do
+/// not depend on the filesystem or number of threads. Symbolic links to files
+/// are included, links to directories are not followed.
+class EOS_CLASS Manifest
+{
+ public:
+  /// Creates an empty manifest.
+   Manifest();
+
+  /// &nbsp;
+   ~Manifest();
+
+
+  /// Empties the manifest.
+   void Clear();
+
+  /// Brings the manifest up to date with the tree under the given directory,
+  /// listing only files matching the pattern, with the same wildcards as
+  /// Dir::Children. If the manifest is of another directory or pattern it is
+  /// scanned from scratch.
+   void Scan(const Dir & root,cstrconst pattern = null<cstrconst>(),time::Progress * prog = null<time::Progress*>());
+
+
+  /// Loads a saved manifest, returns false on failure, in which case it is
+  /// left empty so a Scan does all the work.
+   bit Load(cstrconst fn);
+
+  /// &nbsp;
+   bit Load(const str::String & fn);
+
+  /// Saves the manifest, returns false on failure.
+   bit Save(cstrconst fn,bit overwrite = true) const;
+
+  /// &nbsp;
+   bit Save(const str::String & fn,bit overwrite = true) const;
+
+
+  /// Returns how many files are in the manifest.
+   nat32 Size() const {return file.Size();}
+
+  /// Returns the full path of a file.
+   cstrconst Filename(nat32 i) const {return file[i].fn;}
+
+  /// Returns the size of a file, in bytes.
+   nat64 FileSize(nat32 i) const {return file[i].size;}
+
+  /// Returns the modification time of a file, in seconds since the epoch.
+   nat64 FileTime(nat32 i) const {return file[i].time;}
+
+
+  /// Returns how many directories are in the manifest.
+   nat32 Folders() const {return folder.Size();}
+
+  /// Returns how many directories the last Scan actually had to read, as
+  /// opposed to taking from the manifest.
+   nat32 Rescanned() const {return rescanned;}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::file::Manifest";}
+
+
+ private:
+  struct Entry
+  {
+   cstr fn; // Full path, mem::Malloc-ed.
+   nat64 size;
+   nat64 time;
+  };
+
+  struct Folder
+  {
+   cstr path; // Full path with trailing '/', mem::Malloc-ed.
+   nat64 time;
+   nat32 file; // Range of entries in file.
+   nat32 files;
+   nat32 sub; // Range of leaf names in sub.
+   nat32 subs;
+  };
+
+  str::String root;
+  str::String pattern;
+  ds::Array<Folder> folder; // Sorted by path.
+  ds::Array<Entry> file;
+  ds::Array<cstr> sub; // Leaf names of subdirectories, mem::Malloc-ed.
+  nat32 rescanned;
+
+  // Returns the index of the folder with the given path, or Folders() if
+  // there isn't one...
+   nat32 Find(cstrconst path) const;
+
+  friend class ManifestLevel;
+  friend struct FolderScan;
+  friend struct EntryRef;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
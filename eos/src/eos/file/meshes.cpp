@@ -51,6 +51,30 @@ EOS_FUNC bit SaveMesh(const sur::Mesh & mesh,const str::String & filename,
  return ret;
 }
 
+EOS_FUNC bit SaveMesh(const sur::IndexedMesh & mesh,cstrconst filename,
+                      bit overwrite,time::Progress * prog)
+{
+ if (str::AtEnd(filename,".obj"))
+ {
+  Wavefront out;
+  mesh.Store(out);
+  return out.Save(filename,overwrite,prog);
+ }
+ else
+ {
+  return SavePly(mesh,filename,overwrite,prog);
+ }
+}
+
+EOS_FUNC bit SaveMesh(const sur::IndexedMesh & mesh,const str::String & filename,
+                      bit overwrite,time::Progress * prog)
+{
+ cstr fn = filename.ToStr();
+ bit ret = SaveMesh(mesh,fn,overwrite,prog);
+ mem::Free(fn);
+ return ret;
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC sur::Mesh * LoadMesh(cstrconst filename,
                               time::Progress * prog,str::TokenTable * tt)
@@ -74,6 +98,26 @@ EOS_FUNC sur::Mesh * LoadMesh(const str::String & filename,
  return ret;
 }
 
+EOS_FUNC bit LoadMesh(cstrconst filename,sur::IndexedMesh & out,time::Progress * prog)
+{
+ if (str::AtEnd(filename,".obj"))
+ {
+  return LoadWavefront(filename,out,prog);
+ }
+ else
+ {
+  return LoadPly(filename,out,prog);
+ }
+}
+
+EOS_FUNC bit LoadMesh(const str::String & filename,sur::IndexedMesh & out,time::Progress * prog)
+{
+ cstr fn = filename.ToStr();
+ bit ret = LoadMesh(fn,out,prog);
+ mem::Free(fn);
+ return ret;
+}
+
 //------------------------------------------------------------------------------
  };
 };
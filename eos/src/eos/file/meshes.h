@@ -24,6 +24,7 @@
 
 #include "eos/types.h"#include "eos/str/strings.h"
 #include "eos/sur/mesh.h"
+#include "eos/sur/indexed_mesh.h"
 
 namespace eos
 {
@@ -42,6 +43,16 @@ EOS_FUNC bit SaveMesh(const sur::Mesh & mesh,cstrconst filename,bit overwrite =
 EOS_FUNC bit SaveMesh(const sur::Mesh & mesh,const str::String & filename,bit overwrite = false,
                       time::Progress * prog = null<time::Progress*>());
 
+/// Saves an IndexedMesh, with the same file type selection as for a Mesh.
+/// Returns true on success.
+EOS_FUNC bit SaveMesh(const sur::IndexedMesh & mesh,cstrconst filename,bit overwrite = false,
+                      time::Progress * prog = null<time::Progress*>());
+
+/// Saves an IndexedMesh, with the same file type selection as for a Mesh.
+/// Returns true on success.
+EOS_FUNC bit SaveMesh(const sur::IndexedMesh & mesh,const str::String & filename,bit overwrite = false,
+                      time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
 /// Loads a mesh, works out what kind of file it is and uses the correct loader
 /// accordingly.
@@ -59,6 +70,16 @@ EOS_FUNC sur::Mesh * LoadMesh(const str::String & filename,
                               time::Progress * prog = null<time::Progress*>(),
                               str::TokenTable * tt = null<str::TokenTable*>());
 
+/// Loads an IndexedMesh, with the same file type selection, using the fast
+/// loaders that go straight to one. Returns true on success.
+EOS_FUNC bit LoadMesh(cstrconst filename,sur::IndexedMesh & out,
+                      time::Progress * prog = null<time::Progress*>());
+
+/// Loads an IndexedMesh, with the same file type selection, using the fast
+/// loaders that go straight to one. Returns true on success.
+EOS_FUNC bit LoadMesh(const str::String & filename,sur::IndexedMesh & out,
+                      time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
  };
 };
@@ -25,6 +25,8 @@
 #include "eos/str/functions.h"
 #include "eos/str/tokenize.h"
 #include "eos/file/csv.h"
+#include "eos/sur/indexed_mesh.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -584,8 +586,8 @@ EOS_FUNC sur::Mesh * LoadPly(cstrconst filename,time::Progress * prog,str::Token
    prog->Pop();
    return null<sur::Mesh*>();
   }
-  Cursor<io::Binary> cur = f.GetCursor();
-  io::VirtIn< Cursor<io::Binary> > virtCur = io::VirtIn< Cursor<io::Binary> >(cur);
+  ReadBuffer<io::Binary> cur(f);
+  io::VirtIn< ReadBuffer<io::Binary> > virtCur = io::VirtIn< ReadBuffer<io::Binary> >(cur);
   nat32 fSize = f.Size();
   prog->Report(0,fSize);
 
@@ -776,6 +778,830 @@ EOS_FUNC sur::Mesh * LoadPly(cstrconst filename,time::Progress * prog,str::Token
  return ret;
 }
 
+//------------------------------------------------------------------------------
+// Stuff for the fast loader, which works from a memory mapped file rather than
+// the io streams, so has its own header parser...
+static const nat32 plyMaxProps = 32;
+static const nat32 plyMaxElems = 16;
+static const nat64 plyChunkRows = 65536; // Rows per chunk for binary files.
+static const nat64 plyChunkBytes = 1<<20; // Bytes per chunk for ascii files.
+static const nat64 plyMaxVerts = 0xFFFFFFFF/4; // As IndexedMesh arrays are limited to 4 gig each.
+static const nat64 plyMaxTris = 0xFFFFFFFF/12; // "
+
+struct PlyFastProp
+{
+ PlyType type; // PlyList for a list.
+ PlyType lenType; // For lists only.
+ PlyType idxType; // "
+ int32 outInd; // 0..2 for position, 3..4 for uv, 5..7 for normal or -1 if ignored.
+ bit faceList; // True if this is the face list.
+};
+
+struct PlyFastElem
+{
+ nat32 kind; // 0 for the vertices, 1 for the faces, 2 for anything else.
+ nat64 rows;
+ nat64 first; // Row number of its first row in the file, for ascii.
+ nat32 stride; // Bytes per row for binary without lists, otherwise 0.
+ nat32 props;
+ PlyFastProp prop[plyMaxProps];
+};
+
+// A block of rows that is decoded by a single thread...
+struct PlyChunk
+{
+ nat64 start; // Byte offset of the first row.
+ nat64 end; // Byte offset after the last row, ascii only.
+ nat64 row; // First row - within the element for binary, within the file for ascii.
+ nat64 rows;
+ nat64 tri; // First output triangle.
+ nat64 tris;
+ bit bad; // Set if its got a bad index or doesn't parse.
+};
+
+// Copies the next line of the header into buf, splitting it into tokens,
+// returning how many and advancing pos past it...
+nat32 PlyHeaderLine(const byte * data,nat64 size,nat64 & pos,cstrchar buf[256],cstr tok[8])
+{
+ nat32 len = 0;
+ while ((pos<size)&&(data[pos]!='\n'))
+ {
+  if (len<255) {buf[len] = cstrchar(data[pos]); ++len;}
+  ++pos;
+ }
+ if (pos<size) ++pos;
+ buf[len] = 0;
+
+ nat32 ret = 0;
+ nat32 i = 0;
+ while (true)
+ {
+  while ((i<len)&&((buf[i]==' ')||(buf[i]=='\t')||(buf[i]=='\r'))) {buf[i] = 0; ++i;}
+  if (i>=len) break;
+  if (ret<8) tok[ret] = buf + i;
+  ++ret;
+  while ((i<len)&&(buf[i]!=' ')&&(buf[i]!='\t')&&(buf[i]!='\r')) ++i;
+ }
+ return ret;
+}
+
+struct PlyFastHeader
+{
+ PlyEncode encode;
+ nat64 body; // Byte offset of the data.
+ nat32 elems;
+ PlyFastElem elem[plyMaxElems];
+ int32 vertElem; // Index of the vertex element, -1 if none.
+ int32 faceElem; // Index of the face element, -1 if none.
+ bit hasUV;
+ bit hasNorm;
+
+ bit Parse(const byte * data,nat64 size)
+ {
+  cstrchar buf[256];
+  cstr tok[8];
+  nat64 pos = 0;
+
+  encode = PlyUnknownEncode;
+  elems = 0;
+  vertElem = -1;
+  faceElem = -1;
+
+  nat32 n = PlyHeaderLine(data,size,pos,buf,tok);
+  if ((n!=1)||(str::Compare(tok[0],"ply")!=0)) {LogAlways("[file.ply] Not a ply file."); return false;}
+
+  while (true)
+  {
+   if (pos>=size) {LogAlways("[file.ply] Header not terminated."); return false;}
+   n = PlyHeaderLine(data,size,pos,buf,tok);
+   if (n==0) continue; // Skip blank lines.
+   if (str::Compare(tok[0],"end_header")==0) break;
+
+   if (str::Compare(tok[0],"format")==0)
+   {
+    if ((n!=3)||(encode!=PlyUnknownEncode)) {LogAlways("[file.ply] Format error."); return false;}
+    if (str::Compare(tok[1],"ascii")==0) encode = PlyAscii;
+    else if (str::Compare(tok[1],"binary_little_endian")==0) encode = PlyLittleEndian;
+    else if (str::Compare(tok[1],"binary_big_endian")==0) encode = PlyBigEndian;
+    else {LogAlways("[file.ply] Unrecognised encoding." << LogDiv() << tok[1]); return false;}
+    if (str::Compare(tok[2],"1.0")!=0) {LogAlways("[file.ply] Unsuported version." << LogDiv() << tok[2]); return false;}
+   }
+   else if ((str::Compare(tok[0],"comment")==0)||(str::Compare(tok[0],"obj_info")==0))
+   {
+    // Ignore.
+   }
+   else if (str::Compare(tok[0],"element")==0)
+   {
+    if (n!=3) {LogAlways("[file.ply] Element line is wrong length."); return false;}
+    if (elems==plyMaxElems) {LogAlways("[file.ply] Too many elements."); return false;}
+    PlyFastElem & el = elem[elems];
+
+    cstrconst ptr = tok[2];
+    if (!str::ParseNat(ptr,tok[2]+str::Length(tok[2]),el.rows)) {LogAlways("[file.ply] Bad element size." << LogDiv() << tok[2]); return false;}
+    el.kind = 2;
+    if ((vertElem==-1)&&(str::Compare(tok[1],"vertex")==0)) {el.kind = 0; vertElem = elems;}
+    if ((faceElem==-1)&&(str::Compare(tok[1],"face")==0)) {el.kind = 1; faceElem = elems;}
+    el.first = (elems==0)?0:(elem[elems-1].first + elem[elems-1].rows);
+    el.props = 0;
+    ++elems;
+   }
+   else if (str::Compare(tok[0],"property")==0)
+   {
+    if (elems==0) {LogAlways("[file.ply] Property size error."); return false;}
+    PlyFastElem & el = elem[elems-1];
+    if (el.props==plyMaxProps) {LogAlways("[file.ply] Too many properties."); return false;}
+    PlyFastProp & pp = el.prop[el.props];
+    pp.outInd = -1;
+    pp.faceList = false;
+
+    if (n==3)
+    {
+     pp.type = StrToPlyType(tok[1]);
+     if ((pp.type==PlyUnknown)||(pp.type==PlyList)) {LogAlways("[file.ply] Bad property (0)."); return false;}
+
+     if (el.kind==0)
+     {
+      cstrconst name = tok[2];
+      if (str::Compare(name,"x")==0) pp.outInd = 0;
+      if (str::Compare(name,"y")==0) pp.outInd = 1;
+      if (str::Compare(name,"z")==0) pp.outInd = 2;
+
+      if ((str::Compare(name,"u")==0)||(str::Compare(name,"s")==0)||
+          (str::Compare(name,"texture_u")==0)||(str::Compare(name,"texture_s")==0)) pp.outInd = 3;
+      if ((str::Compare(name,"v")==0)||(str::Compare(name,"t")==0)||
+          (str::Compare(name,"texture_v")==0)||(str::Compare(name,"texture_t")==0)) pp.outInd = 4;
+
+      if (str::Compare(name,"nx")==0) pp.outInd = 5;
+      if (str::Compare(name,"ny")==0) pp.outInd = 6;
+      if (str::Compare(name,"nz")==0) pp.outInd = 7;
+     }
+    }
+    else if (n==5)
+    {
+     if (str::Compare(tok[1],"list")!=0) {LogAlways("[file.ply] Bad property (1)."); return false;}
+     pp.type = PlyList;
+     pp.lenType = StrToPlyType(tok[2]);
+     if ((pp.lenType==PlyUnknown)||(pp.lenType==PlyList)) {LogAlways("[file.ply] Bad list length type."); return false;}
+     pp.idxType = StrToPlyType(tok[3]);
+     if ((pp.idxType==PlyUnknown)||(pp.idxType==PlyList)) {LogAlways("[file.ply] Bad list index type."); return false;}
+
+     if ((el.kind==1)&&((str::Compare(tok[4],"vertex_index")==0)||(str::Compare(tok[4],"vertex_indices")==0))) pp.faceList = true;
+    }
+    else {LogAlways("[file.ply] Invalid property line length."); return false;}
+
+    ++el.props;
+   }
+   else
+   {
+    LogAlways("[file.ply] Unknown header type." << LogDiv() << tok[0]);
+    return false;
+   }
+  }
+  body = pos;
+
+  if (encode==PlyUnknownEncode) {LogAlways("[file.ply] Header omited format info."); return false;}
+
+
+  // Work out the strides of fixed size rows, and what the vertices have...
+   for (nat32 e=0;e<elems;e++)
+   {
+    PlyFastElem & el = elem[e];
+    el.stride = 0;
+    for (nat32 i=0;i<el.props;i++)
+    {
+     if (el.prop[i].type==PlyList) {el.stride = 0; break;}
+     el.stride += PlyTypeSize(el.prop[i].type);
+    }
+   }
+
+   bit got[8] = {false,false,false,false,false,false,false,false};
+   if (vertElem!=-1)
+   {
+    for (nat32 i=0;i<elem[vertElem].props;i++)
+    {
+     if (elem[vertElem].prop[i].outInd>=0) got[elem[vertElem].prop[i].outInd] = true;
+    }
+   }
+   hasUV = got[3] && got[4];
+   hasNorm = got[5] && got[6] && got[7];
+
+  return true;
+ }
+};
+
+// Reads binary values from memory, in either byte order. Ints are as is,
+// reals are scaled to [0,1] or [-1,1] as ReadPlyReal does...
+inline nat64 PlyRawBits(const byte * p,nat32 size,bit big)
+{
+ nat64 ret = 0;
+ if (big) {for (nat32 i=0;i<size;i++) ret = (ret<<8) | nat64(p[i]);}
+     else {for (nat32 i=size;i>0;i--) ret = (ret<<8) | nat64(p[i-1]);}
+ return ret;
+}
+
+inline int64 PlyRawInt(const byte * p,PlyType t,bit big)
+{
+ switch (t)
+ {
+  case PlyChar: return int8(p[0]);
+  case PlyUChar: return p[0];
+  case PlyShort: return int16(nat16(PlyRawBits(p,2,big)));
+  case PlyUShort: return nat16(PlyRawBits(p,2,big));
+  case PlyInt: return int32(nat32(PlyRawBits(p,4,big)));
+  case PlyUInt: return nat32(PlyRawBits(p,4,big));
+  case PlyFloat: {union {nat32 i; real32 r;} u; u.i = nat32(PlyRawBits(p,4,big)); return int64(u.r);}
+  case PlyDouble: {union {nat64 i; real64 r;} u; u.i = PlyRawBits(p,8,big); return int64(u.r);}
+  default: return 0;
+ }
+}
+
+inline real32 PlyRawReal(const byte * p,PlyType t,bit big)
+{
+ switch (t)
+ {
+  case PlyChar: return real32(int8(p[0]))/real32(math::max_int_8);
+  case PlyUChar: return real32(p[0])/real32(math::max_nat_8);
+  case PlyShort: return real32(int16(nat16(PlyRawBits(p,2,big))))/real32(math::max_int_16);
+  case PlyUShort: return real32(nat16(PlyRawBits(p,2,big)))/real32(math::max_nat_16);
+  case PlyInt: return real32(int32(nat32(PlyRawBits(p,4,big))))/real32(math::max_int_32);
+  case PlyUInt: return real32(nat32(PlyRawBits(p,4,big)))/real32(math::max_nat_32);
+  case PlyFloat: {union {nat32 i; real32 r;} u; u.i = nat32(PlyRawBits(p,4,big)); return u.r;}
+  case PlyDouble: {union {nat64 i; real64 r;} u; u.i = PlyRawBits(p,8,big); return real32(u.r);}
+  default: return 0.0;
+ }
+}
+
+// Works out the chunks of a binary element, advancing pos to its end. Rows
+// with lists have to be skimmed, which also counts the triangles of each
+// chunk. Returns false if the file is too short...
+bit PlyBinaryPlan(const byte * data,nat64 size,bit big,const PlyFastElem & el,nat64 & pos,ds::Array<PlyChunk> & out)
+{
+ if ((el.stride==0)&&(el.rows>size-pos)) return false; // Every row with a list is at least a byte, and this avoids silly allocations.
+ if ((el.stride!=0)&&(el.rows>(size-pos)/el.stride)) return false;
+
+ out.Size(nat32((el.rows+plyChunkRows-1)/plyChunkRows));
+ for (nat32 c=0;c<out.Size();c++)
+ {
+  out[c].row = nat64(c)*plyChunkRows;
+  out[c].rows = math::Min(plyChunkRows,el.rows-out[c].row);
+  out[c].tri = 0;
+  out[c].tris = 0;
+  out[c].bad = false;
+ }
+
+ if (el.stride!=0)
+ {
+  for (nat32 c=0;c<out.Size();c++) out[c].start = pos + out[c].row*el.stride;
+  pos += el.rows*el.stride;
+ }
+ else
+ {
+  nat64 tri = 0;
+  for (nat32 c=0;c<out.Size();c++)
+  {
+   PlyChunk & ch = out[c];
+   ch.start = pos;
+   ch.tri = tri;
+   for (nat64 r=0;r<ch.rows;r++)
+   {
+    for (nat32 i=0;i<el.props;i++)
+    {
+     const PlyFastProp & pp = el.prop[i];
+     if (pp.type==PlyList)
+     {
+      nat32 lenSize = PlyTypeSize(pp.lenType);
+      if (lenSize>size-pos) return false;
+      int64 n = PlyRawInt(data+pos,pp.lenType,big);
+      pos += lenSize;
+
+      if (n<0) return false;
+      nat64 skip = nat64(n)*PlyTypeSize(pp.idxType);
+      if (skip>size-pos) return false;
+      pos += skip;
+
+      if (pp.faceList&&(n>2)) ch.tris += nat64(n) - 2;
+     }
+     else
+     {
+      nat32 s = PlyTypeSize(pp.type);
+      if (s>size-pos) return false;
+      pos += s;
+     }
+    }
+   }
+   tri += ch.tris;
+  }
+ }
+
+ return true;
+}
+
+// Decodes the chunks of a binary element into the mesh...
+class PlyBinaryDecode
+{
+ public:
+  PlyBinaryDecode(const byte * d,bit b,const PlyFastElem & e,ds::Array<PlyChunk> & c,sur::IndexedMesh & o)
+  :data(d),big(b),elem(e),chunk(c),out(o)
+  {}
+
+  void operator () (nat32 c0,nat32 c1)
+  {
+   nat64 verts = out.VertexCount();
+   for (nat32 c=c0;c<c1;c++)
+   {
+    PlyChunk & ch = chunk[c];
+    const byte * p = data + ch.start;
+    nat32 t = nat32(ch.tri);
+
+    for (nat64 r=0;r<ch.rows;r++)
+    {
+     real32 val[8] = {0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0};
+     for (nat32 i=0;i<elem.props;i++)
+     {
+      const PlyFastProp & pp = elem.prop[i];
+      if (pp.type==PlyList)
+      {
+       nat32 n = nat32(PlyRawInt(p,pp.lenType,big));
+       p += PlyTypeSize(pp.lenType);
+       nat32 idxSize = PlyTypeSize(pp.idxType);
+       if (pp.faceList)
+       {
+        nat32 first = 0;
+        nat32 prev = 0;
+        for (nat32 k=0;k<n;k++)
+        {
+         int64 ind = PlyRawInt(p,pp.idxType,big);
+         p += idxSize;
+         if ((ind<0)||(nat64(ind)>=verts)) {ch.bad = true; ind = 0;}
+
+         if (k==0) first = nat32(ind);
+         else
+         {
+          if (k>1) {out.SetTri(t,first,prev,nat32(ind)); ++t;}
+          prev = nat32(ind);
+         }
+        }
+       }
+       else p += n*idxSize;
+      }
+      else
+      {
+       if (pp.outInd>=0) val[pp.outInd] = PlyRawReal(p,pp.type,big);
+       p += PlyTypeSize(pp.type);
+      }
+     }
+
+     if (elem.kind==0)
+     {
+      nat32 v = nat32(ch.row + r);
+      out.SetPos(v,bs::Vert(val[0],val[1],val[2]));
+      if (out.HasUV()) out.SetUV(v,bs::Tex2D(val[3],val[4]));
+      if (out.HasNormals()) out.SetNorm(v,bs::Normal(val[5],val[6],val[7]));
+     }
+    }
+   }
+  }
+
+ private:
+  const byte * data;
+  bit big;
+  const PlyFastElem & elem;
+  ds::Array<PlyChunk> & chunk;
+  sur::IndexedMesh & out;
+};
+
+// Does one of the three passes over the chunks of an ascii file - 0 counts the
+// rows in each chunk, 1 the triangles and 2 decodes into the mesh...
+class PlyAsciiPass
+{
+ public:
+  PlyAsciiPass(const byte * d,const PlyFastHeader & h,ds::Array<PlyChunk> & c,sur::IndexedMesh & o,nat32 p)
+  :data(d),head(h),chunk(c),out(o),pass(p)
+  {}
+
+  void operator () (nat32 c0,nat32 c1)
+  {
+   for (nat32 c=c0;c<c1;c++)
+   {
+    PlyChunk & ch = chunk[c];
+
+    // Only the face rows matter when counting triangles...
+     if (pass==1)
+     {
+      if (head.faceElem==-1) continue;
+      const PlyFastElem & fe = head.elem[head.faceElem];
+      if ((ch.row+ch.rows<=fe.first)||(ch.row>=fe.first+fe.rows)) continue;
+     }
+
+    cstrconst ptr = (cstrconst)(data + ch.start);
+    cstrconst end = (cstrconst)(data + ch.end);
+    nat64 row = ch.row;
+    nat64 tri = ch.tri;
+    nat32 e = 0;
+
+    while (ptr!=end)
+    {
+     cstrconst lineEnd = ptr;
+     while ((lineEnd!=end)&&(*lineEnd!='\n')) ++lineEnd;
+
+     str::SkipSpace(ptr,lineEnd);
+     if (ptr!=lineEnd)
+     {
+      if (pass!=0)
+      {
+       while ((e<head.elems)&&(row>=head.elem[e].first+head.elem[e].rows)) ++e;
+       if ((e<head.elems)&&((head.elem[e].kind==1)||((pass==2)&&(head.elem[e].kind==0))))
+       {
+        if (!Row(ptr,lineEnd,head.elem[e],row-head.elem[e].first,tri)) ch.bad = true;
+       }
+      }
+      ++row;
+     }
+
+     ptr = lineEnd;
+     if (ptr!=end) ++ptr;
+    }
+
+    if (pass==0) ch.rows = row - ch.row;
+    if (pass==1) ch.tris = tri - ch.tri;
+   }
+  }
+
+ private:
+  const byte * data;
+  const PlyFastHeader & head;
+  ds::Array<PlyChunk> & chunk;
+  sur::IndexedMesh & out;
+  nat32 pass;
+
+  // Parses a row, advancing tri by its triangles; only writes them and the
+  // vertices to the mesh in pass 2. Returns false on error...
+   bit Row(cstrconst ptr,cstrconst end,const PlyFastElem & el,nat64 r,nat64 & tri)
+   {
+    real64 val[8] = {0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0};
+    for (nat32 i=0;i<el.props;i++)
+    {
+     const PlyFastProp & pp = el.prop[i];
+     if (pp.type==PlyList)
+     {
+      int64 n;
+      if ((!str::ParseInt(ptr,end,n))||(n<0)) return false;
+      if (pp.faceList&&(pass==2))
+      {
+       nat64 verts = out.VertexCount();
+       nat32 first = 0;
+       nat32 prev = 0;
+       bit ok = true;
+       for (int64 k=0;k<n;k++)
+       {
+        int64 ind;
+        if (!str::ParseInt(ptr,end,ind)) return false;
+        if ((ind<0)||(nat64(ind)>=verts)) {ok = false; ind = 0;}
+
+        if (k==0) first = nat32(ind);
+        else
+        {
+         if (k>1) {out.SetTri(nat32(tri),first,prev,nat32(ind)); ++tri;}
+         prev = nat32(ind);
+        }
+       }
+       if (!ok) return false;
+      }
+      else
+      {
+       for (int64 k=0;k<n;k++)
+       {
+        real64 dummy;
+        if (!str::ParseReal(ptr,end,dummy)) return false;
+       }
+       if (pp.faceList&&(n>2)) tri += nat64(n) - 2;
+      }
+     }
+     else
+     {
+      real64 v;
+      if (!str::ParseReal(ptr,end,v)) return false;
+      if (pp.outInd>=0) val[pp.outInd] = v;
+     }
+    }
+
+    if ((pass==2)&&(el.kind==0))
+    {
+     nat32 v = nat32(r);
+     out.SetPos(v,bs::Vert(val[0],val[1],val[2]));
+     if (out.HasUV()) out.SetUV(v,bs::Tex2D(val[3],val[4]));
+     if (out.HasNormals()) out.SetNorm(v,bs::Normal(val[5],val[6],val[7]));
+    }
+    return true;
+   }
+};
+
+// Sets the mesh up to the given size, with the extras the header says the
+// vertices have. Returns false if too large...
+bit PlySetup(const PlyFastHeader & head,nat64 tris,sur::IndexedMesh & out)
+{
+ nat64 verts = (head.vertElem==-1)?0:head.elem[head.vertElem].rows;
+ if ((verts>plyMaxVerts)||(tris>plyMaxTris))
+ {
+  LogAlways("[file.ply] Mesh too large." << LogDiv() << verts << LogDiv() << tris);
+  return false;
+ }
+
+ out.Clear();
+ out.Setup(nat32(verts),nat32(tris));
+ if (head.hasUV) out.EnableUV();
+ if (head.hasNorm) out.EnableNormals();
+ return true;
+}
+
+// Checks if any chunks are bad...
+bit PlyAnyBad(const ds::Array<PlyChunk> & chunk)
+{
+ for (nat32 c=0;c<chunk.Size();c++)
+ {
+  if (chunk[c].bad) return true;
+ }
+ return false;
+}
+
+// The loader for binary files...
+bit PlyLoadBinary(const byte * data,nat64 size,const PlyFastHeader & head,sur::IndexedMesh & out,time::Progress * prog)
+{
+ bit big = head.encode==PlyBigEndian;
+
+ // Plan the chunks, skimming the variable sized elements...
+  nat64 pos = head.body;
+  ds::Array<PlyChunk> vertChunk;
+  ds::Array<PlyChunk> faceChunk;
+  ds::Array<PlyChunk> otherChunk;
+  for (nat32 e=0;e<head.elems;e++)
+  {
+   prog->Report(e,head.elems);
+   ds::Array<PlyChunk> & targ = (head.elem[e].kind==0)?vertChunk:((head.elem[e].kind==1)?faceChunk:otherChunk);
+   if (!PlyBinaryPlan(data,size,big,head.elem[e],pos,targ)) {LogAlways("[file.ply] File truncated."); return false;}
+  }
+
+  nat64 tris = 0;
+  for (nat32 c=0;c<faceChunk.Size();c++) tris += faceChunk[c].tris;
+  if (!PlySetup(head,tris,out)) return false;
+
+
+ // Decode, vertices and then faces, in parallel...
+  if (head.vertElem!=-1)
+  {
+   PlyBinaryDecode pbd(data,big,head.elem[head.vertElem],vertChunk,out);
+   mt::ParallelFor(nat32(0),vertChunk.Size(),pbd);
+  }
+
+  if (head.faceElem!=-1)
+  {
+   PlyBinaryDecode pbd(data,big,head.elem[head.faceElem],faceChunk,out);
+   mt::ParallelFor(nat32(0),faceChunk.Size(),pbd);
+   if (PlyAnyBad(faceChunk)) {LogAlways("[file.ply] Bad vertex index."); return false;}
+  }
+
+ return true;
+}
+
+// The loader for ascii files...
+bit PlyLoadAscii(const byte * data,nat64 size,const PlyFastHeader & head,sur::IndexedMesh & out,time::Progress * prog)
+{
+ // Split the data into chunks, moving the boundaries to the next line start...
+  nat64 bytes = size - head.body;
+  ds::Array<PlyChunk> chunk(nat32(math::Min<nat64>(bytes/plyChunkBytes+1,4096)));
+  for (nat32 c=0;c<chunk.Size();c++)
+  {
+   nat64 start = head.body + (bytes*c)/chunk.Size();
+   if (c!=0)
+   {
+    start = math::Max(start,chunk[c-1].start);
+    while ((start<size)&&(data[start-1]!='\n')) ++start;
+   }
+   chunk[c].start = start;
+   chunk[c].row = 0;
+   chunk[c].rows = 0;
+   chunk[c].tri = 0;
+   chunk[c].tris = 0;
+   chunk[c].bad = false;
+  }
+  for (nat32 c=0;c+1<chunk.Size();c++) chunk[c].end = chunk[c+1].start;
+  chunk[chunk.Size()-1].end = size;
+
+
+ // Count the rows and hence find which row each chunk starts with...
+  prog->Report(0,3);
+  {
+   PlyAsciiPass pap(data,head,chunk,out,0);
+   mt::ParallelFor(nat32(0),chunk.Size(),pap);
+  }
+
+  nat64 rows = 0;
+  for (nat32 c=0;c<chunk.Size();c++)
+  {
+   chunk[c].row = rows;
+   rows += chunk[c].rows;
+  }
+
+  if ((head.elems!=0)&&(rows<head.elem[head.elems-1].first+head.elem[head.elems-1].rows))
+  {
+   LogAlways("[file.ply] File truncated.");
+   return false;
+  }
+
+
+ // Count the triangles...
+  prog->Report(1,3);
+  {
+   PlyAsciiPass pap(data,head,chunk,out,1);
+   mt::ParallelFor(nat32(0),chunk.Size(),pap);
+  }
+  if (PlyAnyBad(chunk)) {LogAlways("[file.ply] Parse error."); return false;}
+
+  nat64 tris = 0;
+  for (nat32 c=0;c<chunk.Size();c++)
+  {
+   chunk[c].tri = tris;
+   tris += chunk[c].tris;
+  }
+  if (!PlySetup(head,tris,out)) return false;
+
+
+ // Decode...
+  prog->Report(2,3);
+  {
+   PlyAsciiPass pap(data,head,chunk,out,2);
+   mt::ParallelFor(nat32(0),chunk.Size(),pap);
+  }
+  if (PlyAnyBad(chunk)) {LogAlways("[file.ply] Parse error or bad vertex index."); return false;}
+
+ return true;
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC bit LoadPly(cstrconst filename,sur::IndexedMesh & out,time::Progress * prog)
+{
+ LogTime("eos::file::LoadPly(IndexedMesh)");
+ prog->Push();
+
+ // Map the file...
+  FileMap * map = new FileMap(filename,false);
+  if (!map->Active())
+  {
+   LogAlways("[file.ply] Could not open file." << LogDiv() << filename);
+   delete map;
+   prog->Pop();
+   return false;
+  }
+  const byte * data = map->Ptr();
+  nat64 size = map->Size();
+
+
+ // Header, then the body...
+  PlyFastHeader * head = new PlyFastHeader();
+  bit ok = head->Parse(data,size);
+  if (ok)
+  {
+   if (head->encode==PlyAscii) ok = PlyLoadAscii(data,size,*head,out,prog);
+                          else ok = PlyLoadBinary(data,size,*head,out,prog);
+  }
+  delete head;
+  delete map;
+
+
+ if (ok) out.BuildAdjacency();
+    else out.Clear();
+
+ prog->Pop();
+ return ok;
+}
+
+//------------------------------------------------------------------------------
+// Buffers writes to a file, converting to little endian...
+class PlyWriter
+{
+ public:
+  PlyWriter(Cursor<io::Binary> & o):out(o),used(0),ok(true) {}
+
+  void Text(cstrconst s)
+  {
+   while (*s) {Nat8(nat8(*s)); ++s;}
+  }
+
+  void Nat8(nat8 v)
+  {
+   if (used==bufSize) Flush();
+   buf[used] = v;
+   ++used;
+  }
+
+  void Nat32(nat32 v)
+  {
+   if (used+4>bufSize) Flush();
+   buf[used] = v&0xFF;
+   buf[used+1] = (v>>8)&0xFF;
+   buf[used+2] = (v>>16)&0xFF;
+   buf[used+3] = (v>>24)&0xFF;
+   used += 4;
+  }
+
+  void Real32(real32 v)
+  {
+   union {real32 r; nat32 i;} u;
+   u.r = v;
+   Nat32(u.i);
+  }
+
+  bit Flush()
+  {
+   if (used!=0)
+   {
+    if (out.Write(buf,used)!=used) ok = false;
+    used = 0;
+   }
+   return ok;
+  }
+
+ private:
+  static const nat32 bufSize = 65536;
+  Cursor<io::Binary> & out;
+  byte buf[bufSize];
+  nat32 used;
+  bit ok;
+};
+
+EOS_FUNC bit SavePly(const sur::IndexedMesh & mesh,cstrconst filename,bit ow,time::Progress * prog)
+{
+ LogTime("eos::file::SavePly(IndexedMesh)");
+ prog->Push();
+
+ File<io::Binary> f(filename,ow?way_ow:way_new,mode_write);
+ if (!f.Active()) {prog->Pop(); return false;}
+ Cursor<io::Binary> cur = f.GetCursor();
+ PlyWriter * out = new PlyWriter(cur);
+
+
+ // Header...
+ {
+  cstrchar buf[32];
+  out->Text("ply\nformat binary_little_endian 1.0\nelement vertex ");
+  str::ToStr(mesh.VertexCount(),buf);
+  out->Text(buf);
+  out->Text("\nproperty float x\nproperty float y\nproperty float z\n");
+  if (mesh.HasNormals()) out->Text("property float nx\nproperty float ny\nproperty float nz\n");
+  if (mesh.HasUV()) out->Text("property float u\nproperty float v\n");
+
+  out->Text("element face ");
+  str::ToStr(mesh.TriCount(),buf);
+  out->Text(buf);
+  out->Text("\nproperty list uchar int vertex_indices\nend_header\n");
+ }
+
+
+ // Vertices...
+  nat32 steps = mesh.VertexCount() + mesh.TriCount();
+  const real32 * x = mesh.X();
+  const real32 * y = mesh.Y();
+  const real32 * z = mesh.Z();
+  for (nat32 i=0;i<mesh.VertexCount();i++)
+  {
+   if ((i&0xFFFF)==0) prog->Report(i,steps);
+   out->Real32(x[i]);
+   out->Real32(y[i]);
+   out->Real32(z[i]);
+   if (mesh.HasNormals())
+   {
+    bs::Normal n = mesh.Norm(i);
+    out->Real32(n[0]);
+    out->Real32(n[1]);
+    out->Real32(n[2]);
+   }
+   if (mesh.HasUV())
+   {
+    bs::Tex2D uv = mesh.UV(i);
+    out->Real32(uv[0]);
+    out->Real32(uv[1]);
+   }
+  }
+
+
+ // Triangles...
+  const nat32 * tri = mesh.Tris();
+  for (nat32 t=0;t<mesh.TriCount();t++)
+  {
+   if ((t&0xFFFF)==0) prog->Report(mesh.VertexCount()+t,steps);
+   out->Nat8(3);
+   out->Nat32(tri[t*3]);
+   out->Nat32(tri[t*3+1]);
+   out->Nat32(tri[t*3+2]);
+  }
+
+
+ bit ret = out->Flush();
+ delete out;
+ prog->Pop();
+ return ret;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -29,6 +29,11 @@
 
 namespace eos
 {
+ namespace sur
+ {
+  class EOS_CLASS IndexedMesh;
+ };
+
  namespace file
  {
 //------------------------------------------------------------------------------
@@ -89,6 +94,24 @@ class EOS_CLASS Ply
   ds::List<nat32> surface; // Faces are deliminated by nat32(-1).
 };
 
+//------------------------------------------------------------------------------
+/// Fast ply loader, straight into an IndexedMesh, for big files. Memory maps
+/// the file and decodes it in parallel chunks, whichever of the three
+/// encodings it is. Loads positions, texture coordinates if given as u,v or
+/// s,t and normals if given as nx,ny,nz, with values converted as LoadPly
+/// does; faces with more than 3 sides are fanned out and those with less
+/// dropped. For ascii files every element must be on its own line, as is
+/// normal. Returns false on error, which is logged, including for bad
+/// vertex indices.
+EOS_FUNC bit LoadPly(cstrconst filename,sur::IndexedMesh & out,
+                     time::Progress * prog = null<time::Progress*>());
+
+/// Saves an IndexedMesh as a binary little endian ply, with normals and
+/// texture coordinates if it has them. Writes straight from the mesh through a
+/// buffer, unlike the Ply class, so costs no memory. Returns true on success.
+EOS_FUNC bit SavePly(const sur::IndexedMesh & mesh,cstrconst filename,bit ow = false,
+                     time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
  };
 };
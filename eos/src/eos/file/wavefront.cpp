@@ -21,6 +21,10 @@
 #include "eos/io/to_virt.h"
 #include "eos/ds/arrays_resize.h"
 #include "eos/ds/dense_hash.h"
+#include "eos/str/functions.h"
+#include "eos/mt/locks.h"
+#include "eos/mt/tasks.h"
+#include "eos/sur/indexed_mesh.h"
 
 
 namespace eos
@@ -417,6 +421,511 @@ EOS_FUNC sur::Mesh * LoadWavefront(cstrconst filename,time::Progress * prog,str:
   return ret;
 }
 
+//------------------------------------------------------------------------------
+// Stuff for the fast loader...
+static const nat64 objChunkBytes = 1<<20;
+static const nat64 objMaxCount = 0xFFFFFFFF/12; // As IndexedMesh arrays are limited to 4 gig each.
+static const nat32 objBlock = 65536; // Corners per block when numbering the vertices.
+static const nat32 objNone = 0xFFFFFFFF;
+
+// A block of whole lines, with how many of each thing it contains, and then
+// with the totals before it...
+struct ObjChunk
+{
+ nat64 start;
+ nat64 end;
+
+ nat64 v;
+ nat64 vt;
+ nat64 vn;
+ nat64 corners;
+ nat64 tris;
+
+ bit bad;
+};
+
+// Identifies a line, returning 0 for ignored, 1 for v, 2 for vt, 3 for vn and
+// 4 for f, advancing ptr past the key word...
+inline nat32 ObjLineType(cstrconst & ptr,cstrconst end)
+{
+ str::SkipSpace(ptr,end);
+ cstrconst key = ptr;
+ while ((ptr!=end)&&(*ptr!=' ')&&(*ptr!='\t')) ++ptr;
+
+ switch (ptr-key)
+ {
+  case 1:
+   if (key[0]=='v') return 1;
+   if (key[0]=='f') return 4;
+  break;
+  case 2:
+   if ((key[0]=='v')&&(key[1]=='t')) return 2;
+   if ((key[0]=='v')&&(key[1]=='n')) return 3;
+  break;
+ }
+ return 0;
+}
+
+// Parses a face corner, of the form v, v/t, v//n or v/t/n, with 0 for the
+// omitted. Returns false if there isn't one...
+inline bit ObjCorner(cstrconst & ptr,cstrconst end,int64 & v,int64 & t,int64 & n)
+{
+ t = 0;
+ n = 0;
+ if (!str::ParseInt(ptr,end,v)) return false;
+ if ((ptr!=end)&&(*ptr=='/'))
+ {
+  ++ptr;
+  if ((ptr!=end)&&(*ptr!='/')&&(!str::ParseInt(ptr,end,t))) return false;
+  if ((ptr!=end)&&(*ptr=='/'))
+  {
+   ++ptr;
+   if (!str::ParseInt(ptr,end,n)) return false;
+  }
+ }
+ return true;
+}
+
+// Counts the tokens before the end of the line or a comment, which for a face
+// line is its number of corners...
+inline nat64 ObjTokens(cstrconst & ptr,cstrconst end)
+{
+ nat64 ret = 0;
+ while (true)
+ {
+  str::SkipSpace(ptr,end);
+  if ((ptr==end)||(*ptr=='#')) break;
+  while ((ptr!=end)&&(*ptr!=' ')&&(*ptr!='\t')&&(*ptr!='\r')) ++ptr;
+  ++ret;
+ }
+ return ret;
+}
+
+// Converts an index from the file, 1 based or negative to count back, to 0
+// based, returning objNone if bad...
+inline nat32 ObjIndex(int64 ind,nat64 sofar,nat64 total)
+{
+ int64 ret = (ind<0)?(int64(sofar)+ind):(ind-1);
+ if ((ret<0)||(ret>=int64(total))) return objNone;
+ return nat32(ret);
+}
+
+// Everything for the fast loader, as a functor that does each of the passes
+// in parallel. Vertices are the unique position/uv/normal combinations used by
+// the corners of faces; each corner is put in a hash table that keeps the
+// first corner with each combination, so the vertices come out in order of
+// first use, regardless of threading...
+struct ObjLoad
+{
+ ObjLoad(const byte * d,ds::Array<ObjChunk> & c,sur::IndexedMesh & o)
+ :data(d),chunk(c),out(o)
+ {}
+
+ const byte * data;
+ ds::Array<ObjChunk> & chunk;
+ sur::IndexedMesh & out;
+ nat32 pass;
+
+ nat64 totalV;
+ nat64 totalVT;
+ nat64 totalVN;
+
+ ds::Array<real32> pos; // 3 per v line.
+ ds::Array<real32> uv; // 2 per vt line.
+ ds::Array<real32> norm; // 3 per vn line.
+
+ ds::Array<nat32> cornerV; // Per corner, in file order.
+ ds::Array<nat32> cornerT; // Empty if there are no vt lines, objNone if not given.
+ ds::Array<nat32> cornerN; // "
+
+ ds::Array<mt::Atomic> slot; // Hash table of corner+1, 0 for empty.
+ nat32 mask;
+
+ ds::Array<nat32> id; // The first corner to match each, then vertex index.
+ ds::Array<nat32> block; // Vertices started in each block of corners, for numbering.
+
+ nat32 Hash(nat32 c) const
+ {
+  nat32 ret = cornerV[c]*0x9E3779B1;
+  if (cornerT.Size()!=0) ret ^= cornerT[c]*0x85EBCA77;
+  if (cornerN.Size()!=0) ret ^= cornerN[c]*0xC2B2AE3D;
+  return ret ^ (ret>>15);
+ }
+
+ bit Same(nat32 a,nat32 b) const
+ {
+  if (cornerV[a]!=cornerV[b]) return false;
+  if ((cornerT.Size()!=0)&&(cornerT[a]!=cornerT[b])) return false;
+  if ((cornerN.Size()!=0)&&(cornerN[a]!=cornerN[b])) return false;
+  return true;
+ }
+
+ // Adds a corner to the table, replacing a matching later one...
+  void Insert(nat32 c)
+  {
+   nat32 h = Hash(c) & mask;
+   while (true)
+   {
+    int32 curr = slot[h].Get();
+    if (curr==0)
+    {
+     if (slot[h].CompareSwap(0,int32(c+1))) return;
+     continue;
+    }
+
+    if (Same(nat32(curr-1),c))
+    {
+     while ((nat32(curr-1)>c)&&(!slot[h].CompareSwap(curr,int32(c+1)))) curr = slot[h].Get();
+     return;
+    }
+    h = (h+1) & mask;
+   }
+  }
+
+ // Returns the first corner that matches the given corner...
+  nat32 Find(nat32 c) const
+  {
+   nat32 h = Hash(c) & mask;
+   while (true)
+   {
+    nat32 curr = nat32(slot[h].Get()-1);
+    if (Same(curr,c)) return curr;
+    h = (h+1) & mask;
+   }
+  }
+
+ void operator () (nat32 b0,nat32 b1)
+ {
+  switch (pass)
+  {
+   case 0: case 1: for (nat32 c=b0;c<b1;c++) Parse(chunk[c]); break;
+   case 2: for (nat32 c=b0;c<b1;c++) Insert(c); break;
+   case 3: for (nat32 c=b0;c<b1;c++) id[c] = Find(c); break;
+   case 4: // Count the vertices started in each block...
+    for (nat32 b=b0;b<b1;b++)
+    {
+     nat32 end = math::Min(nat32((b+1)*objBlock),id.Size());
+     block[b] = 0;
+     for (nat32 c=b*objBlock;c<end;c++) {if (id[c]==c) ++block[b];}
+    }
+   break;
+   case 5: // Number the vertices and fill them in...
+    for (nat32 b=b0;b<b1;b++)
+    {
+     nat32 end = math::Min(nat32((b+1)*objBlock),id.Size());
+     nat32 v = block[b];
+     for (nat32 c=b*objBlock;c<end;c++)
+     {
+      if (id[c]!=c) continue;
+      nat32 p = cornerV[c];
+      out.SetPos(v,bs::Vert(pos[p*3],pos[p*3+1],pos[p*3+2]));
+      if (out.HasUV())
+      {
+       nat32 t = cornerT[c];
+       if (t!=objNone) out.SetUV(v,bs::Tex2D(uv[t*2],uv[t*2+1]));
+                  else out.SetUV(v,bs::Tex2D(0.0,0.0));
+      }
+      if (out.HasNormals())
+      {
+       nat32 n = cornerN[c];
+       if (n!=objNone) out.SetNorm(v,bs::Normal(norm[n*3],norm[n*3+1],norm[n*3+2]));
+                  else out.SetNorm(v,bs::Normal(0.0,0.0,0.0));
+      }
+      id[c] = v | 0x80000000;
+      ++v;
+     }
+    }
+   break;
+   case 6: // Everything else gets the vertex number of its first...
+    for (nat32 c=b0;c<b1;c++)
+    {
+     if ((id[c]&0x80000000)==0) id[c] = id[id[c]];
+    }
+   break;
+   case 7: // Triangles, which were made with corner indices...
+    for (nat32 t=b0;t<b1;t++)
+    {
+     out.SetTri(t,id[out.Corner(t,0)]&0x7FFFFFFF,id[out.Corner(t,1)]&0x7FFFFFFF,id[out.Corner(t,2)]&0x7FFFFFFF);
+    }
+   break;
+  }
+ }
+
+ // Pass 0 counts the contents of a chunk, pass 1 reads them in, given the
+ // totals before each chunk...
+  void Parse(ObjChunk & ch)
+  {
+   cstrconst ptr = (cstrconst)(data + ch.start);
+   cstrconst end = (cstrconst)(data + ch.end);
+
+   nat64 v = ch.v;
+   nat64 vt = ch.vt;
+   nat64 vn = ch.vn;
+   nat64 corners = ch.corners;
+   nat64 tris = ch.tris;
+   if (pass==0) {v = 0; vt = 0; vn = 0; corners = 0; tris = 0;}
+
+   while (ptr!=end)
+   {
+    cstrconst lineEnd = ptr;
+    while ((lineEnd!=end)&&(*lineEnd!='\n')) ++lineEnd;
+
+    switch (ObjLineType(ptr,lineEnd))
+    {
+     case 1:
+      if (pass==1)
+      {
+       for (nat32 i=0;i<3;i++)
+       {
+        real64 val;
+        if (!str::ParseReal(ptr,lineEnd,val)) {ch.bad = true; val = 0.0;}
+        pos[v*3+i] = val;
+       }
+      }
+      ++v;
+     break;
+     case 2:
+      if (pass==1)
+      {
+       real64 val[2] = {0.0,0.0};
+       if (!str::ParseReal(ptr,lineEnd,val[0])) ch.bad = true;
+       str::ParseReal(ptr,lineEnd,val[1]); // Optional.
+       uv[vt*2] = val[0];
+       uv[vt*2+1] = val[1];
+      }
+      ++vt;
+     break;
+     case 3:
+      if (pass==1)
+      {
+       for (nat32 i=0;i<3;i++)
+       {
+        real64 val;
+        if (!str::ParseReal(ptr,lineEnd,val)) {ch.bad = true; val = 0.0;}
+        norm[vn*3+i] = val;
+       }
+      }
+      ++vn;
+     break;
+     case 4:
+      if (pass==0)
+      {
+       nat64 n = ObjTokens(ptr,lineEnd);
+       if (n>2) {corners += n; tris += n - 2;}
+      }
+      else
+      {
+       // Parse the corners, fanning out triangles of corner indices. Has to
+       // agree with the count from the first pass, or the output would end
+       // up in the wrong place...
+        cstrconst start = ptr;
+        nat64 n = ObjTokens(ptr,lineEnd);
+        if (n<3) break;
+
+        ptr = start;
+        for (nat64 k=0;k<n;k++)
+        {
+         int64 iv = 0,it = 0,in = 0;
+         str::SkipSpace(ptr,lineEnd);
+         if (!ObjCorner(ptr,lineEnd,iv,it,in)) {ch.bad = true; break;}
+         if ((ptr!=lineEnd)&&(*ptr!=' ')&&(*ptr!='\t')&&(*ptr!='\r')&&(*ptr!='#')) {ch.bad = true; break;}
+        }
+        if (ch.bad) break;
+
+        nat64 first = corners;
+        ptr = start;
+        for (nat64 k=0;k<n;k++)
+        {
+         int64 iv = 0,it = 0,in = 0;
+         ObjCorner(ptr,lineEnd,iv,it,in);
+
+         nat32 c = nat32(corners);
+         cornerV[c] = ObjIndex(iv,v,totalV);
+         if (cornerV[c]==objNone) {ch.bad = true; cornerV[c] = 0;}
+         if (cornerT.Size()!=0)
+         {
+          cornerT[c] = (it==0)?objNone:ObjIndex(it,vt,totalVT);
+          if ((it!=0)&&(cornerT[c]==objNone)) ch.bad = true;
+         }
+         else if (it!=0) ch.bad = true;
+         if (cornerN.Size()!=0)
+         {
+          cornerN[c] = (in==0)?objNone:ObjIndex(in,vn,totalVN);
+          if ((in!=0)&&(cornerN[c]==objNone)) ch.bad = true;
+         }
+         else if (in!=0) ch.bad = true;
+         ++corners;
+
+         if (k>1)
+         {
+          out.SetTri(nat32(tris),nat32(first),nat32(corners-2),nat32(corners-1));
+          ++tris;
+         }
+        }
+      }
+     break;
+    }
+
+    ptr = lineEnd;
+    if (ptr!=end) ++ptr;
+   }
+
+   if (pass==0)
+   {
+    ch.v = v;
+    ch.vt = vt;
+    ch.vn = vn;
+    ch.corners = corners;
+    ch.tris = tris;
+   }
+  }
+};
+
+//------------------------------------------------------------------------------
+EOS_FUNC bit LoadWavefront(cstrconst filename,sur::IndexedMesh & out,time::Progress * prog)
+{
+ LogTime("eos::file::LoadWavefront(IndexedMesh)");
+ prog->Push();
+ out.Clear();
+
+ // Map the file...
+  FileMap * map = new FileMap(filename,false);
+  if (!map->Active())
+  {
+   LogAlways("[wavefront] Could not open file." << LogDiv() << filename);
+   delete map;
+   prog->Pop();
+   return false;
+  }
+  const byte * data = map->Ptr();
+  nat64 size = map->Size();
+
+
+ // Split it into chunks, moving the boundaries to the next line start...
+  ds::Array<ObjChunk> chunk(nat32(math::Min<nat64>(size/objChunkBytes+1,16384)));
+  for (nat32 c=0;c<chunk.Size();c++)
+  {
+   nat64 start = (size*c)/chunk.Size();
+   if (c!=0)
+   {
+    start = math::Max(start,chunk[c-1].start);
+    while ((start<size)&&(data[start-1]!='\n')) ++start;
+   }
+   chunk[c].start = start;
+   chunk[c].bad = false;
+  }
+  for (nat32 c=0;c+1<chunk.Size();c++) chunk[c].end = chunk[c+1].start;
+  chunk[chunk.Size()-1].end = size;
+
+
+ // Count everything, and convert to the totals before each chunk...
+  prog->Report(0,4);
+  ObjLoad ol(data,chunk,out);
+  ol.pass = 0;
+  mt::ParallelFor(nat32(0),chunk.Size(),ol);
+
+  nat64 total[5] = {0,0,0,0,0};
+  for (nat32 c=0;c<chunk.Size();c++)
+  {
+   nat64 * targ[5] = {&chunk[c].v,&chunk[c].vt,&chunk[c].vn,&chunk[c].corners,&chunk[c].tris};
+   for (nat32 i=0;i<5;i++)
+   {
+    nat64 temp = *targ[i];
+    *targ[i] = total[i];
+    total[i] += temp;
+   }
+  }
+
+  for (nat32 i=0;i<5;i++)
+  {
+   if (total[i]>objMaxCount)
+   {
+    LogAlways("[wavefront] Mesh too large." << LogDiv() << filename);
+    delete map;
+    prog->Pop();
+    return false;
+   }
+  }
+
+
+ // Read it all in, with the triangles made of corner indices for now...
+  prog->Report(1,4);
+  ol.totalV = total[0];
+  ol.totalVT = total[1];
+  ol.totalVN = total[2];
+  ol.pos.Size(total[0]*3);
+  ol.uv.Size(total[1]*2);
+  ol.norm.Size(total[2]*3);
+  ol.cornerV.Size(total[3]);
+  ol.cornerT.Size((total[1]!=0)?total[3]:0);
+  ol.cornerN.Size((total[2]!=0)?total[3]:0);
+  out.Setup(0,nat32(total[4]));
+
+  ol.pass = 1;
+  mt::ParallelFor(nat32(0),chunk.Size(),ol);
+  delete map;
+
+  for (nat32 c=0;c<chunk.Size();c++)
+  {
+   if (chunk[c].bad)
+   {
+    LogAlways("[wavefront] Parse error or bad index." << LogDiv() << filename);
+    out.Clear();
+    prog->Pop();
+    return false;
+   }
+  }
+
+
+ // Find the unique corners, with the hash table...
+  prog->Report(2,4);
+  nat32 corners = nat32(total[3]);
+  nat32 slots = 16;
+  while (slots<corners+corners/2) slots *= 2;
+  ol.slot.Size(slots);
+  for (nat32 i=0;i<slots;i++) ol.slot[i].Set(0);
+  ol.mask = slots - 1;
+
+  ol.pass = 2;
+  mt::ParallelFor(nat32(0),corners,ol,4096);
+
+  ol.id.Size(corners);
+  ol.pass = 3;
+  mt::ParallelFor(nat32(0),corners,ol,4096);
+  ol.slot.Size(0);
+
+
+ // Number the vertices, in order of first use, and create them...
+  prog->Report(3,4);
+  ol.block.Size((corners+objBlock-1)/objBlock);
+  ol.pass = 4;
+  mt::ParallelFor(nat32(0),ol.block.Size(),ol);
+
+  nat32 verts = 0;
+  for (nat32 b=0;b<ol.block.Size();b++)
+  {
+   nat32 temp = ol.block[b];
+   ol.block[b] = verts;
+   verts += temp;
+  }
+
+  out.Setup(verts,nat32(total[4]));
+  if (total[1]!=0) out.EnableUV();
+  if (total[2]!=0) out.EnableNormals();
+
+  ol.pass = 5;
+  mt::ParallelFor(nat32(0),ol.block.Size(),ol);
+  ol.pass = 6;
+  mt::ParallelFor(nat32(0),corners,ol,4096);
+  ol.pass = 7;
+  mt::ParallelFor(nat32(0),out.TriCount(),ol,4096);
+
+
+ out.BuildAdjacency();
+ prog->Pop();
+ return true;
+}
+
 //------------------------------------------------------------------------------
  };
 };
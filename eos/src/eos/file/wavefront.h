@@ -29,6 +29,11 @@
 
 namespace eos
 {
+ namespace sur
+ {
+  class EOS_CLASS IndexedMesh;
+ };
+
  namespace file
  {
 //------------------------------------------------------------------------------
@@ -105,6 +110,18 @@ class EOS_CLASS Wavefront
   ds::List<Corner> surface;
 };
 
+//------------------------------------------------------------------------------
+/// Fast wavefront loader, straight into an IndexedMesh, for big files. Memory
+/// maps the file and parses it in parallel chunks of lines. Loads v, vt and vn
+/// lines and faces, ignoring everything else; faces with more than 3 sides are
+/// fanned out and those with less dropped. A vertex is made for each unique
+/// combination of position, uv and normal used by a face corner, in the order
+/// they are first used, so unused positions are dropped. If the file has uv's
+/// or normals the mesh gets them, zero for corners that don't give one.
+/// Returns false on error, which is logged, including for bad indices.
+EOS_FUNC bit LoadWavefront(cstrconst filename,sur::IndexedMesh & out,
+                           time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
  };
 };
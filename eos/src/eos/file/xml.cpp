@@ -18,45 +18,347 @@
 #include "eos/file/xml.h"
 
 #include "eos/file/csv.h"
+#include "eos/ds/arrays.h"
 
 namespace eos
 {
  namespace file
  {
 //------------------------------------------------------------------------------
-EOS_FUNC bs::Element * LoadXML(str::TokenTable & tokTab,cstrconst filename)
+void XmlStr::Decode(str::String & out) const
 {
- File<io::Text> file(filename,way_edit,mode_read);
- if (!file.Active()) return null<bs::Element*>();
- Cursor<io::Text> cursor = file.GetCursor();
-
- io::VirtIn< Cursor<io::Text> > in(cursor);
- io::TextParser<io::InVirt<io::Text>,256> tp(in);   
- tp.CommentTypes(false,false,true);	  
+ cstrconst end = ptr + size;
+ cstrconst base = ptr;
+ cstrconst targ = ptr;
+ while (targ<end)
+ {
+  if (*targ!='&') {++targ; continue;}
+  
+  cstrconst semi = targ+1;
+  while ((semi<end)&&(*semi!=';')) ++semi;
+  if (semi==end) break;
+  
+  out.Write(base,targ-base);
+  
+  cstrchar c = '?';
+  cstrconst code = targ+1;
+  nat32 len = semi - code;
+  if ((len>0)&&(code[0]=='#'))
+  {
+   nat32 num = 0;
+   if ((len>1)&&(code[1]=='x'))
+   {
+    for (cstrconst h=code+2;h<semi;h++)
+    {
+     num *= 16;
+     if ((*h>='A')&&(*h<='F')) num += *h - 'A' + 10;
+     else if ((*h>='a')&&(*h<='f')) num += *h - 'a' + 10;
+     else num += *h - '0';
+    }
+   }
+   else
+   {
+    for (cstrconst d=code+1;d<semi;d++) num = num*10 + (*d - '0');
+   }
+   c = cstrchar(byte(num));
+  }
+  else
+  {
+   XmlStr name(code,len);
+   if (name=="quot") c = '\"';
+   else if (name=="apos") c = '\'';
+   else if (name=="amp") c = '&';
+   else if (name=="lt") c = '<';
+   else if (name=="gt") c = '>';
+  }
+  out.Write(&c,1);
   
- bs::Element * ret = new bs::Element(tokTab,str::NullToken);
+  targ = semi + 1;
+  base = targ;
+ }
+ out.Write(base,end-base);
+}
+
+//------------------------------------------------------------------------------
+// Helpers for ParseXML...
+static inline bit XmlSpace(cstrchar c)
+{
+ return (c==' ')||(c=='\t')||(c=='\n')||(c=='\r');
+}
+
+static inline cstrconst XmlSkipSpace(cstrconst p,cstrconst end)
+{
+ while ((p<end)&&XmlSpace(*p)) ++p;
+ return p;
+}
+
+// Returns the end of a name, which stops at white space or any of the given
+// characters...
+static inline cstrconst XmlName(cstrconst p,cstrconst end,cstrchar a,cstrchar b,cstrchar c)
+{
+ while ((p<end)&&(!XmlSpace(*p))&&(*p!=a)&&(*p!=b)&&(*p!=c)) ++p;
+ return p;
+}
+
+// Returns the position after the given terminator, or null if the zone ends
+// without it...
+static cstrconst XmlFind(cstrconst p,cstrconst end,cstrconst term)
+{
+ nat32 len = str::Length(term);
+ while (p+len<=end)
+ {
+  if (mem::Compare(p,term,len)==0) return p + len;
+  ++p;
+ }
+ return null<cstrconst>();
+}
+
+static inline bit XmlSame(const XmlStr & a,const XmlStr & b)
+{
+ return (a.Size()==b.Size())&&(mem::Compare(a.Ptr(),b.Ptr(),a.Size())==0);
+}
+
+EOS_FUNC bit ParseXML(cstrconst data,nat32 size,XmlHandler & handler)
+{
+ cstrconst p = data;
+ cstrconst end = data + size;
+ 
+ ds::Array<XmlStr> stack(16); // Names of the currently open elements.
+ nat32 depth = 0;
+ 
  while (true)
  {
-  tp.InvSkip("<");
-  if (ret->ReadText(tp,false,tokTab("content.start"),tokTab("content.post")))
+  // Text upto the next tag...
+  {
+   cstrconst start = p;
+   bit escaped = false;
+   while ((p<end)&&(*p!='<'))
+   {
+    if (*p=='&') escaped = true;
+    ++p;
+   }
+   if (p!=start)
+   {
+    if (!handler.Text(XmlStr(start,p-start,escaped))) return true;
+   }
+   if (p==end) return depth==0;
+  }
+  
+  ++p;
+  if (p==end) return false;
+  
+  switch (*p)
   {
-   if (tp.Peek()=='?')
+   case '?': // Processing instruction...
    {
-    tp.Next();
-    // We have bumped into a <? ... ?> statement - skip it and try again...
-     while (true)
+    p = XmlFind(p,end,"?>");
+    if (p==null<cstrconst>()) return false;
+   }
+   break;
+   
+   case '!': // Comment, CDATA or declaration...
+   {
+    if ((end-p>=3)&&(mem::Compare(p,"!--",3)==0))
+    {
+     p = XmlFind(p+3,end,"-->");
+     if (p==null<cstrconst>()) return false;
+    }
+    else if ((end-p>=8)&&(mem::Compare(p,"![CDATA[",8)==0))
+    {
+     cstrconst start = p + 8;
+     p = XmlFind(start,end,"]]>");
+     if (p==null<cstrconst>()) return false;
+     if (!handler.Text(XmlStr(start,(p-3)-start))) return true;
+    }
+    else
+    {
+     // Declaration, which can contain a [...] block...
+      nat32 brackets = 0;
+      while ((p<end)&&((*p!='>')||(brackets!=0)))
+      {
+       if (*p=='[') ++brackets;
+       else if ((*p==']')&&(brackets!=0)) --brackets;
+       ++p;
+      }
+      if (p==end) return false;
+      ++p;
+    }
+   }
+   break;
+   
+   case '/': // Closing tag...
+   {
+    cstrconst start = p + 1;
+    p = XmlName(start,end,'>','>','>');
+    XmlStr name(start,p-start);
+    p = XmlSkipSpace(p,end);
+    if ((p==end)||(*p!='>')) return false;
+    ++p;
+    
+    if ((depth==0)||(!XmlSame(stack[depth-1],name))) return false;
+    --depth;
+    if (!handler.Close(name)) return true;
+   }
+   break;
+   
+   default: // Opening tag...
+   {
+    cstrconst start = p;
+    p = XmlName(start,end,'/','>','>');
+    if (p==start) return false;
+    XmlStr name(start,p-start);
+    if (!handler.Open(name)) return true;
+    
+    while (true)
+    {
+     p = XmlSkipSpace(p,end);
+     if (p==end) return false;
+     
+     if (*p=='/')
      {
-      tp.InvSkip("?");
-      if (tp.Next()!='?') {delete ret; return null<bs::Element*>();}
-      if (tp.Peek()=='>') {tp.Next(); break;}
+      ++p;
+      if ((p==end)||(*p!='>')) return false;
+      ++p;
+      if (!handler.Close(name)) return true;
+      break;
      }
-   } 
-   else {delete ret; return null<bs::Element*>();}
+     
+     if (*p=='>')
+     {
+      ++p;
+      if (depth==stack.Size()) stack.Size(depth*2);
+      stack[depth] = name;
+      ++depth;
+      break;
+     }
+     
+     // An attribute...
+      cstrconst attrStart = p;
+      p = XmlName(p,end,'=','/','>');
+      XmlStr attrName(attrStart,p-attrStart);
+      p = XmlSkipSpace(p,end);
+      if ((p==end)||(*p!='=')) return false;
+      p = XmlSkipSpace(p+1,end);
+      if ((p==end)||((*p!='\"')&&(*p!='\''))) return false;
+      
+      cstrchar quote = *p;
+      cstrconst valStart = ++p;
+      bit escaped = false;
+      while ((p<end)&&(*p!=quote))
+      {
+       if (*p=='&') escaped = true;
+       ++p;
+      }
+      if (p==end) return false;
+      XmlStr value(valStart,p-valStart,escaped);
+      ++p;
+      
+      if (!handler.Attribute(attrName,value)) return true;
+    }
+   }
+   break;
   }
-  else return ret;
  }
 }
 
+EOS_FUNC bit ParseXML(cstrconst filename,XmlHandler & handler)
+{
+ FileMap map(filename,true);
+ if (!map.Active()) return false;
+ if (map.Size()>nat64(0xFFFFFFFF)) return false;
+ 
+ return ParseXML((cstrconst)map.Ptr(),nat32(map.Size()),handler);
+}
+
+//------------------------------------------------------------------------------
+// Builds a dom from the ParseXML callbacks. Text goes into the content.start
+// attribute of the current element if it has no children yet, otherwise into
+// the content.post of its last child. Stops once the root closes, so anything
+// after it is ignored...
+class DomBuilder : public XmlHandler
+{
+ public:
+  DomBuilder(str::TokenTable & tt)
+  :tokTab(tt),start(tt("content.start")),post(tt("content.post")),
+  root(null<bs::Element*>()),current(null<bs::Element*>()),done(false)
+  {}
+  
+  ~DomBuilder() {delete root;}
+  
+  // Returns the dom if it was completed, passing ownership...
+   bs::Element * Result()
+   {
+    if (!done) return null<bs::Element*>();
+    bs::Element * ret = root;
+    root = null<bs::Element*>();
+    return ret;
+   }
+   
+  
+  bit Open(const XmlStr & name)
+  {
+   Store();
+   bs::Element * e = new bs::Element(tokTab,name.Token(tokTab));
+   if (current) current->AppendChild(e);
+           else root = e;
+   current = e;
+   return true;
+  }
+  
+  bit Attribute(const XmlStr & name,const XmlStr & value)
+  {
+   bs::Attribute * a = new bs::Attribute(name.Token(tokTab));
+   value.Decode(a->EditString());
+   current->AppendAttribute(a);
+   return true;
+  }
+  
+  bit Text(const XmlStr & t)
+  {
+   if (current) t.Decode(text);
+   return true;
+  }
+  
+  bit Close(const XmlStr & name)
+  {
+   Store();
+   current = current->Parent();
+   if (current==null<bs::Element*>())
+   {
+    done = true;
+    return false;
+   }
+   return true;
+  }
+
+
+ private:
+  str::TokenTable & tokTab;
+  str::Token start;
+  str::Token post;
+  
+  bs::Element * root;
+  bs::Element * current;
+  bit done;
+  
+  str::String text; // Text waiting to be stored, as it can arrive in pieces.
+  
+  void Store()
+  {
+   if (text.Size()==0) return;
+   if (current->Front()==current->Bad()) current->SetAttribute(start,text);
+                                    else current->Back()->SetAttribute(post,text);
+   text.SetSize(0);
+  }
+};
+
+EOS_FUNC bs::Element * LoadXML(str::TokenTable & tokTab,cstrconst filename)
+{
+ DomBuilder builder(tokTab);
+ ParseXML(filename,builder);
+ return builder.Result();
+}
+
 EOS_FUNC bs::Element * LoadXML(str::TokenTable & tokTab,const str::String & filename)
 {
  cstr fn = filename.ToStr();
@@ -65,6 +367,13 @@ EOS_FUNC bs::Element * LoadXML(str::TokenTable & tokTab,const str::String & file
  return ret;
 }
 
+EOS_FUNC bs::Element * LoadXML(str::TokenTable & tokTab,cstrconst data,nat32 size)
+{
+ DomBuilder builder(tokTab);
+ ParseXML(data,size,builder);
+ return builder.Result();
+}
+
 
 EOS_FUNC bit SaveXML(bs::Element * root,cstrconst filename,bit overwrite)
 {
@@ -19,9 +19,9 @@
 
 
 /// \file xml.h
-/// Provides routines for loading and saving xml files. Simple really. (Dosn't
-/// actually do anything, the dom provides all the actual code, this is just a
-/// nice wrapper.)
+/// Provides routines for loading and saving xml files. Loading into a dom is
+/// built on a streaming parser, which can also be used directly, for when only
+/// a few elements of a large file are wanted.
 
 #include "eos/types.h"
 #include "eos/file/files.h"
@@ -32,6 +32,99 @@ namespace eos
 {
  namespace file
  {
+//------------------------------------------------------------------------------
+/// A view of a piece of an xml document, as given to an XmlHandler. Points
+/// straight into the document, so is only valid during the callback it was
+/// given to. Text and attribute values are raw, i.e. escape codes such as &amp;
+/// are still in there - use Decode to get the actual string.
+class EOS_CLASS XmlStr
+{
+ public:
+  /// &nbsp;
+   XmlStr():ptr(null<cstrconst>()),size(0),escaped(false) {}
+
+  /// &nbsp;
+   XmlStr(cstrconst p,nat32 s,bit e = false):ptr(p),size(s),escaped(e) {}
+
+
+  /// Start of the raw characters, which are not null terminated.
+   cstrconst Ptr() const {return ptr;}
+
+  /// Number of raw characters.
+   nat32 Size() const {return size;}
+
+  /// true if it contains escape codes, i.e. Decode will not simply copy it.
+   bit Escaped() const {return escaped;}
+
+
+  /// Compares the raw characters with a null terminated string.
+   bit operator == (cstrconst rhs) const
+   {
+    for (nat32 i=0;i<size;i++)
+    {
+     if (rhs[i]!=ptr[i]) return false;
+    }
+    return rhs[size]==0;
+   }
+
+  /// &nbsp;
+   bit operator != (cstrconst rhs) const {return !(*this==rhs);}
+
+  /// Returns the raw characters as a token.
+   str::Token Token(str::TokenTable & tokTab) const {return tokTab(size,ptr);}
+
+  /// Appends the string to out, with escape codes converted, in the same way
+  /// as io::TextParser::ReadString.
+   void Decode(str::String & out) const;
+
+
+ private:
+  cstrconst ptr;
+  nat32 size;
+  bit escaped;
+};
+
+//------------------------------------------------------------------------------
+/// The interface for receiving the contents of an xml document from ParseXML,
+/// in document order. Every method returns true to continue, false to stop
+/// parsing there and then. The defaults do nothing, so you only need to
+/// override the ones you care about.
+class EOS_CLASS XmlHandler
+{
+ public:
+  /// &nbsp;
+   virtual ~XmlHandler() {}
+
+
+  /// Called for each opening tag.
+   virtual bit Open(const XmlStr & name) {return true;}
+
+  /// Called for each attribute of the element last opened, before any of its
+  /// contents.
+   virtual bit Attribute(const XmlStr & name,const XmlStr & value) {return true;}
+
+  /// Called for the text between tags, outside the root as well. Text may be
+  /// split between several calls, e.g. either side of a comment, and CDATA
+  /// sections arrive as text that is not Escaped.
+   virtual bit Text(const XmlStr & text) {return true;}
+
+  /// Called for each closing tag, including for <.../> style elements, in
+  /// which case it follows straight after the attributes.
+   virtual bit Close(const XmlStr & name) {return true;}
+};
+
+/// Parses an xml document held in memory, passing its contents to the given
+/// handler. Processing instructions, comments and doctype declarations are
+/// skipped. Returns false if the document is malformed, including when tags
+/// are not correctly nested, true if it gets to the end or the handler asks
+/// it to stop.
+EOS_FUNC bit ParseXML(cstrconst data,nat32 size,XmlHandler & handler);
+
+/// Memory maps the given file and parses it, as for the other ParseXML. Nothing
+/// is read that the handler does not get to, so stopping early means the
+/// rest of the file is never loaded. Returns false if it can't open the file.
+EOS_FUNC bit ParseXML(cstrconst filename,XmlHandler & handler);
+
 //------------------------------------------------------------------------------
 /// Loads an XML file, returns the root element if it works or null otherwise.
 /// You get no information about the error. You must call delete on the Element
@@ -44,6 +137,10 @@ EOS_FUNC bs::Element * LoadXML(str::TokenTable & tokTab,cstrconst filename);
 EOS_FUNC bs::Element * LoadXML(str::TokenTable & tokTab,const str::String & filename);
 
 
+/// Identical to LoadXML, except it parses an xml document held in memory, as
+/// for ParseXML, e.g. one received over a network.
+EOS_FUNC bs::Element * LoadXML(str::TokenTable & tokTab,cstrconst data,nat32 size);
+
 /// Saves an XMl file, blah.
 /// \param root The root of the tree to save.
 /// \param filename The filename to save to.
@@ -0,0 +1,67 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/file/zlib_funcs.h"
+
+#include "eos/file/dlls.h"
+#include "eos/mt/locks.h"
+
+namespace eos
+{
+ namespace file
+ {
+//------------------------------------------------------------------------------
+// The functions...
+EOS_VAR_DEF zBoundFunc      zCompressBound;
+EOS_VAR_DEF zCompressFunc   zCompress2;
+EOS_VAR_DEF zUncompressFunc zUncompress;
+
+
+EOS_FUNC bit ZlibActive()
+{
+ static mt::OwnedLock lock;
+ mt::AutoLock al(lock);
+
+ if (zUncompress) return true;
+ 
+ Dll zlib;
+ #ifdef EOS_LINUX
+  // Runtime only installs just have the real soname...
+   zlib.Load("z");
+   if (!zlib.Active()) zlib.LoadPath("libz.so.1");
+ #else
+  zlib.Load("zlib1");
+ #endif
+ if (!zlib.Active()) return false;
+
+ zCompressBound = (zBoundFunc)zlib.Get("compressBound");
+ zCompress2 = (zCompressFunc)zlib.Get("compress2");
+ zUncompress = (zUncompressFunc)zlib.Get("uncompress");
+
+ if ((zCompressBound==0)||(zCompress2==0)||(zUncompress==0))
+ {
+  zUncompress = 0;
+  return false;
+ }
+
+ zlib.UnloadKeep();
+ return true;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,57 @@
+#ifndef EOS_FILE_ZLIB_FUNCS_H
+#define EOS_FILE_ZLIB_FUNCS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file zlib_funcs.h
+/// Provides access to the zlib library, for compression. Loaded at runtime,
+/// in the same way as DevIL, so it is only needed if actually used.
+
+#include "eos/types.h"
+
+namespace eos
+{
+ namespace file
+ {
+//------------------------------------------------------------------------------
+// Types for all the functions loaded, these match the zlib1.dll/libz.so
+// calling convention, which is not stdcall...
+typedef unsigned long (*zBoundFunc)(unsigned long);
+typedef int (*zCompressFunc)(unsigned char *,unsigned long *,const unsigned char *,unsigned long,int);
+typedef int (*zUncompressFunc)(unsigned char *,unsigned long *,const unsigned char *,unsigned long);
+
+
+// The functions...
+EOS_VAR zBoundFunc      zCompressBound;
+EOS_VAR zCompressFunc   zCompress2;
+EOS_VAR zUncompressFunc zUncompress;
+
+// Constants...
+static const int ZLIB_OK = 0;
+static const int ZLIB_DEFAULT_COMPRESSION = -1;
+
+
+// Call before use, returns true if you can use the library, false if it hasn't loaded. 
+// After it has been called and returns true it will continue to return true.
+// Safe to call from multiple threads.
+EOS_FUNC bit ZlibActive();
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
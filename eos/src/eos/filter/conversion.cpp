@@ -18,11 +18,336 @@
 #include "eos/filter/conversion.h"
 
 #include "eos/str/tokens.h"
+#include "eos/math/functions.h"
+#include "eos/mem/alloc.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#elif defined(__SSE__)
+ #include <xmmintrin.h>
+#endif
 
 namespace eos
 {
  namespace filter
  {
+//------------------------------------------------------------------------------
+// The Luv conversion engine. Each row is unpacked into three channel planes so
+// the matrix multiplies and divisions can be done four pixels at a time, with
+// the cube root replaced by a table of l against y which is linearly
+// interpolated. Rows are spread over the thread pool...
+
+// The white point, as used by bs::ColourLuv and bs::ColourXYZ...
+static const real32 luvU0 = (4.0*0.950467)/(0.950467 + 15.0*0.9999996 + 3.0*1.088969);
+static const real32 luvV0 = (9.0)/(0.950467 + 15.0*0.9999996 + 3.0*1.088969);
+
+// The tables, filled in at load time. l is indexed by y*size, for y in [0,1],
+// with a repeat of the last entry so interpolation of y==1 stays in bounds...
+class LuvTable
+{
+ public:
+  static const nat32 size = 4096;
+
+  LuvTable()
+  {
+   for (nat32 i=0;i<=size;i++)
+   {
+    real32 yr = real32(i)/real32(size);
+    l[i] = (yr>(216.0/24389.0))?(116.0*math::Pow(yr,real32(1.0/3.0)) - 16.0):(yr*24389.0/27.0);
+   }
+   l[size+1] = l[size];
+
+   for (nat32 i=0;i<256;i++) byteToReal[i] = real32(i)/255.0;
+  }
+
+  real32 l[size+2];
+  real32 byteToReal[256];
+};
+
+static LuvTable luvTable;
+
+// Converts n pixels, given and returned as planes, n a multiple of 4 when SSE2
+// is avaliable. Pixels with y outside [0,1] are out of the tables range, so go
+// through the exact conversion instead...
+static void RowToLuv(const real32 * r,const real32 * g,const real32 * b,real32 * l,real32 * u,real32 * v,nat32 n)
+{
+ nat32 i = 0;
+ #ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0);
+  const __m128 scale = _mm_set1_ps(real32(LuvTable::size)/0.9999996);
+  const __m128 top = _mm_set1_ps(real32(LuvTable::size));
+  const __m128 u0 = _mm_set1_ps(luvU0);
+  const __m128 v0 = _mm_set1_ps(luvV0);
+  int32 ind[4] __attribute__((aligned(16)));
+
+  for (;i<n;i+=4)
+  {
+   __m128 rr = _mm_load_ps(r+i);
+   __m128 gg = _mm_load_ps(g+i);
+   __m128 bb = _mm_load_ps(b+i);
+
+   __m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rr,_mm_set1_ps(0.412424)),_mm_mul_ps(gg,_mm_set1_ps(0.357579))),_mm_mul_ps(bb,_mm_set1_ps(0.180464)));
+   __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rr,_mm_set1_ps(0.212656)),_mm_mul_ps(gg,_mm_set1_ps(0.715158))),_mm_mul_ps(bb,_mm_set1_ps(0.0721856)));
+   __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rr,_mm_set1_ps(0.0193324)),_mm_mul_ps(gg,_mm_set1_ps(0.119193))),_mm_mul_ps(bb,_mm_set1_ps(0.950444)));
+
+   __m128 div = _mm_add_ps(_mm_add_ps(x,_mm_mul_ps(y,_mm_set1_ps(15.0))),_mm_mul_ps(z,_mm_set1_ps(3.0)));
+   __m128 valid = _mm_cmpneq_ps(div,zero);
+   __m128 inv = _mm_div_ps(one,_mm_or_ps(_mm_and_ps(valid,div),_mm_andnot_ps(valid,one)));
+
+   // Table lookup for l...
+    __m128 t = _mm_mul_ps(y,scale);
+    __m128 outside = _mm_or_ps(_mm_cmplt_ps(t,zero),_mm_cmpgt_ps(t,top));
+    t = _mm_min_ps(_mm_max_ps(t,zero),top);
+    __m128i ti = _mm_cvttps_epi32(t);
+    __m128 frac = _mm_sub_ps(t,_mm_cvtepi32_ps(ti));
+    _mm_store_si128((__m128i*)(void*)ind,ti);
+
+    __m128 lo = _mm_setr_ps(luvTable.l[ind[0]],luvTable.l[ind[1]],luvTable.l[ind[2]],luvTable.l[ind[3]]);
+    __m128 hi = _mm_setr_ps(luvTable.l[ind[0]+1],luvTable.l[ind[1]+1],luvTable.l[ind[2]+1],luvTable.l[ind[3]+1]);
+    __m128 ll = _mm_add_ps(lo,_mm_mul_ps(frac,_mm_sub_ps(hi,lo)));
+
+   __m128 ud = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(x,_mm_set1_ps(4.0)),inv),u0);
+   __m128 vd = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(y,_mm_set1_ps(9.0)),inv),v0);
+   __m128 l13 = _mm_mul_ps(ll,_mm_set1_ps(13.0));
+
+   _mm_store_ps(l+i,_mm_and_ps(valid,ll));
+   _mm_store_ps(u+i,_mm_and_ps(valid,_mm_mul_ps(l13,ud)));
+   _mm_store_ps(v+i,_mm_and_ps(valid,_mm_mul_ps(l13,vd)));
+
+   nat32 fix = _mm_movemask_ps(_mm_and_ps(valid,outside));
+   while (fix)
+   {
+    nat32 j = i + __builtin_ctz(fix);
+    bs::ColourLuv luv = bs::ColourRGB(r[j],g[j],b[j]);
+    l[j] = luv.l; u[j] = luv.u; v[j] = luv.v;
+    fix &= fix-1;
+   }
+  }
+ #endif
+
+ for (;i<n;i++)
+ {
+  real32 x = r[i]*0.412424 + g[i]*0.357579 + b[i]*0.180464;
+  real32 y = r[i]*0.212656 + g[i]*0.715158 + b[i]*0.0721856;
+  real32 z = r[i]*0.0193324 + g[i]*0.119193 + b[i]*0.950444;
+  real32 div = x + 15.0*y + 3.0*z;
+
+  real32 t = y*(real32(LuvTable::size)/0.9999996);
+  if (math::IsZero(div))
+  {
+   l[i] = 0.0; u[i] = 0.0; v[i] = 0.0;
+  }
+  else if ((t<0.0)||(t>real32(LuvTable::size)))
+  {
+   bs::ColourLuv luv = bs::ColourRGB(r[i],g[i],b[i]);
+   l[i] = luv.l; u[i] = luv.u; v[i] = luv.v;
+  }
+  else
+  {
+   nat32 ti = nat32(t);
+   real32 frac = t - real32(ti);
+   l[i] = luvTable.l[ti] + frac*(luvTable.l[ti+1] - luvTable.l[ti]);
+   u[i] = 13.0*l[i]*((4.0*x)/div - luvU0);
+   v[i] = 13.0*l[i]*((9.0*y)/div - luvV0);
+  }
+ }
+}
+
+// The inverse, no table required as the cube root becomes a cube...
+static void RowToRGB(const real32 * l,const real32 * u,const real32 * v,real32 * r,real32 * g,real32 * b,nat32 n)
+{
+ nat32 i = 0;
+ #ifdef __SSE__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0);
+  const __m128 third = _mm_set1_ps(1.0/3.0);
+
+  for (;i<n;i+=4)
+  {
+   __m128 ll = _mm_load_ps(l+i);
+   __m128 uu = _mm_load_ps(u+i);
+   __m128 vv = _mm_load_ps(v+i);
+   __m128 valid = _mm_cmpneq_ps(ll,zero);
+
+   __m128 c = _mm_mul_ps(_mm_add_ps(ll,_mm_set1_ps(16.0)),_mm_set1_ps(1.0/116.0));
+   __m128 curve = _mm_cmpgt_ps(ll,_mm_set1_ps(8.0));
+   __m128 y = _mm_or_ps(_mm_and_ps(curve,_mm_mul_ps(_mm_mul_ps(c,c),c)),
+                        _mm_andnot_ps(curve,_mm_mul_ps(ll,_mm_set1_ps(27.0/24389.0))));
+
+   __m128 l13 = _mm_mul_ps(ll,_mm_set1_ps(13.0));
+   __m128 ud = _mm_add_ps(uu,_mm_mul_ps(l13,_mm_set1_ps(luvU0)));
+   __m128 vd = _mm_add_ps(vv,_mm_mul_ps(l13,_mm_set1_ps(luvV0)));
+   __m128 a = _mm_mul_ps(third,_mm_sub_ps(_mm_div_ps(_mm_mul_ps(ll,_mm_set1_ps(52.0)),ud),one));
+   __m128 y5 = _mm_mul_ps(y,_mm_set1_ps(5.0));
+   __m128 d = _mm_sub_ps(_mm_mul_ps(y,_mm_div_ps(_mm_mul_ps(ll,_mm_set1_ps(39.0)),vd)),y5);
+
+   __m128 x = _mm_div_ps(_mm_add_ps(d,y5),_mm_add_ps(a,third));
+   __m128 z = _mm_sub_ps(_mm_mul_ps(x,a),y5);
+   x = _mm_and_ps(valid,x);
+   y = _mm_and_ps(valid,y);
+   z = _mm_and_ps(valid,z);
+
+   _mm_store_ps(r+i,_mm_add_ps(_mm_add_ps(_mm_mul_ps(x,_mm_set1_ps(3.24071)),_mm_mul_ps(y,_mm_set1_ps(-1.53726))),_mm_mul_ps(z,_mm_set1_ps(-0.498571))));
+   _mm_store_ps(g+i,_mm_add_ps(_mm_add_ps(_mm_mul_ps(x,_mm_set1_ps(-0.969258)),_mm_mul_ps(y,_mm_set1_ps(1.87599))),_mm_mul_ps(z,_mm_set1_ps(0.0415557))));
+   _mm_store_ps(b+i,_mm_add_ps(_mm_add_ps(_mm_mul_ps(x,_mm_set1_ps(0.0556352)),_mm_mul_ps(y,_mm_set1_ps(-0.203996))),_mm_mul_ps(z,_mm_set1_ps(1.05707))));
+  }
+ #endif
+
+ for (;i<n;i++)
+ {
+  bs::ColourRGB rgb = bs::ColourLuv(l[i],u[i],v[i]);
+  r[i] = rgb.r; g[i] = rgb.g; b[i] = rgb.b;
+ }
+}
+
+// Row unpacking and packing...
+static inline void Unpack(const svt::Field<bs::ColourRGB> & in,nat32 y,real32 * c0,real32 * c1,real32 * c2)
+{
+ for (nat32 x=0;x<in.Size(0);x++)
+ {
+  const bs::ColourRGB & p = in.Get(x,y);
+  c0[x] = p.r; c1[x] = p.g; c2[x] = p.b;
+ }
+}
+
+static inline void Unpack(const svt::Field<bs::ColRGB> & in,nat32 y,real32 * c0,real32 * c1,real32 * c2)
+{
+ for (nat32 x=0;x<in.Size(0);x++)
+ {
+  const bs::ColRGB & p = in.Get(x,y);
+  c0[x] = luvTable.byteToReal[p.r]; c1[x] = luvTable.byteToReal[p.g]; c2[x] = luvTable.byteToReal[p.b];
+ }
+}
+
+static inline void Unpack(const svt::Field<bs::ColourLuv> & in,nat32 y,real32 * c0,real32 * c1,real32 * c2)
+{
+ for (nat32 x=0;x<in.Size(0);x++)
+ {
+  const bs::ColourLuv & p = in.Get(x,y);
+  c0[x] = p.l; c1[x] = p.u; c2[x] = p.v;
+ }
+}
+
+static inline void Unpack(const svt::Field<bs::ColourRGBh> & in,nat32 y,real32 * c0,real32 * c1,real32 * c2)
+{
+ for (nat32 x=0;x<in.Size(0);x++)
+ {
+  const bs::ColourRGBh & p = in.Get(x,y);
+  c0[x] = p.r; c1[x] = p.g; c2[x] = p.b;
+ }
+}
+
+static inline void Unpack(const svt::Field<bs::ColourLuvh> & in,nat32 y,real32 * c0,real32 * c1,real32 * c2)
+{
+ for (nat32 x=0;x<in.Size(0);x++)
+ {
+  const bs::ColourLuvh & p = in.Get(x,y);
+  c0[x] = p.l; c1[x] = p.u; c2[x] = p.v;
+ }
+}
+
+static inline void Pack(svt::Field<bs::ColourLuv> & out,nat32 y,const real32 * c0,const real32 * c1,const real32 * c2)
+{
+ for (nat32 x=0;x<out.Size(0);x++)
+ {
+  bs::ColourLuv & p = out.Get(x,y);
+  p.l = c0[x]; p.u = c1[x]; p.v = c2[x];
+ }
+}
+
+static inline void Pack(svt::Field<bs::ColourRGB> & out,nat32 y,const real32 * c0,const real32 * c1,const real32 * c2)
+{
+ for (nat32 x=0;x<out.Size(0);x++)
+ {
+  bs::ColourRGB & p = out.Get(x,y);
+  p.r = c0[x]; p.g = c1[x]; p.b = c2[x];
+ }
+}
+
+static inline void Pack(svt::Field<bs::ColourLuvh> & out,nat32 y,const real32 * c0,const real32 * c1,const real32 * c2)
+{
+ for (nat32 x=0;x<out.Size(0);x++)
+ {
+  bs::ColourLuvh & p = out.Get(x,y);
+  p.l = c0[x]; p.u = c1[x]; p.v = c2[x];
+ }
+}
+
+static inline void Pack(svt::Field<bs::ColourRGBh> & out,nat32 y,const real32 * c0,const real32 * c1,const real32 * c2)
+{
+ for (nat32 x=0;x<out.Size(0);x++)
+ {
+  bs::ColourRGBh & p = out.Get(x,y);
+  p.r = c0[x]; p.g = c1[x]; p.b = c2[x];
+ }
+}
+
+// An interleaved 8 bit rgb image in memory, as a source for the below...
+struct ByteRows
+{
+ const byte * data;
+ nat32 stride;
+};
+
+static inline void Unpack(const ByteRows & in,nat32 y,real32 * c0,real32 * c1,real32 * c2,nat32 width)
+{
+ const byte * p = in.data + y*in.stride;
+ for (nat32 x=0;x<width;x++)
+ {
+  c0[x] = luvTable.byteToReal[p[0]]; c1[x] = luvTable.byteToReal[p[1]]; c2[x] = luvTable.byteToReal[p[2]];
+  p += 3;
+ }
+}
+
+template <typename T>
+static inline void Unpack(const svt::Field<T> & in,nat32 y,real32 * c0,real32 * c1,real32 * c2,nat32)
+{
+ Unpack(in,y,c0,c1,c2);
+}
+
+// The threaded driver, IN the source, a Field or ByteRows, OUT the output
+// field type, and row the conversion...
+typedef void (*RowConversion)(const real32*,const real32*,const real32*,real32*,real32*,real32*,nat32);
+
+template <typename IN,typename OUT>
+class ConvertRows
+{
+ public:
+  ConvertRows(const IN & i,svt::Field<OUT> & o,RowConversion r)
+  :in(i),out(o),row(r),stride((o.Size(0)+3)&~nat32(3))
+  {}
+
+  void Run()
+  {
+   mt::ParallelFor(0,out.Size(1),*this,8);
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   // Six planes, with the padding zeroed so the vector loop can run over it...
+    real32 * buf = mem::AlignedMalloc<real32>(stride*6,16);
+    for (nat32 i=0;i<stride*6;i++) buf[i] = 0.0;
+
+   for (nat32 y=begin;y<end;y++)
+   {
+    Unpack(in,y,buf,buf+stride,buf+stride*2,out.Size(0));
+    row(buf,buf+stride,buf+stride*2,buf+stride*3,buf+stride*4,buf+stride*5,stride);
+    Pack(out,y,buf+stride*3,buf+stride*4,buf+stride*5);
+   }
+
+   mem::AlignedFree(buf);
+  }
+
+
+ private:
+  const IN & in;
+  svt::Field<OUT> & out;
+  RowConversion row;
+  nat32 stride;
+};
+
 //------------------------------------------------------------------------------
 EOS_FUNC void LtoRGB(const svt::Field<bs::ColourL> & l,svt::Field<bs::ColourRGB> & rgb)
 {
@@ -48,13 +373,20 @@ EOS_FUNC void RGBtoL(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::Colour
 
 EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::ColourLuv> & luv)
 {
- for (nat32 y=0;y<luv.Size(1);y++)
- {
-  for (nat32 x=0;x<luv.Size(0);x++)
-  {
-   luv.Get(x,y) = rgb.Get(x,y);
-  }
- }
+ ConvertRows<svt::Field<bs::ColourRGB>,bs::ColourLuv> conv(rgb,luv,RowToLuv);
+ conv.Run();
+}
+
+EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColRGB> & rgb,svt::Field<bs::ColourLuv> & luv)
+{
+ ConvertRows<svt::Field<bs::ColRGB>,bs::ColourLuv> conv(rgb,luv,RowToLuv);
+ conv.Run();
+}
+
+EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColourRGBh> & rgb,svt::Field<bs::ColourLuvh> & luv)
+{
+ ConvertRows<svt::Field<bs::ColourRGBh>,bs::ColourLuvh> conv(rgb,luv,RowToLuv);
+ conv.Run();
 }
 
 EOS_FUNC void LuvtoL(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::ColourL> & l)
@@ -70,13 +402,14 @@ EOS_FUNC void LuvtoL(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::Colour
 
 EOS_FUNC void LuvtoRGB(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::ColourRGB> & rgb)
 {
- for (nat32 y=0;y<rgb.Size(1);y++)
- {
-  for (nat32 x=0;x<rgb.Size(0);x++)
-  {
-   rgb.Get(x,y) = luv.Get(x,y);
-  }
- }
+ ConvertRows<svt::Field<bs::ColourLuv>,bs::ColourRGB> conv(luv,rgb,RowToRGB);
+ conv.Run();
+}
+
+EOS_FUNC void LuvtoRGB(const svt::Field<bs::ColourLuvh> & luv,svt::Field<bs::ColourRGBh> & rgb)
+{
+ ConvertRows<svt::Field<bs::ColourLuvh>,bs::ColourRGBh> conv(luv,rgb,RowToRGB);
+ conv.Run();
 }
 
 //------------------------------------------------------------------------------
@@ -203,6 +536,228 @@ EOS_FUNC svt::Var * MakeByteRGB(svt::Var * var,cstrconst rgb)
  return ret;
 }
 
+//------------------------------------------------------------------------------
+// Threaded driver for the simple FromBytes conversions...
+static inline void FromByte(const byte * p,bs::ColRGB & out)
+{
+ out.r = p[0]; out.g = p[1]; out.b = p[2];
+}
+
+static inline void FromByte(const byte * p,bs::ColourRGB & out)
+{
+ out.r = luvTable.byteToReal[p[0]]; out.g = luvTable.byteToReal[p[1]]; out.b = luvTable.byteToReal[p[2]];
+}
+
+static inline void FromByte(const byte * p,bs::ColourL & out)
+{
+ out = bs::ColourRGB(luvTable.byteToReal[p[0]],luvTable.byteToReal[p[1]],luvTable.byteToReal[p[2]]);
+}
+
+static inline void FromByte(const byte * p,bs::ColourRGBh & out)
+{
+ out.r = luvTable.byteToReal[p[0]]; out.g = luvTable.byteToReal[p[1]]; out.b = luvTable.byteToReal[p[2]];
+}
+
+template <typename OUT>
+class FromByteRows
+{
+ public:
+  FromByteRows(const ByteRows & i,svt::Field<OUT> & o):in(i),out(o) {}
+
+  void Run()
+  {
+   mt::ParallelFor(0,out.Size(1),*this,8);
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    const byte * p = in.data + y*in.stride;
+    for (nat32 x=0;x<out.Size(0);x++)
+    {
+     FromByte(p,out.Get(x,y));
+     p += 3;
+    }
+   }
+  }
+
+
+ private:
+  const ByteRows & in;
+  svt::Field<OUT> & out;
+};
+
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColRGB> & out)
+{
+ ByteRows in = {rgb,stride};
+ FromByteRows<bs::ColRGB> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourRGB> & out)
+{
+ ByteRows in = {rgb,stride};
+ FromByteRows<bs::ColourRGB> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourL> & out)
+{
+ ByteRows in = {rgb,stride};
+ FromByteRows<bs::ColourL> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourLuv> & out)
+{
+ ByteRows in = {rgb,stride};
+ ConvertRows<ByteRows,bs::ColourLuv> conv(in,out,RowToLuv);
+ conv.Run();
+}
+
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourRGBh> & out)
+{
+ ByteRows in = {rgb,stride};
+ FromByteRows<bs::ColourRGBh> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourLuvh> & out)
+{
+ ByteRows in = {rgb,stride};
+ ConvertRows<ByteRows,bs::ColourLuvh> conv(in,out,RowToLuv);
+ conv.Run();
+}
+
+//------------------------------------------------------------------------------
+// Threaded driver for converting between real32 and compact storage. IN and
+// OUT are the pixel types, IE and OE the types of their channels. Tightly 
+// packed rows go through math::Convert in one go, otherwise a pixel at a 
+// time...
+template <typename IN,typename OUT,typename IE,typename OE>
+class CompactRows
+{
+ public:
+  static const nat32 channels = sizeof(IN)/sizeof(IE);
+
+  CompactRows(const svt::Field<IN> & i,svt::Field<OUT> & o):in(i),out(o) {}
+
+  void Run()
+  {
+   mt::ParallelFor(0,out.Size(1),*this,8);
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 width = out.Size(0);
+   bit packed = (in.Stride(0)==sizeof(IN))&&(out.Stride(0)==sizeof(OUT));
+   for (nat32 y=begin;y<end;y++)
+   {
+    if (packed)
+    {
+     math::Convert((const IE*)(const void*)&in.Get(0,y),(OE*)(void*)&out.Get(0,y),width*channels);
+    }
+    else
+    {
+     for (nat32 x=0;x<width;x++)
+     {
+      math::Convert((const IE*)(const void*)&in.Get(x,y),(OE*)(void*)&out.Get(x,y),channels);
+     }
+    }
+   }
+  }
+
+
+ private:
+  const svt::Field<IN> & in;
+  svt::Field<OUT> & out;
+};
+
+EOS_FUNC void Convert(const svt::Field<real32> & in,svt::Field<math::Half> & out)
+{
+ CompactRows<real32,math::Half,real32,math::Half> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<math::Half> & in,svt::Field<real32> & out)
+{
+ CompactRows<math::Half,real32,math::Half,real32> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<real32> & in,svt::Field<math::Unorm8> & out)
+{
+ CompactRows<real32,math::Unorm8,real32,math::Unorm8> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<math::Unorm8> & in,svt::Field<real32> & out)
+{
+ CompactRows<math::Unorm8,real32,math::Unorm8,real32> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<real32> & in,svt::Field<math::Unorm16> & out)
+{
+ CompactRows<real32,math::Unorm16,real32,math::Unorm16> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<math::Unorm16> & in,svt::Field<real32> & out)
+{
+ CompactRows<math::Unorm16,real32,math::Unorm16,real32> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGBh> & out)
+{
+ CompactRows<bs::ColourRGB,bs::ColourRGBh,real32,math::Half> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGB> & out)
+{
+ CompactRows<bs::ColourRGBh,bs::ColourRGB,math::Half,real32> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuvh> & out)
+{
+ CompactRows<bs::ColourLuv,bs::ColourLuvh,real32,math::Half> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuv> & out)
+{
+ CompactRows<bs::ColourLuvh,bs::ColourLuv,math::Half,real32> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColRGB16> & out)
+{
+ CompactRows<bs::ColourRGB,bs::ColRGB16,real32,math::Unorm16> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<bs::ColRGB16> & in,svt::Field<bs::ColourRGB> & out)
+{
+ CompactRows<bs::ColRGB16,bs::ColourRGB,math::Unorm16,real32> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<bs::Normal> & in,svt::Field<bs::Normalh> & out)
+{
+ CompactRows<bs::Normal,bs::Normalh,real32,math::Half> conv(in,out);
+ conv.Run();
+}
+
+EOS_FUNC void Convert(const svt::Field<bs::Normalh> & in,svt::Field<bs::Normal> & out)
+{
+ CompactRows<bs::Normalh,bs::Normal,math::Half,real32> conv(in,out);
+ conv.Run();
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC void Quant(const svt::Field<real32> & in,svt::Field<real32> & out,nat32 steps)
 { 
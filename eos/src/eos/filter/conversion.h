@@ -28,6 +28,8 @@
 #include "eos/svt/var.h"
 #include "eos/svt/field.h"
 #include "eos/bs/colours.h"
+#include "eos/bs/geo3d.h"
+#include "eos/math/compact.h"
 
 namespace eos
 {
@@ -43,17 +45,36 @@ EOS_FUNC void LtoRGB(const svt::Field<bs::ColourL> & l,svt::Field<bs::ColourRGB>
 EOS_FUNC void RGBtoL(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::ColourL> & l);
 
 /// This converts the given rgb field to a luv field, given two fields of the same
-/// dimensionality and size.
+/// dimensionality and size. This is the fast path - rows are converted four
+/// pixels at a time with SSE2 and spread over the thread pool, and the cube
+/// root is replaced by an interpolated table. Against the exact per-pixel
+/// conversion of bs::ColourLuv the maximum error for rgb in [0,1] is 0.0005
+/// for l and 0.002 for u and v. Colours with a luminance outside [0,1] go
+/// through the exact conversion, other out of range colours get a comparable
+/// relative error.
 EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::ColourLuv> & luv);
 
+/// As above, but straight from a byte rgb field, which saves converting to a
+/// real rgb field first. Same error bounds.
+EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColRGB> & rgb,svt::Field<bs::ColourLuv> & luv);
+
+/// As above, but with half precision fields at both ends, the work being done
+/// in real32. Same error bounds, plus the rounding of the halfs.
+EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColourRGBh> & rgb,svt::Field<bs::ColourLuvh> & luv);
+
 /// This converts the given luv field to a l field, given two fields of the same
 /// dimensionality and size.
 EOS_FUNC void LuvtoL(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::ColourL> & rgb);
 
 /// This converts the given luv field to a rgb field, given two fields of the same
-/// dimensionality and size.
+/// dimensionality and size. Vectorised and threaded as for RGBtoLuv, but no
+/// table is involved so the only difference from the exact conversion is
+/// rounding.
 EOS_FUNC void LuvtoRGB(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::ColourRGB> & rgb);
 
+/// As above, but with half precision fields at both ends.
+EOS_FUNC void LuvtoRGB(const svt::Field<bs::ColourLuvh> & luv,svt::Field<bs::ColourRGBh> & rgb);
+
 //------------------------------------------------------------------------------
 /// This is given a var, by default it converts the l field in the var to create
 /// a new rgb field. If the rgb field allready exists it is overwritten. You can
@@ -86,6 +107,78 @@ EOS_FUNC void LuvtoRGB(svt::Var * var,cstrconst luv = "luv",cstrconst rgb = "rgb
 /// instead of reals.
 EOS_FUNC svt::Var * MakeByteRGB(svt::Var * var,cstrconst rgb = "rgb");
 
+//------------------------------------------------------------------------------
+/// Converts an interleaved 8 bit rgb image in memory, such as a
+/// file::ImageBytes, straight into a field, so an image can be loaded into the
+/// format wanted in one pass. rgb is the top row, with rows stride bytes apart,
+/// and the size is taken from the field. Rows are done in parallel. The luv
+/// version is the fast path of RGBtoLuv, with the same error bounds, and the l
+/// version matches RGBtoL.
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColRGB> & out);
+
+/// &nbsp;
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourRGB> & out);
+
+/// &nbsp;
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourL> & out);
+
+/// &nbsp;
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourLuv> & out);
+
+/// &nbsp;
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourRGBh> & out);
+
+/// &nbsp;
+EOS_FUNC void FromBytes(const byte * rgb,nat32 stride,svt::Field<bs::ColourLuvh> & out);
+
+//------------------------------------------------------------------------------
+/// Converts a 2D field between real32 storage and one of the compact types of
+/// math/compact.h, or the colours and normals built from them, for moving 
+/// intermediates into half the memory, or a quarter, and back again. The two 
+/// fields must be the same size. Rows are done in parallel, and where the 
+/// fields are tightly packed, as for a planar Var, whole rows at a time with 
+/// the vectorised math::Convert.
+EOS_FUNC void Convert(const svt::Field<real32> & in,svt::Field<math::Half> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<math::Half> & in,svt::Field<real32> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<real32> & in,svt::Field<math::Unorm8> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<math::Unorm8> & in,svt::Field<real32> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<real32> & in,svt::Field<math::Unorm16> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<math::Unorm16> & in,svt::Field<real32> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGBh> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGB> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuvh> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuv> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColRGB16> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<bs::ColRGB16> & in,svt::Field<bs::ColourRGB> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<bs::Normal> & in,svt::Field<bs::Normalh> & out);
+
+/// &nbsp;
+EOS_FUNC void Convert(const svt::Field<bs::Normalh> & in,svt::Field<bs::Normal> & out);
+
 //------------------------------------------------------------------------------
 /// A strange little method, this quantizises a field of real values in [0,1]
 /// by a given number of steps. This is useful for algorithms which are badly
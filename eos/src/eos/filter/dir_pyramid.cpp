@@ -20,6 +20,7 @@
 #include "eos/math/constants.h"
 #include "eos/math/functions.h"
 #include "eos/math/mat_ops.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -41,64 +42,114 @@ DirPyramid::~DirPyramid()
  delete[] dirOctave;
 }
 
-void DirPyramid::Construct(const Pyramid & pyramid)
+// Calculates the magnitude and direction of every level of an octave, done by
+// rows of all the levels together over the thread pool...
+class DirOctave
 {
- // Copy in the pyramid stuff...
-  octaves = pyramid.Octaves();
-  magOctave = new svt::Var*[octaves];
-  dirOctave = new svt::Var*[octaves];
-  scales = pyramid.Scales();
-  extras = pyramid.Extras();
+ public:
+  DirOctave(const Pyramid & p,nat32 o,svt::Var * m,svt::Var * d,nat32 l)
+  :pyramid(p),oct(o),magVar(m),dirVar(d),levels(l),height(m->Size(1))
+  {}
+
+  void Run()
+  {
+   if (height<3) return;
+   mt::ParallelFor(0,levels*(height-2),*this,16);
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   svt::Field<real32> targ;
+   svt::Field<real32> mag;
+   svt::Field<real32> dir;
+   nat32 level = 0xFFFFFFFF;
+
+   for (nat32 i=begin;i<end;i++)
+   {
+    if (i/(height-2)!=level)
+    {
+     level = i/(height-2);
+     pyramid.Get(oct,level,targ);
+     magVar->ByName(str::Token(level+1),mag);
+     dirVar->ByName(str::Token(level+1),dir);
+    }
+
+    nat32 y = 1 + i%(height-2);
+    for (nat32 x=1;x+1<targ.Size(0);x++)
+    {
+     real32 dx = 0.5*(targ.Get(x+1,y)-targ.Get(x-1,y));
+     real32 dy = 0.5*(targ.Get(x,y+1)-targ.Get(x,y-1));
+     mag.Get(x,y) = math::Sqrt(math::Sqr(dx) + math::Sqr(dy));
+     dir.Get(x,y) = math::InvTan2(dy,dx);
+    }
+   }
+  }
+
+
+ private:
+  const Pyramid & pyramid;
+  nat32 oct;
+  svt::Var * magVar;
+  svt::Var * dirVar;
+  nat32 levels;
+  nat32 height;
+};
 
+void DirPyramid::Construct(const Pyramid & pyramid)
+{
  // Get details of the base image size...
   svt::Field<real32> details;
   pyramid.Get(0,0,details);
 
-  nat32 width = details.Size(0);
-  nat32 height = details.Size(1);
-
-  real32 nullReal = 0.0;
-
 
- // Loop the octaves and construct the data for each one...  
-  for (nat32 i=0;i<octaves;i++)
+ // Reuse the previous octaves if they are the same shape, otherwise make
+ // new ones. The borders are never written, so are zeroed on creation...
+  bit reuse = (magOctave!=null<svt::Var**>())&&(octaves==pyramid.Octaves())&&
+              (scales==pyramid.Scales())&&(extras==pyramid.Extras())&&
+              (magOctave[0]->Size(0)==details.Size(0))&&(magOctave[0]->Size(1)==details.Size(1));
+  if (!reuse)
   {
-   // Make the output data structure...
-    magOctave[i] = new svt::Var(details);    
+   for (nat32 i=0;i<octaves;i++)
+   {
+    delete magOctave[i];
+    delete dirOctave[i];
+   }
+   delete[] magOctave;
+   delete[] dirOctave;
+
+   octaves = pyramid.Octaves();
+   magOctave = new svt::Var*[octaves];
+   dirOctave = new svt::Var*[octaves];
+   scales = pyramid.Scales();
+   extras = pyramid.Extras();
+
+   nat32 width = details.Size(0);
+   nat32 height = details.Size(1);
+   real32 nullReal = 0.0;
+
+   for (nat32 i=0;i<octaves;i++)
+   {
+    magOctave[i] = new svt::Var(details);
     magOctave[i]->Setup2D(width,height);
     for (nat32 j=0;j<scales+extras;j++) magOctave[i]->Add(str::Token(j+1),nullReal);
     magOctave[i]->Commit(true);
-   
-    dirOctave[i] = new svt::Var(details);    
+
+    dirOctave[i] = new svt::Var(details);
     dirOctave[i]->Setup2D(width,height);
     for (nat32 j=0;j<scales+extras;j++) dirOctave[i]->Add(str::Token(j+1),nullReal);
     dirOctave[i]->Commit(true);
-        
-   // Calculate all the values...
-    for (nat32 j=0;j<scales+extras;j++)
-    {
-     svt::Field<real32> targ;
-     svt::Field<real32> mag;
-     svt::Field<real32> dir;
-	    
-     pyramid.Get(i,j,targ);
-     magOctave[i]->ByName(str::Token(j+1),mag);
-     dirOctave[i]->ByName(str::Token(j+1),dir);
-     
-     for (nat32 y=1;y<height-1;y++)
-     {
-      for (nat32 x=1;x<width-1;x++)
-      {
-       real32 dx = 0.5*(targ.Get(x+1,y)-targ.Get(x-1,y));
-       real32 dy = 0.5*(targ.Get(x,y+1)-targ.Get(x,y-1));
-       mag.Get(x,y) = math::Sqrt(math::Sqr(dx) + math::Sqr(dy));
-       dir.Get(x,y) = math::InvTan2(dy,dx);
-      }
-     }     
-    }
-    
+
     width = width/2;
-    height = height/2;    
+    height = height/2;
+   }
+  }
+
+
+ // Calculate all the values...
+  for (nat32 i=0;i<octaves;i++)
+  {
+   DirOctave calc(pyramid,i,magOctave[i],dirOctave[i],scales+extras);
+   calc.Run();
   }
 }
 
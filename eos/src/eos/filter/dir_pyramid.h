@@ -46,7 +46,8 @@ class EOS_CLASS DirPyramid
 
 
   /// Constructs the pyramid, you must call this before doing anything else.
-  /// You must only call this method once.
+  /// Can be recalled with a new pyramid, in which case the memory is reused if
+  /// the shape has not changed. Spread over the threads of mt::DefaultPool().
    void Construct(const Pyramid & pyramid);
 
 
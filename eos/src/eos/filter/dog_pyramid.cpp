@@ -20,6 +20,8 @@
 #include "eos/math/constants.h"
 #include "eos/math/functions.h"
 #include "eos/math/mat_ops.h"
+#include "eos/mt/tasks.h"
+#include "eos/ds/arrays.h"
 
 #include <stdio.h>
 
@@ -41,51 +43,96 @@ DogPyramid::~DogPyramid()
  delete[] octave;
 }
 
-void DogPyramid::Construct(const Pyramid & pyramid)
+// Differences adjacent levels of an octave, the levels and rows of the octave
+// all being independent can be spread over the thread pool together...
+class DogOctave
 {
- // Copy in the pyramid stuff...
-  octaves = pyramid.Octaves();
-  octave = new svt::Var*[octaves];
-  scales = pyramid.Scales();
+ public:
+  DogOctave(const Pyramid & p,nat32 o,svt::Var * t,nat32 l)
+  :pyramid(p),oct(o),targ(t),levels(l),height(t->Size(1))
+  {}
+
+  void Run()
+  {
+   mt::ParallelFor(0,levels*height,*this,16);
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   svt::Field<real32> a;
+   svt::Field<real32> b;
+   svt::Field<real32> c;
+   nat32 level = 0xFFFFFFFF;
+
+   for (nat32 i=begin;i<end;i++)
+   {
+    if (i/height!=level)
+    {
+     level = i/height;
+     pyramid.Get(oct,level,a);
+     pyramid.Get(oct,level+1,b);
+     targ->ByName(str::Token(level+1),c);
+    }
 
+    nat32 y = i%height;
+    for (nat32 x=0;x<c.Size(0);x++) c.Get(x,y) = b.Get(x,y) - a.Get(x,y);
+   }
+  }
+
+
+ private:
+  const Pyramid & pyramid;
+  nat32 oct;
+  svt::Var * targ;
+  nat32 levels;
+  nat32 height;
+};
+
+void DogPyramid::Construct(const Pyramid & pyramid)
+{
  // Get details of the base image size...
   svt::Field<real32> details;
   pyramid.Get(0,0,details);
 
-  nat32 width = details.Size(0);
-  nat32 height = details.Size(1);
 
-  real32 nullReal = 0.0;  
+ // Reuse the previous octaves if they are the same shape, otherwise make
+ // new ones...
+  bit reuse = (octave!=null<svt::Var**>())&&(octaves==pyramid.Octaves())&&(scales==pyramid.Scales())&&
+              (octave[0]->Size(0)==details.Size(0))&&(octave[0]->Size(1)==details.Size(1));
+  if (!reuse)
+  {
+   for (nat32 i=0;i<octaves;i++)
+   {
+    delete octave[i];
+   }
+   delete[] octave;
+
+   octaves = pyramid.Octaves();
+   octave = new svt::Var*[octaves];
+   scales = pyramid.Scales();
 
+   nat32 width = details.Size(0);
+   nat32 height = details.Size(1);
+   real32 nullReal = 0.0;
 
- // Loop the octaves and construct the data for each one...  
-  for (nat32 i=0;i<octaves;i++)
-  {
-   // Make the output data structure...
-    octave[i] = new svt::Var(details);    
+   for (nat32 i=0;i<octaves;i++)
+   {
+    octave[i] = new svt::Var(details);
     octave[i]->Setup2D(width,height);
     for (nat32 j=0;j<scales+2;j++) octave[i]->Add(str::Token(j+1),nullReal); // Extra 2 for 'end peices'.
     octave[i]->Commit(false);
-   
-   // Difference the gaussians to generate the actual output...
-    for (nat32 j=1;j<scales+3;j++)
-    {
-     svt::Field<real32> a;
-     svt::Field<real32> b;
-     svt::Field<real32> c;
-	    
-     pyramid.Get(i,j-1,a);
-     pyramid.Get(i,j,b);
-     octave[i]->ByName(str::Token(j),c);
-
-     for (nat32 y=0;y<height;y++)
-     {
-      for (nat32 x=0;x<width;x++) c.Get(x,y) = b.Get(x,y) - a.Get(x,y);
-     }     
-    }
-    
+
     width = width/2;
-    height = height/2;    
+    height = height/2;
+   }
+  }
+
+
+ // Difference the gaussians to generate the actual output...
+  for (nat32 i=0;i<octaves;i++)
+  {
+   DogOctave dog(pyramid,i,octave[i],scales+2);
+   dog.Run();
   }
 }
 
@@ -105,78 +152,144 @@ void DogPyramid::Get(nat32 o,nat32 s,svt::Field<real32> & out) const
 }
 
 
+// Finds the extrema in bands of rows of each level, every band being a job
+// with its own output list, which are joined in order at the end so the
+// output is the same as doing it in one go...
+class DogPyramid::Scan
+{
+ public:
+  static const nat32 band = 16;
+
+  struct Job
+  {
+   nat32 oct;
+   nat32 level; // Token index of the level, [2,scales+2).
+   nat32 y0;
+   nat32 y1;
+  };
+
+  Scan(const DogPyramid & d):dog(d) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 i=begin;i<end;i++) dog.Extrema(job[i].oct,job[i].level,job[i].y0,job[i].y1,out[i]);
+  }
+
+  const DogPyramid & dog;
+  ds::Array<Job> job;
+  ds::ArrayDel< ds::List<Pos> > out; // Sized once, as lists can not be moved.
+};
+
 void DogPyramid::GetExtrema(ds::List<Pos> & out) const
 {
- static const int32 offX[8] = {1,0,-1,-1,1, 1, 0,-1};
- static const int32 offY[8] = {1,1, 1, 0,0,-1,-1,-1};
+ // Make the jobs...
+  nat32 jobs = 0;
+  for (nat32 i=0;i<octaves;i++)
+  {
+   nat32 height = octave[i]->Size(1);
+   if (height>4) jobs += scales*((height-4+Scan::band-1)/Scan::band);
+  }
+
+  Scan scan(*this);
+  scan.job.Size(jobs);
+  scan.out.Size(jobs);
 
- // Iterate all posible places for extrema...
+  nat32 j = 0;
   for (nat32 i=0;i<octaves;i++)
   {
-   for (nat32 j=2;j<scales+2;j++)
+   nat32 height = octave[i]->Size(1);
+   if (height<=4) continue;
+   for (nat32 l=2;l<scales+2;l++)
    {
-    svt::Field<real32> below;
-    svt::Field<real32> level;
-    svt::Field<real32> above;        
-	   
-    octave[i]->ByName(str::Token(j-1),below);
-    octave[i]->ByName(str::Token(j),level);
-    octave[i]->ByName(str::Token(j+1),above);
-    
-    for (nat32 y=2;y<level.Size(1)-2;y++)
+    for (nat32 y=2;y<height-2;y+=Scan::band)
     {
-     for (nat32 x=2;x<level.Size(0)-2;x++)
-     {
-      real32 value = level.Get(x,y);
-      bit type = below.Get(x,y)<value;
-      
-      if (type)
-      {
-       // Testing for a maximum...
-        if (above.Get(x,y)>=value) continue;
-            
-        bit problem;
-        for (nat32 k=0;k<8;k++) {problem = below.Get(x+offX[k],y+offY[k])>=value; if (problem) break;}
-        if (problem) continue;
-
-        for (nat32 k=0;k<8;k++) {problem = level.Get(x+offX[k],y+offY[k])>=value; if (problem) break;}
-        if (problem) continue;
-
-        for (nat32 k=0;k<8;k++) {problem = above.Get(x+offX[k],y+offY[k])>=value; if (problem) break;}
-        if (problem) continue;      
-      }
-      else
-      {
-       // Testing for a minimum...
-        if (above.Get(x,y)<=value) continue;
-            
-        bit problem;
-        for (nat32 k=0;k<8;k++) {problem = below.Get(x+offX[k],y+offY[k])<=value; if (problem) break;}
-        if (problem) continue;
-
-        for (nat32 k=0;k<8;k++) {problem = level.Get(x+offX[k],y+offY[k])<=value; if (problem) break;}
-        if (problem) continue;
-
-        for (nat32 k=0;k<8;k++) {problem = above.Get(x+offX[k],y+offY[k])<=value; if (problem) break;}
-        if (problem) continue;       
-      }
-      
-      
-
-      Pos np;
-       np.x = x;     
-       np.y = y;
-       np.oct = i;
-       np.scale = j-1;
-       np.xOff = 0.0;
-       np.yOff = 0.0;
-       np.sOff = 0.0;
-       np.value = value;
-      out.AddBack(np);
-     }
+     scan.job[j].oct = i;
+     scan.job[j].level = l;
+     scan.job[j].y0 = y;
+     scan.job[j].y1 = math::Min(y+Scan::band,height-2);
+     ++j;
     }
    }
   }
+
+
+ // Run them then collate...
+  mt::ParallelFor(0,jobs,scan);
+
+  for (nat32 i=0;i<jobs;i++)
+  {
+   ds::List<Pos>::Cursor targ = scan.out[i].FrontPtr();
+   while (!targ.Bad())
+   {
+    out.AddBack(*targ);
+    ++targ;
+   }
+  }
+}
+
+void DogPyramid::Extrema(nat32 i,nat32 j,nat32 y0,nat32 y1,ds::List<Pos> & out) const
+{
+ static const int32 offX[8] = {1,0,-1,-1,1, 1, 0,-1};
+ static const int32 offY[8] = {1,1, 1, 0,0,-1,-1,-1};
+
+ svt::Field<real32> below;
+ svt::Field<real32> level;
+ svt::Field<real32> above;
+
+ octave[i]->ByName(str::Token(j-1),below);
+ octave[i]->ByName(str::Token(j),level);
+ octave[i]->ByName(str::Token(j+1),above);
+
+ for (nat32 y=y0;y<y1;y++)
+ {
+  for (nat32 x=2;x<level.Size(0)-2;x++)
+  {
+   real32 value = level.Get(x,y);
+   bit type = below.Get(x,y)<value;
+   
+   if (type)
+   {
+    // Testing for a maximum...
+     if (above.Get(x,y)>=value) continue;
+         
+     bit problem;
+     for (nat32 k=0;k<8;k++) {problem = below.Get(x+offX[k],y+offY[k])>=value; if (problem) break;}
+     if (problem) continue;
+
+     for (nat32 k=0;k<8;k++) {problem = level.Get(x+offX[k],y+offY[k])>=value; if (problem) break;}
+     if (problem) continue;
+
+     for (nat32 k=0;k<8;k++) {problem = above.Get(x+offX[k],y+offY[k])>=value; if (problem) break;}
+     if (problem) continue;      
+   }
+   else
+   {
+    // Testing for a minimum...
+     if (above.Get(x,y)<=value) continue;
+         
+     bit problem;
+     for (nat32 k=0;k<8;k++) {problem = below.Get(x+offX[k],y+offY[k])<=value; if (problem) break;}
+     if (problem) continue;
+
+     for (nat32 k=0;k<8;k++) {problem = level.Get(x+offX[k],y+offY[k])<=value; if (problem) break;}
+     if (problem) continue;
+
+     for (nat32 k=0;k<8;k++) {problem = above.Get(x+offX[k],y+offY[k])<=value; if (problem) break;}
+     if (problem) continue;       
+   }
+
+   Pos np;
+    np.x = x;     
+    np.y = y;
+    np.oct = i;
+    np.scale = j-1;
+    np.xOff = 0.0;
+    np.yOff = 0.0;
+    np.sOff = 0.0;
+    np.value = value;
+   out.AddBack(np);
+  }
+ }
 }
 
 bit DogPyramid::RefineExtrema(Pos & pos) const
@@ -50,7 +50,9 @@ class EOS_CLASS DogPyramid
    
   /// Constructs the pyramid, you must call this before doing anything else.
   /// the Extras() method of the given pyramid must return at least 3 otherwise
-  /// it will go rather hairy. You must only call this method once.
+  /// it will go rather hairy. Can be recalled with a new pyramid, in which case
+  /// the memory is reused if the shape has not changed. Spread over the
+  /// threads of mt::DefaultPool().
    void Construct(const Pyramid & pyramid);
   
   
@@ -92,7 +94,9 @@ class EOS_CLASS DogPyramid
     
   /// Extracts a list of all minimas and maximas in scale space throughout the
   /// pyramid. Appends all found extrema to the given list. Will not produce 
-  /// points on the border, as such pixels can't be trusted.
+  /// points on the border, as such pixels can't be trusted. Bands of rows of
+  /// each level are searched in parallel over mt::DefaultPool(), but the
+  /// output order is the same as a serial search.
    void GetExtrema(ds::List<Pos> & out) const;
   
   /// Given a pos it fills in its offset fields and updates its value by interpolation
@@ -122,7 +126,12 @@ class EOS_CLASS DogPyramid
    svt::Var ** octave;
 
 
-  // Helper method...
+  // Helper methods...
+   // Appends the extrema of rows [y0,y1) of the given octave and level, where
+   // level is the token index of the middle of the three levels...
+    void Extrema(nat32 oct,nat32 level,nat32 y0,nat32 y1,ds::List<Pos> & out) const;
+   class Scan;
+
    // This calculates the (x,y,s) derivative at a given point, don't give it
    // points on the border, it dosn't like it.
     void Deriv(const Pos & pos,math::Vect<3> & out) const;
@@ -22,6 +22,7 @@
 #include "eos/ds/arrays.h"
 #include "eos/filter/grad_angle.h"
 #include "eos/filter/conversion.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -39,51 +40,35 @@ struct RankPos
 };
 
 //-----------------------------------------------------------------------------
-EOS_FUNC void EdgeConfidence(const svt::Field<real32> & in,const KernelVect & kernel,svt::Field<real32> & eta,svt::Field<real32> & rho)
+// Calculates rows of eta for the below method, each range of rows with its own
+// ideal kernel to work in...
+class EtaRows
 {
- // Create the data structures we are going to be using...
-  nat32 half = kernel.HalfSize();
-  nat32 size = half*2 + 1;
-  nat32 width = in.Size(0);
-  nat32 height = in.Size(1);
-
-  svt::Var * temp = new svt::Var(in.GetVar()->GetCore());
-   temp->Setup2D(width,height);
-   real32 ini = 0.0;
-   temp->Add("quant",ini);
-   temp->Add("grad",ini);
-   temp->Add("ang",ini);
-  temp->Commit(false);
-
-  svt::Field<real32> quant;
-  svt::Field<real32> gradiant;
-  svt::Field<real32> angle;
-   temp->ByName("quant",quant);
-   temp->ByName("grad",gradiant);
-   temp->ByName("ang",angle);
+ public:
+  EtaRows(const svt::Field<real32> & i,const svt::Field<real32> & g,const svt::Field<real32> & a,svt::Field<real32> & e,nat32 h)
+  :in(i),gradiant(g),angle(a),eta(e),half(h)
+  {}
 
- // Quantizise the image as the algorithm is rather dependent on it being as such,
- // and produces bad results otherwise... (Yes, that means the algorithm is 
- // essentially broken.)
-  Quant(in,quant);
-
- // First calculate the gradiant and angle for the input...
-  GradAngle(quant,kernel,gradiant,angle);
-  
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 width = in.Size(0);
+   nat32 height = in.Size(1);
+   nat32 size = half*2 + 1;
 
- // Now generate eta using the angle...
-  KernelMat ik;
-  ik.SetSize(half);
-   for (nat32 y=0;y<half;y++)
+   KernelMat ik;
+   ik.SetSize(half);
+   for (nat32 y=begin;y<end;y++)
    {
-    for (nat32 x=0;x<width;x++) eta.Get(x,y) = 0.0; 
-   }
-   for (nat32 y=half;y<height-half;y++)
-   {
+    if ((y<half)||(y>=height-half))
+    {
+     for (nat32 x=0;x<width;x++) eta.Get(x,y) = 0.0;
+     continue;
+    }
+
     for (nat32 x=0;x<half;x++) eta.Get(x,y) = 0.0;
     for (nat32 x=half;x<width-half;x++)
-    {
-     if (!math::Equal(gradiant.Get(x,y),real32(0.0)))
+    {
+     if (!math::Equal(gradiant.Get(x,y),real32(0.0)))
      {
       // Calculate the mean of the window over the image... 
        real32 mean = 0.0;
@@ -107,7 +92,7 @@ EOS_FUNC void EdgeConfidence(const svt::Field<real32> & in,const KernelVect & ke
       // Make the relevent ideal kernel...
        ik.MakeIdeal(angle.Get(x,y));
        ik.ZeroMean();
-       ik.FrobNorm(); 
+       ik.FrobNorm(); 
 
       // Iterate and sum in the contribution to eta from each element in the
       // window...
@@ -119,17 +104,58 @@ EOS_FUNC void EdgeConfidence(const svt::Field<real32> & in,const KernelVect & ke
           o += ik.Val(u,v)*(in.Get(x+u,y+v)-mean)*mult;
          }
         }
-       eta.Get(x,y) = math::Abs(o);
-     }
+       eta.Get(x,y) = math::Abs(o);
+     }
      else eta.Get(x,y) = 0.0;
-    }
+    }
     for (nat32 x=width-half;x<width;x++) eta.Get(x,y) = 0.0;
-   }
-   for (nat32 y=height-half;y<height;y++)
-   {
-    for (nat32 x=0;x<width;x++) eta.Get(x,y) = 0.0;
-   }
+   }
+  }
+
+ private:
+  const svt::Field<real32> & in;
+  const svt::Field<real32> & gradiant;
+  const svt::Field<real32> & angle;
+  svt::Field<real32> & eta;
+  nat32 half;
+};
+
+//-----------------------------------------------------------------------------
+EOS_FUNC void EdgeConfidence(const svt::Field<real32> & in,const KernelVect & kernel,svt::Field<real32> & eta,svt::Field<real32> & rho)
+{
+ // Create the data structures we are going to be using...
+  nat32 half = kernel.HalfSize();
+  nat32 width = in.Size(0);
+  nat32 height = in.Size(1);
+
+  svt::Var * temp = new svt::Var(in.GetVar()->GetCore());
+   temp->Setup2D(width,height);
+   real32 ini = 0.0;
+   temp->Add("quant",ini);
+   temp->Add("grad",ini);
+   temp->Add("ang",ini);
+  temp->Commit(false);
+
+  svt::Field<real32> quant;
+  svt::Field<real32> gradiant;
+  svt::Field<real32> angle;
+   temp->ByName("quant",quant);
+   temp->ByName("grad",gradiant);
+   temp->ByName("ang",angle);
+
+ // Quantizise the image as the algorithm is rather dependent on it being as such,
+ // and produces bad results otherwise... (Yes, that means the algorithm is 
+ // essentially broken.)
+  Quant(in,quant);
+
+ // First calculate the gradiant and angle for the input...
+  GradAngle(quant,kernel,gradiant,angle);
   
+
+ // Now generate eta using the angle, in parallel over the rows...
+  EtaRows etaRows(in,gradiant,angle,eta,half);
+  mt::ParallelFor(0,height,etaRows,4);
+  
   
  // Sort the gradiant values...
   ds::Array<RankPos> sorted(width*height);
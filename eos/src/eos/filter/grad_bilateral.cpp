@@ -19,6 +19,7 @@
 
 #include "eos/ds/arrays.h"
 #include "eos/math/gaussian_mix.h"
+#include "eos/filter/permutohedral.h"
 
 namespace eos
 {
@@ -93,6 +94,112 @@ EOS_FUNC void GradBilatGauss(const svt::Field<bs::ColourLuv> & in,svt::Field<rea
   prog->Pop();
 }
 
+EOS_FUNC void GradBilatLattice(const svt::Field<bs::ColourLuv> & in,svt::Field<real32> & dx,svt::Field<real32> & dy,
+                               real32 spatialSd,real32 domainSd,time::Progress * prog)
+{
+ prog->Push();
+ nat32 width = in.Size(0);
+ nat32 height = in.Size(1);
+ nat32 pixels = width*height;
+
+ // Build the lattice...
+  prog->Report(0,3);
+  {
+   real32 * pos = new real32[pixels*5];
+   real32 * targ = pos;
+   for (nat32 y=0;y<height;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     const bs::ColourLuv & c = in.Get(x,y);
+     targ[0] = real32(x)/spatialSd;
+     targ[1] = real32(y)/spatialSd;
+     targ[2] = c.l/domainSd;
+     targ[3] = c.u/domainSd;
+     targ[4] = c.v/domainSd;
+     targ += 5;
+    }
+   }
+
+   Permutohedral lattice;
+   lattice.Build(pixels,5,pos);
+   delete[] pos;
+
+  // Where the lattice puts the centre of each pixels kernel...
+   real64 * kcx = new real64[pixels];
+   real64 * kcy = new real64[pixels];
+   lattice.Centre(0,kcx);
+   lattice.Centre(1,kcy);
+
+  // Filter the luminance, the spatial offsets, their squares and products
+  // with the luminance and the weight - the offsets are relative to the image
+  // centre to keep the numbers small...
+   prog->Report(1,3);
+   real64 cx = 0.5*real64(width);
+   real64 cy = 0.5*real64(height);
+   real64 * val = new real64[pixels*8];
+   real64 * v = val;
+   for (nat32 y=0;y<height;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     real64 nc = in.Get(x,y).l/100.0;
+     real64 ox = real64(x)-cx;
+     real64 oy = real64(y)-cy;
+     v[0] = 1.0;
+     v[1] = nc;
+     v[2] = ox;
+     v[3] = oy;
+     v[4] = ox*ox;
+     v[5] = oy*oy;
+     v[6] = nc*ox;
+     v[7] = nc*oy;
+     v += 8;
+    }
+   }
+
+   lattice.Filter(8,val,val);
+
+  // Extract - the kernel the lattice provides is only centred on the pixel on
+  // average, as its interpolated from vertices up to a standard deviation
+  // away, so the raw first moment is dominated by that offset. Instead the
+  // weighted least squares slope of the luminance against position is used,
+  // which the centring makes immune to it. Scaling by sd*sqrt(pi/2), which is
+  // E[u^2]/E[|u|] of a Gaussian, makes a ramp give the same answer as
+  // GradBilatGauss...
+   prog->Report(2,3);
+   real64 norm = spatialSd*math::Sqrt(0.5*math::pi);
+   real64 off = 1.0/(spatialSd*math::Sqrt(2.0/math::pi));
+   v = val;
+   for (nat32 y=0;y<height;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     real64 iw = 1.0/v[0];
+     real64 mc = v[1]*iw;
+     real64 mx = v[2]*iw;
+     real64 my = v[3]*iw;
+
+     real64 varX = v[4]*iw - mx*mx;
+     real64 varY = v[5]*iw - my*my;
+     real64 covX = v[6]*iw - mx*mc;
+     real64 covY = v[7]*iw - my*mc;
+
+     nat32 ind = y*width + x;
+     dx.Get(x,y) = norm*covX/varX + off*(mx - (kcx[ind]*spatialSd-cx))*mc;
+     dy.Get(x,y) = norm*covY/varY + off*(my - (kcy[ind]*spatialSd-cy))*mc;
+     if (!math::IsFinite(dx.Get(x,y))) dx.Get(x,y) = 0.0;
+     if (!math::IsFinite(dy.Get(x,y))) dy.Get(x,y) = 0.0;
+     v += 8;
+    }
+   }
+   delete[] val;
+   delete[] kcx;
+   delete[] kcy;
+  }
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
  };
 };
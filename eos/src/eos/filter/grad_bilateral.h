@@ -39,6 +39,23 @@ EOS_FUNC void GradBilatGauss(const svt::Field<bs::ColourLuv> & in,svt::Field<rea
                              real32 spatialSd,real32 domainSd,real32 winSdMult = 2.0,
                              time::Progress * prog = null<time::Progress*>());
 
+/// An alternative to GradBilatGauss that uses a permutohedral lattice over
+/// (x,y,l,u,v) instead of visiting every pixel of the window, so its time
+/// is linear in the pixel count and independent of the standard deviations -
+/// large spatialSd go from thousands of taps per pixel to a few dozen
+/// operations. The sum of the differential weighted luminance is rebuilt from
+/// the moments of the bilateral weighting - the weighted least squares slope
+/// of the luminance plus the shift of the weighted mean position away from
+/// the pixel, the second being what responds at edges. The sum of absolute
+/// weights is approximated by that of a Gaussian, exact for constant images
+/// and straight edges through the pixel. The window is not truncated, and the
+/// lattice only approximates a Gaussian, so this matches GradBilatGauss with
+/// a large winSdMult to a correlation of around 0.99 rather than exactly,
+/// with a little jitter from the lattice on smooth gradients.
+EOS_FUNC void GradBilatLattice(const svt::Field<bs::ColourLuv> & in,svt::Field<real32> & dx,svt::Field<real32> & dy,
+                               real32 spatialSd,real32 domainSd,
+                               time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
  };
 };
@@ -18,80 +18,71 @@
 #include "eos/filter/grad_walk.h"
 
 #include "eos/data/randoms.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace filter
  {
 //------------------------------------------------------------------------------
-EOS_FUNC void GradWalk(const svt::Field<real32> & l,svt::Field<real32> & dx,svt::Field<real32> & dy,
-                       nat32 walks,nat32 length,real32 exp,bit extend,
-                       time::Progress * prog)
+// Does the rows [begin,end) for GradWalk, with a random stream per row so the
+// result only depends on the seed, not on how the rows are shared out. pw is
+// the luminance raised to the exponent, with a border of 1 that is either 0
+// or a copy of the edge depending on extend...
+class GradWalkRows
 {
- prog->Push();
- data::Random rand;
- for (int32 y=0;y<int32(l.Size(1));y++)
- {
-  prog->Report(y,l.Size(1));
-  prog->Push();
-  for (int32 x=0;x<int32(l.Size(0));x++)
-  {
-   prog->Report(x,l.Size(0));
-   // For each pixel calculate a value by walking...
-    dx.Get(x,y) = 0.0;
-    dy.Get(x,y) = 0.0;
+ public:
+  const ds::Array2D<real32> * pw;
+  svt::Field<real32> * dx;
+  svt::Field<real32> * dy;
+  nat32 walks;
+  nat32 length;
+  bit extend;
+  nat64 seed;
+
+  // The weight of stepping onto a pixel - from the border if its outside the
+  // image, or 0 if beyond that without extend...
+   real32 Weight(int32 x,int32 y) const
+   {
+    int32 cx = math::Clamp<int32>(x,-1,int32(pw->Width())-2);
+    int32 cy = math::Clamp<int32>(y,-1,int32(pw->Height())-2);
+    if ((!extend)&&((cx!=x)||(cy!=y))) return 0.0;
+    return pw->Get(cx+1,cy+1);
+   }
 
-    for (nat32 w=0;w<walks;w++)
+  void operator()(nat32 begin,nat32 end)
+  {
+   int32 width = int32(pw->Width()) - 2;
+   for (nat32 y=begin;y<end;y++)
+   {
+    data::RandomStream rand(seed,y);
+    for (int32 x=0;x<width;x++)
     {
-     int32 tx = x,ty = y;
-
-     for (nat32 le=0;le<length;le++)
+     real32 sx = 0.0;
+     real32 sy = 0.0;
+     for (nat32 w=0;w<walks;w++)
      {
-      // Make a step to an adjacent pixel - 4 to choose from...
-       // Get the luminence values...
-        real32 lum[4]; // Indexed by direction, defined in the normal +ve x, +ve y, -ve x, -ve y way.
-        if (extend)
-        {
-         lum[0] = l.Get(math::Clamp<int32>(tx+1,0,int32(l.Size(0)-1)),math::Clamp<int32>(ty,0,int32(l.Size(1)-1)));
-         lum[1] = l.Get(math::Clamp<int32>(tx,0,int32(l.Size(0)-1)),math::Clamp<int32>(ty+1,0,int32(l.Size(1)-1)));
-         lum[2] = l.Get(math::Clamp<int32>(tx-1,0,int32(l.Size(0)-1)),math::Clamp<int32>(ty,0,int32(l.Size(1)-1)));
-         lum[3] = l.Get(math::Clamp<int32>(tx,0,int32(l.Size(0)-1)),math::Clamp<int32>(ty-1,0,int32(l.Size(1)-1)));
-        }
-        else
+      int32 tx = x,ty = int32(y);
+      for (nat32 le=0;le<length;le++)
+      {
+       // The weights of the 4 directions, in the normal +ve x, +ve y, -ve x,
+       // -ve y order...
+        real32 lum[4];
+        lum[0] = Weight(tx+1,ty);
+        lum[1] = Weight(tx,ty+1);
+        lum[2] = Weight(tx-1,ty);
+        lum[3] = Weight(tx,ty-1);
+
+       // Select a direction, update target coordinate...
+        real32 sum = lum[0] + lum[1] + lum[2] + lum[3];
+        real32 index = sum * real32(rand.Normal());
+        nat32 dir = 0;
+        if (sum>0.0)
         {
-         if ((ty>=0)&&(ty<int32(l.Size(1))))
-         {
-          if (tx+1<int32(l.Size(0))) lum[0] = l.Get(tx+1,ty);
-                                else lum[0] = 0.0;
-          if (tx-1>=0) lum[2] = l.Get(tx-1,ty);
-                  else lum[2] = 0.0;
-         }
-         else
-         {
-          lum[0] = 0.0;
-          lum[2] = 0.0;
-         }
-
-         if ((tx>=0)&&(tx<int32(l.Size(0))))
-         {
-          if (ty+1<int32(l.Size(1))) lum[1] = l.Get(tx,ty+1);
-                                else lum[1] = 0.0;
-          if (ty-1>=0) lum[3] = l.Get(tx,ty-1);
-                  else lum[3] = 0.0;
-         }
-         else
-         {
-          lum[1] = 0.0;
-          lum[3] = 0.0;
-         }
+         while ((dir<3)&&(index>=lum[dir])) {index -= lum[dir]; ++dir;}
         }
+        else dir = rand.Next()>>30;
 
-
-       // Add the exponent to the luminence values...
-        for (nat32 i=0;i<4;i++) lum[i] = math::Pow(lum[i],exp);
-
-       // Select a direction, update target coordinate...
-        nat32 dir = rand.Select(4,lum);
         switch (dir)
         {
          case 0:  tx++; break;
@@ -99,129 +90,75 @@ EOS_FUNC void GradWalk(const svt::Field<real32> & l,svt::Field<real32> & dx,svt:
          case 2:  tx--; break;
          default: ty--; break;
         }
+      }
+
+      sx += real32(tx-x);
+      sy += real32(ty-int32(y));
      }
 
-     dx.Get(x,y) += real32(tx-x);
-     dy.Get(x,y) += real32(ty-y);
+     dx->Get(x,y) = sx/real32(walks);
+     dy->Get(x,y) = sy/real32(walks);
     }
-
-    dx.Get(x,y) /= real32(walks);
-    dy.Get(x,y) /= real32(walks);
+   }
   }
-  prog->Pop();
- }
- prog->Pop();
-}
+};
 
-//------------------------------------------------------------------------------
-EOS_FUNC void GradWalkPerfect(const svt::Field<real32> & l,svt::Field<real32> & dx,svt::Field<real32> & dy,
-                              nat32 length,real32 exp,real32 stopChance,time::Progress * prog)
+EOS_FUNC void GradWalk(const svt::Field<real32> & l,svt::Field<real32> & dx,svt::Field<real32> & dy,
+                       nat32 walks,nat32 length,real32 exp,bit extend,
+                       time::Progress * prog)
 {
- // Require 2 buffers to store propagation values in...
-  ds::Array2D<real32> bufA(length*2+1,length*2+1);
-  ds::Array2D<real32> bufB(length*2+1,length*2+1);
-
-  ds::Array2D<real32> * from = &bufA;
-  ds::Array2D<real32> * to = &bufB;
-
-
- // Now do the per-pixel calculation...
  prog->Push();
- for (int32 y=0;y<int32(l.Size(1));y++)
- {
-  prog->Report(y,l.Size(1));
-  prog->Push();
-  for (int32 x=0;x<int32(l.Size(0));x++)
+ nat32 width = l.Size(0);
+ nat32 height = l.Size(1);
+
+ // Raise the luminance to the exponent once, rather than at every step, into
+ // an array with a border, that is 0 or a copy of the edge...
+  prog->Report(0,2);
+  ds::Array2D<real32> pw(width+2,height+2);
+  for (nat32 y=0;y<height+2;y++)
   {
-   prog->Report(x,l.Size(0));
-   // Fill in the starting weight, zero the gradiant vector...
-    from->Get(length,length) = 1.0;
-    dx.Get(x,y) = 0.0;
-    dy.Get(x,y) = 0.0;
-    real32 remains = 1.0; // How much of 1 is left to be added in, for the probalistically shorter walks.
-
-
-   // Iterate through each step of the walk, diffusing the probabilities, bouncing between buffers...
-    int32 bx = x-length;
-    int32 by = y-length;
-    for (nat32 step=0;step<length;step++)
-    {
-     // Zero out the to grid...
-      for (int32 v=int32(length-step-1);v<=int32(length+step+1);v++)
-      {
-       for (int32 u=int32(length-step-1);u<=int32(length+step+1);u++) to->Get(u,v) = 0.0;
-      }
-
-     // Do the step...
-      for (int32 v=int32(length-step);v<=int32(length+step);v++)
-      {
-       for (int32 u=int32(length-step);u<=int32(length+step);u++)
-       {
-        if (!math::IsZero(from->Get(u,v)))
-        {
-         // Calculate the weights for the neighbours...
-          real32 weight[4];
-          weight[0] = l.Get(math::Clamp<int32>(bx+u+1,0,int32(l.Size(0)-1)),math::Clamp<int32>(by+v,0,int32(l.Size(1)-1)));
-          weight[1] = l.Get(math::Clamp<int32>(bx+u,0,int32(l.Size(0)-1)),math::Clamp<int32>(by+v+1,0,int32(l.Size(1)-1)));
-          weight[2] = l.Get(math::Clamp<int32>(bx+u-1,0,int32(l.Size(0)-1)),math::Clamp<int32>(by+v,0,int32(l.Size(1)-1)));
-          weight[3] = l.Get(math::Clamp<int32>(bx+u,0,int32(l.Size(0)-1)),math::Clamp<int32>(by+v-1,0,int32(l.Size(1)-1)));
-
-         // Modify by the exponential term...
-          for (nat32 i=0;i<4;i++) weight[i] = 0.0001 + math::Pow(weight[i],exp); // 0.001 to avoid div by zero.
-
-         // Normalise them by the weight from the from grid...
-          real32 sum = 0.0;
-          for (nat32 i=0;i<4;i++) sum += weight[i];
-          real32 mult = from->Get(u,v)/sum;
-          for (nat32 i=0;i<4;i++) weight[i] *= mult;
-
-         // Add them to the to grid...
-          to->Get(u+1,v) += weight[0];
-          to->Get(u,v+1) += weight[1];
-          to->Get(u-1,v) += weight[2];
-          to->Get(u,v-1) += weight[3];
-        }
-       }
-      }
-
-     // Swap for the next pass...
-      math::Swap(from,to);
-
-     // Sum into the gradient all the walks that have ended at this point...
-      if (!math::IsZero(stopChance))
-      {
-       real32 weight = stopChance * math::Pow(real32(1.0-stopChance),real32(step));
-       remains -= weight;
-
-       for (int32 v=int32(length-step-1);v<=int32(length+step+1);v++)
-       {
-        for (int32 u=int32(length-step-1);u<=int32(length+step+1);u++)
-        {
-         dx.Get(x,y) += real32(u-int32(length)) * from->Get(u,v) * weight;
-         dy.Get(x,y) += real32(v-int32(length)) * from->Get(u,v) * weight;
-        }
-       }
-      }
-    }
-
-   // Sum the gradiant vector from the field of probability values, to make sure the final sum is 1...
-    for (int32 v=0;v<int32(from->Height());v++)
+   for (nat32 x=0;x<width+2;x++)
+   {
+    bit inside = (x>0)&&(x<=width)&&(y>0)&&(y<=height);
+    if (inside||extend)
     {
-     for (int32 u=0;u<int32(from->Width());u++)
-     {
-      dx.Get(x,y) += real32(u-int32(length)) * from->Get(u,v) * remains;
-      dy.Get(x,y) += real32(v-int32(length)) * from->Get(u,v) * remains;
-     }
+     real32 v = l.Get(math::Clamp<int32>(int32(x)-1,0,int32(width)-1),
+                      math::Clamp<int32>(int32(y)-1,0,int32(height)-1));
+     pw.Get(x,y) = math::Pow(v,exp);
     }
+    else pw.Get(x,y) = 0.0;
+   }
   }
-  prog->Pop();
- }
+
+ // Do the walks, in parallel over the rows...
+  prog->Report(1,2);
+  data::Random seeder;
+  GradWalkRows rows;
+  rows.pw = &pw;
+  rows.dx = &dx;
+  rows.dy = &dy;
+  rows.walks = walks;
+  rows.length = length;
+  rows.extend = extend;
+  rows.seed = (nat64(nat32(seeder.Int(0,0x7FFFFFFF)))<<32) | nat64(nat32(seeder.Int(0,0x7FFFFFFF)));
+  mt::ParallelFor(0,height,rows);
+
  prog->Pop();
 }
 
+//------------------------------------------------------------------------------
+EOS_FUNC void GradWalkPerfect(const svt::Field<real32> & l,svt::Field<real32> & dx,svt::Field<real32> & dy,
+                              nat32 length,real32 exp,real32 stopChance,time::Progress * prog)
+{
+ GradWalkSelect gws;
+ gws.SetInput(l);
+ gws.SetParas(length,exp,stopChance);
+ gws.Run(dx,dy,prog);
+}
+
 //------------------------------------------------------------------------------
 GradWalkSelect::GradWalkSelect()
-:length(8),exp(6.0),bufA(8*2+1,8*2+1),bufB(8*2+1,8*2+1)
+:length(8),exp(6.0),stopChance(0.0),ready(false),bufA(8*2+1,8*2+1),bufB(8*2+1,8*2+1)
 {}
 
 GradWalkSelect::~GradWalkSelect()
@@ -230,93 +167,185 @@ GradWalkSelect::~GradWalkSelect()
 void GradWalkSelect::SetInput(const svt::Field<real32> & ll)
 {
  l = ll;
+ ready = false;
 }
 
-void GradWalkSelect::SetParas(nat32 l,real32 e)
+void GradWalkSelect::SetParas(nat32 le,real32 e,real32 sc)
 {
- length = l;
+ length = le;
  exp = e;
+ stopChance = sc;
+ ready = false;
+
+ bufA.Resize(length*2+1,length*2+1);
+ bufB.Resize(length*2+1,length*2+1);
 }
 
 void GradWalkSelect::Query(nat32 x,nat32 y,real32 & dx,real32 & dy)
 {
- // Prep the buffers...
-  ds::Array2D<real32> * from = &bufA;
-  ds::Array2D<real32> * to = &bufB;
-  
-  from->Get(length,length) = 1.0;
+ Prepare();
+ Walk(x,y,bufA,bufB,dx,dy);
+}
+
+// Does the rows [begin,end) for GradWalkSelect::Run, with buffers per range...
+class GradWalkSelect::RunRows
+{
+ public:
+  const GradWalkSelect * self;
+  svt::Field<real32> * dx;
+  svt::Field<real32> * dy;
+
+  void operator()(nat32 begin,nat32 end)
+  {
+   ds::Array2D<real32> bufA(self->length*2+1,self->length*2+1);
+   ds::Array2D<real32> bufB(self->length*2+1,self->length*2+1);
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<self->l.Size(0);x++) self->Walk(x,y,bufA,bufB,dx->Get(x,y),dy->Get(x,y));
+   }
+  }
+};
+
+void GradWalkSelect::Run(svt::Field<real32> & dx,svt::Field<real32> & dy,time::Progress * prog)
+{
+ prog->Push();
+ prog->Report(0,2);
+ Prepare();
 
+ prog->Report(1,2);
+ RunRows rows;
+ rows.self = this;
+ rows.dx = &dx;
+ rows.dy = &dy;
+ mt::ParallelFor(0,l.Size(1),rows);
 
- // Do the walks...
+ prog->Pop();
+}
+
+cstrconst GradWalkSelect::TypeString() const
+{
+ return "eos::filter::GradWalkSelect";
+}
+
+void GradWalkSelect::Prepare()
+{
+ if (ready) return;
+ ready = true;
+
+ int32 width = int32(l.Size(0));
+ int32 height = int32(l.Size(1));
+ int32 len = int32(length);
+
+ // The weight of stepping onto each position, which is the luminance of the
+ // nearest pixel to the power of exp, for the area the walks can reach plus
+ // a border of 1 - position (u,v) is pixel (u-len-1,v-len-1)...
+  ds::Array2D<real32> weight(width+len*2+2,height+len*2+2);
+  for (int32 v=0;v<int32(weight.Height());v++)
+  {
+   for (int32 u=0;u<int32(weight.Width());u++)
+   {
+    real32 lum = l.Get(math::Clamp<int32>(u-len-1,0,width-1),math::Clamp<int32>(v-len-1,0,height-1));
+    weight.Get(u,v) = 0.0001 + math::Pow(lum,exp); // 0.0001 to avoid div by zero.
+   }
+  }
+
+ // Normalise into the per direction probabilities of each position - position
+ // (u,v) is pixel (u-len,v-len), so (x,y) in the walk buffer for pixel (x,y)
+ // is the same in here...
+  for (nat32 i=0;i<4;i++) prob[i].Resize(width+len*2,height+len*2);
+  for (int32 v=0;v<int32(prob[0].Height());v++)
+  {
+   for (int32 u=0;u<int32(prob[0].Width());u++)
+   {
+    real32 w0 = weight.Get(u+2,v+1);
+    real32 w1 = weight.Get(u+1,v+2);
+    real32 w2 = weight.Get(u,v+1);
+    real32 w3 = weight.Get(u+1,v);
+    real32 mult = 1.0/(w0 + w1 + w2 + w3);
+
+    prob[0].Get(u,v) = w0 * mult;
+    prob[1].Get(u,v) = w1 * mult;
+    prob[2].Get(u,v) = w2 * mult;
+    prob[3].Get(u,v) = w3 * mult;
+   }
+  }
+}
+
+void GradWalkSelect::Walk(nat32 x,nat32 y,ds::Array2D<real32> & bufA,ds::Array2D<real32> & bufB,real32 & dx,real32 & dy) const
+{
+ ds::Array2D<real32> * from = &bufA;
+ ds::Array2D<real32> * to = &bufB;
+
+ dx = 0.0;
+ dy = 0.0;
+ real32 remains = 1.0; // How much of 1 is left to be added in, for the probalistically shorter walks.
+ from->Get(length,length) = 1.0;
+
+
+ // Iterate through each step of the walk, diffusing the probabilities,
+ // bouncing between buffers. Each direction is its own loop along the row,
+ // so they vectorise...
   for (nat32 step=0;step<length;step++)
   {
    // Zero out the to grid...
-    for (int32 v=int32(length-step-1);v<=int32(length+step+1);v++)
+    for (nat32 v=length-step-1;v<=length+step+1;v++)
     {
-     for (int32 u=int32(length-step-1);u<=int32(length+step+1);u++) to->Get(u,v) = 0.0;
+     real32 * t = &to->Get(0,v);
+     for (nat32 u=length-step-1;u<=length+step+1;u++) t[u] = 0.0;
     }
-    
+
    // Do the step...
-    int32 bx = int32(x) - int32(length);
-    int32 by = int32(y) - int32(length);
-    for (int32 v=int32(length-step);v<=int32(length+step);v++)
+    nat32 u0 = length-step;
+    nat32 u1 = length+step+1;
+    for (nat32 v=length-step;v<=length+step;v++)
     {
-     for (int32 u=int32(length-step);u<=int32(length+step);u++)
+     const real32 * f = &from->Get(0,v);
+     real32 * tHere = &to->Get(0,v);
+     real32 * tDown = &to->Get(0,v+1);
+     real32 * tUp = &to->Get(0,v-1);
+     const real32 * p0 = &prob[0].Get(x,y+v);
+     const real32 * p1 = &prob[1].Get(x,y+v);
+     const real32 * p2 = &prob[2].Get(x,y+v);
+     const real32 * p3 = &prob[3].Get(x,y+v);
+
+     for (nat32 u=u0;u<u1;u++) tHere[u+1] += f[u] * p0[u];
+     for (nat32 u=u0;u<u1;u++) tDown[u] += f[u] * p1[u];
+     for (nat32 u=u0;u<u1;u++) tHere[u-1] += f[u] * p2[u];
+     for (nat32 u=u0;u<u1;u++) tUp[u] += f[u] * p3[u];
+    }
+
+   // Swap for the next pass...
+    math::Swap(from,to);
+
+   // Sum into the gradient all the walks that have ended at this point...
+    if (!math::IsZero(stopChance))
+    {
+     real32 weight = stopChance * math::Pow(real32(1.0-stopChance),real32(step));
+     remains -= weight;
+
+     for (nat32 v=length-step-1;v<=length+step+1;v++)
      {
-      if (!math::IsZero(from->Get(u,v)))
+      for (nat32 u=length-step-1;u<=length+step+1;u++)
       {
-       // Calculate the weights for the neighbours...
-        real32 weight[4];
-        weight[0] = l.Get(math::Clamp<int32>(bx+u+1,0,int32(l.Size(0)-1)),
-                          math::Clamp<int32>(by+v,0,int32(l.Size(1)-1)));
-        weight[1] = l.Get(math::Clamp<int32>(bx+u,0,int32(l.Size(0)-1)),
-                          math::Clamp<int32>(by+v+1,0,int32(l.Size(1)-1)));
-        weight[2] = l.Get(math::Clamp<int32>(bx+u-1,0,int32(l.Size(0)-1)),
-                          math::Clamp<int32>(by+v,0,int32(l.Size(1)-1)));
-        weight[3] = l.Get(math::Clamp<int32>(bx+u,0,int32(l.Size(0)-1)),
-                          math::Clamp<int32>(by+v-1,0,int32(l.Size(1)-1)));
-
-       // Modify by the exponential term...
-        for (nat32 i=0;i<4;i++) weight[i] = 0.0001 + math::Pow(weight[i],exp); // 0.001 to avoid div by zero.
-
-       // Normalise them by the weight from the from grid...
-        real32 sum = 0.0;
-        for (nat32 i=0;i<4;i++) sum += weight[i];
-        real32 mult = from->Get(u,v)/sum;
-        for (nat32 i=0;i<4;i++) weight[i] *= mult;
-
-       // Add them to the to grid...
-        to->Get(u+1,v) += weight[0];
-        to->Get(u,v+1) += weight[1];
-        to->Get(u-1,v) += weight[2];
-        to->Get(u,v-1) += weight[3];
+       dx += (real32(u)-real32(length)) * from->Get(u,v) * weight;
+       dy += (real32(v)-real32(length)) * from->Get(u,v) * weight;
       }
      }
     }
-
-   // Swap for the next pass...
-    math::Swap(from,to);
   }
 
 
- // Sum out the final mean direction...
-  dx = 0.0;
-  dy = 0.0;
-  for (int32 v=0;v<int32(from->Height());v++)
+ // Sum the gradiant vector from the field of probability values, to make sure the final sum is 1...
+  for (nat32 v=0;v<from->Height();v++)
   {
-   for (int32 u=0;u<int32(from->Width());u++)
+   for (nat32 u=0;u<from->Width();u++)
    {
-    dx += real32(u-int32(length)) * from->Get(u,v);
-    dy += real32(v-int32(length)) * from->Get(u,v);
+    dx += (real32(u)-real32(length)) * from->Get(u,v) * remains;
+    dy += (real32(v)-real32(length)) * from->Get(u,v) * remains;
    }
   }
 }
 
-cstrconst GradWalkSelect::TypeString() const
-{
- return "eos::filter::GradWalkSelect";
-}
-
 //------------------------------------------------------------------------------
  };
 };
@@ -40,6 +40,8 @@ namespace eos
 /// anyway the gradiants will be noisy, and cancel out, either in averaging or
 /// in doing lots of walks.
 /// Runtime of this algoirthm is O(pixel_count * walks * length), so can get slow very quick.
+/// The rows are done in parallel with mt::DefaultPool(), each with its own
+/// data::RandomStream, and the exponent is applied once per pixel up front.
 ///
 /// \param l The luminence map to calculate for.
 /// \param dx The x component of the gradiant output.
@@ -63,6 +65,7 @@ EOS_FUNC void GradWalk(const svt::Field<real32> & l,svt::Field<real32> & dx,svt:
 /// Has an extra parameter, stopChance, which is the chance of each walk
 /// stopping after each step. Having this set to something other than 0.0 will
 /// aleviate any horizon affects of the hard walk length.
+/// Implimented with GradWalkSelect::Run(), so is parallel.
 EOS_FUNC void GradWalkPerfect(const svt::Field<real32> & l,svt::Field<real32> & dx,svt::Field<real32> & dy,
                               nat32 length,real32 exp,real32 stopChance,
                               time::Progress * prog = null<time::Progress*>());
@@ -70,7 +73,11 @@ EOS_FUNC void GradWalkPerfect(const svt::Field<real32> & l,svt::Field<real32> &
 //------------------------------------------------------------------------------
 /// Object version of the GradWalkPerfect function for when you only want it for
 /// select pixels in an image - you give it the image and then query individual
-/// pixels to get an answer.
+/// pixels to get an answer. As the chance of a walk stepping in each direction
+/// only depends on where it is these are calculated once per input and set of
+/// parameters, for every position a walk can reach, so a query is then just
+/// the diffusion of the probabilities, with no clamping or powers. Run() does
+/// every pixel, in parallel.
 class EOS_CLASS GradWalkSelect
 {
  public:
@@ -84,12 +91,17 @@ class EOS_CLASS GradWalkSelect
   /// Sets the input.
    void SetInput(const svt::Field<real32> & l);
    
-  /// Sets the parameters.
-   void SetParas(nat32 length = 8,real32 exp = 6.0);
+  /// Sets the parameters, as for GradWalkPerfect.
+   void SetParas(nat32 length = 8,real32 exp = 6.0,real32 stopChance = 0.0);
 
   /// Given a coordinate outputs a gradiant direction, that points towards the light.
    void Query(nat32 x,nat32 y,real32 & dx,real32 & dy); 
 
+  /// Fills in the gradiant of every pixel, exactly as Query would, in parallel
+  /// over the rows with mt::DefaultPool(). dx and dy must be the size of the
+  /// input.
+   void Run(svt::Field<real32> & dx,svt::Field<real32> & dy,time::Progress * prog = null<time::Progress*>());
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -102,10 +114,25 @@ class EOS_CLASS GradWalkSelect
   // Parameters...
    nat32 length;
    real32 exp;
+   real32 stopChance;
+
+  // The chance of stepping in each direction from each position, in the usual
+  // +ve x, +ve y, -ve x, -ve y order. Position (x,y) is pixel (x-length,y-length),
+  // so it covers the whole area the walks can reach...
+   bit ready; // false if prob needs recalculating.
+   ds::Array2D<real32> prob[4];
    
   // Runtime...
    ds::Array2D<real32> bufA; // Buffers to store propagation values in - this class
    ds::Array2D<real32> bufB; // exists to avoid there repeated creation/destruction.  
+
+  // Fills in prob, if not ready...
+   void Prepare();
+
+  // Does the walk for a pixel, using the given buffers...
+   void Walk(nat32 x,nat32 y,ds::Array2D<real32> & bufA,ds::Array2D<real32> & bufB,real32 & dx,real32 & dy) const;
+
+  class RunRows;
 };
 
 //------------------------------------------------------------------------------
@@ -19,6 +19,8 @@
 
 #include "eos/svt/field.h"
 #include "eos/file/images.h"
+#include "eos/str/functions.h"
+#include "eos/filter/conversion.h"
 
 namespace eos
 {
@@ -148,6 +150,239 @@ EOS_FUNC bit SaveImage(const svt::Field<bs::ColourL> & in,cstrconst filename,bit
  return image.Save(filename,overwrite);
 }
 
+//------------------------------------------------------------------------------
+// Helper for LoadImage, gets the field ready in the Var and then fills it...
+template <typename T>
+inline void LoadImageField(svt::Var * var,str::Token name,const file::ImageBytes & image,bit planar)
+{
+ svt::Field<T> field;
+ bit sized = (var->Dims()==2)&&(var->Size(0)==image.Width())&&(var->Size(1)==image.Height());
+ if ((!sized)||(!var->ByName(name,field))||(var->Planar()!=planar))
+ {
+  if (!sized) var->Setup2D(image.Width(),image.Height());
+  if (!var->ByName(name,field))
+  {
+   T ini;
+   ini = bs::ColourRGB(0.0,0.0,0.0);
+   var->Add(name,ini);
+  }
+  var->SetPlanar(planar);
+  var->Commit(false);
+  var->ByName(name,field);
+ }
+
+ FromBytes(image.Row(0),image.Stride(),field);
+}
+
+EOS_FUNC svt::Var * LoadImage(svt::Core & core,cstrconst filename,ImageFormat format,
+                              cstrconst fieldname,svt::Var * reuse,bit planar)
+{
+ file::ImageBytes image;
+ if (!image.Load(filename)) return null<svt::Var*>();
+
+ if (fieldname==null<cstrconst>())
+ {
+  switch (format)
+  {
+   case FormatL: fieldname = "l"; break;
+   case FormatLuv: case FormatHalfLuv: fieldname = "luv"; break;
+   default: fieldname = "rgb"; break;
+  }
+ }
+
+ svt::Var * ret = reuse?reuse:new svt::Var(core);
+ str::Token name = core.GetTT()(fieldname);
+ switch (format)
+ {
+  case FormatByteRGB: LoadImageField<bs::ColRGB>(ret,name,image,planar); break;
+  case FormatRGB: LoadImageField<bs::ColourRGB>(ret,name,image,planar); break;
+  case FormatL: LoadImageField<bs::ColourL>(ret,name,image,planar); break;
+  case FormatLuv: LoadImageField<bs::ColourLuv>(ret,name,image,planar); break;
+  case FormatHalfRGB: LoadImageField<bs::ColourRGBh>(ret,name,image,planar); break;
+  case FormatHalfLuv: LoadImageField<bs::ColourLuvh>(ret,name,image,planar); break;
+ }
+
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// The task that loads a single image for ImageLoader...
+class ImageLoader::LoadTask : public mt::Task
+{
+ public:
+  LoadTask(ImageLoader & l,cstrconst fn)
+  :loader(l),filename(str::Duplicate(fn)),result(null<svt::Var*>()),done(0) {}
+
+  ~LoadTask() {mem::Free(filename);}
+
+  void Execute()
+  {
+   if (loader.rgb)
+   {
+    file::ImageRGB image;
+    if (image.Load(filename))
+    {
+     result = loader.GetVar(image.Width(),image.Height());
+     svt::Field<bs::ColourRGB> field;
+     result->ByName(loader.name,field);
+     for (nat32 y=0;y<image.Height();y++)
+     {
+      for (nat32 x=0;x<image.Width();x++) field.Get(x,y) = image.Get(x,y);
+     }
+    }
+   }
+   else
+   {
+    file::ImageL image;
+    if (image.Load(filename))
+    {
+     result = loader.GetVar(image.Width(),image.Height());
+     svt::Field<bs::ColourL> field;
+     result->ByName(loader.name,field);
+     for (nat32 y=0;y<image.Height();y++)
+     {
+      for (nat32 x=0;x<image.Width();x++) field.Get(x,y) = image.Get(x,y);
+     }
+    }
+   }
+   done.Set(1); // Must be last, as the task can be deleted the moment this is seen.
+  }
+
+  ImageLoader & loader;
+  cstr filename;
+  svt::Var * result;
+  mt::Atomic done;
+};
+
+//------------------------------------------------------------------------------
+ImageLoader::ImageLoader(svt::Core & c,bit r,cstrconst fieldname,nat32 a,mt::TaskPool & p)
+:core(c),rgb(r),ahead(a),pool(p),group(p)
+{
+ if (fieldname==null<cstrconst>()) fieldname = rgb?"rgb":"l";
+ name = core.GetTT()(fieldname);
+ type = core.GetTT()(rgb?typestring<bs::ColourRGB>():typestring<bs::ColourL>());
+ if (ahead==0) ahead = pool.Concurrency();
+}
+
+ImageLoader::~ImageLoader()
+{
+ group.Wait();
+
+ while (running.Size()!=0)
+ {
+  delete running.Front()->result;
+  delete running.Front();
+  running.RemFront();
+ }
+
+ while (waiting.Size()!=0)
+ {
+  delete waiting.Front();
+  waiting.RemFront();
+ }
+
+ while (spare.Size()!=0)
+ {
+  delete spare.Front();
+  spare.RemFront();
+ }
+}
+
+void ImageLoader::Add(cstrconst filename)
+{
+ waiting.AddBack(new LoadTask(*this,filename));
+ Start();
+}
+
+bit ImageLoader::Next(svt::Var *& out)
+{
+ Start();
+ if (running.Size()==0) return false;
+
+ // Wait for the front task, helping out whilst we do...
+  LoadTask * task = running.Front();
+  nat32 idle = 0;
+  while (task->done.Get()==0)
+  {
+   if (pool.RunOne()) idle = 0;
+   else
+   {
+    ++idle;
+    if (idle<64) mt::Sleep(0);
+            else mt::Sleep(1);
+   }
+  }
+
+ running.RemFront();
+ out = task->result;
+ delete task;
+
+ Start();
+ return true;
+}
+
+void ImageLoader::Recycle(svt::Var * var)
+{
+ if (var==null<svt::Var*>()) return;
+
+ // Keep no more than can be in use at once, throwing away the oldest...
+  svt::Var * victim = null<svt::Var*>();
+  spareLock.Lock();
+   spare.AddBack(var);
+   if (spare.Size()>ahead)
+   {
+    victim = spare.Front();
+    spare.RemFront();
+   }
+  spareLock.Unlock();
+  delete victim;
+}
+
+void ImageLoader::Start()
+{
+ while ((waiting.Size()!=0)&&(running.Size()<ahead))
+ {
+  LoadTask * task = waiting.Front();
+  waiting.RemFront();
+  running.AddBack(task);
+  group.Add(task);
+ }
+}
+
+svt::Var * ImageLoader::GetVar(nat32 width,nat32 height)
+{
+ // Look for a spare of the right size...
+  svt::Var * ret = null<svt::Var*>();
+  spareLock.Lock();
+   for (ds::List<svt::Var*>::Cursor targ = spare.FrontPtr();!targ.Bad();++targ)
+   {
+    if (((*targ)->Size(0)==width)&&((*targ)->Size(1)==height))
+    {
+     ret = *targ;
+     targ.RemNext();
+     break;
+    }
+   }
+  spareLock.Unlock();
+  if (ret) return ret;
+
+ // Otherwise make a new one...
+  ret = new svt::Var(core);
+  ret->Setup2D(width,height);
+  if (rgb)
+  {
+   bs::ColourRGB ini(0.0,0.0,0.0);
+   ret->Add(name,type,sizeof(ini),&ini);
+  }
+  else
+  {
+   bs::ColourL ini(0.0);
+   ret->Add(name,type,sizeof(ini),&ini);
+  }
+  ret->Commit(false);
+  return ret;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -25,10 +25,14 @@
 
 /// \file image_io.h
 /// Not really filters as such, just two methods to load images into and out of
-/// the svt type, for the conveniance of writting test applications.
+/// the svt type, for the conveniance of writting test applications. Also a
+/// loader for batches of images, that loads them in the background.
 
 #include "eos/types.h"#include "eos/svt/var.h"
 #include "eos/bs/colours.h"
+#include "eos/ds/lists.h"
+#include "eos/mt/locks.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -72,6 +76,99 @@ EOS_FUNC bit SaveImage(const svt::Field<bs::ColourRGB> & in,cstrconst filename,b
 /// Returns true on success, false on failure.
 EOS_FUNC bit SaveImage(const svt::Field<bs::ColourL> & in,cstrconst filename,bit overwrite = false);
 
+//------------------------------------------------------------------------------
+/// The formats LoadImage can produce, with the type of the field each gives.
+enum ImageFormat {FormatByteRGB, ///< bs::ColRGB, named "rgb" by default.
+                  FormatRGB,     ///< bs::ColourRGB, named "rgb" by default.
+                  FormatL,       ///< bs::ColourL, named "l" by default, as RGBtoL would give.
+                  FormatLuv,     ///< bs::ColourLuv, named "luv" by default, as RGBtoLuv would give.
+                  FormatHalfRGB, ///< bs::ColourRGBh, named "rgb" by default, half the memory of FormatRGB.
+                  FormatHalfLuv  ///< bs::ColourLuvh, named "luv" by default, half the memory of FormatLuv.
+                 };
+
+/// Loads an image straight into the given format, going from the bytes DevIL
+/// decoded to the field in one pass per row, with rows done in parallel,
+/// rather than loading a real rgb field and then converting it. If reuse is
+/// given the image goes into it rather than a new Var, for loading a sequence
+/// of frames without allocating each time - if it is already the right size
+/// with the field it is simply written over, otherwise it is resized, which
+/// wipes its other fields, and the field added. planar is passed to
+/// svt::Var::SetPlanar, and only matters if the Var has other fields. Returns
+/// the Var, or null if the file can't be loaded, in which case reuse is left
+/// alone.
+EOS_FUNC svt::Var * LoadImage(svt::Core & core,cstrconst filename,ImageFormat format,
+                              cstrconst fieldname = null<cstrconst>(),
+                              svt::Var * reuse = null<svt::Var*>(),bit planar = false);
+
+//------------------------------------------------------------------------------
+/// Loads a queue of images in the background, for batch jobs that iterate a
+/// dataset, so the next few images are being loaded whilst the current one is
+/// being processed. Each load is a task in a mt::TaskPool, with up to ahead of
+/// them in flight at once. DevIL has global state so the decoding itself is
+/// done one image at a time, but everything else - building the Var and
+/// converting the pixels into it - happens in parallel, and all of it happens
+/// whilst the caller is doing something else. Vars that have been finished with
+/// can be handed back with Recycle, to be reused for later images of the same
+/// size rather than allocating a new one each time. The Vars are as returned by
+/// LoadImageRGB or LoadImageL. Only for use by one thread at a time.
+class EOS_CLASS ImageLoader
+{
+ public:
+  /// If rgb is true the images are loaded as by LoadImageRGB, otherwise as by
+  /// LoadImageL, fieldname defaulting to the same. ahead is how many images
+  /// can be loading at once, 0 to match the concurrency of the pool.
+   ImageLoader(svt::Core & core,bit rgb = true,cstrconst fieldname = null<cstrconst>(),
+               nat32 ahead = 0,mt::TaskPool & pool = mt::DefaultPool());
+
+  /// Waits for any loads in progress, then deletes any Vars that have not been
+  /// collected, as well as the recycled ones.
+   ~ImageLoader();
+
+
+  /// Adds a file to the end of the queue, which will start loading straight
+  /// away if there is room. The filename is copied.
+   void Add(cstrconst filename);
+
+  /// Returns how many files have been added but not yet collected with Next.
+   nat32 Queued() const {return running.Size() + waiting.Size();}
+
+  /// Collects the image at the front of the queue, blocking until it has
+  /// loaded, running other tasks from the pool whilst it waits. Returns false
+  /// if the queue was empty, otherwise true with out set to the new Var, which
+  /// becomes the callers, or null if that file failed to load.
+   bit Next(svt::Var *& out);
+
+  /// Hands a Var back, for reuse. It must be one returned by Next, with its
+  /// field unchanged. Vars of a size that turns up again are reused, others
+  /// eventually deleted.
+   void Recycle(svt::Var * var);
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::filter::ImageLoader";}
+
+
+ private:
+  class LoadTask;
+
+  svt::Core & core;
+  bit rgb;
+  str::Token name; // Tokens are found here, as the core is not thread safe.
+  str::Token type;
+  nat32 ahead;
+  mt::TaskPool & pool;
+  mt::TaskGroup group;
+
+  ds::List<LoadTask*> running; // Given to the pool, in queue order.
+  ds::List<LoadTask*> waiting; // Still to be started.
+
+  mt::OwnedLock spareLock; // Protects spare, as the tasks take from it.
+  ds::List<svt::Var*> spare;
+
+  void Start(); // Moves tasks from waiting to running whilst there is room.
+  svt::Var * GetVar(nat32 width,nat32 height); // Called by tasks.
+};
+
 //------------------------------------------------------------------------------
  };
 };
@@ -0,0 +1,252 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos/filter/integral.h"
+
+#include "eos/mem/alloc.h"
+#include "eos/mt/tasks.h"
+
+namespace eos
+{
+ namespace filter
+ {
+//------------------------------------------------------------------------------
+// Gets the channels out of a pixel...
+static inline void Extract(const real32 & in,real64 * out)
+{
+ out[0] = in;
+}
+
+static inline void Extract(const bs::ColourRGB & in,real64 * out)
+{
+ out[0] = in.r; out[1] = in.g; out[2] = in.b;
+}
+
+static inline void Extract(const bs::ColourLuv & in,real64 * out)
+{
+ out[0] = in.l; out[1] = in.u; out[2] = in.v;
+}
+
+// Construction is two passes - first each row becomes a running sum, with the
+// rows split between threads, then the columns are summed down, with bands of
+// columns split between threads. The additions happen in the same order
+// regardless of how the work is split, so the result does not depend on the
+// thread count...
+template <typename T>
+class Integral::Rows
+{
+ public:
+  Rows(const svt::Field<T> & i,Integral & s):in(i),self(s) {}
+
+  void Run() {mt::ParallelFor(0,self.height,*this,16);}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 ch = self.channels;
+   nat32 stride = (self.width+1)*ch;
+   real64 val[3] = {0.0,0.0,0.0};
+   for (nat32 y=begin;y<end;y++)
+   {
+    real64 * s = self.sum + (y+1)*stride;
+    real64 * q = self.sq ? (self.sq + (y+1)*stride) : null<real64*>();
+    for (nat32 c=0;c<ch;c++) s[c] = 0.0;
+    if (q) {for (nat32 c=0;c<ch;c++) q[c] = 0.0;}
+
+    for (nat32 x=0;x<self.width;x++)
+    {
+     Extract(in.Get(x,y),val);
+     for (nat32 c=0;c<ch;c++) s[ch+c] = s[c] + val[c];
+     s += ch;
+     if (q)
+     {
+      for (nat32 c=0;c<ch;c++) q[ch+c] = q[c] + val[c]*val[c];
+      q += ch;
+     }
+    }
+   }
+  }
+
+ private:
+  const svt::Field<T> & in;
+  Integral & self;
+};
+
+class Integral::Columns
+{
+ public:
+  Columns(Integral & s):self(s),stride((s.width+1)*s.channels) {}
+
+  void Run() {mt::ParallelFor(0,stride,*this,256);}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   Down(self.sum,begin,end);
+   if (self.sq) Down(self.sq,begin,end);
+  }
+
+ private:
+  Integral & self;
+  nat32 stride;
+
+  void Down(real64 * t,nat32 begin,nat32 end) const
+  {
+   for (nat32 y=2;y<=self.height;y++)
+   {
+    const real64 * prev = t + (y-1)*stride;
+    real64 * targ = t + y*stride;
+    for (nat32 i=begin;i<end;i++) targ[i] += prev[i];
+   }
+  }
+};
+
+//------------------------------------------------------------------------------
+Integral::Integral()
+:width(0),height(0),channels(0),sum(null<real64*>()),sq(null<real64*>())
+{}
+
+Integral::~Integral()
+{
+ mem::Free(sum);
+ mem::Free(sq);
+}
+
+void Integral::Set(const svt::Field<real32> & in,bit squares)
+{
+ Make(in,1,squares);
+}
+
+void Integral::Set(const svt::Field<bs::ColourRGB> & in,bit squares)
+{
+ Make(in,3,squares);
+}
+
+void Integral::Set(const svt::Field<bs::ColourLuv> & in,bit squares)
+{
+ Make(in,3,squares);
+}
+
+nat32 Integral::Count(int32 x0,int32 y0,int32 x1,int32 y1) const
+{
+ if (!Clamp(x0,y0,x1,y1)) return 0;
+ return nat32(x1-x0+1)*nat32(y1-y0+1);
+}
+
+real64 Integral::Mean(int32 x0,int32 y0,int32 x1,int32 y1,nat32 ch) const
+{
+ if (!Clamp(x0,y0,x1,y1)) return 0.0;
+ return Corners(sum,x0,y0,x1,y1,ch)/(real64(x1-x0+1)*real64(y1-y0+1));
+}
+
+real64 Integral::Variance(int32 x0,int32 y0,int32 x1,int32 y1,nat32 ch) const
+{
+ if (!Clamp(x0,y0,x1,y1)) return 0.0;
+ real64 n = real64(x1-x0+1)*real64(y1-y0+1);
+ real64 mean = Corners(sum,x0,y0,x1,y1,ch)/n;
+ real64 ret = Corners(sq,x0,y0,x1,y1,ch)/n - mean*mean;
+ return (ret<0.0)?0.0:ret; // Rounding can take it just below.
+}
+
+nat32 Integral::SumAll(int32 x0,int32 y0,int32 x1,int32 y1,real64 * out) const
+{
+ if (!Clamp(x0,y0,x1,y1))
+ {
+  for (nat32 c=0;c<channels;c++) out[c] = 0.0;
+  return 0;
+ }
+
+ for (nat32 c=0;c<channels;c++) out[c] = Corners(sum,x0,y0,x1,y1,c);
+ return nat32(x1-x0+1)*nat32(y1-y0+1);
+}
+
+template <typename T>
+void Integral::Make(const svt::Field<T> & in,nat32 c,bit squares)
+{
+ // (Re)allocate if needed...
+  nat32 w = in.Size(0);
+  nat32 h = in.Size(1);
+  nat32 size = (w+1)*(h+1)*c;
+  if ((w!=width)||(h!=height)||(c!=channels)||(sum==null<real64*>()))
+  {
+   mem::Free(sum);
+   mem::Free(sq);
+   sq = null<real64*>();
+   width = w;
+   height = h;
+   channels = c;
+   sum = mem::Malloc<real64>(size);
+  }
+
+  if (squares)
+  {
+   if (sq==null<real64*>()) sq = mem::Malloc<real64>(size);
+  }
+  else
+  {
+   mem::Free(sq);
+   sq = null<real64*>();
+  }
+
+ // The zero row at the top...
+  nat32 stride = (width+1)*channels;
+  for (nat32 i=0;i<stride;i++) sum[i] = 0.0;
+  if (sq) {for (nat32 i=0;i<stride;i++) sq[i] = 0.0;}
+
+ // The two passes...
+  Rows<T> rows(in,*this);
+  rows.Run();
+
+  Columns cols(*this);
+  cols.Run();
+}
+
+//------------------------------------------------------------------------------
+// Writes the box means of a range of rows...
+class BoxRows
+{
+ public:
+  BoxRows(const Integral & t,int32 r,svt::Field<real32> & o):table(t),radius(r),out(o) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<out.Size(0);x++)
+    {
+     out.Get(x,y) = table.Mean(int32(x)-radius,int32(y)-radius,int32(x)+radius,int32(y)+radius);
+    }
+   }
+  }
+
+ private:
+  const Integral & table;
+  int32 radius;
+  svt::Field<real32> & out;
+};
+
+EOS_FUNC void BoxFilter(const svt::Field<real32> & in,nat32 radius,svt::Field<real32> & out)
+{
+ Integral table;
+ table.Set(in);
+
+ BoxRows rows(table,int32(radius),out);
+ mt::ParallelFor(0,out.Size(1),rows,16);
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,158 @@
+#ifndef EOS_FILTER_INTEGRAL_H
+#define EOS_FILTER_INTEGRAL_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+/// \file integral.h
+/// Provides a summed area table, aka integral image, so the sum of any box in
+/// an image can be obtained in constant time regardless of its size.
+
+#include "eos/types.h"
+#include "eos/svt/field.h"
+#include "eos/bs/colours.h"
+
+namespace eos
+{
+ namespace filter
+ {
+//------------------------------------------------------------------------------
+/// A summed area table over a 2D field, with any number of channels. Once built
+/// the sum, mean or variance of any axis aligned box can be found in constant
+/// time, so box windows of any radius cost the same. Accumulation is done in
+/// real64, which for images of real32 in any sane range is exact enough that
+/// the difference of four corners does not suffer from the catastrophic
+/// cancellation a real32 table would. Optionally a second table of squares is
+/// kept, so variance can also be had in constant time. Construction is
+/// threaded, rows first then bands of columns.
+/// All coordinates given to the queries are inclusive and clamped to the
+/// image, so windows that hang off the edge just sum the part inside.
+class EOS_CLASS Integral
+{
+ public:
+  /// &nbsp;
+   Integral();
+
+  /// &nbsp;
+   ~Integral();
+
+
+  /// Builds from a real field, if squares is true the table of squares is also
+  /// built, so Variance can be used. Can be called repeatedly, memory is only
+  /// reallocated if the size changes.
+   void Set(const svt::Field<real32> & in,bit squares = false);
+
+  /// Builds from a colour field, 3 channels, in r,g,b order.
+   void Set(const svt::Field<bs::ColourRGB> & in,bit squares = false);
+
+  /// Builds from a colour field, 3 channels, in l,u,v order.
+   void Set(const svt::Field<bs::ColourLuv> & in,bit squares = false);
+
+
+  /// &nbsp;
+   nat32 Width() const {return width;}
+
+  /// &nbsp;
+   nat32 Height() const {return height;}
+
+  /// &nbsp;
+   nat32 Channels() const {return channels;}
+
+  /// Returns true if the squares table was built.
+   bit Squares() const {return sq!=null<real64*>();}
+
+
+  /// Returns how many pixels are in the given box, after clamping.
+   nat32 Count(int32 x0,int32 y0,int32 x1,int32 y1) const;
+
+  /// Returns the sum of the given channel over the box, inclusive coordinates,
+  /// clamped to the image. Returns 0 for boxes entirly outside.
+   real64 Sum(int32 x0,int32 y0,int32 x1,int32 y1,nat32 ch = 0) const
+   {
+    if (!Clamp(x0,y0,x1,y1)) return 0.0;
+    return Corners(sum,x0,y0,x1,y1,ch);
+   }
+
+  /// Returns the sum of squares of the given channel over the box, only valid
+  /// if built with squares.
+   real64 SumSqr(int32 x0,int32 y0,int32 x1,int32 y1,nat32 ch = 0) const
+   {
+    if (!Clamp(x0,y0,x1,y1)) return 0.0;
+    return Corners(sq,x0,y0,x1,y1,ch);
+   }
+
+  /// Returns the mean of the given channel over the box, 0 if its empty.
+   real64 Mean(int32 x0,int32 y0,int32 x1,int32 y1,nat32 ch = 0) const;
+
+  /// Returns the variance of the given channel over the box, only valid if
+  /// built with squares. 0 if the box is empty.
+   real64 Variance(int32 x0,int32 y0,int32 x1,int32 y1,nat32 ch = 0) const;
+
+  /// Outputs the sum of every channel of the box into out, which must have
+  /// Channels() entrys. Returns the pixel count.
+   nat32 SumAll(int32 x0,int32 y0,int32 x1,int32 y1,real64 * out) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::filter::Integral";}
+
+
+ private:
+  nat32 width;
+  nat32 height;
+  nat32 channels;
+
+  // Tables are (width+1)*(height+1)*channels, with a zero row and column at the
+  // start so queries need no special cases, channels interleaved...
+   real64 * sum;
+   real64 * sq;
+
+  template <typename T> class Rows;
+  class Columns;
+
+  template <typename T>
+  void Make(const svt::Field<T> & in,nat32 c,bit squares);
+
+  bit Clamp(int32 & x0,int32 & y0,int32 & x1,int32 & y1) const
+  {
+   if (x0<0) x0 = 0;
+   if (y0<0) y0 = 0;
+   if (x1>=int32(width)) x1 = int32(width)-1;
+   if (y1>=int32(height)) y1 = int32(height)-1;
+   return (x0<=x1)&&(y0<=y1);
+  }
+
+  real64 Corners(const real64 * t,int32 x0,int32 y0,int32 x1,int32 y1,nat32 ch) const
+  {
+   nat32 stride = (width+1)*channels;
+   const real64 * top = t + nat32(y0)*stride + ch;
+   const real64 * bot = t + nat32(y1+1)*stride + ch;
+   return bot[(x1+1)*channels] - bot[x0*channels] - top[(x1+1)*channels] + top[x0*channels];
+  }
+};
+
+//------------------------------------------------------------------------------
+/// Box filters the given field using an Integral, i.e. each pixel of out is the
+/// mean of the (2*radius+1)^2 window centred on it, clamped to the image. Cost
+/// is independent of radius. in and out can be the same field.
+EOS_FUNC void BoxFilter(const svt::Field<real32> & in,nat32 radius,svt::Field<real32> & out);
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
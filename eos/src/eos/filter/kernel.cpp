@@ -19,11 +19,279 @@
 
 #include "eos/math/constants.h"
 #include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE__
+ #include <xmmintrin.h>
+#endif
 
 namespace eos
 {
  namespace filter
  {
+//-----------------------------------------------------------------------------
+// The convolution engine that sits behind the kernels. Pixels of type T are
+// treated as interleaved channels of type Channel<T>::Type, so colours are 
+// done in the same pass as greyscale. Whatever the storage the work is done in
+// real32, rows being converted on the way in and out...
+template <typename T>
+struct Channel
+{
+ typedef real32 Type;
+ static const nat32 count = sizeof(T)/sizeof(real32);
+};
+
+template <> struct Channel<math::Half> {typedef math::Half Type; static const nat32 count = 1;};
+template <> struct Channel<bs::ColourRGBh> {typedef math::Half Type; static const nat32 count = 3;};
+template <> struct Channel<bs::ColourLuvh> {typedef math::Half Type; static const nat32 count = 3;};
+
+// out[i] += k*in[i] for i in [0,n)...
+static inline void MulAdd(real32 * out,const real32 * in,real32 k,nat32 n)
+{
+ nat32 i = 0;
+ #ifdef __SSE__
+  __m128 kk = _mm_set1_ps(k);
+  for (;i+4<=n;i+=4)
+  {
+   _mm_storeu_ps(out+i,_mm_add_ps(_mm_loadu_ps(out+i),_mm_mul_ps(kk,_mm_loadu_ps(in+i))));
+  }
+ #endif
+ for (;i<n;i++) out[i] += k*in[i];
+}
+
+// Copys row y of a field into a buffer, leaving pad pixels either side which
+// are either zero or repetitions of the end pixels...
+template <typename T>
+static void PadRow(const svt::Field<T> & in,nat32 y,nat32 pad,bit repeat,real32 * row)
+{
+ typedef typename Channel<T>::Type E;
+ static const nat32 channels = Channel<T>::count;
+ nat32 width = in.Size(0);
+
+ real32 * targ = row + pad*channels;
+ if (in.Stride(0)==sizeof(T))
+ {
+  math::Convert((const E*)(const void*)&in.Get(0,y),targ,width*channels);
+  targ += width*channels;
+ }
+ else
+ {
+  for (nat32 x=0;x<width;x++)
+  {
+   math::Convert((const E*)(const void*)&in.Get(x,y),targ,channels);
+   targ += channels;
+  }
+ }
+
+ for (nat32 i=0;i<pad*channels;i++)
+ {
+  if (repeat)
+  {
+   row[i] = row[pad*channels + i%channels];
+   targ[i] = targ[int32(i%channels) - int32(channels)];
+  }
+  else
+  {
+   row[i] = 0.0;
+   targ[i] = 0.0;
+  }
+ }
+}
+
+// Writes a row of interleaved channels into a field, zeroing the first and
+// last zero pixels...
+template <typename T>
+static void WriteRow(svt::Field<T> & out,nat32 y,nat32 zero,const real32 * row)
+{
+ typedef typename Channel<T>::Type E;
+ static const nat32 channels = Channel<T>::count;
+ nat32 width = out.Size(0);
+
+ for (nat32 x=0;x<width;x++)
+ {
+  E * v = (E*)(void*)&out.Get(x,y);
+  if ((x<zero)||(x+zero>=width))
+  {
+   for (nat32 c=0;c<channels;c++) v[c] = 0.0;
+  }
+  else
+  {
+   if ((out.Stride(0)==sizeof(T))&&(x+zero<width))
+   {
+    // Tightly packed, so the rest of the row up to the zeroed end can go in
+    // one conversion...
+     nat32 run = width - zero - x;
+     math::Convert(row + x*channels,v,run*channels);
+     x += run - 1;
+   }
+   else math::Convert(row + x*channels,v,channels);
+  }
+ }
+}
+
+// A separable convolution, a horizontal pass into an intermediate image
+// followed by a vertical pass out of it, each spread over the thread pool by
+// rows. As the input is entirly consumed before the output is written they
+// can be the same field. In zero mode everything within half of the edge is
+// set to zero, otherwise border pixels are repeated...
+template <typename T>
+class SepConv
+{
+ public:
+  static const nat32 channels = Channel<T>::count;
+
+  SepConv(const svt::Field<T> & i,svt::Field<T> & o,nat32 hf,const real32 * hk,const real32 * vk,bit r)
+  :in(i),out(o),half(hf),h(hk),v(vk),repeat(r),width(o.Size(0)),height(o.Size(1))
+  {}
+
+  void Run()
+  {
+   im = new real32[width*height*channels];
+    vertical = false;
+    mt::ParallelFor(0,height,*this,8);
+    vertical = true;
+    mt::ParallelFor(0,height,*this,8);
+   delete[] im;
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   if (vertical)
+   {
+    real32 * acc = new real32[width*channels];
+    for (nat32 y=begin;y<end;y++)
+    {
+     for (nat32 i=0;i<width*channels;i++) acc[i] = 0.0;
+     if (repeat||((y>=half)&&(y+half<height)))
+     {
+      for (nat32 i=0;i<half*2+1;i++)
+      {
+       if (math::IsZero(v[i])) continue;
+       int32 yy = math::Clamp<int32>(int32(y+i)-int32(half),0,height-1);
+       MulAdd(acc,im + yy*width*channels,v[i],width*channels);
+      }
+     }
+     WriteRow(out,y,repeat?0:half,acc);
+    }
+    delete[] acc;
+   }
+   else
+   {
+    real32 * row = new real32[(width+half*2)*channels];
+    for (nat32 y=begin;y<end;y++)
+    {
+     PadRow(in,y,half,repeat,row);
+     real32 * targ = im + y*width*channels;
+     for (nat32 i=0;i<width*channels;i++) targ[i] = 0.0;
+     for (nat32 i=0;i<half*2+1;i++)
+     {
+      if (!math::IsZero(h[i])) MulAdd(targ,row + i*channels,h[i],width*channels);
+     }
+    }
+    delete[] row;
+   }
+  }
+
+
+ private:
+  const svt::Field<T> & in;
+  svt::Field<T> & out;
+  nat32 half;
+  const real32 * h;
+  const real32 * v;
+  bit repeat;
+
+  nat32 width;
+  nat32 height;
+  real32 * im;
+  bit vertical;
+};
+
+// A full 2D convolution, for kernels that are not separable. The input is
+// copied into a padded image first, so again in and out can be the same. 
+// Always in zero mode...
+template <typename T>
+class MatConv
+{
+ public:
+  static const nat32 channels = Channel<T>::count;
+
+  MatConv(const svt::Field<T> & i,svt::Field<T> & o,nat32 hf,const real32 * k)
+  :in(i),out(o),half(hf),kernel(k),width(o.Size(0)),height(o.Size(1)),copy(false)
+  {}
+
+  void Run()
+  {
+   im = new real32[(width+half*2)*height*channels];
+    copy = true;
+    mt::ParallelFor(0,height,*this,8);
+    copy = false;
+    mt::ParallelFor(0,height,*this,8);
+   delete[] im;
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 rowSize = (width+half*2)*channels;
+   if (copy)
+   {
+    for (nat32 y=begin;y<end;y++) PadRow(in,y,half,false,im + y*rowSize);
+   }
+   else
+   {
+    nat32 k = half*2 + 1;
+    real32 * acc = new real32[width*channels];
+    for (nat32 y=begin;y<end;y++)
+    {
+     for (nat32 i=0;i<width*channels;i++) acc[i] = 0.0;
+     if ((y>=half)&&(y+half<height))
+     {
+      for (nat32 v=0;v<k;v++)
+      {
+       const real32 * row = im + (y+v-half)*rowSize;
+       for (nat32 u=0;u<k;u++)
+       {
+        real32 w = kernel[v*k + u];
+        if (!math::IsZero(w)) MulAdd(acc,row + u*channels,w,width*channels);
+       }
+      }
+     }
+     WriteRow(out,y,half,acc);
+    }
+    delete[] acc;
+   }
+  }
+
+
+ private:
+  const svt::Field<T> & in;
+  svt::Field<T> & out;
+  nat32 half;
+  const real32 * kernel;
+
+  nat32 width;
+  nat32 height;
+  real32 * im;
+  bit copy;
+};
+
+// Applies a KernelMat, switching to the separable version if it can...
+template <typename T>
+static void ApplyMat(const KernelMat & kernel,const real32 * data,const svt::Field<T> & in,svt::Field<T> & out)
+{
+ KernelVect sep;
+ if (kernel.Separable(sep))
+ {
+  SepConv<T> conv(in,out,sep.HalfSize(),&sep.ValH(-int32(sep.HalfSize())),&sep.ValV(-int32(sep.HalfSize())),false);
+  conv.Run();
+ }
+ else
+ {
+  MatConv<T> conv(in,out,kernel.HalfSize(),data);
+  conv.Run();
+ }
+}
+
 //-----------------------------------------------------------------------------
 KernelMat & KernelMat::operator = (const KernelMat & rhs)
 {
@@ -60,42 +328,69 @@ real32 & KernelMat::Val(int32 x,int32 y)
 
 void KernelMat::Apply(const svt::Field<real32> & in,svt::Field<real32> & out) const
 {
- // First do the borders, set them all to zero...
-  for (nat32 y=0;y<half;y++)
-  {
-   for (nat32 x=0;x<out.Size(0);x++) out.Get(x,y) = 0.0;
-  }
-  for (nat32 y=out.Size(1)-half;y<out.Size(1);y++)
-  {
-   for (nat32 x=0;x<out.Size(0);x++) out.Get(x,y) = 0.0;
-  }
-  for (nat32 y=half;y<out.Size(1)-half;y++)
+ ApplyMat(*this,data,in,out);
+}
+
+void KernelMat::Apply(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGB> & out) const
+{
+ ApplyMat(*this,data,in,out);
+}
+
+void KernelMat::Apply(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuv> & out) const
+{
+ ApplyMat(*this,data,in,out);
+}
+
+void KernelMat::Apply(const svt::Field<math::Half> & in,svt::Field<math::Half> & out) const
+{
+ ApplyMat(*this,data,in,out);
+}
+
+void KernelMat::Apply(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGBh> & out) const
+{
+ ApplyMat(*this,data,in,out);
+}
+
+void KernelMat::Apply(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuvh> & out) const
+{
+ ApplyMat(*this,data,in,out);
+}
+
+bit KernelMat::Separable(KernelVect & out,real32 tolerance) const
+{
+ // Find the largest magnitude entry, its row and column give the vectors...
+  nat32 width = half*2 + 1;
+  nat32 best = 0;
+  for (nat32 i=1;i<width*width;i++)
   {
-   for (nat32 x=0;x<half;x++) out.Get(x,y) = 0.0;
-   for (nat32 x=out.Size(0)-half;x<out.Size(0);x++) out.Get(x,y) = 0.0;
+   if (math::Abs(data[i])>math::Abs(data[best])) best = i;
   }
 
- // Some values...
-  int32 width = half*2 + 1;
-  real32 * centre = data + (width+1)*half;
+  real32 peak = data[best];
+  if (math::IsZero(peak)) return false;
+  nat32 bx = best%width;
+  nat32 by = best/width;
 
- // Then the hard work, calculate with brute force the solution for the soft
- // juicy centre...
-  for (nat32 y=half;y<out.Size(1)-half;y++)
+ // Check that every entry matches the product...
+  real32 limit = tolerance*math::Abs(peak);
+  for (nat32 v=0;v<width;v++)
   {
-   for (nat32 x=half;x<out.Size(0)-half;x++)
+   for (nat32 u=0;u<width;u++)
    {
-    real32 o = 0.0;
-     for (int32 v = -half;v<=int32(half);v++)
-     {
-      for (int32 u = -half;u<=int32(half);u++)
-      {
-       o += centre[width*v + u]*in.Get(x+u,y+v);
-      }
-     }
-    out.Get(x,y) = o;
+    real32 prod = data[by*width + u]*data[v*width + bx]/peak;
+    if (math::Abs(data[v*width + u] - prod)>limit) return false;
    }
   }
+
+ // Its separable - output...
+  out.SetSize(half);
+  for (nat32 i=0;i<width;i++)
+  {
+   out.ValH(int32(i)-int32(half)) = data[by*width + i];
+   out.ValV(int32(i)-int32(half)) = data[i*width + bx]/peak;
+  }
+
+ return true;
 }
 
 void KernelMat::MakeIdeal(real32 angle)
@@ -252,100 +547,74 @@ void KernelVect::ConvertTo(KernelMat & out) const
 
 void KernelVect::Apply(const svt::Field<real32> & in,svt::Field<real32> & out,bit transpose) const
 {
- nat32 width = out.Size(0);
- nat32 height = out.Size(1); // Now create the intermediate data structure...
- // We transpose the data when writting out to it, reading back from it, as this
- // creates for better cache access behaviour.
-  real32 * im = new real32[width*height];
-
- // Do the first pass - calculate on the x...
-  real32 * t = a;
-  if (transpose) t = b;
-  for (nat32 y=0;y<height;y++)
-  {
-   for (nat32 x=0;x<half;x++) im[x*height + y] = 0.0;
-   for (nat32 x=half;x<width-half;x++)
-   {
-    real32 o = 0.0;
-    for (int32 i=-half;i<=int32(half);i++)
-    {
-     o += in.Get(x+i,y)*t[i+half];
-    }
-    im[x*height + y] = o;
-   }
-   for (nat32 x=width-half;x<width;x++) im[x*height + y] = 0.0;
-  }
+ SepConv<real32> conv(in,out,half,transpose?b:a,transpose?a:b,false);
+ conv.Run();
+}
 
- // Do the second pass - calculate on the y, except its the x because of the transpose...
-  t = b;
-  if (transpose) t = a;
-  for (nat32 y=0;y<half;y++)
-  {
-   for (nat32 x=0;x<width;x++) out.Get(x,y) = 0.0;
-  }
-  for (nat32 y=half;y<height-half;y++)
-  {
-   for (nat32 x=0;x<width;x++)
-   {
-    real32 o = 0.0;
-    for (int32 i=-half;i<=int32(half);i++)
-    {
-     o += im[x*height + y+i]*t[i+half];
-    }
-    out.Get(x,y) = o;
-   }
-  }
-  for (nat32 y=height-half;y<height;y++)
-  {
-   for (nat32 x=0;x<width;x++) out.Get(x,y) = 0.0;
-  }  
+void KernelVect::Apply(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGB> & out,bit transpose) const
+{
+ SepConv<bs::ColourRGB> conv(in,out,half,transpose?b:a,transpose?a:b,false);
+ conv.Run();
+}
 
- // Clean up...
-  delete[] im;
+void KernelVect::Apply(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuv> & out,bit transpose) const
+{
+ SepConv<bs::ColourLuv> conv(in,out,half,transpose?b:a,transpose?a:b,false);
+ conv.Run();
+}
+
+void KernelVect::Apply(const svt::Field<math::Half> & in,svt::Field<math::Half> & out,bit transpose) const
+{
+ SepConv<math::Half> conv(in,out,half,transpose?b:a,transpose?a:b,false);
+ conv.Run();
+}
+
+void KernelVect::Apply(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGBh> & out,bit transpose) const
+{
+ SepConv<bs::ColourRGBh> conv(in,out,half,transpose?b:a,transpose?a:b,false);
+ conv.Run();
+}
+
+void KernelVect::Apply(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuvh> & out,bit transpose) const
+{
+ SepConv<bs::ColourLuvh> conv(in,out,half,transpose?b:a,transpose?a:b,false);
+ conv.Run();
 }
 
 void KernelVect::ApplyRepeat(const svt::Field<real32> & in,svt::Field<real32> & out,bit transpose) const
 {
- int32 width = out.Size(0);
- int32 height = out.Size(1); // Now create the intermediate data structure...
- // We transpose the data when writting out to it, reading back from it, as this
- // creates for better cache access behaviour.
-  real32 * im = new real32[width*height];
+ SepConv<real32> conv(in,out,half,transpose?b:a,transpose?a:b,true);
+ conv.Run();
+}
+
+void KernelVect::ApplyRepeat(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGB> & out,bit transpose) const
+{
+ SepConv<bs::ColourRGB> conv(in,out,half,transpose?b:a,transpose?a:b,true);
+ conv.Run();
+}
 
- // Do the first pass - calculate on the x...
-  real32 * t = a;
-  if (transpose) t = b;
-  for (int32 y=0;y<height;y++)
-  {
-   for (int32 x=0;x<width;x++)
-   {
-    real32 o = 0.0;
-    for (int32 i=-half;i<=int32(half);i++)
-    {
-     o += in.Get(math::Clamp<int32>(x+i,0,width),y)*t[i+half];
-    }
-    im[x*height + y] = o;
-   }
-  }
+void KernelVect::ApplyRepeat(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuv> & out,bit transpose) const
+{
+ SepConv<bs::ColourLuv> conv(in,out,half,transpose?b:a,transpose?a:b,true);
+ conv.Run();
+}
 
- // Do the second pass - calculate on the y, except its the x because of the transpose...
-  t = b;
-  if (transpose) t = a;
-  for (int32 y=0;y<height;y++)
-  {
-   for (int32 x=0;x<width;x++)
-   {
-    real32 o = 0.0;
-    for (int32 i=-half;i<=int32(half);i++)
-    {
-     o += im[x*height + math::Clamp<int32>(y+i,0,height)]*t[i+half];
-    }
-    out.Get(x,y) = o;
-   }
-  }
+void KernelVect::ApplyRepeat(const svt::Field<math::Half> & in,svt::Field<math::Half> & out,bit transpose) const
+{
+ SepConv<math::Half> conv(in,out,half,transpose?b:a,transpose?a:b,true);
+ conv.Run();
+}
 
- // Clean up...
-  delete[] im;
+void KernelVect::ApplyRepeat(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGBh> & out,bit transpose) const
+{
+ SepConv<bs::ColourRGBh> conv(in,out,half,transpose?b:a,transpose?a:b,true);
+ conv.Run();
+}
+
+void KernelVect::ApplyRepeat(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuvh> & out,bit transpose) const
+{
+ SepConv<bs::ColourLuvh> conv(in,out,half,transpose?b:a,transpose?a:b,true);
+ conv.Run();
 }
 
 void KernelVect::MakeGaussian(real32 sd)
@@ -20,20 +20,31 @@
 
 /// \file kernel.h
 /// Simply provides methods to apply kernells to data sets, used to impliment
-/// things such as gaussian blurs.
+/// things such as gaussian blurs. The application is done a row at a time,
+/// with each row copied into a padded buffer so the borders need no special
+/// casing, using SSE where avaliable and spreading the rows over the default
+/// mt::TaskPool. Separable kernels are done as a horizontal then a vertical 
+/// pass, whichever class they are given as. As well as real32 fields ColourRGB
+/// and ColourLuv fields can be filtered, each channel being done in the same
+/// pass.
 
 #include "eos/types.h"
 #include "eos/svt/var.h"
 #include "eos/svt/field.h"
 #include "eos/mem/alloc.h"
+#include "eos/bs/colours.h"
 
 namespace eos
 {
  namespace filter
  {
+//------------------------------------------------------------------------------
+class KernelVect;
+
 //------------------------------------------------------------------------------
 /// This represents a kernel as an arbitary matrix, with the ability to apply 
-/// it. Quite slow.
+/// it. Slow, unless the kernel happens to be separable, in which case it is 
+/// detected and applied as fast as a KernelVect.
 class EOS_CLASS KernelMat
 {
  public:
@@ -70,8 +81,30 @@ class EOS_CLASS KernelMat
 
   /// Applys the kernel to the 2D input and writes it to the same-property output,
   /// all values within half of the edge will be set to 0. The input and output 
-  /// fields must not be identical.
+  /// fields can be identical.
    void Apply(const svt::Field<real32> & in,svt::Field<real32> & out) const;
+
+  /// Applys the kernel to each channel of a colour image.
+   void Apply(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGB> & out) const;
+
+  /// Applys the kernel to each channel of a colour image.
+   void Apply(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuv> & out) const;
+
+  /// As for the real32 version, with half precision storage at both ends; the
+  /// work is done in real32.
+   void Apply(const svt::Field<math::Half> & in,svt::Field<math::Half> & out) const;
+
+  /// &nbsp;
+   void Apply(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGBh> & out) const;
+
+  /// &nbsp;
+   void Apply(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuvh> & out) const;
+
+
+  /// Returns true if the kernel is separable, i.e. if it can be represented
+  /// as a KernelVect, in which case it also writes the KernelVect to out.
+  /// tolerance is relative to the largest magnitude entry.
+   bit Separable(KernelVect & out,real32 tolerance = 1e-5) const;
    
    
   /// Replaces the current kernel with an ideal kernel, defined as a a kernel where one
@@ -154,9 +187,40 @@ class EOS_CLASS KernelVect
   /// Does not handle boundary conditions, simply sets them to zero.
    void Apply(const svt::Field<real32> & in,svt::Field<real32> & out,bit transpose = false) const;
    
+  /// Applys the kernel to each channel of a colour image.
+   void Apply(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGB> & out,bit transpose = false) const;
+
+  /// Applys the kernel to each channel of a colour image.
+   void Apply(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuv> & out,bit transpose = false) const;
+
+  /// As for the real32 version, with half precision storage at both ends; the
+  /// work is done in real32.
+   void Apply(const svt::Field<math::Half> & in,svt::Field<math::Half> & out,bit transpose = false) const;
+
+  /// &nbsp;
+   void Apply(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGBh> & out,bit transpose = false) const;
+
+  /// &nbsp;
+   void Apply(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuvh> & out,bit transpose = false) const;
+
   /// Identical to Apply, except it uses repetition of border values to work right 
   /// upto the boundary, rather than setting it to zero.
    void ApplyRepeat(const svt::Field<real32> & in,svt::Field<real32> & out,bit transpose = false) const;
+
+  /// Applys the kernel to each channel of a colour image, repeating border values.
+   void ApplyRepeat(const svt::Field<bs::ColourRGB> & in,svt::Field<bs::ColourRGB> & out,bit transpose = false) const;
+
+  /// Applys the kernel to each channel of a colour image, repeating border values.
+   void ApplyRepeat(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuv> & out,bit transpose = false) const;
+
+  /// As for the real32 version, with half precision storage at both ends.
+   void ApplyRepeat(const svt::Field<math::Half> & in,svt::Field<math::Half> & out,bit transpose = false) const;
+
+  /// &nbsp;
+   void ApplyRepeat(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGBh> & out,bit transpose = false) const;
+
+  /// &nbsp;
+   void ApplyRepeat(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuvh> & out,bit transpose = false) const;
    
   /// Replaces the current kernel with a gaussian, defined by the given standard 
   /// deviation. Does not change the kernel size, thats the users job.
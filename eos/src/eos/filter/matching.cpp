@@ -19,151 +19,171 @@
 
 #include "eos/filter/conversion.h"
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace filter
  {
 //------------------------------------------------------------------------------
-EOS_FUNC void MatchNCC(const svt::Field<real32> & imgA,const ds::Array<Corner> & corA,
-                       const svt::Field<real32> & imgB,const ds::Array<Corner> & corB,
-                       svt::Field<real32> & out,nat32 half,bit addative,
-                       time::Progress * prog)
+// Extracts the window around each corner, subtracts its mean and scales it to
+// unit length, so the ncc of two windows is simply there dot product. Each
+// window is stored with the given stride, padded with zeros. Windows too close
+// to the edge are flagged as invalid, windows with no variation are left as
+// zeros so all there nccs are 0...
+static void NormalisedWindows(const svt::Field<real32> & img,const ds::Array<Corner> & cor,
+                              nat32 half,nat32 stride,ds::Array<real32> & win,ds::Array<bit> & valid)
 {
- LogBlock("eos::filter::MatchNCC(real32)","-");
- prog->Push();
- 
  nat32 winSize = math::Sqr(half*2+1);
  real64 meanMult = 1.0/real64(winSize);
 
- // Create a tempory structure for image A, containning the window for each corner
- // so as to improve cache coherance, with the mean allready subtracted.
- // Indicate entrys that are too close to the edge with a flag...
-  ds::Array<bit> validA(corA.Size());
-  ds::Array<real32> cacheA(corA.Size()*winSize);
-  for (nat32 i=0;i<corA.Size();i++)
+ valid.Size(cor.Size());
+ win.Size(cor.Size()*stride);
+ for (nat32 i=0;i<win.Size();i++) win[i] = 0.0;
+
+ for (nat32 i=0;i<cor.Size();i++)
+ {
+  nat32 lx = nat32(cor[i].loc[0]);
+  nat32 ly = nat32(cor[i].loc[1]);
+  valid[i] = (lx>=half)&&((lx+half)<img.Size(0))&&
+             (ly>=half)&&((ly+half)<img.Size(1));
+  if (!valid[i]) continue;
+
+  real32 * targ = &win[i*stride];
+  real64 mean = 0.0;
+  nat32 offset = 0;
+  for (nat32 y=ly-half;y<=ly+half;y++)
   {
-   nat32 lx = nat32(corA[i].loc[0]);
-   nat32 ly = nat32(corA[i].loc[1]);
-   validA[i] = (lx>=half)&&((lx+half)<imgA.Size(0))&&
-               (ly>=half)&&((ly+half)<imgA.Size(1));
-   if (validA[i])
+   for (nat32 x=lx-half;x<=lx+half;x++)
    {
-    real64 mean = 0.0;
-    nat32 offset = i*winSize;
-    for (nat32 y=ly-half;y<=ly+half;y++)
-    {
-     for (nat32 x=lx-half;x<=lx+half;x++)
-     {
-      real32 val = imgA.Get(x,y);
-      mean += val;
-      cacheA[offset] = val;
-      ++offset;
-     }
-    }
-    
-    mean *= meanMult;
-    offset = i*winSize;
-    for (nat32 j=0;j<winSize;j++)
-    {
-     cacheA[offset] -= mean;
-     ++offset;	    
-    }
+    real32 val = img.Get(x,y);
+    mean += val;
+    targ[offset] = val;
+    ++offset;
    }
   }
+  mean *= meanMult;
 
-
- // Same as above, for image B...
-  ds::Array<bit> validB(corB.Size());
-  ds::Array<real32> cacheB(corB.Size()*winSize);
-  for (nat32 i=0;i<corB.Size();i++)
+  real64 len = 0.0;
+  for (nat32 j=0;j<winSize;j++)
   {
-   nat32 lx = nat32(corB[i].loc[0]);
-   nat32 ly = nat32(corB[i].loc[1]);
-   validB[i] = (lx>=half)&&((lx+half)<imgB.Size(0))&&
-               (ly>=half)&&((ly+half)<imgB.Size(1));
-   if (validB[i])
-   {
-    real64 mean = 0.0;
-    nat32 offset = i*winSize;
-    for (nat32 y=ly-half;y<=ly+half;y++)
-    {
-     for (nat32 x=lx-half;x<=lx+half;x++)
-     {
-      real32 val = imgB.Get(x,y);
-      mean += val;
-      cacheB[offset] = val;
-      ++offset;
-     }
-    }
-    
-    mean *= meanMult;
-    offset = i*winSize;
-    for (nat32 j=0;j<winSize;j++)
-    {
-     cacheB[offset] -= mean;
-     ++offset;	    
-    }
-   }
+   targ[j] -= mean;
+   len += math::Sqr(real64(targ[j]));
   }
 
+  if (math::IsZero(len)) {for (nat32 j=0;j<winSize;j++) targ[j] = 0.0;}
+  else
+  {
+   real64 mult = math::InvSqrt(len);
+   for (nat32 j=0;j<winSize;j++) targ[j] *= mult;
+  }
+ }
+}
 
- // Loop all corner pairings...
-  for (nat32 v=0;v<corB.Size();v++)
+// Calculates the similarity matrix from the normalised windows, for use with
+// mt::ParallelFor over the corners of the second image. Blocked so a tile of
+// windows from the first image stays in cache whilst a block of the second
+// is matched against it, the dot products being left to the compiler to
+// vectorise...
+class NccBlocks
+{
+ public:
+  NccBlocks(const ds::Array<Corner> & ca,const ds::Array<real32> & wa,const ds::Array<bit> & va,
+            const ds::Array<Corner> & cb,const ds::Array<real32> & wb,const ds::Array<bit> & vb,
+            nat32 s,real32 md,bit add,svt::Field<real32> & o)
+  :corA(ca),winA(wa),validA(va),corB(cb),winB(wb),validB(vb),stride(s),maxDist(md),addative(add),out(o)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
   {
-   prog->Report(v,corB.Size());
-   if (validB[v])
+   static const nat32 tile = 64;
+   real32 maxDistSqr = math::Sqr(maxDist);
+
+   for (nat32 ub=0;ub<corA.Size();ub+=tile)
    {
-    // Coordinate in bounds - get ncc'ing...
-     for (nat32 u=0;u<corA.Size();u++)
+    nat32 ue = math::Min(ub+tile,corA.Size());
+    for (nat32 v=begin;v<end;v++)
+    {
+     const real32 * vB = &winB[v*stride];
+     for (nat32 u=ub;u<ue;u++)
      {
-      if (validA[u])
+      real32 ncc = 0.0;
+      bit use = validA[u] && validB[v];
+      if (use && (maxDist>=0.0))
       {
-       // No boundary issues - we have to do the ncc...
-        // Calculate parts of the final sum...
-         real64 top = 0.0;
-         real64 div1 = 0.0;
-         real64 div2 = 0.0;
-         nat32 baseA = winSize*u;
-         nat32 baseB = winSize*v;
-         for (nat32 t=0;t<winSize;t++)
-         {
-          real64 vA = cacheA[baseA+t];
-          real64 vB = cacheB[baseB+t];
-           
-          top += vA*vB;
-          div1 += math::Sqr(vA);
-          div2 += math::Sqr(vB);
-         }
-       
-        // Now calculate the final ncc...
-         real32 ncc;
-         real64 div = div1*div2;
-         if (math::IsZero(div)) ncc = 0.0;
-                           else ncc = top*math::InvSqrt(div);
-       
-        // Store it...
-         if (addative) out.Get(u,v) *= ncc;
-                  else out.Get(u,v) = ncc;
+       real32 dist = math::Sqr(corA[u].loc[0]-corB[v].loc[0]) + math::Sqr(corA[u].loc[1]-corB[v].loc[1]);
+       use = dist<=maxDistSqr;
       }
-      else
+
+      if (use)
       {
-       out.Get(u,v) = 0.0;	      
+       const real32 * vA = &winA[u*stride];
+       real32 sum[4] = {0.0,0.0,0.0,0.0};
+       for (nat32 t=0;t<stride;t+=4)
+       {
+        sum[0] += vA[t]*vB[t];
+        sum[1] += vA[t+1]*vB[t+1];
+        sum[2] += vA[t+2]*vB[t+2];
+        sum[3] += vA[t+3]*vB[t+3];
+       }
+       ncc = (sum[0]+sum[1]) + (sum[2]+sum[3]);
       }
+
+      if (addative&&use) out.Get(u,v) *= ncc;
+                    else out.Get(u,v) = ncc;
      }
-   }
-   else
-   {
-    for (nat32 u=0;u<corA.Size();u++) out.Get(u,v) = 0.0;	   
+    }
    }
   }
+
+ private:
+  const ds::Array<Corner> & corA;
+  const ds::Array<real32> & winA;
+  const ds::Array<bit> & validA;
+  const ds::Array<Corner> & corB;
+  const ds::Array<real32> & winB;
+  const ds::Array<bit> & validB;
+  nat32 stride;
+  real32 maxDist;
+  bit addative;
+  svt::Field<real32> & out;
+};
+
+//------------------------------------------------------------------------------
+EOS_FUNC void MatchNCC(const svt::Field<real32> & imgA,const ds::Array<Corner> & corA,
+                       const svt::Field<real32> & imgB,const ds::Array<Corner> & corB,
+                       svt::Field<real32> & out,nat32 half,bit addative,real32 maxDist,
+                       time::Progress * prog)
+{
+ LogBlock("eos::filter::MatchNCC(real32)","-");
+ prog->Push();
+
+ // Normalise the window of every corner, once, with the stride a multiple of
+ // 4 for the inner loop...
+  prog->Report(0,2);
+  nat32 stride = (math::Sqr(half*2+1)+3)&~nat32(3);
+
+  ds::Array<real32> winA;
+  ds::Array<bit> validA;
+  NormalisedWindows(imgA,corA,half,stride,winA,validA);
+
+  ds::Array<real32> winB;
+  ds::Array<bit> validB;
+  NormalisedWindows(imgB,corB,half,stride,winB,validB);
+
+
+ // Calculate every pairing, in parallel over the corners in image B...
+  prog->Report(1,2);
+  NccBlocks blocks(corA,winA,validA,corB,winB,validB,stride,maxDist,addative,out);
+  mt::ParallelFor(0,corB.Size(),blocks,16);
+
  prog->Pop();
 }
                        
 //------------------------------------------------------------------------------
 EOS_FUNC void MatchNCC(const svt::Field<bs::ColourRGB> & imgA,const ds::Array<Corner> & corA,
                        const svt::Field<bs::ColourRGB> & imgB,const ds::Array<Corner> & corB,
-                       svt::Field<real32> & out,nat32 half,
+                       svt::Field<real32> & out,nat32 half,real32 maxDist,
                        time::Progress * prog)
 {
  LogBlock("eos::filter::MatchNCC(bs::ColourRGB)","-");
@@ -176,9 +196,9 @@ EOS_FUNC void MatchNCC(const svt::Field<bs::ColourRGB> & imgA,const ds::Array<Co
   svt::Field<real32> greenB; imgB.SubField(1*sizeof(real32),greenB);
   svt::Field<real32> blueB;  imgB.SubField(2*sizeof(real32),blueB);
  
-  prog->Report(0,3); MatchNCC(redA,corA,redB,corB,out,half,false,prog);
-  prog->Report(1,3); MatchNCC(greenA,corA,greenB,corB,out,half,true,prog);
-  prog->Report(2,3); MatchNCC(blueA,corA,blueB,corB,out,half,true,prog);
+  prog->Report(0,3); MatchNCC(redA,corA,redB,corB,out,half,false,maxDist,prog);
+  prog->Report(1,3); MatchNCC(greenA,corA,greenB,corB,out,half,true,maxDist,prog);
+  prog->Report(2,3); MatchNCC(blueA,corA,blueB,corB,out,half,true,maxDist,prog);
  prog->Pop();
 }
 
@@ -264,7 +284,7 @@ EOS_FUNC void MatchSelect(const svt::Field<real32> & simMat,ds::Array<bs::Pos> &
 EOS_FUNC void MatchImages(const svt::Field<bs::ColourRGB> & imgA,
                           const svt::Field<bs::ColourRGB> & imgB,
                           ds::Array<Pair<bs::Pnt,bs::Pnt> > & out,
-                          nat32 maxMatches,nat32 half,real32 ratio,
+                          nat32 maxMatches,nat32 half,real32 ratio,real32 maxDist,
                           time::Progress * prog)
 {
  LogBlock("eos::filter::MatchImages","-");
@@ -311,7 +331,7 @@ EOS_FUNC void MatchImages(const svt::Field<bs::ColourRGB> & imgA,
    simMatVar.Commit(false);
    
    svt::Field<real32> simMat(&simMatVar,"sim");
-   MatchNCC(imgA,corA,imgB,corB,simMat,half,prog);
+   MatchNCC(imgA,corA,imgB,corB,simMat,half,maxDist,prog);
 
 
   // Select the best matches...
@@ -36,9 +36,9 @@ namespace eos
 //------------------------------------------------------------------------------
 /// This creates a similarity matrix (As a svt::Field) using normalised cross 
 /// correlation. Expects to be given the output matrix allready the correct size.
-/// (This is just the basic brute force implimentation - I just don't use this 
-/// enough to justify extensive optimisation.)
-/// (And incase you havn't guessed, no falloff is used.)
+/// The window of each corner is normalised once, so each similarity is then a
+/// dot product, with the matrix calculated in cache sized blocks over all
+/// cores. (And incase you havn't guessed, no falloff is used.)
 /// \param imgA The first image.
 /// \param corA The list of corners in the first image.
 /// \param imgB The second image.
@@ -51,19 +51,23 @@ namespace eos
 /// \param addative If false, the default, it sets the similarity array,
 ///                 if true it multiplies it, useful for combining similaritys for 
 ///                 multiple fields of reals.
+/// \param maxDist If not negative, the default, only pairs of corners whose
+///                positions are within this distance of each other are
+///                matched, all others getting a similarity of 0. Saves a lot
+///                of work when the motion between the images is known to be small.
 /// \param prog Progress bar, as ushall.
 EOS_FUNC void MatchNCC(const svt::Field<real32> & imgA,const ds::Array<Corner> & corA,
                        const svt::Field<real32> & imgB,const ds::Array<Corner> & corB,
-                       svt::Field<real32> & out,nat32 half,bit addative = false,
+                       svt::Field<real32> & out,nat32 half,bit addative = false,real32 maxDist = -1.0,
                        time::Progress * prog = null<time::Progress*>());
 
 //------------------------------------------------------------------------------
 /// This uses the NCC matcher but does it for each channel of a colour image and
 /// then multiplies the similarities together to get a composite similarity 
-/// matrix.
+/// matrix. maxDist is as above.
 EOS_FUNC void MatchNCC(const svt::Field<bs::ColourRGB> & imgA,const ds::Array<Corner> & corA,
                        const svt::Field<bs::ColourRGB> & imgB,const ds::Array<Corner> & corB,
-                       svt::Field<real32> & out,nat32 half,
+                       svt::Field<real32> & out,nat32 half,real32 maxDist = -1.0,
                        time::Progress * prog = null<time::Progress*>());
 
 //------------------------------------------------------------------------------
@@ -86,10 +90,11 @@ EOS_FUNC void MatchSelect(const svt::Field<real32> & simMat,ds::Array<bs::Pos> &
 /// \param maxMatches Maximum number of matches to obtain, will ushally be less than whatever you put here however.
 /// \param half The half window size used for NCC.
 /// \param ratio The match score of the second best match for a corner divided by the best match score must be smaller than this value for it to be considered safe.
+/// \param maxDist If not negative, the default, the maximum distance between a corner in each image for them to be considered as a match.
 /// \param prog Optional progress report.
 EOS_FUNC void MatchImages(const svt::Field<bs::ColourRGB> & imgA,const svt::Field<bs::ColourRGB> & imgB,
                           ds::Array<Pair<bs::Pnt,bs::Pnt> > & out,
-                          nat32 maxMatches,nat32 half,real32 ratio = 0.7,
+                          nat32 maxMatches,nat32 half,real32 ratio = 0.7,real32 maxDist = -1.0,
                           time::Progress * prog = null<time::Progress*>());
 
 //------------------------------------------------------------------------------
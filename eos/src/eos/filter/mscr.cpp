@@ -20,6 +20,8 @@
 #include "eos/ds/arrays2d.h"
 #include "eos/math/functions.h"
 #include "eos/math/eigen.h"
+#include "eos/mem/functions.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -44,46 +46,29 @@ EOS_FUNC real32 DistMSCR(bs::ColourRGB & a,bs::ColourRGB & b)
 }
 
 //------------------------------------------------------------------------------
-MSCR::MSCR()
-:minSize(60),areaCap(2.0),minDim(1.5)
-{}
-   
-MSCR::~MSCR()
-{}
-
-void MSCR::Input(const svt::Field<bs::ColourRGB> & input)
-{
- image = input;
-}
+static const int32 secX[4] = {1,0,1,-1};
+static const int32 secY[4] = {0,1,1, 1};
 
-void MSCR::Run(time::Progress * prog)
+// Fills in the cracks and initialises the forest, a row at a time. The cracks
+// of row y start at y*(4*width-3), as every row but the last has that many...
+class MSCR::Rows
 {
- LogTime("eos::filter::MSCR::Run");
- prog->Push();
- 
- // Some helper stuff...
-  static const int32 secX[4] = {1,0,1,-1};
-  static const int32 secY[4] = {0,1,1, 1};  
-
-
- // Create a sorted array of crack edges, this being the order to do the merges in...
- // (All crack edges are valid, so boundary checking is not needed.)
-  int32 width = int32(image.Size(0));
-  int32 height = int32(image.Size(1));
-  ds::Array<Crack> merge(4*width*height - 3*width - 3*height + 2);
+ public:
+  Rows(MSCR & s):self(s)
   {
-   real32 mult[4];
    for (nat32 dir=0;dir<4;dir++)
    {
     mult[dir] = 1.0/math::Sqrt(math::Abs(secX[dir]) + math::Abs(secY[dir]));
    }
-  
-   nat32 ind = 0;
-   prog->Report(0,5);
-   prog->Push();
-   for (int32 y=0;y<height;y++)
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   int32 width = int32(self.image.Size(0));
+   int32 height = int32(self.image.Size(1));
+   for (int32 y=int32(begin);y<int32(end);y++)
    {
-    prog->Report(y,height);
+    nat32 ind = nat32(y)*(4*width-3);
     for (int32 x=0;x<width;x++)
     {
      // Generate all 4 cracks for this pixel as boundary conditions allow...
@@ -93,51 +78,142 @@ void MSCR::Run(time::Progress * prog)
        int32 y2 = y + secY[dir];
        if ((x2<0)||(x2>=width)) continue;
        if ((y2<0)||(y2>=height)) continue;
-       
-       merge[ind].x = x;
-       merge[ind].y = y;
-       merge[ind].dist = DistMSCR(image.Get(x,y),image.Get(x2,y2)) * mult[dir];
-       merge[ind].dir = dir;
-       
+
+       self.merge[ind].dist = DistMSCR(self.image.Get(x,y),self.image.Get(x2,y2)) * mult[dir];
+       self.merge[ind].code = (nat32(y)*nat32(width) + nat32(x))*4 + dir;
        ++ind;
       }
+
+     // The forest...
+      Region & targ = self.forest.Get(x,y);
+      targ.parent = null<Region*>();
+      targ.past = null<Region*>();
+      targ.dist = 0.0;
+      targ.size = 1;
+      targ.eX = real32(x);
+      targ.eY = real32(y);
+      targ.eXX = math::Sqr(targ.eX);
+      targ.eYY = math::Sqr(targ.eY);
+      targ.eXY = targ.eX * targ.eY;
     }
    }
-   prog->Pop();
-   log::Assert(ind==merge.Size());
-   
-   prog->Report(1,5);
-   merge.SortNorm();
   }
 
+ private:
+  MSCR & self;
+  real32 mult[4];
+};
 
+// Sorts chunks of the cracks, given by an array of boundaries...
+class MSCR::SortChunks
+{
+ public:
+  SortChunks(MSCR & s,const nat32 * b):self(s),bound(b) {}
 
- // Build the forest...
-  prog->Report(2,5);
-  ds::Array2D<Region> forest(width,height);
+  void operator () (nat32 begin,nat32 end)
   {
-   prog->Push();
-   for (int32 y=0;y<height;y++)
+   for (nat32 c=begin;c<end;c++)
    {
-    prog->Report(y,height);
-    for (int32 x=0;x<width;x++)
+    if (bound[c+1]>bound[c]+1) self.merge.SortRange< ds::SortOp<Crack> >(bound[c],bound[c+1]-1);
+   }
+  }
+
+ private:
+  MSCR & self;
+  const nat32 * bound;
+};
+
+// Merges pairs of adjacent sorted runs, run i being [bound[i],bound[i+1])...
+class MSCR::MergeRuns
+{
+ public:
+  MergeRuns(const Crack * f,Crack * t,const nat32 * b,nat32 r):from(f),to(t),bound(b),runs(r) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 p=begin;p<end;p++)
+   {
+    nat32 a = bound[p*2];
+    nat32 aEnd = bound[p*2+1];
+    nat32 b = aEnd;
+    nat32 bEnd = (p*2+1<runs)?bound[p*2+2]:aEnd;
+    nat32 out = a;
+
+    while ((a<aEnd)&&(b<bEnd))
     {
-     Region & targ = forest.Get(x,y);
-    
-     targ.parent = null<Region*>();
-    
-     targ.past = null<Region*>();
-     targ.dist = 0.0;
-    
-     targ.size = 1;
-     targ.eX = real32(x);
-     targ.eY = real32(y);
-     targ.eXX = math::Sqr(targ.eX);
-     targ.eYY = math::Sqr(targ.eY);
-     targ.eXY = targ.eX * targ.eY;
+     if (from[b]<from[a]) to[out++] = from[b++];
+                     else to[out++] = from[a++];
     }
+    while (a<aEnd) to[out++] = from[a++];
+    while (b<bEnd) to[out++] = from[b++];
    }
-   prog->Pop();
+  }
+
+ private:
+  const Crack * from;
+  Crack * to;
+  const nat32 * bound;
+  nat32 runs;
+};
+
+//------------------------------------------------------------------------------
+MSCR::MSCR()
+:minSize(60),areaCap(2.0),minDim(1.5),outSize(0)
+{}
+   
+MSCR::~MSCR()
+{}
+
+void MSCR::Input(const svt::Field<bs::ColourRGB> & input)
+{
+ image = input;
+}
+
+void MSCR::Run(time::Progress * prog)
+{
+ LogTime("eos::filter::MSCR::Run");
+ prog->Push();
+
+ // Create a sorted array of crack edges, this being the order to do the merges in...
+ // (All crack edges are valid, so boundary checking is not needed.)
+ // The arrays only reallocate when the image size changes...
+  int32 width = int32(image.Size(0));
+  int32 height = int32(image.Size(1));
+  nat32 cracks = 4*width*height - 3*width - 3*height + 2;
+  merge.Size(cracks);
+  mergeTemp.Size(cracks);
+  forest.Resize(width,height);
+  {
+   prog->Report(0,4);
+   Rows rows(*this);
+   mt::ParallelFor(0,height,rows,4);
+
+  // Sort - fixed size chunks sorted in parallel then merged in pairs, in
+  // parallel, until one run remains. The crack ordering is total, so the
+  // result is identical to a single sort...
+   prog->Report(1,4);
+   static const nat32 chunks = 32;
+   nat32 bound[chunks+1];
+   for (nat32 c=0;c<=chunks;c++) bound[c] = nat32((nat64(cracks)*c)/chunks);
+
+   SortChunks sc(*this,bound);
+   mt::ParallelFor(0,chunks,sc,1);
+
+   Crack * from = &merge[0];
+   Crack * to = &mergeTemp[0];
+   nat32 runs = chunks;
+   while (runs>1)
+   {
+    MergeRuns mr(from,to,bound,runs);
+    mt::ParallelFor(0,(runs+1)/2,mr,1);
+
+    nat32 newRuns = (runs+1)/2;
+    for (nat32 i=0;i<=newRuns;i++) bound[i] = bound[math::Min(i*2,runs)];
+    runs = newRuns;
+    math::Swap(from,to);
+   }
+
+   if (from!=&merge[0]) mem::Copy(&merge[0],from,cracks);
   }
 
 
@@ -145,15 +221,19 @@ void MSCR::Run(time::Progress * prog)
  // Iterate through the merge list of cracks - merge each crack as needed.
  // When cracks are merged handle all scenarios, including storing found regions
  // as needed...
-  ds::Stack<StableRegion> data;
-  prog->Report(3,5);
+  outSize = 0;
+  prog->Report(2,4);
   prog->Push();
   for (nat32 i=0;i<merge.Size();i++)
   {
-   prog->Report(i,merge.Size());
+   if ((i&0xFFFF)==0) prog->Report(i,merge.Size());
    // Get the parents of the pixels to merge...
-    Region * par1 = forest.Get(merge[i].x,merge[i].y).Parent();
-    Region * par2 = forest.Get(merge[i].x + secX[merge[i].dir],merge[i].y + secY[merge[i].dir]).Parent();
+    nat32 pix = merge[i].code>>2;
+    nat32 dir = merge[i].code&3;
+    int32 x = int32(pix%nat32(width));
+    int32 y = int32(pix/nat32(width));
+    Region * par1 = forest.Get(x,y).Parent();
+    Region * par2 = forest.Get(x + secX[dir],y + secY[dir]).Parent();
     
    // If different then merge...
     if (par1!=par2)
@@ -182,7 +262,7 @@ void MSCR::Run(time::Progress * prog)
      // par2 is going to die and its merge log is going to die with it - 
      // check it for regions before it takes its last gasp...
      // (The check saves on going hunting when no possible stable regions exist.)
-      if (par2->size>=minSize) FindStableRegions(&temp,data,&forest.Get(0,0));
+      if (par2->size>=minSize) FindStableRegions(&temp,&forest.Get(0,0));
       
      
      // Do the actual merge - largest into smallest for reasons of the merge
@@ -201,26 +281,19 @@ void MSCR::Run(time::Progress * prog)
   // log...
   {
    Region * final = forest.Get(0,0).Parent();
-   FindStableRegions(final,data,&forest.Get(0,0));
+   FindStableRegions(final,&forest.Get(0,0));
    log::Assert(nat32(width*height)==final->size);
   }
 
 
-
- // Move from stack to array for actual output...
-  prog->Report(4,5);
-  out.Size(data.Size());
-  for (nat32 i=0;i<out.Size();i++)
-  {
-   out[i] = data.Peek();
-   data.Pop();
-  }
-  log::Assert(data.Size()==0);
+ // Regions were historically output last found first, so reverse...
+  prog->Report(3,4);
+  for (nat32 i=0;i<outSize/2;i++) math::Swap(out[i],out[outSize-1-i]);
 
  prog->Pop();
 }
 
-void MSCR::FindStableRegions(Region * ml,ds::Stack<StableRegion> & output,Region * baseRegion)
+void MSCR::FindStableRegions(Region * ml,Region * baseRegion)
 {
  LogTime("eos::filter::MSCR::FindStableRegions");
  
@@ -317,14 +390,14 @@ void MSCR::FindStableRegions(Region * ml,ds::Stack<StableRegion> & output,Region
      else
      {
       // Its not connected - store best of chain being finished and prep for next chain...
-       StoreStableRegion(best,output,baseRegion);
+       StoreStableRegion(best,baseRegion);
        best = base->past;
      }
     }
     else
     {
      // End of the line - store the best of the last chain...
-      StoreStableRegion(best,output,baseRegion);
+      StoreStableRegion(best,baseRegion);
     }
 
    base = base->past;
@@ -332,7 +405,7 @@ void MSCR::FindStableRegions(Region * ml,ds::Stack<StableRegion> & output,Region
  }
 }
 
-void MSCR::StoreStableRegion(Region * r,ds::Stack<StableRegion> & output,Region * baseRegion)
+void MSCR::StoreStableRegion(Region * r,Region * baseRegion)
 {
  LogTime("eos::filter::MSCR::StoreStableRegion");
   
@@ -365,7 +438,11 @@ void MSCR::StoreStableRegion(Region * r,ds::Stack<StableRegion> & output,Region
   math::SymEigen(trash,q,d);
   if ((d[0]>minDim)&&(d[1]>minDim))
   {
-   output.Push(sr);
+   // Store, doubling the output if its full - it never shrinks, so when the
+   // instance is reused this soon stops allocating...
+    if (outSize==out.Size()) out.Size(math::Max<nat32>(out.Size()*2,64));
+    out[outSize] = sr;
+    ++outSize;
   }
 }
 
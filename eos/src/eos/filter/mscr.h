@@ -27,7 +27,7 @@
 #include "eos/bs/colours.h"
 #include "eos/bs/geo2d.h"
 #include "eos/ds/arrays.h"
-#include "eos/ds/stacks.h"
+#include "eos/ds/arrays2d.h"
 #include "eos/time/progress.h"
 #include "eos/svt/field.h"
 
@@ -74,6 +74,11 @@ class EOS_CLASS StableRegion
 /// images.
 /// Based on the paper 'Maximally Stable Colour Regions for Recognition and Matching'
 /// by Per-Erik Forssen.
+/// An instance is intended to be reused, e.g. for consecutive frames of a
+/// video - all working memory is kept between calls to Run, and only
+/// reallocated if the image size changes. The crack edge weights and their
+/// sort are threaded, the sort ordering ties by position so the output does
+/// not depend on the thread count.
 class EOS_CLASS MSCR
 {
  public:
@@ -92,10 +97,14 @@ class EOS_CLASS MSCR
 
 
   /// Returns how many regions have been found by the Run method.
-   nat32 Size() const {return out.Size();}
+   nat32 Size() const {return outSize;}
    
   /// Accesses a found region.
    const StableRegion & operator[](nat32 i) const {return out[i];}
+
+  /// Returns the found regions as a flat array, of Size() entrys. Valid until
+  /// Run is next called.
+   const StableRegion * Regions() const {return outSize?&out[0]:null<const StableRegion*>();}
   
 
   /// &nbsp;
@@ -112,21 +121,24 @@ class EOS_CLASS MSCR
   // Input image...
    svt::Field<bs::ColourRGB> image;
    
-  // Output array...
+  // Output array, which only grows, with how much of it is in use...
    ds::Array<StableRegion> out;
+   nat32 outSize;
 
 
   // This stores a 'crack', that is the coordinates of two adjacent pixels 
-  // and the difference between them.
+  // and the difference between them. Ties are broken by position, so the
+  // sort order is unique...
    struct Crack
    {
-    int32 x;
-    int32 y;
     real32 dist; // Difference between the two pixels.
-    byte dir; // 0=(1,0),1=(0,1),2=(1,1),3=(-1,1)
+    nat32 code; // (y*width + x)*4 + dir, where dir is 0=(1,0),1=(0,1),2=(1,1),3=(-1,1)
     // (x,y) is coordinate of first pixel, offset with dir to get second.
     
-    bit operator < (const Crack & rhs) const {return dist<rhs.dist;}
+    bit operator < (const Crack & rhs) const
+    {
+     return (dist<rhs.dist) || ((!(rhs.dist<dist))&&(code<rhs.code));
+    }
    };
 
 
@@ -166,13 +178,26 @@ class EOS_CLASS MSCR
    };
 
    
+  // Working memory, kept between runs - the cracks, sorted, a second buffer
+  // for the merge sort and the forest...
+   ds::Array<Crack> merge;
+   ds::Array<Crack> mergeTemp;
+   ds::Array2D<Region> forest;
+
+
   // Helper method - this searches a merge log made from Region-s to find
   // stable regions... (baseRegion is used to calculate coordinates.)
-   void FindStableRegions(Region * ml,ds::Stack<StableRegion> & output,Region * baseRegion);
+   void FindStableRegions(Region * ml,Region * baseRegion);
    
   // Helper method used by above helper method - given a region it stores it,
   // assuming it thinks its good enough...
-   void StoreStableRegion(Region * r,ds::Stack<StableRegion> & output,Region * baseRegion);
+   void StoreStableRegion(Region * r,Region * baseRegion);
+
+  // Work for the threads - filling in the cracks and forest a row at a time,
+  // sorting chunks of cracks, and merging pairs of sorted runs...
+   class Rows;
+   class SortChunks;
+   class MergeRuns;
 };
 
 //------------------------------------------------------------------------------
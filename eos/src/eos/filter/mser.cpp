@@ -19,11 +19,459 @@
 
 #include "eos/ds/lists.h"
 #include "eos/rend/functions.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace filter
  {
+//------------------------------------------------------------------------------
+// Builds the component tree for one polarity and extracts the MSERs from it.
+// Works in a level space that is the grey level bucket for minimal regions
+// and 255 minus it for maximal, so the same code does both. The flood fill
+// keeps a boundary heap of pixels, bucketed by level, and a stack of partial
+// components of strictly decreasing level. Each component keeps a chain of
+// records giving its area at every level it has passed through - when two
+// merge the larger keeps its chain and the smaller is finished, at which point
+// its chain is checked for stable levels. That is the same analysis as the
+// old forest merging did, except all the bookkeeping is per component rather
+// than per pixel. Regions found are recovered by flood filling from a seed
+// pixel to get at the pixels for the centre, covariance and frame...
+class Mser::Tree
+{
+ public:
+  Tree(const Mser & s,const byte * bucket,bit d)
+  :self(s),dir(d),width(s.img.Size(0)),height(s.img.Size(1)),size(width*height),
+  sp(0),recSize(0),recCap(256),stampVal(0)
+  {
+   level = mem::Malloc<byte>(size);
+   access = mem::Malloc<byte>(size);
+   heap = mem::Malloc<nat32>(size);
+   stamp = mem::Malloc<nat32>(size);
+   queue = mem::Malloc<nat32>(size);
+   rec = mem::Malloc<Rec>(recCap);
+
+   nat32 count[256];
+   for (nat32 i=0;i<256;i++) count[i] = 0;
+   for (nat32 i=0;i<size;i++)
+   {
+    level[i] = dir?(255-bucket[i]):bucket[i];
+    access[i] = 0;
+    stamp[i] = 0;
+    ++count[level[i]];
+   }
+
+   nat32 base = 0;
+   for (nat32 i=0;i<256;i++)
+   {
+    heapBase[i] = base;
+    heapTop[i] = 0;
+    base += count[i];
+   }
+   for (nat32 i=0;i<8;i++) heapMask[i] = 0;
+  }
+
+  ~Tree()
+  {
+   mem::Free(rec);
+   mem::Free(queue);
+   mem::Free(stamp);
+   mem::Free(heap);
+   mem::Free(access);
+   mem::Free(level);
+  }
+
+  ds::List<Node> store;
+
+  // For running several trees in parallel...
+   class Each
+   {
+    public:
+     Each(Tree ** t):tree(t) {}
+
+     void operator () (nat32 begin,nat32 end)
+     {
+      for (nat32 i=begin;i<end;i++) tree[i]->Run();
+     }
+
+    private:
+     Tree ** tree;
+   };
+
+  void Run()
+  {
+   if (size==0) return;
+
+   // Start at the first pixel...
+    nat32 cur = 0;
+    nat32 edge = 0;
+    nat32 curLevel = level[0];
+    access[0] = 1;
+    NewComp(curLevel,0);
+
+   while (true)
+   {
+    // Explore the remaining neighbours of the current pixel - if one is lower
+    // we descend to it, leaving the current pixel on the heap...
+     bit descend = false;
+     for (;edge<4;edge++)
+     {
+      nat32 n;
+      if (!Neighbour(cur,edge,n)) continue;
+      if (access[n]) continue;
+      access[n] = 1;
+
+      if (level[n]>=curLevel) Push(n*8);
+      else
+      {
+       Push(cur*8 + edge + 1);
+       cur = n;
+       curLevel = level[n];
+       NewComp(curLevel,n);
+       edge = 0;
+       descend = true;
+       break;
+      }
+     }
+     if (descend) continue;
+
+    // All neighbours done - the pixel joins the top component...
+     stack[sp-1].area += 1;
+
+    // Next pixel from the heap, raising the components if its higher...
+     if (!Pop(cur)) break;
+     edge = cur&7;
+     cur = cur>>3;
+     if (level[cur]!=curLevel)
+     {
+      curLevel = level[cur];
+      ProcessStack(curLevel);
+     }
+   }
+
+   // Whatever is left is the root, don't want to miss the longest chain...
+    while (sp>1) ProcessStack(stack[sp-2].level);
+    Analyse(stack[0],stack[0].level);
+  }
+
+
+ private:
+  const Mser & self;
+  bit dir;
+  nat32 width;
+  nat32 height;
+  nat32 size;
+
+  byte * level; // Level of each pixel.
+  byte * access; // 1 if the pixel has been reached by the flood fill.
+
+  // The boundary heap, a stack per level packed into one array, entrys being
+  // pixel index*8 + next edge to explore. A pixel can only be in it once, so
+  // each level needs room for the pixels at that level. A bit mask of non
+  // empty levels makes finding the lowest constant time...
+   nat32 * heap;
+   nat32 heapBase[256];
+   nat32 heapTop[256];
+   nat32 heapMask[8];
+
+  // The component stack, levels strictly decrease going up it so 256 will do...
+   struct Comp
+   {
+    nat32 level;
+    nat32 area;
+    nat32 seed; // A pixel that is in the component at all levels.
+    nat32 last; // Index of the latest record, 0xFFFFFFFF for none.
+   };
+   Comp stack[256];
+   nat32 sp;
+
+  // Records, a linked list going backwards for each component - each gives the
+  // area of the component from the given level up to that of the next record...
+   struct Rec
+   {
+    nat32 level;
+    nat32 area;
+    nat32 prev;
+   };
+   Rec * rec;
+   nat32 recSize;
+   nat32 recCap;
+
+  // For the flood fills done when storing a region...
+   nat32 * stamp;
+   nat32 stampVal;
+   nat32 * queue;
+
+
+  bit Neighbour(nat32 p,nat32 edge,nat32 & out) const
+  {
+   switch (edge)
+   {
+    case 0: if (p%width==0) return false; out = p-1; return true;
+    case 1: if (p%width==width-1) return false; out = p+1; return true;
+    case 2: if (p<width) return false; out = p-width; return true;
+    default: if (p+width>=size) return false; out = p+width; return true;
+   }
+  }
+
+  void Push(nat32 e)
+  {
+   nat32 l = level[e>>3];
+   heap[heapBase[l] + heapTop[l]] = e;
+   ++heapTop[l];
+   heapMask[l>>5] |= 1<<(l&31);
+  }
+
+  bit Pop(nat32 & out)
+  {
+   for (nat32 i=0;i<8;i++)
+   {
+    if (heapMask[i])
+    {
+     nat32 l = i*32 + __builtin_ctz(heapMask[i]);
+     --heapTop[l];
+     out = heap[heapBase[l] + heapTop[l]];
+     if (heapTop[l]==0) heapMask[i] &= ~(1<<(l&31));
+     return true;
+    }
+   }
+   return false;
+  }
+
+  void NewComp(nat32 l,nat32 seed)
+  {
+   Comp & c = stack[sp];
+   c.level = l;
+   c.area = 0;
+   c.seed = seed;
+   c.last = 0xFFFFFFFF;
+   ++sp;
+  }
+
+  void AddRecord(Comp & c)
+  {
+   if (recSize==recCap)
+   {
+    Rec * nr = mem::Malloc<Rec>(recCap*2);
+    mem::Copy(nr,rec,recSize);
+    mem::Free(rec);
+    rec = nr;
+    recCap *= 2;
+   }
+
+   rec[recSize].level = c.level;
+   rec[recSize].area = c.area;
+   rec[recSize].prev = c.last;
+   c.last = recSize;
+   ++recSize;
+  }
+
+  // Raises the top of the stack to the given level, merging components as
+  // it passes there levels...
+   void ProcessStack(nat32 l)
+   {
+    while (true)
+    {
+     Comp & top = stack[sp-1];
+     AddRecord(top);
+
+     if ((sp==1)||(l<stack[sp-2].level))
+     {
+      top.level = l;
+      return;
+     }
+
+     // Merge with the next down, the smaller is finished...
+      Comp & sec = stack[sp-2];
+      if (top.area>sec.area)
+      {
+       Analyse(sec,sec.level);
+       sec.area += top.area;
+       sec.seed = top.seed;
+       sec.last = top.last;
+      }
+      else
+      {
+       Analyse(top,sec.level);
+       sec.area += top.area;
+      }
+      --sp;
+
+     if (l==sec.level) return;
+    }
+   }
+
+  // Given a finished component, and the level it died at, checks its chain for
+  // stable levels and stores them...
+   void Analyse(const Comp & c,nat32 death)
+   {
+    nat32 delta = self.delta;
+    nat32 minRange = delta*2 + 3;
+    if ((c.area<self.minArea)||(death<=minRange)||(c.last==0xFFFFFFFF)) return;
+
+    // Area chart, with the level of the record to fill from for each...
+     nat32 area[256];
+     nat32 from[256];
+
+     nat32 l = death;
+     for (nat32 r=c.last;r!=0xFFFFFFFF;r=rec[r].prev)
+     {
+      while (l>rec[r].level)
+      {
+       --l;
+       area[l] = rec[r].area;
+       from[l] = rec[r].level;
+      }
+     }
+     while (l!=0)
+     {
+      area[l-1] = area[l];
+      from[l-1] = from[l];
+      --l;
+     }
+
+    // Sliding window, looking for minima of the rate of change...
+     real32 window[3];
+     for (nat32 i=0;i<3;i++) window[i] = 0.0;
+
+     nat32 endLevel = death - 1 - delta;
+     for (nat32 i=delta;i<=endLevel;i++)
+     {
+      window[0] = window[1];
+      window[1] = window[2];
+      window[2] = math::Abs(real32(area[i+delta])-real32(area[i-delta]))/real32(area[i]);
+      if ((window[1]<window[0])&&
+          (window[1]<window[2])&&
+          (area[i-1]>=self.minArea)&&(area[i-1]<=self.maxArea)) Store(c.seed,from[i-1]);
+     }
+   }
+
+  // Stores the region containing seed at the given level...
+   void Store(nat32 seed,nat32 l)
+   {
+    LogTime("eos::filter::Mser::Store");
+
+    // Flood fill to get the pixels, getting the threshold as we go...
+     ++stampVal;
+     nat32 n = 0;
+     queue[n++] = seed;
+     stamp[seed] = stampVal;
+     real32 threshold = self.img.Get(seed%width,seed/width).l;
+     for (nat32 i=0;i<n;i++)
+     {
+      nat32 p = queue[i];
+      real32 pl = self.img.Get(p%width,p/width).l;
+      if (dir) threshold = math::Min(threshold,pl);
+          else threshold = math::Max(threshold,pl);
+
+      for (nat32 e=0;e<4;e++)
+      {
+       nat32 o;
+       if (Neighbour(p,e,o)&&(stamp[o]!=stampVal)&&(level[o]<=l))
+       {
+        stamp[o] = stampVal;
+        queue[n++] = o;
+       }
+      }
+     }
+
+    Node node;
+    node.maximal = dir;
+    node.pixel[0] = seed%width;
+    node.pixel[1] = seed/width;
+    node.area = n;
+    node.threshold = threshold;
+
+    // Centre...
+     real64 sumX = 0.0;
+     real64 sumY = 0.0;
+     for (nat32 i=0;i<n;i++)
+     {
+      sumX += real64(queue[i]%width);
+      sumY += real64(queue[i]/width);
+     }
+     node.centre[0] = sumX/real64(n);
+     node.centre[1] = sumY/real64(n);
+
+    // Covariance...
+     node.covariance[0][0] = 0.0;
+     node.covariance[0][1] = 0.0;
+     node.covariance[1][1] = 0.0;
+     for (nat32 i=0;i<n;i++)
+     {
+      real32 relX = real32(queue[i]%width) - node.centre[0];
+      real32 relY = real32(queue[i]/width) - node.centre[1];
+
+      node.covariance[0][0] += math::Sqr(relX);
+      node.covariance[0][1] += relX*relY;
+      node.covariance[1][1] += math::Sqr(relY);
+     }
+     node.covariance[0][0] /= real32(node.area);
+     node.covariance[0][1] /= real32(node.area);
+     node.covariance[1][1] /= real32(node.area);
+     node.covariance[1][0] = node.covariance[0][1];
+
+    // Generate an affine frame...
+     // Create a transformation upto an unknown rotation...
+      math::Mat<2> temp;
+      math::Mat<2> affineInv = node.covariance;
+      math::Inverse(affineInv,temp);
+      math::Sqrt22(affineInv);
+      node.affine = affineInv;
+      math::Inverse(node.affine,temp);
+
+     // Find the furthest point, under the affine frame...
+      real32 best = 0.0;
+      bs::Pnt furthest;
+      for (nat32 i=0;i<n;i++)
+      {
+       bs::Pnt pos[2];
+       pos[0][0] = real32(queue[i]%width) - node.centre[0];
+       pos[0][1] = real32(queue[i]/width) - node.centre[1];
+       math::MultVect(affineInv,pos[0],pos[1]);
+
+       real32 lenSqr = pos[1].LengthSqr();
+       if (lenSqr>best)
+       {
+        best = lenSqr;
+        furthest = pos[1];
+       }
+      }
+
+     // Rotate (A Givens rotation is used.)...
+      math::Mat<2> rot;
+      real32 c;
+      real32 s;
+      if (math::IsZero(furthest[1]))
+      {
+       c = 1.0;
+       s = 0.0;
+      }
+      else
+      {
+       if (math::Abs(furthest[1])>math::Abs(furthest[0]))
+       {
+        real32 r = -furthest[0]/furthest[1];
+        s = math::InvSqrt(1.0+math::Sqr(r));
+        c = s*r;
+       }
+       else
+       {
+        real32 r = -furthest[1]/furthest[0];
+        c = math::InvSqrt(1.0+math::Sqr(r));
+        s = c*r;
+       }
+      }
+
+      rot[0][0] = c;  rot[0][1] = s;
+      rot[1][0] = -s; rot[1][1] = c;
+      math::Mult(node.affine,rot,temp);
+      node.affine = temp;
+
+    store.AddBack(node);
+   }
+};
+
 //------------------------------------------------------------------------------
 Mser::Mser()
 :minArea(32),maxAreaMult(0.1),delta(32)
@@ -49,86 +497,49 @@ void Mser::Run(time::Progress * prog)
  LogBlock("void eos::filter::Mser::Run()","-");
  prog->Push();
 
-
- // Data structures used in both steps...
-  prog->Report(0,4);
-  ds::Array2D<Turnip> forest(img.Size(0),img.Size(1));
-  ds::List<Node> store;
-  
- 
  // Set the maximum mser area from image size...
   maxArea = nat32(real32(img.Size(0)*img.Size(1))*maxAreaMult);
 
 
- // We use a bucket sort on the assumption of 256 colours...
- // Simultaneously initialise some values in the data structure, the rest are done latter.
-  Turnip * bucket[256];
-  for (nat32 i=0;i<256;i++) bucket[i] = null<Turnip*>();
-  prog->Push();
-   for (nat32 y=0;y<img.Size(1);y++)
+ // Quantise the image into the 256 levels used...
+  prog->Report(0,3);
+  nat32 width = img.Size(0);
+  byte * bucket = mem::Malloc<byte>(img.Size(0)*img.Size(1));
+  for (nat32 y=0;y<img.Size(1);y++)
+  {
+   for (nat32 x=0;x<width;x++)
    {
-    prog->Report(y,img.Size(1));
-    for (nat32 x=0;x<img.Size(0);x++)
-    {
-     Turnip & targ = forest.Get(x,y);
-
-     targ.x = x;
-     targ.y = y;
-     targ.l = img.Get(x,y).l;
-     targ.bucket = nat32(math::Round(targ.l*255.0));
-     log::Assert((targ.bucket>=0)&&(targ.bucket<=255));
-     
-     targ.next = bucket[targ.bucket];
-     bucket[targ.bucket] = &targ;
-     
-     targ.area = 0;
-    }
+    int32 b = int32(math::Round(img.Get(x,y).l*255.0));
+    log::Assert((b>=0)&&(b<=255));
+    bucket[y*width+x] = byte(math::Clamp<int32>(b,0,255));
    }
-  prog->Pop();
+  }
 
 
- // Go from dark to light...
-  prog->Report(1,4);
-  prog->Push();
-   for (nat32 i=0;i<256;i++)
-   {
-    prog->Report(i,256);
-    DoList(forest,bucket[i],store,false);
-   }   
-   Analyse(*forest.Get(0,0).Head(),store,false); // We don't want to miss the longest chain.
-  prog->Pop();
+ // Build both trees, minimal and maximal, in parallel...
+  prog->Report(1,3);
+  Tree * tree[2];
+  tree[0] = new Tree(*this,bucket,false);
+  tree[1] = new Tree(*this,bucket,true);
 
+  Tree::Each each(tree);
+  mt::ParallelFor(0,2,each,1);
+  mem::Free(bucket);
 
- // Null all the area values, to effectivly start again...
-  for (nat32 y=0;y<img.Size(1);y++)
+
+ // Move the results into the data array...
+  prog->Report(2,3);
+  data.Size(tree[0]->store.Size() + tree[1]->store.Size());
+  nat32 i = 0;
+  for (nat32 t=0;t<2;t++)
   {
-   for (nat32 x=0;x<img.Size(0);x++)
-   {
-    forest.Get(x,y).area = 0;
-   }
-  }
-  
-  
- // Go from light to dark...
-  prog->Report(2,4);
-  prog->Push();
-   prog->Report(0,257);
-   for (nat32 i=0;i<256;i++)
+   while (tree[t]->store.Size()!=0)
    {
-    prog->Report(i,256);
-    DoList(forest,bucket[255-i],store,true);
+    data[i] = tree[t]->store.Front();
+    tree[t]->store.RemFrontKill();
+    ++i;
    }
-   Analyse(*forest.Get(0,0).Head(),store,true); // We don't want to miss the longest chain.
-  prog->Pop();
-
-
- // Move the store linked list into the data array...
-  prog->Report(3,4);
-  data.Size(store.Size());
-  for (nat32 i=0;i<data.Size();i++)
-  {
-   data[i] = store.Front();
-   store.RemFrontKill();
+   delete tree[t];
   }
 
 
@@ -370,271 +781,22 @@ bs::Element * Mser::AsXML(str::TokenTable & tt) const
  return ret;
 }
 
-void Mser::DoList(ds::Array2D<Turnip> & forest,Turnip * targ,ds::List<Node> & store,bit dir)
-{
- // Loop all the nodes in the list...
-  while (targ)
-  {
-   // Run the turnip through the forests initiation rite - give it area!..
-    targ->parent = null<Turnip*>();
-    targ->previous = null<Turnip*>();
-    targ->nextOther = targ;
-    targ->prevOther = targ;
-    targ->area = 1;
-
-
-   // Check the (possibly) 4 neighbours, merge with 'em as needed...
-    if (targ->x!=0)
-    {
-     Turnip & other = forest.Get(targ->x-1,targ->y);
-     if (other.area!=0) Merge(*targ,other,store,dir);
-    }
-
-    if (targ->x!=forest.Width()-1)
-    {
-     Turnip & other = forest.Get(targ->x+1,targ->y);
-     if (other.area!=0) Merge(*targ,other,store,dir);
-    }
-  
-    if (targ->y!=0)
-    {
-     Turnip & other = forest.Get(targ->x,targ->y-1);
-     if (other.area!=0) Merge(*targ,other,store,dir);
-    }
-  
-    if (targ->y!=forest.Height()-1)
-    {
-     Turnip & other = forest.Get(targ->x,targ->y+1);
-     if (other.area!=0) Merge(*targ,other,store,dir);
-    }
-   
-   // To next... 
-    targ = targ->next;
-  }
-}
-
-void Mser::Merge(Turnip & ta,Turnip & tb,ds::List<Node> & store,bit dir)
-{
- // Get heads for the two clusters...
-  Turnip * ha = ta.Head();
-  Turnip * hb = tb.Head();
-  if (ha==hb) return;
-
-
- // Decide which node has the smallest cluster, and run the Collect method on 
- // that path...
-  if (ha->area>hb->area) mem::PtrSwap(ha,hb);
-  Analyse(*ha,store,dir);
-  
- 
- // Arrange for ha->previous to be null, so we can safely overwrite it below...
-  ha->Collapse();
-
-
- // Make the smallest cluster the largest clusters bitch...
-  ha->previous = hb;
-  hb->parent = ha;
-  ha->area += hb->area;
- 
- // Compress the ha path, makes latter code faster and removes the possibility 
- // of a stack overflow...
-  ha->Compress();
-}
-
-void Mser::Analyse(Turnip & head,ds::List<Node> & store,bit dir)
-{
- // Check for a situation where we can't do jack, i.e. there is absolutly 
- // no chance of us finding a valid mser, if so return...
-  nat32 minRange = delta*2 + 3;
-  if ((head.area<minArea)||
-      ((!dir)&&(head.bucket<=minRange))||
-      ((dir)&&(255-head.bucket<=minRange))) return;
-
-
- // Area chart - we first fill it in then check for minima 
- // with a rolling window...
- // Have to include the relevent turnip so we can store the correct one when found.
-  nat32 area[256];
-  Turnip * node[256];
-
-  
- // Fill in the area chart and set ranges...
-  nat32 startBucket;
-  nat32 endBucket;
-  if (dir)
-  {
-   // Maximal...	  
-    Turnip * targ = &head;
-    nat32 bucket = targ->bucket;
-
-    startBucket = bucket+1; // Skip first - liable to be flawed.
-    endBucket = 255;
-
-    while (targ)
-    {
-     if (targ->bucket!=bucket)
-     {
-      while (bucket<targ->bucket)
-      {
-       ++bucket;
-       area[bucket] = targ->area;
-       node[bucket] = targ;
-      }
-     }
-     targ = targ->previous;	    
-    }
-    if (bucket==head.bucket) return;
-
-    while (bucket<255)
-    {
-     area[bucket+1] = area[bucket];
-     node[bucket+1] = node[bucket];     
-     ++bucket;
-    }
-  }
-  else
-  {
-   // Minimal...
-    Turnip * targ = &head;
-    nat32 bucket = targ->bucket;
-
-    startBucket = 0;
-    endBucket = bucket-1; // Skip last - liable to be flawed.
-
-    while (targ)
-    {
-     if (targ->bucket!=bucket)
-     {
-      while (bucket>targ->bucket)
-      {
-       --bucket;
-       area[bucket] = targ->area;
-       node[bucket] = targ;
-      }
-     }
-     targ = targ->previous;	    
-    }
-    if (bucket==head.bucket) return;
-
-    while (bucket!=0)
-    {
-     area[bucket-1] = area[bucket];
-     node[bucket-1] = node[bucket];
-     --bucket;
-    }
-  }
-
- // Iterate the given range, extract any minimas and send them on to the store method...
- // Sliding window alert.
-  real32 window[3];
-  for (nat32 i=0;i<3;i++) window[i] = 0.0;
-
-  startBucket += delta;
-  endBucket -= delta;
-  for (nat32 i=startBucket;i<=endBucket;i++)
-  {
-   window[0] = window[1];
-   window[1] = window[2];
-   window[2] = math::Abs(real32(area[i+delta])-real32(area[i-delta]))/real32(area[i]);
-   if ((window[1]<window[0])&&
-       (window[1]<window[2])&&
-       (area[i-1]>=minArea)&&(area[i-1]<=maxArea)) Store(*node[i-1],store,dir);
-  }
-}
-
-void Mser::Store(const Turnip & head,ds::List<Node> & store,bit dir)
+//------------------------------------------------------------------------------
+// Extracts a range of keys...
+class MserKeys::Batch
 {
- LogTime("eos::filter::Mser::Store");
- Node node;
+ public:
+  Batch(MserKeys & s):self(s) {}
 
-
- // Basics...
-  node.maximal = dir;
-  node.pixel[0] = head.x;
-  node.pixel[1] = head.y;
-  node.area = head.area;
-
-
- // Calculate mean and threshold in a single pass...
-  nat32 n = 0;
-  node.centre[0] = 0.0;
-  node.centre[1] = 0.0;
-  real32 sumX = 0.0;
-  real32 sumY = 0.0;
-  node.threshold = head.l;
-  
-  head.CalcTolMean(dir,node.threshold,n,node.centre[0],node.centre[1],sumX,sumY);
-  
-  if (n)
+  void operator () (nat32 begin,nat32 end)
   {
-   node.centre[0] += sumX/real32(n);	  
-   node.centre[1] += sumY/real32(n);
+   for (nat32 i=begin;i<end;i++) self.MakeKey(i);
   }
 
+ private:
+  MserKeys & self;
+};
 
- // Calculate covariance in a second pass...  
-  node.covariance[0][0] = 0.0;
-  node.covariance[0][1] = 0.0;
-  node.covariance[1][1] = 0.0;
-  head.CalcCovar(node.centre,node.covariance);
-  node.covariance[0][0] /= real32(node.area);
-  node.covariance[0][1] /= real32(node.area);
-  node.covariance[1][1] /= real32(node.area);
-  node.covariance[1][0] = node.covariance[0][1];
-  
-
-
- // Generate an affine frame...
-  // Create a transformation upto an unknown rotation...
-   math::Mat<2> temp;
-   math::Mat<2> affineInv = node.covariance;
-   math::Inverse(affineInv,temp);
-   math::Sqrt22(affineInv);
-   node.affine = affineInv;
-   math::Inverse(node.affine,temp);
-
-   
-  // In a third pass find the furthest point, under the affine frame...
-   real32 best = 0.0;
-   bs::Pnt furthest;
-   head.CalcExt(node.centre,affineInv,best,furthest);
-
-  // Rotate (A Givens rotation is used.)...
-   math::Mat<2> rot;
-   real32 c;
-   real32 s;
-   if (math::IsZero(furthest[1]))
-   {
-    c = 1.0;
-    s = 0.0;	     
-   }
-   else
-   {
-    if (math::Abs(furthest[1])>math::Abs(furthest[0]))
-    {
-     real32 r = -furthest[0]/furthest[1];
-     s = math::InvSqrt(1.0+math::Sqr(r));
-     c = s*r;
-    }
-    else
-    {
-     real32 r = -furthest[1]/furthest[0];
-     c = math::InvSqrt(1.0+math::Sqr(r));
-     s = c*r;
-    }
-   }
-     
-   rot[0][0] = c;  rot[0][1] = s;
-   rot[1][0] = -s; rot[1][1] = c;
-   math::Mult(node.affine,rot,temp);
-   node.affine = temp;
-
-
- // Store...
-  store.AddBack(node);
-}
-
-//------------------------------------------------------------------------------
 MserKeys::MserKeys()
 {}
    
@@ -655,18 +817,29 @@ void MserKeys::Run(time::Progress * prog)
   prog->Report(1,2);
    prog->Push();
 
-    key.Size(Size());   
-    for (nat32 i=0;i<Size();i++)
+    key.Size(Size());
+    Batch batch(*this);
+    nat32 step = math::Max<nat32>(mt::DefaultPool().Concurrency()*16,1);
+    for (nat32 i=0;i<Size();i+=step)
     {
      prog->Report(i,Size());
-     MserKey & targ = key[i];
-     targ.index = i;
-     
-     // Iterate and grab each pixel...
-      for (nat32 y=0;y<21;y++)
-      {
-       for (nat32 x=0;x<21;x++)
-       {
+     mt::ParallelFor(i,math::Min(i+step,Size()),batch,4);
+    }
+
+   prog->Pop();
+ prog->Pop();	
+}
+
+void MserKeys::MakeKey(nat32 i)
+{
+ MserKey & targ = key[i];
+ targ.index = i;
+ 
+ // Iterate and grab each pixel...
+  for (nat32 y=0;y<21;y++)
+  {
+   for (nat32 x=0;x<21;x++)
+   {
 	// Get pixel position...
 	 bs::Pnt bp;
 	 bs::Pnt pp;
@@ -711,45 +884,41 @@ void MserKeys::Run(time::Progress * prog)
 	 targ[offset] = final.r;
 	 targ[offset+1] = final.g;
 	 targ[offset+2] = final.b;
-       }
-      }
-     
-     // Normalise - 3 passes...
-      // Mean...
-       for (nat32 j=0;j<3;j++) targ.mean[j] = 0;
-       for (nat32 j=0;j<21*21;j++)
-       {
+   }
+  }
+ 
+ // Normalise - 3 passes...
+  // Mean...
+   for (nat32 j=0;j<3;j++) targ.mean[j] = 0;
+   for (nat32 j=0;j<21*21;j++)
+   {
 	targ.mean[0] += targ[j*3];
 	targ.mean[1] += targ[j*3+1];
 	targ.mean[2] += targ[j*3+2];
-       }
-       for (nat32 j=0;j<3;j++) targ.mean[j] /= 21.0*21.0;
+   }
+   for (nat32 j=0;j<3;j++) targ.mean[j] /= 21.0*21.0;
 
-      // Sd...
-       for (nat32 j=0;j<3;j++) targ.sd[j] = 0;
-       for (nat32 j=0;j<21*21;j++)
-       {
+  // Sd...
+   for (nat32 j=0;j<3;j++) targ.sd[j] = 0;
+   for (nat32 j=0;j<21*21;j++)
+   {
 	targ.sd[0] += math::Sqr(targ.mean[0]-targ[j*3]);
 	targ.sd[1] += math::Sqr(targ.mean[1]-targ[j*3+1]);
 	targ.sd[2] += math::Sqr(targ.mean[2]-targ[j*3+2]);
-       }
-       for (nat32 j=0;j<3;j++)
-       {
-        targ.sd[j] = math::Sqrt(targ.sd[j]/21.0*21.0);
-        if (math::IsZero(targ.sd[j])) targ.sd[j] = 1.0;
-       }
-      
-      // Apply...
-       for (nat32 j=0;j<21*21;j++)
-       {
-        targ[j*3]   = (targ[j*3]  -targ.mean[0])/targ.sd[0];
-        targ[j*3+1] = (targ[j*3+1]-targ.mean[1])/targ.sd[1];
-        targ[j*3+2] = (targ[j*3+2]-targ.mean[2])/targ.sd[2];
-       }
-    }
-
-   prog->Pop();
- prog->Pop();	
+   }
+   for (nat32 j=0;j<3;j++)
+   {
+    targ.sd[j] = math::Sqrt(targ.sd[j]/21.0*21.0);
+    if (math::IsZero(targ.sd[j])) targ.sd[j] = 1.0;
+   }
+  
+  // Apply...
+   for (nat32 j=0;j<21*21;j++)
+   {
+    targ[j*3]   = (targ[j*3]  -targ.mean[0])/targ.sd[0];
+    targ[j*3+1] = (targ[j*3+1]-targ.mean[1])/targ.sd[1];
+    targ[j*3+2] = (targ[j*3+2]-targ.mean[2])/targ.sd[2];
+   }
 }
 
 const MserKey & MserKeys::Key(nat32 i) const
@@ -67,7 +67,10 @@ class EOS_CLASS Mser
    void Set(const svt::Field<bs::ColourL> & img);
 
    
-  /// &nbsp;
+  /// Finds the MSERs. A linear time component tree is built by flood filling
+  /// in order of grey level, the minimal and maximal regions at the same time
+  /// on two threads if avaliable. Memory use is around 30 bytes per pixel.
+  /// Minimal MSERs come before maximal in the output.
    void Run(time::Progress * prog = null<time::Progress*>());
    
    
@@ -144,145 +147,10 @@ class EOS_CLASS Mser
   ds::Array<Node> data;
 
   
-  // The forest data structure used for merging...
-   struct Turnip
-   {
-    nat32 x;
-    nat32 y;
-    real32 l;
-    nat32 bucket;
-
-    Turnip * next; // Linked list of nodes at any particular level, so they can be iterated in the right order.
-
-    Turnip * parent; // Points to the parent node. Path shortening is applied.
-    Turnip * previous; // These form a linked list of nodes from any given head, through the clustering route - by taking areas along this route you get the relevant graph.
-    Turnip * nextOther; // Points to the node that lost at each merge step, so all can be iterated for means/covariances etc.
-    Turnip * prevOther; // (Its a doubly linked list, never null)
-    
-    nat32 area; // Total area if you sum all nodes following previous and other, excluding parents obviously. Set to 0 to indicate that the node has yet to enter the forest.
-
-
-    Turnip * Head()
-    {
-     if (parent)
-     {
-      parent = parent->Head();
-      return parent;
-     }
-     else return this;	    
-    }
-    
-    void Collapse() // Disolves the previous into the nextOther list, nulls the previous essnetially.
-    {
-     if (previous)
-     {
-      previous->prevOther->nextOther = nextOther;
-      nextOther->prevOther = previous->prevOther;
-   
-      previous->prevOther = this;
-      nextOther = previous;
-   
-      previous = null<Turnip*>();
-      nextOther->Collapse();
-     }
-    }
-    
-    // Dissolves the previous into the nextOther list whilst until previous->bucket==bucket.
-    void Compress()
-    {
-     while ((previous)&&(previous->bucket==bucket))
-     {
-      previous->prevOther->nextOther = nextOther;
-      nextOther->prevOther = previous->prevOther;
-   
-      previous->prevOther = this;
-      nextOther = previous;
-   
-      previous = previous->previous;
-      nextOther->previous = null<Turnip*>();
-     }
-    }
-    
-    void CalcTolMean(bit dir,real32 & tol,
-                     nat32 & n,real32 & baseX,real32 & baseY,real32 & sumX,real32 & sumY) const
-    {
-     const Turnip * targ = this;
-     while (true)
-     {
-      if (dir) tol = math::Min(tol,targ->l);
-         else  tol = math::Max(tol,targ->l);
-         
-      sumX += real32(targ->x)-baseX;
-      sumY += real32(targ->y)-baseY;
-      ++n;
-     
-      if (math::Abs(sumX)+math::Abs(sumY)>1000000.0)
-      {
-       baseX += sumX/real32(n);	     
-       baseY += sumY/real32(n);
-       
-       n = 0;
-       sumX = 0.0;
-       sumY = 0.0;
-      }
-      
-      if (targ->nextOther==this) break;
-      targ = targ->nextOther;
-     }
-     
-     if (previous) previous->CalcTolMean(dir,tol,n,baseX,baseY,sumX,sumY);
-    }
-    
-    void CalcCovar(const bs::Pnt & centre,math::Mat<2> & covar) const
-    {
-     const Turnip * targ = this;
-     while (true)
-     {
-      real32 relX = targ->x - centre[0];
-      real32 relY = targ->y - centre[1];
-
-      covar[0][0] += math::Sqr(relX);
-      covar[0][1] += relX*relY;
-      covar[1][1] += math::Sqr(relY);
-
-      if (targ->nextOther==this) break;
-      targ = targ->nextOther;
-     }
-     
-     if (previous) previous->CalcCovar(centre,covar);
-    }
-    
-    void CalcExt(const bs::Pnt & centre,const math::Mat<2> & affineInv,real32 & best,bs::Pnt & furthest) const
-    {
-     const Turnip * targ = this;
-     while (true)
-     {
-      bs::Pnt pos[2];
-
-      pos[0][0] = targ->x - centre[0];
-      pos[0][1] = targ->y - centre[1];
-      math::MultVect(affineInv,pos[0],pos[1]);
-
-      real32 lenSqr = pos[1].LengthSqr();
-      if (lenSqr>best)
-      {
-       best = lenSqr;
-       furthest = pos[1];	     
-      }
-
-      if (targ->nextOther==this) break;
-      targ = targ->nextOther;
-     }
-     
-     if (previous) previous->CalcExt(centre,affineInv,best,furthest);
-    }
-   };
-   
-  // Helper methods/functions...
-   void DoList(ds::Array2D<Turnip> & forest,Turnip * targ,ds::List<Node> & store,bit dir);
-   void Merge(Turnip & ta,Turnip & tb,ds::List<Node> & store,bit dir);
-   void Analyse(Turnip & head,ds::List<Node> & store,bit dir);
-   void Store(const Turnip & head,ds::List<Node> & store,bit dir);
+  // The component tree for one polarity is built by a flood fill, in the
+  // style of Nister and Stewenius, see the .cpp. Run does both polarities
+  // with one of these each, in parallel if the thread pool allows...
+   class Tree;
 
 
   // Data structure used by the Visualise method...
@@ -383,6 +251,11 @@ class EOS_CLASS MserKeys : public Mser
  private:
   svt::Field<bs::ColourRGB> img;
   ds::Array<MserKey> key;
+
+  // Extracts key i, the keys are independent so this is done in parallel by
+  // Batch...
+   void MakeKey(nat32 i);
+   class Batch;
 };
 
 //------------------------------------------------------------------------------
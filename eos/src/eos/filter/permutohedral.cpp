@@ -0,0 +1,440 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/filter/permutohedral.h"
+
+#include "eos/mem/alloc.h"
+#include "eos/mem/functions.h"
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+
+namespace eos
+{
+ namespace filter
+ {
+//------------------------------------------------------------------------------
+// One pass of the blur along a lattice axis, vertices split between threads...
+class Permutohedral::Blur
+{
+ public:
+  Blur(const Permutohedral & s,nat32 a,nat32 ch,const real64 * f,real64 * t)
+  :self(s),axis(a),channels(ch),from(f),to(t) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 d1 = self.dims+1;
+   for (nat32 v=begin;v<end;v++)
+   {
+    const nat32 * n = self.nbr + (v*d1 + axis)*2;
+    const real64 * c = from + v*channels;
+    real64 * out = to + v*channels;
+    for (nat32 i=0;i<channels;i++) out[i] = 0.5*c[i];
+
+    for (nat32 s=0;s<2;s++)
+    {
+     if (n[s]!=0xFFFFFFFF)
+     {
+      const real64 * o = from + n[s]*channels;
+      for (nat32 i=0;i<channels;i++) out[i] += 0.25*o[i];
+     }
+    }
+   }
+  }
+
+ private:
+  const Permutohedral & self;
+  nat32 axis;
+  nat32 channels;
+  const real64 * from;
+  real64 * to;
+};
+
+// Interpolates the blurred lattice back out at the points...
+class Permutohedral::Slice
+{
+ public:
+  Slice(const Permutohedral & s,nat32 ch,const real64 * v,real64 * o)
+  :self(s),channels(ch),val(v),out(o)
+  {
+   alpha = 1.0/(1.0 + math::Pow(2.0,-real64(self.dims)));
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 d1 = self.dims+1;
+   for (nat32 p=begin;p<end;p++)
+   {
+    real64 * targ = out + p*channels;
+    for (nat32 i=0;i<channels;i++) targ[i] = 0.0;
+
+    for (nat32 r=0;r<d1;r++)
+    {
+     real64 w = alpha * self.bary[p*d1 + r];
+     const real64 * vs = val + self.vert[p*d1 + r]*channels;
+     for (nat32 i=0;i<channels;i++) targ[i] += w*vs[i];
+    }
+   }
+  }
+
+ private:
+  const Permutohedral & self;
+  nat32 channels;
+  const real64 * val;
+  real64 * out;
+  real64 alpha;
+};
+
+//------------------------------------------------------------------------------
+Permutohedral::Permutohedral()
+:points(0),dims(0),verts(0),vert(null<nat32*>()),bary(null<real32*>()),nbr(null<nat32*>()),
+key(null<int32*>()),keySize(0),table(null<nat32*>()),tableSize(0)
+{}
+
+Permutohedral::~Permutohedral()
+{
+ mem::Free(vert);
+ mem::Free(bary);
+ mem::Free(nbr);
+ mem::Free(key);
+ mem::Free(table);
+}
+
+void Permutohedral::Build(nat32 pts,nat32 d,const real32 * pos)
+{
+ nat32 d1 = d+1;
+
+ // Storage for the points...
+  if ((pts!=points)||(d!=dims))
+  {
+   mem::Free(vert);
+   mem::Free(bary);
+   vert = mem::Malloc<nat32>(pts*d1);
+   bary = mem::Malloc<real32>(pts*d1);
+  }
+  if (d!=dims)
+  {
+   mem::Free(key);
+   key = null<int32*>();
+   keySize = 0;
+  }
+  points = pts;
+  dims = d;
+
+ // Empty the hash table...
+  verts = 0;
+  if (tableSize==0)
+  {
+   tableSize = 1024;
+   table = mem::Malloc<nat32>(tableSize);
+  }
+  for (nat32 i=0;i<tableSize;i++) table[i] = 0xFFFFFFFF;
+
+ // Work arrays, and the constants - the scale makes the blur of the lattice
+ // have a standard deviation of 1 in the position space, and canonical is the
+ // offsets of the vertices of the canonical simplex...
+  real64 * scale = new real64[d];
+  real64 * elevated = new real64[d1];
+  int32 * greedy = new int32[d1];
+  int32 * rank = new int32[d1];
+  real64 * bc = new real64[d1+1];
+  int32 * canonical = new int32[d1*d1];
+  int32 * k = new int32[d1];
+
+  real64 invStd = real64(d1)*math::Sqrt(2.0/3.0);
+  for (nat32 i=0;i<d;i++) scale[i] = invStd/math::Sqrt(real64((i+1)*(i+2)));
+
+  for (nat32 i=0;i<d1;i++)
+  {
+   for (nat32 j=0;j<d1;j++) canonical[i*d1+j] = (j+i<=d)?int32(i):(int32(i)-int32(d1));
+  }
+
+ // Splat each point in turn...
+  for (nat32 p=0;p<points;p++)
+  {
+   const real32 * ps = pos + p*d;
+
+   // Elevate the position onto the hyperplane...
+    real64 sm = 0.0;
+    for (nat32 i=d;i>0;i--)
+    {
+     real64 cf = ps[i-1]*scale[i-1];
+     elevated[i] = sm - real64(i)*cf;
+     sm += cf;
+    }
+    elevated[0] = sm;
+
+   // Find the closest remainder 0 point...
+    int32 sum = 0;
+    for (nat32 i=0;i<d1;i++)
+    {
+     real64 v = elevated[i]/real64(d1);
+     int32 up = int32(math::RoundUp(v))*int32(d1);
+     int32 down = int32(math::RoundDown(v))*int32(d1);
+     if ((real64(up)-elevated[i])<(elevated[i]-real64(down))) greedy[i] = up;
+                                                         else greedy[i] = down;
+     sum += greedy[i];
+    }
+    sum /= int32(d1);
+
+   // Rank the differences, and fix up the point so its coordinates sum to 0...
+    for (nat32 i=0;i<d1;i++) rank[i] = 0;
+    for (nat32 i=0;i<d;i++)
+    {
+     for (nat32 j=i+1;j<d1;j++)
+     {
+      if ((elevated[i]-greedy[i])<(elevated[j]-greedy[j])) ++rank[i];
+                                                      else ++rank[j];
+     }
+    }
+
+    if (sum>0)
+    {
+     for (nat32 i=0;i<d1;i++)
+     {
+      if (rank[i]>=int32(d1)-sum) {greedy[i] -= int32(d1); rank[i] += sum - int32(d1);}
+                             else rank[i] += sum;
+     }
+    }
+    else
+    {
+     if (sum<0)
+     {
+      for (nat32 i=0;i<d1;i++)
+      {
+       if (rank[i]<-sum) {greedy[i] += int32(d1); rank[i] += int32(d1) + sum;}
+                    else rank[i] += sum;
+      }
+     }
+    }
+
+   // Barycentric weights...
+    for (nat32 i=0;i<d1+1;i++) bc[i] = 0.0;
+    for (nat32 i=0;i<d1;i++)
+    {
+     real64 delta = (elevated[i]-greedy[i])/real64(d1);
+     bc[d-rank[i]] += delta;
+     bc[d1-rank[i]] -= delta;
+    }
+    bc[0] += 1.0 + bc[d1];
+
+   // Record the vertices, creating them as needed...
+    for (nat32 r=0;r<d1;r++)
+    {
+     for (nat32 i=0;i<d;i++) k[i] = greedy[i] + canonical[r*d1 + rank[i]];
+     vert[p*d1 + r] = Lookup(k,true);
+     bary[p*d1 + r] = bc[r];
+    }
+  }
+
+ // Find the neighbours of every vertex along every axis...
+  mem::Free(nbr);
+  nbr = mem::Malloc<nat32>(verts*d1*2);
+  int32 * k2 = new int32[d1];
+  for (nat32 v=0;v<verts;v++)
+  {
+   const int32 * base = key + v*d;
+   for (nat32 j=0;j<d1;j++)
+   {
+    for (nat32 i=0;i<d;i++)
+    {
+     k[i] = base[i] + 1;
+     k2[i] = base[i] - 1;
+    }
+    if (j<d)
+    {
+     k[j] = base[j] - int32(d);
+     k2[j] = base[j] + int32(d);
+    }
+
+    nbr[(v*d1 + j)*2] = Lookup(k,false);
+    nbr[(v*d1 + j)*2 + 1] = Lookup(k2,false);
+   }
+  }
+
+ // Clean up...
+  delete[] scale;
+  delete[] elevated;
+  delete[] greedy;
+  delete[] rank;
+  delete[] bc;
+  delete[] canonical;
+  delete[] k;
+  delete[] k2;
+}
+
+void Permutohedral::Filter(nat32 channels,const real64 * in,real64 * out) const
+{
+ real64 * val = mem::Malloc<real64>(verts*channels);
+ Splat(channels,in,val);
+ Blurred(channels,val);
+
+ Slice slice(*this,channels,val,out);
+ mt::ParallelFor(0,points,slice,1024);
+
+ mem::Free(val);
+}
+
+void Permutohedral::Centre(nat32 dim,real64 * out) const
+{
+ nat32 d1 = dims+1;
+
+ // The mass at every vertex...
+  real64 * ones = mem::Malloc<real64>(points);
+  for (nat32 p=0;p<points;p++) ones[p] = 1.0;
+  real64 * mass = mem::Malloc<real64>(verts);
+  Splat(1,ones,mass);
+  mem::Free(ones);
+  Blurred(1,mass);
+
+ // Pair each vertex mass with the mass times the vertex position - the
+ // elevation of Build is inverted to get the position, which only needs the
+ // first dim+2 elevated coordinates, the last being implicit as they sum to
+ // zero...
+  real64 scale = real64(d1)*math::Sqrt(2.0/3.0)/math::Sqrt(real64((dim+1)*(dim+2)));
+  real64 * e = new real64[d1];
+  real64 * val = mem::Malloc<real64>(verts*2);
+  for (nat32 v=0;v<verts;v++)
+  {
+   const int32 * k = key + v*dims;
+   e[dims] = 0.0;
+   for (nat32 i=0;i<dims;i++)
+   {
+    e[i] = real64(k[i]);
+    e[dims] -= e[i];
+   }
+
+   real64 cf = 0.5*(e[0]-e[1]);
+   for (nat32 i=1;i<=dim;i++) cf = (e[i] - e[i+1] + real64(i)*cf)/real64(i+2);
+
+   val[v*2] = mass[v];
+   val[v*2+1] = mass[v]*cf/scale;
+  }
+  delete[] e;
+  mem::Free(mass);
+
+ // Slice, and divide through...
+  real64 * res = mem::Malloc<real64>(points*2);
+  Slice slice(*this,2,val,res);
+  mt::ParallelFor(0,points,slice,1024);
+  for (nat32 p=0;p<points;p++) out[p] = res[p*2+1]/res[p*2];
+
+ mem::Free(res);
+ mem::Free(val);
+}
+
+void Permutohedral::Splat(nat32 channels,const real64 * in,real64 * val) const
+{
+ // Serial, as neighbouring points share vertices...
+ nat32 d1 = dims+1;
+ for (nat32 i=0;i<verts*channels;i++) val[i] = 0.0;
+ for (nat32 p=0;p<points;p++)
+ {
+  const real64 * src = in + p*channels;
+  for (nat32 r=0;r<d1;r++)
+  {
+   real64 w = bary[p*d1 + r];
+   real64 * targ = val + vert[p*d1 + r]*channels;
+   for (nat32 i=0;i<channels;i++) targ[i] += w*src[i];
+  }
+ }
+}
+
+void Permutohedral::Blurred(nat32 channels,real64 * val) const
+{
+ real64 * temp = mem::Malloc<real64>(verts*channels);
+ real64 * from = val;
+ real64 * to = temp;
+ for (nat32 j=0;j<dims+1;j++)
+ {
+  Blur blur(*this,j,channels,from,to);
+  mt::ParallelFor(0,verts,blur,256);
+  math::Swap(from,to);
+ }
+ if (from!=val) mem::Copy(val,from,verts*channels);
+ mem::Free(temp);
+}
+
+nat32 Permutohedral::Lookup(const int32 * k,bit create)
+{
+ nat32 h = 0;
+ for (nat32 i=0;i<dims;i++) h = (h + nat32(k[i]))*2531011;
+
+ nat32 mask = tableSize-1;
+ nat32 s = h&mask;
+ while (true)
+ {
+  nat32 v = table[s];
+  if (v==0xFFFFFFFF) break;
+
+  const int32 * vk = key + v*dims;
+  bit match = true;
+  for (nat32 i=0;i<dims;i++)
+  {
+   if (vk[i]!=k[i]) {match = false; break;}
+  }
+  if (match) return v;
+
+  s = (s+1)&mask;
+ }
+
+ if (!create) return 0xFFFFFFFF;
+
+ // Its new - add it, growing as needed, which moves everything...
+  if ((verts+1)*2>tableSize)
+  {
+   Grow();
+   return Lookup(k,true);
+  }
+
+  if (verts==keySize)
+  {
+   nat32 newSize = math::Max<nat32>(keySize*2,1024);
+   int32 * newKey = mem::Malloc<int32>(newSize*dims);
+   if (key) mem::Copy(newKey,key,keySize*dims);
+   mem::Free(key);
+   key = newKey;
+   keySize = newSize;
+  }
+
+  mem::Copy(key + verts*dims,k,dims);
+  table[s] = verts;
+  return verts++;
+}
+
+void Permutohedral::Grow()
+{
+ mem::Free(table);
+ tableSize *= 2;
+ table = mem::Malloc<nat32>(tableSize);
+ for (nat32 i=0;i<tableSize;i++) table[i] = 0xFFFFFFFF;
+
+ nat32 mask = tableSize-1;
+ for (nat32 v=0;v<verts;v++)
+ {
+  const int32 * k = key + v*dims;
+  nat32 h = 0;
+  for (nat32 i=0;i<dims;i++) h = (h + nat32(k[i]))*2531011;
+
+  nat32 s = h&mask;
+  while (table[s]!=0xFFFFFFFF) s = (s+1)&mask;
+  table[s] = v;
+ }
+}
+
+//------------------------------------------------------------------------------
+ };
+};
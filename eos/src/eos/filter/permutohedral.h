@@ -0,0 +1,132 @@
+#ifndef EOS_FILTER_PERMUTOHEDRAL_H
+#define EOS_FILTER_PERMUTOHEDRAL_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file permutohedral.h
+/// Provides the permutohedral lattice, for doing high dimensional Gaussian
+/// filters, such as bilateral filters, in time that doesn't depend on the
+/// standard deviation.
+
+#include "eos/types.h"
+
+namespace eos
+{
+ namespace filter
+ {
+//------------------------------------------------------------------------------
+/// The permutohedral lattice of Adams, Baek and Davis, used to approximate a
+/// Gaussian blur over a set of points with arbitrary dimensional positions.
+/// The values at each point are splatted onto the vertices of the simplex of
+/// the lattice that encloses it, the lattice is blurred with a [1 2 1] kernel
+/// along each of its d+1 axes, and the values are then sliced back out at the
+/// points with the same barycentric weights. Only the lattice vertices that
+/// are actually touched are stored, in a hash table, so the cost is linear in
+/// the point count and in the dimensions, and independent of the standard
+/// deviation - the positions are scaled so a standard deviation is 1 before
+/// being handed over. This makes it ideal for bilateral filtering, where the
+/// position is the pixel coordinate and colour each divided by their
+/// respective standard deviations.
+/// The lattice is built once for a set of positions, after which Filter can be
+/// called as often as wanted with different values. The result is unnormalised,
+/// so the usual approach is to include a channel of 1's and divide by its
+/// output, or the result of Filter on a field of 1's otherwise. Blurring and
+/// slicing are threaded.
+class EOS_CLASS Permutohedral
+{
+ public:
+  /// &nbsp;
+   Permutohedral();
+
+  /// &nbsp;
+   ~Permutohedral();
+
+
+  /// Builds the lattice for the given positions, of which there are points,
+  /// each with dims dimensions, stored consecutivly. The positions should be
+  /// pre-divided by the standard deviation of the desired blur. Can be called
+  /// repeatedly, replacing the previous lattice.
+   void Build(nat32 points,nat32 dims,const real32 * pos);
+
+  /// Returns how many points were given to Build.
+   nat32 Points() const {return points;}
+
+  /// Returns the dimensions of the positions given to Build.
+   nat32 Dims() const {return dims;}
+
+  /// Returns how many lattice vertices are in use, i.e. how large the
+  /// downsampled representation is.
+   nat32 Vertices() const {return verts;}
+
+  /// Filters the given values, which are Points() by channels stored
+  /// consecutivly, writting the blurred result into out, same layout. in and
+  /// out can be the same memory. Accumulation is done in real64 with real64
+  /// input and output, so that moment calculations, where a large coordinate
+  /// gets subtracted afterwards, survive.
+   void Filter(nat32 channels,const real64 * in,real64 * out) const;
+
+  /// The kernel Filter applies at a point is interpolated from the vertices of
+  /// its simplex, so its centre is only at the point on average - when the
+  /// vertices carry different amounts of mass its pulled towards the heavier
+  /// ones. This outputs, for each point, where the centre of its kernel would
+  /// be in the given dimension if every point carried equal weight, in the
+  /// units of the positions given to Build. Comparing this with the weighted
+  /// mean position produced by Filter seperates genuine asymmetry of the data
+  /// from the quantisation of the lattice, which matters when calculating
+  /// differentials.
+   void Centre(nat32 dim,real64 * out) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::filter::Permutohedral";}
+
+
+ private:
+  nat32 points;
+  nat32 dims;
+  nat32 verts;
+
+  // For each point its d+1 enclosing vertices and their barycentric weights...
+   nat32 * vert;
+   real32 * bary;
+
+  // For each vertex and each of the d+1 axes the two neighbours, or
+  // 0xFFFFFFFF when the neighbour was never created...
+   nat32 * nbr;
+
+  // The hash table used during construction, kept around so rebuilding
+  // doesn't reallocate. key has dims entrys per vertex, table indexes into
+  // the vertices...
+   int32 * key;
+   nat32 keySize; // Vertices key has room for.
+   nat32 * table;
+   nat32 tableSize; // Power of 2.
+
+  void Splat(nat32 channels,const real64 * in,real64 * val) const; // val is per vertex.
+  void Blurred(nat32 channels,real64 * val) const; // Blurs per vertex values in place.
+  nat32 Lookup(const int32 * k,bit create);
+  void Grow();
+
+  class Blur;
+  class Slice;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
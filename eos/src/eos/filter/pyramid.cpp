@@ -20,6 +20,7 @@
 #include "eos/math/constants.h"
 #include "eos/math/functions.h"
 #include "eos/filter/kernel.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -27,7 +28,7 @@ namespace eos
  {
 //-----------------------------------------------------------------------------
 Pyramid::Pyramid()
-:octaves(0),scales(3),extras(3),octave(null<svt::Var**>()),
+:octaves(0),scales(3),extras(3),levels(0),octave(null<svt::Var**>()),
 maxOctaves(32),smallestDim(8)
 {}
 
@@ -52,87 +53,118 @@ void Pyramid::SetStop(nat32 mo,nat32 sd)
  smallestDim = sd;	
 }
 
-void Pyramid::Construct(const svt::Field<real32> & image)
+// Copys a field into another, optionally taking every second pixel so it
+// decimates, by rows over the thread pool...
+class PyramidCopy
 {
- // Clean up previous...
-  if (octave)
+ public:
+  PyramidCopy(const svt::Field<real32> & i,svt::Field<real32> & o,nat32 s)
+  :in(i),out(o),step(s)
+  {}
+
+  void Run()
   {
-   for (nat32 i=0;i<octaves;i++)
+   mt::ParallelFor(0,out.Size(1),*this,16);
+  }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 y=begin;y<end;y++)
    {
-    delete octave[i];	 
+    for (nat32 x=0;x<out.Size(0);x++) out.Get(x,y) = in.Get(x*step,y*step);
    }
-   delete[] octave;
   }
- 
+
+
+ private:
+  const svt::Field<real32> & in;
+  svt::Field<real32> & out;
+  nat32 step;
+};
+
+void Pyramid::Construct(const svt::Field<real32> & image)
+{
  // First work out how many octaves we will be building...
-  octaves = math::Min(maxOctaves,math::TopBit(math::Max(image.Size(0),image.Size(1)))-math::TopBit(smallestDim));
-  log::Assert(octaves!=0);
-  octave = new svt::Var*[octaves];
+  nat32 newOctaves = math::Min(maxOctaves,math::TopBit(math::Max(image.Size(0),image.Size(1)))-math::TopBit(smallestDim));
+  log::Assert(newOctaves!=0);
 
 
- // Declare kernels...
-  KernelVect gaussVect(3);
-  KernelMat gauss(3);
+ // If the previous pyramid has the same shape then its memory is reused,
+ // otherwise clean it up and make a new one. This makes repeated construction,
+ // as for video, avoid reallocating every level each time...
+  bit reuse = (octave!=null<svt::Var**>())&&(newOctaves==octaves)&&(levels==scales+extras)&&
+              (octave[0]->Size(0)==image.Size(0))&&(octave[0]->Size(1)==image.Size(1));
+  if (!reuse)
+  {
+   if (octave)
+   {
+    for (nat32 i=0;i<octaves;i++)
+    {
+     delete octave[i];
+    }
+    delete[] octave;
+   }
 
+   octaves = newOctaves;
+   levels = scales + extras;
+   octave = new svt::Var*[octaves];
 
- // Make a pass buffer to store the data for when moving between octaves,
- // put the base image into it...
-  nat32 width = image.Size(0);
-  nat32 height = image.Size(1);
-  
-  svt::Var passBufVar(image);
+   nat32 width = image.Size(0);
+   nat32 height = image.Size(1);
    real32 nullReal = 0.0;
-   passBufVar.Add(str::Token(1),nullReal);
-   passBufVar.Commit(false);
-  
-  svt::Field<real32> passBuf(&passBufVar,str::Token(1));
-   passBuf.CopyFrom(image);
+   for (nat32 i=0;i<octaves;i++)
+   {
+    octave[i] = new svt::Var(image);
+    octave[i]->Setup2D(width,height);
+    for (nat32 j=0;j<levels;j++) octave[i]->Add(str::Token(j+1),nullReal);
+    octave[i]->Commit(false);
 
+    width /= 2;
+    height /= 2;
+   }
+  }
 
- // Loop the octaves and construct the data for each one...  
-  for (nat32 i=0;i<octaves;i++)
+
+ // Make the kernels, these are the same for every octave...
+  KernelVect * gauss = new KernelVect[levels];
+  for (nat32 j=1;j<levels;j++)
   {
-   // Make the output data structure...   
-    octave[i] = new svt::Var(passBuf);    
-    octave[i]->Setup2D(width,height);
-    for (nat32 j=0;j<scales+extras;j++) octave[i]->Add(str::Token(j+1),nullReal);
-    octave[i]->Commit(false);
+   real32 sigma = math::Sqrt(math::Pow(2.0,2.0/scales) - 1.0) * 1.6;
+          sigma *= math::Pow<real32>(math::Pow(2.0,1.0/scales),j-1);
+   gauss[j].SetSize(nat32(2.0*sigma));
+   gauss[j].MakeGaussian(sigma);
+  }
 
 
-   // Copy in the first layer then make the rest of the data...
-    svt::Field<real32> a(octave[i],str::Token(1));
-    svt::Field<real32> b;
-    
-    for (nat32 y=0;y<height;y++)
-    {
-     for (nat32 x=0;x<width;x++) a.Get(x,y) = passBuf.Get(x,y);
-    }
+ // Put the image into the first layer, then loop the octaves - each blurs up
+ // from its first layer and decimates the layer with double the blur of the
+ // first straight into the first layer of the next octave...
+  svt::Field<real32> a;
+  svt::Field<real32> b;
 
-    for (nat32 j=1;j<scales+extras;j++)
-    {
-     real32 sigma = math::Sqrt(math::Pow(2.0,2.0/scales) - 1.0) * 1.6;
-            sigma *= math::Pow<real32>(math::Pow(2.0,1.0/scales),j-1);
-     gaussVect.SetSize(nat32(2.0*sigma));
-     gaussVect.MakeGaussian(sigma);    
-     gaussVect.ConvertTo(gauss);	    
-	    
-     octave[i]->ByName(str::Token(j),a);
-     octave[i]->ByName(str::Token(j+1),b);
-     
-     gauss.Apply(a,b);
-    }
+  octave[0]->ByName(str::Token(1),a);
+  PyramidCopy first(image,a,1);
+  first.Run();
 
+  for (nat32 i=0;i<octaves;i++)
+  {
+   for (nat32 j=1;j<levels;j++)
+   {
+    octave[i]->ByName(str::Token(j),a);
+    octave[i]->ByName(str::Token(j+1),b);
+    gauss[j].Apply(a,b);
 
-   // Fill the pass buffer with the data for the next octave, and prep dimensions...	  
-    width /= 2;
-    height /= 2;
-       
-    octave[i]->ByName(str::Token(scales+1),a);
-    for (nat32 y=0;y<height;y++)
+    if ((j+1==scales+1)&&(i+1<octaves))
     {
-     for (nat32 x=0;x<width;x++) passBuf.Get(x,y) = a.Get(x*2,y*2);
+     svt::Field<real32> next;
+     octave[i+1]->ByName(str::Token(1),next);
+     PyramidCopy decimate(b,next,2);
+     decimate.Run();
     }
+   }
   }
+
+ delete[] gauss;
 }
 
 nat32 Pyramid::Scales() const
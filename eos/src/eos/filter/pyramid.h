@@ -62,7 +62,10 @@ class EOS_CLASS Pyramid
    
   /// Constructs the pyramid, you must call this before doing anything else
   /// other than setting parameters. Do not change parameters after calling
-  /// this, you can recall it to rebuild.
+  /// this, you can recall it to rebuild. When rebuilding with an image of the
+  /// same size the memory of the previous pyramid is reused, so for video
+  /// keep the one object and recall this for each frame. Each blur is spread
+  /// over the threads of mt::DefaultPool() by rows.
    void Construct(const svt::Field<real32> & image);
 
 
@@ -107,6 +110,7 @@ class EOS_CLASS Pyramid
    nat32 octaves; // Size of below array.
    nat32 scales; // Scales per octave.
    nat32 extras; // Extra scales above and beyond the transfer point.
+   nat32 levels; // scales+extras when octave was allocated, to detect changes.
    svt::Var ** octave;
 
    real32 baseBlur;
@@ -24,7 +24,10 @@ namespace eos
  namespace filter
  {
 //------------------------------------------------------------------------------
-EOS_FUNC void ScaleExtend(const svt::Field<real32> & in,svt::Field<real32> & out,real32 scaler)
+// The unmasked scaler, for any T that converts to and from real32. The sum is
+// kept in real32, so compact storage only costs the rounding of the result...
+template <typename T>
+static void ScaleChannel(const svt::Field<T> & in,svt::Field<T> & out,real32 scaler)
 {
  real32 mult = 1.0/scaler;
 
@@ -32,7 +35,7 @@ EOS_FUNC void ScaleExtend(const svt::Field<real32> & in,svt::Field<real32> & out
  {
   for (int32 x=0;x<int32(out.Size(0));x++)
   {
-   out.Get(x,y) = 0.0;
+   real32 sum = 0.0;
    real32 weight = 0.0;
 
    // Calculate the range to be sampled (inclusive both ends)...
@@ -54,7 +57,7 @@ EOS_FUNC void ScaleExtend(const svt::Field<real32> & in,svt::Field<real32> & out
       real32 my = maxY - minY;
 
       weight += mx*my;
-      out.Get(x,y) += mx*my*in.Get(endX,endY);
+      sum += mx*my*real32(in.Get(endX,endY));
      }
      else
      {
@@ -64,13 +67,13 @@ EOS_FUNC void ScaleExtend(const svt::Field<real32> & in,svt::Field<real32> & out
 
       // Sum in the end points...
        weight += mx*(sy + ey);
-       out.Get(x,y) += mx*(sy*in.Get(endX,startY) + ey*in.Get(endX,endY));
+       sum += mx*(sy*real32(in.Get(endX,startY)) + ey*real32(in.Get(endX,endY)));
 
       // Sum in the line...
        for (int32 v=startY+1;v<endY;v++)
        {
         weight += mx;
-        out.Get(x,y) += mx*in.Get(endX,v);
+        sum += mx*real32(in.Get(endX,v));
        }
      }
     }
@@ -84,13 +87,13 @@ EOS_FUNC void ScaleExtend(const svt::Field<real32> & in,svt::Field<real32> & out
 
       // Sum in the end points...
        weight += (sx + ex)*my;
-       out.Get(x,y) += (sx*in.Get(startX,endY) + ex*in.Get(endX,endY))*my;
+       sum += (sx*real32(in.Get(startX,endY)) + ex*real32(in.Get(endX,endY)))*my;
 
       // Sum in the line...
        for (int32 u=startX+1;u<endX;u++)
        {
         weight += my;
-        out.Get(x,y) += my*in.Get(u,endY);
+        sum += my*real32(in.Get(u,endY));
        }
      }
      else
@@ -102,22 +105,22 @@ EOS_FUNC void ScaleExtend(const svt::Field<real32> & in,svt::Field<real32> & out
 
       // Sum in the corners...
        weight += sx*sy + sx*ey + ex*sy + ex*ey;
-       out.Get(x,y) += sx*sy*in.Get(startX,startY) +
-                       sx*ey*in.Get(startX,endY) +
-                       ex*sy*in.Get(endX,startY) +
-                       ex*ey*in.Get(endX,endY);
+       sum += sx*sy*real32(in.Get(startX,startY)) +
+              sx*ey*real32(in.Get(startX,endY)) +
+              ex*sy*real32(in.Get(endX,startY)) +
+              ex*ey*real32(in.Get(endX,endY));
 
       // Sum in the edges...
        for (int32 u=startX+1;u<endX;u++)
        {
         weight += sy + ey;
-        out.Get(x,y) += sy*in.Get(u,startY) + ey*in.Get(u,endY);
+        sum += sy*real32(in.Get(u,startY)) + ey*real32(in.Get(u,endY));
        }
 
        for (int32 v=startY+1;v<endY;v++)
        {
         weight += sx + ex;
-        out.Get(x,y) += sx*in.Get(startX,v) + ex*in.Get(endX,v);
+        sum += sx*real32(in.Get(startX,v)) + ex*real32(in.Get(endX,v));
        }
 
       // Sum in the soft juicy centre...
@@ -125,18 +128,24 @@ EOS_FUNC void ScaleExtend(const svt::Field<real32> & in,svt::Field<real32> & out
        {
         for (int32 u=startX+1;u<endX;u++)
         {
-         out.Get(x,y) += in.Get(u,v);
+         sum += real32(in.Get(u,v));
          weight += 1.0;
         }
        }
      }
     }
 
-   if (!math::IsZero(weight)) out.Get(x,y) /= weight;
+   if (!math::IsZero(weight)) sum /= weight;
+   out.Get(x,y) = sum;
   }
  }
 }
 
+EOS_FUNC void ScaleExtend(const svt::Field<real32> & in,svt::Field<real32> & out,real32 scaler)
+{
+ ScaleChannel(in,out,scaler);
+}
+
 EOS_FUNC void ScaleExtend(const svt::Field<real32> & in,const svt::Field<bit> & inMask,
                           svt::Field<real32> & out ,svt::Field<bit> & outMask,
                           real32 scaler)
@@ -372,6 +381,55 @@ EOS_FUNC void ScaleExtend(const svt::Field<bs::ColourRGB> & in,const svt::Field<
  ScaleExtend(inB,inMask,outB,outMask,scaler);
 }
 
+EOS_FUNC void ScaleExtend(const svt::Field<math::Half> & in,svt::Field<math::Half> & out,real32 scaler)
+{
+ ScaleChannel(in,out,scaler);
+}
+
+EOS_FUNC void ScaleExtend(const svt::Field<math::Unorm8> & in,svt::Field<math::Unorm8> & out,real32 scaler)
+{
+ ScaleChannel(in,out,scaler);
+}
+
+EOS_FUNC void ScaleExtend(const svt::Field<math::Unorm16> & in,svt::Field<math::Unorm16> & out,real32 scaler)
+{
+ ScaleChannel(in,out,scaler);
+}
+
+// The colour versions, each channel done as a field of its own...
+template <typename C,typename E>
+static void ScaleColour(const svt::Field<C> & in,svt::Field<C> & out,real32 scaler)
+{
+ for (nat32 c=0;c<3;c++)
+ {
+  svt::Field<E> inC;
+  svt::Field<E> outC;
+  in.SubField(sizeof(E)*c,inC);
+  out.SubField(sizeof(E)*c,outC);
+  ScaleChannel(inC,outC,scaler);
+ }
+}
+
+EOS_FUNC void ScaleExtend(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGBh> & out,real32 scaler)
+{
+ ScaleColour<bs::ColourRGBh,math::Half>(in,out,scaler);
+}
+
+EOS_FUNC void ScaleExtend(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuvh> & out,real32 scaler)
+{
+ ScaleColour<bs::ColourLuvh,math::Half>(in,out,scaler);
+}
+
+EOS_FUNC void ScaleExtend(const svt::Field<bs::ColRGB> & in,svt::Field<bs::ColRGB> & out,real32 scaler)
+{
+ ScaleColour<bs::ColRGB,math::Unorm8>(in,out,scaler);
+}
+
+EOS_FUNC void ScaleExtend(const svt::Field<bs::ColRGB16> & in,svt::Field<bs::ColRGB16> & out,real32 scaler)
+{
+ ScaleColour<bs::ColRGB16,math::Unorm16>(in,out,scaler);
+}
+
 //------------------------------------------------------------------------------
  };
 };
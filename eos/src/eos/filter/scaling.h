@@ -49,6 +49,28 @@ EOS_FUNC void ScaleExtend(const svt::Field<bs::ColourRGB> & in,const svt::Field<
                           svt::Field<bs::ColourRGB> & out,svt::Field<bit> & outMask,
                           real32 scaler);
 
+/// Same as the unmasked real32 version, for compact storage. The filtering is
+/// done in real32, so the only loss is in storing the result.
+EOS_FUNC void ScaleExtend(const svt::Field<math::Half> & in,svt::Field<math::Half> & out,real32 scaler);
+
+/// &nbsp;
+EOS_FUNC void ScaleExtend(const svt::Field<math::Unorm8> & in,svt::Field<math::Unorm8> & out,real32 scaler);
+
+/// &nbsp;
+EOS_FUNC void ScaleExtend(const svt::Field<math::Unorm16> & in,svt::Field<math::Unorm16> & out,real32 scaler);
+
+/// &nbsp;
+EOS_FUNC void ScaleExtend(const svt::Field<bs::ColourRGBh> & in,svt::Field<bs::ColourRGBh> & out,real32 scaler);
+
+/// &nbsp;
+EOS_FUNC void ScaleExtend(const svt::Field<bs::ColourLuvh> & in,svt::Field<bs::ColourLuvh> & out,real32 scaler);
+
+/// The byte channels are treated as math::Unorm8, so [0,255] is [0,1].
+EOS_FUNC void ScaleExtend(const svt::Field<bs::ColRGB> & in,svt::Field<bs::ColRGB> & out,real32 scaler);
+
+/// &nbsp;
+EOS_FUNC void ScaleExtend(const svt::Field<bs::ColRGB16> & in,svt::Field<bs::ColRGB16> & out,real32 scaler);
+
 //------------------------------------------------------------------------------
  };
 };
@@ -26,6 +26,7 @@
 #include "eos/svt/var.h"
 #include "eos/svt/field.h"
 #include "eos/ds/arrays.h"
+#include "eos/ds/csr_graphs.h"
 
 namespace eos
 {
@@ -33,7 +34,8 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 /// Using a 4 way neighbourhood constructs a fast way of querying for the list
-/// of neighbouring segments for any given segment.
+/// of neighbouring segments for any given segment. Neighbours are given in
+/// increasing order of segment index.
 class EOS_CLASS SegGraph
 {
  public:
@@ -46,30 +48,28 @@ class EOS_CLASS SegGraph
 
 
   /// Returns how many segments are avaliable for querying.
-   nat32 Segments();
+   nat32 Segments() const {return graph.Vertices();}
 
   /// Returns how many neighbours a given segment has.
-   nat32 NeighbourCount(nat32 seg);
+   nat32 NeighbourCount(nat32 seg) const {return graph.Degree(seg);}
 
   /// Returns neighbour n of the given segment.
-   nat32 Neighbour(nat32 seg,nat32 n);
+   nat32 Neighbour(nat32 seg,nat32 n) const {return graph.Neighbour(seg,n);}
    
   /// Returns how many shared edges under 4 connectivity exist for
   /// the given segment on the border with the segment in position n.
-   nat32 BorderSize(nat32 seg,nat32 n);
+   nat32 BorderSize(nat32 seg,nat32 n) const {return graph.Weight(seg,n);}
+
+  /// Returns the underlying graph, with the border sizes as weights.
+   const ds::CsrGraph<nat32> & Graph() const {return graph;}
 
 
   /// &nbsp;
    inline cstrconst TypeString() const {return "eos::filter::SegGraph";}
 
 
- private:	
-  struct Node
-  {
-   nat32 size;
-   Pair<nat32,nat32> * data;
-  };
-  ds::Array<Node> sed;
+ private:
+  ds::CsrGraph<nat32> graph;
 };
 
 //------------------------------------------------------------------------------
@@ -19,6 +19,7 @@
 
 #include "eos/mem/alloc.h"
 #include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -163,150 +164,140 @@ void Segmenter::GetOutput(ds::Array2D<nat32> & out) const
 }
 
 //------------------------------------------------------------------------------
-void Segmenter::MergeBasic()
+// Does the union-find for a band of rows, only touching nodes within the band
+// so bands can be done in parallel...
+class Segmenter::MergeBand
 {
- // Now iterativly merge - we do this by iterating all Nodes and checking 
- // there neighbours, and merging with the closest neighbour if there is
- // one within the cutoff. When an iteration with no change happens we stop.
-  while (true)
+ public:
+  MergeBand(Segmenter & s,nat32 bh):self(s),bandHeight(bh) {}
+
+  void operator () (nat32 begin,nat32 end)
   {
-   // First pass, select neighbours to cluster with for each node.
-    Node * targ = forest;
-    for (nat32 y=0;y<height;y++)
+   for (nat32 b=begin;b<end;b++)
+   {
+    nat32 y0 = b*bandHeight;
+    nat32 y1 = math::Min(y0+bandHeight,self.height);
+    for (nat32 y=y0;y<y1;y++)
     {
-     for (nat32 x=0;x<width;x++)
+     Node * targ = self.NodeAt(0,y);
+     for (nat32 x=0;x<self.width;x++)
      {
-      if (!targ->stop)
+      if (x+1!=self.width)
       {
-       Node * head = targ->Head();
-
-       Node * nearHead = 0;
-       Node * nearNode = 0;
-       real32 nearDist = 1e100; // distance squared in fact, for speed.
-
-       // Find the minimum distance to the 4 neighbours, ignoring once of the same cluster...
-        // Left...
-         if (x!=0)
-         {
-          Node * tempNode = (Node*)((byte*)targ - nodeSize);
-          Node * tempHead = tempNode->Head();
-          if (tempHead!=head)
-          {
-           real32 tempDist = 0.0;
-           for (nat32 i=0;i<feat.Size();i++)
-           {
-            tempDist += (targ->fv[i]-tempNode->fv[i])*(targ->fv[i]-tempNode->fv[i]);
-           }
-           if (tempDist<nearDist)
-           {
-            nearHead = tempHead;
-            nearNode = tempNode;
-            nearDist = tempDist;         
-           }
-          }
-         }
+       Node * other = (Node*)((byte*)targ + self.nodeSize);
+       if (self.Near(targ,other)) self.Union(targ,other);
+      }
 
-        // Right...
-         if (x!=(width-1))
-         {
-          Node * tempNode = (Node*)((byte*)targ + nodeSize);
-          Node * tempHead = tempNode->Head();
-          if (tempHead!=head)
-          {
-           real32 tempDist = 0.0;
-           for (nat32 i=0;i<feat.Size();i++)
-           {
-            tempDist += (targ->fv[i]-tempNode->fv[i])*(targ->fv[i]-tempNode->fv[i]);
-           }
-           if (tempDist<nearDist)
-           {
-            nearHead = tempHead;
-            nearNode = tempNode;
-            nearDist = tempDist;         
-           }
-          }
-         }
+      if (y+1!=y1)
+      {
+       Node * other = (Node*)((byte*)targ + self.nodeSize*self.width);
+       if (self.Near(targ,other)) self.Union(targ,other);
+      }
 
-        // Up...
-         if (y!=0)
-         {
-          Node * tempNode = (Node*)((byte*)targ - nodeSize*width);
-          Node * tempHead = tempNode->Head();
-          if (tempHead!=head)
-          {
-           real32 tempDist = 0.0;
-           for (nat32 i=0;i<feat.Size();i++)
-           {
-            tempDist += (targ->fv[i]-tempNode->fv[i])*(targ->fv[i]-tempNode->fv[i]);
-           }
-           if (tempDist<nearDist)
-           {
-            nearHead = tempHead;
-            nearNode = tempNode;
-            nearDist = tempDist;         
-           }
-          }         
-         }
- 
-        // Down...
-         if (y!=(height-1))
-         {
-          Node * tempNode = (Node*)((byte*)targ + nodeSize*width);
-          Node * tempHead = tempNode->Head();
-          if (tempHead!=head)
-          {
-           real32 tempDist = 0.0;
-           for (nat32 i=0;i<feat.Size();i++)
-           {
-            tempDist += (targ->fv[i]-tempNode->fv[i])*(targ->fv[i]-tempNode->fv[i]);
-           }
-           if (tempDist<nearDist)
-           {
-            nearHead = tempHead;
-            nearNode = tempNode;
-            nearDist = tempDist;         
-           }
-          }
-         }
- 
-       // If it is null then we are surrounded by nodes of the same cluster - stop proccessing this one, permanantly...
-        if (nearNode==0) targ->stop = true;
-        else
-        {
-         // If the nearest cluster is within the cutoff then merge...
-          if (nearDist<(cutoff*cutoff))
-          {
-           targ->newParent = nearHead;
-          }
-        }
-       }
-      (byte*&)targ += nodeSize;
+      (byte*&)targ += self.nodeSize;
      }
     }
+   }
+  }
 
-   // Second pass, merge clusters that have been marked for the merging.
-   // Also, detect when its time to finish...
-    targ = forest;
-    bit wibble = true;
-     for (nat32 i=0;i<nodeCount;i++)
+ private:
+  Segmenter & self;
+  nat32 bandHeight;
+};
+
+// Sets the stop flag for a range of rows, once the parents have been
+// flattened...
+class Segmenter::MergeStop
+{
+ public:
+  MergeStop(Segmenter & s):self(s) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    Node * targ = self.NodeAt(0,y);
+    for (nat32 x=0;x<self.width;x++)
+    {
+     if (!targ->stop)
      {
-      if (targ->newParent)
-      {
-       Node * head1 = targ->Head();
-       Node * head2 = targ->newParent->Head();
-       targ->newParent = null<Node*>();
- 
-       if (head1!=head2)
-       {
-        head1->weight = head1->weight + head2->weight;
-        head2->parent = head1;
-        wibble = false;
-       }    
-      }
-      (byte*&)targ += nodeSize; 
+      Node * head = targ->parent ? targ->parent : targ;
+      bit stop = true;
+      if ((x!=0)&&(Top((Node*)((byte*)targ - self.nodeSize))!=head)) stop = false;
+      if ((x+1!=self.width)&&(Top((Node*)((byte*)targ + self.nodeSize))!=head)) stop = false;
+      if ((y!=0)&&(Top((Node*)((byte*)targ - self.nodeSize*self.width))!=head)) stop = false;
+      if ((y+1!=self.height)&&(Top((Node*)((byte*)targ + self.nodeSize*self.width))!=head)) stop = false;
+      targ->stop = stop;
      }
-    if (wibble) break;
+     (byte*&)targ += self.nodeSize;
+    }
+   }
   }
+
+ private:
+  Segmenter & self;
+
+  static Node * Top(Node * n) {return n->parent ? n->parent : n;}
+};
+
+void Segmenter::MergeBasic()
+{
+ // The original algorithm iterativly merged each node with its closest
+ // neighbour in another segment, if within the cutoff, till nothing changed.
+ // As the features are constant throughout this converges to the connected
+ // components of the graph of neighbours within the cutoff, which is what we
+ // calculate directly here. Unions allways make the node with the lower
+ // address the parent, so every parent pointer points backwards and the head
+ // of each segment is its first node in raster order...
+  // Bands of rows in parallel...
+   nat32 bandHeight = 32;
+   nat32 bands = (height+bandHeight-1)/bandHeight;
+   MergeBand band(*this,bandHeight);
+   mt::ParallelFor(0,bands,band,1);
+
+  // Stitch the bands together...
+   for (nat32 b=1;b<bands;b++)
+   {
+    Node * targ = NodeAt(0,b*bandHeight-1);
+    for (nat32 x=0;x<width;x++)
+    {
+     Node * other = (Node*)((byte*)targ + nodeSize*width);
+     if (Near(targ,other)) Union(targ,other);
+     (byte*&)targ += nodeSize;
+    }
+   }
+
+  // Flatten, so every node points straight at its head - as parents are
+  // allways earlier in raster order this can be done in one pass...
+   Node * targ = forest;
+   for (nat32 i=0;i<nodeCount;i++)
+   {
+    if ((targ->parent)&&(targ->parent->parent)) targ->parent = targ->parent->parent;
+    (byte*&)targ += nodeSize;
+   }
+
+  // Set the stop flags, which later stages use - a node is stopped if all its
+  // neighbours are in the same segment...
+   MergeStop stop(*this);
+   mt::ParallelFor(0,height,stop,16);
+}
+
+void Segmenter::Union(Node * a,Node * b)
+{
+ a = a->Root();
+ b = b->Root();
+ if (a==b) return;
+ if (b<a) {Node * t = a; a = b; b = t;}
+
+ b->parent = a;
+ a->weight += b->weight;
+}
+
+bit Segmenter::Near(Node * a,Node * b) const
+{
+ real32 dist = 0.0;
+ for (nat32 i=0;i<feat.Size();i++) dist += (a->fv[i]-b->fv[i])*(a->fv[i]-b->fv[i]);
+ return dist<(cutoff*cutoff);
 }
 
 void Segmenter::MergeWeighted()
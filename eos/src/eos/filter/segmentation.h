@@ -148,6 +148,17 @@ class EOS_CLASS Segmenter
      return parent;
     }
 
+    Node * Root() // As Head, but iterative with path halving, for the union-find in MergeBasic.
+    {
+     Node * ret = this;
+     while (ret->parent)
+     {
+      if (ret->parent->parent) ret->parent = ret->parent->parent;
+      ret = ret->parent;
+     }
+     return ret;
+    }
+
     Node *& Last() // For adding to the linked list.
     {
      if (next==null<Node*>()) return next;
@@ -177,9 +188,18 @@ class EOS_CLASS Segmenter
 
 
   // This method merges all segments in the data structure that are within the 
-  // cutoff distance of each other for pixels at the edges...
+  // cutoff distance of each other for pixels at the edges. Done as a union-find
+  // over the edges within the cutoff, bands of rows in parallel then the
+  // borders between them stitched...
    void MergeBasic();
 
+  // Helpers for the above...
+   class MergeBand;
+   class MergeStop;
+   void Union(Node * a,Node * b);
+   Node * NodeAt(nat32 x,nat32 y) const {return (Node*)(void*)((byte*)forest + (y*width+x)*nodeSize);}
+   bit Near(Node * a,Node * b) const;
+
   // Identical to MergeBasic, except it also does the weighting requirement,
   // an optional code path to replace MergeBasic when weighting is enabled.
    void MergeWeighted();
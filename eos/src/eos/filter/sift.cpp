@@ -28,6 +28,7 @@
 #include "eos/ds/lists.h"
 #include "eos/rend/functions.h"
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
 
 #include <stdio.h>
 
@@ -42,6 +43,27 @@ SiftKeypoint::SiftKeypoint()
 SiftKeypoint::~SiftKeypoint()
 {}
 
+// Does the per candidate work of refinement, pruning and orientation
+// assignment, with the candidates spread over the thread pool. Each gets its
+// own slots for output, which are collated in order afterwards...
+class SiftKeypoint::Batch
+{
+ public:
+  static const nat32 maxRots = rotBins/2; // Rotations must be strict local maxima.
+
+  Batch(const SiftKeypoint & s):sift(s) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 i=begin;i<end;i++) count[i] = sift.Orientate(cand[i],&rot[i*maxRots]);
+  }
+
+  const SiftKeypoint & sift;
+  ds::Array<DogPyramid::Pos> cand;
+  ds::Array<nat32> count;
+  ds::Array<real32> rot;
+};
+
 void SiftKeypoint::Run(const svt::Field<real32> & image,time::Progress * prog)
 {
  prog->Push();
@@ -80,165 +102,148 @@ void SiftKeypoint::Run(const svt::Field<real32> & image,time::Progress * prog)
    gauss.Apply(baseImage,baseImage);
 
 
- // Build the 3 pyramids...
-  DogPyramid dogPyramid;
-  DirPyramid dirPyramid;
-  
-  prog->Report(0,7);
-  pyramid.Construct(baseImage); prog->Report(1,7);
-  dogPyramid.Construct(pyramid); prog->Report(2,7);
-  dirPyramid.Construct(pyramid); prog->Report(3,7);
+ // Build the 3 pyramids, these are kept so a further call with the same size
+ // of image can reuse the memory...
+  prog->Report(0,6);
+  pyramid.Construct(baseImage); prog->Report(1,6);
+  dogPyramid.Construct(pyramid); prog->Report(2,6);
+  dirPyramid.Construct(pyramid); prog->Report(3,6);
 
 
  // Now find all possible keypoints...
   ds::List<DogPyramid::Pos> listA;
-  dogPyramid.GetExtrema(listA); prog->Report(4,7);
+  dogPyramid.GetExtrema(listA); prog->Report(4,6);
 
 
- // Refine all points then prune those that are unsuitable for the task at hand...
- {
-  ds::List<DogPyramid::Pos>::Cursor targ = listA.FrontPtr();
-  while (!targ.Bad())
-  {	  
-   // First refine it...
-    if (dogPyramid.RefineExtrema(*targ)==false)
-    {
-     targ.RemKillNext();
-     continue;
-    }
+ // Refine all points, prune those that are unsuitable for the task at hand
+ // and assign rotations to the survivors, all in parallel...
+  Batch batch(*this);
+  batch.cand.Size(listA.Size());
+  batch.count.Size(listA.Size());
+  batch.rot.Size(listA.Size()*Batch::maxRots);
+  {
+   ds::List<DogPyramid::Pos>::Cursor targ = listA.FrontPtr();
+   for (nat32 i=0;!targ.Bad();i++,++targ) batch.cand[i] = *targ;
+  }
+  listA.Reset();
 
-   // Check if the value is high enough...
-    if (math::Abs(targ->value)<minContrast)
-    {
-     targ.RemKillNext();
-     continue;	    
-    }
-   
-   // Do the curvature ratio check...
-    real32 curveRatio = dogPyramid.CurveRatio(*targ);
-    if ((curveRatio<0.0)||(curveRatio>(math::Sqr(maxCurveRatio+1)/maxCurveRatio)))
-    {
-     targ.RemKillNext();
-     continue;	    
-    }
+  mt::ParallelFor(0,batch.cand.Size(),batch,64);
+  prog->Report(5,6);
 
-   ++targ;	  
-  }
-  prog->Report(5,7);
- }
- 
- 
- // Assign rotation to each keypoint, splitting them as needed...
-  ds::List<Keypoint> listB;
+
+ // Transfer into the array where the final results will live, splitting
+ // candidates with several rotations into several keypoints...
+ {
+  nat32 total = 0;
+  for (nat32 i=0;i<batch.count.Size();i++) total += batch.count[i];
+  data.Size(total);
+
+  nat32 j = 0;
+  for (nat32 i=0;i<batch.cand.Size();i++)
   {
-   ds::List<DogPyramid::Pos>::Cursor targ = listA.FrontPtr();
-   while (!targ.Bad())
+   const DogPyramid::Pos & pos = batch.cand[i];
+   for (nat32 r=0;r<batch.count[i];r++)
    {
-    // Construct a weighted rotation histogram...
-     // Build the histogram structure...
-      real32 histo[rotBins];
-      for (nat32 i=0;i<rotBins;i++) histo[i] = 0.0;
+    Keypoint & kp = data[j++];
+     kp.octave = pos.oct;
+     kp.scale = pos.scale;
+     kp.x = pos.x;
+     kp.y = pos.y;
+     kp.xOff = pos.xOff;
+     kp.yOff = pos.yOff;
+     kp.sOff = pos.sOff;
+     kp.rot = batch.rot[i*Batch::maxRots + r];
+   }
+  }
+  prog->Report(6,6);
+ }
+
+ prog->Pop();	
+}
+
+nat32 SiftKeypoint::Orientate(DogPyramid::Pos & pos,real32 * rot) const
+{
+ // First refine it...
+  if (dogPyramid.RefineExtrema(pos)==false) return 0;
+
+ // Check if the value is high enough...
+  if (math::Abs(pos.value)<minContrast) return 0;
+   
+ // Do the curvature ratio check...
+  real32 curveRatio = dogPyramid.CurveRatio(pos);
+  if ((curveRatio<0.0)||(curveRatio>(math::Sqr(maxCurveRatio+1)/maxCurveRatio))) return 0;
+
+
+ // Construct a weighted rotation histogram...
+  // Build the histogram structure...
+   real32 histo[rotBins];
+   for (nat32 i=0;i<rotBins;i++) histo[i] = 0.0;
      
-     // Get the rotations and magnitudes we are going to be playing with...
-      svt::Field<real32> mag;
-      svt::Field<real32> dir;
+  // Get the rotations and magnitudes we are going to be playing with...
+   svt::Field<real32> mag;
+   svt::Field<real32> dir;
       
-      dirPyramid.GetMag(targ->oct,targ->scale,mag);
-      dirPyramid.GetDir(targ->oct,targ->scale,dir);
+   dirPyramid.GetMag(pos.oct,pos.scale,mag);
+   dirPyramid.GetDir(pos.oct,pos.scale,dir);
       
-     // Calculate the range of pixels to sample...
-      real32 sd = pyramid.Sd(targ->oct,targ->scale) * sdScale;
-      real32 range = sd * sdMult;
+  // Calculate the range of pixels to sample...
+   real32 sd = pyramid.Sd(pos.oct,pos.scale) * sdScale;
+   real32 range = sd * sdMult;
       
-      real32 centX = targ->x + targ->xOff;
-      real32 centY = targ->y + targ->yOff;
+   real32 centX = pos.x + pos.xOff;
+   real32 centY = pos.y + pos.yOff;
             
-      int32 minX = int32(math::RoundDown(centX - range));
-      int32 maxX = int32(math::RoundUp(centX + range));
-      int32 minY = int32(math::RoundDown(centY - range));
-      int32 maxY = int32(math::RoundUp(centY + range));
+   int32 minX = int32(math::RoundDown(centX - range));
+   int32 maxX = int32(math::RoundUp(centX + range));
+   int32 minY = int32(math::RoundDown(centY - range));
+   int32 maxY = int32(math::RoundUp(centY + range));
       
-     // Ignore points that are too close to the border to be analysed reasonably...
-      if ((minX<0)||(maxX>=int32(mag.Size(0)))||(minY<0)||(maxY>=int32(mag.Size(1))))
-      {
-       ++targ;
-       continue;	      
-      }
+  // Ignore points that are too close to the border to be analysed reasonably...
+   if ((minX<0)||(maxX>=int32(mag.Size(0)))||(minY<0)||(maxY>=int32(mag.Size(1)))) return 0;
       
-     // Iterate...
-      for (nat32 y=minY;int32(y)<=maxY;y++)
-      {
-       for (nat32 x=minX;int32(x)<=maxX;x++)
-       {
-	histo[nat32(math::Round((rotBins*(dir.Get(x,y)+math::pi))/(2.0*math::pi)))%rotBins] 
-	     += math::Gaussian(sd,math::Sqrt(math::Sqr(x-centX)+math::Sqr(y-centY))) * mag.Get(x,y);
-       }	      
-      }
+  // Iterate...
+   for (nat32 y=minY;int32(y)<=maxY;y++)
+   {
+    for (nat32 x=minX;int32(x)<=maxX;x++)
+    {
+     histo[nat32(math::Round((rotBins*(dir.Get(x,y)+math::pi))/(2.0*math::pi)))%rotBins] 
+          += math::Gaussian(sd,math::Sqrt(math::Sqr(x-centX)+math::Sqr(y-centY))) * mag.Get(x,y);
+    }	      
+   }
     
-    // Find the maximum...
-     real32 max = histo[0];
-     for (nat32 i=1;i<rotBins;i++) max = math::Max(max,histo[i]);
-     max *= peekMult;
-
-    // For all points within the given ratio of the maximum make an
-    // output keypoint, interpolate to get accurate positions...
-     for (nat32 i=0;i<rotBins;i++)
-     {
-      if (histo[i]>=max)
-      {
-       nat32 bi	= (i+rotBins-1)%rotBins;
-       nat32 ai = (i+1)%rotBins;
-       if ((histo[bi]<histo[i])&&(histo[ai]<histo[i]))
-       {
-	// Interpolate the orientation...
-	 math::Mat<3> mat;
-	 math::Vect<3> vect;
-	 mat[0][0] = 1.0; mat[0][1] = -1.0; mat[0][1] = 1.0; vect[0] = histo[bi];
-	 mat[1][0] = 1.0; mat[1][1] =  1.0; mat[1][1] = 1.0; vect[1] = histo[ai];
-	 mat[2][0] = 1.0; mat[2][1] =  0.0; mat[2][1] = 0.0; vect[2] = histo[i];	 
-	 
-	 SolveLinear(mat,vect);
-	 if (!math::Equal(vect[2],real32(0.0)))
-	 {
-	  real32 iRot = (((-vect[1]/(2.0*vect[2]))+i+0.5)*2.0*math::pi)/real32(rotBins) - math::pi;
-	 
-	  // Store it...
-	   Keypoint kp;
-	    kp.octave = targ->oct;
-	    kp.scale = targ->scale;
-	    kp.x = targ->x;
-	    kp.y = targ->y;
-	    kp.xOff = targ->xOff;
-	    kp.yOff = targ->yOff;
-	    kp.sOff = targ->sOff;
-	    kp.rot = iRot;	 
-	   listB.AddBack(kp);
-         }
-       }
-      }   
-     }
+ // Find the maximum...
+  real32 max = histo[0];
+  for (nat32 i=1;i<rotBins;i++) max = math::Max(max,histo[i]);
+  max *= peekMult;
 
-    ++targ;	   
-   }
-   prog->Report(6,7);
-  }  
-  
-  
- // Transfer from the linked list into the array where the final results will live...
- {
-  data.Size(listB.Size());
-  ds::List<Keypoint>::Cursor targ = listB.FrontPtr();
-  nat32 i = 0;
-  while (!targ.Bad())
+ // For all points within the given ratio of the maximum output a rotation,
+ // interpolate to get accurate positions...
+  nat32 ret = 0;
+  for (nat32 i=0;i<rotBins;i++)
   {
-   data[i] = *targ;
-   ++targ;
-   ++i;	  
+   if (histo[i]>=max)
+   {
+    nat32 bi = (i+rotBins-1)%rotBins;
+    nat32 ai = (i+1)%rotBins;
+    if ((histo[bi]<histo[i])&&(histo[ai]<histo[i]))
+    {
+     // Interpolate the orientation...
+      math::Mat<3> mat;
+      math::Vect<3> vect;
+      mat[0][0] = 1.0; mat[0][1] = -1.0; mat[0][2] = 1.0; vect[0] = histo[bi];
+      mat[1][0] = 1.0; mat[1][1] =  1.0; mat[1][2] = 1.0; vect[1] = histo[ai];
+      mat[2][0] = 1.0; mat[2][1] =  0.0; mat[2][2] = 0.0; vect[2] = histo[i];	 
+	 
+      SolveLinear(mat,vect);
+      if (!math::Equal(vect[2],real32(0.0)))
+      {
+       rot[ret++] = (((-vect[1]/(2.0*vect[2]))+i+0.5)*2.0*math::pi)/real32(rotBins) - math::pi;
+      }
+    }
+   }   
   }
-  prog->Report(7,7);
- }
 
- prog->Pop();	
+ return ret;
 }
 
 nat32 SiftKeypoint::Keypoints() const
@@ -274,127 +279,154 @@ SiftFeature::SiftFeature()
 SiftFeature::~SiftFeature()
 {}
 
+// Calculates the feature vectors, in batches of keypoints over the thread
+// pool...
+class SiftFeature::Batch
+{
+ public:
+  Batch(SiftFeature & f,const SiftKeypoint & k):feat(f),kps(k) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 i=begin;i<end;i++) feat.Describe(kps.GetDirPyramid(),kps[i],feat.data[i]);
+  }
+
+  SiftFeature & feat;
+  const SiftKeypoint & kps;
+};
+
 void SiftFeature::Run(const SiftKeypoint & kps,time::Progress * prog)
 {
  prog->Push();
- 
- // Yes, we make this twice. But the codes so slow anyway I really couldn't care...
-  DirPyramid dirPyramid; 
-  dirPyramid.Construct(kps.GetPyramid());
- 
- 
+ prog->Report(0,1);
+
  data.Size(kps.Keypoints());
- for (nat32 i=0;i<kps.Keypoints();i++)
+ Batch batch(*this,kps);
+ mt::ParallelFor(0,kps.Keypoints(),batch,16);
+
+ prog->Report(1,1);
+ prog->Pop();	
+}
+
+void SiftFeature::Quantise(ds::Array<byte> & out) const
+{
+ out.Size(data.Size()*fvSize);
+ for (nat32 i=0;i<data.Size();i++)
  {
-  prog->Report(i,kps.Keypoints());
+  for (nat32 j=0;j<fvSize;j++)
+  {
+   real32 v = data[i][j];
+   out[i*fvSize + j] = (v==v)?byte(math::Min(v*512.0,255.0)):0; // Multiplier as Lowe, catching nan.
+  }
+ }
+}
+
+void SiftFeature::Describe(const DirPyramid & dirPyramid,const SiftKeypoint::Keypoint & kp,math::Vect<fvSize> & out) const
+{
+ // Null the feature vector...
+  for (nat32 j=0;j<fvSize;j++) out[j] = 0.0;
+ 
+ // Iterate all sample points and distribute there component into the feature
+ // vector...
+  svt::Field<real32> strength; dirPyramid.GetMag(kp.octave,kp.scale,strength);
+  svt::Field<real32> direction; dirPyramid.GetDir(kp.octave,kp.scale,direction);
   
-  // Null the feature vector...
-   for (nat32 j=0;j<fvSize;j++) data[i][j] = 0.0;
+  real32 sAng = math::Sin(kp.rot);
+  real32 cAng = math::Cos(kp.rot);
   
-  // Iterate all sample points and distribute there component into the feature
-  // vector...
-   svt::Field<real32> strength; dirPyramid.GetMag(kps[i].octave,kps[i].scale,strength);
-   svt::Field<real32> direction; dirPyramid.GetDir(kps[i].octave,kps[i].scale,direction);
-   
-   real32 sAng = math::Sin(kps[i].rot);
-   real32 cAng = math::Cos(kps[i].rot);
-   
-   nat32 startX = nat32(math::RoundDown(kps[i].x+kps[i].xOff));
-   nat32 startY = nat32(math::RoundDown(kps[i].y+kps[i].yOff));
-   if ((startX<(dimRes/2))||(startY<(dimRes/2))) continue;
-   startX -= dimRes/2;
-   startY -= dimRes/2;
-   if ((startX+dimRes)>=strength.Size(0)) continue;
-   if ((startY+dimRes)>=strength.Size(1)) continue;
-   
-   //LogAlways("sift feature (" << kps[i].x+kps[i].xOff << "," << kps[i].y+kps[i].yOff << ") at [" << kps[i].octave << "," << kps[i].scale << "]");
-   //LogAlways("start = (" << startX << "," << startY << ")");
-   
-   for (nat32 y=0;y<dimRes;y++)
+  nat32 startX = nat32(math::RoundDown(kp.x+kp.xOff));
+  nat32 startY = nat32(math::RoundDown(kp.y+kp.yOff));
+  if ((startX<(dimRes/2))||(startY<(dimRes/2))) return;
+  startX -= dimRes/2;
+  startY -= dimRes/2;
+  if ((startX+dimRes)>=strength.Size(0)) return;
+  if ((startY+dimRes)>=strength.Size(1)) return;
+  
+  //LogAlways("sift feature (" << kp.x+kp.xOff << "," << kp.y+kp.yOff << ") at [" << kp.octave << "," << kp.scale << "]");
+  //LogAlways("start = (" << startX << "," << startY << ")");
+  
+  for (nat32 y=0;y<dimRes;y++)
+  {
+   for (nat32 x=0;x<dimRes;x++)
    {
-    for (nat32 x=0;x<dimRes;x++)
-    {
-     // Convert from world coordinates to local coordinates...
-      real32 relX = (startX+x) - (kps[i].x+kps[i].xOff);
-      real32 relY = (startY+y) - (kps[i].y+kps[i].yOff);
-      
-      real32 locX = cAng*relX - sAng*relY;
-      real32 locY = sAng*relX + cAng*relY;
-       
-     // Get the rotation and magnitude, weight the magnitude...
-      real32 rot = direction.Get(x+startX,y+startY);
-      real32 mag = strength.Get(x+startX,y+startY);
-      mag *= math::Gaussian(real32(dimRes*0.5),math::Sqrt(math::Sqr(locX)+math::Sqr(locY)));
-     
-      //LogAlways("rel = (" << relX << "," << relY << "); loc = (" << locX << "," << locY << ")");
-      //LogAlways("rot = " << rot << "; mag = " << mag);
+    // Convert from world coordinates to local coordinates...
+     real32 relX = (startX+x) - (kp.x+kp.xOff);
+     real32 relY = (startY+y) - (kp.y+kp.yOff);
      
-     // Move into the feature vector 'coordinate system'...
-      rot = math::Mod(rot - kps[i].rot + 4.0*math::pi*2.0,math::pi*2.0)*(real32(rotSamp)/(2.0*math::pi));
-      int32 lowRot = int32(math::RoundDown(rot));
-      nat32 highRot = (lowRot+1)%rotSamp;
-      rot -= lowRot;
-      
-      locX = locX*(real32(dimSamp+1)/real32(2*dimRes)) + dimSamp/2;
-      int32 lowX = int32(math::RoundDown(locX)); locX -= lowX;
+     real32 locX = cAng*relX - sAng*relY;
+     real32 locY = sAng*relX + cAng*relY;
       
-      locY = locY*(real32(dimSamp+1)/real32(2*dimRes)) + dimSamp/2;
-      int32 lowY = int32(math::RoundDown(locY)); locY -= lowY;
-           
-      if ((lowX<-1)||(lowX>=int32(dimSamp))) continue;
-      if ((lowY<-1)||(lowY>=int32(dimSamp))) continue;
-      
-      //LogAlways("lowX = " << lowX << "; lowY = " << lowY << "; lowRot = " << lowRot);
-      //LogAlways("locX = " << locX << "; locY = " << locY << "; rot = " << rot);
+    // Get the rotation and magnitude, weight the magnitude...
+     real32 rot = direction.Get(x+startX,y+startY);
+     real32 mag = strength.Get(x+startX,y+startY);
+     mag *= math::Gaussian(real32(dimRes*0.5),math::Sqrt(math::Sqr(locX)+math::Sqr(locY)));
+    
+     //LogAlways("rel = (" << relX << "," << relY << "); loc = (" << locX << "," << locY << ")");
+     //LogAlways("rot = " << rot << "; mag = " << mag);
+    
+    // Move into the feature vector 'coordinate system'...
+     rot = math::Mod(rot - kp.rot + 4.0*math::pi*2.0,math::pi*2.0)*(real32(rotSamp)/(2.0*math::pi));
+     int32 lowRot = int32(math::RoundDown(rot))%rotSamp; // Mod can return 2pi due to rounding.
+     nat32 highRot = (lowRot+1)%rotSamp;
+     rot -= lowRot;
+     
+     locX = locX*(real32(dimSamp+1)/real32(2*dimRes)) + dimSamp/2;
+     int32 lowX = int32(math::RoundDown(locX)); locX -= lowX;
+     
+     locY = locY*(real32(dimSamp+1)/real32(2*dimRes)) + dimSamp/2;
+     int32 lowY = int32(math::RoundDown(locY)); locY -= lowY;
+          
+     if ((lowX<-1)||(lowX>=int32(dimSamp))) continue;
+     if ((lowY<-1)||(lowY>=int32(dimSamp))) continue;
+     
+     //LogAlways("lowX = " << lowX << "; lowY = " << lowY << "; lowRot = " << lowRot);
+     //LogAlways("locX = " << locX << "; locY = " << locY << "; rot = " << rot);
 
-            
-     // Add it to the feature vector, will influence 8 positions
-     // due to its 3d nature... (2 normal dimensions and orientation.)     
-      if ((lowX>=0)&&(lowY>=0))
-      {
-       Entry(data[i],lowX,lowY,lowRot)  += mag * (1.0-rot) * (1.0-locX) * (1.0-locY);
-       Entry(data[i],lowX,lowY,highRot) += mag *       rot * (1.0-locX) * (1.0-locY);
-      }
-      
-      if ((lowX>=0)&&(lowY+1<int32(dimSamp)))
-      {
-       Entry(data[i],lowX,lowY+1,lowRot)  += mag * (1.0-rot) * (1.0-locX) * locY;
-       Entry(data[i],lowX,lowY+1,highRot) += mag *       rot * (1.0-locX) * locY;
-      }
+           
+    // Add it to the feature vector, will influence 8 positions
+    // due to its 3d nature... (2 normal dimensions and orientation.)     
+     if ((lowX>=0)&&(lowY>=0))
+     {
+      Entry(out,lowX,lowY,lowRot)  += mag * (1.0-rot) * (1.0-locX) * (1.0-locY);
+      Entry(out,lowX,lowY,highRot) += mag *       rot * (1.0-locX) * (1.0-locY);
+     }
+     
+     if ((lowX>=0)&&(lowY+1<int32(dimSamp)))
+     {
+      Entry(out,lowX,lowY+1,lowRot)  += mag * (1.0-rot) * (1.0-locX) * locY;
+      Entry(out,lowX,lowY+1,highRot) += mag *       rot * (1.0-locX) * locY;
+     }
 
-      if ((lowX+1<int32(dimSamp))&&(lowY>=0))
-      {
-       Entry(data[i],lowX+1,lowY,lowRot)  += mag * (1.0-rot) * locX * (1.0-locY);
-       Entry(data[i],lowX+1,lowY,highRot) += mag *       rot * locX * (1.0-locY);
-      }
-      
-      if ((lowX+1<int32(dimSamp))&&(lowY+1<int32(dimSamp)))
-      {
-       Entry(data[i],lowX+1,lowY+1,lowRot)  += mag * (1.0-rot) * locX * locY;
-       Entry(data[i],lowX+1,lowY+1,highRot) += mag *       rot * locX * locY;
-      }    
-    }	   
-   }
-  
-  // Normalise, threshold, normalise...
-   real32 len = 0.0;
-   for (nat32 j=0;j<fvSize;j++) len += math::Sqr(data[i][j]);
-   len = math::InvSqrt(len);
-   
-   for (nat32 j=0;j<fvSize;j++)
-   {
-    data[i][j] *= len;
-    if (data[i][j]>maxFeat) data[i][j] = maxFeat;
-   }
+     if ((lowX+1<int32(dimSamp))&&(lowY>=0))
+     {
+      Entry(out,lowX+1,lowY,lowRot)  += mag * (1.0-rot) * locX * (1.0-locY);
+      Entry(out,lowX+1,lowY,highRot) += mag *       rot * locX * (1.0-locY);
+     }
+     
+     if ((lowX+1<int32(dimSamp))&&(lowY+1<int32(dimSamp)))
+     {
+      Entry(out,lowX+1,lowY+1,lowRot)  += mag * (1.0-rot) * locX * locY;
+      Entry(out,lowX+1,lowY+1,highRot) += mag *       rot * locX * locY;
+     }    
+   }	   
+  }
+ 
+ // Normalise, threshold, normalise...
+  real32 len = 0.0;
+  for (nat32 j=0;j<fvSize;j++) len += math::Sqr(out[j]);
+  len = math::InvSqrt(len);
   
-   len = 0.0;
-   for (nat32 j=0;j<fvSize;j++) len += math::Sqr(data[i][j]);   
-   len = math::InvSqrt(len);
-   
-   for (nat32 j=0;j<fvSize;j++) data[i][j] *= len;	 
- }
+  for (nat32 j=0;j<fvSize;j++)
+  {
+   out[j] *= len;
+   if (out[j]>maxFeat) out[j] = maxFeat;
+  }
  
- prog->Pop();	
+  len = 0.0;
+  for (nat32 j=0;j<fvSize;j++) len += math::Sqr(out[j]);   
+  len = math::InvSqrt(len);
+  
+  for (nat32 j=0;j<fvSize;j++) out[j] *= len;	 
 }
 
 const math::Vect<128> & SiftFeature::operator[] (nat32 kp) const
@@ -27,6 +27,8 @@
 #include "eos/svt/field.h"
 #include "eos/svt/var.h"
 #include "eos/filter/pyramid.h"
+#include "eos/filter/dog_pyramid.h"
+#include "eos/filter/dir_pyramid.h"
 #include "eos/time/progress.h"
 #include "eos/ds/arrays.h"
 #include "eos/bs/colours.h"
@@ -61,7 +63,10 @@ class EOS_CLASS SiftKeypoint
    
  
   /// Each time this is called with an image it rebuilds the keypoint array
-  /// for the new data.
+  /// for the new data. The pyramids are kept between calls, so for a
+  /// sequence of images of the same size the memory is reused. Extrema
+  /// detection, refinement and orientation assignment are spread over the
+  /// threads of mt::DefaultPool(), with the output order unchanged.
    void Run(const svt::Field<real32> & image,time::Progress * prog = null<time::Progress*>());
  
    
@@ -91,6 +96,10 @@ class EOS_CLASS SiftKeypoint
 
   /// Provides access to the pyramid created in calculating the keypoints.
    const Pyramid & GetPyramid() const {return pyramid;}
+
+  /// Provides access to the magnitude and direction pyramid created in
+  /// calculating the keypoints, so SiftFeature doesn't have to make its own.
+   const DirPyramid & GetDirPyramid() const {return dirPyramid;}
    
    
   /// Renders out to an image the size of the base image handed in arrows
@@ -105,6 +114,8 @@ class EOS_CLASS SiftKeypoint
  
  private:
   Pyramid pyramid;
+  DogPyramid dogPyramid;
+  DirPyramid dirPyramid;
   ds::Array<Keypoint> data;
   
   // Some internal constants...
@@ -115,6 +126,11 @@ class EOS_CLASS SiftKeypoint
    static const real32 sdScale = 1.5; // Multiplier of the scale to get the sd for the rotation weighting gaussian.
    static const real32 sdMult = 2.0; // What factor of the gaussian sd to go out to for deciding the window to search.
    static const real32 peekMult = 0.8; // Expresses how close any maxima has to be to the maximum rotation response to be selected.
+
+  // Refines and prunes a candidate, returning how many rotations it has,
+  // which are written to rot, which must have room for rotBins/2...
+   nat32 Orientate(DogPyramid::Pos & pos,real32 * rot) const;
+   class Batch;
 };
 
 //-----------------------------------------------------------------------------
@@ -147,7 +163,8 @@ class EOS_CLASS SiftFeature
 
 
   /// Each time this is called with a SiftKeypoint it rebuilds the features to match
-  /// with its array of keypoints.
+  /// with its array of keypoints. The keypoints are done in parallel over
+  /// mt::DefaultPool().
    void Run(const SiftKeypoint & kps,time::Progress * prog = null<time::Progress*>());
    
   
@@ -156,6 +173,19 @@ class EOS_CLASS SiftFeature
   /// object it was Run(...) with.
    const math::Vect<fvSize> & operator[] (nat32 kp) const;
 
+  /// Returns how many feature vectors there are. They are contiguous, so
+  /// (*this)[0].Ptr() with a stride of fvSize can be given to ds::VectorKdTree::Build.
+   nat32 Size() const {return data.Size();}
+
+  /// Returns the feature vectors as a Size() by fvSize row major matrix, null
+  /// if there are none.
+   const real32 * Matrix() const {return (data.Size()==0)?null<const real32*>():data[0].Ptr();}
+
+  /// Outputs the feature vectors quantised to bytes, as a Size() by fvSize
+  /// row major matrix, for when memory matters more than precision. Values
+  /// are multiplied by 512 and clamped, as Lowe does.
+   void Quantise(ds::Array<byte> & out) const;
+
    
   /// Returns how many rotation samples there are.
    nat32 Rots() const {return rotSamp;}
@@ -176,6 +206,10 @@ class EOS_CLASS SiftFeature
 
  private:
   ds::Array< math::Vect<fvSize> > data;	
+
+  // Calculates one feature vector...
+   void Describe(const DirPyramid & dirPyramid,const SiftKeypoint::Keypoint & kp,math::Vect<fvSize> & out) const;
+   class Batch;
 };
 
 //------------------------------------------------------------------------------
@@ -21,6 +21,8 @@
 #include "eos/ds/arrays.h"
 #include "eos/ds/arrays2d.h"
 #include "eos/math/mat_ops.h"
+#include "eos/filter/permutohedral.h"
+#include "eos/mt/tasks.h"
 
 
 namespace eos
@@ -331,6 +333,330 @@ EOS_FUNC void SimpleQuantSmooth(svt::Field<bs::ColourRGB> & inOut,real32 cap,
  prog->Pop();
 }
 
+//------------------------------------------------------------------------------
+// Builds the lattice for a bilateral filter guided by the given image...
+static void BuildBilateral(Permutohedral & lattice,const svt::Field<bs::ColourLuv> & guide,
+                           real32 spatialSd,real32 domainSd)
+{
+ nat32 width = guide.Size(0);
+ nat32 height = guide.Size(1);
+
+ real32 * pos = new real32[width*height*5];
+ real32 * targ = pos;
+ for (nat32 y=0;y<height;y++)
+ {
+  for (nat32 x=0;x<width;x++)
+  {
+   const bs::ColourLuv & c = guide.Get(x,y);
+   targ[0] = real32(x)/spatialSd;
+   targ[1] = real32(y)/spatialSd;
+   targ[2] = c.l/domainSd;
+   targ[3] = c.u/domainSd;
+   targ[4] = c.v/domainSd;
+   targ += 5;
+  }
+ }
+
+ lattice.Build(width*height,5,pos);
+ delete[] pos;
+}
+
+EOS_FUNC void BilateralLuv(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuv> & out,
+                           real32 spatialSd,real32 domainSd,time::Progress * prog)
+{
+ prog->Push();
+ nat32 width = in.Size(0);
+ nat32 height = in.Size(1);
+
+ prog->Report(0,2);
+ Permutohedral lattice;
+ BuildBilateral(lattice,in,spatialSd,domainSd);
+
+ prog->Report(1,2);
+ real64 * val = new real64[width*height*4];
+ real64 * v = val;
+ for (nat32 y=0;y<height;y++)
+ {
+  for (nat32 x=0;x<width;x++)
+  {
+   const bs::ColourLuv & c = in.Get(x,y);
+   v[0] = c.l; v[1] = c.u; v[2] = c.v; v[3] = 1.0;
+   v += 4;
+  }
+ }
+
+ lattice.Filter(4,val,val);
+
+ v = val;
+ for (nat32 y=0;y<height;y++)
+ {
+  for (nat32 x=0;x<width;x++)
+  {
+   bs::ColourLuv & c = out.Get(x,y);
+   c.l = v[0]/v[3];
+   c.u = v[1]/v[3];
+   c.v = v[2]/v[3];
+   v += 4;
+  }
+ }
+ delete[] val;
+
+ prog->Pop();
+}
+
+EOS_FUNC void BilateralGuided(const svt::Field<real32> & in,svt::Field<real32> & out,
+                              const svt::Field<bs::ColourLuv> & guide,
+                              real32 spatialSd,real32 domainSd,time::Progress * prog)
+{
+ prog->Push();
+ nat32 width = in.Size(0);
+ nat32 height = in.Size(1);
+
+ prog->Report(0,2);
+ Permutohedral lattice;
+ BuildBilateral(lattice,guide,spatialSd,domainSd);
+
+ prog->Report(1,2);
+ real64 * val = new real64[width*height*2];
+ real64 * v = val;
+ for (nat32 y=0;y<height;y++)
+ {
+  for (nat32 x=0;x<width;x++)
+  {
+   v[0] = in.Get(x,y);
+   v[1] = 1.0;
+   v += 2;
+  }
+ }
+
+ lattice.Filter(2,val,val);
+
+ v = val;
+ for (nat32 y=0;y<height;y++)
+ {
+  for (nat32 x=0;x<width;x++)
+  {
+   out.Get(x,y) = v[0]/v[1];
+   v += 2;
+  }
+ }
+ delete[] val;
+
+ prog->Pop();
+}
+
+//------------------------------------------------------------------------------
+// Does a band of rows for MedianQuant; each band starts its column histograms
+// from scratch, then slides them down the band...
+class MedianRows
+{
+ public:
+  static const nat16 invalid = 0xFFFF;
+
+  MedianRows(const nat16 * q,nat32 w,nat32 h,nat32 r,nat32 l,real32 mv,real32 s,
+             const svt::Field<real32> & i,svt::Field<real32> & o)
+  :quant(q),width(w),height(h),radius(r),levels(l),minVal(mv),step(s),in(i),out(o)
+  {
+   bins = ((levels+15)/16)*16;
+   coarse = bins/16;
+  }
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   // Column histograms, fine and coarse, and how many each has...
+    ds::Array<nat16> colFine(width*bins);
+    ds::Array<nat16> colCoarse(width*coarse);
+    ds::Array<nat32> colCount(width);
+    for (nat32 i=0;i<colFine.Size();i++) colFine[i] = 0;
+    for (nat32 i=0;i<colCoarse.Size();i++) colCoarse[i] = 0;
+    for (nat32 i=0;i<width;i++) colCount[i] = 0;
+
+   // Window histograms, the fine one being brought up to date a segment at a
+   // time, when needed, with stamp recording which column each is valid for...
+    ds::Array<nat32> winFine(bins);
+    ds::Array<nat32> winCoarse(coarse);
+    ds::Array<int32> stamp(coarse);
+
+   // Fill the column histograms for the first row...
+    nat32 top = (begin>radius)?(begin-radius):0;
+    nat32 bottom = math::Min(begin+radius,height-1);
+    for (nat32 y=top;y<=bottom;y++) AddRow(y,colFine,colCoarse,colCount);
+
+   for (nat32 y=begin;y<end;y++)
+   {
+    // Slide the columns down...
+     if (y!=begin)
+     {
+      if (y>radius) SubRow(y-radius-1,colFine,colCoarse,colCount);
+      if (y+radius<height) AddRow(y+radius,colFine,colCoarse,colCount);
+     }
+
+    // Start the window at the left...
+     for (nat32 c=0;c<coarse;c++) {winCoarse[c] = 0; stamp[c] = -1;}
+     nat32 count = 0;
+     for (nat32 x=0;x<=math::Min(radius,width-1);x++)
+     {
+      AddCoarse(x,colCoarse,winCoarse);
+      count += colCount[x];
+     }
+
+    // Slide it along...
+     for (nat32 x=0;x<width;x++)
+     {
+      if (x!=0)
+      {
+       if (x+radius<width)
+       {
+        AddCoarse(x+radius,colCoarse,winCoarse);
+        count += colCount[x+radius];
+       }
+       if (x>radius)
+       {
+        SubCoarse(x-radius-1,colCoarse,winCoarse);
+        count -= colCount[x-radius-1];
+       }
+      }
+
+      if (count==0)
+      {
+       out.Get(x,y) = in.Get(x,y);
+       continue;
+      }
+
+      // Find the coarse bin with the median in...
+       nat32 target = (count-1)/2;
+       nat32 acc = 0;
+       nat32 c = 0;
+       while (acc+winCoarse[c]<=target) {acc += winCoarse[c]; ++c;}
+
+      // Bring its fine segment up to date, incrementally if its recent enough,
+      // otherwise from scratch...
+       nat32 * fine = &winFine[c*16];
+       if ((stamp[c]<0)||(2*(int32(x)-stamp[c])>int32(2*radius+1)))
+       {
+        for (nat32 b=0;b<16;b++) fine[b] = 0;
+        nat32 first = (x>radius)?(x-radius):0;
+        nat32 last = math::Min(x+radius,width-1);
+        for (nat32 col=first;col<=last;col++)
+        {
+         const nat16 * cf = &colFine[col*bins + c*16];
+         for (nat32 b=0;b<16;b++) fine[b] += cf[b];
+        }
+       }
+       else
+       {
+        for (nat32 t=nat32(stamp[c]+1);t<=x;t++)
+        {
+         if (t+radius<width)
+         {
+          const nat16 * cf = &colFine[(t+radius)*bins + c*16];
+          for (nat32 b=0;b<16;b++) fine[b] += cf[b];
+         }
+         if (t>radius)
+         {
+          const nat16 * cf = &colFine[(t-radius-1)*bins + c*16];
+          for (nat32 b=0;b<16;b++) fine[b] -= cf[b];
+         }
+        }
+       }
+       stamp[c] = x;
+
+      // Find the median within it...
+       nat32 b = 0;
+       while (acc+fine[b]<=target) {acc += fine[b]; ++b;}
+       out.Get(x,y) = minVal + step*real32(c*16+b);
+     }
+   }
+  }
+
+
+ private:
+  const nat16 * quant;
+  nat32 width;
+  nat32 height;
+  nat32 radius;
+  nat32 levels;
+  nat32 bins;
+  nat32 coarse;
+  real32 minVal;
+  real32 step;
+  const svt::Field<real32> & in;
+  svt::Field<real32> & out;
+
+  void AddRow(nat32 y,ds::Array<nat16> & colFine,ds::Array<nat16> & colCoarse,ds::Array<nat32> & colCount) const
+  {
+   const nat16 * q = quant + y*width;
+   for (nat32 x=0;x<width;x++)
+   {
+    if (q[x]==invalid) continue;
+    colFine[x*bins + q[x]] += 1;
+    colCoarse[x*coarse + (q[x]>>4)] += 1;
+    colCount[x] += 1;
+   }
+  }
+
+  void SubRow(nat32 y,ds::Array<nat16> & colFine,ds::Array<nat16> & colCoarse,ds::Array<nat32> & colCount) const
+  {
+   const nat16 * q = quant + y*width;
+   for (nat32 x=0;x<width;x++)
+   {
+    if (q[x]==invalid) continue;
+    colFine[x*bins + q[x]] -= 1;
+    colCoarse[x*coarse + (q[x]>>4)] -= 1;
+    colCount[x] -= 1;
+   }
+  }
+
+  void AddCoarse(nat32 col,const ds::Array<nat16> & colCoarse,ds::Array<nat32> & winCoarse) const
+  {
+   const nat16 * cc = &colCoarse[col*coarse];
+   for (nat32 c=0;c<coarse;c++) winCoarse[c] += cc[c];
+  }
+
+  void SubCoarse(nat32 col,const ds::Array<nat16> & colCoarse,ds::Array<nat32> & winCoarse) const
+  {
+   const nat16 * cc = &colCoarse[col*coarse];
+   for (nat32 c=0;c<coarse;c++) winCoarse[c] -= cc[c];
+  }
+};
+
+EOS_FUNC void MedianQuant(const svt::Field<real32> & in,svt::Field<real32> & out,
+                          nat32 radius,real32 minVal,real32 maxVal,nat32 levels,
+                          const svt::Field<bit> * valid,time::Progress * prog)
+{
+ prog->Push();
+ nat32 width = in.Size(0);
+ nat32 height = in.Size(1);
+ levels = math::Clamp<nat32>(levels,2,65535);
+ real32 step = (maxVal-minVal)/real32(levels-1);
+
+ // Quantise, marking the pixels to be ignored...
+  prog->Report(0,2);
+  ds::Array<nat16> quant(width*height);
+  nat16 * q = quant.Ptr();
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    real32 v = in.Get(x,y);
+    if ((valid&&!valid->Get(x,y))||(!math::IsFinite(v))) *q = MedianRows::invalid;
+    else
+    {
+     real32 l = (step>0.0)?((v-minVal)/step):0.0;
+     *q = nat16(math::Clamp<int32>(int32(math::Round(l)),0,int32(levels-1)));
+    }
+    ++q;
+   }
+  }
+
+ // Filter...
+  prog->Report(1,2);
+  MedianRows rows(quant.Ptr(),width,height,radius,levels,minVal,step,in,out);
+  mt::ParallelFor(0,height,rows,math::Max<nat32>(32,4*radius));
+
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -66,6 +66,65 @@ EOS_FUNC void QuantSmooth(const svt::Field<real32> & in,svt::Field<real32> & out
 EOS_FUNC void SimpleQuantSmooth(svt::Field<bs::ColourRGB> & inOut,
                                 real32 cap = 0.1,time::Progress * prog = null<time::Progress*>(),
                                 nat32 levels = 256,nat32 iters = 64);
+
+//------------------------------------------------------------------------------
+/// A bilateral filter of a Luv image, i.e. edge preserving smoothing, where
+/// each pixel becomes the weighted average of all others, weighted by a
+/// Gaussian of spatial distance multiplied by a Gaussian of Luv distance.
+/// Done with a permutohedral lattice, so the time taken is linear in the
+/// pixel count regardless of the standard deviations, and large spatial
+/// standard deviations are as cheap as small ones. The result is an
+/// approximation, but a close one.
+/// \param in Input image.
+/// \param out Output image, can be the same as the input.
+/// \param spatialSd Standard deviation of the spatial Gaussian, in pixels.
+/// \param domainSd Standard deviation of the colour Gaussian, in Luv units.
+/// \param prog Progress bar.
+EOS_FUNC void BilateralLuv(const svt::Field<bs::ColourLuv> & in,svt::Field<bs::ColourLuv> & out,
+                           real32 spatialSd,real32 domainSd,
+                           time::Progress * prog = null<time::Progress*>());
+
+/// A joint bilateral filter, as for BilateralLuv except the field being smoothed
+/// is a seperate real field, with the edges given by the guide image - for
+/// smoothing depth or needle maps without crossing object boundaries.
+/// \param in Input field.
+/// \param out Output field, can be the same as the input.
+/// \param guide Image that provides the colour distances, same size as in.
+/// \param spatialSd Standard deviation of the spatial Gaussian, in pixels.
+/// \param domainSd Standard deviation of the colour Gaussian, in Luv units.
+/// \param prog Progress bar.
+EOS_FUNC void BilateralGuided(const svt::Field<real32> & in,svt::Field<real32> & out,
+                              const svt::Field<bs::ColourLuv> & guide,
+                              real32 spatialSd,real32 domainSd,
+                              time::Progress * prog = null<time::Progress*>());
+
+//------------------------------------------------------------------------------
+/// A median filter for fields with a limited number of distinct values, such as
+/// disparity maps, that takes constant time per pixel regardless of the window
+/// size. Values are quantised into levels evenly spaced from minVal to maxVal,
+/// clamped, and each pixel is set to the lower median of the quantised values
+/// in the square window around it, clipped at the edges of the field. Done as
+/// in 'Median Filtering in Constant Time' by Perreault & Hebert, with a
+/// histogram per column that slides down and a window histogram that slides
+/// along, both split in two tiers so each step costs a handful of small
+/// updates. Rows are done in bands, in parallel. Memory use is about
+/// 2*width*levels bytes per band, so keep levels in the hundreds.
+/// \param in Input field.
+/// \param out Output field, can be the same as the input.
+/// \param radius Window is 2*radius+1 pixels wide and high.
+/// \param minVal The value of the lowest level.
+/// \param maxVal The value of the highest level.
+/// \param levels How many levels to quantise by, at least 2 and at most 65535.
+/// \param valid If provided only pixels that are true in it are included in
+///              the windows, so invalid pixels are filled in by there
+///              neighbours. Pixels with no valid pixels in there window are
+///              left unchanged.
+/// \param prog Progress bar.
+EOS_FUNC void MedianQuant(const svt::Field<real32> & in,svt::Field<real32> & out,
+                          nat32 radius,real32 minVal,real32 maxVal,nat32 levels = 256,
+                          const svt::Field<bit> * valid = null<const svt::Field<bit>*>(),
+                          time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
  };
 };
@@ -20,11 +20,72 @@
 #include "eos/ds/arrays.h"
 #include "eos/math/stats.h"
 #include "eos/math/mat_ops.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace filter
  {
+//------------------------------------------------------------------------------
+// Converts rows of an rgb image to the polar/cylindrical suv coordinates, for
+// use with mt::ParallelFor...
+class ToPolar
+{
+ public:
+  ToPolar(const math::Mat<3> & ts,const svt::Field<bs::ColourRGB> & i,
+          svt::Field<real32> & r,svt::Field<real32> & t,svt::Field<real32> & p)
+  :toSuv(ts),in(i),rho(r),theta(t),phi(p)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<in.Size(0);x++)
+    {
+     // rgb to suv...
+      math::Vect<3> rgb;
+      rgb[0] = in.Get(x,y).r; rgb[1] = in.Get(x,y).g; rgb[2] = in.Get(x,y).b;
+     
+      math::Vect<3> suv;
+      math::MultVect(toSuv,rgb,suv);
+    
+     // suv to polar/cylindrical form...
+      rho.Get(x,y) = math::Sqrt(math::Sqr(suv[1]) + math::Sqr(suv[2]));
+      theta.Get(x,y) = math::InvTan2(suv[2],suv[1]);
+      phi.Get(x,y) = math::InvTan2(suv[0],rho.Get(x,y));
+    }
+   }
+  }
+
+ private:
+  const math::Mat<3> & toSuv;
+  const svt::Field<bs::ColourRGB> & in;
+  svt::Field<real32> & rho;
+  svt::Field<real32> & theta;
+  svt::Field<real32> & phi;
+};
+
+// Generates the matrices to convert to/from suv space...
+static void SuvMatrices(const bs::ColourRGB & light,math::Mat<3> & toSuv,math::Mat<3> & fromSuv)
+{
+ math::Vect<3> xAxis;
+ xAxis[0] = 1.0; xAxis[1] = 0.0; xAxis[2] = 0.0;
+   
+ math::Vect<3> lightAxis;
+ lightAxis[0] = light.r; lightAxis[1] = light.g; lightAxis[2] = light.b;
+ lightAxis.Normalise();
+   
+ math::Vect<3> rotAxis;
+ math::CrossProduct(lightAxis,xAxis,rotAxis);
+ rotAxis.Normalise();
+   
+ math::AngAxisToRotMat(rotAxis,xAxis*lightAxis,toSuv);
+   
+ fromSuv = toSuv;
+ math::Transpose(fromSuv);
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC void SimpleSpecMask(const svt::Field<bs::ColourRGB> & image,
                              const svt::Field<nat32> & segs,                             
@@ -58,45 +119,12 @@ EOS_FUNC void SimpleSpecMask(const svt::Field<bs::ColourRGB> & image,
  // Generate matrices to convert to/from suv space...
   math::Mat<3> toSuv;
   math::Mat<3> fromSuv;
-  {
-   math::Vect<3> xAxis;
-   xAxis[0] = 1.0; xAxis[1] = 0.0; xAxis[2] = 0.0;
-   
-   math::Vect<3> lightAxis;
-   lightAxis[0] = light.r; lightAxis[1] = light.g; lightAxis[2] = light.b;
-   lightAxis.Normalise();
-   
-   math::Vect<3> rotAxis;
-   math::CrossProduct(lightAxis,xAxis,rotAxis);
-   rotAxis.Normalise();
-   
-   math::AngAxisToRotMat(rotAxis,xAxis*lightAxis,toSuv);
-   
-   fromSuv = toSuv;
-   math::Transpose(fromSuv);
-  }
+  SuvMatrices(light,toSuv,fromSuv);
 
 
  // Convert from rgb to polar/cylindrical suv coordinates...
-  for (nat32 y=0;y<image.Size(1);y++)
-  {
-   for (nat32 x=0;x<image.Size(0);x++)
-   {
-    // rgb to suv...
-     math::Vect<3> rgb;
-     rgb[0] = image.Get(x,y).r;
-     rgb[1] = image.Get(x,y).g;
-     rgb[2] = image.Get(x,y).b;
-     
-     math::Vect<3> suv;
-     math::MultVect(toSuv,rgb,suv);
-    
-    // suv to polar/cylindrical form...
-     rho.Get(x,y) = math::Sqrt(math::Sqr(suv[1]) + math::Sqr(suv[2]));
-     theta.Get(x,y) = math::InvTan2(suv[2],suv[1]);
-     phi.Get(x,y) = math::InvTan2(suv[0],rho.Get(x,y));
-   }
-  }
+  ToPolar toPolar(toSuv,image,rho,theta,phi);
+  mt::ParallelFor(0,image.Size(1),toPolar,16);
 
 
  // Find the average phi value for each segment...
@@ -138,6 +166,94 @@ EOS_FUNC void SimpleSpecMask(const svt::Field<bs::ColourRGB> & image,
   }
 }
 
+//------------------------------------------------------------------------------
+// The passes of the minimum propagation in SpecRemoval::Run, for use with
+// mt::ParallelFor - one over ranges of rows, the other over ranges of
+// columns...
+class MinRows
+{
+ public:
+  MinRows(svt::Field<real32> & p):phi(p) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=1;x<phi.Size(0);x++) phi.Get(x,y) = math::Min(phi.Get(x,y),phi.Get(x-1,y));
+   }
+  }
+
+ private:
+  svt::Field<real32> & phi;
+};
+
+class MinColumns
+{
+ public:
+  MinColumns(svt::Field<real32> & p):phi(p) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 y=1;y<phi.Size(1);y++)
+   {
+    for (nat32 x=begin;x<end;x++) phi.Get(x,y) = math::Min(phi.Get(x,y),phi.Get(x,y-1));
+   }
+  }
+
+ private:
+  svt::Field<real32> & phi;
+};
+
+//------------------------------------------------------------------------------
+// Converts rows back from polar/cylindrical suv coordinates to rgb for
+// SpecRemoval::Run, and fills in the mask if requested...
+class SpecRemoval::FromPolar
+{
+ public:
+  FromPolar(SpecRemoval & s,const math::Mat<3> & fs,const svt::Field<real32> & r,
+            const svt::Field<real32> & t,const svt::Field<real32> & p)
+  :self(s),fromSuv(fs),rho(r),theta(t),phi(p)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<self.out.Size(0);x++)
+    {
+     // polar/cylindrical form to suv...
+      math::Vect<3> suv;
+      suv[0] = rho.Get(x,y) * math::Tan(phi.Get(x,y));
+      suv[1] = rho.Get(x,y) * math::Cos(theta.Get(x,y));
+      suv[2] = rho.Get(x,y) * math::Sin(theta.Get(x,y));
+
+
+     // suv to rgb, and save out...
+      math::Vect<3> rgb;
+      math::MultVect(fromSuv,suv,rgb);
+     
+      self.out.Get(x,y).r = rgb[0];
+      self.out.Get(x,y).g = rgb[1];
+      self.out.Get(x,y).b = rgb[2];
+    }
+
+    // The mask, just anywhere where rho is zero, indicating no variation from
+    // the light source colour...
+     if (self.mask.Valid())
+     {
+      for (nat32 x=0;x<self.mask.Size(0);x++) self.mask.Get(x,y) = math::IsZero(rho.Get(x,y));
+     }
+   }
+  }
+
+ private:
+  SpecRemoval & self;
+  const math::Mat<3> & fromSuv;
+  const svt::Field<real32> & rho;
+  const svt::Field<real32> & theta;
+  const svt::Field<real32> & phi;
+};
+
 //------------------------------------------------------------------------------
 SpecRemoval::SpecRemoval()
 :light(1.0,1.0,1.0)
@@ -183,43 +299,12 @@ void SpecRemoval::Run(time::Progress * prog)
  // Generate matrices to convert to/from suv space...
   math::Mat<3> toSuv;
   math::Mat<3> fromSuv;
-  {
-   math::Vect<3> xAxis;
-   xAxis[0] = 1.0; xAxis[1] = 0.0; xAxis[2] = 0.0;
-   
-   math::Vect<3> lightAxis;
-   lightAxis[0] = light.r; lightAxis[1] = light.g; lightAxis[2] = light.b;
-   lightAxis.Normalise();
-   
-   math::Vect<3> rotAxis;
-   math::CrossProduct(lightAxis,xAxis,rotAxis);
-   rotAxis.Normalise();
-   
-   math::AngAxisToRotMat(rotAxis,xAxis*lightAxis,toSuv);
-   
-   fromSuv = toSuv;
-   math::Transpose(fromSuv);
-  }
+  SuvMatrices(light,toSuv,fromSuv);
 
 
  // Convert from rgb to the papers polar/cylindrical suv coordinates...
-  for (nat32 y=0;y<in.Size(1);y++)
-  {
-   for (nat32 x=0;x<in.Size(0);x++)
-   {
-    // rgb to suv...
-     math::Vect<3> rgb;
-     rgb[0] = in.Get(x,y).r; rgb[1] = in.Get(x,y).g; rgb[2] = in.Get(x,y).b;
-     
-     math::Vect<3> suv;
-     math::MultVect(toSuv,rgb,suv);
-    
-    // suv to polar/cylindrical form...
-     rho.Get(x,y) = math::Sqrt(math::Sqr(suv[1]) + math::Sqr(suv[2]));
-     theta.Get(x,y) = math::InvTan2(suv[2],suv[1]);
-     phi.Get(x,y) = math::InvTan2(suv[0],rho.Get(x,y));
-   }
-  }
+  ToPolar toPolar(toSuv,in,rho,theta,phi);
+  mt::ParallelFor(0,in.Size(1),toPolar,16);
 
 
  // Specularity is only evident under our assumptions as an addative affect in
@@ -230,54 +315,25 @@ void SpecRemoval::Run(time::Progress * prog)
  // The likelyhood of pixels being identical is related to theta directly, with
  // sudden changes of rho, and even phi, being indicative of edges through which
  // info should not pass.
- 
- for (nat32 y=0;y<phi.Size(1);y++)
- {
-  for (nat32 x=0;x<phi.Size(0);x++)
-  {
-   if (x!=0) phi.Get(x,y) = math::Min(phi.Get(x,y),phi.Get(x-1,y));
-   if (y!=0) phi.Get(x,y) = math::Min(phi.Get(x,y),phi.Get(x,y-1));
-  }
- }
+
+ // Each phi ends up as the minimum of itself and the phi to its left and
+ // above, after they have been updated, so its the minimum over the rectangle
+ // from the origin to the pixel. Done as a pass along the rows followed by a
+ // pass down the columns, which gives exactly the same minimums but lets both
+ // passes be split over threads...
+  MinRows minRows(phi);
+  mt::ParallelFor(0,phi.Size(1),minRows,16);
+
+  MinColumns minColumns(phi);
+  mt::ParallelFor(0,phi.Size(0),minColumns,64);
  
  // *******************************************************
  
 
- // Convert from the polar/cylindrical suv representation back to rgb...
-  for (nat32 y=0;y<out.Size(1);y++)
-  {
-   for (nat32 x=0;x<out.Size(0);x++)
-   {
-    // polar/cylindrical form to suv...
-     math::Vect<3> suv;
-     suv[0] = rho.Get(x,y) * math::Tan(phi.Get(x,y));
-     suv[1] = rho.Get(x,y) * math::Cos(theta.Get(x,y));
-     suv[2] = rho.Get(x,y) * math::Sin(theta.Get(x,y));
-
-
-    // suv to rgb, and save out...
-     math::Vect<3> rgb;
-     math::MultVect(fromSuv,suv,rgb);
-     
-     out.Get(x,y).r = rgb[0];
-     out.Get(x,y).g = rgb[1];
-     out.Get(x,y).b = rgb[2];
-   }
-  }
-
-
- // Fill in the mask if requested, just anywhere where rho is zero, indicating
- // no variation from the light source colour...
-  if (mask.Valid())
-  {
-   for (nat32 y=0;y<mask.Size(1);y++)
-   {
-    for (nat32 x=0;x<mask.Size(0);x++)
-    {
-     mask.Get(x,y) = math::IsZero(rho.Get(x,y));
-    }
-   }
-  }
+ // Convert from the polar/cylindrical suv representation back to rgb, filling
+ // in the mask if requested...
+  FromPolar fromPolar(*this,fromSuv,rho,theta,phi);
+  mt::ParallelFor(0,out.Size(1),fromPolar,16);
  
  
  prog->Pop();	
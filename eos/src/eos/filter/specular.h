@@ -93,6 +93,8 @@ class EOS_CLASS SpecRemoval
   svt::Field<bs::ColourRGB> out;
   bs::ColourRGB light;
   svt::Field<bit> mask;
+
+  class FromPolar;
 };
 
 //------------------------------------------------------------------------------
@@ -22,11 +22,42 @@
 #include "eos/filter/edge_confidence.h"
 #include "eos/filter/segmentation.h"
 #include "eos/alg/mean_shift.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace filter
  {
+//-----------------------------------------------------------------------------
+// Calculates rows of the weight map from the two edge parameters...
+class WeightRows
+{
+ public:
+  WeightRows(const svt::Field<real32> & e,const svt::Field<real32> & r,svt::Field<real32> & w,real32 em)
+  :eta(e),rho(r),weight(w),edgeMix(em)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<weight.Size(0);x++)
+    {
+     real32 r = rho.Get(x,y);
+     real32 e = eta.Get(x,y);
+     if (r <= 0.02) weight.Get(x,y) = 1.0;
+               else weight.Get(x,y) = 1.0 - (edgeMix*r + (1.0-edgeMix)*e);
+    }
+   }
+  }
+
+ private:
+  const svt::Field<real32> & eta;
+  const svt::Field<real32> & rho;
+  svt::Field<real32> & weight;
+  real32 edgeMix;
+};
+
 //-----------------------------------------------------------------------------
 void Synergism::Run(time::Progress * prog)
 {
@@ -63,16 +94,8 @@ void Synergism::Run(time::Progress * prog)
 
 
  // Using the edge parameters calculate the weight map...
-  for (nat32 y=0;y<weight.Size(1);y++)
-  {
-   for (nat32 x=0;x<weight.Size(0);x++)
-   {
-    real32 r = rho.Get(x,y);
-    real32 e = eta.Get(x,y);
-    if (r <= 0.02) weight.Get(x,y) = 1.0;
-              else weight.Get(x,y) = 1.0 - (edgeMix*r + (1.0-edgeMix)*e);
-   }
-  }
+  WeightRows weightRows(eta,rho,weight,edgeMix);
+  mt::ParallelFor(0,weight.Size(1),weightRows,16);
 
 
  // Do the mean shift to generate the smoothed image, the most time consuming part of the proccess...
@@ -99,9 +122,10 @@ void Synergism::Run(time::Progress * prog)
    meanShift.AddFeature(lImg,1.0/rangeSize);
    meanShift.AddFeature(uImg,1.0/rangeSize);
    meanShift.AddFeature(vImg,1.0/rangeSize);
-   meanShift.SetDistance(&Distance,0.0);
+   meanShift.SetJointDistance(2);
    meanShift.SetCutoff(0.01,100); // *0.01
    meanShift.Passover(true);
+   meanShift.Accelerate(accel);
 
   meanShift.Run(prog);
 
@@ -162,17 +186,6 @@ void Synergism::GetRho(svt::Field<real32> & o) const
  if (out->ByName("rho",temp)) o.CopyFrom(temp);
 }
 
-bit Synergism::Distance(nat32,real32 * fv1,real32 * fv2,real32)
-{
- real32 dis = math::Sqr(fv1[0]-fv2[0]) + math::Sqr(fv1[1]-fv2[1]);
- if (dis>1.0) return false;
- 
- real32 col = math::Sqr(fv1[2]-fv2[2]) + math::Sqr(fv1[3]-fv2[3]) + math::Sqr(fv1[4]-fv2[4]);
- if (col>1.0) return false;
-
- return true;
-}
-
 //-----------------------------------------------------------------------------
  };
 };
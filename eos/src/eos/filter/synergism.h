@@ -45,7 +45,7 @@ class EOS_CLASS Synergism
  public:
   /// &nbsp;
    Synergism()
-   :diffRad(2),edgeMix(0.3),spatialSize(7.0),rangeSize(4.5),mergeCutoff(4.5*0.5),minSegment(20),averageSteps(2),mergeMax(0.9),
+   :diffRad(2),edgeMix(0.3),spatialSize(7.0),rangeSize(4.5),mergeCutoff(4.5*0.5),minSegment(20),averageSteps(2),mergeMax(0.9),accel(true),
    out(null<svt::Var*>())
    {}
 
@@ -96,6 +96,13 @@ class EOS_CLASS Synergism
   /// that range.
    void SetMergeMax(real32 m) {mergeMax = m;}
 
+  /// Sets if the mean shift runs in its accelerated mode, see
+  /// alg::MeanShift::Accelerate, which defaults to on. This converges blocks
+  /// of pixels in parallel, with the passover optimisation confined to each
+  /// block; switch it off to converge them all in a single thread with
+  /// passover over the entire image, the original behaviour.
+   void Accelerate(bit enabled) {accel = enabled;}
+
 
   /// Changes the class from setup mode to result extraction mode, doing the 
   /// calculations neccesary.
@@ -140,14 +147,11 @@ class EOS_CLASS Synergism
    nat32 minSegment; // Smallest segment size in pixels.
    nat32 averageSteps; // Number of averaging steps in fusion step.
    real32 mergeMax; // Maximum average of weight map on a border for merging to be allowed.
+   bit accel; // True to use the accelerated mean shift.
 
   // Output...
    nat32 segments; // Number of segments found.
    svt::Var * out; // Also includes a load of intermediate values.
-   
-  // Distance function, to modify the mean shift behaviour to distinguish between
-  // colour and position...
-   static bit Distance(nat32 fvSize,real32 * fv1,real32 * fv2,real32 pt);
 };
 
 //------------------------------------------------------------------------------
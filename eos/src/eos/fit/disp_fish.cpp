@@ -20,6 +20,7 @@
 #include "eos/math/functions.h"
 #include "eos/ds/arrays.h"
 #include "eos/svt/var.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -71,41 +72,24 @@ void DispFish::SetClamp(real32 minC,real32 maxC)
  maxCon = maxC;
 }
 
-void DispFish::Run(time::Progress * prog)
+//------------------------------------------------------------------------------
+class DispFish::Fill
 {
- prog->Push();
- 
- // First create depth/cost pairs for all pixels covering the range - for each
- // pixel offset the lowest value to 0 to get stability...
-  prog->Report(0,2);
-  // Make data structure...
-   svt::Var temp(disp);
-   nat32 scope = range*2 + 1;
-   {
-    temp.Setup3D(scope,disp.Size(0),disp.Size(1)); // Note order.
-    Pixel initPix;
-     initPix.pos = bs::Vert(0.0,0.0,0.0);
-     initPix.weight = 0.0;
-    temp.Add("pix",initPix);
-    temp.Commit();
-   }
-   svt::Field<Pixel> pix(&temp,"pix");
-  
-  // Fill data structure...
-   prog->Push();
-   //real32 diffWeight = 1.0/real32(range+1);
-   for (nat32 y=0;y<disp.Size(1);y++)
+ public:
+  Fill(DispFish & s,svt::Field<Pixel> & p,nat32 sc)
+  :self(s),pix(p),scope(sc)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
    {
-    prog->Report(y,disp.Size(1));
-    prog->Push();
-    for (nat32 x=0;x<disp.Size(0);x++)
+    for (nat32 x=0;x<self.disp.Size(0);x++)
     {
-     prog->Report(x,disp.Size(0));
-     
      // Prep for below...
-      if (mask.Valid()&&(mask.Get(x,y)==false)) continue;
-      real32 bd = disp.Get(x,y);
-      int32 base = int32(math::Round(bd)) - int32(range);
+      if (self.mask.Valid()&&(self.mask.Get(x,y)==false)) continue;
+      real32 bd = self.disp.Get(x,y);
+      int32 base = int32(math::Round(bd)) - int32(self.range);
       real32 minCost = math::Infinity<real32>();
      
      // Get costs and positions for each entry...
@@ -114,8 +98,8 @@ void DispFish::Run(time::Progress * prog)
        Pixel & p = pix.Get(s,x,y);
        int32 d = base + int32(s);
       
-       pair.Triangulate(x,y,d,p.pos);      
-       p.weight = dsc->Cost(x,math::Clamp<int32>(int32(x)+d,0,dsc->WidthRight()-1),y) * dscMult;
+       self.pair.Triangulate(x,y,d,p.pos);      
+       p.weight = self.dsc->Cost(x,math::Clamp<int32>(int32(x)+d,0,self.dsc->WidthRight()-1),y) * self.dscMult;
        minCost = math::Min(minCost,p.weight);
       }
 
@@ -125,188 +109,234 @@ void DispFish::Run(time::Progress * prog)
       {
        Pixel & p = pix.Get(s,x,y);
        p.weight = math::Exp(-(p.weight-minCost));
-       //p.weight *= 1.0 - diffWeight*math::Abs(real32(base + int32(s)) - disp.Get(x,y));
+       //p.weight *= 1.0 - diffWeight*math::Abs(real32(base + int32(s)) - self.disp.Get(x,y));
       }
     }
-    prog->Pop();
    }
-   prog->Pop();
+  }
 
 
- // Create the buffer to store R-contribution/weight pairs...
-  prog->Report(1,2);
-  ds::Array<Rcont> rb(scope*scope*scope); // This is big.
-  
-  out.Resize(disp.Size(0),disp.Size(1));
- 
- // Iterate the pixels and calculate the distribution for each - this consists 
- // of an easy direction and hard concentration...
-  prog->Push();
-  for (nat32 y=0;y<disp.Size(1);y++)
+ private:
+  DispFish & self;
+  svt::Field<Pixel> & pix;
+  nat32 scope;
+};
+
+class DispFish::Fit
+{
+ public:
+  Fit(DispFish & s,const svt::Field<Pixel> & p,nat32 sc)
+  :self(s),pix(p),scope(sc)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
   {
-   prog->Report(y,disp.Size(1));
-   prog->Push();
-   for (nat32 x=0;x<disp.Size(0);x++)
+   // Create the buffer to store R-contribution/weight pairs...
+    ds::Array<Rcont> rb(scope*scope*scope); // This is big.
+   
+   for (nat32 y=y0;y<y1;y++)
    {
-    prog->Report(x,disp.Size(0));
-    // Break if masked...
-     if (mask.Valid()&&(mask.Get(x,y)==false))
-     {
-      out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
-      continue;
-     }
-    
-    // Get differential calculation stuff - basically border/mask handling...
-     int32 dxI = 1;
-     real32 dxM = 1.0;
-     if (((x+1)==disp.Size(0))||(mask.Valid()&&(mask.Get(x+1,y)==false)))
-     {
-      dxI = -1;
-      dxM = -1.0;
-      if ((x==0)||(mask.Valid()&&(mask.Get(x-1,y)==false)))
+    for (nat32 x=0;x<self.disp.Size(0);x++)
+    {
+     // Break if masked...
+      if (self.mask.Valid()&&(self.mask.Get(x,y)==false))
       {
-       out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
+       self.out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
        continue;
       }
-     }
-
-     int32 dyI = 1;
-     real32 dyM = 1.0;
-     if (((y+1)==disp.Size(1))||(mask.Valid()&&(mask.Get(x,y+1)==false)))
-     {
-      dyI = -1;
-      dyM = -1.0;
-      if ((y==0)||(mask.Valid()&&(mask.Get(x,y-1)==false)))
+
+     // Get differential calculation stuff - basically border/mask handling...
+      int32 dxI = 1;
+      real32 dxM = 1.0;
+      if (((x+1)==self.disp.Size(0))||(self.mask.Valid()&&(self.mask.Get(x+1,y)==false)))
       {
-       out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
-       continue;
-      }
-     }
-     
-    // Calculate the direction from most likelly disparity...
-     bs::Normal dir;
-     {
-      // Get locations of disparities...
-       bs::Vert b,ix,iy;
-       pair.Triangulate(x,y,disp.Get(x,y),b);
-       pair.Triangulate(int32(x)+dxI,y,disp.Get(int32(x)+dxI,y),ix);
-       pair.Triangulate(x,int32(y)+dyI,disp.Get(x,int32(y)+dyI),iy);
-      
-      // Get differences...
-       bs::Vert dx = ix; dx -= b; dx *= dxM;
-       bs::Vert dy = iy; dy -= b; dy *= dyM;
-       
-      // Cross product and normalise...
-       math::CrossProduct(dx,dy,dir);
-       dir.Normalise();
-     }
-
-    
-    // Calculate concentration - this involves a very, very expensive median calculation...
-     real32 k;
-     {
-      // Fill array with samples...
-       nat32 rbInd = 0;
-       for (nat32 sb=0;sb<scope;sb++)
+       dxI = -1;
+       dxM = -1.0;
+       if ((x==0)||(self.mask.Valid()&&(self.mask.Get(x-1,y)==false)))
        {
-        for (nat32 sx=0;sx<scope;sx++)
-        {
-         for (nat32 sy=0;sy<scope;sy++)
-         {
-          // Get pointers to the 3 relevant entrys...
-           Pixel & base = pix.Get(sb,x,y);
-           Pixel & xx = pix.Get(sx,int32(x)+dxI,y);
-           Pixel & yy = pix.Get(sy,x,int32(y)+dyI);
-          
-          // Calculate the surface orientation...
-           bs::Vert dx = xx.pos; dx -= base.pos; dx *= dxM;
-           bs::Vert dy = yy.pos; dy -= base.pos; dy *= dyM;
-           
-           bs::Normal sDir;
-           math::CrossProduct(dx,dy,sDir);
-           sDir.Normalise();
-          
-          // Dot product with dir to get the r component...
-           real32 r = sDir * dir;
-
-          // Calculate the weight...
-           real32 weight = base.weight * xx.weight * yy.weight;
-           
-          // Compensate for outliers - this is required in the case of passing
-          // through the epipole which can happen if your really unlucky (Like me)...
-           if (!math::IsFinite(r))
-           {
-            r = 0.0;
-            weight = 0.0;
-           }
-           
-          // Bias term...
-           weight *= math::Pow<real32>(1.0 - 0.5*(1.0-r),bias);
-           
-          // Store in the rb array...
-           rb[rbInd].r = r;
-           rb[rbInd].weight = weight;
-           ++rbInd;
-         }
-        }
+        self.out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
+        continue;
        }
-       log::Assert(rb.Size()==rbInd);
-      
-      // Sort array...
-       rb.SortNorm();
-      
-      // Calculate the median r value of the array...
-       real32 medR;
+      }
+
+      int32 dyI = 1;
+      real32 dyM = 1.0;
+      if (((y+1)==self.disp.Size(1))||(self.mask.Valid()&&(self.mask.Get(x,y+1)==false)))
+      {
+       dyI = -1;
+       dyM = -1.0;
+       if ((y==0)||(self.mask.Valid()&&(self.mask.Get(x,y-1)==false)))
        {
-        nat32 lowInd = 0;
-        nat32 highInd = rb.Size()-1;
-        
-        real32 lowWeight = rb[lowInd].weight;
-        real32 highWeight = rb[highInd].weight;
-        
-        // Move the two indices closer to one another until they collide...
-         while(lowInd<highInd)
+        self.out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
+        continue;
+       }
+      }
+
+     // Calculate the direction from most likelly disparity...
+      bs::Normal dir;
+      {
+       // Get locations of disparities...
+        bs::Vert b,ix,iy;
+        self.pair.Triangulate(x,y,self.disp.Get(x,y),b);
+        self.pair.Triangulate(int32(x)+dxI,y,self.disp.Get(int32(x)+dxI,y),ix);
+        self.pair.Triangulate(x,int32(y)+dyI,self.disp.Get(x,int32(y)+dyI),iy);
+
+       // Get differences...
+        bs::Vert dx = ix; dx -= b; dx *= dxM;
+        bs::Vert dy = iy; dy -= b; dy *= dyM;
+
+       // Cross product and normalise...
+        math::CrossProduct(dx,dy,dir);
+        dir.Normalise();
+      }
+
+
+     // Calculate concentration - this involves a very, very expensive median calculation...
+      real32 k;
+      {
+       // Fill array with samples...
+        nat32 rbInd = 0;
+        for (nat32 sb=0;sb<scope;sb++)
+        {
+         for (nat32 sx=0;sx<scope;sx++)
          {
-          real32 lowMod = lowWeight + rb[lowInd+1].weight;
-          real32 highMod = highWeight + rb[highInd-1].weight;
-          if (lowMod<highMod)
+          for (nat32 sy=0;sy<scope;sy++)
           {
-           lowInd += 1;
-           lowWeight = lowMod;
+           // Get pointers to the 3 relevant entrys...
+            const Pixel & base = pix.Get(sb,x,y);
+            const Pixel & xx = pix.Get(sx,int32(x)+dxI,y);
+            const Pixel & yy = pix.Get(sy,x,int32(y)+dyI);
+
+           // Calculate the surface orientation...
+            bs::Vert dx = xx.pos; dx -= base.pos; dx *= dxM;
+            bs::Vert dy = yy.pos; dy -= base.pos; dy *= dyM;
+
+            bs::Normal sDir;
+            math::CrossProduct(dx,dy,sDir);
+            sDir.Normalise();
+
+           // Dot product with dir to get the r component...
+            real32 r = sDir * dir;
+
+           // Calculate the weight...
+            real32 weight = base.weight * xx.weight * yy.weight;
+
+           // Compensate for outliers - this is required in the case of passing
+           // through the epipole which can happen if your really unlucky (Like me)...
+            if (!math::IsFinite(r))
+            {
+             r = 0.0;
+             weight = 0.0;
+            }
+
+           // Bias term...
+            weight *= math::Pow<real32>(1.0 - 0.5*(1.0-r),self.bias);
+
+           // Store in the rb array...
+            rb[rbInd].r = r;
+            rb[rbInd].weight = weight;
+            ++rbInd;
           }
-          else
+         }
+        }
+        log::Assert(rb.Size()==rbInd);
+
+       // Sort array...
+        rb.SortNorm();
+
+       // Calculate the median r value of the array...
+        real32 medR;
+        {
+         nat32 lowInd = 0;
+         nat32 highInd = rb.Size()-1;
+
+         real32 lowWeight = rb[lowInd].weight;
+         real32 highWeight = rb[highInd].weight;
+
+         // Move the two indices closer to one another until they collide...
+          while(lowInd<highInd)
           {
-           highInd -= 1;
-           highWeight = highMod;
+           real32 lowMod = lowWeight + rb[lowInd+1].weight;
+           real32 highMod = highWeight + rb[highInd-1].weight;
+           if (lowMod<highMod)
+           {
+            lowInd += 1;
+            lowWeight = lowMod;
+           }
+           else
+           {
+            highInd -= 1;
+            highWeight = highMod;
+           }
           }
-         }
-         log::Assert(lowInd==highInd);
-         
-        // Get the median...
-         medR = rb[lowInd].r;
-       }
-      
-      // Convert the median value into a concentration via the big lookup table...
-       medR *= 1000.0;
-       int32 index = int32(math::RoundDown(medR));
-       real32 t = medR - real32(index);
-       
-       k = medDotToK[math::Clamp<int32>(index,0,999)]*(1.0-t) +
-           medDotToK[math::Clamp<int32>(index+1,0,999)]*t;
-      
-      // Clamp...
-       k = math::Clamp<real32>(k,minCon,maxCon);
-     }
-    
-    // Store it in the output array...
-     out.Get(x,y) = dir;
-     out.Get(x,y) *= k;
+          log::Assert(lowInd==highInd);
+
+         // Get the median...
+          medR = rb[lowInd].r;
+        }
+
+       // Convert the median value into a concentration via the big lookup table...
+        medR *= 1000.0;
+        int32 index = int32(math::RoundDown(medR));
+        real32 t = medR - real32(index);
+
+        k = medDotToK[math::Clamp<int32>(index,0,999)]*(1.0-t) +
+            medDotToK[math::Clamp<int32>(index+1,0,999)]*t;
+
+       // Clamp...
+        k = math::Clamp<real32>(k,self.minCon,self.maxCon);
+      }
+
+     // Store it in the output array...
+      self.out.Get(x,y) = dir;
+      self.out.Get(x,y) *= k;
+    }
    }
-   prog->Pop();
   }
-  prog->Pop();
- 
+
+
+ private:
+  DispFish & self;
+  const svt::Field<Pixel> & pix;
+  nat32 scope;
+};
+
+//------------------------------------------------------------------------------
+void DispFish::Run(time::Progress * prog)
+{
+ prog->Push();
  
+ // First create depth/cost pairs for all pixels covering the range - for each
+ // pixel offset the lowest value to 0 to get stability...
+  prog->Report(0,2);
+  // Make data structure...
+   svt::Var temp(disp);
+   nat32 scope = range*2 + 1;
+   {
+    temp.Setup3D(scope,disp.Size(0),disp.Size(1)); // Note order.
+    Pixel initPix;
+     initPix.pos = bs::Vert(0.0,0.0,0.0);
+     initPix.weight = 0.0;
+    temp.Add("pix",initPix);
+    temp.Commit();
+   }
+   svt::Field<Pixel> pix(&temp,"pix");
+  
+  // Fill data structure, with the task pool...
+   Fill fill(*this,pix,scope);
+   mt::ParallelFor(nat32(0),disp.Size(1),fill,4);
+
+
+ // Iterate the pixels and calculate the distribution for each - this consists 
+ // of an easy direction and hard concentration. Also with the task pool, each
+ // range of rows getting its own sample buffer...
+  prog->Report(1,2);
+  out.Resize(disp.Size(0),disp.Size(1));
+  
+  Fit fit(*this,pix,scope);
+  mt::ParallelFor(nat32(0),disp.Size(1),fit,1);
+
+
  prog->Pop();
 }
 
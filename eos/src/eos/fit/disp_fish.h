@@ -77,7 +77,7 @@ class EOS_CLASS DispFish
    void SetClamp(real32 minCon,real32 maxCon);
 
 
-  /// Runs the algorithm.
+  /// Runs the algorithm, using the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
    
    
@@ -129,6 +129,12 @@ class EOS_CLASS DispFish
      
      bit operator < (const Rcont & rhs) const {return this->r<rhs.r;}
     };
+    
+   // The two passes of Run, functors for the task pool that do a range of
+   // rows - the second reads the neighbouring rows of the first, so they are
+   // run one after the other...
+    class Fill;
+    class Fit;
 };
 
 //------------------------------------------------------------------------------
@@ -20,6 +20,7 @@
 #include "eos/file/csv.h"
 #include "eos/file/stereo_helpers.h"
 #include "eos/math/gaussian_mix.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -70,75 +71,90 @@ void DispNorm::SetMaxIters(nat32 mi)
  maxIters = mi;
 }
 
-void DispNorm::Run(time::Progress * prog)
+//------------------------------------------------------------------------------
+class DispNorm::Rows
 {
- prog->Push();
+ public:
+  Rows(DispNorm & s)
+  :self(s)
+  {}
 
- out.Resize(disp.Size(0),disp.Size(1));
- 
- ds::Array<real32> buf(range*2+1);
- 
- for (int32 y=0;y<int32(out.Height());y++)
- {
-  prog->Report(y,out.Height());
-  prog->Push();
-  for (int32 x=0;x<int32(out.Width());x++)
+  void operator () (nat32 y0,nat32 y1)
   {
-   prog->Report(x,out.Width());
-   
-   if (mask.Valid()&&(mask.Get(x,y)==false))
-   {
-    out.Get(x,y) = 0.0;
-   }
-   else
+   ds::Array<real32> buf(self.range*2+1);
+
+   for (int32 y=int32(y0);y<int32(y1);y++)
    {
-    real32 var = math::Sqr(maxSd); // Variance obtained so far.
-    real32 mean = disp.Get(x,y);
-
-    int32 minDisp = math::Clamp<int32>(int32(math::Round(mean))-int32(range),
-                                       -x,int32(dsc->WidthRight())-x);
-    int32 maxDisp = math::Clamp<int32>(int32(math::Round(mean))+int32(range),
-                                       -x,int32(dsc->WidthRight())-x);
-    
-    // Cache the disparity weights to save repeated calculation...
-     for (int32 d=minDisp;d<=maxDisp;d++)
+    for (int32 x=0;x<int32(self.out.Width());x++)
+    {
+     if (self.mask.Valid()&&(self.mask.Get(x,y)==false))
      {
-      buf[d-minDisp] = math::Exp(-dsc->Cost(x,x+d,y) * dscMult);
+      self.out.Get(x,y) = 0.0;
      }
-     
-    // Do iterative re-weighting till convergance...
-     for (nat32 iter=0;iter<maxIters;iter++)
+     else
      {
-      real32 newVar = 0.0;
-      real32 newVarW = 0.0;
-     
-      real32 iSigma = 1.0/math::Clamp(math::Sqrt(var),minK,maxK);
-      for (int32 d=minDisp;d<=maxDisp;d++)
-      {
-       real32 delta = math::Abs(real32(d) - mean);
-       if ((delta*iSigma<sdCount)&&(!math::IsZero(delta)))
+      real32 var = math::Sqr(self.maxSd); // Variance obtained so far.
+      real32 mean = self.disp.Get(x,y);
+
+      int32 minDisp = math::Clamp<int32>(int32(math::Round(mean))-int32(self.range),
+                                         -x,int32(self.dsc->WidthRight())-x);
+      int32 maxDisp = math::Clamp<int32>(int32(math::Round(mean))+int32(self.range),
+                                         -x,int32(self.dsc->WidthRight())-x);
+
+      // Cache the disparity weights to save repeated calculation...
+       for (int32 d=minDisp;d<=maxDisp;d++)
+       {
+        buf[d-minDisp] = math::Exp(-self.dsc->Cost(x,x+d,y) * self.dscMult);
+       }
+
+      // Do iterative re-weighting till convergance...
+       for (nat32 iter=0;iter<self.maxIters;iter++)
        {
-        real32 weight = (1.0 - math::Cube(1.0 - math::Sqr(delta*iSigma/sdCount)))/math::Sqr(delta*iSigma);
-        weight *= buf[d-minDisp];
-       
-        newVar += weight * math::Sqr(delta);
-        newVarW += 0.5*buf[d-minDisp];//weight;
+        real32 newVar = 0.0;
+        real32 newVarW = 0.0;
+
+        real32 iSigma = 1.0/math::Clamp(math::Sqrt(var),self.minK,self.maxK);
+        for (int32 d=minDisp;d<=maxDisp;d++)
+        {
+         real32 delta = math::Abs(real32(d) - mean);
+         if ((delta*iSigma<self.sdCount)&&(!math::IsZero(delta)))
+         {
+          real32 weight = (1.0 - math::Cube(1.0 - math::Sqr(delta*iSigma/self.sdCount)))/math::Sqr(delta*iSigma);
+          weight *= buf[d-minDisp];
+
+          newVar += weight * math::Sqr(delta);
+          newVarW += 0.5*buf[d-minDisp];//weight;
+         }
+        }
+
+        if (!math::IsZero(newVarW)) newVar /= newVarW;
+        newVar = math::Clamp(newVar,math::Sqr(self.minSd),math::Sqr(self.maxSd));
+        bit done = math::Abs(newVar-var) < (var*1e-3);
+        var = newVar;
+        if (done) break;
        }
-      }
-     
-      if (!math::IsZero(newVarW)) newVar /= newVarW;
-      newVar = math::Clamp(newVar,math::Sqr(minSd),math::Sqr(maxSd));
-      bit done = math::Abs(newVar-var) < (var*1e-3);
-      var = newVar;
-      if (done) break;
+
+      // Store...
+       self.out.Get(x,y) = math::Sqrt(var);
      }
-   
-    // Store...
-     out.Get(x,y) = math::Sqrt(var);
+    }
    }
   }
-  prog->Pop();
- }
+
+
+ private:
+  DispNorm & self;
+};
+
+//------------------------------------------------------------------------------
+void DispNorm::Run(time::Progress * prog)
+{
+ prog->Push();
+
+ out.Resize(disp.Size(0),disp.Size(1));
+ 
+ Rows rows(*this);
+ mt::ParallelFor(nat32(0),out.Height(),rows,4);
 
  prog->Pop();
 }
@@ -185,69 +201,84 @@ void LaplaceDispNorm::SetParam(real32 s,real32 mi,real32 ma,real32 sM)
  sdMult = sM;
 }
 
-void LaplaceDispNorm::Run(time::Progress * prog)
+//------------------------------------------------------------------------------
+class LaplaceDispNorm::Rows
 {
- prog->Push();
+ public:
+  Rows(LaplaceDispNorm & s)
+  :self(s)
+  {}
 
- out.Resize(disp.Size(0),disp.Size(1));
- 
- for (int32 y=0;y<int32(out.Height());y++)
- {
-  prog->Report(y,out.Height());
-  prog->Push();
-  for (int32 x=0;x<int32(out.Width());x++)
+  void operator () (nat32 y0,nat32 y1)
   {
-   prog->Report(x,out.Width());
-   
-   if (mask.Valid()&&(mask.Get(x,y)==false))
-   {
-    out.Get(x,y) = 0.0;
-   }
-   else
+   for (int32 y=int32(y0);y<int32(y1);y++)
    {
-    // Initialise the 3 dsc derived costs around and at the selected
-    // disparity. A divisor is needed for each...
-     real32 costNeg = 0.0, costNegDiv = 0.0;
-     real32 cost    = 0.0, costDiv = 0.0;
-     real32 costPos = 0.0, costPosDiv = 0.0;
-     
-    // Calculate the range of disparity values to consider...
-     real32 mean = disp.Get(x,y);
-     int32 minDisp = math::Clamp<int32>(int32(math::RoundDown(mean-1.0-sd*sdMult)),
-                                        -x,int32(dsc->WidthRight())-x);
-     int32 maxDisp = math::Clamp<int32>(int32(math::RoundUp(mean+1.0+sd*sdMult)),
-                                        -x,int32(dsc->WidthRight())-x);
-    
-    // Calculate the costs - Gaussian blur of the disparities for the
-    // given range...
-     for (int32 d=minDisp;d<=maxDisp;d++)
+    for (int32 x=0;x<int32(self.out.Width());x++)
+    {
+     if (self.mask.Valid()&&(self.mask.Get(x,y)==false))
      {
-      real32 c = dsc->Cost(x,x+d,y) * dscMult;
-      
-      real32 weightNeg = math::UnNormGaussian<real32>(sd,mean-1.0-real32(d));
-      real32 weight    = math::UnNormGaussian<real32>(sd,mean-real32(d));
-      real32 weightPos = math::UnNormGaussian<real32>(sd,mean+1.0-real32(d));
-      
-      costNeg += weightNeg*c; costNegDiv += weightNeg;
-      cost    += weight*c;    costDiv    += weight;
-      costPos += weightPos*c; costPosDiv += weightPos;
+      self.out.Get(x,y) = 0.0;
      }
+     else
+     {
+      // Initialise the 3 dsc derived costs around and at the selected
+      // disparity. A divisor is needed for each...
+       real32 costNeg = 0.0, costNegDiv = 0.0;
+       real32 cost    = 0.0, costDiv = 0.0;
+       real32 costPos = 0.0, costPosDiv = 0.0;
+
+      // Calculate the range of disparity values to consider...
+       real32 mean = self.disp.Get(x,y);
+       int32 minDisp = math::Clamp<int32>(int32(math::RoundDown(mean-1.0-self.sd*self.sdMult)),
+                                          -x,int32(self.dsc->WidthRight())-x);
+       int32 maxDisp = math::Clamp<int32>(int32(math::RoundUp(mean+1.0+self.sd*self.sdMult)),
+                                          -x,int32(self.dsc->WidthRight())-x);
+
+      // Calculate the costs - Gaussian blur of the disparities for the
+      // given range...
+       for (int32 d=minDisp;d<=maxDisp;d++)
+       {
+        real32 c = self.dsc->Cost(x,x+d,y) * self.dscMult;
+
+        real32 weightNeg = math::UnNormGaussian<real32>(self.sd,mean-1.0-real32(d));
+        real32 weight    = math::UnNormGaussian<real32>(self.sd,mean-real32(d));
+        real32 weightPos = math::UnNormGaussian<real32>(self.sd,mean+1.0-real32(d));
+
+        costNeg += weightNeg*c; costNegDiv += weightNeg;
+        cost    += weight*c;    costDiv    += weight;
+        costPos += weightPos*c; costPosDiv += weightPos;
+       }
+
+      // Normalise the final cost, and use central differences to
+      // calculate the second differentials...
+       costNeg /= costNegDiv;
+       cost    /= costDiv;
+       costPos /= costPosDiv;
 
-    // Normalise the final cost, and use central differences to
-    // calculate the second differentials...
-     costNeg /= costNegDiv;
-     cost    /= costDiv;
-     costPos /= costPosDiv;
-     
-     real32 dd = costNeg + costPos - 2.0 * cost;
-
-    // Convert the second differential to a standard deviation, clamp it and store...
-     out.Get(x,y) = math::Sqrt(1.0/math::Clamp<real32>(dd,1.0/math::Sqr(maxSd),1.0/math::Sqr(minSd)));
-     if (!math::IsFinite(out.Get(x,y))) out.Get(x,y) = maxSd;
+       real32 dd = costNeg + costPos - 2.0 * cost;
+
+      // Convert the second differential to a standard deviation, clamp it and store...
+       self.out.Get(x,y) = math::Sqrt(1.0/math::Clamp<real32>(dd,1.0/math::Sqr(self.maxSd),1.0/math::Sqr(self.minSd)));
+       if (!math::IsFinite(self.out.Get(x,y))) self.out.Get(x,y) = self.maxSd;
+     }
+    }
    }
   }
-  prog->Pop();
- }
+
+
+ private:
+  LaplaceDispNorm & self;
+};
+
+//------------------------------------------------------------------------------
+void LaplaceDispNorm::Run(time::Progress * prog)
+{
+ prog->Push();
+
+ out.Resize(disp.Size(0),disp.Size(1));
+ 
+ Rows rows(*this);
+ mt::ParallelFor(nat32(0),out.Height(),rows,4);
 
  prog->Pop();
 }
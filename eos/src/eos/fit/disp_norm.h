@@ -74,7 +74,7 @@ class EOS_CLASS DispNorm
    void SetMaxIters(nat32 maxIters);
 
 
-  /// Runs the algorithm.
+  /// Runs the algorithm, using the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -105,6 +105,9 @@ class EOS_CLASS DispNorm
    
   // Output...
    ds::Array2D<real32> out;
+   
+  // Functor for the task pool, does a range of rows...
+   class Rows;
 };
 
 //------------------------------------------------------------------------------
@@ -137,7 +140,7 @@ class EOS_CLASS LaplaceDispNorm
    void SetParam(real32 sd,real32 minSd = 0.1,real32 maxSd = 16.0,real32 sdMult = 3.0);
 
 
-  /// Runs the algorithm.
+  /// Runs the algorithm, using the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -166,6 +169,9 @@ class EOS_CLASS LaplaceDispNorm
 
   // Output...
    ds::Array2D<real32> out;
+   
+  // Functor for the task pool, does a range of rows...
+   class Rows;
 };
 
 //------------------------------------------------------------------------------
@@ -20,6 +20,7 @@
 #include "eos/math/eigen.h"
 #include "eos/math/gaussian_mix.h"
 #include "eos/sfs/sfs_bp.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -61,6 +62,168 @@ void DispNormFish::SetRange(real32 nK,real32 xK)
  maxK = xK;
 }
  
+//------------------------------------------------------------------------------
+class DispNormFish::Rows
+{
+ public:
+  Rows(DispNormFish & s,real32 md,const sfs::FisherAngProb & f)
+  :self(s),mahDist(md),fap(f)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=0;x<self.disp.Size(0);x++)
+    {
+     //LogDebug("Starting {x,y}" << LogDiv() << x << LogDiv() << y);
+
+     // Set the concentration to zero where we don't have enough information...
+      if (self.mask.Valid()&&(self.mask.Get(x,y)==false))
+      {
+       self.out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
+       continue;
+      }
+
+      bit safeXN = (x>0) && (!self.mask.Valid() || self.mask.Get(x-1,y));
+      bit safeXP = (x+1<self.disp.Size(0)) && (!self.mask.Valid() || self.mask.Get(x+1,y));
+      bit safeYN = (y>0) && (!self.mask.Valid() || self.mask.Get(x,y-1));
+      bit safeYP = (y+1<self.disp.Size(1)) && (!self.mask.Valid() || self.mask.Get(x,y+1));
+
+      if ((!safeXN && !safeXP) || (!safeYN && !safeYP))
+      {
+       self.out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
+       continue;
+      }
+
+
+     // First calculate the bivariate Gaussian on disparity difference from the 
+     // input disparity map, handling the boundary cases...
+      real32 muA = self.disp.Get(x,y);
+      real32 sigmaA = self.sd.Get(x,y);
+
+      real32 muB = safeXP?self.disp.Get(x+1,y):(2.0*muA - self.disp.Get(x-1,y));
+      real32 sigmaB = safeXP?self.sd.Get(x+1,y):self.sd.Get(x-1,y);
+
+      real32 muC = safeYP?self.disp.Get(x,y+1):(2.0*muA - self.disp.Get(x,y-1));
+      real32 sigmaC = safeYP?self.sd.Get(x,y+1):self.sd.Get(x,y-1);
+
+      sigmaA *= self.mult;
+      sigmaB *= self.mult;
+      sigmaC *= self.mult;
+
+      //LogDebug("mu {a,b,c}" << LogDiv() << muA << LogDiv() << muB << LogDiv() << muC);
+      //LogDebug("sigma {a,b,c}" << LogDiv() << sigmaA << LogDiv() << sigmaB << LogDiv() << sigmaC);
+
+
+      real32 rhoA = 1.0/(2.0*sigmaA*sigmaA);
+      real32 rhoB = 1.0/(2.0*sigmaB*sigmaB);
+      real32 rhoC = 1.0/(2.0*sigmaC*sigmaC);
+      real32 rhoS = 1.0/(rhoA + rhoB + rhoC);
+
+
+      math::Vect<2> mean;
+      mean[0] = muB - muA;
+      mean[1] = muC - muA;
+
+      math::Mat<2,2> prec;
+      prec[0][0] = 2.0 * rhoB * (rhoS*rhoB + 1.0);
+      prec[0][1] = 2.0 * rhoS * rhoB * rhoC;
+      prec[1][0] = prec[0][1];
+      prec[1][1] = 2.0 * rhoC * (rhoS*rhoC + 1.0);
+
+
+      math::Mat<2,2> covar = prec;
+      math::Inverse22(covar);
+      real32 det = Determinant(covar);
+      if ((!math::IsFinite(det))||math::IsZero(det)||(det<0.0))
+      {
+       self.out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
+       continue;
+      }
+
+      //LogDebug("{mean,prec,covar}" << LogDiv() << mean << LogDiv() << prec << LogDiv() << covar);
+
+
+     // Get the 5 disparity difference values - the mean value and 4 more,
+     // offsetted from the mean in both directions along each of the major and 
+     // minor axis of the ellipsoid, so they are at the edge of the region 
+     // containing the given probability...
+      math::Vect<2> ddp[5];
+      for (nat32 i=0;i<5;i++) ddp[i] = mean;
+
+      math::Mat<2,2> eigenVec;
+      math::Vect<2> eigenVal;
+      if (math::SymEigen(covar,eigenVec,eigenVal)==false)
+      {
+       self.out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
+       continue;
+      }
+
+      //LogDebug("eigen {val,vec}" << LogDiv() << eigenVal << LogDiv() << eigenVec);
+
+      for (nat32 r=0;r<2;r++)
+      {
+       for (nat32 c=0;c<2;c++) eigenVec[r][c] *= math::Sqrt(eigenVal[c]) * mahDist;
+      }
+
+      ddp[1][0] += eigenVec[0][0]; ddp[1][1] += eigenVec[1][0];
+      ddp[2][0] -= eigenVec[0][0]; ddp[2][1] -= eigenVec[1][0];
+      ddp[3][0] += eigenVec[0][1]; ddp[3][1] += eigenVec[1][1];
+      ddp[4][0] -= eigenVec[0][1]; ddp[4][1] -= eigenVec[1][1];    
+
+
+     // Convert each disparity difference into a surface orientaiton direction,
+     // using the pixels disparity to ground the differences...
+      bs::Normal dir[5];
+      {
+       math::Vect<3> base;
+       self.pair.Triangulate(x,y,muA,base);
+
+       for (nat32 i=0;i<5;i++)
+       {
+        math::Vect<3> incX, incY;
+        self.pair.Triangulate(x+1,y,muA+ddp[i][0],incX);
+        self.pair.Triangulate(x,y+1,muA+ddp[i][1],incY);
+
+        incX -= base;
+        incY -= base;
+
+        math::CrossProduct(incX,incY,dir[i]);
+        dir[i].Normalise();
+
+        //LogDebug("dir {i,ddp,dir}" << LogDiv() << i << LogDiv() << ddp[i][0] << "," << ddp[i][1] << LogDiv() << dir[i]);
+       }
+      }
+
+
+     // Construct a Fisher distribution from the angles - direction of the centre
+     // disparity difference, concentration to match the probability consumed in
+     // the angular range...
+     // (We take the maximum angle between the edge surface normals and centre
+     // surface normal, to take a pesimistic view of certainty.)
+      real32 maxAng = 0.0;
+      for (nat32 i=1;i<5;i++)
+      {
+       maxAng = math::Max(maxAng,math::InvCos(dir[0] * dir[i]));
+      }
+
+      self.out.Get(x,y) = dir[0];
+      self.out.Get(x,y) *= fap.Concentration(maxAng);
+
+      //LogDebug("{maxAng,final}" << LogDiv() << (180.0*maxAng/math::pi) << LogDiv() << self.out.Get(x,y));
+    }
+   }
+  }
+
+
+ private:
+  DispNormFish & self;
+  real32 mahDist;
+  const sfs::FisherAngProb & fap;
+};
+
+//------------------------------------------------------------------------------
 void DispNormFish::Run(time::Progress * prog)
 {
  prog->Push();
@@ -68,7 +231,7 @@ void DispNormFish::Run(time::Progress * prog)
  // Calculate the standard deviation multiplier for a bivariate gaussian needed
  // to obtain a region containing a probability mass of prob around the mean...
  // (Also resize the output array.)
-  prog->Report(0,2+disp.Size(1));
+  prog->Report(0,3);
   real32 mahDist = math::ChiSquareCulmInv(prob,2);
   //LogDebug("test chi square " << math::ChiSquareCulmInv(0.95,10)); // Should output approx 18.3
   
@@ -77,157 +240,18 @@ void DispNormFish::Run(time::Progress * prog)
  
  // Setup ready to calculate a Fisher distribution concentration given an
  // angular range that should contain prob around the concentration direction...
-  prog->Report(1,2+disp.Size(1));
+  prog->Report(1,3);
   prog->Push();
   sfs::FisherAngProb fap;
   fap.Make(prob,minK,maxK,1000,180,prog);
   prog->Pop();
 
 
- // Iterate every pixel and do the maths...
-  for (nat32 y=0;y<disp.Size(1);y++)
-  {
-   prog->Report(2+y,2+disp.Size(1));
-   for (nat32 x=0;x<disp.Size(0);x++)
-   {
-    //LogDebug("Starting {x,y}" << LogDiv() << x << LogDiv() << y);
-    
-    // Set the concentration to zero where we don't have enough information...
-     if (mask.Valid()&&(mask.Get(x,y)==false))
-     {
-      out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
-      continue;
-     }
-     
-     bit safeXN = (x>0) && (!mask.Valid() || mask.Get(x-1,y));
-     bit safeXP = (x+1<disp.Size(0)) && (!mask.Valid() || mask.Get(x+1,y));
-     bit safeYN = (y>0) && (!mask.Valid() || mask.Get(x,y-1));
-     bit safeYP = (y+1<disp.Size(1)) && (!mask.Valid() || mask.Get(x,y+1));
-     
-     if ((!safeXN && !safeXP) || (!safeYN && !safeYP))
-     {
-      out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
-      continue;
-     }
-
-
-    // First calculate the bivariate Gaussian on disparity difference from the 
-    // input disparity map, handling the boundary cases...
-     real32 muA = disp.Get(x,y);
-     real32 sigmaA = sd.Get(x,y);
-     
-     real32 muB = safeXP?disp.Get(x+1,y):(2.0*muA - disp.Get(x-1,y));
-     real32 sigmaB = safeXP?sd.Get(x+1,y):sd.Get(x-1,y);
-    
-     real32 muC = safeYP?disp.Get(x,y+1):(2.0*muA - disp.Get(x,y-1));
-     real32 sigmaC = safeYP?sd.Get(x,y+1):sd.Get(x,y-1);
-     
-     sigmaA *= mult;
-     sigmaB *= mult;
-     sigmaC *= mult;
-     
-     //LogDebug("mu {a,b,c}" << LogDiv() << muA << LogDiv() << muB << LogDiv() << muC);
-     //LogDebug("sigma {a,b,c}" << LogDiv() << sigmaA << LogDiv() << sigmaB << LogDiv() << sigmaC);
-
-
-     real32 rhoA = 1.0/(2.0*sigmaA*sigmaA);
-     real32 rhoB = 1.0/(2.0*sigmaB*sigmaB);
-     real32 rhoC = 1.0/(2.0*sigmaC*sigmaC);
-     real32 rhoS = 1.0/(rhoA + rhoB + rhoC);
-
-
-     math::Vect<2> mean;
-     mean[0] = muB - muA;
-     mean[1] = muC - muA;
-     
-     math::Mat<2,2> prec;
-     prec[0][0] = 2.0 * rhoB * (rhoS*rhoB + 1.0);
-     prec[0][1] = 2.0 * rhoS * rhoB * rhoC;
-     prec[1][0] = prec[0][1];
-     prec[1][1] = 2.0 * rhoC * (rhoS*rhoC + 1.0);
-
-
-     math::Mat<2,2> covar = prec;
-     math::Inverse22(covar);
-     real32 det = Determinant(covar);
-     if ((!math::IsFinite(det))||math::IsZero(det)||(det<0.0))
-     {
-      out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
-      continue;
-     }
-     
-     //LogDebug("{mean,prec,covar}" << LogDiv() << mean << LogDiv() << prec << LogDiv() << covar);
-
-
-    // Get the 5 disparity difference values - the mean value and 4 more,
-    // offsetted from the mean in both directions along each of the major and 
-    // minor axis of the ellipsoid, so they are at the edge of the region 
-    // containing the given probability...
-     math::Vect<2> ddp[5];
-     for (nat32 i=0;i<5;i++) ddp[i] = mean;
-     
-     math::Mat<2,2> eigenVec;
-     math::Vect<2> eigenVal;
-     if (math::SymEigen(covar,eigenVec,eigenVal)==false)
-     {
-      out.Get(x,y) = bs::Vert(0.0,0.0,0.0);
-      continue;
-     }
-     
-     //LogDebug("eigen {val,vec}" << LogDiv() << eigenVal << LogDiv() << eigenVec);
-     
-     for (nat32 r=0;r<2;r++)
-     {
-      for (nat32 c=0;c<2;c++) eigenVec[r][c] *= math::Sqrt(eigenVal[c]) * mahDist;
-     }
-     
-     ddp[1][0] += eigenVec[0][0]; ddp[1][1] += eigenVec[1][0];
-     ddp[2][0] -= eigenVec[0][0]; ddp[2][1] -= eigenVec[1][0];
-     ddp[3][0] += eigenVec[0][1]; ddp[3][1] += eigenVec[1][1];
-     ddp[4][0] -= eigenVec[0][1]; ddp[4][1] -= eigenVec[1][1];    
-
-
-    // Convert each disparity difference into a surface orientaiton direction,
-    // using the pixels disparity to ground the differences...
-     bs::Normal dir[5];
-     {
-      math::Vect<3> base;
-      pair.Triangulate(x,y,muA,base);
-      
-      for (nat32 i=0;i<5;i++)
-      {
-       math::Vect<3> incX, incY;
-       pair.Triangulate(x+1,y,muA+ddp[i][0],incX);
-       pair.Triangulate(x,y+1,muA+ddp[i][1],incY);
-       
-       incX -= base;
-       incY -= base;
-       
-       math::CrossProduct(incX,incY,dir[i]);
-       dir[i].Normalise();
-       
-       //LogDebug("dir {i,ddp,dir}" << LogDiv() << i << LogDiv() << ddp[i][0] << "," << ddp[i][1] << LogDiv() << dir[i]);
-      }
-     }
-
-
-    // Construct a Fisher distribution from the angles - direction of the centre
-    // disparity difference, concentration to match the probability consumed in
-    // the angular range...
-    // (We take the maximum angle between the edge surface normals and centre
-    // surface normal, to take a pesimistic view of certainty.)
-     real32 maxAng = 0.0;
-     for (nat32 i=1;i<5;i++)
-     {
-      maxAng = math::Max(maxAng,math::InvCos(dir[0] * dir[i]));
-     }
-     
-     out.Get(x,y) = dir[0];
-     out.Get(x,y) *= fap.Concentration(maxAng);
-     
-     //LogDebug("{maxAng,final}" << LogDiv() << (180.0*maxAng/math::pi) << LogDiv() << out.Get(x,y));
-   }
-  }
+ // Iterate every pixel and do the maths, with the task pool...
+  prog->Report(2,3);
+  Rows rows(*this,mahDist,fap);
+  mt::ParallelFor(nat32(0),disp.Size(1),rows,4);
+
 
  prog->Pop();
 }
@@ -68,7 +68,7 @@ class EOS_CLASS DispNormFish
    void SetRange(real32 minK,real32 maxK);
    
   
-  /// Runs the algorithm.
+  /// Runs the algorithm, using the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -96,6 +96,9 @@ class EOS_CLASS DispNormFish
     
   // Output...
    ds::Array2D<bs::Vert> out;
+   
+  // Functor for the task pool, does a range of rows...
+   class Rows;
 };
 
 //------------------------------------------------------------------------------
@@ -18,6 +18,7 @@
 #include "eos/fit/light_ambient.h"
 
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -260,7 +261,6 @@ void LightAmb::Run(time::Progress * prog)
    ds::Array<real32> tempAlbedo(segCount);
    real32 maxMinCost = math::Infinity<real32>();
    
-   ds::PriorityQueue<AlbRange> albWork;
    ds::PriorityQueue<AmbRange> ambWork;
 
 
@@ -293,14 +293,14 @@ void LightAmb::Run(time::Progress * prog)
        low.maxAmbient = half;
        low.depth = targ.depth-1;
        prog->Report(step++,steps);
-       AmbRangeCost(low,pixel,pixelOffset,albWork);
+       AmbRangeCost(low,pixel,pixelOffset);
       
        AmbRange high;
        high.minAmbient = half;
        high.maxAmbient = targ.maxAmbient;
        high.depth = targ.depth-1;
        prog->Report(step++,steps);
-       AmbRangeCost(high,pixel,pixelOffset,albWork);
+       AmbRangeCost(high,pixel,pixelOffset);
        
        maxMinCost = math::Min(maxMinCost,low.highMinCost,high.highMinCost);
 
@@ -323,7 +323,7 @@ void LightAmb::Run(time::Progress * prog)
     // At the bottom take an actual sample at the half way position of the range...
      real32 half = (targ.minAmbient + targ.maxAmbient) * 0.5;
      prog->Report(step++,steps);
-     real32 c = AmbCost(half,tempAlbedo,pixel,pixelOffset,albWork);
+     real32 c = AmbCost(half,tempAlbedo,pixel,pixelOffset);
      
      if (c<maxMinCost)
      {
@@ -337,46 +337,112 @@ void LightAmb::Run(time::Progress * prog)
  prog->Pop();
 }
 
+//------------------------------------------------------------------------------
+class LightAmb::SegRanges
+{
+ public:
+  SegRanges(LightAmb & s,const AmbRange & a,const ds::Array<PixelAux> & p,const ds::Array<nat32> & po,
+            ds::Array<real32> & l,ds::Array<real32> & h)
+  :self(s),amb(a),pixel(p),pixelOffset(po),low(l),high(h)
+  {}
+
+  void operator () (nat32 s0,nat32 s1)
+  {
+   ds::PriorityQueue<AlbRange> work;
+   for (nat32 i=s0;i<s1;i++)
+   {
+    nat32 size = pixelOffset[i+1] - pixelOffset[i];
+    if (size!=0)
+    {
+     self.SegCostRange(amb.minAmbient,amb.maxAmbient,low[i],high[i],pixel,pixelOffset[i],size,work);
+    }
+   }
+  }
+
+
+ private:
+  LightAmb & self;
+  const AmbRange & amb;
+  const ds::Array<PixelAux> & pixel;
+  const ds::Array<nat32> & pixelOffset;
+  ds::Array<real32> & low;
+  ds::Array<real32> & high;
+};
+
+class LightAmb::SegCosts
+{
+ public:
+  SegCosts(LightAmb & s,real32 a,const ds::Array<PixelAux> & p,const ds::Array<nat32> & po,
+           ds::Array<real32> & c,ds::Array<real32> & al)
+  :self(s),amb(a),pixel(p),pixelOffset(po),cost(c),albedo(al)
+  {}
+
+  void operator () (nat32 s0,nat32 s1)
+  {
+   ds::PriorityQueue<AlbRange> work;
+   for (nat32 i=s0;i<s1;i++)
+   {
+    nat32 size = pixelOffset[i+1] - pixelOffset[i];
+    if (size!=0)
+    {
+     cost[i] = self.SegCost(amb,pixel,pixelOffset[i],size,work,&albedo[i]);
+    }
+    else
+    {
+     albedo[i] = 0.0;
+    }
+   }
+  }
+
+
+ private:
+  LightAmb & self;
+  real32 amb;
+  const ds::Array<PixelAux> & pixel;
+  const ds::Array<nat32> & pixelOffset;
+  ds::Array<real32> & cost;
+  ds::Array<real32> & albedo;
+};
+
 //------------------------------------------------------------------------------
 void LightAmb::AmbRangeCost(AmbRange & amb,const ds::Array<PixelAux> & pixel,
-                            const ds::Array<nat32> & pixelOffset,ds::PriorityQueue<AlbRange> & work)
+                            const ds::Array<nat32> & pixelOffset)
 {
  LogTime("eos::fit::LightAmb::AmbRangeCost");
  
+ nat32 segCount = pixelOffset.Size()-1;
+ ds::Array<real32> low(segCount);
+ ds::Array<real32> high(segCount);
+ SegRanges ranges(*this,amb,pixel,pixelOffset,low,high);
+ mt::ParallelFor(nat32(0),segCount,ranges,1);
+ 
  amb.lowMinCost = 0.0;
  amb.highMinCost = 0.0;
  
- for (nat32 i=0;i<pixelOffset.Size()-1;i++)
+ for (nat32 i=0;i<segCount;i++)
  {
-  nat32 size = pixelOffset[i+1] - pixelOffset[i];
-  if (size!=0)
+  if (pixelOffset[i+1]!=pixelOffset[i])
   {
-   real32 outLow,outHigh;
-   SegCostRange(amb.minAmbient,amb.maxAmbient,outLow,outHigh,pixel,pixelOffset[i],size,work);
-   amb.lowMinCost += outLow;
-   amb.highMinCost += outHigh;
+   amb.lowMinCost += low[i];
+   amb.highMinCost += high[i];
   }
  }
 }
 
 real32 LightAmb::AmbCost(real32 amb,ds::Array<real32> & albedo,const ds::Array<PixelAux> & pixel,
-                 const ds::Array<nat32> & pixelOffset,ds::PriorityQueue<AlbRange> & work)
+                 const ds::Array<nat32> & pixelOffset)
 {
  LogTime("eos::fit::LightAmb::AmbCost");
 
- real32 cost = 0.0;
+ nat32 segCount = pixelOffset.Size()-1;
+ ds::Array<real32> segCost(segCount);
+ SegCosts costs(*this,amb,pixel,pixelOffset,segCost,albedo);
+ mt::ParallelFor(nat32(0),segCount,costs,1);
 
- for (nat32 i=0;i<pixelOffset.Size()-1;i++)
+ real32 cost = 0.0;
+ for (nat32 i=0;i<segCount;i++)
  {
-  nat32 size = pixelOffset[i+1] - pixelOffset[i];
-  if (size!=0)
-  {
-   cost += SegCost(amb,pixel,pixelOffset[i],size,work,&albedo[i]);
-  }
-  else
-  {
-   albedo[i] = 0.0;
-  }
+  if (pixelOffset[i+1]!=pixelOffset[i]) cost += segCost[i];
  }
 
  return cost;
@@ -82,7 +82,7 @@ class EOS_CLASS LightAmb
    void SetSubdivs(nat32 ambient,nat32 albedo);
 
 
-  /// &nbsp;
+  /// The segments are costed by the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
 
   
@@ -199,14 +199,19 @@ class EOS_CLASS LightAmb
 
    // Given various details this fills in an AmbRange's lowMinCost and 
    // highMinCost values - simply loops the relevant segments and sums it all 
-   // up...
+   // up. The segments are done by the task pool...
     void AmbRangeCost(AmbRange & amb,const ds::Array<PixelAux> & pixel,
-                      const ds::Array<nat32> & pixelOffset,ds::PriorityQueue<AlbRange> & work);
+                      const ds::Array<nat32> & pixelOffset);
    
    // Given an ambient value this returns its cost. It also outputs albedo values
-   // into a segment sized array of reals...
+   // into a segment sized array of reals. Also uses the task pool...
     real32 AmbCost(real32 amb,ds::Array<real32> & albedo,const ds::Array<PixelAux> & pixel,
-                   const ds::Array<nat32> & pixelOffset,ds::PriorityQueue<AlbRange> & work);
+                   const ds::Array<nat32> & pixelOffset);
+
+   // Functors for the above, each doing a range of segments with its own work
+   // queue and writing a result per segment, which are then summed in order...
+    class SegRanges;
+    class SegCosts;
 
 
    // Given a segments details and an ambient range this uses branch and bound
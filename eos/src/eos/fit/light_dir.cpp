@@ -20,6 +20,7 @@
 #include "eos/alg/shapes.h"
 #include "eos/fit/sphere_sample.h"
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -84,6 +85,76 @@ void LightDir::SetIrrThreshold(real32 thresh)
  irrThresh = thresh;
 }
 
+//------------------------------------------------------------------------------
+class LightDir::SegCosts
+{
+ public:
+  SegCosts(LightDir & s,const ds::Array<Pixel> & p,const ds::Array<nat32> & o,
+           const ds::ArrayResize<LightCost> & l,nat32 f,ds::Array2D<real32> & c,nat32 mss)
+  :self(s),pixel(p),offset(o),lc(l),first(f),cost(c),maxSegSize(mss)
+  {}
+
+  void operator () (nat32 s0,nat32 s1)
+  {
+   ds::Array<PixelAux> tAux(maxSegSize);
+   ds::PriorityQueue<CostRange> tWork(self.recDepth*4);
+
+   for (nat32 s=s0;s<s1;s++)
+   {
+    nat32 segSize = offset[s+1] - offset[s];
+    if ((segSize!=0)&&(self.cor[s]>self.segPruneThresh))
+    {
+     for (nat32 l=first;l<lc.Size();l++)
+     {
+      cost.Get(l-first,s) = self.SegLightCost(lc[l].dir,self.recDepth,pixel,offset[s],segSize,tAux,tWork);
+     }
+    }
+   }
+  }
+
+
+ private:
+  LightDir & self;
+  const ds::Array<Pixel> & pixel;
+  const ds::Array<nat32> & offset;
+  const ds::ArrayResize<LightCost> & lc;
+  nat32 first;
+  ds::Array2D<real32> & cost;
+  nat32 maxSegSize;
+};
+
+class LightDir::SegAlbedos
+{
+ public:
+  SegAlbedos(LightDir & s,const ds::Array<Pixel> & p,const ds::Array<nat32> & o,nat32 mss)
+  :self(s),pixel(p),offset(o),maxSegSize(mss)
+  {}
+
+  void operator () (nat32 s0,nat32 s1)
+  {
+   ds::Array<PixelAux> tAux(maxSegSize);
+   ds::PriorityQueue<CostRange> tWork(self.recDepth*4);
+
+   for (nat32 s=s0;s<s1;s++)
+   {
+    if (offset[s+1]!=offset[s])
+    {
+     self.SegLightCost(self.bestLightDir,self.recDepth,pixel,offset[s],offset[s+1]-offset[s],
+                       tAux,tWork,&self.albedo[s]);
+    }
+    else self.albedo[s] = 0.0;
+   }
+  }
+
+
+ private:
+  LightDir & self;
+  const ds::Array<Pixel> & pixel;
+  const ds::Array<nat32> & offset;
+  nat32 maxSegSize;
+};
+
+//------------------------------------------------------------------------------
 void LightDir::Run(time::Progress * prog)
 {
  LogTime("eos::fit::LightDir::Run");
@@ -286,32 +357,24 @@ void LightDir::Run(time::Progress * prog)
 
  // Now iterate the light sources and segments and sum up the costs, for the 
  // initial sampling...
-  prog->Report(step++,steps);
-  ds::Array<real32> segCost(lc.Size());
+  prog->Report(step,steps);
   ds::Array<real32> minSegCost(segCount);
-  ds::Array<PixelAux> tAux(maxSegSize);
-  ds::PriorityQueue<CostRange> tWork(recDepth*4);
- 
-  for (nat32 s=0;s<segCount;s++)
   {
-   nat32 segSize = offset[s+1] - offset[s];
-   if ((segSize!=0)&&(cor[s]>segPruneThresh))
+   ds::Array2D<real32> segCost(lc.Size(),segCount);
+   SegCosts costs(*this,pixel,offset,lc,0,segCost,maxSegSize);
+   mt::ParallelFor(nat32(0),segCount,costs,1);
+   step += 1 + segCount*lc.Size();
+
+   for (nat32 s=0;s<segCount;s++)
    {
-    for (nat32 l=0;l<lc.Size();l++)
+    nat32 segSize = offset[s+1] - offset[s];
+    if ((segSize!=0)&&(cor[s]>segPruneThresh))
     {
-     prog->Report(step++,steps);
-     segCost[l] = SegLightCost(lc[l].dir,recDepth,pixel,offset[s],segSize, 
-                              tAux,tWork);
-    }
-   
-    minSegCost[s] = math::Infinity<real32>();
-    for (nat32 l=0;l<lc.Size();l++) minSegCost[s] = math::Min(minSegCost[s],segCost[l]);
+     minSegCost[s] = math::Infinity<real32>();
+     for (nat32 l=0;l<lc.Size();l++) minSegCost[s] = math::Min(minSegCost[s],segCost.Get(l,s));
 
-    for (nat32 l=0;l<lc.Size();l++) lc[l].cost += math::Min(segCost[l]-minSegCost[s],maxSegCostPP*segSize);
-   }
-   else
-   {
-    step += lc.Size();
+     for (nat32 l=0;l<lc.Size();l++) lc[l].cost += math::Min(segCost.Get(l,s)-minSegCost[s],maxSegCostPP*segSize);
+    }
    }
   }
   
@@ -344,6 +407,7 @@ void LightDir::Run(time::Progress * prog)
     steps = int32(steps) + (int32(tris.Size())-6)*3*int32(segCount);
    
    // Iterate the triangles, subdivide, and make the new samples...
+    nat32 first = lc.Size();
     for (nat32 t=0;t<tris.Size();t++)
     {
      nat32 alreadyDone = sds.VertCount();
@@ -355,29 +419,30 @@ void LightDir::Run(time::Progress * prog)
      {
       if (sds.Ind(targ,v)>=alreadyDone)
       {
-       // Basic setup of storage for the new light cost...
-        nat32 ind = lc.Size();
-        lc.Size(ind+1);
-        lc[ind].dir = sds.Vert(targ,v);
-        lc[ind].cost = 0.0;
-        lc[ind].index = sds.Ind(targ,v);
-       
-       // Iterate the segments - cost 'em all and sum it in...
-        for (nat32 s=0;s<segCount;s++)
-        {
-         prog->Report(step++,steps);
-         nat32 segSize = offset[s+1] - offset[s];
-         if ((segSize!=0)&&(cor[s]>segPruneThresh))
-         {
-          real32 cost = SegLightCost(lc[ind].dir,recDepth,pixel,offset[s],segSize,tAux,tWork);
-          lc[ind].cost += math::Min(cost-minSegCost[s],maxSegCostPP*segSize);
-         }
-        }
+       nat32 ind = lc.Size();
+       lc.Size(ind+1);
+       lc[ind].dir = sds.Vert(targ,v);
+       lc[ind].cost = 0.0;
+       lc[ind].index = sds.Ind(targ,v);
       }
-      else
+     }
+    }
+    
+   // Cost the new samples for every segment and sum them in...
+    prog->Report(step,steps);
+    ds::Array2D<real32> segCost(lc.Size()-first,segCount);
+    SegCosts costs(*this,pixel,offset,lc,first,segCost,maxSegSize);
+    mt::ParallelFor(nat32(0),segCount,costs,1);
+    step += tris.Size()*3*segCount;
+
+    for (nat32 l=first;l<lc.Size();l++)
+    {
+     for (nat32 s=0;s<segCount;s++)
+     {
+      nat32 segSize = offset[s+1] - offset[s];
+      if ((segSize!=0)&&(cor[s]>segPruneThresh))
       {
-       prog->Report(step,steps);
-       step += segCount;
+       lc[l].cost += math::Min(segCost.Get(l-first,s)-minSegCost[s],maxSegCostPP*segSize);
       }
      }
     }
@@ -396,17 +461,10 @@ void LightDir::Run(time::Progress * prog)
 
 
  // Calculate an albedo map using the choosen light source direction...
+  prog->Report(step,steps);
   albedo.Size(segCount);
-  for (nat32 s=0;s<segCount;s++)
-  {
-   prog->Report(step++,steps);
-   if (offset[s+1]!=offset[s])
-   {
-    SegLightCost(bestLightDir,recDepth, pixel,offset[s],offset[s+1]-offset[s], 
-                 tAux,tWork,&albedo[s]);
-   }
-   else albedo[s] = 0.0;
-  }
+  SegAlbedos albedos(*this,pixel,offset,maxSegSize);
+  mt::ParallelFor(nat32(0),segCount,albedos,1);
 
 
  prog->Pop();
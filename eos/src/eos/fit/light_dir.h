@@ -28,6 +28,7 @@
 #include "eos/bs/geo3d.h"
 #include "eos/ds/priority_queues.h"
 #include "eos/ds/arrays.h"
+#include "eos/ds/arrays2d.h"
 #include "eos/ds/arrays_resize.h"
 #include "eos/svt/field.h"
 
@@ -95,7 +96,7 @@ class EOS_CLASS LightDir
    void SetIrrThreshold(real32 thresh);
   
   
-  /// &nbsp;
+  /// The segments are costed by the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -231,6 +232,13 @@ class EOS_CLASS LightDir
    
    // Returns the cost of a given albedo using the data structures used by SegLightCost.
     real32 CalcCost(real32 albedo,ds::Array<LightDir::PixelAux> & tAux,nat32 length);
+
+   // Functors for the task pool, each doing a range of segments with its own
+   // tAux and tWork - the first costs a run of light directions for every
+   // segment, the second finds the albedo of each segment for the final
+   // direction...
+    class SegCosts;
+    class SegAlbedos;
 };
 
 //------------------------------------------------------------------------------
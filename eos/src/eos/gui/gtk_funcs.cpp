@@ -33,6 +33,7 @@
 
 #include "eos/file/dlls.h"
 #include "eos/file/csv.h"
+#include "eos/time/startup.h"
 
 namespace eos
 {
@@ -43,6 +44,8 @@ namespace eos
 EOS_VAR_DEF void EOS_STDCALL (*gtk_init)(int * argc,char *** argv);
 EOS_VAR_DEF void EOS_STDCALL (*gtk_main)();
 EOS_VAR_DEF unsigned int EOS_STDCALL (*gtk_idle_add)(int (*)(void *),void * data);
+EOS_VAR_DEF unsigned int EOS_STDCALL (*gtk_timeout_add)(nat32 interval,int (*)(void *),void * data);
+EOS_VAR_DEF void EOS_STDCALL (*gtk_timeout_remove)(unsigned int id);
 EOS_VAR_DEF int EOS_STDCALL (*gtk_events_pending)();
 EOS_VAR_DEF int EOS_STDCALL (*gtk_main_iteration)();
 EOS_VAR_DEF void EOS_STDCALL (*gtk_main_quit)();
@@ -234,6 +237,8 @@ bit LoadGtk()
   LoadGtkFunc(gtk_events_pending,"gtk_events_pending");
   LoadGtkFunc(gtk_main_iteration,"gtk_main_iteration");
   LoadGtkFunc(gtk_idle_add,"gtk_idle_add");
+  LoadGtkFunc(gtk_timeout_add,"gtk_timeout_add");
+  LoadGtkFunc(gtk_timeout_remove,"gtk_timeout_remove");
   LoadGtkFunc(gtk_main_quit,"gtk_main_quit");
 
   LoadGtkFunc(gtk_signal_connect_full,"gtk_signal_connect_full");
@@ -388,6 +393,7 @@ bit LoadGtk()
   char * ptr = "eos";
   char ** ptp = &ptr;
   gtk_init(&num,&ptp);
+  time::StartupMark("gtk");
 
   return true;
 }
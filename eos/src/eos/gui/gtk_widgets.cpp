@@ -727,7 +727,7 @@ void CanvasGtk::II::Image (const bs::Rect & rect,const bs::Pos & pos,const svt::
   if (image.Stride(0)==3)
   {
    gdk_draw_rgb_image(img,gc,pos[0],pos[1],width,height,GDK_RGB_DITHER_NONE,
-                      (byte*)&image.Get(rect.low[0],rect.low[1]+height-1),-image.Stride(1));
+                      (byte*)&image.Get(rect.low[0],rect.low[1]+height-1),-int(image.Stride(1)));
   }
   else
   {
@@ -1326,6 +1326,9 @@ ProgressBarGtk::ProgressBarGtk()
  gtk_widget_ref(bar);
  gtk_widget_show(bar);
 
+ // Cap updates to 5 times a second...
+  SetInterval(200);
+
  // This fixes a really strange bug where the progress bar doesn't work the first time.
   Begin();
   End();
@@ -1363,7 +1366,6 @@ time::Progress * ProgressBarGtk::Begin()
 void ProgressBarGtk::End()
 {
  running = false;
- lastUpdate = 0;
 
  real64 done;
  real64 remaining;
@@ -1384,6 +1386,13 @@ bit ProgressBarGtk::Running() const
  return running;
 }
 
+void ProgressBarGtk::Show(real32 fraction,cstrconst text)
+{
+ if (running) return;
+ gtk_progress_bar_set_fraction(bar,math::Clamp<real32>(fraction,0.0,1.0));
+ gtk_progress_bar_set_text(bar,text);
+}
+
 void ProgressBarGtk::SetSize(nat32 width,nat32 height)
 {
  gtk_widget_set_size_request(bar,width,height);
@@ -1409,12 +1418,6 @@ void * ProgressBarGtk::Special()
 void ProgressBarGtk::OnChange()
 {
  LogTime("eos::gui::ProgressBarGtk::OnChange");
- // Cap updates to 5 times a second...
-  nat64 now = eos::time::MilliTime();
-  if (now-200<lastUpdate) return;
-  lastUpdate = now;
-
-
  // Update the percent complete...
   real32 prog = Prog();
   gtk_progress_bar_set_fraction(bar,prog);
@@ -1586,7 +1589,11 @@ int EOS_STDCALL WindowGtk::DeleteEvent(GtkWidget * widget,GdkEvent * event,void
 //------------------------------------------------------------------------------
 AppGtk::AppGtk()
 :lastDir(0)
-{}
+{
+ // Invoke is polled rather than using an idle callback per call, as adding
+ // sources from another thread isn't safe unless glib threading is setup...
+  invokeTimer = gtk_timeout_add(50,&InvokeEvent,this);
+}
 
 AppGtk::~AppGtk()
 {
@@ -1600,6 +1607,7 @@ AppGtk::~AppGtk()
  }
  
  g_free(lastDir);
+ gtk_timeout_remove(invokeTimer);
 }
 
 void AppGtk::Go()
@@ -1618,6 +1626,13 @@ void AppGtk::Die()
  gtk_main_quit();
 }
 
+void AppGtk::Invoke(Callback * cb)
+{
+ invokeLock.Lock();
+  invoked.AddBack(cb);
+ invokeLock.Unlock();
+}
+
 void AppGtk::Attach(Window * win,bit show)
 {
  mw.AddBack(win);
@@ -1760,6 +1775,24 @@ int AppGtk::IdleEvent(void * data)
  return 0;
 }
 
+int AppGtk::InvokeEvent(void * data)
+{
+ AppGtk * self = (AppGtk*)data;
+
+ // Take the lot, so callbacks can themselves call Invoke...
+  ds::List<Callback*,mem::KillDel<Callback> > todo;
+  self->invokeLock.Lock();
+   todo.Take(self->invoked);
+  self->invokeLock.Unlock();
+
+ while (todo.Size()!=0)
+ {
+  todo.Front()->Call(null<Base*>(),null<Event*>());
+  todo.RemFrontKill();
+ }
+ return 1;
+}
+
 //------------------------------------------------------------------------------
 GtkFactory::GtkFactory(str::TokenTable & tokTab)
 :Factory(tokTab)
@@ -26,6 +26,7 @@
 #include "eos/str/strings.h"
 #include "eos/ds/lists.h"
 #include "eos/ds/arrays2d.h"
+#include "eos/mt/locks.h"
 #include "eos/gui/gtk_funcs.h"
 #include "eos/gui/widgets.h"
 
@@ -415,6 +416,7 @@ class EOS_CLASS ProgressBarGtk : public ProgressBar
   time::Progress * Begin();
   void End();
   bit Running() const;
+  void Show(real32 fraction,cstrconst text);
 
 
   void SetSize(nat32 width,nat32 height);
@@ -429,7 +431,6 @@ class EOS_CLASS ProgressBarGtk : public ProgressBar
   GtkProgressBar * bar;
 
   bit running;
-  nat64 lastUpdate; // To avoid updating it too often.
   void OnChange();
 };
 
@@ -481,6 +482,7 @@ class EOS_CLASS AppGtk : public App
   void Go();
   void Go(Callback * cb);
   void Die();
+  void Invoke(Callback * cb);
 
   void Attach(Window * win,bit show);
   void Detach(Base * win);
@@ -497,7 +499,12 @@ class EOS_CLASS AppGtk : public App
   ds::List<Window*> mw;
   char * lastDir;
 
+  unsigned int invokeTimer;
+  mt::OwnedLock invokeLock;
+  ds::List<Callback*,mem::KillDel<Callback> > invoked; // Protected by invokeLock.
+
   static int IdleEvent(void * data);
+  static int InvokeEvent(void * data); // Polls invoked, from a gtk timeout.
 };
 
 //------------------------------------------------------------------------------
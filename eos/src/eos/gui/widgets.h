@@ -599,6 +599,11 @@ class EOS_CLASS ProgressBar : public Widget, protected time::Progress
   /// This returns true if Begin() has been called and End has not, false otherwise.
    virtual bit Running() const = 0;
 
+  /// Displays progress made elsewhere, typically by a background thread with
+  /// a time::Progress of its own, as a fraction from 0 to 1 and the text to
+  /// show on the bar. Ignored whilst Running().
+   virtual void Show(real32 fraction,cstrconst text) = 0;
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -712,6 +717,14 @@ class EOS_CLASS App : public Base
   /// Makes it exit the message loop, the first step of program termination ushally.
    virtual void Die() = 0;
 
+  /// Arranges for the callback to be called from the message pump, shortly.
+  /// Unlike everything else in the gui this can be called from any thread,
+  /// and is how a background thread hands its results to the gui. Takes
+  /// ownership of the callback, deleting it once called, or when the App is
+  /// deleted if the message pump exits first. Callbacks are called in the
+  /// order given, with null obj and event.
+   virtual void Invoke(Callback * cb) = 0;
+
 
   /// Adds a window to the application. If show is set to true it will make the
   /// window visible at the same time.
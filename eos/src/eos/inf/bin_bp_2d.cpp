@@ -18,6 +18,12 @@
 #include "eos/inf/bin_bp_2d.h"
 
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
+#include "eos/mt/locks.h"
+
+#ifdef __SSE__
+ #include <xmmintrin.h>
+#endif
 
 namespace eos
 {
@@ -25,7 +31,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 BinBP2D::BinBP2D()
-:tol(1e-3),maxIters(10000),momentum(0.0)
+:tol(1e-3),maxIters(10000),momentum(0.0),stride(0),planeSize(0)
 {}
 
 BinBP2D::~BinBP2D()
@@ -49,14 +55,17 @@ void BinBP2D::SetSize(nat32 width,nat32 height)
      targ.incY[i][j] = 0.0;
     }
    }
-   for (nat32 i=0;i<4;i++)
-   {
-    for (nat32 j=0;j<2;j++) targ.in[i][j] = 0.0;
-   }
    targ.dual = true;
    targ.result = false;
   }
  }
+
+ stride = (width+1)/2 + 2;
+ planeSize = 2*height*stride;
+ packed.Size(Planes*planeSize);
+ for (nat32 i=0;i<packed.Size();i++) packed[i] = 0.0;
+ enabled.Size(planeSize);
+ for (nat32 i=0;i<enabled.Size();i++) enabled[i] = 0;
 }
 
 void BinBP2D::Disable(nat32 x,nat32 y)
@@ -90,10 +99,155 @@ void BinBP2D::SetEnd(real32 t,nat32 mi)
  maxIters = mi;
 }
 
+//------------------------------------------------------------------------------
+// Sends the messages in one direction from a row of nodes of the same colour -
+// tot is the total cost difference of each node, own the message from the
+// direction being sent in, a, b and c the edge and out where the messages go.
+// Nodes that are enabled set there bits in change if they changed a message
+// by more than the tolerance...
+static inline void SendRow(nat32 n,const real32 * tot,const real32 * own,
+                           const real32 * a,const real32 * b,const real32 * c,
+                           const nat32 * on,real32 * out,nat32 * change,
+                           real32 momentum,real32 tol)
+{
+ nat32 k = 0;
+ #ifdef __SSE__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 sign = _mm_set1_ps(-0.0);
+  const __m128 mom = _mm_set1_ps(momentum);
+  const __m128 keep = _mm_set1_ps(1.0-momentum);
+  const __m128 limit = _mm_set1_ps(tol);
+  for (;k+4<=n;k+=4)
+  {
+   __m128 h = _mm_sub_ps(_mm_loadu_ps(tot+k),_mm_loadu_ps(own+k));
+   __m128 msg = _mm_sub_ps(_mm_min_ps(_mm_loadu_ps(a+k),_mm_add_ps(_mm_loadu_ps(b+k),h)),
+                           _mm_min_ps(zero,_mm_add_ps(_mm_loadu_ps(c+k),h)));
+
+   __m128 old = _mm_loadu_ps(out+k);
+   __m128 mask = _mm_loadu_ps((const float*)(const void*)(on+k));
+   __m128 moved = _mm_cmpgt_ps(_mm_andnot_ps(sign,_mm_sub_ps(msg,old)),limit);
+   __m128 ch = _mm_or_ps(_mm_loadu_ps((const float*)(const void*)(change+k)),_mm_and_ps(moved,mask));
+   _mm_storeu_ps((float*)(void*)(change+k),ch);
+
+   msg = _mm_add_ps(_mm_mul_ps(mom,old),_mm_mul_ps(keep,msg));
+   _mm_storeu_ps(out+k,_mm_or_ps(_mm_and_ps(mask,msg),_mm_andnot_ps(mask,old)));
+  }
+ #endif
+ for (;k<n;k++)
+ {
+  if (on[k]==0) continue;
+  real32 h = tot[k] - own[k];
+  real32 msg = math::Min(a[k],b[k]+h) - math::Min(real32(0.0),c[k]+h);
+  if (math::Abs(msg-out[k])>tol) change[k] = 0xFFFFFFFF;
+  out[k] = momentum*out[k] + (1.0-momentum)*msg;
+ }
+}
+
+class BinBP2D::Pass
+{
+ public:
+  Pass(BinBP2D & s,nat32 c):self(s),colour(c),notSettled(0) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 width = self.data.Width();
+   nat32 height = self.data.Height();
+   ds::Array<real32> tot(self.stride);
+   ds::Array<nat32> change(self.stride);
+   nat32 count = 0;
+
+   for (nat32 y=begin;y<end;y++)
+   {
+    // Which half of the row we are doing, how many nodes are in it and where
+    // the horizontal neighbours are in the other half...
+     nat32 p = (colour+y)&1;
+     nat32 q = 1-p;
+     nat32 n = (p==0)?((width+1)/2):(width/2);
+     int32 offL = (p==0)?-1:0;
+     int32 offR = (p==0)?0:1;
+
+    // Total cost difference of each node...
+     const real32 * un = self.Plane(Unary,p,y);
+     const real32 * fpx = self.Plane(FromPosX,p,y);
+     const real32 * fpy = self.Plane(FromPosY,p,y);
+     const real32 * fnx = self.Plane(FromNegX,p,y);
+     const real32 * fny = self.Plane(FromNegY,p,y);
+     for (nat32 k=0;k<n;k++)
+     {
+      tot[k] = un[k] + fpx[k] + fpy[k] + fnx[k] + fny[k];
+      change[k] = 0;
+     }
+
+    // Send in all 4 directions...
+     const nat32 * on = self.Mask(p,y);
+     SendRow(n,tot.Ptr(),fpx,self.Plane(XA,p,y),self.Plane(XB,p,y),self.Plane(XC,p,y),
+             on,self.Plane(FromNegX,q,y)+offR,change.Ptr(),self.momentum,self.tol);
+     SendRow(n,tot.Ptr(),fnx,self.Plane(XC,q,y)+offL,self.Plane(XB,q,y)+offL,self.Plane(XA,q,y)+offL,
+             on,self.Plane(FromPosX,q,y)+offL,change.Ptr(),self.momentum,self.tol);
+     if (y+1<height)
+     {
+      SendRow(n,tot.Ptr(),fpy,self.Plane(YA,p,y),self.Plane(YB,p,y),self.Plane(YC,p,y),
+              on,self.Plane(FromNegY,p,y+1),change.Ptr(),self.momentum,self.tol);
+     }
+     if (y>0)
+     {
+      SendRow(n,tot.Ptr(),fny,self.Plane(YC,p,y-1),self.Plane(YB,p,y-1),self.Plane(YA,p,y-1),
+              on,self.Plane(FromPosY,p,y-1),change.Ptr(),self.momentum,self.tol);
+     }
+
+     for (nat32 k=0;k<n;k++) {if (change[k]) ++count;}
+   }
+
+   lock.Lock();
+    notSettled += count;
+   lock.Unlock();
+  }
+
+  nat32 NotSettled() const {return notSettled;}
+
+
+ private:
+  BinBP2D & self;
+  nat32 colour;
+  nat32 notSettled;
+  mt::OwnedLock lock;
+};
+
+void BinBP2D::Pack()
+{
+ for (nat32 y=0;y<data.Height();y++)
+ {
+  for (nat32 x=0;x<data.Width();x++)
+  {
+   const Node & targ = data.Get(x,y);
+   nat32 p = x&1;
+   nat32 k = x/2;
+
+   Plane(Unary,p,y)[k] = targ.cost[1] - targ.cost[0];
+   Mask(p,y)[k] = targ.dual?0xFFFFFFFF:0;
+
+   if (x+1<data.Width())
+   {
+    Plane(XA,p,y)[k] = targ.incX[0][1] - targ.incX[0][0];
+    Plane(XB,p,y)[k] = targ.incX[1][1] - targ.incX[0][0];
+    Plane(XC,p,y)[k] = targ.incX[1][0] - targ.incX[0][0];
+   }
+
+   if (y+1<data.Height())
+   {
+    Plane(YA,p,y)[k] = targ.incY[0][1] - targ.incY[0][0];
+    Plane(YB,p,y)[k] = targ.incY[1][1] - targ.incY[0][0];
+    Plane(YC,p,y)[k] = targ.incY[1][0] - targ.incY[0][0];
+   }
+  }
+ }
+}
+
 void BinBP2D::Run(time::Progress * prog)
 {
  prog->Push();
- 
+ Pack();
+
  // Run through message updates until the change is tiny or the maximum number
  // of iterations is reached...
   static const nat32 settleLength = 4;
@@ -108,86 +262,14 @@ void BinBP2D::Run(time::Progress * prog)
     real32 toSettle = math::Ln(1.0 + 99.0*real32(setCount)/real32(probSize))/math::Ln(100.0);
     prog->Report(math::Max(iter,maxIters-nat32(toSettle*maxIters)),maxIters+1);
    }
-   
-   nat32 notSettled = 0;
-   for (nat32 y=0;y<data.Height();y++)
-   {
-    for (nat32 x=(iter+y)%2;x<data.Width();x+=2) // Checkerboard update pattern.
-    {
-     // Get the node, skip if its not simulated, calculate the cost sum...
-      Node & targ = data.Get(x,y);
-      if (targ.dual==false) continue;
-      
-      real32 baseCost[2];
-      for (nat32 i=0;i<2;i++) baseCost[i] = targ.cost[i];
-      for (nat32 i=0;i<4;i++)
-      {
-       for (nat32 j=0;j<2;j++) baseCost[j] += targ.in[i][j];
-      }
-     
-     // Send messages in all 4 directions, assuming such messages should be sent...
-      bit change = false;
-      for (nat32 d=0;d<4;d++)
-      {
-       // Check its safe...
-        bit safe = true;
-        switch(d)
-        {
-         case 0: safe = x<(data.Width()-1); break; // +ve x
-         case 1: safe = y<(data.Height()-1); break; // +ve y
-         case 2: safe = x>0; break; // -ve x
-         case 3: safe = y>0; break; // -ve y
-        }
-        if (!safe) continue;
-       
-       // Get a pointer to the output data (An array of two values)...
-        real32 * out = null<real32*>();
-        switch(d)
-        {
-         case 0: out = data.Get(x+1,y).in[2]; break;
-         case 1: out = data.Get(x,y+1).in[3]; break;
-         case 2: out = data.Get(x-1,y).in[0]; break;
-         case 3: out = data.Get(x,y-1).in[1]; break;
-        }
-       
-       // Get a pointer and flip variable for the relevant probability table...
-        real32 (*pt)[2][2] = 0;
-        bit flip = false;
-        switch(d)
-        {
-         case 0: pt = &targ.incX; flip = false; break;
-         case 1: pt = &targ.incY; flip = false; break;
-         case 2: pt = &data.Get(x-1,y).incX; flip = true; break;
-         case 3: pt = &data.Get(x,y-1).incY; flip = true; break;
-        }
-       
-       // Calculate the starting costs...
-        real32 startCost[2];
-        for (nat32 i=0;i<2;i++) startCost[i] = baseCost[i] - targ.in[d][i];
-        
-       // Fill in the output...
-        real32 outTemp[2];
-        for (nat32 i=0;i<2;i++)
-        {
-         outTemp[i] = math::Min((*pt)[flip?i:0][flip?0:i] + startCost[0],
-                                (*pt)[flip?i:1][flip?1:i] + startCost[1]);
-        }
-        
-        real32 msgMin = math::Min(outTemp[0],outTemp[1]);
-        for (nat32 i=0;i<2;i++)
-        {
-         outTemp[i] -= msgMin;
-         change |= math::Abs(out[i]-outTemp[i])>tol;
-         out[i] = momentum*out[i] + (1.0-momentum)*outTemp[i];
-        }
-      }
-      if (change) ++notSettled;
-    }
-   }
+
+   // Checkerboard update pattern, with the rows of each colour done at once...
+    Pass pass(*this,iter&1);
+    mt::ParallelFor(nat32(0),data.Height(),pass,8);
    
    // Decide if to break early due to nothing changing much...
    {
-    ns[iter%settleLength] = notSettled;
+    ns[iter%settleLength] = pass.NotSettled();
     bit br = true;
     for (nat32 i=0;i<settleLength;i++) {if (ns[i]!=0) br = false;}
     if (br) break;
@@ -201,16 +283,11 @@ void BinBP2D::Run(time::Progress * prog)
   {
    for (nat32 x=0;x<data.Width();x++)
    {
-    Node & targ = data.Get(x,y);
-   
-    real32 cost[2];
-    for (nat32 i=0;i<2;i++) cost[i] = targ.cost[i];
-    for (nat32 i=0;i<4;i++)
-    {
-     for (nat32 j=0;j<2;j++) cost[j] += targ.in[i][j];
-    }
-    
-    targ.result = cost[0]>cost[1];
+    nat32 p = x&1;
+    nat32 k = x/2;
+    real32 cost = Plane(Unary,p,y)[k] + Plane(FromPosX,p,y)[k] + Plane(FromPosY,p,y)[k]
+                + Plane(FromNegX,p,y)[k] + Plane(FromNegY,p,y)[k];
+    data.Get(x,y).result = cost<0.0;
    }
   }
 
@@ -25,6 +25,7 @@
 
 #include "eos/types.h"
 
+#include "eos/ds/arrays.h"
 #include "eos/ds/arrays2d.h"
 #include "eos/time/progress.h"
 
@@ -39,6 +40,14 @@ namespace eos
 /// convergance and generally doesn't do them all.
 /// Being a binary decision on each node its very fast anyway.
 /// Uses max-sum bp.
+///
+/// Internally each message is a single number, the cost of state 1 minus the
+/// cost of state 0, as thats all a binary message needs. These live in planes
+/// where each row is split into its even and odd columns, so the nodes of one
+/// colour of the checkerboard are contiguous, with contiguous neighbours -
+/// they are then updated 4 at a time with SSE, and the rows of each colour
+/// are split between the threads of the task pool. Momentum is applied to
+/// these single numbers.
 class EOS_CLASS BinBP2D
 {
  public:
@@ -116,14 +125,40 @@ class EOS_CLASS BinBP2D
    real32 cost[2]; // Cost associated with the two possible states.
    real32 incX[2][2]; // Cost information with the node (x+1,y). [this state][other state].
    real32 incY[2][2]; // Cost information with the node (x,y+1). [this state][other state].
-   
-   real32 in[4][2]; // Incomming messages. [from +ve x, +ve y, -ve x,-ve y][this state].
 
    bit dual; // If true its a binary choice node, if false it has no choice and will be ignored.   
    bit result; // False for state 0, true for state 1.
-  }; // 74 bytes.
+  };
 
   ds::Array2D<Node> data;
+
+
+  // The packed form used by Run. Each row has two halves, the even then odd
+  // columns, each stride long with a pad entry at the start so the neighbours
+  // of the end nodes can allways be indexed, the pads and spare entrys at the
+  // end just take messages that are never read. The edge planes hold, for
+  // the edge to the right or below, the costs minus the cost of both being
+  // state 0 - A for 0 then 1, B for 1 then 1, C for 1 then 0 - in which form
+  // the message the other way is just the same with A and C swapped...
+   enum {Unary,FromPosX,FromPosY,FromNegX,FromNegY,XA,XB,XC,YA,YB,YC,Planes};
+
+   nat32 stride;
+   nat32 planeSize;
+   ds::Array<real32> packed; // Planes*planeSize.
+   ds::Array<nat32> enabled; // planeSize, all bits set if dual, 0 if not.
+
+   real32 * Plane(nat32 plane,nat32 parity,nat32 y) const
+   {return &packed[plane*planeSize + (y*2 + parity)*stride + 1];}
+
+   nat32 * Mask(nat32 parity,nat32 y) const
+   {return &enabled[(y*2 + parity)*stride + 1];}
+
+  // Fills in the unary, edge and enabled planes from data...
+   void Pack();
+
+  // Functor for the task pool, updates the nodes of one colour for a range
+  // of rows...
+   class Pass;
 };
 
 //------------------------------------------------------------------------------
@@ -18,17 +18,94 @@
 #include "eos/inf/factor_graphs.h"
 
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
+#include "eos/mt/locks.h"
+#include "eos/ds/priority_queues.h"
 
 namespace eos
 {
  namespace inf
  {
 //------------------------------------------------------------------------------
-FactorGraph::FactorGraph(bit ms,bit l)
-:doMS(ms),loopy(l),iters(1),
+class FactorGraph::SendFuncs
+{
+ public:
+  SendFuncs(FunctionSet * fs,bit ms,bit measure):fs(fs),ms(ms),measure(measure),change(0.0) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   data::Block temp;
+   real32 c;
+   if (ms) c = fs->SendRangeMS(begin,end-begin,temp,measure);
+      else c = fs->SendRangeSP(begin,end-begin,temp,measure);
+
+   lock.Lock();
+    change = math::Max(change,c);
+   lock.Unlock();
+  }
+
+  real32 Change() const {return change;}
+
+ private:
+  FunctionSet * fs;
+  bit ms;
+  bit measure;
+
+  mt::OwnedLock lock;
+  real32 change;
+};
+
+class FactorGraph::SendVars
+{
+ public:
+  SendVars(FactorGraph & s):self(s) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   data::Block temp;
+   for (nat32 j=begin;j<end;j++) self.SendVar(j,temp);
+  }
+
+ private:
+  FactorGraph & self;
+};
+
+class FactorGraph::SendJobs
+{
+ public:
+  SendJobs(FactorGraph & s,const ds::Array<ds::Scheduler<MsgJob>::Job> & w,bit ms):self(s),wave(w),ms(ms) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 i=begin;i<end;i++)
+   {
+    const MsgJob & job = ds::Scheduler<MsgJob>::Item(wave[i]);
+    if (job.dir==MsgJob::ToVar)
+    {
+     if (ms) self.funcs[job.func]->SendOneMS(job.funcInst,job.funcLink);
+        else self.funcs[job.func]->SendOneSP(job.funcInst,job.funcLink);
+    }
+    else
+    {
+     if (ms) Variable::SendOneMS(self.vars[job.var],job.varLink);
+        else Variable::SendOneSP(self.vars[job.var],job.varLink);
+    }
+   }
+  }
+
+ private:
+  FactorGraph & self;
+  const ds::Array<ds::Scheduler<MsgJob>::Job> & wave;
+  bit ms;
+};
+
+//------------------------------------------------------------------------------
+FactorGraph::FactorGraph(bit ms,bit l,bit c)
+:doMS(ms),loopy(l),compact(c&&ms&&l),iters(1),parallel(true),
+tolerance(0.0),residual(false),monitor(null<LoopyMonitor*>()),itersDone(0),lastResidual(0.0),
 funcCount(0),funcs(funcInc),
 varCount(0),vars(varInc),
-outIndex(null<nat32*>()),output(null<byte*>())
+outIndex(null<nat64*>()),output(null<byte*>())
 {}
 
 FactorGraph::~FactorGraph()
@@ -52,7 +129,7 @@ nat32 FactorGraph::MakeFuncs(Function * func,nat32 instances)
       else func->ToSP();
  
  nat32 ret = funcCount;
- funcs[ret] = new FunctionSet(func,instances);
+ funcs[ret] = new FunctionSet(func,instances,compact);
  if (doMS) funcs[ret]->FlatlineLn();
       else funcs[ret]->Flatline();
  
@@ -104,13 +181,28 @@ nat32 FactorGraph::MakeVar(Variable * var)
 bit FactorGraph::SetMsg(nat32 function,nat32 instance,nat32 link,const MessageClass & type,const void * message)
 {
  if (type!=funcs[function]->GetClass(link)) return false;
- mem::Copy<byte>((byte*)funcs[function]->ToFunc(instance,link),(byte*)message,type.Size(type));
+ if (compact)
+ {
+  nat16 * targ = (nat16*)funcs[function]->ToFunc(instance,link);
+  const real32 * src = (const real32*)message;
+  nat32 count = type.Size(type)/sizeof(real32);
+  for (nat32 i=0;i<count;i++) targ[i] = math::ToHalf(src[i]);
+ }
+ else mem::Copy<byte>((byte*)funcs[function]->ToFunc(instance,link),(byte*)message,type.Size(type));
  return true;
 }
 
 bit FactorGraph::Run(time::Progress * prog,bit multipass)
 {
  LogBlock("bit FactorGraph::Run(...)","{multipass}" << LogDiv() << multipass);
+ itersDone = 0;
+ lastResidual = 0.0;
+ if (loopy&&residual)
+ {
+  RunResidual(prog,multipass);
+  return true;
+ }
+
  if (doMS)
  {
   if (loopy)
@@ -147,6 +239,61 @@ const void * FactorGraph::GetMsg(nat32 function,nat32 instance,nat32 link) const
  return funcs[function]->ToFunc(instance,link);
 }
 
+void FactorGraph::ReadMsg(nat32 function,nat32 instance,nat32 link,void * out) const
+{
+ const MessageClass & mc = funcs[function]->GetClass(link);
+ if (compact)
+ {
+  const nat16 * src = (const nat16*)funcs[function]->ToFunc(instance,link);
+  real32 * targ = (real32*)out;
+  nat32 count = mc.Size(mc)/sizeof(real32);
+  for (nat32 i=0;i<count;i++) targ[i] = math::FromHalf(src[i]);
+ }
+ else mem::Copy<byte>((byte*)out,(const byte*)funcs[function]->ToFunc(instance,link),mc.Size(mc));
+}
+
+nat64 FactorGraph::Memory() const
+{
+ nat64 ret = sizeof(*this);
+ for (nat32 i=0;i<funcCount;i++) ret += funcs[i]->Memory();
+ for (nat32 i=0;i<varCount;i++) ret += sizeof(MessageClass) + sizeof(nat32) + Variable::Links(vars[i])*2*sizeof(void*);
+ if (output&&(varCount!=0))
+ {
+  ret += varCount*sizeof(nat64);
+  ret += outIndex[varCount-1] + Variable::Class(vars[varCount-1]).Size(Variable::Class(vars[varCount-1]));
+ }
+ return ret;
+}
+
+void FactorGraph::Report(MemoryReport & out) const
+{
+ out.Zero();
+ out.functions = sizeof(*this) + funcs.Size()*sizeof(FunctionSet*) + vars.Size()*sizeof(void*);
+
+ nat64 linkCount = 0;
+ for (nat32 i=0;i<funcCount;i++)
+ {
+  out.messages += funcs[i]->MessageMemory();
+  out.functions += FunctionSet::StructureMemory(funcs[i]->Links());
+  linkCount += nat64(funcs[i]->Instances()) * nat64(funcs[i]->Links());
+ }
+
+ for (nat32 i=0;i<varCount;i++)
+ {
+  const MessageClass & mc = Variable::Class(vars[i]);
+  out.variables += sizeof(MessageClass) + sizeof(nat32) + Variable::Links(vars[i])*2*sizeof(void*);
+  out.output += sizeof(nat64) + mc.Size(mc);
+ }
+
+ // The non-loopy solvers make a job for each direction of each link, on top
+ // of the links list, and the scheduler holds about a pointer per job...
+  if (!loopy)
+  {
+   out.schedule = nat64(links.Size())*(sizeof(Link) + 2*sizeof(void*));
+   out.schedule += linkCount*2*(sizeof(ds::Scheduler<MsgJob>::Job) + sizeof(MsgJob) + 2*sizeof(void*));
+  }
+}
+
 const MessageClass & FactorGraph::GetType(nat32 function,nat32 link) const
 {
  return funcs[function]->GetClass(link);
@@ -231,71 +378,29 @@ bit FactorGraph::RunNonLoopySP(time::Progress * prog)
   }
 
 
- // Create a set of flags indicating the status of each function/variable,
- // this saves on effort as we can skip most jobs this way...
-  ds::Array<nat32> funcOff(funcCount);
-  funcOff[0] = 0;
-  for (nat32 i=1;i<funcCount;i++)
-  {
-   funcOff[i] = funcOff[i-1] + funcs[i-1]->Instances();
-  }
-  nat32 funcTotal = funcOff[funcCount-1] + funcs[funcCount-1]->Instances();
-  
-  ds::Array<State> funcState(funcTotal);  
-  ds::Array<State> varState(varCount);
-
-  for (nat32 i=0;i<funcState.Size();i++) funcState[i].done = State::None;
-  for (nat32 i=0;i<varState.Size();i++) varState[i].done = State::None;
-
- 
- // Do the jobs until none are left, at which point its all done...
-  ds::Scheduler<MsgJob>::Job targ = work.Schedule();
-  if (work.Bad(targ)) {prog->Pop(); return false;}
-  data::Block temp;
+ // Do the jobs a wave at a time, where each wave only depends on the messages
+ // of earlier waves so the jobs within it can be done in parallel; only the
+ // current wave is ever gathered...
+  ds::Array<ds::Scheduler<MsgJob>::Job> wave;
+  SendJobs sj(*this,wave,false);
+  nat32 done = 0;
+  ds::Scheduler<MsgJob>::Job targ = work.FirstWave();
   while (work.Good(targ))
   {
-   MsgJob & job = work.Item(targ);
+   prog->Report(done,work.Jobs());
+   nat32 size = work.WaveSize();
+   if (wave.Size()<size) wave.Size(size);
    
-   if (job.dir==MsgJob::ToVar)
-   {
-    // ToVar...
-     nat32 funcInd = funcOff[job.func] + job.funcInst;
-     if (funcState[funcInd].done!=State::All)
-     {
-      if (funcState[funcInd].done==State::None)
-      {
-       // Send a single message...
-        funcState[funcInd].link = job.funcLink;
-        funcs[job.func]->SendOneSP(job.funcInst,job.funcLink);
-      }
-      else
-      {
-       // Send all but one messages...
-        funcs[job.func]->SendAllButOneSP(job.funcInst,funcState[funcInd].link);
-      }
-     }
-   }
-   else
-   {
-    // ToFunc...
-     if (varState[job.var].done!=State::All)
-     {
-      if (varState[job.var].done==State::None)
-      {
-       // Send a single message...
-        varState[job.var].link = job.varLink;
-        Variable::SendOneSP(vars[job.var],job.varLink);
-      }
-      else
-      {
-       // Send all but one messages...
-        Variable::SendAllButOneSP(vars[job.var],varState[job.var].link,temp);
-      }
-     }
-   }
+   nat32 i = 0;
+   for (ds::Scheduler<MsgJob>::Job job = targ;work.Good(job);job = work.WaveNext(job)) wave[i++] = job;
    
-   targ = work.Next(targ);
+   if (parallel) mt::ParallelFor(nat32(0),size,sj,64);
+            else sj(0,size);
+   
+   done += size;
+   targ = work.NextWave(targ);
   }
+  if (!work.Complete()) {prog->Pop(); return false;}
 
 
  // Finally calculate the output distributions...
@@ -310,32 +415,56 @@ void FactorGraph::RunLoopySP(time::Progress * prog,bit multipass)
  LogBlock("void FactorGraph::RunLoopySP(...)","{multipass}" << LogDiv() << multipass);
  prog->Push();
 
+ // Only measure how much the messages change if someone wants to know...
+  bit measure = (tolerance>0.0)||(monitor!=null<LoopyMonitor*>());
+  nat64 perIter = 0;
+  for (nat32 j=0;j<funcCount;j++) perIter += nat64(funcs[j]->Instances())*nat64(funcs[j]->Links());
+
  // Pass arround the messages...
   data::Block temp;
   for (nat32 i=0;i<iters;i++)
   {
    // Calculate all the function to variable messages...
     prog->Report(i*2,iters*2);
+    real32 change = 0.0;
     prog->Push();
      for (nat32 j=0;j<funcCount;j++)
      {
       prog->Report(j,funcCount);
-      funcs[j]->SendAllSP(prog);
+      if (parallel)
+      {
+       SendFuncs sf(funcs[j],false,measure);
+       mt::ParallelFor(nat32(0),funcs[j]->Instances(),sf,256);
+       change = math::Max(change,sf.Change());
+      }
+      else change = math::Max(change,funcs[j]->SendAllSP(prog,measure));
      }
     prog->Pop();
+    bit stop = Done(i,change,perIter*nat64(i+1));
   
    // If its not a multipass we bug out here...
-    if ((!multipass)&&(i+1==iters)) break;
+    if ((!multipass)&&((i+1==iters)||stop)) break;
 
    // Calculate all the variable to function messages...
     prog->Report(i*2+1,iters*2);
     prog->Push();
-     for (nat32 j=0;j<varCount;j++)
+     if (parallel)
      {
-      prog->Report(j,varCount);
-      Variable::SendAllSP(vars[j],temp);
+      SendVars sv(*this);
+      mt::ParallelFor(nat32(0),varCount,sv,1024);
+     }
+     else
+     {
+      for (nat32 j=0;j<varCount;j++)
+      {
+       prog->Report(j,varCount);
+       SendVar(j,temp);
+      }
      }
     prog->Pop();
+    
+   // A multipass stops after the variables, so they are ready for next time...
+    if (stop) break;
   }
   
  // Calcualte the output from the final rack of messages, if applicable...
@@ -356,13 +485,13 @@ void FactorGraph::CalcOutputSP()
   delete[] output;
 
  // Calculate the size of the structure and offsets into it...
-  outIndex = new nat32[varCount];
+  outIndex = new nat64[varCount];
   outIndex[0] = 0;
   for (nat32 i=1;i<varCount;i++)
   {
    outIndex[i] = outIndex[i-1] + Variable::Class(vars[i-1]).Size(Variable::Class(vars[i-1]));
   }
-  nat32 totalSize = outIndex[varCount-1] + Variable::Class(vars[varCount-1]).Size(Variable::Class(vars[varCount-1]));
+  nat64 totalSize = outIndex[varCount-1] + Variable::Class(vars[varCount-1]).Size(Variable::Class(vars[varCount-1]));
 
  // Calculate every output probability functions...
   output = new byte[totalSize];
@@ -440,70 +569,29 @@ bit FactorGraph::RunNonLoopyMS(time::Progress * prog)
   }
 
 
- // Create a set of flags indicating the status of each function/variable,
- // this saves on effort as we can skip most jobs this way...
-  ds::Array<nat32> funcOff(funcCount);
-  funcOff[0] = 0;
-  for (nat32 i=1;i<funcCount;i++)
-  {
-   funcOff[i] = funcOff[i-1] + funcs[i-1]->Instances();
-  }
-  nat32 funcTotal = funcOff[funcCount-1] + funcs[funcCount-1]->Instances();
-  
-  ds::Array<State> funcState(funcTotal);  
-  ds::Array<State> varState(varCount);
-
-  for (nat32 i=0;i<funcState.Size();i++) funcState[i].done = State::None;
-  for (nat32 i=0;i<varState.Size();i++) varState[i].done = State::None;
-
- 
- // Do the jobs until none are left, at which point its all done...
-  ds::Scheduler<MsgJob>::Job targ = work.Schedule();
-  if (work.Bad(targ)) {prog->Pop(); return false;}
+ // Do the jobs a wave at a time, where each wave only depends on the messages
+ // of earlier waves so the jobs within it can be done in parallel; only the
+ // current wave is ever gathered...
+  ds::Array<ds::Scheduler<MsgJob>::Job> wave;
+  SendJobs sj(*this,wave,true);
+  nat32 done = 0;
+  ds::Scheduler<MsgJob>::Job targ = work.FirstWave();
   while (work.Good(targ))
   {
-   MsgJob & job = work.Item(targ);
+   prog->Report(done,work.Jobs());
+   nat32 size = work.WaveSize();
+   if (wave.Size()<size) wave.Size(size);
    
-   if (job.dir==MsgJob::ToVar)
-   {
-    // ToVar...
-     nat32 funcInd = funcOff[job.func] + job.funcInst;
-     if (funcState[funcInd].done!=State::All)
-     {
-      if (funcState[funcInd].done==State::None)
-      {
-       // Send a single message...
-        funcState[funcInd].link = job.funcLink;
-        funcs[job.func]->SendOneMS(job.funcInst,job.funcLink);
-      }
-      else
-      {
-       // Send all but one messages...
-        funcs[job.func]->SendAllButOneMS(job.funcInst,funcState[funcInd].link);
-      }
-     }
-   }
-   else
-   {
-    // ToFunc...
-     if (varState[job.var].done!=State::All)
-     {
-      if (varState[job.var].done==State::None)
-      {
-       // Send a single message...
-        varState[job.var].link = job.varLink;
-        Variable::SendOneMS(vars[job.var],job.varLink);
-      }
-      else
-      {
-       // Send all but one messages...
-        Variable::SendAllButOneMS(vars[job.var],varState[job.var].link);
-      }
-     }
-   }
+   nat32 i = 0;
+   for (ds::Scheduler<MsgJob>::Job job = targ;work.Good(job);job = work.WaveNext(job)) wave[i++] = job;
+   
+   if (parallel) mt::ParallelFor(nat32(0),size,sj,64);
+            else sj(0,size);
    
-   targ = work.Next(targ);
+   done += size;
+   targ = work.NextWave(targ);
   }
+  if (!work.Complete()) {prog->Pop(); return false;}
 
 
  // Finally calculate the output distributions...
@@ -518,32 +606,56 @@ void FactorGraph::RunLoopyMS(time::Progress * prog,bit multipass)
  LogBlock("void FactorGraph::RunLoopyMS(...)","{multipass}" << LogDiv() << multipass);
  prog->Push();
 
+ // Only measure how much the messages change if someone wants to know...
+  bit measure = (tolerance>0.0)||(monitor!=null<LoopyMonitor*>());
+  nat64 perIter = 0;
+  for (nat32 j=0;j<funcCount;j++) perIter += nat64(funcs[j]->Instances())*nat64(funcs[j]->Links());
+
  // Pass arround the messages...
+  data::Block temp;
   for (nat32 i=0;i<iters;i++)
   {
    // Calculate all the function to variable messages...
     prog->Report(i*2,iters*2);
+    real32 change = 0.0;
     prog->Push();
      for (nat32 j=0;j<funcCount;j++)
      {
       prog->Report(j,funcCount);
-      funcs[j]->SendAllMS(prog);
+      if (parallel)
+      {
+       SendFuncs sf(funcs[j],true,measure);
+       mt::ParallelFor(nat32(0),funcs[j]->Instances(),sf,256);
+       change = math::Max(change,sf.Change());
+      }
+      else change = math::Max(change,funcs[j]->SendAllMS(prog,measure));
      }
     prog->Pop();
+    bit stop = Done(i,change,perIter*nat64(i+1));
   
    // If its not a multipass we bug out here...
-    if ((!multipass)&&(i+1==iters)) break;
+    if ((!multipass)&&((i+1==iters)||stop)) break;
 
    // Calculate all the variable to function messages...
     prog->Report(i*2+1,iters*2);
     prog->Push();
-     //LogDebug("varCount = " << varCount);
-     for (nat32 j=0;j<varCount;j++)
+     if (parallel)
+     {
+      SendVars sv(*this);
+      mt::ParallelFor(nat32(0),varCount,sv,1024);
+     }
+     else
      {
-      prog->Report(j,varCount);
-      Variable::SendAllMS(vars[j]);
+      for (nat32 j=0;j<varCount;j++)
+      {
+       prog->Report(j,varCount);
+       SendVar(j,temp);
+      }
      }
     prog->Pop();
+    
+   // A multipass stops after the variables, so they are ready for next time...
+    if (stop) break;
   }
   
  // Calcualte the output from the final rack of messages, if applicable...
@@ -564,20 +676,217 @@ void FactorGraph::CalcOutputMS()
   delete[] output;
 
  // Calculate the size of the structure and offsets into it...
-  outIndex = new nat32[varCount];
+  outIndex = new nat64[varCount];
   outIndex[0] = 0;
   for (nat32 i=1;i<varCount;i++)
   {
    outIndex[i] = outIndex[i-1] + Variable::Class(vars[i-1]).Size(Variable::Class(vars[i-1]));
   }
-  nat32 totalSize = outIndex[varCount-1] + Variable::Class(vars[varCount-1]).Size(Variable::Class(vars[varCount-1]));
+  nat64 totalSize = outIndex[varCount-1] + Variable::Class(vars[varCount-1]).Size(Variable::Class(vars[varCount-1]));
 
  // Calculate every output probability functions...
   output = new byte[totalSize];
+  data::Block temp;
   for (nat32 i=0;i<varCount;i++)
   {
-   Variable::CalcOutputMS(vars[i],&output[outIndex[i]]);
+   if (compact) Variable::CalcOutputMSCompact(vars[i],&output[outIndex[i]],temp);
+           else Variable::CalcOutputMS(vars[i],&output[outIndex[i]]);
+  }
+}
+
+void FactorGraph::SendVar(nat32 var,data::Block & temp)
+{
+ if (doMS)
+ {
+  if (compact) Variable::SendAllMSCompact(vars[var],temp);
+          else Variable::SendAllMS(vars[var]);
+ }
+ else Variable::SendAllSP(vars[var],temp);
+}
+
+bit FactorGraph::Done(nat32 iter,real32 change,nat64 sent)
+{
+ itersDone = iter+1;
+ lastResidual = change;
+ if (monitor) monitor->Iteration(iter,change,sent);
+ return (tolerance>0.0)&&(change<tolerance);
+}
+
+// Entry in the residual schedulers priority queue. Entries are never removed
+// when an instances residual changes, a new one is added instead, with the
+// stamp being used to ignore the out of date ones...
+struct ResidualEntry
+{
+ real32 residual;
+ nat32 inst;
+ nat32 stamp;
+
+ bit operator < (const ResidualEntry & rhs) const {return residual>rhs.residual;} // Largest first.
+};
+
+void FactorGraph::RunResidual(time::Progress * prog,bit multipass)
+{
+ LogBlock("void FactorGraph::RunResidual(...)","{multipass}" << LogDiv() << multipass);
+ prog->Push();
+
+ // Give every function instance a global index...
+  ds::Array<nat32> base(funcCount+1);
+  base[0] = 0;
+  for (nat32 j=0;j<funcCount;j++) base[j+1] = base[j] + funcs[j]->Instances();
+  nat32 total = base[funcCount];
+
+ // Build the graph structure, which variables each instance links to and
+ // vice versa. The variables only have pointers to the messages, so we find
+ // which set each points into...
+  ds::Array<nat32> varStart(varCount+1);
+  varStart[0] = 0;
+  for (nat32 v=0;v<varCount;v++) varStart[v+1] = varStart[v] + Variable::Links(vars[v]);
+
+  ds::Array<nat32> varInst(varStart[varCount]);
+  ds::Array<nat32> instStart(total+1);
+  for (nat32 i=0;i<=total;i++) instStart[i] = 0;
+  for (nat32 v=0;v<varCount;v++)
+  {
+   for (nat32 l=0;l<Variable::Links(vars[v]);l++)
+   {
+    void * ptr = Variable::LinkIn(vars[v],l);
+    for (nat32 j=0;j<funcCount;j++)
+    {
+     nat32 inst;
+     if (funcs[j]->Find(ptr,inst))
+     {
+      varInst[varStart[v]+l] = base[j] + inst;
+      instStart[base[j]+inst+1] += 1;
+      break;
+     }
+    }
+   }
+  }
+
+  for (nat32 i=0;i<total;i++) instStart[i+1] += instStart[i];
+  ds::Array<nat32> instVar(instStart[total]);
+  ds::Array<nat32> fill(total);
+  for (nat32 i=0;i<total;i++) fill[i] = instStart[i];
+  for (nat32 v=0;v<varCount;v++)
+  {
+   for (nat32 k=varStart[v];k<varStart[v+1];k++) instVar[fill[varInst[k]]++] = v;
+  }
+
+  ds::Array<nat32> setOf(total);
+  for (nat32 j=0;j<funcCount;j++)
+  {
+   for (nat32 i=base[j];i<base[j+1];i++) setOf[i] = j;
   }
+
+
+ // Fill the queue with the residual of every instance...
+  data::Block temp;
+  ds::Array<real32> res(total);
+  ds::Array<nat32> stamp(total);
+  ds::PriorityQueue<ResidualEntry> queue(total);
+  for (nat32 i=0;i<total;i++)
+  {
+   FunctionSet * fs = funcs[setOf[i]];
+   nat32 inst = i - base[setOf[i]];
+   res[i] = doMS ? fs->ResidualMS(inst,temp) : fs->ResidualSP(inst,temp);
+   stamp[i] = 0;
+
+   ResidualEntry e;
+    e.residual = res[i];
+    e.inst = i;
+    e.stamp = 0;
+   queue.Add(e);
+  }
+
+
+ // Do the updates, largest residual first, until converged or out of our
+ // allowance...
+  nat64 sent = 0;
+  nat32 iter = 0;
+  nat32 updates = 0;
+  real32 iterMax = 0.0;
+  while ((iter<iters)&&(queue.Size()!=0))
+  {
+   prog->Report(iter,iters);
+   ResidualEntry e = queue.Peek();
+   queue.Rem();
+   if (e.stamp!=stamp[e.inst]) continue;
+   if (e.residual<=tolerance) break;
+
+   // Update the instance...
+    FunctionSet * fs = funcs[setOf[e.inst]];
+    nat32 inst = e.inst - base[setOf[e.inst]];
+    if (doMS) fs->SendRangeMS(inst,1,temp);
+         else fs->SendRangeSP(inst,1,temp);
+    sent += fs->Links();
+    iterMax = math::Max(iterMax,e.residual);
+    res[e.inst] = 0.0;
+    stamp[e.inst] += 1;
+
+   // Update its variables, and then the residuals of their other instances...
+    for (nat32 k=instStart[e.inst];k<instStart[e.inst+1];k++)
+    {
+     nat32 v = instVar[k];
+     SendVar(v,temp);
+
+     for (nat32 m=varStart[v];m<varStart[v+1];m++)
+     {
+      nat32 other = varInst[m];
+      if (other==e.inst) continue;
+
+      FunctionSet * ofs = funcs[setOf[other]];
+      nat32 oi = other - base[setOf[other]];
+      res[other] = doMS ? ofs->ResidualMS(oi,temp) : ofs->ResidualSP(oi,temp);
+      stamp[other] += 1;
+
+      ResidualEntry ne;
+       ne.residual = res[other];
+       ne.inst = other;
+       ne.stamp = stamp[other];
+      queue.Add(ne);
+     }
+    }
+
+   // Out of date entries build up, so rebuild the queue when there are too
+   // many...
+    if (queue.Size()>4*total)
+    {
+     queue.MakeEmpty();
+     for (nat32 i=0;i<total;i++)
+     {
+      if (res[i]<=tolerance) continue;
+      ResidualEntry ne;
+       ne.residual = res[i];
+       ne.inst = i;
+       ne.stamp = stamp[i];
+      queue.Add(ne);
+     }
+    }
+
+   // Count iterations...
+    ++updates;
+    if (updates==total)
+    {
+     Done(iter,iterMax,sent);
+     ++iter;
+     updates = 0;
+     iterMax = 0.0;
+    }
+  }
+
+  // Record the partial iteration if it stopped part way through one...
+   if (updates!=0) Done(iter,iterMax,sent);
+
+
+ // The variables are kept up to date as we go, so if its the final pass the
+ // output can be calculated straight away...
+  if (!multipass)
+  {
+   if (doMS) CalcOutputMS();
+        else CalcOutputSP();
+  }
+
+ prog->Pop();
 }
 
 //------------------------------------------------------------------------------
@@ -35,6 +35,56 @@ namespace eos
 {
  namespace inf
  {
+//------------------------------------------------------------------------------
+/// An interface that can be given to a FactorGraph to be told how loopy solving
+/// is going, one call per iteration. For the residual schedule an iteration is
+/// as many function instance updates as there are function instances.
+class EOS_CLASS LoopyMonitor : public Deletable
+{
+ public:
+  /// &nbsp;
+   ~LoopyMonitor() {}
+
+  /// Called after each iteration, with the iteration number, starting from 0,
+  /// the largest change made to a function to variable message value during
+  /// it and how many function to variable messages have been sent in total
+  /// so far in this Run.
+   virtual void Iteration(nat32 iter,real32 residual,nat64 sent) = 0;
+
+  /// &nbsp;
+   virtual cstrconst TypeString() const = 0;
+};
+
+//------------------------------------------------------------------------------
+/// A break down of how many bytes a graph needs, as filled in by
+/// FactorGraph::Report and FieldGraph::Estimate, so jobs can be sized up
+/// before they are run. None of it includes the data held by the Function
+/// objects.
+struct EOS_CLASS MemoryReport
+{
+ nat64 messages; ///< The message buffers of the function sets, usually almost all of it.
+ nat64 functions; ///< The bookkeeping of the function sets and the graph object itself.
+ nat64 schedule; ///< The links list and job store of the non-loopy schedule, 0 if loopy.
+ nat64 variables; ///< The variables, i.e. there links to the function sets.
+ nat64 output; ///< The final distributions of the variables.
+
+ /// &nbsp;
+  void Zero() {messages = 0; functions = 0; schedule = 0; variables = 0; output = 0;}
+
+ /// &nbsp;
+  void operator += (const MemoryReport & rhs)
+  {
+   messages += rhs.messages;
+   functions += rhs.functions;
+   schedule += rhs.schedule;
+   variables += rhs.variables;
+   output += rhs.output;
+  }
+
+ /// &nbsp;
+  nat64 Total() const {return messages + functions + schedule + variables + output;}
+};
+
 //------------------------------------------------------------------------------
 /// This represents a factor graph solver. Due to its massive memory consumption
 /// requirements a different data structure should be used for storage, with
@@ -58,11 +108,11 @@ namespace eos
 /// interfaces specialised for solving specific problems that use this object as
 /// there inference engine.
 ///
-/// Note that the non-loopy implimentation is far more limited than the loopy 
-/// implimentation in terms of scale, as it produces a complete execution schedule
-/// seperatly then runs, so it has to store the schedule. This results in basic size 
-/// limitations on how large a non-loopy tree can be solved this way, this could be 
-/// fixed but isn't as an issue right now.
+/// Note that the non-loopy implimentation is more limited than the loopy 
+/// implimentation in terms of scale, as it stores a job for every message and
+/// the dependencies between them before it runs. It then sends the messages in
+/// waves, each of which only depends on earlier waves, so the schedule itself
+/// is never stored and each wave is sent in parallel.
 class EOS_CLASS FactorGraph
 {
  public:
@@ -78,7 +128,12 @@ class EOS_CLASS FactorGraph
   /// There are two supported schedules:
   /// - non-loopy - Produces the correct result, only works on trees however. Only passes one message per link with no iterations required, making it relativly fast.
   /// - loopy - Does not neccesarily converge and requires iterations so it is rather slow. Works on graphs however, making it considerably more flexable. In practise this is ushally used as most problems can't be expressed as trees.
-   FactorGraph(bit ms = false,bit loopy = true);
+  ///
+  /// compact stores the messages as halfs rather than real32's, halving the
+  /// memory they take, which is almost all of it for large graphs. Only
+  /// supported for loopy min-sum, ignored otherwise. Costs some speed and
+  /// the messages become accurate to about 3 significant figures.
+   FactorGraph(bit ms = false,bit loopy = true,bit compact = false);
   
   /// &nbsp;
   ~FactorGraph();
@@ -91,6 +146,14 @@ class EOS_CLASS FactorGraph
   /// Returns true if the factor graph was constructed to solve with the loopy method.
    bit DoLoopy() const {return loopy;}
 
+  /// Returns true if the messages are being stored as halfs.
+   bit DoCompact() const {return compact;}
+
+  /// Changes the compact setting given to the constructor, so it can be
+  /// decided once the size of the graph is known. Only has an effect on
+  /// function sets made after it is called, so call before MakeFuncs.
+   void SetCompact(bit enable) {compact = enable&&doMS&&loopy;}
+
 
   /// When using loopy belief propagation you have to set the number of iterations,
   /// should be set high enough for information to flow between nodes in the graph.
@@ -101,6 +164,40 @@ class EOS_CLASS FactorGraph
   /// Defaults to 1, which is too low for anything, so you must call this if loopy.
    void SetIters(nat32 its) {iters = its;}
 
+  /// Sets if solving uses the task pool, defaults to true. For loopy solving
+  /// the function instances and then the variables are split between the
+  /// threads - each half of an iteration only reads the messages the previous
+  /// half wrote, as the incomming and outgoing halves of each link are
+  /// seperate, so it is allready double buffered and the results are
+  /// identical either way. For non-loopy solving each wave of messages is
+  /// split between the threads.
+  /// Only switch it off if the Function objects are not safe to call from
+  /// several threads at once.
+   void SetParallel(bit enable) {parallel = enable;}
+
+  /// Sets a convergence tolerance for loopy solving - once an iteration changes
+  /// no function to variable message value by more than this it stops, even
+  /// if SetIters allowed more. The values are costs for min-sum and
+  /// normalised probabilities for sum-product, so set it accordingly.
+  /// Defaults to 0, which is off. Measuring the change costs a little
+  /// extra work, as the old messages have to be kept to compare with.
+   void SetTolerance(real32 tol) {tolerance = tol;}
+
+  /// Switches loopy solving to residual scheduling - rather than updating
+  /// every function each iteration the function instance whose messages would
+  /// change the most is updated next, using a priority queue, so effort goes
+  /// to the parts of the graph that are still changing. SetIters then caps the
+  /// work at that many updates per function instance, and it stops early when
+  /// no update would change a message by more than the tolerance. Works out
+  /// the residuals by calculating messages without keeping them, so each
+  /// update costs several times as much, and it runs in a single thread.
+  /// Defaults to off; its worth it when most of the graph converges quickly.
+   void SetResidual(bit enable) {residual = enable;}
+
+  /// Sets an object to be told about each loopy iteration, or null for none,
+  /// the default. Not owned - it must outlive the calls to Run.
+   void SetMonitor(LoopyMonitor * mon) {monitor = mon;}
+
 
   /// This creates a number of instances of a function, returning a handle to 
   /// refer to that set in future calls. The Function is absorbed and from then
@@ -173,6 +270,15 @@ class EOS_CLASS FactorGraph
   /// however and return false if it detects that you have given it a graph
   /// rather than a tree.
    bit Run(time::Progress * prog = null<time::Progress*>(),bit multipass = false);
+
+  /// After a loopy Run returns how many iterations were actually done, which
+  /// can be less than SetIters if a tolerance was set.
+   nat32 ItersDone() const {return itersDone;}
+
+  /// After a loopy Run returns the largest message change in the last
+  /// iteration, if it was measured, due to a tolerance, residual scheduling or
+  /// a monitor, otherwise 0.
+   real32 Residual() const {return lastResidual;}
    
   /// Resets all the messages. Useful if you want to run again with the same
   /// structure but with a new data set behind some data-sensitive function.
@@ -193,8 +299,14 @@ class EOS_CLASS FactorGraph
   /// graph using the SetMsg method with which it partners. Works best to call
   /// this after a multipass run rather than not, as it misses an iteration
   /// if not.
+  /// In compact mode this points to halfs, so use ReadMsg instead.
    const void * GetMsg(nat32 function,nat32 instance,nat32 link) const;
 
+  /// As GetMsg, but copys the message into the given block, of the message
+  /// types size, converting from halfs if compact. Can allways be given to
+  /// SetMsg.
+   void ReadMsg(nat32 function,nat32 instance,nat32 link,void * out) const;
+
   /// Proves useful in collaboration with SetMsg and GetMsg, returns a const 
   /// reference to the type of a function variable link.
    const MessageClass & GetType(nat32 function,nat32 link) const;
@@ -215,6 +327,18 @@ class EOS_CLASS FactorGraph
    void FromNegLn();
 
 
+  /// Returns how many bytes the graph is using, for the messages, variables
+  /// and output. Does not include any data held by the Function objects.
+   nat64 Memory() const;
+
+  /// Fills in a break down of the bytes the graph will need to Run, which can
+  /// be called once the graph is built but before Run, so it includes the
+  /// schedule and output even if they have not been made yet. The total can
+  /// be a little more than Memory, as the output of the non-loopy solver and
+  /// such are freed after use.
+   void Report(MemoryReport & out) const;
+
+
   /// &nbsp;
    static cstrconst TypeString() {return "eos::inf::FactorGraph";}
 
@@ -225,7 +349,15 @@ class EOS_CLASS FactorGraph
 
   bit doMS;
   bit loopy;
+  bit compact;
   nat32 iters;
+  bit parallel;
+  real32 tolerance;
+  bit residual;
+  LoopyMonitor * monitor;
+
+  nat32 itersDone;
+  real32 lastResidual;
 
 
   // The actual data structure, these arrays are often larger than needed for
@@ -249,7 +381,7 @@ class EOS_CLASS FactorGraph
    ds::List<Link> links;
    
   // Data structure for storing the final output probability functions...
-   nat32 * outIndex; // Array indexed by probability function of offsets into output for that message.
+   nat64 * outIndex; // Array indexed by probability function of offsets into output for that message.
    byte * output; // Large data blob of tightly packed probability functions.
 
 
@@ -262,6 +394,26 @@ class EOS_CLASS FactorGraph
    void RunLoopyMS(time::Progress * prog,bit multipass);
    void CalcOutputMS();
 
+  // The residual scheduled loopy solver, for both modes...
+   void RunResidual(time::Progress * prog,bit multipass);
+
+  // Sends all the messages of a variable, for the current mode...
+   void SendVar(nat32 var,data::Block & temp);
+
+  // Records an iteration as done, telling the monitor. Returns true if the
+  // tolerance has been reached...
+   bit Done(nat32 iter,real32 change,nat64 sent);
+
+  // Functors for the threaded halves of a loopy iteration. The functions are
+  // given to the threads in ranges of instances, the variables in ranges of
+  // variables...
+   class SendFuncs;
+   class SendVars;
+
+  // Functor for sending the messages of one wave of the non-loopy schedule,
+  // given to the threads in ranges of the wave...
+   class SendJobs;
+
    
   // Extra structures used by the non-loopy message passing arrangment...
    struct MsgJob : public Link
@@ -269,12 +421,6 @@ class EOS_CLASS FactorGraph
     enum {ToVar,ToFunc} dir;
    };
 
-   struct State
-   {
-    enum {None,One,All} done;
-    nat32 link; // For the One to All transition, so we know what to not.
-   };
-   
    // Creates a single data structure array of jobs, where you can request the in 
    // the and out job of each function/instance/link triplet.
    class JobStore
@@ -18,16 +18,42 @@
 #include "eos/inf/fg_funcs.h"
 
 #include "eos/math/gaussian_mix.h"
+#include "eos/math/dist_trans.h"
 #include "eos/file/csv.h"
 
 namespace eos
 {
  namespace inf
  {
+//------------------------------------------------------------------------------
+void Function::SendAllRangeSP(nat32 first,nat32 count,MessageSet ms,nat32 stride)
+{
+ for (nat32 i=0;i<count;i++)
+ {
+  SendAllSP(first+i,ms);
+  ms.Advance(stride);
+ }
+}
+
+void Function::SendAllRangeMS(nat32 first,nat32 count,MessageSet ms,nat32 stride)
+{
+ for (nat32 i=0;i<count;i++)
+ {
+  SendAllMS(first+i,ms);
+  ms.Advance(stride);
+ }
+}
+
+bit Function::SendAllRangeMSHalf(nat32,nat32,MessageSet,nat32,data::Block &)
+{
+ return false;
+}
+
 //------------------------------------------------------------------------------
-FunctionSet::FunctionSet(Function * f,nat32 inst)
+FunctionSet::FunctionSet(Function * f,nat32 inst,bit comp)
 :func(f),instances(inst),links(0),mc(null<MessageClass*>()),
-data(null<byte*>()),stride(0),in(null<nat32*>()),out(null<nat32*>())
+data(null<byte*>()),stride(0),in(null<nat32*>()),out(null<nat32*>()),
+compact(comp),temp(null<byte*>())
 {
  links = func->Links();
  mc = new MessageClass[links]; if (mc==null<MessageClass*>()) return;
@@ -43,12 +69,30 @@ data(null<byte*>()),stride(0),in(null<nat32*>()),out(null<nat32*>())
  for (nat32 i=0;i<links;i++) out[i] = in[i]+stride;
  stride *= 2;
  
- data = mem::Malloc<byte>(stride * instances);
+ if (compact) temp = mem::Malloc<byte>(stride);
+ data = mem::Malloc<byte>(nat64(Off(stride)) * nat64(instances));
+}
+
+nat64 FunctionSet::MessageMemory(const Function & func,nat32 instances,bit compact)
+{
+ nat32 stride = 0;
+ MessageClass mc;
+ for (nat32 i=0;i<func.Links();i++)
+ {
+  func.LinkType(i,mc);
+  stride += mc.Size(mc);
+ }
+ stride *= 2;
+
+ nat64 ret = nat64(compact?(stride>>1):stride)*nat64(instances);
+ if (compact) ret += stride;
+ return ret;
 }
 
 FunctionSet::~FunctionSet()
 {
  mem::Free(data);
+ mem::Free(temp);
  delete[] out;
  delete[] in;
  delete[] mc;
@@ -56,6 +100,14 @@ FunctionSet::~FunctionSet()
 
 void FunctionSet::Flatline()
 {
+ if (compact)
+ {
+  for (nat32 j=0;j<links;j++) mc[j].Flatline(mc[j],temp + in[j]);
+  for (nat32 j=0;j<links;j++) mc[j].Flatline(mc[j],temp + out[j]);
+  FillCompact();
+  return;
+ }
+
  byte * targ = data;
  for (nat32 i=0;i<instances;i++)
  {
@@ -67,6 +119,14 @@ void FunctionSet::Flatline()
 
 void FunctionSet::FlatlineLn()
 {
+ if (compact)
+ {
+  for (nat32 j=0;j<links;j++) mc[j].FlatlineLn(mc[j],temp + in[j]);
+  for (nat32 j=0;j<links;j++) mc[j].FlatlineLn(mc[j],temp + out[j]);
+  FillCompact();
+  return;
+ }
+
  byte * targ = data;
  for (nat32 i=0;i<instances;i++)
  {
@@ -74,6 +134,152 @@ void FunctionSet::FlatlineLn()
   for (nat32 j=0;j<links;j++) mc[j].FlatlineLn(mc[j],targ + out[j]);
   targ += stride;
  }
+}
+
+void FunctionSet::FillCompact()
+{
+ // Convert temp once then copy it into every instance...
+  if (instances==0) return;
+  nat32 count = stride/sizeof(real32);
+  const real32 * src = (const real32*)temp;
+  nat16 * first = (nat16*)At(0);
+  for (nat32 i=0;i<count;i++) first[i] = math::ToHalf(src[i]);
+
+  for (nat32 i=1;i<instances;i++) mem::Copy<nat16>((nat16*)At(i),first,count);
+}
+
+real32 FunctionSet::SendAllSP(time::Progress * prog,bit measure)
+{
+ real32 ret = 0.0;
+ prog->Push();
+  data::Block temp;
+  for (nat32 i=0;i<instances;i+=batch)
+  {
+   prog->Report(i,instances);
+   ret = math::Max(ret,SendRangeSP(i,math::Min(nat32(batch),instances-i),temp,measure));
+  }
+ prog->Pop();
+ return ret;
+}
+
+real32 FunctionSet::SendRangeSP(nat32 first,nat32 count,data::Block & temp,bit measure)
+{
+ return Batch(first,count,temp,false,measure,true);
+}
+
+real32 FunctionSet::ResidualSP(nat32 instance,data::Block & temp)
+{
+ return Batch(instance,1,temp,false,true,false);
+}
+
+real32 FunctionSet::SendAllMS(time::Progress * prog,bit measure)
+{
+ real32 ret = 0.0;
+ prog->Push();
+  data::Block temp;
+  for (nat32 i=0;i<instances;i+=batch)
+  {
+   prog->Report(i,instances);
+   ret = math::Max(ret,SendRangeMS(i,math::Min(nat32(batch),instances-i),temp,measure));
+  }
+ prog->Pop();
+ return ret;
+}
+
+real32 FunctionSet::SendRangeMS(nat32 first,nat32 count,data::Block & temp,bit measure)
+{
+ return Batch(first,count,temp,true,measure,true);
+}
+
+real32 FunctionSet::ResidualMS(nat32 instance,data::Block & temp)
+{
+ return Batch(instance,1,temp,true,true,false);
+}
+
+void FunctionSet::UnpackRange(nat32 first,nat32 count,byte * buf) const
+{
+ if (!compact)
+ {
+  mem::Copy(buf,At(first),count*stride);
+  return;
+ }
+
+ // Instances are contiguous, so its one long conversion...
+  nat32 total = count*(stride/sizeof(real32));
+  const nat16 * src = (const nat16*)At(first);
+  real32 * dst = (real32*)buf;
+  for (nat32 i=0;i<total;i++) dst[i] = math::FromHalf(src[i]);
+}
+
+void FunctionSet::PackRange(nat32 first,nat32 count,const byte * buf)
+{
+ // Only the second half of each instance, the outgoing messages...
+  nat32 half = stride/(2*sizeof(real32));
+  for (nat32 j=0;j<count;j++)
+  {
+   const real32 * src = (const real32*)(buf + j*stride) + half;
+   if (compact)
+   {
+    nat16 * dst = (nat16*)At(first+j) + half;
+    for (nat32 i=0;i<half;i++) dst[i] = math::ToHalf(src[i]);
+   }
+   else mem::Copy((real32*)At(first+j) + half,src,half);
+  }
+}
+
+real32 FunctionSet::Change(nat32 first,nat32 count,const byte * buf) const
+{
+ real32 ret = 0.0;
+ nat32 half = stride/(2*sizeof(real32));
+ for (nat32 j=0;j<count;j++)
+ {
+  const real32 * src = (const real32*)(buf + j*stride) + half;
+  if (compact)
+  {
+   const nat16 * cur = (const nat16*)At(first+j) + half;
+   for (nat32 i=0;i<half;i++) ret = math::Max(ret,math::Abs(src[i]-math::FromHalf(cur[i])));
+  }
+  else
+  {
+   const real32 * cur = (const real32*)At(first+j) + half;
+   for (nat32 i=0;i<half;i++) ret = math::Max(ret,math::Abs(src[i]-cur[i]));
+  }
+ }
+ return ret;
+}
+
+real32 FunctionSet::Batch(nat32 first,nat32 count,data::Block & temp,bit ms,bit measure,bit commit)
+{
+ // If we don't need the old messages it can be done in place, if its not
+ // compact or the function can work with the halfs directly...
+  if ((!compact)&&(!measure))
+  {
+   MessageSet m(mc,At(first),in,out);
+   if (ms) func->SendAllRangeMS(first,count,m,stride);
+      else func->SendAllRangeSP(first,count,m,stride);
+   return 0.0;
+  }
+
+  if (compact&&ms&&(!measure)&&commit)
+  {
+   MessageSet m(mc,At(first),in,out);
+   if (func->SendAllRangeMSHalf(first,count,m,Off(stride),temp)) return 0.0;
+  }
+
+ // Otherwise go through temp in batches, so it stays small...
+  real32 ret = 0.0;
+  for (nat32 i=0;i<count;i+=batch)
+  {
+   nat32 num = math::Min(nat32(batch),count-i);
+   if (temp.Size()<num*stride) temp.SetSize(num*stride);
+   UnpackRange(first+i,num,temp.Ptr());
+    MessageSet m(mc,temp.Ptr(),in,out);
+    if (ms) func->SendAllRangeMS(first+i,num,m,stride);
+       else func->SendAllRangeSP(first+i,num,m,stride);
+   if (measure) ret = math::Max(ret,Change(first+i,num,temp.Ptr()));
+   if (commit) PackRange(first+i,num,temp.Ptr());
+  }
+ return ret;
 }
 
 //------------------------------------------------------------------------------
@@ -161,7 +367,7 @@ void Distribution::ToSP()
   {
    if (targ[l].ms==true)
    {
-    targ[l].val = math::Max<real32>(math::Exp(-targ[l].val),0.0);
+    targ[l].val = math::Max<real32>(math::KernelExp(-targ[l].val),0.0);
     targ[l].ms = false;
    }
    sum += targ[l].val;
@@ -207,7 +413,7 @@ void Distribution::ToMS()
    if (targ[l].ms==false)
    {
     if (math::IsZero(targ[l].val)) targ[l].val = 100.0;
-                              else targ[l].val = math::Min(-math::Ln(targ[l].val),real32(100.0));
+                              else targ[l].val = math::Min(-math::KernelLn(targ[l].val),real32(100.0));
     targ[l].ms = true;
    }
    minVal = math::Min(minVal,targ[l].val);
@@ -373,7 +579,7 @@ void JointDistribution::ToMS()
   {
    real32 & targ = Get(ind,i);
    if (math::Equal(targ,real32(0.0))) targ = 10.0;
-                                 else targ = math::Min(-math::Ln(targ),real32(10.0));
+                                 else targ = math::Min(-math::KernelLn(targ),real32(10.0));
   }
   
   ++ind[0];
@@ -493,10 +699,8 @@ void DualDistribution::ToSP()
  // Convert if need be...
   if (ms)
   {
-   for (nat32 i=0;i<instances*labels0*labels1;i++)
-   {
-    data[i] = math::Exp(-data[i]);
-   }
+   for (nat32 i=0;i<instances*labels0*labels1;i++) data[i] = -data[i];
+   math::KernelExp(data,data,instances*labels0*labels1);
    ms = false;
   }
 
@@ -569,7 +773,7 @@ void DualDistribution::ToMS()
    for (nat32 i=0;i<instances*labels0*labels1;i++)
    {
     if (math::IsZero(data[i])) data[i] = 0.0;
-                          else data[i] = -math::Ln(data[i]);
+                          else data[i] = -math::KernelLn(data[i]);
    }
    ms = true;
   }
@@ -724,11 +928,22 @@ void EqualPotts::SendAllSP(nat32 instance,const MessageSet & ms)
  SendOneSP(instance,ms,1);
 }
 
+void EqualPotts::SendAllRangeSP(nat32 first,nat32 count,MessageSet ms,nat32 stride)
+{
+ // Qualified calls, so they are not virtual and can be inlined...
+  for (nat32 i=0;i<count;i++)
+  {
+   EqualPotts::SendOneSP(first+i,ms,0);
+   EqualPotts::SendOneSP(first+i,ms,1);
+   ms.Advance(stride);
+  }
+}
+
 void EqualPotts::ToMS()
 {
  for (nat32 i=0;i<instances;i++)
  {
-  inst[i] = math::Ln(inst[i]);
+  inst[i] = math::KernelLn(inst[i]);
  }
 }
 
@@ -760,6 +975,48 @@ void EqualPotts::SendAllMS(nat32 instance,const MessageSet & ms)
  SendOneMS(instance,ms,1);
 }
 
+void EqualPotts::SendAllRangeMS(nat32 first,nat32 count,MessageSet ms,nat32 stride)
+{
+ for (nat32 i=0;i<count;i++)
+ {
+  EqualPotts::SendOneMS(first+i,ms,0);
+  EqualPotts::SendOneMS(first+i,ms,1);
+  ms.Advance(stride);
+ }
+}
+
+bit EqualPotts::SendAllRangeMSHalf(nat32 first,nat32 count,MessageSet ms,nat32 stride,data::Block & temp)
+{
+ if (temp.Size()<labels*sizeof(real32)) temp.SetSize(labels*sizeof(real32));
+ real32 * val = (real32*)temp.Ptr();
+
+ for (nat32 i=0;i<count;i++)
+ {
+  real32 cost = inst[(first+i)%instances];
+  for (nat32 m=0;m<2;m++)
+  {
+   const nat16 * in = ms.InHalf((m+1)%2);
+   nat16 * out = ms.OutHalf(m);
+
+   // As SendOneMS, except the drop is known in advance so it can be done as
+   // the output is written...
+    val[0] = math::FromHalf(in[0]);
+    real32 min = val[0];
+    for (nat32 j=1;j<labels;j++)
+    {
+     val[j] = math::FromHalf(in[j]);
+     min = math::Min(min,val[j]);
+    }
+    real32 cap = min + cost;
+    real32 low = math::Min(min,cap);
+
+    for (nat32 j=0;j<labels;j++) out[j] = math::ToHalf(math::Min(val[j],cap) - low);
+  }
+  ms.Advance(stride);
+ }
+ return true;
+}
+
 cstrconst EqualPotts::TypeString() const
 {
  return "eos::inf::EqualPotts";
@@ -879,7 +1136,7 @@ void EqualGaussian::ToMS()
   for (nat32 i=0;i<instances;i++)
   {
    if (math::Equal(inst[i].corruption,real32(0.0))) inst[i].corruption = 10.0;
-                                               else inst[i].corruption = -math::Ln(inst[i].corruption);
+                                               else inst[i].corruption = -math::KernelLn(inst[i].corruption);
    inst[i].sd = 1.0/(2.0*math::Sqr(inst[i].sd));
   }
 }
@@ -890,71 +1147,11 @@ void EqualGaussian::SendOneMS(nat32 instance,const MessageSet & ms,nat32 mtc)
  Frequency in = ms.GetIn<Frequency>((mtc+1)%2);
  Frequency out = ms.GetOut<Frequency>(mtc);  
 
- // Find the minimum plus the corruption, this being the maximum 
- // cost of any given label...
-  real32 minVal = in[0];
-  for (nat32 i=1;i<labels;i++) minVal = math::Min(minVal,in[i]);
-  minVal += targ.corruption;
-
+ // The lower envelope of the parabolas, capped by the minimum plus the
+ // corruption, this being the maximum cost of any given label...
+  math::DistTransTruncQuad(&in[0],&out[0],labels,targ.sd,targ.corruption);
 
- // Now do two passes, a left to right and a right to left, where 
- // we propagate the lowest parabola at each point...
-  // Left to right...
-   nat32 offset = 0;
-   bit cp = false;
-   for (nat32 i=0;i<labels;i++)
-   {
-    if (cp)
-    {
-     // Find which is the minimum - the in[i] value, the parabola or
-     // minVal, and act accordingly...
-      real32 para = math::Sqr(i-offset)*targ.sd + in[offset];
-      if ((para<in[i])&&(para<minVal)) out[i] = para;     
-      else
-      {
-       if (minVal<in[i])
-       {
-        out[i] = minVal;
-        cp = false;
-       }
-       else
-       {
-        out[i] = in[i];
-        offset = i;
-       }
-      }
-    }
-    else
-    {
-     // We are not considering a previous parabola - just check if the minimum
-     // of the current point is less than the minVal and act accordingly...
-      if (minVal<in[i]) out[i] = minVal;
-      else
-      {
-       out[i] = in[i];
-       offset = i;
-       cp = true;
-      }
-    }
-   }
-  
-  // Right to left... 
-   offset = labels-1;
-   for (int32 i=labels-1;i>=0;i--)
-   {
-    real32 para = math::Sqr(offset-i)*targ.sd + in[offset];
-    if (para<=in[i])
-    {
-     if (para<out[i]) out[i] = para;
-    }
-    else
-    {
-     if (in[i]<out[i]) out[i] = in[i];
-     offset = i;
-    }
-   }
-   
-  out.Drop();
+ out.Drop();
 }
 
 void EqualGaussian::SendAllButOneMS(nat32 instance,const MessageSet & ms,nat32 mti)
@@ -968,6 +1165,42 @@ void EqualGaussian::SendAllMS(nat32 instance,const MessageSet & ms)
  SendOneMS(instance,ms,1);
 }
 
+bit EqualGaussian::SendAllRangeMSHalf(nat32 first,nat32 count,MessageSet ms,nat32 stride,data::Block & temp)
+{
+ if (temp.Size()<2*labels*sizeof(real32)) temp.SetSize(2*labels*sizeof(real32));
+ real32 * val = (real32*)temp.Ptr();
+ real32 * res = val + labels;
+
+ for (nat32 i=0;i<count;i++)
+ {
+  Inst & targ = inst[(first+i)%instances];
+  for (nat32 m=0;m<2;m++)
+  {
+   const nat16 * in = ms.InHalf((m+1)%2);
+   nat16 * out = ms.OutHalf(m);
+
+   // Convert the input, finding the minimum, which is also what the drop
+   // will subtract...
+    val[0] = math::FromHalf(in[0]);
+    real32 minIn = val[0];
+    for (nat32 j=1;j<labels;j++)
+    {
+     val[j] = math::FromHalf(in[j]);
+     minIn = math::Min(minIn,val[j]);
+    }
+    real32 low = math::Min(minIn,minIn + targ.corruption);
+
+   // The same envelope as SendOneMS...
+    math::DistTransTruncQuad(val,res,labels,targ.sd,targ.corruption);
+
+   // Drop and store...
+    for (nat32 j=0;j<labels;j++) out[j] = math::ToHalf(res[j] - low);
+  }
+  ms.Advance(stride);
+ }
+ return true;
+}
+
 cstrconst EqualGaussian::TypeString() const
 {
  return "eos::inf::EqualGaussian";	
@@ -1031,7 +1264,7 @@ void EqualLaplace::ToSP()
   if (inst[i].ms==true)
   {
    inst[i].ms = false;
-   inst[i].corruption = math::Max<real32>(math::Exp(-inst[i].corruption),0.0);
+   inst[i].corruption = math::Max<real32>(math::KernelExp(-inst[i].corruption),0.0);
    inst[i].sd = 1.0/inst[i].sd;
   }
   
@@ -1099,6 +1332,17 @@ void EqualLaplace::SendAllSP(nat32 instance,const MessageSet & ms)
  SendOneSP(instance,ms,1);
 }
 
+void EqualLaplace::SendAllRangeSP(nat32 first,nat32 count,MessageSet ms,nat32 stride)
+{
+ // Qualified calls, so they are not virtual and can be inlined...
+  for (nat32 i=0;i<count;i++)
+  {
+   EqualLaplace::SendOneSP(first+i,ms,0);
+   EqualLaplace::SendOneSP(first+i,ms,1);
+   ms.Advance(stride);
+  }
+}
+
 void EqualLaplace::ToMS()
 {
  // Set the corruption to -ln of the corruption and sd to be 1/sd...
@@ -1108,7 +1352,7 @@ void EqualLaplace::ToMS()
    {
     inst[i].ms = true;
     if (math::Equal(inst[i].corruption,real32(0.0))) inst[i].corruption = 100.0;
-                                                else inst[i].corruption = math::Min<real32>(-math::Ln(inst[i].corruption),100.0);
+                                                else inst[i].corruption = math::Min<real32>(-math::KernelLn(inst[i].corruption),100.0);
     inst[i].sd = 1.0/inst[i].sd;
    }   
   }
@@ -1120,27 +1364,11 @@ void EqualLaplace::SendOneMS(nat32 instance,const MessageSet & ms,nat32 mtc)
  Frequency in = ms.GetIn<Frequency>((mtc+1)%2);
  Frequency out = ms.GetOut<Frequency>(mtc);  
 
- // Find the minimum plus the corruption, this being the maximum 
- // cost of any given label...
-  real32 minVal = in[0];
-  for (nat32 i=1;i<labels;i++) minVal = math::Min(minVal,in[i]);
-  minVal += targ.corruption;
-
+ // A linear distance transform, truncated by the minimum plus the
+ // corruption, this being the maximum cost of any given label...
+  for (nat32 i=0;i<labels;i++) out[i] = in[i];
+  math::DistTransTruncLinear(&out[0],labels,targ.sd,targ.corruption);
 
- // Now do two passes, a left to right and a right to left, where 
- // we propagate the lowest value at each point...
-  // Left to right...
-   out[0] = in[0];
-   for (nat32 i=1;i<labels;i++) out[i] = math::Min(in[i],out[i-1]+targ.sd);
-
-  // Right to left...
-   for (int32 i=labels-2;i>=0;i--) out[i] = math::Min(out[i],out[i+1]+targ.sd);
-   
-  // Truncate...
-   for (nat32 i=0;i<labels;i++) out[i] = math::Min(out[i],minVal);
-   
- //LogDebug("[lap] msg " << mtc << LogDiv() << in << LogDiv() << out);
-   
  out.Drop(); 
 }
 
@@ -1153,6 +1381,52 @@ void EqualLaplace::SendAllMS(nat32 instance,const MessageSet & ms)
 {
  SendOneMS(instance,ms,0);
  SendOneMS(instance,ms,1);
+}
+
+void EqualLaplace::SendAllRangeMS(nat32 first,nat32 count,MessageSet ms,nat32 stride)
+{
+ for (nat32 i=0;i<count;i++)
+ {
+  EqualLaplace::SendOneMS(first+i,ms,0);
+  EqualLaplace::SendOneMS(first+i,ms,1);
+  ms.Advance(stride);
+ }
+}
+
+bit EqualLaplace::SendAllRangeMSHalf(nat32 first,nat32 count,MessageSet ms,nat32 stride,data::Block & temp)
+{
+ if (temp.Size()<labels*sizeof(real32)) temp.SetSize(labels*sizeof(real32));
+ real32 * val = (real32*)temp.Ptr();
+
+ for (nat32 i=0;i<count;i++)
+ {
+  Inst & targ = inst[(first+i)%instances];
+  for (nat32 m=0;m<2;m++)
+  {
+   const nat16 * in = ms.InHalf((m+1)%2);
+   nat16 * out = ms.OutHalf(m);
+
+   // Convert the input, finding the minimum, which is also what the drop
+   // will subtract...
+    val[0] = math::FromHalf(in[0]);
+    real32 minVal = val[0];
+    for (nat32 j=1;j<labels;j++)
+    {
+     val[j] = math::FromHalf(in[j]);
+     minVal = math::Min(minVal,val[j]);
+    }
+    real32 cap = minVal + targ.corruption;
+    real32 low = math::Min(minVal,cap);
+
+   // The same transform as SendOneMS, in place...
+    math::DistTransLinear(val,labels,targ.sd);
+
+   // Truncate, drop and store...
+    for (nat32 j=0;j<labels;j++) out[j] = math::ToHalf(math::Min(val[j],cap) - low);
+  }
+  ms.Advance(stride);
+ }
+ return true;
 }
 
 cstrconst EqualLaplace::TypeString() const
@@ -1207,7 +1481,7 @@ void EqualVonMises::SendOneSP(nat32 instance,const MessageSet & ms,nat32 mtc)
    out[io] = 0.0;
    for (int32 ii=0;ii<int32(labels);ii++)
    {
-    real32 pr = math::Max(p.minProb,math::Exp(p.k*math::Cos(diffMult*real32(io-ii))));
+    real32 pr = math::Max(p.minProb,math::KernelExp(p.k*math::Cos(diffMult*real32(io-ii))));
     out[io] += in[ii] * pr;
    }
   }
@@ -1818,6 +2092,75 @@ void GeneralPotts::SendAllMS(nat32 instance,const MessageSet & ms)
   for (nat32 i=0;i<links;i++) n[i].out.Drop();  
 }
 
+bit GeneralPotts::SendAllRangeMSHalf(nat32 first,nat32 count,MessageSet ms,nat32 stride,data::Block & temp)
+{
+ nat32 total = 0;
+ for (nat32 i=0;i<links;i++) total += labels[i];
+ if (temp.Size()<total*sizeof(real32)) temp.SetSize(total*sizeof(real32));
+
+ for (nat32 ii=0;ii<count;ii++)
+ {
+  nat32 instance = (first+ii)%instances;
+
+  // Convert the inputs, getting the minimum of each and summing them with
+  // the base cost...
+   real32 baseSum = cost[instance];
+   real32 * val = (real32*)temp.Ptr();
+   for (nat32 i=0;i<links;i++)
+   {
+    const nat16 * in = ms.InHalf(i);
+    n[i].inVal = val;
+    n[i].outHalf = ms.OutHalf(i);
+
+    val[0] = math::FromHalf(in[0]);
+    n[i].min = val[0];
+    for (nat32 j=1;j<labels[i];j++)
+    {
+     val[j] = math::FromHalf(in[j]);
+     n[i].min = math::Min(n[i].min,val[j]);
+    }
+    baseSum += n[i].min;
+    val += labels[i];
+   }
+   for (nat32 i=0;i<links;i++) n[i].low = baseSum - n[i].min;
+
+  // Unlike SendAllMS we need to know what the drop will subtract before
+  // writing anything, so the exceptions are done twice - first to find the
+  // minimum of each output...
+   nat32 end = excInd[instance].start + excInd[instance].size;
+   for (nat32 i=excInd[instance].start;i<end;i++)
+   {
+    real32 v = exc[i].cost;
+    for (nat32 j=0;j<links;j++) v += n[j].inVal[exc[i].Label(j)];
+    for (nat32 j=0;j<links;j++) n[j].low = math::Min(n[j].low,v - n[j].inVal[exc[i].Label(j)]);
+   }
+
+  // Set all outputs to there relevant maximums...
+   for (nat32 i=0;i<links;i++)
+   {
+    nat16 top = math::ToHalf(baseSum - n[i].min - n[i].low);
+    for (nat32 j=0;j<labels[i];j++) n[i].outHalf[j] = top;
+   }
+
+  // Then factor the exceptions in - as rounding preserves order the
+  // comparisons can be done with the stored values...
+   for (nat32 i=excInd[instance].start;i<end;i++)
+   {
+    real32 v = exc[i].cost;
+    for (nat32 j=0;j<links;j++) v += n[j].inVal[exc[i].Label(j)];
+    for (nat32 j=0;j<links;j++)
+    {
+     nat32 lab = exc[i].Label(j);
+     nat16 h = math::ToHalf(v - n[j].inVal[lab] - n[j].low);
+     if (math::FromHalf(h)<math::FromHalf(n[j].outHalf[lab])) n[j].outHalf[lab] = h;
+    }
+   }
+
+  ms.Advance(stride);
+ }
+ return true;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -28,6 +28,7 @@
 #include "eos/math/vectors.h"
 #include "eos/time/progress.h"
 #include "eos/data/buffers.h"
+#include "eos/data/blocks.h"
 #include "eos/ds/arrays.h"
 
 namespace eos
@@ -65,6 +66,10 @@ class EOS_CLASS MessageSet
   // of messages that need doing.
    void SetBase(void * base) {data = (byte*)base;}
 
+  // Also internal only, moves the baseline on by the given number of bytes,
+  // for stepping through consecutive instances.
+   void Advance(nat32 bytes) {data += bytes;}
+
 
   /// Returns an interface to a particular incomming message, given
   /// an index of its position. No type checking is done here, it 
@@ -80,6 +85,14 @@ class EOS_CLASS MessageSet
    template <typename T>
    T GetOut(nat32 ind) const {return T(mc[ind],data + out[ind]);}
 
+  /// For a compact FunctionSet, where the messages are stored as halfs
+  /// (math::ToHalf), returns a particular incomming message. Only valid
+  /// within SendAllRangeMSHalf.
+   const nat16 * InHalf(nat32 ind) const {return (const nat16*)(data + (in[ind]>>1));}
+
+  /// The outgoing equivalent of InHalf.
+   nat16 * OutHalf(nat32 ind) const {return (nat16*)(data + (out[ind]>>1));}
+
 
   /// &nbsp;
    static cstrconst TypeString() {return "eos::inf::MessageSet";}
@@ -154,6 +167,15 @@ class EOS_CLASS Function : public Deletable
   /// Sum-product varient.
    virtual void SendAllSP(nat32 instance,const MessageSet & ms) = 0;
 
+  /// This does SendAllSP for the count instances starting at first, where
+  /// the message set starts at first and each following instance is stride
+  /// bytes on. The default simply calls SendAllSP for each, implimentations
+  /// can override it to avoid the virtual call per instance and hoist
+  /// lookups out of the loop. Must be safe to call from multiple threads at
+  /// once for different ranges, which it will be if SendAllSP does not
+  /// change the object.
+   virtual void SendAllRangeSP(nat32 first,nat32 count,MessageSet ms,nat32 stride);
+
 
   /// This is called after all editting, if MS is going to be used rather than SP.
   /// If called the method can presume that no SP methods will be called
@@ -183,6 +205,20 @@ class EOS_CLASS Function : public Deletable
   /// Min-sum varient.
    virtual void SendAllMS(nat32 instance,const MessageSet & ms) = 0;
 
+  /// The min-sum equivalent of SendAllRangeSP.
+   virtual void SendAllRangeMS(nat32 first,nat32 count,MessageSet ms,nat32 stride);
+
+  /// An optional version of SendAllRangeMS for compact FunctionSet-s, that
+  /// works directly with the messages as stored, as halfs, via the InHalf
+  /// and OutHalf methods of the MessageSet - stride is then the gap between
+  /// the compact instances. Avoids converting every instance into a real32
+  /// buffer and back, which is most of the cost otherwise - each input value
+  /// should be converted once and each output value once. temp can be used
+  /// for scratch space, resizing it as needed. Should return false if not
+  /// implimented, the default, in which case the conversion happens and
+  /// SendAllRangeMS is called instead.
+   virtual bit SendAllRangeMSHalf(nat32 first,nat32 count,MessageSet ms,nat32 stride,data::Block & temp);
+
 
   /// &nbsp; 
    virtual cstrconst TypeString() const = 0;
@@ -196,6 +232,12 @@ class EOS_CLASS Function : public Deletable
 // contains one function, used for all instances, so the FactorGraph object will
 // ushally contain one of these for each function with each one containning all
 // instances of that function required.
+// In compact mode the messages are stored as halfs (math::ToHalf), as all
+// messages are arrays of real32's, with each instance unpacked into a real32
+// buffer before its function is called and the output messages packed back
+// afterwards, unless the function provides SendAllRangeMSHalf, in which case
+// it works with the halfs directly. Halves the memory at some cost in speed
+// and precision.
 class EOS_CLASS FunctionSet
 {
  public:
@@ -205,7 +247,7 @@ class EOS_CLASS FunctionSet
   // it will be deleted when this object is deleted.
   // Note that this constructor will do one hell of a malloc, and can fail as
   // a result, the active method is provided to check for this.
-   FunctionSet(Function * func,nat32 instances = 1);
+   FunctionSet(Function * func,nat32 instances = 1,bit compact = false);
    
   // &nbsp;
    ~FunctionSet();
@@ -221,6 +263,12 @@ class EOS_CLASS FunctionSet
   // Returns the number of instances.
    nat32 Instances() const {return instances;}
 
+  // Returns how many links each instance has.
+   nat32 Links() const {return links;}
+
+  // Returns true if the messages are stored as halfs.
+   bit Compact() const {return compact;}
+
   // This sets all messages to equal probability, must be called before actual message
   // passing comences.
    void Flatline();
@@ -235,80 +283,103 @@ class EOS_CLASS FunctionSet
   // Returns a pointer to the block of data associated with a particular 
   // message for a particular instance, the message being in for the 
   // function, out for the random variable to which its connected.
-   void * ToFunc(nat32 instance,nat32 link) const {return data + instance*stride + in[link];}
+  // In compact mode this points to an array of halfs.
+   void * ToFunc(nat32 instance,nat32 link) const {return At(instance) + Off(in[link]);}
 
   // Returns a pointer to the block of data associated with a particular 
   // message for a particular instance, the message being out for the 
   // function, in for the random variable to which its connected.
-   void * FromFunc(nat32 instance,nat32 link) const {return data + instance*stride + out[link];}
+  // In compact mode this points to an array of halfs.
+   void * FromFunc(nat32 instance,nat32 link) const {return At(instance) + Off(out[link]);}
+
+  // Given a pointer as returned by ToFunc or FromFunc returns true and the
+  // instance it belongs to, or false if it does not point into this set.
+   bit Find(const void * ptr,nat32 & instance) const
+   {
+    const byte * p = (const byte*)ptr;
+    if ((p<data)||(p>=At(instances))) return false;
+    instance = nat32(nat64(p-data)/nat64(Off(stride)));
+    return true;
+   }
 
 
   // This does a SendOne call with a given instance for the given link index.
    void SendOneSP(nat32 instance,nat32 link)
    {
-    MessageSet ms(mc,data + instance*stride,in,out);
+    MessageSet ms(mc,Unpack(instance),in,out);
     func->SendOneSP(instance,ms,link);
+    Pack(instance);
    }
   
   // This does a SendButOne call with a given instance ignoring a given link index.
    void SendAllButOneSP(nat32 instance,nat32 link)
    {
-    MessageSet ms(mc,data + instance*stride,in,out);
+    MessageSet ms(mc,Unpack(instance),in,out);
     func->SendAllButOneSP(instance,ms,link);
+    Pack(instance);
    }
   
   // This does a SendAll call on every instance contained within, loopy belief 
   // propagation will spend the vast majority of its time within this function.
-   void SendAllSP(time::Progress * prog)
-   {
-    prog->Push();
-     MessageSet ms(mc,data,in,out);
-     byte * targ = data;
-     for (nat32 i=0;i<instances;i++)
-     {
-      prog->Report(i,instances);
-      ms.SetBase(targ);
-      func->SendAllSP(i,ms);
-      targ += stride;
-     }
-    prog->Pop();
-   }
+  // If measure is true it returns the largest change to any output message
+  // value, otherwise 0.
+   real32 SendAllSP(time::Progress * prog,bit measure = false);
+
+  // Does a SendAll call on the instances [first,first+count), batched into
+  // calls of the functions SendAllRangeSP. temp is used to unpack compact
+  // instances into and is resized as needed. Different ranges can be done
+  // by different threads at once, as long as each has its own temp.
+  // measure is as for SendAllSP, and costs a copy when not compact.
+   real32 SendRangeSP(nat32 first,nat32 count,data::Block & temp,bit measure = false);
+
+  // Calculates what SendAll would do to an instance without changing
+  // anything, returning the largest change it would make to any output
+  // message value. The residual used by residual scheduling.
+   real32 ResidualSP(nat32 instance,data::Block & temp);
    
    
   // This does a SendOne call with a given instance for the given link index.
    void SendOneMS(nat32 instance,nat32 link)
    {
-    MessageSet ms(mc,data + instance*stride,in,out);
+    MessageSet ms(mc,Unpack(instance),in,out);
     func->SendOneMS(instance,ms,link);
+    Pack(instance);
    }
   
   // This does a SendButOne call with a given instance ignoring a given link index.
    void SendAllButOneMS(nat32 instance,nat32 link)
    {
-    MessageSet ms(mc,data + instance*stride,in,out);
+    MessageSet ms(mc,Unpack(instance),in,out);
     func->SendAllButOneMS(instance,ms,link);
+    Pack(instance);
    }
   
   // This does a SendAll call on every instance contained within, loopy belief 
   // propagation will spend the vast majority of its time within this function.
-   void SendAllMS(time::Progress * prog)
-   {
-    prog->Push();
-     MessageSet ms(mc,data,in,out);
-     byte * targ = data;
-     for (nat32 i=0;i<instances;i++)
-     {
-      prog->Report(i,instances);
-      ms.SetBase(targ);
-      func->SendAllMS(i,ms);
-      targ += stride;
-     }
-    prog->Pop();
-   }   
+  // measure is as for SendAllSP.
+   real32 SendAllMS(time::Progress * prog,bit measure = false);
+
+  // As SendRangeSP, for min-sum.
+   real32 SendRangeMS(nat32 first,nat32 count,data::Block & temp,bit measure = false);
+
+  // As ResidualSP, for min-sum.
+   real32 ResidualMS(nat32 instance,data::Block & temp);
    
    
   // Returns the memory consumption of the class in bytes.
-   nat32 Memory() const {return stride*instances + (sizeof(MessageClass)+sizeof(nat32)*2)*links + sizeof(*this);}
+   nat64 Memory() const {return MessageMemory() + StructureMemory(links);}
+
+  // Returns how many of the bytes are for the messages, the rest being the
+  // fixed cost of StructureMemory.
+   nat64 MessageMemory() const {return nat64(Off(stride))*nat64(instances) + (compact?stride:0);}
+
+  // Returns how many bytes the messages of a set would take, without making
+  // it, so a graph can be sized up before the big malloc.
+   static nat64 MessageMemory(const Function & func,nat32 instances,bit compact);
+
+  // Returns the bytes used by a set other than its messages, for a given
+  // link count.
+   static nat64 StructureMemory(nat32 links) {return (sizeof(MessageClass)+sizeof(nat32)*2)*links + sizeof(FunctionSet);}
 
 
   // &nbsp;
@@ -323,10 +394,57 @@ class EOS_CLASS FunctionSet
   MessageClass * mc;
 
   byte * data;
-  nat32 stride; // Gap in bytes between instances in the above buffer.
+  nat32 stride; // Gap in bytes between instances in the above buffer, when not compact.
 
   nat32 * in;
   nat32 * out;
+
+  bit compact;
+  byte * temp; // Buffer of stride bytes a compact instance is unpacked into.
+
+  static const nat32 batch = 256; // Most instances unpacked at once by the range methods.
+
+  // Converts a byte offset into a real32 instance to one into a compact
+  // instance, and gets the start of an instance...
+   nat32 Off(nat32 offset) const {return compact ? (offset>>1) : offset;}
+   byte * At(nat32 instance) const {return data + nat64(instance)*nat64(Off(stride));}
+
+  // Returns a pointer to the real32 version of an instance, which for a compact
+  // set means converting it into temp, and writes the output messages back
+  // afterwards. Pack does nothing if not compact...
+   byte * Unpack(nat32 instance)
+   {
+    if (!compact) return At(instance);
+    const nat16 * src = (const nat16*)At(instance);
+    real32 * dst = (real32*)temp;
+    for (nat32 i=0;i<stride/sizeof(real32);i++) dst[i] = math::FromHalf(src[i]);
+    return temp;
+   }
+
+   void Pack(nat32 instance)
+   {
+    if (!compact) return;
+    nat32 half = stride/(2*sizeof(real32)); // Only the outgoing messages, which are the second half.
+    nat16 * dst = (nat16*)At(instance) + half;
+    const real32 * src = (const real32*)temp + half;
+    for (nat32 i=0;i<half;i++) dst[i] = math::ToHalf(src[i]);
+   }
+
+  // Sets every instance of a compact set to the contents of temp...
+   void FillCompact();
+
+  // The range versions of Unpack and Pack, for count consecutive instances
+  // going to/from a buffer of count*stride bytes. Unlike Unpack and Pack they
+  // also work when not compact, by copying. Change returns the largest
+  // difference between the output messages in the buffer and those stored...
+   void UnpackRange(nat32 first,nat32 count,byte * buf) const;
+   void PackRange(nat32 first,nat32 count,const byte * buf);
+   real32 Change(nat32 first,nat32 count,const byte * buf) const;
+
+  // The implimentation of the SendRange and Residual methods - runs the range
+  // through temp unless it can be done in place, optionally measuring the
+  // change and optionally writing the result back...
+   real32 Batch(nat32 first,nat32 count,data::Block & temp,bit ms,bit measure,bit commit);
 };
 
 //------------------------------------------------------------------------------
@@ -629,6 +747,9 @@ class EOS_CLASS EqualPotts : public Function
   /// &nbsp;
    void SendAllSP(nat32 instance,const MessageSet & ms);
 
+  /// &nbsp;
+   void SendAllRangeSP(nat32 first,nat32 count,MessageSet ms,nat32 stride);
+
 
   /// &nbsp;
    void ToMS();
@@ -642,6 +763,12 @@ class EOS_CLASS EqualPotts : public Function
   /// &nbsp;
    void SendAllMS(nat32 instance,const MessageSet & ms);
 
+  /// &nbsp;
+   void SendAllRangeMS(nat32 first,nat32 count,MessageSet ms,nat32 stride);
+
+  /// &nbsp;
+   bit SendAllRangeMSHalf(nat32 first,nat32 count,MessageSet ms,nat32 stride,data::Block & temp);
+
 
   /// &nbsp; 
    cstrconst TypeString() const;
@@ -718,6 +845,9 @@ class EOS_CLASS EqualGaussian : public Function
   /// &nbsp;
    void SendAllMS(nat32 instance,const MessageSet & ms);
 
+  /// &nbsp;
+   bit SendAllRangeMSHalf(nat32 first,nat32 count,MessageSet ms,nat32 stride,data::Block & temp);
+
 
   /// &nbsp; 
    cstrconst TypeString() const;
@@ -798,6 +928,9 @@ class EOS_CLASS EqualLaplace : public Function
   /// &nbsp;
    void SendAllSP(nat32 instance,const MessageSet & ms);
 
+  /// &nbsp;
+   void SendAllRangeSP(nat32 first,nat32 count,MessageSet ms,nat32 stride);
+
 
   /// &nbsp;
    void ToMS();
@@ -811,6 +944,12 @@ class EOS_CLASS EqualLaplace : public Function
   /// &nbsp;
    void SendAllMS(nat32 instance,const MessageSet & ms);
 
+  /// &nbsp;
+   void SendAllRangeMS(nat32 first,nat32 count,MessageSet ms,nat32 stride);
+
+  /// &nbsp;
+   bit SendAllRangeMSHalf(nat32 first,nat32 count,MessageSet ms,nat32 stride,data::Block & temp);
+
 
   /// &nbsp; 
    cstrconst TypeString() const;
@@ -1037,6 +1176,9 @@ class EOS_CLASS GeneralPotts : public Function
   /// &nbsp;
    void SendAllMS(nat32 instance,const MessageSet & ms);
 
+  /// &nbsp;
+   bit SendAllRangeMSHalf(nat32 first,nat32 count,MessageSet ms,nat32 stride,data::Block & temp);
+
 
   /// &nbsp; 
    cstrconst TypeString() const {return "eos::inf::GeneralPotts";}
@@ -1059,7 +1201,7 @@ class EOS_CLASS GeneralPotts : public Function
    struct Exc
    {
     nat32 instance;
-    nat32 cost;
+    real32 cost;
 
     nat32 & Label(nat32 i) {return ((nat32*)(void*)(this+1))[i];}
     const nat32 & Label(nat32 i) const {return ((nat32*)(void*)(this+1))[i];}
@@ -1096,6 +1238,11 @@ class EOS_CLASS GeneralPotts : public Function
     Frequency in;
     Frequency out;
     real32 min; // Minimum value of freq.
+
+    // For SendAllRangeMSHalf...
+     const real32 * inVal;
+     nat16 * outHalf;
+     real32 low; // Minimum value of the output.
    };
    Node * n;
 };
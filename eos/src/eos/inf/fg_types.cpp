@@ -27,6 +27,7 @@ namespace eos
 //------------------------------------------------------------------------------
 void Frequency::MakeClass(nat32 labels,MessageClass & out)
 {
+ mem::Null(&out); // MessageClass-s are compared bytewise, so the padding must match.
  out.scale = labels;
  out.Size = &Frequency::Size;
  out.Flatline = &Frequency::Flatline;
@@ -98,12 +99,8 @@ void Frequency::FromNegLn(const MessageClass & mc,void * obj)
 
  real32 min = 0.0;
  for (nat32 i=0;i<mc.scale;i++) min = math::Min(min,targ[i]);
- if (min<0.0)
- {
-  for (nat32 i=0;i<mc.scale;i++) targ[i] -= min;
- }
-
- for (nat32 i=0;i<mc.scale;i++) targ[i] = math::Exp(-targ[i]);
+ for (nat32 i=0;i<mc.scale;i++) targ[i] = min - targ[i];
+ math::KernelExp(targ,targ,mc.scale);
  Norm(mc,obj);
 }
 
@@ -91,6 +91,12 @@ nat32 Variable::Links(void * pv)
  return var->size;
 }
 
+void * Variable::LinkIn(void * pv,nat32 link)
+{
+ Packed * var = (Packed*)pv;
+ return var->link[link].in;
+}
+
 const MessageClass & Variable::Class(void * pv)
 {
  Packed * var = (Packed*)pv;
@@ -465,6 +471,62 @@ void Variable::CalcOutputMS(void * pv,void * msgOut)
   var->mc.Drop(var->mc,msgOut);
 }
 
+void Variable::SendAllMSCompact(void * pv,data::Block & temp)
+{
+ Packed * var = (Packed*)pv;
+ nat32 bytes = var->mc.Size(var->mc);
+ nat32 count = bytes/sizeof(real32);
+
+ // Convert the incomming messages, leaving space for their sum after...
+  nat32 dataNeeded = (var->size+1)*bytes;
+  if (temp.Size()<dataNeeded) temp.SetSize(dataNeeded);
+  real32 * in = (real32*)temp.Ptr();
+  real32 * sum = in + var->size*count;
+
+  var->mc.FlatlineLn(var->mc,sum);
+  for (nat32 i=0;i<var->size;i++)
+  {
+   const nat16 * src = (const nat16*)var->link[i].in;
+   real32 * dst = in + i*count;
+   for (nat32 j=0;j<count;j++)
+   {
+    dst[j] = math::FromHalf(src[j]);
+    sum[j] += dst[j];
+   }
+  }
+
+ // Each output is then the sum without its own input, dropped and stored...
+  for (nat32 i=0;i<var->size;i++)
+  {
+   const real32 * src = in + i*count;
+   nat16 * dst = (nat16*)var->link[i].out;
+
+   real32 min = sum[0] - src[0];
+   for (nat32 j=1;j<count;j++) min = math::Min(min,sum[j] - src[j]);
+   for (nat32 j=0;j<count;j++) dst[j] = math::ToHalf(sum[j] - src[j] - min);
+  }
+}
+
+void Variable::CalcOutputMSCompact(void * pv,void * msgOut,data::Block & temp)
+{
+ Packed * var = (Packed*)pv;
+ nat32 bytes = var->mc.Size(var->mc);
+ nat32 count = bytes/sizeof(real32);
+
+ if (temp.Size()<bytes) temp.SetSize(bytes);
+ real32 * msg = (real32*)temp.Ptr();
+
+ var->mc.FlatlineLn(var->mc,msgOut);
+ for (nat32 i=0;i<var->size;i++)
+ {
+  const nat16 * src = (const nat16*)var->link[i].in;
+  for (nat32 j=0;j<count;j++) msg[j] = math::FromHalf(src[j]);
+  var->mc.InplaceAdd(var->mc,msgOut,msg);
+ }
+
+ var->mc.Drop(var->mc,msgOut);
+}
+
 //------------------------------------------------------------------------------
  };
 };
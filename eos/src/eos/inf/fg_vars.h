@@ -94,6 +94,10 @@ class EOS_CLASS Variable
   // Extracts and returns the number of links that a packed representation 
   // of a variable contains.
    static nat32 Links(void * pv);
+
+  // Returns the incomming message pointer for a link of a packed variable,
+  // i.e. the FunctionSet::FromFunc pointer of the function its linked to.
+   static void * LinkIn(void * pv,nat32 link);
    
   // Returns a const reference to the MessageClass of a packed variable.
    static const MessageClass & Class(void * pv);
@@ -149,6 +153,18 @@ class EOS_CLASS Variable
    static void CalcOutputMS(void * pv,void * msgOut);
 
 
+  // As SendAllMS, for when the messages are stored as halfs, i.e. the
+  // FunctionSet-s are compact. Uses the tempory block to convert the
+  // incomming messages into, the outgoing are written straight out. Unlike
+  // SendAllMS the outgoing messages are dropped, so they stay close to zero
+  // where halfs are most accurate.
+   static void SendAllMSCompact(void * pv,data::Block & temp);
+
+  // As CalcOutputMS, for when the messages are stored as halfs. msgOut is
+  // real32's as ushall.
+   static void CalcOutputMSCompact(void * pv,void * msgOut,data::Block & temp);
+
+
   /// &nbsp;
    static cstrconst TypeString() {return "eos::inf::Variable";}
 
@@ -26,7 +26,9 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 FieldGraph::FieldGraph(bit ms)
-:doMS(ms),maximumLevel(0xFFFFFFFF),iters(6),extraHigh(0),extraLow(0),countFP(0),countVP(0)
+:doMS(ms),compact(false),useGrid(true),maximumLevel(0xFFFFFFFF),peak(0),budget(0),compactLevels(0),
+iters(6),extraHigh(0),extraLow(0),
+tolerance(0.0),residual(false),itersDone(0),countFP(0),countVP(0),inferred(false),topLevel(0)
 {}
 
 FieldGraph::~FieldGraph()
@@ -52,6 +54,27 @@ void FieldGraph::SetMaxLevel(nat32 maxLevel)
  maximumLevel = maxLevel;
 }
 
+void FieldGraph::SetCompact(bit enable)
+{
+ compact = enable;
+}
+
+void FieldGraph::SetBudget(nat64 bytes)
+{
+ budget = bytes;
+}
+
+void FieldGraph::SetTolerance(real32 tol,bit res)
+{
+ tolerance = tol;
+ residual = res;
+}
+
+void FieldGraph::SetGrid(bit enable)
+{
+ useGrid = enable;
+}
+
 nat32 FieldGraph::NewFP(FactorPattern * gfp)
 {
  if (fp.Size()==countFP) fp.Size(fp.Size()+4);
@@ -84,154 +107,215 @@ bit FieldGraph::Run(time::Progress * prog)
 
   // First we have to infer and verify the typing, i.e. calculate all the 
   // details of the graph and check it all matches...
-  // (Work out the maximum level as well.)
    prog->Report(0,2);
-    // Compress fp for conveniance...
-     fp.Size(countFP);
-   
-    // Create the shell of the res array...
-     res.Size(countVP);
-     for (nat32 i=0;i<res.Size();i++)
-     {
-      res[i].vp = null<VariablePattern*>();
-      res[i].res = null<real32*>();
-     }
-
-
-    // Loop whilst change happens...
-     LogDebug("[inf.field] Start type propagation");
-     bit doMore;
-     do
-     {
-      doMore = false;
-      // Iterate the wol array, trying to find new inferences of type,
-      // passing them on as possible - this involves passing into the 
-      // res array as well as out of the res array...
-      // (Stop when no changes are made.)
-       ds::List<WorkOrder>::Cursor targ = wol.FrontPtr();       
-       while (!targ.Bad())
-       {        
-        if (res[targ->vp].vp)
-        {
-         // Variable allready set - passing from variable to factors...        
-          nat32 set;
-          if (SetVarPat(*fp[targ->fp],targ->pipe,*res[targ->vp].vp,set)==false)
-          {
-           // We have not been given a consistant graph - exit with an error...
-            LogAlways("[inf.field] Failed due to error when setting pipe {factor pattern,pipe,variable}"
-                      << LogDiv() << targ->fp << LogDiv() << targ->pipe << LogDiv() << targ->vp);
-            prog->Pop();
-            return false;
-          }
-          doMore |= set!=0;
-        }
-        else
-        {
-         // Variable not set, check if we can set it from the factor...
-          if (fp[targ->fp]->PipeIsSet(targ->pipe))
-          {
-           res[targ->vp].vp = fp[targ->fp]->PipeGet(targ->pipe).Clone();
-           doMore |= true;
-          }
-        }
-
-        ++targ;       
-       }
-     } while (doMore);
-     LogDebug("[inf.field] End type propagation");
-
-
-    // Check that all variables and all factors have been set,
-    // its an error if they have not...
-    // (So some logging whilst we are at it.)
-     // Check variables...
-      for (nat32 i=0;i<res.Size();i++)
-      {
-       if (res[i].vp==null<VariablePattern*>())
-       {
-        LogAlways("[inf.field] Failed due to unset variable {variable pattern}" << LogDiv() << i);
-        prog->Pop();
-        return false;
-       }
-       else
-       {
-        LogDebug("[inf.field] Variable " << i << " {variable type,paras}" <<
-                 LogDiv() << typestring(*res[i].vp) << LogDiv() << res[i].vp->Paras());
-       }
-      }
-     
-     // Check factors...
-      for (nat32 i=0;i<fp.Size();i++)
-      {
-       for (nat32 j=0;j<fp[i]->PipeCount();j++)
-       {
-        if (!fp[i]->PipeIsSet(j))
-        {
-         LogAlways("[inf.field] Failed due to unset pipe {factor pattern,pipe}" << LogDiv() << i << LogDiv() << j);
-         prog->Pop();
-         return false;
-        }
-        else
-        {
-         LogDebug("[inf.field] Factor " << i << ", Pipe " << j << " {factor type,variable type,paras}" <<
-                  LogDiv() << typestring(*fp[i]) <<
-                  LogDiv() << typestring(fp[i]->PipeGet(j)) <<
-                  LogDiv() << fp[i]->PipeGet(j).Paras());
-        }
-       }
-      }
-      LogDebug("[inf.field] Validated propagation");
-
-
-    // Finish off the res structure, so its not a concern latter, also find
-    // the maximum level worth doing...
-     nat32 maxLevel = 0;
-     for (nat32 i=0;i<res.Size();i++)
-     {
-      // maxLevel...
-       maxLevel = math::Max(maxLevel,res[i].vp->MaxLevel());
-
-      // mc...
-       Frequency::MakeClass(res[i].vp->Labels(),res[i].mc);
-      
-      // res...
-       res[i].res = mem::Malloc<real32>(res[i].vp->Labels() * res[i].vp->Vars(0));
-     }
-     maxLevel = math::Min(maxLevel,maximumLevel);
-
+   if (!Infer())
+   {
+    prog->Pop();
+    return false;
+   }
+   nat32 maxLevel = topLevel;
 
 
   // Now we have to iterate over each level, creating the factor graph,
   // transfering from the previous as relevant, and solving...
    prog->Report(1,2);
    prog->Push();
+    peak = 0;
+    compactLevels = 0;
+    itersDone = 0;
     nat32 level = maxLevel+1;
     LevelData * prev = null<LevelData*>();
-    LevelData * curr = null<LevelData*>();
     do
     {
      --level;
      prog->Report(maxLevel-level,maxLevel+1);
    
-      // Move along one, creating the next FactorGraph...
-      delete prev;
+      // Move along one, creating the next FactorGraph, with DoLevel getting
+      // rid of the previous...
+      LevelData * curr = new LevelData(doMS,compact);
+      DoLevel(level,prev,*curr,prog);
       prev = curr;
-      curr = new LevelData(doMS);
-
-      // Do the work...
-       DoLevel(level,prev,*curr,prog);
         
     } while (level!=0);
 
     delete prev;
-    delete curr;
    prog->Pop();
 
+   LogDebug("[inf.field] {levels,compact,compact levels,peak bytes}" << LogDiv() << (maxLevel+1) << LogDiv() << compact << LogDiv() << compactLevels << LogDiv() << peak);
+
  prog->Pop();
  return true;
 }
 
+bit FieldGraph::Estimate(MemoryReport & out)
+{
+ LogBlock("bit FieldGraph::Estimate(...)","-");
+ if (!Infer()) return false;
+
+ // Go through the levels as Run would, making the functions of each but not
+ // the graphs, to cost them up with the previous level held...
+  out.Zero();
+  MemoryReport held;
+  held.Zero();
+
+  nat32 level = topLevel+1;
+  do
+  {
+   --level;
+   LevelData curr(doMS,compact);
+   Build(level,curr);
+
+   MemoryReport need;
+   Cost(level,curr,compact,need);
+   if ((budget!=0)&&doMS&&(!compact))
+   {
+    MemoryReport total = need;
+    total += held;
+    if (total.Total()>budget) Cost(level,curr,true,need);
+   }
+
+   for (nat32 i=0;i<curr.funcs.Size();i++) delete curr.funcs[i].func;
+   curr.funcs.Size(0);
+
+   MemoryReport total = need;
+   total += held;
+   if (total.Total()>out.Total()) out = total;
+
+   held = need;
+   held.output = 0;
+  } while (level!=0);
+
+ return true;
+}
+
 //------------------------------------------------------------------------------
+bit FieldGraph::Infer()
+{
+ LogBlock("bit FieldGraph::Infer()","-");
+ if (inferred) return true;
+
+ // Infer and verify the typing, i.e. calculate all the details of the graph
+ // and check it all matches... (Work out the maximum level as well.)
+  // Compress fp for conveniance...
+   fp.Size(countFP);
+ 
+  // Create the shell of the res array, tidying up after a previous attempt if
+  // it failed...
+   for (nat32 i=0;i<res.Size();i++)
+   {
+    delete res[i].vp;
+    mem::Free(res[i].res);
+   }
+   res.Size(countVP);
+   for (nat32 i=0;i<res.Size();i++)
+   {
+    res[i].vp = null<VariablePattern*>();
+    res[i].res = null<real32*>();
+   }
+
+
+  // Loop whilst change happens...
+   LogDebug("[inf.field] Start type propagation");
+   bit doMore;
+   do
+   {
+    doMore = false;
+    // Iterate the wol array, trying to find new inferences of type,
+    // passing them on as possible - this involves passing into the 
+    // res array as well as out of the res array...
+    // (Stop when no changes are made.)
+     ds::List<WorkOrder>::Cursor targ = wol.FrontPtr();       
+     while (!targ.Bad())
+     {        
+      if (res[targ->vp].vp)
+      {
+       // Variable allready set - passing from variable to factors...        
+        nat32 set;
+        if (SetVarPat(*fp[targ->fp],targ->pipe,*res[targ->vp].vp,set)==false)
+        {
+         // We have not been given a consistant graph - exit with an error...
+          LogAlways("[inf.field] Failed due to error when setting pipe {factor pattern,pipe,variable}"
+                    << LogDiv() << targ->fp << LogDiv() << targ->pipe << LogDiv() << targ->vp);
+          return false;
+        }
+        doMore |= set!=0;
+      }
+      else
+      {
+       // Variable not set, check if we can set it from the factor...
+        if (fp[targ->fp]->PipeIsSet(targ->pipe))
+        {
+         res[targ->vp].vp = fp[targ->fp]->PipeGet(targ->pipe).Clone();
+         doMore |= true;
+        }
+      }
+
+      ++targ;       
+     }
+   } while (doMore);
+   LogDebug("[inf.field] End type propagation");
+
+
+  // Check that all variables and all factors have been set,
+  // its an error if they have not...
+  // (So some logging whilst we are at it.)
+   // Check variables...
+    for (nat32 i=0;i<res.Size();i++)
+    {
+     if (res[i].vp==null<VariablePattern*>())
+     {
+      LogAlways("[inf.field] Failed due to unset variable {variable pattern}" << LogDiv() << i);
+      return false;
+     }
+     else
+     {
+      LogDebug("[inf.field] Variable " << i << " {variable type,paras}" <<
+               LogDiv() << typestring(*res[i].vp) << LogDiv() << res[i].vp->Paras());
+     }
+    }
+   
+   // Check factors...
+    for (nat32 i=0;i<fp.Size();i++)
+    {
+     for (nat32 j=0;j<fp[i]->PipeCount();j++)
+     {
+      if (!fp[i]->PipeIsSet(j))
+      {
+       LogAlways("[inf.field] Failed due to unset pipe {factor pattern,pipe}" << LogDiv() << i << LogDiv() << j);
+       return false;
+      }
+      else
+      {
+       LogDebug("[inf.field] Factor " << i << ", Pipe " << j << " {factor type,variable type,paras}" <<
+                LogDiv() << typestring(*fp[i]) <<
+                LogDiv() << typestring(fp[i]->PipeGet(j)) <<
+                LogDiv() << fp[i]->PipeGet(j).Paras());
+      }
+     }
+    }
+    LogDebug("[inf.field] Validated propagation");
+
+
+  // Finish off the res structure, so its not a concern latter, also find
+  // the maximum level worth doing...
+   nat32 maxLevel = 0;
+   for (nat32 i=0;i<res.Size();i++)
+   {
+    // maxLevel...
+     maxLevel = math::Max(maxLevel,res[i].vp->MaxLevel());
+
+    // mc...
+     Frequency::MakeClass(res[i].vp->Labels(),res[i].mc);
+    
+    // res...
+     res[i].res = mem::Malloc<real32>(res[i].vp->Labels() * res[i].vp->Vars(0));
+   }
+   topLevel = math::Min(maxLevel,maximumLevel);
+
+ inferred = true;
+ return true;
+}
+
 bit FieldGraph::SetVarPat(FactorPattern & fp,nat32 pipe,const VariablePattern & vp,nat32 & set)
 {
  LogTime("bit FieldGraph::SetVarPat(...)");
@@ -318,109 +402,173 @@ void FieldGraph::DoLevel(nat32 level,LevelData * prev,LevelData & curr,time::Pro
 
   // Create the factors, collecting the linking information...
    prog->Report(step++,steps);
-   // First create the FactorConstruct objects...
-    curr.vpl.Size(res.Size());
-    ds::Array<FactorConstruct*> fca(fp.Size());
-    for (nat32 i=0;i<fp.Size();i++)
-    {
-     fca[i] = new FactorConstruct(curr.fg,i,fp[i]->PipeCount());
-    }
+   Build(level,curr);
 
-   // Now fill 'em up...
-   {
-    ds::List<WorkOrder>::Cursor targ = wol.FrontPtr();
-    while (!targ.Bad())
+   // If there is a budget and this level would go over it, with the previous
+   // level still held for the transfer, store its messages as halfs...
+    nat64 resBytes = 0;
+    for (nat32 i=0;i<res.Size();i++) resBytes += nat64(res[i].vp->Labels()) * nat64(res[i].vp->Vars(0)) * sizeof(real32);
+
+    if ((budget!=0)&&doMS)
     {
-     fca[targ->fp]->SetPipe(targ->pipe,&curr.vpl[targ->vp]);
-     ++targ;
+     MemoryReport held;
+     if (prev) Held(*prev,held);
+          else held.Zero();
+
+     MemoryReport need;
+     Cost(level,curr,compact,need);
+     need += held;
+     if ((!compact)&&(need.Total()>budget))
+     {
+      curr.fg.SetCompact(true);
+      ++compactLevels;
+      Cost(level,curr,true,need);
+      need += held;
+     }
+
+     if (need.Total()>budget)
+     {
+      LogAlways("[inf.field] Over memory budget, solving anyway {level,estimate,budget}" << LogDiv()
+                << level << LogDiv() << need.Total() << LogDiv() << budget);
+     }
     }
-   }
-   
-   // Send them unto the breach, where they may do their duty for bit & byte...
-   // Kill them upon their return.
-    for (nat32 i=0;i<fp.Size();i++)
+
+   // Decide which engine gets the functions - a GridGraph if it will have
+   // them, otherwise the factor graph...
+    if (!MakeGrid(level,curr))
     {
-     fp[i]->Construct(level,*fca[i]);
-     delete fca[i];
+     for (nat32 i=0;i<curr.funcs.Size();i++) curr.fg.MakeFuncs(curr.funcs[i].func,curr.funcs[i].instances);
     }
+    curr.funcs.Size(0);
 
 
   // Create the variables, using the collected link information, if we have a previous layer
   // we simultaneously copy it in...
    prog->Report(step++,steps);
-   Variable var;
-   curr.piv.Size(res.Size());
-   for (nat32 i=0;i<res.Size();i++)
+   if (curr.grid)
    {
-    curr.piv[i].Size(res[i].vp->Vars(level));
-    
-    ds::SortList<PatLink>::Cursor targ = curr.vpl[i].FrontPtr();
-    for (nat32 j=0;j<curr.piv[i].Size();j++)
+    // The grid has its variables allready, so only the transfer is needed,
+    // which only works between grids...
+     if (prev&&prev->grid) curr.grid->Transfer(*prev->grid,toPrev[0]);
+   }
+   else
+   {
+    Variable var;
+    data::Block msg;
+    bit transfer = prev&&(prev->grid==null<GridGraph*>());
+    curr.piv.Size(res.Size());
+    for (nat32 i=0;i<res.Size();i++)
     {
-     while ((!targ.Bad())&&(targ->var==j))
+     curr.piv[i].Size(res[i].vp->Vars(level));
+    
+     ds::SortList<PatLink>::Cursor targ = curr.vpl[i].FrontPtr();
+     for (nat32 j=0;j<curr.piv[i].Size();j++)
      {
-      // Make the link...
-       curr.fg.MakeLink(&var,targ->func,targ->inst,targ->link);
+      while ((!targ.Bad())&&(targ->var==j))
+      {
+       // Make the link...
+        curr.fg.MakeLink(&var,targ->func,targ->inst,targ->link);
       
-      // If we have previous copy it in...
-       if (prev)
-       {
-        int32 preVar = toPrev[i][j];
-        if (preVar!=-1)
+       // If we have previous copy it in...
+        if (transfer)
         {
-         // Create the dummy node with which to search, include getting the 
-         // relevent variable number from the previous data set...
-          PatLink dummy = *targ;
-          dummy.var = preVar;
+         int32 preVar = toPrev[i][j];
+         if (preVar!=-1)
+         {
+          // Create the dummy node with which to search, include getting the 
+          // relevent variable number from the previous data set...
+           PatLink dummy = *targ;
+           dummy.var = preVar;
         
-         // See if we can find a match...
-          PatLink * match = prev->vpl[i].Get(dummy);
+          // See if we can find a match...
+           PatLink * match = prev->vpl[i].Get(dummy);
         
-         // If a match has been found perform the transfer...
-          if (match)
-          {
-           curr.fg.SetMsg(targ->func,targ->inst,targ->link,res[i].mc,
-                          prev->fg.GetMsg(match->func,match->inst,match->link));
-          }
+          // If a match has been found perform the transfer...
+           if (match)
+           {
+            nat32 bytes = res[i].mc.Size(res[i].mc);
+            if (msg.Size()<bytes) msg.SetSize(bytes);
+            prev->fg.ReadMsg(match->func,match->inst,match->link,msg.Ptr());
+            curr.fg.SetMsg(targ->func,targ->inst,targ->link,res[i].mc,msg.Ptr());
+           }
+         }
         }
-       }
      
-      // To next...
-       ++targ;
+       // To next...
+        ++targ;
+      }
+      if (var.LinkCount()==0) curr.piv[i][j] = nat32(-1);
+                         else curr.piv[i][j] = curr.fg.MakeVar(&var);
      }
-     if (var.LinkCount()==0) curr.piv[i][j] = nat32(-1);
-                        else curr.piv[i][j] = curr.fg.MakeVar(&var);
     }
    }
 
+  // Both levels are now at their largest, so record the memory, then get rid
+  // of the previous level as its done its job...
+   nat64 mem = curr.fg.Memory() + resBytes;
+   if (curr.grid) mem += curr.grid->Memory();
+   if (prev)
+   {
+    mem += prev->fg.Memory();
+    if (prev->grid) mem += prev->grid->Memory();
+   }
+   peak = math::Max(peak,mem);
+
+   delete prev;
+   prev = null<LevelData*>();
+   toPrev.Size(0);
+
 
   // Solve...
    prog->Report(step++,steps);
-   curr.fg.SetIters(iters + (prev?0:extraHigh) + (level==0?extraLow:0));
-   curr.fg.Run(prog,level!=0);
+   if (curr.grid)
+   {
+    curr.grid->SetIters(iters + (prev?0:extraHigh) + (level==0?extraLow:0));
+    curr.grid->SetTolerance(tolerance);
+    curr.grid->Run(prog);
+    itersDone += curr.grid->ItersDone();
+   }
+   else
+   {
+    curr.fg.SetIters(iters + (prev?0:extraHigh) + (level==0?extraLow:0));
+    curr.fg.SetTolerance(tolerance);
+    curr.fg.SetResidual(residual);
+    curr.fg.Run(prog,level!=0);
+    itersDone += curr.fg.ItersDone();
+   }
 
 
   // If the lift is now at level 0 then copy the results into the res structure...
    if (level==0)
    {
     prog->Report(step++,steps);
-    curr.fg.FromNegLn();
-    
-    for (nat32 i=0;i<res.Size();i++)
+    if (curr.grid)
     {
-     nat32 vars = res[i].vp->Vars(0);
-     nat32 labels = res[i].vp->Labels();
-     for (nat32 j=0;j<vars;j++)
+     peak = math::Max(peak,curr.grid->Memory() + resBytes);
+     nat32 labels = res[0].vp->Labels();
+     for (nat32 j=0;j<res[0].vp->Vars(0);j++) curr.grid->GetProb(j,res[0].res + j*labels);
+    }
+    else
+    {
+     peak = math::Max(peak,curr.fg.Memory() + resBytes); // Now includes the output.
+     curr.fg.FromNegLn();
+    
+     for (nat32 i=0;i<res.Size();i++)
      {
-      if (curr.piv[i][j]!=nat32(-1))
-      {
-       mem::Copy<real32>(res[i].res + j*labels,(real32*)curr.fg.GetProb(curr.piv[i][j]),labels);
-      }
-      else
+      nat32 vars = res[i].vp->Vars(0);
+      nat32 labels = res[i].vp->Labels();
+      for (nat32 j=0;j<vars;j++)
       {
-       real32 * targ = res[i].res + j*labels;
-       real32 val = 1.0/real32(labels);
-       for (nat32 k=0;k<labels;k++) targ[k] = val;
+       if (curr.piv[i][j]!=nat32(-1))
+       {
+        mem::Copy<real32>(res[i].res + j*labels,(real32*)curr.fg.GetProb(curr.piv[i][j]),labels);
+       }
+       else
+       {
+        real32 * targ = res[i].res + j*labels;
+        real32 val = 1.0/real32(labels);
+        for (nat32 k=0;k<labels;k++) targ[k] = val;
+       }
       }
      }
     }
@@ -430,6 +578,106 @@ void FieldGraph::DoLevel(nat32 level,LevelData * prev,LevelData & curr,time::Pro
  prog->Pop();
 }
 
+void FieldGraph::Build(nat32 level,LevelData & curr)
+{
+ LogBlock("void FieldGraph::Build(...)","{level}" << LogDiv() << level);
+
+ // First create the FactorConstruct objects...
+  curr.vpl.Size(res.Size());
+  ds::Array<FactorConstruct*> fca(fp.Size());
+  for (nat32 i=0;i<fp.Size();i++)
+  {
+   fca[i] = new FactorConstruct(curr.funcs,i,fp[i]->PipeCount());
+  }
+
+ // Now fill 'em up...
+ {
+  ds::List<WorkOrder>::Cursor targ = wol.FrontPtr();
+  while (!targ.Bad())
+  {
+   fca[targ->fp]->SetPipe(targ->pipe,&curr.vpl[targ->vp]);
+   ++targ;
+  }
+ }
+   
+ // Send them unto the breach, where they may do their duty for bit & byte...
+ // Kill them upon their return.
+  for (nat32 i=0;i<fp.Size();i++)
+  {
+   fp[i]->Construct(level,*fca[i]);
+   delete fca[i];
+  }
+}
+
+void FieldGraph::Cost(nat32 level,const LevelData & curr,bit comp,MemoryReport & out) const
+{
+ out.Zero();
+ out.functions = sizeof(LevelData);
+
+ for (nat32 i=0;i<curr.funcs.Size();i++)
+ {
+  out.messages += FunctionSet::MessageMemory(*curr.funcs[i].func,curr.funcs[i].instances,comp);
+  out.functions += FunctionSet::StructureMemory(curr.funcs[i].func->Links());
+ }
+
+ // Each variable has its entry in piv and its link array in the factor graph,
+ // each link also its PatLink, whose avl tree node adds about 4 pointers...
+  for (nat32 i=0;i<res.Size();i++)
+  {
+   nat64 vars = res[i].vp->Vars(level);
+   nat64 links = curr.vpl[i].Size();
+   out.variables += vars*(sizeof(MessageClass) + 2*sizeof(nat32));
+   out.variables += links*(sizeof(PatLink) + 6*sizeof(void*));
+
+   out.output += nat64(res[i].vp->Labels()) * nat64(res[i].vp->Vars(0)) * sizeof(real32);
+   if (level==0) out.output += vars*(sizeof(nat64) + res[i].mc.Size(res[i].mc));
+  }
+}
+
+void FieldGraph::Held(const LevelData & prev,MemoryReport & out) const
+{
+ prev.fg.Report(out);
+ out.output = 0; // Only level 0 makes output.
+ if (prev.grid) out.messages += prev.grid->Memory();
+ for (nat32 i=0;i<prev.vpl.Size();i++) out.variables += nat64(prev.vpl[i].Size())*(sizeof(PatLink) + 4*sizeof(void*));
+}
+
+bit FieldGraph::MakeGrid(nat32 level,LevelData & curr)
+{
+ // Only a single grid, and only when nothing the GridGraph can't do is wanted...
+  if ((!useGrid)||curr.fg.DoCompact()||residual) return false;
+  if (res.Size()!=1) return false;
+  if (str::Compare(typestring(*res[0].vp),"eos::inf::Grid2D")!=0) return false;
+
+ // Get the size of the grid at this level, as Grid2D does...
+  const math::Vector<nat32> & paras = res[0].vp->Paras();
+  nat32 width = math::Max(paras[1]>>level,nat32(1));
+  nat32 height = math::Max(paras[2]>>level,nat32(1));
+
+ // Give it everything, see if it takes it...
+  GridGraph * grid = new GridGraph(doMS,width,height,res[0].vp->Labels());
+  for (nat32 i=0;i<curr.funcs.Size();i++) grid->MakeFuncs(curr.funcs[i].func,curr.funcs[i].instances);
+
+  ds::SortList<PatLink>::Cursor targ = curr.vpl[0].FrontPtr();
+  while (!targ.Bad())
+  {
+   grid->MakeLink(targ->func,targ->inst,targ->link,targ->var);
+   ++targ;
+  }
+
+  if (!grid->Prepare())
+  {
+   delete grid;
+   return false;
+  }
+
+ // Success - the links are not needed any more...
+  curr.grid = grid;
+  curr.vpl[0].MakeEmpty();
+  LogDebug("[inf.field] Using a grid {level,width,height}" << LogDiv() << level << LogDiv() << width << LogDiv() << height);
+  return true;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -30,6 +30,7 @@
 #include "eos/types.h"
 
 #include "eos/inf/factor_graphs.h"
+#include "eos/inf/grid_graphs.h"
 #include "eos/math/vectors.h"
 #include "eos/ds/arrays.h"
 #include "eos/ds/lists.h"
@@ -167,6 +168,15 @@ struct PatLink
   nat32 link;
 };
 
+//------------------------------------------------------------------------------
+// Helper structure, a function set made through a FactorConstruct, kept until
+// the FieldGraph has decided which engine is to solve the level...
+struct PatFunc
+{
+ Function * func;
+ nat32 instances;
+};
+
 //------------------------------------------------------------------------------
 /// A helper interface, used by the FactorPattern implimentor to express how
 /// factors are to be linked to variables for a particular level.
@@ -174,8 +184,8 @@ class EOS_CLASS FactorConstruct : public Deletable
 {
  public:
   // Constructor...
-   FactorConstruct(FactorGraph & fg,nat32 fpp,nat32 pipes)
-   :curr(fg),fp(fpp),linkStore(pipes)
+   FactorConstruct(ds::Array<PatFunc> & f,nat32 fpp,nat32 pipes)
+   :funcs(f),fp(fpp),linkStore(pipes)
    {}
 
   /// &nbsp;
@@ -191,10 +201,15 @@ class EOS_CLASS FactorConstruct : public Deletable
 
   /// This is identical to the method of the same name in the FactorGraph class.
   /// It should be used to obtain indexes to the function objects required to 
-  /// construct the relations.
+  /// construct the relations. (They are actually given to a FactorGraph or
+  /// GridGraph latter, but the indexes match.)
    nat32 MakeFuncs(Function * func,nat32 instances)
    {
-    return curr.MakeFuncs(func,instances);
+    nat32 ret = funcs.Size();
+    funcs.Size(ret+1);
+    funcs[ret].func = func;
+    funcs[ret].instances = instances;
+    return ret;
    }
    
   /// Once you have created the relevent function then this method will link 
@@ -231,7 +246,7 @@ class EOS_CLASS FactorConstruct : public Deletable
 
 
  private:
-  FactorGraph & curr;
+  ds::Array<PatFunc> & funcs;
   nat32 fp; // Index of factor pattern.
 
   ds::Array<ds::SortList<PatLink>*> linkStore; // Data structure to store the given in for each pipe.
@@ -328,6 +343,35 @@ class EOS_CLASS FieldGraph : public Deletable
   /// Sets the maximum level to consider - it will not go higher than this. Best left alone this method.
    void SetMaxLevel(nat32 maxLevel);
 
+  /// Switches on storing the messages as halfs, see FactorGraph. Only works
+  /// for min-sum, which is what you want when short of memory anyway.
+  /// Defaults to off.
+   void SetCompact(bit enable = true);
+
+  /// Sets a memory budget in bytes, for the messages and structure as counted
+  /// by Estimate, which includes the link dictionaries that PeakMemory
+  /// leaves out. When a level would go over it, with the previous level
+  /// still held for the transfer, that level stores its messages as halfs,
+  /// as for SetCompact, which also means it will not use a GridGraph. Only
+  /// works for min-sum. If even that goes over it says so in the log and
+  /// solves regardless, rather than failing. Defaults to 0, no budget.
+   void SetBudget(nat64 bytes);
+
+  /// Sets the convergence tolerance and if residual scheduling is used for
+  /// the factor graph of every level, see FactorGraph::SetTolerance and
+  /// FactorGraph::SetResidual. The iterations set become a cap. Defaults to
+  /// 0 and false, i.e. all iterations are always done.
+   void SetTolerance(real32 tol,bit residual = false);
+
+  /// Sets if levels that are a single Grid2D with only unary and 4-connected
+  /// pairwise factors, which is the usual stereo setup, are solved with a
+  /// GridGraph rather than a FactorGraph. It keeps the messages in planes
+  /// and uses a checkerboard schedule, so its faster and converges quicker,
+  /// though the results will differ slightly. Its not used with SetCompact
+  /// or residual scheduling, and anything that is not such a grid allways
+  /// uses the FactorGraph. Defaults to on.
+   void SetGrid(bit enable = true);
+
 
   /// Adds a FactorPattern, returning its handle number.
   /// The given pointer is claimed by the FieldGraph, and shall never be heard 
@@ -354,6 +398,13 @@ class EOS_CLASS FieldGraph : public Deletable
    nat32 CountVP() const {return countVP;}
 
 
+  /// Returns in out the memory needed by the largest level, with the level
+  /// before it held for the transfer, so it can be checked before calling
+  /// Run. Allowing for the budget, if set. This has to make, and then delete,
+  /// the functions of every level, so isn't free. Returns false if the pipes
+  /// are bad, as Run would.
+   bit Estimate(MemoryReport & out);
+
   /// Solves the specified monstrosity. For all its tricks this will not be fast.
   /// (And the progress bar won't be linear.)
   /// Returns true on success, false on failure. Failure will ushally occur due
@@ -382,6 +433,19 @@ class EOS_CLASS FieldGraph : public Deletable
     return *res[vp].vp;
    }
 
+  /// After Run returns the most bytes the factor graphs and results used at
+  /// once, for the messages and structure only - the data the factors hold is
+  /// not included.
+   nat64 PeakMemory() const {return peak;}
+
+  /// After Run returns the total iterations done over all the levels, to see
+  /// how much a tolerance is saving.
+   nat32 ItersDone() const {return itersDone;}
+
+  /// After Run returns how many levels the budget made store there messages
+  /// as halfs.
+   nat32 CompactLevels() const {return compactLevels;}
+
 
   /// &nbsp;
    static cstrconst TypeString() {return "eos::inf::FieldGraph";}
@@ -389,15 +453,27 @@ class EOS_CLASS FieldGraph : public Deletable
 
  private:
   bit doMS;
+  bit compact;
+  bit useGrid;
   nat32 maximumLevel;
+  nat64 peak;
+  nat64 budget;
+  nat32 compactLevels;
 
   nat32 iters;
   nat32 extraHigh;
   nat32 extraLow;
+
+  real32 tolerance;
+  bit residual;
+  nat32 itersDone;
   
   nat32 countFP;
   nat32 countVP;
   ds::Array<FactorPattern*> fp;
+
+  bit inferred; // true once the types have been inferred, so it only happens once.
+  nat32 topLevel; // The highest level to solve, set with the types.
   
   // This stores all the calls to Lay, it is not proccessed heavily until 
   // the actual call to run...
@@ -426,13 +502,22 @@ class EOS_CLASS FieldGraph : public Deletable
    // The variable set is set to the number of pipes now set that wern't set before.
     static bit SetVarPat(FactorPattern & fp,nat32 pipe,const VariablePattern & vp,nat32 & set);
     
+   // This infers the VariablePattern of every pipe and checks they match,
+   // setting up res and topLevel, returning false if the graph is bad...
+    bit Infer();
+
    // This structure contains a factor graph and other information required to be passed
    // from one level to the next...
     struct LevelData
     {
-     LevelData(bit doMS):fg(doMS,true) {}
+     LevelData(bit doMS,bit compact):fg(doMS,true,compact),grid(null<GridGraph*>()) {}
+     ~LevelData() {delete grid;}
 
      FactorGraph fg;
+     GridGraph * grid; // If not null the level is a grid, solved by this rather than fg.
+
+     // The functions made by the patterns, before they go to fg or grid...
+      ds::Array<PatFunc> funcs;
      
      // For each variable pattern we store a dictionary of links created,
      // with the details required for several operations...
@@ -450,7 +535,20 @@ class EOS_CLASS FieldGraph : public Deletable
    // This actually does the real work, kept in here for neatness, only does a single level,
    // on being given the previous level so it can be transfered in...
    // (level is the level of curr, prev is level+1)
+   // prev is deleted as soon as its been transfered, so it isn't taking up
+   // memory whilst curr is solved.
     void DoLevel(nat32 level,LevelData * prev,LevelData & curr,time::Progress * prog);
+
+   // Has the FactorPattern-s make the functions and links of a level...
+    void Build(nat32 level,LevelData & curr);
+
+   // Costs up a level once built, as if its messages were compact or not,
+   // and the memory a done level holds whilst the next is transfered in...
+    void Cost(nat32 level,const LevelData & curr,bit comp,MemoryReport & out) const;
+    void Held(const LevelData & prev,MemoryReport & out) const;
+
+   // Trys to make a GridGraph for the level, returning true on success...
+    bit MakeGrid(nat32 level,LevelData & curr);
 };
 
 //------------------------------------------------------------------------------
@@ -18,6 +18,8 @@
 #include "eos/inf/gauss_integration.h"
 
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
+#include "eos/mt/locks.h"
 
 namespace eos
 {
@@ -25,7 +27,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 IntegrateBP::IntegrateBP(nat32 width,nat32 height)
-:iters(100),zeroM(0)
+:iters(100),zeroM(0),tolerance(0.0),cg(false),cgTol(1e-6),cgIters(0),itersDone(0),cgItersDone(0)
 {
  Reset(width,height);
 }
@@ -99,6 +101,335 @@ void IntegrateBP::SetZeroMeaning(nat32 n)
  zeroM = n;
 }
 
+void IntegrateBP::SetTolerance(real32 tol)
+{
+ tolerance = tol;
+}
+
+void IntegrateBP::SetConjGrad(bit enable,real32 tol,nat32 maxIters)
+{
+ cg = enable;
+ cgTol = tol;
+ cgIters = maxIters;
+}
+
+//------------------------------------------------------------------------------
+// Sends the messages from the nodes of one colour, for a range of rows. As the
+// messages all go to the other colour the rows can be done at once...
+class IntegrateBP::PassMsgs
+{
+ public:
+  PassMsgs(IntegrateBP & s,ds::ArrayDel< ds::Array<Node> > & d,nat32 p,real32 & r)
+  :self(s),data(d),parity(p),residual(r) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   ds::ArrayDel< ds::Array<Pixel> > & in = self.in;
+   nat32 width = self.out.Width();
+   real32 maxDiff = 0.0;
+
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=(parity+y)%2;x<width;x+=2)
+    {
+     if (in[y][x].lock)
+     {
+      // Message calculation is far easier for locked nodes, simply use the
+      // relationship to calculate the absolute value and then apply the invSd to
+      // get the message...
+       for (nat32 j=0;j<4;j++)
+       {
+        if (!math::IsZero(in[y][x].rel[j].invSd))
+        {
+         // Calculate message...
+          real32 invVar = math::Sqr(in[y][x].rel[j].invSd);
+          real32 val = in[y][x].mean*in[y][x].rel[j].ubM + in[y][x].rel[j].ubZ;
+
+          math::Gauss1D msg;
+          msg.InvCoVar() = invVar;
+          msg.InvCoVarMean() = invVar * val;
+
+         // Send message...
+          switch (j)
+          {
+           case 0: data[y][x+1].msg[2] = msg; break;
+           case 1: data[y+1][x].msg[3] = msg; break;
+           case 2: data[y][x-1].msg[0] = msg; break;
+           case 3: data[y-1][x].msg[1] = msg; break;
+          }
+        }
+       }
+     }
+     else
+     {
+      // Calculate the accumulator of messages, from which we can subtract to get
+      // the outputs...
+       math::Gauss1D acc = data[y][x].exp;
+       for (nat32 j=0;j<4;j++) acc *= data[y][x].msg[j];
+
+       if ((self.tolerance>0.0)&&(acc.Defined()))
+       {
+        real32 mean = acc.Mean();
+        maxDiff = math::Max(maxDiff,math::Abs(mean-data[y][x].last));
+        data[y][x].last = mean;
+       }
+
+      // Pass messages...
+       for (nat32 j=0;j<4;j++)
+       {
+        if (!math::IsZero(in[y][x].rel[j].invSd))
+        {
+         // Remove the message from the direction we are sending from the
+         // expectation...
+          math::Gauss1D accSub = acc;
+          accSub /= data[y][x].msg[j];
+
+         // Combine the acc with the compatability distribution and marginalise
+         // to generate our output message...
+          math::Gauss2D msgExt(accSub);
+
+          real32 m = in[y][x].rel[j].ubM;
+          real32 z = in[y][x].rel[j].ubZ;
+          real32 mult = 0.5 * math::Sqr(in[y][x].rel[j].invSd);
+
+          math::Gauss2D co;
+          co.InvCoVar()[0][0] = mult * math::Sqr(m);
+          co.InvCoVar()[0][1] = -mult * m;
+          co.InvCoVar()[1][0] = -mult * m;
+          co.InvCoVar()[1][1] = mult;
+          co.InvCoVarMean()[1] = -mult * z * m;
+          co.InvCoVarMean()[0] =  mult * z;
+
+          msgExt *= co;
+          math::Gauss1D msg;
+          msgExt.Marg1(msg);
+
+         // Send message...
+          switch (j)
+          {
+           case 0: data[y][x+1].msg[2] = msg; break;
+           case 1: data[y+1][x].msg[3] = msg; break;
+           case 2: data[y][x-1].msg[0] = msg; break;
+           case 3: data[y-1][x].msg[1] = msg; break;
+          }
+        }
+       }
+     }
+    }
+   }
+
+   if (self.tolerance>0.0)
+   {
+    lock.Lock();
+     residual = math::Max(residual,maxDiff);
+    lock.Unlock();
+   }
+  }
+
+
+ private:
+  IntegrateBP & self;
+  ds::ArrayDel< ds::Array<Node> > & data;
+  nat32 parity;
+  real32 & residual;
+  mt::OwnedLock lock;
+};
+
+//------------------------------------------------------------------------------
+// As PassMsgs, but only for the inverse variances, for conjugate gradient
+// mode. Exactly the same numbers as the inverse variances in PassMsgs, just
+// with the 2D Gaussian multiplied out by hand...
+class IntegrateBP::PassPrec
+{
+ public:
+  PassPrec(IntegrateBP & s,ds::ArrayDel< ds::Array<Node> > & d,nat32 p,real32 & r)
+  :self(s),data(d),parity(p),residual(r) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   ds::ArrayDel< ds::Array<Pixel> > & in = self.in;
+   nat32 width = self.out.Width();
+   real32 maxDiff = 0.0;
+
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=(parity+y)%2;x<width;x+=2)
+    {
+     real32 acc = 0.0;
+     if (!in[y][x].lock)
+     {
+      acc = data[y][x].exp.InvCoVar();
+      for (nat32 j=0;j<4;j++) acc += data[y][x].msg[j].InvCoVar();
+
+      if ((self.tolerance>0.0)&&(!math::IsZero(acc)))
+      {
+       maxDiff = math::Max(maxDiff,math::Abs(acc-data[y][x].last)/acc);
+       data[y][x].last = acc;
+      }
+     }
+
+     for (nat32 j=0;j<4;j++)
+     {
+      if (!math::IsZero(in[y][x].rel[j].invSd))
+      {
+       real32 msg;
+       if (in[y][x].lock) msg = math::Sqr(in[y][x].rel[j].invSd);
+       else
+       {
+        real32 m = in[y][x].rel[j].ubM;
+        real32 mult = 0.5 * math::Sqr(in[y][x].rel[j].invSd);
+        real32 iv = (acc - data[y][x].msg[j].InvCoVar()) + mult * math::Sqr(m);
+        if (math::IsZero(iv)) msg = mult;
+                         else msg = mult - (mult*m)*(mult*m)/iv;
+       }
+
+       switch (j)
+       {
+        case 0: data[y][x+1].msg[2].InvCoVar() = msg; break;
+        case 1: data[y+1][x].msg[3].InvCoVar() = msg; break;
+        case 2: data[y][x-1].msg[0].InvCoVar() = msg; break;
+        case 3: data[y-1][x].msg[1].InvCoVar() = msg; break;
+       }
+      }
+     }
+    }
+   }
+
+   if (self.tolerance>0.0)
+   {
+    lock.Lock();
+     residual = math::Max(residual,maxDiff);
+    lock.Unlock();
+   }
+  }
+
+
+ private:
+  IntegrateBP & self;
+  ds::ArrayDel< ds::Array<Node> > & data;
+  nat32 parity;
+  real32 & residual;
+  mt::OwnedLock lock;
+};
+
+//------------------------------------------------------------------------------
+// The linear system for conjugate gradient mode, a 5 point stencil, which is
+// symmetric so only the right and down entrys are stored...
+struct CgNode
+{
+ real64 diag;
+ real64 right;
+ real64 down;
+ real64 invDiag; // Jacobi preconditioner, 0 for nodes not in the system.
+};
+
+// q = Ap, also summing p.q...
+class IntegrateBP::CgMult
+{
+ public:
+  CgMult(const ds::Array<CgNode> & a,nat32 w,const ds::Array<real64> & pp,ds::Array<real64> & qq)
+  :sys(a),width(w),p(pp),q(qq),pq(0.0) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 height = sys.Size()/width;
+   real64 sum = 0.0;
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     nat32 i = y*width + x;
+     real64 v = sys[i].diag * p[i];
+     if (x+1<width) v += sys[i].right * p[i+1];
+     if (x>0) v += sys[i-1].right * p[i-1];
+     if (y+1<height) v += sys[i].down * p[i+width];
+     if (y>0) v += sys[i-width].down * p[i-width];
+     q[i] = v;
+     sum += p[i]*v;
+    }
+   }
+
+   lock.Lock();
+    pq += sum;
+   lock.Unlock();
+  }
+
+  real64 PQ() const {return pq;}
+
+
+ private:
+  const ds::Array<CgNode> & sys;
+  nat32 width;
+  const ds::Array<real64> & p;
+  ds::Array<real64> & q;
+  real64 pq;
+  mt::OwnedLock lock;
+};
+
+// x += alpha p, r -= alpha q, z = Mr, summing r.r and r.z...
+class IntegrateBP::CgStep
+{
+ public:
+  CgStep(const ds::Array<CgNode> & a,nat32 w,real64 al,ds::Array<real64> & xx,ds::Array<real64> & rr,ds::Array<real64> & zz,const ds::Array<real64> & pp,const ds::Array<real64> & qq)
+  :sys(a),width(w),alpha(al),x(xx),r(rr),z(zz),p(pp),q(qq),rr2(0.0),rz(0.0) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   real64 sumR = 0.0;
+   real64 sumZ = 0.0;
+   for (nat32 i=begin*width;i<end*width;i++)
+   {
+    x[i] += alpha * p[i];
+    r[i] -= alpha * q[i];
+    z[i] = sys[i].invDiag * r[i];
+    sumR += r[i]*r[i];
+    sumZ += r[i]*z[i];
+   }
+
+   lock.Lock();
+    rr2 += sumR;
+    rz += sumZ;
+   lock.Unlock();
+  }
+
+  real64 RR() const {return rr2;}
+  real64 RZ() const {return rz;}
+
+
+ private:
+  const ds::Array<CgNode> & sys;
+  nat32 width;
+  real64 alpha;
+  ds::Array<real64> & x;
+  ds::Array<real64> & r;
+  ds::Array<real64> & z;
+  const ds::Array<real64> & p;
+  const ds::Array<real64> & q;
+  real64 rr2;
+  real64 rz;
+  mt::OwnedLock lock;
+};
+
+// p = z + beta p...
+class IntegrateBP::CgDir
+{
+ public:
+  CgDir(nat32 w,real64 b,const ds::Array<real64> & zz,ds::Array<real64> & pp)
+  :width(w),beta(b),z(zz),p(pp) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 i=begin*width;i<end*width;i++) p[i] = z[i] + beta*p[i];
+  }
+
+
+ private:
+  nat32 width;
+  real64 beta;
+  const ds::Array<real64> & z;
+  ds::Array<real64> & p;
+};
+
 void IntegrateBP::Run(time::Progress * prog)
 {
  LogDebug("eos::inf::IntegrateBP::Run");
@@ -106,7 +437,7 @@ void IntegrateBP::Run(time::Progress * prog)
 
  // Create and null the message passing data structure...
  // It also contains the input messages, so fill them in.
-  prog->Report(0,iters+2);
+  prog->Report(0,iters+3);
   ds::ArrayDel< ds::Array<Node> > data(out.Height());
   for (nat32 i=0;i<data.Size();i++) data[i].Size(out.Width());
 
@@ -123,6 +454,7 @@ void IntegrateBP::Run(time::Progress * prog)
 
     // Messages...
      for (nat32 i=0;i<4;i++) data[y][x].msg[i] = math::Gauss1D();
+     data[y][x].last = 0.0;
    }
   }
 
@@ -186,111 +518,57 @@ void IntegrateBP::Run(time::Progress * prog)
   }
 
 
- // Pass messages (With a checkboard pattern.)...
+ // Pass messages (With a checkboard pattern.), stopping early if converged,
+ // which needs two iterations below the tolerance so both colours are...
+  itersDone = 0;
+  cgItersDone = 0;
+  real32 prevResidual = math::Infinity<real32>();
   for (nat32 i=0;i<iters;i++)
   {
    prog->Report(2+i,iters+3);
-   for (nat32 y=0;y<out.Height();y++)
+   real32 residual = 0.0;
+   if (cg)
    {
-    for (nat32 x=(i+y)%2;x<out.Width();x+=2)
-    {
-     if (in[y][x].lock)
-     {
-      // Message calculation is far easier for locked nodes, simply use the
-      // relationship to calculate the absolute value and then apply the invSd to
-      // get the message...
-       for (nat32 j=0;j<4;j++)
-       {
-        if (!math::IsZero(in[y][x].rel[j].invSd))
-        {
-         // Calculate message...
-          real32 invVar = math::Sqr(in[y][x].rel[j].invSd);
-          real32 val = in[y][x].mean*in[y][x].rel[j].ubM + in[y][x].rel[j].ubZ;
-
-          math::Gauss1D msg;
-          msg.InvCoVar() = invVar;
-          msg.InvCoVarMean() = invVar * val;
-
-         // Send message...
-          switch (j)
-          {
-           case 0: data[y][x+1].msg[2] = msg; break;
-           case 1: data[y+1][x].msg[3] = msg; break;
-           case 2: data[y][x-1].msg[0] = msg; break;
-           case 3: data[y-1][x].msg[1] = msg; break;
-          }
-        }
-       }
-     }
-     else
-     {
-      // Calculate the accumulator of messages, from which we can subtract to get
-      // the outputs...
-       math::Gauss1D acc = data[y][x].exp;
-       for (nat32 j=0;j<4;j++) acc *= data[y][x].msg[j];
-
-      // Pass messages...
-       for (nat32 j=0;j<4;j++)
-       {
-        if (!math::IsZero(in[y][x].rel[j].invSd))
-        {
-         // Remove the message from the direction we are sending from the
-         // expectation...
-          math::Gauss1D accSub = acc;
-          accSub /= data[y][x].msg[j];
-
-         // Combine the acc with the compatability distribution and marginalise
-         // to generate our output message...
-          math::Gauss2D msgExt(accSub);
-
-          real32 m = in[y][x].rel[j].ubM;
-          real32 z = in[y][x].rel[j].ubZ;
-          real32 mult = 0.5 * math::Sqr(in[y][x].rel[j].invSd);
-
-          math::Gauss2D co;
-          co.InvCoVar()[0][0] = mult * math::Sqr(m);
-          co.InvCoVar()[0][1] = -mult * m;
-          co.InvCoVar()[1][0] = -mult * m;
-          co.InvCoVar()[1][1] = mult;
-          co.InvCoVarMean()[1] = -mult * z * m;
-          co.InvCoVarMean()[0] =  mult * z;
-
-          msgExt *= co;
-          math::Gauss1D msg;
-          msgExt.Marg1(msg);
+    PassPrec pass(*this,data,i&1,residual);
+    mt::ParallelFor(nat32(0),out.Height(),pass,8);
+   }
+   else
+   {
+    PassMsgs pass(*this,data,i&1,residual);
+    mt::ParallelFor(nat32(0),out.Height(),pass,8);
 
-         // Send message...
-          switch (j)
-          {
-           case 0: data[y][x+1].msg[2] = msg; break;
-           case 1: data[y+1][x].msg[3] = msg; break;
-           case 2: data[y][x-1].msg[0] = msg; break;
-           case 3: data[y-1][x].msg[1] = msg; break;
-          }
-        }
-       }
-     }
-    }
+    // Zero mean if needed...
+     if ((zeroM!=0)&&(((i+1)%zeroM)==0)) WeightedZeroMean(data);
    }
-   
-   // Zero mean if needed...
-    if ((zeroM!=0)&&(((i+1)%zeroM)==0)) WeightedZeroMean(data);
+   itersDone = i+1;
+
+   // The first two iterations are not meaningful, as last starts at 0...
+    if ((tolerance>0.0)&&(i>=3)&&(residual<tolerance)&&(prevResidual<tolerance)) break;
+    prevResidual = residual;
   }
-  
- // Once done zero mean again if needed...
-  if (zeroM!=0) WeightedZeroMean(data);
 
 
- // Extract the results...
+ // Extract the results - in conjugate gradient mode we solve for the means
+ // first...
   prog->Report(2+iters,iters+3);
-  for (nat32 y=0;y<out.Height();y++)
+  if (cg)
   {
-   for (nat32 x=0;x<out.Width();x++)
+   ConjGrad(data,prog);
+  }
+  else
+  {
+   // Once done zero mean again if needed...
+    if (zeroM!=0) WeightedZeroMean(data);
+
+   for (nat32 y=0;y<out.Height();y++)
    {
-    if (!in[y][x].lock)
+    for (nat32 x=0;x<out.Width();x++)
     {
-     out.Get(x,y) = data[y][x].exp;
-     for (nat32 i=0;i<4;i++) out.Get(x,y) *= data[y][x].msg[i];
+     if (!in[y][x].lock)
+     {
+      out.Get(x,y) = data[y][x].exp;
+      for (nat32 i=0;i<4;i++) out.Get(x,y) *= data[y][x].msg[i];
+     }
     }
    }
   }
@@ -390,6 +668,185 @@ void IntegrateBP::WeightedZeroMean(ds::ArrayDel< ds::Array<Node> > & data)
   }
 }
 
+void IntegrateBP::ConjGrad(ds::ArrayDel< ds::Array<Node> > & data,time::Progress * prog)
+{
+ prog->Push();
+ nat32 width = out.Width();
+ nat32 height = out.Height();
+ nat32 nodes = width*height;
+
+ // Build the system - each directed relationship between unlocked nodes
+ // contributes the potential BP would use for its message, halved if the
+ // reverse direction also exists so the two are averaged. Locked nodes
+ // simply become a prior on there neighbours, as in BP...
+  ds::Array<CgNode> sys(nodes);
+  ds::Array<real64> b(nodes);
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    nat32 i = y*width + x;
+    sys[i].right = 0.0;
+    sys[i].down = 0.0;
+    if (in[y][x].lock)
+    {
+     sys[i].diag = 0.0;
+     b[i] = 0.0;
+    }
+    else
+    {
+     sys[i].diag = data[y][x].exp.InvCoVar();
+     b[i] = data[y][x].exp.InvCoVarMean();
+    }
+   }
+  }
+
+  static const int32 dx[4] = {1,0,-1,0};
+  static const int32 dy[4] = {0,1,0,-1};
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    nat32 i = y*width + x;
+    for (nat32 j=0;j<4;j++)
+    {
+     if (math::IsZero(in[y][x].rel[j].invSd)) continue;
+     nat32 nx = x + dx[j];
+     nat32 ny = y + dy[j];
+     nat32 n = ny*width + nx;
+     if (in[ny][nx].lock) continue;
+
+     real64 w = math::Sqr(in[y][x].rel[j].invSd);
+     real64 m = in[y][x].rel[j].ubM;
+     real64 z = in[y][x].rel[j].ubZ;
+
+     if (in[y][x].lock)
+     {
+      sys[n].diag += w;
+      b[n] += w * (in[y][x].mean*m + z);
+     }
+     else
+     {
+      real64 mult = 0.5 * w;
+      if (!math::IsZero(in[ny][nx].rel[(j+2)%4].invSd)) mult *= 0.5;
+
+      sys[i].diag += mult * m * m;
+      sys[n].diag += mult;
+      switch (j)
+      {
+       case 0: sys[i].right -= mult * m; break;
+       case 1: sys[i].down -= mult * m; break;
+       case 2: sys[n].right -= mult * m; break;
+       case 3: sys[n].down -= mult * m; break;
+      }
+      b[i] += mult * z;
+      b[n] -= mult * z * m;
+     }
+    }
+   }
+  }
+
+  for (nat32 i=0;i<nodes;i++)
+  {
+   if (sys[i].diag>0.0) sys[i].invDiag = 1.0/sys[i].diag;
+                   else sys[i].invDiag = 0.0;
+  }
+
+
+ // Preconditioned conjugate gradient, starting from all zeros...
+  ds::Array<real64> xv(nodes);
+  ds::Array<real64> r(nodes);
+  ds::Array<real64> z(nodes);
+  ds::Array<real64> p(nodes);
+  ds::Array<real64> q(nodes);
+
+  real64 bb = 0.0;
+  real64 rz = 0.0;
+  for (nat32 i=0;i<nodes;i++)
+  {
+   xv[i] = 0.0;
+   r[i] = b[i];
+   z[i] = sys[i].invDiag * r[i];
+   p[i] = z[i];
+   bb += b[i]*b[i];
+   rz += r[i]*z[i];
+  }
+
+  nat32 maxIters = (cgIters!=0)?cgIters:nodes;
+  real64 limit = math::Sqr(real64(cgTol)) * bb;
+  nat32 grain = 8;
+  while ((cgItersDone<maxIters)&&(bb>0.0))
+  {
+   prog->Report(cgItersDone,maxIters);
+
+   CgMult mult(sys,width,p,q);
+   mt::ParallelFor(nat32(0),height,mult,grain);
+   if (!(mult.PQ()>0.0)) break;
+
+   CgStep step(sys,width,rz/mult.PQ(),xv,r,z,p,q);
+   mt::ParallelFor(nat32(0),height,step,grain);
+   cgItersDone += 1;
+   if (step.RR()<=limit) break;
+
+   CgDir dir(width,step.RZ()/rz,z,p);
+   mt::ParallelFor(nat32(0),height,dir,grain);
+   rz = step.RZ();
+  }
+
+
+ // Write out the answer, with the inverse variances from BP, zero meaning
+ // first if needed...
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    if (!in[y][x].lock)
+    {
+     real32 iv = data[y][x].exp.InvCoVar();
+     for (nat32 i=0;i<4;i++) iv += data[y][x].msg[i].InvCoVar();
+     data[y][x].last = iv;
+    }
+   }
+  }
+
+  if (zeroM!=0)
+  {
+   real64 mean = 0.0;
+   real64 weight = 0.0;
+   for (nat32 y=0;y<height;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     if ((!in[y][x].lock)&&(!math::IsZero(data[y][x].last)))
+     {
+      weight += data[y][x].last;
+      mean += data[y][x].last * xv[y*width+x];
+     }
+    }
+   }
+
+   if (weight>0.0)
+   {
+    mean /= weight;
+    for (nat32 i=0;i<nodes;i++) xv[i] -= mean;
+   }
+  }
+
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    if (!in[y][x].lock)
+    {
+     out.Get(x,y).InvCoVar() = data[y][x].last;
+     out.Get(x,y).InvCoVarMean() = data[y][x].last * xv[y*width+x];
+    }
+   }
+  }
+
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -51,7 +51,18 @@ namespace eos
 /// Given all this information values are determined for each entry on the grid,
 /// as well as standard deviations to indicate confidence.
 /// This is done with belief propagation using a checkerboard update pattern and a
-/// given number of message passing iterations.
+/// given number of message passing iterations. Each half of the checkerboard is
+/// split between the threads of the task pool.
+///
+/// As the means take a very long time to propagate across large grids there is
+/// also a conjugate gradient mode. The means BP converges to are the solution of
+/// a sparse linear system, so that is solved directly, with a Jacobi
+/// preconditioner. The inverse variances BP calculates do not depend on the
+/// means at all, so they are still found with BP, but only passing them, which
+/// is a lot cheaper. The system is built by taking, for each pair of nodes, the
+/// average of the relationships in each direction - when these agree, which
+/// is the case when the directions are the reverse of each other, as all the
+/// users of this class provide, the results match BP run to convergence.
 class EOS_CLASS IntegrateBP
 {
  public:
@@ -95,8 +106,30 @@ class EOS_CLASS IntegrateBP
   /// i.e. no relationship.
    void SetRel(nat32 x,nat32 y,nat32 dir,real32 m,real32 z,real32 invSd);
 
-  /// Sets how many iterations it does, defaults to 100.
+  /// Sets how many iterations it does, defaults to 100. In conjugate
+  /// gradient mode this is how many iterations are used for the inverse
+  /// variances.
    void SetIters(nat32 iter);
+
+  /// Sets a tolerance, so it stops early if the largest change of a mean
+  /// between iterations is less than it. In conjugate gradient mode it is
+  /// instead applied to the relative change of the inverse variances.
+  /// Defaults to 0, which switches it off.
+   void SetTolerance(real32 tol);
+
+  /// Switches to conjugate gradient mode, or back again. The tolerance is for
+  /// the residual, relative to that of the initial all zeros answer, with the
+  /// iteration cap defaulting to the number of nodes, as you would never
+  /// expect to get close to that. Defaults to off.
+   void SetConjGrad(bit enable,real32 tol = 1e-6,nat32 maxIters = 0);
+
+  /// After Run returns how many iterations were done, of BP or of the
+  /// inverse variance pass in conjugate gradient mode.
+   nat32 ItersDone() const {return itersDone;}
+
+  /// After Run in conjugate gradient mode returns how many conjugate gradient
+  /// iterations were done, otherwise 0.
+   nat32 ConjGradIters() const {return cgItersDone;}
    
   /// Sets zero meaning of the data every n iterations, with n==0 switching off
   /// the zero meaning. The mean is weighted by inverse variance.
@@ -142,6 +175,10 @@ class EOS_CLASS IntegrateBP
   // Input...
    nat32 iters;
    nat32 zeroM;
+   real32 tolerance;
+   bit cg;
+   real32 cgTol;
+   nat32 cgIters;
 
    struct Pixel
    {
@@ -166,14 +203,30 @@ class EOS_CLASS IntegrateBP
    {
     math::Gauss1D exp;
     math::Gauss1D msg[4]; // Comming into the node, so exp*msg[0]*msg[1]*msg[2]*msg[3] is the output.
+    real32 last; // Mean, or inverse variance for the conjugate gradient mode, last time it was updated, for the tolerance.
    };
 
+   nat32 itersDone;
+   nat32 cgItersDone;
+
 
   // Output...
    ds::Array2D<math::Gauss1D> out;
    
   // Helper method - zero means the runtime array, weighting by inverse variance...
    void WeightedZeroMean(ds::ArrayDel< ds::Array<Node> > & data);
+
+  // Helper method - solves the means with conjugate gradient, given the
+  // inverse variances from the pass, writing out...
+   void ConjGrad(ds::ArrayDel< ds::Array<Node> > & data,time::Progress * prog);
+
+  // Functors for the task pool - the BP updates for one colour, with and
+  // without the means, and the parts of the conjugate gradient iteration...
+   class PassMsgs;
+   class PassPrec;
+   class CgMult;
+   class CgStep;
+   class CgDir;
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,422 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/inf/grid_graphs.h"
+
+#include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
+#include "eos/mt/locks.h"
+
+namespace eos
+{
+ namespace inf
+ {
+//------------------------------------------------------------------------------
+class GridGraph::SendFuncs
+{
+ public:
+  SendFuncs(GridGraph & s,nat32 col,bit un,bit meas)
+  :self(s),colour(col),unary(un),measure(meas),change(0.0) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 count = self.msgBytes/sizeof(real32);
+   data::Block old;
+   if (measure) old.SetSize(self.msgBytes);
+   real32 c = 0.0;
+
+   for (nat32 i=begin;i<end;i++)
+   {
+    const Span & sp = self.spans[i];
+    Set & set = self.sets[sp.set];
+    if ((set.links==1)&&(!unary)) continue;
+
+    MessageSet ms(set.mc,self.data + sp.var*self.msgBytes,set.in,set.out);
+    nat32 first = self.Colour(sp.var);
+    for (nat32 k=0;k<sp.size;k++)
+    {
+     // Work out which link goes to a variable of the colour being done, if any...
+      bit lowIs = ((first+k)&1)==colour;
+      nat32 mtc;
+      if (set.links==1)
+      {
+       if (!lowIs) {ms.Advance(self.msgBytes); continue;}
+       mtc = 0;
+      }
+      else mtc = lowIs?set.low:(1-set.low);
+
+     // Send, keeping the old message if we need to know the change...
+      real32 * msg = (real32*)(self.data + (sp.var+k)*self.msgBytes + set.out[mtc]);
+      if (measure) mem::Copy((real32*)old.Ptr(),msg,count);
+
+      if (self.doMS) set.func->SendOneMS(sp.inst+k,ms,mtc);
+                else set.func->SendOneSP(sp.inst+k,ms,mtc);
+
+      if (measure)
+      {
+       const real32 * prev = (const real32*)old.Ptr();
+       for (nat32 j=0;j<count;j++) c = math::Max(c,math::Abs(msg[j]-prev[j]));
+      }
+
+     ms.Advance(self.msgBytes);
+    }
+   }
+
+   if (measure)
+   {
+    lock.Lock();
+     change = math::Max(change,c);
+    lock.Unlock();
+   }
+  }
+
+  real32 Change() const {return change;}
+
+ private:
+  GridGraph & self;
+  nat32 colour;
+  bit unary;
+  bit measure;
+
+  mt::OwnedLock lock;
+  real32 change;
+};
+
+class GridGraph::SendVars
+{
+ public:
+  SendVars(GridGraph & s,nat32 col):self(s),colour(col) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 count = self.msgBytes/sizeof(real32);
+   data::Block sum;
+   sum.SetSize(self.msgBytes);
+   real32 * acc = (real32*)sum.Ptr();
+
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=(y+colour)&1;x<self.width;x+=2)
+    {
+     nat32 v = y*self.width + x;
+     if (self.doMS)
+     {
+      // Sum everything, then take each slots own message back off...
+       const real32 * in = (const real32*)self.ToVar(0,v);
+       for (nat32 i=0;i<count;i++) acc[i] = in[i];
+       for (nat32 k=1;k<self.slots;k++)
+       {
+        in = (const real32*)self.ToVar(k,v);
+        for (nat32 i=0;i<count;i++) acc[i] += in[i];
+       }
+
+       for (nat32 k=0;k<self.slots;k++)
+       {
+        in = (const real32*)self.ToVar(k,v);
+        real32 * out = (real32*)self.FromVar(k,v);
+        for (nat32 i=0;i<count;i++) out[i] = acc[i] - in[i];
+       }
+     }
+     else
+     {
+      // Products of all the others, the slot count is small so the O(n^2)
+      // approach is fine...
+       for (nat32 k=0;k<self.slots;k++)
+       {
+        real32 * out = (real32*)self.FromVar(k,v);
+        for (nat32 i=0;i<count;i++) out[i] = 1.0;
+        for (nat32 j=0;j<self.slots;j++)
+        {
+         if (j==k) continue;
+         const real32 * in = (const real32*)self.ToVar(j,v);
+         for (nat32 i=0;i<count;i++) out[i] *= in[i];
+        }
+       }
+     }
+    }
+   }
+  }
+
+ private:
+  GridGraph & self;
+  nat32 colour;
+};
+
+//------------------------------------------------------------------------------
+GridGraph::GridGraph(bit ms,nat32 w,nat32 h,nat32 labels)
+:doMS(ms),width(w),height(h),vars(w*h),msgBytes(labels*sizeof(real32)),
+iters(1),tolerance(0.0),monitor(null<LoopyMonitor*>()),itersDone(0),lastResidual(0.0),owned(false),
+slots(0),planeBytes(0),data(null<byte*>())
+{
+ Frequency::MakeClass(labels,mc);
+}
+
+GridGraph::~GridGraph()
+{
+ for (nat32 i=0;i<sets.Size();i++)
+ {
+  if (owned) delete sets[i].func;
+  delete[] sets[i].linkVar;
+ }
+ mem::Free(data);
+}
+
+nat32 GridGraph::MakeFuncs(Function * func,nat32 instances)
+{
+ nat32 ret = sets.Size();
+ sets.Size(ret+1);
+
+ Set & set = sets[ret];
+  set.func = func;
+  set.instances = instances;
+  set.links = func->Links();
+  set.slot = 0;
+  set.low = 0;
+  set.delta = 0;
+  set.linkVar = new nat32[instances*set.links];
+  for (nat32 i=0;i<instances*set.links;i++) set.linkVar[i] = nat32(-1);
+
+ return ret;
+}
+
+void GridGraph::MakeLink(nat32 function,nat32 instance,nat32 link,nat32 var)
+{
+ Set & set = sets[function];
+ set.linkVar[instance*set.links + link] = var;
+}
+
+bit GridGraph::Prepare()
+{
+ LogBlock("bit GridGraph::Prepare()","{width,height,sets}" << LogDiv() << width << LogDiv() << height << LogDiv() << sets.Size());
+
+ // Assign the slots, checking the link counts whilst we are at it...
+  slots = 0;
+  for (nat32 s=0;s<sets.Size();s++)
+  {
+   if ((sets[s].links!=1)&&(sets[s].links!=2)) return false;
+   sets[s].slot = slots;
+   slots += sets[s].links;
+  }
+  if (slots==0) return false;
+
+ // The offsets are nat32, so all the planes have to fit in 4 gig...
+  planeBytes = nat64(vars)*nat64(msgBytes);
+  if (2*nat64(slots)*planeBytes>nat64(0xFFFFFFFF)) return false;
+
+ // Check each set, building the spans...
+  ds::Array<nat32> seen(vars);
+  for (nat32 i=0;i<vars;i++) seen[i] = nat32(-1);
+  for (nat32 s=0;s<sets.Size();s++)
+  {
+   if (!Check(s,seen))
+   {
+    LogDebug("[inf.grid] Not a grid {set}" << LogDiv() << s);
+    spans.Size(0);
+    return false;
+   }
+  }
+
+
+ // Its a grid - claim the functions and make the messages...
+  owned = true;
+  for (nat32 s=0;s<sets.Size();s++)
+  {
+   delete[] sets[s].linkVar;
+   sets[s].linkVar = null<nat32*>();
+
+   if (doMS) sets[s].func->ToMS();
+        else sets[s].func->ToSP();
+  }
+
+  data = mem::Malloc<byte>(2*nat64(slots)*planeBytes);
+  for (nat32 p=0;p<2*slots;p++)
+  {
+   for (nat32 v=0;v<vars;v++)
+   {
+    byte * msg = data + p*planeBytes + v*msgBytes;
+    if (doMS) mc.FlatlineLn(mc,msg);
+         else mc.Flatline(mc,msg);
+   }
+  }
+
+ LogDebug("[inf.grid] Prepared {slots,spans,bytes}" << LogDiv() << slots << LogDiv() << spans.Size() << LogDiv() << Memory());
+ return true;
+}
+
+void GridGraph::Transfer(const GridGraph & prev,const ds::Array<int32> & toPrev)
+{
+ if ((prev.slots!=slots)||(prev.msgBytes!=msgBytes)) return;
+
+ for (nat32 k=0;k<slots;k++)
+ {
+  for (nat32 v=0;v<vars;v++)
+  {
+   if (toPrev[v]!=-1) mem::Copy(FromVar(k,v),prev.FromVar(k,toPrev[v]),msgBytes);
+  }
+ }
+}
+
+void GridGraph::Run(time::Progress * prog)
+{
+ LogBlock("void GridGraph::Run(...)","{iters,tolerance}" << LogDiv() << iters << LogDiv() << tolerance);
+ prog->Push();
+
+ bit measure = (tolerance>0.0)||(monitor!=null<LoopyMonitor*>());
+ nat64 perIter = 0;
+ for (nat32 s=0;s<sets.Size();s++) perIter += nat64(sets[s].instances)*nat64(sets[s].links);
+
+ itersDone = 0;
+ lastResidual = 0.0;
+ for (nat32 i=0;i<iters;i++)
+ {
+  prog->Report(i,iters);
+  real32 change = 0.0;
+
+  // Each colour in turn - the factors send to it, then its variables update.
+  // Unary messages don't depend on anything so only need sending once...
+   for (nat32 c=0;c<2;c++)
+   {
+    SendFuncs sf(*this,c,i==0,measure);
+    mt::ParallelFor(nat32(0),spans.Size(),sf,16);
+    change = math::Max(change,sf.Change());
+
+    SendVars sv(*this,c);
+    mt::ParallelFor(nat32(0),height,sv,4);
+   }
+
+  itersDone = i+1;
+  lastResidual = change;
+  if (monitor) monitor->Iteration(i,change,perIter*nat64(i+1));
+  if ((tolerance>0.0)&&(change<tolerance)) break;
+ }
+
+ prog->Pop();
+}
+
+void GridGraph::GetProb(nat32 var,void * out) const
+{
+ if (doMS)
+ {
+  mc.FlatlineLn(mc,out);
+  for (nat32 k=0;k<slots;k++) mc.InplaceAdd(mc,out,ToVar(k,var));
+  mc.Drop(mc,out);
+  mc.FromNegLn(mc,out);
+ }
+ else
+ {
+  mc.Flatline(mc,out);
+  for (nat32 k=0;k<slots;k++) mc.InplaceMult(mc,out,ToVar(k,var));
+  mc.Norm(mc,out);
+ }
+}
+
+nat64 GridGraph::Memory() const
+{
+ nat64 ret = sizeof(*this);
+ ret += sets.Size()*sizeof(Set);
+ ret += spans.Size()*sizeof(Span);
+ for (nat32 s=0;s<sets.Size();s++)
+ {
+  if (sets[s].linkVar) ret += sets[s].instances*sets[s].links*sizeof(nat32);
+ }
+ if (data) ret += 2*nat64(slots)*planeBytes;
+ return ret;
+}
+
+bit GridGraph::Check(nat32 s,ds::Array<nat32> & seen)
+{
+ Set & set = sets[s];
+
+ // The messages must all be of the grids type...
+  for (nat32 l=0;l<set.links;l++)
+  {
+   set.func->LinkType(l,set.mc[l]);
+   if (set.mc[l]!=mc) return false;
+  }
+
+ // Every link must be made, to a variable that exists, with a constant
+ // offset, which must be to the right or below, and only once per variable...
+  for (nat32 i=0;i<set.instances;i++)
+  {
+   nat32 * lv = set.linkVar + i*set.links;
+   for (nat32 l=0;l<set.links;l++)
+   {
+    if (lv[l]>=vars) return false;
+   }
+
+   nat32 low = 0;
+   nat32 delta = 0;
+   if (set.links==2)
+   {
+    low = (lv[0]<lv[1])?0:1;
+    delta = lv[1-low] - lv[low];
+    if (i==0)
+    {
+     set.low = low;
+     set.delta = delta;
+    }
+    if ((low!=set.low)||(delta!=set.delta)) return false;
+    if (delta!=width)
+    {
+     if ((delta!=1)||((lv[low]%width)+1==width)) return false;
+    }
+   }
+
+   if (seen[lv[low]]==set.slot) return false;
+   seen[lv[low]] = set.slot;
+  }
+
+ // Offsets for the message set...
+  for (nat32 l=0;l<set.links;l++)
+  {
+   set.in[l] = (set.slot+l)*planeBytes;
+   if (l!=set.low) set.in[l] += set.delta*msgBytes;
+   set.out[l] = set.in[l] + slots*planeBytes;
+  }
+
+ // Spans - a new one starts whenever the variables stop following on, or a
+ // row ends...
+  nat32 count = 0;
+  for (nat32 i=0;i<set.instances;i++)
+  {
+   nat32 v = set.linkVar[i*set.links + set.low];
+   if ((i==0)||(v!=set.linkVar[(i-1)*set.links + set.low]+1)||((v%width)==0)) ++count;
+  }
+
+  nat32 base = spans.Size();
+  spans.Size(base+count);
+  nat32 ind = base;
+  for (nat32 i=0;i<set.instances;i++)
+  {
+   nat32 v = set.linkVar[i*set.links + set.low];
+   if ((i==0)||(v!=set.linkVar[(i-1)*set.links + set.low]+1)||((v%width)==0))
+   {
+    if (i!=0) ++ind;
+    spans[ind].set = s;
+    spans[ind].inst = i;
+    spans[ind].var = v;
+    spans[ind].size = 0;
+   }
+   spans[ind].size += 1;
+  }
+
+ return true;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,207 @@
+#ifndef EOS_INF_GRID_GRAPHS_H
+#define EOS_INF_GRID_GRAPHS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file grid_graphs.h
+/// Provides a loopy belief propagation engine specialised for the most common
+/// case, a 4-connected grid of variables with unary and pairwise factors. It
+/// takes the same Function objects as the FactorGraph, but as the structure is
+/// known the messages live in planes indexed by variable, rather than being
+/// scattered in per-link storage, and the grid is solved with a checkerboard
+/// schedule. The FieldGraph uses it automatically when it can.
+
+#include "eos/types.h"
+
+#include "eos/inf/factor_graphs.h"
+#include "eos/ds/arrays.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace inf
+ {
+//------------------------------------------------------------------------------
+/// A loopy belief propagation solver for a width x height grid of variables,
+/// indexed y*width + x, which are all Frequency's with the same label count.
+/// Every function set must have either 1 link, a unary factor, or 2 links,
+/// where the variable of one is allways a constant offset of 1 (the neighbour
+/// to the right, never wrapping a row) or width (the neighbour below) from the
+/// other - the patterns of the fig_factors module that work on Grid2D are
+/// like this.
+/// Each variable can only be linked to once by each link of each function set.
+///
+/// Each link of each function set is a slot, and each slot has a plane of
+/// messages from the variables and a plane of messages to the variables, each
+/// a message per variable. Where a variable has no factor for a slot, at the
+/// edge of the grid, the message to it just stays flat, so updating variables
+/// needs no special cases.
+///
+/// As grids are bipartite, under the (x+y)%2 colouring, it alternates between
+/// the colours - first the factors send to the variables of one colour, which
+/// then update there messages, before the same for the other colour. Each
+/// iteration therefore sends every message once, for the same work as an
+/// iteration of the FactorGraph, but information moves twice as far. Both
+/// halves are split between the threads of the task pool, so, as with the
+/// FactorGraph, the Function objects have to be safe to call at once.
+///
+/// It is used by building it and then calling Prepare, which checks that the
+/// structure really is a grid - if not it can be discarded and the functions
+/// given to a FactorGraph instead.
+class EOS_CLASS GridGraph
+{
+ public:
+  /// You give the mode, as for the FactorGraph, the grid size and the label
+  /// count of the variables.
+   GridGraph(bit ms,nat32 width,nat32 height,nat32 labels);
+
+  /// &nbsp;
+   ~GridGraph();
+
+
+  /// Sets the number of iterations, defaults to 1.
+   void SetIters(nat32 its) {iters = its;}
+
+  /// Sets the convergence tolerance, as for FactorGraph::SetTolerance.
+  /// Defaults to 0, which is off.
+   void SetTolerance(real32 tol) {tolerance = tol;}
+
+  /// Sets an object to be told about each iteration, or null for none, the
+  /// default. Not owned.
+   void SetMonitor(LoopyMonitor * mon) {monitor = mon;}
+
+
+  /// Adds a set of function instances, returning its index, which go up from
+  /// 0 as for FactorGraph::MakeFuncs. Unlike the FactorGraph it is not owned
+  /// and not converted to the mode until Prepare succeeds.
+   nat32 MakeFuncs(Function * func,nat32 instances);
+
+  /// Sets the variable that a link of a function instance goes to.
+   void MakeLink(nat32 function,nat32 instance,nat32 link,nat32 var);
+
+  /// Call once all functions and links have been given. Returns true if the
+  /// structure is a grid this can solve, in which case it now owns the
+  /// functions and the messages are allocated and flatlined. Returns false
+  /// otherwise, in which case the functions are untouched and still belong
+  /// to the caller - this object is then only fit for deletion.
+   bit Prepare();
+
+
+  /// Returns how many slots, function set links, there are. Only valid after
+  /// Prepare.
+   nat32 Slots() const {return slots;}
+
+  /// Copys the messages from the variables of another, smaller, grid with the
+  /// same slots, as is done between the levels of a FieldGraph. toPrev gives
+  /// for each variable of this grid the variable of the other to copy from,
+  /// or -1 to leave it flat. Does nothing if the slots do not match.
+   void Transfer(const GridGraph & prev,const ds::Array<int32> & toPrev);
+
+
+  /// Solves, iterating until the iterations run out or the tolerance is met.
+   void Run(time::Progress * prog = null<time::Progress*>());
+
+  /// After Run returns how many iterations were done.
+   nat32 ItersDone() const {return itersDone;}
+
+  /// After Run returns the largest message change in the last iteration, if
+  /// measured due to a tolerance or monitor, otherwise 0.
+   real32 Residual() const {return lastResidual;}
+
+  /// Writes the final distribution of a variable, as probabilities, into out,
+  /// which must be the size of a message. For min-sum the result is converted
+  /// with FromNegLn, as FactorGraph::FromNegLn does.
+   void GetProb(nat32 var,void * out) const;
+
+
+  /// Returns how many bytes this object is using, for the messages and
+  /// structure but not the data of the functions.
+   nat64 Memory() const;
+
+
+  /// &nbsp;
+   static cstrconst TypeString() {return "eos::inf::GridGraph";}
+
+
+ private:
+  bit doMS;
+  nat32 width;
+  nat32 height;
+  nat32 vars;
+  MessageClass mc;
+  nat32 msgBytes;
+
+  nat32 iters;
+  real32 tolerance;
+  LoopyMonitor * monitor;
+  nat32 itersDone;
+  real32 lastResidual;
+  bit owned;
+
+  // A sequence of function instances in a row of the grid, where each
+  // instance links to the variable after the previous...
+   struct Span
+   {
+    nat32 set; // Function set it belongs to.
+    nat32 inst; // First instance.
+    nat32 var; // Variable of the lower link of the first instance.
+    nat32 size; // Number of instances.
+   };
+
+  // Everything about a function set...
+   struct Set
+   {
+    Function * func;
+    nat32 instances;
+    nat32 links; // 1 or 2.
+    nat32 slot; // Slot of link 0, link 1 if it exists is the next slot.
+    nat32 low; // The link with the lower variable index.
+    nat32 delta; // How much higher the variable of the other link is.
+
+    MessageClass mc[2];
+    nat32 in[2]; // Offsets from the message of the low variable in plane 0.
+    nat32 out[2];
+
+    nat32 * linkVar; // Until Prepare, which variable each link goes to, indexed inst*links + link. new[]'ed.
+   };
+
+  ds::Array<Set> sets;
+  ds::Array<Span> spans;
+
+  nat32 slots;
+  nat64 planeBytes;
+  byte * data; // 2*slots planes, the from variable planes then the to variable planes.
+
+  // Helpers...
+   byte * FromVar(nat32 slot,nat32 var) const {return data + slot*planeBytes + var*msgBytes;}
+   byte * ToVar(nat32 slot,nat32 var) const {return data + (slots+slot)*planeBytes + var*msgBytes;}
+   nat32 Colour(nat32 var) const {return ((var%width) + (var/width))&1;}
+
+  // Checks a function set is a grid, filling in its details and adding its
+  // spans, returns false if not...
+   bit Check(nat32 s,ds::Array<nat32> & seen);
+
+  // The two halves of sending to one colour, functors for the task pool...
+   class SendFuncs;
+   class SendVars;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -20,6 +20,8 @@
 #include "eos/math/functions.h"
 #include "eos/ds/arrays.h"
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
+#include "eos/log/profile.h"
 
 namespace eos
 {
@@ -82,14 +84,46 @@ void ModelSeg::SetMult(nat32 x,nat32 y,real32 mx,real32 my)
  diffCostMult.Get(x,y).my = my;
 }
 
+// Does the message passing for a range of bands, each band with its own
+// packer...
+class ModelSeg::PassBands
+{
+ public:
+  PassBands(ModelSeg & s,ds::Array2D<Node> & ind,nat32 i,ds::ArrayDel< mem::StackPtr<mem::Packer> > & a)
+  :self(s),index(ind),iter(i),alloc(a) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 b=begin;b<end;b++)
+   {
+    alloc[b]->Rewind();
+    nat32 y0 = b*bandRows;
+    nat32 y1 = math::Min(y0+bandRows,index.Height());
+    self.PassMessages(index,iter,y0,y1,*alloc[b]);
+   }
+  }
+
+
+ private:
+  ModelSeg & self;
+  ds::Array2D<Node> & index;
+  nat32 iter;
+  ds::ArrayDel< mem::StackPtr<mem::Packer> > & alloc;
+};
+
 void ModelSeg::Run(time::Progress * prog)
 {
  LogBlock("eos::inf::ModelSeg::Run","");
  prog->Push();
 
+ // Each of the three phases is recorded with the profiler, if on...
+  log::Profiler & prof = log::DefaultProfiler();
+  bit profile = prof.Enabled();
+
 
  // Construct the index hierachy...
   prog->Report(0,3);
+  if (profile) prof.Enter("eos::inf::ModelSeg::Run setup");
   prog->Push();
   prog->Report(0,5);
   nat32 levels = math::Max(math::TopBit(width),math::TopBit(height));
@@ -307,6 +341,7 @@ void ModelSeg::Run(time::Progress * prog)
 
  // Iterate through the levels passing messages, and transfering from each layer to the one below...
   prog->Report(1,3);
+  if (profile) {prof.Leave(); prof.Enter("eos::inf::ModelSeg::Run passing");}
   ds::ArrayDel< mem::StackPtr< mem::Packer > > msgA(ind.Size());
   ds::ArrayDel< mem::StackPtr< mem::Packer > > msgB(ind.Size());
   for (nat32 l=0;l<ind.Size();l++)
@@ -315,19 +350,32 @@ void ModelSeg::Run(time::Progress * prog)
    msgB[l] = new mem::Packer(blockSize);
   }
 
+  // The iterations happen in bands, each with its own pair of packers, again
+  // for each colour, which are shared by all levels. Blocks must be large
+  // enough for the biggest message...
+   nat32 bands = (height+bandRows-1)/bandRows;
+   nat32 bandBlock = math::Max(blockSize/16,nat32(2*(sizeof(Msg) + models*sizeof(ModCost)) + 64));
+   ds::ArrayDel< mem::StackPtr< mem::Packer > > bandA(bands);
+   ds::ArrayDel< mem::StackPtr< mem::Packer > > bandB(bands);
+   for (nat32 b=0;b<bands;b++)
+   {
+    bandA[b] = new mem::Packer(bandBlock);
+    bandB[b] = new mem::Packer(bandBlock);
+   }
+
   prog->Push();
   for (int32 l=int32(ind.Size()-1);l>=0;l--)
   {
    prog->Report(ind.Size()-1-l,ind.Size());
    prog->Push();
    
-   // Do the iterations...
+   // Do the iterations - the messages transfered from the level above stay
+   // in msgA[l] and msgB[l] until the level is done...
     for (nat32 i=0;i<iters;i++)
     {
      prog->Report(i,iters+1);
-     if (i&1) msgB[l]->Reset();
-         else msgA[l]->Reset();
-     PassMessages(ind[l],i,(i&1)?*msgB[l]:*msgA[l]);
+     PassBands pass(*this,ind[l],i,(i&1)?bandB:bandA);
+     mt::ParallelFor(nat32(0),(ind[l].Height()+bandRows-1)/bandRows,pass);
     }
 
 
@@ -349,6 +397,7 @@ void ModelSeg::Run(time::Progress * prog)
 
  // Extract the final result...
   prog->Report(2,3);
+  if (profile) {prof.Leave(); prof.Enter("eos::inf::ModelSeg::Run extract");}
   out.Resize(ind[0].Width(),ind[0].Height());
   prog->Push();
   for (nat32 y=0;y<out.Height();y++)
@@ -451,6 +500,7 @@ void ModelSeg::Run(time::Progress * prog)
   prog->Pop();
 
 
+ if (profile) prof.Leave();
  prog->Pop();
 }
 
@@ -685,11 +735,11 @@ void ModelSeg::TransferMsgDown(ds::Array2D<Node> & from,ds::Array2D<Node> & to,
  }
 }
 
-void ModelSeg::PassMessages(ds::Array2D<Node> & index,nat32 iter,mem::Packer & alloc)
+void ModelSeg::PassMessages(ds::Array2D<Node> & index,nat32 iter,nat32 y0,nat32 y1,mem::Packer & alloc)
 {
  LogTime("eos::inf::ModelSeg::PassMessages");
  // Iterate the checkboard and each direction on it where a message should be sent...
-  for (nat32 y=0;y<index.Height();y++)
+  for (nat32 y=y0;y<y1;y++)
   {
    for (nat32 x=(y+iter)%2;x<index.Width();x+=2)
    {
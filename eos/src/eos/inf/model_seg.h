@@ -48,6 +48,11 @@ namespace eos
 /// label. It then dynamically decides which labels are worth storing for each
 /// node to minimise memory consumption. The entire algorithm is implimented as
 /// a hideous data rewrite system basically.
+///
+/// Each round of message passing is split into bands of rows which are shared
+/// between the threads of the task pool, each band with its own allocators,
+/// which keep there memory from one round to the next. The phases of Run are
+/// recorded with the log::Profiler when its enabled.
 class EOS_CLASS ModelSeg
 {
  public:
@@ -113,6 +118,7 @@ class EOS_CLASS ModelSeg
 
  private:
   static const nat32 blockSize = 4*1024*1024; // Block size used by the assortment of memory allocators.
+  static const nat32 bandRows = 16; // Rows per band when passing messages.
  
   // Input...
    nat32 width;
@@ -205,13 +211,17 @@ class EOS_CLASS ModelSeg
     void TransferMsgDown(ds::Array2D<Node> & from,ds::Array2D<Node> & to,
                          mem::Packer & allocA,mem::Packer & allocB);
 
-   // Does a single round of message passing. iter is the iteration number, and
-   // is used to indicate whether to use black or white squares on the giant 
-   // chess board via its lowest bit. It will create new incomming messages for
-   // all nodes of the other colour, hence the packer.
-   // Calls of this will alternate in which packer is used, to allow memory to
-   // be freed when overwritten by a latter message pass.
-    void PassMessages(ds::Array2D<Node> & index,nat32 iter,mem::Packer & alloc);
+   // Does a single round of message passing, for the rows [y0,y1). iter is
+   // the iteration number, and is used to indicate whether to use black or
+   // white squares on the giant chess board via its lowest bit. It will create
+   // new incomming messages for all nodes of the other colour, hence the
+   // packer. Calls of this will alternate in which packer is used, to allow
+   // memory to be reused when overwritten by a latter message pass. Different
+   // rows can be done at once, as long as they have there own packers.
+    void PassMessages(ds::Array2D<Node> & index,nat32 iter,nat32 y0,nat32 y1,mem::Packer & alloc);
+
+   // Functor for the task pool, does PassMessages for a range of bands...
+    class PassBands;
 };
 
 //------------------------------------------------------------------------------
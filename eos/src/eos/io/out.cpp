@@ -17,8 +17,332 @@
 
 #include "eos/io/out.h"
 
+#include <string.h>
+#include <math.h>
+
+namespace eos
+{
+ namespace io
+ {
+//------------------------------------------------------------------------------
+// The shortest round trip formatting is the free-format algorithm of Steele &
+// White, as refined by Burger & Dybvig, done with exact integer arithmetic on
+// fixed size big numbers, so it is always correct and never allocates. The
+// numbers are big enough for any real64, scaled by 10 during digit generation.
+class RealBig
+{
+ public:
+  RealBig():size(0) {}
+  
+  void Set(nat64 v)
+  {
+   size = 0;
+   while (v!=0) {word[size++] = nat32(v); v >>= 32;}
+  }
+  
+  void MulSmall(nat32 m)
+  {
+   nat64 carry = 0;
+   for (nat32 i=0;i<size;i++)
+   {
+    carry += nat64(word[i])*m;
+    word[i] = nat32(carry);
+    carry >>= 32;
+   }
+   if (carry!=0) word[size++] = nat32(carry);
+  }
+  
+  void MulPow10(nat32 p)
+  {
+   static const nat32 pow10[10] = {1,10,100,1000,10000,100000,1000000,10000000,100000000,1000000000};
+   while (p>=9) {MulSmall(pow10[9]); p -= 9;}
+   if (p!=0) MulSmall(pow10[p]);
+  }
+  
+  void ShiftLeft(nat32 bits)
+  {
+   if (size==0) return;
+   nat32 words = bits/32;
+   bits %= 32;
+   
+   if (bits!=0)
+   {
+    nat32 top = word[size-1]>>(32-bits);
+    for (nat32 i=size-1;i>0;i--) word[i] = (word[i]<<bits) | (word[i-1]>>(32-bits));
+    word[0] <<= bits;
+    if (top!=0) word[size++] = top;
+   }
+   
+   if (words!=0)
+   {
+    for (nat32 i=size;i>0;i--) word[i-1+words] = word[i-1];
+    for (nat32 i=0;i<words;i++) word[i] = 0;
+    size += words;
+   }
+  }
+  
+  // Subtracts, requires that this>=rhs.
+   void Sub(const RealBig & rhs)
+   {
+    nat64 borrow = 0;
+    for (nat32 i=0;i<size;i++)
+    {
+     nat64 r = (i<rhs.size)?rhs.word[i]:0;
+     nat64 v = nat64(word[i]) - r - borrow;
+     word[i] = nat32(v);
+     borrow = (v>>32)&1;
+    }
+    while ((size!=0)&&(word[size-1]==0)) --size;
+   }
+  
+  // Returns -1, 0 or 1 as a is less than, equal to or greater than b.
+   static int32 Compare(const RealBig & a,const RealBig & b)
+   {
+    if (a.size!=b.size) return (a.size<b.size)?-1:1;
+    for (nat32 i=a.size;i>0;i--)
+    {
+     if (a.word[i-1]!=b.word[i-1]) return (a.word[i-1]<b.word[i-1])?-1:1;
+    }
+    return 0;
+   }
+   
+  // Compares a+b with c.
+   static int32 CompareSum(const RealBig & a,const RealBig & b,const RealBig & c)
+   {
+    RealBig sum;
+    nat32 n = (a.size>b.size)?a.size:b.size;
+    nat64 carry = 0;
+    for (nat32 i=0;i<n;i++)
+    {
+     carry += nat64((i<a.size)?a.word[i]:0) + nat64((i<b.size)?b.word[i]:0);
+     sum.word[i] = nat32(carry);
+     carry >>= 32;
+    }
+    sum.size = n;
+    if (carry!=0) sum.word[sum.size++] = nat32(carry);
+    return Compare(sum,c);
+   }
+   
+  // Sets this to this mod div, returning this div div, which must be <10. The
+  // quotient is estimated from the top words, which can only be low, then
+  // corrected...
+   nat32 DivMod(const RealBig & div)
+   {
+    nat32 ret = 0;
+    if ((div.size!=0)&&(size>=div.size))
+    {
+     nat32 n = div.size;
+     nat64 top = word[n-1];
+     if (size>n) top |= nat64(word[n])<<32;
+     ret = nat32(top/(nat64(div.word[n-1])+1));
+     if (ret!=0)
+     {
+      nat64 carry = 0;
+      nat64 borrow = 0;
+      for (nat32 i=0;i<size;i++)
+      {
+       if (i<n) carry += nat64(div.word[i])*ret;
+       nat64 v = nat64(word[i]) - nat64(nat32(carry)) - borrow;
+       word[i] = nat32(v);
+       borrow = (v>>32)&1;
+       carry >>= 32;
+      }
+      while ((size!=0)&&(word[size-1]==0)) --size;
+     }
+    }
+    while (Compare(*this,div)>=0) {Sub(div); ++ret;}
+    return ret;
+   }
+
+
+ private:
+  nat32 size;
+  nat32 word[40];
+};
+
 //------------------------------------------------------------------------------
+// Works out the digits for the value f*2^e, where f has p bits of precision and
+// minExp is the exponent of the denormals. Returns the number of digits, with
+// the value being 0.digits * 10^k...
+static nat32 ShortestDigits(nat64 f,int32 e,nat32 p,int32 minExp,cstr digit,int32 & k)
+{
+ bit even = (f&1)==0;
+ bit asym = (f==(nat64(1)<<(p-1)))&&(e!=minExp);
+
+ // Setup the numerator, denominator and the two half gaps to the neighbours,
+ // with everything doubled so its all integers...
+  RealBig r, s, mp, mm; // mm is only used when asym, otherwise its the same as mp.
+  if (e>=0)
+  {
+   r.Set(f); r.ShiftLeft(e + (asym?2:1));
+   s.Set(asym?4:2);
+   mp.Set(1); mp.ShiftLeft(e + (asym?1:0));
+   mm.Set(1); mm.ShiftLeft(e);
+  }
+  else
+  {
+   r.Set(f); r.ShiftLeft(asym?2:1);
+   s.Set(1); s.ShiftLeft(-e + (asym?2:1));
+   mp.Set(asym?2:1);
+   mm.Set(1);
+  }
+
+ // Estimate the decimal exponent, which can be one too low but never high...
+  int32 bits = 0;
+  for (nat64 t=f;t!=0;t>>=1) ++bits;
+  k = int32(::ceil((e + bits - 1)*0.30102999566398119521 - 1e-10));
+  
+  if (k>=0) s.MulPow10(k);
+  else
+  {
+   r.MulPow10(-k);
+   mp.MulPow10(-k);
+   if (asym) mm.MulPow10(-k);
+  }
+  
+  while (true)
+  {
+   int32 c = RealBig::CompareSum(r,mp,s);
+   if ((c>0)||(even&&(c==0))) {s.MulSmall(10); ++k;}
+                         else break;
+  }
+
+ // Generate digits until the remainder is inside the rounding interval...
+  nat32 ret = 0;
+  while (true)
+  {
+   r.MulSmall(10);
+   mp.MulSmall(10);
+   if (asym) mm.MulSmall(10);
+   nat32 d = r.DivMod(s);
+   
+   int32 cl = RealBig::Compare(r,asym?mm:mp);
+   int32 ch = RealBig::CompareSum(r,mp,s);
+   bit low = (cl<0)||(even&&(cl==0));
+   bit high = (ch>0)||(even&&(ch==0));
+   
+   if (!low && !high) {digit[ret++] = '0' + d; continue;}
+   
+   if (low && high)
+   {
+    RealBig r2 = r;
+    r2.ShiftLeft(1);
+    if (RealBig::Compare(r2,s)>=0) ++d;
+   }
+   else if (high) ++d;
+   digit[ret++] = '0' + d;
+   break;
+  }
+ 
+ return ret;
+}
+
+// Lays out digits with the given decimal exponent, as described for RealToCstr...
+static nat32 LayoutReal(bit neg,cstrconst digit,nat32 n,int32 k,cstr out)
+{
+ cstr targ = out;
+ if (neg) *targ++ = '-';
+ 
+ int32 exp = k - 1;
+ if ((exp>=-5)&&(exp<=15))
+ {
+  if (k<=0)
+  {
+   *targ++ = '0';
+   *targ++ = '.';
+   for (int32 i=0;i<-k;i++) *targ++ = '0';
+   for (nat32 i=0;i<n;i++) *targ++ = digit[i];
+  }
+  else if (nat32(k)>=n)
+  {
+   for (nat32 i=0;i<n;i++) *targ++ = digit[i];
+   for (nat32 i=n;i<nat32(k);i++) *targ++ = '0';
+  }
+  else
+  {
+   for (int32 i=0;i<k;i++) *targ++ = digit[i];
+   *targ++ = '.';
+   for (nat32 i=k;i<n;i++) *targ++ = digit[i];
+  }
+ }
+ else
+ {
+  *targ++ = digit[0];
+  if (n>1)
+  {
+   *targ++ = '.';
+   for (nat32 i=1;i<n;i++) *targ++ = digit[i];
+  }
+  *targ++ = 'e';
+  if (exp<0) {*targ++ = '-'; exp = -exp;}
+  nat32 size;
+  cstrchar buf[4];
+  cstr str = NatToCstr(nat32(exp),buf+4,size);
+  for (nat32 i=0;i<size;i++) *targ++ = str[i];
+ }
+ 
+ return targ - out;
+}
+
+static nat32 SpecialReal(bit neg,bit nan,cstr out)
+{
+ if (nan) {memcpy(out,"nan",3); return 3;}
+ if (neg) {memcpy(out,"-inf",4); return 4;}
+     else {memcpy(out,"inf",3); return 3;}
+}
+
+EOS_FUNC nat32 RealToCstr(real32 val,cstr out)
+{
+ nat32 bits;
+ memcpy(&bits,&val,4);
+ bit neg = (bits>>31)!=0;
+ nat32 exp = (bits>>23)&0xFF;
+ nat32 frac = bits&0x7FFFFF;
+ 
+ if (exp==0xFF) return SpecialReal(neg,frac!=0,out);
+ if ((exp==0)&&(frac==0))
+ {
+  if (neg) {memcpy(out,"-0",2); return 2;}
+  out[0] = '0'; return 1;
+ }
+ 
+ nat64 f;
+ int32 e;
+ if (exp==0) {f = frac; e = -149;}
+        else {f = frac | 0x800000; e = int32(exp) - 150;}
+
+ cstrchar digit[20];
+ int32 k;
+ nat32 n = ShortestDigits(f,e,24,-149,digit,k);
+ return LayoutReal(neg,digit,n,k,out);
+}
 
+EOS_FUNC nat32 RealToCstr(real64 val,cstr out)
+{
+ nat64 bits;
+ memcpy(&bits,&val,8);
+ bit neg = (bits>>63)!=0;
+ nat32 exp = nat32(bits>>52)&0x7FF;
+ nat64 frac = bits & ((nat64(1)<<52)-1);
+ 
+ if (exp==0x7FF) return SpecialReal(neg,frac!=0,out);
+ if ((exp==0)&&(frac==0))
+ {
+  if (neg) {memcpy(out,"-0",2); return 2;}
+  out[0] = '0'; return 1;
+ }
+ 
+ nat64 f;
+ int32 e;
+ if (exp==0) {f = frac; e = -1074;}
+        else {f = frac | (nat64(1)<<52); e = int32(exp) - 1075;}
 
+ cstrchar digit[20];
+ int32 k;
+ nat32 n = ShortestDigits(f,e,53,-1074,digit,k);
+ return LayoutReal(neg,digit,n,k,out);
+}
 
 //------------------------------------------------------------------------------
+ };
+};
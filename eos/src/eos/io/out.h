@@ -230,24 +230,59 @@ inline cstr IntToCstr(T val,cstr bufTop,nat32 & size)
  return bufTop;	
 }
 
-/// See IntToCstr, variant for natural numbers.
+/// See IntToCstr, variant for natural numbers. Does two digits per division.
 template <typename T>
 inline cstr NatToCstr(T val,cstr bufTop,nat32 & size)
 {
+ static const cstrchar pairs[] = "00010203040506070809"
+                                 "10111213141516171819"
+                                 "20212223242526272829"
+                                 "30313233343536373839"
+                                 "40414243444546474849"
+                                 "50515253545556575859"
+                                 "60616263646566676869"
+                                 "70717273747576777879"
+                                 "80818283848586878889"
+                                 "90919293949596979899";
  cstr start = bufTop;
 
- do
+ while (val>=100)
+ {
+  nat32 p = nat32(val%100)*2;
+  val = val/100;
+  bufTop -= 2;
+  bufTop[0] = pairs[p];
+  bufTop[1] = pairs[p+1];
+ }
+ 
+ if (val>=10)
+ {
+  nat32 p = nat32(val)*2;
+  bufTop -= 2;
+  bufTop[0] = pairs[p];
+  bufTop[1] = pairs[p+1];
+ }
+ else
  {
   --bufTop;
-  *bufTop = '0' + val%10;   
-  val = val/10;
+  *bufTop = '0' + cstrchar(val);
  }
- while (val!=0);
   
  size = start-bufTop;
  return bufTop;	
 }
 
+/// Writes the shortest decimal string that reads back as exactly the given
+/// value, e.g. 0.1f is written as 0.1 rather than the 0.100000001 you get from
+/// printing a fixed number of digits. Uses plain notation for exponents in
+/// [-5,15], otherwise scientific, e.g. 1.5e-7. Inf and nan come out as inf, 
+/// -inf and nan. Allocates nothing; out must have space for 32 characters. No
+/// null is written. Returns the number of characters written.
+EOS_FUNC nat32 RealToCstr(real32 val,cstr out);
+
+/// &nbsp;
+EOS_FUNC nat32 RealToCstr(real64 val,cstr out);
+
 //------------------------------------------------------------------------------
 // All the StreamWrite functions for the basic types, text versions...
 // Includes additional suport for character strings.
@@ -335,9 +370,7 @@ template <typename T>
 inline T & StreamWrite(T & lhs,real32 rhs,Text)
 {
  cstrchar str[32];
- cstrchar * targ = ::gcvt(rhs,8,str);
- while (*targ!=0) targ++;
- nat32 size = targ-str;
+ nat32 size = RealToCstr(rhs,str);
  lhs.SetError(lhs.Write(str,size)!=size);
  return lhs;
 }
@@ -346,9 +379,7 @@ template <typename T>
 inline T & StreamWrite(T & lhs,const real64 & rhs,Text)
 {
  cstrchar str[32];
- cstrchar * targ = ::gcvt(rhs,24,str);
- while (*targ!=0) targ++;
- nat32 size = targ-str;
+ nat32 size = RealToCstr(rhs,str);
  lhs.SetError(lhs.Write(str,size)!=size);	
  return lhs;
 }
@@ -16,6 +16,7 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "eos/log/logs.h"
+#include "eos/log/profile.h"
 
 #include "eos/time/times.h"
 #include "eos/file/csv.h"
@@ -304,19 +305,27 @@ EOS_VAR_DEF LogObj logger;
 
 //------------------------------------------------------------------------------
 BlockLogger::BlockLogger(cstrconst n,bit le)
-:name(n),logEnd(le)
+:name(n),logEnd(le),profiled(DefaultProfiler().Enabled())
 {
- real = time::UltraTime();
- time::ThreadTime(user,system);
+ if (profiled) DefaultProfiler().Enter(name);
+ else
+ {
+  real = time::UltraTime();
+  time::ThreadTime(user,system);
+ }
 }
 
 BlockLogger::~BlockLogger()
 {
- real64 endUser = 0.0,endSystem = 0.0;
- time::ThreadTime(endUser,endSystem);
- real64 endReal = time::UltraTime();
+ if (profiled) DefaultProfiler().Leave();
+ else
+ {
+  real64 endUser = 0.0,endSystem = 0.0;
+  time::ThreadTime(endUser,endSystem);
+  real64 endReal = time::UltraTime();
  
- logger.StoreBlock(name,endReal-real,endUser-user,endSystem-system); 
+  logger.StoreBlock(name,endReal-real,endUser-user,endSystem-system);
+ }
  
  if (logEnd)
  {
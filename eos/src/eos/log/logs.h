@@ -104,6 +104,7 @@ class EOS_CLASS BlockLogger
  private:
   cstrconst name;
   bit logEnd;
+  bit profiled; // true if its being recorded by DefaultProfiler() rather than StoreBlock.
 
   real64 real;
   real64 user;
@@ -161,6 +162,10 @@ class EOS_CLASS BlockLogger
 /// This is identical to LogBlock(n,p), except it does not log entry/exit of each block.
 /// This is more conveniant for profiling purposes where a log entry for each call 
 /// is too major a slow down/memory hog/profiling distorter.
+///
+/// When DefaultProfiler() is enabled, see profile.h, the time taken by both of
+/// these is recorded there instead of by the logger, which is thread safe and
+/// records the call tree rather than just totals.
 
 //------------------------------------------------------------------------------
 
@@ -0,0 +1,1007 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/log/profile.h"
+
+#include "eos/mem/alloc.h"
+#include "eos/mem/functions.h"
+#include "eos/mt/threads.h"
+#include "eos/time/times.h"
+#include "eos/ds/arrays.h"
+#include "eos/file/files.h"
+#include "eos/file/csv.h"
+#include "eos/math/functions.h"
+
+#include <math.h>
+
+namespace eos
+{
+ namespace log
+ {
+//------------------------------------------------------------------------------
+// A node of a threads call tree, node 0 is the root...
+struct ProfileNode
+{
+ cstrconst name;
+ nat32 parent;
+ nat32 child; // First child, 0 if none, as the root can't be a child.
+ nat32 sibling; // Next sibling, 0 if none.
+
+ nat32 calls;
+ real64 inclusive;
+ real64 children; // Time spent in child nodes.
+};
+
+// A completed block, as stored in the ring buffer...
+struct ProfileEvent
+{
+ cstrconst name;
+ nat32 depth;
+ real64 start;
+ real64 end;
+};
+
+// A counter of a thread...
+struct ProfileCounter
+{
+ cstrconst name;
+ nat64 count;
+};
+
+// A histogram of a thread, bucketed as ProfileReport::Histogram...
+struct ProfileHistogram
+{
+ nat64 count;
+ real64 sum;
+ real64 min;
+ real64 max;
+ nat64 bucket[ProfileReport::histBuckets];
+};
+
+// Everything recorded by a single thread. Only ever touched by that thread,
+// except when being reset or merged...
+class ProfileThread
+{
+ public:
+  ProfileThread(nat32 rs,nat32 ind)
+  :index(ind),next(null<ProfileThread*>()),
+  nodeSize(16),nodeCount(1),node(mem::Malloc<ProfileNode>(16)),current(0),
+  stackSize(16),depth(0),start(mem::Malloc<real64>(16)),
+  ringSize(rs),events(0),ring(mem::Malloc<ProfileEvent>(rs)),
+  counterSize(4),counterCount(0),counter(mem::Malloc<ProfileCounter>(4)),
+  tallySize(0),tally(null<nat64*>()),histSize(0),hist(null<ProfileHistogram*>())
+  {
+   Clear();
+  }
+
+ ~ProfileThread()
+  {
+   mem::Free(node);
+   mem::Free(start);
+   mem::Free(ring);
+   mem::Free(counter);
+   mem::Free(tally);
+   mem::Free(hist);
+  }
+
+  void Clear()
+  {
+   nodeCount = 1;
+   node[0].name = null<cstrconst>();
+   node[0].parent = 0;
+   node[0].child = 0;
+   node[0].sibling = 0;
+   node[0].calls = 0;
+   node[0].inclusive = 0.0;
+   node[0].children = 0.0;
+   current = 0;
+   depth = 0;
+   events = 0;
+   counterCount = 0;
+   for (nat32 i=0;i<tallySize;i++) tally[i] = 0;
+   for (nat32 i=0;i<histSize;i++) ClearHist(hist[i]);
+  }
+
+  void Enter(cstrconst name)
+  {
+   // Find the child of the current node with the given name, creating it if
+   // need be...
+    nat32 targ = node[current].child;
+    while ((targ!=0)&&(node[targ].name!=name)) targ = node[targ].sibling;
+    if (targ==0)
+    {
+     if (nodeCount==nodeSize)
+     {
+      nodeSize *= 2;
+      ProfileNode * nn = mem::Malloc<ProfileNode>(nodeSize);
+      for (nat32 i=0;i<nodeCount;i++) nn[i] = node[i];
+      mem::Free(node);
+      node = nn;
+     }
+
+     targ = nodeCount++;
+     node[targ].name = name;
+     node[targ].parent = current;
+     node[targ].child = 0;
+     node[targ].sibling = node[current].child;
+     node[targ].calls = 0;
+     node[targ].inclusive = 0.0;
+     node[targ].children = 0.0;
+     node[current].child = targ;
+    }
+
+   // Push it onto the stack, with the start time...
+    if (depth==stackSize)
+    {
+     stackSize *= 2;
+     real64 * ns = mem::Malloc<real64>(stackSize);
+     for (nat32 i=0;i<depth;i++) ns[i] = start[i];
+     mem::Free(start);
+     start = ns;
+    }
+    current = targ;
+    start[depth] = time::UltraTime();
+    ++depth;
+  }
+
+  void Leave()
+  {
+   if (depth==0) return; // Enter was called before a Reset.
+   real64 end = time::UltraTime();
+   --depth;
+   real64 taken = end - start[depth];
+
+   ProfileNode & targ = node[current];
+   targ.calls += 1;
+   targ.inclusive += taken;
+   node[targ.parent].children += taken;
+
+   ProfileEvent & ev = ring[events%ringSize];
+   ev.name = targ.name;
+   ev.depth = depth;
+   ev.start = start[depth];
+   ev.end = end;
+   ++events;
+
+   current = targ.parent;
+  }
+
+  void Count(cstrconst name,nat64 amount)
+  {
+   // Ushally only a handful, so a linear search by pointer is fine...
+    for (nat32 i=0;i<counterCount;i++)
+    {
+     if (counter[i].name==name) {counter[i].count += amount; return;}
+    }
+
+   if (counterCount==counterSize)
+   {
+    counterSize *= 2;
+    ProfileCounter * nc = mem::Malloc<ProfileCounter>(counterSize);
+    for (nat32 i=0;i<counterCount;i++) nc[i] = counter[i];
+    mem::Free(counter);
+    counter = nc;
+   }
+   counter[counterCount].name = name;
+   counter[counterCount].count = amount;
+   ++counterCount;
+  }
+
+  void Add(nat32 id,nat64 amount)
+  {
+   if (id>=tallySize)
+   {
+    nat32 ns = math::Max<nat32>(id+1,tallySize*2);
+    nat64 * nt = mem::Malloc<nat64>(ns);
+    for (nat32 i=0;i<tallySize;i++) nt[i] = tally[i];
+    for (nat32 i=tallySize;i<ns;i++) nt[i] = 0;
+    mem::Free(tally);
+    tally = nt;
+    tallySize = ns;
+   }
+   tally[id] += amount;
+  }
+
+  void Sample(nat32 id,real64 value)
+  {
+   if (id>=histSize)
+   {
+    nat32 ns = math::Max<nat32>(id+1,histSize*2);
+    ProfileHistogram * nh = mem::Malloc<ProfileHistogram>(ns);
+    for (nat32 i=0;i<histSize;i++) nh[i] = hist[i];
+    for (nat32 i=histSize;i<ns;i++) ClearHist(nh[i]);
+    mem::Free(hist);
+    hist = nh;
+    histSize = ns;
+   }
+
+   ProfileHistogram & targ = hist[id];
+   if ((targ.count==0)||(value<targ.min)) targ.min = value;
+   if ((targ.count==0)||(value>targ.max)) targ.max = value;
+   targ.count += 1;
+   targ.sum += value;
+
+   // frexp gives value = m*2^e with m in [0.5,1), so value is in [2^(e-1),2^e)...
+    nat32 b = 0;
+    if (value>=1.0)
+    {
+     int e;
+     frexp(value,&e);
+     b = math::Min<nat32>(nat32(e),ProfileReport::histBuckets-1);
+    }
+    targ.bucket[b] += 1;
+  }
+
+  static void ClearHist(ProfileHistogram & h)
+  {
+   h.count = 0;
+   h.sum = 0.0;
+   h.min = 0.0;
+   h.max = 0.0;
+   for (nat32 i=0;i<ProfileReport::histBuckets;i++) h.bucket[i] = 0;
+  }
+
+  nat32 index; // Order in which threads registered.
+  ProfileThread * next;
+
+  nat32 nodeSize;
+  nat32 nodeCount;
+  ProfileNode * node;
+  nat32 current;
+
+  nat32 stackSize;
+  nat32 depth;
+  real64 * start;
+
+  nat32 ringSize;
+  nat64 events; // Total recorded, the ring only has the last ringSize of them.
+  ProfileEvent * ring;
+
+  nat32 counterSize;
+  nat32 counterCount;
+  ProfileCounter * counter;
+
+  nat32 tallySize; // Counters by identifier, as registered with the Profiler.
+  nat64 * tally;
+
+  nat32 histSize; // Histograms by identifier.
+  ProfileHistogram * hist;
+};
+
+//------------------------------------------------------------------------------
+Profiler::Profiler(nat32 rs)
+:enabled(false),ringSize((rs==0)?1:rs),slot(new mt::ThreadSlot()),
+first(null<ProfileThread*>()),threads(0),
+counterIds(0),counterName(null<cstrconst*>()),histogramIds(0),histogramName(null<cstrconst*>())
+{}
+
+Profiler::~Profiler()
+{
+ while (first)
+ {
+  ProfileThread * victim = first;
+  first = first->next;
+  delete victim;
+ }
+ delete slot;
+ mem::Free(counterName);
+ mem::Free(histogramName);
+}
+
+void Profiler::Enter(cstrconst name)
+{
+ Current()->Enter(name);
+}
+
+void Profiler::Leave()
+{
+ Current()->Leave();
+}
+
+void Profiler::Count(cstrconst name,nat64 amount)
+{
+ if (enabled) Current()->Count(name,amount);
+}
+
+nat32 Profiler::CounterId(cstrconst name)
+{
+ lock.Lock();
+  nat32 ret = Register(name,counterIds,counterName);
+ lock.Unlock();
+ return ret;
+}
+
+nat32 Profiler::HistogramId(cstrconst name)
+{
+ lock.Lock();
+  nat32 ret = Register(name,histogramIds,histogramName);
+ lock.Unlock();
+ return ret;
+}
+
+void Profiler::Reset()
+{
+ lock.Lock();
+  ProfileThread * targ = first;
+  while (targ)
+  {
+   targ->Clear();
+   targ = targ->next;
+  }
+ lock.Unlock();
+}
+
+void Profiler::AddCurrent(nat32 id,nat64 amount)
+{
+ Current()->Add(id,amount);
+}
+
+void Profiler::SampleCurrent(nat32 id,real64 value)
+{
+ Current()->Sample(id,value);
+}
+
+nat32 Profiler::Register(cstrconst name,nat32 & ids,cstrconst *& names)
+{
+ for (nat32 i=0;i<ids;i++)
+ {
+  if (str::Compare(names[i],name)==0) return i;
+ }
+
+ cstrconst * nn = mem::Malloc<cstrconst>(ids+1);
+ for (nat32 i=0;i<ids;i++) nn[i] = names[i];
+ nn[ids] = name;
+ mem::Free(names);
+ names = nn;
+ return ids++;
+}
+
+ProfileThread * Profiler::Current()
+{
+ ProfileThread * ret = static_cast<ProfileThread*>(slot->Get());
+ if (ret==null<ProfileThread*>())
+ {
+  // First block of this thread - create its record. They are kept after the
+  // thread exits, so a thread pool can come and go without losing anything...
+   lock.Lock();
+    ret = new ProfileThread(ringSize,threads);
+    ++threads;
+    ret->next = first;
+    first = ret;
+   lock.Unlock();
+   slot->Set(ret);
+ }
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC Profiler & DefaultProfiler()
+{
+ static Profiler prof;
+ return prof;
+}
+
+//------------------------------------------------------------------------------
+// Helpers for the ProfileReport constructor...
+struct MergeNode
+{
+ cstrconst name;
+ nat32 child;
+ nat32 sibling;
+
+ nat32 calls;
+ real64 inclusive;
+ real64 children;
+};
+
+struct MergeTree
+{
+ MergeTree():size(16),count(1),node(mem::Malloc<MergeNode>(16))
+ {
+  node[0].name = null<cstrconst>();
+  node[0].child = 0;
+  node[0].sibling = 0;
+  node[0].calls = 0;
+  node[0].inclusive = 0.0;
+  node[0].children = 0.0;
+ }
+
+~MergeTree() {mem::Free(node);}
+
+ // Merges the children of node from of the given thread into node to of this...
+  void Merge(const ProfileThread & pt,nat32 from,nat32 to)
+  {
+   nat32 src = pt.node[from].child;
+   while (src!=0)
+   {
+    const ProfileNode & sn = pt.node[src];
+
+    nat32 targ = node[to].child;
+    while ((targ!=0)&&(str::Compare(node[targ].name,sn.name)!=0)) targ = node[targ].sibling;
+    if (targ==0)
+    {
+     if (count==size)
+     {
+      size *= 2;
+      MergeNode * nn = mem::Malloc<MergeNode>(size);
+      for (nat32 i=0;i<count;i++) nn[i] = node[i];
+      mem::Free(node);
+      node = nn;
+     }
+
+     targ = count++;
+     node[targ].name = sn.name;
+     node[targ].child = 0;
+     node[targ].sibling = 0;
+     node[targ].calls = 0;
+     node[targ].inclusive = 0.0;
+     node[targ].children = 0.0;
+
+     // Keep children in the order first seen, so the output is stable...
+      if (node[to].child==0) node[to].child = targ;
+      else
+      {
+       nat32 last = node[to].child;
+       while (node[last].sibling!=0) last = node[last].sibling;
+       node[last].sibling = targ;
+      }
+    }
+
+    node[targ].calls += sn.calls;
+    node[targ].inclusive += sn.inclusive;
+    node[targ].children += sn.children;
+
+    Merge(pt,src,targ);
+    src = sn.sibling;
+   }
+  }
+
+ // Writes the tree out in depth first order...
+  void Flatten(nat32 mn,nat32 parent,nat32 depth,ProfileReport::Node * out,nat32 & pos) const
+  {
+   nat32 index = pos++;
+   out[index].name = node[mn].name;
+   out[index].parent = parent;
+   out[index].depth = depth;
+   out[index].calls = node[mn].calls;
+   out[index].inclusive = node[mn].inclusive;
+   out[index].exclusive = node[mn].inclusive - node[mn].children;
+
+   nat32 targ = node[mn].child;
+   while (targ!=0)
+   {
+    Flatten(targ,index,depth+1,out,pos);
+    targ = node[targ].sibling;
+   }
+  }
+
+ nat32 size;
+ nat32 count;
+ MergeNode * node;
+};
+
+struct BlockByName
+{
+ static bit LessThan(const ProfileReport::Block & lhs,const ProfileReport::Block & rhs)
+ {
+  return str::Compare(lhs.name,rhs.name)<0;
+ }
+};
+
+struct BlockByCost
+{
+ static bit LessThan(const ProfileReport::Block & lhs,const ProfileReport::Block & rhs)
+ {
+  return lhs.exclusive>rhs.exclusive;
+ }
+};
+
+struct CounterByName
+{
+ static bit LessThan(const ProfileReport::Counter & lhs,const ProfileReport::Counter & rhs)
+ {
+  return str::Compare(lhs.name,rhs.name)<0;
+ }
+};
+
+struct HistogramByName
+{
+ static bit LessThan(const ProfileReport::Histogram & lhs,const ProfileReport::Histogram & rhs)
+ {
+  return str::Compare(lhs.name,rhs.name)<0;
+ }
+};
+
+struct MemTagByPeak
+{
+ static bit LessThan(const mem::MemTagStats & lhs,const mem::MemTagStats & rhs)
+ {
+  return lhs.peak>rhs.peak;
+ }
+};
+
+struct EventOrder
+{
+ static bit LessThan(const ProfileReport::Event & lhs,const ProfileReport::Event & rhs)
+ {
+  if (lhs.thread!=rhs.thread) return lhs.thread<rhs.thread;
+  if (lhs.start<rhs.start) return true;
+  if (rhs.start<lhs.start) return false;
+  return lhs.depth<rhs.depth;
+ }
+};
+
+// Returns the index of the block with the given name, which must exist, from
+// an array sorted by name...
+nat32 FindBlock(const ProfileReport::Block * block,nat32 blocks,cstrconst name)
+{
+ nat32 low = 0;
+ nat32 high = blocks;
+ while (high-low>1)
+ {
+  nat32 mid = (low+high)/2;
+  if (str::Compare(name,block[mid].name)<0) high = mid;
+                                       else low = mid;
+ }
+ return low;
+}
+
+//------------------------------------------------------------------------------
+ProfileReport::ProfileReport(const Profiler & prof)
+:nodes(0),node(null<Node*>()),blocks(0),block(null<Block*>()),
+counters(0),counter(null<Counter*>()),histograms(0),histogram(null<Histogram*>()),
+memTracked(false),memThreads(0),memThread(null<mem::MemStats*>()),memTags(0),memTag(null<mem::MemTagStats*>()),
+events(0),event(null<Event*>())
+{
+ Profiler & self = const_cast<Profiler&>(prof);
+ self.lock.Lock();
+
+ // Merge the call trees of all the threads...
+  MergeTree tree;
+  ProfileThread * targ = prof.first;
+  while (targ)
+  {
+   tree.Merge(*targ,0,0);
+   targ = targ->next;
+  }
+
+  nat32 rc = tree.node[0].child;
+  while (rc!=0)
+  {
+   tree.node[0].inclusive += tree.node[rc].inclusive;
+   tree.node[0].children += tree.node[rc].inclusive;
+   rc = tree.node[rc].sibling;
+  }
+
+  nodes = tree.count;
+  node = mem::Malloc<Node>(nodes);
+  nat32 pos = 0;
+  tree.Flatten(0,0,0,node,pos);
+
+
+ // Copy out the events, in a sensible order...
+  targ = prof.first;
+  while (targ)
+  {
+   events += nat32((targ->events<targ->ringSize)?targ->events:targ->ringSize);
+   targ = targ->next;
+  }
+
+  ds::Array<Counter> co;
+  targ = prof.first;
+  while (targ)
+  {
+   for (nat32 i=0;i<targ->counterCount;i++)
+   {
+    co.Size(co.Size()+1);
+    co[co.Size()-1].name = targ->counter[i].name;
+    co[co.Size()-1].count = targ->counter[i].count;
+   }
+   for (nat32 i=0;i<targ->tallySize;i++)
+   {
+    if (targ->tally[i]==0) continue;
+    co.Size(co.Size()+1);
+    co[co.Size()-1].name = prof.counterName[i];
+    co[co.Size()-1].count = targ->tally[i];
+   }
+   targ = targ->next;
+  }
+
+ // Sum the histograms, which are already in identifier order...
+  ds::Array<Histogram> hi(prof.histogramIds);
+  for (nat32 i=0;i<hi.Size();i++)
+  {
+   hi[i].name = prof.histogramName[i];
+   hi[i].count = 0;
+   hi[i].sum = 0.0;
+   hi[i].min = 0.0;
+   hi[i].max = 0.0;
+   for (nat32 b=0;b<histBuckets;b++) hi[i].bucket[b] = 0;
+  }
+
+  targ = prof.first;
+  while (targ)
+  {
+   for (nat32 i=0;i<targ->histSize;i++)
+   {
+    const ProfileHistogram & from = targ->hist[i];
+    if (from.count==0) continue;
+    Histogram & to = hi[i];
+    if ((to.count==0)||(from.min<to.min)) to.min = from.min;
+    if ((to.count==0)||(from.max>to.max)) to.max = from.max;
+    to.count += from.count;
+    to.sum += from.sum;
+    for (nat32 b=0;b<histBuckets;b++) to.bucket[b] += from.bucket[b];
+   }
+   targ = targ->next;
+  }
+
+  ds::Array<Event> ev(events);
+  pos = 0;
+  targ = prof.first;
+  while (targ)
+  {
+   nat32 count = nat32((targ->events<targ->ringSize)?targ->events:targ->ringSize);
+   for (nat32 i=0;i<count;i++)
+   {
+    const ProfileEvent & pe = targ->ring[nat32((targ->events-count+i)%targ->ringSize)];
+    ev[pos].name = pe.name;
+    ev[pos].thread = targ->index;
+    ev[pos].depth = pe.depth;
+    ev[pos].start = pe.start;
+    ev[pos].end = pe.end;
+    ++pos;
+   }
+   targ = targ->next;
+  }
+
+ self.lock.Unlock();
+
+ if (events!=0) ev.Sort<EventOrder>();
+ event = mem::Malloc<Event>(events);
+ for (nat32 i=0;i<events;i++) event[i] = ev[i];
+
+
+ // Collate the block statistics, by name...
+  ds::Array<Block> bl(nodes);
+  for (nat32 i=1;i<nodes;i++)
+  {
+   bl[i-1].name = node[i].name;
+   bl[i-1].calls = node[i].calls;
+   bl[i-1].exclusive = node[i].exclusive;
+  }
+  bl.Size(nodes-1);
+
+  if (bl.Size()!=0)
+  {
+   bl.Sort<BlockByName>();
+   for (nat32 i=0;i<bl.Size();i++)
+   {
+    if ((blocks!=0)&&(str::Compare(bl[blocks-1].name,bl[i].name)==0))
+    {
+     bl[blocks-1].calls += bl[i].calls;
+     bl[blocks-1].exclusive += bl[i].exclusive;
+    }
+    else
+    {
+     bl[blocks] = bl[i];
+     bl[blocks].samples = 0;
+     ++blocks;
+    }
+   }
+  }
+
+
+ // Bucket the event durations by block, so the percentiles can be found...
+  ds::Array<nat32> which(events);
+  for (nat32 i=0;i<events;i++)
+  {
+   which[i] = FindBlock(bl.Ptr(),blocks,event[i].name);
+   bl[which[i]].samples += 1;
+  }
+
+  ds::Array<nat32> offset(blocks+1);
+  offset[0] = 0;
+  for (nat32 i=0;i<blocks;i++) offset[i+1] = offset[i] + bl[i].samples;
+
+  ds::Array<real64> taken(events);
+  ds::Array<nat32> fill(blocks);
+  for (nat32 i=0;i<blocks;i++) fill[i] = offset[i];
+  for (nat32 i=0;i<events;i++)
+  {
+   taken[fill[which[i]]] = event[i].end - event[i].start;
+   fill[which[i]] += 1;
+  }
+
+  for (nat32 i=0;i<blocks;i++)
+  {
+   Block & b = bl[i];
+   if (b.samples==0)
+   {
+    b.p50 = 0.0;
+    b.p90 = 0.0;
+    b.p99 = 0.0;
+    b.max = 0.0;
+   }
+   else
+   {
+    nat32 base = offset[i];
+    taken.SortRangeNorm(base,base+b.samples-1);
+    b.p50 = taken[base + nat32(0.50*real64(b.samples-1))];
+    b.p90 = taken[base + nat32(0.90*real64(b.samples-1))];
+    b.p99 = taken[base + nat32(0.99*real64(b.samples-1))];
+    b.max = taken[base + b.samples-1];
+   }
+  }
+
+  bl.Size(blocks);
+  if (blocks!=0) bl.Sort<BlockByCost>();
+  block = mem::Malloc<Block>(blocks);
+  for (nat32 i=0;i<blocks;i++) block[i] = bl[i];
+
+
+ // Merge the counters by name...
+  if (co.Size()!=0) co.Sort<CounterByName>();
+  counter = mem::Malloc<Counter>(co.Size());
+  for (nat32 i=0;i<co.Size();i++)
+  {
+   if ((counters!=0)&&(str::Compare(counter[counters-1].name,co[i].name)==0))
+   {
+    counter[counters-1].count += co[i].count;
+   }
+   else
+   {
+    counter[counters] = co[i];
+    ++counters;
+   }
+  }
+
+
+ // Keep the histograms that got anything, by name...
+  nat32 used = 0;
+  for (nat32 i=0;i<hi.Size();i++)
+  {
+   if (hi[i].count!=0) hi[used++] = hi[i];
+  }
+  hi.Size(used);
+  if (used!=0) hi.Sort<HistogramByName>();
+
+  histograms = used;
+  histogram = mem::Malloc<Histogram>(histograms);
+  for (nat32 i=0;i<histograms;i++) histogram[i] = hi[i];
+
+
+ // Snapshot the memory statistics...
+  memTracked = mem::TrackingMemory()||(mem::MemThreads()!=0);
+  if (memTracked)
+  {
+   mem::GetMemStats(memory);
+
+   memThreads = mem::MemThreads();
+   memThread = mem::Malloc<mem::MemStats>(memThreads);
+   for (nat32 i=0;i<memThreads;i++) mem::GetMemStats(i,memThread[i]);
+
+   ds::Array<mem::MemTagStats> mt(mem::MemTags());
+   for (nat32 i=0;i<mt.Size();i++) mem::GetMemTag(i,mt[i]);
+   if (mt.Size()!=0) mt.Sort<MemTagByPeak>();
+
+   memTags = mt.Size();
+   memTag = mem::Malloc<mem::MemTagStats>(memTags);
+   for (nat32 i=0;i<memTags;i++) memTag[i] = mt[i];
+  }
+  else mem::Null(&memory);
+}
+
+ProfileReport::~ProfileReport()
+{
+ mem::Free(node);
+ mem::Free(block);
+ mem::Free(counter);
+ mem::Free(histogram);
+ mem::Free(memThread);
+ mem::Free(memTag);
+ mem::Free(event);
+}
+
+bit ProfileReport::WriteCsv(cstrconst fn) const
+{
+ file::Csv out(fn,true);
+ if (!out.Active()) return false;
+
+ out << "node" << file::EndField()
+     << "parent" << file::EndField()
+     << "depth" << file::EndField()
+     << "block" << file::EndField()
+     << "calls" << file::EndField()
+     << "inclusive" << file::EndField()
+     << "exclusive" << file::EndField()
+     << "inclusive mean" << file::EndRow();
+
+ for (nat32 i=1;i<nodes;i++)
+ {
+  const Node & targ = node[i];
+  out << i << file::EndField()
+      << targ.parent << file::EndField()
+      << targ.depth << file::EndField()
+      << targ.name << file::EndField()
+      << targ.calls << file::EndField()
+      << targ.inclusive << file::EndField()
+      << targ.exclusive << file::EndField()
+      << ((targ.calls!=0)?(targ.inclusive/real64(targ.calls)):0.0) << file::EndRow();
+ }
+
+ out << file::EndRow();
+ out << "block" << file::EndField()
+     << "calls" << file::EndField()
+     << "exclusive" << file::EndField()
+     << "samples" << file::EndField()
+     << "p50" << file::EndField()
+     << "p90" << file::EndField()
+     << "p99" << file::EndField()
+     << "max" << file::EndRow();
+
+ for (nat32 i=0;i<blocks;i++)
+ {
+  const Block & targ = block[i];
+  out << targ.name << file::EndField()
+      << targ.calls << file::EndField()
+      << targ.exclusive << file::EndField()
+      << targ.samples << file::EndField()
+      << targ.p50 << file::EndField()
+      << targ.p90 << file::EndField()
+      << targ.p99 << file::EndField()
+      << targ.max << file::EndRow();
+ }
+
+ out << file::EndRow();
+ out << "counter" << file::EndField()
+     << "count" << file::EndRow();
+
+ for (nat32 i=0;i<counters;i++)
+ {
+  out << counter[i].name << file::EndField()
+      << counter[i].count << file::EndRow();
+ }
+
+ out << file::EndRow();
+ out << "histogram" << file::EndField()
+     << "count" << file::EndField()
+     << "mean" << file::EndField()
+     << "min" << file::EndField()
+     << "max" << file::EndField()
+     << "bucket low" << file::EndField()
+     << "bucket count" << file::EndRow();
+
+ for (nat32 i=0;i<histograms;i++)
+ {
+  // A row per non-empty bucket, the summary repeated so each row stands alone...
+   const Histogram & targ = histogram[i];
+   for (nat32 b=0;b<histBuckets;b++)
+   {
+    if (targ.bucket[b]==0) continue;
+    out << targ.name << file::EndField()
+        << targ.count << file::EndField()
+        << targ.Mean() << file::EndField()
+        << targ.min << file::EndField()
+        << targ.max << file::EndField()
+        << Histogram::BucketLow(b) << file::EndField()
+        << targ.bucket[b] << file::EndRow();
+   }
+ }
+
+ if (memTracked)
+ {
+  out << file::EndRow();
+  out << "memory" << file::EndField()
+      << "current" << file::EndField()
+      << "peak" << file::EndField()
+      << "allocs" << file::EndField()
+      << "frees" << file::EndField()
+      << "bytes" << file::EndRow();
+
+  out << "process" << file::EndField()
+      << memory.current << file::EndField()
+      << memory.peak << file::EndField()
+      << memory.allocs << file::EndField()
+      << memory.frees << file::EndField()
+      << memory.bytes << file::EndRow();
+
+  for (nat32 i=0;i<memThreads;i++)
+  {
+   const mem::MemStats & targ = memThread[i];
+   out << "thread " << i << file::EndField()
+       << targ.current << file::EndField()
+       << targ.peak << file::EndField()
+       << targ.allocs << file::EndField()
+       << targ.frees << file::EndField()
+       << targ.bytes << file::EndRow();
+  }
+
+  out << file::EndRow();
+  out << "memory tag" << file::EndField()
+      << "scopes" << file::EndField()
+      << "peak" << file::EndField()
+      << "allocs" << file::EndField()
+      << "bytes" << file::EndRow();
+
+  for (nat32 i=0;i<memTags;i++)
+  {
+   const mem::MemTagStats & targ = memTag[i];
+   out << targ.tag << file::EndField()
+       << targ.scopes << file::EndField()
+       << targ.peak << file::EndField()
+       << targ.allocs << file::EndField()
+       << targ.bytes << file::EndRow();
+  }
+ }
+
+ out.Flush();
+ return true;
+}
+
+// Writes a time in seconds as microseconds, with 3 decimal places, as gcvt
+// produces output that json readers don't always agree with...
+void WriteMicro(file::Cursor<io::Text> & out,real64 sec)
+{
+ if (sec<0.0) sec = 0.0;
+ nat64 ns = nat64(sec*1e9 + 0.5);
+ nat32 frac = nat32(ns%1000);
+ out << nat64(ns/1000) << ".";
+ if (frac<100) out << "0";
+ if (frac<10) out << "0";
+ out << frac;
+}
+
+bit ProfileReport::WriteTrace(cstrconst fn) const
+{
+ file::File<io::Text> f(fn,file::way_ow,file::mode_write);
+ if (!f.Active()) return false;
+ file::Cursor<io::Text> out = f.GetCursor();
+
+ real64 base = 0.0;
+ for (nat32 i=0;i<events;i++)
+ {
+  if ((i==0)||(event[i].start<base)) base = event[i].start;
+ }
+
+ out << "{\"traceEvents\":[\n";
+ for (nat32 i=0;i<events;i++)
+ {
+  const Event & targ = event[i];
+  out << "{\"name\":\"";
+  for (cstrconst c=targ.name;*c!=0;c++)
+  {
+   if ((*c=='"')||(*c=='\\')) out << "\\";
+   cstrchar ch[2] = {*c,0};
+   out << ch;
+  }
+  out << "\",\"cat\":\"eos\",\"ph\":\"X\",\"pid\":0,\"tid\":" << targ.thread << ",\"ts\":";
+  WriteMicro(out,targ.start-base);
+  out << ",\"dur\":";
+  WriteMicro(out,targ.end-targ.start);
+  out << "}";
+  if (i+1!=events) out << ",";
+  out << "\n";
+ }
+ out << "],\"displayTimeUnit\":\"ms\"}\n";
+
+ return !out.Error();
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,362 @@
+#ifndef EOS_LOG_PROFILE_H
+#define EOS_LOG_PROFILE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file profile.h
+/// An in memory profiler that sits behind the LogBlock(n,p)/LogTime(n) macros,
+/// as an alternative to the profiling done by the logger. Each thread records
+/// into its own buffers without any locking, building a call tree as it goes
+/// and keeping the most recent blocks in a ring buffer; a ProfileReport then
+/// merges the threads together and can be written out as a csv file or in the
+/// json format understood by the chrome://tracing viewer.
+///
+/// It also keeps counters and histograms, for the work done inside hot loops
+/// where blocks would cost too much, such as cost evaluations or messages
+/// passed. The LogCount(n,a) and LogSample(n,v) macros are the ushall way of
+/// using these, as they compile to nothing unless EOS_LOG_BLOCKS or
+/// EOS_LOG_COUNTERS is defined.
+
+#include "eos/types.h"
+#include "eos/mt/locks.h"
+#include "eos/mem/alloc.h"
+
+namespace eos
+{
+ namespace mt
+ {
+  class ThreadSlot;
+ }
+
+ namespace log
+ {
+//------------------------------------------------------------------------------
+// The per-thread data, defined in the .cpp...
+class ProfileThread;
+
+//------------------------------------------------------------------------------
+/// The profiler, you would ushally use the one provided by DefaultProfiler(),
+/// which is what the logging macros report to. It starts disabled, in which
+/// case the blocks are profiled by the logger as they always have been, when
+/// enabled they are recorded here instead and never touch the disk. Note that
+/// the LogBlock/LogTime macros only exist when EOS_LOG_BLOCKS is defined.
+///
+/// Blocks are identified by the pointer to there name, which is why they have
+/// to be compile time constant strings. Each thread has its own call tree,
+/// with a node for every distinct path of block names, storing call counts and
+/// total times, so these are exact regardless of how long it runs. The ring
+/// buffer of individual blocks, used for the percentiles and the trace, only
+/// keeps the most recent ringSize blocks of each thread. Note that as each
+/// thread has its own stack blocks run by the workers of a mt::TaskPool appear
+/// at the top of the tree, not under the block that handed them the work.
+class EOS_CLASS Profiler
+{
+ public:
+  /// ringSize is how many individual blocks to keep per thread.
+   Profiler(nat32 ringSize = 65536);
+
+  /// &nbsp;
+   ~Profiler();
+
+
+  /// Switches the profiler on or off. Blocks that are running when this is
+  /// called are unaffected, i.e. a block that started with profiling on still
+  /// gets recorded when it ends.
+   void Enable(bit on = true) {enabled = on;}
+
+  /// &nbsp;
+   bit Enabled() const {return enabled;}
+
+
+  /// Called on entering a block, with the name of the block.
+   void Enter(cstrconst name);
+
+  /// Called on leaving a block, must match a previous call to Enter() from
+  /// the same thread.
+   void Leave();
+
+  /// Adds to a named counter, for recording events that are too frequent or 
+  /// too quick to be blocks, such as cache hits. As with blocks the name must 
+  /// be a compile time constant string. Does nothing if not Enabled().
+   void Count(cstrconst name,nat64 amount = 1);
+
+
+  /// Returns the identifier of the named counter, for use with Add(),
+  /// registering it if need be. Unlike Count() names are compared by content,
+  /// so the same name used in two places is the same counter. The name must
+  /// remain valid for the life of the profiler. This takes a lock, so get the
+  /// identifier once and keep it, as LogCount does.
+   nat32 CounterId(cstrconst name);
+
+  /// Adds to the counter with the given identifier. Each thread has its own
+  /// array of counters, indexed by identifier, so this is a thread local
+  /// lookup and an add, with no locking and no cache lines shared between
+  /// threads. Does nothing if not Enabled().
+   void Add(nat32 id,nat64 amount = 1) {if (enabled) AddCurrent(id,amount);}
+
+  /// As CounterId(), but for a histogram.
+   nat32 HistogramId(cstrconst name);
+
+  /// Adds a value to the histogram with the given identifier, which records
+  /// the count, sum, minimum and maximum plus a count in power of two
+  /// buckets, see ProfileReport::Histogram. Intended for sizes, such as how
+  /// many disparities a pixel has. Sharded per thread as for Add(). Does
+  /// nothing if not Enabled().
+   void Sample(nat32 id,real64 value) {if (enabled) SampleCurrent(id,value);}
+
+
+  /// Empties all recorded data. Must only be called when no thread is inside
+  /// a profiled block. Counter and histogram identifiers remain valid.
+   void Reset();
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::log::Profiler";}
+
+
+ private:
+  friend class ProfileReport;
+
+  volatile bit enabled;
+  nat32 ringSize;
+
+  mt::ThreadSlot * slot; // Points to the calling threads ProfileThread.
+  mt::OwnedLock lock; // Protects the below.
+  ProfileThread * first; // Linked list of every thread that has recorded anything.
+  nat32 threads;
+
+  nat32 counterIds; // Registered counter names, indexed by identifier.
+  cstrconst * counterName;
+  nat32 histogramIds; // Registered histogram names, indexed by identifier.
+  cstrconst * histogramName;
+
+  // Returns the ProfileThread for the calling thread, creating it if need be...
+   ProfileThread * Current();
+
+  // The out of line parts of Add and Sample...
+   void AddCurrent(nat32 id,nat64 amount);
+   void SampleCurrent(nat32 id,real64 value);
+
+  // Registration for CounterId and HistogramId, must be called with the lock...
+   static nat32 Register(cstrconst name,nat32 & ids,cstrconst *& names);
+};
+
+//------------------------------------------------------------------------------
+/// Returns the system wide Profiler, as used by the logging macros.
+EOS_FUNC Profiler & DefaultProfiler();
+
+//------------------------------------------------------------------------------
+/// The merge step for a Profiler, constructing this collects the data from
+/// every thread into a single call tree, plus per block name statistics,
+/// which can then be accessed or written out. The data is copied, so the
+/// profiler can carry on afterwards, but the threads being profiled must not be
+/// inside a profiled block whilst this is being constructed, i.e. create it
+/// after the parallel work is done. If mem::TrackMemory() is on it also takes
+/// a snapshot of the memory statistics.
+class EOS_CLASS ProfileReport
+{
+ public:
+  /// &nbsp;
+   ProfileReport(const Profiler & prof = DefaultProfiler());
+
+  /// &nbsp;
+   ~ProfileReport();
+
+
+  /// A node in the merged call tree. Node 0 is the root, which represents
+  /// being outside of any block and has no name.
+   struct Node
+   {
+    cstrconst name;
+    nat32 parent; // Ignored for the root.
+    nat32 depth; // 0 for the root.
+    nat32 calls;
+    real64 inclusive; // Total time in seconds spent in this block.
+    real64 exclusive; // Total time in seconds not spent in child blocks.
+   };
+
+  /// The statistics for a block name, summed over every position in the call
+  /// tree in which it appears. The percentiles are only over the blocks still in
+  /// the ring buffers, of which there are samples, the rest is exact.
+   struct Block
+   {
+    cstrconst name;
+    nat32 calls;
+    real64 exclusive; // Total time in seconds.
+    nat32 samples;
+    real64 p50; // Inclusive times of a single call, in seconds.
+    real64 p90;
+    real64 p99;
+    real64 max;
+   };
+
+  /// A counter, as given to Profiler::Count, summed over all threads.
+   struct Counter
+   {
+    cstrconst name;
+    nat64 count;
+   };
+
+  /// How many buckets a Histogram has.
+   static const nat32 histBuckets = 64;
+
+  /// A histogram, as given to Profiler::Sample, summed over all threads.
+  /// Bucket 0 counts values below 1, bucket b>0 values in [2^(b-1),2^b),
+  /// with the last bucket also getting everything larger.
+   struct Histogram
+   {
+    cstrconst name;
+    nat64 count;
+    real64 sum;
+    real64 min; // 0 if count is 0, as is max.
+    real64 max;
+    nat64 bucket[histBuckets];
+
+    /// Returns the inclusive lower limit of the given bucket.
+     static real64 BucketLow(nat32 b) {return (b==0)?0.0:real64(nat64(1)<<(b-1));}
+
+    /// &nbsp;
+     real64 Mean() const {return (count==0)?0.0:(sum/real64(count));}
+   };
+
+  /// A single call of a block.
+   struct Event
+   {
+    cstrconst name;
+    nat32 thread; // Index of the thread, in the order they first recorded something.
+    nat32 depth;
+    real64 start; // Seconds, as returned by time::UltraTime().
+    real64 end;
+   };
+
+
+  /// Returns how many nodes are in the call tree, including the root. Nodes
+  /// are in depth first order, so a nodes children all follow it.
+   nat32 Nodes() const {return nodes;}
+
+  /// &nbsp;
+   const Node & GetNode(nat32 i) const {return node[i];}
+
+  /// Returns how many block names there are.
+   nat32 Blocks() const {return blocks;}
+
+  /// The blocks are sorted by exclusive time, most expensive first.
+   const Block & GetBlock(nat32 i) const {return block[i];}
+
+  /// Returns how many counters there are.
+   nat32 Counters() const {return counters;}
+
+  /// The counters are sorted by name.
+   const Counter & GetCounter(nat32 i) const {return counter[i];}
+
+  /// Returns how many histograms there are.
+   nat32 Histograms() const {return histograms;}
+
+  /// The histograms are sorted by name.
+   const Histogram & GetHistogram(nat32 i) const {return histogram[i];}
+
+  /// Returns true if memory was being tracked, see mem::TrackMemory(), in
+  /// which case the memory statistics are avaliable.
+   bit MemoryTracked() const {return memTracked;}
+
+  /// The memory statistics of the process.
+   const mem::MemStats & Memory() const {return memory;}
+
+  /// Returns how many threads have memory statistics.
+   nat32 MemThreads() const {return memThreads;}
+
+  /// Memory statistics of a thread, in the order they started being tracked.
+   const mem::MemStats & GetMemThread(nat32 i) const {return memThread[i];}
+
+  /// Returns how many memory tags there are, see mem::MemScope.
+   nat32 MemTags() const {return memTags;}
+
+  /// Memory statistics of a tag, sorted by peak, largest first.
+   const mem::MemTagStats & GetMemTag(nat32 i) const {return memTag[i];}
+
+  /// Returns how many individual block calls were retained.
+   nat32 Events() const {return events;}
+
+  /// The events are sorted by thread then start time.
+   const Event & GetEvent(nat32 i) const {return event[i];}
+
+
+  /// Writes the call tree followed by the per block statistics, the counters,
+  /// the histograms and then, if tracked, the memory statistics to the given
+  /// file, as a csv. Returns true on success.
+   bit WriteCsv(cstrconst fn) const;
+
+  /// Writes the events to the given file as a json file in the chrome trace
+  /// event format. Returns true on success.
+   bit WriteTrace(cstrconst fn) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::log::ProfileReport";}
+
+
+ private:
+  nat32 nodes;
+  Node * node;
+
+  nat32 blocks;
+  Block * block;
+
+  nat32 counters;
+  Counter * counter;
+
+  nat32 histograms;
+  Histogram * histogram;
+
+  bit memTracked;
+  mem::MemStats memory;
+  nat32 memThreads;
+  mem::MemStats * memThread;
+  nat32 memTags;
+  mem::MemTagStats * memTag;
+
+  nat32 events;
+  Event * event;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+
+//------------------------------------------------------------------------------
+/// \def LogCount(n,a)
+/// Adds a to the counter named n of DefaultProfiler(), when it is enabled.
+/// The name is registered the first time the line runs, after which it costs
+/// a thread local lookup and an add, or just a test when the profiler is
+/// disabled. Compiled out entirely unless EOS_LOG_BLOCKS or EOS_LOG_COUNTERS
+/// is defined, so release builds can have counters without the block logging.
+/// For the hottest loops count into a local and call this once at the end.
+
+/// \def LogSample(n,v)
+/// As LogCount(n,a), but adds the value v to the histogram named n.
+
+#if defined(EOS_LOG_BLOCKS)||defined(EOS_LOG_COUNTERS)
+ #define LogCount(n,a) {static const eos::nat32 eosLogCountId = eos::log::DefaultProfiler().CounterId(n); eos::log::DefaultProfiler().Add(eosLogCountId,a);}
+ #define LogSample(n,v) {static const eos::nat32 eosLogSampleId = eos::log::DefaultProfiler().HistogramId(n); eos::log::DefaultProfiler().Sample(eosLogSampleId,v);}
+#else
+ #define LogCount(n,a)
+ #define LogSample(n,v)
+#endif
+
+//------------------------------------------------------------------------------
+#endif
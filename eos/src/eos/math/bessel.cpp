@@ -133,6 +133,52 @@ EOS_FUNC real32 InverseModBesselFirstOrder0(real32 x,real32 accuracy,nat32 limit
  return ret;
 }
 
+//------------------------------------------------------------------------------
+// The table behind InverseModBesselFirstOrder0Ln, of the inverse at evenly
+// spaced square roots of ln(x)...
+class InvBesselTable
+{
+ public:
+  static const nat32 size = 1024;
+
+  InvBesselTable()
+  {
+   step = math::Sqrt(maxLn)/real32(size);
+   invStep = 1.0/step;
+   for (nat32 i=0;i<=size;i++)
+   {
+    real32 u = step*real32(i);
+    k[i] = InverseModBesselFirstOrder0(math::Exp(u*u),1e-6);
+   }
+  }
+
+  real32 Get(real32 lnX) const
+  {
+   real32 t = math::Sqrt(lnX)*invStep;
+   nat32 i = nat32(t);
+   if (i>=size) i = size-1;
+   t -= real32(i);
+   return (1.0-t)*k[i] + t*k[i+1];
+  }
+
+  static const real32 maxLn;
+
+  real32 step;
+  real32 invStep;
+  real32 k[size+1];
+};
+
+const real32 InvBesselTable::maxLn = 86.0;
+
+EOS_FUNC real32 InverseModBesselFirstOrder0Ln(real32 lnX)
+{
+ if (lnX<0.0001) return 0.0; // Matches the cut off of the original.
+ if (lnX>InvBesselTable::maxLn) return InverseModBesselFirstOrder0(math::Exp(lnX));
+
+ static InvBesselTable table;
+ return table.Get(lnX);
+}
+
 //------------------------------------------------------------------------------
  };
 };
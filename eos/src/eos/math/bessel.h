@@ -46,6 +46,16 @@ EOS_FUNC real32 ModBesselFirst(nat32 orderX2,real32 x,real32 accuracy = 0.0001,n
 /// - any higher and you will get a nan.
 EOS_FUNC real32 InverseModBesselFirstOrder0(real32 x,real32 accuracy = 0.0001,nat32 limit = 1000);
 
+//------------------------------------------------------------------------------
+/// A fast version of InverseModBesselFirstOrder0, for inner loops. It is given
+/// the natural log of x, as that is often what you have, and interpolates a
+/// table of 1024 entrys made the first time its called - they are indexed by
+/// the square root of the log, in which the function is close to linear.
+/// Within the table, ln(x) from 0 to 86, the answer is within 0.00005 of
+/// InverseModBesselFirstOrder0 run to an accuracy of 1e-6, which is better
+/// than its default accuracy manages. Outside the table it is just called.
+EOS_FUNC real32 InverseModBesselFirstOrder0Ln(real32 lnX);
+
 //------------------------------------------------------------------------------
  };
 };
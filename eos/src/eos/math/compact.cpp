@@ -0,0 +1,149 @@
+//------------------------------------------------------------------------------
+// Copyright 2010 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/math/compact.h"
+
+#if defined(__F16C__)
+ #include <immintrin.h>
+#elif defined(__SSE2__)
+ #include <emmintrin.h>
+#endif
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+EOS_FUNC void Convert(const Half * in,real32 * out,nat32 n)
+{
+ nat32 i = 0;
+ #ifdef __F16C__
+  for (;i+8<=n;i+=8)
+  {
+   _mm256_storeu_ps(out+i,_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(const void*)(in+i))));
+  }
+ #endif
+ for (;i<n;i++) out[i] = Half::ToReal(in[i].bits);
+}
+
+EOS_FUNC void Convert(const real32 * in,Half * out,nat32 n)
+{
+ nat32 i = 0;
+ #ifdef __F16C__
+  for (;i+8<=n;i+=8)
+  {
+   __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in+i),_MM_FROUND_TO_NEAREST_INT);
+
+   // Infinities back to the largest finite half, as ToHalf does...
+    __m128i inf = _mm_cmpeq_epi16(_mm_and_si128(h,_mm_set1_epi16(0x7fff)),_mm_set1_epi16(0x7c00));
+    h = _mm_add_epi16(h,inf);
+
+   _mm_storeu_si128((__m128i*)(void*)(out+i),h);
+  }
+ #endif
+ for (;i<n;i++) out[i].bits = Half::FromReal(in[i]);
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC void Convert(const Unorm8 * in,real32 * out,nat32 n)
+{
+ nat32 i = 0;
+ #ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps(255.0);
+  for (;i+16<=n;i+=16)
+  {
+   __m128i b = _mm_loadu_si128((const __m128i*)(const void*)(in+i));
+   __m128i lo = _mm_unpacklo_epi8(b,zero);
+   __m128i hi = _mm_unpackhi_epi8(b,zero);
+   _mm_storeu_ps(out+i,   _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo,zero)),scale));
+   _mm_storeu_ps(out+i+4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo,zero)),scale));
+   _mm_storeu_ps(out+i+8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi,zero)),scale));
+   _mm_storeu_ps(out+i+12,_mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi,zero)),scale));
+  }
+ #endif
+ for (;i<n;i++) out[i] = in[i];
+}
+
+EOS_FUNC void Convert(const real32 * in,Unorm8 * out,nat32 n)
+{
+ nat32 i = 0;
+ #ifdef __SSE2__
+  // max with zero first turns nan into zero, as the scalar version does...
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0);
+   const __m128 scale = _mm_set1_ps(255.0);
+   const __m128 half = _mm_set1_ps(0.5);
+   for (;i+16<=n;i+=16)
+   {
+    __m128i v[4];
+    for (nat32 j=0;j<4;j++)
+    {
+     __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in+i+j*4),zero),one);
+     v[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x,scale),half));
+    }
+    __m128i b = _mm_packus_epi16(_mm_packs_epi32(v[0],v[1]),_mm_packs_epi32(v[2],v[3]));
+    _mm_storeu_si128((__m128i*)(void*)(out+i),b);
+   }
+ #endif
+ for (;i<n;i++) out[i] = in[i];
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC void Convert(const Unorm16 * in,real32 * out,nat32 n)
+{
+ nat32 i = 0;
+ #ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps(65535.0);
+  for (;i+8<=n;i+=8)
+  {
+   __m128i s = _mm_loadu_si128((const __m128i*)(const void*)(in+i));
+   _mm_storeu_ps(out+i,  _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(s,zero)),scale));
+   _mm_storeu_ps(out+i+4,_mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(s,zero)),scale));
+  }
+ #endif
+ for (;i<n;i++) out[i] = in[i];
+}
+
+EOS_FUNC void Convert(const real32 * in,Unorm16 * out,nat32 n)
+{
+ nat32 i = 0;
+ #ifdef __SSE2__
+  // SSE2 only has a signed saturating pack, so offset into the signed range
+  // and back again...
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0);
+   const __m128 scale = _mm_set1_ps(65535.0);
+   const __m128 half = _mm_set1_ps(0.5);
+   const __m128i offset = _mm_set1_epi32(32768);
+   const __m128i flip = _mm_set1_epi16(-32768);
+   for (;i+8<=n;i+=8)
+   {
+    __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in+i),zero),one);
+    __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in+i+4),zero),one);
+    __m128i ia = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a,scale),half)),offset);
+    __m128i ib = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b,scale),half)),offset);
+    _mm_storeu_si128((__m128i*)(void*)(out+i),_mm_xor_si128(_mm_packs_epi32(ia,ib),flip));
+   }
+ #endif
+ for (;i<n;i++) out[i] = in[i];
+}
+
+//------------------------------------------------------------------------------
+ };
+};
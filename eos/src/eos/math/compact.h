@@ -0,0 +1,205 @@
+#ifndef EOS_MATH_COMPACT_H
+#define EOS_MATH_COMPACT_H
+//------------------------------------------------------------------------------
+// Copyright 2010 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+/// \file compact.h
+/// Provides compact stand-ins for real32, for storing large fields in half or
+/// a quarter of the memory, and hence bandwidth, when the precision is not 
+/// needed. Each converts to and from real32 implicitly, so arithmetic is done
+/// in real32 and only storage is compact.
+
+#include "eos/types.h"
+#include "eos/mem/functions.h"
+#include "eos/math/functions.h"
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+/// An IEEE 754 half precision (binary16) floating point number. 11 bits of
+/// precision, so about 3 decimal digits, with a range of +/-65504; values 
+/// beyond that, infinities included, are clamped to it and values below 6e-8 
+/// become zero. Conversion is math::ToHalf and math::FromHalf, so matches the
+/// compact messages of inf exactly.
+class EOS_CLASS Half
+{
+ public:
+  /// Leaves the value undefined.
+   Half() {}
+
+  /// &nbsp;
+   Half(real32 v):bits(FromReal(v)) {}
+
+  /// &nbsp;
+   Half(const Half & rhs):bits(rhs.bits) {}
+
+
+  /// &nbsp;
+   Half & operator = (real32 v) {bits = FromReal(v); return *this;}
+
+  /// &nbsp;
+   Half & operator = (const Half & rhs) {bits = rhs.bits; return *this;}
+
+  /// &nbsp;
+   operator real32 () const {return ToReal(bits);}
+
+
+  /// Converts a real32 to the bit pattern of a half.
+   static inline nat16 FromReal(real32 v);
+
+  /// Converts the bit pattern of a half to a real32.
+   static inline real32 ToReal(nat16 h);
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::Half";}
+
+
+ nat16 bits; ///< The raw binary16 value.
+};
+
+//------------------------------------------------------------------------------
+/// An unsigned normalised 8 bit number, representing [0,1] in 256 steps, as
+/// found in ordinary images. Conversion from real32 clamps to [0,1] and rounds
+/// to the nearest step.
+class EOS_CLASS Unorm8
+{
+ public:
+  /// Leaves the value undefined.
+   Unorm8() {}
+
+  /// &nbsp;
+   Unorm8(real32 v):val(FromReal(v)) {}
+
+  /// &nbsp;
+   Unorm8(const Unorm8 & rhs):val(rhs.val) {}
+
+
+  /// &nbsp;
+   Unorm8 & operator = (real32 v) {val = FromReal(v); return *this;}
+
+  /// &nbsp;
+   Unorm8 & operator = (const Unorm8 & rhs) {val = rhs.val; return *this;}
+
+  /// &nbsp;
+   operator real32 () const {return real32(val)/real32(255.0);}
+
+
+  /// &nbsp;
+   static inline nat8 FromReal(real32 v)
+   {
+    if (!(v>0.0)) return 0;
+    if (v>=1.0) return 255;
+    return nat8(v*real32(255.0) + real32(0.5));
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::Unorm8";}
+
+
+ nat8 val; ///< 0 is 0.0, 255 is 1.0.
+};
+
+//------------------------------------------------------------------------------
+/// An unsigned normalised 16 bit number, representing [0,1] in 65536 steps,
+/// for images that need more than 8 bits but not a float. Conversion from 
+/// real32 clamps to [0,1] and rounds to the nearest step.
+class EOS_CLASS Unorm16
+{
+ public:
+  /// Leaves the value undefined.
+   Unorm16() {}
+
+  /// &nbsp;
+   Unorm16(real32 v):val(FromReal(v)) {}
+
+  /// &nbsp;
+   Unorm16(const Unorm16 & rhs):val(rhs.val) {}
+
+
+  /// &nbsp;
+   Unorm16 & operator = (real32 v) {val = FromReal(v); return *this;}
+
+  /// &nbsp;
+   Unorm16 & operator = (const Unorm16 & rhs) {val = rhs.val; return *this;}
+
+  /// &nbsp;
+   operator real32 () const {return real32(val)/real32(65535.0);}
+
+
+  /// &nbsp;
+   static inline nat16 FromReal(real32 v)
+   {
+    if (!(v>0.0)) return 0;
+    if (v>=1.0) return 65535;
+    return nat16(v*real32(65535.0) + real32(0.5));
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::Unorm16";}
+
+
+ nat16 val; ///< 0 is 0.0, 65535 is 1.0.
+};
+
+//------------------------------------------------------------------------------
+/// Converts an array of n values, for moving whole rows between compact
+/// storage and real32 buffers. Vectorised with F16C for Half and SSE2 for the
+/// Unorm types when the compiler has them enabled, with exactly the same 
+/// results as converting each value on its own. The in and out arrays must not
+/// overlap.
+EOS_FUNC void Convert(const Half * in,real32 * out,nat32 n);
+
+/// &nbsp;
+EOS_FUNC void Convert(const real32 * in,Half * out,nat32 n);
+
+/// &nbsp;
+EOS_FUNC void Convert(const Unorm8 * in,real32 * out,nat32 n);
+
+/// &nbsp;
+EOS_FUNC void Convert(const real32 * in,Unorm8 * out,nat32 n);
+
+/// &nbsp;
+EOS_FUNC void Convert(const Unorm16 * in,real32 * out,nat32 n);
+
+/// &nbsp;
+EOS_FUNC void Convert(const real32 * in,Unorm16 * out,nat32 n);
+
+/// A copy, so templated code can treat real32 as just another storage type.
+inline void Convert(const real32 * in,real32 * out,nat32 n) {mem::Copy(out,in,n);}
+
+//------------------------------------------------------------------------------
+inline nat16 Half::FromReal(real32 v)
+{
+ return ToHalf(v);
+}
+
+inline real32 Half::ToReal(nat16 h)
+{
+ return FromHalf(h);
+}
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
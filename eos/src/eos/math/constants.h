@@ -81,6 +81,25 @@ inline T Infinity()
  return INFINITY;
 }
 
+/// This returns the machine epsilon, the gap between 1 and the next number up,
+/// should only be templated to real32 or real64.
+template <typename T>
+inline T Epsilon();
+
+/// &nbsp;
+template <>
+inline real32 Epsilon<real32>()
+{
+ return 1.1920928955078125e-7;
+}
+
+/// &nbsp;
+template <>
+inline real64 Epsilon<real64>()
+{
+ return 2.220446049250313080847263336181640625e-16;
+}
+
 //------------------------------------------------------------------------------
 /// Minimum value an int8 can take.
 const int8 min_int_8 = -128;
@@ -0,0 +1,129 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos/math/dist_trans.h"
+
+#include "eos/math/functions.h"
+#include "eos/math/constants.h"
+#include "eos/mem/alloc.h"
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+EOS_FUNC void DistTransLinear(real32 * val,nat32 n,real32 mult)
+{
+ for (nat32 i=1;i<n;i++) val[i] = math::Min(val[i],val[i-1]+mult);
+ for (int32 i=int32(n)-2;i>=0;i--) val[i] = math::Min(val[i],val[i+1]+mult);
+}
+
+EOS_FUNC void DistTransTruncLinear(real32 * val,nat32 n,real32 mult,real32 trunc)
+{
+ if (n==0) return;
+ real32 cap = val[0];
+ for (nat32 i=1;i<n;i++) cap = math::Min(cap,val[i]);
+ cap += trunc;
+
+ DistTransLinear(val,n,mult);
+ for (nat32 i=0;i<n;i++) val[i] = math::Min(val[i],cap);
+}
+
+EOS_FUNC void DistTransQuad(const real32 * in,real32 * out,nat32 n,real32 mult)
+{
+ if (n==0) return;
+
+ // With no curvature its just the minimum everywhere...
+  if (!(mult>0.0))
+  {
+   real32 low = in[0];
+   for (nat32 i=1;i<n;i++) low = math::Min(low,in[i]);
+   for (nat32 i=0;i<n;i++) out[i] = low;
+   return;
+  }
+
+ // Storage for the envelope - v is the parabola roots, z the boundaries
+ // between them...
+  int32 vStack[256];
+  real32 zStack[257];
+  int32 * v = vStack;
+  real32 * z = zStack;
+  if (n>256)
+  {
+   v = mem::Malloc<int32>(n);
+   z = mem::Malloc<real32>(n+1);
+  }
+
+ // Build the lower envelope, left to right, dropping parabolas that the new
+ // one hides...
+  nat32 k = 0;
+  v[0] = 0;
+  z[0] = -math::Infinity<real32>();
+  z[1] = math::Infinity<real32>();
+  real32 iMult = 0.5/mult;
+  for (nat32 q=1;q<n;q++)
+  {
+   // The intersection with the parabola at p is at
+   // (in[q]-in[p])/(2*mult*(q-p)) + (q+p)/2, which avoids squaring big
+   // label numbers...
+    real32 s;
+    while (true)
+    {
+     int32 p = v[k];
+     s = (in[q]-in[p])*iMult/real32(int32(q)-p) + 0.5*real32(int32(q)+p);
+     if (!(s<=z[k])) break;
+     --k;
+    }
+
+   // Add it...
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k+1] = math::Infinity<real32>();
+  }
+
+ // Read it off...
+  k = 0;
+  for (nat32 q=0;q<n;q++)
+  {
+   while (z[k+1]<real32(q)) ++k;
+   real32 d = real32(int32(q)-v[k]);
+   out[q] = mult*d*d + in[v[k]];
+  }
+
+ if (n>256)
+ {
+  mem::Free(v);
+  mem::Free(z);
+ }
+}
+
+EOS_FUNC void DistTransTruncQuad(const real32 * in,real32 * out,nat32 n,real32 mult,real32 trunc)
+{
+ if (n==0) return;
+ real32 cap = in[0];
+ for (nat32 i=1;i<n;i++) cap = math::Min(cap,in[i]);
+ cap += trunc;
+
+ DistTransQuad(in,out,n,mult);
+ for (nat32 i=0;i<n;i++) out[i] = math::Min(out[i],cap);
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,54 @@
+#ifndef EOS_MATH_DIST_TRANS_H
+#define EOS_MATH_DIST_TRANS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file dist_trans.h
+/// Provides 1D distance transforms, in the sense of Felzenszwalb and
+/// Huttenlocher - given costs f(j) they calculate min_j f(j) + d(i-j) for every
+/// i in linear time, for the common choices of d. These are the expensive part
+/// of min-sum belief propagation messages, so both the alg and inf belief
+/// propagation implimentations use them.
+
+#include "eos/types.h"
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+/// Distance transform for d(x) = mult*|x|, done in place with a forward and a
+/// backward pass.
+EOS_FUNC void DistTransLinear(real32 * val,nat32 n,real32 mult);
+
+/// Distance transform for d(x) = min(mult*|x|,trunc), done in place.
+EOS_FUNC void DistTransTruncLinear(real32 * val,nat32 n,real32 mult,real32 trunc);
+
+/// Distance transform for d(x) = mult*x^2, using the lower envelope of the
+/// parabolas rooted at each input. in and out must not overlap. Uses the stack
+/// for up to 256 entries, the heap beyond that.
+EOS_FUNC void DistTransQuad(const real32 * in,real32 * out,nat32 n,real32 mult);
+
+/// Distance transform for d(x) = min(mult*x^2,trunc). in and out must not
+/// overlap.
+EOS_FUNC void DistTransTruncQuad(const real32 * in,real32 * out,nat32 n,real32 mult,real32 trunc);
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
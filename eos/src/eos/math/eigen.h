@@ -775,6 +775,365 @@ inline bit SymEigen(M & a,M & q,V & d)
  return all_good;
 }
 
+//------------------------------------------------------------------------------
+/// The fixed size version of SymEigen, used for the small sizes via overloads.
+/// Uses cyclic Jacobi rotations, which for matrices this small are far faster
+/// than tri-diagonalisation and QR, and more accurate. The relation q^T a q = d
+/// holds as for SymEigen, no particular order. Stops when a sweep leaves all
+/// off diagonal terms negligible, with at most maxSweeps. Returns false if it
+/// ran out of sweeps, which is very rare, or the input was not finite.
+template <nat32 S,typename T>
+inline bit SymEigenJacobi(Mat<S,S,T> & a,Mat<S,S,T> & q,Vect<S,T> & d,nat32 maxSweeps = 32)
+{
+ Identity(q);
+ bit done = false;
+ for (nat32 sweep=0;(sweep<maxSweeps)&&(!done);sweep++)
+ {
+  done = true;
+  for (nat32 p=0;p+1<S;p++)
+  {
+   for (nat32 r=p+1;r<S;r++)
+   {
+    T apr = a[p][r];
+    if (Abs(apr)<=Epsilon<T>()*(Abs(a[p][p]) + Abs(a[r][r]))) {a[p][r] = T(0); a[r][p] = T(0); continue;}
+    done = false;
+
+    // Calculate the rotation that zeros a[p][r]...
+     T theta = (a[r][r] - a[p][p])/(T(2)*apr);
+     T t = T(1)/(Abs(theta) + Sqrt(Sqr(theta) + T(1)));
+     if (theta<T(0)) t = -t;
+     T c = T(1)/Sqrt(Sqr(t) + T(1));
+     T sn = t*c;
+
+    // Apply it...
+     a[p][p] -= t*apr;
+     a[r][r] += t*apr;
+     a[p][r] = T(0);
+     a[r][p] = T(0);
+     for (nat32 k=0;k<S;k++)
+     {
+      if ((k==p)||(k==r)) continue;
+      T akp = a[k][p];
+      T akr = a[k][r];
+      a[k][p] = c*akp - sn*akr;
+      a[p][k] = a[k][p];
+      a[k][r] = sn*akp + c*akr;
+      a[r][k] = a[k][r];
+     }
+    
+     for (nat32 k=0;k<S;k++)
+     {
+      T qkp = q[k][p];
+      T qkr = q[k][r];
+      q[k][p] = c*qkp - sn*qkr;
+      q[k][r] = sn*qkp + c*qkr;
+     }
+   }
+  }
+ }
+
+ for (nat32 i=0;i<S;i++)
+ {
+  d[i] = a[i][i];
+  if (!IsFinite(d[i])) return false;
+ }
+ return done;
+}
+
+/// SymEigen for 2x2 matrices, in closed form - a single Jacobi rotation.
+template <typename T>
+inline bit SymEigen(Mat<2,2,T> & a,Mat<2,2,T> & q,Vect<2,T> & d)
+{
+ T apr = a[0][1];
+ T t = T(0);
+ if (!IsZero(apr))
+ {
+  T theta = (a[1][1] - a[0][0])/(T(2)*apr);
+  t = T(1)/(Abs(theta) + Sqrt(Sqr(theta) + T(1)));
+  if (theta<T(0)) t = -t;
+ }
+ T c = T(1)/Sqrt(Sqr(t) + T(1));
+ T sn = t*c;
+
+ d[0] = a[0][0] - t*apr;
+ d[1] = a[1][1] + t*apr;
+ q[0][0] = c;  q[0][1] = sn;
+ q[1][0] = -sn; q[1][1] = c;
+ 
+ return IsFinite(d[0])&&IsFinite(d[1]);
+}
+
+/// SymEigen for 3x3 matrices, in closed form. The eigenvalues are the roots of
+/// the characteristic cubic of the scaled and shifted matrix, found with the
+/// trigonometric method. The eigenvector of the most isolated eigenvalue is
+/// then the longest cross product of rows of a - d_i I, with the second found
+/// from the 2x2 problem in the plane orthogonal to it, so nearly repeated
+/// eigenvalues do not cost accuracy. This is the method of 'A Robust
+/// Eigensolver for 3x3 Symmetric Matrices' by Eberly. As for SymEigen the
+/// eigenvalues are in no particular order.
+template <typename T>
+inline bit SymEigen(Mat<3,3,T> & a,Mat<3,3,T> & q,Vect<3,T> & d)
+{
+ // Scale, to avoid overflow, handling the zero matrix...
+  T scale = Max(Abs(a[0][0]),Abs(a[0][1]),Abs(a[0][2]),
+                Abs(a[1][1]),Abs(a[1][2]),Abs(a[2][2]));
+  if (!IsFinite(scale)) return false;
+  if (IsZero(scale))
+  {
+   Identity(q);
+   d[0] = T(0); d[1] = T(0); d[2] = T(0);
+   return true;
+  }
+
+  T inv = T(1)/scale;
+  T a00 = a[0][0]*inv; T a01 = a[0][1]*inv; T a02 = a[0][2]*inv;
+  T a11 = a[1][1]*inv; T a12 = a[1][2]*inv; T a22 = a[2][2]*inv;
+
+
+ // Diagonal matrices are trivial...
+  T offNorm = Sqr(a01) + Sqr(a02) + Sqr(a12);
+  if (IsZero(offNorm))
+  {
+   Identity(q);
+   d[0] = a[0][0]; d[1] = a[1][1]; d[2] = a[2][2];
+   return true;
+  }
+
+
+ // Eigenvalues, via b = (a - mI)/p, whose characteristic equation is
+ // b^3 - 3b - det(b) = 0...
+  T m = (a00 + a11 + a22)/T(3);
+  T b00 = a00 - m;
+  T b11 = a11 - m;
+  T b22 = a22 - m;
+  T p = Sqrt((Sqr(b00) + Sqr(b11) + Sqr(b22) + T(2)*offNorm)/T(6));
+  
+  T c00 = b11*b22 - Sqr(a12);
+  T c01 = a01*b22 - a12*a02;
+  T c02 = a01*a12 - b11*a02;
+  T halfDet = (b00*c00 - a01*c01 + a02*c02)/(T(2)*p*p*p);
+  halfDet = Min(Max(halfDet,T(-1)),T(1));
+  
+  T angle = InvCos(halfDet)/T(3);
+  T beta2 = T(2)*Cos(angle);
+  T beta0 = T(2)*Cos(angle + T(2.0*pi/3.0));
+  T beta1 = -(beta0 + beta2);
+  
+  T eval[3];
+  eval[0] = m + p*beta0;
+  eval[1] = m + p*beta1;
+  eval[2] = m + p*beta2;
+
+
+ // Eigenvectors - start with whichever end eigenvalue is furthest from the
+ // middle one...
+  T vec[3][3];
+  nat32 first = (halfDet>=T(0))?2:0;
+  
+  // Longest cross product of the rows of a - eval I...
+  {
+   T r0[3] = {a00 - eval[first],a01,a02};
+   T r1[3] = {a01,a11 - eval[first],a12};
+   T r2[3] = {a02,a12,a22 - eval[first]};
+   
+   T x[3][3];
+   x[0][0] = r0[1]*r1[2] - r0[2]*r1[1];
+   x[0][1] = r0[2]*r1[0] - r0[0]*r1[2];
+   x[0][2] = r0[0]*r1[1] - r0[1]*r1[0];
+   x[1][0] = r0[1]*r2[2] - r0[2]*r2[1];
+   x[1][1] = r0[2]*r2[0] - r0[0]*r2[2];
+   x[1][2] = r0[0]*r2[1] - r0[1]*r2[0];
+   x[2][0] = r1[1]*r2[2] - r1[2]*r2[1];
+   x[2][1] = r1[2]*r2[0] - r1[0]*r2[2];
+   x[2][2] = r1[0]*r2[1] - r1[1]*r2[0];
+   
+   nat32 best = 0;
+   T bestLen = T(0);
+   for (nat32 i=0;i<3;i++)
+   {
+    T len = Sqr(x[i][0]) + Sqr(x[i][1]) + Sqr(x[i][2]);
+    if (len>bestLen) {best = i; bestLen = len;}
+   }
+   
+   if (bestLen>T(0))
+   {
+    T il = T(1)/Sqrt(bestLen);
+    for (nat32 r=0;r<3;r++) vec[first][r] = x[best][r]*il;
+   }
+   else
+   {
+    vec[first][0] = T(1); vec[first][1] = T(0); vec[first][2] = T(0);
+   }
+  }
+  
+  // The middle, as the 2x2 problem in the orthogonal complement...
+  {
+   const T * w = vec[first];
+   T u[3];
+   if (Abs(w[0])>Abs(w[1]))
+   {
+    T il = T(1)/Sqrt(Sqr(w[0]) + Sqr(w[2]));
+    u[0] = -w[2]*il; u[1] = T(0); u[2] = w[0]*il;
+   }
+   else
+   {
+    T il = T(1)/Sqrt(Sqr(w[1]) + Sqr(w[2]));
+    u[0] = T(0); u[1] = w[2]*il; u[2] = -w[1]*il;
+   }
+   T v[3];
+   v[0] = w[1]*u[2] - w[2]*u[1];
+   v[1] = w[2]*u[0] - w[0]*u[2];
+   v[2] = w[0]*u[1] - w[1]*u[0];
+   
+   T au[3];
+   au[0] = a00*u[0] + a01*u[1] + a02*u[2];
+   au[1] = a01*u[0] + a11*u[1] + a12*u[2];
+   au[2] = a02*u[0] + a12*u[1] + a22*u[2];
+   T av[3];
+   av[0] = a00*v[0] + a01*v[1] + a02*v[2];
+   av[1] = a01*v[0] + a11*v[1] + a12*v[2];
+   av[2] = a02*v[0] + a12*v[1] + a22*v[2];
+   
+   T m00 = u[0]*au[0] + u[1]*au[1] + u[2]*au[2] - eval[1];
+   T m01 = u[0]*av[0] + u[1]*av[1] + u[2]*av[2];
+   T m11 = v[0]*av[0] + v[1]*av[1] + v[2]*av[2] - eval[1];
+   T abs00 = Abs(m00);
+   T abs01 = Abs(m01);
+   T abs11 = Abs(m11);
+   
+   // (cu,cv) is the unit null vector of the 2x2, found from its larger row...
+    T cu = T(1);
+    T cv = T(0);
+    if (abs00>=abs11)
+    {
+     if (abs00>=abs01)
+     {
+      if (abs00>T(0)) {m01 /= m00; m00 = T(1)/Sqrt(T(1) + Sqr(m01)); m01 *= m00; cu = m01; cv = -m00;}
+     }
+     else {m00 /= m01; m01 = T(1)/Sqrt(T(1) + Sqr(m00)); m00 *= m01; cu = m01; cv = -m00;}
+    }
+    else
+    {
+     if (abs11>=abs01) {m01 /= m11; m11 = T(1)/Sqrt(T(1) + Sqr(m01)); m01 *= m11; cu = m11; cv = -m01;}
+                  else {m11 /= m01; m01 = T(1)/Sqrt(T(1) + Sqr(m11)); m11 *= m01; cu = m11; cv = -m01;}
+    }
+    
+    for (nat32 r=0;r<3;r++) vec[1][r] = cu*u[r] + cv*v[r];
+  }
+  
+  // The last is orthogonal to both, keeping it right handed...
+  {
+   nat32 o = 2-first;
+   const T * x = vec[(o+1)%3];
+   const T * y = vec[(o+2)%3];
+   vec[o][0] = x[1]*y[2] - x[2]*y[1];
+   vec[o][1] = x[2]*y[0] - x[0]*y[2];
+   vec[o][2] = x[0]*y[1] - x[1]*y[0];
+  }
+
+
+ // Output...
+  for (nat32 i=0;i<3;i++)
+  {
+   d[i] = eval[i]*scale;
+   for (nat32 r=0;r<3;r++) q[r][i] = vec[i][r];
+  }
+
+ return true;
+}
+
+/// SymEigen for 4x4 matrices, using SymEigenJacobi.
+template <typename T>
+inline bit SymEigen(Mat<4,4,T> & a,Mat<4,4,T> & q,Vect<4,T> & d)
+{
+ return SymEigenJacobi(a,q,d);
+}
+
+//------------------------------------------------------------------------------
+/// A batch of 8 symmetric 3x3 matrices, in structure of arrays form, for
+/// SymEigenBatch. Element [r][c][i] is row r, column c of matrix i. Callers
+/// that decompose a matrix per pixel can fill these in 8 pixels at a time.
+template <typename T>
+class EOS_CLASS SymBatch33
+{
+ public:
+  /// Input, the matrices, trashed. Only the upper triangle is read.
+   T a[3][3][8];
+   
+  /// Output, the rotations, with the eigenvectors as columns.
+   T q[3][3][8];
+  
+  /// Output, the eigenvalues.
+   T d[3][8];
+};
+
+/// Does SymEigen to all 8 matrices of a batch at once, with a fixed number of
+/// cyclic Jacobi sweeps. Each step is done to all 8 lanes with no branches, so
+/// the compiler can turn the lane loops into SIMD. 5 sweeps is plenty for
+/// single precision, the convergence being quadratic. A lane that is allready
+/// diagonal is simply not rotated.
+template <typename T>
+inline void SymEigenBatch(SymBatch33<T> & b,nat32 sweeps = 5)
+{
+ for (nat32 r=0;r<3;r++)
+ {
+  for (nat32 c=0;c<3;c++)
+  {
+   T v = (r==c)?T(1):T(0);
+   for (nat32 i=0;i<8;i++) b.q[r][c][i] = v;
+  }
+ }
+
+ for (nat32 sweep=0;sweep<sweeps;sweep++)
+ {
+  for (nat32 p=0;p<2;p++)
+  {
+   for (nat32 r=p+1;r<3;r++)
+   {
+    nat32 k = 3-p-r; // The third index.
+    T * app = b.a[p][p];
+    T * arr = b.a[r][r];
+    T * apr = b.a[p][r];
+    T * akp = (k<p)?b.a[k][p]:b.a[p][k];
+    T * akr = (k<r)?b.a[k][r]:b.a[r][k];
+    
+    for (nat32 i=0;i<8;i++)
+    {
+     bit zero = apr[i]==T(0);
+     T theta = (arr[i] - app[i])/(zero?T(1):(T(2)*apr[i]));
+     T t = T(1)/(Abs(theta) + Sqrt(theta*theta + T(1)));
+     t = (theta<T(0))?-t:t;
+     t = zero?T(0):t;
+     T c = T(1)/Sqrt(t*t + T(1));
+     T sn = t*c;
+     
+     app[i] -= t*apr[i];
+     arr[i] += t*apr[i];
+     apr[i] = T(0);
+     
+     T kp = akp[i];
+     T kr = akr[i];
+     akp[i] = c*kp - sn*kr;
+     akr[i] = sn*kp + c*kr;
+     
+     for (nat32 j=0;j<3;j++)
+     {
+      T qp = b.q[j][p][i];
+      T qr = b.q[j][r][i];
+      b.q[j][p][i] = c*qp - sn*qr;
+      b.q[j][r][i] = sn*qp + c*qr;
+     }
+    }
+   }
+  }
+ }
+
+ for (nat32 j=0;j<3;j++)
+ {
+  for (nat32 i=0;i<8;i++) b.d[j][i] = b.a[j][j][i];
+ }
+}
+
 //------------------------------------------------------------------------------
 /// Same as SymEigen, except it sorts the eigenvalues into decreasing order.
 /// (Uses a simple insertion sort, but then one usually doesn't do this to large
@@ -0,0 +1,444 @@
+#ifndef EOS_MATH_EXPRESSIONS_H
+#define EOS_MATH_EXPRESSIONS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file expressions.h
+/// Provides the arithmetic operators for the fixed size Vect and Mat classes,
+/// as expression templates. Writting a + b*s - c does not create any
+/// temporary vectors - it builds a tiny object that records the expression,
+/// which is then evaluated in a single loop when assigned to a Vect, so it
+/// compiles to the same code as writting the loop by hand. Element wise
+/// expressions are lazy in this way, products of matrices with vectors and
+/// other matrices are instead worked out when the expression is built, as
+/// each output depends on a whole row/column and re-computing that for each
+/// element would cost more than the temporary. The product nodes live on the
+/// stack, so there is still no allocation.
+///
+/// This is included by vectors.h and matrices.h, there is no need to include
+/// it directly. The expression objects reference there arguments, so they
+/// should not be stored - assign them to a Vect or Mat in the statement that
+/// creates them.
+
+#include "eos/types.h"
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+/// The base of all fixed size vector expressions, including Vect itself. E is
+/// the real type, which must provide a T operator [] (nat32) const. Inheriting
+/// from this is what allows a type to be used with the arithmetic operators -
+/// it adds no data.
+template <nat32 S,typename T,typename E>
+class EOS_CLASS VectExpr
+{
+ public:
+  /// Returns the real type.
+   const E & Self() const {return static_cast<const E&>(*this);}
+
+  /// &nbsp;
+   nat32 Size() const {return S;}
+};
+
+//------------------------------------------------------------------------------
+/// The base of all fixed size matrix expressions, including Mat itself. E is
+/// the real type, which must provide a T operator () (nat32 row,nat32 col)
+/// const. As for VectExpr, adds no data.
+template <nat32 R,nat32 C,typename T,typename E>
+class EOS_CLASS MatExpr
+{
+ public:
+  /// Returns the real type.
+   const E & Self() const {return static_cast<const E&>(*this);}
+
+  /// &nbsp;
+   nat32 Rows() const {return R;}
+
+  /// &nbsp;
+   nat32 Cols() const {return C;}
+};
+
+//------------------------------------------------------------------------------
+// The vector expression nodes...
+/// The sum of two vector expressions.
+template <nat32 S,typename T,typename L,typename R>
+class EOS_CLASS VectSum : public VectExpr<S,T,VectSum<S,T,L,R> >
+{
+ public:
+  /// &nbsp;
+   VectSum(const L & l,const R & r):lhs(l),rhs(r) {}
+
+  /// &nbsp;
+   T operator [] (nat32 i) const {return lhs[i] + rhs[i];}
+
+
+ private:
+  const L & lhs;
+  const R & rhs;
+};
+
+/// The difference of two vector expressions.
+template <nat32 S,typename T,typename L,typename R>
+class EOS_CLASS VectDiff : public VectExpr<S,T,VectDiff<S,T,L,R> >
+{
+ public:
+  /// &nbsp;
+   VectDiff(const L & l,const R & r):lhs(l),rhs(r) {}
+
+  /// &nbsp;
+   T operator [] (nat32 i) const {return lhs[i] - rhs[i];}
+
+
+ private:
+  const L & lhs;
+  const R & rhs;
+};
+
+/// A vector expression multiplied by a scalar.
+template <nat32 S,typename T,typename E>
+class EOS_CLASS VectScale : public VectExpr<S,T,VectScale<S,T,E> >
+{
+ public:
+  /// &nbsp;
+   VectScale(const E & e,const T & s):expr(e),scale(s) {}
+
+  /// &nbsp;
+   T operator [] (nat32 i) const {return expr[i]*scale;}
+
+
+ private:
+  const E & expr;
+  T scale;
+};
+
+/// A negated vector expression.
+template <nat32 S,typename T,typename E>
+class EOS_CLASS VectNeg : public VectExpr<S,T,VectNeg<S,T,E> >
+{
+ public:
+  /// &nbsp;
+   VectNeg(const E & e):expr(e) {}
+
+  /// &nbsp;
+   T operator [] (nat32 i) const {return -expr[i];}
+
+
+ private:
+  const E & expr;
+};
+
+/// The element wise product of two vector expressions, as made by MultElem.
+template <nat32 S,typename T,typename L,typename R>
+class EOS_CLASS VectElem : public VectExpr<S,T,VectElem<S,T,L,R> >
+{
+ public:
+  /// &nbsp;
+   VectElem(const L & l,const R & r):lhs(l),rhs(r) {}
+
+  /// &nbsp;
+   T operator [] (nat32 i) const {return lhs[i]*rhs[i];}
+
+
+ private:
+  const L & lhs;
+  const R & rhs;
+};
+
+/// A matrix multiplied by a vector. Unlike the other nodes this is evaluated
+/// when constructed, with the vector read once before any output is
+/// written, so it is safe for the output to be the input vector.
+template <nat32 R,typename T>
+class EOS_CLASS MatVectProd : public VectExpr<R,T,MatVectProd<R,T> >
+{
+ public:
+  /// &nbsp;
+   template <nat32 C,typename ME,typename VE>
+   MatVectProd(const MatExpr<R,C,T,ME> & m,const VectExpr<C,T,VE> & v)
+   {
+    const ME & mat = m.Self();
+    const VE & vec = v.Self();
+
+    T in[C];
+    for (nat32 c=0;c<C;c++) in[c] = vec[c];
+
+    for (nat32 r=0;r<R;r++)
+    {
+     d[r] = mat(r,0) * in[0];
+     for (nat32 c=1;c<C;c++) d[r] += mat(r,c) * in[c];
+    }
+   }
+
+  /// &nbsp;
+   T operator [] (nat32 i) const {return d[i];}
+
+
+ private:
+  T d[R];
+};
+
+//------------------------------------------------------------------------------
+// The matrix expression nodes...
+/// The sum of two matrix expressions.
+template <nat32 R,nat32 C,typename T,typename LE,typename RE>
+class EOS_CLASS MatSum : public MatExpr<R,C,T,MatSum<R,C,T,LE,RE> >
+{
+ public:
+  /// &nbsp;
+   MatSum(const LE & l,const RE & r):lhs(l),rhs(r) {}
+
+  /// &nbsp;
+   T operator () (nat32 r,nat32 c) const {return lhs(r,c) + rhs(r,c);}
+
+
+ private:
+  const LE & lhs;
+  const RE & rhs;
+};
+
+/// The difference of two matrix expressions.
+template <nat32 R,nat32 C,typename T,typename LE,typename RE>
+class EOS_CLASS MatDiff : public MatExpr<R,C,T,MatDiff<R,C,T,LE,RE> >
+{
+ public:
+  /// &nbsp;
+   MatDiff(const LE & l,const RE & r):lhs(l),rhs(r) {}
+
+  /// &nbsp;
+   T operator () (nat32 r,nat32 c) const {return lhs(r,c) - rhs(r,c);}
+
+
+ private:
+  const LE & lhs;
+  const RE & rhs;
+};
+
+/// A matrix expression multiplied by a scalar.
+template <nat32 R,nat32 C,typename T,typename E>
+class EOS_CLASS MatScale : public MatExpr<R,C,T,MatScale<R,C,T,E> >
+{
+ public:
+  /// &nbsp;
+   MatScale(const E & e,const T & s):expr(e),scale(s) {}
+
+  /// &nbsp;
+   T operator () (nat32 r,nat32 c) const {return expr(r,c)*scale;}
+
+
+ private:
+  const E & expr;
+  T scale;
+};
+
+/// A negated matrix expression.
+template <nat32 R,nat32 C,typename T,typename E>
+class EOS_CLASS MatNeg : public MatExpr<R,C,T,MatNeg<R,C,T,E> >
+{
+ public:
+  /// &nbsp;
+   MatNeg(const E & e):expr(e) {}
+
+  /// &nbsp;
+   T operator () (nat32 r,nat32 c) const {return -expr(r,c);}
+
+
+ private:
+  const E & expr;
+};
+
+/// The transpose of a matrix expression, as made by Trans. Lazy, so
+/// Trans(a)*v does not copy a.
+template <nat32 R,nat32 C,typename T,typename E>
+class EOS_CLASS MatTrans : public MatExpr<R,C,T,MatTrans<R,C,T,E> >
+{
+ public:
+  /// &nbsp;
+   MatTrans(const E & e):expr(e) {}
+
+  /// &nbsp;
+   T operator () (nat32 r,nat32 c) const {return expr(c,r);}
+
+
+ private:
+  const E & expr;
+};
+
+/// The product of two matrices. As for MatVectProd this is evaluated when
+/// constructed, so it is safe to assign it to one of its inputs.
+template <nat32 R,nat32 C,typename T>
+class EOS_CLASS MatProd : public MatExpr<R,C,T,MatProd<R,C,T> >
+{
+ public:
+  /// &nbsp;
+   template <nat32 K,typename LE,typename RE>
+   MatProd(const MatExpr<R,K,T,LE> & l,const MatExpr<K,C,T,RE> & r)
+   {
+    const LE & lhs = l.Self();
+    const RE & rhs = r.Self();
+
+    for (nat32 i=0;i<R;i++)
+    {
+     for (nat32 j=0;j<C;j++)
+     {
+      d[i][j] = lhs(i,0) * rhs(0,j);
+      for (nat32 k=1;k<K;k++) d[i][j] += lhs(i,k) * rhs(k,j);
+     }
+    }
+   }
+
+  /// &nbsp;
+   T operator () (nat32 r,nat32 c) const {return d[r][c];}
+
+
+ private:
+  T d[R][C];
+};
+
+//------------------------------------------------------------------------------
+// The vector operators...
+/// &nbsp;
+template <nat32 S,typename T,typename L,typename R>
+inline VectSum<S,T,L,R> operator + (const VectExpr<S,T,L> & lhs,const VectExpr<S,T,R> & rhs)
+{
+ return VectSum<S,T,L,R>(lhs.Self(),rhs.Self());
+}
+
+/// &nbsp;
+template <nat32 S,typename T,typename L,typename R>
+inline VectDiff<S,T,L,R> operator - (const VectExpr<S,T,L> & lhs,const VectExpr<S,T,R> & rhs)
+{
+ return VectDiff<S,T,L,R>(lhs.Self(),rhs.Self());
+}
+
+/// &nbsp;
+template <nat32 S,typename T,typename E>
+inline VectNeg<S,T,E> operator - (const VectExpr<S,T,E> & rhs)
+{
+ return VectNeg<S,T,E>(rhs.Self());
+}
+
+/// &nbsp;
+template <nat32 S,typename T,typename E>
+inline VectScale<S,T,E> operator * (const VectExpr<S,T,E> & lhs,const T & rhs)
+{
+ return VectScale<S,T,E>(lhs.Self(),rhs);
+}
+
+/// &nbsp;
+template <nat32 S,typename T,typename E>
+inline VectScale<S,T,E> operator * (const T & lhs,const VectExpr<S,T,E> & rhs)
+{
+ return VectScale<S,T,E>(rhs.Self(),lhs);
+}
+
+/// Multiplies by the inverse, as Vect::operator /= does.
+template <nat32 S,typename T,typename E>
+inline VectScale<S,T,E> operator / (const VectExpr<S,T,E> & lhs,const T & rhs)
+{
+ return VectScale<S,T,E>(lhs.Self(),T(1)/rhs);
+}
+
+/// The dot product of two vector expressions, evaluated immediatly. Vect has
+/// its own operator * for when both sides are Vect's, this covers the rest.
+template <nat32 S,typename T,typename L,typename R>
+inline T operator * (const VectExpr<S,T,L> & lhs,const VectExpr<S,T,R> & rhs)
+{
+ const L & l = lhs.Self();
+ const R & r = rhs.Self();
+ T ret = l[0]*r[0];
+ for (nat32 i=1;i<S;i++) ret += l[i]*r[i];
+ return ret;
+}
+
+/// Returns the element wise product of two vector expressions.
+template <nat32 S,typename T,typename L,typename R>
+inline VectElem<S,T,L,R> MultElem(const VectExpr<S,T,L> & lhs,const VectExpr<S,T,R> & rhs)
+{
+ return VectElem<S,T,L,R>(lhs.Self(),rhs.Self());
+}
+
+//------------------------------------------------------------------------------
+// The matrix operators...
+/// &nbsp;
+template <nat32 R,nat32 C,typename T,typename LE,typename RE>
+inline MatSum<R,C,T,LE,RE> operator + (const MatExpr<R,C,T,LE> & lhs,const MatExpr<R,C,T,RE> & rhs)
+{
+ return MatSum<R,C,T,LE,RE>(lhs.Self(),rhs.Self());
+}
+
+/// &nbsp;
+template <nat32 R,nat32 C,typename T,typename LE,typename RE>
+inline MatDiff<R,C,T,LE,RE> operator - (const MatExpr<R,C,T,LE> & lhs,const MatExpr<R,C,T,RE> & rhs)
+{
+ return MatDiff<R,C,T,LE,RE>(lhs.Self(),rhs.Self());
+}
+
+/// &nbsp;
+template <nat32 R,nat32 C,typename T,typename E>
+inline MatNeg<R,C,T,E> operator - (const MatExpr<R,C,T,E> & rhs)
+{
+ return MatNeg<R,C,T,E>(rhs.Self());
+}
+
+/// &nbsp;
+template <nat32 R,nat32 C,typename T,typename E>
+inline MatScale<R,C,T,E> operator * (const MatExpr<R,C,T,E> & lhs,const T & rhs)
+{
+ return MatScale<R,C,T,E>(lhs.Self(),rhs);
+}
+
+/// &nbsp;
+template <nat32 R,nat32 C,typename T,typename E>
+inline MatScale<R,C,T,E> operator * (const T & lhs,const MatExpr<R,C,T,E> & rhs)
+{
+ return MatScale<R,C,T,E>(rhs.Self(),lhs);
+}
+
+/// &nbsp;
+template <nat32 R,nat32 C,typename T,typename E>
+inline MatScale<R,C,T,E> operator / (const MatExpr<R,C,T,E> & lhs,const T & rhs)
+{
+ return MatScale<R,C,T,E>(lhs.Self(),T(1)/rhs);
+}
+
+/// Returns the transpose of a matrix expression, without copying it.
+template <nat32 R,nat32 C,typename T,typename E>
+inline MatTrans<C,R,T,E> Trans(const MatExpr<R,C,T,E> & rhs)
+{
+ return MatTrans<C,R,T,E>(rhs.Self());
+}
+
+/// Matrix times vector.
+template <nat32 R,nat32 C,typename T,typename ME,typename VE>
+inline MatVectProd<R,T> operator * (const MatExpr<R,C,T,ME> & lhs,const VectExpr<C,T,VE> & rhs)
+{
+ return MatVectProd<R,T>(lhs,rhs);
+}
+
+/// Matrix times matrix.
+template <nat32 R,nat32 K,nat32 C,typename T,typename LE,typename RE>
+inline MatProd<R,C,T> operator * (const MatExpr<R,K,T,LE> & lhs,const MatExpr<K,C,T,RE> & rhs)
+{
+ return MatProd<R,C,T>(lhs,rhs);
+}
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
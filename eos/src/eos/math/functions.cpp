@@ -17,9 +17,111 @@
 
 #include "eos/math/functions.h"
 
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#endif
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+#ifdef __SSE2__
+// sse2 versions of the fast functions, 4 at a time, using the same
+// approximations as the scalar versions in functions.h, except for the approx3
+// square root, which uses the rsqrt instruction instead...
+
+static inline __m128 Poly(__m128 x,const real32 * c,nat32 n)
+{
+ __m128 ret = _mm_set1_ps(c[n-1]);
+ for (int32 i=int32(n)-2;i>=0;i--) ret = _mm_add_ps(_mm_mul_ps(ret,x),_mm_set1_ps(c[i]));
+ return ret;
+}
+
+static const real32 expCoarse[4] = {0.99992807f,1.0001642f,0.50496326f,0.16566841f};
+static const real32 expFine[6] = {1.0000001f,0.99999969f,0.49998895f,0.16667575f,0.041915382f,0.0082976548f};
+static const real32 lnCoarse[2] = {0.99997774f,0.33933993f};
+static const real32 lnFine[3] = {1.0000001f,0.33326112f,0.20648186f};
+
+static inline __m128 ExpSSE(__m128 x,Approx a)
+{
+ __m128 under = _mm_cmpge_ps(x,_mm_set1_ps(-87.0f));
+ x = _mm_min_ps(x,_mm_set1_ps(88.0f));
+
+ __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x,_mm_set1_ps(1.44269504f)));
+ __m128 nf = _mm_cvtepi32_ps(n);
+ __m128 r = _mm_sub_ps(_mm_sub_ps(x,_mm_mul_ps(nf,_mm_set1_ps(0.693145751953125f))),_mm_mul_ps(nf,_mm_set1_ps(1.42860682e-6f)));
+
+ __m128 er = (a==approx3) ? Poly(r,expCoarse,4) : Poly(r,expFine,6);
+
+ __m128i p2 = _mm_slli_epi32(_mm_add_epi32(n,_mm_set1_epi32(127)),23);
+ return _mm_and_ps(_mm_mul_ps(er,_mm_castsi128_ps(p2)),under);
+}
+
+static inline __m128 LnSSE(__m128 x,Approx a)
+{
+ __m128 pos = _mm_cmpgt_ps(x,_mm_setzero_ps());
+
+ // Denormals...
+  __m128 denorm = _mm_cmplt_ps(x,_mm_set1_ps(1.17549435e-38f));
+  x = _mm_or_ps(_mm_and_ps(denorm,_mm_mul_ps(x,_mm_set1_ps(8388608.0f))),_mm_andnot_ps(denorm,x));
+  __m128i e = _mm_and_si128(_mm_castps_si128(denorm),_mm_set1_epi32(-23));
+
+ // Split...
+  __m128i xi = _mm_castps_si128(x);
+  e = _mm_add_epi32(e,_mm_sub_epi32(_mm_srli_epi32(xi,23),_mm_set1_epi32(127)));
+  __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(xi,_mm_set1_epi32(0x007fffff)),_mm_set1_epi32(0x3f800000)));
+  __m128 big = _mm_cmpgt_ps(m,_mm_set1_ps(1.41421356f));
+  m = _mm_or_ps(_mm_and_ps(big,_mm_mul_ps(m,_mm_set1_ps(0.5f))),_mm_andnot_ps(big,m));
+  e = _mm_sub_epi32(e,_mm_castps_si128(big)); // big is all ones, i.e. -1, where set.
+
+ // Polynomial...
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 s = _mm_div_ps(_mm_sub_ps(m,one),_mm_add_ps(m,one));
+  __m128 t = _mm_mul_ps(s,s);
+  __m128 lm = _mm_mul_ps(_mm_add_ps(s,s),(a==approx3) ? Poly(t,lnCoarse,2) : Poly(t,lnFine,3));
+
+ __m128 ef = _mm_cvtepi32_ps(e);
+ __m128 ret = _mm_add_ps(_mm_mul_ps(ef,_mm_set1_ps(0.693145751953125f)),_mm_add_ps(_mm_mul_ps(ef,_mm_set1_ps(1.42860682e-6f)),lm));
+ return _mm_or_ps(_mm_and_ps(pos,ret),_mm_andnot_ps(pos,_mm_set1_ps(-Infinity<real32>())));
+}
+
+static inline __m128 SqrtSSE(__m128 x,Approx a)
+{
+ if (a==approx6) return _mm_sqrt_ps(x);
+ __m128 ret = _mm_mul_ps(x,_mm_rsqrt_ps(x)); // rsqrt is good to 3.7e-4.
+ return _mm_and_ps(ret,_mm_cmpgt_ps(x,_mm_setzero_ps()));
+}
+#endif
+
 //------------------------------------------------------------------------------
+EOS_FUNC void FastExp(const real32 * in,real32 * out,nat32 size,Approx a)
+{
+ nat32 i = 0;
+ #ifdef __SSE2__
+  for (;i+4<=size;i+=4) _mm_storeu_ps(out+i,ExpSSE(_mm_loadu_ps(in+i),a));
+ #endif
+ for (;i<size;i++) out[i] = FastExp(in[i],a);
+}
+
+EOS_FUNC void FastLn(const real32 * in,real32 * out,nat32 size,Approx a)
+{
+ nat32 i = 0;
+ #ifdef __SSE2__
+  for (;i+4<=size;i+=4) _mm_storeu_ps(out+i,LnSSE(_mm_loadu_ps(in+i),a));
+ #endif
+ for (;i<size;i++) out[i] = FastLn(in[i],a);
+}
 
-// The insertion of code here is prohibited. In the event that code is found 
-// here all coders within a 5 mile radius will be terminated. Thank you.
+EOS_FUNC void FastSqrt(const real32 * in,real32 * out,nat32 size,Approx a)
+{
+ nat32 i = 0;
+ #ifdef __SSE2__
+  for (;i+4<=size;i+=4) _mm_storeu_ps(out+i,SqrtSSE(_mm_loadu_ps(in+i),a));
+ #endif
+ for (;i<size;i++) out[i] = FastSqrt(in[i],a);
+}
 
 //------------------------------------------------------------------------------
+ };
+};
@@ -546,7 +546,7 @@ inline nat32 RotLeft(nat32 in,nat32 rot)
  #ifdef EOS_WIN32
   return _lrotl(in,rot);
  #else
-  return (in<<rot) | (rot>>(32-rot));
+  return (in<<rot) | (in>>(32-rot));
  #endif
 }
 
@@ -556,7 +556,7 @@ inline nat32 RotRight(nat32 in,nat32 rot)
  #ifdef EOS_WIN32
   return _lrotr(in,rot);
  #else
-  return (in>>rot) | (rot<<(32-rot));
+  return (in>>rot) | (in<<(32-rot));
  #endif
 }
 
@@ -926,6 +926,207 @@ inline T SigmoidCutoff(T value,T cutoff,T halfLife)
  return 0.5 - 0.5*math::Tanh((value-cutoff)/(2.0*halfLife));
 }
 
+//------------------------------------------------------------------------------
+// Half precision floating point, for storing large arrays of reals in half the
+// memory. Conversion only, no arithmetic.
+
+/// Converts a real32 to the ieee 16 bit half format, rounding to nearest, ties
+/// to even. Values too large for a half, infinities included, are clamped to 
+/// the largest finite half, so arithmetic on the results never produces nan's.
+/// Nan's stay nan, made quiet as the F16C instructions do. This is the only
+/// real32 to half conversion, math::Half uses it too.
+inline nat16 ToHalf(real32 val)
+{
+ union {real32 f; nat32 i;} u;
+ u.f = val;
+
+ nat32 sign = (u.i>>16)&0x8000;
+ nat32 e = (u.i>>23)&0xff;
+ nat32 man = u.i&0x7fffff;
+ if (e==0xff) return (man!=0) ? (sign|0x7e00|(man>>13)) : (sign|0x7bff);
+
+ int32 exp = int32(e) - 127 + 15;
+ if (exp>=31) return sign|0x7bff;
+ if (exp<=0)
+ {
+  // Subnormal or zero...
+   if (exp<-10) return sign;
+   man |= 0x800000;
+   nat32 shift = 14 - exp;
+   nat32 ret = man>>shift;
+   nat32 rem = man&((1<<shift)-1);
+   nat32 halfway = 1<<(shift-1);
+   if ((rem>halfway)||((rem==halfway)&&(ret&1))) ret += 1;
+   return sign|ret;
+ }
+
+ nat32 ret = (nat32(exp)<<10)|(man>>13);
+ nat32 rem = man&0x1fff;
+ if ((rem>0x1000)||((rem==0x1000)&&(ret&1))) ret += 1; // Can carry into the exponent, which is correct.
+ if (ret>=0x7c00) ret = 0x7bff;
+ return sign|ret;
+}
+
+/// Converts from the ieee 16 bit half format to a real32, exactly, except that
+/// nan's are made quiet, as the F16C instructions do.
+inline real32 FromHalf(nat16 val)
+{
+ nat32 sign = nat32(val&0x8000)<<16;
+ nat32 e = (val>>10)&0x1f;
+ nat32 man = val&0x3ff;
+
+ union {real32 f; nat32 i;} u;
+ if (e==0)
+ {
+  u.f = real32(man)*(1.0f/16777216.0f);
+  u.i |= sign;
+ }
+ else
+ {
+  if (e==31) u.i = sign|0x7f800000|((man!=0)?0x400000:0)|(man<<13);
+        else u.i = sign|((e+112)<<23)|(man<<13);
+ }
+ return u.f;
+}
+
+//------------------------------------------------------------------------------
+// Fast approximations of the transcendental functions, for real32's in the
+// inner loops of inference, where every label of every message goes through an
+// exp or ln. Accuracy is selectable, as a bound on the relative error, and each
+// has a batch version in functions.cpp that uses sse2 when it can. Inputs are
+// expected to be finite, with no checks for infinities or nan's.
+
+/// The precision levels of the fast functions, as the relative error that can
+/// be expected.
+enum Approx {approx3, ///< Relative error of 1e-3 or less, the cheapest.
+             approx6  ///< Relative error of 1e-6 or less, which is close to the precision of a real32 anyway.
+            };
+
+/// Fast e^x. Saturates at e^88 above, and returns 0 for x<-87, which is where
+/// the result would otherwise become denormal.
+inline real32 FastExp(real32 x,Approx a = approx6)
+{
+ if (x<-87.0f) return 0.0f;
+ if (x>88.0f) x = 88.0f;
+
+ // Range reduction, x = n ln(2) + r, with ln(2) in two parts so r is accurate...
+  real32 nf = x*1.44269504f;
+  int32 n = int32(nf + ((nf<0.0f)?-0.5f:0.5f));
+  real32 r = (x - real32(n)*0.693145751953125f) - real32(n)*1.42860682e-6f;
+
+ // Polynomial for e^r, fitted for minimax relative error over [-ln(2)/2,ln(2)/2]...
+  real32 er;
+  if (a==approx3) er = 0.99992807f + r*(1.0001642f + r*(0.50496326f + r*0.16566841f));
+             else er = 1.0000001f + r*(0.99999969f + r*(0.49998895f + r*(0.16667575f + r*(0.041915382f + r*0.0082976548f))));
+
+ // Multiply by 2^n...
+  union {real32 f; nat32 i;} u;
+  u.i = nat32(n+127)<<23;
+ return er*u.f;
+}
+
+/// Fast natural logarithm. Returns -infinity for inputs that are 0 or
+/// negative.
+inline real32 FastLn(real32 x,Approx a = approx6)
+{
+ if (x<=0.0f) return -Infinity<real32>();
+
+ // Split into mantissa and exponent, with the mantissa in [sqrt(0.5),sqrt(2))...
+  union {real32 f; nat32 i;} u;
+  u.f = x;
+  int32 e = -127;
+  if (u.i<0x00800000) {u.f *= 8388608.0f; e -= 23;} // Denormal.
+  e += int32(u.i>>23);
+  u.i = (u.i&0x007fffff)|0x3f800000;
+  if (u.f>1.41421356f) {u.f *= 0.5f; e += 1;}
+
+ // ln(m) = 2 atanh(s), with a polynomial in s^2 for atanh(s)/s, fitted for
+ // minimax relative error...
+  real32 s = (u.f-1.0f)/(u.f+1.0f);
+  real32 t = s*s;
+  real32 lm;
+  if (a==approx3) lm = 2.0f*s*(0.99997774f + t*0.33933993f);
+             else lm = 2.0f*s*(1.0000001f + t*(0.33326112f + t*0.20648186f));
+
+ return real32(e)*0.693145751953125f + (real32(e)*1.42860682e-6f + lm);
+}
+
+/// Fast square root, for non-negative inputs. The approx6 version is simply
+/// the hardware instruction, as nothing is faster at that accuracy.
+inline real32 FastSqrt(real32 x,Approx a = approx6)
+{
+ if (a==approx6) return ::sqrtf(x);
+
+ // Magic number inverse square root plus one step of a modified Newton
+ // iteration, constants from Moroz et al...
+  union {real32 f; nat32 i;} u;
+  u.f = x;
+  u.i = 0x5f1ffff9 - (u.i>>1);
+  real32 y = u.f;
+  y = 0.703952253f*y*(2.38924456f - x*y*y);
+ return x*y;
+}
+
+
+/// The batch version of FastExp, out[i] = FastExp(in[i]). in and out can be
+/// the same array.
+EOS_FUNC void FastExp(const real32 * in,real32 * out,nat32 size,Approx a = approx6);
+
+/// The batch version of FastLn, out[i] = FastLn(in[i]). in and out can be
+/// the same array.
+EOS_FUNC void FastLn(const real32 * in,real32 * out,nat32 size,Approx a = approx6);
+
+/// The batch version of FastSqrt, out[i] = FastSqrt(in[i]). in and out can be
+/// the same array.
+EOS_FUNC void FastSqrt(const real32 * in,real32 * out,nat32 size,Approx a = approx6);
+
+//------------------------------------------------------------------------------
+// What the inference and shape from shading kernels call in there hot loops.
+// By default these are the standard functions, but if EOS_FAST_MATH is defined
+// they become the fast approximations, at approx6, or approx3 if
+// EOS_FAST_MATH_COARSE is defined as well. (Switch this on in the makefile.)
+
+#ifdef EOS_FAST_MATH
+#ifdef EOS_FAST_MATH_COARSE
+static const Approx kernelApprox = approx3;
+#else
+static const Approx kernelApprox = approx6;
+#endif
+
+/// &nbsp;
+inline real32 KernelExp(real32 x) {return FastExp(x,kernelApprox);}
+
+/// &nbsp;
+inline real32 KernelLn(real32 x) {return FastLn(x,kernelApprox);}
+
+/// &nbsp;
+inline real32 KernelSqrt(real32 x) {return FastSqrt(x,kernelApprox);}
+
+/// &nbsp;
+inline void KernelExp(const real32 * in,real32 * out,nat32 size) {FastExp(in,out,size,kernelApprox);}
+
+/// &nbsp;
+inline void KernelLn(const real32 * in,real32 * out,nat32 size) {FastLn(in,out,size,kernelApprox);}
+
+#else
+
+/// &nbsp;
+inline real32 KernelExp(real32 x) {return Exp(x);}
+
+/// &nbsp;
+inline real32 KernelLn(real32 x) {return Ln(x);}
+
+/// &nbsp;
+inline real32 KernelSqrt(real32 x) {return Sqrt(x);}
+
+/// &nbsp;
+inline void KernelExp(const real32 * in,real32 * out,nat32 size) {for (nat32 i=0;i<size;i++) out[i] = Exp(in[i]);}
+
+/// &nbsp;
+inline void KernelLn(const real32 * in,real32 * out,nat32 size) {for (nat32 i=0;i<size;i++) out[i] = Ln(in[i]);}
+
+#endif
+
 //------------------------------------------------------------------------------
  };
 };
@@ -121,9 +121,89 @@ Gauss2D & Gauss2D::operator *= (const Gauss2D & rhs)
  return *this;
 }
 
+//------------------------------------------------------------------------------
+// The E-step of GaussMix1D::Fit, each block of samples sums the weight,
+// weighted sum and weighted sum of squares of each component into 3 entries of
+// stats...
+class GaussMix1D::EStep
+{
+ public:
+  EStep(const GaussMix1D & s,const real32 * xx,nat32 off,nat32 str,nat32 n,real64 * st,real64 * ll)
+  :self(s),x(xx),offset(off),stride(str),count(n),stats(st),logLike(ll)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   const nat32 k = self.Size();
+   real64 * norm = new real64[k*3];
+   real64 * scale = norm + k;
+   real64 * lp = norm + 2*k;
+
+   for (nat32 j=0;j<k;j++)
+   {
+    const WeightGauss & wg = self[j];
+    if (wg.prob>0.0) norm[j] = math::Ln(real64(wg.prob)/(wg.sd*math::Sqrt(2.0*pi)));
+                else norm[j] = -math::Infinity<real64>();
+    scale[j] = -0.5/math::Sqr(real64(wg.sd));
+   }
+
+   for (nat32 b=b0;b<b1;b++)
+   {
+    real64 * st = stats + b*k*3;
+    for (nat32 j=0;j<k*3;j++) st[j] = 0.0;
+
+    real64 ll = 0.0;
+    nat32 end = math::Min(count,(b+1)*block);
+    for (nat32 i=b*block;i<end;i++)
+    {
+     real64 v = x[offset + i*stride];
+
+     real64 best = -math::Infinity<real64>();
+     for (nat32 j=0;j<k;j++)
+     {
+      lp[j] = norm[j] + scale[j]*math::Sqr(v - self[j].mean);
+      best = math::Max(best,lp[j]);
+     }
+
+     real64 sum = 0.0;
+     for (nat32 j=0;j<k;j++)
+     {
+      lp[j] = math::Exp(lp[j] - best);
+      sum += lp[j];
+     }
+     ll += best + math::Ln(sum);
+
+     sum = 1.0/sum;
+     for (nat32 j=0;j<k;j++)
+     {
+      real64 resp = lp[j] * sum;
+      st[j*3] += resp;
+      st[j*3+1] += resp * v;
+      st[j*3+2] += resp * v * v;
+     }
+    }
+    logLike[b] = ll;
+   }
+
+   delete[] norm;
+  }
+
+  static const nat32 block = 4096;
+
+
+ private:
+  const GaussMix1D & self;
+  const real32 * x;
+  nat32 offset;
+  nat32 stride;
+  nat32 count;
+  real64 * stats;
+  real64 * logLike;
+};
+
 //------------------------------------------------------------------------------
 GaussMix1D::GaussMix1D(nat32 sz)
-:ds::Array<WeightGauss>(sz)
+:ds::Array<WeightGauss>(sz),logLike(0.0)
 {}
 
 GaussMix1D::~GaussMix1D()
@@ -182,6 +262,99 @@ real32 min = Lowest();
  return ret;
 }
 
+void GaussMix1D::InitFit(const real32 * x,nat32 count)
+{
+ if ((Size()==0)||(count==0)) return;
+
+ real32 low = x[0];
+ real32 high = x[0];
+ for (nat32 i=1;i<count;i++)
+ {
+  low = math::Min(low,x[i]);
+  high = math::Max(high,x[i]);
+ }
+
+ real32 gap = (high-low)/real32(Size());
+ if (math::IsZero(gap)) gap = 1.0;
+ for (nat32 j=0;j<Size();j++)
+ {
+  (*this)[j].mean = low + (real32(j)+0.5)*gap;
+  (*this)[j].sd = gap;
+  (*this)[j].prob = 1.0/real32(Size());
+ }
+}
+
+nat32 GaussMix1D::Fit(const real32 * x,nat32 count,nat32 maxIters,real32 tol,
+                      real32 minSd,nat32 batch,time::Progress * prog)
+{
+ LogTime("eos::math::GaussMix1D::Fit");
+ const nat32 k = Size();
+ if ((k==0)||(count==0)) return 0;
+
+ // Work out the blocks, and the strided subset for mini-batches...
+  bit mini = (batch!=0)&&(batch<count);
+  nat32 n = mini?batch:count;
+  nat32 stride = mini?(count/batch):1;
+  nat32 blocks = (n+EStep::block-1)/EStep::block;
+
+  ds::Array<real64> stats(blocks*k*3);
+  ds::Array<real64> blockLL(blocks);
+  ds::Array<real64> avg(k*3);
+  for (nat32 j=0;j<k*3;j++) avg[j] = 0.0;
+
+ // Iterate...
+  nat32 iter;
+  real64 prevLL = -math::Infinity<real64>();
+  prog->Push();
+  for (iter=0;iter<maxIters;iter++)
+  {
+   prog->Report(iter,maxIters);
+
+   // E-step...
+    EStep es(*this,x,mini?(iter%stride):0,stride,n,stats.Ptr(),blockLL.Ptr());
+    mt::ParallelFor(nat32(0),blocks,es);
+
+   // Merge the blocks, in order, into per sample statistics, blending them in
+   // when doing mini-batches...
+    real64 eta = (mini&&(iter!=0))?math::Pow(real64(iter+1),-0.6):1.0;
+    real64 mult = 1.0/real64(n);
+
+    logLike = 0.0;
+    for (nat32 b=0;b<blocks;b++) logLike += blockLL[b];
+    logLike *= mult;
+
+    for (nat32 j=0;j<k*3;j++)
+    {
+     real64 sum = 0.0;
+     for (nat32 b=0;b<blocks;b++) sum += stats[b*k*3+j];
+     avg[j] = (1.0-eta)*avg[j] + eta*mult*sum;
+    }
+
+   // M-step - a component that has lost all its samples is given a
+   // probability of 0, which it then keeps...
+    real64 totalW = 0.0;
+    for (nat32 j=0;j<k;j++) totalW += avg[j*3];
+
+    for (nat32 j=0;j<k;j++)
+    {
+     real64 w = avg[j*3];
+     WeightGauss & wg = (*this)[j];
+     if (w<1e-12*totalW) {wg.prob = 0.0; continue;}
+
+     wg.prob = w/totalW;
+     wg.mean = avg[j*3+1]/w;
+     wg.sd = math::Sqrt(math::Max(avg[j*3+2]/w - math::Sqr(real64(wg.mean)),real64(math::Sqr(minSd))));
+    }
+
+   // Check for convergence...
+    if ((!mini)&&((logLike-prevLL)<tol)) {++iter; break;}
+    prevLL = logLike;
+  }
+  prog->Pop();
+
+ return iter;
+}
+
 real32 GaussMix1D::MaxMode(real32 tol,nat32 limit) const
 {
  LogTime("eos::math::GaussMix1D::MaxMode");
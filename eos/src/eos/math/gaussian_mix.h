@@ -27,7 +27,10 @@
 #include "eos/math/functions.h"
 #include "eos/math/vectors.h"
 #include "eos/math/matrices.h"
+#include "eos/math/mat_ops.h"
 #include "eos/ds/arrays.h"
+#include "eos/mt/tasks.h"
+#include "eos/time/progress.h"
 
 namespace eos
 {
@@ -298,6 +301,40 @@ class EOS_CLASS GaussMix1D : public ds::Array<WeightGauss>
    Vector<real32> * GetSamples(nat32 samples) const;
 
 
+  /// Initialises the mixture for Fit, keeping its current size - the means
+  /// are spread evenly over the range of the given samples, with equal
+  /// probabilities and a standard deviation of the gap between means.
+   void InitFit(const real32 * x,nat32 count);
+
+  /// Fits the mixture to a set of samples with expectation maximisation,
+  /// starting from its current contents, see InitFit. Each pass is split
+  /// into blocks of samples between the threads of the task pool, each block
+  /// summing the sufficient statistics of every component, so the
+  /// responsibilities are never stored. The blocks depend only on the sample
+  /// count, so the result is the same however many threads there are.
+  /// \param x The samples.
+  /// \param count How many samples there are.
+  /// \param maxIters Maximum number of iterations.
+  /// \param tol Stops once the average log likelihood of the samples improves
+  ///            by less than this. Not used in mini-batch mode.
+  /// \param minSd Floor on the standard deviations, so components can't
+  ///              collapse onto a single value.
+  /// \param batch If 0, or not less than count, every iteration uses every
+  ///              sample. Otherwise each iteration takes a strided subset of
+  ///              this many samples, and blends its statistics into a
+  ///              running average with a decreasing step size, i.e. stepwise
+  ///              EM. For very large inputs, where a few passes over subsets
+  ///              get most of the way there. Runs for all maxIters.
+  /// \param prog Optional progress reporter.
+  /// \returns The number of iterations done.
+   nat32 Fit(const real32 * x,nat32 count,nat32 maxIters = 100,real32 tol = 1e-5,
+             real32 minSd = 1e-3,nat32 batch = 0,time::Progress * prog = null<time::Progress*>());
+
+  /// Returns the average log likelihood of the samples given to Fit, as of
+  /// its last iteration. For mini-batches it is of the last batch only.
+   real64 LogLikelihood() const {return logLike;}
+
+
   /// Finds the position of the highest mode in the expressed pdf.
   /// Runs a fixed point iterative algorithm from every gaussian in the mixture,
   /// and whilst it optimises out overlap as its in the 1D domain in general the
@@ -353,53 +390,454 @@ class EOS_CLASS GaussMix1D : public ds::Array<WeightGauss>
   // Helper for MaxMode - given a range it returns the best mode in the range
   // found. Recursive, does limited tail recursion...
    void BestInRange(real32 lower,real32 upper,real32 & bsf,real32 & fbsf,real32 tol,nat32 limit) const;
+
+  real64 logLike;
+
+  class EStep;
 };
 
 //------------------------------------------------------------------------------
-/// This represents a Gaussian Mixture. This is a density function
-/// (Integrates to 1 over [-inf,+inf], allways positive.) that approximatly
-/// represents a function of some kind using a set of weighted gaussian functions.
-/// Provides operations to multiply, add and construct from function pointers,
-/// vectors etc. Suport for integration and differentiation is also provided.
-/// Of course, it allows for sampling the represented function.
-///
-/// This implimentation is designed to be insanly efficient, and internally uses
-/// a balanced kd tree to sort the kernels, which it then uses for the various
-/// operations. Additional information is stored beyond the gaussian parameters
-/// for each function to assist with this, though it does still keep a 
-/// reasonably small memory footprint. In fact, multiple implimentations of
-/// certain algorithms are provided so the user can choose the level of speed 
-/// versus accuracy to go for. The number of gaussians to use for representation
-/// is runtime selectable.
+/// This represents a D dimensional Gaussian Mixture, a density function that
+/// is the weighted sum of gaussians with full covariance matrices. Its main
+/// purpose is to be fitted to data, e.g. a colour model over many pixels.
 ///
-/// Templated on the dimensionality, as it can work in any dimension. Note that
-/// this shouldn't really surpass 3, as it just can't be trusted at that point.
+/// Fitting is by expectation maximisation, which never stores the
+/// responsibilities - each pass splits the samples into blocks, shared
+/// between the threads of the task pool, and each block sums the sufficient
+/// statistics of every component, the weight, weighted sum and weighted outer
+/// product, which are then merged. Memory use therefore does not depend on
+/// the number of samples, and, as the blocks are decided by the sample count
+/// alone, the result does not depend on the number of threads. For very large
+/// inputs there is also a mini-batch mode, see Fit.
 ///
-/// NOT IMPLIMENTED.
+/// Templated on the dimensionality. The cost of each sample goes up with D^2
+/// for each component, so this is intended for small D.
 template <nat32 D>
 class EOS_CLASS GaussMix
 {
  public:
-  /// Provided with the number of member gaussians to use for the
-  /// representation, constructs it containning random data.
-   GaussMix(nat32 mg);
-   
+  /// Provided with the number of member gaussians, all of which are
+  /// initialised with an equal weight, a mean of zero and identity
+  /// covariance.
+   GaussMix(nat32 mg = 0);
+
   /// &nbsp;
    ~GaussMix();
 
 
+  /// Returns how many member gaussians there are.
+   nat32 Size() const {return comp.Size();}
+
+  /// Resizes, resetting all members as for the constructor.
+   void SetSize(nat32 mg);
+
+
+  /// Weight of a member, the set of weights sums to 1.
+   real32 & Weight(nat32 i) {return comp[i].weight;}
+
+  /// &nbsp;
+   const real32 & Weight(nat32 i) const {return comp[i].weight;}
+
+  /// Mean of a member.
+   Vect<D> & Mean(nat32 i) {return comp[i].mean;}
+
+  /// &nbsp;
+   const Vect<D> & Mean(nat32 i) const {return comp[i].mean;}
+
+  /// Covariance of a member.
+   Mat<D> & Covar(nat32 i) {return comp[i].covar;}
+
+  /// &nbsp;
+   const Mat<D> & Covar(nat32 i) const {return comp[i].covar;}
+
+  /// Must be called after editing the members directly, before using LogF, F
+  /// or Responsibilities. Returns false if a covariance matrix is not
+  /// positive definite, in which case this object is not usable.
+   bit Update();
+
+
+  /// Initialises the mixture for Fit, keeping its current size - the means
+  /// are set to samples spread evenly through the array, with equal weights
+  /// and the covariance of the samples for every member.
+   void InitFit(const Vect<D> * x,nat32 count);
+
+  /// Fits the mixture to a set of samples with expectation maximisation,
+  /// starting from its current contents, see InitFit.
+  /// \param x The samples.
+  /// \param count How many samples there are.
+  /// \param maxIters Maximum number of iterations.
+  /// \param tol Stops once the average log likelihood of the samples improves
+  ///            by less than this. Not used in mini-batch mode.
+  /// \param minVar Added to the diagonal of every covariance matrix, so they
+  ///               stay positive definite.
+  /// \param batch If 0, or not less than count, every iteration uses every
+  ///              sample. Otherwise each iteration takes a strided subset of
+  ///              this many samples, and blends its statistics into a
+  ///              running average with a decreasing step size, i.e. stepwise
+  ///              EM. Runs for all maxIters.
+  /// \param prog Optional progress reporter.
+  /// \returns The number of iterations done, 0 if it could not start, due to
+  ///          the covariances not being positive definite.
+   nat32 Fit(const Vect<D> * x,nat32 count,nat32 maxIters = 100,real32 tol = 1e-5,
+             real32 minVar = 1e-6,nat32 batch = 0,time::Progress * prog = null<time::Progress*>());
+
+  /// Returns the average log likelihood of the samples given to Fit, as of
+  /// its last iteration. For mini-batches it is of the last batch only.
+   real64 LogLikelihood() const {return logLike;}
+
+
+  /// Returns the natural logarithm of the density at the given point.
+   real32 LogF(const Vect<D> & x) const
+   {
+    real64 * lp = new real64[Size()];
+     real64 ret = LogComp(x,lp);
+    delete[] lp;
+    return ret;
+   }
+
+  /// Returns the density at the given point.
+   real32 F(const Vect<D> & x) const {return math::Exp(LogF(x));}
+
+  /// Outputs the probability of each member given the point, into out, which
+  /// must have Size() entries.
+   void Responsibilities(const Vect<D> & x,real32 * out) const
+   {
+    real64 * lp = new real64[Size()];
+     real64 total = LogComp(x,lp);
+     for (nat32 j=0;j<Size();j++) out[j] = math::Exp(lp[j] - total);
+    delete[] lp;
+   }
+
+
   /// &nbsp;
-   static inline cstrconst TypeString() 
+   static inline cstrconst TypeString()
    {
     static GlueStr ret(GlueStr() << "eos::math::GaussMix<" << D << ">");
     return ret;
-   } 
+   }
 
 
  private:
- 
+  struct Member
+  {
+   real32 weight;
+   Vect<D> mean;
+   Mat<D> covar;
+
+   real64 logNorm; // ln(weight) - 0.5 ln(det(2 pi covar)), -infinity if weight is 0.
+   Mat<D,D,real64> chol; // Lower triangle is the Cholesky factor of covar.
+  };
+
+  ds::Array<Member> comp;
+  real64 logLike;
+
+  // Sufficient statistics of a member for a set of samples...
+   struct Stats
+   {
+    real64 w;
+    real64 s1[D];
+    real64 s2[D][D]; // Only the lower triangle is used.
+   };
+
+  // Outputs the log probability of each member for a point, into lp, and
+  // returns the log of there sum...
+   real64 LogComp(const Vect<D> & x,real64 * lp) const;
+
+  // The E-step, as a functor for the task pool...
+   class EStep;
+};
+
+//------------------------------------------------------------------------------
+template <nat32 D>
+class GaussMix<D>::EStep
+{
+ public:
+  EStep(const GaussMix<D> & s,const Vect<D> * xx,nat32 off,nat32 str,nat32 n,Stats * st,real64 * ll)
+  :self(s),x(xx),offset(off),stride(str),count(n),stats(st),logLike(ll)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   const nat32 k = self.Size();
+   real64 * lp = new real64[k];
+
+   for (nat32 b=b0;b<b1;b++)
+   {
+    Stats * st = stats + b*k;
+    for (nat32 j=0;j<k;j++)
+    {
+     st[j].w = 0.0;
+     for (nat32 r=0;r<D;r++)
+     {
+      st[j].s1[r] = 0.0;
+      for (nat32 c=0;c<=r;c++) st[j].s2[r][c] = 0.0;
+     }
+    }
+
+    real64 ll = 0.0;
+    nat32 end = math::Min(count,(b+1)*block);
+    for (nat32 i=b*block;i<end;i++)
+    {
+     const Vect<D> & v = x[offset + i*stride];
+     real64 total = self.LogComp(v,lp);
+     ll += total;
+
+     for (nat32 j=0;j<k;j++)
+     {
+      real64 resp = math::Exp(lp[j] - total);
+      if (resp<1e-12) continue;
+
+      st[j].w += resp;
+      for (nat32 r=0;r<D;r++)
+      {
+       real64 rv = resp * v[r];
+       st[j].s1[r] += rv;
+       for (nat32 c=0;c<=r;c++) st[j].s2[r][c] += rv * v[c];
+      }
+     }
+    }
+    logLike[b] = ll;
+   }
+
+   delete[] lp;
+  }
+
+  static const nat32 block = 4096;
+
+
+ private:
+  const GaussMix<D> & self;
+  const Vect<D> * x;
+  nat32 offset;
+  nat32 stride;
+  nat32 count;
+  Stats * stats;
+  real64 * logLike;
 };
 
+//------------------------------------------------------------------------------
+template <nat32 D>
+inline GaussMix<D>::GaussMix(nat32 mg)
+:logLike(0.0)
+{
+ SetSize(mg);
+}
+
+template <nat32 D>
+inline GaussMix<D>::~GaussMix()
+{}
+
+template <nat32 D>
+inline void GaussMix<D>::SetSize(nat32 mg)
+{
+ comp.Size(mg);
+ for (nat32 j=0;j<mg;j++)
+ {
+  comp[j].weight = 1.0/real32(mg);
+  comp[j].mean = Vect<D>(0.0);
+  Identity(comp[j].covar);
+ }
+ Update();
+}
+
+template <nat32 D>
+inline bit GaussMix<D>::Update()
+{
+ for (nat32 j=0;j<Size();j++)
+ {
+  Member & m = comp[j];
+  for (nat32 r=0;r<D;r++)
+  {
+   for (nat32 c=0;c<=r;c++) m.chol[r][c] = m.covar[r][c];
+  }
+  if (!Cholesky(m.chol)) return false;
+
+  if (m.weight>0.0)
+  {
+   real64 logDet = real64(D) * math::Ln(2.0*pi);
+   for (nat32 r=0;r<D;r++) logDet += 2.0*math::Ln(m.chol[r][r]);
+   m.logNorm = math::Ln(real64(m.weight)) - 0.5*logDet;
+  }
+  else m.logNorm = -math::Infinity<real64>();
+ }
+ return true;
+}
+
+template <nat32 D>
+inline real64 GaussMix<D>::LogComp(const Vect<D> & x,real64 * lp) const
+{
+ real64 best = -math::Infinity<real64>();
+ for (nat32 j=0;j<Size();j++)
+ {
+  const Member & m = comp[j];
+
+  // Mahalanobis distance, by forward substitution with the Cholesky factor...
+   real64 d[D];
+   real64 maha = 0.0;
+   for (nat32 r=0;r<D;r++)
+   {
+    real64 v = x[r] - m.mean[r];
+    for (nat32 c=0;c<r;c++) v -= m.chol[r][c] * d[c];
+    d[r] = v / m.chol[r][r];
+    maha += math::Sqr(d[r]);
+   }
+
+  lp[j] = m.logNorm - 0.5*maha;
+  best = math::Max(best,lp[j]);
+ }
+
+ real64 sum = 0.0;
+ for (nat32 j=0;j<Size();j++) sum += math::Exp(lp[j] - best);
+ return best + math::Ln(sum);
+}
+
+template <nat32 D>
+inline void GaussMix<D>::InitFit(const Vect<D> * x,nat32 count)
+{
+ if ((Size()==0)||(count==0)) return;
+
+ // Covariance of the samples, from a subset if there are lots...
+  nat32 stride = math::Max<nat32>(count/100000,1);
+  real64 samples = 0.0;
+  Vect<D,real64> mean(0.0);
+  Mat<D,D,real64> sqr;
+  Zero(sqr);
+  for (nat32 i=0;i<count;i+=stride)
+  {
+   samples += 1.0;
+   for (nat32 r=0;r<D;r++)
+   {
+    mean[r] += x[i][r];
+    for (nat32 c=0;c<=r;c++) sqr[r][c] += real64(x[i][r]) * real64(x[i][c]);
+   }
+  }
+  mean /= samples;
+
+  Mat<D> covar;
+  for (nat32 r=0;r<D;r++)
+  {
+   for (nat32 c=0;c<=r;c++)
+   {
+    covar[r][c] = sqr[r][c]/samples - mean[r]*mean[c];
+    covar[c][r] = covar[r][c];
+   }
+  }
+
+ // Set the members...
+  for (nat32 j=0;j<Size();j++)
+  {
+   nat32 ind = nat32((nat64(2*j+1)*nat64(count))/nat64(2*Size()));
+   comp[j].weight = 1.0/real32(Size());
+   comp[j].mean = x[ind];
+   comp[j].covar = covar;
+  }
+}
+
+template <nat32 D>
+inline nat32 GaussMix<D>::Fit(const Vect<D> * x,nat32 count,nat32 maxIters,real32 tol,
+                              real32 minVar,nat32 batch,time::Progress * prog)
+{
+ LogTime("eos::math::GaussMix::Fit");
+ const nat32 k = Size();
+ if ((k==0)||(count==0)||(!Update())) return 0;
+
+ // Work out the blocks, and the strided subset for mini-batches...
+  bit mini = (batch!=0)&&(batch<count);
+  nat32 n = mini?batch:count;
+  nat32 stride = mini?(count/batch):1;
+  nat32 blocks = (n+EStep::block-1)/EStep::block;
+
+  ds::Array<Stats> stats(blocks*k);
+  ds::Array<real64> blockLL(blocks);
+  ds::Array<Stats> avg(k);
+  for (nat32 j=0;j<k;j++)
+  {
+   avg[j].w = 0.0;
+   for (nat32 r=0;r<D;r++)
+   {
+    avg[j].s1[r] = 0.0;
+    for (nat32 c=0;c<=r;c++) avg[j].s2[r][c] = 0.0;
+   }
+  }
+
+ // Iterate...
+  nat32 iter;
+  real64 prevLL = -math::Infinity<real64>();
+  prog->Push();
+  for (iter=0;iter<maxIters;iter++)
+  {
+   prog->Report(iter,maxIters);
+
+   // E-step...
+    EStep es(*this,x,mini?(iter%stride):0,stride,n,stats.Ptr(),blockLL.Ptr());
+    mt::ParallelFor(nat32(0),blocks,es);
+
+   // Merge the blocks, in order, into per sample statistics, blending them in
+   // when doing mini-batches...
+    real64 eta = (mini&&(iter!=0))?math::Pow(real64(iter+1),-0.6):1.0;
+    real64 mult = 1.0/real64(n);
+
+    logLike = 0.0;
+    for (nat32 b=0;b<blocks;b++) logLike += blockLL[b];
+    logLike *= mult;
+
+    for (nat32 j=0;j<k;j++)
+    {
+     Stats sum = stats[j];
+     for (nat32 b=1;b<blocks;b++)
+     {
+      const Stats & st = stats[b*k+j];
+      sum.w += st.w;
+      for (nat32 r=0;r<D;r++)
+      {
+       sum.s1[r] += st.s1[r];
+       for (nat32 c=0;c<=r;c++) sum.s2[r][c] += st.s2[r][c];
+      }
+     }
+
+     Stats & a = avg[j];
+     a.w = (1.0-eta)*a.w + eta*mult*sum.w;
+     for (nat32 r=0;r<D;r++)
+     {
+      a.s1[r] = (1.0-eta)*a.s1[r] + eta*mult*sum.s1[r];
+      for (nat32 c=0;c<=r;c++) a.s2[r][c] = (1.0-eta)*a.s2[r][c] + eta*mult*sum.s2[r][c];
+     }
+    }
+
+   // M-step - a member that has lost all its samples is given a weight of 0,
+   // which it then keeps...
+    real64 totalW = 0.0;
+    for (nat32 j=0;j<k;j++) totalW += avg[j].w;
+
+    for (nat32 j=0;j<k;j++)
+    {
+     const Stats & a = avg[j];
+     Member & m = comp[j];
+     if (a.w<1e-12*totalW) {m.weight = 0.0; continue;}
+
+     m.weight = a.w/totalW;
+     for (nat32 r=0;r<D;r++) m.mean[r] = a.s1[r]/a.w;
+     for (nat32 r=0;r<D;r++)
+     {
+      for (nat32 c=0;c<=r;c++)
+      {
+       m.covar[r][c] = a.s2[r][c]/a.w - real64(m.mean[r])*real64(m.mean[c]);
+       m.covar[c][r] = m.covar[r][c];
+      }
+      m.covar[r][r] += minVar;
+     }
+    }
+    if (!Update()) {++iter; break;}
+
+   // Check for convergence...
+    if ((!mini)&&((logLike-prevLL)<tol)) {++iter; break;}
+    prevLL = logLike;
+  }
+  prog->Pop();
+
+ return iter;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -17,17 +17,349 @@
 
 #include "eos/math/iter_min.h"
 
+#include "eos/mt/tasks.h"
+
 namespace eos
 {
  namespace math
  {
+//------------------------------------------------------------------------------
+// Calculates the error vectors, from either the current or the new parameters...
+class SparseLM::Errors
+{
+ public:
+  Errors(SparseLM & s,bit f)
+  :self(s),fresh(f)
+  {}
+
+  void operator () (nat32 p0,nat32 p1)
+  {
+   for (nat32 i=p0;i<p1;i++)
+   {
+    PairNode * targ = self.pairs[i];
+    if (fresh) (targ->F)(*self.paraA[targ->a]->para,*self.paraB[targ->b]->para,*targ->m,*targ->err);
+          else (targ->F)(*self.paraA[targ->a]->paraNew,*self.paraB[targ->b]->paraNew,*targ->m,*targ->errNew);
+   }
+  }
+
+
+ private:
+  SparseLM & self;
+  bit fresh;
+};
+
+//------------------------------------------------------------------------------
+// Fills in the jacobians of each pair, by forward differences...
+class SparseLM::Jacobians
+{
+ public:
+  Jacobians(SparseLM & s)
+  :self(s)
+  {}
+
+  void operator () (nat32 p0,nat32 p1)
+  {
+   Vector<real64> tempParaA(self.sizeA);
+   Vector<real64> tempParaB(self.sizeB);
+   Vector<real64> tempErr(self.sizeErr);
+
+   for (nat32 i=p0;i<p1;i++)
+   {
+    PairNode * targ = self.pairs[i];
+    const Vector<real64> & pa = *self.paraA[targ->a]->para;
+    const Vector<real64> & pb = *self.paraB[targ->b]->para;
+
+    // Jacobian A...
+     tempParaA = pa;
+     for (nat32 c=0;c<targ->aJacob->Cols();c++)
+     {
+      real64 delta = Max(Abs(10e-4 * tempParaA[c]),10e-6);
+      tempParaA[c] += delta;
+
+      (targ->F)(tempParaA,pb,*targ->m,tempErr);
+      delta = 1.0/delta;
+      for (nat32 r=0;r<targ->aJacob->Rows();r++)
+      {
+       (*targ->aJacob)[r][c] = (tempErr[r] - (*targ->err)[r])*delta;
+      }
+
+      tempParaA[c] = pa[c];
+     }
+
+    // B Jacobian...
+     tempParaB = pb;
+     for (nat32 c=0;c<targ->bJacob->Cols();c++)
+     {
+      real64 delta = Max(Abs(10e-4 * tempParaB[c]),10e-6);
+      tempParaB[c] += delta;
+
+      (targ->F)(pa,tempParaB,*targ->m,tempErr);
+      delta = 1.0/delta;
+      for (nat32 r=0;r<targ->bJacob->Rows();r++)
+      {
+       (*targ->bJacob)[r][c] = (tempErr[r] - (*targ->err)[r])*delta;
+      }
+
+      tempParaB[c] = pb[c];
+     }
+   }
+  }
+
+
+ private:
+  SparseLM & self;
+};
+
+//------------------------------------------------------------------------------
+// Sums up U and e for each entry of the first list. e is the negative gradient,
+// as the error functions give the error, not the measurement...
+class SparseLM::SumA
+{
+ public:
+  SumA(SparseLM & s)
+  :self(s)
+  {}
+
+  void operator () (nat32 a0,nat32 a1)
+  {
+   Matrix<real64> tempAerr(self.sizeA,self.sizeErr);
+   Matrix<real64> tempU(self.sizeA,self.sizeA);
+   Vector<real64> tempParaA(self.sizeA);
+
+   for (nat32 i=a0;i<a1;i++)
+   {
+    ParaNode & pn = *self.paraA[i];
+    Zero(*pn.uv);
+    for (nat32 j=0;j<pn.e->Size();j++) (*pn.e)[j] = 0.0;
+
+    PairNode * targ = self.listA[i];
+    while (targ)
+    {
+     if (targ->covarInv)
+     {
+      TransMult(*targ->aJacob,*targ->covarInv,tempAerr);
+      Mult(tempAerr,*targ->aJacob,tempU);
+      MultVect(tempAerr,*targ->err,tempParaA);
+     }
+     else
+     {
+      TransMult(*targ->aJacob,*targ->aJacob,tempU);
+      TransMultVect(*targ->aJacob,*targ->err,tempParaA);
+     }
+     *pn.uv += tempU;
+     *pn.e -= tempParaA;
+     targ = targ->nextA;
+    }
+   }
+  }
+
+
+ private:
+  SparseLM & self;
+};
+
+//------------------------------------------------------------------------------
+// Sums up V and e for each entry of the second list, and calculates W for each
+// of its pairs whilst at it...
+class SparseLM::SumB
+{
+ public:
+  SumB(SparseLM & s)
+  :self(s)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   Matrix<real64> tempAerr(self.sizeA,self.sizeErr);
+   Matrix<real64> tempBerr(self.sizeB,self.sizeErr);
+   Matrix<real64> tempV(self.sizeB,self.sizeB);
+   Vector<real64> tempParaB(self.sizeB);
+
+   for (nat32 i=b0;i<b1;i++)
+   {
+    ParaNode & pn = *self.paraB[i];
+    Zero(*pn.uv);
+    for (nat32 j=0;j<pn.e->Size();j++) (*pn.e)[j] = 0.0;
+
+    PairNode * targ = self.listB[i];
+    while (targ)
+    {
+     if (targ->covarInv)
+     {
+      TransMult(*targ->bJacob,*targ->covarInv,tempBerr);
+      Mult(tempBerr,*targ->bJacob,tempV);
+      MultVect(tempBerr,*targ->err,tempParaB);
+
+      TransMult(*targ->aJacob,*targ->covarInv,tempAerr);
+      Mult(tempAerr,*targ->bJacob,*targ->w);
+     }
+     else
+     {
+      TransMult(*targ->bJacob,*targ->bJacob,tempV);
+      TransMultVect(*targ->bJacob,*targ->err,tempParaB);
+
+      TransMult(*targ->aJacob,*targ->bJacob,*targ->w);
+     }
+     *pn.uv += tempV;
+     *pn.e -= tempParaB;
+     targ = targ->nextB;
+    }
+   }
+  }
+
+
+ private:
+  SparseLM & self;
+};
+
+//------------------------------------------------------------------------------
+// Inverts the augmented V of each entry of the second list, once, and then makes
+// Y for each of its pairs...
+class SparseLM::ReduceB
+{
+ public:
+  ReduceB(SparseLM & s,real64 l)
+  :self(s),lambda(l)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   Matrix<real64> temp(self.sizeB,self.sizeB);
+
+   for (nat32 i=b0;i<b1;i++)
+   {
+    ParaNode & pn = *self.paraB[i];
+    *pn.inv = *pn.uv;
+    for (nat32 j=0;j<self.sizeB;j++) (*pn.inv)[j][j] *= 1.0 + lambda;
+    if (Inverse(*pn.inv,temp)==false) Zero(*pn.inv); // Unconstrained, so leave it be.
+
+    PairNode * targ = self.listB[i];
+    while (targ)
+    {
+     Mult(*targ->w,*pn.inv,*targ->y);
+     targ = targ->nextB;
+    }
+   }
+  }
+
+
+ private:
+  SparseLM & self;
+  real64 lambda;
+};
+
+//------------------------------------------------------------------------------
+// Fills in the block rows of the reduced system and its right hand side, one
+// entry of the first list at a time. Each only writes its own rows, so they
+// can be done at once...
+class SparseLM::ReduceA
+{
+ public:
+  ReduceA(SparseLM & s,real64 l)
+  :self(s),lambda(l)
+  {}
+
+  void operator () (nat32 a0,nat32 a1)
+  {
+   const nat32 sizeA = self.sizeA;
+   Matrix<real64> tempU(sizeA,sizeA);
+   Vector<real64> tempParaA(sizeA);
+
+   for (nat32 br=a0;br<a1;br++)
+   {
+    nat32 base = br*sizeA;
+
+    // Start with the augmented U, zeroing the rest of the rows...
+     for (nat32 r=0;r<sizeA;r++)
+     {
+      for (nat32 i=self.s.RowBegin(base+r);i<self.s.RowEnd(base+r);i++) self.s.Value(i) = 0.0;
+
+      nat32 d = self.Block(br,br,r);
+      for (nat32 c=0;c<sizeA;c++) self.s.Value(d+c) = (*self.paraA[br]->uv)[r][c];
+      self.s.Value(d+r) *= 1.0 + lambda;
+     }
+
+     for (nat32 j=0;j<sizeA;j++) self.es[base+j] = (*self.paraA[br]->e)[j];
+
+    // Subtract the combinations for each point, for every pair of entrys
+    // that share it...
+     PairNode * targ = self.listA[br];
+     while (targ)
+     {
+      PairNode * other = self.listB[targ->b];
+      while (other)
+      {
+       MultTrans(*targ->y,*other->w,tempU);
+       for (nat32 r=0;r<sizeA;r++)
+       {
+        nat32 d = self.Block(br,other->a,r);
+        for (nat32 c=0;c<sizeA;c++) self.s.Value(d+c) -= tempU[r][c];
+       }
+       other = other->nextB;
+      }
+
+      MultVect(*targ->y,*self.paraB[targ->b]->e,tempParaA);
+      for (nat32 j=0;j<sizeA;j++) self.es[base+j] -= tempParaA[j];
+
+      targ = targ->nextA;
+     }
+   }
+  }
+
+
+ private:
+  SparseLM & self;
+  real64 lambda;
+};
+
+//------------------------------------------------------------------------------
+// Given the deltas for the first list calculates the new parameters of each
+// entry of the second list...
+class SparseLM::StepB
+{
+ public:
+  StepB(SparseLM & s)
+  :self(s)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   Vector<real64> da(self.sizeA);
+   Vector<real64> tempParaB(self.sizeB);
+
+   for (nat32 i=b0;i<b1;i++)
+   {
+    ParaNode & pn = *self.paraB[i];
+    tempParaB = *pn.e;
+
+    // Subtract the W's by the a list deltas...
+     PairNode * targ = self.listB[i];
+     while (targ)
+     {
+      nat32 base = targ->a*self.sizeA;
+      for (nat32 j=0;j<self.sizeA;j++) da[j] = self.delta[base+j];
+      TransMultVect(*targ->w,da,*pn.paraNew);
+      tempParaB -= *pn.paraNew;
+      targ = targ->nextB;
+     }
+
+    // Multiply by V^*-1, to get the b list deltas...
+     MultVect(*pn.inv,tempParaB,*pn.paraNew);
+     *pn.paraNew += *pn.para;
+     if (pn.C) (*pn.C)(*pn.paraNew);
+   }
+  }
+
+
+ private:
+  SparseLM & self;
+};
+
 //------------------------------------------------------------------------------
 SparseLM::SparseLM()
-:sizeA(0),sizeB(0),sizeErr(0),preStruct(true),list(null<PairNode*>()),
-tempParaA(null<Vector<real64>*>()),tempParaB(null<Vector<real64>*>()),tempErr(null<Vector<real64>*>()),
-tempAerr(null<Matrix<real64>*>()),tempBerr(null<Matrix<real64>*>()),
-tempU(null<Matrix<real64>*>()),tempV(null<Matrix<real64>*>()),tempV2(null<Matrix<real64>*>()),
-pimt(null<PseudoInverseTemp<real64>*>()),s(null<Matrix<real64>*>()),es(null<Vector<real64>*>())
+:sizeA(0),sizeB(0),sizeErr(0),solver(Auto),tolerance(1e-10),solverIters(0),iters(0),
+preStruct(true),list(null<PairNode*>()),
+dense(null<Matrix<real64>*>()),pimt(null<PseudoInverseTemp<real64>*>())
 {}
 
 SparseLM::~SparseLM()
@@ -39,20 +371,8 @@ SparseLM::~SparseLM()
   delete victim;
  }
 
- delete tempParaA;
- delete tempParaB;
- delete tempErr;
- 
- delete tempAerr;
- delete tempBerr; 
- 
- delete tempU;
- delete tempV;
- delete tempV2;
- 
+ delete dense;
  delete pimt;
- delete s;
- delete es;
 }
 
 void SparseLM::SetSizes(nat32 sA,nat32 sB,nat32 sE)
@@ -111,6 +431,7 @@ void SparseLM::AddError(nat32 a,nat32 b,const Vector<real64> & m,
      paraListB.RemFront();
      paraB[i]->paraNew = new Vector<real64>(sizeB);
      paraB[i]->uv = new Matrix<real64>(sizeB,sizeB); 
+     paraB[i]->inv = new Matrix<real64>(sizeB,sizeB);
      paraB[i]->e = new Vector<real64>(sizeB);
      ++i;
     }    
@@ -155,6 +476,7 @@ void SparseLM::AddCovar(nat32 a,nat32 b,const Matrix<real64> & covar)
  {
   if ((targ->a==a)&&(targ->b==b))
   {
+   delete targ->covarInv;
    targ->covarInv = ci;
    break;
   }
@@ -162,68 +484,26 @@ void SparseLM::AddCovar(nat32 a,nat32 b,const Matrix<real64> & covar)
  }
 }
 
+void SparseLM::SetSolver(Solver so,real64 tol,nat32 maxIters)
+{
+ solver = so;
+ tolerance = tol;
+ solverIters = maxIters;
+}
+
 real64 SparseLM::Run(time::Progress * prog)
 {
+ LogTime("eos::math::SparseLM::Run");
  prog->Push();
  // Here we do the looping over trying lambda values and checking for
  // improvment, everything else is pushed to other methods.
-  // Create a bunch of large data structures...
-   tempParaA = new Vector<real64>(sizeA);
-   tempParaB = new Vector<real64>(sizeB);
-   tempErr = new Vector<real64>(sizeErr);
-
-   tempAerr = new Matrix<real64>(sizeA,sizeErr);
-   tempBerr = new Matrix<real64>(sizeB,sizeErr);
-   
-   tempU = new Matrix<real64>(sizeA,sizeA);
-   tempV = new Matrix<real64>(sizeB,sizeB);
-   tempV2 = new Matrix<real64>(sizeB,sizeB);
-   
-   nat32 sSize = sizeA * paraA.Size();
-   pimt = new PseudoInverseTemp<real64>(sSize,sSize);
-   s = new Matrix<real64>(sSize,sSize);
-   es = new Vector<real64>(sSize);
-
-
-  // We require the listA linked lists to be sorted by b, a bit of a pain,
-  // an inline bucket sort...
-  {
-   ds::Array<PairNode*> entry(paraB.Size());
-   for (nat32 i=0;i<paraA.Size();i++)
-   {
-    for (nat32 j=0;j<entry.Size();j++) entry[j] = null<PairNode*>();
-    
-    PairNode * targ = listA[i];
-    while (targ)
-    {
-     entry[targ->b] = targ; 
-     targ = targ->nextA;
-    }
-    
-    listA[i] = null<PairNode*>();
-    for (int32 j=paraB.Size()-1;j>=0;j--)
-    {
-     if (entry[j])
-     {
-      entry[j]->nextA = listA[i];
-      listA[i] = entry[j];
-     }
-    }
-   }
-  }
-
+  // First time only, make the pair array and the structure of the reduced
+  // system...
+   if (adjStart.Size()==0) Prepare();
+   iters = 0;
 
   // Before we start calculate the error vectors and the residual for all of 'em...
-   real64 residual = 0.0; // We work squared, obviously.
-   {
-    PairNode * targ = list;
-    while (targ)
-    {
-     (targ->F)(*paraA[targ->a]->para,*paraB[targ->b]->para,*targ->m,*targ->err);
-     residual += targ->err->LengthSqr();
-     targ = targ->next;
-    }
-   }
+   real64 residual = Residual(true); // We work squared, obviously.
 
 
   // The primary loop, each time through we should reduce our residual...
@@ -232,11 +512,20 @@ real64 SparseLM::Run(time::Progress * prog)
    {
     prog->Report(k,k+1);
     // Fill out the jacobian matrices...
-     MakeJacobians();
-     
+    {
+     Jacobians jacobians(*this);
+     mt::ParallelFor(nat32(0),pairs.Size(),jacobians,64);
+    }
+
     // Calculate all cached values that are not dependent on lambda...
-     NonLambdaWork();
-        
+    {
+     SumA sumA(*this);
+     mt::ParallelFor(nat32(0),paraA.Size(),sumA,1);
+
+     SumB sumB(*this);
+     mt::ParallelFor(nat32(0),paraB.Size(),sumB,64);
+    }
+
     // The secondary loop, where we try out values of lambda till an improvment is found...
      while (lambda<=maxLambda)
      {
@@ -245,32 +534,20 @@ real64 SparseLM::Run(time::Progress * prog)
 
       // If its residual is an improvement swap it in, decrease lambda and break,
       // otherwise increase lambda and go arround again...
-       real64 newResidual = 0.0;
-       {
-        PairNode * targ = list;
-        while (targ)
-        {
-         (targ->F)(*paraA[targ->a]->paraNew,*paraB[targ->b]->paraNew,*targ->m,*targ->errNew);
-         newResidual += targ->errNew->LengthSqr();
-         targ = targ->next;
-        }
-       }
+       real64 newResidual = Residual(false);
        if (newResidual<residual)
        {
         // It has improved, we are done doing secondry iterations, for now...
+         bit stalled = (residual-newResidual)<=(1e-12*residual);
          residual = newResidual;
+         ++iters;
          for (nat32 i=0;i<paraA.Size();i++) mem::PtrSwap(paraA[i]->para,paraA[i]->paraNew);
          for (nat32 i=0;i<paraB.Size();i++) mem::PtrSwap(paraB[i]->para,paraB[i]->paraNew);
-         
-         PairNode * targ = list;
-         while (targ)
-         {
-          mem::PtrSwap(targ->err,targ->errNew);
-          targ = targ->next;
-         }
+         for (nat32 i=0;i<pairs.Size();i++) mem::PtrSwap(pairs[i]->err,pairs[i]->errNew);
          
          lambda *= 0.1;
          if (math::Equal(lambda,real64(0.0))) lambda = 0.000000001;
+         if (stalled) lambda = maxLambda*10.0; // No longer getting anywhere.
          break;
        }
        else
@@ -296,284 +573,196 @@ void SparseLM::GetParaB(nat32 ind,Vector<real64> & out)
  out = *(paraB[ind]->para);
 }
 
-void SparseLM::MakeJacobians()
+void SparseLM::SetParaA(nat32 ind,const Vector<real64> & in)
 {
- PairNode * targ = list;
- while (targ)
- {
-  // Jacobian A...
-   *tempParaA = paraA[targ->a]->para[0];
-   for (nat32 c=0;c<targ->aJacob->Cols();c++)
-   {
-    real64 delta = Max(Abs(10e-4 * (*tempParaA)[c]),10e-6);
-    (*tempParaA)[c] += delta;
-      
-    (targ->F)(*tempParaA,*paraB[targ->b]->para,*targ->m,*tempErr);
-    delta = 1.0/delta;   
-       
-    for (nat32 r=0;r<targ->aJacob->Rows();r++)
-    {
-     (*targ->aJacob)[r][c] = ((*tempErr)[r] - (*targ->err)[r])*delta;
-    }
-    
-    (*tempParaA)[c] = paraA[targ->a]->para[0][c];
-   }
+ *(paraA[ind]->para) = in;
+}
 
-  // B Jacobian...
-   *tempParaB = *paraB[targ->b]->para;
-   for (nat32 c=0;c<targ->bJacob->Cols();c++)
-   {
-    real64 delta = Max(Abs(10e-4 * (*tempParaB)[c]),10e-6);
-    (*tempParaB)[c] += delta;
-    
-    (targ->F)(*paraA[targ->a]->para,*tempParaB,*targ->m,*tempErr);       
-    delta = 1.0/delta;        
-    for (nat32 r=0;r<targ->bJacob->Rows();r++)
-    {
-     (*targ->bJacob)[r][c] = ((*tempErr)[r] - (*targ->err)[r])*delta;
-    }
-    
-    (*tempParaB)[c] = (*paraB[targ->b]->para)[c];
-   }
-   
-  targ = targ->next;
- }
+void SparseLM::SetParaB(nat32 ind,const Vector<real64> & in)
+{
+ *(paraB[ind]->para) = in;
 }
 
-void SparseLM::NonLambdaWork()
+void SparseLM::Prepare()
 {
- // Calculate all the intermediate values that do not contain lambda, i.e. only have
- // to be done each primary loop instead of each secondry loop...
-  PairNode * targ;
-  // Pass through the a list...
-   for (nat32 i=0;i<paraA.Size();i++)
+ // The array of pairs...
+  nat32 count = 0;
+  for (PairNode * targ=list;targ;targ=targ->next) ++count;
+  pairs.Size(count);
+  count = 0;
+  for (PairNode * targ=list;targ;targ=targ->next) pairs[count++] = targ;
+
+
+ // For each entry of the first list find every other entry it shares an entry
+ // of the second list with - these are the blocks of the reduced system.
+ // Each is allways paired with itself, so the diagonal exists even if it has no
+ // errors...
+  adjStart.Size(paraA.Size()+1);
+  ds::ArrayResize<nat32> found(0,1024,256);
+  ds::Array<nat32> mark(paraA.Size());
+  for (nat32 i=0;i<mark.Size();i++) mark[i] = math::max_nat_32;
+
+  for (nat32 i=0;i<paraA.Size();i++)
+  {
+   adjStart[i] = found.Size();
+   mark[i] = i;
+   for (PairNode * targ=listA[i];targ;targ=targ->nextA)
    {
-    Zero(*paraA[i]->uv);
-    for (nat32 j=0;j<paraA[i]->e->Size();j++) (*paraA[i]->e)[j] = 0.0;
-    
-    targ = listA[i];
-    while (targ)
-    {
-     if (targ->covarInv)
-     {
-      // Calculate common factor...
-       TransMult(*targ->aJacob,*targ->covarInv,*tempAerr);
-      
-      // Calculate U...
-       Mult(*tempAerr,*targ->aJacob,*tempU);
-       (*paraA[i]->uv) += *tempU;
-     
-      // Calculate e_a...   
-       MultVect(*tempAerr,*targ->err,*tempParaA);
-       (*paraA[i]->e) += *tempParaA;
-     }
-     else
-     {
-      // Calculate U...
-       TransMult(*targ->aJacob,*targ->aJacob,*tempU);
-       (*paraA[i]->uv) += *tempU;
-       
-      // Calculate e_a...   
-       TransMultVect(*targ->aJacob,*targ->err,*tempParaA);
-       (*paraA[i]->e) += *tempParaA;
-     } 
-     targ = targ->nextA;
-    }
+    for (PairNode * other=listB[targ->b];other;other=other->nextB) mark[other->a] = i;
    }
-  
-  // Pass through the b list...
-   for (nat32 i=0;i<paraB.Size();i++)
+
+   for (nat32 j=0;j<paraA.Size();j++)
    {
-    Zero(*paraB[i]->uv);
-    for (nat32 j=0;j<paraB[i]->e->Size();j++) (*paraB[i]->e)[j] = 0.0;
-    
-    targ = listB[i];
-    while (targ)
+    if (mark[j]==i)
     {
-     if (targ->covarInv)
-     {
-      // Calculate common factor...
-       TransMult(*targ->bJacob,*targ->covarInv,*tempBerr);
-      
-      // Calculate V...
-       Mult(*tempBerr,*targ->bJacob,*tempV);
-       (*paraB[i]->uv) += *tempV;
-     
-      // Calculate e_a...   
-       MultVect(*tempBerr,*targ->err,*tempParaB);
-       (*paraB[i]->e) += *tempParaB;
-     }
-     else
-     {
-      // Calculate V...
-       TransMult(*targ->bJacob,*targ->bJacob,*tempV);
-       (*paraB[i]->uv) += *tempV;
-       
-      // Calculate e_a...   
-       TransMultVect(*targ->bJacob,*targ->err,*tempParaB);
-       (*paraB[i]->e) += *tempParaB;            
-     }
-     targ = targ->nextB;
+     found.Size(found.Size()+1);
+     found[found.Size()-1] = j;
     }
    }
-  
-  // Pass through the error set...
-   targ = list;
-   while (targ)
+  }
+  adjStart[paraA.Size()] = found.Size();
+
+  adj.Size(found.Size());
+  for (nat32 i=0;i<adj.Size();i++) adj[i] = found[i];
+
+
+ // Build the sparse matrix with that structure, every entry of every block
+ // stored, all zero for now...
+  nat32 n = sizeA * paraA.Size();
+  s.SetSize(n,n);
+  for (nat32 i=0;i<paraA.Size();i++)
+  {
+   for (nat32 j=adjStart[i];j<adjStart[i+1];j++)
    {
-    if (targ->covarInv)
+    for (nat32 r=0;r<sizeA;r++)
     {
-     TransMult(*targ->aJacob,*targ->covarInv,*tempU);
-     Mult(*tempU,*targ->bJacob,*targ->w);
+     for (nat32 c=0;c<sizeA;c++) s.Add(i*sizeA+r,adj[j]*sizeA+c,0.0);
     }
-    else
-    {
-     TransMult(*targ->aJacob,*targ->bJacob,*targ->w);
-    }    
-    targ = targ->next;
    }
+  }
+  s.Build();
+
+  es.SetSize(n);
+  delta.SetSize(n);
 }
 
-void SparseLM::MakePara(real64 lambda)
+real64 SparseLM::Residual(bit fresh)
 {
- // Calculate the only intermediate value dependent on lambda, Y...
+ Errors errors(*this,fresh);
+ mt::ParallelFor(nat32(0),pairs.Size(),errors,256);
+
+ real64 ret = 0.0;
+ for (nat32 i=0;i<pairs.Size();i++)
  {
-  PairNode * targ = list;
-  while (targ)
-  {
-   *tempV = *paraB[targ->b]->uv;
-   for (nat32 i=0;i<sizeB;i++) (*tempV)[i][i] *= 1.0 + lambda;
-   Inverse(*tempV,*tempV2);
-   Mult(*targ->w,*tempV,*targ->y);   
-   targ = targ->next;
-  }
+  if (fresh) ret += pairs[i]->err->LengthSqr();
+        else ret += pairs[i]->errNew->LengthSqr();
  }
+ return ret;
+}
 
+nat32 SparseLM::Block(nat32 r,nat32 c,nat32 row) const
+{
+ nat32 low = adjStart[r];
+ nat32 high = adjStart[r+1];
+ while (high-low>1)
+ {
+  nat32 mid = (low+high)/2;
+  if (adj[mid]>c) high = mid;
+             else low = mid;
+ }
+ return s.RowBegin(r*sizeA+row) + (low-adjStart[r])*sizeA;
+}
 
- // Construct S...
-  Zero(*s);  
-  // The main bit, with different code for the diagonals..
-   for (nat32 br=0;br<paraA.Size();br++)
-   {
-    for (nat32 bc=0;bc<paraA.Size();bc++)
-    {
-     nat32 baseR = br*sizeA;
-     nat32 baseC = bc*sizeA;
+void SparseLM::MakePara(real64 lambda)
+{
+ // Invert the augmented V's and calculate Y...
+ {
+  ReduceB reduceB(*this,lambda);
+  mt::ParallelFor(nat32(0),paraB.Size(),reduceB,64);
+ }
 
-     if (bc==br)
-     {
-      // Diagonal...
-       // Sum in augmented U...
-        for (nat32 r=0;r<sizeA;r++)
-        {
-         for (nat32 c=0;c<sizeA;c++) (*s)[baseR+r][baseC+c] = (*paraA[bc]->uv)[r][c];
-        }
-        for (nat32 i=0;i<sizeA;i++) (*s)[baseR+i][baseC+i] *= 1.0 + lambda;
-        
-       // Subtract the combinations for each point...
-        PairNode * targ = listA[br];
-        while (targ)
-        {
-         MultTrans(*targ->y,*targ->w,*tempU);
-         for (nat32 r=0;r<sizeA;r++)
-         {
-          for (nat32 c=0;c<sizeA;c++) (*s)[baseR+r][baseC+c] -= (*tempU)[r][c];
-         }
-         targ = targ->nextA;
-        }
-     }
-     else
-     {
-      // Off-diagonal - subtract point combinations...
-       PairNode * targY = listA[br];
-       PairNode * targW = listA[bc];
-       while (targY&&targW)
-       {
-        if (targY->b==targW->b)
-        {
-         // We have a match - multiply and subtract...
-          MultTrans(*targY->y,*targW->w,*tempU);
-          for (nat32 r=0;r<sizeA;r++)
-          {
-           for (nat32 c=0;c<sizeA;c++) (*s)[baseR+r][baseC+c] -= (*tempU)[r][c];
-          }
-         targY = targY->nextA;
-         targW = targW->nextA;         
-        }
-        else
-        {
-         if (targY->b<targW->b) targY = targY->nextA;
-                           else targW = targW->nextA;
-        }
-       }       
-     }
-    }
-   }
+ // Construct S and es...
+ {
+  ReduceA reduceA(*this,lambda);
+  mt::ParallelFor(nat32(0),paraA.Size(),reduceA,1);
+ }
 
+ // From S & es calculate the deltas for the first list...
+  SolveReduced();
 
- // Construct es...
+ // Calculate and apply the second list deltas in one swoop...
+ {
+  StepB stepB(*this);
+  mt::ParallelFor(nat32(0),paraB.Size(),stepB,64);
+ }
+
+ // Apply the first list deltas...
   for (nat32 i=0;i<paraA.Size();i++)
   {
    nat32 base = i*sizeA;
-   for (nat32 j=0;j<sizeA;j++) (*es)[base+j] = (*paraA[i]->e)[j];
-   
-   PairNode * targ = listA[i];
-   while (targ)
-   {
-    MultVect(*targ->y,*paraB[targ->b]->e,*tempParaA);    
-    for (nat32 j=0;j<sizeA;j++) (*es)[base+j] -= (*tempParaA)[j];
-    targ = targ->nextA;
-   }
+   Vector<real64> & targ = *paraA[i]->paraNew;
+   for (nat32 j=0;j<sizeA;j++) targ[j] = (*paraA[i]->para)[j] + delta[base+j];
+   if (paraA[i]->C) (*paraA[i]->C)(targ);
   }
+}
 
+void SparseLM::SolveReduced()
+{
+ nat32 n = s.Rows();
+ Solver method = solver;
+ if (method==Auto) method = (n<=denseLimit)?Dense:Iterative;
 
- // From S & es calculate the deltas for the first list...
- // (A pseudo inverse and inline multiply.)
-  PseudoInverse(*s,*pimt);
-  for (nat32 i=0;i<paraA.Size();i++)
-  {
-   nat32 base = i*sizeA;
-   Vector<real64> & targ = *paraA[i]->paraNew;
-   for (nat32 j=0;j<sizeA;j++)
+ if (method==Dense)
+ {
+  // Expand into a dense matrix and Cholesky it...
+   if (dense==null<Matrix<real64>*>()) dense = new Matrix<real64>(n,n);
+   Zero(*dense);
+   for (nat32 r=0;r<n;r++)
    {
-    targ[j] = 0.0;
-    for (nat32 k=0;k<s->Cols();k++) targ[j] += (*s)[base+j][k] * (*es)[k];
+    for (nat32 i=s.RowBegin(r);i<s.RowEnd(r);i++) (*dense)[r][s.Column(i)] = s.Value(i);
    }
-  }
- 
- 
- // Calculate and apply the second list deltas in one swoop...
-  for (nat32 i=0;i<paraB.Size();i++)
-  {
-   // Fill a vector with the relevent starting vector...
-    *tempParaB = *paraB[i]->e;
-    
-   // Subtract the W's by the a list deltas...
-    PairNode * targ = listB[i];
-    while (targ)
+
+   delta = es;
+   if (Cholesky(*dense))
+   {
+    SolveLinearLowerTri(*dense,delta);
+    for (nat32 r=0;r<n;r++)
     {
-     TransMultVect(*targ->w,*paraA[targ->a]->paraNew,*paraB[i]->paraNew);
-     *tempParaB -= *paraB[i]->paraNew;    
-     targ = targ->nextB;
+     for (nat32 c=0;c<r;c++) (*dense)[c][r] = (*dense)[r][c];
     }
-   
-   // Multiply by V^*-1, to get the b list deltas...
-    *tempV = *paraB[i]->uv;
-    for (nat32 j=0;j<sizeB;j++) (*tempV)[j][j] *= 1.0 + lambda;    
-    Inverse(*tempV,*tempV2);
-    
-    MultVect(*tempV,*tempParaB,*paraB[i]->paraNew);
-    *paraB[i]->paraNew += *paraB[i]->para;
-    if (paraB[i]->C) (*paraB[i]->C)(*paraB[i]->paraNew);
-  }
- 
- 
- // Apply the first list deltas...
-  for (nat32 i=0;i<paraA.Size();i++)
-  {
-   *paraA[i]->paraNew += *paraA[i]->para;   
-   if (paraA[i]->C) (*paraA[i]->C)(*paraA[i]->paraNew);
-  }
+    SolveLinearUpperTri(*dense,delta);
+   }
+   else
+   {
+    // Not positive definite, fallback to the pseudo-inverse, as gauge
+    // freedoms can make it singular...
+     Zero(*dense);
+     for (nat32 r=0;r<n;r++)
+     {
+      for (nat32 i=s.RowBegin(r);i<s.RowEnd(r);i++) (*dense)[r][s.Column(i)] = s.Value(i);
+     }
+
+     if (pimt==null<PseudoInverseTemp<real64>*>()) pimt = new PseudoInverseTemp<real64>(n,n);
+     PseudoInverse(*dense,*pimt);
+     MultVect(*dense,es,delta);
+   }
+ }
+ else
+ {
+  // Conjugate gradient, from zero as the previous step says nothing about
+  // this one; the incomplete Cholesky should allways work given the diagonal
+  // shifting, but just in case...
+   for (nat32 i=0;i<n;i++) delta[i] = 0.0;
+
+   const Preconditioner * pre = null<Preconditioner*>();
+   if (cholPre.Setup(s)) pre = &cholPre;
+   else
+   {
+    if (jacobiPre.Setup(s)) pre = &jacobiPre;
+   }
+
+   SolvePCG(s,es,delta,pre,tolerance,(solverIters==0)?n:solverIters);
+ }
 }
 
 //------------------------------------------------------------------------------
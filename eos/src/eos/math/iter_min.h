@@ -25,6 +25,7 @@
 #include "eos/types.h"
 #include "eos/math/mat_ops.h"
 #include "eos/math/complex.h"
+#include "eos/math/sparse.h"
 #include "eos/time/progress.h"
 #include "eos/ds/lists.h"
 #include "eos/ds/arrays.h"
@@ -392,9 +393,18 @@ inline void JacobianLM(nat32 evs,const Vector<RT> & pv,const OT & oi,
 /// From an optimisation point of view the first list is presumed greatly smaller than
 /// the second, best to stick to this pattern.
 ///
-/// This is a use and delete class, you can not use it twice. The memory consumption is
-/// heavy also, so deleting it straight after use is recomended unless you want to start
-/// paging, or even exceding memory address space on a 32 bit computer.
+/// Each step the second list is eliminated with the Schur complement, leaving the
+/// reduced system for the first list. This is stored in blocks, sizeA x sizeA, one
+/// for each pair of first list entrys that share an entry in the second list, so
+/// memory is never the first list size times the second list size. It is solved
+/// with either a dense Cholesky decomposition or the preconditioned conjugate gradient
+/// method, see SetSolver. The per pair work, the jacobians and the block
+/// accumulation, is split between the threads of the task pool, so the error and
+/// constraint functions have to be safe to call at once, i.e. no writing to globals.
+///
+/// Once structure has been setup it can be Run repeatedly, with SetParaA/SetParaB
+/// used to change the starting point between runs - the structure is only made
+/// the first time.
 class EOS_CLASS SparseLM
 {
  public:
@@ -427,7 +437,8 @@ class EOS_CLASS SparseLM
   /// to the AddPara methods before calling this, as the first time this is 
   /// called it fundamentally changes the internal data structure. Obviously,
   /// you must call this at least once before calling Run, and you must *never*
-  /// call this multiple times for the same (a,b) key.
+  /// call this multiple times for the same (a,b) key. Must not be called once
+  /// Run has been called.
    void AddError(nat32 a,nat32 b,const Vector<real64> & m,
                  void (*F)(const Vector<real64> & a,const Vector<real64> & b,const Vector<real64> & m,Vector<real64> & err));
 
@@ -455,12 +466,28 @@ class EOS_CLASS SparseLM
    void AddCovar(nat32 a,nat32 b,const Matrix<real64> & covar);
 
 
+  /// The methods for solving the reduced system of the first list.
+   enum Solver {Auto, ///< Dense if the first list has no more than 512 parameters in total, otherwise Iterative.
+                Dense, ///< Cholesky decomposition, falling back to the pseudo-inverse if that fails. O(n^3) time and O(n^2) memory.
+                Iterative ///< Conjugate gradient, with an incomplete Cholesky preconditioner, using only the block storage. For large first lists.
+               };
+
+  /// Sets the method used to solve the reduced system, defaults to Auto. For Iterative
+  /// the relative residual to stop at and the iteration cap can be given, the cap
+  /// defaulting to the number of parameters in the first list when left as 0.
+   void SetSolver(Solver s,real64 tol = 1e-10,nat32 maxIters = 0);
+
+
   /// This does the calculation. Whilst it does take a progress object it dosn't use it
   /// properly as it never knows when the main loop is goig to end till it does, so it
   /// just keeps track of how many loops it has actually done.
   /// Returns the final residual obtained, as a measure of how well it did.
+  /// Can be called repeatedly, each run starting from the current parameters.
    real64 Run(time::Progress * prog = null<time::Progress*>());
 
+  /// Returns how many iterations the last Run did that improved the residual.
+   nat32 Iters() const {return iters;}
+
 
   /// Extracts the parameter vector from the first list for the given index.
    void GetParaA(nat32 ind,Vector<real64> & out);
@@ -468,6 +495,16 @@ class EOS_CLASS SparseLM
   /// Extracts the parameter vector from the second list for the given index.
    void GetParaB(nat32 ind,Vector<real64> & out);
 
+  /// Replaces the parameter vector from the first list for the given index, so
+  /// Run can be called again from a new starting point. Only valid after the
+  /// AddError state change.
+   void SetParaA(nat32 ind,const Vector<real64> & in);
+
+  /// Replaces the parameter vector from the second list for the given index, so
+  /// Run can be called again from a new starting point. Only valid after the
+  /// AddError state change.
+   void SetParaB(nat32 ind,const Vector<real64> & in);
+
 
   /// &nbsp;
    inline cstrconst TypeString() const {return "eos::math::SparseLM";}
@@ -477,12 +514,19 @@ class EOS_CLASS SparseLM
   // Internal constant variables...
    static const real64 maxLambda = 1e100;
    static const nat32 maxIter = 1000;
+   static const nat32 denseLimit = 512;
 
   // Sizes used throughout...
    nat32 sizeA;
    nat32 sizeB;
    nat32 sizeErr;
 
+  // Solver settings...
+   Solver solver;
+   real64 tolerance;
+   nat32 solverIters;
+   nat32 iters;
+
   // The pre-AddError data structure, just a pair of linked lists of parameters...
    bit preStruct; // true when the below stuff is actually in use.
    ds::List< Vector<real64>*,mem::KillDel< Vector<real64> > > paraListA;
@@ -496,25 +540,26 @@ class EOS_CLASS SparseLM
     {
       ParaNode()
       :C(0),para(null<Vector<real64>*>()),paraNew(null<Vector<real64>*>()),
-      uv(null<Matrix<real64>*>()),e(null<Vector<real64>*>())
+      uv(null<Matrix<real64>*>()),inv(null<Matrix<real64>*>()),e(null<Vector<real64>*>())
       {}
 
-     ~ParaNode() {delete para; delete paraNew; delete uv; delete e;}
+     ~ParaNode() {delete para; delete paraNew; delete uv; delete inv; delete e;}
      
      void (*C)(Vector<real64> & a);
      
      Vector<real64> * para;
      Vector<real64> * paraNew;
      Matrix<real64> * uv; // Either the u or v matrix.
+     Matrix<real64> * inv; // Second list only, the inverse of the augmented v matrix.
      Vector<real64> * e;
     };
 
     ds::Array< ParaNode*,mem::MakeNull< ParaNode* >,mem::KillDel< ParaNode > > paraA;
     ds::Array< ParaNode*,mem::MakeNull< ParaNode* >,mem::KillDel< ParaNode > > paraB;
 
-   // A structure and Array2D which stores some data for every pair taken from 
-   // paraA and paraB. Several linked lists are also created over this structure
-   // for efficient access of relevent data sets...
+   // A structure which stores some data for every pair taken from paraA and
+   // paraB that has an error function. Several linked lists are also created
+   // over this structure for efficient access of relevent data sets...
     struct PairNode
     {
       PairNode()
@@ -556,27 +601,44 @@ class EOS_CLASS SparseLM
      ds::Array<PairNode*,mem::MakeNull< PairNode* > > listA;
      ds::Array<PairNode*,mem::MakeNull< PairNode* > > listB;
      
-     
-  // The runtime data structures, to save passing parameters between methods...
-   Vector<real64> * tempParaA;
-   Vector<real64> * tempParaB;   
-   Vector<real64> * tempErr;  
-   
-   Matrix<real64> * tempAerr; // sizeA by sizeErr matrix.
-   Matrix<real64> * tempBerr; // sizeB by sizeErr matrix.
-   
-   Matrix<real64> * tempU; // sizeA by sizeA matrix.
-   Matrix<real64> * tempV; // sizeB by sizeB matrix.
-   Matrix<real64> * tempV2; // sizeB by sizeB matrix.
-   
-   PseudoInverseTemp<real64> * pimt;
-   Matrix<real64> * s;
-   Vector<real64> * es;
-  
+    // The same as an array, made by the first Run, so the threads can split it...
+     ds::Array<PairNode*> pairs;
+
+
+  // The reduced system, made by the first Run. adj gives, for each entry of the
+  // first list, starting at adjStart, the sorted entrys it shares a second list
+  // entry with, including itself - each is a block of s...
+   ds::Array<nat32> adjStart;
+   ds::Array<nat32> adj;
+
+   SparseMatrix s;
+   Vector<real64> es;
+   Vector<real64> delta;
+
+   Matrix<real64> * dense; // Only made if the Dense solver is used. 
+   PseudoInverseTemp<real64> * pimt; // Only made if the Cholesky fails.
+   CholeskyPrecon cholPre;
+   JacobiPrecon jacobiPre;
+
+
   // Internal methods, these do all the real work...
-   void MakeJacobians();
-   void NonLambdaWork();
+   void Prepare();
+   real64 Residual(bit fresh); // fresh selects the current parameters rather than the new.
    void MakePara(real64 lambda);
+   void SolveReduced(); // Solves s delta = es.
+
+  // Returns the index in s of entry (0,0) of block (r,c), given the row
+  // within it. Must be a block that exists...
+   nat32 Block(nat32 r,nat32 c,nat32 row) const;
+
+  // Functors for the task pool, the pair work then the per list entry work...
+   class Errors;
+   class Jacobians;
+   class SumA;
+   class SumB;
+   class ReduceB;
+   class ReduceA;
+   class StepB;
 };
 
 //------------------------------------------------------------------------------
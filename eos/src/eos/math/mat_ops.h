@@ -1087,6 +1087,104 @@ inline bit Inverse(MT & mat,MT & temp)
  return true;
 }
 
+/// Closed form inverse of a 2x2 matrix, by the adjugate, which is much faster
+/// than the general version. Fails when the determinant is negligible relative
+/// to the size of the entries. temp is not used.
+template <typename T>
+inline bit Inverse(Mat<2,2,T> & mat,Mat<2,2,T> & temp)
+{
+ T det = mat[0][0]*mat[1][1] - mat[0][1]*mat[1][0];
+ T scale = Sqrt(Sqr(mat[0][0]) + Sqr(mat[0][1])) * Sqrt(Sqr(mat[1][0]) + Sqr(mat[1][1]));
+ if (IsZero(scale)||IsZero(det/scale)) return false;
+
+ T inv = T(1)/det;
+ T m00 = mat[0][0];
+ mat[0][0] =  mat[1][1]*inv;
+ mat[0][1] = -mat[0][1]*inv;
+ mat[1][0] = -mat[1][0]*inv;
+ mat[1][1] =  m00*inv;
+ return true;
+}
+
+/// Closed form inverse of a 3x3 matrix, by the adjugate, see the 2x2 version.
+template <typename T>
+inline bit Inverse(Mat<3,3,T> & mat,Mat<3,3,T> & temp)
+{
+ temp[0][0] = mat[1][1]*mat[2][2] - mat[1][2]*mat[2][1];
+ temp[0][1] = mat[0][2]*mat[2][1] - mat[0][1]*mat[2][2];
+ temp[0][2] = mat[0][1]*mat[1][2] - mat[0][2]*mat[1][1];
+ temp[1][0] = mat[1][2]*mat[2][0] - mat[1][0]*mat[2][2];
+ temp[1][1] = mat[0][0]*mat[2][2] - mat[0][2]*mat[2][0];
+ temp[1][2] = mat[0][2]*mat[1][0] - mat[0][0]*mat[1][2];
+ temp[2][0] = mat[1][0]*mat[2][1] - mat[1][1]*mat[2][0];
+ temp[2][1] = mat[0][1]*mat[2][0] - mat[0][0]*mat[2][1];
+ temp[2][2] = mat[0][0]*mat[1][1] - mat[0][1]*mat[1][0];
+
+ T det = mat[0][0]*temp[0][0] + mat[0][1]*temp[1][0] + mat[0][2]*temp[2][0];
+ T scale = T(1);
+ for (nat32 r=0;r<3;r++) scale *= Sqrt(Sqr(mat[r][0]) + Sqr(mat[r][1]) + Sqr(mat[r][2]));
+ if (IsZero(scale)||IsZero(det/scale)) return false;
+
+ T inv = T(1)/det;
+ for (nat32 r=0;r<3;r++)
+ {
+  for (nat32 c=0;c<3;c++) mat[r][c] = temp[r][c]*inv;
+ }
+ return true;
+}
+
+/// Closed form inverse of a 4x4 matrix, by the adjugate, using the 2x2
+/// sub-determinants of the top and bottom pairs of rows. See the 2x2 version.
+template <typename T>
+inline bit Inverse(Mat<4,4,T> & mat,Mat<4,4,T> & temp)
+{
+ // Sub-determinants of the top two rows, s, and bottom two rows, c...
+  T s0 = mat[0][0]*mat[1][1] - mat[1][0]*mat[0][1];
+  T s1 = mat[0][0]*mat[1][2] - mat[1][0]*mat[0][2];
+  T s2 = mat[0][0]*mat[1][3] - mat[1][0]*mat[0][3];
+  T s3 = mat[0][1]*mat[1][2] - mat[1][1]*mat[0][2];
+  T s4 = mat[0][1]*mat[1][3] - mat[1][1]*mat[0][3];
+  T s5 = mat[0][2]*mat[1][3] - mat[1][2]*mat[0][3];
+
+  T c5 = mat[2][2]*mat[3][3] - mat[3][2]*mat[2][3];
+  T c4 = mat[2][1]*mat[3][3] - mat[3][1]*mat[2][3];
+  T c3 = mat[2][1]*mat[3][2] - mat[3][1]*mat[2][2];
+  T c2 = mat[2][0]*mat[3][3] - mat[3][0]*mat[2][3];
+  T c1 = mat[2][0]*mat[3][2] - mat[3][0]*mat[2][2];
+  T c0 = mat[2][0]*mat[3][1] - mat[3][0]*mat[2][1];
+
+ // Determinant, and the check...
+  T det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+  T scale = T(1);
+  for (nat32 r=0;r<4;r++) scale *= Sqrt(Sqr(mat[r][0]) + Sqr(mat[r][1]) + Sqr(mat[r][2]) + Sqr(mat[r][3]));
+  if (IsZero(scale)||IsZero(det/scale)) return false;
+  T inv = T(1)/det;
+
+ // Adjugate...
+  temp[0][0] = ( mat[1][1]*c5 - mat[1][2]*c4 + mat[1][3]*c3)*inv;
+  temp[0][1] = (-mat[0][1]*c5 + mat[0][2]*c4 - mat[0][3]*c3)*inv;
+  temp[0][2] = ( mat[3][1]*s5 - mat[3][2]*s4 + mat[3][3]*s3)*inv;
+  temp[0][3] = (-mat[2][1]*s5 + mat[2][2]*s4 - mat[2][3]*s3)*inv;
+
+  temp[1][0] = (-mat[1][0]*c5 + mat[1][2]*c2 - mat[1][3]*c1)*inv;
+  temp[1][1] = ( mat[0][0]*c5 - mat[0][2]*c2 + mat[0][3]*c1)*inv;
+  temp[1][2] = (-mat[3][0]*s5 + mat[3][2]*s2 - mat[3][3]*s1)*inv;
+  temp[1][3] = ( mat[2][0]*s5 - mat[2][2]*s2 + mat[2][3]*s1)*inv;
+
+  temp[2][0] = ( mat[1][0]*c4 - mat[1][1]*c2 + mat[1][3]*c0)*inv;
+  temp[2][1] = (-mat[0][0]*c4 + mat[0][1]*c2 - mat[0][3]*c0)*inv;
+  temp[2][2] = ( mat[3][0]*s4 - mat[3][1]*s2 + mat[3][3]*s0)*inv;
+  temp[2][3] = (-mat[2][0]*s4 + mat[2][1]*s2 - mat[2][3]*s0)*inv;
+
+  temp[3][0] = (-mat[1][0]*c3 + mat[1][1]*c1 - mat[1][2]*c0)*inv;
+  temp[3][1] = ( mat[0][0]*c3 - mat[0][1]*c1 + mat[0][2]*c0)*inv;
+  temp[3][2] = (-mat[3][0]*s3 + mat[3][1]*s1 - mat[3][2]*s0)*inv;
+  temp[3][3] = ( mat[2][0]*s3 - mat[2][1]*s1 + mat[2][2]*s0)*inv;
+
+ mat = temp;
+ return true;
+}
+
 //------------------------------------------------------------------------------
 /// This is given a 3x3 rotation matrix, from which is calculates an angle-axis
 /// representation of the rotation. This is a representation as a vector,
@@ -28,6 +28,7 @@
 #include "eos/math/functions.h"
 #include "eos/io/inout.h"
 #include "eos/file/csv.h"
+#include "eos/math/expressions.h"
 
 namespace eos
 {
@@ -37,8 +38,10 @@ namespace eos
 /// A Matrix class with templated dimensions and templated type. Provides only 
 /// basic operations so all proper operations can be templated to work on both
 /// this class and the Matrix classes.
+/// The arithmetic operators are in expressions.h, where m*v and m*m are also
+/// provided.
 template <nat32 ROWS, nat32 COLS = ROWS, typename T = real32>
-class EOS_CLASS Mat
+class EOS_CLASS Mat : public MatExpr<ROWS,COLS,T,Mat<ROWS,COLS,T> >
 {
  public:
   /// The data item type, so it can be used by templated code.
@@ -72,6 +75,10 @@ class EOS_CLASS Mat
     }
    }
    
+  /// Evaluates an expression, such as a + b*s or a*b.
+   template <typename E>
+   Mat(const MatExpr<ROWS,COLS,T,E> & rhs) {Assign(rhs.Self());}
+
   /// &nbsp;
    ~Mat() {}
    
@@ -86,6 +93,12 @@ class EOS_CLASS Mat
     return *this;
    }
 
+  /// Evaluates an expression in a single loop. This is safe for the likes of
+  /// a = a*b - a, but not a = Trans(a), as it reads a as it writes it - use
+  /// Transpose for that.
+   template <typename E>
+   Mat<ROWS,COLS,T> & operator = (const MatExpr<ROWS,COLS,T,E> & rhs) {Assign(rhs.Self()); return *this;}
+
 
   /// &nbsp;
    nat32 Rows() const {return ROWS;}
@@ -99,6 +112,9 @@ class EOS_CLASS Mat
   /// &nbsp;
    const T * operator [] (nat32 row) const {return data[row];}
 
+  /// Element access, as used by the expressions.
+   T operator () (nat32 row,nat32 col) const {return data[row][col];}
+
 
   /// &nbsp;
    Mat<ROWS,COLS,T> & operator *= (T rhs)
@@ -139,6 +155,30 @@ class EOS_CLASS Mat
     }
     return *this;
    }
+
+  /// &nbsp;
+   template <typename E>
+   Mat<ROWS,COLS,T> & operator += (const MatExpr<ROWS,COLS,T,E> & rhs)
+   {
+    const E & e = rhs.Self();
+    for (nat32 r=0;r<ROWS;r++)
+    {
+     for (nat32 c=0;c<COLS;c++) data[r][c] += e(r,c);
+    }
+    return *this;
+   }
+
+  /// &nbsp;
+   template <typename E>
+   Mat<ROWS,COLS,T> & operator -= (const MatExpr<ROWS,COLS,T,E> & rhs)
+   {
+    const E & e = rhs.Self();
+    for (nat32 r=0;r<ROWS;r++)
+    {
+     for (nat32 c=0;c<COLS;c++) data[r][c] -= e(r,c);
+    }
+    return *this;
+   }
    
    
   /// Swaps the 2 rows with given indexes, accheives nothing if the two indexes are identical.
@@ -182,6 +222,15 @@ class EOS_CLASS Mat
 
  private:
   T data[ROWS][COLS];
+
+  template <typename E>
+  void Assign(const E & e)
+  {
+   for (nat32 r=0;r<ROWS;r++)
+   {
+    for (nat32 c=0;c<COLS;c++) data[r][c] = e(r,c);
+   }
+  }
 };
 
 //------------------------------------------------------------------------------
@@ -147,9 +147,9 @@ class EOS_CLASS Quaternion : public Vect<4>
     
     real32 dd = math::Sqr((*this)[3]);    
     
-    out[0][0] = aa+bb-cc-dd; out[0][1] = bc-ad;       out[0][2] = ac-bd;
-    out[0][0] = ad+bc;       out[0][1] = aa-bb+cc-dd; out[0][2] = cd-ab;
-    out[0][0] = bd-ac;       out[0][1] = ab+cd;       out[0][2] = aa-bb-cc+dd;
+    out[0][0] = aa+bb-cc-dd; out[0][1] = bc-ad;       out[0][2] = ac+bd;
+    out[1][0] = ad+bc;       out[1][1] = aa-bb+cc-dd; out[1][2] = cd-ab;
+    out[2][0] = bd-ac;       out[2][1] = ab+cd;       out[2][2] = aa-bb-cc+dd;
    }
    
   /// This rotates a vector by the quaternion, simply uses the ToMat method
@@ -0,0 +1,715 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/math/sparse.h"
+
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+#include "eos/file/csv.h"
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+class SparseMatrix::MultRows
+{
+ public:
+  MultRows(const SparseMatrix & s,const Vector<real64> & i,Vector<real64> & o)
+  :self(s),in(i),out(o)
+  {}
+
+  void operator () (nat32 r0,nat32 r1)
+  {
+   const nat32 * rs = self.rowStart.Ptr();
+   const nat32 * col = self.column.Ptr();
+   const real64 * val = self.value.Ptr();
+
+   for (nat32 r=r0;r<r1;r++)
+   {
+    real64 sum = 0.0;
+    for (nat32 i=rs[r];i<rs[r+1];i++) sum += val[i]*in[col[i]];
+    out[r] = sum;
+   }
+  }
+
+
+ private:
+  const SparseMatrix & self;
+  const Vector<real64> & in;
+  Vector<real64> & out;
+};
+
+//------------------------------------------------------------------------------
+SparseMatrix::SparseMatrix()
+:rows(0),cols(0),pending(0,1024,256)
+{
+ rowStart.Size(1);
+ rowStart[0] = 0;
+}
+
+SparseMatrix::~SparseMatrix()
+{}
+
+void SparseMatrix::SetSize(nat32 r,nat32 c)
+{
+ rows = r;
+ cols = c;
+
+ rowStart.Size(rows+1);
+ for (nat32 i=0;i<=rows;i++) rowStart[i] = 0;
+ column.Size(0);
+ value.Size(0);
+ pending.Size(0);
+}
+
+void SparseMatrix::Add(nat32 r,nat32 c,real64 v)
+{
+ log::Assert((r<rows)&&(c<cols));
+ nat32 i = pending.Size();
+ pending.Size(i+1);
+ pending[i].r = r;
+ pending[i].c = c;
+ pending[i].v = v;
+}
+
+void SparseMatrix::Build()
+{
+ LogTime("eos::math::SparseMatrix::Build");
+ if (pending.Size()==0) return;
+
+ // Collect the existing entries and the new into one list...
+  nat32 total = column.Size() + pending.Size();
+  ds::Array<Entry> all(total);
+  nat32 n = 0;
+  for (nat32 r=0;r<rows;r++)
+  {
+   for (nat32 i=rowStart[r];i<rowStart[r+1];i++)
+   {
+    all[n].r = r;
+    all[n].c = column[i];
+    all[n].v = value[i];
+    ++n;
+   }
+  }
+
+  for (nat32 i=0;i<pending.Size();i++)
+  {
+   all[n] = pending[i];
+   ++n;
+  }
+  pending.Size(0);
+
+
+ // Counting sort by column then a stable counting sort by row, to get them
+ // into row major order...
+  ds::Array<Entry> byCol(total);
+  {
+   ds::Array<nat32> start(cols+1);
+   for (nat32 c=0;c<=cols;c++) start[c] = 0;
+   for (nat32 i=0;i<total;i++) start[all[i].c+1] += 1;
+   for (nat32 c=0;c<cols;c++) start[c+1] += start[c];
+   for (nat32 i=0;i<total;i++)
+   {
+    byCol[start[all[i].c]] = all[i];
+    start[all[i].c] += 1;
+   }
+  }
+
+  {
+   ds::Array<nat32> start(rows+1);
+   for (nat32 r=0;r<=rows;r++) start[r] = 0;
+   for (nat32 i=0;i<total;i++) start[byCol[i].r+1] += 1;
+   for (nat32 r=0;r<rows;r++) start[r+1] += start[r];
+   for (nat32 i=0;i<total;i++)
+   {
+    all[start[byCol[i].r]] = byCol[i];
+    start[byCol[i].r] += 1;
+   }
+  }
+
+
+ // Merge repeats and store...
+  column.Size(total);
+  value.Size(total);
+  n = 0;
+  nat32 i = 0;
+  for (nat32 r=0;r<rows;r++)
+  {
+   rowStart[r] = n;
+   while ((i<total)&&(all[i].r==r))
+   {
+    if ((n!=rowStart[r])&&(column[n-1]==all[i].c)) value[n-1] += all[i].v;
+    else
+    {
+     column[n] = all[i].c;
+     value[n] = all[i].v;
+     ++n;
+    }
+    ++i;
+   }
+  }
+  rowStart[rows] = n;
+
+  column.Size(n);
+  value.Size(n);
+}
+
+real64 SparseMatrix::Get(nat32 r,nat32 c) const
+{
+ nat32 low = rowStart[r];
+ nat32 high = rowStart[r+1];
+ while (low<high)
+ {
+  nat32 mid = (low+high)/2;
+  if (column[mid]<c) low = mid+1;
+                else high = mid;
+ }
+
+ if ((low<rowStart[r+1])&&(column[low]==c)) return value[low];
+ return 0.0;
+}
+
+void SparseMatrix::Mult(const Vector<real64> & in,Vector<real64> & out) const
+{
+ log::Assert(in.Size()==cols);
+ out.SetSize(rows);
+
+ MultRows mr(*this,in,out);
+ mt::ParallelFor(nat32(0),rows,mr,1024);
+}
+
+void SparseMatrix::MultTrans(const Vector<real64> & in,Vector<real64> & out) const
+{
+ log::Assert(in.Size()==rows);
+ out.SetSize(cols);
+ for (nat32 c=0;c<cols;c++) out[c] = 0.0;
+
+ for (nat32 r=0;r<rows;r++)
+ {
+  real64 v = in[r];
+  for (nat32 i=rowStart[r];i<rowStart[r+1];i++) out[column[i]] += value[i]*v;
+ }
+}
+
+void SparseMatrix::Transpose(SparseMatrix & out) const
+{
+ out.rows = cols;
+ out.cols = rows;
+ out.pending.Size(0);
+
+ out.rowStart.Size(cols+1);
+ out.column.Size(column.Size());
+ out.value.Size(value.Size());
+
+ for (nat32 c=0;c<=cols;c++) out.rowStart[c] = 0;
+ for (nat32 i=0;i<column.Size();i++) out.rowStart[column[i]+1] += 1;
+ for (nat32 c=0;c<cols;c++) out.rowStart[c+1] += out.rowStart[c];
+
+ ds::Array<nat32> pos(cols);
+ for (nat32 c=0;c<cols;c++) pos[c] = out.rowStart[c];
+
+ // Going through the rows in order keeps the output columns sorted...
+  for (nat32 r=0;r<rows;r++)
+  {
+   for (nat32 i=rowStart[r];i<rowStart[r+1];i++)
+   {
+    nat32 & p = pos[column[i]];
+    out.column[p] = r;
+    out.value[p] = value[i];
+    ++p;
+   }
+  }
+}
+
+void SparseMatrix::Diagonal(Vector<real64> & out) const
+{
+ out.SetSize(rows);
+ for (nat32 r=0;r<rows;r++) out[r] = Get(r,r);
+}
+
+//------------------------------------------------------------------------------
+JacobiPrecon::JacobiPrecon()
+{}
+
+JacobiPrecon::~JacobiPrecon()
+{}
+
+bit JacobiPrecon::Setup(const SparseMatrix & a)
+{
+ if (a.Rows()!=a.Cols()) return false;
+
+ a.Diagonal(invDiag);
+ for (nat32 i=0;i<invDiag.Size();i++)
+ {
+  if (!(invDiag[i]>0.0)) return false;
+  invDiag[i] = 1.0/invDiag[i];
+ }
+ return true;
+}
+
+void JacobiPrecon::Apply(const Vector<real64> & r,Vector<real64> & z) const
+{
+ z.SetSize(r.Size());
+ for (nat32 i=0;i<r.Size();i++) z[i] = r[i]*invDiag[i];
+}
+
+cstrconst JacobiPrecon::TypeString() const
+{
+ return "eos::math::JacobiPrecon";
+}
+
+//------------------------------------------------------------------------------
+CholeskyPrecon::CholeskyPrecon()
+:shift(1.0)
+{}
+
+CholeskyPrecon::~CholeskyPrecon()
+{}
+
+bit CholeskyPrecon::Setup(const SparseMatrix & a)
+{
+ LogTime("eos::math::CholeskyPrecon::Setup");
+ if (a.Rows()!=a.Cols()) return false;
+ nat32 n = a.Rows();
+
+ // Extract the lower triangle, checking every row has a positive diagonal...
+  l.SetSize(n,n);
+  for (nat32 r=0;r<n;r++)
+  {
+   bit diag = false;
+   for (nat32 i=a.RowBegin(r);i<a.RowEnd(r);i++)
+   {
+    nat32 c = a.Column(i);
+    if (c>r) break;
+    if (c==r)
+    {
+     if (!(a.Value(i)>0.0)) return false;
+     diag = true;
+    }
+    l.Add(r,c,a.Value(i));
+   }
+   if (!diag) return false;
+  }
+  l.Build();
+
+
+ // Factorise, row by row - each entry is the dot product of the earlier parts
+ // of its row and the row of its column, both sorted so they can be merged...
+ // If the diagonal goes non-positive restart with it inflated.
+  shift = 1.0;
+  ds::Array<real64> orig(l.NonZeros());
+  for (nat32 i=0;i<l.NonZeros();i++) orig[i] = l.Value(i);
+
+  real64 alpha = 1e-3;
+  while (true)
+  {
+   bit ok = true;
+   for (nat32 r=0;(r<n)&&ok;r++)
+   {
+    nat32 diag = l.RowEnd(r)-1;
+    for (nat32 i=l.RowBegin(r);i<=diag;i++)
+    {
+     nat32 c = l.Column(i);
+     real64 s = orig[i];
+     if (c==r) s *= shift;
+
+     nat32 j = l.RowBegin(r);
+     nat32 k = l.RowBegin(c);
+     nat32 kEnd = l.RowEnd(c)-1;
+     while ((j<i)&&(k<kEnd))
+     {
+      nat32 cj = l.Column(j);
+      nat32 ck = l.Column(k);
+      if (cj==ck)
+      {
+       s -= l.Value(j)*l.Value(k);
+       ++j;
+       ++k;
+      }
+      else
+      {
+       if (cj<ck) ++j;
+             else ++k;
+      }
+     }
+
+     if (c==r)
+     {
+      if (!(s>0.0)) {ok = false; break;}
+      l.Value(i) = Sqrt(s);
+     }
+     else l.Value(i) = s/l.Value(l.RowEnd(c)-1);
+    }
+   }
+
+   if (ok) break;
+   shift = 1.0 + alpha;
+   alpha *= 2.0;
+   if (alpha>1e6) return false;
+  }
+
+ return true;
+}
+
+void CholeskyPrecon::Apply(const Vector<real64> & r,Vector<real64> & z) const
+{
+ nat32 n = r.Size();
+ z.SetSize(n);
+
+ // Forward substitution, L y = r...
+  for (nat32 i=0;i<n;i++)
+  {
+   nat32 diag = l.RowEnd(i)-1;
+   real64 s = r[i];
+   for (nat32 j=l.RowBegin(i);j<diag;j++) s -= l.Value(j)*z[l.Column(j)];
+   z[i] = s/l.Value(diag);
+  }
+
+ // Backward substitution, L^T z = y, a row of L being a column of L^T...
+  for (int32 i=int32(n)-1;i>=0;i--)
+  {
+   nat32 diag = l.RowEnd(i)-1;
+   z[i] /= l.Value(diag);
+   real64 zi = z[i];
+   for (nat32 j=l.RowBegin(i);j<diag;j++) z[l.Column(j)] -= l.Value(j)*zi;
+  }
+}
+
+cstrconst CholeskyPrecon::TypeString() const
+{
+ return "eos::math::CholeskyPrecon";
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC nat32 SolvePCG(const SparseMatrix & a,const Vector<real64> & b,Vector<real64> & x,
+                        const Preconditioner * pre,real64 tol,nat32 maxIters,real64 * residual)
+{
+ LogTime("eos::math::SolvePCG");
+ nat32 n = a.Rows();
+ log::Assert((a.Cols()==n)&&(b.Size()==n));
+
+ if (x.Size()!=n)
+ {
+  x.SetSize(n);
+  for (nat32 i=0;i<n;i++) x[i] = 0.0;
+ }
+
+ // Initial residual...
+  Vector<real64> r;
+  a.Mult(x,r);
+  for (nat32 i=0;i<n;i++) r[i] = b[i] - r[i];
+
+  real64 bNorm = b.Length();
+  if (IsZero(bNorm))
+  {
+   for (nat32 i=0;i<n;i++) x[i] = 0.0;
+   if (residual) *residual = 0.0;
+   return 0;
+  }
+  real64 limit = Sqr(tol*bNorm);
+
+ // Iterate...
+  Vector<real64> z;
+  if (pre) pre->Apply(r,z);
+      else z = r;
+  Vector<real64> p = z;
+  Vector<real64> ap;
+  real64 rz = r*z;
+  real64 rr = r.LengthSqr();
+
+  nat32 iter = 0;
+  while ((iter<maxIters)&&(rr>limit))
+  {
+   a.Mult(p,ap);
+   real64 pap = p*ap;
+   if (!(pap>0.0)) break; // Not positive definite, or converged as far as precision allows.
+
+   real64 alpha = rz/pap;
+   rr = 0.0;
+   for (nat32 i=0;i<n;i++)
+   {
+    x[i] += alpha*p[i];
+    r[i] -= alpha*ap[i];
+    rr += Sqr(r[i]);
+   }
+   ++iter;
+   if (rr<=limit) break;
+
+   if (pre) pre->Apply(r,z);
+       else z = r;
+   real64 rzNew = r*z;
+   real64 beta = rzNew/rz;
+   rz = rzNew;
+   for (nat32 i=0;i<n;i++) p[i] = z[i] + beta*p[i];
+  }
+
+ if (residual) *residual = Sqrt(rr)/bNorm;
+ return iter;
+}
+
+//------------------------------------------------------------------------------
+SparseCholesky::SparseCholesky()
+{
+ colStart.Size(1);
+ colStart[0] = 0;
+}
+
+SparseCholesky::~SparseCholesky()
+{}
+
+bit SparseCholesky::Factorise(const SparseMatrix & a,bit order)
+{
+ LogTime("eos::math::SparseCholesky::Factorise");
+ log::Assert(a.Rows()==a.Cols());
+ nat32 n = a.Rows();
+
+ // Choose the ordering - reverse Cuthill-McKee is a breadth first search from
+ // a low degree node, visiting neighbours lowest degree first, reversed...
+  perm.Size(n);
+  if (order)
+  {
+   ds::Array<nat32> degree(n);
+   ds::Array<bit> done(n);
+   for (nat32 i=0;i<n;i++)
+   {
+    degree[i] = a.RowEnd(i) - a.RowBegin(i);
+    done[i] = false;
+   }
+
+   nat32 out = 0;
+   ds::Array<nat32> nb;
+   while (out<n)
+   {
+    // Lowest degree unvisited node starts each component...
+     nat32 start = 0;
+     nat32 best = math::max_nat_32;
+     for (nat32 i=0;i<n;i++)
+     {
+      if ((!done[i])&&(degree[i]<best)) {start = i; best = degree[i];}
+     }
+
+    nat32 head = out;
+    perm[out++] = start;
+    done[start] = true;
+    while (head<out)
+    {
+     nat32 v = perm[head++];
+
+     nat32 count = 0;
+     nb.Size(a.RowEnd(v) - a.RowBegin(v));
+     for (nat32 i=a.RowBegin(v);i<a.RowEnd(v);i++)
+     {
+      nat32 c = a.Column(i);
+      if (!done[c])
+      {
+       done[c] = true;
+       nb[count++] = c;
+      }
+     }
+
+     // Insertion sort by degree, neighbour lists being short...
+      for (nat32 i=1;i<count;i++)
+      {
+       nat32 t = nb[i];
+       nat32 j = i;
+       for (;(j>0)&&(degree[nb[j-1]]>degree[t]);j--) nb[j] = nb[j-1];
+       nb[j] = t;
+      }
+
+     for (nat32 i=0;i<count;i++) perm[out++] = nb[i];
+    }
+   }
+
+   for (nat32 i=0;i<n/2;i++) math::Swap(perm[i],perm[n-1-i]);
+  }
+  else
+  {
+   for (nat32 i=0;i<n;i++) perm[i] = i;
+  }
+
+
+ // Make the lower triangle of the permuted matrix...
+  SparseMatrix c;
+  {
+   ds::Array<nat32> inv(n);
+   for (nat32 i=0;i<n;i++) inv[perm[i]] = i;
+
+   c.SetSize(n,n);
+   for (nat32 i=0;i<n;i++)
+   {
+    nat32 r = perm[i];
+    for (nat32 j=a.RowBegin(r);j<a.RowEnd(r);j++)
+    {
+     nat32 k = inv[a.Column(j)];
+     if (k<=i) c.Add(i,k,a.Value(j));
+    }
+   }
+   c.Build();
+  }
+
+
+ // Elimination tree, with path compression on the ancestors...
+  ds::Array<int32> parent(n);
+  {
+   ds::Array<int32> ancestor(n);
+   for (nat32 k=0;k<n;k++)
+   {
+    parent[k] = -1;
+    ancestor[k] = -1;
+    for (nat32 j=c.RowBegin(k);j<c.RowEnd(k);j++)
+    {
+     int32 i = c.Column(j);
+     while ((i!=-1)&&(i<int32(k)))
+     {
+      int32 next = ancestor[i];
+      ancestor[i] = k;
+      if (next==-1) parent[i] = k;
+      i = next;
+     }
+    }
+   }
+  }
+
+
+ // The pattern of row k of the factor is the set of nodes reached by walking
+ // up the tree from each entry of row k of c, stopping at k. Give a helper
+ // that fills in s[top..n) with it, in an order suitable for the solve...
+  ds::Array<int32> mark(n);
+  ds::Array<nat32> stack(n);
+  struct Reach
+  {
+   static nat32 Do(const SparseMatrix & c,nat32 k,const ds::Array<int32> & parent,
+                   ds::Array<int32> & mark,ds::Array<nat32> & stack)
+   {
+    nat32 n = c.Rows();
+    nat32 top = n;
+    mark[k] = k;
+    for (nat32 j=c.RowBegin(k);j<c.RowEnd(k);j++)
+    {
+     nat32 i = c.Column(j);
+     if (i>=k) continue;
+
+     nat32 len = 0;
+     while (mark[i]!=int32(k))
+     {
+      stack[len++] = i;
+      mark[i] = k;
+      i = parent[i];
+     }
+     while (len>0) stack[--top] = stack[--len];
+    }
+    return top;
+   }
+  };
+  // (The walk writes to the front of stack whilst the result builds up at the
+  // back - they can't collide as each node is only visited once.)
+
+
+ // Column counts, for allocation...
+  ds::Array<nat32> count(n);
+  for (nat32 i=0;i<n;i++)
+  {
+   count[i] = 1;
+   mark[i] = -1;
+  }
+  for (nat32 k=0;k<n;k++)
+  {
+   nat32 top = Reach::Do(c,k,parent,mark,stack);
+   for (nat32 i=top;i<n;i++) count[stack[i]] += 1;
+  }
+
+  colStart.Size(n+1);
+  colStart[0] = 0;
+  for (nat32 i=0;i<n;i++) colStart[i+1] = colStart[i] + count[i];
+
+  index.Size(colStart[n]);
+  value.Size(colStart[n]);
+
+
+ // Numeric factorisation, a row at a time, each a sparse triangular solve
+ // against the columns so far...
+  ds::Array<nat32> next(n);
+  ds::Array<real64> x(n);
+  for (nat32 i=0;i<n;i++)
+  {
+   next[i] = colStart[i];
+   mark[i] = -1;
+   x[i] = 0.0;
+  }
+
+  for (nat32 k=0;k<n;k++)
+  {
+   nat32 top = Reach::Do(c,k,parent,mark,stack);
+
+   for (nat32 j=c.RowBegin(k);j<c.RowEnd(k);j++) x[c.Column(j)] = c.Value(j);
+   real64 d = x[k];
+   x[k] = 0.0;
+
+   for (nat32 s=top;s<n;s++)
+   {
+    nat32 i = stack[s];
+    real64 lki = x[i]/value[colStart[i]];
+    x[i] = 0.0;
+    for (nat32 p=colStart[i]+1;p<next[i];p++) x[index[p]] -= value[p]*lki;
+
+    d -= lki*lki;
+    nat32 p = next[i]++;
+    index[p] = k;
+    value[p] = lki;
+   }
+
+   if (!(d>0.0)) return false;
+   nat32 p = next[k]++;
+   index[p] = k;
+   value[p] = Sqrt(d);
+  }
+
+ return true;
+}
+
+void SparseCholesky::Solve(const Vector<real64> & b,Vector<real64> & x) const
+{
+ nat32 n = perm.Size();
+ log::Assert(b.Size()==n);
+
+ Vector<real64> y(n);
+ for (nat32 i=0;i<n;i++) y[i] = b[perm[i]];
+
+ // L y' = y...
+  for (nat32 j=0;j<n;j++)
+  {
+   y[j] /= value[colStart[j]];
+   real64 yj = y[j];
+   for (nat32 p=colStart[j]+1;p<colStart[j+1];p++) y[index[p]] -= value[p]*yj;
+  }
+
+ // L^T x' = y'...
+  for (int32 j=int32(n)-1;j>=0;j--)
+  {
+   real64 s = y[j];
+   for (nat32 p=colStart[j]+1;p<colStart[j+1];p++) s -= value[p]*y[index[p]];
+   y[j] = s/value[colStart[j]];
+  }
+
+ x.SetSize(n);
+ for (nat32 i=0;i<n;i++) x[perm[i]] = y[i];
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,282 @@
+#ifndef EOS_MATH_SPARSE_H
+#define EOS_MATH_SPARSE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file sparse.h
+/// Provides a sparse matrix, and the linear solvers to go with it - a
+/// preconditioned conjugate gradient solver and a sparse Cholesky
+/// factorisation. For the large systems that come out of finite differences
+/// on images, e.g. integrating a needle map, where a dense solve is out of the
+/// question.
+
+#include "eos/types.h"
+#include "eos/math/vectors.h"
+#include "eos/ds/arrays.h"
+#include "eos/ds/arrays_resize.h"
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+/// A sparse matrix of real64's, stored in compressed sparse row (CSR) form, so
+/// each row is a run of (column,value) pairs, sorted by column. For the
+/// compressed sparse column form of a matrix take the Transpose, as the CSR of
+/// the transpose is the CSC of the original.
+///
+/// Built by setting the size then adding entries in any order, with repeats
+/// summed, before calling Build to compress them - this suits assembling a
+/// matrix term by term, as for finite differences. Once built the values can
+/// be edited in place, but the structure is fixed until the next Build.
+class EOS_CLASS SparseMatrix
+{
+ public:
+  /// Constructs a 0x0 matrix.
+   SparseMatrix();
+
+  /// &nbsp;
+   ~SparseMatrix();
+
+
+  /// Sets the size, emptying the matrix.
+   void SetSize(nat32 rows,nat32 cols);
+
+  /// Adds v to the entry at (r,c). Does not change the matrix until Build is
+  /// called.
+   void Add(nat32 r,nat32 c,real64 v);
+
+  /// Compresses all entries added since the last Build into the matrix,
+  /// summing them with any entries allready there.
+   void Build();
+
+
+  /// &nbsp;
+   nat32 Rows() const {return rows;}
+
+  /// &nbsp;
+   nat32 Cols() const {return cols;}
+
+  /// Returns how many entries are stored.
+   nat32 NonZeros() const {return column.Size();}
+
+  /// Returns the value at (r,c), 0 if it is not stored. Binary search.
+   real64 Get(nat32 r,nat32 c) const;
+
+
+  /// Returns the index of the first entry of a row.
+   nat32 RowBegin(nat32 r) const {return rowStart[r];}
+
+  /// Returns one past the index of the last entry of a row.
+   nat32 RowEnd(nat32 r) const {return rowStart[r+1];}
+
+  /// Returns the column of an entry, by index.
+   nat32 Column(nat32 i) const {return column[i];}
+
+  /// Returns the value of an entry, by index.
+   real64 & Value(nat32 i) {return value[i];}
+
+  /// &nbsp;
+   const real64 & Value(nat32 i) const {return value[i];}
+
+
+  /// Sets out = this * in, with the rows split between the threads of the
+  /// task pool. out is resized as needed, and must not be in.
+   void Mult(const Vector<real64> & in,Vector<real64> & out) const;
+
+  /// Sets out = this^T * in. out is resized as needed, and must not be in.
+   void MultTrans(const Vector<real64> & in,Vector<real64> & out) const;
+
+  /// Outputs the transpose.
+   void Transpose(SparseMatrix & out) const;
+
+  /// Outputs the diagonal, 0 where it is not stored. For square matrices.
+   void Diagonal(Vector<real64> & out) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::SparseMatrix";}
+
+
+ private:
+  nat32 rows;
+  nat32 cols;
+
+  ds::Array<nat32> rowStart; // rows+1 entries.
+  ds::Array<nat32> column;
+  ds::Array<real64> value;
+
+  struct Entry
+  {
+   nat32 r;
+   nat32 c;
+   real64 v;
+  };
+  ds::ArrayResize<Entry> pending;
+
+  class MultRows;
+};
+
+//------------------------------------------------------------------------------
+/// The interface for a preconditioner for SolvePCG, an approximation of the
+/// inverse of the matrix that is cheap to apply.
+class EOS_CLASS Preconditioner : public Deletable
+{
+ public:
+  /// &nbsp;
+   ~Preconditioner() {}
+
+  /// Prepares for the given matrix, returning false if it can't.
+   virtual bit Setup(const SparseMatrix & a) = 0;
+
+  /// Sets z to the preconditioner applied to r. z is resized as needed, and
+  /// must not be r.
+   virtual void Apply(const Vector<real64> & r,Vector<real64> & z) const = 0;
+
+  /// &nbsp;
+   virtual cstrconst TypeString() const = 0;
+};
+
+//------------------------------------------------------------------------------
+/// The Jacobi preconditioner, which divides by the diagonal. Costs next to
+/// nothing, but does little more than normalise the rows.
+class EOS_CLASS JacobiPrecon : public Preconditioner
+{
+ public:
+  /// &nbsp;
+   JacobiPrecon();
+
+  /// &nbsp;
+   ~JacobiPrecon();
+
+  /// Fails if any diagonal entry is not positive.
+   bit Setup(const SparseMatrix & a);
+
+  /// &nbsp;
+   void Apply(const Vector<real64> & r,Vector<real64> & z) const;
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  Vector<real64> invDiag;
+};
+
+//------------------------------------------------------------------------------
+/// The incomplete Cholesky preconditioner, IC(0) - the Cholesky factorisation
+/// of the matrix restricted to the sparsity pattern of its lower triangle, so
+/// it costs the same to apply as a multiplication by the matrix. For the
+/// Laplacian like matrices of image problems it typically cuts the iterations
+/// of SolvePCG by a factor of two to four over JacobiPrecon. If the
+/// factorisation breaks down, which can happen for matrices that are not
+/// diagonally dominant, it is redone with the diagonal inflated until it
+/// works. The matrix must be symmetric, stored in full.
+class EOS_CLASS CholeskyPrecon : public Preconditioner
+{
+ public:
+  /// &nbsp;
+   CholeskyPrecon();
+
+  /// &nbsp;
+   ~CholeskyPrecon();
+
+  /// Fails if the matrix is not square or lacks a positive diagonal.
+   bit Setup(const SparseMatrix & a);
+
+  /// &nbsp;
+   void Apply(const Vector<real64> & r,Vector<real64> & z) const;
+
+  /// Returns the factor the diagonal was inflated by to avoid breakdown in the
+  /// last Setup, 1 if it was not needed.
+   real64 Shift() const {return shift;}
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  SparseMatrix l; // Lower triangle, so the diagonal is the last entry of each row.
+  real64 shift;
+};
+
+//------------------------------------------------------------------------------
+/// Solves a x = b with the preconditioned conjugate gradient method, for a
+/// symmetric positive definite matrix a. x is used as the initial guess, if it
+/// is the right size, otherwise it is zeroed. Iterates until the residual
+/// |b - a x| is no more than tol*|b|, or maxIters is reached. The
+/// preconditioner, if given, must allready be Setup for a.
+/// Returns the iterations done, with the final relative residual written to
+/// residual if it is provided.
+EOS_FUNC nat32 SolvePCG(const SparseMatrix & a,const Vector<real64> & b,Vector<real64> & x,
+                        const Preconditioner * pre = null<Preconditioner*>(),
+                        real64 tol = 1e-6,nat32 maxIters = 1000,
+                        real64 * residual = null<real64*>());
+
+//------------------------------------------------------------------------------
+/// A sparse Cholesky factorisation, for solving symmetric positive definite
+/// systems directly, with repeated right hand sides being cheap once it is
+/// done. Up-looking, with the structure found in advance from the elimination
+/// tree. The rows and columns can be reordered with reverse Cuthill-McKee to
+/// reduce fill in, which keeps it banded - good for meshes and small images,
+/// but for large grids the factor grows with the width, so SolvePCG with a
+/// CholeskyPrecon is then the better option.
+class EOS_CLASS SparseCholesky
+{
+ public:
+  /// &nbsp;
+   SparseCholesky();
+
+  /// &nbsp;
+   ~SparseCholesky();
+
+
+  /// Factorises the given matrix, which must be symmetric, stored in full.
+  /// order selects whether to reorder it first. Returns false if it is
+  /// not positive definite.
+   bit Factorise(const SparseMatrix & a,bit order = true);
+
+  /// Given the right hand side b outputs x, such that a x = b. x is resized
+  /// as needed, and can not be b.
+   void Solve(const Vector<real64> & b,Vector<real64> & x) const;
+
+
+  /// Returns the size of the system factorised.
+   nat32 Size() const {return perm.Size();}
+
+  /// Returns how many entries are in the factor, to judge fill in.
+   nat32 NonZeros() const {return index.Size();}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::SparseCholesky";}
+
+
+ private:
+  ds::Array<nat32> perm; // Factor row i is row perm[i] of the input.
+
+  // The factor, by columns, with the diagonal first in each...
+   ds::Array<nat32> colStart;
+   ds::Array<nat32> index;
+   ds::Array<real64> value;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
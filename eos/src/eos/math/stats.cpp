@@ -24,6 +24,84 @@ namespace eos
 {
  namespace math
  {
+//------------------------------------------------------------------------------
+Histogram::Histogram(real32 l,real32 h,nat32 bins)
+{
+ Set(l,h,bins);
+}
+
+Histogram::Histogram(const Histogram & rhs)
+:low(rhs.low),high(rhs.high),mult(rhs.mult),bin(rhs.bin.Size()),below(rhs.below),above(rhs.above)
+{
+ for (nat32 i=0;i<bin.Size();i++) bin[i] = rhs.bin[i];
+}
+
+Histogram::~Histogram()
+{}
+
+Histogram & Histogram::operator = (const Histogram & rhs)
+{
+ low = rhs.low;
+ high = rhs.high;
+ mult = rhs.mult;
+ bin.Size(rhs.bin.Size());
+ for (nat32 i=0;i<bin.Size();i++) bin[i] = rhs.bin[i];
+ below = rhs.below;
+ above = rhs.above;
+ return *this;
+}
+
+void Histogram::Set(real32 l,real32 h,nat32 bins)
+{
+ log::Assert((h>l)&&(bins!=0),"math::Histogram::Set");
+ low = l;
+ high = h;
+ mult = real32(bins)/(h-l);
+ bin.Size(bins);
+ Reset();
+}
+
+void Histogram::Reset()
+{
+ for (nat32 i=0;i<bin.Size();i++) bin[i] = 0;
+ below = 0;
+ above = 0;
+}
+
+void Histogram::Merge(const Histogram & rhs)
+{
+ log::Assert((rhs.bin.Size()==bin.Size())&&Equal(rhs.low,low)&&Equal(rhs.high,high),"math::Histogram::Merge");
+ for (nat32 i=0;i<bin.Size();i++) bin[i] += rhs.bin[i];
+ below += rhs.below;
+ above += rhs.above;
+}
+
+nat32 Histogram::Samples() const
+{
+ nat32 ret = below + above;
+ for (nat32 i=0;i<bin.Size();i++) ret += bin[i];
+ return ret;
+}
+
+real32 Histogram::Quantile(real32 p) const
+{
+ nat32 total = Samples() - below - above;
+ if (total==0) return low;
+
+ real64 target = math::Clamp<real64>(p,0.0,1.0) * real64(total);
+ real64 sum = 0.0;
+ for (nat32 i=0;i<bin.Size();i++)
+ {
+  if ((bin[i]!=0)&&(sum+real64(bin[i])>=target))
+  {
+   real64 t = (target - sum)/real64(bin[i]);
+   return low + (real32(i) + t)/mult;
+  }
+  sum += bin[i];
+ }
+ return high;
+}
+
 //------------------------------------------------------------------------------
 UniDensityEstimate::UniDensityEstimate()
 :size(0),sd(0.0)
@@ -40,6 +118,13 @@ void UniDensityEstimate::Add(real32 x)
  size += 1;
 }
 
+void UniDensityEstimate::Merge(const UniDensityEstimate & rhs)
+{
+ if (size+rhs.size>data.Size()) data.Size(size+rhs.size+incSize);
+ for (nat32 i=0;i<rhs.size;i++) data[size+i] = rhs.data[i];
+ size += rhs.size;
+}
+
 nat32 UniDensityEstimate::Samples() const
 {
  return size;
@@ -76,6 +76,8 @@ struct Range
 /// that, i.e. how many times it didn't produce a number(!).
 /// When used with text IO it outputs/inputs as sample_count<bad_results>{min,mean(sd),max}
 /// Bad results are only shown if there are bad results, i.e. <0> will never be output.
+/// Two can be merged, so each thread can collect its own before they are
+/// combined - it has what mt::ParallelReduce requires.
 class Sample
 {
  public:
@@ -117,6 +119,31 @@ class Sample
   /// Incriments the count of bad samples.
    void AddBad() {++badCount;}
 
+  /// Merges in the samples of another, as though they had all been added to
+  /// this one. Uses the pairwise update of Chan et al., which is as stable as
+  /// adding them one at a time.
+   void Merge(const Sample & rhs)
+   {
+    badCount += rhs.badCount;
+    if (rhs.samples==0) return;
+    if (samples==0)
+    {
+     samples = rhs.samples;
+     min = rhs.min; max = rhs.max;
+     mean = rhs.mean; sdi = rhs.sdi;
+     return;
+    }
+
+    min = math::Min(min,rhs.min);
+    max = math::Max(max,rhs.max);
+
+    real64 n = real64(samples) + real64(rhs.samples);
+    real64 delta = rhs.mean - mean;
+    mean += delta * real64(rhs.samples)/n;
+    sdi += rhs.sdi + math::Sqr(delta) * real64(samples) * real64(rhs.samples)/n;
+    samples += rhs.samples;
+   }
+
 
   /// Returns how many samples have been Add(..)'ed to the class, if it
   /// returns 0 don't query the stats.
@@ -142,6 +169,9 @@ class Sample
   /// repeatedly calling this method.
    real32 Sd() const {return (samples>1)?math::Sqrt(sdi/real64(samples-1)):0.0;}
 
+  /// Returns the variance of the samples provided.
+   real32 Variance() const {return (samples>1)?(sdi/real64(samples-1)):0.0;}
+
 
   /// &nbsp;
    static inline cstrconst TypeString() {return "eos::math::Sample";}
@@ -168,6 +198,216 @@ class Sample
   real64 sdi; // Variance * (samples-1).
 };
 
+//------------------------------------------------------------------------------
+/// A simple templated structure that is quite useful for representing
+/// multi-variate statistics.
+/// Nothing more than a shell.
+template <nat32 N,typename T = real32>
+class EOS_CLASS MeanCovar
+{
+ public:
+  /// &nbsp;
+   Vect<N,T> mean;
+   
+  /// &nbsp;
+   Mat<N,N,T> covar;
+};
+
+//------------------------------------------------------------------------------
+/// The multivariate version of Sample, for the mean and covariance of a set of
+/// vectors. Uses the same numerically stable updates, and can be merged in the
+/// same way, for use with mt::ParallelReduce.
+template <nat32 N,typename T = real32>
+class EOS_CLASS SampleCovar
+{
+ public:
+  /// &nbsp;
+   SampleCovar() {Reset();}
+
+  /// &nbsp;
+   ~SampleCovar() {}
+
+  /// Resets the object as though no samples are contained.
+   void Reset()
+   {
+    samples = 0;
+    for (nat32 r=0;r<N;r++)
+    {
+     mean[r] = 0.0;
+     for (nat32 c=0;c<N;c++) co[r][c] = 0.0;
+    }
+   }
+
+
+  /// Adds a sample.
+   void Add(const Vect<N,T> & x)
+   {
+    ++samples;
+    real64 delta[N];
+    for (nat32 r=0;r<N;r++)
+    {
+     delta[r] = x[r] - mean[r];
+     mean[r] += delta[r]/real64(samples);
+    }
+    for (nat32 r=0;r<N;r++)
+    {
+     real64 after = x[r] - mean[r];
+     for (nat32 c=0;c<=r;c++) co[r][c] += delta[c] * after;
+    }
+   }
+
+  /// Merges in the samples of another, as though they had all been added to
+  /// this one.
+   void Merge(const SampleCovar<N,T> & rhs)
+   {
+    if (rhs.samples==0) return;
+    if (samples==0) {*this = rhs; return;}
+
+    real64 n = real64(samples) + real64(rhs.samples);
+    real64 mult = real64(samples) * real64(rhs.samples)/n;
+    real64 delta[N];
+    for (nat32 r=0;r<N;r++)
+    {
+     delta[r] = rhs.mean[r] - mean[r];
+     mean[r] += delta[r] * real64(rhs.samples)/n;
+    }
+    for (nat32 r=0;r<N;r++)
+    {
+     for (nat32 c=0;c<=r;c++) co[r][c] += rhs.co[r][c] + delta[r]*delta[c]*mult;
+    }
+    samples += rhs.samples;
+   }
+
+
+  /// Returns how many samples have been added.
+   nat32 Samples() const {return samples;}
+
+  /// Returns an entry of the mean.
+   real64 Mean(nat32 i) const {return mean[i];}
+
+  /// Returns an entry of the sample covariance, i.e. divided by samples-1.
+   real64 Covar(nat32 r,nat32 c) const
+   {
+    if (samples<2) return 0.0;
+    return ((c<=r)?co[r][c]:co[c][r])/real64(samples-1);
+   }
+
+  /// Outputs the mean and covariance.
+   void Get(Vect<N,T> & m,Mat<N,N,T> & covar) const
+   {
+    for (nat32 r=0;r<N;r++)
+    {
+     m[r] = mean[r];
+     for (nat32 c=0;c<=r;c++)
+     {
+      covar[r][c] = Covar(r,c);
+      covar[c][r] = covar[r][c];
+     }
+    }
+   }
+
+  /// Outputs the mean and covariance, into the shell provided for them.
+   void Get(MeanCovar<N,T> & out) const {Get(out.mean,out.covar);}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::math::SampleCovar<" << typestring<T>() << ">");
+    return ret;
+   }
+
+
+ private:
+  nat32 samples;
+  real64 mean[N];
+  real64 co[N][N]; // Covariance times (samples-1), lower triangle only.
+};
+
+//------------------------------------------------------------------------------
+/// A histogram with a fixed range split into equal sized bins, for when a
+/// distribution is needed rather than a few moments, e.g. for finding
+/// percentiles. Samples outside the range are counted but not binned. Two
+/// with the same range and bins can be merged, for use with
+/// mt::ParallelReduce.
+class EOS_CLASS Histogram
+{
+ public:
+  /// Bins [low,high) into the given number of bins.
+   Histogram(real32 low = 0.0,real32 high = 1.0,nat32 bins = 256);
+
+  /// &nbsp;
+   Histogram(const Histogram & rhs);
+
+  /// &nbsp;
+   ~Histogram();
+
+  /// &nbsp;
+   Histogram & operator = (const Histogram & rhs);
+
+  /// Changes the range and bins, emptying it.
+   void Set(real32 low,real32 high,nat32 bins);
+
+  /// Empties it, keeping the range and bins.
+   void Reset();
+
+
+  /// Adds a sample. NaN's count as below the range.
+   void Add(real32 x)
+   {
+    if (!(x>=low)) ++below;
+    else
+    {
+     if (x<high) ++bin[math::Min(nat32((x-low)*mult),bin.Size()-1)];
+            else ++above;
+    }
+   }
+
+  /// Merges in the counts of another, which must have the same range and
+  /// bins.
+   void Merge(const Histogram & rhs);
+
+
+  /// Returns the number of bins.
+   nat32 Bins() const {return bin.Size();}
+
+  /// Returns the count of a bin.
+   nat32 Count(nat32 i) const {return bin[i];}
+
+  /// Returns the centre of a bin.
+   real32 Centre(nat32 i) const {return low + (real32(i)+0.5)/mult;}
+
+  /// Returns how many samples were below the range.
+   nat32 Below() const {return below;}
+
+  /// Returns how many samples were above the range.
+   nat32 Above() const {return above;}
+
+  /// Returns how many samples have been added, including those outside the
+  /// range.
+   nat32 Samples() const;
+
+
+  /// Returns the value below which the given fraction of the binned samples
+  /// lie, interpolating linearly within bins, so Quantile(0.5) is the median.
+  /// Samples outside the range are ignored. Returns low if it is empty.
+   real32 Quantile(real32 p) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::Histogram";}
+
+
+ private:
+  real32 low;
+  real32 high;
+  real32 mult; // Bins per unit.
+
+  ds::Array<nat32> bin;
+  nat32 below;
+  nat32 above;
+};
+
 //------------------------------------------------------------------------------
 /// This uses kernel density estimation on a 1-dimensional input to estimate
 /// an unknown pdf given a set of samples from that pdf. It uses the simplistic
@@ -199,6 +439,10 @@ class EOS_CLASS UniDensityEstimate
   /// Must not be called after Run has been called.
    void Add(real32 x);
 
+  /// Adds all the data points of another, so threads can each collect there
+  /// own. Neither must have had Run called.
+   void Merge(const UniDensityEstimate & rhs);
+
   /// Returns how many samples are contained - if it returns 0 don't do anything
   /// other than Add(...) to it.
    nat32 Samples() const;
@@ -278,21 +522,6 @@ class EOS_CLASS UniDensityEstimate
    };
 };
 
-//------------------------------------------------------------------------------
-/// A simple templated structure that is quite useful for representing
-/// multi-variate statistics.
-/// Nothing more than a shell.
-template <nat32 N,typename T = real32>
-class EOS_CLASS MeanCovar
-{
- public:
-  /// &nbsp;
-   Vect<N,T> mean;
-   
-  /// &nbsp;
-   Mat<N,N,T> covar;
-};
-
 //------------------------------------------------------------------------------
  };
 };
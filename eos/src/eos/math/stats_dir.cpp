@@ -72,13 +72,13 @@ void Fisher::Sample(Vect<3,real32> & out,data::Random & rand) const
   real32 theta = pi * rand.NormalInc();
   if (!math::IsZero(k))
   {
-   real32 theta_prob = Exp(k*Cos(theta)) * Sin(theta);
+   real32 theta_prob = KernelExp(k*Cos(theta)) * Sin(theta);
    nat32 accepts = 48;
   
    while (accepts)
    {
     real32 theta_new = theta + rand.Gaussian(pi*0.25);
-    real32 theta_new_prob = Exp(k * Cos(theta_new)) * Sin(theta_new);
+    real32 theta_new_prob = KernelExp(k * Cos(theta_new)) * Sin(theta_new);
     real32 ratio = theta_new_prob / theta_prob;
     
     if ((ratio>=1.0)||(ratio>rand.Normal()))
@@ -210,15 +210,15 @@ void FisherBingham::Convolve(real32 k)
     {
      for (nat32 j=0;j<3;j++)
      {
-      dp[j] += fish_weight[i]*Exp(fish[i][j]);
-      dn[j] += fish_weight[i]*Exp(-fish[i][j]);
+      dp[j] += fish_weight[i]*KernelExp(fish[i][j]);
+      dn[j] += fish_weight[i]*KernelExp(-fish[i][j]);
      }
     }
     
     for (nat32 j=0;j<3;j++)
     {
-     dp[j] = Ln(dp[j]/weight);
-     dn[j] = Ln(dn[j]/weight);
+     dp[j] = KernelLn(dp[j]/weight);
+     dn[j] = KernelLn(dn[j]/weight);
      rotFish[j] = dp[j] - 0.5*(dp[j]+dn[j]);
     }
     
@@ -237,15 +237,15 @@ void FisherBingham::Convolve(real32 k)
     {
      for (nat32 j=0;j<3;j++)
      {
-      dp[j] += fish_weight[i]*Exp(fish[i][j]);
-      dn[j] += fish_weight[i]*Exp(-fish[i][j]);
+      dp[j] += fish_weight[i]*KernelExp(fish[i][j]);
+      dn[j] += fish_weight[i]*KernelExp(-fish[i][j]);
      }
     }
     
     for (nat32 j=0;j<3;j++)
     {
-     dp[j] = Ln(dp[j]/weight);
-     dn[j] = Ln(dn[j]/weight);
+     dp[j] = KernelLn(dp[j]/weight);
+     dn[j] = KernelLn(dn[j]/weight);
      rotBing[j] = 0.5*(dp[j]+dn[j]);
      rotFish[j] += dp[j] - rotBing[j];
     }
@@ -690,9 +690,9 @@ void FisherBingham::ToFisher(nat32 num,Fisher * out) const
   diag[min_ind] = 0.0;
 
 
- // Calculate the two multipliers - this is the slow bit...
-  real32 alpha_mult = InverseModBesselFirstOrder0(Exp(diag[alpha_ind]));
-  real32 beta_mult = InverseModBesselFirstOrder0(Exp(diag[beta_ind]));
+ // Calculate the two multipliers - this was the slow bit, until tabulated...
+  real32 alpha_mult = InverseModBesselFirstOrder0Ln(diag[alpha_ind]);
+  real32 beta_mult = InverseModBesselFirstOrder0Ln(diag[beta_ind]);
    
  // Iterate and fill in each Fisher distribution from the sum in turn...
   for (nat32 i=0;i<num;i++)
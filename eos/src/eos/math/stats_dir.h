@@ -140,7 +140,7 @@ class EOS_CLASS Fisher : public Vect<3,real32>
   /// multiple calls of this method.
    real32 UnnormProb(const Vect<3,real32> & rhs) const
    {
-    return Exp(rhs * (*this));
+    return KernelExp(rhs * (*this));
    }
 
 
@@ -203,7 +203,7 @@ class EOS_CLASS Bingham : public Mat<3,3,real32>
   /// Returns the unnormalised probablity of a given normalised vector.
    real32 UnnormProb(const Vect<3,real32> & rhs) const
    {
-    return Exp(VectMultVect(rhs,*this,rhs));
+    return KernelExp(VectMultVect(rhs,*this,rhs));
    }
 
 
@@ -370,7 +370,7 @@ class EOS_CLASS FisherBingham
   /// The normalisation constant can not be calculated analytically.
    real32 UnnormProb(const Vect<3,real32> & rhs) const
    {
-    return Exp(rhs * fisher + VectMultVect(rhs,bingham,rhs));
+    return KernelExp(rhs * fisher + VectMultVect(rhs,bingham,rhs));
    }
    
   /// Returns the normalising divider of the distribution. Well, an
@@ -612,6 +612,169 @@ inline bit SVD(MT1 & u,MT2 & d,MT3 & v,MT4 & temp)
  return all_good;
 }
 
+//------------------------------------------------------------------------------
+/// The fixed size square version of SVD, used for the small sizes via
+/// overloads. One sided Jacobi - rotations are applied to the columns of u
+/// until they are orthogonal, with v accumulating them, after which the column
+/// lengths are the singular values. For matrices this small it is far faster
+/// than bidiagonalisation, and more accurate. Output is as for SVD, the
+/// singular values decreasing, with columns of u that correspond to zero
+/// singular values filled in to keep it orthogonal. Returns false if it ran
+/// out of sweeps, which is very rare, or the input was not finite.
+template <nat32 S,typename T>
+inline bit SVDJacobi(Mat<S,S,T> & u,Vect<S,T> & d,Mat<S,S,T> & v,nat32 maxSweeps = 32)
+{
+ Identity(v);
+ 
+ // Overall size, so columns that are noise can be left alone...
+  T frob = T(0);
+  for (nat32 r=0;r<S;r++)
+  {
+   for (nat32 c=0;c<S;c++) frob += Sqr(u[r][c]);
+  }
+  frob = Sqrt(frob);
+  if (!IsFinite(frob)) return false;
+  T tiny = Epsilon<T>()*frob;
+
+ // Orthogonalise the columns...
+  bit done = false;
+  for (nat32 sweep=0;(sweep<maxSweeps)&&(!done);sweep++)
+  {
+   done = true;
+   for (nat32 p=0;p+1<S;p++)
+   {
+    for (nat32 r=p+1;r<S;r++)
+    {
+     T alpha = T(0);
+     T beta = T(0);
+     T gamma = T(0);
+     for (nat32 k=0;k<S;k++)
+     {
+      alpha += Sqr(u[k][p]);
+      beta += Sqr(u[k][r]);
+      gamma += u[k][p]*u[k][r];
+     }
+     
+     if (Sqrt(Min(alpha,beta))<=tiny) continue;
+     T norm = Sqrt(alpha*beta);
+     if (Abs(gamma)<=T(S)*Epsilon<T>()*norm) continue;
+     done = false;
+
+     T zeta = (beta - alpha)/(T(2)*gamma);
+     T t = T(1)/(Abs(zeta) + Sqrt(Sqr(zeta) + T(1)));
+     if (zeta<T(0)) t = -t;
+     T c = T(1)/Sqrt(Sqr(t) + T(1));
+     T sn = t*c;
+
+     for (nat32 k=0;k<S;k++)
+     {
+      T up = u[k][p];
+      T ur = u[k][r];
+      u[k][p] = c*up - sn*ur;
+      u[k][r] = sn*up + c*ur;
+      
+      T vp = v[k][p];
+      T vr = v[k][r];
+      v[k][p] = c*vp - sn*vr;
+      v[k][r] = sn*vp + c*vr;
+     }
+    }
+   }
+  }
+
+
+ // Extract the singular values, sorting into decreasing order...
+  for (nat32 i=0;i<S;i++)
+  {
+   T len = T(0);
+   for (nat32 k=0;k<S;k++) len += Sqr(u[k][i]);
+   d[i] = Sqrt(len);
+   if (!IsFinite(d[i])) return false;
+  }
+  
+  for (nat32 i=1;i<S;i++)
+  {
+   for (nat32 j=i;(j>0)&&(d[j]>d[j-1]);j--)
+   {
+    math::Swap(d[j],d[j-1]);
+    u.SwapCols(j,j-1);
+    v.SwapCols(j,j-1);
+   }
+  }
+  
+  // Anything at the noise floor is zero - such a column of u is not
+  // orthogonal to the others, so is better replaced below...
+   for (nat32 i=1;i<S;i++)
+   {
+    if (d[i]<=T(S)*Epsilon<T>()*d[0]) d[i] = T(0);
+   }
+  
+  // Anything at the noise floor is zero - such a column of u is not
+  // orthogonal to the others, so is better replaced below...
+   for (nat32 i=1;i<S;i++)
+   {
+    if (d[i]<=T(S)*Epsilon<T>()*d[0]) d[i] = T(0);
+   }
+
+
+ // Normalise the columns of u - any that are zero are replaced by whichever
+ // axis has the most left over once made orthogonal to the columns before...
+  for (nat32 i=0;i<S;i++)
+  {
+   if (d[i]>T(0))
+   {
+    T inv = T(1)/d[i];
+    for (nat32 k=0;k<S;k++) u[k][i] *= inv;
+   }
+   else
+   {
+    T best = T(-1);
+    for (nat32 a=0;a<S;a++)
+    {
+     Vect<S,T> cand;
+     for (nat32 k=0;k<S;k++) cand[k] = (k==a)?T(1):T(0);
+     for (nat32 j=0;j<i;j++)
+     {
+      T dot = u[a][j];
+      for (nat32 k=0;k<S;k++) cand[k] -= dot*u[k][j];
+     }
+     
+     T len = T(0);
+     for (nat32 k=0;k<S;k++) len += Sqr(cand[k]);
+     if (len>best)
+     {
+      best = len;
+      T inv = T(1)/Sqrt(len);
+      for (nat32 k=0;k<S;k++) u[k][i] = cand[k]*inv;
+     }
+    }
+   }
+  }
+
+ return done;
+}
+
+/// SVD for 2x2 matrices, using SVDJacobi. temp is not used.
+template <typename T,typename MT>
+inline bit SVD(Mat<2,2,T> & u,Vect<2,T> & d,Mat<2,2,T> & v,MT & temp)
+{
+ return SVDJacobi(u,d,v);
+}
+
+/// SVD for 3x3 matrices, using SVDJacobi. temp is not used.
+template <typename T,typename MT>
+inline bit SVD(Mat<3,3,T> & u,Vect<3,T> & d,Mat<3,3,T> & v,MT & temp)
+{
+ return SVDJacobi(u,d,v);
+}
+
+/// SVD for 4x4 matrices, using SVDJacobi. temp is not used.
+template <typename T,typename MT>
+inline bit SVD(Mat<4,4,T> & u,Vect<4,T> & d,Mat<4,4,T> & v,MT & temp)
+{
+ return SVDJacobi(u,d,v);
+}
+
 //------------------------------------------------------------------------------
 /// Pseudo Inverse, this will invert all matrices, even non-square and singular
 /// once, uses SVD to accheive this goal.
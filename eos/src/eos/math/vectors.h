@@ -27,6 +27,7 @@
 #include "eos/typestring.h"
 #include "eos/math/functions.h"
 #include "eos/io/inout.h"
+#include "eos/math/expressions.h"
 
 namespace eos
 {
@@ -37,8 +38,10 @@ namespace eos
 /// Provides only the most basic of operations as all the real operations are 
 /// implimented independently of the Vector class, only requiring it to follow
 /// the standard that both vector classes provided adhere to.
+/// The arithmetic operators, +, -, * by a scalar etc., are in expressions.h,
+/// and avoid temporaries by only evaluating when assigned to a Vect.
 template <nat32 S, typename T = real32>
-class EOS_CLASS Vect
+class EOS_CLASS Vect : public VectExpr<S,T,Vect<S,T> >
 {
  public:
   /// The data item type, so it can be used by templated code.
@@ -56,6 +59,10 @@ class EOS_CLASS Vect
    
   /// &nbsp;
    Vect(const Vect<S,T> & rhs) {for(nat32 i=0;i<S;i++) d[i] = rhs.d[i];}
+
+  /// Evaluates an expression, such as a + b*s.
+   template <typename E>
+   Vect(const VectExpr<S,T,E> & rhs) {const E & e = rhs.Self(); for(nat32 i=0;i<S;i++) d[i] = e[i];}
    
   /// &nbsp;
    ~Vect() {}
@@ -67,6 +74,12 @@ class EOS_CLASS Vect
   /// &nbsp;
    template <typename T2>
    Vect<S,T2> & operator = (const Vect<S,T2> & rhs) {for(nat32 i=0;i<S;i++) d[i] = rhs[i]; return *this;}  
+
+  /// Evaluates an expression in a single loop. Each element only depends on
+  /// the same element of the inputs, or on a product evaluated in advance, so
+  /// the likes of a = b - a*s are safe.
+   template <typename E>
+   Vect<S,T> & operator = (const VectExpr<S,T,E> & rhs) {const E & e = rhs.Self(); for(nat32 i=0;i<S;i++) d[i] = e[i]; return *this;}
    
   /// &nbsp;
    template <typename T2>
@@ -109,6 +122,14 @@ class EOS_CLASS Vect
    
   /// &nbsp;
    Vect<S,T> & operator -= (const Vect<S,T> & rhs) {for(nat32 i=0;i<S;i++) d[i] -= rhs.d[i]; return *this;}
+
+  /// &nbsp;
+   template <typename E>
+   Vect<S,T> & operator += (const VectExpr<S,T,E> & rhs) {const E & e = rhs.Self(); for(nat32 i=0;i<S;i++) d[i] += e[i]; return *this;}
+
+  /// &nbsp;
+   template <typename E>
+   Vect<S,T> & operator -= (const VectExpr<S,T,E> & rhs) {const E & e = rhs.Self(); for(nat32 i=0;i<S;i++) d[i] -= e[i]; return *this;}
   
   
   /// Negates all entrys in the vector. 
@@ -117,6 +138,14 @@ class EOS_CLASS Vect
   /// Returns the dot product, a scalar.
    T operator* (const Vect<S,T> & rhs) const {T ret = 0; for(nat32 i=0;i<S;i++) ret += d[i]*rhs.d[i]; return ret;}
 
+  /// Returns the dot product with an expression.
+   template <typename E>
+   T operator* (const VectExpr<S,T,E> & rhs) const {const E & e = rhs.Self(); T ret = 0; for(nat32 i=0;i<S;i++) ret += d[i]*e[i]; return ret;}
+
+  /// Returns the vector scaled, as an expression. Without this the implicit
+  /// constructor from T would make v*s a dot product.
+   VectScale<S,T,Vect<S,T> > operator* (const T & rhs) const {return VectScale<S,T,Vect<S,T> >(*this,rhs);}
+
    
   /// Returns the length of the vector, squared.
    T LengthSqr() const {T ret = 0.0; for(nat32 i=0;i<S;i++) ret += math::Sqr(d[i]); return ret;}
@@ -249,6 +278,10 @@ class EOS_CLASS Vector
    
   /// Leaves the contents in a random state.
    void SetSize(nat32 ns) {if (ns!=size) {size = ns; delete[] data; data = new T[size];}}
+
+  /// Exchanges the contents of two vectors in constant time, without copying.
+  /// Assignment copies every element, so this is how to move a vector.
+   void Swap(Vector<T> & rhs) {nat32 ts = size; size = rhs.size; rhs.size = ts; T * td = data; data = rhs.data; rhs.data = td;}
  
   /// &nbsp;
    T & operator [] (nat32 i) {return data[i];}
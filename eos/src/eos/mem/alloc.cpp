@@ -17,21 +17,351 @@
 
 #include "eos/mem/alloc.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef EOS_WIN32
+ #include <unistd.h>
+ #include <sys/syscall.h>
+#endif
+
 namespace eos
 {
  namespace mem
  {
 //------------------------------------------------------------------------------
-EOS_FUNC void * EOS_STDCALL BasicMalloc(nat32 size)
+// The tracking state. Everything here uses ::malloc directly, as it gets
+// called from within BasicMalloc. The pointers are left to static zero
+// initialisation, as allocations can happen from other static constructors
+// before this files would run...
+static volatile bit tracking = false;
+
+static volatile int64 procCurrent = 0;
+static volatile int64 procPeak = 0;
+
+static MemThread * volatile memFirst; // Most recent first.
+static volatile nat32 memThreads = 0;
+static __thread MemThread * memThis;
+
+static volatile int32 tagLock = 0; // Spin lock for the below.
+static nat32 tagCount = 0;
+static nat32 tagSize = 0;
+static MemTagStats * tagTable;
+
+// Returns the size of a block as the allocator sees it...
+static inline nat64 UsableSize(void * ptr)
 {
- return ::malloc(size);
+ #ifdef EOS_WIN32
+  return ::_msize(ptr);
+ #else
+  return ::malloc_usable_size(ptr);
+ #endif
+}
+
+// Raises a peak to the given value if its below it, safe against other
+// threads doing the same...
+static inline void RaisePeak(volatile int64 & peak,int64 now)
+{
+ int64 old = peak;
+ while ((now>old)&&(!__sync_bool_compare_and_swap(&peak,old,now))) old = peak;
+}
+
+//------------------------------------------------------------------------------
+struct MemThread
+{
+ MemStats stats;
+ MemScope * scope; // Innermost open scope, null if none.
+ nat32 index;
+ MemThread * next;
+
+ // Returns the calling threads record, creating it if need be. Returns null
+ // if out of memory...
+  static MemThread * Get()
+  {
+   if (memThis==null<MemThread*>())
+   {
+    MemThread * t = static_cast<MemThread*>(::calloc(1,sizeof(MemThread)));
+    if (t==null<MemThread*>()) return t;
+    t->index = __sync_fetch_and_add(&memThreads,1);
+    do
+    {
+     t->next = memFirst;
+    } while (!__sync_bool_compare_and_swap(&memFirst,t->next,t));
+    memThis = t;
+   }
+   return memThis;
+  }
+
+ // Returns the record of the thread with the given index, null if none...
+  static MemThread * Find(nat32 index)
+  {
+   MemThread * targ = memFirst;
+   while ((targ!=null<MemThread*>())&&(targ->index!=index)) targ = targ->next;
+   return targ;
+  }
+
+ static void Alloc(void * ptr)
+ {
+  if (ptr==null<void*>()) return;
+  MemThread * self = Get();
+  if (self==null<MemThread*>()) return;
+  nat64 size = UsableSize(ptr);
+
+  MemStats & st = self->stats;
+  st.allocs += 1;
+  st.bytes += size;
+  st.current += int64(size);
+  if (st.current>st.peak) st.peak = st.current;
+
+  for (MemScope * targ=self->scope;targ;targ=targ->parent)
+  {
+   targ->allocs += 1;
+   targ->bytes += size;
+   if (st.current-targ->base>targ->peak) targ->peak = st.current - targ->base;
+  }
+
+  RaisePeak(procPeak,__sync_add_and_fetch(&procCurrent,int64(size)));
+ }
+
+ static void Free(void * ptr)
+ {
+  MemThread * self = Get();
+  if (self==null<MemThread*>()) return;
+  nat64 size = UsableSize(ptr);
+
+  self->stats.frees += 1;
+  self->stats.current -= int64(size);
+
+  __sync_sub_and_fetch(&procCurrent,int64(size));
+ }
+
+ // Adds the totals of a scope to the tag table...
+  static void Merge(const MemScope & scope)
+  {
+   while (__sync_lock_test_and_set(&tagLock,1)) {}
+    nat32 i = 0;
+    while ((i<tagCount)&&(tagTable[i].tag!=scope.tag)&&(strcmp(tagTable[i].tag,scope.tag)!=0)) ++i;
+    if (i==tagCount)
+    {
+     if (tagCount==tagSize)
+     {
+      nat32 ns = (tagSize==0)?16:(tagSize*2);
+      MemTagStats * nt = static_cast<MemTagStats*>(::realloc(tagTable,ns*sizeof(MemTagStats)));
+      if (nt==null<MemTagStats*>()) {__sync_lock_release(&tagLock); return;}
+      tagTable = nt;
+      tagSize = ns;
+     }
+     tagTable[i].tag = scope.tag;
+     tagTable[i].scopes = 0;
+     tagTable[i].allocs = 0;
+     tagTable[i].bytes = 0;
+     tagTable[i].peak = 0;
+     ++tagCount;
+    }
+
+    MemTagStats & targ = tagTable[i];
+    targ.scopes += 1;
+    targ.allocs += scope.allocs;
+    targ.bytes += scope.bytes;
+    if (scope.peak>targ.peak) targ.peak = scope.peak;
+   __sync_lock_release(&tagLock);
+  }
+};
+
+//------------------------------------------------------------------------------
+EOS_FUNC void * EOS_STDCALL BasicMalloc(nat64 size)
+{
+ #ifdef EOS_32BIT
+  if (size>nat64(0xFFFFFFFF)) return null<void*>();
+ #endif
+ void * ret = ::malloc(size_t(size));
+ if (tracking) MemThread::Alloc(ret);
+ return ret;
 }
 
 EOS_FUNC void EOS_STDCALL BasicFree(void * ptr)
 {
+ if (tracking&&ptr) MemThread::Free(ptr);
  ::free(ptr);
 }
 
+EOS_FUNC void * EOS_STDCALL BasicAlignedMalloc(nat64 size,nat32 align)
+{
+ #ifdef EOS_32BIT
+  if (size>nat64(0xFFFFFFFF)) return null<void*>();
+ #endif
+ if (align<sizeof(void*)) align = sizeof(void*);
+ #ifdef EOS_WIN32
+  return ::_aligned_malloc(size_t(size),align);
+ #else
+  void * ret;
+  if (::posix_memalign(&ret,align,size_t(size))!=0) return null<void*>();
+  if (tracking) MemThread::Alloc(ret);
+  return ret;
+ #endif
+}
+
+EOS_FUNC void EOS_STDCALL BasicAlignedFree(void * ptr)
+{
+ #ifdef EOS_WIN32
+  ::_aligned_free(ptr);
+ #else
+  if (tracking&&ptr) MemThread::Free(ptr);
+  ::free(ptr);
+ #endif
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC bit Place(void * ptr,nat64 size,NumaPolicy policy,nat32 node)
+{
+ #ifdef EOS_WIN32
+  return false;
+ #else
+  // Straight to the system call, to avoid a dependency on libnuma. Modes are
+  // from linux/mempolicy.h; the kernel limits the node mask to the nodes
+  // that exist, so interleave can simply give all of them...
+   static const int mpolDefault = 0;
+   static const int mpolBind = 2;
+   static const int mpolInterleave = 3;
+   static const nat32 maxNodes = 64;
+
+   nat64 page = nat64(sysconf(_SC_PAGESIZE));
+   nat64 start = (nat64(ptr) + page - 1) & ~(page-1);
+   nat64 end = (nat64(ptr) + size) & ~(page-1);
+   if (end<=start) return true;
+
+   static const nat32 bits = sizeof(unsigned long)*8;
+   unsigned long mask[maxNodes/bits];
+   for (nat32 i=0;i<maxNodes/bits;i++) mask[i] = 0;
+
+   int mode = mpolDefault;
+   switch (policy)
+   {
+    case numa_first_touch: break;
+    case numa_interleave:
+     mode = mpolInterleave;
+     for (nat32 i=0;i<maxNodes/bits;i++) mask[i] = ~0UL;
+    break;
+    case numa_bind:
+     if (node>=maxNodes) return false;
+     mode = mpolBind;
+     mask[node/bits] = 1UL<<(node%bits);
+    break;
+   }
+
+   #ifdef SYS_mbind
+    return syscall(SYS_mbind,(void*)start,(unsigned long)(end-start),mode,
+                   (mode==mpolDefault)?null<unsigned long*>():mask,
+                   (mode==mpolDefault)?0UL:(unsigned long)(maxNodes+1),0U)==0;
+   #else
+    return false;
+   #endif
+ #endif
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC void TrackMemory(bit on)
+{
+ tracking = on;
+}
+
+EOS_FUNC bit TrackingMemory()
+{
+ return tracking;
+}
+
+EOS_FUNC void GetMemStats(MemStats & out)
+{
+ out.current = __sync_add_and_fetch(&procCurrent,0);
+ out.peak = __sync_add_and_fetch(&procPeak,0);
+ out.allocs = 0;
+ out.frees = 0;
+ out.bytes = 0;
+
+ for (MemThread * targ=memFirst;targ;targ=targ->next)
+ {
+  out.allocs += targ->stats.allocs;
+  out.frees += targ->stats.frees;
+  out.bytes += targ->stats.bytes;
+ }
+}
+
+EOS_FUNC void GetThreadMemStats(MemStats & out)
+{
+ MemThread * self = memThis;
+ if (self) out = self->stats;
+ else
+ {
+  out.current = 0;
+  out.peak = 0;
+  out.allocs = 0;
+  out.frees = 0;
+  out.bytes = 0;
+ }
+}
+
+EOS_FUNC nat32 MemThreads()
+{
+ return memThreads;
+}
+
+EOS_FUNC void GetMemStats(nat32 thread,MemStats & out)
+{
+ MemThread * targ = MemThread::Find(thread);
+ if (targ) out = targ->stats;
+ else
+ {
+  out.current = 0;
+  out.peak = 0;
+  out.allocs = 0;
+  out.frees = 0;
+  out.bytes = 0;
+ }
+}
+
+EOS_FUNC void ResetMemPeak()
+{
+ int64 old = procPeak;
+ while (!__sync_bool_compare_and_swap(&procPeak,old,procCurrent)) old = procPeak;
+
+ for (MemThread * targ=memFirst;targ;targ=targ->next) targ->stats.peak = targ->stats.current;
+}
+
+EOS_FUNC nat32 MemTags()
+{
+ while (__sync_lock_test_and_set(&tagLock,1)) {}
+  nat32 ret = tagCount;
+ __sync_lock_release(&tagLock);
+ return ret;
+}
+
+EOS_FUNC void GetMemTag(nat32 i,MemTagStats & out)
+{
+ while (__sync_lock_test_and_set(&tagLock,1)) {}
+  out = tagTable[i];
+ __sync_lock_release(&tagLock);
+}
+
+//------------------------------------------------------------------------------
+MemScope::MemScope(cstrconst t)
+:tag(t),thread(null<MemThread*>()),parent(null<MemScope*>()),base(0),peak(0),allocs(0),bytes(0)
+{
+ if (!tracking) return;
+ thread = MemThread::Get();
+ if (thread==null<MemThread*>()) return;
+
+ parent = thread->scope;
+ base = thread->stats.current;
+ thread->scope = this;
+}
+
+MemScope::~MemScope()
+{
+ if (thread==null<MemThread*>()) return;
+ thread->scope = parent;
+ MemThread::Merge(*this);
+}
+
 //------------------------------------------------------------------------------
  };
 };
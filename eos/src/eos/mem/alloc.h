@@ -42,9 +42,12 @@ namespace eos
 // to be exported from the class because if inline they could use the 
 // malloc/free of another executable unit...
 
-EOS_FUNC void * EOS_STDCALL BasicMalloc(nat32 size);
+EOS_FUNC void * EOS_STDCALL BasicMalloc(nat64 size);
 EOS_FUNC void EOS_STDCALL BasicFree(void * ptr);
 
+EOS_FUNC void * EOS_STDCALL BasicAlignedMalloc(nat64 size,nat32 align);
+EOS_FUNC void EOS_STDCALL BasicAlignedFree(void * ptr);
+
 //------------------------------------------------------------------------------
 // Then we need a set of inline templated, and inturn typed, equivalents, with
 // more typical names...
@@ -56,7 +59,7 @@ EOS_FUNC void EOS_STDCALL BasicFree(void * ptr);
 /// <code>n==1</code>. This stricter typing is generally useful for catching 
 /// certain bugs, and prevents a certain kind of bastardisation.
 template <typename T>
-inline T * Malloc(int32 n = 1)
+inline T * Malloc(nat64 n = 1)
 {
  return static_cast<T*>(BasicMalloc(sizeof(T)*n));
 }
@@ -70,6 +73,148 @@ inline void Free(T * ptr)
  BasicFree(ptr);
 }
 
+/// A typed malloc that returns memory aligned to the given number of bytes, 
+/// which must be a power of two. The default of 64 is a cache line, and enough
+/// for aligned SSE/AVX loads. Memory from this must be freed with AlignedFree, 
+/// not Free, as on some platforms they are not compatable.
+template <typename T>
+inline T * AlignedMalloc(nat64 n = 1,nat32 align = 64)
+{
+ return static_cast<T*>(BasicAlignedMalloc(sizeof(T)*n,align));
+}
+
+/// Frees memory obtained from AlignedMalloc.
+template <typename T>
+inline void AlignedFree(T * ptr)
+{
+ BasicAlignedFree(ptr);
+}
+
+//------------------------------------------------------------------------------
+// Placement of large blocks on NUMA machines...
+
+/// How the pages of a block are spread over the nodes of a NUMA machine, see
+/// Place().
+enum NumaPolicy {numa_first_touch, ///< The OS default, each page goes on the node of the thread that first writes to it.
+                 numa_interleave, ///< Pages go round robin over all nodes, for data every thread reads.
+                 numa_bind ///< All pages go on the given node.
+                };
+
+/// Sets the placement policy of a block, which should not have been written
+/// to yet, as pages allready touched have allready been placed. Only whole
+/// pages inside the block are affected. Returns false if the OS can't do
+/// this, which is the case on windows, where it is left to first touch.
+/// Setting numa_first_touch is only useful to undo a previous call.
+EOS_FUNC bit Place(void * ptr,nat64 size,NumaPolicy policy,nat32 node = 0);
+
+//------------------------------------------------------------------------------
+// Optional tracking of how much memory is in use, by thread and by tagged
+// scope, for finding out how much a job needs before it gets run somewhere it
+// won't fit...
+
+/// Switches allocation tracking on or off, it starts off, in which case the
+/// only cost is a test in BasicMalloc/BasicFree. Sizes are as reported by the
+/// allocator, so include its rounding up. Memory allocated before tracking is
+/// switched on but freed after gets subtracted, and vice versa, so it is best
+/// switched on once at the start of main. Memory from AlignedMalloc is not
+/// tracked under windows.
+EOS_FUNC void TrackMemory(bit on = true);
+
+/// Returns true if allocations are being tracked.
+EOS_FUNC bit TrackingMemory();
+
+/// Memory statistics, for the process or for a single thread.
+struct EOS_CLASS MemStats
+{
+ int64 current; ///< Bytes allocated minus bytes freed. Can be negative for a thread, as memory is not always freed by the thread that allocated it.
+ int64 peak; ///< The highest current has been since tracking started or the last ResetMemPeak().
+ nat64 allocs; ///< Number of allocations.
+ nat64 frees; ///< Number of frees.
+ nat64 bytes; ///< Total bytes allocated, ignoring frees.
+
+ /// &nbsp;
+  static inline cstrconst TypeString() {return "eos::mem::MemStats";}
+};
+
+/// Fills in the statistics for the whole process. The current and peak
+/// figures are exact, the counts are summed from the threads so may be
+/// slightly behind if other threads are busy.
+EOS_FUNC void GetMemStats(MemStats & out);
+
+/// Fills in the statistics of the calling thread.
+EOS_FUNC void GetThreadMemStats(MemStats & out);
+
+/// Returns how many threads have allocated memory whilst being tracked,
+/// including ones that have since exited.
+EOS_FUNC nat32 MemThreads();
+
+/// Fills in the statistics of a thread, indexed from 0 to MemThreads()-1 in
+/// the order they started being tracked.
+EOS_FUNC void GetMemStats(nat32 thread,MemStats & out);
+
+/// Sets the peaks, of the process and of every thread, to the current values,
+/// so the peak of a single job can be measured. Should be called when the
+/// other threads are idle.
+EOS_FUNC void ResetMemPeak();
+
+
+/// Statistics for all the MemScope of a given tag.
+struct EOS_CLASS MemTagStats
+{
+ cstrconst tag; ///< As given to MemScope.
+ nat64 scopes; ///< How many scopes with this tag have ended.
+ nat64 allocs; ///< Allocations made inside the scopes, including nested scopes.
+ nat64 bytes; ///< Total bytes allocated inside the scopes.
+ int64 peak; ///< The largest amount the threads current usage grew by during a single scope, i.e. how much memory the scope needed.
+
+ /// &nbsp;
+  static inline cstrconst TypeString() {return "eos::mem::MemTagStats";}
+};
+
+/// Returns how many distinct tags have had a MemScope end whilst tracking.
+EOS_FUNC nat32 MemTags();
+
+/// Fills in the statistics of a tag, indexed from 0 to MemTags()-1 in the
+/// order they were first seen.
+EOS_FUNC void GetMemTag(nat32 i,MemTagStats & out);
+
+
+// The per-thread tracking data, defined in the .cpp...
+struct MemThread;
+
+/// Charges all allocations made by the constructing thread during its
+/// lifetime to the given tag, such as "DSI" or "BP messages". Scopes nest,
+/// with allocations charged to every enclosing scope. Intended to be a local
+/// variable, it must be destroyed by the thread that created it. If tracking
+/// is off when it is constructed it does nothing. The tag must be a compile
+/// time constant string.
+class EOS_CLASS MemScope
+{
+ public:
+  /// &nbsp;
+   MemScope(cstrconst tag);
+
+  /// &nbsp;
+   ~MemScope();
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::mem::MemScope";}
+
+
+ private:
+  friend struct MemThread;
+
+  cstrconst tag;
+  MemThread * thread; // null if not tracking.
+  MemScope * parent;
+
+  int64 base; // Current usage of the thread when constructed.
+  int64 peak;
+  nat64 allocs;
+  nat64 bytes;
+};
+
 //------------------------------------------------------------------------------
  };
 };
@@ -51,14 +51,14 @@ inline void NotNull(T * data,nat32 num = 1)
 /// the data overlaps. num defines how many complete objects to copy, and 
 /// defaults to 1, i.e. sizeof(T)*num bytes are shifted.
 template <typename T>
-inline void Copy(T * to,const T * from,nat32 num = 1)
+inline void Copy(T * to,const T * from,nat64 num = 1)
 {
  ::memcpy(to,from,sizeof(T)*num);
 }
 
 /// Identical to Copy, except it handles overlaping data blocks correctly.
 template <typename T>
-inline void Move(T * to,const T * from,nat32 num = 1)
+inline void Move(T * to,const T * from,nat64 num = 1)
 {
  ::memmove(to,from,sizeof(T)*num);
 }
@@ -17,13 +17,15 @@
 
 #include "eos/mem/packer.h"
 
+#include "eos/log/profile.h"
+
 namespace eos
 {
  namespace mem
  {
 //------------------------------------------------------------------------------
 Packer::Packer(nat32 bs)
-:blockSize(bs),top(null<byte*>()),offset(bs)
+:blockSize(bs),top(null<byte*>()),offset(bs),spare(null<byte*>())
 {}
 
 Packer::~Packer()
@@ -39,12 +41,31 @@ void Packer::Reset()
   top = *(byte**)(void*)victim;
   mem::Free(victim);
  }
+ while (spare)
+ {
+  byte * victim = spare;
+  spare = *(byte**)(void*)victim;
+  mem::Free(victim);
+ }
+ offset = blockSize;
+}
+
+void Packer::Rewind()
+{
+ while (top)
+ {
+  byte * targ = top;
+  top = *(byte**)(void*)targ;
+  *(byte**)(void*)targ = spare;
+  spare = targ;
+ }
  offset = blockSize;
 }
 
 void * Packer::NewBlock(nat32 size)
 {
  log::Assert(size<(blockSize-sizeof(byte*)));
+ LogCount("eos::mem::Packer alloc",1);
  if (offset+size<=blockSize)
  {
   void * ret = top+offset;
@@ -53,7 +74,14 @@ void * Packer::NewBlock(nat32 size)
  }
  else
  {
-  byte * newTop = mem::Malloc<byte>(blockSize);
+  LogCount("eos::mem::Packer block",1);
+  byte * newTop;
+  if (spare)
+  {
+   newTop = spare;
+   spare = *(byte**)(void*)spare;
+  }
+  else newTop = mem::Malloc<byte>(blockSize);
   *((byte**)(void*)newTop) = top;
   top = newTop;
   offset = sizeof(byte*) + size;
@@ -61,6 +89,96 @@ void * Packer::NewBlock(nat32 size)
  }
 }
 
+//------------------------------------------------------------------------------
+NodePool::NodePool(Packer * p)
+:packer(p),slab(null<byte*>()),slabNodes(0),next(null<byte*>()),left(0),spare(null<void*>())
+{}
+
+NodePool::~NodePool()
+{
+ Release();
+}
+
+void NodePool::Release()
+{
+ while (slab)
+ {
+  byte * victim = slab;
+  slab = *(byte**)(void*)victim;
+  mem::Free(victim);
+ }
+ slabNodes = 0;
+ next = null<byte*>();
+ left = 0;
+ spare = null<void*>();
+}
+
+void NodePool::Swap(NodePool & rhs)
+{
+ Packer * tp = packer; packer = rhs.packer; rhs.packer = tp;
+ byte * ts = slab; slab = rhs.slab; rhs.slab = ts;
+ nat32 tsn = slabNodes; slabNodes = rhs.slabNodes; rhs.slabNodes = tsn;
+ byte * tn = next; next = rhs.next; rhs.next = tn;
+ nat32 tl = left; left = rhs.left; rhs.left = tl;
+ void * tsp = spare; spare = rhs.spare; rhs.spare = tsp;
+}
+
+void * NodePool::NewNode(nat32 size)
+{
+ // Keep nodes aligned for whatever data follows the containers own pointers...
+  size = (size + sizeof(real64) - 1) & ~nat32(sizeof(real64) - 1);
+  if (packer) return packer->Malloc<byte>(size);
+
+ // Start a new slab when the current one runs out...
+  if (left==0)
+  {
+   slabNodes = (slabNodes==0)?16:slabNodes*2;
+   if (slabNodes>maxSlabNodes) slabNodes = maxSlabNodes;
+
+   byte * ns = mem::Malloc<byte>(sizeof(real64) + slabNodes*size);
+   *(byte**)(void*)ns = slab;
+   slab = ns;
+   next = ns + sizeof(real64);
+   left = slabNodes;
+  }
+
+ void * ret = next;
+ next += size;
+ --left;
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+ThreadPacker::ThreadPacker(nat32 bs)
+:blockSize(bs),first(null<Node*>())
+{}
+
+ThreadPacker::~ThreadPacker()
+{
+ while (first)
+ {
+  Node * victim = first;
+  first = first->next;
+  delete victim;
+ }
+}
+
+void ThreadPacker::Reset()
+{
+ for (Node * targ = first;targ;targ = targ->next) targ->packer.Reset();
+}
+
+ThreadPacker::Node * ThreadPacker::NewLocal()
+{
+ Node * ret = new Node(blockSize);
+ lock.Lock();
+  ret->next = first;
+  first = ret;
+ lock.Unlock();
+ slot.Set(ret);
+ return ret;
+}
+
 //------------------------------------------------------------------------------
  };
 };
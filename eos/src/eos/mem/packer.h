@@ -22,9 +22,12 @@
 /// Abstracts the idea of declaring a single memory block and then splitting it
 /// up for many tasks. When that block is used up a new block is allocated and 
 /// it continues. Frees all memory only when the object is destroyed - there is
-/// no free method. Ideal for a certain class of heavy-weight algorithm.
+/// no free method. Ideal for a certain class of heavy-weight algorithm. Also
+/// provides a pool of same sized nodes for the node based containers.
 
 #include "eos/types.h"
+#include "eos/mt/threads.h"
+#include "eos/mt/locks.h"
 
 namespace eos
 {
@@ -54,6 +57,10 @@ class EOS_CLASS Packer
   /// Resets it, freeing all memory and preparing it to start again.
    void Reset();
 
+  /// Resets it, but keeps the blocks it has allocated to be handed out again
+  /// rather than freeing them, for when its about to be filled up again.
+   void Rewind();
+
 
   /// Returns a new memory block, num is the number wanted.
    template <typename T>
@@ -89,10 +96,129 @@ class EOS_CLASS Packer
   nat32 blockSize;
   byte * top; // First 4 bytes of each block are eatten by pointer to previous block. For destruction.
   nat32 offset;
+  byte * spare; // Blocks kept by Rewind, linked in the same way.
   
   void * NewBlock(nat32 size);
 };
 
+//------------------------------------------------------------------------------
+/// A pool of same sized nodes, for the node based containers. Nodes are carved
+/// out of slabs that double in size as the pool grows, and freed nodes go on a
+/// free list to be handed out again, so building and destroying a big container
+/// costs a handful of mallocs rather than one per node. Alternatively the nodes
+/// can come from a Packer, which may be shared by many pools so they all go
+/// when it is reset - freed nodes are still reused. Not thread safe.
+class EOS_CLASS NodePool
+{
+ public:
+  /// If given a Packer the nodes come from it, and it must outlive the nodes.
+   NodePool(Packer * packer = null<Packer*>());
+
+  /// Releases all memory, so every node must be dead.
+   ~NodePool();
+
+
+  /// Returns a node of the given size. Every call must ask for the same size,
+  /// until Release is called.
+   void * Alloc(nat32 size)
+   {
+    if (spare)
+    {
+     void * ret = spare;
+     spare = *(void**)spare;
+     return ret;
+    }
+    return NewNode(size);
+   }
+
+  /// Returns a node to the pool, to be handed out by a later Alloc.
+   void Free(void * ptr)
+   {
+    *(void**)ptr = spare;
+    spare = ptr;
+   }
+
+  /// Releases all the slabs, so is only safe when every node is dead. Nodes
+  /// from a Packer are simply forgotten.
+   void Release();
+
+  /// Changes the Packer used, null to go back to its own slabs. Calls Release.
+   void SetPacker(Packer * p) {Release(); packer = p;}
+
+  /// Returns the Packer in use, null if its own slabs are.
+   Packer * GetPacker() const {return packer;}
+
+  /// Swaps the contents of two pools, including the Packers used, for when
+  /// the nodes move to another container.
+   void Swap(NodePool & rhs);
+
+
+ private:
+  static const nat32 maxSlabNodes = 4096;
+
+  Packer * packer;
+  byte * slab; // First pointer of each slab links to the previous slab, as with Packer.
+  nat32 slabNodes; // How many nodes the last slab was made for.
+  byte * next; // Next free node in the current slab.
+  nat32 left; // How many nodes are left in the current slab.
+  void * spare; // Free list of returned nodes, linked via there first pointer.
+
+  void * NewNode(nat32 size);
+};
+
+//------------------------------------------------------------------------------
+/// A thread safe version of Packer, which simply keeps a seperate Packer for
+/// each thread that uses it, so there is no locking when allocating. All the
+/// memory belongs to this object, so its fine for whatever thread to use the
+/// memory after allocation, its only freed by Reset() or deletion. Mal/Loc are
+/// not provided.
+class EOS_CLASS ThreadPacker
+{
+ public:
+  /// Sets the size of each new block, for every thread.
+   ThreadPacker(nat32 blockSize);
+
+  /// &nbsp;
+   ~ThreadPacker();
+
+  /// Resets it, freeing all memory and preparing it to start again. No other
+  /// thread may be using this object when this is called.
+   void Reset();
+
+
+  /// Returns a new memory block, num is the number wanted. The block comes
+  /// from the calling threads own Packer.
+   template <typename T>
+   T * Malloc(nat32 num = 1)
+   {
+    return Local().Malloc<T>(num);
+   }
+
+
+ private:
+  struct Node
+  {
+   Node * next;
+   Packer packer;
+
+   Node(nat32 blockSize):packer(blockSize) {}
+  };
+
+  nat32 blockSize;
+  mt::ThreadSlot slot; // Node of the current thread.
+  mt::OwnedLock lock; // Protects the below, which only changes when a new thread turns up.
+  Node * first;
+
+  Packer & Local()
+  {
+   Node * ret = (Node*)slot.Get();
+   if (ret==null<Node*>()) ret = NewLocal();
+   return ret->packer;
+  }
+
+  Node * NewLocal();
+};
+
 //------------------------------------------------------------------------------
  };
 };
@@ -22,11 +22,140 @@ namespace eos
  namespace mem
  {
 //------------------------------------------------------------------------------
+// A threads stack of blocks. The free list is only touched by the owning
+// thread, the remote list by everybody else...
+struct ThreadAllocCode::Heap
+{
+ Heap * next; // In the list of all heaps.
+ mt::Atomic owned; // 1 if a thread is using it, 0 if its up for grabs.
+
+ byte * free; // Stack of free blocks, linked via the first pointer after the header.
+ byte * volatile remote; // Stack of blocks freed by other threads.
+ byte * chunks; // Linked list of the big blocks that the blocks come from, via their first pointer.
+};
+
+//------------------------------------------------------------------------------
+ThreadAllocCode::ThreadAllocCode(nat32 bs,nat32 bc)
+:blockSize(sizeof(Header) + ((bs<sizeof(byte*))?sizeof(byte*):bs)),blockCount(bc),
+slot(Orphan),heaps(null<Heap*>())
+{
+ blockSize = (blockSize+7)&~nat32(7);
+}
+
+ThreadAllocCode::~ThreadAllocCode()
+{
+ while (heaps)
+ {
+  Heap * victim = heaps;
+  heaps = heaps->next;
+
+  while (victim->chunks)
+  {
+   byte * chunk = victim->chunks;
+   victim->chunks = *(byte**)(void*)chunk;
+   mem::Free(chunk);
+  }
+  delete victim;
+ }
+}
+
+void * ThreadAllocCode::Malloc()
+{
+ Heap * heap = Local();
+
+ // If the free list is empty try grabbing everything that has been given back
+ // by other threads, if that fails get a new chunk...
+  if (heap->free==null<byte*>())
+  {
+   heap->free = (byte*)__sync_lock_test_and_set((void**)&heap->remote,null<void*>());
+   if (heap->free==null<byte*>())
+   {
+    byte * chunk = mem::Malloc<byte>(sizeof(Header) + blockSize*blockCount);
+    *(byte**)(void*)chunk = heap->chunks;
+    heap->chunks = chunk;
+
+    byte * block = chunk + sizeof(Header);
+    for (nat32 i=0;i<blockCount;i++)
+    {
+     ((Header*)(void*)block)->heap = heap;
+     *(byte**)(void*)(block+sizeof(Header)) = (i+1<blockCount)?(block+blockSize):null<byte*>();
+     block += blockSize;
+    }
+    heap->free = chunk + sizeof(Header);
+   }
+  }
 
-EOS_VAR_DEF PreAlloc<8,pre8_size> pre8;
-EOS_VAR_DEF PreAlloc<16,pre16_size> pre16;
-EOS_VAR_DEF PreAlloc<32,pre32_size> pre32;
-EOS_VAR_DEF PreAlloc<64,pre64_size> pre64;
+ // Pop the top block...
+  byte * ret = heap->free;
+  heap->free = *(byte**)(void*)(ret+sizeof(Header));
+  return ret + sizeof(Header);
+}
+
+void ThreadAllocCode::Free(void * ptr)
+{
+ if (ptr==null<void*>()) return;
+ byte * block = (byte*)ptr - sizeof(Header);
+ Heap * heap = ((Header*)(void*)block)->heap;
+
+ if (heap==(Heap*)slot.Get())
+ {
+  *(byte**)ptr = heap->free;
+  heap->free = block;
+ }
+ else
+ {
+  // Not ours - push it onto the owners remote list. Only ever pushed to, or
+  // emptied in one go, so no ABA problem...
+   while (true)
+   {
+    byte * top = heap->remote;
+    *(byte**)ptr = top;
+    if (__sync_bool_compare_and_swap(&heap->remote,top,block)) break;
+   }
+ }
+}
+
+ThreadAllocCode::Heap * ThreadAllocCode::Local()
+{
+ Heap * ret = (Heap*)slot.Get();
+ if (ret) return ret;
+
+ // Try and adopt a heap left behind by a thread that has exited...
+  for (Heap * targ = heaps;targ;targ = targ->next)
+  {
+   if (targ->owned.CompareSwap(0,1))
+   {
+    slot.Set(targ);
+    return targ;
+   }
+  }
+
+ // Make a new one...
+  ret = new Heap();
+  ret->owned.Set(1);
+  ret->free = null<byte*>();
+  ret->remote = null<byte*>();
+  ret->chunks = null<byte*>();
+  while (true)
+  {
+   ret->next = heaps;
+   if (__sync_bool_compare_and_swap(&heaps,ret->next,ret)) break;
+  }
+
+ slot.Set(ret);
+ return ret;
+}
+
+void ThreadAllocCode::Orphan(void * heap)
+{
+ ((Heap*)heap)->owned.Set(0);
+}
+
+//------------------------------------------------------------------------------
+EOS_VAR_DEF ThreadAlloc<8,pre8_size> pre8;
+EOS_VAR_DEF ThreadAlloc<16,pre16_size> pre16;
+EOS_VAR_DEF ThreadAlloc<32,pre32_size> pre32;
+EOS_VAR_DEF ThreadAlloc<64,pre64_size> pre64;
 
 //------------------------------------------------------------------------------
  };
@@ -26,6 +26,8 @@
 
 #include "eos/types.h"
 #include "eos/mem/alloc.h"
+#include "eos/mt/threads.h"
+#include "eos/mt/locks.h"
 
 namespace eos
 {
@@ -115,29 +117,104 @@ class EOS_CLASS PreAlloc
 };
 
 //------------------------------------------------------------------------------
-/// Size of the 8 byte system wide memory allocator.
-static const nat32 pre8_size = 128*1024;
+// Code for below.
+class EOS_CLASS ThreadAllocCode
+{
+ protected:
+   ThreadAllocCode(nat32 blockSize,nat32 blockCount);
+  ~ThreadAllocCode();
+
+  void * Malloc();
+  void Free(void * ptr);
+
+
+ private:
+  struct Heap;
+
+  // Each block is preceded by a pointer to the heap it belongs to, padded so
+  // the users half stays 8 byte aligned...
+   union Header
+   {
+    Heap * heap;
+    real64 align;
+   };
+
+  nat32 blockSize; // Including the header.
+  nat32 blockCount;
+  mt::ThreadSlot slot; // Heap of the current thread.
+  Heap * volatile heaps; // Linked list of every heap ever made - they are only deleted with this object.
+
+  Heap * Local();
+  static void Orphan(void * heap);
+};
+
+//------------------------------------------------------------------------------
+/// A thread safe version of PreAlloc, with the same interface. Each thread
+/// gets its own stack of free blocks, so allocation and freeing never need to
+/// lock. Blocks may be freed by a thread other than the one that allocated
+/// them, in which case they are handed back to the owning thread via a lock
+/// free list, which it collects when it runs out. Blocks are obtained from the
+/// heap BC at a time, per thread, and are never returned to the heap until
+/// this object is destroyed. When a thread exits its stack of blocks is kept,
+/// and taken over by the next thread that needs one, so thread pools that come
+/// and go do not leak. Costs an extra 8 bytes per block.
+template <nat32 BS,nat32 BC>
+class EOS_CLASS ThreadAlloc : public ThreadAllocCode
+{
+ public:
+  /// &nbsp;
+   ThreadAlloc():ThreadAllocCode(BS,BC) {}
+
+  /// &nbsp;
+   ~ThreadAlloc() {}
+
+
+  /// This mallocs a pointer of the requested size, templated by return type and
+  /// designed to return null if the type you give it is bigger than what
+  /// this returns.
+   template <typename T>
+   T * Malloc()
+   {
+    if (sizeof(T)<=BS) return (T*)ThreadAllocCode::Malloc();
+                  else return null<T*>();
+   }
+
+  /// Frees a memory block that was allocated by this object, from any thread.
+   template <typename T>
+   void Free(T * ptr)
+   {
+    ThreadAllocCode::Free((void*)ptr);
+   }
+};
+
+//------------------------------------------------------------------------------
+/// Number of blocks each thread takes at a time from the 8 byte system wide
+/// memory allocator.
+static const nat32 pre8_size = 8*1024;
 
-/// A system wide memory allocator for 8 byte structures.
-EOS_VAR PreAlloc<8,pre8_size> pre8;
+/// A system wide memory allocator for 8 byte structures. Thread safe.
+EOS_VAR ThreadAlloc<8,pre8_size> pre8;
 
-/// Size of the 16 byte system wide memory allocator.
-static const nat32 pre16_size = 128*1024;
+/// Number of blocks each thread takes at a time from the 16 byte system wide
+/// memory allocator.
+static const nat32 pre16_size = 8*1024;
 
-/// A system wide memory allocator for 16 byte structures.
-EOS_VAR PreAlloc<16,pre16_size> pre16;
+/// A system wide memory allocator for 16 byte structures. Thread safe.
+EOS_VAR ThreadAlloc<16,pre16_size> pre16;
 
-/// Size of the 32 byte system wide memory allocator.
-static const nat32 pre32_size = 32*1024; 
+/// Number of blocks each thread takes at a time from the 32 byte system wide
+/// memory allocator.
+static const nat32 pre32_size = 4*1024;
 
-/// A system wide memory allocator for 32 byte structures.
-EOS_VAR PreAlloc<32,pre32_size> pre32;
+/// A system wide memory allocator for 32 byte structures. Thread safe.
+EOS_VAR ThreadAlloc<32,pre32_size> pre32;
 
-/// Size of the 64 byte system wide memory allocator.
-static const nat32 pre64_size = 16*1024; 
+/// Number of blocks each thread takes at a time from the 64 byte system wide
+/// memory allocator.
+static const nat32 pre64_size = 2*1024;
 
-/// A system wide memory allocator for 64 byte structures.
-EOS_VAR PreAlloc<64,pre64_size> pre64;
+/// A system wide memory allocator for 64 byte structures. Thread safe.
+EOS_VAR ThreadAlloc<64,pre64_size> pre64;
 
 //------------------------------------------------------------------------------
  };
@@ -158,6 +158,7 @@ EventLock::~EventLock()
 
 void EventLock::Add(nat32 n)
 {
+ if (n==0) return; // A sem_op of 0 would wait for the count to reach 0.
  sembuf op;
   op.sem_num = 0;
   op.sem_op = n;
@@ -234,6 +234,54 @@ class EOS_CLASS GateLock
   #endif
 };
 
+//------------------------------------------------------------------------------
+/// An integer that can be safelly modified by multiple threads without a lock,
+/// using the processors atomic instructions. Far cheaper than an OwnedLock for
+/// counters and flags, which is all it should be used for. All methods are
+/// full memory barriers.
+class EOS_CLASS Atomic
+{
+ public:
+  /// &nbsp;
+   Atomic(int32 v = 0):val(v) {}
+
+  /// &nbsp;
+   ~Atomic() {}
+
+
+  /// Returns the current value. Obviously it may of changed by the time you
+  /// get to look at it.
+   int32 Get() const {return __sync_add_and_fetch(&val,0);}
+
+  /// Sets the value.
+   void Set(int32 v)
+   {
+    int32 old = val;
+    while (!__sync_bool_compare_and_swap(&val,old,v)) old = val;
+   }
+
+  /// Adds the given amount, returning the value after the addition.
+   int32 Add(int32 amount) {return __sync_add_and_fetch(&val,amount);}
+
+  /// Incriments by one, returning the new value.
+   int32 Inc() {return __sync_add_and_fetch(&val,1);}
+
+  /// Decriments by one, returning the new value.
+   int32 Dec() {return __sync_sub_and_fetch(&val,1);}
+
+  /// If the current value is equal to oldVal it is set to newVal and true is
+  /// returned, otherwise it is left alone and false is returned.
+   bit CompareSwap(int32 oldVal,int32 newVal) {return __sync_bool_compare_and_swap(&val,oldVal,newVal);}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::mt::Atomic";}
+
+
+ private:
+  mutable volatile int32 val;
+};
+
 //------------------------------------------------------------------------------
  };
 };
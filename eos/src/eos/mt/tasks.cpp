@@ -0,0 +1,347 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/mt/tasks.h"
+
+#include "eos/mem/alloc.h"
+
+namespace eos
+{
+ namespace mt
+ {
+//------------------------------------------------------------------------------
+// A double ended queue of tasks, protected by a lock. The owning worker adds
+// and removes at the back, thiefs remove from the front...
+class PoolQueue
+{
+ public:
+  PoolQueue():size(64),start(0),count(0),data(mem::Malloc<Entry>(64)) {}
+ ~PoolQueue() {mem::Free(data);}
+
+  void PushBack(Task * task,TaskGroup * group)
+  {
+   lock.Lock();
+    if (count==size) Grow();
+    Entry & targ = data[(start+count)%size];
+    targ.task = task;
+    targ.group = group;
+    ++count;
+   lock.Unlock();
+  }
+
+  bit PopBack(Task *& task,TaskGroup *& group)
+  {
+   if (count==0) return false; // Unlocked peek, the lock makes the real decision.
+   bit ret = false;
+   lock.Lock();
+    if (count!=0)
+    {
+     --count;
+     Entry & targ = data[(start+count)%size];
+     task = targ.task;
+     group = targ.group;
+     ret = true;
+    }
+   lock.Unlock();
+   return ret;
+  }
+
+  bit PopFront(Task *& task,TaskGroup *& group)
+  {
+   if (count==0) return false;
+   bit ret = false;
+   lock.Lock();
+    if (count!=0)
+    {
+     Entry & targ = data[start];
+     task = targ.task;
+     group = targ.group;
+     start = (start+1)%size;
+     --count;
+     ret = true;
+    }
+   lock.Unlock();
+   return ret;
+  }
+
+
+ private:
+  struct Entry
+  {
+   Task * task;
+   TaskGroup * group;
+  };
+
+  OwnedLock lock;
+  nat32 size;
+  nat32 start;
+  volatile nat32 count;
+  Entry * data;
+
+  void Grow() // Call with the lock held.
+  {
+   Entry * nd = mem::Malloc<Entry>(size*2);
+   for (nat32 i=0;i<count;i++) nd[i] = data[(start+i)%size];
+   mem::Free(data);
+   data = nd;
+   start = 0;
+   size *= 2;
+  }
+};
+
+//------------------------------------------------------------------------------
+// The worker threads, which simply sit on the pools event lock and go to work
+// whenever there is something to do...
+class PoolWorker : public Thread
+{
+ public:
+  PoolWorker(TaskPool & p,nat32 i,nat32 c):pool(p),index(i),core(c),id(0xFFFFFFFF) {}
+ ~PoolWorker() {}
+
+  void Execute()
+  {
+   if (core!=0xFFFFFFFF) PinThread(core);
+   id = ThreadID();
+   while (true)
+   {
+    pool.wake.Get();
+
+    Task * task;
+    TaskGroup * group;
+    if (pool.Find(index,task,group)) TaskPool::Run(task,group);
+    else
+    {
+     if (pool.quit.Get()!=0) break;
+    }
+   }
+  }
+
+  nat32 Id() const {return id;}
+
+
+ private:
+  TaskPool & pool;
+  nat32 index;
+  nat32 core; // 0xFFFFFFFF if not pinned.
+  volatile nat32 id;
+};
+
+//------------------------------------------------------------------------------
+TaskGroup::TaskGroup()
+:pool(DefaultPool())
+{}
+
+TaskGroup::TaskGroup(TaskPool & p)
+:pool(p)
+{}
+
+TaskGroup::~TaskGroup()
+{
+ Wait();
+}
+
+void TaskGroup::Add(Task * task)
+{
+ pool.Add(task,*this);
+}
+
+void TaskGroup::Add(Task * task,nat32 band,nat32 bands)
+{
+ pool.Add(task,*this,band,bands);
+}
+
+void TaskGroup::Wait()
+{
+ nat32 idle = 0;
+ while (outstanding.Get()!=0)
+ {
+  if (pool.RunOne()) idle = 0;
+  else
+  {
+   // Nothing to do but wait for the stragglers - give way to start with, as
+   // they are probably close to finishing, and then back off...
+    ++idle;
+    if (idle<64) Sleep(0);
+            else Sleep(1);
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+TaskPool::TaskPool(nat32 threads,bit pin)
+:shared(new PoolQueue()),workers(threads),
+worker(null<PoolWorker**>()),queue(null<PoolQueue**>()),pinned(pin),node(null<nat32*>())
+{
+ if (workers==0) workers = CoreCount()-1;
+
+ if (workers!=0)
+ {
+  worker = new PoolWorker*[workers];
+  queue = new PoolQueue*[workers];
+  node = new nat32[workers];
+  for (nat32 i=0;i<workers;i++) queue[i] = new PoolQueue();
+
+  // Order the cores node by node, for handing out to the workers...
+   nat32 cores = CoreCount();
+   nat32 * order = new nat32[cores];
+   nat32 count = 0;
+   for (nat32 n=0;(n<NodeCount())&&(count<cores);n++)
+   {
+    for (nat32 c=0;c<cores;c++)
+    {
+     if (CoreNode(c)==n) order[count++] = c;
+    }
+   }
+
+  for (nat32 i=0;i<workers;i++)
+  {
+   nat32 core = 0xFFFFFFFF;
+   node[i] = 0;
+   if (pinned)
+   {
+    core = order[(i+1)%cores];
+    node[i] = CoreNode(core);
+   }
+
+   worker[i] = new PoolWorker(*this,i,core);
+   worker[i]->Run();
+  }
+  delete[] order;
+ }
+}
+
+TaskPool::~TaskPool()
+{
+ // Tell the workers to stop, and wait for them to do so...
+  quit.Set(1);
+  wake.Add(workers);
+  for (nat32 i=0;i<workers;i++) worker[i]->Wait();
+
+ // Clean up...
+  for (nat32 i=0;i<workers;i++)
+  {
+   delete worker[i];
+   delete queue[i];
+  }
+  delete[] worker;
+  delete[] queue;
+  delete[] node;
+  delete shared;
+}
+
+void TaskPool::Add(Task * task,TaskGroup & group)
+{
+ group.outstanding.Inc();
+
+ nat32 cur = Current();
+ if (cur<workers) queue[cur]->PushBack(task,&group);
+             else shared->PushBack(task,&group);
+
+ wake.Add(1);
+}
+
+void TaskPool::Add(Task * task,TaskGroup & group,nat32 band,nat32 bands)
+{
+ // From inside the pool the task stays with the worker that made it, as for
+ // any other...
+  if ((bands==0)||(Current()<workers)) {Add(task,group); return;}
+
+ group.outstanding.Inc();
+
+ // Share the bands out in order, with the last share going to the shared
+ // queue, for the thread that is waiting...
+  nat32 slot = nat32((nat64(band)*nat64(workers+1))/nat64(bands));
+  if (slot<workers) queue[slot]->PushBack(task,&group);
+               else shared->PushBack(task,&group);
+
+ wake.Add(1);
+}
+
+bit TaskPool::RunOne()
+{
+ Task * task;
+ TaskGroup * group;
+ if (Find(Current(),task,group))
+ {
+  Run(task,group);
+  return true;
+ }
+ else return false;
+}
+
+nat32 TaskPool::Current() const
+{
+ if (workers==0) return 0;
+ nat32 id = ThreadID();
+ for (nat32 i=0;i<workers;i++)
+ {
+  if (worker[i]->Id()==id) return i;
+ }
+ return workers;
+}
+
+void TaskPool::Run(Task * task,TaskGroup * group)
+{
+ try
+ {
+  task->Execute();
+ }
+ catch(...)
+ {
+  group->errors.Inc();
+ }
+ group->outstanding.Dec();
+}
+
+bit TaskPool::Find(nat32 start,Task *& task,TaskGroup *& group)
+{
+ // Our own queue first, newest task first as its memory is probably still in
+ // the cache...
+  if ((start<workers)&&(queue[start]->PopBack(task,group))) return true;
+
+ // Then the shared queue, oldest first...
+  if (shared->PopFront(task,group)) return true;
+
+ // Then try stealing, going round the other workers starting with our
+ // neighbour, so thiefs tend to spread out. Workers on our own node are
+ // tried first, as the memory of their tasks is probably local to us too...
+  for (nat32 pass=0;pass<2;pass++)
+  {
+   for (nat32 i=1;i<=workers;i++)
+   {
+    nat32 victim = (start+i)%(workers+1);
+    if ((victim>=workers)||(victim==start)) continue;
+
+    bit local = (start<workers)&&(node[victim]==node[start]);
+    if (local!=(pass==0)) continue;
+    if (queue[victim]->PopFront(task,group)) return true;
+   }
+  }
+
+ return false;
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC TaskPool & DefaultPool()
+{
+ static TaskPool pool(0,NodeCount()>1);
+ return pool;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,401 @@
+#ifndef EOS_MT_TASKS_H
+#define EOS_MT_TASKS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file tasks.h
+/// Provides a shared pool of worker threads that small jobs can be handed to,
+/// so algorithms can use every core without each one having to run its own
+/// threads. Also provides the ParallelFor family of helpers, and
+/// ParallelReduce, which are how most code should use it.
+
+#include "eos/types.h"
+#include "eos/mt/threads.h"
+#include "eos/mt/locks.h"
+
+namespace eos
+{
+ namespace svt
+ {
+  template <typename T>
+  class Field;
+ }
+
+ namespace mt
+ {
+//------------------------------------------------------------------------------
+/// A unit of work to be given to a TaskPool, you inherit from this and
+/// impliment Execute(), just like for Thread. A Task is never deleted by the
+/// pool, its up to whoever created it to clean it up after the TaskGroup it
+/// was added to has been waited on.
+class EOS_CLASS Task : public Deletable
+{
+ public:
+  /// &nbsp;
+   Task() {}
+
+  /// &nbsp;
+   ~Task() {}
+
+
+  /// Does the work, called by whichever thread gets to it first.
+   virtual void Execute() = 0;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::mt::Task";}
+};
+
+//------------------------------------------------------------------------------
+class TaskPool;
+
+//------------------------------------------------------------------------------
+/// A set of tasks that can be waited on as a unit. You add tasks to the group,
+/// which hands them to its pool, and then call Wait(), which returns only once
+/// all of them have been done. Whilst waiting the calling thread does not sit
+/// idle, it runs pending tasks itself, which means groups can be nested, i.e. a
+/// task can create its own group and wait on it without any risk of deadlock.
+class EOS_CLASS TaskGroup
+{
+ public:
+  /// Uses the default pool. See DefaultPool().
+   TaskGroup();
+
+  /// Uses the given pool.
+   TaskGroup(TaskPool & pool);
+
+  /// Waits for any remaining tasks before returning.
+   ~TaskGroup();
+
+
+  /// Adds a task, it can start running before this method returns. The task
+  /// must remain valid until Wait() has been called.
+   void Add(Task * task);
+
+  /// Adds a task that is the given band of bands consecutive parts of a
+  /// larger job, such as a set of rows. When added from outside the pool the
+  /// bands are shared out in order over the workers, rather than all going
+  /// in the one queue, so repeated jobs of the same size hand the same band
+  /// to the same worker each time. With a pinned pool that means the same
+  /// node, so memory first touched by one pass is local for the next.
+   void Add(Task * task,nat32 band,nat32 bands);
+
+  /// Blocks until all tasks added so far have finished, running tasks itself
+  /// whilst it waits. Can be called repeatedly, adding more tasks between
+  /// calls.
+   void Wait();
+
+
+  /// Returns how many tasks have been added but not yet completed.
+   nat32 Outstanding() const {return nat32(outstanding.Get());}
+
+  /// Returns true if any task threw an exception. Exceptions can not be
+  /// passed between threads, so they are caught and counted instead, the task
+  /// having been abandoned at the point it threw.
+   bit Error() const {return errors.Get()!=0;}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::mt::TaskGroup";}
+
+
+ private:
+  friend class TaskPool;
+
+  TaskPool & pool;
+  Atomic outstanding;
+  Atomic errors;
+};
+
+//------------------------------------------------------------------------------
+/// A pool of worker threads, which runs the tasks given to it via TaskGroup
+/// objects. Each worker has its own queue, to which tasks created by that
+/// worker are added; a worker takes from the back of its own queue and when
+/// that runs dry steals from the front of the others, which keeps related work
+/// on the same core and balances the load automatically. Tasks added from
+/// outside the pool go into a shared queue.
+///
+/// By default it creates one less thread than there are cores, as the thread
+/// that calls TaskGroup::Wait() works as well. On a single core machine this
+/// means no threads at all, with all the work done in Wait(). Ushally you will
+/// just use the pool provided by DefaultPool().
+///
+/// On NUMA machines the workers can be pinned to cores, filling each node in
+/// turn, in which case thiefs try the workers of their own node before going
+/// further afield, and banded tasks (see TaskGroup::Add) keep to a node.
+class EOS_CLASS TaskPool
+{
+ public:
+  /// Creates the given number of worker threads, where 0 means CoreCount()-1.
+  /// If pin is true each worker is pinned to its own core, going through the
+  /// cores node by node and skipping the first, which is left for the thread
+  /// that creates the pool, so consecutive workers share a node.
+   TaskPool(nat32 threads = 0,bit pin = false);
+
+  /// It is the users responsibility to make sure all task groups have been
+  /// waited on before this is called.
+   ~TaskPool();
+
+
+  /// Returns how many worker threads there are.
+   nat32 Threads() const {return workers;}
+
+  /// Returns how many threads can be working on tasks at once, i.e. Threads()+1
+  /// to include the thread that is waiting. This is the number to base any
+  /// decisions about how finely to split work on.
+   nat32 Concurrency() const {return workers+1;}
+
+  /// Returns true if the workers are pinned to cores.
+   bit Pinned() const {return pinned;}
+
+  /// Returns the node the given worker runs on, always 0 if not Pinned().
+   nat32 Node(nat32 worker) const {return node[worker];}
+
+
+  /// Adds a task, which will be done on behalf of the given group. You would
+  /// ushally call TaskGroup::Add() instead.
+   void Add(Task * task,TaskGroup & group);
+
+  /// Adds a banded task, see TaskGroup::Add.
+   void Add(Task * task,TaskGroup & group,nat32 band,nat32 bands);
+
+  /// Runs a single pending task in the calling thread, returning true if it did
+  /// so or false if there was nothing to do. Used by TaskGroup::Wait().
+   bit RunOne();
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::mt::TaskPool";}
+
+
+ private:
+  friend class PoolWorker;
+
+  class PoolQueue * shared; // For tasks added from outside the pool.
+  nat32 workers;
+  class PoolWorker ** worker; // Array of workers.
+  class PoolQueue ** queue; // Array of the per-worker queues, indexed as worker is.
+  bit pinned;
+  nat32 * node; // Node of each worker, indexed as worker is.
+
+  EventLock wake; // One event per task added, plus one per worker on shutdown.
+  Atomic quit;
+
+  // Returns the index of the worker that is calling, or workers if its not one.
+   nat32 Current() const;
+
+  // Runs a task, with all the book keeping, given its details...
+   static void Run(Task * task,TaskGroup * group);
+
+  // Finds a task, starting with the given queue index, returns false if none...
+   bit Find(nat32 start,Task *& task,TaskGroup *& group);
+};
+
+//------------------------------------------------------------------------------
+/// Returns the system wide TaskPool, which is created the first time this is
+/// called. Everything should share this pool, rather than creating extra
+/// pools and hence to many threads. Its workers are pinned if the machine
+/// has more than one NUMA node.
+EOS_FUNC TaskPool & DefaultPool();
+
+//------------------------------------------------------------------------------
+// Helper for the ParallelFor functions...
+template <typename F>
+class EOS_CLASS RangeTask : public Task
+{
+ public:
+  F * func;
+  nat32 begin;
+  nat32 end;
+
+  void Execute() {(*func)(begin,end);}
+};
+
+// Helper for ParallelReduce...
+template <typename F,typename A>
+class EOS_CLASS ReduceTask : public Task
+{
+ public:
+  F * func;
+  A * acc;
+  nat32 begin;
+  nat32 end;
+
+  void Execute() {(*func)(begin,end,*acc);}
+};
+
+// Helper for the ParallelFor2D functions...
+template <typename F>
+class EOS_CLASS TileTask : public Task
+{
+ public:
+  F * func;
+  nat32 x0;
+  nat32 y0;
+  nat32 x1;
+  nat32 y1;
+
+  void Execute() {(*func)(x0,y0,x1,y1);}
+};
+
+//------------------------------------------------------------------------------
+/// Calls func(b,e) for a set of ranges [b,e) that together cover [begin,end),
+/// using the given pool to do them at the same time. Ranges are never smaller
+/// than grain, except for the last, and are made large enough that there are
+/// only a few per thread, so func should hand each range to a tight loop.
+/// The ranges are decided purely by the sizes given, so if each range writes
+/// to its own part of the output the results are identical to a single call
+/// of func(begin,end). Returns once all ranges are done. F can be any type
+/// with a suitable operator(), it is called in multiple threads at once.
+/// The ranges are added as bands, so on a pinned pool a given range runs on
+/// the same node each time - initialising an array with a ParallelFor places
+/// its pages where the ParallelFor-s that follow will want them.
+template <typename F>
+inline void ParallelFor(nat32 begin,nat32 end,F & func,nat32 grain = 1,TaskPool & pool = DefaultPool())
+{
+ if (end<=begin) return;
+ if (grain==0) grain = 1;
+
+ nat32 n = end - begin;
+ nat32 chunks = (n+grain-1)/grain;
+ if (chunks>pool.Concurrency()*4) chunks = pool.Concurrency()*4;
+ if ((chunks<=1)||(pool.Threads()==0)) {func(begin,end); return;}
+
+ RangeTask<F> * task = new RangeTask<F>[chunks];
+ {
+  TaskGroup group(pool);
+  for (nat32 i=0;i<chunks;i++)
+  {
+   task[i].func = &func;
+   task[i].begin = begin + nat32((nat64(n)*nat64(i))/nat64(chunks));
+   task[i].end = begin + nat32((nat64(n)*nat64(i+1))/nat64(chunks));
+   group.Add(&task[i],i,chunks);
+  }
+  group.Wait();
+ }
+ delete[] task;
+}
+
+/// The ParallelFor for calculating a summary of a range, such as the
+/// statistics of math/stats.h. Calls func(b,e,acc) for a set of ranges
+/// [b,e) that cover [begin,end), as ParallelFor, where each range gets its
+/// own accumulator, a copy of init, to add to. Once all are done they are
+/// merged into out in range order, by calling out.Merge(acc) for each. A
+/// therefore needs a copy constructor and a Merge method. init and out can be
+/// the same object, so long as its empty when starting. As with ParallelFor
+/// the ranges depend only on the sizes given and the number of threads, so
+/// for a given machine the result is repeatable.
+template <typename F,typename A>
+inline void ParallelReduce(nat32 begin,nat32 end,F & func,const A & init,A & out,nat32 grain = 1,TaskPool & pool = DefaultPool())
+{
+ if (end<=begin) return;
+ if (grain==0) grain = 1;
+
+ nat32 n = end - begin;
+ nat32 chunks = (n+grain-1)/grain;
+ if (chunks>pool.Concurrency()*4) chunks = pool.Concurrency()*4;
+ if ((chunks<=1)||(pool.Threads()==0))
+ {
+  A acc(init);
+  func(begin,end,acc);
+  out.Merge(acc);
+  return;
+ }
+
+ ReduceTask<F,A> * task = new ReduceTask<F,A>[chunks];
+ for (nat32 i=0;i<chunks;i++) task[i].acc = new A(init);
+ {
+  TaskGroup group(pool);
+  for (nat32 i=0;i<chunks;i++)
+  {
+   task[i].func = &func;
+   task[i].begin = begin + nat32((nat64(n)*nat64(i))/nat64(chunks));
+   task[i].end = begin + nat32((nat64(n)*nat64(i+1))/nat64(chunks));
+   group.Add(&task[i],i,chunks);
+  }
+  group.Wait();
+ }
+
+ for (nat32 i=0;i<chunks;i++)
+ {
+  out.Merge(*task[i].acc);
+  delete task[i].acc;
+ }
+ delete[] task;
+}
+
+/// Calls func(x0,y0,x1,y1) for a grid of tiles covering the rectangle
+/// [0,width) x [0,height), with the ends being exclusive. Tiles are tileW by
+/// tileH, except at the right and bottom edges. Each tile is a seperate task,
+/// so tiles should be big enough to be worth it.
+template <typename F>
+inline void ParallelFor2D(nat32 width,nat32 height,F & func,nat32 tileW = 64,nat32 tileH = 64,TaskPool & pool = DefaultPool())
+{
+ if ((width==0)||(height==0)) return;
+ if (tileW==0) tileW = width;
+ if (tileH==0) tileH = height;
+
+ nat32 tilesX = (width+tileW-1)/tileW;
+ nat32 tilesY = (height+tileH-1)/tileH;
+ nat32 tiles = tilesX*tilesY;
+ if ((tiles==1)||(pool.Threads()==0)) {func(nat32(0),nat32(0),width,height); return;}
+
+ TileTask<F> * task = new TileTask<F>[tiles];
+ {
+  TaskGroup group(pool);
+  for (nat32 y=0;y<tilesY;y++)
+  {
+   for (nat32 x=0;x<tilesX;x++)
+   {
+    TileTask<F> & targ = task[y*tilesX + x];
+    targ.func = &func;
+    targ.x0 = x*tileW;
+    targ.y0 = y*tileH;
+    targ.x1 = (targ.x0+tileW<width)?(targ.x0+tileW):width;
+    targ.y1 = (targ.y0+tileH<height)?(targ.y0+tileH):height;
+    group.Add(&targ);
+   }
+  }
+  group.Wait();
+ }
+ delete[] task;
+}
+
+//------------------------------------------------------------------------------
+/// Splits a 2 or more dimensional svt::Field by rows, i.e. by its second
+/// dimension, calling func(y0,y1) for sets of rows [y0,y1). See the range
+/// version of ParallelFor for details.
+template <typename T,typename F>
+inline void ParallelFor(const svt::Field<T> & field,F & func,nat32 grain = 1,TaskPool & pool = DefaultPool())
+{
+ ParallelFor(nat32(0),field.Size(1),func,grain,pool);
+}
+
+/// Splits a 2 or more dimensional svt::Field into tiles over its first two
+/// dimensions, calling func(x0,y0,x1,y1) for each. See the range version of
+/// ParallelFor2D for details.
+template <typename T,typename F>
+inline void ParallelFor2D(const svt::Field<T> & field,F & func,nat32 tileW = 64,nat32 tileH = 64,TaskPool & pool = DefaultPool())
+{
+ ParallelFor2D(field.Size(0),field.Size(1),func,tileW,tileH,pool);
+}
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
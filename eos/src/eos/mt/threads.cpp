@@ -26,13 +26,14 @@
 #else
  #include <unistd.h>
  #include <sys/types.h>
+ #include <sys/syscall.h>
  #include <stdio.h>
- #include <sys/mman.h>
- #include <sched.h>
- #include <sys/wait.h>
+ #include <stdlib.h>
+ #include <pthread.h>
  #include <signal.h>
  #include <sys/time.h> 
  #include <sys/resource.h>
+ #include <sched.h>
 #endif
 
 namespace eos
@@ -59,6 +60,26 @@ EOS_FUNC nat32 CoreCount()
  return si.dwNumberOfProcessors;
 }
 
+EOS_FUNC nat32 NodeCount()
+{
+ ULONG highest;
+ if (!GetNumaHighestNodeNumber(&highest)) return 1;
+ return highest+1;
+}
+
+EOS_FUNC nat32 CoreNode(nat32 core)
+{
+ UCHAR node;
+ if ((core>255)||(!GetNumaProcessorNode(UCHAR(core),&node))||(node==0xFF)) return 0;
+ return node;
+}
+
+EOS_FUNC bit PinThread(nat32 core)
+{
+ if (core>=sizeof(DWORD_PTR)*8) return false;
+ return SetThreadAffinityMask(GetCurrentThread(),DWORD_PTR(1)<<core)!=0;
+}
+
 #else
 
 EOS_FUNC void Sleep(nat32 ms)
@@ -68,7 +89,7 @@ EOS_FUNC void Sleep(nat32 ms)
 
 EOS_FUNC nat32 ThreadID()
 {
- return getpid();
+ return syscall(SYS_gettid);
 }
 
 EOS_FUNC nat32 CoreCount()
@@ -101,17 +122,95 @@ EOS_FUNC nat32 CoreCount()
  return (ret==0)?1:ret; // I consider it good practise to return at least 1, being told there are no cpus can be something of a mind blowing event for a running process.
 }
 
+// The node of each core, read from sysfs the first time its needed. Nodes
+// are renumbered to be contiguous, in case some are offline...
+struct Topology
+{
+ static const nat32 maxNodes = 64;
+
+ nat32 nodes;
+ nat32 cores;
+ nat32 * node; // Indexed by core.
+
+ Topology():nodes(0),cores(CoreCount()),node(mem::Malloc<nat32>(cores))
+ {
+  for (nat32 i=0;i<cores;i++) node[i] = 0;
+
+  for (nat32 n=0;n<maxNodes;n++)
+  {
+   char fn[64];
+   sprintf(fn,"/sys/devices/system/node/node%u/cpulist",n);
+   FILE * f = fopen(fn,"r");
+   if (f==null<FILE*>()) continue;
+
+   // Its a comma seperated list of cores and inclusive ranges of cores...
+    char line[1024];
+    if (fgets(line,sizeof(line),f))
+    {
+     char * pos = line;
+     while ((*pos>='0')&&(*pos<='9'))
+     {
+      nat32 first = strtoul(pos,&pos,10);
+      nat32 last = first;
+      if (*pos=='-') last = strtoul(pos+1,&pos,10);
+      for (nat32 c=first;(c<=last)&&(c<cores);c++) node[c] = nodes;
+      if (*pos==',') ++pos;
+     }
+    }
+    fclose(f);
+    ++nodes;
+  }
+
+  if (nodes==0) nodes = 1;
+ }
+
+ ~Topology() {mem::Free(node);}
+};
+
+static Topology & GetTopology()
+{
+ static Topology topology;
+ return topology;
+}
+
+EOS_FUNC nat32 NodeCount()
+{
+ return GetTopology().nodes;
+}
+
+EOS_FUNC nat32 CoreNode(nat32 core)
+{
+ Topology & t = GetTopology();
+ return (core<t.cores)?t.node[core]:0;
+}
+
+EOS_FUNC bit PinThread(nat32 core)
+{
+ if (core>=CPU_SETSIZE) return false;
+ cpu_set_t set;
+ CPU_ZERO(&set);
+ CPU_SET(core,&set);
+ return sched_setaffinity(0,sizeof(set),&set)==0;
+}
+
 #endif
 
+EOS_FUNC nat32 CoreCount(nat32 node)
+{
+ nat32 ret = 0;
+ nat32 cores = CoreCount();
+ for (nat32 i=0;i<cores;i++)
+ {
+  if (CoreNode(i)==node) ++ret;
+ }
+ return ret;
+}
+
 //------------------------------------------------------------------------------
 // Helper function, used by the below class...
 
 #ifdef EOS_WIN32
-DWORD WINAPI 
-#else
-int
-#endif
-thread_func(void * data)
+DWORD WINAPI thread_func(void * data)
 {
  try
  {
@@ -123,6 +222,23 @@ thread_func(void * data)
  }
  return 0;
 }
+#else
+void * thread_func(void * data)
+{
+ Thread * self = static_cast<Thread*>(data);
+ self->tid = ThreadID();
+ try
+ {
+  self->Execute();
+  self->state = 2;
+ }
+ catch(...)
+ {
+  self->state = 3;
+ }
+ return null<void*>();
+}
+#endif
 
 //------------------------------------------------------------------------------
 #ifdef WIN32
@@ -178,7 +294,7 @@ void Thread::Priority(bit high)
 #else
 
 Thread::Thread()
-:stack(null<void*>()),procId(-1)
+:hand(null<void*>()),state(0),tid(0)
 {}
 
 Thread::~Thread()
@@ -188,50 +304,102 @@ Thread::~Thread()
 
 bit Thread::Run()
 {
- // Create the stack, using mmap...
-  stack = mmap(0,start_size,PROT_EXEC | PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_GROWSDOWN | MAP_ANONYMOUS,0,0);
-  if (stack==null<void*>()) return false;
- 
- // Clone to create the new kernel space thread...
-  procId = clone(thread_func,stack,SIGCHLD | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_PTRACE | CLONE_VM,this);
-
- return procId!=-1;
+ pthread_t * th = mem::Malloc<pthread_t>();
+ state = 1;
+ if (pthread_create(th,0,thread_func,this)!=0)
+ {
+  mem::Free(th);
+  state = 0;
+  return false;
+ }
+ hand = th;
+ return true;
 }
 
 void Thread::Kill()
 {
- if (procId!=-1) kill(procId,SIGKILL);
- if (stack) munmap(stack,start_size);
+ if (hand)
+ {
+  if (state==1) pthread_cancel(*(pthread_t*)hand);
+  pthread_join(*(pthread_t*)hand,0);
+  mem::Free((pthread_t*)hand);
+  hand = null<void*>();
+ }
 }
 
 bit Thread::Running() const
 {
- if (procId==-1) return false;
- return waitpid(procId,0,WNOHANG)==0;
+ return state==1;
 }
 
 bit Thread::Error() const
 {
- if (procId==-1) return true;
- int status;
- int res = waitpid(procId,&status,WNOHANG);
- if (res!=procId)
- {
-  if (res==0) return false;
-         else return true;
- }
- return !WIFEXITED(status) || (WEXITSTATUS(status)!=0);
+ return (state==0)||(state==3);
 }
 
 void Thread::Wait() const
 {
- if (procId!=-1) waitpid(procId,0,0);
+ if (hand)
+ {
+  pthread_join(*(pthread_t*)hand,0);
+  mem::Free((pthread_t*)hand);
+  hand = null<void*>();
+ }
 }
 
 void Thread::Priority(bit high)
 {
- if (high) setpriority(PRIO_PROCESS,procId,0);
-      else setpriority(PRIO_PROCESS,procId,-1);
+ while ((state==1)&&(tid==0)) Sleep(0);
+ if (high) setpriority(PRIO_PROCESS,tid,0);
+      else setpriority(PRIO_PROCESS,tid,-1);
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+#ifdef WIN32
+
+ThreadSlot::ThreadSlot(void (*onExit)(void * ptr))
+:index(TlsAlloc())
+{}
+
+ThreadSlot::~ThreadSlot()
+{
+ TlsFree(index);
+}
+
+void * ThreadSlot::Get() const
+{
+ return TlsGetValue(index);
+}
+
+void ThreadSlot::Set(void * ptr)
+{
+ TlsSetValue(index,ptr);
+}
+
+#else
+
+ThreadSlot::ThreadSlot(void (*onExit)(void * ptr))
+:key(mem::Malloc<pthread_key_t>())
+{
+ pthread_key_create((pthread_key_t*)key,onExit);
+}
+
+ThreadSlot::~ThreadSlot()
+{
+ pthread_key_delete(*(pthread_key_t*)key);
+ mem::Free((pthread_key_t*)key);
+}
+
+void * ThreadSlot::Get() const
+{
+ return pthread_getspecific(*(pthread_key_t*)key);
+}
+
+void ThreadSlot::Set(void * ptr)
+{
+ pthread_setspecific(*(pthread_key_t*)key,ptr);
 }
 
 #endif
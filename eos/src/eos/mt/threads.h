@@ -47,6 +47,22 @@ EOS_FUNC nat32 ThreadID();
 /// The sum of the number of cores for each proccessor.
 EOS_FUNC nat32 CoreCount();
 
+/// Returns how many NUMA nodes the computer has, i.e. how many groups of
+/// cores with their own memory, ushally one per socket. Always at least 1.
+EOS_FUNC nat32 NodeCount();
+
+/// Returns how many cores the given node has.
+EOS_FUNC nat32 CoreCount(nat32 node);
+
+/// Returns which node the given core, in [0,CoreCount()), belongs to. Cores
+/// the OS doesn't report a node for are put on node 0.
+EOS_FUNC nat32 CoreNode(nat32 core);
+
+/// Pins the calling thread to the given core, so it will only ever run there
+/// and the memory it first touches stays on that cores node. Returns false
+/// on failure.
+EOS_FUNC bit PinThread(nat32 core);
+
 //------------------------------------------------------------------------------
 /// To create a thread inherit from this class and impliment the Execute()
 /// method, when the Run() method is then called the execute method will be run
@@ -108,9 +124,47 @@ class EOS_CLASS Thread : public Deletable
   #ifdef WIN32
    void * hand;
   #else
-   static const int start_size = 1024; // Starting stack size.
-   void * stack;
-   int procId;
+   mutable void * hand; // Malloc'ed pthread_t, null once joined.
+   volatile int state; // 0 = not started, 1 = running, 2 = finished, 3 = died.
+   volatile nat32 tid; // Kernel id of the thread, for setting priority.
+
+   friend void * thread_func(void * data);
+  #endif
+};
+
+//------------------------------------------------------------------------------
+/// A pointer with a seperate value for every thread, i.e. thread local
+/// storage. Every thread starts with it set to null. You can optionally
+/// provide a function that is called with the value whenever a thread that
+/// set it to something other than null exits, so per-thread structures can
+/// be cleaned up or recycled. (This callback is not supported on windows,
+/// where it is simply never called.)
+class EOS_CLASS ThreadSlot
+{
+ public:
+  /// &nbsp;
+   ThreadSlot(void (*onExit)(void * ptr) = null<void (*)(void*)>());
+
+  /// Does not call onExit for any threads.
+   ~ThreadSlot();
+
+
+  /// Returns the value for the calling thread.
+   void * Get() const;
+
+  /// Sets the value for the calling thread.
+   void Set(void * ptr);
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::mt::ThreadSlot";}
+
+
+ private:
+  #ifdef WIN32
+   nat32 index;
+  #else
+   void * key; // Malloc'ed pthread_key_t.
   #endif
 };
 
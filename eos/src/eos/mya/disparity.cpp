@@ -27,6 +27,7 @@ Disparity::Disparity(real32 mult,const svt::Field<real32> & disp)
 {
  SetConst(0,mult);
  SetVariable(0,disp);
+ CacheFeatures();
 }
 
 Disparity::Disparity(real32 mult,const svt::Field<real32> & disp,const svt::Field<bit> & valid)
@@ -35,6 +36,7 @@ Disparity::Disparity(real32 mult,const svt::Field<real32> & disp,const svt::Fiel
  SetConst(0,mult);
  SetVariable(0,disp);
  SetValidity(valid);
+ CacheFeatures();
 }
 
 Disparity::~Disparity()
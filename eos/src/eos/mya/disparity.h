@@ -28,7 +28,9 @@ namespace eos
  namespace mya
  {
 //------------------------------------------------------------------------------
-/// An Ied for representing Disparity data from a stereo algorithm.
+/// An Ied for representing Disparity data from a stereo algorithm. The
+/// disparity map is copied at construction, via CacheFeatures, so changes made
+/// to it afterwards are not seen unless CacheFeatures is called again.
 class EOS_CLASS Disparity : public Ied
 {
  public:
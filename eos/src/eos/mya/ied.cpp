@@ -60,15 +60,101 @@ bit Ied::Feature(nat32 x,nat32 y,math::Vector<real32> & out) const
    out[ovi] = constFeats[i];
    ++ovi;
   }
-  for (nat32 i=0;i<variableFeats.Size();i++)
+  if (cache.Size()!=0)
   {
-   out[ovi] = variableFeats[i].Get(x,y);
-   ++ovi;
+   nat32 step = Width()*Height();
+   const real32 * targ = cache.Ptr() + y*Width() + x;
+   for (nat32 i=0;i<variableFeats.Size();i++)
+   {
+    out[ovi] = *targ;
+    targ += step;
+    ++ovi;
+   }
+  }
+  else
+  {
+   for (nat32 i=0;i<variableFeats.Size();i++)
+   {
+    out[ovi] = variableFeats[i].Get(x,y);
+    ++ovi;
+   }
   }
  
  return true;
 }
 
+nat32 Ied::Features(nat32 x0,nat32 y0,nat32 width,nat32 height,real32 * out,bit * validOut) const
+{
+ nat32 area = width*height;
+ 
+ // The constant features...
+  for (nat32 i=0;i<constFeats.Size();i++)
+  {
+   real32 * targ = out + i*area;
+   for (nat32 j=0;j<area;j++) targ[j] = constFeats[i];
+  }
+  out += constFeats.Size()*area;
+ 
+ // The variable features, by row, from the cache if avaliable...
+  for (nat32 i=0;i<variableFeats.Size();i++)
+  {
+   real32 * targ = out + i*area;
+   if (cache.Size()!=0)
+   {
+    const real32 * plane = cache.Ptr() + i*Width()*Height();
+    for (nat32 v=0;v<height;v++) mem::Copy(targ + v*width,plane + (y0+v)*Width() + x0,width);
+   }
+   else
+   {
+    for (nat32 v=0;v<height;v++)
+    {
+     for (nat32 u=0;u<width;u++) targ[v*width+u] = variableFeats[i].Get(x0+u,y0+v);
+    }
+   }
+  }
+
+ // The validity...
+  nat32 ret = area;
+  if (valid.Valid())
+  {
+   ret = 0;
+   for (nat32 v=0;v<height;v++)
+   {
+    for (nat32 u=0;u<width;u++)
+    {
+     bit ok = valid.Get(x0+u,y0+v);
+     if (ok) ++ret;
+     if (validOut) validOut[v*width+u] = ok;
+    }
+   }
+  }
+  else if (validOut)
+  {
+   for (nat32 j=0;j<area;j++) validOut[j] = true;
+  }
+
+ return ret;
+}
+
+void Ied::CacheFeatures()
+{
+ nat32 step = Width()*Height();
+ cache.Size(variableFeats.Size()*step);
+ for (nat32 i=0;i<variableFeats.Size();i++)
+ {
+  real32 * targ = cache.Ptr() + i*step;
+  for (nat32 y=0;y<Height();y++)
+  {
+   for (nat32 x=0;x<Width();x++) *targ++ = variableFeats[i].Get(x,y);
+  }
+ }
+}
+
+void Ied::ClearCache()
+{
+ cache.Size(0);
+}
+
 void Ied::SetValidity(const svt::Field<bit> & v)
 {
  valid = v;
@@ -76,6 +76,33 @@ class EOS_CLASS Ied : public Deletable
   /// elements will be ignored. returns true if out is set, false otherwise.
   /// false indicates the data is invalid at this particular point.
    bit Feature(nat32 x,nat32 y,math::Vector<real32> & out) const;
+
+  /// Outputs the features for a whole region at once, into a caller provided
+  /// buffer in structure of arrays layout, so no memory is allocated. out must
+  /// have Length()*width*height entries, element i of the feature at 
+  /// (x0+u,y0+v) goes to out[(i*height+v)*width+u]. validOut, if provided, must 
+  /// have width*height entries, and is set true where the feature is valid, the
+  /// features of invalid pixels are still written but are meaningless. Returns
+  /// how many of the features are valid.
+   nat32 Features(nat32 x0,nat32 y0,nat32 width,nat32 height,real32 * out,bit * validOut = null<bit*>()) const;
+
+  /// Row version of Features, for [x0,x1) of row y. out must have 
+  /// Length()*(x1-x0) entries.
+   nat32 FeatureRow(nat32 y,nat32 x0,nat32 x1,real32 * out,bit * validOut = null<bit*>()) const
+   {return Features(x0,y,x1-x0,1,out,validOut);}
+
+
+  /// Copies the image-variable features into contiguous planes, which are then
+  /// used by Feature and Features instead of the fields, so they read memory
+  /// sequentially. Must be called again if the fields are changed afterwards,
+  /// as the copy will be stale.
+   void CacheFeatures();
+   
+  /// Releases the copy made by CacheFeatures, so the fields are used directly.
+   void ClearCache();
+   
+  /// Returns true if CacheFeatures is in effect.
+   bit Cached() const {return cache.Size()!=0;}
    
    
   /// This returns the type token for the data type, which will correlate with the
@@ -116,6 +143,10 @@ class EOS_CLASS Ied : public Deletable
   
   ds::Array< real32 > constFeats;
   ds::Array< svt::Field<real32> > variableFeats; 
+  
+  // The copy made by CacheFeatures, a width*height plane for each variable 
+  // feature, one after the other. Empty when not in use.
+   ds::Array<real32> cache;
 };
 
 //------------------------------------------------------------------------------
@@ -17,13 +17,144 @@
 
 #include "eos/mya/layer_grow.h"
 
+#include "eos/ds/arrays.h"
+
 namespace eos
 {
  namespace mya
  {
 //------------------------------------------------------------------------------
+LayerGrow::LayerGrow(const svt::Field<nat32> & s,Layers & l,LayerScore & ls)
+:segs(s),layers(l),layerScore(ls),maxIters(32)
+{}
+
+LayerGrow::~LayerGrow()
+{}
+
+void LayerGrow::SetMaxIters(nat32 mi)
+{
+ maxIters = mi;
+}
+
+void LayerGrow::operator () (time::Progress * prog) const
+{
+ LogTime("eos::mya::LayerGrow::operator ()");
+ prog->Push();
+
+ ds::Array<Move> move;
+ ds::Array<bit> touched(layers.SegmentCount());
+ ds::Array<nat32> label(layers.SegmentCount());
+ for (nat32 iter=0;iter<maxIters;iter++)
+ {
+  prog->Report(iter,maxIters);
+  
+  // Collect every move of a segment into the layer of a neighbouring segment,
+  // removing duplicates...
+   nat32 moves = 0;
+   for (nat32 y=0;y<segs.Size(1);y++)
+   {
+    for (nat32 x=0;x<segs.Size(0);x++)
+    {
+     nat32 here = segs.Get(x,y);
+     for (nat32 n=0;n<2;n++)
+     {
+      if ((n==0)&&(x==0)) continue;
+      if ((n==1)&&(y==0)) continue;
+      nat32 there = (n==0)?segs.Get(x-1,y):segs.Get(x,y-1);
+      
+      nat32 hereLayer = layers.SegToLayer(here);
+      nat32 thereLayer = layers.SegToLayer(there);
+      if (hereLayer==thereLayer) continue;
+      
+      if (moves+2>move.Size()) move.Size(moves*2+64);
+      move[moves].seg = here;
+      move[moves].layer = thereLayer;
+      ++moves;
+      move[moves].seg = there;
+      move[moves].layer = hereLayer;
+      ++moves;
+     }
+    }
+   }
+   if (moves==0) break;
+   
+   move.Size(moves);
+   move.SortNorm();
+   nat32 unique = 1;
+   for (nat32 i=1;i<moves;i++)
+   {
+    if ((move[i].seg!=move[unique-1].seg)||(move[i].layer!=move[unique-1].layer)) move[unique++] = move[i];
+   }
+   moves = unique;
+
+
+  // Score them all in a batch...
+   ds::Array<nat32> seg(moves);
+   ds::Array<nat32> layer(moves);
+   ds::Array<real32> cost(moves);
+   for (nat32 i=0;i<moves;i++)
+   {
+    seg[i] = move[i].seg;
+    layer[i] = move[i].layer;
+   }
+   layerScore.IfSetSegLayerBatch(moves,seg.Ptr(),layer.Ptr(),cost.Ptr());
+
+
+  // Find the best improving move for each segment, then sort them best first...
+   ds::Array<Choice> choice(moves);
+   nat32 choices = 0;
+   for (nat32 i=0;i<moves;i++)
+   {
+    if (cost[i]>=0.0) continue;
+    if ((choices!=0)&&(choice[choices-1].seg==seg[i]))
+    {
+     if (cost[i]<choice[choices-1].cost)
+     {
+      choice[choices-1].layer = layer[i];
+      choice[choices-1].cost = cost[i];
+     }
+    }
+    else
+    {
+     choice[choices].seg = seg[i];
+     choice[choices].layer = layer[i];
+     choice[choices].cost = cost[i];
+     ++choices;
+    }
+   }
+   if (choices==0) break;
+   
+   choice.Size(choices);
+   choice.SortNorm();
+
 
+  // Apply the moves in order, skipping any that involve a layer that has 
+  // allready been changed this iteration. Layers are identified by their head
+  // from before any changes, as moving a head changes it...
+   for (nat32 i=0;i<touched.Size();i++)
+   {
+    touched[i] = false;
+    label[i] = layers.SegToLayer(i);
+   }
+   nat32 applied = 0;
+   for (nat32 i=0;i<choices;i++)
+   {
+    nat32 from = label[choice[i].seg];
+    nat32 to = choice[i].layer;
+    if (touched[from]||touched[to]) continue;
+    touched[from] = true;
+    touched[to] = true;
+    
+    layers.SetSeglayer(choice[i].seg,to);
+    choice[applied++] = choice[i];
+   }
+   
+   layers.Refit(prog);
+   for (nat32 i=0;i<applied;i++) layerScore.OnSetSeglayer(choice[i].seg,choice[i].layer);
+ }
 
+ prog->Pop();
+}
 
 //------------------------------------------------------------------------------
  };
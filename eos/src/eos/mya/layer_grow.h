@@ -49,7 +49,13 @@ class EOS_CLASS LayerGrow
    ~LayerGrow();
 
 
+  /// Sets the maximum number of iterations, defaults to 32.
+   void SetMaxIters(nat32 maxIters);
+
   /// Applys a grow/shrink operation on the layer object from construction.
+  /// Each iteration scores every border move as a batch, then applys the best
+  /// move for each segment, best first, skipping any that involve a layer 
+  /// allready changed that iteration, as their scores are out of date.
    void operator () (time::Progress * prog = null<time::Progress*>()) const;
 
 
@@ -60,6 +66,28 @@ class EOS_CLASS LayerGrow
   svt::Field<nat32> segs;
   Layers & layers;
   LayerScore & layerScore;
+  
+  nat32 maxIters;
+  
+  // A potential move of a segment to a layer, sorted by segment then layer
+  // so duplicates can be removed...
+   struct Move
+   {
+    bit operator < (const Move & rhs) const {return (seg<rhs.seg)||((seg==rhs.seg)&&(layer<rhs.layer));}
+    
+    nat32 seg;
+    nat32 layer;
+   };
+   
+  // The best move for a segment, sorted by cost so the best go first...
+   struct Choice
+   {
+    bit operator < (const Choice & rhs) const {return cost<rhs.cost;}
+    
+    nat32 seg;
+    nat32 layer;
+    real32 cost;
+   };
 };
 
 //------------------------------------------------------------------------------
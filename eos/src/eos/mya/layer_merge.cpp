@@ -18,6 +18,7 @@
 #include "eos/mya/layer_merge.h"
 
 #include "eos/ds/arrays.h"
+#include "eos/ds/csr_graphs.h"
 #include "eos/ds/priority_queues.h"
 
 namespace eos
@@ -69,83 +70,108 @@ void LayerMerge::operator () (time::Progress * prog) const
     segToVert[i] = segToVert[layers.SegToLayer(i)];
    } 
    
-  // Make links between vertices...
-   nat32 edgeCount = 0; // Just so the heap can be reasonably initialised.
+  // Make links between vertices, via a compressed graph of the layer
+  // adjacencies so each link is only considered once...
+   ds::Array<nat32> segHead(layers.SegmentCount());
+   for (nat32 i=0;i<segHead.Size();i++) segHead[i] = layers.SegToLayer(i);
+
+   nat32 count = 0;
    for (nat32 y=0;y<segs.Size(1);y++)
    {
     for (nat32 x=0;x<segs.Size(0);x++)
     {
-     // Back...
-      if (x!=0)
+     nat32 here = segHead[segs.Get(x,y)];
+     if ((x!=0)&&(here!=segHead[segs.Get(x-1,y)])) ++count;
+     if ((y!=0)&&(here!=segHead[segs.Get(x,y-1)])) ++count;
+    }
+   }
+
+   ds::Array<ds::CsrGraph<nat32>::Edge> link(count);
+   count = 0;
+   for (nat32 y=0;y<segs.Size(1);y++)
+   {
+    for (nat32 x=0;x<segs.Size(0);x++)
+    {
+     nat32 here = segHead[segs.Get(x,y)];
+     if (x!=0)
+     {
+      nat32 there = segHead[segs.Get(x-1,y)];
+      if (here!=there)
       {
-       nat32 here = segs.Get(x,y);
-       nat32 there = segs.Get(x-1,y);
-       if (here!=there)
-       {
-        Vertex * hv = segToVert[here];
-        Vertex * tv = segToVert[there];
-        if (hv!=tv)
-        {
-         if (hv->Connection(tv)==null<ds::Edge*>())
-         {
-          new ds::Edge(graph,hv,tv);
-         }
-        }
-       }
+       link[count].from = here;
+       link[count].to = there;
+       link[count].weight = 1;
+       ++count;
       }
-      
-     // Up...
-      if (y!=0)
+     }
+
+     if (y!=0)
+     {
+      nat32 there = segHead[segs.Get(x,y-1)];
+      if (here!=there)
       {
-       nat32 here = segs.Get(x,y);
-       nat32 there = segs.Get(x,y-1);
-       if (here!=there)
-       {
-        Vertex * hv = segToVert[here];
-        Vertex * tv = segToVert[there];
-        if (hv!=tv)
-        {
-         if (hv->Connection(tv)==null<ds::Edge*>())
-         {
-          new ds::Edge(graph,hv,tv);
-         }
-        }
-       }      
+       link[count].from = here;
+       link[count].to = there;
+       link[count].weight = 1;
+       ++count;
       }
+     }
     }
    }
 
+   ds::CsrGraph<nat32> adj;
+   adj.Build(layers.SegmentCount(),link);
+   link.Size(0);
+
+   for (nat32 i=0;i<adj.Vertices();i++)
+   {
+    for (nat32 j=0;j<adj.Degree(i);j++)
+    {
+     nat32 n = adj.Neighbour(i,j);
+     if (i<n) new ds::Edge(graph,segToVert[i],segToVert[n]);
+    }
+   }
 
- // Build a heap with all the initial merge operations...
+
+ // Build a heap with all the initial merge operations, collecting them first 
+ // so their costs can be calculated in batches...
   prog->Report(1,3);
   prog->Push();
-  nat32 progPos = 0;
-  ds::PriorityQueue<Node> heap(edgeCount*2);
-  ds::List<ds::Vertex*>::Cursor vTarg = graph.VertexList();
-  while (!vTarg.Bad())
+  ds::Array<nat32> lay1(adj.Edges()/2);
+  ds::Array<nat32> lay2(adj.Edges()/2);
+  nat32 pairs = 0;
+  for (nat32 i=0;i<adj.Vertices();i++)
   {
-   prog->Report(progPos++,graph.Vertices());
-   ds::List<ds::Edge*>::Cursor eTarg = (*vTarg)->EdgeList();   
-   while (!eTarg.Bad())
+   for (nat32 j=0;j<adj.Degree(i);j++)
    {
-    Vertex * here = static_cast<Vertex*>(*vTarg);
-    Vertex * there = static_cast<Vertex*>((*eTarg)->From());
-    if (there==here) there = static_cast<Vertex*>((*eTarg)->To());
-    
-    if (here<there) // So we only add each pair once, to compensate for getting each edge twice.
+    nat32 n = adj.Neighbour(i,j);
+    if (i<n) // So we only add each pair once, to compensate for getting each edge twice.
     {
-     Node node;
-      node.seg1 = here->layer;
-      node.seg2 = there->layer;
-      node.cost = layerScore.IfMergeLayers(node.seg1,node.seg2);
-      node.seg1ver = headVer[node.seg1];
-      node.seg2ver = headVer[node.seg2];   
-     if (node.cost<bias) heap.Add(node);
+     lay1[pairs] = i;
+     lay2[pairs] = n;
+     ++pairs;
     }
-    
-    ++eTarg;
    }
-   ++vTarg;
+  }
+
+  ds::PriorityQueue<Node> heap(pairs);
+  ds::Array<real32> cost(pairs);
+  static const nat32 batch = 1024;
+  for (nat32 base=0;base<pairs;base+=batch)
+  {
+   prog->Report(base,pairs);
+   layerScore.IfMergeLayersBatch(math::Min(batch,pairs-base),lay1.Ptr()+base,lay2.Ptr()+base,cost.Ptr()+base);
+  }
+
+  for (nat32 i=0;i<pairs;i++)
+  {
+   Node node;
+    node.seg1 = lay1[i];
+    node.seg2 = lay2[i];
+    node.cost = cost[i];
+    node.seg1ver = headVer[node.seg1];
+    node.seg2ver = headVer[node.seg2];   
+   if (node.cost<bias) heap.Add(node);
   }
   prog->Pop();
   
@@ -183,7 +209,9 @@ void LayerMerge::operator () (time::Progress * prog) const
       segToVert[node.seg1]->layer = mergeHead;
       
       
-     // Add the new merges created to the heap...
+     // Add the new merges created to the heap, again calculating the costs as 
+     // a batch...
+      nat32 newPairs = 0;
       ds::List<ds::Edge*>::Cursor targ = segToVert[mergeHead]->EdgeList();
       while (!targ.Bad())
       {
@@ -191,15 +219,30 @@ void LayerMerge::operator () (time::Progress * prog) const
        Vertex * there = static_cast<Vertex*>((*targ)->From());
        if (there==here) there = static_cast<Vertex*>((*targ)->To());       
 
+       if (newPairs==lay1.Size())
+       {
+        lay1.Size(newPairs*2+8);
+        lay2.Size(newPairs*2+8);
+       }
+       lay1[newPairs] = here->layer;
+       lay2[newPairs] = there->layer;
+       ++newPairs;
+
+       ++targ;      
+      }
+
+      if (cost.Size()<newPairs) cost.Size(newPairs);
+      layerScore.IfMergeLayersBatch(newPairs,lay1.Ptr(),lay2.Ptr(),cost.Ptr());
+
+      for (nat32 i=0;i<newPairs;i++)
+      {
        Node node;
-        node.seg1 = here->layer;
-        node.seg2 = there->layer;
-        node.cost = layerScore.IfMergeLayers(node.seg1,node.seg2);
+        node.seg1 = lay1[i];
+        node.seg2 = lay2[i];
+        node.cost = cost[i];
         node.seg1ver = headVer[node.seg1];
         node.seg2ver = headVer[node.seg2];
        if (node.cost<bias) {heap.Add(node); ++progSize;}
-
-       ++targ;      
       }
     }
   }
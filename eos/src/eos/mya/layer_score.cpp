@@ -29,6 +29,60 @@ LayerScore::LayerScore(Layers & l)
 LayerScore::~LayerScore()
 {}
 
+void LayerScore::IfSetSegLayerBatch(nat32 count,const nat32 * seg,const nat32 * layer,real32 * out) const
+{
+ typedef ds::Array<bit> Flags;
+ ds::Array<Flags,mem::MakeNew<Flags>,mem::KillOnlyDel<Flags> > foi(batchSize*2);
+ ds::Array<real32> cost(batchSize*2);
+
+ for (nat32 base=0;base<count;base+=batchSize)
+ {
+  nat32 size = math::Min(batchSize,count-base);
+
+  // Prefetch the fittings for both layers after each change...
+   for (nat32 i=0;i<size;i++)
+   {
+    Flags & from = foi[i*2];
+    Flags & to = foi[i*2+1];
+    from.Size(layers.SegmentCount());
+    to.Size(layers.SegmentCount());
+
+    layers.GetLayerFlags(seg[base+i],from);
+    from[seg[base+i]] = false;
+    layers.GetLayerFlags(layer[base+i],to);
+    to[seg[base+i]] = true;
+   }
+   layers.LayerFitCosts(size*2,foi.Ptr(),cost.Ptr());
+
+  // Do the real thing...
+   for (nat32 i=0;i<size;i++) out[base+i] = IfSetSegLayer(seg[base+i],layer[base+i]);
+ }
+}
+
+void LayerScore::IfMergeLayersBatch(nat32 count,const nat32 * lay1,const nat32 * lay2,real32 * out) const
+{
+ typedef ds::Array<bit> Flags;
+ ds::Array<Flags,mem::MakeNew<Flags>,mem::KillOnlyDel<Flags> > foi(batchSize);
+ ds::Array<real32> cost(batchSize);
+
+ for (nat32 base=0;base<count;base+=batchSize)
+ {
+  nat32 size = math::Min(batchSize,count-base);
+
+  // Prefetch the fittings of the merged layers...
+   for (nat32 i=0;i<size;i++)
+   {
+    foi[i].Size(layers.SegmentCount());
+    layers.GetLayerFlags(lay1[base+i],foi[i],true);
+    layers.GetLayerFlags(lay2[base+i],foi[i],false);
+   }
+   layers.LayerFitCosts(size,foi.Ptr(),cost.Ptr());
+
+  // Do the real thing...
+   for (nat32 i=0;i<size;i++) out[base+i] = IfMergeLayers(lay1[base+i],lay2[base+i]);
+ }
+}
+
 void LayerScore::OnSetSeglayer(nat32,nat32)
 {}
 
@@ -158,13 +212,18 @@ void WarpScore::SetDisparityMult(real32 m)
  mult = m;
 }
 
+void WarpScore::SetCheck(bit enable)
+{
+ warp.SetCheck(enable);
+}
+
 real32 WarpScore::IfSetSegLayer(nat32 seg,nat32 layer) const
 {
  // Apply the change...
-  // Remove the segments that are members of the involved layers...
+  // Stash the segments that are members of the involved layers...
    layers.GetLayerFlags(seg,foiA);
    layers.GetLayerFlags(layer,foiB);
-   for (nat32 i=0;i<segCount;i++) if (foiA[i]||foiB[i]) warp.Remove(i);
+   for (nat32 i=0;i<segCount;i++) if (foiA[i]||foiB[i]) warp.Stash(i);
   
   // Re-fit the layers in question to the new surfaces...
    foiA[seg] = false;
@@ -184,23 +243,8 @@ real32 WarpScore::IfSetSegLayer(nat32 seg,nat32 layer) const
  // Record the score after change...
   real32 nScore = warp.Score();
 
- // Remove the change...
-  // Remove the involved segments...
-   for (nat32 i=0;i<segCount;i++) if (foiA[i]||foiB[i]) warp.Remove(i);
- 
-  // Adjust variables...
-   foiA[seg] = true;
-   foiB[seg] = false;
-
-   nsSeg   = layers.LayerToSurf(seg);
-   nsLayer = layers.LayerToSurf(layer);
-
-  // Write back involved segments...
-   for (nat32 i=0;i<segCount;i++)
-   {
-    if (foiA[i]) AddSeg(i,nsSeg);
-    else if (foiB[i]) AddSeg(i,nsLayer);
-   }   
+ // Remove the change, putting back the stashed rendering of the involved segments...
+  for (nat32 i=0;i<segCount;i++) if (foiA[i]||foiB[i]) warp.Restore(i);
  
  // Return the delta...
   return nScore - warp.Score();
@@ -209,12 +253,12 @@ real32 WarpScore::IfSetSegLayer(nat32 seg,nat32 layer) const
 real32 WarpScore::IfMergeLayers(nat32 lay1,nat32 lay2) const
 {
  // Apply the change...
-  // Remove the segments that are members of the involved layers...
+  // Stash the segments that are members of the involved layers...
    layers.GetLayerFlags(lay1,foiA);
    layers.GetLayerFlags(lay2,foiB);
    for (nat32 i=0;i<segCount;i++)
    {
-    if (foiA[i]||foiB[i]) {warp.Remove(i); foiC[i] = true;}
+    if (foiA[i]||foiB[i]) {warp.Stash(i); foiC[i] = true;}
                      else foiC[i] = false;
    }
    
@@ -227,14 +271,7 @@ real32 WarpScore::IfMergeLayers(nat32 lay1,nat32 lay2) const
   real32 nScore = warp.Score(); 
     
  // Remove the change...
-  Surface * osLay1 = layers.LayerToSurf(lay1);
-  Surface * osLay2 = layers.LayerToSurf(lay2);
-  
-  for (nat32 i=0;i<segCount;i++)
-  {
-   if (foiA[i]) AddSeg(i,osLay1);
-   else if (foiB[i]) AddSeg(i,osLay2);
-  }  
+  for (nat32 i=0;i<segCount;i++) if (foiC[i]) warp.Restore(i);
  
  // Return the delta...
   return nScore - warp.Score();
@@ -243,9 +280,9 @@ real32 WarpScore::IfMergeLayers(nat32 lay1,nat32 lay2) const
 real32 WarpScore::IfSeperate(nat32 seg) const
 {
  // Apply the change...
-  // Remove the layer in question...
+  // Stash the layer in question...
    layers.GetLayerFlags(seg,foiA);
-   for (nat32 i=0;i<segCount;i++) if (foiA[i]) warp.Remove(i);
+   for (nat32 i=0;i<segCount;i++) if (foiA[i]) warp.Stash(i);
  
   // Fit the relevent layers to new surfaces...
    foiA[seg] = false;
@@ -263,8 +300,7 @@ real32 WarpScore::IfSeperate(nat32 seg) const
     
  // Remove the change...
   foiA[seg] = true;
-  nsLayer = layers.LayerToSurf(seg);
-  for (nat32 i=0;i<segCount;i++) if (foiA[i]) AddSeg(i,nsLayer);
+  for (nat32 i=0;i<segCount;i++) if (foiA[i]) warp.Restore(i);
  
  // Return the delta...
   return nScore - warp.Score();
@@ -334,7 +370,7 @@ void WarpScore::AddSeg(nat32 seg,Surface * surface) const
     real32 start = targ->x + SurfaceDisp(surface,mult,targ->x,targ->y);
     real32 end = targ->x + 1.0 + SurfaceDisp(surface,mult,targ->x+1,targ->y);
     
-    real32 mult = 1.0/(end-start);
+    real32 spanMult = 1.0/(end-start);
     real32 base = start;
     
     if (targ->incStart) start = targ->x-0.5 + SurfaceDisp(surface,mult,targ->x-0.5,targ->y);
@@ -344,7 +380,7 @@ void WarpScore::AddSeg(nat32 seg,Surface * surface) const
    // For each integer in the range interpolate a colour and write...
     for (nat32 i=math::Max<int32>(int32(math::RoundUp(start)),0);(real32(i)<end)&&(i<width);i++)
     {
-     real32 t = (real32(i)-base)*mult;
+     real32 t = (real32(i)-base)*spanMult;
      bs::ColourRGB colour;
       colour.r = (1.0-t)*targ->colour.r + t*targ->next->colour.r;
       colour.g = (1.0-t)*targ->colour.g + t*targ->next->colour.g;
@@ -68,6 +68,17 @@ class EOS_CLASS LayerScore : public Deletable
    virtual real32 IfSeperate(nat32 seg) const = 0;
 
 
+  /// Batch version of IfSetSegLayer, outputs the result for each of count
+  /// seg/layer pairs into out. The default fits all the involved layer 
+  /// configurations in one go with Layers::LayerFitCosts, so they can be done 
+  /// in parallel, and then calls IfSetSegLayer for each, which finds them in
+  /// the cache. The results are identical to calling IfSetSegLayer in turn.
+   virtual void IfSetSegLayerBatch(nat32 count,const nat32 * seg,const nat32 * layer,real32 * out) const;
+
+  /// Batch version of IfMergeLayers, as for IfSetSegLayerBatch.
+   virtual void IfMergeLayersBatch(nat32 count,const nat32 * lay1,const nat32 * lay2,real32 * out) const;
+
+
   /// Called when the equivalent is called for the layer object, after any call to Rebuild().
    virtual void OnSetSeglayer(nat32 seg,nat32 layer);
    
@@ -87,6 +98,9 @@ class EOS_CLASS LayerScore : public Deletable
 
  protected:
   Layers & layers;
+  
+  // How many operations the batch methods prefetch at a time...
+   static const nat32 batchSize = 64;
 };
 
 //------------------------------------------------------------------------------
@@ -147,6 +161,10 @@ class EOS_CLASS WarpScore : public LayerScore
   /// defaults to 1.
    void SetDisparityMult(real32 mult);
 
+  /// Debugging aid, makes every score the warp produces get checked against a
+  /// full recalculation, see stereo::WarpInc::SetCheck.
+   void SetCheck(bit enable);
+
  
   /// &nbsp;
    real32 IfSetSegLayer(nat32 seg,nat32 layer) const;
@@ -17,13 +17,44 @@
 
 #include "eos/mya/layers.h"
 
+#include "eos/mt/tasks.h"
+#include "eos/log/profile.h"
+
 namespace eos
 {
  namespace mya
  {
+//------------------------------------------------------------------------------
+// Helper for Layers::FitBatch - fits a range of configurations, each to its
+// own output...
+class LayerFitTask
+{
+ public:
+  LayerFitTask(const Layers & l,const ds::Array<nat32> * ss,real32 * sc,Surface ** su)
+  :layers(l),segSet(ss),score(sc),surf(su) {}
+
+  void operator () (nat32 b,nat32 e) const
+  {
+   for (nat32 i=b;i<e;i++)
+   {
+    score[i] = 1e10;
+    surf[i] = layers.SegFitInt(segSet[i],score[i]);
+   }
+  }
+
+
+ private:
+  const Layers & layers;
+  const ds::Array<nat32> * segSet;
+  real32 * score;
+  Surface ** surf;
+};
+
 //------------------------------------------------------------------------------
 Layers::Layers()
-:fa(Prune),random(null<data::Random*>())
+:fa(Prune),random(null<data::Random*>()),
+cacheFront(null<CacheNode*>()),cacheBack(null<CacheNode*>()),cacheLimit(256*1024*1024),
+cacheMemory(0),cacheHits(0),cacheMisses(0),cacheEvictions(0)
 {}
 
 Layers::~Layers()
@@ -105,41 +136,105 @@ void Layers::Commit(time::Progress * prog)
       for (nat32 k=0;k<da[i].surfData[j].Size();k++) da[i].surfData[j][k].vec.SetSize(da[i].ied->Length());
      }
      
-    // Now fill it with data...
+    // Now fill it with data, a row of features at a time...
      for (nat32 j=0;j<data.Size();j++) segValidSize[j] = 0;
+     nat32 width = segs.Size(0);
+     nat32 length = da[i].ied->Length();
+     ds::Array<real32> row(length*width);
+     ds::Array<bit> rowValid(width);
      for (nat32 y=0;y<segs.Size(1);y++)
      {
-      for (nat32 x=0;x<segs.Size(0);x++)
+      da[i].ied->FeatureRow(y,0,width,row.Ptr(),rowValid.Ptr());
+      for (nat32 x=0;x<width;x++)
       {
-       NodeSample & targ = da[i].surfData[segs.Get(x,y)][segValidSize[segs.Get(x,y)]];
-       if (da[i].ied->Feature(x,y,targ.vec))
-       {
-        targ.x = (2.0*x)/segs.Size(0) - 1.0;
-        targ.y = (2.0*y)/segs.Size(0) - 1.0;
-        segValidSize[segs.Get(x,y)] += 1;
-       }
+       if (rowValid[x]==false) continue;
+       nat32 seg = segs.Get(x,y);
+       NodeSample & targ = da[i].surfData[seg][segValidSize[seg]];
+       for (nat32 k=0;k<length;k++) targ.vec[k] = row[k*width+x];
+       targ.x = (2.0*x)/width - 1.0;
+       targ.y = (2.0*y)/width - 1.0;
+       segValidSize[seg] += 1;
       }
      }  
    }
    delete[] segValidSize;
    
    
-  // Build the data structure, fitting surfaces to each segment...
+  // Work out which data sources each surface type can use, so fitting never
+  // has to touch the token table...
+   fitType.Size(sa.Size()*da.Size());
+   for (nat32 i=0;i<sa.Size();i++)
+   {
+    for (nat32 j=0;j<da.Size();j++)
+    {
+     FitType & targ = fitType[i*da.Size()+j];
+     str::Token dataType = da[j].ied->Type(tt);
+     targ.supported = sa[i].type->Supports(tt,dataType,targ.outType);
+    }
+   }
+
+
+  // Build the data structure, fitting surfaces to each segment, in batches so
+  // the fitting can be done in parallel. Eviction is held off until all are
+  // done, as the layers are not yet valid for deciding whats in use...
    layers = data.Size();
    prog->Report(1,2);
    prog->Push();
    for (nat32 i=0;i<data.Size();i++)
    {
-    prog->Report(i,data.Size());
     data[i].parent = null<Node*>();
     data[i].seg = i;
     data[i].editted = false;
-    data[i].segSize = 0;    
-    
-    data[i].surface = SegFit(i,data[i].cost);
-    if (data[i].surface==null<Surface*>()) data[i].cost = 1e10;
+    data[i].segSize = 0;
+    data[i].surface = null<Surface*>();
+    data[i].cost = 1e10;
     data[i].pixels = 0;
    }
+
+   nat64 oldLimit = cacheLimit;
+   cacheLimit = 0;
+   {
+    static const nat32 batch = 1024;
+    ds::Array<CacheNode*> key(batch);
+    ds::Array<nat32> seg(batch);
+    SegSetArray segSet(batch);
+    for (nat32 i=0;i<batch;i++) segSet[i].Size(1);
+
+    for (nat32 base=0;base<data.Size();base+=batch)
+    {
+     prog->Report(base,data.Size());
+     nat32 count = 0;
+     for (nat32 i=base;(i<data.Size())&&(i<base+batch);i++)
+     {
+      CacheNode node(SegmentCount());
+       node.AddMember(i);
+      CacheNode * targ = CacheFind(node);
+      if (targ)
+      {
+       data[i].surface = targ->GetSurface();
+       data[i].cost = targ->GetScore();
+      }
+      else
+      {
+       key[count] = new CacheNode(SegmentCount());
+       key[count]->AddMember(i);
+       seg[count] = i;
+       segSet[count][0] = i;
+       ++count;
+      }
+     }
+
+     ds::Array<real32> score(count);
+     ds::Array<Surface*> surf(count);
+     FitBatch(count,key.Ptr(),segSet.Ptr(),score.Ptr(),surf.Ptr());
+     for (nat32 i=0;i<count;i++)
+     {
+      data[seg[i]].surface = surf[i];
+      data[seg[i]].cost = (surf[i]==null<Surface*>())?1e10:score[i];
+     }
+    }
+   }
+   cacheLimit = oldLimit;
    prog->Pop();
    
   // Iterate all segments, to sum up the segSize/pixels counts...
@@ -153,6 +248,9 @@ void Layers::Commit(time::Progress * prog)
     }
    }
 
+ // Now the layers are setup the cache can be trimmed down to its limit...
+  if ((cacheLimit!=0)&&(cacheMemory>cacheLimit)) CacheEvict();
+
  prog->Pop();
 }
 
@@ -294,6 +392,30 @@ void Layers::Seperate(nat32 seg)
 void Layers::Refit(time::Progress * prog)
 {
  prog->Push();
+  // Fit the editted layers in batches, so it can be done in parallel...
+  {
+   static const nat32 batch = 256;
+   ds::Array<ds::Array<bit>,mem::MakeNew<ds::Array<bit> >,mem::KillOnlyDel<ds::Array<bit> > > lf(batch);
+   ds::Array<real32> cost(batch);
+   for (nat32 i=0;i<batch;i++) lf[i].Size(data.Size());
+
+   nat32 count = 0;
+   for (nat32 i=0;i<data.Size();i++)
+   {
+    if ((data[i].editted)&&(data[i].parent==null<Node*>()))
+    {
+     GetLayerFlags(i,lf[count]);
+     ++count;
+    }
+    if ((count==batch)||((i+1==data.Size())&&(count!=0)))
+    {
+     LayerFitCosts(count,lf.Ptr(),cost.Ptr());
+     count = 0;
+    }
+   }
+  }
+
+  // Collect the results, which are all now in the cache...
   ds::Array<bit> foi(data.Size());
   for (nat32 i=0;i<data.Size();i++)
   {
@@ -312,26 +434,25 @@ Surface * Layers::SegFit(nat32 seg,real32 & cost) const
  // Check if ths answer is allready cached, if so use the cached version...
   CacheNode node(SegmentCount());
    node.AddMember(seg);
-  CacheNode ** targ = cache.Get(&node);
-  if (targ!=null<CacheNode**>())
+  CacheNode * targ = CacheFind(node);
+  if (targ)
   {
-   log::Assert(*targ);
-   cost = (*targ)->GetScore();
-   return (*targ)->GetSurface();
+   cost = targ->GetScore();
+   return targ->GetSurface();
   }
 
  // Setup the segSet array...
-  segSet.Size(1);
+  ds::Array<nat32> segSet(1);
   segSet[0] = seg;
 
  // Calculate and store in the cache the best fit surface...
-  Surface * ret = SegFitInt(cost);
+  Surface * ret = SegFitInt(segSet,cost);
   
   CacheNode * nn = new CacheNode(SegmentCount());
    nn->AddMember(seg);  
    nn->SetScore(cost);
    nn->SetSurface(ret);
-  cache.Add(nn);
+  CacheAdd(nn);
 
  // Return the best fitted surface...   
   return ret;
@@ -349,29 +470,29 @@ Surface * Layers::LayerFit(const ds::Array<bit> & foi,real32 & cost) const
  // Check if the answer is allready cached, if so use the cached version...
   CacheNode node(SegmentCount());
    node.AddMembers(foi);
-  CacheNode ** targ = cache.Get(&node);
-  if (targ!=null<CacheNode**>())
+  CacheNode * targ = CacheFind(node);
+  if (targ)
   {
-   cost = (*targ)->GetScore();
-   return (*targ)->GetSurface();
+   cost = targ->GetScore();
+   return targ->GetSurface();
   }
   
  // Setup the segSet array...
   nat32 segCount = 0;
   for (nat32 i=0;i<foi.Size();i++) if (foi[i]) ++segCount;
-  segSet.Size(segCount);
+  ds::Array<nat32> segSet(segCount);
   
   segCount = 0;
   for (nat32 i=0;i<foi.Size();i++) if (foi[i]) segSet[segCount++] = i;
 
  // Calculate and store in the cache the best fit surface...
-  Surface * ret = SegFitInt(cost);
+  Surface * ret = SegFitInt(segSet,cost);
   
   CacheNode * nn = new CacheNode(SegmentCount());  
    nn->AddMembers(foi);
    nn->SetScore(cost);
    nn->SetSurface(ret);
-  cache.Add(nn);
+  CacheAdd(nn);
   
  // Return the best fitted surface...   
   return ret;
@@ -384,6 +505,174 @@ real32 Layers::LayerFitCost(const ds::Array<bit> & foi) const
  return ret;
 }
 
+void Layers::LayerFitCosts(nat32 count,const ds::Array<bit> * foi,real32 * cost) const
+{
+ LogTime("eos::mya::Layers::LayerFitCosts");
+
+ // Answer everything that is in the cache, collecting the rest...
+  ds::Array<nat32> miss(count);
+  ds::Array<CacheNode*> key(count);
+  nat32 missCount = 0;
+  for (nat32 i=0;i<count;i++)
+  {
+   CacheNode node(SegmentCount());
+    node.AddMembers(foi[i]);
+   CacheNode * targ = CacheFind(node);
+   if (targ) cost[i] = targ->GetScore();
+   else
+   {
+    miss[missCount] = i;
+    key[missCount] = new CacheNode(SegmentCount());
+    key[missCount]->AddMembers(foi[i]);
+    ++missCount;
+   }
+  }
+  if (missCount==0) return;
+
+ // Convert the misses to segment sets and fit them...
+  SegSetArray segSet(missCount);
+  for (nat32 i=0;i<missCount;i++)
+  {
+   const ds::Array<bit> & f = foi[miss[i]];
+   nat32 segCount = 0;
+   for (nat32 j=0;j<f.Size();j++) if (f[j]) ++segCount;
+   segSet[i].Size(segCount);
+
+   segCount = 0;
+   for (nat32 j=0;j<f.Size();j++) if (f[j]) segSet[i][segCount++] = j;
+  }
+
+  ds::Array<real32> score(missCount);
+  FitBatch(missCount,key.Ptr(),segSet.Ptr(),score.Ptr());
+  for (nat32 i=0;i<missCount;i++) cost[miss[i]] = score[i];
+}
+
+void Layers::FitBatch(nat32 count,CacheNode ** key,const ds::Array<nat32> * segSet,real32 * score,Surface ** surf) const
+{
+ // Do the fitting, in parallel unless ransac needs the random number generator...
+  ds::Array<Surface*> fit(count);
+  LayerFitTask lft(*this,segSet,score,fit.Ptr());
+  if (fa==Ransac) lft(0,count);
+             else mt::ParallelFor(nat32(0),count,lft);
+
+ // Store the results in the cache, in the same order as the serial version
+ // would have, merging any configurations that appeared more than once...
+  for (nat32 i=0;i<count;i++)
+  {
+   CacheNode ** dup = cache.Get(key[i]);
+   if (dup)
+   {
+    delete fit[i];
+    delete key[i];
+    score[i] = (*dup)->GetScore();
+    if (surf) surf[i] = (*dup)->GetSurface();
+    continue;
+   }
+
+   key[i]->SetScore(score[i]);
+   key[i]->SetSurface(fit[i]);
+   if (surf) surf[i] = fit[i];
+   CacheAdd(key[i]);
+  }
+}
+
+Layers::CacheNode * Layers::CacheFind(const CacheNode & key) const
+{
+ CacheNode ** targ = cache.Get(const_cast<CacheNode*>(&key));
+ if (targ==null<CacheNode**>())
+ {
+  ++cacheMisses;
+  LogCount("eos::mya::Layers cache miss",1);
+  return null<CacheNode*>();
+ }
+ ++cacheHits;
+ LogCount("eos::mya::Layers cache hit",1);
+
+ // Move to the front of the chain, unless its the dummy which is not in it...
+  CacheNode * ret = *targ;
+  log::Assert(ret);
+  if (ret->prev)
+  {
+   ret->prev->next = ret->next;
+   if (ret->next) ret->next->prev = ret->prev;
+             else cacheBack = ret->prev;
+
+   ret->prev = null<CacheNode*>();
+   ret->next = cacheFront;
+   cacheFront->prev = ret;
+   cacheFront = ret;
+  }
+ return ret;
+}
+
+void Layers::CacheAdd(CacheNode * nn) const
+{
+ cache.Add(nn);
+
+ nn->prev = null<CacheNode*>();
+ nn->next = cacheFront;
+ if (cacheFront) cacheFront->prev = nn;
+            else cacheBack = nn;
+ cacheFront = nn;
+ cacheMemory += nn->Memory();
+
+ if ((cacheLimit!=0)&&(cacheMemory>cacheLimit)) CacheEvict();
+}
+
+void Layers::CacheEvict() const
+{
+ LogTime("eos::mya::Layers::CacheEvict");
+
+ // Collect the surfaces in use by layers, sorted so they can be searched...
+  ds::Array<Surface*> inUse(data.Size());
+  nat32 used = 0;
+  for (nat32 i=0;i<data.Size();i++)
+  {
+   if ((data[i].parent==null<Node*>())&&(data[i].surface)) inUse[used++] = data[i].surface;
+  }
+  inUse.Size(used);
+  inUse.SortNorm();
+
+ // Find the last of the entries that are kept for being recent...
+  CacheNode * stop = cacheFront;
+  for (nat32 i=0;(i<cacheKeep)&&stop;i++) stop = stop->next;
+
+ // Walk from the back, discarding until under the target...
+  nat64 target = cacheLimit - (cacheLimit>>2);
+  CacheNode * targ = cacheBack;
+  while ((targ!=stop)&&(cacheMemory>target))
+  {
+   CacheNode * victim = targ;
+   targ = targ->prev;
+
+   // Skip if a layer is using it...
+    Surface * surf = victim->GetSurface();
+    if (surf)
+    {
+     nat32 low = 0;
+     nat32 high = used;
+     while (low<high)
+     {
+      nat32 mid = (low+high)/2;
+      if (inUse[mid]<surf) low = mid+1;
+                      else high = mid;
+     }
+     if ((low<used)&&(inUse[low]==surf)) continue;
+    }
+
+   // Unlink and delete...
+    if (victim->prev) victim->prev->next = victim->next;
+                 else cacheFront = victim->next;
+    if (victim->next) victim->next->prev = victim->prev;
+                 else cacheBack = victim->prev;
+
+    cacheMemory -= victim->Memory();
+    ++cacheEvictions;
+    LogCount("eos::mya::Layers cache eviction",1);
+    cache.Rem(victim);
+  }
+}
+
 real32 Layers::GetDepth(real32 limit,real32 x,real32 y)
 {
  // Get segment numbers for each corner, taking care of the borders...
@@ -622,12 +911,19 @@ void Layers::IntCoord(const math::Vect<2> & in,math::Vect<2> & out)
  out[1] = 2.0*in[1]/real32(segs.Size(0)) - 1.0;
 }
  
-Surface * Layers::SegFitInt(real32 & bestScore) const
+Surface * Layers::SegFitInt(const ds::Array<nat32> & segSet,real32 & bestScore) const
 {
  // Iterate each surface type and generate the best surface,
  // return the surface with the least number of weighted outliers...
   Surface * best = null<Surface*>();
-  ds::Array<NodeIed*> lda;
+  ds::Array<FitData> lda;
+  ds::Array<nat32> sampleCount(da.Size());
+  for (nat32 j=0;j<da.Size();j++)
+  {
+   sampleCount[j] = 0;
+   for (nat32 k=0;k<segSet.Size();k++) sampleCount[j] += da[j].surfData[segSet[k]].Size();
+  }
+
   for (nat32 i=0;i<sa.Size();i++)
   {
    // Check if we have enough data to even concider fitting this surface type,
@@ -638,15 +934,11 @@ Surface * Layers::SegFitInt(real32 & bestScore) const
     nat32 totalDTS = 0;
     for (nat32 j=0;j<da.Size();j++)
     {
-     str::Token dataType = da[j].ied->Type(tt);
-     nat32 outType;
-     if (sa[i].type->Supports(tt,dataType,outType))
+     const FitType & ft = fitType[i*da.Size()+j];
+     if (ft.supported)
      {
       ++totalDTS;
-      da[j].sampleCount = 0;
-      for (nat32 k=0;k<segSet.Size();k++) da[j].sampleCount += da[j].surfData[segSet[k]].Size();
-      
-      totalInfo += sa[i].type->TypeDegrees(outType) * da[j].sampleCount;
+      totalInfo += sa[i].type->TypeDegrees(ft.outType) * sampleCount[j];
      }
     }    
     nat32 reqInfo = sa[i].type->Degrees();
@@ -660,14 +952,14 @@ Surface * Layers::SegFitInt(real32 & bestScore) const
     nat32 totalSamples = 0;
     for (nat32 j=0;j<da.Size();j++)
     {
-     str::Token dataType = da[j].ied->Type(tt);
-     nat32 outType;
-     if (sa[i].type->Supports(tt,dataType,outType))
+     const FitType & ft = fitType[i*da.Size()+j];
+     if (ft.supported)
      {
-      lda[pos] = &da[j];
-      lda[pos]->ind = outType;
-      lda[pos]->sampleSum = totalSamples;
-      totalSamples += lda[pos]->sampleCount;
+      lda[pos].node = &da[j];
+      lda[pos].ind = ft.outType;
+      lda[pos].sampleCount = sampleCount[j];
+      lda[pos].sampleSum = totalSamples;
+      totalSamples += sampleCount[j];
       ++pos;
      }
     }
@@ -675,7 +967,7 @@ Surface * Layers::SegFitInt(real32 & bestScore) const
    
    // Do the fitting, factor in weighting...
     real32 score;    
-    Surface * surface = SegFitInt(lfa,sa[i],lda,score);
+    Surface * surface = SegFitInt(lfa,sa[i],lda,segSet,score);
     if (surface)
     {
      score *= sa[i].weight;
@@ -694,7 +986,7 @@ Surface * Layers::SegFitInt(real32 & bestScore) const
  return best;
 }
 
-Surface * Layers::SegFitInt(FitAlg lfa,NodeSurface & st,const ds::Array<NodeIed*> & ds,real32 & out) const
+Surface * Layers::SegFitInt(FitAlg lfa,const NodeSurface & st,const ds::Array<FitData> & ds,const ds::Array<nat32> & segSet,real32 & out) const
 {
  // First create an initial fitting, if its the prune method we just fit all the
  // data, otherwise its ransac time...
@@ -705,7 +997,7 @@ Surface * Layers::SegFitInt(FitAlg lfa,NodeSurface & st,const ds::Array<NodeIed*
    // Do ransac, iterate giving a minimal number of samples, finally selecting 
    // the solution with the most inliers...
    // (We use the standard finishing condition.)
-    nat32 dataAvaliable = ds[ds.Size()-1]->sampleSum + ds[ds.Size()-1]->sampleCount;
+    nat32 dataAvaliable = ds[ds.Size()-1].sampleSum + ds[ds.Size()-1].sampleCount;
    
     ret = null<Surface*>(); // ret is the best surface found.
     nat32 mostInliers = st.type->Degrees();
@@ -724,22 +1016,22 @@ Surface * Layers::SegFitInt(FitAlg lfa,NodeSurface & st,const ds::Array<NodeIed*
         nat32 db = 0;
         for (;db<ds.Size();db++)
         {
-         if (val<ds[db]->sampleCount) break;
-         val -= ds[db]->sampleCount;
+         if (val<ds[db].sampleCount) break;
+         val -= ds[db].sampleCount;
         }
         
        // Calculate which segment in the data block its in...       
         nat32 sb = 0;
         for (;sb<segSet.Size();sb++)
         {
-         if (val<ds[db]->surfData[segSet[sb]].Size()) break;
-         val -= ds[db]->surfData[segSet[sb]].Size();
+         if (val<ds[db].node->surfData[segSet[sb]].Size()) break;
+         val -= ds[db].node->surfData[segSet[sb]].Size();
         }
        
        // Add the entry in, if the fitter reports it is now satisfied we then break...
-        NodeSample & targ = ds[db]->surfData[segSet[sb]][val];
+        NodeSample & targ = ds[db].node->surfData[segSet[sb]][val];
                       
-        if (fitter->Add(ds[db]->ind,targ.x,targ.y,targ.vec)) break;
+        if (fitter->Add(ds[db].ind,targ.x,targ.y,targ.vec)) break;
       }
       Surface * calc = st.type->NewSurface();
       if (fitter->Extract(*calc)==false)
@@ -748,21 +1040,24 @@ Surface * Layers::SegFitInt(FitAlg lfa,NodeSurface & st,const ds::Array<NodeIed*
        continue;
       }      
      
-     // Count the inliers and outliers...
+     // Count the inliers and outliers, giving up early, a segment at a time, 
+     // once it can no longer beat the best so far...
       nat32 inlierC = 0;
       nat32 outlierC = 0;
       for (nat32 i=0;i<ds.Size();i++)
       {
        for (nat32 j=0;j<segSet.Size();j++)
        {
-        for (nat32 l=0;l<ds[i]->surfData[segSet[j]].Size();l++)
+        for (nat32 l=0;l<ds[i].node->surfData[segSet[j]].Size();l++)
         {
-         NodeSample & targ = ds[i]->surfData[segSet[j]][l];
-         real32 dist = ds[i]->ied->FitCost(targ.vec,*calc,targ.x,targ.y);
-         if (dist<ds[i]->cutoff) ++inlierC;
+         NodeSample & targ = ds[i].node->surfData[segSet[j]][l];
+         real32 dist = ds[i].node->ied->FitCost(targ.vec,*calc,targ.x,targ.y);
+         if (dist<ds[i].node->cutoff) ++inlierC;
                            else ++outlierC;
         }
+        if (dataAvaliable-outlierC<=mostInliers) break;
        }
+       if (dataAvaliable-outlierC<=mostInliers) break;
       }
       
      // If an improvment record it...
@@ -791,11 +1086,11 @@ Surface * Layers::SegFitInt(FitAlg lfa,NodeSurface & st,const ds::Array<NodeIed*
     {
      for (nat32 j=0;j<segSet.Size();j++)
      {
-      for (nat32 l=0;l<ds[i]->surfData[segSet[j]].Size();l++)
+      for (nat32 l=0;l<ds[i].node->surfData[segSet[j]].Size();l++)
       {
-       NodeSample & targ = ds[i]->surfData[segSet[j]][l];
+       NodeSample & targ = ds[i].node->surfData[segSet[j]][l];
        
-       fitter->Add(ds[i]->ind,targ.x,targ.y,targ.vec);
+       fitter->Add(ds[i].ind,targ.x,targ.y,targ.vec);
       }
      }
     }
@@ -824,14 +1119,14 @@ Surface * Layers::SegFitInt(FitAlg lfa,NodeSurface & st,const ds::Array<NodeIed*
       {
        for (nat32 j=0;j<segSet.Size();j++)
        {
-        for (nat32 l=0;l<ds[i]->surfData[segSet[j]].Size();l++)
+        for (nat32 l=0;l<ds[i].node->surfData[segSet[j]].Size();l++)
         {
-         NodeSample & targ = ds[i]->surfData[segSet[j]][l];
+         NodeSample & targ = ds[i].node->surfData[segSet[j]][l];
         
-         real32 dist = ds[i]->ied->FitCost(targ.vec,*ret,targ.x,targ.y);
-         if (dist<=ds[i]->cutoff)
+         real32 dist = ds[i].node->ied->FitCost(targ.vec,*ret,targ.x,targ.y);
+         if (dist<=ds[i].node->cutoff)
          {
-          fitter->Add(ds[i]->ind,targ.x,targ.y,targ.vec);
+          fitter->Add(ds[i].ind,targ.x,targ.y,targ.vec);
           ++inlierCount;
          }
         }
@@ -868,14 +1163,14 @@ Surface * Layers::SegFitInt(FitAlg lfa,NodeSurface & st,const ds::Array<NodeIed*
    out = 0.0;   
    for (nat32 i=0;i<ds.Size();i++)
    {
-    real32 cop = math::Exp(-math::Sqr(ds[i]->cutoff));
+    real32 cop = math::Exp(-math::Sqr(ds[i].node->cutoff));
     for (nat32 j=0;j<segSet.Size();j++)
     {
-     for (nat32 l=0;l<ds[i]->surfData[segSet[j]].Size();l++)
+     for (nat32 l=0;l<ds[i].node->surfData[segSet[j]].Size();l++)
      {
-      NodeSample & targ = ds[i]->surfData[segSet[j]][l];
+      NodeSample & targ = ds[i].node->surfData[segSet[j]][l];
        
-      real32 dist = ds[i]->ied->FitCost(targ.vec,*ret,targ.x,targ.y);
+      real32 dist = ds[i].node->ied->FitCost(targ.vec,*ret,targ.x,targ.y);
       out += -math::Ln(math::Exp(-math::Sqr(dist))+cop);
      }
     }
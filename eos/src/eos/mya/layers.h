@@ -194,6 +194,13 @@ class EOS_CLASS Layers
    // hypothetical configurations. Uses the caching system, so the surface is actually
    // generated, so further calls to LayerFit will be optimised.
     real32 LayerFitCost(const ds::Array<bit> & foi) const;
+
+   /// The batch version of LayerFitCost, outputs the cost for each of count
+   /// configurations. The configurations not allready in the cache are fitted
+   /// in parallel, unless the fitting method is ransac, which shares the one
+   /// random number generator. The results are identical to calling
+   /// LayerFitCost for each in turn.
+    void LayerFitCosts(nat32 count,const ds::Array<bit> * foi,real32 * cost) const;
     
 
   // Result extractors...
@@ -242,6 +249,38 @@ class EOS_CLASS Layers
   /// Transilates from image coordinates to the normalised coordinates used
   /// internaly by this class, for if you want to use the Surface objects directly.
    void IntCoord(const math::Vect<2> & in,math::Vect<2> & out);
+
+
+  // Fitting cache...
+   /// Sets the approximate memory limit, in bytes, of the cache of fitted layer
+   /// configurations. When exceeded the least recently used configurations are
+   /// discarded, down to three quarters of the limit, except for those in use by
+   /// a layer and the most recent few, so a Surface returned by SegFit or
+   /// LayerFit remains valid for at least the next few fits. The memory counted
+   /// is that of the keys, which dominates with a lot of segments, plus a fixed
+   /// overhead per configuration. 0 means no limit. Defaults to 256 meg.
+    void SetCacheLimit(nat64 bytes) {cacheLimit = bytes;}
+
+   /// &nbsp;
+    nat64 GetCacheLimit() const {return cacheLimit;}
+
+   /// Returns the memory currently counted against the cache limit.
+    nat64 CacheMemory() const {return cacheMemory;}
+
+   /// Returns how many layer configurations are currently cached.
+    nat32 CacheEntries() const {return cache.Size();}
+
+   /// Returns how many fits have been answered from the cache.
+    nat64 CacheHits() const {return cacheHits;}
+
+   /// Returns how many fits had to be calculated.
+    nat64 CacheMisses() const {return cacheMisses;}
+
+   /// Returns how many configurations have been discarded to stay within the limit.
+    nat64 CacheEvictions() const {return cacheEvictions;}
+
+   /// Zeros the hit, miss and eviction counts.
+    void ResetCacheStats() {cacheHits = 0; cacheMisses = 0; cacheEvictions = 0;}
   
   
   /// &nbsp;
@@ -254,6 +293,8 @@ class EOS_CLASS Layers
    static const nat32 maxPruneIter = 64; // Maximum number of iterations it will do before giving up on improving the surface as part of the prune and ransac fitting algorithms.
    static const real32 ransacProb = 0.99; // Probability of success for the ransac algorithm.
    static const nat32 maxRansacIter = 10000; // Maximum number of ransac iterations, to keep things moving.
+   static const nat32 cacheKeep = 16; // The most recently used cache entries are never evicted, so returned surfaces stay valid for a while.
+   static const nat32 cacheOverhead = 96; // Approximate bytes per cache entry, excluding the key.
  
   // An internal token table, used for comunicating between plugin surface types and data sources...
    mutable str::TokenTable tt;
@@ -280,13 +321,21 @@ class EOS_CLASS Layers
     // for all valid pixels for each segment.
      typedef ds::Array<NodeSample,mem::MakeNew<NodeSample>,mem::KillOnlyDel<NodeSample> > SampleArray;
      ds::Array<SampleArray,mem::MakeNew<SampleArray>,mem::KillOnlyDel<SampleArray> > surfData;    
-     
-    // Some data used by the fitting algorithm during runtime, simply for conveniance of passing arround...
-     mutable nat32 ind; // Type index, to be used when passing to the surface.
-     mutable nat32 sampleCount; // Number of samples.
-     mutable nat32 sampleSum; // Sum of samples upto but excluding here, for weighted random selection of NodeIed.
    };
    ds::Array<NodeIed,mem::MakeNew<NodeIed>,mem::KillOnlyDel<NodeIed> > da;
+
+  // Some data used by the fitting algorithm during runtime, for a data source,
+  // kept seperate from NodeIed so multiple fits can run at once...
+   struct FitData
+   {
+    const NodeIed * node;
+    nat32 ind; // Type index, to be used when passing to the surface.
+    nat32 sampleCount; // Number of samples.
+    nat32 sampleSum; // Sum of samples upto but excluding here, for weighted random selection of NodeIed.
+   };
+
+  // An array of segment sets, one for each configuration in a batch fit...
+   typedef ds::Array<ds::Array<nat32>,mem::MakeNew<ds::Array<nat32> >,mem::KillOnlyDel<ds::Array<nat32> > > SegSetArray;
    
   // Surface types...
    struct NodeSurface
@@ -296,11 +345,15 @@ class EOS_CLASS Layers
    };
    ds::Array<NodeSurface> sa;
 
-
-  // An internal data structure used during fitting in collaboration with the
-  // da object - an array of numbers where each number indicates a segment thats
-  // a member of the layer to which we are fitting.
-   mutable ds::Array<nat32> segSet;
+  // Which data sources each surface type supports, and as what type, indexed
+  // [surface type * da.Size() + data source]. Filled in by Commit, so the
+  // token table is not touched during fitting...
+   struct FitType
+   {
+    bit supported;
+    nat32 outType;
+   };
+   ds::Array<FitType> fitType;
 
   // Assignment of segment numbers to layers, represented by a forest...
    struct Node
@@ -327,22 +380,34 @@ class EOS_CLASS Layers
 
   // The caching system, to stop duplicate calculation...
    // This represents an item used to store a layer-configuration and its
-   // resulting surface and score...
+   // resulting surface and score. The key is a bit for each segment, plus a
+   // 64 bit fingerprint of it, maintained as members are added, so most
+   // comparisons never have to look at the bits...
     class CacheNode
     {
      public:
        CacheNode(nat32 sCount)
-       :segCount(sCount),bits(mem::Malloc<byte>((sCount+7)>>3)),surface(null<Surface*>())
+       :prev(null<CacheNode*>()),next(null<CacheNode*>()),
+       segCount(sCount),bits(mem::Malloc<byte>((sCount+7)>>3)),hash(0),surface(null<Surface*>())
         {mem::Null(bits,(sCount+7)>>3);}
       
       ~CacheNode() {mem::Free(bits); delete surface;}
       
       bit operator < (const CacheNode & rhs) const 
-      {return math::CompareBitSeq(bits,rhs.bits,(segCount+7)>>3);}
+      {
+       if (hash!=rhs.hash) return hash<rhs.hash;
+       return math::CompareBitSeq(bits,rhs.bits,(segCount+7)>>3)<0;
+      }
      
      
       // Adds a member to the key, which starts with no members on construction...
-       void AddMember(nat32 seg) {log::Assert(seg<segCount); bits[seg>>3] |= 1<<(seg&0x07);}
+       void AddMember(nat32 seg)
+       {
+        log::Assert(seg<segCount);
+        byte mask = 1<<(seg&0x07);
+        if ((bits[seg>>3]&mask)==0) hash ^= Fingerprint(seg);
+        bits[seg>>3] |= mask;
+       }
        
       // Adds a whole load of members to the key, or's with current data...
        void AddMembers(const ds::Array<bit> & foi)
@@ -363,33 +428,81 @@ class EOS_CLASS Layers
       // Gets the surface...
        Surface * GetSurface() const {return surface;}
 
+      // Returns the memory this entry is charged against the cache limit...
+       nat64 Memory() const {return cacheOverhead + ((segCount+7)>>3);}
+
+
+      // The least recently used chain, front is most recent, maintained by Layers...
+       CacheNode * prev;
+       CacheNode * next;
+
+
      private:
       nat32 segCount;
       byte * bits; // segCount/8, rounded up in size, bit for each segment indicating membership. All excess bits are zero'ed.
+      nat64 hash; // Xor of the Fingerprint of each member.
       
       real32 score;
       Surface * surface;
+
+      // A well mixed 64 bit value for a segment, from splitmix64...
+       static nat64 Fingerprint(nat32 seg)
+       {
+        nat64 z = nat64(seg) + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z>>30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z>>27)) * 0x94D049BB133111EBULL;
+        return z ^ (z>>31);
+       }
     };
     
   // Hash table of scores for each layer configuration tried, a sort list is used
   // as its the only structure with the required features, though better structures
   // do exist (A potential future optimisation possibility.)...
    mutable ds::SortList<CacheNode*,ds::SortPtrOp<CacheNode*>,mem::KillDel<CacheNode> > cache;
+
+  // The least recently used chain through the cache entries, excluding the
+  // dummy added by SetSegs, plus the memory and statistics...
+   mutable CacheNode * cacheFront;
+   mutable CacheNode * cacheBack;
+   nat64 cacheLimit;
+   mutable nat64 cacheMemory;
+   mutable nat64 cacheHits;
+   mutable nat64 cacheMisses;
+   mutable nat64 cacheEvictions;
+
+   // Looks up a key, on success moving it to the front and returning it, null
+   // on failure. Counts hits and misses...
+    CacheNode * CacheFind(const CacheNode & key) const;
+
+   // Adds a new entry at the front, evicting if the limit is exceeded...
+    void CacheAdd(CacheNode * nn) const;
+
+   // Discards the least recently used entries not in use...
+    void CacheEvict() const;
    
 
   // Internal stuff...
-   // Finds the best fit surface, called when the da structure has been updated with
-   // the relevent data arrays and sizes for the area being fitted in question.
-   // It outputs its score, as a measure of confidence, where 0 implies a perfect fit,
-   // higher numbers imply a worse fit.
-    Surface * SegFitInt(real32 & score) const;
+   // Finds the best fit surface for the given set of segments, the members of
+   // the layer being fitted. It outputs its score, as a measure of confidence,
+   // where 0 implies a perfect fit, higher numbers imply a worse fit. Only
+   // reads shared state, so can be called by multiple threads at once, except
+   // when using ransac, as that uses the random number generator.
+    Surface * SegFitInt(const ds::Array<nat32> & segSet,real32 & score) const;
    
    // Fits data to a surface, for a given SurfaceType with given model data
    // with weights and SurfaceType-model indexes passed in.
    // out is filled with the number of outliers for the returned surface, so
    // surface comparisons can be made to decide on the best. (As a real so a weighting can
    // be applied without conversion.)
-    Surface * SegFitInt(FitAlg lfa,NodeSurface & st,const ds::Array<NodeIed*> & ds,real32 & out) const;
+    Surface * SegFitInt(FitAlg lfa,const NodeSurface & st,const ds::Array<FitData> & ds,const ds::Array<nat32> & segSet,real32 & out) const;
+
+   // Fits a batch of configurations that are not in the cache, in parallel
+   // when the fitting method allows, and adds them to the cache. Takes
+   // ownership of the keys, outputting the score of each, and its surface if
+   // surf is not null...
+    void FitBatch(nat32 count,CacheNode ** key,const ds::Array<nat32> * segSet,real32 * score,Surface ** surf = null<Surface**>()) const;
+
+   friend class LayerFitTask;
 };
 
 //------------------------------------------------------------------------------
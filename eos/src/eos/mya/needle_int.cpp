@@ -20,6 +20,7 @@
 #include "eos/ds/arrays2d.h"
 #include "eos/ds/priority_queues.h"
 #include "eos/file/wavefront.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -84,7 +85,7 @@ EOS_FUNC void IntegrateNeedle(const svt::Field<bs::Normal> & needle,const svt::F
    {
     if (mask.Get(x,y))
     {
-     if ((x!=forest.Width()-1)&&mask.Get(x+1,y));
+     if ((x!=forest.Width()-1)&&mask.Get(x+1,y))
      {
       NeedleLink nl;
        nl.aX = x;
@@ -192,7 +193,7 @@ EOS_FUNC void IntegrateNeedle(const svt::Field<bs::Normal> & needle,const svt::F
      keepGoing = false;
       for (int32 y=forest.Height()-1;y>=0;y--)
       {
-       for (int32 x=forest.Width();x>=0;x--)
+       for (int32 x=forest.Width()-1;x>=0;x--)
        {
         if (mask.Get(x,y))
         {
@@ -317,6 +318,382 @@ EOS_FUNC void IntegrateNeedle(const svt::Field<bs::Normal> & needle,const svt::F
    }*/
 }
 
+//------------------------------------------------------------------------------
+// The grid representation of the least squares needle integration, used by
+// IntegrateNeedleLS. Each level is a width x height grid, each pixel has a
+// conductance to its right and down neighbours and a pull towards zero, the
+// matrix being the resulting weighted graph laplacian plus the pulls. Pixels 
+// with a zero diagonal are not part of the problem. Coarser levels are made 
+// by merging 2x2 blocks, summing the conductances between blocks, which is the 
+// Galerkin product for piecewise constant interpolation...
+struct NeedleGrid
+{
+ nat32 width;
+ nat32 height;
+ ds::Array<real32> cx; // Conductance to x+1.
+ ds::Array<real32> cy; // Conductance to y+1.
+ ds::Array<real32> pull;
+ ds::Array<real32> diag;
+
+ ds::Array<real32> x; // Solution.
+ ds::Array<real32> b; // Right hand side.
+ ds::Array<real32> r; // Residual.
+ 
+ void Size(nat32 w,nat32 h)
+ {
+  width = w;
+  height = h;
+  cx.Size(w*h);
+  cy.Size(w*h);
+  pull.Size(w*h);
+  diag.Size(w*h);
+  x.Size(w*h);
+  b.Size(w*h);
+  r.Size(w*h);
+ }
+ 
+ void MakeDiag()
+ {
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x0=0;x0<width;x0++)
+   {
+    nat32 i = y*width + x0;
+    real32 d = pull[i] + cx[i] + cy[i];
+    if (x0!=0) d += cx[i-1];
+    if (y!=0) d += cy[i-width];
+    diag[i] = d;
+   }
+  }
+ }
+};
+
+// One red-black Gauss-Seidel half sweep, for the rows given...
+class NeedleSmooth
+{
+ public:
+  NeedleSmooth(NeedleGrid & g,nat32 c):grid(g),colour(c) {}
+  
+  void operator () (nat32 y0,nat32 y1) const
+  {
+   nat32 w = grid.width;
+   nat32 h = grid.height;
+   real32 * x = grid.x.Ptr();
+   const real32 * b = grid.b.Ptr();
+   const real32 * cx = grid.cx.Ptr();
+   const real32 * cy = grid.cy.Ptr();
+   const real32 * diag = grid.diag.Ptr();
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x0=(y+colour)&1;x0<w;x0+=2)
+    {
+     nat32 i = y*w + x0;
+     if (math::IsZero(diag[i])) continue;
+     real32 sum = b[i];
+     if (x0!=0) sum += cx[i-1]*x[i-1];
+     if (x0+1!=w) sum += cx[i]*x[i+1];
+     if (y!=0) sum += cy[i-w]*x[i-w];
+     if (y+1!=h) sum += cy[i]*x[i+w];
+     x[i] = sum/diag[i];
+    }
+   }
+  }
+  
+ private:
+  NeedleGrid & grid;
+  nat32 colour;
+};
+
+// Calculates the residual of a level, b - Ax, and sums it into the 2x2 blocks
+// of the next level as its right hand side, zeroing its solution. Works in
+// rows of the coarse level...
+class NeedleRestrict
+{
+ public:
+  NeedleRestrict(NeedleGrid & f,NeedleGrid & c):fine(f),coarse(c) {}
+  
+  void operator () (nat32 y0,nat32 y1) const
+  {
+   nat32 w = fine.width;
+   nat32 h = fine.height;
+   const real32 * x = fine.x.Ptr();
+   const real32 * b = fine.b.Ptr();
+   const real32 * cx = fine.cx.Ptr();
+   const real32 * cy = fine.cy.Ptr();
+   const real32 * diag = fine.diag.Ptr();
+   for (nat32 cy0=y0;cy0<y1;cy0++)
+   {
+    for (nat32 cx0=0;cx0<coarse.width;cx0++) {coarse.b[cy0*coarse.width+cx0] = 0.0; coarse.x[cy0*coarse.width+cx0] = 0.0;}
+    for (nat32 y=cy0*2;(y<cy0*2+2)&&(y<h);y++)
+    {
+     for (nat32 x0=0;x0<w;x0++)
+     {
+      nat32 i = y*w + x0;
+      if (math::IsZero(diag[i])) continue;
+      real32 res = b[i] - diag[i]*x[i];
+      if (x0!=0) res += cx[i-1]*x[i-1];
+      if (x0+1!=w) res += cx[i]*x[i+1];
+      if (y!=0) res += cy[i-w]*x[i-w];
+      if (y+1!=h) res += cy[i]*x[i+w];
+      coarse.b[cy0*coarse.width + x0/2] += res;
+     }
+    }
+   }
+  }
+  
+ private:
+  NeedleGrid & fine;
+  NeedleGrid & coarse;
+};
+
+// Adds the coarse solution back into the fine, in rows of the fine level. The
+// correction is doubled, as piecewise constant aggregation underestimates the
+// smooth error by about that factor - it keeps the cycle symmetric and makes
+// the preconditioner far more effective...
+class NeedleProlong
+{
+ public:
+  NeedleProlong(NeedleGrid & f,const NeedleGrid & c):fine(f),coarse(c) {}
+  
+  void operator () (nat32 y0,nat32 y1) const
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    real32 * x = fine.x.Ptr() + y*fine.width;
+    const real32 * diag = fine.diag.Ptr() + y*fine.width;
+    const real32 * cx = coarse.x.Ptr() + (y/2)*coarse.width;
+    for (nat32 x0=0;x0<fine.width;x0++)
+    {
+     if (!math::IsZero(diag[x0])) x[x0] += 2.0*cx[x0/2];
+    }
+   }
+  }
+  
+ private:
+  NeedleGrid & fine;
+  const NeedleGrid & coarse;
+};
+
+// Does a multigrid V-cycle from the given level down, improving level.x as 
+// the solution for level.b. The smoothing is ordered so the cycle is a 
+// symmetric operator, as required to use it as a conjugate gradient 
+// preconditioner...
+inline void NeedleCycle(ds::Array<NeedleGrid,mem::MakeNew<NeedleGrid>,mem::KillOnlyDel<NeedleGrid> > & level,nat32 l)
+{
+ static const nat32 coarseSweeps = 16;
+ static const nat32 rowGrain = 16;
+ NeedleGrid & g = level[l];
+ NeedleSmooth red(g,0);
+ NeedleSmooth black(g,1);
+ 
+ if (l+1==level.Size())
+ {
+  for (nat32 i=0;i<coarseSweeps;i++)
+  {
+   red(0,g.height); black(0,g.height);
+   black(0,g.height); red(0,g.height);
+  }
+  return;
+ }
+ 
+ mt::ParallelFor(nat32(0),g.height,red,rowGrain);
+ mt::ParallelFor(nat32(0),g.height,black,rowGrain);
+ 
+ NeedleRestrict down(g,level[l+1]);
+ mt::ParallelFor(nat32(0),level[l+1].height,down,rowGrain/2);
+ NeedleCycle(level,l+1);
+ NeedleProlong up(g,level[l+1]);
+ mt::ParallelFor(nat32(0),g.height,up,rowGrain);
+ 
+ mt::ParallelFor(nat32(0),g.height,black,rowGrain);
+ mt::ParallelFor(nat32(0),g.height,red,rowGrain);
+}
+
+// The conjugate gradient operations on the finest level, in double precision.
+// Does q = Ap, outputting a partial p.q for each row so the dot product is
+// the same regardless of how its split...
+class NeedleApply
+{
+ public:
+  NeedleApply(const NeedleGrid & g,const real64 * pp,real64 * qq,real64 * pd)
+  :grid(g),p(pp),q(qq),partial(pd) {}
+  
+  void operator () (nat32 y0,nat32 y1) const
+  {
+   nat32 w = grid.width;
+   nat32 h = grid.height;
+   for (nat32 y=y0;y<y1;y++)
+   {
+    real64 sum = 0.0;
+    for (nat32 x0=0;x0<w;x0++)
+    {
+     nat32 i = y*w + x0;
+     real64 v = grid.diag[i]*p[i];
+     if (x0!=0) v -= grid.cx[i-1]*p[i-1];
+     if (x0+1!=w) v -= grid.cx[i]*p[i+1];
+     if (y!=0) v -= grid.cy[i-w]*p[i-w];
+     if (y+1!=h) v -= grid.cy[i]*p[i+w];
+     q[i] = v;
+     sum += v*p[i];
+    }
+    partial[y] = sum;
+   }
+  }
+  
+ private:
+  const NeedleGrid & grid;
+  const real64 * p;
+  real64 * q;
+  real64 * partial;
+};
+
+//------------------------------------------------------------------------------
+EOS_FUNC void IntegrateNeedleLS(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,svt::Field<real32> & depth,
+                                real64 tol,nat32 maxIters)
+{
+ LogTime("eos::mya::IntegrateNeedleLS");
+ nat32 width = needle.Size(0);
+ nat32 height = needle.Size(1);
+ nat32 n = width*height;
+ if (n==0) return;
+
+ // Build the finest level and the right hand side - each neighbour pair wants
+ // the depth of the second to be the first plus delta. A tiny pull towards 
+ // zero keeps it positive definite, fixing the constant of each region...
+  ds::Array<NeedleGrid,mem::MakeNew<NeedleGrid>,mem::KillOnlyDel<NeedleGrid> > level(1);
+  {
+   NeedleGrid & g = level[0];
+   g.Size(width,height);
+   for (nat32 i=0;i<n;i++) g.b[i] = 0.0;
+   for (nat32 y=0;y<height;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     nat32 i = y*width + x;
+     bit in = mask.Get(x,y);
+     g.pull[i] = in?1e-6:0.0;
+     g.cx[i] = 0.0;
+     g.cy[i] = 0.0;
+     if (!in) continue;
+     
+     const bs::Normal & na = needle.Get(x,y);
+     if ((x+1<width)&&mask.Get(x+1,y))
+     {
+      const bs::Normal & nb = needle.Get(x+1,y);
+      real32 delta = 0.5*(na[0]/na[2] + nb[0]/nb[2]);
+      g.cx[i] = 1.0;
+      g.b[i] -= delta;
+      g.b[i+1] += delta;
+     }
+     if ((y+1<height)&&mask.Get(x,y+1))
+     {
+      const bs::Normal & nb = needle.Get(x,y+1);
+      real32 delta = 0.5*(na[1]/na[2] + nb[1]/nb[2]);
+      g.cy[i] = 1.0;
+      g.b[i] -= delta;
+      g.b[i+width] += delta;
+     }
+    }
+   }
+   g.MakeDiag();
+  }
+
+ // Build the coarser levels, till its small...
+  static const nat32 coarsest = 8;
+  while ((level[level.Size()-1].width>coarsest)||(level[level.Size()-1].height>coarsest))
+  {
+   nat32 l = level.Size();
+   level.Size(l+1);
+   const NeedleGrid & f = level[l-1];
+   NeedleGrid & c = level[l];
+   c.Size((f.width+1)/2,(f.height+1)/2);
+   for (nat32 i=0;i<c.width*c.height;i++) {c.cx[i] = 0.0; c.cy[i] = 0.0; c.pull[i] = 0.0;}
+   
+   for (nat32 y=0;y<f.height;y++)
+   {
+    for (nat32 x=0;x<f.width;x++)
+    {
+     nat32 i = y*f.width + x;
+     nat32 ci = (y/2)*c.width + x/2;
+     c.pull[ci] += f.pull[i];
+     if ((x&1)&&(x+1<f.width)) c.cx[ci] += f.cx[i];
+     if ((y&1)&&(y+1<f.height)) c.cy[ci] += f.cy[i];
+    }
+   }
+   c.MakeDiag();
+  }
+
+
+ // Solve with conjugate gradient, preconditioned by a multigrid cycle...
+  ds::Array<real64> x(n);
+  ds::Array<real64> r(n);
+  ds::Array<real64> p(n);
+  ds::Array<real64> q(n);
+  ds::Array<real64> partial(height);
+  NeedleGrid & g = level[0];
+  
+  real64 bNorm = 0.0;
+  for (nat32 i=0;i<n;i++)
+  {
+   x[i] = 0.0;
+   r[i] = g.b[i];
+   bNorm += r[i]*r[i];
+  }
+  
+  if (bNorm>0.0)
+  {
+   // Initial search direction...
+    for (nat32 i=0;i<n;i++) {g.b[i] = r[i]; g.x[i] = 0.0;}
+    NeedleCycle(level,0);
+    real64 rz = 0.0;
+    for (nat32 i=0;i<n;i++)
+    {
+     p[i] = g.x[i];
+     rz += r[i]*p[i];
+    }
+   
+   // Iterate...
+    NeedleApply apply(g,p.Ptr(),q.Ptr(),partial.Ptr());
+    for (nat32 iter=0;iter<maxIters;iter++)
+    {
+     mt::ParallelFor(nat32(0),height,apply,16);
+     real64 pq = 0.0;
+     for (nat32 y=0;y<height;y++) pq += partial[y];
+     if (!(pq>0.0)) break;
+     
+     real64 alpha = rz/pq;
+     real64 rNorm = 0.0;
+     for (nat32 i=0;i<n;i++)
+     {
+      x[i] += alpha*p[i];
+      r[i] -= alpha*q[i];
+      rNorm += r[i]*r[i];
+     }
+     if (rNorm<=tol*tol*bNorm) break;
+     
+     for (nat32 i=0;i<n;i++) {g.b[i] = r[i]; g.x[i] = 0.0;}
+     NeedleCycle(level,0);
+     real64 rzNew = 0.0;
+     for (nat32 i=0;i<n;i++) rzNew += r[i]*g.x[i];
+     
+     real64 beta = rzNew/rz;
+     rz = rzNew;
+     for (nat32 i=0;i<n;i++) p[i] = g.x[i] + beta*p[i];
+    }
+  }
+
+
+ // Write back...
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x0=0;x0<width;x0++)
+   {
+    if (mask.Get(x0,y)) depth.Get(x0,y) = x[y*width+x0];
+                   else depth.Get(x0,y) = 0.0;
+   }
+  }
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC bit SaveNeedleModel(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,nat32 freq,cstrconst fn,bit overwrite)
 {
@@ -329,7 +706,7 @@ EOS_FUNC bit SaveNeedleModel(const svt::Field<bs::Normal> & needle,const svt::Fi
   svt::Field<real32> depth(&tv,"depth");
  
  // Integrate to generate the depth map...
-  IntegrateNeedle(needle,mask,depth);
+  IntegrateNeedleLS(needle,mask,depth);
  
  // Write the depth map into a Wavefront object, with the given sampling...
   file::Wavefront wf;
@@ -35,10 +35,28 @@ namespace eos
 /// trees each time.
 EOS_FUNC void IntegrateNeedle(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,svt::Field<real32> & depth);
 
+//------------------------------------------------------------------------------
+/// This integrates a needle map to generate a depth map, by least squares -
+/// the depth that best matches the gradients implied by the needle between
+/// every pair of 4-way neighbours in the mask. This is the Poisson equation,
+/// solved matrix free by conjugate gradients preconditioned with a multigrid
+/// V-cycle, the grid repeatedly coarsened by 2x2 aggregation; rows are
+/// processed in parallel throughout. Unlike IntegrateNeedle errors
+/// are spread out rather than accumulating along paths. Each connected region
+/// comes out with (almost) zero mean depth.
+/// \param needle The needle map to integrate.
+/// \param mask Which pixels to integrate, depth is set to 0 outside it.
+/// \param depth Output depth map.
+/// \param tol Relative residual the solver stops at.
+/// \param maxIters Cap on solver iterations.
+EOS_FUNC void IntegrateNeedleLS(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,svt::Field<real32> & depth,
+                                real64 tol = 1e-6,nat32 maxIters = 2000);
+
 //------------------------------------------------------------------------------
 /// A helper function, given a needle map this saves a Wavefront .obj 3D model
 /// to a given filename, overwritting on request. You also provide a sampling
-/// resolution for the model, so sampling every pixel is optional.
+/// resolution for the model, so sampling every pixel is optional. Depth comes
+/// from IntegrateNeedleLS.
 /// \param needle The needle map to be saved.
 /// \param mask The mask associated with the needle map.
 /// \param freq The frequency of sampling for pixels, set to 1 to sample every one, 5 to sample every 5th pixel etc.
@@ -29,6 +29,7 @@ Needles::Needles(const svt::Field<bs::Normal> & dir)
  dir.SubField(0*sizeof(real32),n); SetVariable(0,n);
  dir.SubField(1*sizeof(real32),n); SetVariable(1,n);
  dir.SubField(2*sizeof(real32),n); SetVariable(2,n);
+ CacheFeatures();
 }
 
 Needles::Needles(const svt::Field<bs::Normal> & dir,const svt::Field<bit> & valid)
@@ -39,6 +40,7 @@ Needles::Needles(const svt::Field<bs::Normal> & dir,const svt::Field<bit> & vali
  dir.SubField(1*sizeof(real32),n); SetVariable(1,n);
  dir.SubField(2*sizeof(real32),n); SetVariable(2,n);
  SetValidity(valid);
+ CacheFeatures();
 }
 
 Needles::~Needles()
@@ -30,7 +30,9 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 /// An Ied for representing a Needle map from a sfs algorithm with a smoothness
-/// constraint.
+/// constraint. The needle map is copied at construction, via CacheFeatures, so
+/// changes made to it afterwards are not seen unless CacheFeatures is called 
+/// again.
 class EOS_CLASS Needles : public Ied
 {
  public:
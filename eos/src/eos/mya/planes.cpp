@@ -17,9 +17,12 @@
 
 #include "eos/mya/planes.h"
 
-#include "eos/alg/fitting.h"
 #include "eos/math/iter_min.h"
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 namespace eos
 {
  namespace mya
@@ -83,45 +86,57 @@ void PlaneFitter::Reset()
  dispCount = 0;
  needleCount = 0;
  sfsCount = 0;
- data.Reset();
+ pf.Reset();
 }
 
 bit PlaneFitter::Add(nat32 type,real32 x,real32 y,const math::Vector<real32> & d)
 {
- Node n;
-  switch (type)
-  {
-   case 0:
-    if (!math::Equal(d[1],real32(0.0)))
+ switch (type)
+ {
+  case 0:
+   if (!math::Equal(d[1],real32(0.0)))
+   {
+    if (dispCount==dispX.Size())
     {
-     n.type = Node::disp;
-     n.v[0] = x; 
-     n.v[1] = y;
-     n.v[2] = d[0]/d[1];
-     n.v[3] = 1.0;
-     ++dispCount;
-     data.AddBack(n);
+     nat32 ns = dispCount*2 + 16;
+     dispX.Size(ns);
+     dispY.Size(ns);
+     dispZ.Size(ns);
     }
-   break;
-   case 1:
+    dispX[dispCount] = x;
+    dispY[dispCount] = y;
+    dispZ[dispCount] = d[0]/d[1];
+    pf.Add(x,y,dispZ[dispCount]);
+    ++dispCount;
+   }
+  break;
+  case 1:
+  case 2:
+  {
+   nat32 oc = needleCount + sfsCount;
+   if (oc==other.Size()) other.Size(oc*2 + 4);
+   Node & n = other[oc];
+   if (type==1)
+   {
     n.type = Node::needle;
     n.v[0] = d[0];
     n.v[1] = d[1];
     n.v[2] = d[2];
     n.v[3] = 1.0;
     ++needleCount; 
-    data.AddBack(n);
-   break;
-   case 2:
+   }
+   else
+   {
     n.type = Node::sfs;
     n.v[0] = d[0]; 
     n.v[1] = d[1];
     n.v[2] = d[2];
     n.v[3] = d[3];
     ++sfsCount;   
-    data.AddBack(n);
-   break;
+   }
   }
+  break;
+ }
  
  nat32 dc = dispCount + 2*math::Min(needleCount,nat32(1)) + math::Min(sfsCount,nat32(2));
  return dc>=3;
@@ -134,18 +149,11 @@ bit PlaneFitter::Extract(Surface & out) const
  // Fit an initial plane using only position data, if that fails we simply start with a plane
  // orthogonal to the viewing direction...
  {
-  alg::PlaneFit pf;
-   ds::List<Node>::Cursor targ = data.FrontPtr();
-   while (!targ.Bad())
-   {
-    if (targ->type==Node::disp) pf.Add(targ->v[0],targ->v[1],targ->v[2]);    
-    ++targ;
-   }
-    
-  if (pf.Valid())
+  alg::PlaneFit ipf = pf;
+  if (ipf.Valid())
   {
    bs::PlaneABC plane;
-   pf.Get(plane);
+   ipf.Get(plane);
    bs::Plane p = plane;
     o.Data()[0] = p.n[0];
     o.Data()[1] = p.n[1];
@@ -190,28 +198,46 @@ void PlaneFitter::LMfunc(const math::Vector<real32> & pv, math::Vector<real32> &
  real32 ny = math::Sin(pv[0])*math::Sin(pv[1]);
  real32 nz = math::Cos(pv[1]);
 
- nat32 ewp = 0;
- ds::List<Node>::Cursor targ = self.data.FrontPtr();
- while (!targ.Bad())
- {
-  switch (targ->type)
+ // The disparity data, signed distance from the plane, 4 at a time where 
+ // avaliable...
+  nat32 ewp = 0;
+  real32 * e = &err[0];
+  const real32 * x = self.dispX.Ptr();
+  const real32 * y = self.dispY.Ptr();
+  const real32 * z = self.dispZ.Ptr();
+  #ifdef __SSE__
   {
-   case Node::disp:
-    err[ewp] = nx*targ->v[0] + ny*targ->v[1] + nz*targ->v[2] + pv[2];    
-   break;
+   __m128 mx = _mm_set1_ps(nx);
+   __m128 my = _mm_set1_ps(ny);
+   __m128 mz = _mm_set1_ps(nz);
+   __m128 md = _mm_set1_ps(pv[2]);
+   for (;ewp+4<=self.dispCount;ewp+=4)
+   {
+    __m128 r = _mm_add_ps(_mm_mul_ps(mx,_mm_loadu_ps(x+ewp)),_mm_mul_ps(my,_mm_loadu_ps(y+ewp)));
+    r = _mm_add_ps(r,_mm_mul_ps(mz,_mm_loadu_ps(z+ewp)));
+    _mm_storeu_ps(e+ewp,_mm_add_ps(r,md));
+   }
+  }
+  #endif
+  for (;ewp<self.dispCount;ewp++) e[ewp] = nx*x[ewp] + ny*y[ewp] + nz*z[ewp] + pv[2];
 
-   case Node::needle:
-    err[ewp] = angMult*math::Sin(math::InvCos(nx*targ->v[0] + ny*targ->v[1] + nz*targ->v[2]));
-   break;
+ // The angular data...
+  nat32 oc = self.needleCount + self.sfsCount;
+  for (nat32 i=0;i<oc;i++)
+  {
+   const Node & targ = self.other[i];
+   switch (targ.type)
+   {
+    case Node::needle:
+     e[ewp] = angMult*math::Sin(math::InvCos(nx*targ.v[0] + ny*targ.v[1] + nz*targ.v[2]));
+    break;
 
-   case Node::sfs:
-    err[ewp] = angMult*math::Sin(math::InvCos(nx*targ->v[0] + ny*targ->v[1] + nz*targ->v[2]) - math::InvCos(targ->v[3]));
-   break;
+    case Node::sfs:
+     e[ewp] = angMult*math::Sin(math::InvCos(nx*targ.v[0] + ny*targ.v[1] + nz*targ.v[2]) - math::InvCos(targ.v[3]));
+    break;
+   }
+   ++ewp;
   }
-  
-  ++targ;
-  ++ewp;
- }
 }
 
 //------------------------------------------------------------------------------
@@ -22,7 +22,8 @@
 /// Provides an implimentation of a Surface type for planes.
 
 #include "eos/mya/surfaces.h"
-#include "eos/ds/lists.h"
+#include "eos/ds/arrays.h"
+#include "eos/alg/fitting.h"
 
 namespace eos
 {
@@ -97,18 +98,29 @@ class EOS_CLASS PlaneFitter : public Fitter
  private:
   static const real32 angMult = 0.02; // The multiplier of angles to weight them compared to distance in the error functions.
  
-  // We store a linked list of typed data collected, plus counters of each data
-  // type so we know when enough data is avaliable...
+  // We store the typed data collected, plus counters of each data type so we 
+  // know when enough data is avaliable. Disparity, the common case, goes in 
+  // seperate arrays of x, y and depth so its residuals can be calculated 4 at a 
+  // time, the rest as typed nodes. The arrays are only ever grown, so a Reset 
+  // followed by refilling, as ransac does, never allocates...
    nat32 dispCount;
    nat32 needleCount;
    nat32 sfsCount;
    
+   ds::Array<real32> dispX;
+   ds::Array<real32> dispY;
+   ds::Array<real32> dispZ;
+   
    struct Node
    {
-    enum {disp,needle,sfs} type;
+    enum {needle,sfs} type;
     math::Vect<4> v; // The 4 vector from the lhs matrix followed by the single entry in the vector on the rhs.
    };
-   ds::List<Node> data;
+   ds::Array<Node> other;
+   
+  // The moments of the disparity data, kept as data is added so the initial
+  // algebraic fit needs no pass over the data...
+   alg::PlaneFit pf;
    
   // Error metric function for LM...
    static void LMfunc(const math::Vector<real32> & pv, math::Vector<real32> & err, const PlaneFitter & self);
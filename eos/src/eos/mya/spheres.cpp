@@ -119,7 +119,6 @@ void SphereFitter::Reset()
  dispCount = 0;
  needleCount = 0;
  sfsCount = 0;
- data.Reset();
 }
 
 bit SphereFitter::Add(nat32 type,real32 x,real32 y,const math::Vector<real32> & d)
@@ -137,8 +136,8 @@ bit SphereFitter::Add(nat32 type,real32 x,real32 y,const math::Vector<real32> &
      n.v[3] = 1.0;
      n.v[4] = 0.0;
      n.v[5] = 0.0;
+     Push(n);
      ++dispCount;
-     data.AddBack(n);
     }
    break;
    case 1:
@@ -149,8 +148,8 @@ bit SphereFitter::Add(nat32 type,real32 x,real32 y,const math::Vector<real32> &
     n.v[3] = d[1];
     n.v[4] = d[2];
     n.v[5] = 1.0;
-    ++needleCount; 
-    data.AddBack(n);
+    Push(n);
+    ++needleCount;
    break;
    case 2:
     n.type = Node::sfs;
@@ -160,8 +159,8 @@ bit SphereFitter::Add(nat32 type,real32 x,real32 y,const math::Vector<real32> &
     n.v[3] = d[1];
     n.v[4] = d[2];
     n.v[5] = d[3];
-    ++sfsCount;   
-    data.AddBack(n);
+    Push(n);
+    ++sfsCount;
    break;
   }
  
@@ -176,10 +175,11 @@ bit SphereFitter::Extract(Surface & out) const
  // Construct an initialisation condition, simply a centre as the average in x/y and the
  // deapest point in z of all disp data, then radius to include the entire data set...
   math::Vector<real32> sr(5,0.0);
-  ds::List<Node>::Cursor targ = data.FrontPtr();
+  nat32 nodes = Nodes();
   nat32 zDiv = 0;
-  while (!targ.Bad())
+  for (nat32 i=0;i<nodes;i++)
   {
+   const Node * targ = &data[i];
    sr[0] += targ->v[0];
    sr[1] += targ->v[1];   
    if (targ->type==Node::disp)
@@ -187,15 +187,14 @@ bit SphereFitter::Extract(Surface & out) const
     sr[2] += targ->v[2];
     ++zDiv;
    }
-   ++targ;
   }
-  sr[0] /= real32(data.Size());
-  sr[1] /= real32(data.Size());
+  sr[0] /= real32(nodes);
+  sr[1] /= real32(nodes);
   if (zDiv!=0) sr[2] /= real32(zDiv); 
   
-  targ = data.FrontPtr();
-  while (!targ.Bad())
+  for (nat32 i=0;i<nodes;i++)
   {
+   const Node * targ = &data[i];
    if (targ->type==Node::disp)
    {
     sr[3] = math::Max(sr[3],math::Sqr(sr[0] - targ->v[0]) + math::Sqr(sr[1] - targ->v[1]) + math::Sqr(sr[2] - targ->v[2]));
@@ -204,7 +203,6 @@ bit SphereFitter::Extract(Surface & out) const
    {
     sr[3] = math::Max(sr[3],math::Sqr(sr[0] - targ->v[0]) + math::Sqr(sr[1] - targ->v[1]));
    }
-   ++targ;
   }
   sr[3] = math::Sqrt(sr[3]);
 
@@ -232,10 +230,10 @@ cstrconst SphereFitter::TypeString() const
 
 void SphereFitter::LMfunc(const math::Vector<real32> & pv,math::Vector<real32> & err,const SphereFitter & self)
 {
- nat32 ewp = 0;
- ds::List<Node>::Cursor targ = self.data.FrontPtr();
- while (!targ.Bad())
+ nat32 nodes = self.Nodes();
+ for (nat32 ewp=0;ewp<nodes;ewp++)
  {
+  const Node * targ = &self.data[ewp];
   switch (targ->type)
   {
    case Node::disp:
@@ -298,9 +296,6 @@ void SphereFitter::LMfunc(const math::Vector<real32> & pv,math::Vector<real32> &
     err[ewp] = 0.0; // ? ******************************************************************
    break;
   }
-  
-  ++targ;
-  ++ewp;
  }
 }
 
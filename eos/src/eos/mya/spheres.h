@@ -22,7 +22,7 @@
 /// Provides an implimentation of a Surface type for spheres.
 
 #include "eos/mya/surfaces.h"
-#include "eos/ds/lists.h"
+#include "eos/ds/arrays.h"
 
 namespace eos
 {
@@ -99,8 +99,9 @@ class EOS_CLASS SphereFitter : public Fitter
  private:
   static const real32 angMult = 0.9; // The multiplier of angles to weight them compared to distance in the error functions.
 
-  // We store a linked list of typed data collected, plus counters of each data
-  // type so we know when enough data is avaliable...
+  // We store an array of typed data collected, plus counters of each data
+  // type so we know when enough data is avaliable. The array is only ever 
+  // grown, so a Reset followed by refilling, as ransac does, never allocates...
    nat32 dispCount;
    nat32 needleCount;
    nat32 sfsCount;
@@ -110,7 +111,11 @@ class EOS_CLASS SphereFitter : public Fitter
     enum {disp,needle,sfs} type;
     math::Vect<6> v; // The data for the sphere fitting.
    };
-   ds::List<Node> data;
+   ds::Array<Node> data;
+   
+  // Returns the number of nodes in use, and appends one...
+   nat32 Nodes() const {return dispCount+needleCount+sfsCount;}
+   void Push(const Node & n) {if (Nodes()==data.Size()) data.Size(Nodes()*2+16); data[Nodes()] = n;}
    
   // Error function for LM...
    static void LMfunc(const math::Vector<real32> & pv,math::Vector<real32> & err,const SphereFitter & self);
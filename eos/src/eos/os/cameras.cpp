@@ -386,6 +386,39 @@ file::ImageRGB * Camera::Capture() const
 {
  LogBlock("file::ImageRGB * Camera::Capture() const","-");
 
+ // Take the photo, and get it off the camera...
+  Shot shot;
+  if (!Trigger(shot)) return null<file::ImageRGB*>();
+
+ // Saving to disk first is a major flaw in the gphoto library design...
+  cstr filename = file::TemporyFilename();
+  if (!Download(shot,filename))
+  {
+   mem::Free(filename);
+   return null<file::ImageRGB*>();
+  }
+
+ // Load back in the file just saved...
+  file::ImageRGB * ret = new file::ImageRGB();
+  if (ret->Load(filename)==false)
+  {
+   LogAlways("[gphoto] Error reloading image");
+   delete ret;
+   ret = null<file::ImageRGB*>();
+  }
+  LogDebug("[gphoto] Tempory file reloaded");
+
+ // Delete the file, clean up, and return the result...
+  file::DeleteFile(filename);
+  mem::Free(filename);
+
+ return ret;
+}
+
+bit Camera::Trigger(Shot & out) const
+{
+ LogBlock("bit Camera::Trigger(Shot & out) const","-");
+
  // Before we start we need a context for logging...
   GPContext * context = gp_context_new();
   if (context!=null<GPContext*>())
@@ -395,40 +428,63 @@ file::ImageRGB * Camera::Capture() const
    gp_context_set_status_func(context,StatusFunc,0);
    gp_context_set_message_func(context,MessageFunc,0);
   }
-  LogDebug("[gphoto] Context created");
 
- // First step - actually do the capture...
-  GPCameraFile * file;
+ // Take the photo...
   GPCameraFilePath path;
-  if (gp_file_new(&file)<0) {LogAlways("[gphoto] Error creating file object"); return null<file::ImageRGB*>();}
-  if (gp_camera_capture((GPCamera*)cam,GP_CAPTURE_IMAGE,&path,context)<0) {LogAlways("[gphoto] Error capturing image"); return null<file::ImageRGB*>();}
-  LogDebug("[gphoto] Photo taken, capture is on camera. {folder,file}" << LogDiv() << path.folder << LogDiv() << path.name);
-  if (gp_camera_file_get((GPCamera*)cam,path.folder,path.name,GP_FILE_TYPE_NORMAL,file,context)<0) {LogAlways("[gphoto] Error transfering image from camera"); return null<file::ImageRGB*>();}
-  LogDebug("[gphoto] Capture performed");
-
- // Second step, save the captured file to somewhere on disk,
- // this is a major flaw in the gphoto library design...
-  cstr filename = file::TemporyFilename();
-  if (gp_file_save(file,filename)<0) {LogAlways("[gphoto] Error saving tempory file"); return null<file::ImageRGB*>();}
-  LogDebug("[gphoto] Capture saved to tempory file");
+  bit ret = gp_camera_capture((GPCamera*)cam,GP_CAPTURE_IMAGE,&path,context)>=0;
+  if (ret)
+  {
+   LogDebug("[gphoto] Photo taken, capture is on camera. {folder,file}" << LogDiv() << path.folder << LogDiv() << path.name);
+   mem::Copy(out.folder,path.folder,sizeof(out.folder));
+   mem::Copy(out.name,path.name,sizeof(out.name));
+  }
+  else {LogAlways("[gphoto] Error capturing image");}
 
- // Third step - load back in the file just saved...
-  file::ImageRGB * ret = new file::ImageRGB();
-  if (ret->Load(filename)==false)
+  if (context) gp_context_unref(context);
+ return ret;
+}
+
+bit Camera::Download(const Shot & shot,cstrconst filename,bit remove) const
+{
+ LogBlock("bit Camera::Download(const Shot & shot,cstrconst filename,bit remove) const","-");
+
+ // Before we start we need a context for logging...
+  GPContext * context = gp_context_new();
+  if (context!=null<GPContext*>())
   {
-   LogAlways("[gphoto] Error reloading image");
-   delete ret;
-   ret = null<file::ImageRGB*>();
+   gp_context_ref(context);
+   gp_context_set_error_func(context,ErrorFunc,0);
+   gp_context_set_status_func(context,StatusFunc,0);
+   gp_context_set_message_func(context,MessageFunc,0);
   }
-  LogDebug("[gphoto] Tempory file reloaded");
 
- // Delete the files, clean up, and return the result...
-  file::DeleteFile(filename);
-  if (gp_camera_file_delete((GPCamera*)cam,path.folder,path.name,context)<0) {LogAlways("[gphoto] Could not delete tempory file on camera - you will have to do it yourself");}
+ // Transfer and save...
+  bit ret = false;
+  GPCameraFile * file;
+  if (gp_file_new(&file)<0) {LogAlways("[gphoto] Error creating file object");}
+  else
+  {
+   if (gp_camera_file_get((GPCamera*)cam,shot.folder,shot.name,GP_FILE_TYPE_NORMAL,file,context)<0) {LogAlways("[gphoto] Error transfering image from camera");}
+   else
+   {
+    LogDebug("[gphoto] Image transfered");
+    if (gp_file_save(file,filename)<0) {LogAlways("[gphoto] Error saving file {name}" << LogDiv() << filename);}
+    else
+    {
+     LogDebug("[gphoto] Capture saved to file");
+     ret = true;
+    }
+   }
+   gp_file_free(file);
+  }
 
-  mem::Free(filename);
-  if (context) gp_context_unref(context);
+ // Delete the original, and clean up...
+  if (ret&&remove)
+  {
+   if (gp_camera_file_delete((GPCamera*)cam,shot.folder,shot.name,context)<0) {LogAlways("[gphoto] Could not delete tempory file on camera - you will have to do it yourself");}
+  }
 
+  if (context) gp_context_unref(context);
  return ret;
 }
 
@@ -88,6 +88,25 @@ class EOS_CLASS Camera
    file::ImageRGB * Capture() const;
 
 
+  /// Where a photo taken by Trigger is waiting on the camera.
+   struct Shot
+   {
+    cstrchar folder[1024];
+    cstrchar name[128];
+   };
+
+  /// The first half of Capture - takes a photo and leaves it on the camera,
+  /// outputting where it is. Returns false on failure.
+   bit Trigger(Shot & out) const;
+
+  /// The second half of Capture, minus the decoding - transfers a photo taken
+  /// with Trigger from the camera to the given file, in whatever format the
+  /// camera saves in. If remove is true it is then deleted from the camera.
+  /// Returns false on failure, but note that a failure to delete is only
+  /// logged.
+   bit Download(const Shot & shot,cstrconst filename,bit remove = true) const;
+
+
   /// &nbsp;
    static inline cstrconst TypeString() {return "eos::os::Camera";}
 
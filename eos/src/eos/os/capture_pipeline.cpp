@@ -0,0 +1,457 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos/os/capture_pipeline.h"
+
+#include "eos/math/functions.h"
+#include "eos/str/functions.h"
+#include "eos/file/files.h"
+#include "eos/file/images.h"
+#include "eos/filter/image_io.h"
+#include "eos/svt/field.h"
+#include "eos/time/times.h"
+
+#include <stdio.h>
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+// The thread for a camera, that triggers then downloads...
+class CaptureStage : public mt::Thread
+{
+ public:
+   CaptureStage(CapturePipeline & p,nat32 i):pipe(p),index(i) {}
+  ~CaptureStage() {}
+
+   void Execute()
+   {
+    LogBlock("void CaptureStage::Execute()","-");
+    CapturePipeline::Cam & c = pipe.cams[index];
+    while (true)
+    {
+     CapturePipeline::Job job;
+     c.trig->Rem(job);
+     if (job.start<0.0) break;
+
+     real64 t0 = time::UltraTime();
+     Camera::Shot shot;
+     if (!c.cam->Trigger(shot))
+     {
+      LogAlways("[os.capture] Trigger failed {camera,shot}" << LogDiv() << job.camera << LogDiv() << job.shot);
+      pipe.failures.Inc();
+      continue;
+     }
+
+     real64 t1 = time::UltraTime();
+     pipe.Record(CapturePipeline::st_trigger,t1-t0);
+
+     cstr fn = file::TemporyFilename();
+     if (!c.cam->Download(shot,fn))
+     {
+      LogAlways("[os.capture] Download failed {camera,shot}" << LogDiv() << job.camera << LogDiv() << job.shot);
+      pipe.failures.Inc();
+      file::DeleteFile(fn);
+      mem::Free(fn);
+      continue;
+     }
+
+     real64 t2 = time::UltraTime();
+     pipe.Record(CapturePipeline::st_download,t2-t1);
+
+     job.filename = fn;
+     job.stamp = t2;
+     pipe.toDecode->Add(job);
+    }
+   }
+
+ private:
+  CapturePipeline & pipe;
+  nat32 index;
+};
+
+//------------------------------------------------------------------------------
+// A decoding thread, there can be many...
+class DecodeStage : public mt::Thread
+{
+ public:
+   DecodeStage(CapturePipeline & p):pipe(p) {}
+  ~DecodeStage() {}
+
+   void Execute()
+   {
+    LogBlock("void DecodeStage::Execute()","-");
+    file::ImageRGB img;
+    svt::Field<bs::ColourRGB> rgb;
+    while (true)
+    {
+     CapturePipeline::Job job;
+     pipe.toDecode->Rem(job);
+     if (job.filename==null<cstr>()) break;
+
+     real64 t0 = time::UltraTime();
+     pipe.Record(CapturePipeline::st_decode_wait,t0-job.stamp);
+
+     bit ok = img.Load(job.filename);
+     file::DeleteFile(job.filename);
+     mem::Free(job.filename);
+     if (!ok)
+     {
+      LogAlways("[os.capture] Decode failed {camera,shot}" << LogDiv() << job.camera << LogDiv() << job.shot);
+      pipe.failures.Inc();
+      continue;
+     }
+
+     // Get a buffer, only changing its shape if it has to...
+      CapturePipeline::Frame * frame = pipe.GetFrame();
+      svt::Var * var = frame->image;
+      if ((var->Dims()!=2)||(var->Size(0)!=img.Width())||(var->Size(1)!=img.Height())||
+          (var->Fields()==0))
+      {
+       var->Setup2D(img.Width(),img.Height());
+       bs::ColourRGB ini(0.0,0.0,0.0);
+       var->Add("rgb",ini);
+       var->Commit(false);
+      }
+      var->ByName("rgb",rgb);
+
+     // Copy over...
+      for (nat32 y=0;y<img.Height();y++)
+      {
+       for (nat32 x=0;x<img.Width();x++) rgb.Get(x,y) = img.Get(x,y);
+      }
+      frame->camera = job.camera;
+      frame->shot = job.shot;
+
+     real64 t1 = time::UltraTime();
+     pipe.Record(CapturePipeline::st_decode,t1-t0);
+
+     if (pipe.cams[job.camera].pattern)
+     {
+      job.filename = null<cstr>();
+      job.frame = frame;
+      job.stamp = t1;
+      pipe.toWrite->Add(job);
+     }
+     else pipe.Finish(frame,job.start);
+    }
+   }
+
+ private:
+  CapturePipeline & pipe;
+};
+
+//------------------------------------------------------------------------------
+// The thread that saves frames to disk...
+class WriteStage : public mt::Thread
+{
+ public:
+   WriteStage(CapturePipeline & p):pipe(p) {}
+  ~WriteStage() {}
+
+   void Execute()
+   {
+    LogBlock("void WriteStage::Execute()","-");
+    while (true)
+    {
+     CapturePipeline::Job job;
+     pipe.toWrite->Rem(job);
+     if (job.frame==null<CapturePipeline::Frame*>()) break;
+
+     real64 t0 = time::UltraTime();
+     pipe.Record(CapturePipeline::st_write_wait,t0-job.stamp);
+
+     cstrchar fn[1024];
+     snprintf(fn,sizeof(fn),pipe.cams[job.camera].pattern,job.shot);
+     if (!filter::SaveImageRGB(job.frame->image,fn,true))
+     {
+      LogAlways("[os.capture] Write failed {camera,shot,filename}" << LogDiv() << job.camera << LogDiv() << job.shot << LogDiv() << fn);
+      pipe.failures.Inc();
+     }
+
+     real64 t1 = time::UltraTime();
+     pipe.Record(CapturePipeline::st_write,t1-t0);
+
+     pipe.Finish(job.frame,job.start);
+    }
+   }
+
+ private:
+  CapturePipeline & pipe;
+};
+
+//------------------------------------------------------------------------------
+CapturePipeline::CapturePipeline(svt::Core & c,bit k,nat32 qs,nat32 d)
+:core(c),keep(k),queueSize(math::Max(qs,nat32(1))),decoders(d),running(false),stopping(false),shot(0),
+toDecode(null<ds::ConcurrentQueue<Job>*>()),toWrite(null<ds::ConcurrentQueue<Job>*>()),
+done(null<ds::ConcurrentQueue<Frame*>*>()),pool(null<ds::ConcurrentQueue<Frame*>*>()),
+write(null<WriteStage*>())
+{
+ if (decoders==0) decoders = mt::CoreCount();
+ ResetStats();
+}
+
+CapturePipeline::~CapturePipeline()
+{
+ Stop();
+
+ for (nat32 i=0;i<cams.Size();i++)
+ {
+  mem::Free(cams[i].pattern);
+  delete cams[i].trig;
+ }
+
+ for (nat32 i=0;i<frames.Size();i++)
+ {
+  delete frames[i]->image;
+  delete frames[i];
+ }
+
+ delete toDecode;
+ delete toWrite;
+ delete done;
+ delete pool;
+}
+
+nat32 CapturePipeline::Add(const Camera & cam,cstrconst pattern)
+{
+ if (pool)
+ {
+  LogAlways("[os.capture] Camera added after Start, ignored");
+  return nat32(-1);
+ }
+
+ nat32 ret = cams.Size();
+ cams.Size(ret+1);
+  cams[ret].cam = &cam;
+  cams[ret].pattern = (pattern!=null<cstrconst>())?str::Duplicate(pattern):null<cstr>();
+  cams[ret].trig = new ds::ConcurrentQueue<Job>(queueSize);
+  cams[ret].thread = null<CaptureStage*>();
+ return ret;
+}
+
+bit CapturePipeline::Start()
+{
+ LogBlock("bit CapturePipeline::Start()","-");
+ if (running||(cams.Size()==0)) return false;
+
+ // First time only, create the queues and the pool of frames - enough for
+ // every queue to be full with a frame for each decoder as well...
+  if (pool==null<ds::ConcurrentQueue<Frame*>*>())
+  {
+   nat32 slots = cams.Size()*queueSize;
+   toDecode = new ds::ConcurrentQueue<Job>(slots+decoders);
+   toWrite = new ds::ConcurrentQueue<Job>(slots+1);
+
+   // (done and pool are made big enough to never fill, even after the pool
+   // has been grown by every shot in flight whilst stopping.)
+   nat32 count = slots + decoders + 1;
+   done = new ds::ConcurrentQueue<Frame*>(8*count);
+   pool = new ds::ConcurrentQueue<Frame*>(8*count);
+   for (nat32 i=0;i<count;i++) pool->Add(NewFrame());
+  }
+
+ // Get all the threads going...
+  write = new WriteStage(*this);
+  write->Run();
+
+  decode.Size(decoders);
+  for (nat32 i=0;i<decode.Size();i++)
+  {
+   decode[i] = new DecodeStage(*this);
+   decode[i]->Run();
+  }
+
+  for (nat32 i=0;i<cams.Size();i++)
+  {
+   cams[i].thread = new CaptureStage(*this,i);
+   cams[i].thread->Run();
+  }
+
+ running = true;
+ return true;
+}
+
+bit CapturePipeline::Trigger()
+{
+ if (!running) return false;
+
+ // Check there is space for everyone, so the shot is all or nothing...
+  for (nat32 i=0;i<cams.Size();i++)
+  {
+   if (cams[i].trig->Size()>=queueSize) return false;
+  }
+
+ // Send it out...
+  Job job;
+  job.shot = shot++;
+  job.start = time::UltraTime();
+  job.stamp = job.start;
+  job.filename = null<cstr>();
+  job.frame = null<Frame*>();
+  for (nat32 i=0;i<cams.Size();i++)
+  {
+   job.camera = i;
+   cams[i].trig->Add(job);
+  }
+
+ return true;
+}
+
+CapturePipeline::Frame * CapturePipeline::Get(nat32 timeout)
+{
+ if (done==null<ds::ConcurrentQueue<Frame*>*>()) return null<Frame*>();
+ Frame * ret;
+ if (done->Rem(ret,timeout)) return ret;
+                        else return null<Frame*>();
+}
+
+void CapturePipeline::Release(Frame * frame)
+{
+ pool->Add(frame);
+}
+
+void CapturePipeline::Stop()
+{
+ LogBlock("void CapturePipeline::Stop()","-");
+ if (!running) return;
+
+ // Each stage is told to stop by a message that comes after everything it
+ // has to do, so they are stopped in order, waiting on each...
+  Job job;
+  job.camera = 0;
+  job.shot = 0;
+  job.start = -1.0;
+  job.stamp = 0.0;
+  job.filename = null<cstr>();
+  job.frame = null<Frame*>();
+
+  stopping = true;
+  for (nat32 i=0;i<cams.Size();i++) cams[i].trig->Add(job);
+  for (nat32 i=0;i<cams.Size();i++)
+  {
+   cams[i].thread->Wait();
+   delete cams[i].thread;
+   cams[i].thread = null<CaptureStage*>();
+  }
+
+  for (nat32 i=0;i<decode.Size();i++) toDecode->Add(job);
+  for (nat32 i=0;i<decode.Size();i++)
+  {
+   decode[i]->Wait();
+   delete decode[i];
+  }
+  decode.Size(0);
+
+  toWrite->Add(job);
+  write->Wait();
+  delete write;
+  write = null<WriteStage*>();
+
+ stopping = false;
+ running = false;
+}
+
+CapturePipeline::Stage CapturePipeline::Stats(StageId s) const
+{
+ statLock.Lock();
+  Stage ret = stats[s];
+ statLock.Unlock();
+ return ret;
+}
+
+void CapturePipeline::ResetStats()
+{
+ statLock.Lock();
+  for (nat32 i=0;i<st_count;i++)
+  {
+   stats[i].count = 0;
+   stats[i].total = 0.0;
+   stats[i].min = 0.0;
+   stats[i].max = 0.0;
+  }
+ statLock.Unlock();
+ failures.Set(0);
+}
+
+void CapturePipeline::LogStats() const
+{
+ static cstrconst name[st_count] = {"trigger","download","decode wait","decode","write wait","write","total"};
+ for (nat32 i=0;i<st_count;i++)
+ {
+  Stage s = Stats(StageId(i));
+  LogAlways("[os.capture] Stage statistics {stage,count,mean,min,max}" << LogDiv() << name[i] << LogDiv()
+            << s.count << LogDiv() << s.Mean() << LogDiv() << s.min << LogDiv() << s.max);
+ }
+ LogAlways("[os.capture] {failures}" << LogDiv() << Failures());
+}
+
+void CapturePipeline::Record(StageId s,real64 time)
+{
+ statLock.Lock();
+  Stage & targ = stats[s];
+  if ((targ.count==0)||(time<targ.min)) targ.min = time;
+  if ((targ.count==0)||(time>targ.max)) targ.max = time;
+  targ.count += 1;
+  targ.total += time;
+ statLock.Unlock();
+}
+
+CapturePipeline::Frame * CapturePipeline::NewFrame()
+{
+ Frame * ret = new Frame;
+  ret->camera = 0;
+  ret->shot = 0;
+  ret->image = new svt::Var(core);
+  ret->latency = 0.0;
+
+ frameLock.Lock();
+  frames.Size(frames.Size()+1);
+  frames[frames.Size()-1] = ret;
+ frameLock.Unlock();
+
+ return ret;
+}
+
+CapturePipeline::Frame * CapturePipeline::GetFrame()
+{
+ Frame * ret;
+ while (!pool->Rem(ret,50))
+ {
+  if (stopping)
+  {
+   LogDebug("[os.capture] Growing the frame pool whilst stopping");
+   return NewFrame();
+  }
+ }
+ return ret;
+}
+
+void CapturePipeline::Finish(Frame * frame,real64 start)
+{
+ frame->latency = time::UltraTime() - start;
+ Record(st_total,frame->latency);
+
+ if (keep) done->Add(frame);
+      else pool->Add(frame);
+}
+
+//------------------------------------------------------------------------------
+ };
+};
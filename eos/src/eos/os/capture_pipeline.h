@@ -0,0 +1,225 @@
+#ifndef EOS_OS_CAPTURE_PIPELINE_H
+#define EOS_OS_CAPTURE_PIPELINE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file capture_pipeline.h
+/// Provides an asynchronous pipeline for tethered capture from any number of
+/// cameras, so a rig can keep shooting whilst earlier frames are still being
+/// downloaded, decoded and saved.
+
+#include "eos/types.h"
+#include "eos/os/cameras.h"
+#include "eos/ds/arrays.h"
+#include "eos/ds/concurrent_queues.h"
+#include "eos/mt/threads.h"
+#include "eos/mt/locks.h"
+#include "eos/svt/var.h"
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+class CaptureStage;
+class DecodeStage;
+class WriteStage;
+
+//------------------------------------------------------------------------------
+/// A capture pipeline, for driving a set of cameras. Each call to Trigger takes
+/// a photo with every camera, and the results then go through the stages of
+/// downloading from the camera, decoding into a svt::Var and optionally being
+/// written to disk, each stage running in its own threads with bounded queues
+/// between them. The decoded frames are then returned by Get, in the order
+/// they finish. The svt::Var-s are pooled, so once warmed up no image sized
+/// allocations are made, and frames must be handed back with Release.
+///
+/// Each camera has its own thread that triggers then downloads, as gphoto can
+/// not talk to a camera from two threads at once - the two stages are timed
+/// seperatly however. Triggers are queued per camera, so whilst the cameras
+/// fire as soon as they are free the only guarantee of simultaneous capture is
+/// to not trigger again until the previous frames have arrived. If the queues
+/// back up, because frames are not being Release-d or the disk can not keep
+/// up, Trigger refuses rather than letting them grow.
+///
+/// The time each frame spends in each stage, and waiting for each stage, is
+/// recorded, so you can see where the time is going.
+class EOS_CLASS CapturePipeline
+{
+ public:
+  /// One captured frame, as returned by Get.
+   struct Frame
+   {
+    nat32 camera; ///< Index of the camera, as returned by Add.
+    nat32 shot; ///< Which call to Trigger it came from, starting at 0.
+    svt::Var * image; ///< 2D, with a "rgb" field of bs::ColourRGB. Owned by the pipeline.
+    real64 latency; ///< Seconds from the call to Trigger to it being ready for Get.
+   };
+
+  /// The stages, for indexing the statistics.
+   enum StageId {st_trigger, ///< Taking the photo.
+                 st_download, ///< Getting it from the camera.
+                 st_decode_wait, ///< Queued for a decoder.
+                 st_decode, ///< Decoding it into a svt::Var, including getting a buffer.
+                 st_write_wait, ///< Queued for the writer.
+                 st_write, ///< Saving it to disk.
+                 st_total, ///< From Trigger being called to being ready for Get.
+                 st_count};
+
+  /// Timing statistics for a stage, in seconds.
+   struct Stage
+   {
+    nat32 count; ///< How many frames have been through the stage.
+    real64 total; ///< Total time.
+    real64 min; ///< Shortest time, 0 if count is 0.
+    real64 max; ///< Longest time.
+
+    /// Returns the mean, or 0 if count is 0.
+     real64 Mean() const {return (count!=0)?(total/real64(count)):0.0;}
+   };
+
+
+  /// The svt::Core is used to make the frames. queueSize is the number of
+  /// shots each queue can hold, decoders the number of decoding threads, 0 to
+  /// use one per core. If keep is false frames are not returned by Get, for when
+  /// only writing to disk is wanted.
+   CapturePipeline(svt::Core & core,bit keep = true,nat32 queueSize = 4,nat32 decoders = 0);
+
+  /// Calls Stop.
+   ~CapturePipeline();
+
+
+  /// Adds a camera, which must be active and stay so until Stop is called.
+  /// Can only be called before the first call to Start. If pattern is given every frame from the
+  /// camera is saved, pattern being a printf style filename with a single %u,
+  /// or similar, that is given the shot number. Returns the cameras index.
+   nat32 Add(const Camera & cam,cstrconst pattern = null<cstrconst>());
+
+  /// Starts all the threads, returns false if there are no cameras or it is
+  /// allready running.
+   bit Start();
+
+  /// Takes a photo with every camera. Returns false, with nothing happening, if
+  /// not running or if any camera still has queueSize shots waiting. Should
+  /// only be called from one thread.
+   bit Trigger();
+
+  /// Returns the next frame that is ready, blocking until there is one. The
+  /// timeout is in milliseconds, 0xFFFFFFFF meaning forever, and null is
+  /// returned if it expires. Frames that fail to be taken, downloaded or
+  /// decoded never arrive, whilst failing to write one is only counted.
+   Frame * Get(nat32 timeout = 0xFFFFFFFF);
+
+  /// Hands a frame from Get back, so its svt::Var can be reused.
+   void Release(Frame * frame);
+
+  /// Waits for every shot triggered to finish, then stops all the threads.
+  /// Frames not yet collected with Get can still be, but no more triggering is
+  /// possible until Start is called again. Does nothing if not running. As
+  /// Get may not be called whilst this runs the frame pool can grow.
+   void Stop();
+
+  /// Returns true between Start and Stop.
+   bit Running() const {return running;}
+
+
+  /// Returns the statistics for a stage.
+   Stage Stats(StageId s) const;
+
+  /// Returns how many frames have been lost to failures, which are logged.
+   nat32 Failures() const {return nat32(failures.Get());}
+
+  /// Resets all the statistics.
+   void ResetStats();
+
+  /// Writes all the statistics to the log.
+   void LogStats() const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::os::CapturePipeline";}
+
+
+ private:
+  friend class CaptureStage;
+  friend class DecodeStage;
+  friend class WriteStage;
+
+  // A shot on its way through the pipeline before it has a Frame...
+   struct Job
+   {
+    nat32 camera;
+    nat32 shot;
+    real64 start; // When it was triggered.
+    real64 stamp; // When it entered the current queue.
+    cstr filename; // The downloaded file, null if its the stop message.
+    Frame * frame; // Only once decoded.
+   };
+
+  // Per camera data...
+   struct Cam
+   {
+    const Camera * cam;
+    cstr pattern;
+    ds::ConcurrentQueue<Job> * trig; // Shots not yet taken, a negative start means stop.
+    CaptureStage * thread;
+   };
+
+  svt::Core & core;
+  bit keep;
+  nat32 queueSize;
+  nat32 decoders;
+
+  bit running;
+  volatile bit stopping;
+  nat32 shot;
+  ds::Array<Cam> cams;
+
+  ds::ConcurrentQueue<Job> * toDecode;
+  ds::ConcurrentQueue<Job> * toWrite;
+  ds::ConcurrentQueue<Frame*> * done;
+  ds::ConcurrentQueue<Frame*> * pool; // Frames with no current use.
+  mt::OwnedLock frameLock;
+  ds::Array<Frame*> frames; // Every frame, for deleting them.
+  ds::Array<DecodeStage*> decode;
+  WriteStage * write;
+
+  mt::Atomic failures;
+  mt::OwnedLock statLock;
+  Stage stats[st_count];
+
+  // Records a time for a stage...
+   void Record(StageId s,real64 time);
+
+  // Makes a new frame, with an empty svt::Var...
+   Frame * NewFrame();
+
+  // Gets a frame from the pool for a decoder. Normally this waits for one to
+  // be free, but whilst stopping there may be nobody calling Get to free them,
+  // so the pool is grown instead...
+   Frame * GetFrame();
+
+  // Called when a frame has been through every stage, sends it to Get or
+  // back to the pool...
+   void Finish(Frame * frame,real64 start);
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -0,0 +1,709 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/os/compute.h"
+
+#include "eos/mem/alloc.h"
+#include "eos/mem/functions.h"
+#include "eos/str/functions.h"
+#include "eos/math/functions.h"
+#include "eos/file/csv.h"
+
+#include <stdlib.h>
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+// The kernels, in OpenCL C. Each matches one of the CPU versions further
+// down, which are the reference...
+static const char * computeSource =
+"__kernel void sad_hor(__global const float * left,__global const float * right,int channels,\n"
+"                      int width,int widthRight,int height,int minDisp,int radius,float maxDiff,\n"
+"                      __global float * hor)\n"
+"{\n"
+" int x = get_global_id(0); int y = get_global_id(1); int d = get_global_id(2);\n"
+" int disp = minDisp + d;\n"
+" float sum = 0.0f;\n"
+" for (int u=-radius;u<=radius;u++)\n"
+" {\n"
+"  int lx = x + u; int rx = lx + disp;\n"
+"  if ((lx<0)||(lx>=width)||(rx<0)||(rx>=widthRight)) {sum += maxDiff; continue;}\n"
+"  for (int c=0;c<channels;c++) sum += fabs(left[(c*height + y)*width + lx] - right[(c*height + y)*widthRight + rx]);\n"
+" }\n"
+" hor[(d*height + y)*width + x] = sum;\n"
+"}\n"
+"\n"
+"__kernel void sad_ver(__global const float * hor,int width,int height,int radius,__global float * out)\n"
+"{\n"
+" int x = get_global_id(0); int y = get_global_id(1); int d = get_global_id(2);\n"
+" int low = max(y-radius,0); int high = min(y+radius,height-1);\n"
+" float sum = 0.0f;\n"
+" for (int v=low;v<=high;v++) sum += hor[(d*height + v)*width + x];\n"
+" out[(d*height + y)*width + x] = sum;\n"
+"}\n"
+"\n"
+"__kernel void sep_hor(__global const float * in,__global float * im,int width,int height,int half,\n"
+"                      __global const float * h)\n"
+"{\n"
+" int x = get_global_id(0); int y = get_global_id(1);\n"
+" float sum = 0.0f;\n"
+" for (int i=0;i<=half*2;i++) sum += h[i] * in[y*width + clamp(x+i-half,0,width-1)];\n"
+" im[y*width + x] = sum;\n"
+"}\n"
+"\n"
+"__kernel void sep_ver(__global const float * im,__global float * out,int width,int height,int half,\n"
+"                      __global const float * v,int repeat)\n"
+"{\n"
+" int x = get_global_id(0); int y = get_global_id(1);\n"
+" float sum = 0.0f;\n"
+" if (repeat||((x>=half)&&(x+half<width)&&(y>=half)&&(y+half<height)))\n"
+" {\n"
+"  for (int i=0;i<=half*2;i++) sum += v[i] * im[clamp(y+i-half,0,height-1)*width + x];\n"
+" }\n"
+" out[y*width + x] = sum;\n"
+"}\n"
+"\n"
+"__kernel void wta(__global const float * cost,int width,int height,int depth,int minDisp,__global float * out)\n"
+"{\n"
+" int p = get_global_id(1)*width + get_global_id(0);\n"
+" int plane = width*height;\n"
+" int best = 0;\n"
+" for (int d=1;d<depth;d++) {if (cost[d*plane + p]<cost[best*plane + p]) best = d;}\n"
+" out[p] = minDisp + best;\n"
+"}\n"
+"\n"
+"__kernel void bp_update(__global const float * cost,__global float * msg,__global float * scratch,\n"
+"                        int width,int height,int labels,float mult,float trunc,int parity)\n"
+"{\n"
+" int x = get_global_id(0); int y = get_global_id(1);\n"
+" if (((x+y)&1)!=parity) return;\n"
+" int plane = width*height; int vol = plane*labels;\n"
+" int p = y*width + x;\n"
+" __global float * h = scratch + p;\n"
+" for (int dir=0;dir<4;dir++)\n"
+" {\n"
+"  int q; int slot; int skip;\n"
+"  if (dir==0) {if (x+1>=width) continue; q = p+1; slot = 0; skip = 1;}\n"
+"  else if (dir==1) {if (x==0) continue; q = p-1; slot = 1; skip = 0;}\n"
+"  else if (dir==2) {if (y+1>=height) continue; q = p+width; slot = 2; skip = 3;}\n"
+"  else {if (y==0) continue; q = p-width; slot = 3; skip = 2;}\n"
+"\n"
+"  float low = MAXFLOAT;\n"
+"  for (int l=0;l<labels;l++)\n"
+"  {\n"
+"   float v = cost[l*plane + p];\n"
+"   for (int s=0;s<4;s++) {if (s!=skip) v += msg[s*vol + l*plane + p];}\n"
+"   h[l*plane] = v;\n"
+"   low = min(low,v);\n"
+"  }\n"
+"  for (int l=1;l<labels;l++) h[l*plane] = min(h[l*plane],h[(l-1)*plane] + mult);\n"
+"  for (int l=labels-2;l>=0;l--) h[l*plane] = min(h[l*plane],h[(l+1)*plane] + mult);\n"
+"\n"
+"  float cap = low + mult*trunc;\n"
+"  float sum = 0.0f;\n"
+"  for (int l=0;l<labels;l++) {h[l*plane] = min(h[l*plane],cap); sum += h[l*plane];}\n"
+"  sum /= labels;\n"
+"  for (int l=0;l<labels;l++) msg[slot*vol + l*plane + q] = h[l*plane] - sum;\n"
+" }\n"
+"}\n"
+"\n"
+"__kernel void bp_belief(__global const float * cost,__global const float * msg,int width,int height,\n"
+"                        int labels,int minDisp,__global float * out)\n"
+"{\n"
+" int p = get_global_id(1)*width + get_global_id(0);\n"
+" int plane = width*height; int vol = plane*labels;\n"
+" int best = 0; float bestCost = 0.0f;\n"
+" for (int l=0;l<labels;l++)\n"
+" {\n"
+"  float v = cost[l*plane + p] + msg[l*plane + p] + msg[vol + l*plane + p] +\n"
+"            msg[2*vol + l*plane + p] + msg[3*vol + l*plane + p];\n"
+"  if ((l==0)||(v<bestCost)) {best = l; bestCost = v;}\n"
+" }\n"
+" out[p] = minDisp + best;\n"
+"}\n";
+
+static const char * kernelName[] = {"sad_hor","sad_ver","sep_hor","sep_ver","wta","bp_update","bp_belief"};
+
+//------------------------------------------------------------------------------
+Compute & Compute::Default()
+{
+ static Compute dev;
+ return dev;
+}
+
+Compute::Compute()
+:active(false),name(str::Duplicate("cpu")),
+context(null<cl_context>()),queue(null<cl_command_queue>()),program(null<cl_program>())
+{
+ LogBlock("eos::os::Compute::Compute","");
+ for (nat32 i=0;i<kernelCount;i++) kernel[i] = null<cl_kernel>();
+
+ // Check if we are even allowed to try...
+  cstrconst env = getenv("EOS_COMPUTE");
+  if (env&&(str::Compare(env,"cpu")==0)) return;
+  bit any = env&&(str::Compare(env,"any")==0);
+  if (!LoadOpenCL()) return;
+
+ // Find a device, the first suitable one of the first platform that has one...
+  static const nat32 maxPlatforms = 8;
+  cl_platform_id platform[maxPlatforms];
+  cl_uint platforms = 0;
+  if (clGetPlatformIDs(maxPlatforms,platform,&platforms)!=CL_SUCCESS) platforms = 0;
+
+  cl_device_id device = null<cl_device_id>();
+  ptrdiff_t props[3] = {CL_CONTEXT_PLATFORM,0,0};
+  for (nat32 i=0;i<math::Min<nat32>(platforms,maxPlatforms);i++)
+  {
+   cl_uint devices = 0;
+   if ((clGetDeviceIDs(platform[i],any?CL_DEVICE_TYPE_ALL:CL_DEVICE_TYPE_GPU,1,&device,&devices)==CL_SUCCESS)&&(devices!=0))
+   {
+    props[1] = ptrdiff_t(platform[i]);
+    break;
+   }
+   device = null<cl_device_id>();
+  }
+
+  if (device==null<cl_device_id>())
+  {
+   LogAlways("[compute] No OpenCL device found, using the cpu");
+   return;
+  }
+
+ // Create the context and queue...
+  cl_int err;
+  context = clCreateContext(props,1,&device,null<void*>(),null<void*>(),&err);
+  if (err!=CL_SUCCESS) {context = null<cl_context>(); Release(); return;}
+
+  queue = clCreateCommandQueue(context,device,0,&err);
+  if (err!=CL_SUCCESS) {queue = null<cl_command_queue>(); Release(); return;}
+
+ // Build the kernels...
+  program = clCreateProgramWithSource(context,1,&computeSource,null<size_t*>(),&err);
+  if (err!=CL_SUCCESS) {program = null<cl_program>(); Release(); return;}
+
+  if (clBuildProgram(program,1,&device,"",null<void*>(),null<void*>())!=CL_SUCCESS)
+  {
+   char buildLog[4096];
+   buildLog[0] = 0;
+   clGetProgramBuildInfo(program,device,CL_PROGRAM_BUILD_LOG,sizeof(buildLog)-1,buildLog,null<size_t*>());
+   buildLog[sizeof(buildLog)-1] = 0;
+   LogAlways("[compute] Kernel build failed, using the cpu" << LogDiv() << buildLog);
+   Release();
+   return;
+  }
+
+  for (nat32 i=0;i<kernelCount;i++)
+  {
+   kernel[i] = clCreateKernel(program,kernelName[i],&err);
+   if (err!=CL_SUCCESS) {kernel[i] = null<cl_kernel>(); Release(); return;}
+  }
+
+ // Success...
+  char devName[256];
+  if (clGetDeviceInfo(device,CL_DEVICE_NAME,sizeof(devName)-1,devName,null<size_t*>())!=CL_SUCCESS) devName[0] = 0;
+  devName[sizeof(devName)-1] = 0;
+  mem::Free(name);
+  name = str::Duplicate(devName);
+  active = true;
+
+  LogAlways("[compute] Using OpenCL device" << LogDiv() << name);
+}
+
+Compute::~Compute()
+{
+ Release();
+ mem::Free(name);
+}
+
+void Compute::SadVolume(const ComputeBuffer & left,const ComputeBuffer & right,nat32 channels,
+                        nat32 width,nat32 widthRight,nat32 height,
+                        int32 minDisp,nat32 depth,nat32 radius,real32 maxDiff,ComputeBuffer & out)
+{
+ if (DevSadVolume(left,right,channels,width,widthRight,height,minDisp,depth,radius,maxDiff,out)) return;
+
+ // Horizontal sums a row at a time, then the vertical sums for all columns
+ // with a running total per column...
+  const real32 * l = left.Map();
+  const real32 * r = right.Map();
+  real32 * o = out.Map();
+
+  nat32 plane = width*height;
+  real32 * hor = mem::Malloc<real32>(plane);
+  real32 * col = mem::Malloc<real32>(width);
+  for (nat32 d=0;d<depth;d++)
+  {
+   int32 disp = minDisp + int32(d);
+   for (nat32 y=0;y<height;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     real32 sum = 0.0;
+     for (int32 u=-int32(radius);u<=int32(radius);u++)
+     {
+      int32 lx = int32(x) + u;
+      int32 rx = lx + disp;
+      if ((lx<0)||(lx>=int32(width))||(rx<0)||(rx>=int32(widthRight))) {sum += maxDiff; continue;}
+      for (nat32 c=0;c<channels;c++)
+      {
+       sum += math::Abs(l[(c*height + y)*width + lx] - r[(c*height + y)*widthRight + rx]);
+      }
+     }
+     hor[y*width + x] = sum;
+    }
+   }
+
+   real32 * targ = o + d*plane;
+   for (nat32 x=0;x<width;x++) col[x] = 0.0;
+   for (nat32 y=0;(y<radius)&&(y<height);y++)
+   {
+    for (nat32 x=0;x<width;x++) col[x] += hor[y*width + x];
+   }
+   for (nat32 y=0;y<height;y++)
+   {
+    if (y+radius<height)
+    {
+     for (nat32 x=0;x<width;x++) col[x] += hor[(y+radius)*width + x];
+    }
+    if (y>radius)
+    {
+     for (nat32 x=0;x<width;x++) col[x] -= hor[(y-radius-1)*width + x];
+    }
+    for (nat32 x=0;x<width;x++) targ[y*width + x] = col[x];
+   }
+  }
+  mem::Free(col);
+  mem::Free(hor);
+
+  out.Unmap(true);
+  right.Unmap(false);
+  left.Unmap(false);
+}
+
+void Compute::SepConvolve(const ComputeBuffer & in,ComputeBuffer & out,nat32 width,nat32 height,
+                          nat32 half,const real32 * h,const real32 * v,bit repeat)
+{
+ if (DevSepConvolve(in,out,width,height,half,h,v,repeat)) return;
+
+ const real32 * i = in.Map();
+ real32 * o = out.Map();
+
+ real32 * im = mem::Malloc<real32>(width*height);
+ for (nat32 y=0;y<height;y++)
+ {
+  for (nat32 x=0;x<width;x++)
+  {
+   real32 sum = 0.0;
+   for (nat32 k=0;k<=half*2;k++)
+   {
+    sum += h[k] * i[y*width + math::Clamp<int32>(int32(x+k)-int32(half),0,width-1)];
+   }
+   im[y*width + x] = sum;
+  }
+ }
+
+ for (nat32 y=0;y<height;y++)
+ {
+  for (nat32 x=0;x<width;x++)
+  {
+   real32 sum = 0.0;
+   if (repeat||((x>=half)&&(x+half<width)&&(y>=half)&&(y+half<height)))
+   {
+    for (nat32 k=0;k<=half*2;k++)
+    {
+     sum += v[k] * im[math::Clamp<int32>(int32(y+k)-int32(half),0,height-1)*width + x];
+    }
+   }
+   o[y*width + x] = sum;
+  }
+ }
+ mem::Free(im);
+
+ out.Unmap(true);
+ in.Unmap(false);
+}
+
+void Compute::WinnerTakeAll(const ComputeBuffer & cost,nat32 width,nat32 height,nat32 depth,
+                            int32 minDisp,ComputeBuffer & out)
+{
+ if (DevWinnerTakeAll(cost,width,height,depth,minDisp,out)) return;
+
+ const real32 * c = cost.Map();
+ real32 * o = out.Map();
+
+ nat32 plane = width*height;
+ for (nat32 p=0;p<plane;p++)
+ {
+  nat32 best = 0;
+  for (nat32 d=1;d<depth;d++)
+  {
+   if (c[d*plane + p]<c[best*plane + p]) best = d;
+  }
+  o[p] = minDisp + int32(best);
+ }
+
+ out.Unmap(true);
+ cost.Unmap(false);
+}
+
+void Compute::TruncLinearBP(const ComputeBuffer & cost,nat32 width,nat32 height,nat32 labels,
+                            real32 mult,real32 trunc,nat32 iters,int32 minDisp,ComputeBuffer & out)
+{
+ if (DevTruncLinearBP(cost,width,height,labels,mult,trunc,iters,minDisp,out)) return;
+
+ const real32 * c = cost.Map();
+ real32 * o = out.Map();
+
+ // The messages are 4 volumes, indexed by the direction they arrive from -
+ // left, right, above and below...
+  nat32 plane = width*height;
+  nat32 vol = plane*labels;
+  real32 * msg = mem::Malloc<real32>(vol*4);
+  for (nat32 i=0;i<vol*4;i++) msg[i] = 0.0;
+  real32 * h = mem::Malloc<real32>(labels);
+
+ // Checkerboard sweeps...
+  for (nat32 iter=0;iter<iters;iter++)
+  {
+   for (nat32 parity=0;parity<2;parity++)
+   {
+    for (nat32 y=0;y<height;y++)
+    {
+     for (nat32 x=(y+parity)%2;x<width;x+=2)
+     {
+      nat32 p = y*width + x;
+      for (nat32 dir=0;dir<4;dir++)
+      {
+       nat32 q,slot,skip;
+       if (dir==0) {if (x+1>=width) continue; q = p+1; slot = 0; skip = 1;}
+       else if (dir==1) {if (x==0) continue; q = p-1; slot = 1; skip = 0;}
+       else if (dir==2) {if (y+1>=height) continue; q = p+width; slot = 2; skip = 3;}
+       else {if (y==0) continue; q = p-width; slot = 3; skip = 2;}
+
+       // Gather, then the distance transform for the linear part, then the
+       // truncation and normalisation...
+        real32 low = math::Infinity<real32>();
+        for (nat32 l=0;l<labels;l++)
+        {
+         real32 v = c[l*plane + p];
+         for (nat32 s=0;s<4;s++) {if (s!=skip) v += msg[s*vol + l*plane + p];}
+         h[l] = v;
+         low = math::Min(low,v);
+        }
+        for (nat32 l=1;l<labels;l++) h[l] = math::Min(h[l],h[l-1] + mult);
+        for (int32 l=int32(labels)-2;l>=0;l--) h[l] = math::Min(h[l],h[l+1] + mult);
+
+        real32 cap = low + mult*trunc;
+        real32 sum = 0.0;
+        for (nat32 l=0;l<labels;l++) {h[l] = math::Min(h[l],cap); sum += h[l];}
+        sum /= real32(labels);
+        for (nat32 l=0;l<labels;l++) msg[slot*vol + l*plane + q] = h[l] - sum;
+      }
+     }
+    }
+   }
+  }
+
+ // Beliefs...
+  for (nat32 p=0;p<plane;p++)
+  {
+   nat32 best = 0;
+   real32 bestCost = 0.0;
+   for (nat32 l=0;l<labels;l++)
+   {
+    real32 v = c[l*plane + p] + msg[l*plane + p] + msg[vol + l*plane + p] +
+               msg[2*vol + l*plane + p] + msg[3*vol + l*plane + p];
+    if ((l==0)||(v<bestCost)) {best = l; bestCost = v;}
+   }
+   o[p] = minDisp + int32(best);
+  }
+
+ mem::Free(h);
+ mem::Free(msg);
+
+ out.Unmap(true);
+ cost.Unmap(false);
+}
+
+void Compute::Release()
+{
+ for (nat32 i=0;i<kernelCount;i++)
+ {
+  if (kernel[i]) clReleaseKernel(kernel[i]);
+  kernel[i] = null<cl_kernel>();
+ }
+ if (program) clReleaseProgram(program);
+ if (queue) clReleaseCommandQueue(queue);
+ if (context) clReleaseContext(context);
+
+ program = null<cl_program>();
+ queue = null<cl_command_queue>();
+ context = null<cl_context>();
+ active = false;
+}
+
+bit Compute::Launch(nat32 k,nat32 width,nat32 height,nat32 depth)
+{
+ size_t global[3];
+ global[0] = width;
+ global[1] = height;
+ global[2] = depth;
+
+ cl_int err = clEnqueueNDRangeKernel(queue,kernel[k],(depth==1)?2:3,null<size_t*>(),global,null<size_t*>(),
+                                     0,null<cl_event*>(),null<cl_event*>());
+ if (err!=CL_SUCCESS)
+ {
+  LogAlways("[compute] Kernel launch failed" << LogDiv() << kernelName[k] << LogDiv() << err);
+  return false;
+ }
+ return true;
+}
+
+bit Compute::DevSadVolume(const ComputeBuffer & left,const ComputeBuffer & right,nat32 channels,
+                          nat32 width,nat32 widthRight,nat32 height,
+                          int32 minDisp,nat32 depth,nat32 radius,real32 maxDiff,ComputeBuffer & out)
+{
+ if (!(active&&left.Resident()&&right.Resident()&&out.Resident())) return false;
+
+ ComputeBuffer hor(width*height*depth,*this);
+ if (!hor.Resident()) return false;
+
+ mt::AutoLock al(lock);
+ int32 ch = channels; int32 w = width; int32 wr = widthRight; int32 h = height; int32 r = radius;
+ return Arg(k_sad_hor,0,left.buf) && Arg(k_sad_hor,1,right.buf) && Arg(k_sad_hor,2,ch) &&
+        Arg(k_sad_hor,3,w) && Arg(k_sad_hor,4,wr) && Arg(k_sad_hor,5,h) && Arg(k_sad_hor,6,minDisp) &&
+        Arg(k_sad_hor,7,r) && Arg(k_sad_hor,8,maxDiff) && Arg(k_sad_hor,9,hor.buf) &&
+        Launch(k_sad_hor,width,height,depth) &&
+        Arg(k_sad_ver,0,hor.buf) && Arg(k_sad_ver,1,w) && Arg(k_sad_ver,2,h) && Arg(k_sad_ver,3,r) &&
+        Arg(k_sad_ver,4,out.buf) &&
+        Launch(k_sad_ver,width,height,depth);
+}
+
+bit Compute::DevSepConvolve(const ComputeBuffer & in,ComputeBuffer & out,nat32 width,nat32 height,
+                            nat32 half,const real32 * h,const real32 * v,bit repeat)
+{
+ if (!(active&&in.Resident()&&out.Resident())) return false;
+
+ ComputeBuffer im(width*height,*this);
+ ComputeBuffer hk(half*2+1,*this);
+ ComputeBuffer vk(half*2+1,*this);
+ if (!(im.Resident()&&hk.Resident()&&vk.Resident())) return false;
+ hk.Write(h,half*2+1);
+ vk.Write(v,half*2+1);
+
+ mt::AutoLock al(lock);
+ int32 w = width; int32 ht = height; int32 hf = half; int32 rep = repeat?1:0;
+ return Arg(k_sep_hor,0,in.buf) && Arg(k_sep_hor,1,im.buf) && Arg(k_sep_hor,2,w) &&
+        Arg(k_sep_hor,3,ht) && Arg(k_sep_hor,4,hf) && Arg(k_sep_hor,5,hk.buf) &&
+        Launch(k_sep_hor,width,height) &&
+        Arg(k_sep_ver,0,im.buf) && Arg(k_sep_ver,1,out.buf) && Arg(k_sep_ver,2,w) &&
+        Arg(k_sep_ver,3,ht) && Arg(k_sep_ver,4,hf) && Arg(k_sep_ver,5,vk.buf) && Arg(k_sep_ver,6,rep) &&
+        Launch(k_sep_ver,width,height);
+}
+
+bit Compute::DevWinnerTakeAll(const ComputeBuffer & cost,nat32 width,nat32 height,nat32 depth,
+                              int32 minDisp,ComputeBuffer & out)
+{
+ if (!(active&&cost.Resident()&&out.Resident())) return false;
+
+ mt::AutoLock al(lock);
+ int32 w = width; int32 h = height; int32 d = depth;
+ return Arg(k_wta,0,cost.buf) && Arg(k_wta,1,w) && Arg(k_wta,2,h) && Arg(k_wta,3,d) &&
+        Arg(k_wta,4,minDisp) && Arg(k_wta,5,out.buf) &&
+        Launch(k_wta,width,height);
+}
+
+bit Compute::DevTruncLinearBP(const ComputeBuffer & cost,nat32 width,nat32 height,nat32 labels,
+                              real32 mult,real32 trunc,nat32 iters,int32 minDisp,ComputeBuffer & out)
+{
+ if (!(active&&cost.Resident()&&out.Resident())) return false;
+
+ nat32 vol = width*height*labels;
+ ComputeBuffer msg(vol*4,*this);
+ ComputeBuffer scratch(vol,*this);
+ if (!(msg.Resident()&&scratch.Resident())) return false;
+
+ // Zero the messages, with a plane at a time from main memory...
+  {
+   real32 * zero = mem::Malloc<real32>(vol);
+   for (nat32 i=0;i<vol;i++) zero[i] = 0.0;
+   for (nat32 i=0;i<4;i++) msg.Write(zero,vol,i*vol);
+   mem::Free(zero);
+  }
+
+ mt::AutoLock al(lock);
+ int32 w = width; int32 h = height; int32 l = labels;
+ if (!(Arg(k_bp_update,0,cost.buf) && Arg(k_bp_update,1,msg.buf) && Arg(k_bp_update,2,scratch.buf) &&
+       Arg(k_bp_update,3,w) && Arg(k_bp_update,4,h) && Arg(k_bp_update,5,l) &&
+       Arg(k_bp_update,6,mult) && Arg(k_bp_update,7,trunc))) return false;
+
+ for (nat32 iter=0;iter<iters;iter++)
+ {
+  for (int32 parity=0;parity<2;parity++)
+  {
+   if (!(Arg(k_bp_update,8,parity) && Launch(k_bp_update,width,height))) return false;
+  }
+ }
+
+ return Arg(k_bp_belief,0,cost.buf) && Arg(k_bp_belief,1,msg.buf) && Arg(k_bp_belief,2,w) &&
+        Arg(k_bp_belief,3,h) && Arg(k_bp_belief,4,l) && Arg(k_bp_belief,5,minDisp) &&
+        Arg(k_bp_belief,6,out.buf) &&
+        Launch(k_bp_belief,width,height);
+}
+
+//------------------------------------------------------------------------------
+ComputeBuffer::ComputeBuffer(Compute & d)
+:dev(d),size(0),buf(null<cl_mem>()),host(null<real32*>())
+{}
+
+ComputeBuffer::ComputeBuffer(nat32 s,Compute & d)
+:dev(d),size(0),buf(null<cl_mem>()),host(null<real32*>())
+{
+ Resize(s);
+}
+
+ComputeBuffer::~ComputeBuffer()
+{
+ Resize(0);
+}
+
+void ComputeBuffer::Resize(nat32 s)
+{
+ if (buf) clReleaseMemObject(buf);
+ mem::Free(host);
+  buf = null<cl_mem>();
+ host = null<real32*>();
+
+ size = s;
+ if (size==0) return;
+
+ if (dev.Active())
+ {
+  cl_int err;
+  buf = clCreateBuffer(dev.context,CL_MEM_READ_WRITE,size*sizeof(real32),null<void*>(),&err);
+  if (err==CL_SUCCESS) return;
+
+  LogAlways("[compute] Device allocation failed, using main memory" << LogDiv() << size << LogDiv() << err);
+  buf = null<cl_mem>();
+ }
+ host = mem::Malloc<real32>(size);
+}
+
+void ComputeBuffer::Write(const real32 * data,nat32 s,nat32 offset)
+{
+ if (buf)
+ {
+  cl_int err = clEnqueueWriteBuffer(dev.queue,buf,CL_TRUE,offset*sizeof(real32),s*sizeof(real32),data,
+                                    0,null<cl_event*>(),null<cl_event*>());
+  if (err!=CL_SUCCESS) LogAlways("[compute] Write failed" << LogDiv() << err);
+ }
+ else mem::Copy(host + offset,data,s);
+}
+
+void ComputeBuffer::Read(real32 * data,nat32 s,nat32 offset) const
+{
+ if (buf)
+ {
+  cl_int err = clEnqueueReadBuffer(dev.queue,buf,CL_TRUE,offset*sizeof(real32),s*sizeof(real32),data,
+                                   0,null<cl_event*>(),null<cl_event*>());
+  if (err!=CL_SUCCESS) LogAlways("[compute] Read failed" << LogDiv() << err);
+ }
+ else mem::Copy(data,host + offset,s);
+}
+
+void ComputeBuffer::Upload(const svt::Field<real32> & field,nat32 offset)
+{
+ nat32 width = field.Size(0);
+ nat32 height = field.Size(1);
+ nat32 depth = (field.Dims()>2)?field.Size(2):1;
+ nat32 count = width*height*depth;
+ if (offset+count>size) Resize(offset+count);
+
+ real32 * data = mem::Malloc<real32>(count);
+ real32 * targ = data;
+ for (nat32 z=0;z<depth;z++)
+ {
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    *targ = (depth==1)?field.Get(x,y):field.Get(x,y,z);
+    ++targ;
+   }
+  }
+ }
+
+ Write(data,count,offset);
+ mem::Free(data);
+}
+
+void ComputeBuffer::Download(svt::Field<real32> & field,nat32 offset) const
+{
+ nat32 width = field.Size(0);
+ nat32 height = field.Size(1);
+ nat32 depth = (field.Dims()>2)?field.Size(2):1;
+ nat32 count = width*height*depth;
+
+ real32 * data = mem::Malloc<real32>(count);
+ Read(data,count,offset);
+
+ const real32 * targ = data;
+ for (nat32 z=0;z<depth;z++)
+ {
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    if (depth==1) field.Get(x,y) = *targ;
+             else field.Get(x,y,z) = *targ;
+    ++targ;
+   }
+  }
+ }
+
+ mem::Free(data);
+}
+
+real32 * ComputeBuffer::Map() const
+{
+ if (buf)
+ {
+  host = mem::Malloc<real32>(size);
+  Read(host,size);
+ }
+ return host;
+}
+
+void ComputeBuffer::Unmap(bit changed) const
+{
+ if (buf)
+ {
+  if (changed)
+  {
+   cl_int err = clEnqueueWriteBuffer(dev.queue,buf,CL_TRUE,0,size*sizeof(real32),host,
+                                     0,null<cl_event*>(),null<cl_event*>());
+   if (err!=CL_SUCCESS) LogAlways("[compute] Write failed" << LogDiv() << err);
+  }
+  mem::Free(host);
+  host = null<real32*>();
+ }
+}
+
+//------------------------------------------------------------------------------
+ };
+};
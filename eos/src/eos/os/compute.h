@@ -0,0 +1,212 @@
+#ifndef EOS_OS_COMPUTE_H
+#define EOS_OS_COMPUTE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file compute.h
+/// Provides an optional GPU backend, via OpenCL, for the bandwidth bound
+/// stages of the stereo pipeline, with a CPU fallback for when there is no
+/// device.
+
+#include "eos/types.h"
+#include "eos/os/opencl_funcs.h"
+#include "eos/mt/locks.h"
+#include "eos/svt/field.h"
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+class ComputeBuffer;
+
+//------------------------------------------------------------------------------
+/// The compute device, a singleton obtained with Default(). On first use it
+/// loads OpenCL, picks a device and builds the kernels; if any of that fails,
+/// or there simply isn't a device, Active() is false and everything runs on
+/// the CPU instead, with the same results bar floating point ordering. The
+/// environment variable EOS_COMPUTE selects the device - "cpu" never uses
+/// OpenCL, "any" takes the first device of any type and otherwise only a GPU
+/// will do, as an OpenCL CPU device gains nothing over the native code.
+///
+/// The operations all work on ComputeBuffer-s, which live on the device when
+/// its active, so a chain of operations only crosses the bus at either end.
+/// Volumes are laid out as svt::Field-s are when packed - x fastest, then y,
+/// then the third dimension - with multiple channels as consecutive slices.
+/// The operations are thread safe, though they serialise on the device.
+class EOS_CLASS Compute
+{
+ public:
+  /// Returns the process wide device.
+   static Compute & Default();
+
+
+  /// Returns true if operations run on an OpenCL device, false if on the CPU.
+   bit Active() const {return active;}
+
+  /// Returns the name of the device in use, "cpu" if not Active().
+   cstrconst Name() const {return name;}
+
+
+  /// Calculates a sum of absolute differences cost volume, exactly as
+  /// stereo::Sad does - left is channels slices of width x height, right
+  /// channels slices of widthRight x height, out depth slices of width x
+  /// height, for disparities starting at minDisp. Outside the images the
+  /// absolute difference is maxDiff horizontally, with the window simply
+  /// truncated vertically.
+   void SadVolume(const ComputeBuffer & left,const ComputeBuffer & right,nat32 channels,
+                  nat32 width,nat32 widthRight,nat32 height,
+                  int32 minDisp,nat32 depth,nat32 radius,real32 maxDiff,ComputeBuffer & out);
+
+  /// Applies a separable kernel to a width x height image, matching
+  /// filter::KernelVect::Apply, or ApplyRepeat if repeat is true. h and v are
+  /// the horizontal and vertical vectors, each half*2+1 long. in and out must
+  /// be different buffers.
+   void SepConvolve(const ComputeBuffer & in,ComputeBuffer & out,nat32 width,nat32 height,
+                    nat32 half,const real32 * h,const real32 * v,bit repeat);
+
+  /// Writes into out, width x height, minDisp plus the index of the lowest
+  /// cost slice of the given width x height x depth volume.
+   void WinnerTakeAll(const ComputeBuffer & cost,nat32 width,nat32 height,nat32 depth,
+                      int32 minDisp,ComputeBuffer & out);
+
+  /// Loopy belief propagation on the 4 connected grid, min-sum with a
+  /// truncated linear smoothness cost, mult*min(|a-b|,trunc) in label units,
+  /// as alg::BP2D would do with that cost but without the hierarchy. cost is
+  /// the width x height x labels data cost volume, out gets minDisp plus the
+  /// label of the lowest belief after the given number of iterations, each
+  /// being a full checkerboard sweep. Needs 5 volumes of working memory.
+   void TruncLinearBP(const ComputeBuffer & cost,nat32 width,nat32 height,nat32 labels,
+                      real32 mult,real32 trunc,nat32 iters,int32 minDisp,ComputeBuffer & out);
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::os::Compute";}
+
+
+ private:
+  friend class ComputeBuffer;
+
+   Compute();
+   ~Compute();
+
+  bit active;
+  cstr name;
+  mt::OwnedLock lock;
+
+  cl_context context;
+  cl_command_queue queue;
+  cl_program program;
+
+  static const nat32 kernelCount = 7;
+  cl_kernel kernel[kernelCount];
+  enum {k_sad_hor,k_sad_ver,k_sep_hor,k_sep_ver,k_wta,k_bp_update,k_bp_belief};
+
+  // Releases everything and deactivates, for use on error...
+   void Release();
+
+  // Helpers for running kernels, each returning false on error...
+   template <typename T>
+   bit Arg(nat32 k,nat32 i,const T & value)
+   {return clSetKernelArg(kernel[k],i,sizeof(T),&value)==CL_SUCCESS;}
+
+   bit Launch(nat32 k,nat32 width,nat32 height,nat32 depth = 1);
+
+  // The device versions of the operations, which return false on failure so
+  // the CPU can take over...
+   bit DevSadVolume(const ComputeBuffer & left,const ComputeBuffer & right,nat32 channels,
+                    nat32 width,nat32 widthRight,nat32 height,
+                    int32 minDisp,nat32 depth,nat32 radius,real32 maxDiff,ComputeBuffer & out);
+   bit DevSepConvolve(const ComputeBuffer & in,ComputeBuffer & out,nat32 width,nat32 height,
+                      nat32 half,const real32 * h,const real32 * v,bit repeat);
+   bit DevWinnerTakeAll(const ComputeBuffer & cost,nat32 width,nat32 height,nat32 depth,
+                        int32 minDisp,ComputeBuffer & out);
+   bit DevTruncLinearBP(const ComputeBuffer & cost,nat32 width,nat32 height,nat32 labels,
+                        real32 mult,real32 trunc,nat32 iters,int32 minDisp,ComputeBuffer & out);
+};
+
+//------------------------------------------------------------------------------
+/// A buffer of real32-s for use with Compute. Lives on the device if its
+/// active, in main memory otherwise, or if the device runs out of memory.
+/// Operations run on the device only when all of their buffers are resident
+/// there, so mixing is allowed but slow.
+class EOS_CLASS ComputeBuffer
+{
+ public:
+  /// &nbsp;
+   ComputeBuffer(Compute & dev = Compute::Default());
+
+  /// &nbsp;
+   ComputeBuffer(nat32 size,Compute & dev = Compute::Default());
+
+  /// &nbsp;
+   ~ComputeBuffer();
+
+
+  /// Resizes, in real32-s, the contents are lost.
+   void Resize(nat32 size);
+
+  /// &nbsp;
+   nat32 Size() const {return size;}
+
+  /// Returns true if the buffer is on the device.
+   bit Resident() const {return buf!=null<cl_mem>();}
+
+
+  /// Copies size real32-s in, starting at the given offset.
+   void Write(const real32 * data,nat32 size,nat32 offset = 0);
+
+  /// Copies size real32-s out, starting at the given offset.
+   void Read(real32 * data,nat32 size,nat32 offset = 0) const;
+
+
+  /// Copies a 2D or 3D field in at the given offset, packing it. If too small
+  /// the buffer is resized to fit first, losing its contents.
+   void Upload(const svt::Field<real32> & field,nat32 offset = 0);
+
+  /// Copies into a 2D or 3D field from the given offset, the inverse of
+  /// Upload.
+   void Download(svt::Field<real32> & field,nat32 offset = 0) const;
+
+
+  /// Returns a pointer to the contents in main memory, copying them off the
+  /// device if resident. Must be matched with Unmap, which copies them back
+  /// if changed is true. Used by the CPU versions of the operations.
+   real32 * Map() const;
+
+  /// &nbsp;
+   void Unmap(bit changed) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::os::ComputeBuffer";}
+
+
+ private:
+  friend class Compute;
+
+  Compute & dev;
+  nat32 size;
+  cl_mem buf;
+  mutable real32 * host; // The data if not resident, a copy whilst mapped if it is.
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -39,7 +39,9 @@ namespace eos
 //------------------------------------------------------------------------------
 ConversationProg::ConversationProg(class Conversation & c)
 :con(c)
-{}
+{
+ SetInterval(100);
+}
 
 void ConversationProg::Begin()
 {
@@ -55,7 +57,6 @@ void ConversationProg::Begin()
  // Render an empty percentage/step of step line...
   con << "0% 0ns/?ns |\n";
 
- lastUpdate = eos::time::MilliTime();
  Reset();
 }
 
@@ -76,9 +77,6 @@ void ConversationProg::End(bit clear)
 
 void ConversationProg::OnChange()
 {
- nat64 now = eos::time::MilliTime();
- if (now-100<lastUpdate) return;
- lastUpdate = now;
  con.DeleteLine();
 
  // Discover if we need to re-render the progress bar, if so do it...
@@ -62,7 +62,6 @@ class EOS_CLASS ConversationProg : public time::Progress
   nat32 pos; // How many characters of the bar are filled in, so we only redraw it when necesary.
   nat32 width; // The width that has been decided on for the bar.
 
-  nat64 lastUpdate; // When the console was last updated, so we don't waste time by doing it too often.
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/os/memory.h"
+
+#ifdef EOS_WIN32
+ #include <windows.h>
+ #include <psapi.h>
+#else
+ #include <stdio.h>
+ #include <string.h>
+ #include <stdlib.h>
+#endif
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+#ifdef EOS_WIN32
+
+EOS_FUNC nat64 CurrentMemory()
+{
+ PROCESS_MEMORY_COUNTERS pmc;
+ if (!GetProcessMemoryInfo(GetCurrentProcess(),&pmc,sizeof(pmc))) return 0;
+ return pmc.WorkingSetSize;
+}
+
+EOS_FUNC nat64 PeakMemory()
+{
+ PROCESS_MEMORY_COUNTERS pmc;
+ if (!GetProcessMemoryInfo(GetCurrentProcess(),&pmc,sizeof(pmc))) return 0;
+ return pmc.PeakWorkingSetSize;
+}
+
+EOS_FUNC bit ResetPeakMemory()
+{
+ return false;
+}
+
+#else
+
+// Returns a line of /proc/self/status, in bytes, the values being in kB...
+static nat64 ProcStatus(cstrconst key)
+{
+ FILE * f = fopen("/proc/self/status","r");
+ if (f==null<FILE*>()) return 0;
+
+ nat64 ret = 0;
+ nat32 keyLen = strlen(key);
+ char line[256];
+ while (fgets(line,sizeof(line),f))
+ {
+  if (strncmp(line,key,keyLen)==0)
+  {
+   ret = nat64(strtoull(line+keyLen,null<char**>(),10))*1024;
+   break;
+  }
+ }
+
+ fclose(f);
+ return ret;
+}
+
+EOS_FUNC nat64 CurrentMemory()
+{
+ return ProcStatus("VmRSS:");
+}
+
+EOS_FUNC nat64 PeakMemory()
+{
+ return ProcStatus("VmHWM:");
+}
+
+EOS_FUNC bit ResetPeakMemory()
+{
+ // Writing 5 to clear_refs resets the high water mark...
+  FILE * f = fopen("/proc/self/clear_refs","w");
+  if (f==null<FILE*>()) return false;
+  bit ret = fputs("5",f)>=0;
+  if (fclose(f)!=0) ret = false;
+
+ return ret&&(PeakMemory()<=CurrentMemory()+64*1024);
+}
+
+#endif
+//------------------------------------------------------------------------------
+ };
+};
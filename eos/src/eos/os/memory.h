@@ -0,0 +1,49 @@
+#ifndef EOS_OS_MEMORY_H
+#define EOS_OS_MEMORY_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file memory.h
+/// Asks the OS how much memory the process is using, for measuring what an
+/// algorithm costs in memory as well as time.
+
+#include "eos/types.h"
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+/// Returns how many bytes of physical memory the process is currently using,
+/// its resident set or working set. Returns 0 if the OS won't say.
+EOS_FUNC nat64 CurrentMemory();
+
+/// Returns the largest CurrentMemory() has been, since the process started or
+/// the last successful ResetPeakMemory(). Returns 0 if the OS won't say.
+EOS_FUNC nat64 PeakMemory();
+
+/// Resets PeakMemory() to the current usage, so the peak of a single
+/// operation can be measured. Returns false if the OS can't do this, in
+/// which case PeakMemory() remains the peak for the whole process. Only
+/// avaliable on linux 4.0 onwards.
+EOS_FUNC bit ResetPeakMemory();
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/os/opencl_funcs.h"
+
+#include "eos/file/dlls.h"
+#include "eos/file/csv.h"
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+EOS_VAR_DEF cl_int EOS_STDCALL (*clGetPlatformIDs)(cl_uint num_entries,cl_platform_id * platforms,cl_uint * num_platforms);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clGetDeviceIDs)(cl_platform_id platform,cl_ulong device_type,cl_uint num_entries,cl_device_id * devices,cl_uint * num_devices);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clGetDeviceInfo)(cl_device_id device,cl_uint param_name,size_t param_value_size,void * param_value,size_t * param_value_size_ret);
+
+EOS_VAR_DEF cl_context EOS_STDCALL (*clCreateContext)(const ptrdiff_t * properties,cl_uint num_devices,const cl_device_id * devices,void * pfn_notify,void * user_data,cl_int * errcode_ret);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clReleaseContext)(cl_context context);
+EOS_VAR_DEF cl_command_queue EOS_STDCALL (*clCreateCommandQueue)(cl_context context,cl_device_id device,cl_ulong properties,cl_int * errcode_ret);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clReleaseCommandQueue)(cl_command_queue command_queue);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clFinish)(cl_command_queue command_queue);
+
+EOS_VAR_DEF cl_mem EOS_STDCALL (*clCreateBuffer)(cl_context context,cl_ulong flags,size_t size,void * host_ptr,cl_int * errcode_ret);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clReleaseMemObject)(cl_mem memobj);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clEnqueueReadBuffer)(cl_command_queue command_queue,cl_mem buffer,cl_bool blocking_read,size_t offset,size_t cb,void * ptr,cl_uint num_events_in_wait_list,const cl_event * event_wait_list,cl_event * event);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clEnqueueWriteBuffer)(cl_command_queue command_queue,cl_mem buffer,cl_bool blocking_write,size_t offset,size_t cb,const void * ptr,cl_uint num_events_in_wait_list,const cl_event * event_wait_list,cl_event * event);
+
+EOS_VAR_DEF cl_program EOS_STDCALL (*clCreateProgramWithSource)(cl_context context,cl_uint count,const char ** strings,const size_t * lengths,cl_int * errcode_ret);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clBuildProgram)(cl_program program,cl_uint num_devices,const cl_device_id * device_list,const char * options,void * pfn_notify,void * user_data);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clGetProgramBuildInfo)(cl_program program,cl_device_id device,cl_uint param_name,size_t param_value_size,void * param_value,size_t * param_value_size_ret);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clReleaseProgram)(cl_program program);
+
+EOS_VAR_DEF cl_kernel EOS_STDCALL (*clCreateKernel)(cl_program program,const char * kernel_name,cl_int * errcode_ret);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clReleaseKernel)(cl_kernel kernel);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clSetKernelArg)(cl_kernel kernel,cl_uint arg_index,size_t arg_size,const void * arg_value);
+EOS_VAR_DEF cl_int EOS_STDCALL (*clEnqueueNDRangeKernel)(cl_command_queue command_queue,cl_kernel kernel,cl_uint work_dim,const size_t * global_work_offset,const size_t * global_work_size,const size_t * local_work_size,cl_uint num_events_in_wait_list,const cl_event * event_wait_list,cl_event * event);
+
+
+//------------------------------------------------------------------------------
+bit LoadOpenCL()
+{
+ if (clEnqueueNDRangeKernel) return true; // Allready loaded.
+
+ // The ICD loader is often only installed with its version number, without
+ // the development symlink...
+  file::Dll cl;
+  cl.Load("OpenCL");
+  #ifndef EOS_WIN32
+  if (!cl.Active()) cl.LoadPath("libOpenCL.so.1");
+  #endif
+  if (!cl.Active()) {LogAlways("Could not load OpenCL library"); return false;}
+
+ (void*&)clGetPlatformIDs = cl.Get("clGetPlatformIDs");
+ (void*&)clGetDeviceIDs = cl.Get("clGetDeviceIDs");
+ (void*&)clGetDeviceInfo = cl.Get("clGetDeviceInfo");
+ (void*&)clCreateContext = cl.Get("clCreateContext");
+ (void*&)clReleaseContext = cl.Get("clReleaseContext");
+ (void*&)clCreateCommandQueue = cl.Get("clCreateCommandQueue");
+ (void*&)clReleaseCommandQueue = cl.Get("clReleaseCommandQueue");
+ (void*&)clFinish = cl.Get("clFinish");
+ (void*&)clCreateBuffer = cl.Get("clCreateBuffer");
+ (void*&)clReleaseMemObject = cl.Get("clReleaseMemObject");
+ (void*&)clEnqueueReadBuffer = cl.Get("clEnqueueReadBuffer");
+ (void*&)clEnqueueWriteBuffer = cl.Get("clEnqueueWriteBuffer");
+ (void*&)clCreateProgramWithSource = cl.Get("clCreateProgramWithSource");
+ (void*&)clBuildProgram = cl.Get("clBuildProgram");
+ (void*&)clGetProgramBuildInfo = cl.Get("clGetProgramBuildInfo");
+ (void*&)clReleaseProgram = cl.Get("clReleaseProgram");
+ (void*&)clCreateKernel = cl.Get("clCreateKernel");
+ (void*&)clReleaseKernel = cl.Get("clReleaseKernel");
+ (void*&)clSetKernelArg = cl.Get("clSetKernelArg");
+ (void*&)clEnqueueNDRangeKernel = cl.Get("clEnqueueNDRangeKernel");
+
+ // Check its all there - clEnqueueNDRangeKernel doubles as the loaded flag so
+ // is cleared on failure...
+  if ((clGetPlatformIDs==0)||(clGetDeviceIDs==0)||(clGetDeviceInfo==0)||(clCreateContext==0)||
+      (clReleaseContext==0)||(clCreateCommandQueue==0)||(clReleaseCommandQueue==0)||(clFinish==0)||
+      (clCreateBuffer==0)||(clReleaseMemObject==0)||(clEnqueueReadBuffer==0)||(clEnqueueWriteBuffer==0)||
+      (clCreateProgramWithSource==0)||(clBuildProgram==0)||(clGetProgramBuildInfo==0)||
+      (clReleaseProgram==0)||(clCreateKernel==0)||(clReleaseKernel==0)||(clSetKernelArg==0)||
+      (clEnqueueNDRangeKernel==0))
+  {
+   LogAlways("Could not load all OpenCL functions");
+   (void*&)clEnqueueNDRangeKernel = null<void*>();
+   return false;
+  }
+
+ cl.UnloadKeep();
+ return true;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,110 @@
+#ifndef EOS_OS_OPENCL_FUNCS_H
+#define EOS_OS_OPENCL_FUNCS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file opencl_funcs.h
+/// Provides access to OpenCL, loaded at runtime so its not a dependency.
+
+#include "eos/types.h"
+
+#include <stddef.h>
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+// The types and constants used, from the OpenCL 1.0 specification. Only what
+// the compute module needs...
+typedef int32 cl_int;
+typedef nat32 cl_uint;
+typedef nat64 cl_ulong;
+typedef cl_uint cl_bool;
+
+struct CLPlatform {};
+struct CLDevice {};
+struct CLContext {};
+struct CLQueue {};
+struct CLMem {};
+struct CLProgram {};
+struct CLKernel {};
+struct CLEvent {};
+
+typedef CLPlatform * cl_platform_id;
+typedef CLDevice * cl_device_id;
+typedef CLContext * cl_context;
+typedef CLQueue * cl_command_queue;
+typedef CLMem * cl_mem;
+typedef CLProgram * cl_program;
+typedef CLKernel * cl_kernel;
+typedef CLEvent * cl_event;
+
+static const cl_int CL_SUCCESS = 0;
+static const cl_bool CL_TRUE = 1;
+
+static const cl_ulong CL_DEVICE_TYPE_CPU = 1<<1;
+static const cl_ulong CL_DEVICE_TYPE_GPU = 1<<2;
+static const cl_ulong CL_DEVICE_TYPE_ACCELERATOR = 1<<3;
+static const cl_ulong CL_DEVICE_TYPE_ALL = 0xFFFFFFFF;
+
+static const ptrdiff_t CL_CONTEXT_PLATFORM = 0x1084;
+static const cl_uint CL_DEVICE_NAME = 0x102B;
+static const cl_uint CL_PROGRAM_BUILD_LOG = 0x1183;
+
+static const cl_ulong CL_MEM_READ_WRITE = 1<<0;
+
+
+//------------------------------------------------------------------------------
+// Pointers to all the OpenCL functions needed...
+EOS_VAR cl_int EOS_STDCALL (*clGetPlatformIDs)(cl_uint num_entries,cl_platform_id * platforms,cl_uint * num_platforms);
+EOS_VAR cl_int EOS_STDCALL (*clGetDeviceIDs)(cl_platform_id platform,cl_ulong device_type,cl_uint num_entries,cl_device_id * devices,cl_uint * num_devices);
+EOS_VAR cl_int EOS_STDCALL (*clGetDeviceInfo)(cl_device_id device,cl_uint param_name,size_t param_value_size,void * param_value,size_t * param_value_size_ret);
+
+EOS_VAR cl_context EOS_STDCALL (*clCreateContext)(const ptrdiff_t * properties,cl_uint num_devices,const cl_device_id * devices,void * pfn_notify,void * user_data,cl_int * errcode_ret);
+EOS_VAR cl_int EOS_STDCALL (*clReleaseContext)(cl_context context);
+EOS_VAR cl_command_queue EOS_STDCALL (*clCreateCommandQueue)(cl_context context,cl_device_id device,cl_ulong properties,cl_int * errcode_ret);
+EOS_VAR cl_int EOS_STDCALL (*clReleaseCommandQueue)(cl_command_queue command_queue);
+EOS_VAR cl_int EOS_STDCALL (*clFinish)(cl_command_queue command_queue);
+
+EOS_VAR cl_mem EOS_STDCALL (*clCreateBuffer)(cl_context context,cl_ulong flags,size_t size,void * host_ptr,cl_int * errcode_ret);
+EOS_VAR cl_int EOS_STDCALL (*clReleaseMemObject)(cl_mem memobj);
+EOS_VAR cl_int EOS_STDCALL (*clEnqueueReadBuffer)(cl_command_queue command_queue,cl_mem buffer,cl_bool blocking_read,size_t offset,size_t cb,void * ptr,cl_uint num_events_in_wait_list,const cl_event * event_wait_list,cl_event * event);
+EOS_VAR cl_int EOS_STDCALL (*clEnqueueWriteBuffer)(cl_command_queue command_queue,cl_mem buffer,cl_bool blocking_write,size_t offset,size_t cb,const void * ptr,cl_uint num_events_in_wait_list,const cl_event * event_wait_list,cl_event * event);
+
+EOS_VAR cl_program EOS_STDCALL (*clCreateProgramWithSource)(cl_context context,cl_uint count,const char ** strings,const size_t * lengths,cl_int * errcode_ret);
+EOS_VAR cl_int EOS_STDCALL (*clBuildProgram)(cl_program program,cl_uint num_devices,const cl_device_id * device_list,const char * options,void * pfn_notify,void * user_data);
+EOS_VAR cl_int EOS_STDCALL (*clGetProgramBuildInfo)(cl_program program,cl_device_id device,cl_uint param_name,size_t param_value_size,void * param_value,size_t * param_value_size_ret);
+EOS_VAR cl_int EOS_STDCALL (*clReleaseProgram)(cl_program program);
+
+EOS_VAR cl_kernel EOS_STDCALL (*clCreateKernel)(cl_program program,const char * kernel_name,cl_int * errcode_ret);
+EOS_VAR cl_int EOS_STDCALL (*clReleaseKernel)(cl_kernel kernel);
+EOS_VAR cl_int EOS_STDCALL (*clSetKernelArg)(cl_kernel kernel,cl_uint arg_index,size_t arg_size,const void * arg_value);
+EOS_VAR cl_int EOS_STDCALL (*clEnqueueNDRangeKernel)(cl_command_queue command_queue,cl_kernel kernel,cl_uint work_dim,const size_t * global_work_offset,const size_t * global_work_size,const size_t * local_work_size,cl_uint num_events_in_wait_list,const cl_event * event_wait_list,cl_event * event);
+
+
+//------------------------------------------------------------------------------
+// A function that checks if the OpenCL library has been loaded, and if not
+// trys to load it. Returns true if its all ready to go, false if not...
+bit LoadOpenCL();
+
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -0,0 +1,289 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/os/sockets.h"
+
+#include "eos/math/functions.h"
+#include "eos/str/strings.h"
+
+#ifdef EOS_WIN32
+ #include <winsock2.h>
+ #include <ws2tcpip.h>
+#else
+ #include <sys/types.h>
+ #include <sys/socket.h>
+ #include <netinet/in.h>
+ #include <netinet/tcp.h>
+ #include <netdb.h>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <unistd.h>
+ #include <errno.h>
+#endif
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+// Platform differences...
+#ifdef EOS_WIN32
+ static void SocketStartup()
+ {
+  static bit done = false;
+  if (!done)
+  {
+   WSADATA wsa;
+   WSAStartup(MAKEWORD(2,2),&wsa);
+   done = true;
+  }
+ }
+
+ static inline void SocketClose(int32 h) {closesocket(h);}
+ static inline void SocketNonBlock(int32 h) {u_long on = 1; ioctlsocket(h,FIONBIO,&on);}
+ static inline bit SocketInProgress() {return WSAGetLastError()==WSAEWOULDBLOCK;}
+ static inline bit SocketRetry() {return WSAGetLastError()==WSAEWOULDBLOCK;}
+#else
+ static void SocketStartup() {}
+
+ static inline void SocketClose(int32 h) {close(h);}
+ static inline void SocketNonBlock(int32 h) {fcntl(h,F_SETFL,fcntl(h,F_GETFL,0)|O_NONBLOCK);}
+ static inline bit SocketInProgress() {return errno==EINPROGRESS;}
+ static inline bit SocketRetry() {return (errno==EAGAIN)||(errno==EWOULDBLOCK)||(errno==EINTR);}
+#endif
+
+//------------------------------------------------------------------------------
+Socket::Socket()
+:handle(-1),timeout(60000),sent(0),received(0)
+{
+ SocketStartup();
+}
+
+Socket::~Socket()
+{
+ Close();
+}
+
+bit Socket::Connect(cstrconst host,nat32 port)
+{
+ Close();
+
+ // Look up the host...
+  str::String ps;
+  ps << port;
+  cstr portStr = ps.ToStr();
+
+  struct addrinfo hints;
+  mem::Null(&hints);
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo * addr = null<struct addrinfo*>();
+  int res = getaddrinfo(host,portStr,&hints,&addr);
+  mem::Free(portStr);
+  if ((res!=0)||(addr==null<struct addrinfo*>())) return false;
+
+ // Connect, without blocking so the timeout applies...
+  handle = int32(socket(addr->ai_family,addr->ai_socktype,addr->ai_protocol));
+  if (handle==-1) {freeaddrinfo(addr); return false;}
+  SocketNonBlock(handle);
+
+  if (connect(handle,addr->ai_addr,addr->ai_addrlen)!=0)
+  {
+   if ((!SocketInProgress())||(!Wait(true)))
+   {
+    freeaddrinfo(addr);
+    Close();
+    return false;
+   }
+
+   int err = 0;
+   socklen_t errSize = sizeof(err);
+   getsockopt(handle,SOL_SOCKET,SO_ERROR,(char*)&err,&errSize);
+   if (err!=0)
+   {
+    freeaddrinfo(addr);
+    Close();
+    return false;
+   }
+  }
+  freeaddrinfo(addr);
+
+ // Messages are ushally a small header followed by a big block, so don't let
+ // Nagle hold the header back...
+  int on = 1;
+  setsockopt(handle,IPPROTO_TCP,TCP_NODELAY,(char*)&on,sizeof(on));
+
+ return true;
+}
+
+bit Socket::Listen(nat32 port,cstrconst iface)
+{
+ Close();
+
+ // Look up the interface, unless its all of them...
+  nat32 ip = htonl(INADDR_ANY);
+  if (iface)
+  {
+   struct addrinfo hints;
+   mem::Null(&hints);
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+
+   struct addrinfo * res = null<struct addrinfo*>();
+   if ((getaddrinfo(iface,null<cstr>(),&hints,&res)!=0)||(res==null<struct addrinfo*>())) return false;
+   ip = ((struct sockaddr_in*)res->ai_addr)->sin_addr.s_addr;
+   freeaddrinfo(res);
+  }
+
+ handle = int32(socket(AF_INET,SOCK_STREAM,0));
+ if (handle==-1) return false;
+
+ int on = 1;
+ setsockopt(handle,SOL_SOCKET,SO_REUSEADDR,(char*)&on,sizeof(on));
+
+ struct sockaddr_in addr;
+ mem::Null(&addr);
+ addr.sin_family = AF_INET;
+ addr.sin_addr.s_addr = ip;
+ addr.sin_port = htons(port);
+
+ if ((bind(handle,(struct sockaddr*)&addr,sizeof(addr))!=0)||(listen(handle,16)!=0))
+ {
+  Close();
+  return false;
+ }
+
+ SocketNonBlock(handle);
+ return true;
+}
+
+Socket * Socket::Accept()
+{
+ if (!Active()) return null<Socket*>();
+
+ // Wait for one, without closing on a timeout...
+ {
+  #ifdef EOS_WIN32
+   fd_set set;
+   FD_ZERO(&set);
+   FD_SET(handle,&set);
+   struct timeval tv;
+   tv.tv_sec = timeout/1000;
+   tv.tv_usec = (timeout%1000)*1000;
+   if (select(handle+1,&set,null<fd_set*>(),null<fd_set*>(),&tv)<=0) return null<Socket*>();
+  #else
+   struct pollfd pfd;
+   pfd.fd = handle;
+   pfd.events = POLLIN;
+   pfd.revents = 0;
+   if (poll(&pfd,1,int(timeout))<=0) return null<Socket*>();
+  #endif
+ }
+
+ int32 h = int32(accept(handle,null<struct sockaddr*>(),null<socklen_t*>()));
+ if (h==-1) return null<Socket*>();
+ SocketNonBlock(h);
+
+ int on = 1;
+ setsockopt(h,IPPROTO_TCP,TCP_NODELAY,(char*)&on,sizeof(on));
+
+ Socket * ret = new Socket();
+ ret->handle = h;
+ ret->timeout = timeout;
+ return ret;
+}
+
+void Socket::Close()
+{
+ if (handle!=-1)
+ {
+  SocketClose(handle);
+  handle = -1;
+ }
+}
+
+bit Socket::Send(const void * data,nat64 bytes)
+{
+ const byte * ptr = (const byte*)data;
+ while (bytes!=0)
+ {
+  if (!Active()) return false;
+  int32 done = int32(send(handle,(const char*)ptr,nat32(math::Min<nat64>(bytes,1024*1024)),0));
+  if (done<=0)
+  {
+   if ((done<0)&&SocketRetry()&&Wait(true)) continue;
+   Close();
+   return false;
+  }
+  ptr += done;
+  bytes -= done;
+  sent += done;
+ }
+ return Active();
+}
+
+bit Socket::Recv(void * data,nat64 bytes)
+{
+ byte * ptr = (byte*)data;
+ while (bytes!=0)
+ {
+  if (!Active()) return false;
+  int32 done = int32(recv(handle,(char*)ptr,nat32(math::Min<nat64>(bytes,1024*1024)),0));
+  if (done<=0)
+  {
+   // 0 is the other end closing, which is a failure as we wanted more...
+    if ((done<0)&&SocketRetry()&&Wait(false)) continue;
+    Close();
+    return false;
+  }
+  ptr += done;
+  bytes -= done;
+  received += done;
+ }
+ return Active();
+}
+
+bit Socket::Wait(bit write)
+{
+ #ifdef EOS_WIN32
+  fd_set set;
+  FD_ZERO(&set);
+  FD_SET(handle,&set);
+  struct timeval tv;
+  tv.tv_sec = timeout/1000;
+  tv.tv_usec = (timeout%1000)*1000;
+  int res = write?select(handle+1,null<fd_set*>(),&set,null<fd_set*>(),&tv)
+                 :select(handle+1,&set,null<fd_set*>(),null<fd_set*>(),&tv);
+  return res>0;
+ #else
+  struct pollfd pfd;
+  pfd.fd = handle;
+  pfd.events = write?POLLOUT:POLLIN;
+  pfd.revents = 0;
+  while (true)
+  {
+   int res = poll(&pfd,1,int(timeout));
+   if ((res<0)&&(errno==EINTR)) continue;
+   return (res>0)&&((pfd.revents&(POLLERR|POLLNVAL))==0);
+  }
+ #endif
+}
+
+//------------------------------------------------------------------------------
+ };
+};
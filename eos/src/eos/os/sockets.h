@@ -0,0 +1,105 @@
+#ifndef EOS_OS_SOCKETS_H
+#define EOS_OS_SOCKETS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file sockets.h
+/// Provides a minimal wrapper around tcp sockets, blocking but with timeouts,
+/// so a lost connection can not hang the caller forever.
+
+#include "eos/types.h"
+
+namespace eos
+{
+ namespace os
+ {
+//------------------------------------------------------------------------------
+/// A tcp socket, which is either connected to somewhere or listening for
+/// connections. Everything blocks, but all waits are limited by a timeout, and
+/// any failure, including a timeout, closes the socket, so the ushall pattern is
+/// to do a sequence of operations and then check Active().
+class EOS_CLASS Socket : public Deletable
+{
+ public:
+  /// Creates an inactive socket, with a timeout of a minute.
+   Socket();
+
+  /// Closes the socket if its open.
+  ~Socket();
+
+
+  /// Connects to the given host, a name or dotted address, and port. Returns
+  /// true on success. Any previous connection is closed first.
+   bit Connect(cstrconst host,nat32 port);
+
+  /// Listens for connections on the given port, on the interface with the
+  /// given name or dotted address, loopback only by default. Pass null to
+  /// listen on all interfaces. Returns true on success.
+   bit Listen(nat32 port,cstrconst iface = "127.0.0.1");
+
+  /// Waits for a connection on a listening socket, for no longer than the
+  /// timeout. Returns the connection, which you must delete, or null if nothing
+  /// arrived in time. A timeout does not close a listening socket.
+   Socket * Accept();
+
+
+  /// Returns true if the socket is open.
+   bit Active() const {return handle!=-1;}
+
+  /// Closes the socket.
+   void Close();
+
+  /// Sets the timeout used by all waits, in milliseconds.
+   void SetTimeout(nat32 ms) {timeout = ms;}
+
+
+  /// Sends all of the given data, returning true on success. On failure the
+  /// socket is closed.
+   bit Send(const void * data,nat64 bytes);
+
+  /// Receives exactly the given number of bytes, returning true on success. On
+  /// failure the socket is closed.
+   bit Recv(void * data,nat64 bytes);
+
+
+  /// Returns how many bytes have been sent since construction.
+   nat64 Sent() const {return sent;}
+
+  /// Returns how many bytes have been received since construction.
+   nat64 Received() const {return received;}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::os::Socket";}
+
+
+ private:
+  int32 handle; // -1 if not open.
+  nat32 timeout;
+  nat64 sent;
+  nat64 received;
+
+  // Waits for the socket to be readable, or writable, returns false on
+  // timeout or error...
+   bit Wait(bit write);
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -17,10 +17,37 @@
 
 #include "eos/rend/databases.h"
 
+#include "eos/math/functions.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 namespace eos
 {
  namespace rend
  {
+//------------------------------------------------------------------------------
+// Sorts and then compacts an array of objects so each appears once. Objects
+// can be instanced, shared by many renderables with different transforms, so
+// this is used to only prepare and unprepare each of them once...
+inline void Distinct(ds::Array<Object*> & objs)
+{
+ if (objs.Size()==0) return;
+ objs.SortNorm();
+
+ nat32 out = 1;
+ for (nat32 i=1;i<objs.Size();i++)
+ {
+  if (objs[i]!=objs[out-1])
+  {
+   objs[out] = objs[i];
+   ++out;
+  }
+ }
+ objs.Size(out);
+}
+
 //------------------------------------------------------------------------------
 BruteDB::BruteDB()
 {}
@@ -39,8 +66,9 @@ void BruteDB::Prepare(time::Progress * prog)
 {
  prog->Push();
   nat32 step = 0;
-  nat32 steps = data.Size();
+  nat32 steps = data.Size() + 1;
  
+  ds::Array<Object*> objs(data.Size());
   ds::List<Node>::Cursor targ = data.FrontPtr();
   while (!targ.Bad())
   {
@@ -50,11 +78,15 @@ void BruteDB::Prepare(time::Progress * prog)
    targ->rend->object->Bound(sphere);
    targ->rend->local->ToWorld(sphere,targ->sphere);
    
-   targ->rend->object->Prepare();
+   objs[step] = targ->rend->object;
    
    ++targ;
    ++step;
   }
+
+  prog->Report(step,steps);
+  Distinct(objs);
+  for (nat32 i=0;i<objs.Size();i++) objs[i]->Prepare();
  prog->Pop();
 }
 
@@ -62,18 +94,21 @@ void BruteDB::Unprepare(time::Progress * prog)
 {
  prog->Push();
   nat32 step = 0;
-  nat32 steps = data.Size();
+  nat32 steps = data.Size() + 1;
  
+  ds::Array<Object*> objs(data.Size());
   ds::List<Node>::Cursor targ = data.FrontPtr();
   while (!targ.Bad())
   {
    prog->Report(step,steps);
-   
-   targ->rend->object->Unprepare();
-   
+   objs[step] = targ->rend->object;
    ++targ;
    ++step;
   }
+
+  prog->Report(step,steps);
+  Distinct(objs);
+  for (nat32 i=0;i<objs.Size();i++) objs[i]->Unprepare();
  prog->Pop();
 }
 
@@ -168,6 +203,696 @@ cstrconst BruteDB::TypeString() const
  return "eos::rend::BruteDB";
 }
 
+//------------------------------------------------------------------------------
+// Slab test of a ray against a box, limited to [0,limit]. Outputs the entry
+// distance when it returns true...
+inline bit BoxHit(const real32 * min,const real32 * max,const bs::Ray & ray,const real32 * inv,real32 limit,real32 & entry)
+{
+ real32 low = 0.0;
+ real32 high = limit;
+ for (nat32 d=0;d<3;d++)
+ {
+  real32 t0 = (min[d] - ray.s[d]) * inv[d];
+  real32 t1 = (max[d] - ray.s[d]) * inv[d];
+  if (t0>t1) math::Swap(t0,t1);
+  low = math::Max(low,t0);
+  high = math::Min(high,t1);
+ }
+ entry = low;
+ return low<=high;
+}
+
+// BoxHit for a packet, with the rays as seperate arrays of start and 1 over
+// direction components, padded to a multiple of 4; returns the mask of the rays
+// in active that hit within their limits...
+inline nat32 BoxHitPacket(const real32 * min,const real32 * max,nat32 groups,const real32 (*rs)[32],const real32 (*ri)[32],const real32 * limit,nat32 active)
+{
+ nat32 ret = 0;
+ for (nat32 g=0;g<groups;g++)
+ {
+  if (((active>>(g*4))&0xF)==0) continue;
+  #ifdef __SSE__
+   __m128 low = _mm_setzero_ps();
+   __m128 high = _mm_loadu_ps(limit+g*4);
+   for (nat32 d=0;d<3;d++)
+   {
+    __m128 s = _mm_loadu_ps(rs[d]+g*4);
+    __m128 inv = _mm_loadu_ps(ri[d]+g*4);
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(min[d]),s),inv);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(max[d]),s),inv);
+    low = _mm_max_ps(low,_mm_min_ps(t0,t1));
+    high = _mm_min_ps(high,_mm_max_ps(t0,t1));
+   }
+   ret |= nat32(_mm_movemask_ps(_mm_cmple_ps(low,high)))<<(g*4);
+  #else
+   for (nat32 r=g*4;r<g*4+4;r++)
+   {
+    real32 low = 0.0;
+    real32 high = limit[r];
+    for (nat32 d=0;d<3;d++)
+    {
+     real32 t0 = (min[d] - rs[d][r]) * ri[d][r];
+     real32 t1 = (max[d] - rs[d][r]) * ri[d][r];
+     if (t0>t1) math::Swap(t0,t1);
+     low = math::Max(low,t0);
+     high = math::Min(high,t1);
+    }
+    if (low<=high) ret |= 1<<r;
+   }
+  #endif
+ }
+ return ret & active;
+}
+
+// Half the surface area of a box, which is all the heuristic needs...
+inline real32 HalfArea(const real32 * min,const real32 * max)
+{
+ real32 dx = max[0] - min[0];
+ real32 dy = max[1] - min[1];
+ real32 dz = max[2] - min[2];
+ return dx*dy + dy*dz + dz*dx;
+}
+
+//------------------------------------------------------------------------------
+// Builds the tree for BvhDB, recursively, splitting each node with a binned
+// surface area heuristic over the centres of the item boxes...
+class BvhDBBuilder
+{
+ public:
+  BvhDBBuilder(BvhDB & d):db(d) {}
+
+  void Run()
+  {
+   nat32 n = db.item.Size();
+   if (n==0)
+   {
+    db.node.Size(0);
+    return;
+   }
+
+   centre.Size(n*3);
+   for (nat32 i=0;i<n;i++)
+   {
+    for (nat32 d=0;d<3;d++) centre[i*3+d] = 0.5*(db.item[i].min[d] + db.item[i].max[d]);
+   }
+
+   db.node.Size(2*n-1);
+   used = 1;
+   Split(0,0,n,0);
+   db.node.Size(used);
+  }
+
+
+ private:
+  static const nat32 bins = 12;
+  static const nat32 maxLeaf = 4;
+  static const nat32 maxDepth = 48; // Past this it splits at the median, to bound the depth.
+
+  BvhDB & db;
+  ds::Array<real32> centre;
+  nat32 used;
+
+  struct Bin
+  {
+   real32 min[3];
+   real32 max[3];
+   nat32 count;
+
+   void Reset()
+   {
+    for (nat32 d=0;d<3;d++)
+    {
+     min[d] = math::Infinity<real32>();
+     max[d] = -math::Infinity<real32>();
+    }
+    count = 0;
+   }
+
+   void Add(const real32 * mi,const real32 * ma)
+   {
+    for (nat32 d=0;d<3;d++)
+    {
+     min[d] = math::Min(min[d],mi[d]);
+     max[d] = math::Max(max[d],ma[d]);
+    }
+   }
+  };
+
+  void Swap(nat32 a,nat32 b)
+  {
+   math::Swap(db.item[a],db.item[b]);
+   for (nat32 d=0;d<3;d++) math::Swap(centre[a*3+d],centre[b*3+d]);
+  }
+
+  void Split(nat32 ni,nat32 first,nat32 count,nat32 depth)
+  {
+   // Box of the node, and of the centres...
+    Bin box;
+    Bin cb;
+    box.Reset();
+    cb.Reset();
+    for (nat32 i=first;i<first+count;i++)
+    {
+     box.Add(db.item[i].min,db.item[i].max);
+     cb.Add(&centre[i*3],&centre[i*3]);
+    }
+
+    BvhDB::Node & node = db.node[ni];
+    for (nat32 d=0;d<3;d++)
+    {
+     node.min[d] = box.min[d];
+     node.max[d] = box.max[d];
+    }
+    node.first = first;
+    node.count = count;
+    if (count<=1) return;
+
+   // Choose the axis the centres are most spread along...
+    nat32 axis = 0;
+    for (nat32 d=1;d<3;d++)
+    {
+     if ((cb.max[d]-cb.min[d])>(cb.max[axis]-cb.min[axis])) axis = d;
+    }
+    real32 extent = cb.max[axis] - cb.min[axis];
+
+   // Bin the items and find the cheapest split between bins...
+    nat32 mid = first + count/2;
+    if ((extent>0.0)&&(depth<maxDepth))
+    {
+     Bin bin[bins];
+     for (nat32 b=0;b<bins;b++) bin[b].Reset();
+
+     real32 scale = real32(bins)/extent;
+     for (nat32 i=first;i<first+count;i++)
+     {
+      nat32 b = math::Min(nat32((centre[i*3+axis]-cb.min[axis])*scale),bins-1);
+      bin[b].Add(db.item[i].min,db.item[i].max);
+      bin[b].count += 1;
+     }
+
+     real32 rightArea[bins];
+     nat32 rightCount[bins];
+     Bin acc;
+     acc.Reset();
+     nat32 accCount = 0;
+     for (nat32 b=bins-1;b>0;b--)
+     {
+      acc.Add(bin[b].min,bin[b].max);
+      accCount += bin[b].count;
+      rightArea[b] = (accCount!=0)?HalfArea(acc.min,acc.max):0.0;
+      rightCount[b] = accCount;
+     }
+
+     real32 bestCost = math::Infinity<real32>();
+     nat32 bestSplit = 0;
+     acc.Reset();
+     accCount = 0;
+     for (nat32 b=0;b+1<bins;b++)
+     {
+      acc.Add(bin[b].min,bin[b].max);
+      accCount += bin[b].count;
+      if ((accCount==0)||(rightCount[b+1]==0)) continue;
+
+      real32 cost = HalfArea(acc.min,acc.max)*accCount + rightArea[b+1]*rightCount[b+1];
+      if (cost<bestCost)
+      {
+       bestCost = cost;
+       bestSplit = b;
+      }
+     }
+
+     // Make it a leaf if splitting is no better, taking a box test to cost
+     // half as much as an object test...
+      real32 area = HalfArea(box.min,box.max);
+      if ((count<=maxLeaf)&&(area*count<=0.5*area+bestCost)) return;
+
+     // Partition...
+      if (bestCost<math::Infinity<real32>())
+      {
+       nat32 left = first;
+       nat32 right = first + count;
+       while (left<right)
+       {
+        nat32 b = math::Min(nat32((centre[left*3+axis]-cb.min[axis])*scale),bins-1);
+        if (b<=bestSplit) ++left;
+        else
+        {
+         --right;
+         Swap(left,right);
+        }
+       }
+       if ((left!=first)&&(left!=first+count)) mid = left;
+      }
+    }
+    else
+    {
+     if (count<=maxLeaf) return;
+    }
+
+   // Create the children and recurse...
+    nat32 child = used;
+    used += 2;
+    node.first = child;
+    node.count = 0;
+
+    Split(child,first,mid-first,depth+1);
+    Split(child+1,mid,first+count-mid,depth+1);
+  }
+};
+
+//------------------------------------------------------------------------------
+BvhDB::BvhDB()
+{}
+
+BvhDB::~BvhDB()
+{}
+
+void BvhDB::Add(Renderable * rb)
+{
+ data.AddBack(rb);
+}
+
+void BvhDB::Prepare(time::Progress * prog)
+{
+ prog->Push();
+  nat32 step = 0;
+  nat32 steps = data.Size() + 2;
+
+ // Prepare each object, once however many renderables instance it...
+  prog->Report(step,steps);
+  {
+   ds::Array<Object*> objs(data.Size());
+   ds::List<Renderable*>::Cursor targ = data.FrontPtr();
+   for (nat32 i=0;!targ.Bad();i++)
+   {
+    objs[i] = (*targ)->object;
+    ++targ;
+   }
+   Distinct(objs);
+   for (nat32 i=0;i<objs.Size();i++) objs[i]->Prepare();
+  }
+  ++step;
+
+ // Find the world space box of each renderable...
+  item.Size(data.Size());
+  unbounded.Size(0);
+  nat32 bounded = 0;
+  nat32 unboundedCount = 0;
+  ds::List<Renderable*>::Cursor targ = data.FrontPtr();
+  while (!targ.Bad())
+  {
+   prog->Report(step,steps);
+   Renderable * rend = *targ;
+
+   Item & it = item[bounded];
+   it.rend = rend;
+
+   // From the sphere...
+    bs::Sphere sphere;
+    rend->object->Bound(sphere);
+    bs::Sphere worldSphere;
+    rend->local->ToWorld(sphere,worldSphere);
+    for (nat32 d=0;d<3;d++)
+    {
+     it.min[d] = worldSphere.c[d] - worldSphere.r;
+     it.max[d] = worldSphere.c[d] + worldSphere.r;
+    }
+
+   // From the box, by transforming all 8 corners...
+    bs::Box box;
+    rend->object->Bound(box);
+    real32 bmin[3];
+    real32 bmax[3];
+    for (nat32 d=0;d<3;d++)
+    {
+     bmin[d] = math::Infinity<real32>();
+     bmax[d] = -math::Infinity<real32>();
+    }
+    for (nat32 c=0;c<8;c++)
+    {
+     bs::Vert corner = box.c;
+     for (nat32 e=0;e<3;e++)
+     {
+      if (c&(1<<e)) corner += box.e[e];
+     }
+     bs::Vert wc;
+     rend->local->ToWorld(corner,wc);
+     for (nat32 d=0;d<3;d++)
+     {
+      bmin[d] = math::Min(bmin[d],wc[d]);
+      bmax[d] = math::Max(bmax[d],wc[d]);
+     }
+    }
+
+   // Keep the tighter, and check its finite...
+    bit finite = true;
+    for (nat32 d=0;d<3;d++)
+    {
+     it.min[d] = math::Max(it.min[d],bmin[d]);
+     it.max[d] = math::Min(it.max[d],bmax[d]);
+     if (!math::IsFinite(it.min[d])||!math::IsFinite(it.max[d])) finite = false;
+    }
+
+    if (finite) ++bounded;
+    else
+    {
+     unbounded.Size(unboundedCount+1);
+     unbounded[unboundedCount] = rend;
+     ++unboundedCount;
+    }
+
+   ++targ;
+   ++step;
+  }
+  item.Size(bounded);
+
+
+ // Build the tree...
+  prog->Report(step,steps);
+  BvhDBBuilder builder(*this);
+  builder.Run();
+
+ prog->Pop();
+}
+
+void BvhDB::Unprepare(time::Progress * prog)
+{
+ prog->Push();
+  nat32 step = 0;
+  nat32 steps = data.Size() + 1;
+
+  ds::Array<Object*> objs(data.Size());
+  ds::List<Renderable*>::Cursor targ = data.FrontPtr();
+  while (!targ.Bad())
+  {
+   prog->Report(step,steps);
+   objs[step] = (*targ)->object;
+   ++targ;
+   ++step;
+  }
+
+  prog->Report(step,steps);
+  Distinct(objs);
+  for (nat32 i=0;i<objs.Size();i++) objs[i]->Unprepare();
+
+  item.Size(0);
+  unbounded.Size(0);
+  node.Size(0);
+ prog->Pop();
+}
+
+void BvhDB::Inside(const bs::Vert & point,ds::List<Renderable*> & out) const
+{
+ // Objects without a box...
+  for (nat32 i=0;i<unbounded.Size();i++)
+  {
+   bs::Vert locP;
+   unbounded[i]->local->ToLocal(point,locP);
+   if (unbounded[i]->object->Inside(locP)) out.AddBack(unbounded[i]);
+  }
+
+ // The tree, only going into nodes that contain the point...
+  if (node.Size()==0) return;
+
+  nat32 stack[96];
+  nat32 size = 0;
+  nat32 ni = 0;
+  while (true)
+  {
+   const Node & targ = node[ni];
+   bit in = true;
+   for (nat32 d=0;d<3;d++)
+   {
+    if ((point[d]<targ.min[d])||(point[d]>targ.max[d])) in = false;
+   }
+
+   if (in)
+   {
+    if (targ.count!=0)
+    {
+     for (nat32 i=targ.first;i<targ.first+targ.count;i++)
+     {
+      bs::Vert locP;
+      item[i].rend->local->ToLocal(point,locP);
+      if (item[i].rend->object->Inside(locP)) out.AddBack(item[i].rend);
+     }
+    }
+    else
+    {
+     stack[size] = targ.first + 1; ++size;
+     ni = targ.first;
+     continue;
+    }
+   }
+
+   if (size==0) break;
+   --size;
+   ni = stack[size];
+  }
+}
+
+bit BvhDB::Intercept(const bs::Ray & ray,Renderable *& objOut,Intersection & intOut) const
+{
+ real32 dist;
+ if (!Nearest(ray,math::Infinity<real32>(),objOut,dist)) return false;
+
+ bs::Ray locRay;
+ objOut->local->ToLocal(ray,locRay);
+ log::Assert(objOut->object->Intercept(locRay,intOut));
+ intOut.ToWorld(*objOut->local);
+ return true;
+}
+
+bit BvhDB::Intercept(const bs::FiniteLine & line,Renderable *& objOut,Intersection & intOut) const
+{
+ bs::Ray ray;
+ ray.s = line.s;
+ ray.n = line.e;
+ ray.n -= line.s;
+ real32 lineLength = ray.n.Length();
+ ray.n /= lineLength;
+
+ real32 dist;
+ if (!Nearest(ray,lineLength,objOut,dist)) return false;
+
+ bs::Ray locRay;
+ objOut->local->ToLocal(ray,locRay);
+ log::Assert(objOut->object->Intercept(locRay,intOut));
+ intOut.ToWorld(*objOut->local);
+ return true;
+}
+
+nat32 BvhDB::InterceptPacket(nat32 count,const bs::Ray * ray,Renderable ** objOut,Intersection * intOut) const
+{
+ log::Assert(count<=32);
+ if (count==0) return 0;
+
+ real32 dist[32];
+ for (nat32 r=0;r<count;r++)
+ {
+  dist[r] = math::Infinity<real32>();
+  objOut[r] = null<Renderable*>();
+ }
+ nat32 all = (count==32)?nat32(0xFFFFFFFF):((nat32(1)<<count)-1);
+
+ // Objects without a box...
+  for (nat32 i=0;i<unbounded.Size();i++) TestPacket(unbounded[i],ray,all,objOut,dist);
+
+ // The tree, with a mask of the rays still interested in each node on the
+ // stack. Rays as seperate component arrays for the box tests, the padding
+ // given a negative limit so it never hits...
+  if (node.Size()!=0)
+  {
+   nat32 groups = (count+3)/4;
+   real32 rs[3][32];
+   real32 ri[3][32];
+   real32 limit[32];
+   for (nat32 r=0;r<groups*4;r++)
+   {
+    const bs::Ray & src = ray[(r<count)?r:0];
+    for (nat32 d=0;d<3;d++)
+    {
+     rs[d][r] = src.s[d];
+     ri[d][r] = 1.0/src.n[d]; // Infinities for zeros are fine.
+    }
+    limit[r] = (r<count)?dist[r]:-1.0;
+   }
+
+   nat32 stack[96];
+   nat32 stackMask[96];
+   nat32 size = 1;
+   stack[0] = 0;
+   stackMask[0] = all;
+   while (size!=0)
+   {
+    --size;
+    const Node & targ = node[stack[size]];
+    nat32 mask = BoxHitPacket(targ.min,targ.max,groups,rs,ri,limit,stackMask[size]);
+    if (mask==0) continue;
+
+    if (targ.count!=0)
+    {
+     for (nat32 i=targ.first;i<targ.first+targ.count;i++)
+     {
+      nat32 sub = BoxHitPacket(item[i].min,item[i].max,groups,rs,ri,limit,mask);
+      if (sub==0) continue;
+      TestPacket(item[i].rend,ray,sub,objOut,dist);
+      for (nat32 r=0;r<count;r++) limit[r] = dist[r];
+     }
+    }
+    else
+    {
+     // Push the child further along the first ray first, so the nearer is
+     // visited first and the limits shrink sooner...
+      nat32 lead = 0;
+      while ((mask&(1<<lead))==0) ++lead;
+
+      real32 order = 0.0;
+      for (nat32 d=0;d<3;d++)
+      {
+       real32 c0 = node[targ.first].min[d] + node[targ.first].max[d];
+       real32 c1 = node[targ.first+1].min[d] + node[targ.first+1].max[d];
+       order += (c1-c0) * ray[lead].n[d];
+      }
+
+      nat32 closer = (order<0.0)?(targ.first+1):targ.first;
+      stack[size] = targ.first + targ.first + 1 - closer; stackMask[size] = mask; ++size;
+      stack[size] = closer; stackMask[size] = mask; ++size;
+    }
+   }
+  }
+
+ // Full intersection details for the rays that hit, as for Intercept...
+  nat32 ret = 0;
+  for (nat32 r=0;r<count;r++)
+  {
+   if (objOut[r]==null<Renderable*>()) continue;
+   bs::Ray locRay;
+   objOut[r]->local->ToLocal(ray[r],locRay);
+   log::Assert(objOut[r]->object->Intercept(locRay,intOut[r]));
+   intOut[r].ToWorld(*objOut[r]->local);
+   ret |= 1<<r;
+  }
+
+ return ret;
+}
+
+cstrconst BvhDB::TypeString() const
+{
+ return "eos::rend::BvhDB";
+}
+
+bit BvhDB::Nearest(const bs::Ray & ray,real32 maxDist,Renderable *& objOut,real32 & dist) const
+{
+ bit ret = false;
+ dist = maxDist;
+
+ // Objects without a box...
+  for (nat32 i=0;i<unbounded.Size();i++)
+  {
+   if (Test(unbounded[i],ray,objOut,dist)) ret = true;
+  }
+
+ // The tree, front to back, skipping nodes further than the best so far...
+  if (node.Size()==0) return ret;
+
+  real32 inv[3];
+  for (nat32 d=0;d<3;d++) inv[d] = 1.0/ray.n[d]; // Infinities for zeros are fine.
+
+  real32 entry;
+  if (!BoxHit(node[0].min,node[0].max,ray,inv,dist,entry)) return ret;
+
+  nat32 stack[96];
+  real32 stackEntry[96];
+  nat32 size = 0;
+  nat32 ni = 0;
+  while (true)
+  {
+   const Node & targ = node[ni];
+   if (targ.count!=0)
+   {
+    for (nat32 i=targ.first;i<targ.first+targ.count;i++)
+    {
+     if (BoxHit(item[i].min,item[i].max,ray,inv,dist,entry))
+     {
+      if (Test(item[i].rend,ray,objOut,dist)) ret = true;
+     }
+    }
+   }
+   else
+   {
+    real32 e0,e1;
+    bit h0 = BoxHit(node[targ.first].min,node[targ.first].max,ray,inv,dist,e0);
+    bit h1 = BoxHit(node[targ.first+1].min,node[targ.first+1].max,ray,inv,dist,e1);
+    if (h0&&h1)
+    {
+     if (e1<e0)
+     {
+      stack[size] = targ.first; stackEntry[size] = e0; ++size;
+      ni = targ.first+1;
+     }
+     else
+     {
+      stack[size] = targ.first+1; stackEntry[size] = e1; ++size;
+      ni = targ.first;
+     }
+     continue;
+    }
+    if (h0) {ni = targ.first; continue;}
+    if (h1) {ni = targ.first+1; continue;}
+   }
+
+   // Pop the next node that could still have something closer...
+    while ((size!=0)&&(stackEntry[size-1]>dist)) --size;
+    if (size==0) break;
+    --size;
+    ni = stack[size];
+  }
+
+ return ret;
+}
+
+bit BvhDB::Test(Renderable * rend,const bs::Ray & ray,Renderable *& objOut,real32 & dist)
+{
+ bs::Ray locRay;
+ rend->local->ToLocal(ray,locRay);
+
+ real32 d;
+ if (!rend->object->Intercept(locRay,d)) return false;
+ rend->local->ToWorld(d,d);
+ if (d>=dist) return false;
+
+ objOut = rend;
+ dist = d;
+ return true;
+}
+
+void BvhDB::TestPacket(Renderable * rend,const bs::Ray * ray,nat32 mask,Renderable ** objOut,real32 * dist)
+{
+ bs::Ray locRay[32];
+ nat32 index[32];
+ nat32 count = 0;
+ for (nat32 r=0;r<32;r++)
+ {
+  if ((mask&(1<<r))==0) continue;
+  rend->local->ToLocal(ray[r],locRay[count]);
+  index[count] = r;
+  ++count;
+ }
+
+ real32 d[32];
+ nat32 hit = rend->object->InterceptPacket(count,locRay,d);
+ for (nat32 i=0;i<count;i++)
+ {
+  if ((hit&(1<<i))==0) continue;
+  rend->local->ToWorld(d[i],d[i]);
+  if (d[i]>=dist[index[i]]) continue;
+
+  objOut[index[i]] = rend;
+  dist[index[i]] = d[i];
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
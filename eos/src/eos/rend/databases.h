@@ -76,6 +76,100 @@ class EOS_CLASS BruteDB : public RenderableDB
   ds::List<Node> data;
 };
 
+//------------------------------------------------------------------------------
+/// An object database for big scenes, it builds a bounding volume hierarchy
+/// over the objects in Prepare(), using the surface area heuristic over the
+/// world space axis aligned boxes of the objects. Rays then only go near the
+/// objects whose boxes they pass through, so thousands of objects are fine.
+/// The box of each object is the smaller of what its Bound(bs::Box&) and
+/// Bound(bs::Sphere&) give. Objects with a box that is not finite, e.g. an
+/// infinite plane, are kept aside and tested against every ray, as BruteDB
+/// would. Objects must not move between Prepare() and Unprepare().
+class EOS_CLASS BvhDB : public RenderableDB
+{
+ public:
+  /// &nbsp;
+   BvhDB();
+
+  /// &nbsp;
+   ~BvhDB();
+
+
+  /// &nbsp;
+   void Add(Renderable * rb);
+
+
+  /// Builds the hierarchy, after calling Prepare on every object.
+   void Prepare(time::Progress * prog = null<time::Progress*>());
+
+  /// &nbsp;
+   void Unprepare(time::Progress * prog = null<time::Progress*>());
+
+
+  /// &nbsp;
+   void Inside(const bs::Vert & point,ds::List<Renderable*> & out) const;
+
+  /// &nbsp;
+   bit Intercept(const bs::Ray & ray,Renderable *& objOut,Intersection & intOut) const;
+
+  /// &nbsp;
+   bit Intercept(const bs::FiniteLine & line,Renderable *& objOut,Intersection & intOut) const;
+
+  /// Traverses the tree once for the whole packet, testing the boxes of 4 rays
+  /// at a time with SIMD when avaliable and handing the rays that reach each
+  /// object to its Object::InterceptPacket together.
+   nat32 InterceptPacket(nat32 count,const bs::Ray * ray,Renderable ** objOut,Intersection * intOut) const;
+
+
+  /// Returns how many nodes the hierarchy has, for the curious.
+   nat32 NodeCount() const {return node.Size();}
+
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  friend class BvhDBBuilder;
+
+  ds::List<Renderable*> data;
+
+  // Each object with its world space box, in tree order after Prepare...
+   struct Item
+   {
+    Renderable * rend;
+    real32 min[3];
+    real32 max[3];
+   };
+   ds::Array<Item> item;
+
+  // The objects with no finite box...
+   ds::Array<Renderable*> unbounded;
+
+  // A node is a box, and either a leaf with count items from first, or has
+  // its two children at first and first+1 when count is 0. Node 0 is the
+  // root...
+   struct Node
+   {
+    real32 min[3];
+    real32 max[3];
+    nat32 first;
+    nat32 count;
+   };
+   ds::Array<Node> node;
+
+  // Finds the nearest object along the ray closer than maxDist, returning
+  // true and setting objOut and dist if there is one...
+   bit Nearest(const bs::Ray & ray,real32 maxDist,Renderable *& objOut,real32 & dist) const;
+
+  // Tests one object, updating objOut and dist if its closer...
+   static bit Test(Renderable * rend,const bs::Ray & ray,Renderable *& objOut,real32 & dist);
+
+  // Tests one object against the packet rays in mask, updating objOut and
+  // dist for those its closer for...
+   static void TestPacket(Renderable * rend,const bs::Ray * ray,nat32 mask,Renderable ** objOut,real32 * dist);
+};
+
 //------------------------------------------------------------------------------
  };
 };
@@ -17,11 +17,19 @@
 
 #include "eos/rend/objects.h"
 
+#ifdef __SSE__
+ #include <xmmintrin.h>
+#endif
+
 namespace eos
 {
  namespace rend
  {
 //------------------------------------------------------------------------------
+// Rays can not hit the sphere closer than this to their start, so rays leaving
+// its surface do not hit it again...
+static const real32 startEpsilon = 1e-4;
+
 void Sphere::Bound(bs::Sphere & out) const
 {
  out.c = bs::Vert(0.0,0.0,0.0);
@@ -31,9 +39,9 @@ void Sphere::Bound(bs::Sphere & out) const
 void Sphere::Bound(bs::Box & out) const
 {
  out.c = bs::Vert(-1.0,-1.0,-1.0);
- out.e[0][0] = 2.0; out.e[0][0] = 0.0; out.e[0][0] = 0.0;
- out.e[0][0] = 0.0; out.e[0][0] = 2.0; out.e[0][0] = 0.0;
- out.e[0][0] = 0.0; out.e[0][0] = 0.0; out.e[0][0] = 2.0;
+ out.e[0][0] = 2.0; out.e[0][1] = 0.0; out.e[0][2] = 0.0;
+ out.e[1][0] = 0.0; out.e[1][1] = 2.0; out.e[1][2] = 0.0;
+ out.e[2][0] = 0.0; out.e[2][1] = 0.0; out.e[2][2] = 2.0;
 }
 
 bit Sphere::Inside(const bs::Vert & point) const
@@ -43,21 +51,27 @@ bit Sphere::Inside(const bs::Vert & point) const
 
 bit Sphere::Intercept(const bs::Ray & ray,real32 & dist) const
 {
- bs::Sphere self;
-  self.c = bs::Vert(0.0,0.0,0.0);
-  self.r = 1.0;
-  
- return self.Intercept(ray,&dist);
+ // Solve |s + t n|^2 = 1, taking the nearer root not at the start...
+  real32 b = ray.s[0]*ray.n[0] + ray.s[1]*ray.n[1] + ray.s[2]*ray.n[2];
+  real32 c = ray.s[0]*ray.s[0] + ray.s[1]*ray.s[1] + ray.s[2]*ray.s[2] - 1.0;
+  real32 disc = b*b - c;
+  if (disc<0.0) return false;
+
+  real32 root = math::Sqrt(disc);
+  real32 closer = -b - root;
+  real32 further = -b + root;
+  dist = (closer>startEpsilon)?closer:further;
+  return dist>startEpsilon;
 }
 
 bit Sphere::Intercept(const bs::Ray & ray,Intersection & out) const
 {
- bs::Sphere self;
-  self.c = bs::Vert(0.0,0.0,0.0);
-  self.r = 1.0;
-
- if (self.Intercept(ray,out.depth,out.point))
+ if (Intercept(ray,out.depth))
  {
+  out.point = ray.n;
+  out.point *= out.depth;
+  out.point += ray.s;
+
   real32 theta = math::InvTan2(out.point[1],out.point[0]);
   real32 rho = math::InvCos(out.point[2]);
   
@@ -79,10 +93,6 @@ bit Sphere::Intercept(const bs::Ray & ray,Intersection & out) const
 
 bit Sphere::Intercept(const bs::FiniteLine & line) const
 {
- bs::Sphere self;
-  self.c = bs::Vert(0.0,0.0,0.0);
-  self.r = 1.0;
-   
  real32 dist;
  bs::Ray ray;
   ray.s = line.s;
@@ -92,7 +102,254 @@ bit Sphere::Intercept(const bs::FiniteLine & line) const
  real32 length = ray.n.Length();
  ray.n /= length;
  
- return (self.Intercept(ray,&dist))&&(dist<length);
+ return Intercept(ray,dist)&&(dist<length);
+}
+
+nat32 Sphere::InterceptPacket(nat32 count,const bs::Ray * ray,real32 * dist) const
+{
+ #ifdef __SSE__
+  // 4 rays at a time, as for the single ray version...
+   nat32 ret = 0;
+   for (nat32 g=0;g<count;g+=4)
+   {
+    nat32 n = math::Min(count-g,nat32(4));
+    real32 comp[6][4];
+    for (nat32 r=0;r<4;r++)
+    {
+     const bs::Ray & src = ray[g + ((r<n)?r:0)];
+     for (nat32 d=0;d<3;d++)
+     {
+      comp[d][r] = src.s[d];
+      comp[3+d][r] = src.n[d];
+     }
+    }
+
+    __m128 sx = _mm_loadu_ps(comp[0]), sy = _mm_loadu_ps(comp[1]), sz = _mm_loadu_ps(comp[2]);
+    __m128 nx = _mm_loadu_ps(comp[3]), ny = _mm_loadu_ps(comp[4]), nz = _mm_loadu_ps(comp[5]);
+
+    __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx,nx),_mm_mul_ps(sy,ny)),_mm_mul_ps(sz,nz));
+    __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx,sx),_mm_mul_ps(sy,sy)),_mm_mul_ps(sz,sz)),_mm_set1_ps(1.0));
+    __m128 disc = _mm_sub_ps(_mm_mul_ps(b,b),c);
+    __m128 ok = _mm_cmpge_ps(disc,_mm_setzero_ps());
+
+    __m128 root = _mm_sqrt_ps(_mm_max_ps(disc,_mm_setzero_ps()));
+    __m128 nb = _mm_sub_ps(_mm_setzero_ps(),b);
+    __m128 closer = _mm_sub_ps(nb,root);
+    __m128 further = _mm_add_ps(nb,root);
+    __m128 eps = _mm_set1_ps(startEpsilon);
+    __m128 useNear = _mm_cmpgt_ps(closer,eps);
+    __m128 d = _mm_or_ps(_mm_and_ps(useNear,closer),_mm_andnot_ps(useNear,further));
+    ok = _mm_and_ps(ok,_mm_cmpgt_ps(d,eps));
+
+    real32 out[4];
+    _mm_storeu_ps(out,d);
+    nat32 hit = _mm_movemask_ps(ok) & ((1<<n)-1);
+    for (nat32 r=0;r<n;r++) dist[g+r] = out[r];
+    ret |= hit<<g;
+   }
+   return ret;
+ #else
+  return Object::InterceptPacket(count,ray,dist);
+ #endif
+}
+
+//------------------------------------------------------------------------------
+TriMesh::TriMesh(const sur::IndexedMesh & m)
+:velocity(0.0,0.0,0.0),mesh(m),low(0.0,0.0,0.0),high(0.0,0.0,0.0)
+{
+ for (nat32 i=0;i<mesh.VertexCount();i++)
+ {
+  bs::Vert p = mesh.Pos(i);
+  for (nat32 d=0;d<3;d++)
+  {
+   if ((i==0)||(p[d]<low[d])) low[d] = p[d];
+   if ((i==0)||(p[d]>high[d])) high[d] = p[d];
+  }
+ }
+
+ bs::Vert diag = high;
+ diag -= low;
+ epsilon = math::Max(real32(1e-5*diag.Length()),real32(1e-6));
+}
+
+void TriMesh::Prepare()
+{
+ bvh.Build(mesh);
+}
+
+void TriMesh::Bound(bs::Sphere & out) const
+{
+ out.c = low;
+ out.c += high;
+ out.c *= 0.5;
+
+ bs::Vert diag = high;
+ diag -= low;
+ out.r = 0.5*diag.Length();
+}
+
+void TriMesh::Bound(bs::Box & out) const
+{
+ out.c = low;
+ for (nat32 e=0;e<3;e++)
+ {
+  for (nat32 d=0;d<3;d++) out.e[e][d] = (e==d)?(high[d]-low[d]):0.0;
+ }
+}
+
+bit TriMesh::Inside(const bs::Vert & point) const
+{
+ // Count crossings along an arbitary direction - odd means inside...
+  bs::Ray ray;
+  ray.s = point;
+  ray.n = bs::Vert(0.5773,0.5774,0.5775);
+  ray.n.Normalise();
+
+  nat32 crossings = 0;
+  while (crossings<1024)
+  {
+   sur::Bvh::Hit hit;
+   if (!bvh.Nearest(ray,hit)) break;
+   ++crossings;
+
+   bs::Vert step = ray.n;
+   step *= hit.dist + epsilon;
+   ray.s += step;
+  }
+
+ return (crossings&1)==1;
+}
+
+bit TriMesh::Intercept(const bs::Ray & ray,real32 & dist) const
+{
+ bs::Ray moved = ray;
+ bs::Vert step = ray.n;
+ step *= epsilon;
+ moved.s += step;
+
+ sur::Bvh::Hit hit;
+ if (!bvh.Nearest(moved,hit)) return false;
+ dist = hit.dist + epsilon;
+ return true;
+}
+
+bit TriMesh::Intercept(const bs::Ray & ray,Intersection & out) const
+{
+ bs::Ray moved = ray;
+ bs::Vert step = ray.n;
+ step *= epsilon;
+ moved.s += step;
+
+ sur::Bvh::Hit hit;
+ if (!bvh.Nearest(moved,hit)) return false;
+
+ out.depth = hit.dist + epsilon;
+ out.point = ray.n;
+ out.point *= out.depth;
+ out.point += ray.s;
+
+ nat32 corner[3];
+ for (nat32 c=0;c<3;c++) corner[c] = mesh.Corner(hit.tri,c);
+
+ // Normal...
+  if (mesh.HasNormals())
+  {
+   out.norm = bs::Normal(0.0,0.0,0.0);
+   for (nat32 c=0;c<3;c++)
+   {
+    bs::Normal n = mesh.Norm(corner[c]);
+    n *= hit.w[c];
+    out.norm += n;
+   }
+  }
+  else
+  {
+   bs::Vert a,b,c;
+   mesh.GetTri(hit.tri,a,b,c);
+   b -= a;
+   c -= a;
+   math::CrossProduct(b,c,out.norm);
+  }
+  out.norm.Normalise();
+
+ // Axes, for bump mapping...
+  out.axis[1] = bs::Normal(0.0,1.0,0.0);
+  if (math::Abs(out.norm[1])>0.99) out.axis[1] = bs::Normal(1.0,0.0,0.0);
+  math::CrossProduct(out.axis[1],out.norm,out.axis[0]);
+  out.axis[0].Normalise();
+  math::CrossProduct(out.norm,out.axis[0],out.axis[1]);
+
+ // Texture coordinate...
+  if (mesh.HasUV())
+  {
+   out.coord[0] = 0.0;
+   out.coord[1] = 0.0;
+   for (nat32 c=0;c<3;c++)
+   {
+    bs::Tex2D uv = mesh.UV(corner[c]);
+    out.coord[0] += hit.w[c]*uv[0];
+    out.coord[1] += hit.w[c]*uv[1];
+   }
+  }
+  else
+  {
+   out.coord[0] = hit.w[1];
+   out.coord[1] = hit.w[2];
+  }
+  out.coord[2] = 0.0;
+  out.coord.material = 0;
+
+ out.velocity = velocity;
+ return true;
+}
+
+bit TriMesh::Intercept(const bs::FiniteLine & line) const
+{
+ bs::Ray ray;
+ ray.s = line.s;
+ ray.n = line.e;
+ ray.n -= line.s;
+ real32 length = ray.n.Length();
+ ray.n /= length;
+ if (length<=epsilon) return false;
+
+ bs::Vert step = ray.n;
+ step *= epsilon;
+ ray.s += step;
+
+ return bvh.Any(ray,length-epsilon);
+}
+
+nat32 TriMesh::InterceptPacket(nat32 count,const bs::Ray * ray,real32 * dist) const
+{
+ log::Assert(count<=32);
+ bs::Ray moved[32];
+ for (nat32 i=0;i<count;i++)
+ {
+  moved[i] = ray[i];
+  bs::Vert step = ray[i].n;
+  step *= epsilon;
+  moved[i].s += step;
+ }
+ for (nat32 i=count;i<32;i++)
+ {
+  moved[i].s = bs::Vert(0.0,0.0,0.0);
+  moved[i].n = bs::Vert(0.0,0.0,0.0);
+ }
+
+ sur::Bvh::Hit hit[32];
+ bvh.Nearest(count,moved,hit);
+
+ nat32 ret = 0;
+ for (nat32 i=0;i<count;i++)
+ {
+  if (hit[i].tri!=nat32(-1))
+  {
+   dist[i] = hit[i].dist + epsilon;
+   ret |= 1<<i;
+  }
+ }
+ return ret;
 }
 
 //------------------------------------------------------------------------------
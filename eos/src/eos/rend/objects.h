@@ -23,6 +23,8 @@
 
 #include "eos/types.h"
 #include "eos/rend/renderer.h"
+#include "eos/sur/indexed_mesh.h"
+#include "eos/sur/bvh.h"
 
 namespace eos
 {
@@ -61,6 +63,9 @@ class EOS_CLASS Sphere : public Object
   /// &nbsp;
    bit Intercept(const bs::FiniteLine & line) const;
 
+  /// Does 4 rays at a time with SSE, when avaliable.
+   nat32 InterceptPacket(nat32 count,const bs::Ray * ray,real32 * dist) const;
+
 
   /// &nbsp;
    nat32 Materials() const {return 1;}
@@ -76,6 +81,73 @@ class EOS_CLASS Sphere : public Object
   bs::Vert velocity;
 };
 
+//------------------------------------------------------------------------------
+/// A triangle mesh, given as a sur::IndexedMesh which it references, so it must
+/// stay around and unchanged for as long as this does. Prepare() builds a
+/// sur::Bvh for it, which is what the intersections use, and packets of rays
+/// go through the Bvh together. The normal is interpolated from the vertex
+/// normals if the mesh has them, otherwise it is that of the triangle; the
+/// texture coordinate likewise comes from the mesh if it has them, otherwise
+/// it is the position on the triangle. Inside() counts crossings along a ray,
+/// so is only meaningful for closed meshes.
+class EOS_CLASS TriMesh : public Object
+{
+ public:
+  /// &nbsp;
+   TriMesh(const sur::IndexedMesh & mesh);
+
+  /// &nbsp;
+   ~TriMesh() {}
+
+
+  /// Builds the Bvh.
+   void Prepare();
+
+
+  /// &nbsp;
+   void Bound(bs::Sphere & out) const;
+
+  /// &nbsp;
+   void Bound(bs::Box & out) const;
+
+
+  /// &nbsp;
+   bit Inside(const bs::Vert & point) const;
+
+  /// &nbsp;
+   bit Intercept(const bs::Ray & ray,real32 & dist) const;
+
+  /// &nbsp;
+   bit Intercept(const bs::Ray & ray,Intersection & out) const;
+
+  /// &nbsp;
+   bit Intercept(const bs::FiniteLine & line) const;
+
+  /// Traces the rays through the Bvh in packets of 8.
+   nat32 InterceptPacket(nat32 count,const bs::Ray * ray,real32 * dist) const;
+
+
+  /// &nbsp;
+   nat32 Materials() const {return 1;}
+
+
+  /// &nbsp;
+   cstrconst TypeString() const {return "eos::rend::TriMesh";}
+
+
+ /// Passed through to the intersections, as for Sphere. Defaults to none.
+  bs::Vert velocity;
+
+
+ private:
+  const sur::IndexedMesh & mesh;
+  sur::Bvh bvh;
+
+  bs::Vert low; // Corners of the bounding box.
+  bs::Vert high;
+  real32 epsilon; // Rays start this far along, so they do not hit the surface they leave.
+};
+
 //------------------------------------------------------------------------------
  };
 };
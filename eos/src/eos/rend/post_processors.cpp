@@ -35,9 +35,9 @@ void PostNoise::Apply(RayImage & ri,time::Progress * prog) const
  prog->Push();
   if (perRay)
   {
-   for (nat32 y=0;y<ri.Height();y++)
+   for (nat32 y=ri.BandStart();y<ri.BandEnd();y++)
    {
-    prog->Report(y,ri.Height());
+    prog->Report(y-ri.BandStart(),ri.BandEnd()-ri.BandStart());
     for (nat32 x=0;x<ri.Width();x++)
     {
      for (nat32 i=0;i<ri.Rays(x,y);i++)
@@ -52,9 +52,9 @@ void PostNoise::Apply(RayImage & ri,time::Progress * prog) const
   }
   else
   {
-   for (nat32 y=0;y<ri.Height();y++)
+   for (nat32 y=ri.BandStart();y<ri.BandEnd();y++)
    {
-    prog->Report(y,ri.Height());
+    prog->Report(y-ri.BandStart(),ri.BandEnd()-ri.BandStart());
     for (nat32 x=0;x<ri.Width();x++)
     {
      bs::ColourRGB average = bs::ColourRGB(0.0,0.0,0.0);
@@ -64,7 +64,7 @@ void PostNoise::Apply(RayImage & ri,time::Progress * prog) const
        temp *= ri.Ray(x,y,i).weight;
        average += temp;
       }
-     average /= ri.RaysWeightSum(x,y,i);
+     if (ri.RaysWeightSum(x,y)>0.0) average /= ri.RaysWeightSum(x,y);
      
      bs::ColourRGB noise;
       noise.r = bias + rand.Gaussian(sd1) + rand.Gaussian(average.r*sdm2);
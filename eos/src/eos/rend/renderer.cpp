@@ -55,13 +55,14 @@ void Intersection::ToWorld(const OpTran & tran)
 }
 
 //------------------------------------------------------------------------------
-RayImage::RayImage(nat32 w,nat32 h,nat32 expR,nat32 blockR)
-:width(w),height(h),expRays(expR),blockRays(blockR),
+RayImage::RayImage(nat32 w,nat32 h,nat32 expR,nat32 blockR,nat32 bandH)
+:width(w),height(h),expRays(expR),blockRays(blockR),bandStart(0),
+bandHeight(((bandH==0)||(bandH>h))?h:bandH),
 sizeOfThing(sizeof(Head) + sizeof(Node) + sizeof(TaggedRay)*expRays)
 {
- data = mem::Malloc<byte>(sizeOfThing*width*height);
+ data = mem::Malloc<byte>(sizeOfThing*width*bandHeight);
 
- for (nat32 y=0;y<height;y++)
+ for (nat32 y=0;y<bandHeight;y++)
  {
   for (nat32 x=0;x<width;x++)
   {
@@ -77,11 +78,27 @@ sizeOfThing(sizeof(Head) + sizeof(Node) + sizeof(TaggedRay)*expRays)
 
 RayImage::~RayImage()
 {
- for (nat32 y=0;y<height;y++)
+ Clear();
+ mem::Free(data); 
+}
+
+void RayImage::MoveBand(nat32 start)
+{
+ Clear();
+ bandStart = start;
+}
+
+void RayImage::Clear()
+{
+ for (nat32 y=bandStart;y<bandStart+bandHeight;y++)
  {
   for (nat32 x=0;x<width;x++)
   {
-   Node * targ = Entry(x,y)->Start();
+   Head * head = Entry(x,y);
+   head->rays = 0;
+   head->weightSum = 0.0;
+
+   Node * targ = head->Start();
    while (targ->next)
    {
     Node * victim = targ->next;
@@ -90,8 +107,6 @@ RayImage::~RayImage()
    }
   }
  }
- 
- mem::Free(data); 
 }
 
 nat32 RayImage::Width() const
@@ -203,7 +218,7 @@ Job::Job()
 :db(null<RenderableDB*>()),renderer(null<Renderer*>()),
 bg(null<Background*>()),viewer(null<Viewer*>()),
 sampler(null<Sampler*>()),tm(null<ToneMapper*>()),
-ri(null<RayImage*>())
+ri(null<RayImage*>()),bandHeight(0)
 {}
 
 Job::~Job()
@@ -269,6 +284,16 @@ void Job::Register(Texture * tex)
  textures.AddBack(tex);
 }
 
+void Job::PrepareTextures()
+{
+ ds::List<Texture*,mem::KillDel<Texture> >::Cursor targ = textures.FrontPtr();
+ while (!targ.Bad())
+ {
+  (*targ)->Prepare();
+  ++targ;
+ }
+}
+
 void Job::Render(time::Progress * prog)
 {
  prog->Push();
@@ -278,6 +303,7 @@ void Job::Render(time::Progress * prog)
   // Prepare...
    prog->Report(step,steps);
    db->Prepare(prog);
+   PrepareTextures();
    ++step;   
   
   // Create the ray image...
@@ -310,6 +336,13 @@ void Job::Render(time::Progress * prog)
 
 void Job::Render(svt::Field<bs::ColourRGB> & out,time::Progress * prog)
 {
+ nat32 height = viewer->Height();
+ if ((bandHeight!=0)&&(bandHeight<height)&&sampler->Banded()&&tm->Banded())
+ {
+  RenderBands(out,prog);
+  return;
+ }
+
  prog->Push();
   nat32 step = 0;
   nat32 steps = posts.Size()+5;
@@ -317,6 +350,7 @@ void Job::Render(svt::Field<bs::ColourRGB> & out,time::Progress * prog)
   // Prepare...
    prog->Report(step,steps);
    db->Prepare(prog);
+   PrepareTextures();
    ++step;  
   
   // Create the ray image...
@@ -352,6 +386,60 @@ void Job::Render(svt::Field<bs::ColourRGB> & out,time::Progress * prog)
  prog->Pop();
 }
 
+void Job::RenderBands(svt::Field<bs::ColourRGB> & out,time::Progress * prog)
+{
+ prog->Push();
+  nat32 height = viewer->Height();
+  nat32 bands = (height+bandHeight-1)/bandHeight;
+  nat32 step = 0;
+  nat32 steps = bands+3;
+
+  // Prepare...
+   prog->Report(step,steps);
+   db->Prepare(prog);
+   PrepareTextures();
+   ++step;
+
+  // Create the ray image, which only holds a band...
+   prog->Report(step,steps);
+   delete ri;
+   ri = new RayImage(viewer->Width(),height,sampler->Samples(),4,bandHeight);
+   tm->Begin(out);
+   ++step;
+
+  // Render each band, post-processing and tone mapping it before the next...
+   for (nat32 y=0;y<height;y+=bandHeight)
+   {
+    prog->Report(step,steps);
+    prog->Push();
+     nat32 y1 = math::Min(y+bandHeight,height);
+     ri->MoveBand(y);
+
+     prog->Report(0,posts.Size()+1);
+     sampler->RenderRows(*this,y,y1,prog);
+
+     ds::List<PostProcessor*,mem::KillDel<PostProcessor> >::Cursor targ = posts.FrontPtr();
+     for (nat32 i=1;!targ.Bad();i++)
+     {
+      prog->Report(i,posts.Size()+1);
+      (*targ)->Apply(*ri,prog);
+      ++targ;
+     }
+
+     tm->ApplyRows(*ri,y,y1,out);
+    prog->Pop();
+    ++step;
+    if (prog->Cancelled()) break;
+   }
+
+  // Finish the tone mapping and un-prepare...
+   prog->Report(step,steps);
+   tm->End(out,prog);
+   db->Unprepare(prog);
+
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -24,6 +24,13 @@
 /// feature required to ensure a render is never completed in any human lifetime.
 /// Actual implimentations of the various parts can be found elsewhere, but this
 /// serves to make sure all the parts will play ball.
+///
+/// Renders are done by many threads at once, so between Prepare() and
+/// Unprepare() every const method of the scene description - objects,
+/// databases, lights, materials, textures, intersection modifiers, backgrounds,
+/// viewers and renderers - must be safe to call from several threads at the
+/// same time. In practise that means they must not write to any shared state
+/// in their const methods; any caches must be built in Prepare().
 
 #include "eos/types.h"
 #include "eos/math/quaternions.h"
@@ -154,7 +161,7 @@ class EOS_CLASS OpTran
     for (nat32 i=0;i<3;i++)
     {
      tran[i][3] = rhs.t[i];
-     invTran[i][3] = -rhs.t[i];  
+     invTran[i][3] = -(invTran[i][0]*rhs.t[0] + invTran[i][1]*rhs.t[1] + invTran[i][2]*rhs.t[2]);
     }
     
     for (nat32 i=0;i<3;i++)
@@ -497,7 +504,7 @@ class EOS_CLASS Boundable : public Deletable
 /// Must suport intersection with rays emited inside the object, for transparency.
 /// Note that if a ray *starts* on the surface of an object it can not intersect
 /// the surface where it starts - this would break reflection and transparency 
-/// code.
+/// code. The const methods are called by many threads at once.
 class EOS_CLASS Object : public Boundable
 {
  public:
@@ -531,6 +538,20 @@ class EOS_CLASS Object : public Boundable
   /// any point along the line. Used to optimise lighting tests.
    virtual bit Intercept(const bs::FiniteLine & line) const = 0;
 
+  /// The distance only ray Intercept for a packet of rays, count of them, at
+  /// most 32. Returns a bit mask of the rays that hit, setting dist for each of
+  /// them. Defaults to calling Intercept for each ray; objects that can do
+  /// several rays at once, e.g. with SIMD, should override it.
+   virtual nat32 InterceptPacket(nat32 count,const bs::Ray * ray,real32 * dist) const
+   {
+    nat32 ret = 0;
+    for (nat32 i=0;i<count;i++)
+    {
+     if (Intercept(ray[i],dist[i])) ret |= 1<<i;
+    }
+    return ret;
+   }
+
 
   /// Must return the number of material indexes the object will output, 
   /// for user conveniance.
@@ -662,6 +683,18 @@ class EOS_CLASS Texture : public TextureUser
    virtual bit Suports(TextureType type) const = 0;
 
 
+  /// Called by the Job before rendering, for every registered Texture. A
+  /// Texture with inputs should call it on them and may then precompute
+  /// whatever it can, such as collapsing into a constant when all its inputs
+  /// are Constant(). May be called more than once; after a ParaSet() call it
+  /// must be called again before the next render.
+   virtual void Prepare() {}
+
+  /// Returns true if the output is the same for every texture coordinate and
+  /// direction. Only valid after Prepare().
+   virtual bit Constant() const {return false;}
+
+
   /// Extracts a value parameter. Should only be called if it suports this.
   /// Called with orientation information as well as texture coordinates,
   /// orientation will ushally not be used, but has the occasional use.
@@ -732,7 +765,9 @@ class EOS_CLASS Background : public TextureUser
 //------------------------------------------------------------------------------
 /// A Rendererable, consists of an Object, the Transform to get into the 
 /// Object's local coordinate space and the Material's required to
-/// render it. Just a pointer container.
+/// render it. Just a pointer container. Several Renderables may point to the
+/// same Object with different transforms, to instance it - the RenderableDB
+/// types only prepare each Object once, however many times its used.
 class EOS_CLASS Renderable
 {
  public:
@@ -756,7 +791,8 @@ class EOS_CLASS Renderable
 
 //------------------------------------------------------------------------------
 /// RenderableDB, stores a set of objects and manages the ray intersections,
-/// exists to optimise ray intersection tests.
+/// exists to optimise ray intersection tests. After Prepare() the const
+/// queries are made by every render thread at once, with no locking.
 class EOS_CLASS RenderableDB : public Deletable
 {
  public:
@@ -790,6 +826,20 @@ class EOS_CLASS RenderableDB : public Deletable
   /// nothing between the two end points.
   /// The intersection must be converted into world coordinates.
    virtual bit Intercept(const bs::FiniteLine & line,Renderable *& objOut,Intersection & intOut) const = 0;  
+
+  /// The ray Intercept for a packet of count rays, at most 32, which should be
+  /// coherent, e.g. neighbouring primary rays. Returns a bit mask of the rays
+  /// that hit something, filling in objOut and intOut for those. Defaults to
+  /// calling Intercept for each ray.
+   virtual nat32 InterceptPacket(nat32 count,const bs::Ray * ray,Renderable ** objOut,Intersection * intOut) const
+   {
+    nat32 ret = 0;
+    for (nat32 i=0;i<count;i++)
+    {
+     if (Intercept(ray[i],objOut[i],intOut[i])) ret |= 1<<i;
+    }
+    return ret;
+   }
    
    
   /// &nbsp;
@@ -832,7 +882,8 @@ class EOS_CLASS TaggedRay : public bs::Ray
 /// A Renderer, does an actual render, can represent multiple techneques, such as
 /// a simple scan line method, a raytracer or a global illumination renderer.
 /// Responsible for taking the BDRF's of intersecting rays to create a fully 
-/// tagged RayImage object.
+/// tagged RayImage object. Cast is called by many threads at once, each with
+/// its own TaggedRay.
 class EOS_CLASS Renderer : public Deletable
 {
  public:
@@ -851,6 +902,17 @@ class EOS_CLASS Renderer : public Deletable
                      const ds::List<Light*,mem::KillDel<Light> > & ll,
                      const Background & bg) const = 0;
 
+  /// Cast for a packet of count rays, at most 32, that all start inside the
+  /// same objects. Defaults to calling Cast for each.
+   virtual void CastPacket(nat32 count,TaggedRay * ray,
+                           const RenderableDB & db,
+                           const ds::List<Renderable*> & inside,
+                           const ds::List<Light*,mem::KillDel<Light> > & ll,
+                           const Background & bg) const
+   {
+    for (nat32 i=0;i<count;i++) Cast(ray[i],db,inside,ll,bg);
+   }
+
 
   /// &nbsp;
    virtual cstrconst TypeString() const = 0; 
@@ -860,6 +922,12 @@ class EOS_CLASS Renderer : public Deletable
 /// The RayImage stores tagged rays for every pixel.
 /// The results of rendering are collected in this object, which is then passed
 /// through Postproccessor(s) and the ToneMapper object.
+/// Pixels are independent, so threads may add and remove rays at the same time
+/// if each sticks to its own pixels.
+/// For very large renders it can hold just a band of rows at a time, so
+/// memory is bounded by the band rather than the image. Only pixels in the
+/// current band, [BandStart(),BandEnd()), may then be accessed, and moving the
+/// band discards all the rays stored.
 class EOS_CLASS RayImage
 {
  public:
@@ -867,8 +935,9 @@ class EOS_CLASS RayImage
   /// rays for each pixel, though you can store more rays per pixel it is 
   /// expected that most pixels would be the expected number,
   /// due to anti-aliasing. blockRays is the number of extra rays allocated 
-  /// each time a pixel runs out of space.
-   RayImage(nat32 width,nat32 height,nat32 expRays,nat32 blockRays = 4);
+  /// each time a pixel runs out of space. bandHeight is the number of rows
+  /// stored at once, 0 (or the height or more) to store the entire image.
+   RayImage(nat32 width,nat32 height,nat32 expRays,nat32 blockRays = 4,nat32 bandHeight = 0);
    
   /// &nbsp;
    ~RayImage();
@@ -881,6 +950,16 @@ class EOS_CLASS RayImage
    nat32 Height() const;
 
 
+  /// Returns the first row of the current band.
+   nat32 BandStart() const {return bandStart;}
+
+  /// Returns one past the last row of the current band.
+   nat32 BandEnd() const {return math::Min(bandStart+bandHeight,height);}
+
+  /// Moves the band so it starts at the given row, emptying all pixels.
+   void MoveBand(nat32 start);
+
+
   /// Returns the number of tagged rays assigned to a given pixel.
    nat32 Rays(nat32 x,nat32 y) const;
 
@@ -910,6 +989,8 @@ class EOS_CLASS RayImage
   nat32 height;
   nat32 expRays;
   nat32 blockRays;
+  nat32 bandStart;
+  nat32 bandHeight;
   
   nat32 sizeOfThing;
  
@@ -938,8 +1019,11 @@ class EOS_CLASS RayImage
 
     Head * Entry(nat32 x,nat32 y) const
     {
-     return (Head*)(void*)(data + sizeOfThing*(width*y + x));
+     return (Head*)(void*)(data + sizeOfThing*(width*(y-bandStart) + x));
     }
+
+   // Empties every pixel, freeing any extra nodes...
+    void Clear();
 };
 
 //------------------------------------------------------------------------------
@@ -991,7 +1075,8 @@ class EOS_CLASS Viewer : public TextureUser
 /// implimented here.
 /// This actually drives a render, being given all the relevent objects and the
 /// progress bar, so it can report what percentage of rays have been cast/pixels
-/// done etc.
+/// done etc. It is expected to spread the work over the mt::DefaultPool(),
+/// reporting progress from the calling thread only.
 class EOS_CLASS Sampler : public Deletable
 {
  public:
@@ -1010,6 +1095,15 @@ class EOS_CLASS Sampler : public Deletable
    virtual void Render(class Job & job,time::Progress * prog = null<time::Progress*>()) = 0;
 
 
+  /// Returns true if the sampler can render a range of rows at a time, with
+  /// RenderRows, so the Job can use a RayImage that only stores a band.
+   virtual bit Banded() const {return false;}
+
+  /// Renders just the rows [y0,y1), which will be within the band of the Jobs
+  /// RayImage. Only called if Banded() returns true.
+   virtual void RenderRows(class Job & job,nat32 y0,nat32 y1,time::Progress * prog = null<time::Progress*>()) {}
+
+
   /// &nbsp;
    virtual cstrconst TypeString() const = 0;    
 };
@@ -1045,6 +1139,21 @@ class EOS_CLASS ToneMapper : public TextureUser
   /// Given a RayImage and a svt::Field for output this does the tone mapping.
    virtual void Apply(const RayImage & ri,svt::Field<bs::ColourRGB> & out,
                       time::Progress * prog = null<time::Progress*>()) const = 0;
+
+
+  /// Returns true if the tone mapper can be given the image a band of rows at
+  /// a time, by calling Begin, then ApplyRows for each band, then End.
+   virtual bit Banded() const {return false;}
+
+  /// Called before the first band is given, to reset any statistics.
+   virtual void Begin(svt::Field<bs::ColourRGB> & out) {}
+
+  /// Writes the rows [y0,y1) of the output from the RayImage, which will be
+  /// its current band. The output need not be final until End is called.
+   virtual void ApplyRows(const RayImage & ri,nat32 y0,nat32 y1,svt::Field<bs::ColourRGB> & out) {}
+
+  /// Called after the last band, to finish the output.
+   virtual void End(svt::Field<bs::ColourRGB> & out,time::Progress * prog = null<time::Progress*>()) {}
 };
 
 //------------------------------------------------------------------------------
@@ -1122,7 +1231,8 @@ class EOS_CLASS Job
   /// Registers a Material so it can be deleted when the Job is done.
    void Register(Material * mat);
 
-  /// Registers a Texture so it can be deleted when the Job is done.
+  /// Registers a Texture so it can be deleted when the Job is done. Registered
+  /// textures also have Texture::Prepare() called before each render.
    void Register(Texture * tex);  
 
 
@@ -1132,9 +1242,23 @@ class EOS_CLASS Job
    void Render(time::Progress * prog = null<time::Progress*>());
    
   /// Renders the scene. This generates an image, requiring that
-  /// a ToneMapper was specified.
+  /// a ToneMapper was specified. If a band height has been set, and both the
+  /// Sampler and ToneMapper support it, the image is rendered a band of rows
+  /// at a time, each being post-processed and tone mapped into out before the
+  /// next is started, so only one band of rays is ever stored.
    void Render(svt::Field<bs::ColourRGB> & out,time::Progress * prog = null<time::Progress*>());
 
+
+  /// Sets the number of rows rendered at a time by Render(out,prog), 0, the
+  /// default, to render the whole image at once. Memory use is then
+  /// proportional to the band rather than the image, for when sampling a
+  /// large image would not otherwise fit. Note that post-processors only see
+  /// one band at a time, and RI() will only contain the last band.
+   void SetBandHeight(nat32 rows) {bandHeight = rows;}
+
+  /// &nbsp;
+   nat32 GetBandHeight() const {return bandHeight;}
+
   /// After rendering you can use this to access the RayImage, 
   /// incase you need to extract such information.
   /// (Includes depth, velocity and other juicy bits of info.)
@@ -1164,6 +1288,13 @@ class EOS_CLASS Job
   ds::List<Texture*,mem::KillDel<Texture> > textures;
   
   RayImage * ri;
+  nat32 bandHeight;
+
+  // Calls Prepare on all the registered textures...
+   void PrepareTextures();
+
+  // The version of Render that works a band at a time...
+   void RenderBands(svt::Field<bs::ColourRGB> & out,time::Progress * prog);
 };
 
 //------------------------------------------------------------------------------
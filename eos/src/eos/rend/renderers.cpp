@@ -22,27 +22,10 @@ namespace eos
  namespace rend
  {
 //------------------------------------------------------------------------------
-void OneHit::Cast(TaggedRay & ray,const RenderableDB & db,const ds::List<Renderable*,
-                  mem::KillDel<Light> > & inside,const ds::List<Light*> & ll,const Background & bg) const
+void OneHit::Cast(TaggedRay & ray,const RenderableDB & db,const ds::List<Renderable*> & inside,
+                  const ds::List<Light*,mem::KillDel<Light> > & ll,const Background & bg) const
 {
- if (db.Intercept(ray,ray.hit,ray.inter))
- {
-  // Hit an object - respond accordingly...
-   ray.irradiance = bs::ColourRGB(0.0,0.0,0.0);
-
-   Renderable::MatSpec & ms = ray.hit->mat[ray.inter.coord.material];
-   if (ms.im) ms.im->Modify(ray.inter);
-   
-   ds::List<Light*>::Cursor targ = ll.FrontPtr();
-   while (!targ.Bad())
-   {
-    bs::ColourRGB out;
-    bs::Normal norm = ray.n; norm.Neg();
-    (*targ)->Calc(norm,ray.inter,*ms.mat,db,out);
-    ray.irradiance += out;
-    ++targ;
-   }
- }
+ if (db.Intercept(ray,ray.hit,ray.inter)) Shade(ray,db,ll);
  else
  {
   // Missed all objects - use the background instead...
@@ -51,6 +34,49 @@ void OneHit::Cast(TaggedRay & ray,const RenderableDB & db,const ds::List<Rendera
  }
 }
 
+void OneHit::CastPacket(nat32 count,TaggedRay * ray,const RenderableDB & db,const ds::List<Renderable*> & inside,
+                        const ds::List<Light*,mem::KillDel<Light> > & ll,const Background & bg) const
+{
+ bs::Ray base[32];
+ Renderable * hit[32];
+ Intersection inter[32];
+ for (nat32 i=0;i<count;i++) base[i] = ray[i];
+
+ nat32 mask = db.InterceptPacket(count,base,hit,inter);
+ for (nat32 i=0;i<count;i++)
+ {
+  if (mask&(1<<i))
+  {
+   ray[i].hit = hit[i];
+   ray[i].inter = inter[i];
+   Shade(ray[i],db,ll);
+  }
+  else
+  {
+   ray[i].hit = null<Renderable*>();
+   bg.Calc(ray[i],ray[i].irradiance);
+  }
+ }
+}
+
+void OneHit::Shade(TaggedRay & ray,const RenderableDB & db,const ds::List<Light*,mem::KillDel<Light> > & ll) const
+{
+ ray.irradiance = bs::ColourRGB(0.0,0.0,0.0);
+
+ Renderable::MatSpec & ms = ray.hit->mat[ray.inter.coord.material];
+ if (ms.im) ms.im->Modify(ray.inter);
+
+ ds::List<Light*,mem::KillDel<Light> >::Cursor targ = ll.FrontPtr();
+ while (!targ.Bad())
+ {
+  bs::ColourRGB out;
+  bs::Normal norm = ray.n; norm.Neg();
+  (*targ)->Calc(norm,ray.inter,*ms.mat,db,out);
+  ray.irradiance += out;
+  ++targ;
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -50,11 +50,20 @@ class EOS_CLASS OneHit : public Renderer
    ~OneHit() {}
   
   /// &nbsp;
-   void Cast(TaggedRay & ray,const RenderableDB & db,const ds::List<Renderable*,
-             mem::KillDel<Light> > & inside,const ds::List<Light*> & ll,const Background & bg) const;
+   void Cast(TaggedRay & ray,const RenderableDB & db,const ds::List<Renderable*> & inside,
+             const ds::List<Light*,mem::KillDel<Light> > & ll,const Background & bg) const;
+
+  /// Intercepts the rays together, with RenderableDB::InterceptPacket.
+   void CastPacket(nat32 count,TaggedRay * ray,const RenderableDB & db,const ds::List<Renderable*> & inside,
+                   const ds::List<Light*,mem::KillDel<Light> > & ll,const Background & bg) const;
   
   /// &nbsp;
    cstrconst TypeString() const {return "eos::rend::OneHit";}
+
+
+ private:
+  // Sets the irradiance of a ray that has hit something...
+   void Shade(TaggedRay & ray,const RenderableDB & db,const ds::List<Light*,mem::KillDel<Light> > & ll) const;
 };
 
 //------------------------------------------------------------------------------
@@ -17,23 +17,79 @@
 
 #include "eos/rend/rerender.h"
 
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 namespace eos
 {
  namespace rend
  {
 //------------------------------------------------------------------------------
+// Renders a range of rows for LambertianNeedleRender, 4 pixels at a time with
+// SSE when avaliable, the pixels being gathered into one register per
+// component...
+class LambertianRows
+{
+ public:
+  LambertianRows(const svt::Field<real32> & a,const svt::Field<bs::Normal> & n,const bs::Normal & l,svt::Field<real32> & o)
+  :albedo(a),needle(n),toLight(l),out(o)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   nat32 width = albedo.Size(0);
+   for (nat32 y=y0;y<y1;y++)
+   {
+    nat32 x = 0;
+    #ifdef __SSE__
+     __m128 lx = _mm_set1_ps(toLight[0]);
+     __m128 ly = _mm_set1_ps(toLight[1]);
+     __m128 lz = _mm_set1_ps(toLight[2]);
+     __m128 zero = _mm_setzero_ps();
+     __m128 one = _mm_set1_ps(1.0);
+     for (;x+4<=width;x+=4)
+     {
+      const bs::Normal & n0 = needle.Get(x,y);
+      const bs::Normal & n1 = needle.Get(x+1,y);
+      const bs::Normal & n2 = needle.Get(x+2,y);
+      const bs::Normal & n3 = needle.Get(x+3,y);
+
+      __m128 dot = _mm_mul_ps(lx,_mm_setr_ps(n0[0],n1[0],n2[0],n3[0]));
+      dot = _mm_add_ps(dot,_mm_mul_ps(ly,_mm_setr_ps(n0[1],n1[1],n2[1],n3[1])));
+      dot = _mm_add_ps(dot,_mm_mul_ps(lz,_mm_setr_ps(n0[2],n1[2],n2[2],n3[2])));
+
+      __m128 alb = _mm_setr_ps(albedo.Get(x,y),albedo.Get(x+1,y),albedo.Get(x+2,y),albedo.Get(x+3,y));
+      __m128 res = _mm_min_ps(_mm_max_ps(_mm_mul_ps(alb,dot),zero),one);
+
+      real32 temp[4];
+      _mm_storeu_ps(temp,res);
+      for (nat32 i=0;i<4;i++) out.Get(x+i,y) = temp[i];
+     }
+    #endif
+    for (;x<width;x++)
+    {
+     out.Get(x,y) = math::Clamp<real32>(albedo.Get(x,y) * (toLight * needle.Get(x,y)),0.0,1.0);
+    }
+   }
+  }
+
+ private:
+  const svt::Field<real32> & albedo;
+  const svt::Field<bs::Normal> & needle;
+  const bs::Normal & toLight;
+  svt::Field<real32> & out;
+};
+
 EOS_FUNC void LambertianNeedleRender(const svt::Field<real32> & albedo,
                                      const svt::Field<bs::Normal> & needle,
                                      const bs::Normal & toLight,
                                      svt::Field<real32> & out)
 {
- for (nat32 y=0;y<albedo.Size(1);y++)
- {
-  for (nat32 x=0;x<albedo.Size(0);x++)
-  {
-   out.Get(x,y) = math::Clamp<real32>(albedo.Get(x,y) * (toLight * needle.Get(x,y)),0.0,1.0);
-  }
- }
+ LambertianRows rows(albedo,needle,toLight,out);
+ mt::ParallelFor(nat32(0),albedo.Size(1),rows,16);
 }
 
 //------------------------------------------------------------------------------
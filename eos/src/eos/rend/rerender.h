@@ -33,7 +33,9 @@ namespace eos
 //------------------------------------------------------------------------------
 /// Given an albedo and a normal for each point in an image this assumes basic
 /// lambertion lighting, from an infinite light source that dosn't cast shadows,
-/// and re-renders the image accordingly.
+/// and re-renders the image accordingly. Rows are done in parallel on the
+/// thread pool, 4 pixels at a time with SSE when avaliable. To only update part
+/// of an image, such as the visible region in a GUI, pass svt::View's of it.
 /// \param albedo Albedo for each pixel in the image.
 /// \param needle Surface normal for each pixel in the image.
 /// \param toLight Normal pointing towards light source at infinity, its length is the strength of he light. (Any longer than 1 and the image will probably suffer from saturation.)
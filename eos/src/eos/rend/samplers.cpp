@@ -17,59 +17,429 @@
 
 #include "eos/rend/samplers.h"
 
+#include "eos/mt/tasks.h"
+#include "eos/ds/arrays2d.h"
+
 namespace eos
 {
  namespace rend
  {
 //------------------------------------------------------------------------------
+// Casts the rays of the samplers and adds them to the ray image. When they all
+// start inside the same objects neighbouring rays are coherent, so they are
+// batched into packets, being added in the same order as a ray at a time
+// would. One per thread...
+class SampleCaster
+{
+ public:
+  SampleCaster(Job & j,bit cs,const ds::List<Renderable*> & si)
+  :job(j),constantStart(cs),startInside(si),waiting(0)
+  {}
+
+  // Casts a ray through image position (xp,yp), adding it to pixel (x,y)...
+   void Add(nat32 x,nat32 y,real32 xp,real32 yp)
+   {
+    TaggedRay & targ = ray[waiting];
+    job.Camera().ViewRay(xp,yp,targ);
+    targ.weight = 1.0;
+
+    if (constantStart)
+    {
+     px[waiting] = x;
+     py[waiting] = y;
+     ++waiting;
+     if (waiting==packetSize) Flush();
+    }
+    else
+    {
+     inside.Reset();
+     job.DB().Inside(targ.s,inside);
+     job.Rend().Cast(targ,job.DB(),inside,job.LightList(),job.BG());
+     job.RI().AddRay(x,y,targ);
+    }
+   }
+
+  // Casts any rays still waiting for a packet to fill up...
+   void Flush()
+   {
+    if (waiting==0) return;
+    job.Rend().CastPacket(waiting,ray,job.DB(),startInside,job.LightList(),job.BG());
+    for (nat32 i=0;i<waiting;i++) job.RI().AddRay(px[i],py[i],ray[i]);
+    waiting = 0;
+   }
+
+ private:
+  static const nat32 packetSize = 16;
+
+  Job & job;
+  bit constantStart;
+  const ds::List<Renderable*> & startInside;
+  ds::List<Renderable*> inside;
+
+  TaggedRay ray[packetSize];
+  nat32 px[packetSize];
+  nat32 py[packetSize];
+  nat32 waiting;
+};
+
+//------------------------------------------------------------------------------
+// Renders the tiles of a band of rows for GridAA...
+class GridAATile
+{
+ public:
+  GridAATile(Job & j,const GridAA & gaa,bit cs,const ds::List<Renderable*> & si)
+  :job(j),self(gaa),constantStart(cs),startInside(si),yOffset(0)
+  {}
+
+  void operator () (nat32 x0,nat32 y0,nat32 x1,nat32 y1)
+  {
+   SampleCaster caster(job,constantStart,startInside);
+   nat32 dimSamps = self.dimSamps;
+
+   for (nat32 y=y0+yOffset;y<y1+yOffset;y++)
+   {
+    for (nat32 x=x0;x<x1;x++)
+    {
+     for (nat32 v=0;v<dimSamps;v++)
+     {
+      for (nat32 u=0;u<dimSamps;u++)
+      {
+       real32 xp = real32(x) + real32(u)/real32(dimSamps+1);
+       real32 yp = real32(y) + real32(v)/real32(dimSamps+1);
+       caster.Add(x,y,xp,yp);
+      }
+     }
+    }
+   }
+
+   caster.Flush();
+  }
+
+  Job & job;
+  const GridAA & self;
+  bit constantStart;
+  const ds::List<Renderable*> & startInside;
+  nat32 yOffset;
+};
+
 void GridAA::Render(Job & job,time::Progress * prog)
+{
+ RenderRows(job,0,job.Camera().Height(),prog);
+}
+
+void GridAA::RenderRows(Job & job,nat32 y0,nat32 y1,time::Progress * prog)
 {
  prog->Push();
- 
- nat32 height = job.Camera().Height();
+
+ static const nat32 tileSize = 32;
+ static const nat32 bandHeight = tileSize*4;
+
  nat32 width = job.Camera().Width();
  bs::Vert start;
  bit constantStart = job.Camera().ConstantStart(start);
- 
- ds::List<Renderable*> inside;
- TaggedRay ray;
-
 
+ ds::List<Renderable*> inside;
  if (constantStart) job.DB().Inside(start,inside);
 
- for (nat32 y=0;y<height;y++)
+ GridAATile tile(job,*this,constantStart,inside);
+ for (nat32 y=y0;y<y1;y+=bandHeight)
  {
-  for (nat32 x=0;x<width;x++)
+  prog->Report(y-y0,y1-y0);
+  tile.yOffset = y;
+  mt::ParallelFor2D(width,math::Min(bandHeight,y1-y),tile,tileSize,tileSize);
+ }
+
+ prog->Pop();
+}
+
+//------------------------------------------------------------------------------
+// Renders the tiles of a band of rows for a pass of AdaptiveAA. The first pass
+// casts the initial samples and records the mean of each pixel, and if its own
+// samples disagree; the second compares each pixel with its neighbours and
+// casts the rest of the fine grid for those that need it...
+class AdaptiveAATile
+{
+ public:
+  AdaptiveAATile(Job & j,const AdaptiveAA & aaa,bit cs,const ds::List<Renderable*> & si)
+  :job(j),self(aaa),constantStart(cs),startInside(si),yOffset(0),second(false),
+  mean(job.Camera().Width(),job.Camera().Height()),
+  busy(job.Camera().Width(),job.Camera().Height())
+  {
+   // Spread the initial samples over the fine grid, on each axis...
+    nat32 initDim = math::Min(self.initDim,self.fineDim);
+    for (nat32 i=0;i<self.fineDim;i++) initial[i] = false;
+    for (nat32 i=0;i<initDim;i++) initial[((2*i+1)*self.fineDim)/(2*initDim)] = true;
+  }
+
+  void operator () (nat32 x0,nat32 y0,nat32 x1,nat32 y1)
   {
-   prog->Report(y*width+x,width*height);
-   
-   for (nat32 v=0;v<dimSamps;v++)
+   SampleCaster caster(job,constantStart,startInside);
+   nat32 fineDim = self.fineDim;
+
+   for (nat32 y=y0+yOffset;y<y1+yOffset;y++)
    {
-    for (nat32 u=0;u<dimSamps;u++)
+    for (nat32 x=x0;x<x1;x++)
     {
-     real32 xp = real32(x) + real32(u)/real32(dimSamps+1);
-     real32 yp = real32(y) + real32(v)/real32(dimSamps+1);
-     job.Camera().ViewRay(xp,yp,ray);
-     ray.weight = 1.0;
-     
-     if (!constantStart)
+     if (second&&(!Refine(x,y))) continue;
+
+     for (nat32 v=0;v<fineDim;v++)
      {
-      inside.Reset();
-      job.DB().Inside(ray.s,inside);
+      for (nat32 u=0;u<fineDim;u++)
+      {
+       if ((initial[u]&&initial[v])==second) continue;
+       real32 xp = real32(x) + (real32(u)+0.5)/real32(fineDim);
+       real32 yp = real32(y) + (real32(v)+0.5)/real32(fineDim);
+       caster.Add(x,y,xp,yp);
+      }
      }
-     
-     job.Rend().Cast(ray,job.DB(),inside,job.LightList(),job.BG());
-     
-     job.RI().AddRay(x,y,ray);
     }
    }
 
+   caster.Flush();
+   if (second) return;
+
+   // Statistics of the initial samples of each pixel...
+    for (nat32 y=y0+yOffset;y<y1+yOffset;y++)
+    {
+     for (nat32 x=x0;x<x1;x++)
+     {
+      const RayImage & ri = job.RI();
+      nat32 rays = ri.Rays(x,y);
+
+      bs::ColourRGB sum(0.0,0.0,0.0);
+      bs::ColourRGB sqrSum(0.0,0.0,0.0);
+      bit differ = false;
+      for (nat32 r=0;r<rays;r++)
+      {
+       const TaggedRay & ray = ri.Ray(x,y,r);
+       sum += ray.irradiance;
+       sqrSum.r += math::Sqr(ray.irradiance.r);
+       sqrSum.g += math::Sqr(ray.irradiance.g);
+       sqrSum.b += math::Sqr(ray.irradiance.b);
+       if (ray.hit!=ri.Ray(x,y,0).hit) differ = true;
+      }
+      sum /= real32(rays);
+      sqrSum /= real32(rays);
+
+      real32 limit = math::Sqr(self.threshold);
+      if ((sqrSum.r-math::Sqr(sum.r)>limit)||
+          (sqrSum.g-math::Sqr(sum.g)>limit)||
+          (sqrSum.b-math::Sqr(sum.b)>limit)) differ = true;
+
+      mean.Get(x,y) = sum;
+      busy.Get(x,y) = differ;
+     }
+    }
   }
+
+  // True if a pixel needs the rest of its samples, by its own samples or the
+  // contrast with its 4 neighbours...
+   bit Refine(nat32 x,nat32 y) const
+   {
+    if (busy.Get(x,y)) return true;
+
+    const bs::ColourRGB & c = mean.Get(x,y);
+    for (nat32 n=0;n<4;n++)
+    {
+     const bs::ColourRGB & o = mean.ClampGet(int32(x)+((n==0)?1:0)-((n==1)?1:0),
+                                             int32(y)+((n==2)?1:0)-((n==3)?1:0));
+     if ((math::Abs(c.r-o.r)>self.threshold)||
+         (math::Abs(c.g-o.g)>self.threshold)||
+         (math::Abs(c.b-o.b)>self.threshold)) return true;
+    }
+    return false;
+   }
+
+  Job & job;
+  const AdaptiveAA & self;
+  bit constantStart;
+  const ds::List<Renderable*> & startInside;
+  nat32 yOffset;
+  bit second;
+
+  bit initial[AdaptiveAA::maxDim];
+  ds::Array2D<bs::ColourRGB> mean;
+  ds::Array2D<bit> busy;
+};
+
+AdaptiveAA::AdaptiveAA(nat32 iDim,nat32 fDim,real32 thresh)
+:initDim(math::Max(iDim,nat32(1))),fineDim(math::Clamp(fDim,nat32(1),maxDim)),threshold(thresh)
+{}
+
+void AdaptiveAA::Render(Job & job,time::Progress * prog)
+{
+ prog->Push();
+
+ static const nat32 tileSize = 32;
+ static const nat32 bandHeight = tileSize*4;
+
+ nat32 height = job.Camera().Height();
+ nat32 width = job.Camera().Width();
+ bs::Vert start;
+ bit constantStart = job.Camera().ConstantStart(start);
+
+ ds::List<Renderable*> inside;
+ if (constantStart) job.DB().Inside(start,inside);
+
+ AdaptiveAATile tile(job,*this,constantStart,inside);
+ for (nat32 pass=0;pass<2;pass++)
+ {
+  tile.second = pass==1;
+  for (nat32 y=0;y<height;y+=bandHeight)
+  {
+   prog->Report(pass*height+y,2*height);
+   tile.yOffset = y;
+   mt::ParallelFor2D(width,math::Min(bandHeight,height-y),tile,tileSize,tileSize);
+  }
+ }
+
+ prog->Pop();
+}
+
+//------------------------------------------------------------------------------
+// Renders the tiles of a band of rows for a pass of ProgressiveAA; tile
+// coordinates are in the grid of pixels spaced by spacing, skipping those done
+// by an earlier pass when filling in...
+class ProgressiveAATile
+{
+ public:
+  ProgressiveAATile(Job & j,const ProgressiveAA & paa,bit cs,const ds::List<Renderable*> & si)
+  :job(j),self(paa),constantStart(cs),startInside(si),
+  yOffset(0),spacing(1),fillIn(false),sample(0)
+  {}
+
+  void operator () (nat32 x0,nat32 y0,nat32 x1,nat32 y1)
+  {
+   SampleCaster caster(job,constantStart,startInside);
+   nat32 dimSamps = self.dimSamps;
+   real32 xs = real32(sample%dimSamps)/real32(dimSamps+1);
+   real32 ys = real32(sample/dimSamps)/real32(dimSamps+1);
+   nat32 width = job.Camera().Width();
+   nat32 height = job.Camera().Height();
+
+   for (nat32 gy=y0+yOffset;gy<y1+yOffset;gy++)
+   {
+    nat32 y = gy*spacing;
+    if (y>=height) break;
+    for (nat32 gx=x0;gx<x1;gx++)
+    {
+     nat32 x = gx*spacing;
+     if (x>=width) break;
+     if (fillIn&&((gx&1)==0)&&((gy&1)==0)) continue;
+     caster.Add(x,y,real32(x)+xs,real32(y)+ys);
+    }
+   }
+
+   caster.Flush();
+  }
+
+  Job & job;
+  const ProgressiveAA & self;
+  bit constantStart;
+  const ds::List<Renderable*> & startInside;
+
+  nat32 yOffset; // In grid rows.
+  nat32 spacing; // Between the pixels of the grid.
+  bit fillIn; // If true pixels with even grid coordinates in both axes are skipped.
+  nat32 sample; // Which of the pixels GridAA samples to cast.
+};
+
+ProgressiveAA::ProgressiveAA(nat32 dimSamples,nat32 sb,Handler * h)
+:dimSamps(dimSamples),startBlock(1),handler(h)
+{
+ while (startBlock*2<=sb) startBlock *= 2;
+}
+
+void ProgressiveAA::Render(Job & job,time::Progress * prog)
+{
+ prog->Push();
+
+ static const nat32 tileSize = 32;
+ static const nat32 bandHeight = tileSize*4;
+
+ nat32 height = job.Camera().Height();
+ nat32 width = job.Camera().Width();
+ bs::Vert start;
+ bit constantStart = job.Camera().ConstantStart(start);
+
+ ds::List<Renderable*> inside;
+ if (constantStart) job.DB().Inside(start,inside);
+
+ // Count the passes, for progress reporting...
+  nat32 levels = 0;
+  for (nat32 b=startBlock;b>0;b/=2) ++levels;
+  nat32 passes = levels + math::Sqr(dimSamps) - 1;
+
+ ProgressiveAATile tile(job,*this,constantStart,inside);
+ nat32 spacing = startBlock;
+ for (nat32 pass=0;pass<passes;pass++)
+ {
+  prog->Report(pass,passes);
+  prog->Push();
+
+  // Set up the pass - coarse to fine first sample, then the rest of them...
+   if (pass<levels)
+   {
+    tile.spacing = spacing;
+    tile.fillIn = pass!=0;
+    tile.sample = 0;
+   }
+   else
+   {
+    tile.spacing = 1;
+    tile.fillIn = false;
+    tile.sample = pass - levels + 1;
+   }
+
+  // Do it, in bands, so it can be cancelled between them...
+   nat32 gridW = (width + tile.spacing - 1)/tile.spacing;
+   nat32 gridH = (height + tile.spacing - 1)/tile.spacing;
+   for (nat32 y=0;y<gridH;y+=bandHeight)
+   {
+    if (prog->Cancelled()) break;
+    prog->Report(y,gridH);
+    tile.yOffset = y;
+    mt::ParallelFor2D(gridW,math::Min(bandHeight,gridH-y),tile,tileSize,tileSize);
+   }
+
+  prog->Pop();
+  if (prog->Cancelled()) break;
+
+  if (handler) handler->Pass(job.RI(),tile.spacing,pass);
+  if (pass+1<levels) spacing /= 2;
  }
- 
+
  prog->Pop();
 }
 
+void ProgressiveAA::Preview(const RayImage & ri,nat32 spacing,svt::Field<bs::ColourRGB> & out)
+{
+ for (nat32 y=0;y<ri.Height();y++)
+ {
+  nat32 sy = y - (y%spacing);
+  for (nat32 x=0;x<ri.Width();x++)
+  {
+   nat32 sx = x - (x%spacing);
+   if (y!=sy) {out.Get(x,y) = out.Get(x,sy); continue;}
+   if (x!=sx) {out.Get(x,y) = out.Get(sx,y); continue;}
+
+   bs::ColourRGB col(0.0,0.0,0.0);
+   nat32 rays = ri.Rays(x,y);
+   if (rays!=0)
+   {
+    real32 mult = 1.0/ri.RaysWeightSum(x,y);
+    for (nat32 i=0;i<rays;i++)
+    {
+     bs::ColourRGB c = ri.Ray(x,y,i).irradiance;
+     c *= ri.Ray(x,y,i).weight * mult;
+     col += c;
+    }
+   }
+   out.Get(x,y) = col;
+  }
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
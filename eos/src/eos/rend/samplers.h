@@ -32,7 +32,10 @@ namespace eos
 //------------------------------------------------------------------------------
 /// This is a standard grid based anti-aliasing arrangment, you specify how many
 /// rays to divide each pixel into on each axis and it then fires that many rays
-/// squared for each pixel. Reports progress on a pixel by pixel basis.
+/// squared for each pixel. The image is rendered in tiles by the thread pool,
+/// progress being reported after each band of tiles. The rays of each pixel
+/// are always cast in the same order by one thread, so the result does not
+/// depend on the number of threads.
 class EOS_CLASS GridAA : public Sampler
 {
  public:
@@ -57,12 +60,132 @@ class EOS_CLASS GridAA : public Sampler
    void Render(Job & job,time::Progress * prog);
 
 
+  /// &nbsp;
+   bit Banded() const {return true;}
+
+  /// &nbsp;
+   void RenderRows(Job & job,nat32 y0,nat32 y1,time::Progress * prog);
+
+
   /// &nbsp;
    cstrconst TypeString() const {return "eos::rend::GridAA";}
 
 
  private:
+  friend class GridAATile;
+
+  nat32 dimSamps;
+};
+
+//------------------------------------------------------------------------------
+/// An adaptive version of GridAA, which only fires lots of rays where they are
+/// needed. Each pixel is divided into a fine grid, of which a sparse subset of
+/// initial samples are cast first; only pixels where those disagree get the
+/// rest of the fine grid. A pixel disagrees if the standard deviation of any
+/// colour channel of its samples is above a threshold, if its samples hit
+/// different objects, or if its mean differs from that of a 4-neighbour by
+/// more than the threshold in any channel. Flat areas, such as the background,
+/// therefore cost initial dimension squared rays a pixel, whilst edges get the
+/// full fine grid. Rendered as two passes of tiles on the thread pool, and as
+/// for GridAA the result does not depend on the number of threads.
+class EOS_CLASS AdaptiveAA : public Sampler
+{
+ public:
+  /// The maximum fine samples per dimension.
+   static const nat32 maxDim = 16;
+
+  /// \param initDim Initial samples per dimension, at most fineDim.
+  /// \param fineDim Samples per dimension of pixels that need more, so the maximum number of samples of a pixel is this squared. Clamped to maxDim.
+  /// \param threshold The colour difference above which a pixel gets more samples.
+   AdaptiveAA(nat32 initDim = 2,nat32 fineDim = 4,real32 threshold = 0.02);
+
+  /// &nbsp;
+   ~AdaptiveAA() {}
+
+
+  /// Maximum samples per pixel.
+   nat32 Samples() const {return math::Sqr(fineDim);}
+
+  /// &nbsp;
+   void Render(Job & job,time::Progress * prog);
+
+
+  /// &nbsp;
+   cstrconst TypeString() const {return "eos::rend::AdaptiveAA";}
+
+
+ private:
+  friend class AdaptiveAATile;
+
+  nat32 initDim;
+  nat32 fineDim;
+  real32 threshold;
+};
+
+//------------------------------------------------------------------------------
+/// A progressive version of GridAA, for interactive previews. It first casts
+/// one ray for every startBlock'th pixel in each direction, then halves the
+/// spacing each pass, filling in the pixels between, until every pixel has a
+/// ray; further passes then add the rest of the rays each pixel gets from
+/// GridAA, one per pass. The rays of each pixel end up exactly as GridAA would
+/// give, so the final image is the same. After each pass a Handler, if given,
+/// is handed the RayImage so far, from the thread that called Render, and
+/// Preview() can turn it into an image. Between bands of each pass it checks
+/// time::Progress::Cancelled() and returns early if set, leaving a partial but
+/// valid RayImage, so a GUI can abandon a render when the view changes.
+class EOS_CLASS ProgressiveAA : public Sampler
+{
+ public:
+  /// Told about each pass as it finishes.
+   class EOS_CLASS Handler
+   {
+    public:
+     /// &nbsp;
+      virtual ~Handler() {}
+
+     /// Called after each pass, with the ray image so far and the spacing of
+     /// the pixels that have rays; 1 once they all do. pass counts from 0.
+      virtual void Pass(const RayImage & ri,nat32 spacing,nat32 pass) = 0;
+   };
+
+
+  /// \param dimSamples As for GridAA.
+  /// \param startBlock Pixel spacing of the first pass, rounded down to a power of 2.
+  /// \param handler Told about each pass, can be null. Not owned.
+   ProgressiveAA(nat32 dimSamples = 1,nat32 startBlock = 16,Handler * handler = null<Handler*>());
+
+  /// &nbsp;
+   ~ProgressiveAA() {}
+
+
+  /// &nbsp;
+   void SetHandler(Handler * h) {handler = h;}
+
+
+  /// &nbsp;
+   nat32 Samples() const {return math::Sqr(dimSamps);}
+
+  /// &nbsp;
+   void Render(Job & job,time::Progress * prog);
+
+
+  /// Fills in an image from a partial RayImage, given the spacing of the pixels
+  /// with rays, as handed to Handler::Pass; each pixel gets the weighted mean
+  /// of the rays of the nearest pixel with rays above and to the left of it.
+  /// The image must be the size of the RayImage.
+   static void Preview(const RayImage & ri,nat32 spacing,svt::Field<bs::ColourRGB> & out);
+
+
+  /// &nbsp;
+   cstrconst TypeString() const {return "eos::rend::ProgressiveAA";}
+
+
+ private:
+  friend class ProgressiveAATile;
+
   nat32 dimSamps;
+  nat32 startBlock;
+  Handler * handler;
 };
 
 //------------------------------------------------------------------------------
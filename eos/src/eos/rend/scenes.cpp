@@ -64,6 +64,17 @@ OpTran * TransformStack::Current()
  return targ.tran;
 }
 
+Renderable * TransformStack::Instance(const Renderable & proto)
+{
+ Renderable * ret = new Renderable();
+  ret->object = proto.object;
+  ret->local = Current();
+  ret->mat.Size(proto.mat.Size());
+  for (nat32 i=0;i<proto.mat.Size();i++) ret->mat[i] = proto.mat[i];
+ regWith->Add(ret);
+ return ret;
+}
+
 //------------------------------------------------------------------------------
 Scene::Scene()
 {}
@@ -89,6 +89,15 @@ class EOS_CLASS TransformStack
   /// a Push/Pop it will return the same pointer each time.
    OpTran * Current();
 
+  /// Adds an instance of the given Renderable to the Job, at the current
+  /// location. The new Renderable shares its Object and materials with proto,
+  /// only the transform differs, so a mesh can be repeated many times whilst
+  /// only being stored, and having its acceleration structure built, once.
+  /// The Object is then in effect the bottom level of a two level hierachy,
+  /// with the Job's RenderableDB being the top level over the instances.
+  /// Returns the new Renderable, which the Job owns.
+   Renderable * Instance(const Renderable & proto);
+
 
   /// &nbsp;
    static inline cstrconst TypeString() {return "eos::rend::TransformStack";}
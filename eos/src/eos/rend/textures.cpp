@@ -17,10 +17,44 @@
 
 #include "eos/rend/textures.h"
 
+#include "eos/math/functions.h"
+
 namespace eos
 {
  namespace rend
  {
+//------------------------------------------------------------------------------
+// Prepares count inputs of a combinator, returning true if they are all there
+// and constant...
+inline bit PrepareInputs(nat32 count,Texture * const * in)
+{
+ bit ret = true;
+ for (nat32 i=0;i<count;i++)
+ {
+  if (in[i]==null<Texture*>()) {ret = false; continue;}
+  in[i]->Prepare();
+  if (!in[i]->Constant()) ret = false;
+ }
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+void TextureCache::Fill(const Texture & tex)
+{
+ valid = false;
+
+ TexCoord coord(0.0,0.0,0.0);
+ coord.material = 0;
+ bs::Normal dir(0.0,0.0,1.0);
+
+ if (tex.Suports(TextureValue)) tex.GetValue(coord,dir,dir,value);
+ if (tex.Suports(TextureColour)) tex.GetColour(coord,dir,dir,colour);
+ if (tex.Suports(TextureOffset)) tex.GetOffset(coord,dir,dir,offset);
+ if (tex.Suports(TextureVector)) tex.GetVector(coord,dir,dir,vector);
+
+ valid = true;
+}
+
 //------------------------------------------------------------------------------
 ConstantTexture::~ConstantTexture()
 {}
@@ -76,6 +110,7 @@ cstrconst AddTexture::ParaName(nat32 index) const
 
 void AddTexture::ParaSet(nat32 index,class Texture * rhs)
 {
+ cache.Reset();
  switch (index)
  {
   case 0: a = rhs; break;
@@ -88,8 +123,17 @@ bit AddTexture::Suports(TextureType t) const
  return type==t;
 }
 
+void AddTexture::Prepare()
+{
+ cache.Reset();
+ Texture * input[2] = {a,b};
+ if (PrepareInputs(2,input)) cache.Fill(*this);
+}
+
 void AddTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const
 {
+ if (cache.valid) {out = cache.value; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>()))
  {
   out = 0.0;
@@ -104,6 +148,8 @@ void AddTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const
 
 void AddTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::ColourRGB & out) const
 {
+ if (cache.valid) {out = cache.colour; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>()))
  {
   out = bs::ColourRGB(0.0,0.0,0.0);
@@ -118,6 +164,8 @@ void AddTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,const
 
 void AddTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Pnt & out) const
 {
+ if (cache.valid) {out = cache.offset; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>()))
  {
   out = bs::Pnt(0.0,0.0);
@@ -132,6 +180,8 @@ void AddTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir,const
 
 void AddTexture::GetVector(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Vert & out) const
 {
+ if (cache.valid) {out = cache.vector; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>()))
  {
   out = bs::Vert(0.0,0.0,0.0);
@@ -170,6 +220,7 @@ cstrconst MultTexture::ParaName(nat32 index) const
 
 void MultTexture::ParaSet(nat32 index,class Texture * rhs)
 {
+ cache.Reset();
  switch (index)
  {
   case 0: a = rhs; break;
@@ -187,8 +238,17 @@ bit MultTexture::Suports(TextureType t) const
  }
 }
 
+void MultTexture::Prepare()
+{
+ cache.Reset();
+ Texture * input[2] = {a,b};
+ if (PrepareInputs(2,input)) cache.Fill(*this);
+}
+
 void MultTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const
 {
+ if (cache.valid) {out = cache.value; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>()))
  {
   out = 0.0;
@@ -223,6 +283,8 @@ void MultTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const
 
 void MultTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::ColourRGB & out) const
 {
+ if (cache.valid) {out = cache.colour; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>()))
  {
   out = bs::ColourRGB(0.0,0.0,0.0);
@@ -237,11 +299,15 @@ void MultTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,cons
 
 void MultTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Pnt & out) const
 {
+ if (cache.valid) {out = cache.offset; return;}
+
  out = bs::Pnt(0.0,0.0);
 }
 
 void MultTexture::GetVector(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Vert & out) const
 {
+ if (cache.valid) {out = cache.vector; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>()))
  {
   out = bs::Vert(0.0,0.0,0.0);
@@ -286,6 +352,7 @@ cstrconst LinearMixTexture::ParaName(nat32 index) const
 
 void LinearMixTexture::ParaSet(nat32 index,class Texture * rhs)
 {
+ cache.Reset();
  switch (index)
  {
   case 0: a = rhs; break;
@@ -299,8 +366,17 @@ bit LinearMixTexture::Suports(TextureType t) const
  return type==t;
 }
 
+void LinearMixTexture::Prepare()
+{
+ cache.Reset();
+ Texture * input[3] = {a,b,mix};
+ if (PrepareInputs(3,input)) cache.Fill(*this);
+}
+
 void LinearMixTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const
 {
+ if (cache.valid) {out = cache.value; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>())||(mix==null<Texture*>()))
  {
   out = 0.0;
@@ -320,6 +396,8 @@ void LinearMixTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,
 
 void LinearMixTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::ColourRGB & out) const
 {
+ if (cache.valid) {out = cache.colour; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>())||(mix==null<Texture*>()))
  {
   out = bs::ColourRGB(0.0,0.0,0.0);
@@ -342,6 +420,8 @@ void LinearMixTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir
 
 void LinearMixTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Pnt & out) const
 {
+ if (cache.valid) {out = cache.offset; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>())||(mix==null<Texture*>()))
  {
   out = bs::Pnt(0.0,0.0);
@@ -364,6 +444,8 @@ void LinearMixTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir
 
 void LinearMixTexture::GetVector(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Vert & out) const
 {
+ if (cache.valid) {out = cache.vector; return;}
+
  if ((a==null<Texture*>())||(b==null<Texture*>())||(mix==null<Texture*>()))
  {
   out = bs::Vert(0.0,0.0,0.0);
@@ -411,6 +493,7 @@ cstrconst ToColourTexture::ParaName(nat32 index) const
 
 void ToColourTexture::ParaSet(nat32 index,class Texture * rhs)
 {
+ cache.Reset();
  switch (index)
  {
   case 0: r = rhs; break;
@@ -424,13 +507,24 @@ bit ToColourTexture::Suports(TextureType t) const
  return TextureColour==t;
 }
 
+void ToColourTexture::Prepare()
+{
+ cache.Reset();
+ Texture * input[3] = {r,g,b};
+ if (PrepareInputs(3,input)) cache.Fill(*this);
+}
+
 void ToColourTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const
 {
+ if (cache.valid) {out = cache.value; return;}
+
  out = 0.0;
 }
 
 void ToColourTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::ColourRGB & out) const
 {
+ if (cache.valid) {out = cache.colour; return;}
+
  if ((r==null<Texture*>())||(g==null<Texture*>())||(b==null<Texture*>()))
  {
   out = bs::ColourRGB(0.0,0.0,0.0);
@@ -444,11 +538,15 @@ void ToColourTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,
 
 void ToColourTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Pnt & out) const
 {
+ if (cache.valid) {out = cache.offset; return;}
+
  out = bs::Pnt(0.0,0.0);
 }
 
 void ToColourTexture::GetVector(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Vert & out) const
 {
+ if (cache.valid) {out = cache.vector; return;}
+
  out = bs::Vert(0.0,0.0,0.0);
 }
 
@@ -477,6 +575,7 @@ cstrconst FromColourTexture::ParaName(nat32 index) const
 
 void FromColourTexture::ParaSet(nat32 index,class Texture * rhs)
 {
+ cache.Reset();
  switch (index)
  {
   case 0: in = rhs; break;
@@ -488,8 +587,17 @@ bit FromColourTexture::Suports(TextureType t) const
  return TextureValue==t;
 }
 
+void FromColourTexture::Prepare()
+{
+ cache.Reset();
+ Texture * input[1] = {in};
+ if (PrepareInputs(1,input)) cache.Fill(*this);
+}
+
 void FromColourTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const
 {
+ if (cache.valid) {out = cache.value; return;}
+
  if (in==null<Texture*>())
  {
   out = 0.0;
@@ -515,16 +623,22 @@ void FromColourTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir
 
 void FromColourTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::ColourRGB & out) const
 {
+ if (cache.valid) {out = cache.colour; return;}
+
  out = bs::ColourRGB(0.0,0.0,0.0);
 }
 
 void FromColourTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Pnt & out) const
 {
+ if (cache.valid) {out = cache.offset; return;}
+
  out = bs::Pnt(0.0,0.0);
 }
 
 void FromColourTexture::GetVector(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Vert & out) const
 {
+ if (cache.valid) {out = cache.vector; return;}
+
  out = bs::Vert(0.0,0.0,0.0);
 }
 
@@ -559,6 +673,7 @@ cstrconst TransformTexture::ParaName(nat32 index) const
 
 void TransformTexture::ParaSet(nat32 index,class Texture * rhs)
 {
+ cache.Reset();
  switch (index)
  {
   case 0: in = rhs; break;
@@ -571,8 +686,17 @@ bit TransformTexture::Suports(TextureType t) const
                       else return in->Suports(t);
 }
 
+void TransformTexture::Prepare()
+{
+ cache.Reset();
+ Texture * input[1] = {in};
+ if (PrepareInputs(1,input)) cache.Fill(*this);
+}
+
 void TransformTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const
 {
+ if (cache.valid) {out = cache.value; return;}
+
  if (in==null<Texture*>())
  {
   out = 0.0;
@@ -588,6 +712,8 @@ void TransformTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,
 
 void TransformTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::ColourRGB & out) const
 {
+ if (cache.valid) {out = cache.colour; return;}
+
  if (in==null<Texture*>())
  {
   out = bs::ColourRGB(0.0,0.0,0.0);
@@ -603,6 +729,8 @@ void TransformTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir
 
 void TransformTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Pnt & out) const
 {
+ if (cache.valid) {out = cache.offset; return;}
+
  if (in==null<Texture*>())
  {
   out = bs::Pnt(0.0,0.0);
@@ -618,6 +746,8 @@ void TransformTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir
 
 void TransformTexture::GetVector(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Vert & out) const
 {
+ if (cache.valid) {out = cache.vector; return;}
+
  if (in==null<Texture*>())
  {
   out = bs::Vert(0.0,0.0,0.0);
@@ -665,6 +795,7 @@ cstrconst DistortionTexture::ParaName(nat32 index) const
 
 void DistortionTexture::ParaSet(nat32 index,class Texture * rhs)
 {
+ cache.Reset();
  switch (index)
  {
   case 0: in = rhs; break;
@@ -678,8 +809,19 @@ bit DistortionTexture::Suports(TextureType t) const
                       else return in->Suports(t);
 }
 
+void DistortionTexture::Prepare()
+{
+ // Only the input matters - a constant distorted is still constant...
+  cache.Reset();
+  if (distort) distort->Prepare();
+  Texture * input[1] = {in};
+  if (PrepareInputs(1,input)&&distort) cache.Fill(*this);
+}
+
 void DistortionTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const
 {
+ if (cache.valid) {out = cache.value; return;}
+
  if ((in==null<Texture*>())||(distort==null<Texture*>()))
  {
   out = 0.0;
@@ -721,6 +863,8 @@ void DistortionTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir
 
 void DistortionTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::ColourRGB & out) const
 {
+ if (cache.valid) {out = cache.colour; return;}
+
  if ((in==null<Texture*>())||(distort==null<Texture*>()))
  {
   out = bs::ColourRGB(0.0,0.0,0.0);
@@ -762,6 +906,8 @@ void DistortionTexture::GetColour(const TexCoord & coord,const bs::Normal & inDi
 
 void DistortionTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Pnt & out) const
 {
+ if (cache.valid) {out = cache.offset; return;}
+
  if ((in==null<Texture*>())||(distort==null<Texture*>()))
  {
   out = bs::Pnt(0.0,0.0);
@@ -803,6 +949,8 @@ void DistortionTexture::GetOffset(const TexCoord & coord,const bs::Normal & inDi
 
 void DistortionTexture::GetVector(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::Vert & out) const
 {
+ if (cache.valid) {out = cache.vector; return;}
+
  if ((in==null<Texture*>())||(distort==null<Texture*>()))
  {
   out = bs::Vert(0.0,0.0,0.0);
@@ -846,6 +994,158 @@ void DistortionTexture::GetVector(const TexCoord & coord,const bs::Normal & inDi
 
 
 
+//------------------------------------------------------------------------------
+// The bits of a 3 bit number spread out to every other bit, for the Morton
+// order within a tile...
+static const nat32 mortonSpread[8] = {0,1,4,5,16,17,20,21};
+
+ImageTexture::ImageTexture(const svt::Field<bs::ColourRGB> & image)
+:footprint(1.0)
+{
+ LogTime("eos::rend::ImageTexture::ImageTexture");
+
+ // Work out the levels and where each lives...
+  nat32 levels = 1;
+  nat32 w = math::Max(image.Size(0),nat32(1));
+  nat32 h = math::Max(image.Size(1),nat32(1));
+  while ((w>>(levels-1))>1 || (h>>(levels-1))>1) ++levels;
+  level.Size(levels);
+
+  nat32 total = 0;
+  for (nat32 l=0;l<levels;l++)
+  {
+   level[l].width = math::Max(w>>l,nat32(1));
+   level[l].height = math::Max(h>>l,nat32(1));
+   level[l].tilesX = (level[l].width + (1<<tileShift) - 1)>>tileShift;
+   nat32 tilesY = (level[l].height + (1<<tileShift) - 1)>>tileShift;
+   level[l].offset = total;
+   total += (level[l].tilesX*tilesY)<<(2*tileShift);
+  }
+  texel.Size(total);
+
+ // Level 0 is the image...
+  for (nat32 y=0;y<level[0].height;y++)
+  {
+   for (nat32 x=0;x<level[0].width;x++)
+   {
+    if ((x<image.Size(0))&&(y<image.Size(1))) Texel(level[0],x,y) = image.Get(x,y);
+                                          else Texel(level[0],x,y) = bs::ColourRGB(0.0,0.0,0.0);
+   }
+  }
+
+ // Each further level averages 2x2 blocks of the previous, the last row or
+ // column being dropped for odd sizes...
+  for (nat32 l=1;l<levels;l++)
+  {
+   const Level & from = level[l-1];
+   const Level & to = level[l];
+   for (nat32 y=0;y<to.height;y++)
+   {
+    nat32 y0 = math::Min(y*2,from.height-1);
+    nat32 y1 = math::Min(y*2+1,from.height-1);
+    for (nat32 x=0;x<to.width;x++)
+    {
+     nat32 x0 = math::Min(x*2,from.width-1);
+     nat32 x1 = math::Min(x*2+1,from.width-1);
+
+     bs::ColourRGB & out = Texel(to,x,y);
+     out = Texel(from,x0,y0);
+     out += Texel(from,x1,y0);
+     out += Texel(from,x0,y1);
+     out += Texel(from,x1,y1);
+     out *= 0.25;
+    }
+   }
+  }
+}
+
+ImageTexture::~ImageTexture()
+{}
+
+bit ImageTexture::Suports(TextureType t) const
+{
+ return (t==TextureValue)||(t==TextureColour);
+}
+
+void ImageTexture::GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const
+{
+ bs::ColourRGB col;
+ GetColour(coord,inDir,norm,col);
+ bs::ColourL lum = col;
+ out = lum.l;
+}
+
+void ImageTexture::GetColour(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::ColourRGB & out) const
+{
+ // Choose the level, as a real, from the footprint...
+  real32 cosAng = math::Abs(inDir*norm);
+  real32 size = footprint/math::Max(cosAng,real32(1.0/64.0));
+  real32 lod = (size>1.0)?math::Min(math::Log(size,real32(2.0)),real32(level.Size()-1)):0.0;
+
+  nat32 l0 = nat32(math::RoundDown(lod));
+  real32 t = lod - real32(l0);
+
+ // Trilinear, only sampling the second level if it contributes...
+  Sample(level[l0],coord[0],coord[1],out);
+  if ((t>0.0)&&(l0+1<level.Size()))
+  {
+   bs::ColourRGB other;
+   Sample(level[l0+1],coord[0],coord[1],other);
+   out *= 1.0-t;
+   other *= t;
+   out += other;
+  }
+}
+
+const bs::ColourRGB & ImageTexture::Texel(const Level & l,nat32 x,nat32 y) const
+{
+ static const nat32 mask = (1<<tileShift)-1;
+ nat32 tile = (y>>tileShift)*l.tilesX + (x>>tileShift);
+ return texel[l.offset + (tile<<(2*tileShift)) + (mortonSpread[x&mask] | (mortonSpread[y&mask]<<1))];
+}
+
+bs::ColourRGB & ImageTexture::Texel(const Level & l,nat32 x,nat32 y)
+{
+ static const nat32 mask = (1<<tileShift)-1;
+ nat32 tile = (y>>tileShift)*l.tilesX + (x>>tileShift);
+ return texel[l.offset + (tile<<(2*tileShift)) + (mortonSpread[x&mask] | (mortonSpread[y&mask]<<1))];
+}
+
+void ImageTexture::Sample(const Level & l,real32 u,real32 v,bs::ColourRGB & out) const
+{
+ // Texel centres are at half coordinates...
+  real32 fx = u*real32(l.width) - 0.5;
+  real32 fy = v*real32(l.height) - 0.5;
+  real32 bx = math::RoundDown(fx);
+  real32 by = math::RoundDown(fy);
+  real32 tx = fx - bx;
+  real32 ty = fy - by;
+
+  int32 ix = int32(bx) % int32(l.width);
+  int32 iy = int32(by) % int32(l.height);
+  if (ix<0) ix += l.width;
+  if (iy<0) iy += l.height;
+  nat32 x0 = ix;
+  nat32 y0 = iy;
+  nat32 x1 = (x0+1==l.width)?0:(x0+1);
+  nat32 y1 = (y0+1==l.height)?0:(y0+1);
+
+ // Blend...
+  bs::ColourRGB a = Texel(l,x0,y0);
+  a *= (1.0-tx)*(1.0-ty);
+  bs::ColourRGB b = Texel(l,x1,y0);
+  b *= tx*(1.0-ty);
+  bs::ColourRGB c = Texel(l,x0,y1);
+  c *= (1.0-tx)*ty;
+  bs::ColourRGB d = Texel(l,x1,y1);
+  d *= tx*ty;
+
+  out = a;
+  out += b;
+  out += c;
+  out += d;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -28,6 +28,42 @@ namespace eos
 {
  namespace rend
  {
+//------------------------------------------------------------------------------
+/// The constant outputs of a texture, used by the combinators to flatten
+/// themselves at Prepare() when all their inputs are constant, so a constant
+/// subtree costs one virtual call rather than one per node.
+class EOS_CLASS TextureCache
+{
+ public:
+  /// Starts invalid.
+   TextureCache():valid(false) {}
+
+
+  /// &nbsp;
+   void Reset() {valid = false;}
+
+  /// Calls the Get method of every type the texture suports, storing the
+  /// results, and makes itself valid. The texture should be constant, so the
+  /// coordinate passed doesn't matter.
+   void Fill(const Texture & tex);
+
+
+  /// &nbsp;
+   bit valid;
+
+  /// &nbsp;
+   real32 value;
+
+  /// &nbsp;
+   bs::ColourRGB colour;
+
+  /// &nbsp;
+   bs::Pnt offset;
+
+  /// &nbsp;
+   bs::Vert vector;
+};
+
 //------------------------------------------------------------------------------
 /// Represents a constant value, can only be one type at any given time but can 
 /// represent them all. You call the relevent Set method with the type you want,
@@ -58,6 +94,9 @@ class EOS_CLASS ConstantTexture : public Texture
   /// &nbsp;
    bit Suports(TextureType type) const;
 
+  /// Always true.
+   bit Constant() const {return true;}
+
 
   /// &nbsp;
    void GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const;
@@ -116,6 +155,12 @@ class EOS_CLASS AddTexture : public Texture
   /// &nbsp;
    bit Suports(TextureType type) const;
 
+  /// Prepares its inputs, making itself constant if they are.
+   void Prepare();
+
+  /// &nbsp;
+   bit Constant() const {return cache.valid;}
+
 
   /// &nbsp;
    void GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const;
@@ -138,6 +183,8 @@ class EOS_CLASS AddTexture : public Texture
   TextureType type;
   Texture * a;
   Texture * b;
+
+  TextureCache cache;
 };
 
 //------------------------------------------------------------------------------
@@ -173,6 +220,12 @@ class EOS_CLASS MultTexture : public Texture
   /// &nbsp;
    bit Suports(TextureType type) const;
 
+  /// Prepares its inputs, making itself constant if they are.
+   void Prepare();
+
+  /// &nbsp;
+   bit Constant() const {return cache.valid;}
+
 
   /// &nbsp;
    void GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const;
@@ -196,6 +249,8 @@ class EOS_CLASS MultTexture : public Texture
 
   Texture * a;
   Texture * b;
+
+  TextureCache cache;
 };
 
 //------------------------------------------------------------------------------
@@ -231,6 +286,12 @@ class EOS_CLASS LinearMixTexture : public Texture
   /// &nbsp;
    bit Suports(TextureType type) const;
 
+  /// Prepares its inputs, making itself constant if they are.
+   void Prepare();
+
+  /// &nbsp;
+   bit Constant() const {return cache.valid;}
+
 
   /// &nbsp;
    void GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const;
@@ -255,6 +316,8 @@ class EOS_CLASS LinearMixTexture : public Texture
   Texture * a;
   Texture * b;
   Texture * mix; 
+
+  TextureCache cache;
 };
 
 //------------------------------------------------------------------------------
@@ -287,6 +350,12 @@ class EOS_CLASS ToColourTexture : public Texture
   /// &nbsp;
    bit Suports(TextureType type) const;
 
+  /// Prepares its inputs, making itself constant if they are.
+   void Prepare();
+
+  /// &nbsp;
+   bit Constant() const {return cache.valid;}
+
 
   /// &nbsp;
    void GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const;
@@ -309,6 +378,8 @@ class EOS_CLASS ToColourTexture : public Texture
   Texture * r;
   Texture * g;
   Texture * b;  
+
+  TextureCache cache;
 };
 
 //------------------------------------------------------------------------------
@@ -353,6 +424,12 @@ class EOS_CLASS FromColourTexture : public Texture
   /// &nbsp;
    bit Suports(TextureType type) const;
 
+  /// Prepares its inputs, making itself constant if they are.
+   void Prepare();
+
+  /// &nbsp;
+   bit Constant() const {return cache.valid;}
+
 
   /// &nbsp;
    void GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const;
@@ -374,6 +451,8 @@ class EOS_CLASS FromColourTexture : public Texture
  private:
   Mode mode;
   Texture * in; 
+
+  TextureCache cache;
 };
 
 //------------------------------------------------------------------------------
@@ -415,6 +494,12 @@ class EOS_CLASS TransformTexture : public Texture
   /// &nbsp;
    bit Suports(TextureType type) const;
 
+  /// Prepares its inputs, making itself constant if they are.
+   void Prepare();
+
+  /// &nbsp;
+   bit Constant() const {return cache.valid;}
+
 
   /// &nbsp;
    void GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const;
@@ -436,6 +521,8 @@ class EOS_CLASS TransformTexture : public Texture
  private:
   math::Mat<4,4> matrix;
   Texture * in; 
+
+  TextureCache cache;
 };
 
 
@@ -470,6 +557,12 @@ class EOS_CLASS DistortionTexture : public Texture
   /// &nbsp;
    bit Suports(TextureType type) const;
 
+  /// Prepares its inputs, making itself constant if they are.
+   void Prepare();
+
+  /// &nbsp;
+   bit Constant() const {return cache.valid;}
+
 
   /// &nbsp;
    void GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const;
@@ -492,6 +585,8 @@ class EOS_CLASS DistortionTexture : public Texture
   TextureType dt; // Type of distortion texture.
   Texture * in;
   Texture * distort;
+
+  TextureCache cache;
 };
 
 //------------------------------------------------------------------------------
@@ -510,7 +605,77 @@ class EOS_CLASS DistortionTexture : public Texture
 // Raw noise.
 
 //------------------------------------------------------------------------------
-// From svt types.
+/// An image texture, from a svt field. Texture coordinates (0,0) to (1,1)
+/// cover the image once, u along x and v along y, repeating beyond. It stores
+/// a mip map, each level half the size of the last down to 1x1, and samples
+/// trilinearly, so minified images don't alias. Every level is stored in 8x8
+/// tiles with the texels of each tile in Morton order, so neighbouring lookups
+/// in any direction tend to share cache lines.
+///
+/// As textures are not given the pixel footprint the level is chosen from a
+/// user set footprint, the size of a sample in level 0 texels when looking
+/// straight at the surface, divided by the cosine between the view direction
+/// and the normal, so oblique surfaces use blurrier levels. Outputs colour,
+/// or luminance for value.
+class EOS_CLASS ImageTexture : public Texture
+{
+ public:
+  /// Copies the image, which must be 2D, and builds the mip map.
+   ImageTexture(const svt::Field<bs::ColourRGB> & image);
+
+  /// &nbsp;
+   ~ImageTexture();
+
+
+  /// Sets the footprint of a sample at normal incidence, in level 0 texels.
+  /// Defaults to 1, so head on the full resolution image is used.
+   void SetFootprint(real32 texels) {footprint = texels;}
+
+  /// &nbsp;
+   real32 GetFootprint() const {return footprint;}
+
+  /// Returns how many mip levels there are.
+   nat32 Levels() const {return level.Size();}
+
+
+  /// &nbsp;
+   bit Suports(TextureType type) const;
+
+
+  /// &nbsp;
+   void GetValue(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,real32 & out) const;
+
+  /// &nbsp;
+   void GetColour(const TexCoord & coord,const bs::Normal & inDir,const bs::Normal & norm,bs::ColourRGB & out) const;
+
+
+  /// &nbsp;
+   cstrconst TypeString() const {return "eos::rend::ImageTexture";}
+
+
+ private:
+  static const nat32 tileShift = 3; // Tiles are 8x8.
+
+  struct Level
+  {
+   nat32 width;
+   nat32 height;
+   nat32 tilesX; // Tiles per row.
+   nat32 offset; // Index of its first texel in texel.
+  };
+  ds::Array<Level> level;
+  ds::Array<bs::ColourRGB> texel;
+
+  real32 footprint;
+
+  // Returns a texel of a level, coordinates must be in range...
+   const bs::ColourRGB & Texel(const Level & l,nat32 x,nat32 y) const;
+   bs::ColourRGB & Texel(const Level & l,nat32 x,nat32 y);
+
+  // Bilinear sample of a level, with wrapping...
+   void Sample(const Level & l,real32 u,real32 v,bs::ColourRGB & out) const;
+};
+
 
 //------------------------------------------------------------------------------
  };
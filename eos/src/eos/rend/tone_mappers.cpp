@@ -17,77 +17,284 @@
 
 #include "eos/rend/tone_mappers.h"
 
+#include "eos/mt/tasks.h"
+#include "eos/ds/arrays.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 namespace eos
 {
  namespace rend
  {
 //------------------------------------------------------------------------------
-void ToneScaler::Apply(const RayImage & ri,svt::Field<bs::ColourRGB> & out,time::Progress * prog) const
+// Returns the weighted average of the rays assigned to a pixel, as the first
+// three lanes of an SSE register when avaliable. Pixels without weight come
+// out black...
+#ifdef __SSE__
+inline __m128 PixelMean(const RayImage & ri,nat32 x,nat32 y)
 {
- prog->Push();
+ __m128 ret = _mm_setzero_ps();
+ real32 ws = ri.RaysWeightSum(x,y);
+ if (ws<=0.0) return ret;
 
+ nat32 rays = ri.Rays(x,y);
+ for (nat32 i=0;i<rays;i++)
+ {
+  const TaggedRay & ray = ri.Ray(x,y,i);
+  __m128 col = _mm_setr_ps(ray.irradiance.r,ray.irradiance.g,ray.irradiance.b,0.0);
+  ret = _mm_add_ps(ret,_mm_mul_ps(col,_mm_set1_ps(ray.weight)));
+ }
+ return _mm_mul_ps(ret,_mm_set1_ps(1.0/ws));
+}
+#else
+inline bs::ColourRGB PixelMean(const RayImage & ri,nat32 x,nat32 y)
+{
+ bs::ColourRGB ret(0.0,0.0,0.0);
+ real32 ws = ri.RaysWeightSum(x,y);
+ if (ws<=0.0) return ret;
 
-  // First null the output...
-   prog->Report(0,4);
-   for (nat32 y=0;y<ri.Height();y++)
-   {
-    for (nat32 x=0;x<ri.Width();x++) out.Get(x,y) = bs::ColourRGB(0.0,0.0,0.0);
-   }
+ nat32 rays = ri.Rays(x,y);
+ for (nat32 i=0;i<rays;i++)
+ {
+  const TaggedRay & ray = ri.Ray(x,y,i);
+  bs::ColourRGB col = ray.irradiance;
+  col *= ray.weight;
+  ret += col;
+ }
+ ret *= 1.0/ws;
+ return ret;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// The accumulator for the statistics pass of ToneScaler, collects both the
+// sum and maximum so the mode only matters when the multiplier is made...
+class ToneStats
+{
+ public:
+  ToneStats():sum(0.0),max(0.0) {}
+
+  void Merge(const ToneStats & rhs)
+  {
+   sum += rhs.sum;
+   max = math::Max(max,rhs.max);
+  }
+
+  real64 sum; // Of the (r+g+b) values.
+  real32 max; // Of all components.
+};
 
+// Gathers the weighted average of each pixel for a range of rows, whilst
+// collecting the statistics. Writes to the field if given, otherwise to the
+// dense buffer...
+class ToneGatherRows
+{
+ public:
+  ToneGatherRows(const RayImage & r,svt::Field<bs::ColourRGB> * o,bs::ColourRGB * b)
+  :ri(r),out(o),buf(b)
+  {}
 
-  // Now sumate all the values from the ray image into the output, weighting 
-  // them according to ray counts and weights...
-   prog->Report(1,4);
-   for (nat32 y=0;y<ri.Height();y++)
+  void operator () (nat32 y0,nat32 y1,ToneStats & acc)
+  {
+   for (nat32 y=y0;y<y1;y++)
    {
+    real64 rowSum = 0.0;
+    #ifdef __SSE__
+     __m128 mx = _mm_setzero_ps();
+    #endif
     for (nat32 x=0;x<ri.Width();x++)
     {
-     real32 mult = 1.0/ri.RaysWeightSum(x,y);
-     for (nat32 i=0;i<ri.Rays(x,y);i++)
-     {
-      bs::ColourRGB col = ri.Ray(x,y,i).irradiance;
-      col *= ri.Ray(x,y,i).weight * mult;
-      out.Get(x,y) += col;
-     }
+     bs::ColourRGB & targ = out?out->Get(x,y):buf[y*ri.Width()+x];
+     #ifdef __SSE__
+      __m128 col = PixelMean(ri,x,y);
+      mx = _mm_max_ps(mx,col);
+      real32 temp[4];
+      _mm_storeu_ps(temp,col);
+      targ = bs::ColourRGB(temp[0],temp[1],temp[2]);
+     #else
+      targ = PixelMean(ri,x,y);
+      acc.max = math::Max(acc.max,targ.r,targ.g,targ.b);
+     #endif
+     rowSum += targ.r + targ.g + targ.b;
     }
+    #ifdef __SSE__
+     real32 temp[4];
+     _mm_storeu_ps(temp,mx);
+     acc.max = math::Max(acc.max,temp[0],temp[1],temp[2]);
+    #endif
+    acc.sum += rowSum;
    }
+  }
 
+ private:
+  const RayImage & ri;
+  svt::Field<bs::ColourRGB> * out;
+  bs::ColourRGB * buf;
+};
+
+// Multiplies a range of rows of the field by a constant, in place. When the
+// rows are dense it treats them as a flat array of floats...
+class ToneScaleRows
+{
+ public:
+  ToneScaleRows(svt::Field<bs::ColourRGB> & o,real32 m):out(o),mult(m) {}
 
-  // Now, depending on mode, calculate the multiplier...
-   prog->Report(2,4);
-   real32 mult;
-   if (meanM)
+  void operator () (nat32 y0,nat32 y1)
+  {
+   nat32 width = out.Size(0);
+   for (nat32 y=y0;y<y1;y++)
    {
-    real32 mean = 0.0;
-    for (nat32 y=0;y<ri.Height();y++)
-    {
-     for (nat32 x=0;x<ri.Width();x++) mean += (out.Get(x,y).r+out.Get(x,y).g+out.Get(x,y).b)/3.0;
-    }
-    mean /= real32(ri.Width()*ri.Height());
-    mult = 0.5/mean;
+    nat32 x = 0;
+    #ifdef __SSE__
+     if (out.Stride(0)==sizeof(bs::ColourRGB))
+     {
+      real32 * row = &out.Get(0,y).r;
+      nat32 n = width*3;
+      __m128 m = _mm_set1_ps(mult);
+      nat32 i = 0;
+      for (;i+4<=n;i+=4) _mm_storeu_ps(row+i,_mm_mul_ps(_mm_loadu_ps(row+i),m));
+      for (;i<n;i++) row[i] *= mult;
+      x = width;
+     }
+    #endif
+    for (;x<width;x++) out.Get(x,y) *= mult;
    }
-   else
+  }
+
+ private:
+  svt::Field<bs::ColourRGB> & out;
+  real32 mult;
+};
+
+// Scales, clamps and quantises a range of rows from a dense buffer into a byte
+// field, 4 pixels at a time with SSE, as 3 registers of interleaved
+// components...
+class ToneQuantRows
+{
+ public:
+  ToneQuantRows(const bs::ColourRGB * b,real32 m,svt::Field<bs::ColRGB> & o):buf(b),mult(m),out(o) {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   nat32 width = out.Size(0);
+   for (nat32 y=y0;y<y1;y++)
    {
-    real32 max = 0.0;
-    for (nat32 y=0;y<ri.Height();y++)
+    const bs::ColourRGB * row = buf + y*width;
+    nat32 x = 0;
+    #ifdef __SSE__
+     __m128 m = _mm_set1_ps(mult*255.0);
+     __m128 zero = _mm_setzero_ps();
+     __m128 top = _mm_set1_ps(255.0);
+     for (;x+4<=width;x+=4)
+     {
+      const real32 * in = &row[x].r;
+      real32 temp[12];
+      for (nat32 i=0;i<12;i+=4)
+      {
+       __m128 v = _mm_mul_ps(_mm_loadu_ps(in+i),m);
+       _mm_storeu_ps(temp+i,_mm_min_ps(_mm_max_ps(v,zero),top));
+      }
+      for (nat32 i=0;i<4;i++)
+      {
+       out.Get(x+i,y) = bs::ColRGB(byte(temp[i*3]),byte(temp[i*3+1]),byte(temp[i*3+2]));
+      }
+     }
+    #endif
+    for (;x<width;x++)
     {
-     for (nat32 x=0;x<ri.Width();x++) max = math::Max(max,out.Get(x,y).r,out.Get(x,y).g,out.Get(x,y).b);
+     out.Get(x,y) = bs::ColRGB(byte(math::Clamp<real32>(row[x].r*mult*255.0,0.0,255.0)),
+                               byte(math::Clamp<real32>(row[x].g*mult*255.0,0.0,255.0)),
+                               byte(math::Clamp<real32>(row[x].b*mult*255.0,0.0,255.0)));
     }
-    mult = 1.0/max;
    }
+  }
 
+ private:
+  const bs::ColourRGB * buf;
+  real32 mult;
+  svt::Field<bs::ColRGB> & out;
+};
 
-  // And finally apply the multiplier...
-   prog->Report(3,4);
-   for (nat32 y=0;y<ri.Height();y++)
-   {
-    for (nat32 x=0;x<ri.Width();x++) out.Get(x,y) *= mult;
-   }
-   
+//------------------------------------------------------------------------------
+void ToneScaler::Apply(const RayImage & ri,svt::Field<bs::ColourRGB> & out,time::Progress * prog) const
+{
+ LogTime("eos::rend::ToneScaler::Apply");
+ prog->Push();
+  // Gather the pixels and statistics in one pass...
+   prog->Report(0,2);
+   ToneGatherRows gather(ri,&out,null<bs::ColourRGB*>());
+   real64 sum = 0.0;
+   real32 max = 0.0;
+   Gather(ri,0,ri.Height(),gather,sum,max);
+   real32 mult = Multiplier(sum,max,ri.Width()*ri.Height());
+
+  // Scale them in a second...
+   prog->Report(1,2);
+   ToneScaleRows rows(out,mult);
+   mt::ParallelFor(nat32(0),ri.Height(),rows,16);
+ prog->Pop();
+}
 
+void ToneScaler::Apply(const RayImage & ri,svt::Field<bs::ColRGB> & out,time::Progress * prog) const
+{
+ LogTime("eos::rend::ToneScaler::Apply");
+ prog->Push();
+  // Gather the pixels and statistics into a temporary...
+   prog->Report(0,2);
+   ds::Array<bs::ColourRGB> buf(ri.Width()*ri.Height());
+   ToneGatherRows gather(ri,null<svt::Field<bs::ColourRGB>*>(),&buf[0]);
+   real64 sum = 0.0;
+   real32 max = 0.0;
+   Gather(ri,0,ri.Height(),gather,sum,max);
+   real32 mult = Multiplier(sum,max,ri.Width()*ri.Height());
+
+  // Quantise into the output...
+   prog->Report(1,2);
+   ToneQuantRows rows(&buf[0],mult,out);
+   mt::ParallelFor(nat32(0),ri.Height(),rows,16);
  prog->Pop();
 }
 
+void ToneScaler::Begin(svt::Field<bs::ColourRGB> & out)
+{
+ bandSum = 0.0;
+ bandMax = 0.0;
+}
+
+void ToneScaler::ApplyRows(const RayImage & ri,nat32 y0,nat32 y1,svt::Field<bs::ColourRGB> & out)
+{
+ ToneGatherRows gather(ri,&out,null<bs::ColourRGB*>());
+ Gather(ri,y0,y1,gather,bandSum,bandMax);
+}
+
+void ToneScaler::End(svt::Field<bs::ColourRGB> & out,time::Progress * prog)
+{
+ LogTime("eos::rend::ToneScaler::End");
+ real32 mult = Multiplier(bandSum,bandMax,out.Size(0)*out.Size(1));
+ ToneScaleRows rows(out,mult);
+ mt::ParallelFor(nat32(0),out.Size(1),rows,16);
+}
+
+void ToneScaler::Gather(const RayImage & ri,nat32 y0,nat32 y1,ToneGatherRows & gather,real64 & sum,real32 & max) const
+{
+ ToneStats stats;
+ mt::ParallelReduce(y0,y1,gather,ToneStats(),stats,16);
+ sum += stats.sum;
+ max = math::Max(max,stats.max);
+}
+
+real32 ToneScaler::Multiplier(real64 sum,real32 max,nat32 pixels) const
+{
+ if (meanM)
+ {
+  real64 mean = sum/(3.0*real64(pixels));
+  return 0.5/mean;
+ }
+ else return 1.0/max;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -36,12 +36,15 @@ namespace eos
 /// values to put them in range. Has two modes, in the first it makes the 
 /// largest irradiance value equate to 1 in the image, in the second it equates 
 /// the mean value in the image to the mean value of the irradiance values.
+/// The statistics needed for either mode are gathered in a single parallel
+/// pass, after which a second pass writes the scaled pixels, either as
+/// floating point or directly quantised to bytes.
 class EOS_CLASS ToneScaler : public ToneMapper
 {
  public:
   /// Set meanMode to true to equate means, otherwise it uses the simple 
   /// maximum to one model.
-   ToneScaler(bit meanMode = false):meanM(meanMode) {}
+   ToneScaler(bit meanMode = false):meanM(meanMode),bandSum(0.0),bandMax(0.0) {}
    
   /// &nbsp;
   ~ToneScaler() {} 
@@ -55,7 +58,26 @@ class EOS_CLASS ToneScaler : public ToneMapper
 
 
   /// &nbsp;
-   void Apply(const RayImage & ri,svt::Field<bs::ColourRGB> & out,time::Progress * prog) const;
+   void Apply(const RayImage & ri,svt::Field<bs::ColourRGB> & out,time::Progress * prog = null<time::Progress*>()) const;
+
+  /// As the other Apply, except the output is clamped to [0,1] and quantised
+  /// to bytes as its written, saving a seperate conversion pass when the
+  /// result is going straight into an 8 bit image.
+   void Apply(const RayImage & ri,svt::Field<bs::ColRGB> & out,time::Progress * prog = null<time::Progress*>()) const;
+
+
+  /// &nbsp;
+   bit Banded() const {return true;}
+
+  /// &nbsp;
+   void Begin(svt::Field<bs::ColourRGB> & out);
+
+  /// Writes the unscaled pixels of the band, collecting the statistics as it
+  /// goes, so End only has to apply the multiplier.
+   void ApplyRows(const RayImage & ri,nat32 y0,nat32 y1,svt::Field<bs::ColourRGB> & out);
+
+  /// &nbsp;
+   void End(svt::Field<bs::ColourRGB> & out,time::Progress * prog = null<time::Progress*>());
 
 
   /// &nbsp;
@@ -64,6 +86,17 @@ class EOS_CLASS ToneScaler : public ToneMapper
 
  private:
   bit meanM;
+
+  // Statistics collected over the bands so far...
+   real64 bandSum;
+   real32 bandMax;
+
+  // Runs the gathering and statistics pass over the given rows, adding to
+  // sum and max...
+   void Gather(const RayImage & ri,nat32 y0,nat32 y1,class ToneGatherRows & gather,real64 & sum,real32 & max) const;
+
+  // Returns the multiplier to apply, given the statistics...
+   real32 Multiplier(real64 sum,real32 max,nat32 pixels) const;
 };
 
 //------------------------------------------------------------------------------
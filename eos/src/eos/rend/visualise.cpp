@@ -18,46 +18,88 @@
 #include "eos/rend/visualise.h"
 
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 namespace eos
 {
  namespace rend
  {
 //------------------------------------------------------------------------------
-EOS_FUNC void VisNeedleMap(const svt::Field<bs::Normal> & in,svt::Field<bs::ColourRGB> & out,bit rev)
+// Does a range of rows for VisNeedleMap, 4 pixels at a time with SSE when
+// avaliable...
+class VisNeedleRows
 {
- for (nat32 y=0;y<in.Size(1);y++)
- {
-  for (nat32 x=0;x<in.Size(0);x++)
+ public:
+  VisNeedleRows(const svt::Field<bs::Normal> & i,svt::Field<bs::ColourRGB> & o,bit r)
+  :in(i),out(o),rev(r)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
   {
-   if (rev)
-   {
-    if (in.Get(x,y).Z()>0.0)
-    {
-     out.Get(x,y) = bs::ColourRGB(0.0,0.0,0.0);
-    }
-    else
-    {
-     out.Get(x,y).r = math::Clamp<real32>(0.5*(in.Get(x,y).X()+1.0),0.0,1.0);
-     out.Get(x,y).g = math::Clamp<real32>(0.5*(in.Get(x,y).Y()+1.0),0.0,1.0);
-     out.Get(x,y).b = math::Clamp<real32>(-in.Get(x,y).Z(),0.0,1.0);
-    }   
-   }
-   else
+   nat32 width = in.Size(0);
+   real32 zSign = rev?-1.0:1.0;
+   for (nat32 y=y0;y<y1;y++)
    {
-    if (in.Get(x,y).Z()<0.0)
-    {
-     out.Get(x,y) = bs::ColourRGB(0.0,0.0,0.0);
-    }
-    else
+    nat32 x = 0;
+    #ifdef __SSE__
+     __m128 zero = _mm_setzero_ps();
+     __m128 half = _mm_set1_ps(0.5);
+     __m128 one = _mm_set1_ps(1.0);
+     __m128 sign = _mm_set1_ps(zSign);
+     for (;x+4<=width;x+=4)
+     {
+      const bs::Normal & n0 = in.Get(x,y);
+      const bs::Normal & n1 = in.Get(x+1,y);
+      const bs::Normal & n2 = in.Get(x+2,y);
+      const bs::Normal & n3 = in.Get(x+3,y);
+
+      __m128 z = _mm_mul_ps(sign,_mm_setr_ps(n0[2],n1[2],n2[2],n3[2]));
+      __m128 front = _mm_cmpge_ps(z,zero); // Facing the viewer, otherwise black.
+
+      __m128 r = _mm_mul_ps(half,_mm_add_ps(_mm_setr_ps(n0[0],n1[0],n2[0],n3[0]),one));
+      __m128 g = _mm_mul_ps(half,_mm_add_ps(_mm_setr_ps(n0[1],n1[1],n2[1],n3[1]),one));
+      r = _mm_and_ps(front,_mm_min_ps(_mm_max_ps(r,zero),one));
+      g = _mm_and_ps(front,_mm_min_ps(_mm_max_ps(g,zero),one));
+      __m128 b = _mm_and_ps(front,_mm_min_ps(z,one));
+
+      real32 tr[4]; real32 tg[4]; real32 tb[4];
+      _mm_storeu_ps(tr,r);
+      _mm_storeu_ps(tg,g);
+      _mm_storeu_ps(tb,b);
+      for (nat32 i=0;i<4;i++) out.Get(x+i,y) = bs::ColourRGB(tr[i],tg[i],tb[i]);
+     }
+    #endif
+    for (;x<width;x++)
     {
-     out.Get(x,y).r = math::Clamp<real32>(0.5*(in.Get(x,y).X()+1.0),0.0,1.0);
-     out.Get(x,y).g = math::Clamp<real32>(0.5*(in.Get(x,y).Y()+1.0),0.0,1.0);
-     out.Get(x,y).b = math::Clamp<real32>(in.Get(x,y).Z(),0.0,1.0);
+     const bs::Normal & n = in.Get(x,y);
+     if (zSign*n.Z()<0.0)
+     {
+      out.Get(x,y) = bs::ColourRGB(0.0,0.0,0.0);
+     }
+     else
+     {
+      out.Get(x,y).r = math::Clamp<real32>(0.5*(n.X()+1.0),0.0,1.0);
+      out.Get(x,y).g = math::Clamp<real32>(0.5*(n.Y()+1.0),0.0,1.0);
+      out.Get(x,y).b = math::Clamp<real32>(zSign*n.Z(),0.0,1.0);
+     }
     }
    }
   }
- }
+
+ private:
+  const svt::Field<bs::Normal> & in;
+  svt::Field<bs::ColourRGB> & out;
+  bit rev;
+};
+
+EOS_FUNC void VisNeedleMap(const svt::Field<bs::Normal> & in,svt::Field<bs::ColourRGB> & out,bit rev)
+{
+ VisNeedleRows rows(in,out,rev);
+ mt::ParallelFor(nat32(0),in.Size(1),rows,16);
 }
 
 EOS_FUNC void NeedleMapToModel(const svt::Field<bs::Normal> & in,file::Wavefront & out)
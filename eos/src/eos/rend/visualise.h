@@ -40,6 +40,8 @@ namespace eos
 /// z==0 has no blue, a normal pointing directly at the viewer has 100% blue.
 /// rev allows you to reverse the direction of all needles, so you can save out
 /// two images containning all info when normals are no behaving.
+/// Rows are done in parallel on the thread pool, 4 pixels at a time with SSE
+/// when avaliable; pass svt::View's to only update a region.
 EOS_FUNC void VisNeedleMap(const svt::Field<bs::Normal> & in,svt::Field<bs::ColourRGB> & out,bit rev = false);
 
 /// Similar to VisNeedleMap, except this creates a 3D model of faces, on a plane,
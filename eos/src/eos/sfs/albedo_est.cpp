@@ -18,6 +18,7 @@
 #include "eos/sfs/albedo_est.h"
 
 #include "eos/ds/arrays.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -68,6 +69,312 @@ EOS_FUNC real32 AlbedoEstimate(const svt::Field<real32> & l,
   return samples[sampleCount/2];
 }
 
+//------------------------------------------------------------------------------
+SegAlbedoEstimate::SegAlbedoEstimate()
+:toLight(0.0,0.0,1.0),minL(0.0),maxL(math::Infinity<real32>())
+{}
+
+SegAlbedoEstimate::~SegAlbedoEstimate()
+{}
+
+void SegAlbedoEstimate::Set(const svt::Field<real32> & i)
+{
+ irr = i;
+}
+
+void SegAlbedoEstimate::Set(const svt::Field<bs::Normal> & n)
+{
+ needle = n;
+}
+
+void SegAlbedoEstimate::Set(const svt::Field<nat32> & s)
+{
+ seg = s;
+}
+
+void SegAlbedoEstimate::SetMask(const svt::Field<bit> & m)
+{
+ mask = m;
+}
+
+void SegAlbedoEstimate::SetLight(const bs::Normal & tl)
+{
+ toLight = tl;
+}
+
+void SegAlbedoEstimate::SetRange(real32 mi,real32 ma)
+{
+ minL = mi;
+ maxL = ma;
+}
+
+//------------------------------------------------------------------------------
+// Collects the estimates of a range of bands, each into its own part of the
+// arrays, noting how many it found and the largest segment index seen...
+class SegAlbedoEstimate::Collect
+{
+ public:
+  Collect(const SegAlbedoEstimate & s,nat32 bh,ds::Array<nat32> & so,ds::Array<Est> & e,
+          ds::Array<nat32> & bs,ds::Array<nat32> & bm)
+  :self(s),bandHeight(bh),segOf(so),est(e),bandSize(bs),bandMax(bm)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   nat32 width = self.seg.Size(0);
+   nat32 height = self.seg.Size(1);
+   for (nat32 b=b0;b<b1;b++)
+   {
+    nat32 pos = b*bandHeight*width;
+    nat32 & size = bandSize[b];
+    nat32 & max = bandMax[b];
+    size = 0;
+    max = 0;
+
+    nat32 yEnd = math::Min((b+1)*bandHeight,height);
+    for (nat32 y=b*bandHeight;y<yEnd;y++)
+    {
+     for (nat32 x=0;x<width;x++)
+     {
+      nat32 s = self.seg.Get(x,y);
+      max = math::Max(max,s);
+      
+      if (self.mask.Valid()&&(!self.mask.Get(x,y))) continue;
+      real32 l = self.irr.Get(x,y);
+      if ((l<=self.minL)||(l>=self.maxL)) continue;
+      real32 dot = self.needle.Get(x,y) * self.toLight;
+      if ((dot<=0.0)||math::IsZero(dot)) continue;
+
+      Est & targ = est[pos+size];
+      targ.estimate = l/dot;
+      targ.weight = dot;
+      if ((!math::IsFinite(targ.estimate))||(!math::IsFinite(targ.weight)))
+      {
+       targ.estimate = 0.0;
+       targ.weight = 0.0;
+      }
+      segOf[pos+size] = s;
+      ++size;
+     }
+    }
+   }
+  }
+
+
+ private:
+  const SegAlbedoEstimate & self;
+  nat32 bandHeight;
+  ds::Array<nat32> & segOf;
+  ds::Array<Est> & est;
+  ds::Array<nat32> & bandSize;
+  ds::Array<nat32> & bandMax;
+};
+
+//------------------------------------------------------------------------------
+// Counts how many estimates each band has for each segment...
+class SegAlbedoEstimate::Count
+{
+ public:
+  Count(nat32 bs,nat32 sc,const ds::Array<nat32> & so,const ds::Array<nat32> & bsz,ds::Array<nat32> & c)
+  :bandStride(bs),segCount(sc),segOf(so),bandSize(bsz),count(c)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 b=b0;b<b1;b++)
+   {
+    nat32 * targ = &count[b*segCount];
+    for (nat32 s=0;s<segCount;s++) targ[s] = 0;
+
+    nat32 pos = b*bandStride;
+    for (nat32 i=0;i<bandSize[b];i++) targ[segOf[pos+i]] += 1;
+   }
+  }
+
+
+ private:
+  nat32 bandStride;
+  nat32 segCount;
+  const ds::Array<nat32> & segOf;
+  const ds::Array<nat32> & bandSize;
+  ds::Array<nat32> & count;
+};
+
+//------------------------------------------------------------------------------
+// Scatters the estimates of each band into their place in the merged array,
+// given the offset of each band within each segment...
+class SegAlbedoEstimate::Scatter
+{
+ public:
+  Scatter(nat32 bs,nat32 sc,const ds::Array<nat32> & so,const ds::Array<Est> & e,
+          const ds::Array<nat32> & bsz,ds::Array<nat32> & off,ds::Array<Est> & m)
+  :bandStride(bs),segCount(sc),segOf(so),est(e),bandSize(bsz),offset(off),merged(m)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 b=b0;b<b1;b++)
+   {
+    nat32 * targ = &offset[b*segCount];
+    nat32 pos = b*bandStride;
+    for (nat32 i=0;i<bandSize[b];i++)
+    {
+     merged[targ[segOf[pos+i]]] = est[pos+i];
+     targ[segOf[pos+i]] += 1;
+    }
+   }
+  }
+
+
+ private:
+  nat32 bandStride;
+  nat32 segCount;
+  const ds::Array<nat32> & segOf;
+  const ds::Array<Est> & est;
+  const ds::Array<nat32> & bandSize;
+  ds::Array<nat32> & offset;
+  ds::Array<Est> & merged;
+};
+
+//------------------------------------------------------------------------------
+// Sorts the estimates of a range of segments and finds the weighted median and
+// mean of each...
+class SegAlbedoEstimate::Median
+{
+ public:
+  Median(SegAlbedoEstimate & s,const ds::Array<nat32> & ss,ds::Array<Est> & m)
+  :self(s),segStart(ss),merged(m)
+  {}
+
+  void operator () (nat32 s0,nat32 s1)
+  {
+   for (nat32 s=s0;s<s1;s++)
+   {
+    nat32 start = segStart[s];
+    nat32 end = segStart[s+1];
+    if (start==end)
+    {
+     self.albedo[s] = 0.0;
+     self.mean[s] = 0.0;
+     self.weight[s] = 0.0;
+     continue;
+    }
+
+    merged.SortRangeNorm(start,end-1);
+
+    real32 weightSum = 0.0;
+    real32 estSum = 0.0;
+    for (nat32 i=start;i<end;i++)
+    {
+     weightSum += merged[i].weight;
+     estSum += merged[i].weight * merged[i].estimate;
+    }
+    self.weight[s] = weightSum;
+    self.mean[s] = math::IsZero(weightSum)?0.0:(estSum/weightSum);
+
+    real32 half = weightSum/2.0;
+    nat32 targ = start;
+    real32 targWeight = merged[targ].weight;
+    while ((targWeight<half)&&(targ+1<end))
+    {
+     targ += 1;
+     targWeight += merged[targ].weight;
+    }
+
+    if (targ!=start)
+    {
+     real32 w = (half - targWeight + merged[targ].weight) / merged[targ].weight;
+     self.albedo[s] = (1.0-w)*merged[targ-1].estimate + w*merged[targ].estimate;
+    }
+    else self.albedo[s] = merged[targ].estimate;
+   }
+  }
+
+
+ private:
+  SegAlbedoEstimate & self;
+  const ds::Array<nat32> & segStart;
+  ds::Array<Est> & merged;
+};
+
+void SegAlbedoEstimate::Run(time::Progress * prog)
+{
+ LogBlock("eos::sfs::SegAlbedoEstimate::Run","-");
+ prog->Push();
+ 
+ nat32 width = seg.Size(0);
+ nat32 height = seg.Size(1);
+ static const nat32 bandHeight = 32;
+ nat32 bands = (height+bandHeight-1)/bandHeight;
+ nat32 bandStride = bandHeight*width;
+
+ // Read the image, collecting the estimates of each band...
+  prog->Report(0,3);
+  ds::Array<nat32> segOf(width*height);
+  ds::Array<Est> est(width*height);
+  ds::Array<nat32> bandSize(bands);
+  ds::Array<nat32> bandMax(bands);
+  {
+   Collect collect(*this,bandHeight,segOf,est,bandSize,bandMax);
+   mt::ParallelFor(nat32(0),bands,collect);
+  }
+  
+  nat32 segCount = 0;
+  for (nat32 b=0;b<bands;b++) segCount = math::Max(segCount,bandMax[b]+1);
+
+
+ // Count each band's estimates for each segment, and convert the counts to
+ // offsets into the merged array, ordered by segment then band so each
+ // segment gets its estimates in raster order...
+  prog->Report(1,3);
+  ds::Array<nat32> offset(bands*segCount);
+  {
+   Count count(bandStride,segCount,segOf,bandSize,offset);
+   mt::ParallelFor(nat32(0),bands,count);
+  }
+  
+  ds::Array<nat32> segStart(segCount+1);
+  nat32 total = 0;
+  for (nat32 s=0;s<segCount;s++)
+  {
+   segStart[s] = total;
+   for (nat32 b=0;b<bands;b++)
+   {
+    nat32 c = offset[b*segCount+s];
+    offset[b*segCount+s] = total;
+    total += c;
+   }
+  }
+  segStart[segCount] = total;
+  
+  ds::Array<Est> merged(total);
+  {
+   Scatter scatter(bandStride,segCount,segOf,est,bandSize,offset,merged);
+   mt::ParallelFor(nat32(0),bands,scatter);
+  }
+
+
+ // Sort each segment and extract its estimate...
+  prog->Report(2,3);
+  albedo.Size(segCount);
+  mean.Size(segCount);
+  weight.Size(segCount);
+  {
+   Median median(*this,segStart,merged);
+   mt::ParallelFor(nat32(0),segCount,median,16);
+  }
+ 
+ prog->Pop();
+}
+
+void SegAlbedoEstimate::GetAlbedo(svt::Field<real32> & out) const
+{
+ for (nat32 y=0;y<out.Size(1);y++)
+ {
+  for (nat32 x=0;x<out.Size(0);x++) out.Get(x,y) = albedo[seg.Get(x,y)];
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -24,6 +24,8 @@
 #include "eos/types.h"
 #include "eos/bs/geo3d.h"
 #include "eos/svt/field.h"
+#include "eos/ds/arrays.h"
+#include "eos/time/progress.h"
 
 namespace eos
 {
@@ -38,6 +40,108 @@ EOS_FUNC real32 AlbedoEstimate(const svt::Field<real32> & l,
                                const bs::Normal & toLight,
                                real32 minL = 0.1,real32 maxL = 0.9);
 
+//------------------------------------------------------------------------------
+/// Estimates an albedo for every segment of a segmentation at once, assuming
+/// each segment has constant albedo. Every usable pixel provides the estimate
+/// irradiance/(needle.toLight), weighted by the dot product, and each segment
+/// gets the weighted median of its estimates, for robustness, as well as the
+/// weighted mean.
+///
+/// The image is read once, in bands of rows on the task pool, with each band
+/// keeping its estimates and a per segment count. These are merged by
+/// scattering them into one array grouped by segment, which is then sorted a
+/// segment at a time, again on the task pool. The results are identical to
+/// doing it a segment at a time, but the cost is linear in the pixel count
+/// rather than multiplied by the segment count.
+class EOS_CLASS SegAlbedoEstimate
+{
+ public:
+  /// &nbsp;
+   SegAlbedoEstimate();
+
+  /// &nbsp;
+   ~SegAlbedoEstimate();
+
+
+  /// Sets the irradiance.
+   void Set(const svt::Field<real32> & irr);
+
+  /// Sets the surface orientation.
+   void Set(const svt::Field<bs::Normal> & needle);
+
+  /// Sets the segmentation.
+   void Set(const svt::Field<nat32> & seg);
+
+  /// Optionally sets a mask, only pixels where it is true are used.
+   void SetMask(const svt::Field<bit> & mask);
+
+  /// Sets the direction to the light source, must be normalised.
+   void SetLight(const bs::Normal & toLight);
+
+  /// Sets the exclusive irradiance range of usable pixels, defaults to
+  /// (0,infinity), so only black pixels are excluded.
+   void SetRange(real32 minL,real32 maxL);
+
+
+  /// Runs the estimation.
+   void Run(time::Progress * prog = null<time::Progress*>());
+
+
+  /// Returns how many segments there are, one more than the largest index in
+  /// the segmentation.
+   nat32 Segments() const {return albedo.Size();}
+
+  /// Returns the albedo of a segment, the weighted median, or 0 if it has no
+  /// usable pixels.
+   real32 Albedo(nat32 seg) const {return albedo[seg];}
+
+  /// Returns the weighted mean of the estimates of a segment, or 0 if it has
+  /// no usable pixels.
+   real32 Mean(nat32 seg) const {return mean[seg];}
+
+  /// Returns the total weight of the estimates of a segment, 0 if it has no
+  /// usable pixels.
+   real32 Weight(nat32 seg) const {return weight[seg];}
+
+  /// Outputs the albedo of every pixel, as given by its segment.
+   void GetAlbedo(svt::Field<real32> & out) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::sfs::SegAlbedoEstimate";}
+
+
+ private:
+  // Input...
+   svt::Field<real32> irr;
+   svt::Field<bs::Normal> needle;
+   svt::Field<nat32> seg;
+   svt::Field<bit> mask; // Optional.
+   bs::Normal toLight;
+   real32 minL;
+   real32 maxL;
+
+  // Output...
+   ds::Array<real32> albedo;
+   ds::Array<real32> mean;
+   ds::Array<real32> weight;
+
+  // An estimate from a single pixel...
+   struct Est
+   {
+    real32 estimate;
+    real32 weight;
+
+    bit operator < (const Est & rhs) const {return estimate < rhs.estimate;}
+   };
+
+  // The passes, functors for the task pool...
+   class Collect;
+   class Count;
+   class Scatter;
+   class Median;
+};
+
 //------------------------------------------------------------------------------
  };
 };
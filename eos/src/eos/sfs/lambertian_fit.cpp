@@ -18,6 +18,12 @@
 #include "eos/sfs/lambertian_fit.h"
 
 #include "eos/math/iter_min.h"
+#include "eos/ds/arrays2d.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE__
+ #include <xmmintrin.h>
+#endif
 
 namespace eos
 {
@@ -419,7 +425,8 @@ void LambertianEA::Mutate(void * orgV,data::Random & rand) const
 
 void LambertianEA::CalcFitness(const Organism * org) const
 {
- org->fitness = 0.0;
+ // Summed locally and only then stored, as Genetic evaluates in parallel...
+ real32 fitness = 0.0;
 
  for (nat32 i=0;i<ns->Segments();i++)
  {
@@ -440,9 +447,11 @@ void LambertianEA::CalcFitness(const Organism * org) const
    {
     real32 guess = a * math::Max((sa[j].dir * l),real32(0.0));
     real32 e = math::Abs(guess - sa[j].irr);
-    org->fitness += math::Max(sa[j].weight * (cutoff - e),real32(0.0));
+    fitness += math::Max(sa[j].weight * (cutoff - e),real32(0.0));
    }
  }
+ 
+ org->fitness = fitness;
 }
 
 //------------------------------------------------------------------------------
@@ -472,6 +481,155 @@ void LambertianRANSAC::Set(real32 cu,real32 ch,real32 l,nat32 ca)
  cap = ca;
 }
 
+real32 LambertianRANSAC::Packed::Score(nat32 seg,real32 albedo,const bs::Normal & light,real32 cutoff) const
+{
+ nat32 i = start[seg];
+ nat32 end = start[seg+1];
+
+ #ifdef __SSE__
+  __m128 sum = _mm_setzero_ps();
+  __m128 zero = _mm_setzero_ps();
+  __m128 alb = _mm_set1_ps(albedo);
+  __m128 lx = _mm_set1_ps(light[0]);
+  __m128 ly = _mm_set1_ps(light[1]);
+  __m128 lz = _mm_set1_ps(light[2]);
+  __m128 cut = _mm_set1_ps(cutoff);
+  for (;i<end;i+=4)
+  {
+   __m128 dot = _mm_mul_ps(_mm_loadu_ps(&dir[0][i]),lx);
+   dot = _mm_add_ps(dot,_mm_mul_ps(_mm_loadu_ps(&dir[1][i]),ly));
+   dot = _mm_add_ps(dot,_mm_mul_ps(_mm_loadu_ps(&dir[2][i]),lz));
+
+   __m128 e = _mm_sub_ps(_mm_mul_ps(alb,dot),_mm_loadu_ps(&irr[i]));
+   e = _mm_max_ps(e,_mm_sub_ps(zero,e));
+
+   sum = _mm_add_ps(sum,_mm_and_ps(_mm_cmplt_ps(e,cut),_mm_loadu_ps(&weight[i])));
+  }
+
+  real32 lane[4];
+  _mm_storeu_ps(lane,sum);
+  return (lane[0]+lane[1]) + (lane[2]+lane[3]);
+ #else
+  real32 ret = 0.0;
+  for (;i<end;i++)
+  {
+   real32 guess = albedo * (dir[0][i]*light[0] + dir[1][i]*light[1] + dir[2][i]*light[2]);
+   if (math::Abs(guess - irr[i])<cutoff) ret += weight[i];
+  }
+  return ret;
+ #endif
+}
+
+real32 LambertianRANSAC::Packed::Weight(nat32 seg) const
+{
+ nat32 i = start[seg];
+ nat32 end = start[seg+1];
+
+ #ifdef __SSE__
+  __m128 sum = _mm_setzero_ps();
+  for (;i<end;i+=4) sum = _mm_add_ps(sum,_mm_loadu_ps(&weight[i]));
+
+  real32 lane[4];
+  _mm_storeu_ps(lane,sum);
+  return (lane[0]+lane[1]) + (lane[2]+lane[3]);
+ #else
+  real32 ret = 0.0;
+  for (;i<end;i++) ret += weight[i];
+  return ret;
+ #endif
+}
+
+class LambertianRANSAC::ScoreBatch
+{
+ public:
+  ScoreBatch(const NeedleSeg & n,const Packed & p,real32 c,
+             const ds::Array<real32> & ss,
+             const ds::Array<real32> & tas,const ds::Array<real32> & tls,
+             const ds::Array<real32> & bas,const ds::Array<real32> & bls,
+             const ds::Array2D<real32> & a,const ds::Array2D<bs::Normal> & l,
+             ds::Array2D<real32> & as,ds::Array2D<real32> & ls,ds::Array<bit> & h)
+  :ns(n),packed(p),cutoff(c),segSize(ss),
+  topAlbedoScore(tas),topLightScore(tls),bestAlbedoScore(bas),bestLightScore(bls),
+  albedo(a),light(l),albedoScore(as),lightScore(ls),hopeless(h)
+  {}
+
+  void operator () (nat32 h0,nat32 h1)
+  {
+   ds::Array<real32> albedoLeft(albedo.Width());
+   ds::Array<real32> lightLeft(light.Width());
+
+   for (nat32 h=h0;h<h1;h++)
+   {
+    // Zero the scores, and count how many parts of the model could still beat
+    // the best so far. When none can we can stop early - as the best only
+    // ever gets better this stays true once the batch is merged in. The bound
+    // is given some slack so rounding can't cause a winner to be dropped...
+     nat32 alive = 0;
+     for (nat32 j=0;j<albedo.Width();j++)
+     {
+      albedoScore.Get(j,h) = 0.0;
+      albedoLeft[j] = topAlbedoScore[j];
+      if (Alive(0.0,albedoLeft[j],bestAlbedoScore[j],topAlbedoScore[j])) ++alive;
+     }
+
+     for (nat32 j=0;j<light.Width();j++)
+     {
+      lightScore.Get(j,h) = 0.0;
+      lightLeft[j] = topLightScore[j];
+      if (Alive(0.0,lightLeft[j],bestLightScore[j],topLightScore[j])) ++alive;
+     }
+
+
+    // Score each segment...
+     hopeless[h] = false;
+     for (nat32 j=0;j<ns.Segments();j++)
+     {
+      nat32 ag = ns.AlbedoGroup(j);
+      nat32 lg = ns.LightGroup(j);
+
+      bit albedoWas = Alive(albedoScore.Get(ag,h),albedoLeft[ag],bestAlbedoScore[ag],topAlbedoScore[ag]);
+      bit lightWas = Alive(lightScore.Get(lg,h),lightLeft[lg],bestLightScore[lg],topLightScore[lg]);
+
+      real32 score = packed.Score(j,albedo.Get(ag,h),light.Get(lg,h),cutoff);
+      albedoScore.Get(ag,h) += score;
+      lightScore.Get(lg,h) += score;
+      albedoLeft[ag] -= segSize[j];
+      lightLeft[lg] -= segSize[j];
+
+      if (albedoWas&&!Alive(albedoScore.Get(ag,h),albedoLeft[ag],bestAlbedoScore[ag],topAlbedoScore[ag])) --alive;
+      if (lightWas&&!Alive(lightScore.Get(lg,h),lightLeft[lg],bestLightScore[lg],topLightScore[lg])) --alive;
+
+      if (alive==0)
+      {
+       hopeless[h] = true;
+       break;
+      }
+     }
+   }
+  }
+
+
+ private:
+  const NeedleSeg & ns;
+  const Packed & packed;
+  real32 cutoff;
+  const ds::Array<real32> & segSize;
+  const ds::Array<real32> & topAlbedoScore;
+  const ds::Array<real32> & topLightScore;
+  const ds::Array<real32> & bestAlbedoScore;
+  const ds::Array<real32> & bestLightScore;
+  const ds::Array2D<real32> & albedo;
+  const ds::Array2D<bs::Normal> & light;
+  ds::Array2D<real32> & albedoScore;
+  ds::Array2D<real32> & lightScore;
+  ds::Array<bit> & hopeless;
+
+  static bit Alive(real32 score,real32 left,real32 best,real32 top)
+  {
+   return (score + left + 1e-4*top)>best;
+  }
+};
+
 void LambertianRANSAC::Run(time::Progress * prog)
 {
  LogTime("eos::sfs::LambertianRANSAC::Run");
@@ -487,6 +645,9 @@ void LambertianRANSAC::Run(time::Progress * prog)
  // The model is then split into lighting and material information. For each 
  // light one of the multiple lights generated this way is then selected with
  // even chance. Same again for the albedo.
+ // Models are generated a batch at a time, so the scoring, which is where the
+ // time goes, can be done in parallel - they are then taken in order, so the
+ // outcome is the same as going one at a time.
  
  // Build data structure to store the best model and its scores...
   // Albedos...
@@ -512,7 +673,45 @@ void LambertianRANSAC::Run(time::Progress * prog)
 
 
 
+ // Pack the samples for scoring...
+  Packed packed;
+  packed.start.Size(ns->Segments()+1);
+  packed.start[0] = 0;
+  for (nat32 i=0;i<ns->Segments();i++)
+  {
+   packed.start[i+1] = packed.start[i] + ((ns->Samples(i).Size()+3)/4)*4;
+  }
+
+  nat32 packedSize = packed.start[ns->Segments()];
+  packed.irr.Size(packedSize);
+  for (nat32 k=0;k<3;k++) packed.dir[k].Size(packedSize);
+  packed.weight.Size(packedSize);
+
+  for (nat32 i=0;i<ns->Segments();i++)
+  {
+   const ds::Array<IrrDir> & data = ns->Samples(i);
+   for (nat32 j=packed.start[i];j<packed.start[i+1];j++)
+   {
+    nat32 ind = j - packed.start[i];
+    if (ind<data.Size())
+    {
+     packed.irr[j] = data[ind].irr;
+     for (nat32 k=0;k<3;k++) packed.dir[k][j] = data[ind].dir[k];
+     packed.weight[j] = data[ind].weight;
+    }
+    else
+    {
+     packed.irr[j] = 0.0;
+     for (nat32 k=0;k<3;k++) packed.dir[k][j] = 0.0;
+     packed.weight[j] = 0.0;
+    }
+   }
+  }
+
+
+
  // Top scores for each albedo/light...
+  ds::Array<real32> segSize(ns->Segments());
   ds::Array<real32> topAlbedoScore(nsm->Albedos());
   ds::Array<real32> topLightScore(nsm->Lights());
 
@@ -521,12 +720,9 @@ void LambertianRANSAC::Run(time::Progress * prog)
 
   for (nat32 i=0;i<ns->Segments();i++)
   {
-   const ds::Array<IrrDir> & data = ns->Samples(i);
-   real32 size = 0.0;
-   for (nat32 j=0;j<data.Size();j++) size += data[j].weight;
-   
-   topAlbedoScore[ns->AlbedoGroup(i)] += size;
-   topLightScore[ns->LightGroup(i)] += size;
+   segSize[i] = packed.Weight(i);
+   topAlbedoScore[ns->AlbedoGroup(i)] += segSize[i];
+   topLightScore[ns->LightGroup(i)] += segSize[i];
   }
 
 
@@ -534,202 +730,202 @@ void LambertianRANSAC::Run(time::Progress * prog)
  // Same again, for currently generated model. Needs extra suport structures...
   // Albeos...
    ds::Array<real32> currAlbedo(nsm->Albedos());
-    ds::Array<real32> currAlbedoScore(nsm->Albedos());
     ds::Array<nat32> currAlbedoSegs(nsm->Albedos()); // Number of segs used, for random selection of seg.
 
   // Lights...
    ds::Array<bs::Normal> currLight(nsm->Lights());
-        ds::Array<real32> currLightScore(nsm->Lights());
-        ds::Array<nat32> currLightSegs(nsm->Albedos()); // Number of segs used, for random selection.
+        ds::Array<nat32> currLightSegs(nsm->Lights()); // Number of segs used, for random selection.
+
+  // The batch...
+   static const nat32 batchSize = 16;
+   ds::Array2D<real32> batchAlbedo(nsm->Albedos(),batchSize);
+   ds::Array2D<real32> batchAlbedoScore(nsm->Albedos(),batchSize);
+   ds::Array2D<bs::Normal> batchLight(nsm->Lights(),batchSize);
+   ds::Array2D<real32> batchLightScore(nsm->Lights(),batchSize);
+   ds::Array<bit> hopeless(batchSize);
+
+   ScoreBatch scorer(*ns,packed,cutoff,segSize,topAlbedoScore,topLightScore,
+                     bestAlbedoScore,bestLightScore,
+                     batchAlbedo,batchLight,batchAlbedoScore,batchLightScore,hopeless);
 
 
 
  // Iterate until all components say stop (There is a cap, just incase)...
-  for (nat32 i=0;i<cap;i++)
+  bit done = false;
+  for (nat32 b=0;(b<cap)&&(!done);b+=batchSize)
   {
-   // Generate a completly random model...
-    // Zero out the seg counters...
-     for (nat32 j=0;j<currAlbedoSegs.Size();j++) currAlbedoSegs[j] = 0;
-     for (nat32 j=0;j<currLightSegs.Size();j++) currLightSegs[j] = 0;
+   nat32 batch = math::Min(batchSize,cap-b);
+
+   // Generate the batch of completly random models...
+    for (nat32 h=0;h<batch;h++)
+    {
+     // Zero out the seg counters...
+      for (nat32 j=0;j<currAlbedoSegs.Size();j++) currAlbedoSegs[j] = 0;
+      for (nat32 j=0;j<currLightSegs.Size();j++) currLightSegs[j] = 0;
     
-    // Iterate all segments, for each segment calculate a random model, 
-    // then split it into light and albedo, before storing it, incrimentally,
-    // such that a random selection from avaliable segments is made for
-    // each light/albedo...
-     for (nat32 j=0;j<ns->Segments();j++)
-     {
-      // Find out if we are storing either light/albedo from this...
-       nat32 albedoGroup = ns->AlbedoGroup(j);
-       nat32 lightGroup = ns->LightGroup(j);
+     // Iterate all segments, for each segment calculate a random model, 
+     // then split it into light and albedo, before storing it, incrimentally,
+     // such that a random selection from avaliable segments is made for
+     // each light/albedo...
+      for (nat32 j=0;j<ns->Segments();j++)
+      {
+       // Find out if we are storing either light/albedo from this...
+        nat32 albedoGroup = ns->AlbedoGroup(j);
+        nat32 lightGroup = ns->LightGroup(j);
        
-       currAlbedoSegs[albedoGroup] += 1;
-       currLightSegs[lightGroup] += 1;
+        currAlbedoSegs[albedoGroup] += 1;
+        currLightSegs[lightGroup] += 1;
        
-       bit storeAlbedo = rand.Event(1.0/real64(currAlbedoSegs[albedoGroup]));
-       bit storeLight = rand.Event(1.0/real64(currLightSegs[lightGroup]));
-       if ((storeAlbedo==false)&&(storeLight==false)) continue;
+        bit storeAlbedo = rand.Event(1.0/real64(currAlbedoSegs[albedoGroup]));
+        bit storeLight = rand.Event(1.0/real64(currLightSegs[lightGroup]));
+        if ((storeAlbedo==false)&&(storeLight==false)) continue;
 
 
-      // Randomly select 3 components within the segment...
-      // (Without repetition - not hard to do as only 3 samples needed.)
-      // (Insane answers get zeroed.)
-       const ds::Array<IrrDir> & data = ns->Samples(j);
+       // Randomly select 3 components within the segment...
+       // (Without repetition - not hard to do as only 3 samples needed.)
+       // (Insane answers get zeroed.)
+        const ds::Array<IrrDir> & data = ns->Samples(j);
       
-       // Select 3 samples...
-        nat32 samp[3];
-        for (nat32 k=0;k<3;k++)
-        {
-         samp[k] = rand.Int(0,data.Size()-1-k);
-         for (nat32 l=0;l<k;l++)
+        // Select 3 samples...
+         nat32 samp[3];
+         for (nat32 k=0;k<3;k++)
          {
-          if (samp[k]>=samp[l]) samp[k] += 1;
+          samp[k] = rand.Int(0,data.Size()-1-k);
+          for (nat32 l=0;l<k;l++)
+          {
+           if (samp[k]>=samp[l]) samp[k] += 1;
+          }
          }
-        }
 
 
-       // Fit a model to the samples found - a simple linear method...
-        math::Mat<3,3> a;
-        bs::Normal mod;
-        for (nat32 k=0;k<3;k++)
-        {
-         for (nat32 l=0;l<3;l++) a[k][l] = data[samp[k]].dir[l];
-         mod[k] = data[samp[k]].irr;
+        // Fit a model to the samples found - a simple linear method...
+         math::Mat<3,3> a;
+         bs::Normal mod;
+         for (nat32 k=0;k<3;k++)
+         {
+          for (nat32 l=0;l<3;l++) a[k][l] = data[samp[k]].dir[l];
+          mod[k] = data[samp[k]].irr;
         
-          real32 dist = math::Sqrt(math::Sqr(a[k][0]) + 
-                                   math::Sqr(a[k][1]) + 
-                                   math::Sqr(a[k][2]) + 
-                                   math::Sqr(mod[k]));
-          real32 mult = data[samp[k]].weight/dist;
-          for (nat32 l=0;l<3;l++) a[k][l] *= mult;
-          mod[k] *= mult;
-         }
+           real32 dist = math::Sqrt(math::Sqr(a[k][0]) + 
+                                    math::Sqr(a[k][1]) + 
+                                    math::Sqr(a[k][2]) + 
+                                    math::Sqr(mod[k]));
+           real32 mult = data[samp[k]].weight/dist;
+           for (nat32 l=0;l<3;l++) a[k][l] *= mult;
+           mod[k] *= mult;
+          }
                 
-         math::SolveLinear(a,mod);
+          math::SolveLinear(a,mod);
 
        
-        // Check that all is numerically stable...
-         real32 albedo = mod.Length();
-         if (!math::IsFinite(albedo)) {mod = bs::Normal(0.0,0.0,0.0); albedo = 0.0;}
-         if (albedo>limit) {mod = bs::Normal(0.0,0.0,0.0); albedo = 0.0;}
-
-
-
-      // Store the relevant parts of the model...
-       if (storeAlbedo) currAlbedo[albedoGroup] = albedo;
-       
-       if (storeLight)
-       {
-        currLight[lightGroup] = mod;
-        if (!math::IsZero(albedo)) currLight[lightGroup] /= albedo;
-       }
-     }
-
+         // Check that all is numerically stable...
+          real32 albedo = mod.Length();
+          if (!math::IsFinite(albedo)) {mod = bs::Normal(0.0,0.0,0.0); albedo = 0.0;}
+          if (albedo>limit) {mod = bs::Normal(0.0,0.0,0.0); albedo = 0.0;}
 
 
-   // Zero each score...
-    for (nat32 j=0;j<currAlbedoScore.Size();j++) currAlbedoScore[j] = 0.0;
-    for (nat32 j=0;j<currLightScore.Size();j++) currLightScore[j] = 0.0;
 
-
-
-   // Score each segment,...
-    for (nat32 j=0;j<ns->Segments();j++)
-    {
-     // Get the segments assigned model...
-      nat32 albedoGroup = ns->AlbedoGroup(j);
-      nat32 lightGroup = ns->LightGroup(j);
+       // Store the relevant parts of the model...
+        if (storeAlbedo) currAlbedo[albedoGroup] = albedo;
        
-      bs::Normal light = currLight[lightGroup];
-      real32 albedo    = currAlbedo[albedoGroup];
+        if (storeLight)
+        {
+         currLight[lightGroup] = mod;
+         if (!math::IsZero(albedo)) currLight[lightGroup] /= albedo;
+        }
+      }
 
+     // Into the batch...
+      for (nat32 j=0;j<currAlbedo.Size();j++) batchAlbedo.Get(j,h) = currAlbedo[j];
+      for (nat32 j=0;j<currLight.Size();j++) batchLight.Get(j,h) = currLight[j];
+    }
 
-     // Measure the error of every contained sample, count those within tolerance...
-      real32 score = 0;
-      const ds::Array<IrrDir> & sa = ns->Samples(j);
-      for (nat32 k=0;k<sa.Size();k++)
-      {
-       real32 guess = albedo * (sa[k].dir * light);
-       real32 e = math::Abs(guess - sa[k].irr);
 
-       if (e<cutoff) score += sa[k].weight;
-      }
 
+   // Score the batch, in parallel...
+    mt::ParallelFor(nat32(0),batch,scorer);
 
-     // Add to relevant score totals...
-      currAlbedoScore[albedoGroup] += score;
-      currLightScore[lightGroup] += score;
-    }
 
 
+   // Go through the batch in order, merging each model in and checking for
+   // termination...
+    for (nat32 h=0;h<batch;h++)
+    {
+     nat32 i = b + h;
 
-   // Grab any better parts of the model and transfer into best...
-    // Albedo...
-     for (nat32 j=0;j<currAlbedo.Size();j++)
-     {
-      if (currAlbedoScore[j]>bestAlbedoScore[j])
+     // Grab any better parts of the model and transfer into best...
+     // (Skipped if its been found that nothing could be better.)
+      if (!hopeless[h])
       {
-       bestAlbedo[j] = currAlbedo[j];
-       bestAlbedoScore[j] = currAlbedoScore[j];
-      }
-     }
+       // Albedo...
+        for (nat32 j=0;j<bestAlbedo.Size();j++)
+        {
+         if (batchAlbedoScore.Get(j,h)>bestAlbedoScore[j])
+         {
+          bestAlbedo[j] = batchAlbedo.Get(j,h);
+          bestAlbedoScore[j] = batchAlbedoScore.Get(j,h);
+         }
+        }
 
-    // Lights...
-     for (nat32 j=0;j<currLight.Size();j++)
-     {
-      if (currLightScore[j]>bestLightScore[j])
-      {
-       bestLight[j] = currLight[j];
-       bestLightScore[j] = currLightScore[j];
+       // Lights...
+        for (nat32 j=0;j<bestLight.Size();j++)
+        {
+         if (batchLightScore.Get(j,h)>bestLightScore[j])
+         {
+          bestLight[j] = batchLight.Get(j,h);
+          bestLightScore[j] = batchLightScore.Get(j,h);
+         }
+        }
       }
-     }
 
 
 
-   // Break if all models have enough random samples, update progress bar...
-    real32 percentDone = 1.0;
-    bit done = true;
+     // Break if all models have enough random samples, update progress bar...
+      real32 percentDone = 1.0;
+      done = true;
   
-    for (nat32 j=0;j<bestAlbedo.Size();j++)
-    {
-     if (!math::IsZero(bestAlbedoScore[j]))
-     {
-      real32 ip = bestAlbedoScore[j]/topAlbedoScore[j];
-      real32 samplesNeeded = math::Ln(1.0-chance)/math::Ln(1.0-math::Pow(ip,real32(3.0)));
-      if (samplesNeeded>real32(i))
+      for (nat32 j=0;j<bestAlbedo.Size();j++)
       {
-       done = false;
-       percentDone *= real32(i)/samplesNeeded;
+       if (!math::IsZero(bestAlbedoScore[j]))
+       {
+        real32 ip = bestAlbedoScore[j]/topAlbedoScore[j];
+        real32 samplesNeeded = math::Ln(1.0-chance)/math::Ln(1.0-math::Pow(ip,real32(3.0)));
+        if (samplesNeeded>real32(i))
+        {
+         done = false;
+         percentDone *= real32(i)/samplesNeeded;
+        }
+       }
+       else
+       {
+        done = false;
+        percentDone = 0.0;
+       }     
       }
-     }
-     else
-     {
-      done = false;
-      percentDone = 0.0;
-     }     
-    }
     
-    for (nat32 j=0;j<bestLight.Size();j++)
-    {
-     if (!math::IsZero(bestLightScore[j]))
-     {
-      real32 ip = bestLightScore[j]/topLightScore[j];
-      real32 samplesNeeded = math::Ln(1.0-chance)/math::Ln(1.0-math::Pow(ip,real32(3.0)));
-      if (samplesNeeded>real32(i))
+      for (nat32 j=0;j<bestLight.Size();j++)
       {
-       done = false;
-       percentDone *= real32(i)/samplesNeeded;
+       if (!math::IsZero(bestLightScore[j]))
+       {
+        real32 ip = bestLightScore[j]/topLightScore[j];
+        real32 samplesNeeded = math::Ln(1.0-chance)/math::Ln(1.0-math::Pow(ip,real32(3.0)));
+        if (samplesNeeded>real32(i))
+        {
+         done = false;
+         percentDone *= real32(i)/samplesNeeded;
+        }
+       }
+       else
+       {
+        done = false;
+        percentDone = 0.0;
+       }
       }
-     }
-     else
-     {
-      done = false;
-      percentDone = 0.0;
-     }
-    }
     
-    if (done) break;
-    percentDone = math::Max(percentDone,real32(i)/real32(cap));
-    prog->Report(nat32(percentDone*1000.0),1000);
+      if (done) break;
+      percentDone = math::Max(percentDone,real32(i)/real32(cap));
+      prog->Report(nat32(percentDone*1000.0),1000);
+    }
   }
 
 
@@ -289,6 +289,9 @@ class EOS_CLASS LambertianEA : private alg::GeneticOrg
 //------------------------------------------------------------------------------
 /// This uses a RANSAC approach to estimate shading models for the
 /// system descibed by a NeedleSeg, outputting the result into a NeedleSegModel.
+/// Models are generated in batches, which are then scored at once using the
+/// task pool - the random sequence and the results are as if they were done
+/// one at a time.
 class EOS_CLASS LambertianRANSAC
 {
  public:
@@ -335,6 +338,26 @@ class EOS_CLASS LambertianRANSAC
 
   // Random number generator...
    data::Random rand;
+
+  // The samples of every segment rearranged for scoring, as a structure of
+  // arrays with each segment padded out to a multiple of 4 with zero weight
+  // samples, so they can be done 4 at a time...
+   struct Packed
+   {
+    ds::Array<nat32> start; // Segments+1 entries, offset of each segment.
+    ds::Array<real32> irr;
+    ds::Array<real32> dir[3];
+    ds::Array<real32> weight;
+
+    // Total weight of the samples of a segment within cutoff of the model...
+     real32 Score(nat32 seg,real32 albedo,const bs::Normal & light,real32 cutoff) const;
+
+    // Total weight of a segment, summed in the same order as Score...
+     real32 Weight(nat32 seg) const;
+   };
+
+  // Scores a batch of models at once, a functor for the task pool...
+   class ScoreBatch;
 };
 
 //------------------------------------------------------------------------------
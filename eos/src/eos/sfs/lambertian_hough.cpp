@@ -20,6 +20,7 @@
 #include "eos/alg/shapes.h"
 #include "eos/math/gaussian_mix.h"
 #include "eos/file/csv.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -88,6 +89,83 @@ void LamHough::Add(const svt::Field<real32> & irr,const svt::Field<bs::Normal> &
  }
 }
 
+class LamHough::Accumulate
+{
+ public:
+  Accumulate(const LamHough & s,const ds::Array<Sample> & d,const ds::Array<bs::Normal> & di,
+             const ds::Array<real32> & a,ds::Array2D<real32> & ac,int32 sd,real32 am)
+  :self(s),data(d),dir(di),albedo(a),acc(ac),sdSize(sd),albMult(am)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 i=0;i<data.Size();i++)
+    {
+     // Calculate the albedo for this direction...
+      real32 a = data[i].irr/(dir[y] * data[i].dir);
+    
+     // If the albedo is within the range collected continue...
+      if (math::IsFinite(a)&&(a>=self.minAlb)&&(a<=self.maxAlb))
+      {
+       // Iterate the range given by the standard deviation, calculating the 
+       // amount to add and summing it in...
+        int32 centre = int32(math::Round(albMult*(a-self.minAlb)));
+        int32 startX = math::Max(centre-sdSize,int32(0));
+        int32 endX   = math::Min(centre+sdSize,int32(acc.Width()-1));
+        for (int32 x=startX;x<=endX;x++)
+        {
+         acc.Get(x,y) += data[i].weight * math::UnNormGaussian(self.albSd,albedo[x]-a);
+        }
+      }
+    }
+   }
+  }
+
+
+ private:
+  const LamHough & self;
+  const ds::Array<Sample> & data;
+  const ds::Array<bs::Normal> & dir;
+  const ds::Array<real32> & albedo;
+  ds::Array2D<real32> & acc;
+  int32 sdSize;
+  real32 albMult;
+};
+
+class LamHough::Errors
+{
+ public:
+  Errors(const LamHough & s,const ds::Array<Sample> & d,ds::ArrayDel< ds::Array<ModError> > & m)
+  :self(s),data(d),me(m)
+  {}
+
+  void operator () (nat32 m0,nat32 m1)
+  {
+   for (nat32 s=0;s<data.Size();s++)
+   {
+    ds::Array<ModError> & mods = me[data[s].segment];
+    real32 maxErrWeighted = data[s].weight * self.maxErr;
+    real32 irrWeighted = data[s].weight * data[s].irr;
+    bs::Normal dirWeighted = data[s].dir; dirWeighted *= data[s].weight;
+
+    for (nat32 i=m0;i<m1;i++)
+    {
+     ModError & tme = mods[i];
+     real32 modIrr = dirWeighted*tme.modVec;
+     tme.error += math::Min(math::Abs(irrWeighted - modIrr),maxErrWeighted);
+    }
+   }
+  }
+
+
+ private:
+  const LamHough & self;
+  const ds::Array<Sample> & data;
+  ds::ArrayDel< ds::Array<ModError> > & me;
+};
+
 void LamHough::Run(time::Progress * prog)
 {
  LogBlock("eos::sfs::LamHough::Run","");
@@ -139,47 +217,16 @@ void LamHough::Run(time::Progress * prog)
  
  // Iterate all samples, sum them into the accumilator...
   prog->Report(1,6);
-  prog->Push();
-  for (nat32 i=0;i<data.Size();i++)
   {
    LogTime("eos::sfs::LamHough::Run sum");
-   prog->Report(i,data.Size());
-   for (nat32 y=0;y<acc.Height();y++)
-   {
-    // Calculate the albedo for this direction...
-     real32 a = data[i].irr/(dir[y] * data[i].dir);
-    
-    // If the albedo is within the range collected continue...
-     if (math::IsFinite(a)&&(a>=minAlb)&&(a<=maxAlb))
-     {
-      // Iterate the range given by the standard deviation, calculating the 
-      // amount to add and summing it in...
-       int32 centre = int32(math::Round(albMult*(a-minAlb)));
-       int32 startX = math::Max(centre-sdSize,int32(0));
-       int32 endX   = math::Min(centre+sdSize,int32(acc.Width()-1));
-       for (int32 x=startX;x<=endX;x++)
-       {
-        acc.Get(x,y) += data[i].weight * math::UnNormGaussian(albSd,albedo[x]-a);
-       }
-     }
-   }
+   Accumulate accumulate(*this,data,dir,albedo,acc,sdSize,albMult);
+   mt::ParallelFor(nat32(0),acc.Height(),accumulate,8);
   }
-  prog->Pop();
 
 
- // Find all maximas, requires building a suport data structure for speed...
+ // Find all maximas, the rows to check for each row being the neighbours of
+ // its vertex on the icosphere...
   prog->Report(2,6);
-  // Build a list of rows to check for each row, by row - an adjacency list...
-   ds::Array<nat32> adjCount(acc.Height());
-   ds::Array2D<nat32> adj(6,acc.Height()); // Can't be more than 6 adjacencies for each vertex.
-   for (nat32 i=0;i<adjCount.Size();i++) adjCount[i] = 0;
-   
-   for (nat32 i=0;i<ico.Edges();i++)
-   {
-    adj.Get(adjCount[ico.Edge(i)[0]],ico.Edge(i)[0]) = ico.Edge(i)[1]; ++adjCount[ico.Edge(i)[0]];
-    adj.Get(adjCount[ico.Edge(i)[1]],ico.Edge(i)[1]) = ico.Edge(i)[0]; ++adjCount[ico.Edge(i)[1]];
-   }
-
   // Iterate through every accumilator entry and check if its a maxima.
   // If so record it into a linked list...
   // (Omit extremities of albedo.)
@@ -193,9 +240,9 @@ void LamHough::Run(time::Progress * prog)
      if ((acc.Get(x,y)>acc.Get(x-1,y))&&(acc.Get(x,y)>acc.Get(x+1,y)))
      {
       bit bad = false;
-      for (nat32 i=0;i<adjCount[y];i++)
+      for (nat32 i=0;i<ico.Neighbours(y);i++)
       {
-       if (acc.Get(x,y)<=acc.Get(x,adj.Get(i,y)))
+       if (acc.Get(x,y)<=acc.Get(x,ico.Neighbour(y,i)))
        {
         bad = true;
         break;
@@ -243,26 +290,11 @@ void LamHough::Run(time::Progress * prog)
     }
    }
 
-   prog->Push();
-   for (nat32 s=0;s<data.Size();s++)
    {
     LogTime("eos::sfs::LamHough::Run weight");
-    prog->Report(s,data.Size());
-    
-    ds::Array<ModError> & mods = me[data[s].segment];
-    real32 maxErrWeighted = data[s].weight * maxErr;
-    real32 irrWeighted = data[s].weight * data[s].irr;
-    bs::Normal dirWeighted = data[s].dir; dirWeighted *= data[s].weight;
-
-    for (nat32 i=0;i<models.Size();i++)
-    {
-     ModError & tme = mods[i];
-     real32 modIrr = dirWeighted*tme.modVec;
-     tme.error += math::Min(math::Abs(irrWeighted - modIrr),maxErrWeighted);
-    }
+    Errors errors(*this,data,me);
+    mt::ParallelFor(nat32(0),models.Size(),errors,16);
    }
-   prog->Pop();
-
 
 
   // Go through the segments, sort the models by best, and score the top models
@@ -84,7 +84,7 @@ class EOS_CLASS LamHough
 
 
   /// Runs the algorithm, very fast really, you will probably spend comparable time
-  /// in the Add methods.
+  /// in the Add methods. Uses the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -148,6 +148,12 @@ class EOS_CLASS LamHough
     bit operator < (const ModError & rhs) const
     {return error < rhs.error;}
    };
+
+  // The two expensive loops of Run, functors for the task pool - the first is
+  // split by accumilator row, the second by model, so each output is still
+  // summed in sample order...
+   class Accumulate;
+   class Errors;
 };
 
 //------------------------------------------------------------------------------
@@ -27,7 +27,7 @@ namespace eos
 //------------------------------------------------------------------------------
 LambertianSeg::LambertianSeg()
 {
- mode = false;
+ mode = 0;
  refine = true;
 
  fp_ga.population = 100;
@@ -70,7 +70,7 @@ void LambertianSeg::Set(const svt::Field<bs::Normal> & n)
 
 void LambertianSeg::SetGA(nat32 p,nat32 k,nat32 i,real32 m,nat32 g,real32 a,real32 l,real32 c,real32 h)
 {
- mode = false;
+ mode = 0;
 
  fp_ga.population = p;
  fp_ga.keptBest = k;
@@ -86,7 +86,7 @@ void LambertianSeg::SetGA(nat32 p,nat32 k,nat32 i,real32 m,nat32 g,real32 a,real
 
 void LambertianSeg::SetRansac(real32 ch,real32 l,nat32 ca,real32 c,real32 h)
 {
- mode = true;
+ mode = 1;
  
  fp_rs.chance = ch;
  fp_rs.limit = l;
@@ -96,6 +96,11 @@ void LambertianSeg::SetRansac(real32 ch,real32 l,nat32 ca,real32 c,real32 h)
  fp_shared.halflife = h;
 }
 
+void LambertianSeg::SetLinear()
+{
+ mode = 2;
+}
+
 void LambertianSeg::Refine(bit r)
 {
  refine = r;
@@ -157,6 +162,9 @@ void LambertianSeg::Run(time::Progress * prog)
      segData[i] = new Node1();
      segData[i]->modelValid = false;
      segData[i]->samples.Size(segSize[i]);
+     math::Zero(segData[i]->dd);
+     for (nat32 j=0;j<3;j++) segData[i]->di[j] = 0.0;
+     segData[i]->ii = 0.0;
      segSize[i] = 0;
     }
     
@@ -170,6 +178,14 @@ void LambertianSeg::Run(time::Progress * prog)
       id.dir = needle.Get(x,y);
       id.weight = 1.0;
       segSize[s] += 1;
+
+      Node1 & n = *segData[s];
+      for (nat32 r=0;r<3;r++)
+      {
+       for (nat32 c=0;c<3;c++) n.dd[r][c] += id.weight * id.dir[r] * id.dir[c];
+       n.di[r] += id.weight * id.irr * id.dir[r];
+      }
+      n.ii += id.weight * math::Sqr(id.irr);
      }
     }
    
@@ -473,6 +489,53 @@ real32 LambertianSeg::ModelCost(const NeedleSeg & ns,const NeedleSegModel & nsm)
  return cost;
 }
 
+real32 LambertianSeg::LinearCost(const math::Mat<3,3,real64> & dd,const math::Vect<3,real64> & di,
+                                 real64 ii,bs::Normal & model) const
+{
+ // The Hessian of the negative log likelihood is dd/irrSd^2 - factorise it,
+ // with a little regularisation so regions with degenerate normals, such as
+ // single pixels, still get a model...
+  real64 invVar = 1.0/math::Sqr(irrSd);
+  real64 reg = 1e-6 * (dd[0][0] + dd[1][1] + dd[2][2] + 1.0);
+
+  math::Mat<3,3,real64> g;
+  for (nat32 r=0;r<3;r++)
+  {
+   for (nat32 c=0;c<3;c++) g[r][c] = dd[r][c];
+   g[r][r] += reg;
+  }
+  
+  if (!math::Cholesky(g))
+  {
+   model = bs::Normal(0.0,0.0,0.0);
+   return 0.5*ii*invVar + 3.0*freedomCost;
+  }
+
+
+ // Solve for the least squares model...
+  math::Vect<3,real64> m = di;
+  math::SolveLinearLowerTri(g,m);
+  math::Mat<3,3,real64> gt;
+  math::Transpose(g,gt);
+  math::SolveLinearUpperTri(gt,m);
+  
+  for (nat32 i=0;i<3;i++) model[i] = m[i];
+
+
+ // Residual, from the sufficient statistics alone...
+  real64 res = ii;
+  for (nat32 i=0;i<3;i++) res -= m[i]*di[i];
+  res = math::Max(res,real64(0.0));
+
+
+ // Sum the terms - fit, degrees of freedom and the log determinant of the
+ // Hessian over 2 pi, the later obtained from the Cholesky diagonal...
+  real64 cost = 0.5*res*invVar + 3.0*freedomCost;
+  for (nat32 i=0;i<3;i++) cost += math::Ln(g[i][i]) + 0.5*math::Ln(invVar/(2.0*math::pi));
+
+ return cost;
+}
+
 void LambertianSeg::Func(const math::Vector<real32> & pv,math::Vector<real32> & err,const Store & store)
 {
  // Extract the light source directions from the parameter vector...
@@ -504,9 +567,9 @@ void LambertianSeg::Func(const math::Vector<real32> & pv,math::Vector<real32> &
 
 //------------------------------------------------------------------------------
 LambertianSeg::GMI1::GMI1(LambertianSeg * s)
-:self(s),ns1(1),ns2(2),nsm(1,1)
+:self(s)
 {
- if (self->mode)
+ if (self->mode==1)
  {
   // Ransac...
    lf.SetRansac(self->fp_rs.chance,self->fp_rs.limit,self->fp_rs.cap,
@@ -530,21 +593,36 @@ real32 LambertianSeg::GMI1::Cost(const Deletable * a) const
 {
  LogTime("eos::sfs::LambertianSeg::GMI1::Cost(1)");
  const Node1 * na = static_cast<const Node1*>(a);
+
+ if (self->mode==2)
+ {
+  bs::Normal model;
+  real32 ret = self->LinearCost(na->dd,na->di,na->ii,model);
+  if (!na->modelValid)
+  {
+   na->model = model;
+   na->modelValid = true;
+  }
+  return ret;
+ }
  
- ns1.Set(0,0,0,na->samples);
+ NeedleSeg ns(1);
+ NeedleSegModel nsm(1,1);
+ ns.Set(0,0,0,na->samples);
 
  if (!na->modelValid)
  {
-  lf.Set(ns1);
-  lf.Set(nsm);
-  lf.Run();
+  LambertianFit fit = lf;
+  fit.Set(ns);
+  fit.Set(nsm);
+  fit.Run();
   
   na->model = nsm.Light(0);
   na->model *= nsm.Albedo(0);
   na->modelValid = true;
  }
  
- return self->ModelCost(ns1,nsm);
+ return self->ModelCost(ns,nsm);
 }
 
 real32 LambertianSeg::GMI1::Cost(const Deletable * a,const Deletable * b) const
@@ -553,14 +631,31 @@ real32 LambertianSeg::GMI1::Cost(const Deletable * a,const Deletable * b) const
  const Node1 * na = static_cast<const Node1*>(a);
  const Node1 * nb = static_cast<const Node1*>(b);
 
- ns2.Set(0,0,0,na->samples);
- ns2.Set(1,0,0,nb->samples);
+ if (self->mode==2)
+ {
+  math::Mat<3,3,real64> dd = na->dd;
+  math::Vect<3,real64> di = na->di;
+  for (nat32 r=0;r<3;r++)
+  {
+   for (nat32 c=0;c<3;c++) dd[r][c] += nb->dd[r][c];
+   di[r] += nb->di[r];
+  }
+
+  bs::Normal model;
+  return self->LinearCost(dd,di,na->ii + nb->ii,model);
+ }
+
+ NeedleSeg ns(2);
+ NeedleSegModel nsm(1,1);
+ ns.Set(0,0,0,na->samples);
+ ns.Set(1,0,0,nb->samples);
  
- lf.Set(ns2);
- lf.Set(nsm);
- lf.Run();
+ LambertianFit fit = lf;
+ fit.Set(ns);
+ fit.Set(nsm);
+ fit.Run();
 
- return self->ModelCost(ns2,nsm);
+ return self->ModelCost(ns,nsm);
 }
 
 Deletable * LambertianSeg::GMI1::Merge(const Deletable * a,const Deletable * b) const
@@ -571,6 +666,22 @@ Deletable * LambertianSeg::GMI1::Merge(const Deletable * a,const Deletable * b)
  
  // Make new node...
   Node1 * ret = new Node1();
+
+ // Sum the sufficient statistics...
+  for (nat32 r=0;r<3;r++)
+  {
+   for (nat32 c=0;c<3;c++) ret->dd[r][c] = na->dd[r][c] + nb->dd[r][c];
+   ret->di[r] = na->di[r] + nb->di[r];
+  }
+  ret->ii = na->ii + nb->ii;
+
+ // In linear mode that is all that is needed...
+  if (self->mode==2)
+  {
+   self->LinearCost(ret->dd,ret->di,ret->ii,ret->model);
+   ret->modelValid = true;
+   return ret;
+  }
   
  // Fill in samples...
   ret->samples.Size(na->samples.Size()+nb->samples.Size());
@@ -578,11 +689,14 @@ Deletable * LambertianSeg::GMI1::Merge(const Deletable * a,const Deletable * b)
   for (nat32 i=0;i<nb->samples.Size();i++) ret->samples[na->samples.Size() + i] = nb->samples[i];
 
  // Calculate and fill in model...
-  ns1.Set(0,0,0,ret->samples);
-
-  lf.Set(ns1);
-  lf.Set(nsm);
-  lf.Run();
+  NeedleSeg ns(1);
+  NeedleSegModel nsm(1,1);
+  ns.Set(0,0,0,ret->samples);
+
+  LambertianFit fit = lf;
+  fit.Set(ns);
+  fit.Set(nsm);
+  fit.Run();
   
   ret->model = nsm.Light(0);
   ret->model *= nsm.Albedo(0);
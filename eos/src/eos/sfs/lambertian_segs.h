@@ -37,6 +37,12 @@ namespace eos
 /// It then assigns a lambertian model to each segment, and merges segments with
 /// similar models to get super segments. Merges can be of just lighting or 
 /// albedo, rather than always being both at once.
+///
+/// Each region keeps the sufficient statistics of its samples for a linear
+/// least squares fit, which sum when regions merge. In linear mode the model
+/// fitting and comparison work from these alone, so costing a candidate merge
+/// is constant time regardless of region size - this is much faster than the
+/// robust modes, at the price of no outlier handling.
 class EOS_CLASS LambertianSeg
 {
  public:
@@ -66,6 +72,12 @@ class EOS_CLASS LambertianSeg
   /// This sets it into Ransac mode.
    void SetRansac(real32 chance,real32 limit,nat32 cap,
                   real32 cutoff,real32 halflife);
+
+  /// Sets it into linear mode, where the model of each region is its least
+  /// squares fit, with the negative log evidence given by the exact Gaussian
+  /// integral rather than the Laplace approximation. Cheap, as the pixels are
+  /// never revisited, but irrCap of SetMC is ignored and refinement is moot.
+   void SetLinear();
                                     
   /// Sets true to refine, false to not. (With regard to model fitting.) Defaults to true.
    void Refine(bit r);
@@ -104,7 +116,7 @@ class EOS_CLASS LambertianSeg
 
 
   // Fitter parameters...
-   bit mode; // false = ga, true = ransac.
+   nat32 mode; // 0 = ga, 1 = ransac, 2 = linear.
    bit refine;
    struct
    {
@@ -155,6 +167,11 @@ class EOS_CLASS LambertianSeg
   // Needless to say, this violates the laws of thermodynamics - it can make a 
   // headache pop into existance with it meer presence;-)
    real32 ModelCost(const NeedleSeg & ns,const NeedleSegModel & nsm) const;
+
+  // Equivalent of the above for linear mode, given the sufficient statistics
+  // of a region - fits the model, which is output, and returns its cost...
+   real32 LinearCost(const math::Mat<3,3,real64> & dd,const math::Vect<3,real64> & di,
+                     real64 ii,bs::Normal & model) const;
    
    
   // Helper structure for the below and above helper methods...
@@ -196,7 +213,12 @@ class EOS_CLASS LambertianSeg
      
       mutable bit modelValid;
       mutable bs::Normal model; // Only valid if modelValid.
-      ds::Array<IrrDir> samples;
+      ds::Array<IrrDir> samples; // Left empty after merges in linear mode.
+
+      // Sufficient statistics, weighted sums over the samples...
+       math::Mat<3,3,real64> dd; // Of dir dir^T.
+       math::Vect<3,real64> di; // Of irr dir.
+       real64 ii; // Of irr^2.
     };
    
    // The interface given to teh greedy merger...
@@ -213,11 +235,7 @@ class EOS_CLASS LambertianSeg
      private:
       LambertianSeg * self;
       
-      mutable LambertianFit lf;
-      
-      mutable NeedleSeg ns1;
-      mutable NeedleSeg ns2;
-      mutable NeedleSegModel nsm;
+      LambertianFit lf; // Configured but never run, copied by each call so they can be concurrent.
     };
     friend class GMI1;
 };
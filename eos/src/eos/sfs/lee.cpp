@@ -17,6 +17,8 @@
 
 #include "eos/sfs/lee.h"
 
+#include "eos/mt/tasks.h"
+
 namespace eos
 {
  namespace sfs
@@ -281,11 +283,408 @@ cstrconst Lee::TypeString() const
 }
 
 //------------------------------------------------------------------------------
+class Lee::PrepRows
+{
+ public:
+  PrepRows(Lee & s,ds::ArrayDel< ds::Array2D<Site> > & d,ds::Array2D<real32> & i,alg::Multigrid2D & m)
+  :self(s),data(d),irr(i),mg(m),stage(0),l(0),val(0.0)
+  {}
+
+  // Sets the stage to do, the level to do it to and a value it needs...
+   void Set(nat32 st,nat32 le,real32 v) {stage = st; l = le; val = v;}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    switch (stage)
+    {
+     case 0: Down(y); break;
+     case 1: Diffs(y); break;
+     case 2: FillA(y); break;
+     case 3: Smooth(y); break;
+     case 4: FillB(y); break;
+    }
+   }
+  }
+
+
+ private:
+  Lee & self;
+  ds::ArrayDel< ds::Array2D<Site> > & data;
+  ds::Array2D<real32> & irr;
+  alg::Multigrid2D & mg;
+
+  nat32 stage;
+  nat32 l;
+  real32 val;
+
+  // Calculates the depths of level l from level l-1.
+  void Down(nat32 y)
+  {
+   for (nat32 x=0;x<data[l].Width();x++)
+   {
+    nat32 twX = x*2;
+    nat32 twY = y*2;
+  
+    bit incX = (twX+1)<data[l-1].Width();
+    bit decX = twX>0;
+    bit incY = (twY+1)<data[l-1].Height();
+    bit decY = twY>0;
+    
+    real32 div = 0.25;
+    data[l].Get(x,y).z = 0.25 * data[l-1].Get(twX,twY).z;
+    
+    if (incX) {data[l].Get(x,y).z += 0.125 * data[l-1].Get(twX+1,twY).z; div += 0.125;}
+    if (decX) {data[l].Get(x,y).z += 0.125 * data[l-1].Get(twX-1,twY).z; div += 0.125;}
+    if (incY) {data[l].Get(x,y).z += 0.125 * data[l-1].Get(twX,twY+1).z; div += 0.125;}
+    if (decY) {data[l].Get(x,y).z += 0.125 * data[l-1].Get(twX,twY-1).z; div += 0.125;}
+   
+    if (incX&&incY) {data[l].Get(x,y).z += 0.0625 * data[l-1].Get(twX+1,twY+1).z; div += 0.0625;}
+    if (incX&&decY) {data[l].Get(x,y).z += 0.0625 * data[l-1].Get(twX+1,twY-1).z; div += 0.0625;}
+    if (decX&&incY) {data[l].Get(x,y).z += 0.0625 * data[l-1].Get(twX-1,twY+1).z; div += 0.0625;}
+    if (decX&&decY) {data[l].Get(x,y).z += 0.0625 * data[l-1].Get(twX-1,twY-1).z; div += 0.0625;}
+   
+    data[l].Get(x,y).z /= div;
+   }
+  }
+
+  // Calculates the differentials of level l, val being the level scale.
+  void Diffs(nat32 y)
+  {
+   real32 levelDiv = val;
+   for (nat32 x=0;x<data[l].Width();x++)
+   {
+    // Get safety information for the 4 directions...
+     bit xInc = (x+1)<data[l].Width();
+     bit xDec = x>0;
+     bit yInc = (y+1)<data[l].Height();
+     bit yDec = y>0;
+     
+    // Go through and calculate the value for each of the 6 triangles that use
+    // the node, where the triangles exist that is...  
+    // Aditionally, zero out differentials when the pixel is black, to indicate
+    // any solution is allowed.
+     // 0 - (x,y),(x-1,y),(x-1,y-1)...
+      if (xDec&&yDec&&(!math::IsZero(irr.Get(x-1,y-1))))
+      {
+       real32 p = (data[l].Get(x,y).z - data[l].Get(x-1,y).z) / levelDiv;
+       real32 q = (data[l].Get(x-1,y).z - data[l].Get(x-1,y-1).z) / levelDiv;
+       data[l].Get(x,y).dt[0] = self.RefDp(p,q);
+      }
+      else data[l].Get(x,y).dt[0] = 0.0;
+       
+     // 1 - (x,y),(x-1,y-1),(x,y-1)...
+      if (xDec&&yDec&&(!math::IsZero(irr.Get(x-1,y-1))))
+      {
+       real32 p = (data[l].Get(x,y-1).z - data[l].Get(x-1,y-1).z) / levelDiv;
+       real32 q = (data[l].Get(x,y).z - data[l].Get(x,y-1).z) / levelDiv;
+       data[l].Get(x,y).dt[1] = self.RefDq(p,q);
+      }
+      else data[l].Get(x,y).dt[1] = 0.0;
+       
+     // 2 - (x,y),(x,y-1),(x+1,y)...
+      if (xInc&&yDec&&(!math::IsZero(irr.Get(x,y-1))))
+      {
+       real32 p = (data[l].Get(x+1,y).z - data[l].Get(x,y).z) / levelDiv;
+       real32 q = (data[l].Get(x,y).z - data[l].Get(x,y-1).z) / levelDiv;
+       data[l].Get(x,y).dt[2] = self.RefDq(p,q) - self.RefDp(p,q);
+      }
+      else data[l].Get(x,y).dt[2] = 0.0;
+
+     // 3 - (x,y),(x+1,y),(x+1,y+1)...
+      if (xInc&&yInc&&(!math::IsZero(irr.Get(x,y))))
+      {
+       real32 p = (data[l].Get(x+1,y).z - data[l].Get(x,y).z) / levelDiv;
+       real32 q = (data[l].Get(x+1,y+1).z - data[l].Get(x+1,y).z) / levelDiv;
+       data[l].Get(x,y).dt[3] = -self.RefDp(p,q);
+      }
+      else data[l].Get(x,y).dt[3] = 0.0;
+       
+     // 4 - (x,y),(x+1,y+1),(x,y+1)...
+      if (xInc&&yInc&&(!math::IsZero(irr.Get(x,y))))
+      {
+       real32 p = (data[l].Get(x+1,y+1).z - data[l].Get(x,y+1).z) / levelDiv;
+       real32 q = (data[l].Get(x,y+1).z - data[l].Get(x,y).z) / levelDiv;
+       data[l].Get(x,y).dt[4] = -self.RefDq(p,q);
+      }
+      else data[l].Get(x,y).dt[4] = 0.0;
+
+     // 5 - (x,y),(x,y+1),(x-1,y)...
+      if (xDec&&yInc&&(!math::IsZero(irr.Get(x-1,y))))
+      {
+       real32 p = (data[l].Get(x,y).z - data[l].Get(x-1,y).z) / levelDiv;
+       real32 q = (data[l].Get(x,y+1).z - data[l].Get(x,y).z) / levelDiv;
+       data[l].Get(x,y).dt[5] = self.RefDp(p,q) - self.RefDq(p,q);
+      }
+      else data[l].Get(x,y).dt[5] = 0.0;
+   }
+  }
+
+  // Fills in the a values of level l from the differentials.
+  void FillA(nat32 y)
+  {
+   for (nat32 x=0;x<data[l].Width();x++)
+   {
+    // Get safety information...
+      bit xInc = (x+1)<data[l].Width();
+      bit xDec = x>0;
+      bit yInc = (y+1)<data[l].Height();
+      bit yDec = y>0;
+          
+    // Zero out the a so we can fill it in additavly...
+     mg.ZeroA(l,x,y);
+
+    // Entry zero, with offset (0,0), is nice and simple...
+    {
+     real32 temp = 0.0;
+     for (nat32 t=0;t<6;t++) temp += math::Sqr(data[l].Get(x,y).dt[t]);
+     if (math::IsZero(temp)) mg.SetA(l,x,y,0,1.0);
+                        else mg.SetA(l,x,y,0,2.0*temp);
+    }
+
+    // Do the other offsets by iterating the 6 vertices that share triangles
+    // with the target vertex...
+     // Vert 0...
+      if (xDec&&yDec)
+      {
+       real32 temp  = data[l].Get(x,y).dt[0] * data[l].Get(x-1,y-1).dt[4];
+              temp += data[l].Get(x,y).dt[1] * data[l].Get(x-1,y-1).dt[3];
+              temp *= 2.0;
+       mg.SetA(l,x,y,10,temp);
+      }
+      else mg.SetA(l,x,y,10,0.0);
+      
+     // Vert 1...
+      if (yDec)
+      {
+       real32 temp  = data[l].Get(x,y).dt[1] * data[l].Get(x,y-1).dt[5];
+              temp += data[l].Get(x,y).dt[2] * data[l].Get(x,y-1).dt[4];
+              temp *= 2.0;
+       mg.SetA(l,x,y,4,temp);
+      }
+      else mg.SetA(l,x,y,4,0.0);
+
+     // Vert 2...
+      if (xInc)
+      {
+       real32 temp  = data[l].Get(x,y).dt[2] * data[l].Get(x+1,y).dt[0];
+              temp += data[l].Get(x,y).dt[3] * data[l].Get(x+1,y).dt[5];
+              temp *= 2.0;
+       mg.SetA(l,x,y,1,temp);       
+      }
+      else mg.SetA(l,x,y,1,0.0);
+            
+     // Vert 3...
+      if (xInc&&yInc)
+      {
+       real32 temp  = data[l].Get(x,y).dt[3] * data[l].Get(x+1,y+1).dt[1];
+              temp += data[l].Get(x,y).dt[4] * data[l].Get(x+1,y+1).dt[0];
+              temp *= 2.0;
+       mg.SetA(l,x,y,6,temp);   
+      }
+      else mg.SetA(l,x,y,6,0.0);
+            
+     // Vert 4...
+      if (yInc)
+      {
+       real32 temp  = data[l].Get(x,y).dt[4] * data[l].Get(x,y+1).dt[2];
+              temp += data[l].Get(x,y).dt[5] * data[l].Get(x,y+1).dt[1];
+              temp *= 2.0;
+       mg.SetA(l,x,y,2,temp);   
+      }
+      else mg.SetA(l,x,y,2,0.0);
+            
+     // Vert 5...
+      if (xDec)
+      {
+       real32 temp  = data[l].Get(x,y).dt[5] * data[l].Get(x-1,y).dt[3];
+              temp += data[l].Get(x,y).dt[0] * data[l].Get(x-1,y).dt[2];
+              temp *= 2.0;
+       mg.SetA(l,x,y,3,temp);   
+      }
+      else mg.SetA(l,x,y,3,0.0);
+      
+      
+     // If the pixel is suitable log this info, so we can see it evolve...
+      /*if ((x==(data[l].Width()/3))&&(y==(data[l].Height()/3)))
+      {
+       LogDebug("{level,x,y}" << LogDiv() << l << LogDiv() << x << LogDiv() << y);
+       for (nat32 i=0;i<6;i++)
+       {
+        LogDebug("{tri,diff}" << LogDiv() << i << LogDiv() << data[l].Get(x,y).dt[i]);
+       }
+       LogDebug("{se,val}" << LogDiv() << 0 << LogDiv() << mg.GetA(l,x,y,0));
+       LogDebug("{se,val}" << LogDiv() << 1 << LogDiv() << mg.GetA(l,x,y,1));
+       LogDebug("{se,val}" << LogDiv() << 2 << LogDiv() << mg.GetA(l,x,y,2));
+       LogDebug("{se,val}" << LogDiv() << 3 << LogDiv() << mg.GetA(l,x,y,3));
+       LogDebug("{se,val}" << LogDiv() << 4 << LogDiv() << mg.GetA(l,x,y,4));
+       LogDebug("{se,val}" << LogDiv() << 6 << LogDiv() << mg.GetA(l,x,y,6));
+       LogDebug("{se,val}" << LogDiv() << 10 << LogDiv() << mg.GetA(l,x,y,10));
+      }*/
+   }
+  }
+
+  // Adds the smoothing term to the a values of level l, val being its multiplier.
+  void Smooth(nat32 y)
+  {
+   real32 mult = val;
+   for (nat32 x=0;x<data[l].Width();x++)
+   {
+    // Create a full smoothing stencil...
+     int32 s[13];
+                           s[11] =  1;
+               s[10] =  2; s[4]  = -8; s[12] =  2;
+     s[9] = 1; s[3]  = -8; s[0]  = 20; s[1]  = -8; s[5] = 1;
+               s[8]  =  2; s[2]  = -8; s[6]  =  2;
+                           s[7]  =  1;
+    
+    // Update the stencil with boundary constraints...
+     // Outer...
+      if (x<2) {s[9] = 0;  s[3] += 2;}
+      if (y<2) {s[11] = 0; s[4] += 2;}
+      if (x+2>=data[l].Width())  {s[5] = 0; s[1] += 2;}
+      if (y+2>=data[l].Height()) {s[7] = 0; s[2] += 2;}
+      
+     // Inner...
+      if (x<1) {s[1] += 2; s[2] += 2; s[4] += 2;}
+      if (y<1) {s[1] += 2; s[2] += 2; s[3] += 2;}
+      if (x+1>=data[l].Width()) {s[2] += 2; s[3] += 2; s[4] += 2;}
+      if (y+1>=data[l].Height()) {s[1] += 2; s[3] += 2; s[4] += 2;}
+      
+      if (x<1) {s[10] = 0; s[3] = 0; s[8] = 0;}
+      if (y<1) {s[10] = 0; s[4] = 0; s[12] = 0;}
+      if (x+1>=data[l].Width()) {s[12] = 0; s[1] = 0; s[6] = 0;}
+      if (y+1>=data[l].Height()) {s[8] = 0; s[2] = 0; s[6] = 0;}
+
+     // Correct the centre...
+      for (nat32 se=0;se<13;se++) s[0] -= s[se];
+    
+    // Add the entire stencil to the current stencil, noting that 
+    // out-of-bound entrys will be ignored...
+    // (Multiply in the lambda and scale adjustments.)
+     for (nat32 se=0;se<13;se++) mg.AddA(l,x,y,se,mult * s[se]);
+   }
+  }
+
+  // Fills in the b values of level 0.
+  void FillB(nat32 y)
+  {
+   // This converts face index to offset from node coordinate to get irr coordinate...
+    static const int32 faceToIrrX[6] = {-1,-1, 0, 0, 0,-1};
+    static const int32 faceToIrrY[6] = {-1,-1,-1, 0, 0, 0};
+   
+   // These indicate the offset and face number within the location indicated by
+   // the offset that match a face number at the current location.
+   // (2 vertices provided, the third you already have.)
+    /*static const int32 faceToOffsetXA[6] = {-1,-1, 0, 1, 1, 0};
+    static const int32 faceToOffsetYA[6] = { 0,-1,-1, 0, 1, 1};
+    static const nat32 faceToFaceA[6] = {2,3,4,5,0,1};
+   
+    static const int32 faceToOffsetXB[6] = {-1, 0, 1, 1, 0,-1};
+    static const int32 faceToOffsetYB[6] = {-1,-1, 0, 1, 1, 0};
+    static const nat32 faceToFaceB[6] = {4,5,0,1,2,3};*/
+
+   for (nat32 x=0;x<data[0].Width();x++)
+   {
+    real32 b = 0.0;
+    
+    /*if ((x==(data[0].Width()/3))&&(y==(data[0].Height()/3))) // ******************************
+    {
+     LogDebug("z(-1,-1),z(0,-1),z(1,-1)" << LogDiv() << data[0].Get(x-1,y-1).z 
+                                         << LogDiv() << data[0].Get(x,y-1).z
+                                         << LogDiv() << data[0].Get(x+1,y-1).z);
+     LogDebug("z(-1,0),z(0,0),z(1,0)" << LogDiv() << data[0].Get(x-1,y).z 
+                                      << LogDiv() << data[0].Get(x,y).z
+                                      << LogDiv() << data[0].Get(x+1,y).z);
+     LogDebug("z(-1,1),z(0,1),z(1,1)" << LogDiv() << data[0].Get(x-1,y+1).z 
+                                      << LogDiv() << data[0].Get(x,y+1).z
+                                      << LogDiv() << data[0].Get(x+1,y+1).z);
+    }*/
+                                             
+    // Go over all 6 faces that interact with this node and sum in there relevant affect...
+     for (nat32 f=0;f<6;f++)
+     {
+      if (!math::IsZero(data[0].Get(x,y).dt[f])) // Essentially boundary checking.
+      {
+       // Get the target irradiance...
+        real32 e = irr.Get(x+faceToIrrX[f],y+faceToIrrY[f]);
+          
+       // Subtract the current irradiance to get the required change...
+        real32 p = 0.0,q = 0.0;
+        switch (f)
+        {
+         case 0:
+          p = data[0].Get(x,y).z - data[0].Get(x-1,y).z;
+          q = data[0].Get(x-1,y).z - data[0].Get(x-1,y-1).z;
+         break;
+         case 1:
+          p = data[0].Get(x,y-1).z - data[0].Get(x-1,y-1).z;
+          q = data[0].Get(x,y).z - data[0].Get(x,y-1).z;
+         break;
+         case 2:
+          p = data[0].Get(x+1,y).z - data[0].Get(x,y).z;
+          q = data[0].Get(x,y).z - data[0].Get(x,y-1).z;
+         break;
+         case 3:
+          p = data[0].Get(x+1,y).z - data[0].Get(x,y).z;
+          q = data[0].Get(x+1,y+1).z - data[0].Get(x+1,y).z;
+         break;
+         case 4:
+          p = data[0].Get(x+1,y+1).z - data[0].Get(x,y+1).z;
+          q = data[0].Get(x,y+1).z - data[0].Get(x,y).z;
+         break;
+         case 5:
+          p = data[0].Get(x,y).z - data[0].Get(x-1,y).z;
+          q = data[0].Get(x,y+1).z - data[0].Get(x,y).z;
+         break;                                                       
+        }
+       e -= self.Ref(p,q);
+       
+       /*if ((x==(data[0].Width()/3))&&(y==(data[0].Height()/3))) // ******************************
+       {
+        LogDebug("irr err tri " << f << LogDiv() << e);
+       }*/
+         
+       // Add the affect of the current depth values, so the depth values
+       // remain absolute rather than relative to the previous iteration...
+        //e += data[0].Get(x,y).z *
+        //     data[0].Get(x,y).dt[f];
+        //e += data[0].Get(x+faceToOffsetXA[f],y+faceToOffsetYA[f]).z *
+        //     data[0].Get(x+faceToOffsetXA[f],y+faceToOffsetYA[f]).dt[faceToFaceA[f]];
+        //e += data[0].Get(x+faceToOffsetXB[f],y+faceToOffsetYB[f]).z *
+        //     data[0].Get(x+faceToOffsetXB[f],y+faceToOffsetYB[f]).dt[faceToFaceB[f]];
+        e += self.RefDp(p,q) * p;
+        e += self.RefDq(p,q) * q;
+        
+        
+         /*if ((x==(data[0].Width()/3))&&(y==(data[0].Height()/3))) // ******************************
+         {
+          LogDebug("B tri " << f << LogDiv() << (e * data[0].Get(x,y).dt[f]) << LogDiv() << e);
+         }*/
+        
+       // Add to sum...
+        b += e * data[0].Get(x,y).dt[f];
+      }
+     }
+     
+    // ********************************************************************************
+    /*if ((x==(data[0].Width()/3))&&(y==(data[0].Height()/3)))
+    {
+     LogDebug("B" << LogDiv() << b);
+    }*/
+     
+    mg.SetB(0,x,y,2.0 * b);
+   }
+  }
+};
+
 void Lee::PrepMultigrid(ds::ArrayDel< ds::Array2D<Site> > & data,ds::Array2D<real32> & irr,
                         alg::Multigrid2D & mg,real32 lambda,time::Progress * prog)
 {
  LogTime("eos::sfs::Lee::PrepMultigrid");
  prog->Push();
+ PrepRows rows(*this,data,irr,mg);
 
  // Extract from the multigrid depth maps for each level (Zero mean it to stop drift)...
   prog->Report(0,5);
@@ -307,37 +706,8 @@ void Lee::PrepMultigrid(ds::ArrayDel< ds::Array2D<Site> > & data,ds::Array2D<rea
    for (nat32 l=1;l<data.Size();l++)
    {
     prog->Report(l,data.Size());
-    prog->Push();
-    for (nat32 y=0;y<data[l].Height();y++)
-    {
-     prog->Report(y,data[l].Height());
-     for (nat32 x=0;x<data[l].Width();x++)
-     {
-      nat32 twX = x*2;
-      nat32 twY = y*2;
-    
-      bit incX = (twX+1)<data[l-1].Width();
-      bit decX = twX>0;
-      bit incY = (twY+1)<data[l-1].Height();
-      bit decY = twY>0;
-      
-      real32 div = 0.25;
-      data[l].Get(x,y).z = 0.25 * data[l-1].Get(twX,twY).z;
-      
-      if (incX) {data[l].Get(x,y).z += 0.125 * data[l-1].Get(twX+1,twY).z; div += 0.125;}
-      if (decX) {data[l].Get(x,y).z += 0.125 * data[l-1].Get(twX-1,twY).z; div += 0.125;}
-      if (incY) {data[l].Get(x,y).z += 0.125 * data[l-1].Get(twX,twY+1).z; div += 0.125;}
-      if (decY) {data[l].Get(x,y).z += 0.125 * data[l-1].Get(twX,twY-1).z; div += 0.125;}
-     
-      if (incX&&incY) {data[l].Get(x,y).z += 0.0625 * data[l-1].Get(twX+1,twY+1).z; div += 0.0625;}
-      if (incX&&decY) {data[l].Get(x,y).z += 0.0625 * data[l-1].Get(twX+1,twY-1).z; div += 0.0625;}
-      if (decX&&incY) {data[l].Get(x,y).z += 0.0625 * data[l-1].Get(twX-1,twY+1).z; div += 0.0625;}
-      if (decX&&decY) {data[l].Get(x,y).z += 0.0625 * data[l-1].Get(twX-1,twY-1).z; div += 0.0625;}
-     
-      data[l].Get(x,y).z /= div;
-     }
-    }
-    prog->Pop();
+    rows.Set(0,l,0.0);
+    mt::ParallelFor(nat32(0),data[l].Height(),rows,4);
    }
    prog->Pop();
 
@@ -348,79 +718,9 @@ void Lee::PrepMultigrid(ds::ArrayDel< ds::Array2D<Site> > & data,ds::Array2D<rea
   for (nat32 l=0;l<data.Size();l++)
   {
    prog->Report(l,data.Size());
-   prog->Push();
    real32 levelDiv = math::Pow<real32>(2,l);
-   for (nat32 y=0;y<data[l].Height();y++)
-   {
-    prog->Report(y,data[l].Height());
-    for (nat32 x=0;x<data[l].Width();x++)
-    {
-     // Get safety information for the 4 directions...
-      bit xInc = (x+1)<data[l].Width();
-      bit xDec = x>0;
-      bit yInc = (y+1)<data[l].Height();
-      bit yDec = y>0;
-      
-     // Go through and calculate the value for each of the 6 triangles that use
-     // the node, where the triangles exist that is...  
-     // Aditionally, zero out differentials when the pixel is black, to indicate
-     // any solution is allowed.
-      // 0 - (x,y),(x-1,y),(x-1,y-1)...
-       if (xDec&&yDec&&(!math::IsZero(irr.Get(x-1,y-1))))
-       {
-        real32 p = (data[l].Get(x,y).z - data[l].Get(x-1,y).z) / levelDiv;
-        real32 q = (data[l].Get(x-1,y).z - data[l].Get(x-1,y-1).z) / levelDiv;
-        data[l].Get(x,y).dt[0] = RefDp(p,q);
-       }
-       else data[l].Get(x,y).dt[0] = 0.0;
-        
-      // 1 - (x,y),(x-1,y-1),(x,y-1)...
-       if (xDec&&yDec&&(!math::IsZero(irr.Get(x-1,y-1))))
-       {
-        real32 p = (data[l].Get(x,y-1).z - data[l].Get(x-1,y-1).z) / levelDiv;
-        real32 q = (data[l].Get(x,y).z - data[l].Get(x,y-1).z) / levelDiv;
-        data[l].Get(x,y).dt[1] = RefDq(p,q);
-       }
-       else data[l].Get(x,y).dt[1] = 0.0;
-        
-      // 2 - (x,y),(x,y-1),(x+1,y)...
-       if (xInc&&yDec&&(!math::IsZero(irr.Get(x,y-1))))
-       {
-        real32 p = (data[l].Get(x+1,y).z - data[l].Get(x,y).z) / levelDiv;
-        real32 q = (data[l].Get(x,y).z - data[l].Get(x,y-1).z) / levelDiv;
-        data[l].Get(x,y).dt[2] = RefDq(p,q) - RefDp(p,q);
-       }
-       else data[l].Get(x,y).dt[2] = 0.0;
-
-      // 3 - (x,y),(x+1,y),(x+1,y+1)...
-       if (xInc&&yInc&&(!math::IsZero(irr.Get(x,y))))
-       {
-        real32 p = (data[l].Get(x+1,y).z - data[l].Get(x,y).z) / levelDiv;
-        real32 q = (data[l].Get(x+1,y+1).z - data[l].Get(x+1,y).z) / levelDiv;
-        data[l].Get(x,y).dt[3] = -RefDp(p,q);
-       }
-       else data[l].Get(x,y).dt[3] = 0.0;
-        
-      // 4 - (x,y),(x+1,y+1),(x,y+1)...
-       if (xInc&&yInc&&(!math::IsZero(irr.Get(x,y))))
-       {
-        real32 p = (data[l].Get(x+1,y+1).z - data[l].Get(x,y+1).z) / levelDiv;
-        real32 q = (data[l].Get(x,y+1).z - data[l].Get(x,y).z) / levelDiv;
-        data[l].Get(x,y).dt[4] = -RefDq(p,q);
-       }
-       else data[l].Get(x,y).dt[4] = 0.0;
-
-      // 5 - (x,y),(x,y+1),(x-1,y)...
-       if (xDec&&yInc&&(!math::IsZero(irr.Get(x-1,y))))
-       {
-        real32 p = (data[l].Get(x,y).z - data[l].Get(x-1,y).z) / levelDiv;
-        real32 q = (data[l].Get(x,y+1).z - data[l].Get(x,y).z) / levelDiv;
-        data[l].Get(x,y).dt[5] = RefDp(p,q) - RefDq(p,q);
-       }
-       else data[l].Get(x,y).dt[5] = 0.0;
-    }
-   }
-   prog->Pop();
+   rows.Set(1,l,levelDiv);
+   mt::ParallelFor(nat32(0),data[l].Height(),rows,4);
   }
   prog->Pop();
 
@@ -432,111 +732,8 @@ void Lee::PrepMultigrid(ds::ArrayDel< ds::Array2D<Site> > & data,ds::Array2D<rea
   for (nat32 l=0;l<data.Size();l++)
   {
    prog->Report(l,data.Size());
-   prog->Push();
-   for (nat32 y=0;y<data[l].Height();y++)
-   {
-    prog->Report(y,data[l].Height());
-    for (nat32 x=0;x<data[l].Width();x++)
-    {
-     // Get safety information...
-       bit xInc = (x+1)<data[l].Width();
-       bit xDec = x>0;
-       bit yInc = (y+1)<data[l].Height();
-       bit yDec = y>0;
-           
-     // Zero out the a so we can fill it in additavly...
-      mg.ZeroA(l,x,y);
-
-     // Entry zero, with offset (0,0), is nice and simple...
-     {
-      real32 temp = 0.0;
-      for (nat32 t=0;t<6;t++) temp += math::Sqr(data[l].Get(x,y).dt[t]);
-      if (math::IsZero(temp)) mg.SetA(l,x,y,0,1.0);
-                         else mg.SetA(l,x,y,0,2.0*temp);
-     }
-
-     // Do the other offsets by iterating the 6 vertices that share triangles
-     // with the target vertex...
-      // Vert 0...
-       if (xDec&&yDec)
-       {
-        real32 temp  = data[l].Get(x,y).dt[0] * data[l].Get(x-1,y-1).dt[4];
-               temp += data[l].Get(x,y).dt[1] * data[l].Get(x-1,y-1).dt[3];
-               temp *= 2.0;
-        mg.SetA(l,x,y,10,temp);
-       }
-       else mg.SetA(l,x,y,10,0.0);
-       
-      // Vert 1...
-       if (yDec)
-       {
-        real32 temp  = data[l].Get(x,y).dt[1] * data[l].Get(x,y-1).dt[5];
-               temp += data[l].Get(x,y).dt[2] * data[l].Get(x,y-1).dt[4];
-               temp *= 2.0;
-        mg.SetA(l,x,y,4,temp);
-       }
-       else mg.SetA(l,x,y,4,0.0);
-
-      // Vert 2...
-       if (xInc)
-       {
-        real32 temp  = data[l].Get(x,y).dt[2] * data[l].Get(x+1,y).dt[0];
-               temp += data[l].Get(x,y).dt[3] * data[l].Get(x+1,y).dt[5];
-               temp *= 2.0;
-        mg.SetA(l,x,y,1,temp);       
-       }
-       else mg.SetA(l,x,y,1,0.0);
-             
-      // Vert 3...
-       if (xInc&&yInc)
-       {
-        real32 temp  = data[l].Get(x,y).dt[3] * data[l].Get(x+1,y+1).dt[1];
-               temp += data[l].Get(x,y).dt[4] * data[l].Get(x+1,y+1).dt[0];
-               temp *= 2.0;
-        mg.SetA(l,x,y,6,temp);   
-       }
-       else mg.SetA(l,x,y,6,0.0);
-             
-      // Vert 4...
-       if (yInc)
-       {
-        real32 temp  = data[l].Get(x,y).dt[4] * data[l].Get(x,y+1).dt[2];
-               temp += data[l].Get(x,y).dt[5] * data[l].Get(x,y+1).dt[1];
-               temp *= 2.0;
-        mg.SetA(l,x,y,2,temp);   
-       }
-       else mg.SetA(l,x,y,2,0.0);
-             
-      // Vert 5...
-       if (xDec)
-       {
-        real32 temp  = data[l].Get(x,y).dt[5] * data[l].Get(x-1,y).dt[3];
-               temp += data[l].Get(x,y).dt[0] * data[l].Get(x-1,y).dt[2];
-               temp *= 2.0;
-        mg.SetA(l,x,y,3,temp);   
-       }
-       else mg.SetA(l,x,y,3,0.0);
-       
-       
-      // If the pixel is suitable log this info, so we can see it evolve...
-       /*if ((x==(data[l].Width()/3))&&(y==(data[l].Height()/3)))
-       {
-        LogDebug("{level,x,y}" << LogDiv() << l << LogDiv() << x << LogDiv() << y);
-        for (nat32 i=0;i<6;i++)
-        {
-         LogDebug("{tri,diff}" << LogDiv() << i << LogDiv() << data[l].Get(x,y).dt[i]);
-        }
-        LogDebug("{se,val}" << LogDiv() << 0 << LogDiv() << mg.GetA(l,x,y,0));
-        LogDebug("{se,val}" << LogDiv() << 1 << LogDiv() << mg.GetA(l,x,y,1));
-        LogDebug("{se,val}" << LogDiv() << 2 << LogDiv() << mg.GetA(l,x,y,2));
-        LogDebug("{se,val}" << LogDiv() << 3 << LogDiv() << mg.GetA(l,x,y,3));
-        LogDebug("{se,val}" << LogDiv() << 4 << LogDiv() << mg.GetA(l,x,y,4));
-        LogDebug("{se,val}" << LogDiv() << 6 << LogDiv() << mg.GetA(l,x,y,6));
-        LogDebug("{se,val}" << LogDiv() << 10 << LogDiv() << mg.GetA(l,x,y,10));
-       }*/
-    }
-   }
-   prog->Pop();
+   rows.Set(2,l,0.0);
+   mt::ParallelFor(nat32(0),data[l].Height(),rows,4);
   }
   prog->Pop();
 
@@ -547,50 +744,10 @@ void Lee::PrepMultigrid(ds::ArrayDel< ds::Array2D<Site> > & data,ds::Array2D<rea
   for (nat32 l=0;l<data.Size();l++)
   {
    prog->Report(l,data.Size());
-   prog->Push();
    real32 mult = lambda / math::Sqr(math::Pow(real32(2.0),real32(l)));
    //real32 mult = lambda / math::Sqr(l+1.0); // Wrong, taken from code.
-   for (nat32 y=0;y<data[l].Height();y++)
-   {
-    prog->Report(y,data[l].Height());
-    for (nat32 x=0;x<data[l].Width();x++)
-    {
-     // Create a full smoothing stencil...
-      int32 s[13];
-                            s[11] =  1;
-                s[10] =  2; s[4]  = -8; s[12] =  2;
-      s[9] = 1; s[3]  = -8; s[0]  = 20; s[1]  = -8; s[5] = 1;
-                s[8]  =  2; s[2]  = -8; s[6]  =  2;
-                            s[7]  =  1;
-     
-     // Update the stencil with boundary constraints...
-      // Outer...
-       if (x<2) {s[9] = 0;  s[3] += 2;}
-       if (y<2) {s[11] = 0; s[4] += 2;}
-       if (x+2>=data[l].Width())  {s[5] = 0; s[1] += 2;}
-       if (y+2>=data[l].Height()) {s[7] = 0; s[2] += 2;}
-       
-      // Inner...
-       if (x<1) {s[1] += 2; s[2] += 2; s[4] += 2;}
-       if (y<1) {s[1] += 2; s[2] += 2; s[3] += 2;}
-       if (x+1>=data[l].Width()) {s[2] += 2; s[3] += 2; s[4] += 2;}
-       if (y+1>=data[l].Height()) {s[1] += 2; s[3] += 2; s[4] += 2;}
-       
-       if (x<1) {s[10] = 0; s[3] = 0; s[8] = 0;}
-       if (y<1) {s[10] = 0; s[4] = 0; s[12] = 0;}
-       if (x+1>=data[l].Width()) {s[12] = 0; s[1] = 0; s[6] = 0;}
-       if (y+1>=data[l].Height()) {s[8] = 0; s[2] = 0; s[6] = 0;}
-
-      // Correct the centre...
-       for (nat32 se=0;se<13;se++) s[0] -= s[se];
-     
-     // Add the entire stencil to the current stencil, noting that 
-     // out-of-bound entrys will be ignored...
-     // (Multiply in the lambda and scale adjustments.)
-      for (nat32 se=0;se<13;se++) mg.AddA(l,x,y,se,mult * s[se]);
-    }
-   }
-   prog->Pop();
+   rows.Set(3,l,mult);
+   mt::ParallelFor(nat32(0),data[l].Height(),rows,4);
   }
   prog->Pop();
 
@@ -602,120 +759,9 @@ void Lee::PrepMultigrid(ds::ArrayDel< ds::Array2D<Site> > & data,ds::Array2D<rea
 
 
  // Fill in b for the first level of the multigrid only...
-  // This converts face index to offset from node coordinate to get irr coordinate...
-   static const int32 faceToIrrX[6] = {-1,-1, 0, 0, 0,-1};
-   static const int32 faceToIrrY[6] = {-1,-1,-1, 0, 0, 0};
-   
-  // These indicate the offset and face number within the location indicated by
-  // the offset that match a face number at the current location.
-  // (2 vertices provided, the third you already have.)
-   /*static const int32 faceToOffsetXA[6] = {-1,-1, 0, 1, 1, 0};
-   static const int32 faceToOffsetYA[6] = { 0,-1,-1, 0, 1, 1};
-   static const nat32 faceToFaceA[6] = {2,3,4,5,0,1};
-   
-   static const int32 faceToOffsetXB[6] = {-1, 0, 1, 1, 0,-1};
-   static const int32 faceToOffsetYB[6] = {-1,-1, 0, 1, 1, 0};
-   static const nat32 faceToFaceB[6] = {4,5,0,1,2,3};*/
-   
-  // Actual work...
-   prog->Report(4,5);
-   prog->Push();
-   for (nat32 y=0;y<data[0].Height();y++)
-   {
-    prog->Report(y,data[0].Height());
-    for (nat32 x=0;x<data[0].Width();x++)
-    {
-     real32 b = 0.0;
-     
-     /*if ((x==(data[0].Width()/3))&&(y==(data[0].Height()/3))) // ******************************
-     {
-      LogDebug("z(-1,-1),z(0,-1),z(1,-1)" << LogDiv() << data[0].Get(x-1,y-1).z 
-                                          << LogDiv() << data[0].Get(x,y-1).z
-                                          << LogDiv() << data[0].Get(x+1,y-1).z);
-      LogDebug("z(-1,0),z(0,0),z(1,0)" << LogDiv() << data[0].Get(x-1,y).z 
-                                       << LogDiv() << data[0].Get(x,y).z
-                                       << LogDiv() << data[0].Get(x+1,y).z);
-      LogDebug("z(-1,1),z(0,1),z(1,1)" << LogDiv() << data[0].Get(x-1,y+1).z 
-                                       << LogDiv() << data[0].Get(x,y+1).z
-                                       << LogDiv() << data[0].Get(x+1,y+1).z);
-     }*/
-                                              
-     // Go over all 6 faces that interact with this node and sum in there relevant affect...
-      for (nat32 f=0;f<6;f++)
-      {
-       if (!math::IsZero(data[0].Get(x,y).dt[f])) // Essentially boundary checking.
-       {
-        // Get the target irradiance...
-         real32 e = irr.Get(x+faceToIrrX[f],y+faceToIrrY[f]);
-           
-        // Subtract the current irradiance to get the required change...
-         real32 p = 0.0,q = 0.0;
-         switch (f)
-         {
-          case 0:
-           p = data[0].Get(x,y).z - data[0].Get(x-1,y).z;
-           q = data[0].Get(x-1,y).z - data[0].Get(x-1,y-1).z;
-          break;
-          case 1:
-           p = data[0].Get(x,y-1).z - data[0].Get(x-1,y-1).z;
-           q = data[0].Get(x,y).z - data[0].Get(x,y-1).z;
-          break;
-          case 2:
-           p = data[0].Get(x+1,y).z - data[0].Get(x,y).z;
-           q = data[0].Get(x,y).z - data[0].Get(x,y-1).z;
-          break;
-          case 3:
-           p = data[0].Get(x+1,y).z - data[0].Get(x,y).z;
-           q = data[0].Get(x+1,y+1).z - data[0].Get(x+1,y).z;
-          break;
-          case 4:
-           p = data[0].Get(x+1,y+1).z - data[0].Get(x,y+1).z;
-           q = data[0].Get(x,y+1).z - data[0].Get(x,y).z;
-          break;
-          case 5:
-           p = data[0].Get(x,y).z - data[0].Get(x-1,y).z;
-           q = data[0].Get(x,y+1).z - data[0].Get(x,y).z;
-          break;                                                       
-         }
-        e -= Ref(p,q);
-        
-        /*if ((x==(data[0].Width()/3))&&(y==(data[0].Height()/3))) // ******************************
-        {
-         LogDebug("irr err tri " << f << LogDiv() << e);
-        }*/
-          
-        // Add the affect of the current depth values, so the depth values
-        // remain absolute rather than relative to the previous iteration...
-         //e += data[0].Get(x,y).z *
-         //     data[0].Get(x,y).dt[f];
-         //e += data[0].Get(x+faceToOffsetXA[f],y+faceToOffsetYA[f]).z *
-         //     data[0].Get(x+faceToOffsetXA[f],y+faceToOffsetYA[f]).dt[faceToFaceA[f]];
-         //e += data[0].Get(x+faceToOffsetXB[f],y+faceToOffsetYB[f]).z *
-         //     data[0].Get(x+faceToOffsetXB[f],y+faceToOffsetYB[f]).dt[faceToFaceB[f]];
-         e += RefDp(p,q) * p;
-         e += RefDq(p,q) * q;
-         
-         
-          /*if ((x==(data[0].Width()/3))&&(y==(data[0].Height()/3))) // ******************************
-          {
-           LogDebug("B tri " << f << LogDiv() << (e * data[0].Get(x,y).dt[f]) << LogDiv() << e);
-          }*/
-         
-        // Add to sum...
-         b += e * data[0].Get(x,y).dt[f];
-       }
-      }
-      
-     // ********************************************************************************
-     /*if ((x==(data[0].Width()/3))&&(y==(data[0].Height()/3)))
-     {
-      LogDebug("B" << LogDiv() << b);
-     }*/
-      
-     mg.SetB(0,x,y,2.0 * b);
-    }
-   }
-   prog->Pop();
+  prog->Report(4,5);
+  rows.Set(4,0,0.0);
+  mt::ParallelFor(nat32(0),data[0].Height(),rows,4);
 
 
  prog->Pop();
@@ -70,7 +70,7 @@ class EOS_CLASS Lee
                  nat32 multiIters = 64,real32 tolerance = 0.001,real32 speed = 0.5);
 
 
-  /// Blah.
+  /// Blah. Uses the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -120,6 +120,10 @@ class EOS_CLASS Lee
    // (Data is a support data structure, passed in to avoid memory thrashing.)
     void PrepMultigrid(ds::ArrayDel< ds::Array2D<Site> > & data,ds::Array2D<real32> & irr,
                        alg::Multigrid2D & mg,real32 lambda,time::Progress * prog);
+
+   // Does the stages of PrepMultigrid for a range of rows, a functor for the
+   // task pool - every stage only writes to the row its given...
+    class PrepRows;
   
    // Calculates the irradiance given differentials of z. (Albedo is assumed as 1.)
     real32 Ref(real32 p,real32 q) // p=dz/dx, q=dz/dy
@@ -21,6 +21,7 @@
 #include "eos/filter/grad_walk.h"
 #include "eos/filter/kernel.h"
 #include "eos/inf/bin_bp_2d.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -165,6 +166,82 @@ void SfS_BP::DisableNorms()
  doML = false;
 }
 
+class SfS_BP::PassRows
+{
+ public:
+  PassRows(ds::Array2D<MsgSet> & l,nat32 p):level(l),parity(p) {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=(parity+y)%2;x<level.Width();x+=2)
+    {
+     // Each message is the product of the data term and the messages from
+     // the other three directions - as the directions are done in order the
+     // product of those before can be built up as we go...
+      MsgSet & ms = level.Get(x,y);
+      math::FisherBingham before = ms.data;
+      for (nat32 d=0;d<4;d++)
+      {
+       if (ms.send[d]>0.0)
+       {
+        // Calculate the coordinates of the neighbour...
+         int32 ox = x;
+         int32 oy = y;
+         switch (d)
+         {
+          case 0: ++ox; break;
+          case 1: ++oy; break;
+          case 2: --ox; break;
+          case 3: --oy; break;
+         }
+
+        // Calculate the message...
+         math::FisherBingham msg = before;
+         for (nat32 i=d+1;i<4;i++) msg *= ms.in[i];
+         msg.Convolve(ms.send[d]);
+
+        // Send, which is safe as the neighbour is the other colour, so its
+        // messages are not being read...
+         level.Get(ox,oy).in[(d+2)%4] = msg;
+       }
+       before *= ms.in[d];
+      }
+    }
+   }
+  }
+
+
+ private:
+  ds::Array2D<MsgSet> & level;
+  nat32 parity;
+};
+
+class SfS_BP::Beliefs
+{
+ public:
+  Beliefs(SfS_BP & s,ds::Array2D<MsgSet> & l):self(s),level(l) {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=0;x<self.dist.Width();x++)
+    {
+     self.dist.Get(x,y) = level.Get(x,y).data;
+     for (nat32 d=0;d<4;d++) self.dist.Get(x,y) *= level.Get(x,y).in[d];
+     if (self.doML) self.dist.Get(x,y).Maximum(self.distMax.Get(x,y));
+    }
+   }
+  }
+
+
+ private:
+  SfS_BP & self;
+  ds::Array2D<MsgSet> & level;
+};
+
 void SfS_BP::Run(time::Progress * prog)
 {
  prog->Push();
@@ -315,47 +392,8 @@ void SfS_BP::Run(time::Progress * prog)
     for (nat32 it=0;it<iters;it++)
     {
      prog->Report(it,iters);
-     prog->Push();
-     for (nat32 y=0;y<level[l].Height();y++)
-     {
-      prog->Report(y,level[l].Height());
-      for (nat32 x=(it+y)%2;x<level[l].Width();x+=2)
-      {
-       MsgSet & ms = level[l].Get(x,y);
-       //LogDebug("Calculating (" << x << "," << y << ") at level " << l);
-       //LogDebug("Data term" << LogDiv() << ms.data);
-       for (nat32 d=0;d<4;d++)
-       {
-        //LogDebug("Message from dir " << d << LogDiv() << ms.in[d]);
-        if (ms.send[d]>0.0)
-        {
-         // Calculate the coordinates of the neighbour...
-          int32 ox = x;
-          int32 oy = y;
-          switch (d)
-          {
-           case 0: ++ox; break;
-           case 1: ++oy; break;
-           case 2: --ox; break;
-           case 3: --oy; break;
-          }
-         
-         // Calculate the message...
-          math::FisherBingham msg = ms.data;
-          for (nat32 i=0;i<d;i++) msg *= ms.in[i];
-          for (nat32 i=d+1;i<4;i++) msg *= ms.in[i];       
-          
-          //LogDebug("Pre-convolution" << LogDiv() << msg);
-          msg.Convolve(ms.send[d]);
-                   
-         // Send...
-          level[l].Get(ox,oy).in[(d+2)%4] = msg;
-          //LogDebug("Sent message for direction " << d << LogDiv() << msg);
-        }
-       }
-      }
-     }
-     prog->Pop();
+     PassRows pass(level[l],it);
+     mt::ParallelFor(nat32(0),level[l].Height(),pass,4);
     }
     prog->Pop();
 
@@ -381,36 +419,12 @@ void SfS_BP::Run(time::Progress * prog)
   }
 
 
- // Extract the final beliefs and store in the dist data structure...
+ // Extract the final beliefs and store in the dist data structure, and the
+ // distMax data structure if wanted...
   prog->Report(step++,steps);
-  prog->Push();
-  for (nat32 y=0;y<dist.Height();y++)
-  {
-   prog->Report(y,dist.Height());
-   for (nat32 x=0;x<dist.Width();x++)
-   {
-    dist.Get(x,y) = level[0].Get(x,y).data;
-    for (nat32 d=0;d<4;d++) dist.Get(x,y) *= level[0].Get(x,y).in[d];
-   }
-  }
-  prog->Pop();
-
-
- // Calculate the distMax data structure...
-  if (doML)
-  {
-   prog->Report(step++,steps);
-   prog->Push();
-   for (nat32 y=0;y<distMax.Height();y++)
-   {
-    prog->Report(y,distMax.Height());
-    for (nat32 x=0;x<distMax.Width();x++)
-    {
-     dist.Get(x,y).Maximum(distMax.Get(x,y));
-    }
-   }
-   prog->Pop();
-  }
+  Beliefs beliefs(*this,level[0]);
+  mt::ParallelFor(nat32(0),dist.Height(),beliefs,4);
+  if (doML) prog->Report(step++,steps);
 
  prog->Pop();
 }
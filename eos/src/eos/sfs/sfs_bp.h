@@ -118,7 +118,9 @@ class EOS_CLASS SfS_BP
   /// be able to get distributions out.
    void DisableNorms();
    
-  /// Runs the algorithm. Expect hair to go grey.
+  /// Runs the algorithm. Expect hair to go grey. The rows of each half of the
+  /// checkerboard are split between the threads of the task pool, which gives
+  /// the same answer as doing them in order.
    void Run(time::Progress * prog = null<time::Progress*>());
    
    
@@ -166,6 +168,11 @@ class EOS_CLASS SfS_BP
     math::FisherBingham in[4]; // The incomming message for each direction. (+ve x,+ve y,-ve x,-ve y)
     real32 send[4]; // If negative it shouldn't send a message in the given direction, if positive it should, and its the concentration to use.
    };
+
+  // Functors for the task pool, passing the messages of one colour of the
+  // checkerboard for a range of rows and making the final beliefs...
+   class PassRows;
+   class Beliefs;
 };
 
 //------------------------------------------------------------------------------
@@ -19,6 +19,7 @@
 
 #include "eos/filter/grad_angle.h"
 #include "eos/rend/functions.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -65,6 +66,183 @@ void Worthington::UseIniNeedle(const svt::Field<bs::ColourRGB> & iniN)
  iniNeedle = iniN;
 }
 
+class Worthington::Smooth
+{
+ public:
+  Smooth(const Worthington & s,svt::Field<bs::Normal> & n2)
+  :image(s.image),toLight(s.toLight),needle(s.needle),mask(s.mask),needle2(n2)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=0;x<needle.Size(0);x++)
+    {
+     if (mask.Get(x,y))
+     {
+      // Calculate the next normal...
+       // Calculate sigma...
+        real32 sigma = 0.0;
+        nat32 sigCc = 0;
+         if (mask.Get(x-1,y))
+         {
+          bs::Normal dx = needle.Get(x,y); dx -= needle.Get(x-2,y); dx *= 0.5;
+          bs::Normal dy = needle.Get(x-1,y+1); dy -= needle.Get(x-1,y-1); dy *= 0.5;
+          real32 xc = 0.5*(image.Get(x,y)-image.Get(x-2,y)) - (dx*toLight);
+          real32 yc = 0.5*(image.Get(x-1,y+1)-image.Get(x-1,y-1)) - (dy*toLight);
+          sigma += math::KernelExp(-math::Sqr(xc) - math::Sqr(yc));
+          ++sigCc;
+         }
+       
+         if (mask.Get(x+1,y))
+         {
+          bs::Normal dx = needle.Get(x+2,y); dx -= needle.Get(x,y); dx *= 0.5;
+          bs::Normal dy = needle.Get(x+1,y+1); dy -= needle.Get(x+1,y-1); dy *= 0.5;
+          real32 xc = 0.5*(image.Get(x+2,y)-image.Get(x,y)) - (dx*toLight);
+          real32 yc = 0.5*(image.Get(x+1,y+1)-image.Get(x+1,y-1)) - (dy*toLight);
+          sigma += math::KernelExp(-math::Sqr(xc) - math::Sqr(yc));
+          ++sigCc;
+         }
+
+         if (mask.Get(x,y-1))
+         {
+          bs::Normal dx = needle.Get(x+1,y-1); dx -= needle.Get(x-1,y-1); dx *= 0.5;
+          bs::Normal dy = needle.Get(x,y); dy -= needle.Get(x,y-2); dy *= 0.5;
+          real32 xc = 0.5*(image.Get(x+1,y-1)-image.Get(x-1,y-1)) - (dx*toLight);
+          real32 yc = 0.5*(image.Get(x,y)-image.Get(x,y-2)) - (dy*toLight);
+          sigma += math::KernelExp(-math::Sqr(xc) - math::Sqr(yc));
+          ++sigCc;
+         }
+          
+         if (mask.Get(x,y+1))
+         {
+          bs::Normal dx = needle.Get(x+1,y+1); dx -= needle.Get(x-1,y+1); dx *= 0.5;
+          bs::Normal dy = needle.Get(x,y+2); dy -= needle.Get(x,y); dy *= 0.5;
+          real32 xc = 0.5*(image.Get(x+1,y+1)-image.Get(x-1,y+1)) - (dx*toLight);
+          real32 yc = 0.5*(image.Get(x,y+2)-image.Get(x,y)) - (dy*toLight);
+          sigma += math::KernelExp(-math::Sqr(xc) - math::Sqr(yc));
+          ++sigCc;
+         }
+        if (sigCc!=0) sigma = (sigmaZero*sigma)/real32(sigCc);
+        //sigma = math::Max(sigma,real32(0.0001));
+        real32 pis = math::pi/sigma;
+       
+       // Calculate the differentials, dx and dy, and their 2-norms...
+        bs::Normal dx = needle.Get(x+1,y); dx -= needle.Get(x-1,y); dx *= 0.5;
+        bs::Normal dy = needle.Get(x,y+1); dy -= needle.Get(x,y-1); dy *= 0.5;
+       
+        real32 dxN = dx.Length();
+        real32 dyN = dy.Length();
+       
+       // Do the sum of neighbours in x part of the equation...
+        real32 mult = math::Tanh(pis*dxN)/dxN;
+        bs::Normal vec = needle.Get(x-1,y); vec += needle.Get(x+1,y);
+        vec *= mult;
+        needle2.Get(x,y) = vec;
+      
+       // Do the big dx part of the equation...
+        mult = (pis*math::Sqr(math::Sech(pis*dxN)))/math::Sqr(dxN);
+        mult -= math::Tanh(pis*dxN)/math::Pow<real32>(dxN,3.0);
+        mult *= dx * dx;
+        dx *= mult;
+        needle2.Get(x,y) += dx;
+       
+       // Do the sum of neighbours in y part of the equation...
+        mult = math::Tanh(pis*dyN)/dyN;
+        vec = needle.Get(x,y-1); vec += needle.Get(x,y+1);
+        vec *= mult;
+        needle2.Get(x,y) += vec;
+     
+       // Do the big dy part of the equation...
+        mult = (pis*math::Sqr(math::Sech(pis*dyN)))/math::Sqr(dyN);
+        mult -= math::Tanh(pis*dyN)/math::Pow<real32>(dyN,3.0);
+        mult *= dy * dy;
+        dy *= mult;
+        needle2.Get(x,y) += dy;
+     
+      
+      // Check the answer is good - if not fallback to DD1 from DD6...
+       real32 length = needle2.Get(x,y).Length();
+       if ((!math::IsFinite(length))||(math::IsZero(length)))
+       {
+        needle2.Get(x,y) = bs::Normal(0.0,0.0,0.0);
+        needle2.Get(x,y) += needle.Get(x-1,y);
+        needle2.Get(x,y) += needle.Get(x+1,y);
+        needle2.Get(x,y) += needle.Get(x,y-1);
+        needle2.Get(x,y) += needle.Get(x,y+1);
+       
+        length = needle2.Get(x,y).Length();
+        if ((!math::IsFinite(length))||(math::IsZero(length)))
+        {
+         needle2.Get(x,y) = needle.Get(x,y); // Fallback to no change if DD1 fails - unlikelly.
+         length = needle2.Get(x,y).Length();
+        }
+       }
+
+      // Renormalise, as numerical error adds up...
+       needle2.Get(x,y) /= length;
+     }
+    }
+   }
+  }
+
+
+ private:
+  const svt::Field<real32> & image;
+  const bs::Normal & toLight;
+  const svt::Field<bs::Normal> & needle;
+  const svt::Field<bit> & mask;
+  svt::Field<bs::Normal> & needle2;
+};
+
+class Worthington::Cone
+{
+ public:
+  Cone(Worthington & s,const svt::Field<bs::Normal> & n2)
+  :image(s.image),albedo(s.albedo),toLight(s.toLight),needle(s.needle),mask(s.mask),needle2(n2)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    for (nat32 x=0;x<needle.Size(0);x++)
+    {
+     if (mask.Get(x,y))
+     {
+      // Work out the angle of the cone from the image colour and albedo map...
+       real32 normR = math::Min(image.Get(x,y)/albedo.Get(x,y),real32(1.0));
+       if (!math::IsFinite(normR)) normR = 1.0;
+       real32 coneAng = math::InvCos(normR);
+      
+      // Work out the axis of rotation and the relevent angle...
+       bs::Normal axis;
+       CrossProduct(needle2.Get(x,y),toLight,axis);
+       if (math::IsZero(axis.LengthSqr())) axis = bs::Normal(1.0,0.0,0.0);
+       axis.Normalise();
+      
+       real32 ang = math::InvCos(needle2.Get(x,y)*toLight) - coneAng;    
+             
+      // Apply the axis of rotation...
+       math::Mat<3,3> rotMat;
+       AngAxisToRotMat(axis,ang,rotMat);
+       MultVect(rotMat,needle2.Get(x,y),needle.Get(x,y));
+     }
+    }
+   }
+  }
+
+
+ private:
+  const svt::Field<real32> & image;
+  const svt::Field<real32> & albedo;
+  const bs::Normal & toLight;
+  svt::Field<bs::Normal> & needle;
+  const svt::Field<bit> & mask;
+  const svt::Field<bs::Normal> & needle2;
+};
+
 void Worthington::Run(time::Progress * prog)
 {
  prog->Push();
@@ -180,121 +358,14 @@ void Worthington::Run(time::Progress * prog)
 
 
  // Iterate and smooth/correct the normals...
+  Smooth smooth(*this,needle2);
+  Cone cone(*this,needle2);
   for (nat32 i=1;i<iterCount;i++)
   {
    prog->Report(i,iterCount);
   
    // First pass to smooth (and re-normalise)...
-    for (nat32 y=0;y<needle.Size(1);y++)
-    {
-     for (nat32 x=0;x<needle.Size(0);x++)
-     {
-      if (mask.Get(x,y))
-      {
-       // Calculate the next normal...
-        // Calculate sigma...
-         real32 sigma = 0.0;
-         nat32 sigCc = 0;
-          if (mask.Get(x-1,y))
-          {
-           bs::Normal dx = needle.Get(x,y); dx -= needle.Get(x-2,y); dx *= 0.5;
-           bs::Normal dy = needle.Get(x-1,y+1); dy -= needle.Get(x-1,y-1); dy *= 0.5;
-           real32 xc = 0.5*(image.Get(x,y)-image.Get(x-2,y)) - (dx*toLight);
-           real32 yc = 0.5*(image.Get(x-1,y+1)-image.Get(x-1,y-1)) - (dy*toLight);
-           sigma += math::Exp(-math::Sqr(xc) - math::Sqr(yc));
-           ++sigCc;
-          }
-         
-          if (mask.Get(x+1,y))
-          {
-           bs::Normal dx = needle.Get(x+2,y); dx -= needle.Get(x,y); dx *= 0.5;
-           bs::Normal dy = needle.Get(x+1,y+1); dy -= needle.Get(x+1,y-1); dy *= 0.5;
-           real32 xc = 0.5*(image.Get(x+2,y)-image.Get(x,y)) - (dx*toLight);
-           real32 yc = 0.5*(image.Get(x+1,y+1)-image.Get(x+1,y-1)) - (dy*toLight);
-           sigma += math::Exp(-math::Sqr(xc) - math::Sqr(yc));
-           ++sigCc;
-          }
-
-          if (mask.Get(x,y-1))
-          {
-           bs::Normal dx = needle.Get(x+1,y-1); dx -= needle.Get(x-1,y-1); dx *= 0.5;
-           bs::Normal dy = needle.Get(x,y); dy -= needle.Get(x,y-2); dy *= 0.5;
-           real32 xc = 0.5*(image.Get(x+1,y-1)-image.Get(x-1,y-1)) - (dx*toLight);
-           real32 yc = 0.5*(image.Get(x,y)-image.Get(x,y-2)) - (dy*toLight);
-           sigma += math::Exp(-math::Sqr(xc) - math::Sqr(yc));
-           ++sigCc;
-          }
-            
-          if (mask.Get(x,y+1))
-          {
-           bs::Normal dx = needle.Get(x+1,y+1); dx -= needle.Get(x-1,y+1); dx *= 0.5;
-           bs::Normal dy = needle.Get(x,y+2); dy -= needle.Get(x,y); dy *= 0.5;
-           real32 xc = 0.5*(image.Get(x+1,y+1)-image.Get(x-1,y+1)) - (dx*toLight);
-           real32 yc = 0.5*(image.Get(x,y+2)-image.Get(x,y)) - (dy*toLight);
-           sigma += math::Exp(-math::Sqr(xc) - math::Sqr(yc));
-           ++sigCc;
-          }
-         if (sigCc!=0) sigma = (sigmaZero*sigma)/real32(sigCc);
-         //sigma = math::Max(sigma,real32(0.0001));
-         real32 pis = math::pi/sigma;
-         
-        // Calculate the differentials, dx and dy, and their 2-norms...
-         bs::Normal dx = needle.Get(x+1,y); dx -= needle.Get(x-1,y); dx *= 0.5;
-         bs::Normal dy = needle.Get(x,y+1); dy -= needle.Get(x,y-1); dy *= 0.5;
-         
-         real32 dxN = dx.Length();
-         real32 dyN = dy.Length();
-         
-        // Do the sum of neighbours in x part of the equation...
-         real32 mult = math::Tanh(pis*dxN)/dxN;
-         bs::Normal vec = needle.Get(x-1,y); vec += needle.Get(x+1,y);
-         vec *= mult;
-         needle2.Get(x,y) = vec;
-        
-        // Do the big dx part of the equation...
-         mult = (pis*math::Sqr(math::Sech(pis*dxN)))/math::Sqr(dxN);
-         mult -= math::Tanh(pis*dxN)/math::Pow<real32>(dxN,3.0);
-         mult *= dx * dx;
-         dx *= mult;
-         needle2.Get(x,y) += dx;
-         
-        // Do the sum of neighbours in y part of the equation...
-         mult = math::Tanh(pis*dyN)/dyN;
-         vec = needle.Get(x,y-1); vec += needle.Get(x,y+1);
-         vec *= mult;
-         needle2.Get(x,y) += vec;
-       
-        // Do the big dy part of the equation...
-         mult = (pis*math::Sqr(math::Sech(pis*dyN)))/math::Sqr(dyN);
-         mult -= math::Tanh(pis*dyN)/math::Pow<real32>(dyN,3.0);
-         mult *= dy * dy;
-         dy *= mult;
-         needle2.Get(x,y) += dy;
-       
-        
-       // Check the answer is good - if not fallback to DD1 from DD6...
-        real32 length = needle2.Get(x,y).Length();
-        if ((!math::IsFinite(length))||(math::IsZero(length)))
-        {
-         needle2.Get(x,y) = bs::Normal(0.0,0.0,0.0);
-         needle2.Get(x,y) += needle.Get(x-1,y);
-         needle2.Get(x,y) += needle.Get(x+1,y);
-         needle2.Get(x,y) += needle.Get(x,y-1);
-         needle2.Get(x,y) += needle.Get(x,y+1);
-         
-         length = needle2.Get(x,y).Length();
-         if ((!math::IsFinite(length))||(math::IsZero(length)))
-         {
-          needle2.Get(x,y) = needle.Get(x,y); // Fallback to no change if DD1 fails - unlikelly.
-          length = needle2.Get(x,y).Length();
-         }
-        }
-
-       // Renormalise, as numerical error adds up...
-        needle2.Get(x,y) /= length;
-      }
-     }
-    }
+    mt::ParallelFor(nat32(0),needle.Size(1),smooth,4);
 
 
    // DD1 version of first pass...
@@ -317,32 +388,7 @@ void Worthington::Run(time::Progress * prog)
 
 
    // Second pass to enforce the cone constraint...
-    for (nat32 y=0;y<needle.Size(1);y++)
-    {
-     for (nat32 x=0;x<needle.Size(0);x++)
-     {
-      if (mask.Get(x,y))
-      {
-       // Work out the angle of the cone from the image colour and albedo map...
-        real32 normR = math::Min(image.Get(x,y)/albedo.Get(x,y),real32(1.0));
-        if (!math::IsFinite(normR)) normR = 1.0;
-        real32 coneAng = math::InvCos(normR);
-        
-       // Work out the axis of rotation and the relevent angle...
-        bs::Normal axis;
-        CrossProduct(needle2.Get(x,y),toLight,axis);
-        if (math::IsZero(axis.LengthSqr())) axis = bs::Normal(1.0,0.0,0.0);
-        axis.Normalise();
-        
-        real32 ang = math::InvCos(needle2.Get(x,y)*toLight) - coneAng;    
-               
-       // Apply the axis of rotation...
-        math::Mat<3,3> rotMat;
-        AngAxisToRotMat(axis,ang,rotMat);
-        MultVect(rotMat,needle2.Get(x,y),needle.Get(x,y));
-      }
-     }     
-    }
+    mt::ParallelFor(nat32(0),needle.Size(1),cone,8);
   }
   
  // Go through and re-normalise all the needles, just a bit of paranoia...
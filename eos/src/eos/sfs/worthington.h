@@ -76,7 +76,7 @@ class EOS_CLASS Worthington
 
 
   /// Produces results, outputting an indication of
-  /// progress. (Albit a 1-step ahead variety.)
+  /// progress. (Albit a 1-step ahead variety.) Uses the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -117,6 +117,12 @@ class EOS_CLASS Worthington
    svt::Var * var;
    svt::Field<bs::Normal> needle;
    svt::Field<bit> mask;
+
+  // The two passes of each iteration, functors for the task pool that do a
+  // range of rows. The first reads needle and writes a seperate field, the
+  // second only reads its own pixel, so rows can be done in any order...
+   class Smooth;
+   class Cone;
 };
 
 //------------------------------------------------------------------------------
@@ -17,6 +17,8 @@
 
 #include "eos/sfs/zheng.h"
 
+#include "eos/mt/tasks.h"
+
 namespace eos
 {
  namespace sfs
@@ -234,107 +236,165 @@ cstrconst Zheng::TypeString() const
 }
 
 //------------------------------------------------------------------------------
+class Zheng::Deltas
+{
+ public:
+  Deltas(const Zheng & s,const ds::Array2D<real32> & i,const ds::Array2D<Pixel> & d,ds::Array2D<Pixel> & de)
+  :self(s),irr(i),data(d),delta(de)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   const bs::Normal & toLight = self.toLight;
+   const real32 mu = self.mu;
+   const real32 diffDelta = self.diffDelta;
+
+   for (int32 y=int32(y0);y<int32(y1);y++)
+   {
+    for (int32 x=0;x<int32(data.Width());x++)
+    {
+     // Calculate the many differentials...
+      real32 Px = data.ClampGet(x+1,y).p - data.Get(x,y).p;
+      real32 Pxx = data.ClampGet(x+1,y).p + data.ClampGet(x-1,y).p - 2.0*data.Get(x,y).p;
+      real32 Pyy = data.ClampGet(x,y+1).p + data.ClampGet(x,y-1).p - 2.0*data.Get(x,y).p;
+
+      real32 Qy = data.ClampGet(x,y+1).q - data.Get(x,y).q;
+      real32 Qxx = data.ClampGet(x+1,y).q + data.ClampGet(x-1,y).q - 2.0*data.Get(x,y).q;
+      real32 Qyy = data.ClampGet(x,y+1).q + data.ClampGet(x,y-1).q - 2.0*data.Get(x,y).q;
+      
+      real32 Zx = data.ClampGet(x+1,y).z - data.Get(x,y).z;
+      real32 Zy = data.ClampGet(x,y+1).z - data.Get(x,y).z;
+      real32 Zxx = data.ClampGet(x+1,y).z + data.ClampGet(x-1,y).z - 2.0*data.Get(x,y).z;
+      real32 Zyy = data.ClampGet(x,y+1).z + data.ClampGet(x,y-1).z - 2.0*data.Get(x,y).z;
+      
+      real32 Ixx = irr.ClampGet(x+1,y) + irr.ClampGet(x-1,y) - 2.0*irr.Get(x,y);
+      real32 Iyy = irr.ClampGet(x,y+1) + irr.ClampGet(x,y-1) - 2.0*irr.Get(x,y);
+
+
+     // Calculate the reflectance function, plus differentials...
+      real32 R = (-toLight[0]*data.Get(x,y).p - toLight[1]*data.Get(x,y).q + toLight[2])/
+                 math::Sqrt(math::Sqr(data.Get(x,y).p) + math::Sqr(data.Get(x,y).q) + 1.0);
+             R = math::Max(R,real32(0.0));
+      real32 Rp = (-toLight[0]*(data.Get(x,y).p+diffDelta) - toLight[1]*data.Get(x,y).q + toLight[2])/
+                  math::Sqrt(math::Sqr(data.Get(x,y).p+diffDelta) + math::Sqr(data.Get(x,y).q) + 1.0);
+             Rp = math::Max(Rp,real32(0.0));
+             Rp = (Rp - R)/diffDelta;
+      real32 Rq = (-toLight[0]*data.Get(x,y).p - toLight[1]*(data.Get(x,y).q+diffDelta) + toLight[2])/
+                  math::Sqrt(math::Sqr(data.Get(x,y).p) + math::Sqr(data.Get(x,y).q+diffDelta) + 1.0);
+             Rq = math::Max(Rq,real32(0.0));
+             Rq = (Rq - R)/diffDelta;
+     
+     // Calculate the symmetric A matrix...
+      real32 A11 = 5.0*math::Sqr(Rp) + 1.25*mu;
+      real32 A12 = 5.0*Rp*Rq + 0.25*mu;
+      real32 A22 = 5.0*math::Sqr(Rq) + 1.25*mu;
+      
+     // Calculate some greek letters...
+      real32 ep1 = R - irr.Get(x,y); 
+      real32 ep2 = Rp*(Pxx+Pyy) + Rq*(Qxx+Qyy) - Ixx - Iyy;
+      real32 aDet = A11*A22 - math::Sqr(A12);
+      
+     // Calculate the C terms...
+      real32 C3 = -Px - Qy + Zxx + Zyy;
+      real32 C1 = (ep2-ep1)*Rp - mu*(data.Get(x,y).p-Zx) - 0.25*mu*C3;
+      real32 C2 = (ep2-ep1)*Rq - mu*(data.Get(x,y).q-Zy) - 0.25*mu*C3;
+      
+     // And, finally, calculate the deltas...
+      delta.Get(x,y).p = (C1*A22 - C2*A12)/aDet;
+      delta.Get(x,y).q = (C2*A11 - C1*A12)/aDet;
+      delta.Get(x,y).z = (C3 + delta.Get(x,y).p + delta.Get(x,y).q)/4.0;
+      
+      /*if ((x==int32(data.Width()/2))&&(y==int32(data.Height()/2)))
+      {
+       LogDebug("Start {x,y,iter}" << LogDiv() << x << LogDiv() << y << LogDiv() << i);
+       LogDebug("{Px,Pxx,Pyy}" << LogDiv() << Px << LogDiv() << Pxx << LogDiv() << Pyy);
+       LogDebug("{Qy,Qxx,Qyy}" << LogDiv() << Qy << LogDiv() << Qxx << LogDiv() << Qyy);
+       LogDebug("{Zx,Zy,Zxx,Zyy}" << LogDiv() << Zx << LogDiv() << Zy << LogDiv() << Zxx << LogDiv() << Zyy);
+       LogDebug("{Ixx,Iyy}" << LogDiv() << Ixx << LogDiv() << Iyy);
+       LogDebug("{R,Rp,Rq}" << LogDiv() << R << LogDiv() << Rp << LogDiv() << Rq);
+       
+       LogDebug("{A11,A12,A22}" << LogDiv() << A11 << LogDiv() << A12 << LogDiv() << A22);
+       LogDebug("{ep1,ep2,aDet}" << LogDiv() << ep1 << LogDiv() << ep2 << LogDiv() << aDet);
+       LogDebug("{C1,C2,C3}" << LogDiv() << C1 << LogDiv() << C2 << LogDiv() << C3);
+       LogDebug("End {dp,dq,dz}" << LogDiv() << delta.Get(x,y).p << LogDiv()
+                << delta.Get(x,y).q << LogDiv() << delta.Get(x,y).z);
+      }*/
+    }
+   }
+  }
+
+
+ private:
+  const Zheng & self;
+  const ds::Array2D<real32> & irr;
+  const ds::Array2D<Pixel> & data;
+  ds::Array2D<Pixel> & delta;
+};
+
+class Zheng::Apply
+{
+ public:
+  Apply(ds::Array2D<Pixel> & d,const ds::Array2D<Pixel> & de,ds::Array<Pixel> & s)
+  :data(d),delta(de),sum(s)
+  {}
+
+  void operator () (nat32 y0,nat32 y1)
+  {
+   for (nat32 y=y0;y<y1;y++)
+   {
+    sum[y].p = 0.0;
+    sum[y].q = 0.0;
+    sum[y].z = 0.0;
+    for (nat32 x=0;x<data.Width();x++)
+    {
+     if (math::IsFinite(delta.Get(x,y).z))
+     {
+      data.Get(x,y) += delta.Get(x,y);
+      sum[y].p += math::Abs(delta.Get(x,y).p);
+      sum[y].q += math::Abs(delta.Get(x,y).q);
+      sum[y].z += math::Abs(delta.Get(x,y).z);
+     }
+     else sum[y].z += 1.0; // Make sure it doesn't finish this time around.
+    }
+   }
+  }
+
+
+ private:
+  ds::Array2D<Pixel> & data;
+  const ds::Array2D<Pixel> & delta;
+  ds::Array<Pixel> & sum;
+};
+
 void Zheng::DoIterations(ds::Array2D<real32> & irr,ds::Array2D<Pixel> & data,ds::Array2D<Pixel> & delta,time::Progress * prog)
 {
  prog->Push();
+ ds::Array<Pixel> rowSum(data.Height());
+ Deltas deltas(*this,irr,data,delta);
+ Apply apply(data,delta,rowSum);
+
  // Iterate until the cap is hit, unless we break early due to the deltas being zero...
   for (nat32 i=0;i<iters;i++)
   {
    prog->Report(i,iters);
 
    // Calculate delta on a per-pixel basis...
-    for (int32 y=0;y<int32(data.Height());y++)
-    {
-     for (int32 x=0;x<int32(data.Width());x++)
-     {
-      // Calculate the many differentials...
-       real32 Px = data.ClampGet(x+1,y).p - data.Get(x,y).p;
-       real32 Pxx = data.ClampGet(x+1,y).p + data.ClampGet(x-1,y).p - 2.0*data.Get(x,y).p;
-       real32 Pyy = data.ClampGet(x,y+1).p + data.ClampGet(x,y-1).p - 2.0*data.Get(x,y).p;
-
-       real32 Qy = data.ClampGet(x,y+1).q - data.Get(x,y).q;
-       real32 Qxx = data.ClampGet(x+1,y).q + data.ClampGet(x-1,y).q - 2.0*data.Get(x,y).q;
-       real32 Qyy = data.ClampGet(x,y+1).q + data.ClampGet(x,y-1).q - 2.0*data.Get(x,y).q;
-       
-       real32 Zx = data.ClampGet(x+1,y).z - data.Get(x,y).z;
-       real32 Zy = data.ClampGet(x,y+1).z - data.Get(x,y).z;
-       real32 Zxx = data.ClampGet(x+1,y).z + data.ClampGet(x-1,y).z - 2.0*data.Get(x,y).z;
-       real32 Zyy = data.ClampGet(x,y+1).z + data.ClampGet(x,y-1).z - 2.0*data.Get(x,y).z;
-       
-       real32 Ixx = irr.ClampGet(x+1,y) + irr.ClampGet(x-1,y) - 2.0*irr.Get(x,y);
-       real32 Iyy = irr.ClampGet(x,y+1) + irr.ClampGet(x,y-1) - 2.0*irr.Get(x,y);
-
-
-      // Calculate the reflectance function, plus differentials...
-       real32 R = (-toLight[0]*data.Get(x,y).p - toLight[1]*data.Get(x,y).q + toLight[2])/
-                  math::Sqrt(math::Sqr(data.Get(x,y).p) + math::Sqr(data.Get(x,y).q) + 1.0);
-              R = math::Max(R,real32(0.0));
-       real32 Rp = (-toLight[0]*(data.Get(x,y).p+diffDelta) - toLight[1]*data.Get(x,y).q + toLight[2])/
-                   math::Sqrt(math::Sqr(data.Get(x,y).p+diffDelta) + math::Sqr(data.Get(x,y).q) + 1.0);
-              Rp = math::Max(Rp,real32(0.0));
-              Rp = (Rp - R)/diffDelta;
-       real32 Rq = (-toLight[0]*data.Get(x,y).p - toLight[1]*(data.Get(x,y).q+diffDelta) + toLight[2])/
-                   math::Sqrt(math::Sqr(data.Get(x,y).p) + math::Sqr(data.Get(x,y).q+diffDelta) + 1.0);
-              Rq = math::Max(Rq,real32(0.0));
-              Rq = (Rq - R)/diffDelta;
-      
-      // Calculate the symmetric A matrix...
-       real32 A11 = 5.0*math::Sqr(Rp) + 1.25*mu;
-       real32 A12 = 5.0*Rp*Rq + 0.25*mu;
-       real32 A22 = 5.0*math::Sqr(Rq) + 1.25*mu;
-       
-      // Calculate some greek letters...
-       real32 ep1 = R - irr.Get(x,y); 
-       real32 ep2 = Rp*(Pxx+Pyy) + Rq*(Qxx+Qyy) - Ixx - Iyy;
-       real32 aDet = A11*A22 - math::Sqr(A12);
-       
-      // Calculate the C terms...
-       real32 C3 = -Px - Qy + Zxx + Zyy;
-       real32 C1 = (ep2-ep1)*Rp - mu*(data.Get(x,y).p-Zx) - 0.25*mu*C3;
-       real32 C2 = (ep2-ep1)*Rq - mu*(data.Get(x,y).q-Zy) - 0.25*mu*C3;
-       
-      // And, finally, calculate the deltas...
-       delta.Get(x,y).p = (C1*A22 - C2*A12)/aDet;
-       delta.Get(x,y).q = (C2*A11 - C1*A12)/aDet;
-       delta.Get(x,y).z = (C3 + delta.Get(x,y).p + delta.Get(x,y).q)/4.0;
-       
-       /*if ((x==int32(data.Width()/2))&&(y==int32(data.Height()/2)))
-       {
-        LogDebug("Start {x,y,iter}" << LogDiv() << x << LogDiv() << y << LogDiv() << i);
-        LogDebug("{Px,Pxx,Pyy}" << LogDiv() << Px << LogDiv() << Pxx << LogDiv() << Pyy);
-        LogDebug("{Qy,Qxx,Qyy}" << LogDiv() << Qy << LogDiv() << Qxx << LogDiv() << Qyy);
-        LogDebug("{Zx,Zy,Zxx,Zyy}" << LogDiv() << Zx << LogDiv() << Zy << LogDiv() << Zxx << LogDiv() << Zyy);
-        LogDebug("{Ixx,Iyy}" << LogDiv() << Ixx << LogDiv() << Iyy);
-        LogDebug("{R,Rp,Rq}" << LogDiv() << R << LogDiv() << Rp << LogDiv() << Rq);
-        
-        LogDebug("{A11,A12,A22}" << LogDiv() << A11 << LogDiv() << A12 << LogDiv() << A22);
-        LogDebug("{ep1,ep2,aDet}" << LogDiv() << ep1 << LogDiv() << ep2 << LogDiv() << aDet);
-        LogDebug("{C1,C2,C3}" << LogDiv() << C1 << LogDiv() << C2 << LogDiv() << C3);
-        LogDebug("End {dp,dq,dz}" << LogDiv() << delta.Get(x,y).p << LogDiv()
-                 << delta.Get(x,y).q << LogDiv() << delta.Get(x,y).z);
-       }*/
-     }
-    }
-   
-   // Apply deltas, keeping track of the total amount of actual change...
+    mt::ParallelFor(nat32(0),data.Height(),deltas,4);
+
+   // Apply deltas, keeping track of the total amount of actual change, which
+   // is summed by row and then the rows summed...
+    mt::ParallelFor(nat32(0),data.Height(),apply,8);
+
     real32 sumDp = 0.0;
     real32 sumDq = 0.0;
     real32 sumDz = 0.0;
     for (nat32 y=0;y<data.Height();y++)
     {
-     for (nat32 x=0;x<data.Width();x++)
-     {
-      if (math::IsFinite(delta.Get(x,y).z))
-      {
-       data.Get(x,y) += delta.Get(x,y);
-       sumDp += math::Abs(delta.Get(x,y).p);
-       sumDq += math::Abs(delta.Get(x,y).q);
-       sumDz += math::Abs(delta.Get(x,y).z);
-      }
-      else sumDz += 1.0; // Make sure it doesn't finish this time around.
-     }
+     sumDp += rowSum[y].p;
+     sumDq += rowSum[y].q;
+     sumDz += rowSum[y].z;
     }
-   
+
    // If the change from applying the deltas is small break early...
     if ((sumDp<0.001)&&(sumDq<0.001)&&(sumDz<0.001)) break;
   }
@@ -62,7 +62,7 @@ class EOS_CLASS Zheng
    void SetParas(real32 mu = 1.0,nat32 iters = 512,real32 diffDelta = 0.0001);
 
 
-  /// Blah.
+  /// Blah. Uses the task pool.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -120,6 +120,12 @@ class EOS_CLASS Zheng
 
   // Helper methods...
    void DoIterations(ds::Array2D<real32> & irr,ds::Array2D<Pixel> & data,ds::Array2D<Pixel> & delta,time::Progress * prog);
+
+  // The two halves of an iteration, functors for the task pool that do a
+  // range of rows - as every delta is calculated before any are applied the
+  // rows can be done in any order...
+   class Deltas;
+   class Apply;
 };
 
 //------------------------------------------------------------------------------
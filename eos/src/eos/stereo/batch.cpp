@@ -0,0 +1,620 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/stereo/batch.h"
+
+#include "eos/ds/lists.h"
+#include "eos/mt/threads.h"
+#include "eos/svt/file.h"
+#include "eos/filter/image_io.h"
+#include "eos/filter/conversion.h"
+#include "eos/cam/rectification.h"
+#include "eos/stereo/dsi.h"
+#include "eos/stereo/disp_post.h"
+#include "eos/stereo/diffuse_correlation.h"
+#include "eos/time/times.h"
+#include "eos/file/csv.h"
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+BatchJob::BatchJob()
+:index(0),core(null<svt::Core*>()),left(null<svt::Var*>()),right(null<svt::Var*>()),result(null<svt::Var*>()),
+charged(0)
+{}
+
+BatchJob::~BatchJob()
+{
+ delete left;
+ delete right;
+ delete result;
+}
+
+nat64 BatchJob::Bytes() const
+{
+ nat64 ret = 0;
+ if (left) ret += left->Stride(left->Dims());
+ if (right) ret += right->Stride(right->Dims());
+ if (result) ret += result->Stride(result->Dims());
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+BatchLoad::~BatchLoad()
+{}
+
+bit BatchLoad::Process(BatchJob & job)
+{
+ cstr fn = job.leftFn.ToStr();
+ job.left = filter::LoadImageRGB(*job.core,fn);
+ mem::Free(fn);
+
+ fn = job.rightFn.ToStr();
+ job.right = filter::LoadImageRGB(*job.core,fn);
+ mem::Free(fn);
+
+ return (job.left!=null<svt::Var*>())&&(job.right!=null<svt::Var*>());
+}
+
+cstrconst BatchLoad::Name() const
+{
+ return "load";
+}
+
+cstrconst BatchLoad::TypeString() const
+{
+ return "eos::stereo::BatchLoad";
+}
+
+//------------------------------------------------------------------------------
+BatchRectify::BatchRectify(bit f,nat32 s)
+:force(f),samples(s)
+{}
+
+BatchRectify::~BatchRectify()
+{}
+
+bit BatchRectify::Process(BatchJob & job)
+{
+ cam::CameraPair & pair = job.pair;
+ if ((!force)&&pair.IsRectified()) return true;
+
+ // Get the maps, only calculated when the rig or image sizes change...
+  if (!cache.Get(pair,job.left->Size(0),job.left->Size(1),
+                 job.right->Size(0),job.right->Size(1),samples)) return false;
+
+ // Rectify...
+  svt::Var * leftOut = new svt::Var(*job.core);
+  svt::Var * rightOut = new svt::Var(*job.core);
+  if (!(cache.LeftMap().Apply(job.left,leftOut,false,true)&&
+        cache.RightMap().Apply(job.right,rightOut,false,true)))
+  {
+   delete leftOut;
+   delete rightOut;
+   return false;
+  }
+
+  delete job.left; job.left = leftOut;
+  delete job.right; job.right = rightOut;
+
+ // The radial distortion has been compensated for, and the sizes have
+ // changed...
+  pair = cache.Pair();
+
+ return true;
+}
+
+cstrconst BatchRectify::Name() const
+{
+ return "rectify";
+}
+
+cstrconst BatchRectify::TypeString() const
+{
+ return "eos::stereo::BatchRectify";
+}
+
+//------------------------------------------------------------------------------
+BatchMatch::BatchMatch(const LevelSolver & s)
+:solver(s.Clone()),minDisp(-32),maxDisp(32),levels(2),mult(1.0),cap(36.0),check(false),tol(1.0)
+{}
+
+BatchMatch::~BatchMatch()
+{
+ delete solver;
+}
+
+void BatchMatch::SetRange(int32 minD,int32 maxD)
+{
+ minDisp = math::Min(minD,maxD);
+ maxDisp = math::Max(minD,maxD);
+}
+
+void BatchMatch::SetLevels(nat32 l)
+{
+ levels = l;
+}
+
+void BatchMatch::SetCost(real32 m,real32 c)
+{
+ mult = m;
+ cap = c;
+}
+
+void BatchMatch::SetCheck(bit enable,real32 t)
+{
+ check = enable;
+ tol = t;
+}
+
+bit BatchMatch::Process(BatchJob & job)
+{
+ // Get the images in luv...
+  filter::RGBtoLuv(job.left);
+  filter::RGBtoLuv(job.right);
+
+  svt::Field<bs::ColourLuv> leftLuv(job.left,"luv");
+  svt::Field<bs::ColourLuv> rightLuv(job.right,"luv");
+  svt::Field<bit> leftMask; job.left->ByName("mask",leftMask);
+  svt::Field<bit> rightMask; job.right->ByName("mask",rightMask);
+
+ // Make the result...
+  delete job.result;
+  job.result = new svt::Var(*job.core);
+  job.result->Setup2D(job.left->Size(0),job.left->Size(1));
+  real32 dispIni = 0.0;
+  bit maskIni = true;
+  job.result->Add("disp",dispIni);
+  job.result->Add("mask",maskIni);
+  job.result->Commit(false);
+
+  svt::Field<real32> disp(job.result,"disp");
+  svt::Field<bit> mask(job.result,"mask");
+
+ // Match...
+  SqrBoundLuvDSC dsc(leftLuv,rightLuv,mult,cap);
+
+  CoarseToFine leftC2F;
+  leftC2F.Set(&dsc);
+  if (leftMask.Valid()&&rightMask.Valid()) leftC2F.Set(leftMask,rightMask);
+  leftC2F.Set(solver);
+  leftC2F.SetRange(minDisp,maxDisp);
+  leftC2F.SetLevels(levels);
+  leftC2F.Run();
+
+ // Either check against the other direction or take the best disparity
+ // directly...
+  if (check)
+  {
+   SwapDSC swap(&dsc);
+
+   CoarseToFine rightC2F;
+   rightC2F.Set(&swap);
+   if (leftMask.Valid()&&rightMask.Valid()) rightC2F.Set(rightMask,leftMask);
+   rightC2F.Set(solver);
+   rightC2F.SetRange(-maxDisp,-minDisp);
+   rightC2F.SetLevels(levels);
+   rightC2F.Run();
+
+   CrossCheck(leftC2F,rightC2F,disp,mask,tol,FillBackground);
+  }
+  else
+  {
+   for (nat32 y=0;y<disp.Size(1);y++)
+   {
+    for (nat32 x=0;x<disp.Size(0);x++)
+    {
+     nat32 size = leftC2F.Size(x,y);
+     disp.Get(x,y) = 0.0;
+     mask.Get(x,y) = size!=0;
+     real32 best = math::Infinity<real32>();
+     for (nat32 i=0;i<size;i++)
+     {
+      if (leftC2F.Cost(x,y,i)<best)
+      {
+       best = leftC2F.Cost(x,y,i);
+       disp.Get(x,y) = leftC2F.Disp(x,y,i);
+      }
+     }
+    }
+   }
+  }
+
+ return true;
+}
+
+cstrconst BatchMatch::Name() const
+{
+ return "match";
+}
+
+cstrconst BatchMatch::TypeString() const
+{
+ return "eos::stereo::BatchMatch";
+}
+
+//------------------------------------------------------------------------------
+BatchRefine::BatchRefine(real32 dm,nat32 ds,real32 dc,real32 p)
+:distMult(dm),diffSteps(ds),distCap(dc),prune(p)
+{}
+
+BatchRefine::~BatchRefine()
+{}
+
+bit BatchRefine::Process(BatchJob & job)
+{
+ if (job.result==null<svt::Var*>()) return false;
+
+ svt::Field<bs::ColourLuv> leftLuv(job.left,"luv");
+ svt::Field<bs::ColourLuv> rightLuv(job.right,"luv");
+ svt::Field<bit> leftMask; job.left->ByName("mask",leftMask);
+ svt::Field<bit> rightMask; job.right->ByName("mask",rightMask);
+ svt::Field<real32> disp(job.result,"disp");
+ svt::Field<bit> mask(job.result,"mask");
+
+ DiffCorrRefine dcr;
+ dcr.SetImages(leftLuv,rightLuv);
+ if (leftMask.Valid()&&rightMask.Valid()) dcr.SetMasks(leftMask,rightMask);
+ dcr.SetDisparity(disp);
+ dcr.SetDisparityMask(mask);
+ dcr.SetDiff(distMult,diffSteps);
+ dcr.SetDist(distCap,prune);
+ dcr.Run();
+
+ dcr.GetDisp(disp);
+ dcr.GetMask(mask);
+
+ return true;
+}
+
+cstrconst BatchRefine::Name() const
+{
+ return "refine";
+}
+
+cstrconst BatchRefine::TypeString() const
+{
+ return "eos::stereo::BatchRefine";
+}
+
+//------------------------------------------------------------------------------
+BatchSave::BatchSave(bit sp)
+:savePair(sp)
+{}
+
+BatchSave::~BatchSave()
+{}
+
+bit BatchSave::Process(BatchJob & job)
+{
+ if (job.result==null<svt::Var*>()) return false;
+
+ delete job.left; job.left = null<svt::Var*>();
+ delete job.right; job.right = null<svt::Var*>();
+
+ cstr fn = job.outFn.ToStr();
+ bit ret = svt::Save(fn,job.result,true);
+ mem::Free(fn);
+
+ if (ret&&savePair)
+ {
+  str::String pcc = job.outFn;
+  pcc += ".pcc";
+  ret = job.pair.Save(pcc,true);
+ }
+
+ return ret;
+}
+
+cstrconst BatchSave::Name() const
+{
+ return "save";
+}
+
+cstrconst BatchSave::TypeString() const
+{
+ return "eos::stereo::BatchSave";
+}
+
+//------------------------------------------------------------------------------
+// A bounded queue of jobs between two stages - Push blocks when its full, Pop
+// when its empty. A null job is used to tell a worker there are no more...
+class Batch::Queue
+{
+ public:
+  Queue(nat32 size)
+  {
+   space.Add(size);
+  }
+
+  void Push(BatchJob * job)
+  {
+   space.Get();
+   lock.Lock();
+    data.AddBack(job);
+   lock.Unlock();
+   items.Add();
+  }
+
+  BatchJob * Pop()
+  {
+   items.Get();
+   lock.Lock();
+    BatchJob * ret = data.Front();
+    data.RemFront();
+   lock.Unlock();
+   space.Add();
+   return ret;
+  }
+
+
+ private:
+  mt::OwnedLock lock;
+  mt::EventLock items;
+  mt::EventLock space;
+  ds::List<BatchJob*> data;
+};
+
+// The thread for a stage, takes jobs from its queue, processes them and hands
+// them on, or back to the Batch when its the last stage or they fail...
+class Batch::Worker : public mt::Thread
+{
+ public:
+  Worker(Batch & b,nat32 s,Queue & i,Queue * o)
+  :batch(b),stage(s),in(i),out(o)
+  {}
+
+  void Execute()
+  {
+   while (true)
+   {
+    BatchJob * job = in.Pop();
+    if (job==null<BatchJob*>())
+    {
+     if (out) out->Push(job);
+     break;
+    }
+
+    nat64 start = time::MilliTime();
+    bit ok = batch.stages[stage]->Process(*job);
+    batch.stageTime[stage] += time::MilliTime() - start;
+    batch.stageJobs[stage] += 1;
+
+    if (!ok)
+    {
+     LogDebug("[batch] failed {job,stage}" << LogDiv() << job->index << LogDiv() << batch.stages[stage]->Name());
+     batch.Finish(job,true);
+     continue;
+    }
+
+    batch.Charge(*job);
+    if (out) out->Push(job);
+        else batch.Finish(job,false);
+   }
+  }
+
+
+ private:
+  Batch & batch;
+  nat32 stage;
+  Queue & in;
+  Queue * out;
+};
+
+//------------------------------------------------------------------------------
+Batch::Batch(svt::Core & c)
+:core(c),inFlight(3),memory(nat64(512)*1024*1024),queueSize(1),wallTime(0),peak(0),
+active(0),used(0),estimate(0),measured(false)
+{}
+
+Batch::~Batch()
+{
+ for (nat32 i=0;i<stages.Size();i++) delete stages[i];
+}
+
+void Batch::Add(BatchStage * stage)
+{
+ stages.Size(stages.Size()+1);
+ stages[stages.Size()-1] = stage;
+}
+
+void Batch::Add(const str::String & leftFn,const str::String & rightFn,const cam::CameraPair & pair,const str::String & outFn)
+{
+ jobs.Size(jobs.Size()+1);
+ Input & targ = jobs[jobs.Size()-1];
+ targ.leftFn = leftFn;
+ targ.rightFn = rightFn;
+ targ.outFn = outFn;
+ targ.pair = pair;
+ targ.done = false;
+ targ.failed = false;
+}
+
+void Batch::SetInFlight(nat32 count)
+{
+ inFlight = math::Max<nat32>(count,1);
+}
+
+void Batch::SetMemory(nat64 bytes)
+{
+ memory = bytes;
+}
+
+void Batch::SetQueue(nat32 size)
+{
+ queueSize = math::Max<nat32>(size,1);
+}
+
+void Batch::Run(time::Progress * prog)
+{
+ LogBlock("eos::stereo::Batch::Run","{jobs,stages}" << LogDiv() << jobs.Size() << LogDiv() << stages.Size());
+ prog->Push();
+
+ // Reset the statistics...
+  stageJobs.Size(stages.Size());
+  stageTime.Size(stages.Size());
+  for (nat32 s=0;s<stages.Size();s++)
+  {
+   stageJobs[s] = 0;
+   stageTime[s] = 0;
+  }
+  wallTime = 0;
+  peak = 0;
+  active = 0;
+  used = 0;
+  estimate = 0;
+  measured = false;
+
+  if (stages.Size()==0)
+  {
+   prog->Pop();
+   return;
+  }
+
+  nat32 todo = 0;
+  for (nat32 i=0;i<jobs.Size();i++)
+  {
+   if (!jobs[i].done) todo += 1;
+  }
+  nat64 start = time::MilliTime();
+
+
+ // Start the threads...
+  ds::Array<Queue*> queue(stages.Size());
+  ds::Array<Worker*> worker(stages.Size());
+  for (nat32 s=0;s<stages.Size();s++) queue[s] = new Queue(queueSize);
+  for (nat32 s=0;s<stages.Size();s++)
+  {
+   worker[s] = new Worker(*this,s,*queue[s],(s+1<stages.Size()) ? queue[s+1] : null<Queue*>());
+   worker[s]->Run();
+  }
+
+
+ // Feed in the jobs, waiting for space in the budget before each one...
+  nat32 fed = 0;
+  for (nat32 i=0;i<jobs.Size();i++)
+  {
+   if (jobs[i].done) continue;
+
+   nat64 reserve = 0;
+   while (true)
+   {
+    bit go = false;
+    lock.Lock();
+     if ((active==0)||(measured&&(active<inFlight)&&(used+estimate<=memory)))
+     {
+      go = true;
+      active += 1;
+      reserve = estimate;
+      used += reserve;
+      peak = math::Max(peak,used);
+     }
+    lock.Unlock();
+
+    if (go) break;
+    finished.Get();
+   }
+
+   prog->Report(fed++,todo);
+
+   BatchJob * job = new BatchJob();
+   job->index = i;
+   job->core = &core;
+   job->leftFn = jobs[i].leftFn;
+   job->rightFn = jobs[i].rightFn;
+   job->outFn = jobs[i].outFn;
+   job->pair = jobs[i].pair;
+   job->charged = reserve;
+
+   queue[0]->Push(job);
+  }
+  queue[0]->Push(null<BatchJob*>());
+
+
+ // Wait for them to drain, then clean up...
+  for (nat32 s=0;s<stages.Size();s++) worker[s]->Wait();
+  wallTime = time::MilliTime() - start;
+
+  for (nat32 s=0;s<stages.Size();s++)
+  {
+   delete worker[s];
+   delete queue[s];
+  }
+
+
+ // Report...
+  LogDebug("[batch] {jobs,failures,seconds,peak bytes}" << LogDiv() << todo << LogDiv() << Failures()
+           << LogDiv() << WallTime() << LogDiv() << peak);
+  for (nat32 s=0;s<stages.Size();s++)
+  {
+   LogDebug("[batch] stage {name,jobs,seconds,jobs per second}" << LogDiv() << stages[s]->Name() << LogDiv()
+            << stageJobs[s] << LogDiv() << StageTime(s) << LogDiv() << StageThroughput(s));
+  }
+
+ prog->Pop();
+}
+
+nat32 Batch::Failures() const
+{
+ nat32 ret = 0;
+ for (nat32 i=0;i<jobs.Size();i++)
+ {
+  if (jobs[i].failed) ret += 1;
+ }
+ return ret;
+}
+
+real32 Batch::StageThroughput(nat32 s) const
+{
+ if (stageTime[s]==0) return math::Infinity<real32>();
+ return real32(stageJobs[s])/StageTime(s);
+}
+
+void Batch::Charge(BatchJob & job)
+{
+ nat64 bytes = job.Bytes();
+
+ lock.Lock();
+  estimate = math::Max(estimate,bytes);
+  if (bytes>job.charged)
+  {
+   used += bytes - job.charged;
+   job.charged = bytes;
+   peak = math::Max(peak,used);
+  }
+ lock.Unlock();
+}
+
+void Batch::Finish(BatchJob * job,bit failed)
+{
+ lock.Lock();
+  used -= job->charged;
+  active -= 1;
+  jobs[job->index].done = true;
+  jobs[job->index].failed = failed;
+  if (!failed) measured = true;
+ lock.Unlock();
+
+ delete job;
+ finished.Add();
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,395 @@
+#ifndef EOS_STEREO_BATCH_H
+#define EOS_STEREO_BATCH_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file batch.h
+/// Provides a pipeline for running stereo over large numbers of image pairs,
+/// so the loading, rectification, matching and saving of different pairs can
+/// all happen at once.
+
+#include "eos/types.h"
+#include "eos/str/strings.h"
+#include "eos/ds/arrays.h"
+#include "eos/svt/core.h"
+#include "eos/svt/var.h"
+#include "eos/cam/files.h"
+#include "eos/cam/rig_cache.h"
+#include "eos/mt/locks.h"
+#include "eos/stereo/coarse_to_fine.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+/// Everything to do with a single image pair as it goes through a Batch. The
+/// stages fill in the Var's as they go, which are deleted with the job.
+class EOS_CLASS BatchJob
+{
+ public:
+  /// &nbsp;
+   BatchJob();
+
+  /// &nbsp;
+   ~BatchJob();
+
+
+  /// Returns how many bytes the Var's of the job are currently using.
+   nat64 Bytes() const;
+
+
+  /// Position in the batch.
+   nat32 index;
+
+  /// The core to make Var's with.
+   svt::Core * core;
+
+  /// Image filenames and the filename to save the result to.
+   str::String leftFn;
+   str::String rightFn;
+   str::String outFn;
+
+  /// The calibration, which stages update as they change the images.
+   cam::CameraPair pair;
+
+  /// The images, with an "rgb" field and optionally a "mask" field, then
+  /// whatever other fields the stages add. null until loaded.
+   svt::Var * left;
+   svt::Var * right;
+
+  /// The result, with "disp" and "mask" fields. null until matched.
+   svt::Var * result;
+
+
+  /// &nbsp;
+   inline cstrconst TypeString() const {return "eos::stereo::BatchJob";}
+
+
+ private:
+  friend class Batch;
+  nat64 charged; // Bytes of the memory budget this job is holding.
+};
+
+//------------------------------------------------------------------------------
+/// The interface for a stage of a Batch. Each stage is run by its own thread,
+/// one job at a time, so Process need not be thread safe, but it will be
+/// running at the same time as the other stages, on other jobs.
+class EOS_CLASS BatchStage : public Deletable
+{
+ public:
+  /// &nbsp;
+   ~BatchStage() {}
+
+  /// Does the stage to the job, returning false on failure, in which case the
+  /// job skips all remaining stages.
+   virtual bit Process(BatchJob & job) = 0;
+
+  /// A short name for the stage, for reporting.
+   virtual cstrconst Name() const = 0;
+
+  /// &nbsp;
+   virtual cstrconst TypeString() const = 0;
+};
+
+//------------------------------------------------------------------------------
+/// Loads the two images, with DevIL, as "rgb" fields.
+class EOS_CLASS BatchLoad : public BatchStage
+{
+ public:
+  /// &nbsp;
+   ~BatchLoad();
+
+  /// &nbsp;
+   bit Process(BatchJob & job);
+
+  /// &nbsp;
+   cstrconst Name() const;
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+};
+
+//------------------------------------------------------------------------------
+/// Rectifies the images with cam::PlaneRectify, adding masks and updating the
+/// CameraPair as cyclops does. Pairs that are allready rectified are left
+/// alone unless forced. Keeps a cam::RigCache, so a run of pairs from the same
+/// rig, with the same image sizes, only works out the rectification once.
+class EOS_CLASS BatchRectify : public BatchStage
+{
+ public:
+  /// Parameters are whether to rectify allready rectified pairs and the
+  /// samples given to PlaneRectify.
+   BatchRectify(bit force = false,nat32 samples = 1);
+
+  /// &nbsp;
+   ~BatchRectify();
+
+  /// &nbsp;
+   bit Process(BatchJob & job);
+
+  /// &nbsp;
+   cstrconst Name() const;
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  bit force;
+  nat32 samples;
+  cam::RigCache cache;
+};
+
+//------------------------------------------------------------------------------
+/// Does the stereo matching, using CoarseToFine with the given LevelSolver
+/// and a SqrBoundLuvDSC, as used by cyclops for its BP algorithms. Adds "luv"
+/// fields to the images and creates the result. Optionally left-right checks
+/// the result, with the failures filled in using CrossCheck.
+class EOS_CLASS BatchMatch : public BatchStage
+{
+ public:
+  /// The solver is cloned.
+   BatchMatch(const LevelSolver & solver);
+
+  /// &nbsp;
+   ~BatchMatch();
+
+
+  /// Sets the inclusive disparity range, defaults to [-32,32].
+   void SetRange(int32 minDisp,int32 maxDisp);
+
+  /// Sets how many reduced resolution levels CoarseToFine uses, defaults to 2.
+   void SetLevels(nat32 levels);
+
+  /// Sets the DSC's multiplier and cap, default to 1 and 36.
+   void SetCost(real32 mult,real32 cap);
+
+  /// Sets if a left-right check is done, and its tolerance. Defaults to
+  /// false and 1.0. Doubles the matching time when on.
+   void SetCheck(bit enable,real32 tol = 1.0);
+
+
+  /// &nbsp;
+   bit Process(BatchJob & job);
+
+  /// &nbsp;
+   cstrconst Name() const;
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  LevelSolver * solver;
+  int32 minDisp;
+  int32 maxDisp;
+  nat32 levels;
+  real32 mult;
+  real32 cap;
+  bit check;
+  real32 tol;
+};
+
+//------------------------------------------------------------------------------
+/// Refines the result with DiffCorrRefine, the cyclops polynomial fitting
+/// refinement. Must come after a BatchMatch.
+class EOS_CLASS BatchRefine : public BatchStage
+{
+ public:
+  /// Parameters as for DiffCorrRefine::SetDiff and DiffCorrRefine::SetDist.
+   BatchRefine(real32 distMult = 0.01,nat32 diffSteps = 7,real32 distCap = 64.0,real32 prune = 0.25);
+
+  /// &nbsp;
+   ~BatchRefine();
+
+  /// &nbsp;
+   bit Process(BatchJob & job);
+
+  /// &nbsp;
+   cstrconst Name() const;
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  real32 distMult;
+  nat32 diffSteps;
+  real32 distCap;
+  real32 prune;
+};
+
+//------------------------------------------------------------------------------
+/// Saves the result as an svt file, overwriting, and optionally the CameraPair
+/// alongside it, with .pcc appended to the filename. Deletes the images first,
+/// as they are no longer needed.
+class EOS_CLASS BatchSave : public BatchStage
+{
+ public:
+  /// &nbsp;
+   BatchSave(bit savePair = true);
+
+  /// &nbsp;
+   ~BatchSave();
+
+  /// &nbsp;
+   bit Process(BatchJob & job);
+
+  /// &nbsp;
+   cstrconst Name() const;
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  bit savePair;
+};
+
+//------------------------------------------------------------------------------
+/// Runs a list of image pairs through a sequence of stages, typically
+/// BatchLoad, BatchRectify, BatchMatch, BatchRefine then BatchSave. Each stage
+/// gets its own thread, with bounded queues between them, so whilst one pair
+/// is being matched the next can be loaded and the last saved - the matching
+/// stages use the task pool for their own threading, whilst decoding and
+/// writing leave it free.
+///
+/// Limits how many pairs are in flight at once and how much memory their Var's
+/// can use - a new pair is only started if the largest job seen so far would
+/// fit in what remains of the budget. (Temporary memory used inside the stages
+/// is not counted.) Until the first pair has got through every stage there is
+/// nothing to go on, so only one pair is in flight. One pair is always allowed,
+/// so a budget too small for a single pair just makes it run sequentially.
+///
+/// Records the number of jobs and busy time of every stage, for reporting
+/// throughput.
+class EOS_CLASS Batch
+{
+ public:
+  /// The core is used for all the Var's made.
+   Batch(svt::Core & core);
+
+  /// &nbsp;
+   ~Batch();
+
+
+  /// Adds a stage to the end of the pipeline, which this object then owns.
+   void Add(BatchStage * stage);
+
+  /// Adds an image pair to be processed, with its calibration and the filename
+  /// to save to.
+   void Add(const str::String & leftFn,const str::String & rightFn,const cam::CameraPair & pair,const str::String & outFn);
+
+  /// Sets the most pairs in flight at once, defaults to 3.
+   void SetInFlight(nat32 count);
+
+  /// Sets the memory budget in bytes, defaults to 512 meg.
+   void SetMemory(nat64 bytes);
+
+  /// Sets how many jobs can wait between each pair of stages, defaults to 1.
+   void SetQueue(nat32 size);
+
+
+  /// Runs every pair through every stage, returning when they are all done.
+  /// Can be called again after adding more pairs, only new pairs are done.
+   void Run(time::Progress * prog = null<time::Progress*>());
+
+
+  /// Returns how many pairs have been added.
+   nat32 Jobs() const {return jobs.Size();}
+
+  /// Returns true if a pair failed at some stage.
+   bit Failed(nat32 job) const {return jobs[job].failed;}
+
+  /// Returns how many pairs failed.
+   nat32 Failures() const;
+
+
+  /// Returns how many stages there are.
+   nat32 Stages() const {return stages.Size();}
+
+  /// Returns the name of a stage.
+   cstrconst StageName(nat32 s) const {return stages[s]->Name();}
+
+  /// Returns how many pairs a stage has processed in the last Run.
+   nat32 StageJobs(nat32 s) const {return stageJobs[s];}
+
+  /// Returns how many seconds a stage spent working in the last Run.
+   real32 StageTime(nat32 s) const {return real32(stageTime[s])/1000.0;}
+
+  /// Returns the pairs per second a stage could manage on its own, from the
+  /// last Run.
+   real32 StageThroughput(nat32 s) const;
+
+  /// Returns how many seconds the last Run took, start to finish.
+   real32 WallTime() const {return real32(wallTime)/1000.0;}
+
+  /// Returns the most memory the jobs held at once during the last Run.
+   nat64 PeakMemory() const {return peak;}
+
+
+  /// &nbsp;
+   inline cstrconst TypeString() const {return "eos::stereo::Batch";}
+
+
+ private:
+  svt::Core & core;
+  ds::Array<BatchStage*> stages;
+
+  struct Input
+  {
+   str::String leftFn;
+   str::String rightFn;
+   str::String outFn;
+   cam::CameraPair pair;
+   bit done;
+   bit failed;
+  };
+  ds::ArrayDel<Input> jobs;
+
+  nat32 inFlight;
+  nat64 memory;
+  nat32 queueSize;
+
+  ds::Array<nat32> stageJobs;
+  ds::Array<nat64> stageTime;
+  nat64 wallTime;
+  nat64 peak;
+
+  // Run time state, shared between the threads and protected by lock...
+   mt::OwnedLock lock;
+   mt::EventLock finished; // An event every time a job leaves the pipeline.
+   nat32 active;
+   nat64 used;
+   nat64 estimate;
+   bit measured; // true once a job has been through every stage, so estimate can be trusted.
+
+  // Called by the workers after each stage, to update the accounting...
+   void Charge(BatchJob & job);
+   void Finish(BatchJob * job,bit failed);
+
+  class Queue;
+  class Worker;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
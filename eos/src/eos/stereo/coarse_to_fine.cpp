@@ -0,0 +1,309 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/stereo/coarse_to_fine.h"
+
+#include "eos/stereo/ebp.h"
+#include "eos/stereo/sgm.h"
+#include "eos/math/functions.h"
+#include "eos/time/times.h"
+#include "eos/file/csv.h"
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+EBPSolver::EBPSolver(real32 ocb,real32 ocm,real32 olm,nat32 i)
+:occCostBase(ocb),occCostMult(ocm),occLimMult(olm),iters(i),parallel(false),dscOcc(null<DSC*>())
+{}
+
+EBPSolver::~EBPSolver()
+{
+ delete dscOcc;
+}
+
+LevelSolver * EBPSolver::Clone() const
+{
+ EBPSolver * ret = new EBPSolver(occCostBase,occCostMult,occLimMult,iters);
+ ret->parallel = parallel;
+ if (dscOcc) ret->dscOcc = dscOcc->Clone();
+ return ret;
+}
+
+void EBPSolver::SetOcc(const DSC * dsc)
+{
+ delete dscOcc;
+ dscOcc = dsc ? dsc->Clone() : null<DSC*>();
+}
+
+void EBPSolver::SetParallel(bit enable)
+{
+ parallel = enable;
+}
+
+DSI * EBPSolver::Solve(const DSC & dsc,DSR & dsr,const svt::Field<bit> & leftMask,
+                       const svt::Field<bit> & rightMask,time::Progress * prog) const
+{
+ EBP * ret = new EBP();
+ ret->Set(occCostBase,occCostMult,occLimMult,iters,1);
+ ret->Set(&dsr);
+ ret->Set(&dsc);
+
+ // The occlusion DSC is at full resolution, so only use it when the sizes agree...
+  if (dscOcc&&(dscOcc->WidthLeft()==dsc.WidthLeft())&&(dscOcc->HeightLeft()==dsc.HeightLeft()))
+  {
+   ret->SetOcc(dscOcc);
+  }
+
+ if (parallel) ret->SetParallel();
+ ret->Run(prog);
+ return ret;
+}
+
+cstrconst EBPSolver::TypeString() const
+{
+ return "eos::stereo::EBPSolver";
+}
+
+//------------------------------------------------------------------------------
+SGMSolver::SGMSolver(real32 pp1,real32 pp2,real32 c,nat32 p)
+:p1(pp1),p2(pp2),cap(c),paths(p)
+{}
+
+SGMSolver::~SGMSolver()
+{}
+
+LevelSolver * SGMSolver::Clone() const
+{
+ return new SGMSolver(p1,p2,cap,paths);
+}
+
+DSI * SGMSolver::Solve(const DSC & dsc,DSR & dsr,const svt::Field<bit> & leftMask,
+                       const svt::Field<bit> & rightMask,time::Progress * prog) const
+{
+ SGM * ret = new SGM();
+ ret->Set(&dsc);
+ ret->Set(&dsr);
+ ret->Set(leftMask,rightMask);
+ ret->SetSmooth(p1,p2);
+ ret->SetCost(cap);
+ ret->SetPaths(paths);
+ ret->Run(prog);
+ return ret;
+}
+
+cstrconst SGMSolver::TypeString() const
+{
+ return "eos::stereo::SGMSolver";
+}
+
+//------------------------------------------------------------------------------
+CoarseToFine::CoarseToFine()
+:dsc(null<DSC*>()),solver(null<LevelSolver*>()),minDisp(-32),maxDisp(32),levels(2),grow(2),spread(1),
+result(null<DSI*>())
+{}
+
+CoarseToFine::~CoarseToFine()
+{
+ delete dsc;
+ delete solver;
+ delete result;
+}
+
+void CoarseToFine::Set(const DSC * d)
+{
+ delete dsc;
+ dsc = d->Clone();
+}
+
+void CoarseToFine::Set(const svt::Field<bit> & lm,const svt::Field<bit> & rm)
+{
+ leftMask = lm;
+ rightMask = rm;
+}
+
+void CoarseToFine::Set(const LevelSolver * s)
+{
+ delete solver;
+ solver = s->Clone();
+}
+
+void CoarseToFine::SetRange(int32 minD,int32 maxD)
+{
+ minDisp = math::Min(minD,maxD);
+ maxDisp = math::Max(minD,maxD);
+}
+
+void CoarseToFine::SetLevels(nat32 l)
+{
+ levels = l;
+}
+
+void CoarseToFine::SetGrow(nat32 g,nat32 s)
+{
+ grow = g;
+ spread = s;
+}
+
+void CoarseToFine::Run(time::Progress * prog)
+{
+ LogBlock("eos::stereo::CoarseToFine::Run","");
+ mem::MemScope memScope("eos::stereo::CoarseToFine");
+ prog->Push("eos::stereo::CoarseToFine::Run");
+
+ delete result;
+ result = null<DSI*>();
+
+ // Build the hierarchy, if needed...
+  HierarchyDSC hier;
+  nat32 top = levels;
+  if (top>0)
+  {
+   hier.Set(*dsc,leftMask,rightMask);
+   top = math::Min(top,hier.Levels()-1);
+  }
+  times.Size(top+1);
+  volumes.Size(top+1);
+
+
+ // Do each level in turn, coarsest first...
+  DSI * prev = null<DSI*>();
+  for (int32 l=top;l>=0;l--)
+  {
+   prog->Report(top-l,top+1);
+   nat64 start = time::MilliTime();
+
+   const DSC & d = (l==0) ? *dsc : hier.Level(l);
+   svt::Field<bit> lm = (l==0) ? leftMask : hier.LeftMask(l);
+   svt::Field<bit> rm = (l==0) ? rightMask : hier.RightMask(l);
+
+   DSR * dsr;
+   if (prev==null<DSI*>())
+   {
+    RangeDSR * rdsr = new RangeDSR(d.WidthLeft(),d.HeightLeft());
+    rdsr->Set(int32(math::RoundDown(real32(minDisp)/real32(1<<l))),
+              int32(math::RoundUp(real32(maxDisp)/real32(1<<l))));
+    dsr = rdsr;
+   }
+   else
+   {
+    dsr = Upscale(*prev,d.WidthLeft(),d.HeightLeft(),l,lm);
+    delete prev;
+   }
+   volumes[l] = dsr->Matches();
+
+   prev = solver->Solve(d,*dsr,lm,rm,prog);
+   delete dsr;
+
+   times[l] = nat32(time::MilliTime() - start);
+   LogDebug("[coarse to fine] {level,width,height,volume,ms}" << LogDiv()
+            << l << LogDiv() << d.WidthLeft() << LogDiv() << d.HeightLeft() << LogDiv()
+            << volumes[l] << LogDiv() << times[l]);
+  }
+  result = prev;
+
+ prog->Pop();
+}
+
+nat32 CoarseToFine::FullVolume() const
+{
+ return dsc->WidthLeft() * dsc->HeightLeft() * nat32(maxDisp - minDisp + 1);
+}
+
+nat32 CoarseToFine::Width() const
+{
+ return result->Width();
+}
+
+nat32 CoarseToFine::Height() const
+{
+ return result->Height();
+}
+
+nat32 CoarseToFine::Size(nat32 x, nat32 y) const
+{
+ return result->Size(x,y);
+}
+
+real32 CoarseToFine::Disp(nat32 x, nat32 y, nat32 i) const
+{
+ return result->Disp(x,y,i);
+}
+
+real32 CoarseToFine::Cost(nat32 x, nat32 y, nat32 i) const
+{
+ return result->Cost(x,y,i);
+}
+
+real32 CoarseToFine::DispWidth(nat32 x, nat32 y, nat32 i) const
+{
+ return result->DispWidth(x,y,i);
+}
+
+cstrconst CoarseToFine::TypeString() const
+{
+ return "eos::stereo::CoarseToFine";
+}
+
+BasicDSR * CoarseToFine::Upscale(const DSI & coarse,nat32 width,nat32 height,nat32 level,const svt::Field<bit> & mask) const
+{
+ BasicDSR * ret = new BasicDSR(width,height);
+
+ // The range allowed at this level...
+  int32 low = int32(math::RoundDown(real32(minDisp)/real32(1<<level)));
+  int32 high = int32(math::RoundUp(real32(maxDisp)/real32(1<<level)));
+
+ // Each pixel gets the union of the doubled ranges of the coarse pixels in a
+ // window arround its parent, grown...
+  int32 cw = coarse.Width();
+  int32 ch = coarse.Height();
+  int32 sr = spread;
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    if (mask.Valid()&&(!mask.Get(x,y))) continue;
+
+    int32 px = math::Min<int32>(x/2,cw-1);
+    int32 py = math::Min<int32>(y/2,ch-1);
+    for (int32 v=math::Max<int32>(py-sr,0);v<=math::Min<int32>(py+sr,ch-1);v++)
+    {
+     for (int32 u=math::Max<int32>(px-sr,0);u<=math::Min<int32>(px+sr,cw-1);u++)
+     {
+      for (nat32 i=0;i<coarse.Size(u,v);i++)
+      {
+       real32 d = 2.0*coarse.Disp(u,v,i);
+       real32 w = 2.0*coarse.DispWidth(u,v,i);
+       int32 start = int32(math::RoundDown(d - w + 0.5)) - int32(grow);
+       int32 end = int32(math::RoundUp(d + w - 0.5)) + int32(grow);
+
+       start = math::Max(start,low);
+       end = math::Min(end,high);
+       if (start<=end) ret->Add(x,y,start,end);
+      }
+     }
+    }
+   }
+  }
+
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,244 @@
+#ifndef EOS_STEREO_COARSE_TO_FINE_H
+#define EOS_STEREO_COARSE_TO_FINE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file coarse_to_fine.h
+/// Provides a pipeline that runs a stereo algorithm at reduced resolutions to
+/// work out the disparity ranges worth searching at full resolution.
+
+#include "eos/types.h"
+
+#include "eos/stereo/dsi.h"
+#include "eos/stereo/dsr.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+/// The interface CoarseToFine uses to run a stereo algorithm at each level -
+/// given a DSC, a DSR of ranges to search and masks it must return a new DSI,
+/// which the caller then owns.
+class EOS_CLASS LevelSolver : public Deletable
+{
+ public:
+  /// &nbsp;
+   ~LevelSolver() {}
+
+  /// &nbsp;
+   virtual LevelSolver * Clone() const = 0;
+
+  /// Runs the algorithm, returning the result. The masks may be invalid.
+   virtual DSI * Solve(const DSC & dsc,DSR & dsr,const svt::Field<bit> & leftMask,
+                       const svt::Field<bit> & rightMask,time::Progress * prog) const = 0;
+
+  /// &nbsp;
+   virtual cstrconst TypeString() const = 0;
+};
+
+//------------------------------------------------------------------------------
+/// A LevelSolver that uses EBP, which only ever visits the disparities in the
+/// given ranges.
+class EOS_CLASS EBPSolver : public LevelSolver
+{
+ public:
+  /// Parameters as for EBP::Set, with the exception of outCount which is
+  /// always 1.
+   EBPSolver(real32 occCostBase = 1.0,real32 occCostMult = -0.1,real32 occLimMult = 2.0,nat32 iters = 8);
+
+  /// &nbsp;
+   ~EBPSolver();
+
+  /// &nbsp;
+   LevelSolver * Clone() const;
+
+  /// Sets the DSC for calculating occlusion costs, cloned. Optional, as for
+  /// EBP::SetOcc, but note that its given at full resolution and will be used
+  /// at all levels.
+   void SetOcc(const DSC * dsc);
+
+  /// Switches on EBP's multi-threaded mode.
+   void SetParallel(bit enable = true);
+
+
+  /// &nbsp;
+   DSI * Solve(const DSC & dsc,DSR & dsr,const svt::Field<bit> & leftMask,
+               const svt::Field<bit> & rightMask,time::Progress * prog) const;
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  real32 occCostBase;
+  real32 occCostMult;
+  real32 occLimMult;
+  nat32 iters;
+  bit parallel;
+  DSC * dscOcc;
+};
+
+//------------------------------------------------------------------------------
+/// A LevelSolver that uses SGM. SGM aggregates over every disparity between
+/// the extremes of the DSR, so only the calls to the DSC are saved.
+class EOS_CLASS SGMSolver : public LevelSolver
+{
+ public:
+  /// Parameters as for SGM::SetSmooth, SGM::SetCost and SGM::SetPaths.
+   SGMSolver(real32 p1 = 1.0,real32 p2 = 8.0,real32 cap = 32.0,nat32 paths = 8);
+
+  /// &nbsp;
+   ~SGMSolver();
+
+  /// &nbsp;
+   LevelSolver * Clone() const;
+
+
+  /// &nbsp;
+   DSI * Solve(const DSC & dsc,DSR & dsr,const svt::Field<bit> & leftMask,
+               const svt::Field<bit> & rightMask,time::Progress * prog) const;
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  real32 p1;
+  real32 p2;
+  real32 cap;
+  nat32 paths;
+};
+
+//------------------------------------------------------------------------------
+/// Coarse to fine disparity range pruning. The given LevelSolver is run on the
+/// DSC at reduced resolutions, by default 1/4 and then 1/2, using a
+/// HierarchyDSC to make the smaller DSCs. The coarsest level searches the
+/// entire disparity range, scaled down; the result of each level is then
+/// turned into a BasicDSR for the next, each disparity covering its
+/// footprint, unioned over a small window of neighbours and grown, so only a
+/// small band arround the coarse solution gets searched. The full resolution
+/// pass is then run with this, and is the output of this object. With a wide
+/// disparity range the full resolution search ends up being a small fraction
+/// of the full volume.
+///
+/// Records how long each level took and how many disparities were searched,
+/// to see how well its working.
+class EOS_CLASS CoarseToFine : public DSI
+{
+ public:
+  /// &nbsp;
+   CoarseToFine();
+
+  /// &nbsp;
+   ~CoarseToFine();
+
+
+  /// Sets the DSC, cloned. Must be called before Run.
+   void Set(const DSC * dsc);
+
+  /// Optional, sets the masks.
+   void Set(const svt::Field<bit> & leftMask,const svt::Field<bit> & rightMask);
+
+  /// Sets the algorithm to run at each level, cloned. Must be called before Run.
+   void Set(const LevelSolver * solver);
+
+  /// Sets the inclusive disparity range for the full resolution image,
+  /// defaults to [-32,32].
+   void SetRange(int32 minDisp,int32 maxDisp);
+
+  /// Sets how many reduced resolution levels to do, each half the last.
+  /// Defaults to 2, for 1/4 and 1/2. 0 just runs at full resolution with the
+  /// full range.
+   void SetLevels(nat32 levels);
+
+  /// Sets how many disparities to grow each coarse range by when moving to
+  /// the next level, after scaling, and the radius of the window of coarse
+  /// pixels whose ranges are unioned. Defaults to 2 and 1.
+   void SetGrow(nat32 grow,nat32 spread = 1);
+
+
+  /// Runs the pipeline.
+   void Run(time::Progress * prog = null<time::Progress*>());
+
+
+  /// Returns how many levels were run, including full resolution, after
+  /// limiting by the image size. Level 0 is full resolution.
+   nat32 Levels() const {return times.Size();}
+
+  /// Returns how many milliseconds a level took, including building its DSR.
+   nat32 Time(nat32 level) const {return times[level];}
+
+  /// Returns how many pixel/disparity pairs were searched at a level.
+   nat32 Volume(nat32 level) const {return volumes[level];}
+
+  /// Returns how many pixel/disparity pairs a full resolution search of the
+  /// entire range would have, for comparison with Volume(0).
+   nat32 FullVolume() const;
+
+
+  /// &nbsp;
+   nat32 Width() const;
+
+  /// &nbsp;
+   nat32 Height() const;
+
+  /// &nbsp;
+   nat32 Size(nat32 x, nat32 y) const;
+
+  /// &nbsp;
+   real32 Disp(nat32 x, nat32 y, nat32 i) const;
+
+  /// &nbsp;
+   real32 Cost(nat32 x, nat32 y, nat32 i) const;
+
+  /// &nbsp;
+   real32 DispWidth(nat32 x, nat32 y, nat32 i) const;
+
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  // Input...
+   DSC * dsc;
+   LevelSolver * solver;
+   svt::Field<bit> leftMask;
+   svt::Field<bit> rightMask;
+
+   int32 minDisp;
+   int32 maxDisp;
+   nat32 levels;
+   nat32 grow;
+   nat32 spread;
+
+  // Output...
+   DSI * result;
+   ds::Array<nat32> times;
+   ds::Array<nat32> volumes;
+
+  // Makes the DSR for a level from the result of the level above...
+   BasicDSR * Upscale(const DSI & coarse,nat32 width,nat32 height,nat32 level,const svt::Field<bit> & mask) const;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
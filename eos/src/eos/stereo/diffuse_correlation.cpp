@@ -19,6 +19,8 @@
 
 #include "eos/ds/sort_lists.h"
 #include "eos/ds/priority_queues.h"
+#include "eos/mt/tasks.h"
+#include "eos/str/functions.h"
 #include "eos/file/csv.h"
 
 namespace eos
@@ -92,6 +94,56 @@ void DiffusionWeight::Create(const bs::LuvRangeImage & img, const bs::LuvRangeDi
  prog->Pop();
 }
 
+//------------------------------------------------------------------------------
+DiffusionCache::DiffusionCache()
+:haveImage(false),useHalfX(false),useHalfY(false),useCorners(false),
+haveWeight(false),distType(null<cstrconst>()),distMult(0.0),builds(0)
+{}
+
+DiffusionCache::~DiffusionCache()
+{}
+
+void DiffusionCache::Set(const svt::Field<bs::ColourLuv> & i,const svt::Field<bit> & m)
+{
+ if ((img==i)&&(mask==m)) return;
+
+ img = i;
+ mask = m;
+ haveImage = false;
+ haveWeight = false;
+}
+
+const bs::LuvRangeImage & DiffusionCache::Image(bit hx,bit hy,bit c)
+{
+ if ((!haveImage)||(useHalfX!=hx)||(useHalfY!=hy)||(useCorners!=c))
+ {
+  image.Create(img,mask,hx,hy,c);
+  haveImage = true;
+  haveWeight = false;
+  useHalfX = hx;
+  useHalfY = hy;
+  useCorners = c;
+ }
+
+ return image;
+}
+
+const DiffusionWeight & DiffusionCache::Weight(bit hx,bit hy,bit c,const bs::LuvRangeDist & dist,real32 dm,time::Progress * prog)
+{
+ const bs::LuvRangeImage & im = Image(hx,hy,c);
+
+ if ((!haveWeight)||(!math::Equal(distMult,dm))||(str::Compare(distType,dist.TypeString())!=0))
+ {
+  weight.Create(im,dist,dm,prog);
+  haveWeight = true;
+  distType = dist.TypeString();
+  distMult = dm;
+  builds += 1;
+ }
+
+ return weight;
+}
+
 //------------------------------------------------------------------------------
 RangeDiffusionSlice::RangeDiffusionSlice()
 :steps(0)
@@ -101,6 +153,11 @@ RangeDiffusionSlice::~RangeDiffusionSlice()
 {}
 
 void RangeDiffusionSlice::Create(nat32 yy, nat32 stps, const bs::LuvRangeImage & img, const DiffusionWeight & dw, time::Progress * prog)
+{
+ Create(yy,stps,img,dw,0,img.Width(),prog);
+}
+
+void RangeDiffusionSlice::Create(nat32 yy, nat32 stps, const bs::LuvRangeImage & img, const DiffusionWeight & dw, nat32 x0, nat32 x1, time::Progress * prog)
 {
  prog->Push();
  
@@ -143,7 +200,7 @@ void RangeDiffusionSlice::Create(nat32 yy, nat32 stps, const bs::LuvRangeImage &
   {
    prog->Report(x+1,img.Width()+1);
    
-   if (!img.Valid(x,y))
+   if ((x<x0)||(x>=x1)||(!img.Valid(x,y)))
    {
     for (nat32 v=0;v<valueCount;v++)  data.Get(x,v) = 0.0;
     continue;
@@ -304,7 +361,8 @@ real32 DiffuseCorrelation::DistanceCap() const
 
 //------------------------------------------------------------------------------
 DiffusionCorrelationImage::DiffusionCorrelationImage()
-:distMult(1.0),minimaLimit(8),baseDistCap(1.0),distCapMult(2.0),distCapThreshold(0.5),range(2),steps(5)
+:leftBase(null<DiffusionWeight*>()),rightBase(null<DiffusionWeight*>()),
+distMult(1.0),minimaLimit(8),baseDistCap(1.0),distCapMult(2.0),distCapThreshold(0.5),range(2),steps(5)
 {}
 
 DiffusionCorrelationImage::~DiffusionCorrelationImage()
@@ -328,26 +386,191 @@ void DiffusionCorrelationImage::Set(nat32 ml, real32 bdc, real32 dcm, real32 dct
  steps = s;
 }
 
+void DiffusionCorrelationImage::SetBase(const DiffusionWeight * l,const DiffusionWeight * r)
+{
+ leftBase = l;
+ rightBase = r;
+}
+
+//------------------------------------------------------------------------------
+// Does every pairing in each row of the coarsest level, writing the matches
+// for each row to its own array...
+class DiffusionCorrelationImage::CoarseRows
+{
+ public:
+  CoarseRows(const DiffusionCorrelationImage & s,const bs::LuvRangeImage & li,const DiffusionWeight & lw,
+             const bs::LuvRangeImage & ri,const DiffusionWeight & rw,real32 dc,ds::ArrayDel< ds::Array<Match> > & o)
+  :self(s),leftImg(li),leftDiff(lw),rightImg(ri),rightDiff(rw),distCap(dc),out(o)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   RangeDiffusionSlice leftSlice;
+   RangeDiffusionSlice rightSlice;
+   DiffuseCorrelation dc;
+
+   for (nat32 y=begin;y<end;y++)
+   {
+    leftSlice.Create(y,self.steps,leftImg,leftDiff);
+    rightSlice.Create(y,self.steps,rightImg,rightDiff);
+    dc.Setup(*self.dist,distCap,leftImg,leftSlice,rightImg,rightSlice);
+
+    ds::Array<Match> & targ = out[y];
+    targ.Size(leftImg.Width()*rightImg.Width());
+    for (nat32 xLeft=0;xLeft<leftImg.Width();xLeft++)
+    {
+     for (nat32 xRight=0;xRight<rightImg.Width();xRight++)
+     {
+      Match & m = targ[xLeft*rightImg.Width() + xRight];
+      m.y = y;
+      m.xLeft = xLeft;
+      m.xRight = xRight;
+      m.score = dc.Cost(xLeft,xRight);
+     }
+    }
+   }
+  }
+
+
+ private:
+  const DiffusionCorrelationImage & self;
+  const bs::LuvRangeImage & leftImg;
+  const DiffusionWeight & leftDiff;
+  const bs::LuvRangeImage & rightImg;
+  const DiffusionWeight & rightDiff;
+  real32 distCap;
+  ds::ArrayDel< ds::Array<Match> > & out;
+};
+
+// Given the matches passed down from the level above, arranged into groups that
+// share a y coordinate, calculates the correlations arround them at the current
+// level. Groups produce disjoint rows, so each is done alone, with its own
+// list to avoid duplicates, and written to its own array...
+class DiffusionCorrelationImage::FineRows
+{
+ public:
+  FineRows(const DiffusionCorrelationImage & s,const bs::LuvRangeImage & li,const DiffusionWeight & lw,
+           const bs::LuvRangeImage & ri,const DiffusionWeight & rw,real32 dc,
+           const ds::Array<Match> & c,const ds::Array<nat32> & g,ds::ArrayDel< ds::Array<Match> > & o)
+  :self(s),leftImg(li),leftDiff(lw),rightImg(ri),rightDiff(rw),distCap(dc),cand(c),group(g),out(o)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   RangeDiffusionSlice leftSliceLow;
+   RangeDiffusionSlice leftSliceHigh;
+   RangeDiffusionSlice rightSliceLow;
+   RangeDiffusionSlice rightSliceHigh;
+   DiffuseCorrelation dcLow;
+   DiffuseCorrelation dcHigh;
+   bit halfHeight = self.left->HalfHeight();
+
+   for (nat32 g=begin;g<end;g++)
+   {
+    // Setup the slices for the row(s)...
+     int32 y = cand[group[g]].y;
+     if (halfHeight)
+     {
+      leftSliceLow.Create(y*2,self.steps,leftImg,leftDiff);
+      rightSliceLow.Create(y*2,self.steps,rightImg,rightDiff);
+      dcLow.Setup(*self.dist,distCap,leftImg,leftSliceLow,rightImg,rightSliceLow);
+
+      if (y*2+1<int32(leftImg.Height()))
+      {
+       leftSliceHigh.Create(y*2+1,self.steps,leftImg,leftDiff);
+       rightSliceHigh.Create(y*2+1,self.steps,rightImg,rightDiff);
+       dcHigh.Setup(*self.dist,distCap,leftImg,leftSliceHigh,rightImg,rightSliceHigh);
+      }
+     }
+     else
+     {
+      leftSliceLow.Create(y,self.steps,leftImg,leftDiff);
+      rightSliceLow.Create(y,self.steps,rightImg,rightDiff);
+      dcLow.Setup(*self.dist,distCap,leftImg,leftSliceLow,rightImg,rightSliceLow);
+     }
+
+    // Iterate the region arround each match in the current level, calculating
+    // correlation values where they currently don't exist...
+     ds::SortList<Match> found;
+     for (nat32 i=group[g];i<group[g+1];i++)
+     {
+      const Match & m = cand[i];
+      int32 lowLeftX = math::Clamp<int32>(m.xLeft*2-int32(self.range),0,leftImg.Width()-1);
+      int32 highLeftX = math::Clamp<int32>(m.xLeft*2+1+int32(self.range),0,leftImg.Width()-1);
+      int32 lowRightX = math::Clamp<int32>(m.xRight*2-int32(self.range),0,rightImg.Width()-1);
+      int32 highRightX = math::Clamp<int32>(m.xRight*2+1+int32(self.range),0,rightImg.Width()-1);
+
+      for (int32 xLeft=lowLeftX;xLeft<=highLeftX;xLeft++)
+      {
+       for (int32 xRight=lowRightX;xRight<=highRightX;xRight++)
+       {
+        Match mNew;
+        mNew.y = halfHeight ? m.y*2 : m.y;
+        mNew.xLeft = xLeft;
+        mNew.xRight = xRight;
+        if (found.Get(mNew)==null<Match*>())
+        {
+         mNew.score = dcLow.Cost(xLeft,xRight);
+         found.Add(mNew);
+        }
+
+        if (halfHeight)
+        {
+         mNew.y += 1;
+         if ((mNew.y<int32(leftImg.Height()))&&(found.Get(mNew)==null<Match*>()))
+         {
+          mNew.score = dcHigh.Cost(xLeft,xRight);
+          found.Add(mNew);
+         }
+        }
+       }
+      }
+     }
+
+    // Store...
+     ds::Array<Match> & targ = out[g];
+     targ.Size(found.Size());
+     if (found.Size()!=0)
+     {
+      nat32 j = 0;
+      ds::SortList<Match>::Cursor f = found.FrontPtr();
+      while (!f.Bad())
+      {
+       targ[j++] = *f;
+       ++f;
+      }
+     }
+   }
+  }
+
+
+ private:
+  const DiffusionCorrelationImage & self;
+  const bs::LuvRangeImage & leftImg;
+  const DiffusionWeight & leftDiff;
+  const bs::LuvRangeImage & rightImg;
+  const DiffusionWeight & rightDiff;
+  real32 distCap;
+  const ds::Array<Match> & cand;
+  const ds::Array<nat32> & group;
+  ds::ArrayDel< ds::Array<Match> > & out;
+};
+
+//------------------------------------------------------------------------------
 void DiffusionCorrelationImage::Run(time::Progress * prog)
 {
  prog->Push();
  
  // Find out how many levels we are going to do, construct the data structure to
- // store our state. Also make the correlation object ready for use.
+ // store our state.
   nat32 levels = math::Min(left->Levels(),right->Levels());
   nat32 step = 0;
-  nat32 steps = 4 + levels;
+  nat32 progSteps = 4 + levels;
   
   ds::ArrayDel< ds::SortList<Match> > matches(levels);
   
   DiffusionWeight leftDiff;
   DiffusionWeight rightDiff;
-  RangeDiffusionSlice leftSliceLow;
-  RangeDiffusionSlice leftSliceHigh;
-  RangeDiffusionSlice rightSliceLow;
-  RangeDiffusionSlice rightSliceHigh;
-  DiffuseCorrelation dcLow;
-  DiffuseCorrelation dcHigh;
   
   ds::Array<real32> distCap(levels);
   distCap[0] = baseDistCap;
@@ -355,148 +578,83 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
 
 
  // Create result for highest level - its low enough resolution that we can brute force...
-  prog->Report(step++,steps);
-  prog->Push();
-  prog->Report(0,left->Level(0).Height()+1);
+  prog->Report(step++,progSteps);
   
-  nat32 l = levels-1;  
-  leftDiff.Create(left->Level(l),*dist,distMult);
-  rightDiff.Create(right->Level(l),*dist,distMult);
-  
-  for (nat32 y=0;y<left->Level(l).Height();y++)
+  nat32 l = levels-1;
   {
-   prog->Report(y+1,left->Level(l).Height()+1);
-   leftSliceLow.Create(y,steps,left->Level(l),leftDiff);
-   rightSliceLow.Create(y,steps,right->Level(l),rightDiff);
-   dcLow.Setup(*dist,distCap[l],left->Level(l),leftSliceLow,right->Level(l),rightSliceLow);
+   const bs::LuvRangeImage & leftImg = left->Level(l);
+   const bs::LuvRangeImage & rightImg = right->Level(l);
+   const DiffusionWeight * lw = &leftDiff;
+   const DiffusionWeight * rw = &rightDiff;
+   if ((l==0)&&leftBase&&rightBase) {lw = leftBase; rw = rightBase;}
+   else
+   {
+    leftDiff.Create(leftImg,*dist,distMult);
+    rightDiff.Create(rightImg,*dist,distMult);
+   }
+   
+   ds::ArrayDel< ds::Array<Match> > rows(leftImg.Height());
+   CoarseRows coarse(*this,leftImg,*lw,rightImg,*rw,distCap[l],rows);
+   mt::ParallelFor(0,leftImg.Height(),coarse,1);
    
-   for (nat32 xLeft=0;xLeft<left->Level(l).Width();xLeft++)
+   for (nat32 y=0;y<rows.Size();y++)
    {
-    for (nat32 xRight=0;xRight<right->Level(l).Width();xRight++)
-    {
-     Match m;
-     m.y = y;
-     m.xLeft = xLeft;
-     m.xRight = xRight;
-     m.score = dcLow.Cost(xLeft,xRight);
-     
-     matches[l].Add(m);
-    }
+    for (nat32 i=0;i<rows[y].Size();i++) matches[l].Add(rows[y][i]);
    }
   }
-  prog->Pop();
 
 
  // Now iterate down to the lower levels, only considering pairings the higher
  // levels consider to be good enough...
-  while(true)
+  while(l!=0)
   {
-   prog->Report(step++,steps);
+   prog->Report(step++,progSteps);
    // Move to the level we need to proccess...
     l -= 1;
-    nat32 step2 = 0,steps2 = matches[l+1].Size()+1;
-    prog->Push();
-    prog->Report(step2++,steps2);
     
    // Get the images, setup the diffusion weights...
     const bs::LuvRangeImage & leftImg = left->Level(l);
     const bs::LuvRangeImage & rightImg = right->Level(l);
     
-    leftDiff.Create(leftImg,*dist,distMult);
-    rightDiff.Create(rightImg,*dist,distMult);
+    const DiffusionWeight * lw = &leftDiff;
+    const DiffusionWeight * rw = &rightDiff;
+    if ((l==0)&&leftBase&&rightBase) {lw = leftBase; rw = rightBase;}
+    else
+    {
+     leftDiff.Create(leftImg,*dist,distMult);
+     rightDiff.Create(rightImg,*dist,distMult);
+    }
     
-   // Iterate every match in the above layer...
-    int32 prevY = -1; // Dummy value, so we always reset for the first entry.
+   // Collect the matches in the above layer that are good enough, noting where
+   // each y coordinate starts - they come out of the sort list ordered by y...
     if (matches[l+1].Size()==0) break; // So we don't crash if the parameters are too fussy.
+    ds::Array<Match> cand(matches[l+1].Size());
+    ds::Array<nat32> group(matches[l+1].Size()+1);
+    nat32 candCount = 0;
+    nat32 groupCount = 0;
+    
     ds::SortList<Match>::Cursor targ = matches[l+1].FrontPtr();
     while (!targ.Bad())
     {
-     prog->Report(step2++,steps2);
-     
-     // Get the match...
-      Match & m = *targ;
-       
-     // Only consider this match if it is good enough...
-      if (m.score<(distCap[l+1]*distCapThreshold))
-      {
-       // If the match has a different y coordinate we need to recalculate the
-       // slices and update the correlation calculation objects...
-        if (m.y!=prevY)
-        {
-         prevY = m.y;
-         
-         if (left->HalfHeight())
-         {
-          leftSliceLow.Create(m.y*2,steps,leftImg,leftDiff);
-          rightSliceLow.Create(m.y*2,steps,rightImg,rightDiff);
-          dcLow.Setup(*dist,distCap[l],leftImg,leftSliceLow,rightImg,rightSliceLow);
-
-          leftSliceHigh.Create(m.y*2+1,steps,leftImg,leftDiff);
-          rightSliceHigh.Create(m.y*2+1,steps,rightImg,rightDiff);
-          dcHigh.Setup(*dist,distCap[l],leftImg,leftSliceHigh,rightImg,rightSliceHigh);
-         }
-         else
-         {
-          leftSliceLow.Create(m.y,steps,leftImg,leftDiff);
-          rightSliceLow.Create(m.y,steps,rightImg,rightDiff);
-          dcLow.Setup(*dist,distCap[l],leftImg,leftSliceLow,rightImg,rightSliceLow);
-         }
-        }
-
-       // Iterate the region around the match in the current level, calculating
-       // correlation values where they currently don't exist...
-        int32 lowLeftX = math::Clamp<int32>(m.xLeft*2-int32(range),0,leftImg.Width()-1);
-        int32 highLeftX = math::Clamp<int32>(m.xLeft*2+1+int32(range),0,leftImg.Width()-1);
-        int32 lowRightX = math::Clamp<int32>(m.xRight*2-int32(range),0,rightImg.Width()-1);
-        int32 highRightX = math::Clamp<int32>(m.xRight*2+1+int32(range),0,rightImg.Width()-1);
-       
-        for (int32 xLeft=lowLeftX;xLeft<=highLeftX;xLeft++)
-        {
-         for (int32 xRight=lowRightX;xRight<=highRightX;xRight++)
-         {
-          if (left->HalfHeight())
-          {
-           Match mNew;
-           mNew.y = m.y*2;
-           mNew.xLeft = xLeft;
-           mNew.xRight = xRight;
-           if (matches[l].Get(mNew)==null<Match*>())
-           {
-            mNew.score = dcLow.Cost(xLeft,xRight);
-            matches[l].Add(mNew);
-           }
-           
-           mNew.y += 1;
-           if ((mNew.y<int32(leftImg.Height()))&&(matches[l].Get(mNew)==null<Match*>()))
-           {
-            mNew.score = dcHigh.Cost(xLeft,xRight);
-            matches[l].Add(mNew);
-           }
-          }
-          else
-          {
-           Match mNew;
-           mNew.y = m.y;
-           mNew.xLeft = xLeft;
-           mNew.xRight = xRight;
-           
-           if (matches[l].Get(mNew)==null<Match*>())
-           {
-            mNew.score = dcLow.Cost(xLeft,xRight);
-            matches[l].Add(mNew);
-           }
-          }
-         }
-        }
-      }
- 
-     // To the next...   
-      ++targ;
+     const Match & m = *targ;
+     if (m.score<(distCap[l+1]*distCapThreshold))
+     {
+      if ((candCount==0)||(cand[candCount-1].y!=m.y)) group[groupCount++] = candCount;
+      cand[candCount++] = m;
+     }
+     ++targ;
     }
-    prog->Pop();
+    group[groupCount] = candCount;
+    
+   // Do the groups, in parallel, then merge into the levels set...
+    ds::ArrayDel< ds::Array<Match> > rows(groupCount);
+    FineRows fine(*this,leftImg,*lw,rightImg,*rw,distCap[l],cand,group,rows);
+    mt::ParallelFor(0,groupCount,fine,1);
     
-   // Break if we have just done the full resolution level...
-    if (l==0) break;
+    for (nat32 g=0;g<rows.Size();g++)
+    {
+     for (nat32 i=0;i<rows[g].Size();i++) matches[l].Add(rows[g][i]);
+    }
   }
  
  
@@ -506,7 +664,7 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
   // the a sort list of the Match data structure, even though it has stuff we
   // don't actually need...
   // (Offset into minima array for each pixel by y*width+x)
-   prog->Report(step++,steps);
+   prog->Report(step++,progSteps);
    ds::ArrayDel<ds::PriorityQueue<Disp> > minimaLeft(left->Level(0).Width() * left->Level(0).Height());
    ds::ArrayDel<ds::PriorityQueue<Disp> > minimaRight(right->Level(0).Width() * right->Level(0).Height());
 
@@ -620,7 +778,7 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
 
 
   // Now prepare the offset data structures, and set the size of the others...
-   prog->Report(step++,steps);
+   prog->Report(step++,progSteps);
    offsetLeft.Size(left->Level(0).Width()*left->Level(0).Height() + 1);
    offsetRight.Size(right->Level(0).Width()*right->Level(0).Height() + 1);
    
@@ -649,7 +807,7 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
   // For each pixel output its minima into the data structure, using the sorting
   // obtained from the priority queues...
    // Left...
-    prog->Report(step++,steps);
+    prog->Report(step++,progSteps);
     prog->Push();
     for (nat32 y=0;y<left->Level(0).Height();y++)
     {
@@ -684,7 +842,7 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
     prog->Pop();
    
    // Right...
-    prog->Report(step++,steps);
+    prog->Report(step++,progSteps);
     prog->Push();
     for (nat32 y=0;y<right->Level(0).Height();y++)
     {
@@ -769,7 +927,7 @@ real32 DiffusionCorrelationImage::ScoreRight(nat32 x,nat32 y,nat32 i,int32 offse
 
 //------------------------------------------------------------------------------
 DiffCorrStereo::DiffCorrStereo()
-:useHalfX(true),useHalfY(true),useCorners(true),halfHeight(true),
+:leftCache(null<DiffusionCache*>()),rightCache(null<DiffusionCache*>()),useHalfX(true),useHalfY(true),useCorners(true),halfHeight(true),
 distMult(0.1),minimaLimit(8),baseDistCap(4.0),distCapMult(2.0),distCapThreshold(0.5),dispRange(2),diffSteps(5),
 doLR(true),distCapDifference(0.25)
 {}
@@ -789,6 +947,12 @@ void DiffCorrStereo::SetMasks(const svt::Field<bit> & lm,const svt::Field<bit> &
  rightMask = rm;
 }
 
+void DiffCorrStereo::SetCache(DiffusionCache * l,DiffusionCache * r)
+{
+ leftCache = l;
+ rightCache = r;
+}
+
 void DiffCorrStereo::SetPyramid(bit ux, bit uy, bit uc, bit hh)
 {
  useHalfX = ux;
@@ -838,6 +1002,16 @@ void DiffCorrStereo::Run(time::Progress * prog)
   
   dci.Set(dist,distMult,leftP,rightP);
   dci.Set(minimaLimit,baseDistCap,distCapMult,distCapThreshold,dispRange,diffSteps);
+  
+  // The full resolution weights come from the caches, so they can be reused...
+   DiffusionCache localLeft;
+   DiffusionCache localRight;
+   DiffusionCache * lc = leftCache ? leftCache : &localLeft;
+   DiffusionCache * rc = rightCache ? rightCache : &localRight;
+   lc->Set(left,leftMask);
+   rc->Set(right,rightMask);
+   dci.SetBase(&lc->Weight(useHalfX,useHalfY,useCorners,dist,distMult),
+               &rc->Weight(useHalfX,useHalfY,useCorners,dist,distMult));
 
   dci.Run(prog);
 
@@ -983,8 +1157,9 @@ cstrconst DiffCorrStereo::TypeString() const
 
 //------------------------------------------------------------------------------
 DiffCorrRefine::DiffCorrRefine()
-:useHalfX(true),useHalfY(true),useCorners(true),
-distMult(0.01),diffSteps(7),cap(64.0),prune(4.0)
+:leftCache(null<DiffusionCache*>()),rightCache(null<DiffusionCache*>()),useHalfX(true),useHalfY(true),useCorners(true),
+distMult(0.01),diffSteps(7),cap(64.0),prune(4.0),
+full(true),dirtyX0(0),dirtyY0(0),dirtyX1(0),dirtyY1(0),halo(0),solved(0)
 {}
 
 DiffCorrRefine::~DiffCorrRefine()
@@ -994,12 +1169,14 @@ void DiffCorrRefine::SetImages(const svt::Field<bs::ColourLuv> & l,const svt::Fi
 {
  left = l;
  right = r;
+ full = true;
 }
 
 void DiffCorrRefine::SetMasks(const svt::Field<bit> & l,const svt::Field<bit> & r)
 {
  leftMask = l;
  rightMask = r;
+ full = true;
 }
 
 void DiffCorrRefine::SetDisparity(const svt::Field<real32> & d)
@@ -1012,25 +1189,174 @@ void DiffCorrRefine::SetDisparityMask(const svt::Field<bit> & dm)
  dispMask = dm;
 }
 
+void DiffCorrRefine::SetCache(DiffusionCache * l,DiffusionCache * r)
+{
+ leftCache = l;
+ rightCache = r;
+ full = true;
+}
+
 void DiffCorrRefine::SetFlags(bit x, bit y, bit c)
 {
  useHalfX = x;
  useHalfY = y;
  useCorners = c;
+ full = true;
 }
 
 void DiffCorrRefine::SetDiff(real32 dm,nat32 ds)
 {
  distMult = dm;
  diffSteps = ds;
+ full = true;
 }
 
 void DiffCorrRefine::SetDist(real32 c,real32 p)
 {
  cap = c;
  prune = p;
+ full = true;
+}
+
+void DiffCorrRefine::Dirty(nat32 x0,nat32 y0,nat32 x1,nat32 y1)
+{
+ if ((x0>=x1)||(y0>=y1)) return;
+ if (dirtyX0>=dirtyX1)
+ {
+  dirtyX0 = x0;
+  dirtyY0 = y0;
+  dirtyX1 = x1;
+  dirtyY1 = y1;
+ }
+ else
+ {
+  dirtyX0 = math::Min(dirtyX0,x0);
+  dirtyY0 = math::Min(dirtyY0,y0);
+  dirtyX1 = math::Max(dirtyX1,x1);
+  dirtyY1 = math::Max(dirtyY1,y1);
+ }
+}
+
+void DiffCorrRefine::Dirty(const svt::Field<bit> & changed)
+{
+ for (nat32 y=0;y<changed.Size(1);y++)
+ {
+  for (nat32 x=0;x<changed.Size(0);x++)
+  {
+   if (changed.Get(x,y)) Dirty(x,y,x+1,y+1);
+  }
+ }
 }
 
+void DiffCorrRefine::Dirty()
+{
+ full = true;
+}
+
+void DiffCorrRefine::SetHalo(nat32 h)
+{
+ halo = h;
+}
+
+// Does a range of rows, each range with its own slices...
+class DiffCorrRefine::Rows
+{
+ public:
+  Rows(DiffCorrRefine & s,const bs::LuvRangeDist & d,const bs::LuvRangeImage & li,const DiffusionWeight & lwi,
+       const bs::LuvRangeImage & ri,const DiffusionWeight & rwi,nat32 xb,nat32 xe)
+  :self(s),dist(d),l(li),lw(lwi),r(ri),rw(rwi),x0(xb),x1(xe)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   RangeDiffusionSlice ls;
+   RangeDiffusionSlice rs;
+   DiffuseCorrelation dc;
+   bit part = (x0!=0)||(x1!=self.out.Width());
+
+   for (int32 y=begin;y<int32(end);y++)
+   {
+    // Create the diffusion maps for this scanline - when only doing part of
+    // it only the masks that are going to be used are calculated...
+     if (part)
+     {
+      int32 minX2 = int32(self.out.Width());
+      int32 maxX2 = -1;
+      for (int32 x=x0;x<int32(x1);x++)
+      {
+       if (self.dispMask.Valid()&&(self.dispMask.Get(x,y)==false)) continue;
+       int32 x2 = x + int32(math::Round(self.disp.Get(x,y)));
+       minX2 = math::Min(minX2,x2);
+       maxX2 = math::Max(maxX2,x2);
+      }
+      minX2 = math::Max(minX2-1,int32(0));
+      maxX2 = math::Min(maxX2+2,int32(r.Width()));
+
+      ls.Create(y,self.diffSteps,l,lw,(x0==0)?0:(x0-1),math::Min(x1+1,l.Width()));
+      rs.Create(y,self.diffSteps,r,rw,minX2,math::Max(minX2,maxX2));
+     }
+     else
+     {
+      ls.Create(y,self.diffSteps,l,lw);
+      rs.Create(y,self.diffSteps,r,rw);
+     }
+    
+    // Do the scanline...
+     dc.Setup(dist,self.cap,l,ls,r,rs);
+     for (int32 x=x0;x<int32(x1);x++)
+     {
+      // Make it bad, so we can continue if we give up and obey the mask...
+       self.out.Get(x,y) = math::Infinity<real32>();
+       if (self.dispMask.Valid()&&(self.dispMask.Get(x,y)==false)) continue;
+      
+      // Get the discrete x value for the other image, rounding if needed...
+       int32 x2 = x + int32(math::Round(self.disp.Get(x,y)));
+      
+      // Check the masking is safe - we throw away values that have bad masking...
+       if ((l.ValidExt(x   ,y)==false)||
+           (l.ValidExt(x+1 ,y)==false)||
+           (l.ValidExt(x-1 ,y)==false)||
+           (r.ValidExt(x2  ,y)==false)||
+           (r.ValidExt(x2+1,y)==false)||
+           (r.ValidExt(x2-1,y)==false)) continue;
+     
+      // Get the 5 needed correlation values - the current pixel and offset 
+      // by 1 for each image...
+       real32 centre = dc.Cost(x,x2);
+       real32 negL = dc.Cost(x-1,x2);
+       real32 posL = dc.Cost(x+1,x2);
+       real32 negR = dc.Cost(x,x2-1);
+       real32 posR = dc.Cost(x,x2+1);
+     
+      // Verify that the pixel is sufficiently better than the rest...
+       if (((negL-centre)<self.prune)||
+           ((posL-centre)<self.prune)||
+           ((negR-centre)<self.prune)||
+           ((posR-centre)<self.prune)) continue;
+     
+      // Refine the disparity position and store it...
+       real32 p = 0.5*(negL+negR);
+       real32 q = centre;
+       real32 r = 0.5*(posL+posR);
+      
+       real32 dOS = (p-r)/(2.0*(p+r) - 4.0*q);
+       self.out.Get(x,y) = real32(x2-x) + dOS;
+     }
+   }
+  }
+
+
+ private:
+  DiffCorrRefine & self;
+  const bs::LuvRangeDist & dist;
+  const bs::LuvRangeImage & l;
+  const DiffusionWeight & lw;
+  const bs::LuvRangeImage & r;
+  const DiffusionWeight & rw;
+  nat32 x0;
+  nat32 x1;
+};
+
 void DiffCorrRefine::Run(time::Progress * prog)
 {
  prog->Push();
@@ -1038,89 +1364,58 @@ void DiffCorrRefine::Run(time::Progress * prog)
  // Distance object to use...
   bs::BasicLRD dist;
   
- // Generate range images from the inputs...
-  prog->Report(0,disp.Size(1)+2);
-  bs::LuvRangeImage l;
-  l.Create(left,leftMask,useHalfX,useHalfY,useCorners);
-  
-  DiffusionWeight lw;
-  lw.Create(l,dist,distMult,prog);
+ // Get range images and weights for the inputs, from the caches...
+  DiffusionCache * lc = leftCache ? leftCache : &localLeft;
+  DiffusionCache * rc = rightCache ? rightCache : &localRight;
+  lc->Set(left,leftMask);
+  rc->Set(right,rightMask);
 
+  prog->Report(0,3);
+  const bs::LuvRangeImage & l = lc->Image(useHalfX,useHalfY,useCorners);
+  const DiffusionWeight & lw = lc->Weight(useHalfX,useHalfY,useCorners,dist,distMult,prog);
 
-  prog->Report(1,disp.Size(1)+2);
-  bs::LuvRangeImage r;
-  r.Create(right,rightMask,useHalfX,useHalfY,useCorners);
-  
-  DiffusionWeight rw;
-  rw.Create(r,dist,distMult,prog);
-  
+  prog->Report(1,3);
+  const bs::LuvRangeImage & r = rc->Image(useHalfX,useHalfY,useCorners);
+  const DiffusionWeight & rw = rc->Weight(useHalfX,useHalfY,useCorners,dist,distMult,prog);
   
- // Iterate the disparity map and refine...
-  out.Resize(disp.Size(0),disp.Size(1));
-
-  RangeDiffusionSlice ls;
-  RangeDiffusionSlice rs;
-  DiffuseCorrelation dc;
   
-  for (int32 y=0;y<int32(out.Height());y++)
+ // Iterate the disparity map and refine, rows in parallel...
+  prog->Report(2,3);
+  if ((out.Width()!=disp.Size(0))||(out.Height()!=disp.Size(1)))
   {
-   prog->Report(2+y,disp.Size(1)+2);
-   prog->Push();
-   
-   // Create the diffusion maps for this scanline...
-    prog->Report(0,3);
-    ls.Create(y,diffSteps,l,lw,prog);
-    
-    prog->Report(1,3);
-    rs.Create(y,diffSteps,r,rw,prog);
-    
+   out.Resize(disp.Size(0),disp.Size(1));
+   full = true;
+  }
 
-   // Do the scanline...
-    prog->Report(2,3);
-    dc.Setup(dist,cap,l,ls,r,rs);
-    for (int32 x=0;x<int32(out.Width());x++)
-    {
-     // Make it bad, so we can continue if we give up and obey the mask...
-      out.Get(x,y) = math::Infinity<real32>();
-      if (dispMask.Valid()&&(dispMask.Get(x,y)==false)) continue;
-      
-     // Get the discrete x value for the other image, rounding if needed...
-      int32 x2 = x + int32(math::Round(disp.Get(x,y)));
-      
-     // Check the masking is safe - we throw away values that have bad masking...
-      if ((l.ValidExt(x   ,y)==false)||
-          (l.ValidExt(x+1 ,y)==false)||
-          (l.ValidExt(x-1 ,y)==false)||
-          (r.ValidExt(x2  ,y)==false)||
-          (r.ValidExt(x2+1,y)==false)||
-          (r.ValidExt(x2-1,y)==false)) continue;
-     
-     // Get the 5 needed correlation values - the current pixel and offset 
-     // by 1 for each image...
-      real32 centre = dc.Cost(x,x2);
-      real32 negL = dc.Cost(x-1,x2);
-      real32 posL = dc.Cost(x+1,x2);
-      real32 negR = dc.Cost(x,x2-1);
-      real32 posR = dc.Cost(x,x2+1);
-     
-     // Verify that the pixel is sufficiently better than the rest...
-      if (((negL-centre)<prune)||
-          ((posL-centre)<prune)||
-          ((negR-centre)<prune)||
-          ((posR-centre)<prune)) continue;
-     
-     // Refine the disparity position and store it...
-      real32 p = 0.5*(negL+negR);
-      real32 q = centre;
-      real32 r = 0.5*(posL+posR);
-      
-      real32 dOS = (p-r)/(2.0*(p+r) - 4.0*q);
-      out.Get(x,y) = real32(x2-x) + dOS;
-    }
+  nat32 x0 = 0;
+  nat32 y0 = 0;
+  nat32 x1 = out.Width();
+  nat32 y1 = out.Height();
+  if (!full)
+  {
+   if (dirtyX0<dirtyX1)
+   {
+    x0 = (dirtyX0>halo) ? (dirtyX0-halo) : 0;
+    y0 = (dirtyY0>halo) ? (dirtyY0-halo) : 0;
+    x1 = math::Min(dirtyX1+halo,out.Width());
+    y1 = math::Min(dirtyY1+halo,out.Height());
+   }
+   else x1 = 0;
+  }
+  solved = (x0<x1)&&(y0<y1) ? (x1-x0)*(y1-y0) : 0;
 
-   prog->Pop();
+  if (solved!=0)
+  {
+   Rows rows(*this,dist,l,lw,r,rw,x0,x1);
+   mt::ParallelFor(y0,y1,rows,1);
   }
-    
+
+ // Everything is now up to date...
+  full = false;
+  dirtyX0 = 0;
+  dirtyY0 = 0;
+  dirtyX1 = 0;
+  dirtyY1 = 0;
  
  prog->Pop();
 }
@@ -74,11 +74,69 @@ class EOS_CLASS DiffusionWeight
   ds::Array2D<Weight> data;
 };
 
+//------------------------------------------------------------------------------
+/// Holds the LuvRangeImage and DiffusionWeight for an image, so several
+/// passes over the same image, such as DiffCorrStereo followed by
+/// DiffCorrRefine, can share them rather than each calculating its own. Only
+/// remembers the most recent request, if the flags, distance or multiplier
+/// change it recalculates. Not thread safe, but the returned objects can be
+/// used by many threads at once.
+class EOS_CLASS DiffusionCache
+{
+ public:
+  /// &nbsp;
+   DiffusionCache();
+
+  /// &nbsp;
+   ~DiffusionCache();
+
+
+  /// Sets the image and its optional mask. If they are the same as last
+  /// time the cache survives, otherwise its emptied.
+   void Set(const svt::Field<bs::ColourLuv> & img,const svt::Field<bit> & mask);
+
+  /// Returns the LuvRangeImage made with the given flags, creating it if
+  /// needed.
+   const bs::LuvRangeImage & Image(bit useHalfX,bit useHalfY,bit useCorners);
+
+  /// Returns the DiffusionWeight for the image made with the given flags,
+  /// distance and multiplier, creating it if needed. Distances are matched by
+  /// TypeString.
+   const DiffusionWeight & Weight(bit useHalfX,bit useHalfY,bit useCorners,const bs::LuvRangeDist & dist,real32 distMult,time::Progress * prog = null<time::Progress*>());
+
+  /// Returns how many times the weights have been calculated, for checking
+  /// the sharing is happening.
+   nat32 Builds() const {return builds;}
+
+
+  /// &nbsp;
+   inline cstrconst TypeString() const {return "eos::stereo::DiffusionCache";}
+
+
+ private:
+  svt::Field<bs::ColourLuv> img;
+  svt::Field<bit> mask;
+
+  bit haveImage;
+  bit useHalfX;
+  bit useHalfY;
+  bit useCorners;
+  bs::LuvRangeImage image;
+
+  bit haveWeight;
+  cstrconst distType;
+  real32 distMult;
+  DiffusionWeight weight;
+
+  nat32 builds;
+};
+
 //------------------------------------------------------------------------------
 /// Given a LuvRangeImage and a scanline number this calculates a slice of 
 /// diffusion scores, for a given number of steps.
 /// Clever enough to cache storage between runs as long as the image
-/// width and step count don't change.
+/// width and step count don't change. Each instance can only be used by one
+/// thread, so threaded users have one per thread.
 /// Once done each pixel in the scanline will have a normalised set of weights 
 /// for surrounding pixels within the given walking distance. Note that this is
 /// never going to be that fast. It will always give values of zero to masked or
@@ -102,6 +160,11 @@ class EOS_CLASS RangeDiffusionSlice
   /// distance. (And offsets first, for stability.)
    void Create(nat32 y, nat32 steps, const bs::LuvRangeImage & img, const DiffusionWeight & dw, time::Progress * prog = null<time::Progress*>());
 
+  /// As above, but only calculates the masks for pixels in the range [x0,x1),
+  /// the rest are given zeros, as for masked pixels. For when only part of a
+  /// scanline is needed.
+   void Create(nat32 y, nat32 steps, const bs::LuvRangeImage & img, const DiffusionWeight & dw, nat32 x0, nat32 x1, time::Progress * prog = null<time::Progress*>());
+
 
   /// Returns the width of the slice.
    nat32 Width() const;
@@ -189,6 +252,7 @@ class EOS_CLASS DiffuseCorrelation
 /// A minima has to be so in both images for it to be accepted.
 /// Each match will also include its score and the scores of adjacent pixels, so
 /// the positions can be refined beyond discrete coordinates.
+/// Rows are split between threads at every level, each with its own slices.
 class EOS_CLASS DiffusionCorrelationImage
 {
  public:
@@ -215,6 +279,12 @@ class EOS_CLASS DiffusionCorrelationImage
   /// scores for - don't set it too high, range is the diffusion range to use.
    void Set(nat32 minimaLimit = 8, real32 baseDistCap = 1.0, real32 distCapMult = 2.0, real32 distCapThreshold = 0.5, nat32 range = 2, nat32 steps = 5);
 
+  /// Optional, provides the DiffusionWeight objects for level 0 of the two
+  /// pyramids, so they don't have to be calculated again. They must have been
+  /// made with the same distance and multiplier, and survive until Run has
+  /// finished. Null to go back to calculating them.
+   void SetBase(const DiffusionWeight * left,const DiffusionWeight * right);
+
 
   /// Runs the algorithm.
    void Run(time::Progress * prog = null<time::Progress*>());
@@ -261,6 +331,8 @@ class EOS_CLASS DiffusionCorrelationImage
    const bs::LuvRangeDist * dist;
    const bs::LuvRangePyramid * left;
    const bs::LuvRangePyramid * right;
+   const DiffusionWeight * leftBase;
+   const DiffusionWeight * rightBase;
   
   // Parameters...
    real32 distMult;
@@ -307,6 +379,10 @@ class EOS_CLASS DiffusionCorrelationImage
      return d < rhs.d;
     }
    };
+
+  // Threaded workers for the first level and the rest...
+   class CoarseRows;
+   class FineRows;
 };
 
 //------------------------------------------------------------------------------
@@ -330,6 +406,12 @@ class EOS_CLASS DiffCorrStereo : public DSI
 
   /// Optionally call to set masks.
    void SetMasks(const svt::Field<bit> & left,const svt::Field<bit> & right);
+
+  /// Optional, sets caches to get the full resolution diffusion weights
+  /// from, so they can be shared with a later DiffCorrRefine. They are given
+  /// the images and masks during Run, and must survive it. Null to use
+  /// internal ones.
+   void SetCache(DiffusionCache * left,DiffusionCache * right);
    
   /// Sets luv range pyramid construction options. All default to true.
    void SetPyramid(bit useHalfX, bit useHalfY, bit useCorners, bit halfHeight);
@@ -404,6 +486,8 @@ class EOS_CLASS DiffCorrStereo : public DSI
    svt::Field<bs::ColourLuv> right;
    svt::Field<bit> leftMask;
    svt::Field<bit> rightMask;
+   DiffusionCache * leftCache;
+   DiffusionCache * rightCache;
 
   // Parameters...
    bit useHalfX;
@@ -432,6 +516,14 @@ class EOS_CLASS DiffCorrStereo : public DSI
 /// disparity value and refines its position by running diffusion correlation in
 /// a region around the results - if there is no maxima it prunes the value, if
 /// there is it does subpixel refinement by fitting a polynomial based on area.
+/// Rows are split between threads.
+///
+/// Supports incremental re-solving - the result for each pixel only depends on
+/// its own disparity (and mask), so after the disparity map or its mask has
+/// been edited you can call Dirty() with the region that changed and the next
+/// Run will only redo that region, keeping the previous result everywhere
+/// else. Changing anything else, including the images, makes the next Run
+/// redo everything.
 class EOS_CLASS DiffCorrRefine 
 {
  public:
@@ -454,6 +546,11 @@ class EOS_CLASS DiffCorrRefine
   /// Optional sets a mask for the disparity map to refine.
    void SetDisparityMask(const svt::Field<bit> & dispMask);
 
+  /// Optional, sets caches to get the diffusion weights from, as for
+  /// DiffCorrStereo::SetCache - passing the same caches to both means the
+  /// weights are only calculated once when the parameters match.
+   void SetCache(DiffusionCache * left,DiffusionCache * right);
+
 
   /// Sets luv range from image construction flags. All default to true.
    void SetFlags(bit useHalfX, bit useHalfY, bit useCorners);
@@ -469,7 +566,25 @@ class EOS_CLASS DiffCorrRefine
    void SetDist(real32 cap,real32 prune);
 
 
-  /// Runs the algorithm.
+  /// Marks the rectangle [x0,x1) x [y0,y1) as having changed since the last
+  /// Run, so it will be redone. Can be called repeatedly, the region used is
+  /// the bounding box of all the calls.
+   void Dirty(nat32 x0,nat32 y0,nat32 x1,nat32 y1);
+
+  /// Marks every pixel set in the given mask as having changed.
+   void Dirty(const svt::Field<bit> & changed);
+
+  /// Marks everything as having changed, so the next Run redoes it all.
+   void Dirty();
+
+  /// Sets a border, in pixels, that is added around the dirty region, for
+  /// callers that want a safety margin. Defaults to 0, which is exact for
+  /// edits to the disparity map and its mask.
+   void SetHalo(nat32 halo);
+
+
+  /// Runs the algorithm. If nothing has changed since the last run but a
+  /// dirty region only that region is redone.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -479,6 +594,10 @@ class EOS_CLASS DiffCorrRefine
   /// &nbsp;
    void GetMask(svt::Field<bit> & mask) const;
 
+  /// Returns how many pixels the last Run calculated, for checking that
+  /// incremental updates are happening.
+   nat32 Solved() const {return solved;}
+
 
   /// &nbsp;
    inline cstrconst TypeString() const {return "eos::stereo::DiffCorrRefine";}
@@ -492,6 +611,8 @@ class EOS_CLASS DiffCorrRefine
    svt::Field<bit> rightMask;
    svt::Field<real32> disp;
    svt::Field<bit> dispMask;
+   DiffusionCache * leftCache;
+   DiffusionCache * rightCache;
   
   // Parameters...
    bit useHalfX;
@@ -504,8 +625,26 @@ class EOS_CLASS DiffCorrRefine
    real32 cap;
    real32 prune;
 
+  // Incremental state - if full is false only the dirty rectangle needs
+  // redoing, which is empty if x0>=x1...
+   bit full;
+   nat32 dirtyX0;
+   nat32 dirtyY0;
+   nat32 dirtyX1;
+   nat32 dirtyY1;
+   nat32 halo;
+   nat32 solved;
+
+  // Used when the user does not provide caches, so the weights survive
+  // between runs...
+   DiffusionCache localLeft;
+   DiffusionCache localRight;
+
   // Output...
    ds::Array2D<real32> out; // I use infinity to indicate masked values.
+
+  // Threaded worker...
+   class Rows;
 };
 
 //------------------------------------------------------------------------------
@@ -17,6 +17,8 @@
 
 #include "eos/stereo/disp_post.h"
 
+#include "eos/mt/tasks.h"
+
 namespace eos
 {
  namespace stereo
@@ -52,6 +54,225 @@ EOS_FUNC void FillDispLeft(svt::Field<real32> & disp,const svt::Field<bit> & val
  }
 }
 
+//------------------------------------------------------------------------------
+// Returns the lowest cost disparity for a pixel, false if it has none...
+inline bit BestDisp(const DSI & dsi,nat32 x,nat32 y,real32 & out)
+{
+ nat32 size = dsi.Size(x,y);
+ if (size==0) return false;
+
+ out = dsi.Disp(x,y,0);
+ real32 best = dsi.Cost(x,y,0);
+ for (nat32 i=1;i<size;i++)
+ {
+  real32 c = dsi.Cost(x,y,i);
+  if (c<best)
+  {
+   best = c;
+   out = dsi.Disp(x,y,i);
+  }
+ }
+ return true;
+}
+
+// Does a band of rows for CrossCheck, with a row of scratch so the fill can be
+// done without leaving the row...
+class CrossCheckRows
+{
+ public:
+  CrossCheckRows(const DSI & l,const DSI & r,svt::Field<real32> & d,svt::Field<bit> & v,real32 t,DispFill f)
+  :left(l),right(r),disp(d),valid(v),tol(t),fill(f)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 width = disp.Size(0);
+   int32 rightWidth = right.Width();
+   ds::Array<real32> prev(width);
+
+   for (nat32 y=begin;y<end;y++)
+   {
+    // Check...
+     for (nat32 x=0;x<width;x++)
+     {
+      real32 d = 0.0;
+      bit ok = BestDisp(left,x,y,d);
+      if (ok)
+      {
+       int32 rx = int32(x) + int32(math::Round(d));
+       real32 rd;
+       ok = (rx>=0)&&(rx<rightWidth)&&BestDisp(right,rx,y,rd)&&(math::Abs(d+rd)<=tol);
+      }
+
+      disp.Get(x,y) = d;
+      valid.Get(x,y) = ok;
+     }
+
+    // Fill...
+     switch (fill)
+     {
+      case FillNone: break;
+      case FillInf:
+       for (nat32 x=0;x<width;x++)
+       {
+        if (!valid.Get(x,y)) disp.Get(x,y) = 0.0;
+       }
+      break;
+      case FillLeft:
+       if (!valid.Get(0,y)) disp.Get(0,y) = 0.0;
+       for (nat32 x=1;x<width;x++)
+       {
+        if (!valid.Get(x,y)) disp.Get(x,y) = disp.Get(x-1,y);
+       }
+      break;
+      case FillBackground:
+      {
+       // Forward pass records the nearest passing value to the left, backwards
+       // pass then compares it with the nearest to the right...
+        real32 last = math::Infinity<real32>();
+        for (nat32 x=0;x<width;x++)
+        {
+         if (valid.Get(x,y)) last = disp.Get(x,y);
+                        else prev[x] = last;
+        }
+
+        last = math::Infinity<real32>();
+        for (int32 x=int32(width)-1;x>=0;x--)
+        {
+         if (valid.Get(x,y)) last = disp.Get(x,y);
+         else
+         {
+          real32 & out = disp.Get(x,y);
+          if (math::IsFinite(prev[x]))
+          {
+           if (math::IsFinite(last)&&(math::Abs(last)<math::Abs(prev[x]))) out = last;
+                                                                      else out = prev[x];
+          }
+          else
+          {
+           if (math::IsFinite(last)) out = last;
+                                else out = 0.0;
+          }
+         }
+        }
+      }
+      break;
+     }
+   }
+  }
+
+
+ private:
+  const DSI & left;
+  const DSI & right;
+  svt::Field<real32> & disp;
+  svt::Field<bit> & valid;
+  real32 tol;
+  DispFill fill;
+};
+
+EOS_FUNC void CrossCheck(const DSI & left,const DSI & right,svt::Field<real32> & disp,svt::Field<bit> & valid,
+                         real32 tol,DispFill fill)
+{
+ CrossCheckRows rows(left,right,disp,valid,tol,fill);
+ mt::ParallelFor(0,disp.Size(1),rows,8);
+}
+
+//------------------------------------------------------------------------------
+// Does a band of rows for WinnerTakeAll, for either type of volume...
+template <typename T>
+class WtaRows
+{
+ public:
+  WtaRows(const svt::Field<T> & c,int32 m,svt::Field<real32> & d)
+  :cost(c),minDisp(m),disp(d)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 width = disp.Size(0);
+   ds::Array<T> best(width);
+   ds::Array<nat32> bestInd(width);
+
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     best[x] = cost.Get(x,y,0);
+     bestInd[x] = 0;
+    }
+
+    for (nat32 d=1;d<cost.Size(2);d++)
+    {
+     for (nat32 x=0;x<width;x++)
+     {
+      T c = cost.Get(x,y,d);
+      if (c<best[x])
+      {
+       best[x] = c;
+       bestInd[x] = d;
+      }
+     }
+    }
+
+    for (nat32 x=0;x<width;x++) disp.Get(x,y) = real32(int32(bestInd[x]) + minDisp);
+   }
+  }
+
+
+ private:
+  const svt::Field<T> & cost;
+  int32 minDisp;
+  svt::Field<real32> & disp;
+};
+
+EOS_FUNC void WinnerTakeAll(const svt::Field<real32> & cost,int32 minDisp,svt::Field<real32> & disp)
+{
+ WtaRows<real32> rows(cost,minDisp,disp);
+ mt::ParallelFor(0,disp.Size(1),rows,8);
+}
+
+EOS_FUNC void WinnerTakeAll(const svt::Field<nat16> & cost,int32 minDisp,svt::Field<real32> & disp)
+{
+ WtaRows<nat16> rows(cost,minDisp,disp);
+ mt::ParallelFor(0,disp.Size(1),rows,8);
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC void DispError(const svt::Field<real32> & disp,const svt::Field<bit> & valid,
+                        const svt::Field<real32> & truth,const svt::Field<bit> & known,
+                        real32 threshold,DispStats & out)
+{
+ out.pixels = 0;
+ out.bad = 0;
+ out.missing = 0;
+
+ real64 sqrErr = 0.0;
+ nat32 matched = 0;
+ for (nat32 y=0;y<disp.Size(1);y++)
+ {
+  for (nat32 x=0;x<disp.Size(0);x++)
+  {
+   if (known.Valid()&&(!known.Get(x,y))) continue;
+   out.pixels += 1;
+
+   if (valid.Valid()&&(!valid.Get(x,y)))
+   {
+    out.missing += 1;
+    out.bad += 1;
+    continue;
+   }
+
+   real32 err = math::Abs(disp.Get(x,y) - truth.Get(x,y));
+   if (err>threshold) out.bad += 1;
+   sqrErr += math::Sqr(err);
+   matched += 1;
+  }
+ }
+
+ out.rms = (matched==0)?0.0:math::Sqrt(sqrErr/real64(matched));
+}
+
 //------------------------------------------------------------------------------
  };
 };
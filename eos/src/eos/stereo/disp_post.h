@@ -24,6 +24,7 @@
 #include "eos/types.h"
 #include "eos/svt/var.h"
 #include "eos/svt/field.h"
+#include "eos/stereo/dsi.h"
 
 namespace eos
 {
@@ -37,6 +38,66 @@ EOS_FUNC void FillDispInf(svt::Field<real32> & disp,const svt::Field<bit> & vali
 /// proposed with the middlebury test.
 EOS_FUNC void FillDispLeft(svt::Field<real32> & disp,const svt::Field<bit> & valid);
 
+//------------------------------------------------------------------------------
+/// The ways CrossCheck can fill in the disparities that fail.
+enum DispFill {FillNone,      ///< Leaves them as whatever the left DSI said, or 0 if it had nothing.
+               FillInf,       ///< Sets them to 0, as FillDispInf.
+               FillLeft,      ///< Sets them to there left neighbour, as FillDispLeft.
+               FillBackground ///< Sets them to whichever of the nearest passing disparities to the left and right is furthest away, i.e. smallest in magnitude, as occlusions belong to the background.
+              };
+
+/// Left-right consistency check and fill in, done in one pass directly from the
+/// two DSI's rather than via intermediate disparity maps. left is the DSI for
+/// the left image, right the same algorithm run with a SwapDSC, so a
+/// disparity of d at left pixel x should be matched by about -d at right pixel
+/// x+d. For each pixel the lowest cost disparity is used; it passes if the
+/// two agree within tol. valid is set to which pass and disp to the
+/// disparities, with the failures filled according to fill. Rows are done in
+/// bands, in parallel.
+EOS_FUNC void CrossCheck(const DSI & left,const DSI & right,svt::Field<real32> & disp,svt::Field<bit> & valid,
+                         real32 tol = 1.0,DispFill fill = FillBackground);
+
+/// Winner takes all over a dense cost volume, such as Sad writes - each pixel
+/// of disp is set to minDisp plus the index of its lowest cost in the third
+/// dimension of cost, ties going to the lowest disparity. The volume is read
+/// a disparity slice at a time with a row of running minimums, rather than a
+/// pixel at a time, as it is stored slice by slice. Rows are done in bands, in
+/// parallel.
+EOS_FUNC void WinnerTakeAll(const svt::Field<real32> & cost,int32 minDisp,svt::Field<real32> & disp);
+
+/// Version of the above for the fixed point volumes Sad can write, it being
+/// the cost volume the version of most interest for large images.
+EOS_FUNC void WinnerTakeAll(const svt::Field<nat16> & cost,int32 minDisp,svt::Field<real32> & disp);
+
+//------------------------------------------------------------------------------
+/// The result of comparing a disparity map with ground truth, see DispError.
+struct EOS_CLASS DispStats
+{
+ nat32 pixels; ///< Pixels evaluated, i.e. where the truth is known.
+ nat32 bad; ///< Evaluated pixels more than the threshold from the truth, including the missing.
+ nat32 missing; ///< Evaluated pixels without a valid disparity.
+ real32 rms; ///< Root mean square error of the evaluated pixels with a valid disparity.
+
+ /// Returns the fraction of evaluated pixels that are bad, the Middlebury
+ /// measure.
+  real32 BadRate() const {return (pixels==0)?0.0:(real32(bad)/real32(pixels));}
+
+ /// &nbsp;
+  static inline cstrconst TypeString() {return "eos::stereo::DispStats";}
+};
+
+/// Compares a disparity map with ground truth, as the Middlebury evaluation
+/// does - a pixel is bad if its disparity is more than threshold from the
+/// truth, or if it has no disparity. valid marks the pixels with a disparity
+/// and known the pixels where the truth is known, so occluded areas can be
+/// left out; either can be an invalid Field, to include every pixel. The
+/// truth must use the same convention as disp, i.e. a disparity of d matches
+/// left pixel x with right pixel x+d, which is the negative of the Middlebury
+/// files.
+EOS_FUNC void DispError(const svt::Field<real32> & disp,const svt::Field<bit> & valid,
+                        const svt::Field<real32> & truth,const svt::Field<bit> & known,
+                        real32 threshold,DispStats & out);
+
 //------------------------------------------------------------------------------
  };
 };
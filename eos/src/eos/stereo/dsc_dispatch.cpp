@@ -0,0 +1,51 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/stereo/dsc_dispatch.h"
+
+#include "eos/str/functions.h"
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+// The table of TypeString-s, with the kind each maps to...
+struct DSCKindEntry
+{
+ cstrconst type;
+ DSCKind kind;
+};
+
+static const DSCKindEntry dscKindTable[] = {{"eos::stereo::DifferenceDSC",dsc_difference},
+                                            {"eos::stereo::CensusDSC",dsc_census},
+                                            {"eos::stereo::LuvDSC",dsc_luv},
+                                            {"eos::stereo::BoundLuvDSC",dsc_bound_luv}};
+
+EOS_FUNC DSCKind KindOfDSC(const DSC & dsc)
+{
+ cstrconst type = dsc.TypeString();
+ for (nat32 i=0;i<sizeof(dscKindTable)/sizeof(DSCKindEntry);i++)
+ {
+  if (str::Compare(type,dscKindTable[i].type)==0) return dscKindTable[i].kind;
+ }
+ return dsc_other;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
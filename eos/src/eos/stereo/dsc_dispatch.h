@@ -0,0 +1,93 @@
+#ifndef EOS_STEREO_DSC_DISPATCH_H
+#define EOS_STEREO_DSC_DISPATCH_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file dsc_dispatch.h
+/// Provides compile time access to the common DSC-s, so inner loops that
+/// would otherwise make a virtual call per cost can be instantiated for the
+/// concrete type and have the cost inlined.
+
+#include "eos/types.h"
+#include "eos/stereo/dsi.h"
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+/// The DSC types that kernels are instantiated for, plus dsc_other for
+/// everything else.
+enum DSCKind {dsc_other,
+              dsc_difference, ///< DifferenceDSC
+              dsc_census, ///< CensusDSC
+              dsc_luv, ///< LuvDSC
+              dsc_bound_luv ///< BoundLuvDSC
+             };
+
+/// Returns the kind of a DSC, by looking its TypeString() up in a table. A
+/// class derived from one of the listed DSC-s is only matched if it doesn't
+/// change TypeString(), so derived classes that change the costs must.
+EOS_FUNC DSCKind KindOfDSC(const DSC & dsc);
+
+//------------------------------------------------------------------------------
+/// Static access to the per value methods of a DSC of type T. For the
+/// concrete types these are qualified, and hence non-virtual, calls to the
+/// inline definitions in dsi.h; for T = DSC they are the normal virtual calls,
+/// so the same kernel code serves as the fallback.
+template <typename T>
+struct DSCOps
+{
+ static inline nat32 Bytes(const T & dsc) {return dsc.T::Bytes();}
+ static inline real32 Cost(const T & dsc,const byte * left,const byte * right) {return dsc.T::Cost(left,right);}
+ static inline void Left(const T & dsc,nat32 x,nat32 y,byte * out) {dsc.T::Left(x,y,out);}
+ static inline void Right(const T & dsc,nat32 x,nat32 y,byte * out) {dsc.T::Right(x,y,out);}
+};
+
+template <>
+struct DSCOps<DSC>
+{
+ static inline nat32 Bytes(const DSC & dsc) {return dsc.Bytes();}
+ static inline real32 Cost(const DSC & dsc,const byte * left,const byte * right) {return dsc.Cost(left,right);}
+ static inline void Left(const DSC & dsc,nat32 x,nat32 y,byte * out) {dsc.Left(x,y,out);}
+ static inline void Right(const DSC & dsc,nat32 x,nat32 y,byte * out) {dsc.Right(x,y,out);}
+};
+
+//------------------------------------------------------------------------------
+/// Calls kernel(d), where d is the given DSC cast to its concrete type if its
+/// one of those in DSCKind, or left as a DSC & otherwise. K must therefore
+/// have a templated operator(), that accesses the DSC through DSCOps<T>; that
+/// operator is instantiated for each of the kinds in the translation unit
+/// that calls this, so only call it once per run of a kernel, not per cost.
+template <typename K>
+inline void DispatchDSC(const DSC & dsc,K & kernel)
+{
+ switch (KindOfDSC(dsc))
+ {
+  case dsc_difference: kernel(static_cast<const DifferenceDSC&>(dsc)); break;
+  case dsc_census:     kernel(static_cast<const CensusDSC&>(dsc)); break;
+  case dsc_luv:        kernel(static_cast<const LuvDSC&>(dsc)); break;
+  case dsc_bound_luv:  kernel(static_cast<const BoundLuvDSC&>(dsc)); break;
+  default:             kernel(dsc); break;
+ }
+}
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -19,6 +19,11 @@
 
 #include "eos/math/functions.h"
 #include "eos/file/csv.h"
+#include "eos/stereo/dsc_dispatch.h"
+
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#endif
 
 namespace eos
 {
@@ -36,6 +41,11 @@ real32 DSC::Cost(nat32 leftX,nat32 rightX,nat32 y) const
  return ret;
 }
 
+void DSC::CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const
+{
+ for (nat32 i=0;i<count;i++) out[i] = Cost(leftX,rightX+i,y);
+}
+
 //------------------------------------------------------------------------------
 DifferenceDSC::DifferenceDSC(const svt::Field<real32> & l,const svt::Field<real32> & r,real32 m)
 :left(l),right(r),mult(m)
@@ -49,18 +59,6 @@ DSC * DifferenceDSC::Clone() const
  return new DifferenceDSC(left,right,mult);
 }
 
-nat32 DifferenceDSC::Bytes() const
-{
- return sizeof(real32);
-}
-
-real32 DifferenceDSC::Cost(const byte * left,const byte * right) const
-{
- real32 a = *(real32*)(void*)left;
- real32 b = *(real32*)(void*)right; 
- return math::Abs(a - b);
-}
-
 void DifferenceDSC::Join(const byte * left,const byte * right,byte * out) const
 {
  real32 a = *(real32*)(void*)left;
@@ -96,12 +94,6 @@ nat32 DifferenceDSC::HeightLeft() const
  return left.Size(1);
 }
 
-void DifferenceDSC::Left(nat32 x,nat32 y,byte * out) const
-{
- real32 & o = *(real32*)(void*)out;
- o = left.Get(x,y) * mult;
-}
-
 nat32 DifferenceDSC::WidthRight() const
 {
  return right.Size(0);
@@ -112,15 +104,15 @@ nat32 DifferenceDSC::HeightRight() const
  return right.Size(1);
 }
 
-void DifferenceDSC::Right(nat32 x,nat32 y,byte * out) const
+real32 DifferenceDSC::Cost(nat32 leftX,nat32 rightX,nat32 y) const
 {
- real32 & o = *(real32*)(void*)out;
- o = right.Get(x,y) * mult;
+ return math::Abs(left.Get(leftX,y) - right.Get(rightX,y)) * mult;
 }
 
-real32 DifferenceDSC::Cost(nat32 leftX,nat32 rightX,nat32 y) const
+void DifferenceDSC::CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const
 {
- return math::Abs(left.Get(leftX,y) - right.Get(rightX,y)) * mult;
+ real32 l = left.Get(leftX,y);
+ for (nat32 i=0;i<count;i++) out[i] = math::Abs(l - right.Get(rightX+i,y)) * mult;
 }
 
 cstrconst DifferenceDSC::TypeString() const
@@ -305,34 +297,175 @@ cstrconst BoundDifferenceDSC::TypeString() const
 }
 
 //------------------------------------------------------------------------------
-LuvDSC::LuvDSC(const svt::Field<bs::ColourLuv> & l,const svt::Field<bs::ColourLuv> & r,real32 m,real32 c)
-:left(l),right(r),mult(m),cap(c)
-{}
+// Helper for CensusDSC - a mask of the even bits used to break ties when
+// joining...
+static const nat64 censusEven = 0x5555555555555555ULL;
 
-LuvDSC::~LuvDSC()
+CensusDSC::CensusDSC(const svt::Field<real32> & l,const svt::Field<real32> & r,nat32 radiusX,nat32 radiusY,real32 m)
+:mult(m)
+{
+ radiusX = math::Min<nat32>(radiusX,31);
+ while (((2*radiusX+1)*(2*radiusY+1)>65)&&(radiusY>0)) --radiusY;
+
+ Transform(l,radiusX,radiusY,left);
+ Transform(r,radiusX,radiusY,right);
+}
+
+CensusDSC::CensusDSC(const CensusDSC & rhs)
+:DSC(),mult(rhs.mult)
+{
+ // Array2D's copy constructor is a template, so the default would be used -
+ // copy by hand...
+  left.Resize(rhs.left.Width(),rhs.left.Height());
+  right.Resize(rhs.right.Width(),rhs.right.Height());
+  for (nat32 y=0;y<left.Height();y++) mem::Copy(&left.Get(0,y),&rhs.left.Get(0,y),left.Width());
+  for (nat32 y=0;y<right.Height();y++) mem::Copy(&right.Get(0,y),&rhs.right.Get(0,y),right.Width());
+}
+
+CensusDSC::~CensusDSC()
 {}
 
-DSC * LuvDSC::Clone() const
+DSC * CensusDSC::Clone() const
 {
- return new LuvDSC(left,right,mult,cap);
+ return new CensusDSC(*this);
 }
 
-nat32 LuvDSC::Bytes() const
+void CensusDSC::Join(const byte * left,const byte * right,byte * out) const
 {
- return sizeof(real32) * 3;
+ nat64 a = *(nat64*)(void*)left;
+ nat64 b = *(nat64*)(void*)right;
+ nat64 & o = *(nat64*)(void*)out;
+ o = (a & b) | ((a ^ b) & censusEven);
 }
 
-real32 LuvDSC::Cost(const byte * left,const byte * right) const
+void CensusDSC::Join(nat32 n,const byte ** in,byte * out) const
 {
- real32 aL = *(real32*)(void*)(left);
- real32 aU = *(real32*)(void*)(left+sizeof(real32));
- real32 aV = *(real32*)(void*)(left+sizeof(real32)*2);
+ // Count the votes for each bit...
+  nat32 votes[64];
+  for (nat32 b=0;b<64;b++) votes[b] = 0;
 
- real32 bL = *(real32*)(void*)(right);
- real32 bU = *(real32*)(void*)(right+sizeof(real32));
- real32 bV = *(real32*)(void*)(right+sizeof(real32)*2);
+  nat32 num = 0;
+  for (nat32 i=0;i<n;i++)
+  {
+   if (in[i])
+   {
+    nat64 t = *(nat64*)(void*)in[i];
+    ++num;
+    for (nat32 b=0;b<64;b++) votes[b] += nat32((t>>b)&1);
+   }
+  }
+  if (num==0) return;
+
+ // Majority wins...
+  nat64 & o = *(nat64*)(void*)out;
+  o = 0;
+  for (nat32 b=0;b<64;b++)
+  {
+   nat32 v = votes[b]*2;
+   if ((v>num)||((v==num)&&((b&1)==0))) o |= nat64(1)<<b;
+  }
+}
+
+nat32 CensusDSC::WidthLeft() const
+{
+ return left.Width();
+}
+
+nat32 CensusDSC::HeightLeft() const
+{
+ return left.Height();
+}
+
+nat32 CensusDSC::WidthRight() const
+{
+ return right.Width();
+}
+
+nat32 CensusDSC::HeightRight() const
+{
+ return right.Height();
+}
+
+real32 CensusDSC::Cost(nat32 leftX,nat32 rightX,nat32 y) const
+{
+ return real32(Count(left.Get(leftX,y)^right.Get(rightX,y))) * mult;
+}
+
+void CensusDSC::CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const
+{
+ nat64 l = left.Get(leftX,y);
+ const nat64 * r = &right.Get(rightX,y);
+ nat32 i = 0;
+
+ #ifdef __SSE2__
+  // Bit count by the usual halving, with the final sum of bytes done by sad...
+   __m128i vl = _mm_set_epi32(nat32(l>>32),nat32(l),nat32(l>>32),nat32(l));
+   __m128i m1 = _mm_set1_epi8(0x55);
+   __m128i m2 = _mm_set1_epi8(0x33);
+   __m128i m4 = _mm_set1_epi8(0x0F);
+   __m128i zero = _mm_setzero_si128();
+   for (;i+2<=count;i+=2)
+   {
+    __m128i v = _mm_xor_si128(vl,_mm_loadu_si128((const __m128i*)(const void*)(r+i)));
+    v = _mm_sub_epi8(v,_mm_and_si128(_mm_srli_epi64(v,1),m1));
+    v = _mm_add_epi8(_mm_and_si128(v,m2),_mm_and_si128(_mm_srli_epi64(v,2),m2));
+    v = _mm_and_si128(_mm_add_epi8(v,_mm_srli_epi64(v,4)),m4);
+    v = _mm_sad_epu8(v,zero);
+    out[i] = real32(_mm_cvtsi128_si32(v)) * mult;
+    out[i+1] = real32(_mm_cvtsi128_si32(_mm_srli_si128(v,8))) * mult;
+   }
+ #endif
+
+ for (;i<count;i++) out[i] = real32(Count(l^r[i])) * mult;
+}
 
- return math::Min(math::Sqrt(math::Sqr(aL-bL) + math::Sqr(aU-bU) + math::Sqr(aV-bV)),cap);
+cstrconst CensusDSC::TypeString() const
+{
+ return "eos::stereo::CensusDSC";
+}
+
+void CensusDSC::Transform(const svt::Field<real32> & in,nat32 radiusX,nat32 radiusY,ds::Array2D<nat64> & out)
+{
+ int32 width = in.Size(0);
+ int32 height = in.Size(1);
+ int32 rx = radiusX;
+ int32 ry = radiusY;
+ out.Resize(width,height);
+
+ for (int32 y=0;y<height;y++)
+ {
+  for (int32 x=0;x<width;x++)
+  {
+   real32 centre = in.Get(x,y);
+   nat64 code = 0;
+   nat32 b = 0;
+   for (int32 v=-ry;v<=ry;v++)
+   {
+    int32 sy = math::Clamp<int32>(y+v,0,height-1);
+    for (int32 u=-rx;u<=rx;u++)
+    {
+     if ((u==0)&&(v==0)) continue;
+     int32 sx = math::Clamp<int32>(x+u,0,width-1);
+     if (in.Get(sx,sy)<centre) code |= nat64(1)<<b;
+     ++b;
+    }
+   }
+   out.Get(x,y) = code;
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+LuvDSC::LuvDSC(const svt::Field<bs::ColourLuv> & l,const svt::Field<bs::ColourLuv> & r,real32 m,real32 c)
+:left(l),right(r),mult(m),cap(c)
+{}
+
+LuvDSC::~LuvDSC()
+{}
+
+DSC * LuvDSC::Clone() const
+{
+ return new LuvDSC(left,right,mult,cap);
 }
 
 void LuvDSC::Join(const byte * left,const byte * right,byte * out) const
@@ -392,17 +525,6 @@ nat32 LuvDSC::HeightLeft() const
  return left.Size(1);
 }
 
-void LuvDSC::Left(nat32 x,nat32 y,byte * out) const
-{
- real32 & oL = *(real32*)(void*)(out);
- real32 & oU = *(real32*)(void*)(out+sizeof(real32));
- real32 & oV = *(real32*)(void*)(out+sizeof(real32)*2);
- 
- oL = left.Get(x,y).l * mult;
- oU = left.Get(x,y).u * mult;
- oV = left.Get(x,y).v * mult;
-}
-
 nat32 LuvDSC::WidthRight() const
 {
  return right.Size(0);
@@ -413,17 +535,6 @@ nat32 LuvDSC::HeightRight() const
  return right.Size(1);
 }
 
-void LuvDSC::Right(nat32 x,nat32 y,byte * out) const
-{
- real32 & oL = *(real32*)(void*)(out);
- real32 & oU = *(real32*)(void*)(out+sizeof(real32));
- real32 & oV = *(real32*)(void*)(out+sizeof(real32)*2);
- 
- oL = right.Get(x,y).l * mult;
- oU = right.Get(x,y).u * mult;
- oV = right.Get(x,y).v * mult;
-}
-
 real32 LuvDSC::Cost(nat32 leftX,nat32 rightX,nat32 y) const
 {
  byte temp[sizeof(real32) * 6];
@@ -432,6 +543,24 @@ real32 LuvDSC::Cost(nat32 leftX,nat32 rightX,nat32 y) const
  return Cost(temp,temp + sizeof(real32)*3);
 }
 
+void LuvDSC::CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const
+{
+ const bs::ColourLuv & a = left.Get(leftX,y);
+ real32 aL = a.l * mult;
+ real32 aU = a.u * mult;
+ real32 aV = a.v * mult;
+
+ for (nat32 i=0;i<count;i++)
+ {
+  const bs::ColourLuv & b = right.Get(rightX+i,y);
+  real32 bL = b.l * mult;
+  real32 bU = b.u * mult;
+  real32 bV = b.v * mult;
+
+  out[i] = math::Min(math::Sqrt(math::Sqr(aL-bL) + math::Sqr(aU-bU) + math::Sqr(aV-bV)),cap);
+ }
+}
+
 cstrconst LuvDSC::TypeString() const
 {
  return "eos::stereo::LuvDSC";
@@ -565,6 +694,24 @@ real32 SqrLuvDSC::Cost(nat32 leftX,nat32 rightX,nat32 y) const
  return Cost(temp,temp + sizeof(real32)*3);
 }
 
+void SqrLuvDSC::CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const
+{
+ const bs::ColourLuv & a = left.Get(leftX,y);
+ real32 aL = a.l * mult;
+ real32 aU = a.u * mult;
+ real32 aV = a.v * mult;
+
+ for (nat32 i=0;i<count;i++)
+ {
+  const bs::ColourLuv & b = right.Get(rightX+i,y);
+  real32 bL = b.l * mult;
+  real32 bU = b.u * mult;
+  real32 bV = b.v * mult;
+
+  out[i] = math::Min(math::Sqr(aL-bL) + math::Sqr(aU-bU) + math::Sqr(aV-bV),cap);
+ }
+}
+
 cstrconst SqrLuvDSC::TypeString() const
 {
  return "eos::stereo::SqrLuvDSC";
@@ -698,6 +845,24 @@ real32 ManLuvDSC::Cost(nat32 leftX,nat32 rightX,nat32 y) const
  return Cost(temp,temp + sizeof(real32)*3);
 }
 
+void ManLuvDSC::CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const
+{
+ const bs::ColourLuv & a = left.Get(leftX,y);
+ real32 aL = a.l * mult;
+ real32 aU = a.u * mult;
+ real32 aV = a.v * mult;
+
+ for (nat32 i=0;i<count;i++)
+ {
+  const bs::ColourLuv & b = right.Get(rightX+i,y);
+  real32 bL = b.l * mult;
+  real32 bU = b.u * mult;
+  real32 bV = b.v * mult;
+
+  out[i] = math::Min(math::Abs(aL-bL) + math::Abs(aU-bU) + math::Abs(aV-bV),cap);
+ }
+}
+
 cstrconst ManLuvDSC::TypeString() const
 {
  return "eos::stereo::ManLuvDSC";
@@ -980,34 +1145,6 @@ void BoundLuvDSC::SetCap(real32 c)
  cap = c;
 }
 
-nat32 BoundLuvDSC::Bytes() const
-{
- return sizeof(real32) * 6;
-}
-
-real32 BoundLuvDSC::Cost(const byte * left,const byte * right) const
-{
- real32 aMinL = *(real32*)(void*)(left);
- real32 aMaxL = *(real32*)(void*)(left+sizeof(real32));
- real32 aMinU = *(real32*)(void*)(left+sizeof(real32)*2);
- real32 aMaxU = *(real32*)(void*)(left+sizeof(real32)*3);
- real32 aMinV = *(real32*)(void*)(left+sizeof(real32)*4);
- real32 aMaxV = *(real32*)(void*)(left+sizeof(real32)*5);
-
- real32 bMinL = *(real32*)(void*)(right);
- real32 bMaxL = *(real32*)(void*)(right+sizeof(real32));
- real32 bMinU = *(real32*)(void*)(right+sizeof(real32)*2);
- real32 bMaxU = *(real32*)(void*)(right+sizeof(real32)*3);
- real32 bMinV = *(real32*)(void*)(right+sizeof(real32)*4);
- real32 bMaxV = *(real32*)(void*)(right+sizeof(real32)*5);
-
- real32 dL = math::Max<real32>(0.0,aMinL-bMaxL,bMinL-aMaxL);
- real32 dU = math::Max<real32>(0.0,aMinU-bMaxU,bMinU-aMaxU);
- real32 dV = math::Max<real32>(0.0,aMinV-bMaxV,bMinV-aMaxV);
-
- return math::Min(math::Sqrt(math::Sqr(dL) + math::Sqr(dU) + math::Sqr(dV))*mult,cap);
-}
-
 void BoundLuvDSC::Join(const byte * left,const byte * right,byte * out) const
 {
  real32 aMinL = *(real32*)(void*)(left);
@@ -1262,6 +1399,19 @@ real32 BoundLuvDSC::Cost(nat32 leftX,nat32 rightX,nat32 y) const
  return Cost(temp,temp + sizeof(real32)*6);
 }
 
+void BoundLuvDSC::CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const
+{
+ // The left bound only needs calculating once, the right bound is the
+ // expensive bit regardless...
+  byte temp[sizeof(real32) * 12];
+  BoundLuvDSC::Left(leftX,y,temp);
+  for (nat32 i=0;i<count;i++)
+  {
+   BoundLuvDSC::Right(rightX+i,y,temp + sizeof(real32)*6);
+   out[i] = BoundLuvDSC::Cost(temp,temp + sizeof(real32)*6);
+  }
+}
+
 cstrconst BoundLuvDSC::TypeString() const
 {
  return "eos::stereo::BoundLuvDSC";
@@ -2755,6 +2905,19 @@ void EuclideanDSC::Right(nat32 x,nat32 y,byte * out) const
  log::Assert(offset==bytes);
 }
 
+void EuclideanDSC::CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const
+{
+ // Matches the default Cost, but with the left side only fetched once...
+  byte * temp = mem::Malloc<byte>(bytes*2);
+  EuclideanDSC::Left(leftX,y,temp);
+  for (nat32 i=0;i<count;i++)
+  {
+   EuclideanDSC::Right(rightX+i,y,temp+bytes);
+   out[i] = EuclideanDSC::Cost(temp,temp+bytes);
+  }
+  mem::Free(temp);
+}
+
 cstrconst EuclideanDSC::TypeString() const
 {
  return "eos::stereo::EuclideanDSC";
@@ -3185,6 +3348,38 @@ real32 HierarchyDSC::HierLevel::Cost(nat32 leftX,nat32 rightX,nat32 y) const
  return dsc->Cost(l,r);
 }
 
+// Kernel for HierLevel::CostRun, instantiated for each kind of DSC...
+class HierCostRun
+{
+ public:
+  const byte * left;
+  const byte * right;
+  nat32 count;
+  real32 * out;
+
+  template <typename T>
+  void operator()(const T & dsc)
+  {
+   nat32 bytes = DSCOps<T>::Bytes(dsc);
+   const byte * r = right;
+   for (nat32 i=0;i<count;i++)
+   {
+    out[i] = DSCOps<T>::Cost(dsc,left,r);
+    r += bytes;
+   }
+  }
+};
+
+void HierarchyDSC::HierLevel::CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const
+{
+ HierCostRun hcr;
+ hcr.left = leftData + dsc->Bytes()*(widthLeft*y + leftX);
+ hcr.right = rightData + dsc->Bytes()*(widthRight*y + rightX);
+ hcr.count = count;
+ hcr.out = out;
+ DispatchDSC(*dsc,hcr);
+}
+
 cstrconst HierarchyDSC::HierLevel::TypeString() const
 {
  return "eos::stereo::HierarchyDSC::HierLevel";
@@ -3299,6 +3494,226 @@ cstrconst DummyDSI::TypeString() const
  return "eos::stereo::DummyDSI";
 }
 
+//------------------------------------------------------------------------------
+CompactDSI::CompactDSI()
+:width(0),height(0),dispWidth(0.5),rowsDone(0)
+{}
+
+CompactDSI::~CompactDSI()
+{
+ Clear();
+}
+
+void CompactDSI::Begin(nat32 w,nat32 h,real32 dw)
+{
+ Clear();
+ width = w;
+ height = h;
+ dispWidth = dw;
+
+ index.Size(height*(width+1));
+ base.Size(width*height);
+ rows.Size(height);
+ for (nat32 y=0;y<height;y++) rows[y].data = null<byte*>();
+ rowsDone = 0;
+}
+
+void CompactDSI::AddRow(const nat32 * ind,const int32 * disp,const real32 * cost)
+{
+ log::Assert(rowsDone<height,"CompactDSI::AddRow called too often");
+ nat32 y = rowsDone++;
+ nat32 entrys = ind[width] - ind[0];
+ Row & row = rows[y];
+
+ // Index, and find the base of each pixel, the largest span and largest cost...
+  nat32 * ri = &index[y*(width+1)];
+  int16 * rb = &base[y*width];
+  int32 span = 0;
+  real32 maxCost = 0.0;
+  for (nat32 x=0;x<width;x++)
+  {
+   ri[x] = ind[x] - ind[0];
+   rb[x] = 0;
+   if (ind[x+1]==ind[x]) continue;
+
+   int32 low = disp[ind[x]];
+   int32 high = low;
+   for (nat32 i=ind[x];i<ind[x+1];i++)
+   {
+    low = math::Min(low,disp[i]);
+    high = math::Max(high,disp[i]);
+    if (cost[i]<math::Infinity<real32>()) maxCost = math::Max(maxCost,cost[i]);
+   }
+   rb[x] = int16(math::Clamp<int32>(low,-32768,32767));
+   span = math::Max(span,high-low);
+  }
+  ri[width] = entrys;
+
+ // Create the block and fill it...
+  row.wide = span>255;
+  row.scale = (maxCost>0.0)?(maxCost/65535.0):1.0;
+  row.data = mem::Malloc<byte>(entrys*(row.wide?4:3));
+
+  nat16 * rc = (nat16*)(void*)row.data;
+  for (nat32 x=0;x<width;x++)
+  {
+   for (nat32 i=ind[x];i<ind[x+1];i++)
+   {
+    nat32 e = i - ind[0];
+    real32 q = cost[i]/row.scale + 0.5;
+    rc[e] = (q<65535.0)?nat16(math::Max<real32>(q,0.0)):nat16(65535);
+
+    int32 off = math::Clamp<int32>(disp[i] - int32(rb[x]),0,65535);
+    if (row.wide) ((nat16*)(void*)(row.data + entrys*2))[e] = nat16(off);
+             else row.data[entrys*2 + e] = byte(off);
+   }
+  }
+}
+
+void CompactDSI::Set(const DSI & dsi,time::Progress * prog)
+{
+ prog->Push();
+
+ // Find the disparity width off the first entry...
+  real32 dw = 0.5;
+  bit found = false;
+  for (nat32 y=0;(y<dsi.Height())&&(!found);y++)
+  {
+   for (nat32 x=0;x<dsi.Width();x++)
+   {
+    if (dsi.Size(x,y)!=0)
+    {
+     dw = dsi.DispWidth(x,y,0);
+     found = true;
+     break;
+    }
+   }
+  }
+
+ // Stream the rows over...
+  Begin(dsi.Width(),dsi.Height(),dw);
+  ds::Array<nat32> ind(width+1);
+  ds::Array<int32> disp;
+  ds::Array<real32> cost;
+  for (nat32 y=0;y<height;y++)
+  {
+   prog->Report(y,height);
+   ind[0] = 0;
+   for (nat32 x=0;x<width;x++) ind[x+1] = ind[x] + dsi.Size(x,y);
+
+   if (disp.Size()<ind[width])
+   {
+    disp.Size(ind[width]);
+    cost.Size(ind[width]);
+   }
+
+   for (nat32 x=0;x<width;x++)
+   {
+    for (nat32 i=0;i<ind[x+1]-ind[x];i++)
+    {
+     disp[ind[x]+i] = int32(math::RoundDown(dsi.Disp(x,y,i)+0.5));
+     cost[ind[x]+i] = dsi.Cost(x,y,i);
+    }
+   }
+
+   AddRow(&ind[0],disp.Ptr(),cost.Ptr());
+  }
+
+ prog->Pop();
+}
+
+void CompactDSI::SortByCost(time::Progress * prog)
+{
+ prog->Push();
+ for (nat32 y=0;y<rowsDone;y++)
+ {
+  prog->Report(y,rowsDone);
+  const Row & row = rows[y];
+  const nat32 * ri = &index[y*(width+1)];
+  nat32 entrys = ri[width];
+  nat16 * rc = (nat16*)(void*)row.data;
+  nat16 * wo = (nat16*)(void*)(row.data + entrys*2);
+  byte * no = row.data + entrys*2;
+
+  // Insertion sort of each pixel, as they are small...
+   for (nat32 x=0;x<width;x++)
+   {
+    for (nat32 i=ri[x]+1;i<ri[x+1];i++)
+    {
+     nat16 c = rc[i];
+     nat16 o = row.wide?wo[i]:nat16(no[i]);
+     nat32 j = i;
+     while ((j>ri[x])&&(rc[j-1]>c))
+     {
+      rc[j] = rc[j-1];
+      if (row.wide) wo[j] = wo[j-1]; else no[j] = no[j-1];
+      --j;
+     }
+     rc[j] = c;
+     if (row.wide) wo[j] = o; else no[j] = byte(o);
+    }
+   }
+ }
+ prog->Pop();
+}
+
+nat32 CompactDSI::Memory() const
+{
+ nat32 ret = sizeof(CompactDSI) + index.Size()*sizeof(nat32) + base.Size()*sizeof(int16) + rows.Size()*sizeof(Row);
+ for (nat32 y=0;y<rowsDone;y++) ret += index[y*(width+1)+width] * (rows[y].wide?4:3);
+ return ret;
+}
+
+nat32 CompactDSI::Width() const
+{
+ return width;
+}
+
+nat32 CompactDSI::Height() const
+{
+ return height;
+}
+
+nat32 CompactDSI::Size(nat32 x,nat32 y) const
+{
+ if (y>=rowsDone) return 0;
+ const nat32 * ri = &index[y*(width+1)+x];
+ return ri[1] - ri[0];
+}
+
+real32 CompactDSI::Disp(nat32 x,nat32 y,nat32 i) const
+{
+ const Row & row = rows[y];
+ nat32 entrys = index[y*(width+1)+width];
+ nat32 e = index[y*(width+1)+x] + i;
+ int32 off = row.wide ? ((const nat16*)(const void*)(row.data + entrys*2))[e] : row.data[entrys*2 + e];
+ return real32(int32(base[y*width+x]) + off);
+}
+
+real32 CompactDSI::Cost(nat32 x,nat32 y,nat32 i) const
+{
+ const Row & row = rows[y];
+ nat32 e = index[y*(width+1)+x] + i;
+ return real32(((const nat16*)(const void*)row.data)[e]) * row.scale;
+}
+
+real32 CompactDSI::DispWidth(nat32 x,nat32 y,nat32 i) const
+{
+ return dispWidth;
+}
+
+cstrconst CompactDSI::TypeString() const
+{
+ return "eos::stereo::CompactDSI";
+}
+
+void CompactDSI::Clear()
+{
+ for (nat32 y=0;y<rows.Size();y++) mem::Free(rows[y].data);
+ rows.Size(0);
+ rowsDone = 0;
+}
+
 //------------------------------------------------------------------------------
  };
 };
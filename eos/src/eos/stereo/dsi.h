@@ -26,6 +26,7 @@
 #include "eos/ds/arrays.h"
 #include "eos/ds/arrays2d.h"
 #include "eos/svt/field.h"
+#include "eos/time/progress.h"
 
 namespace eos
 {
@@ -103,6 +104,15 @@ class EOS_CLASS DSC : public Deletable
   /// defined in terms of Left(..)/Right(...), but that involves heap bashing.
    virtual real32 Cost(nat32 leftX,nat32 rightX,nat32 y) const;
 
+  /// Batch version of the above, fills out[i] with Cost(leftX,rightX+i,y) for
+  /// i in [0,count), i.e. the costs of a run of disparities for a single pixel,
+  /// or of an entire scanline if rightX is 0 and count is WidthRight().
+  /// rightX+count must not exceed WidthRight(). The default just calls the
+  /// above for each, but the common implimentations override it with a tight
+  /// loop that avoids a virtual call per cost. Always gives the exact same
+  /// answers as calling the above.
+   virtual void CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const;
+
 
   /// &nbsp;
    virtual cstrconst TypeString() const = 0;
@@ -160,6 +170,9 @@ class EOS_CLASS DifferenceDSC : public DSC
   /// &nbsp;
    real32 Cost(nat32 leftX,nat32 rightX,nat32 y) const;
 
+  /// &nbsp;
+   void CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const;
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -237,6 +250,89 @@ class EOS_CLASS BoundDifferenceDSC : public DSC
   real32 mult;
 };
 
+//------------------------------------------------------------------------------
+/// Defines a DSC using the census transform of two fields of reals. Each pixel
+/// is represented by a 64 bit code, with a bit for each other pixel in a
+/// window around it, set if that pixel is darker than the centre. The cost is
+/// the Hamming distance between the codes, multiplied by mult, which being
+/// based only on the ordering of intensities is immune to the gain and bias
+/// differences between cameras. The codes are calculated for both images in
+/// the constructor, so matching is an xor and a bit count.
+/// For joining it takes a bitwise majority vote, with ties going to set for
+/// even bits and unset for odd bits, so it works with HierarchyDSC.
+class EOS_CLASS CensusDSC : public DSC
+{
+ public:
+  /// The window is (2*radiusX+1) by (2*radiusY+1), which must have no more
+  /// than 65 pixels - radiusY is reduced if its too large. The default 7x7
+  /// window uses 48 of the bits. Pixels outside the image are clamped to the
+  /// edge.
+   CensusDSC(const svt::Field<real32> & left,const svt::Field<real32> & right,nat32 radiusX = 3,nat32 radiusY = 3,real32 mult = 1.0);
+
+  /// &nbsp;
+   ~CensusDSC();
+
+  /// &nbsp;
+   DSC * Clone() const;
+
+
+  /// &nbsp;
+   nat32 Bytes() const;
+
+  /// &nbsp;
+   real32 Cost(const byte * left,const byte * right) const;
+
+  /// &nbsp;
+   void Join(const byte * left,const byte * right,byte * out) const;
+
+  /// &nbsp;
+   void Join(nat32 n,const byte ** in,byte * out) const;
+
+
+  /// &nbsp;
+   nat32 WidthLeft() const;
+
+  /// &nbsp;
+   nat32 HeightLeft() const;
+
+  /// &nbsp;
+   void Left(nat32 x,nat32 y,byte * out) const;
+
+
+  /// &nbsp;
+   nat32 WidthRight() const;
+
+  /// &nbsp;
+   nat32 HeightRight() const;
+
+  /// &nbsp;
+   void Right(nat32 x,nat32 y,byte * out) const;
+
+
+  /// &nbsp;
+   real32 Cost(nat32 leftX,nat32 rightX,nat32 y) const;
+
+  /// Two codes at a time with SSE2.
+   void CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const;
+
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  CensusDSC(const CensusDSC & rhs);
+
+  ds::Array2D<nat64> left;
+  ds::Array2D<nat64> right;
+  real32 mult;
+
+  // A bit count of a 64 bit code...
+   static nat32 Count(nat64 v);
+
+  static void Transform(const svt::Field<real32> & in,nat32 radiusX,nat32 radiusY,ds::Array2D<nat64> & out);
+};
+
 //------------------------------------------------------------------------------
 /// Defines a DSC in terms of the Luv colour space, using euclidian distance for costs.
 /// Uses averages.
@@ -290,6 +386,9 @@ class EOS_CLASS LuvDSC : public DSC
   /// &nbsp;
    real32 Cost(nat32 leftX,nat32 rightX,nat32 y) const;
 
+  /// &nbsp;
+   void CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const;
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -356,6 +455,9 @@ class EOS_CLASS SqrLuvDSC : public DSC
   /// &nbsp;
    real32 Cost(nat32 leftX,nat32 rightX,nat32 y) const;
 
+  /// &nbsp;
+   void CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const;
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -421,6 +523,9 @@ class EOS_CLASS ManLuvDSC : public DSC
   /// &nbsp;
    real32 Cost(nat32 leftX,nat32 rightX,nat32 y) const;
 
+  /// &nbsp;
+   void CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const;
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -571,6 +676,9 @@ class EOS_CLASS BoundLuvDSC : public DSC
   /// &nbsp;
    real32 Cost(nat32 leftX,nat32 rightX,nat32 y) const;
 
+  /// &nbsp;
+   void CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const;
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -1086,6 +1194,9 @@ class EOS_CLASS EuclideanDSC : public DSC
   /// &nbsp;
    void Right(nat32 x,nat32 y,byte * out) const;
 
+  /// &nbsp;
+   void CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const;
+
 
   /// &nbsp;
    cstrconst TypeString() const;
@@ -1232,6 +1343,7 @@ class EOS_CLASS HierarchyDSC
      void Right(nat32 x,nat32 y,byte * out) const;
 
      real32 Cost(nat32 leftX,nat32 rightX,nat32 y) const;
+     void CostRun(nat32 leftX,nat32 rightX,nat32 y,nat32 count,real32 * out) const;
 
      cstrconst TypeString() const;
    };
@@ -1356,6 +1468,219 @@ class EOS_CLASS DummyDSI : public DSI
   svt::Field<bit> mask;
 };
 
+//------------------------------------------------------------------------------
+/// A compact store for a sparse DSI, for when a real32 cost and disparity per
+/// entry is too much. Costs are 16 bit fixed point, with a scale per row set
+/// from the rows largest cost. Disparities are stored as offsets from the
+/// smallest disparity of each pixel, in 8 bits if every pixel in the row spans
+/// less than 256 disparities, 16 otherwise. Each row is a single block of
+/// memory found via a per row table, with a per pixel start index into it.
+/// Built a row at a time, so a source can be streamed in without a dense
+/// volume ever existing - SparseDSI can output directly to it. Random access
+/// to any entry remains constant time.
+class EOS_CLASS CompactDSI : public DSI
+{
+ public:
+  /// &nbsp;
+   CompactDSI();
+
+  /// &nbsp;
+   ~CompactDSI();
+
+
+  /// Starts a new build, throwing away any previous contents. Rows must then be
+  /// provided in order, from 0 to height-1, with AddRow. dispWidth is the
+  /// value DispWidth returns for every entry.
+   void Begin(nat32 width,nat32 height,real32 dispWidth = 0.5);
+
+  /// Adds the next row. index has width+1 entrys, pixel x having entrys
+  /// [index[x],index[x+1]) in disp and cost. The order of entrys within a pixel
+  /// is preserved.
+   void AddRow(const nat32 * index,const int32 * disp,const real32 * cost);
+
+  /// Builds from any other DSI, a row at a time, copying DispWidth from the
+  /// first entry found.
+   void Set(const DSI & dsi,time::Progress * prog = null<time::Progress*>());
+
+  /// Re-sorts the entrys of each pixel so the lowest cost comes first.
+   void SortByCost(time::Progress * prog = null<time::Progress*>());
+
+  /// Returns how many bytes of storage are in use.
+   nat32 Memory() const;
+
+
+  /// &nbsp;
+   nat32 Width() const;
+
+  /// &nbsp;
+   nat32 Height() const;
+
+  /// &nbsp;
+   nat32 Size(nat32 x,nat32 y) const;
+
+  /// &nbsp;
+   real32 Disp(nat32 x,nat32 y,nat32 i) const;
+
+  /// &nbsp;
+   real32 Cost(nat32 x,nat32 y,nat32 i) const;
+
+  /// &nbsp;
+   real32 DispWidth(nat32 x,nat32 y,nat32 i) const;
+
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  nat32 width;
+  nat32 height;
+  real32 dispWidth;
+
+  // Per pixel, the start of its entrys in its row, with width+1 per row, and
+  // the disparity the offsets are relative to...
+   ds::Array<nat32> index;
+   ds::Array<int16> base;
+
+  // Per row, a block with all the 16 bit costs followed by all the disparity
+  // offsets...
+   struct Row
+   {
+    byte * data;
+    real32 scale;
+    bit wide;
+   };
+   ds::Array<Row> rows;
+   nat32 rowsDone;
+
+  void Clear();
+};
+
+//------------------------------------------------------------------------------
+// The per value methods of the common DSC-s are inline, so the kernels
+// instantiated for them via DispatchDSC (dsc_dispatch.h) can inline them...
+inline nat32 CensusDSC::Count(nat64 v)
+{
+ v = v - ((v>>1) & 0x5555555555555555ULL);
+ v = (v & 0x3333333333333333ULL) + ((v>>2) & 0x3333333333333333ULL);
+ v = (v + (v>>4)) & 0x0F0F0F0F0F0F0F0FULL;
+ return nat32((v * 0x0101010101010101ULL)>>56);
+}
+
+inline nat32 DifferenceDSC::Bytes() const
+{
+ return sizeof(real32);
+}
+
+inline real32 DifferenceDSC::Cost(const byte * left,const byte * right) const
+{
+ real32 a = *(real32*)(void*)left;
+ real32 b = *(real32*)(void*)right; 
+ return math::Abs(a - b);
+}
+
+inline void DifferenceDSC::Left(nat32 x,nat32 y,byte * out) const
+{
+ real32 & o = *(real32*)(void*)out;
+ o = left.Get(x,y) * mult;
+}
+
+inline void DifferenceDSC::Right(nat32 x,nat32 y,byte * out) const
+{
+ real32 & o = *(real32*)(void*)out;
+ o = right.Get(x,y) * mult;
+}
+
+inline nat32 CensusDSC::Bytes() const
+{
+ return sizeof(nat64);
+}
+
+inline real32 CensusDSC::Cost(const byte * left,const byte * right) const
+{
+ nat64 a = *(nat64*)(void*)left;
+ nat64 b = *(nat64*)(void*)right;
+ return real32(Count(a^b)) * mult;
+}
+
+inline void CensusDSC::Left(nat32 x,nat32 y,byte * out) const
+{
+ *(nat64*)(void*)out = left.Get(x,y);
+}
+
+inline void CensusDSC::Right(nat32 x,nat32 y,byte * out) const
+{
+ *(nat64*)(void*)out = right.Get(x,y);
+}
+
+inline nat32 LuvDSC::Bytes() const
+{
+ return sizeof(real32) * 3;
+}
+
+inline real32 LuvDSC::Cost(const byte * left,const byte * right) const
+{
+ real32 aL = *(real32*)(void*)(left);
+ real32 aU = *(real32*)(void*)(left+sizeof(real32));
+ real32 aV = *(real32*)(void*)(left+sizeof(real32)*2);
+
+ real32 bL = *(real32*)(void*)(right);
+ real32 bU = *(real32*)(void*)(right+sizeof(real32));
+ real32 bV = *(real32*)(void*)(right+sizeof(real32)*2);
+
+ return math::Min(math::Sqrt(math::Sqr(aL-bL) + math::Sqr(aU-bU) + math::Sqr(aV-bV)),cap);
+}
+
+inline void LuvDSC::Left(nat32 x,nat32 y,byte * out) const
+{
+ real32 & oL = *(real32*)(void*)(out);
+ real32 & oU = *(real32*)(void*)(out+sizeof(real32));
+ real32 & oV = *(real32*)(void*)(out+sizeof(real32)*2);
+ 
+ oL = left.Get(x,y).l * mult;
+ oU = left.Get(x,y).u * mult;
+ oV = left.Get(x,y).v * mult;
+}
+
+inline void LuvDSC::Right(nat32 x,nat32 y,byte * out) const
+{
+ real32 & oL = *(real32*)(void*)(out);
+ real32 & oU = *(real32*)(void*)(out+sizeof(real32));
+ real32 & oV = *(real32*)(void*)(out+sizeof(real32)*2);
+ 
+ oL = right.Get(x,y).l * mult;
+ oU = right.Get(x,y).u * mult;
+ oV = right.Get(x,y).v * mult;
+}
+
+inline nat32 BoundLuvDSC::Bytes() const
+{
+ return sizeof(real32) * 6;
+}
+
+inline real32 BoundLuvDSC::Cost(const byte * left,const byte * right) const
+{
+ real32 aMinL = *(real32*)(void*)(left);
+ real32 aMaxL = *(real32*)(void*)(left+sizeof(real32));
+ real32 aMinU = *(real32*)(void*)(left+sizeof(real32)*2);
+ real32 aMaxU = *(real32*)(void*)(left+sizeof(real32)*3);
+ real32 aMinV = *(real32*)(void*)(left+sizeof(real32)*4);
+ real32 aMaxV = *(real32*)(void*)(left+sizeof(real32)*5);
+
+ real32 bMinL = *(real32*)(void*)(right);
+ real32 bMaxL = *(real32*)(void*)(right+sizeof(real32));
+ real32 bMinU = *(real32*)(void*)(right+sizeof(real32)*2);
+ real32 bMaxU = *(real32*)(void*)(right+sizeof(real32)*3);
+ real32 bMinV = *(real32*)(void*)(right+sizeof(real32)*4);
+ real32 bMaxV = *(real32*)(void*)(right+sizeof(real32)*5);
+
+ real32 dL = math::Max<real32>(0.0,aMinL-bMaxL,bMinL-aMaxL);
+ real32 dU = math::Max<real32>(0.0,aMinU-bMaxU,bMinU-aMaxU);
+ real32 dV = math::Max<real32>(0.0,aMinV-bMaxV,bMinV-aMaxV);
+
+ return math::Min(math::Sqrt(math::Sqr(dL) + math::Sqr(dU) + math::Sqr(dV))*mult,cap);
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -22,6 +22,8 @@
 #include "eos/cam/triangulation.h"
 #include "eos/alg/fitting.h"
 #include "eos/alg/depth_plane.h"
+#include "eos/mt/tasks.h"
+#include "eos/stereo/dsc_dispatch.h"
 
 namespace eos
 {
@@ -30,7 +32,7 @@ namespace eos
 //------------------------------------------------------------------------------
 SparseDSI::SparseDSI()
 :occCost(1.0),horizCost(1.0),vertCost(1.0),vertMult(0.2),errLim(0.1),
-dsc(null<DSC*>())
+dsc(null<DSC*>()),compact(false)
 {}
 
 SparseDSI::~SparseDSI()
@@ -63,8 +65,11 @@ void SparseDSI::Run(time::Progress * prog)
    height = dsc->HeightLeft();
    widthRight  = dsc->WidthRight();
    heightRight = dsc->HeightRight();
-   data.Size(height);
-   for (nat32 y=0;y<height;y++) data[y].index.Size(width+1);
+   data.Size(compact?2:height);
+   for (nat32 y=0;y<data.Size();y++) data[y].index.Size(width+1);
+   if (compact) store.Begin(width,height,0.5);
+   ds::Array<int32> rowDisp;
+   ds::Array<real32> rowCost;
    
    
    ds::ArrayDel<DoubleNatWindow> pass(dsc->WidthRight());
@@ -169,7 +174,7 @@ void SparseDSI::Run(time::Progress * prog)
     // in for the difference with the previous row...
      if (y!=0)
      {
-      prevRow[0] = data[y-1];
+      prevRow[0] = data[compact?((y-1)&1):(y-1)];
       for (nat32 i=1;i<prevRow.Size();i++) HalfScanline(prevRow[i-1],prevRow[i]);     
       for (nat32 i=0;i<prevRow.Size();i++) PropagateScanline(prevRow[i]);
      }
@@ -199,57 +204,15 @@ void SparseDSI::Run(time::Progress * prog)
         if (l+1!=int32(levels)) PrepProg(l,dsiProg);
        
        // Fill in the costs...
-        nat32 vertOffset = 0;
-        for (nat32 i=0;i<dsiProg.Size();i++)
-        {
-         // Pixel to pixel matching cost...
-          dsiProg[i].cost = dsc->Cost(col[0][l] + dsc->Bytes()*dsiProg[i].left,
-                                      col[1][l] + dsc->Bytes()*dsiProg[i].right);
-
-         // Vertical consistancy cost...
-          if (y!=0)
-          {
-           // Find the adjacent data position, done this way as whilst fiddly it
-           // makes for an approximatly O(n) algorithm...
-            vertOffset = math::Max(vertOffset,prevRow[l].index[dsiProg[i].left]);
-            while (true)
-            {
-             if (prevRow[l].data[vertOffset].disp>=dsiProg[i].right-dsiProg[i].left) break;
-             if (vertOffset+1>=prevRow[l].index[dsiProg[i].left+1]) break;
-             vertOffset += 1;
-            }
-
-           if ((vertOffset>=prevRow[l].index[dsiProg[i].left])&&(vertOffset<prevRow[l].index[dsiProg[i].left+1]))
-           {
-            // Calculate the vertical cost...
-             real32 bestVert;
-             if (prevRow[l].data[vertOffset].disp==(dsiProg[i].right-dsiProg[i].left))
-             {
-              bestVert = prevRow[l].data[vertOffset].cost;
-             }
-             else
-             {
-              bestVert = prevRow[l].data[vertOffset].cost + 
-                         vertCost * math::Abs(prevRow[l].data[vertOffset].disp - (dsiProg[i].right-dsiProg[i].left));
-
-              if (vertOffset>prevRow[l].index[dsiProg[i].left])
-              {
-               bestVert = math::Min(bestVert,prevRow[l].data[vertOffset-1].cost +
-                                    vertCost * math::Abs(prevRow[l].data[vertOffset-1].disp
-                                    - (dsiProg[i].right-dsiProg[i].left)));
-              }
-             }
-          
-            // Add the vertical cost, including a term to take into account vertical similarity...
-             real32 pixMatch = dsc->Cost(col[0][l] + dsc->Bytes()*dsiProg[i].left,
-                                         oldCol[0][l] + dsc->Bytes()*dsiProg[i].left);
-             pixMatch += dsc->Cost(col[1][l] + dsc->Bytes()*dsiProg[i].right,
-                                   oldCol[1][l] + dsc->Bytes()*dsiProg[i].right);
-
-             dsiProg[i].cost += math::Exp(-vertMult*pixMatch) * vertMult * bestVert;
-           }
-          }
-        }
+        CostFunc costFunc;
+        costFunc.self = this;
+        costFunc.level = l;
+        costFunc.y = y;
+        costFunc.col = col;
+        costFunc.oldCol = oldCol;
+        costFunc.prog = &dsiProg;
+        costFunc.prevRow = &prevRow;
+        DispatchDSC(*dsc,costFunc);
        
       // Run through the passes...
        FirstPass(l,dsiProg,pass);
@@ -259,8 +222,22 @@ void SparseDSI::Run(time::Progress * prog)
 
 
     // Extract the final result from the final prog...
-     Extract(dsiProg,data[y].index,data[y].data);
-     dispCount += data[y].data.Size();
+     Scanline & row = data[compact?(y&1):y];
+     Extract(dsiProg,row.index,row.data);
+     dispCount += row.data.Size();
+
+    // If compact send it on its way...
+     if (compact)
+     {
+      rowDisp.Size(row.data.Size());
+      rowCost.Size(row.data.Size());
+      for (nat32 i=0;i<row.data.Size();i++)
+      {
+       rowDisp[i] = row.data[i].disp;
+       rowCost[i] = row.data[i].cost;
+      }
+      store.AddRow(&row.index[0],rowDisp.Ptr(),rowCost.Ptr());
+     }
    }
 
 
@@ -286,21 +263,30 @@ void SparseDSI::Run(time::Progress * prog)
 
 nat32 SparseDSI::Size(nat32 x,nat32 y) const
 {
+ if (compact) return store.Size(x,y);
  return data[y].index[x+1] - data[y].index[x];
 }
 
 real32 SparseDSI::Disp(nat32 x,nat32 y,nat32 i) const
 {
+ if (compact) return store.Disp(x,y,i);
  return data[y].data[data[y].index[x]+i].disp;
 }
 
 real32 SparseDSI::Cost(nat32 x,nat32 y,nat32 i) const
 {
+ if (compact) return store.Cost(x,y,i);
  return data[y].data[data[y].index[x]+i].cost;
 }
 
 void SparseDSI::SortByCost(time::Progress * prog)
 {
+ if (compact)
+ {
+  store.SortByCost(prog);
+  return;
+ }
+
  prog->Push();
   // Simply sort each pixel by a suitable cost function...
   // (Lots of lil' sorts.)
@@ -315,6 +301,64 @@ void SparseDSI::SortByCost(time::Progress * prog)
  prog->Pop();
 }
 
+template <typename T>
+void SparseDSI::LevelCosts(const T & d,nat32 level,nat32 y,byte ** col[2],byte ** oldCol[2],
+                           ds::ArrayNS<Node> & prog,ds::ArrayDel<Scanline> & prevRow)
+{
+ nat32 bytes = DSCOps<T>::Bytes(d);
+ nat32 vertOffset = 0;
+ for (nat32 i=0;i<prog.Size();i++)
+ {
+  // Pixel to pixel matching cost...
+   prog[i].cost = DSCOps<T>::Cost(d,col[0][level] + bytes*prog[i].left,
+                                    col[1][level] + bytes*prog[i].right);
+
+  // Vertical consistancy cost...
+   if (y!=0)
+   {
+    // Find the adjacent data position, done this way as whilst fiddly it
+    // makes for an approximatly O(n) algorithm...
+     vertOffset = math::Max(vertOffset,prevRow[level].index[prog[i].left]);
+     while (true)
+     {
+      if (prevRow[level].data[vertOffset].disp>=prog[i].right-prog[i].left) break;
+      if (vertOffset+1>=prevRow[level].index[prog[i].left+1]) break;
+      vertOffset += 1;
+     }
+
+    if ((vertOffset>=prevRow[level].index[prog[i].left])&&(vertOffset<prevRow[level].index[prog[i].left+1]))
+    {
+     // Calculate the vertical cost...
+      real32 bestVert;
+      if (prevRow[level].data[vertOffset].disp==(prog[i].right-prog[i].left))
+      {
+       bestVert = prevRow[level].data[vertOffset].cost;
+      }
+      else
+      {
+       bestVert = prevRow[level].data[vertOffset].cost + 
+                  vertCost * math::Abs(prevRow[level].data[vertOffset].disp - (prog[i].right-prog[i].left));
+
+       if (vertOffset>prevRow[level].index[prog[i].left])
+       {
+        bestVert = math::Min(bestVert,prevRow[level].data[vertOffset-1].cost +
+                             vertCost * math::Abs(prevRow[level].data[vertOffset-1].disp
+                             - (prog[i].right-prog[i].left)));
+       }
+      }
+   
+     // Add the vertical cost, including a term to take into account vertical similarity...
+      real32 pixMatch = DSCOps<T>::Cost(d,col[0][level] + bytes*prog[i].left,
+                                        oldCol[0][level] + bytes*prog[i].left);
+      pixMatch += DSCOps<T>::Cost(d,col[1][level] + bytes*prog[i].right,
+                                  oldCol[1][level] + bytes*prog[i].right);
+
+      prog[i].cost += math::Exp(-vertMult*pixMatch) * vertMult * bestVert;
+    }
+   }
+ }
+}
+
 void SparseDSI::FirstPass(nat32 level,ds::ArrayNS<Node> & prog,ds::ArrayDel<DoubleNatWindow> & pass)
 {
  LogTime("eos::stereo::SparseDSI::FirstPass");
@@ -758,7 +802,7 @@ void SparseDSI::PropagateScanline(Scanline & sl) const
 
 //------------------------------------------------------------------------------
 DispSelect::DispSelect()
-:radius(1),mult(1.0),sdsi(null<SparseDSI*>())
+:radius(1),mult(1.0),sdsi(null<SparseDSI*>()),denseMin(0)
 {}
 
 DispSelect::~DispSelect()
@@ -773,10 +817,24 @@ void DispSelect::Set(nat32 r,real32 m)
 void DispSelect::Set(const SparseDSI & d)
 {
  sdsi = &d;
+ dense = svt::Field<nat16>();
+}
+
+void DispSelect::Set(const svt::Field<nat16> & cost,int32 minDisp)
+{
+ sdsi = null<SparseDSI*>();
+ dense = cost;
+ denseMin = minDisp;
 }
 
 void DispSelect::Run(time::Progress * prog)
 {
+ if (dense.Valid())
+ {
+  RunDense(prog);
+  return;
+ }
+
  prog->Push();
 
  // A window of indexes, constantly needed...
@@ -864,6 +922,56 @@ void DispSelect::Run(time::Progress * prog)
  prog->Pop();
 }
 
+void DispSelect::RunDense(time::Progress * prog)
+{
+ prog->Push();
+
+ nat32 width = dense.Size(0);
+ nat32 height = dense.Size(1);
+ nat32 depth = dense.Size(2);
+
+ // The best so far for each pixel, updated a disparity slice at a time so the
+ // volume is read in storage order...
+  ds::Array2D<nat32> best(width,height);
+  ds::Array<nat32> colSum(width);
+  disp.Resize(width,height);
+
+ for (nat32 d=0;d<depth;d++)
+ {
+  prog->Report(d,depth);
+  for (nat32 y=0;y<height;y++)
+  {
+   // Sum each column of the window, clipped to the image as for the sparse
+   // version...
+    nat32 minV = nat32(math::Max(int32(y)-int32(radius),int32(0)));
+    nat32 maxV = math::Min(y+radius,height-1);
+    for (nat32 x=0;x<width;x++)
+    {
+     nat32 sum = 0;
+     for (nat32 v=minV;v<=maxV;v++) sum += dense.Get(x,v,d);
+     colSum[x] = sum;
+    }
+
+   // Slide along the row summing the columns, keeping the best...
+    nat32 sum = 0;
+    for (nat32 x=0;x<math::Min(radius,width);x++) sum += colSum[x];
+    for (nat32 x=0;x<width;x++)
+    {
+     if (x+radius<width) sum += colSum[x+radius];
+     if (x>radius) sum -= colSum[x-radius-1];
+
+     if ((d==0)||(sum<best.Get(x,y)))
+     {
+      best.Get(x,y) = sum;
+      disp.Get(x,y) = real32(int32(d) + denseMin);
+     }
+    }
+  }
+ }
+
+ prog->Pop();
+}
+
 void DispSelect::Get(svt::Field<real32> & out)
 {
  for (nat32 y=0;y<out.Size(1);y++)
@@ -1211,6 +1319,99 @@ void LocalSparsePlane::Duds(bit enable)
  duds = enable;
 }
 
+class LocalSparsePlane::FitRows
+{
+ public:
+  FitRows(LocalSparsePlane & s,const math::Vect<4,real64> & c,const math::Mat<4,3,real64> & il,const real32 * k)
+  :self(s),centre(c),invLP(il),kernel(k)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   const SparsePos & spos = *self.spos;
+   const svt::Field<nat32> & seg = self.seg;
+   int32 radius = self.radius;
+   int32 kernelStride = radius*2 + 1;
+
+   alg::LinePlaneFit lpf;
+   math::Matrix<real32> temp;
+   for (int32 y=int32(begin);y<int32(end);y++)
+   {
+    for (int32 x=0;x<int32(seg.Size(0));x++)
+    {
+     nat32 s = seg.Get(x,y);
+     
+     // Set or calculate the plane...
+      bs::Plane plane;
+      if (self.duds&&(s==0))
+      {
+       plane.n[0] = 0.0;
+       plane.n[1] = 0.0;
+       plane.n[2] = 0.0;
+       plane.d = 1.0;
+      }
+      else
+      {
+       lpf.Reset();
+     
+       // Iterate the window and add all relevant pixels...
+        for (int32 v=math::Max<int32>(y-radius,0);v<=math::Min<int32>(y+radius,int32(seg.Size(1))-1);v++)
+        {
+         const real32 * kernelRow = kernel + (v-y+radius)*kernelStride;
+         for (int32 u=math::Max<int32>(x-radius,0);u<=math::Min<int32>(x+radius,int32(seg.Size(0))-1);u++)
+         {
+          if (seg.Get(u,v)==s)
+          {
+           for (nat32 i=0;i<spos.Size(u,v);i++)
+           {
+            lpf.Add(spos.Start(u,v,i),spos.End(u,v,i),kernelRow[u-x+radius]*math::Exp(-spos.Cost(u,v,i)));
+           }
+          }
+         }
+        }
+     
+       // Find the plane...
+        lpf.Run(temp);
+        plane = lpf.Plane();
+        plane.Normalise();
+      }
+
+     // Calculate and store the position and orientation...
+      // Calculate ray - we have the centre, we now need another point, which may
+      // be provided by the psuedo inverse, after un-rectification of course...
+       math::Vect<3,real64> rp;
+        rp[0] = x;
+        rp[1] = y;
+        rp[2] = 1.0;
+      
+       math::Vect<3,real64> urp;
+       math::MultVect(self.pair.unRectLeft,rp,urp);
+      
+       math::Vect<4,real64> to;
+       math::MultVect(invLP,urp,to);
+       if (!math::IsZero(to[3])) to /= to[3];
+     
+      // Intercept with plane...
+       bs::PosDir & out = self.data.Get(x,y);
+       math::Vect<4,real64> loc;
+       plane.LineIntercept(centre,to,loc);
+       out.pos = loc;
+       if (!math::IsZero(out.pos[3])) out.pos /= out.pos[3];
+       
+      // Orientation from plane is somewhat easier...
+       out.dir = plane.n;
+       if (plane.n[2]<0.0) out.dir *= -1.0;
+    }
+   }
+  }
+
+ private:
+  LocalSparsePlane & self;
+  const math::Vect<4,real64> & centre;
+  const math::Mat<4,3,real64> & invLP;
+  const real32 * kernel;
+};
+
 void LocalSparsePlane::Run(time::Progress * prog)
 {
  prog->Push();
@@ -1225,79 +1426,26 @@ void LocalSparsePlane::Run(time::Progress * prog)
    math::Mat<4,3,real64> invLP;
    math::PseudoInverse(pair.lp,invLP);
 
-
- // Iterate every single pixel, for each do a plane fitting...
-  data.Resize(seg.Size(0),seg.Size(1));
-  for (int32 y=0;y<int32(seg.Size(1));y++)
-  {
-   prog->Report(y,seg.Size(1));
-   for (int32 x=0;x<int32(seg.Size(0));x++)
+  // The weight of each offset in the window, falling off linearly with
+  // distance from the centre...
+   int32 kernelStride = radius*2 + 1;
+   ds::Array<real32> kernel(kernelStride*kernelStride);
+   real32 distMult = 1.0/real32(radius+1);
+   for (int32 v=-radius;v<=radius;v++)
    {
-    nat32 s = seg.Get(x,y);
-    
-    // Set or calculate the plane...
-     bs::Plane plane;
-     if (duds&&(s==0))
-     {
-      plane.n[0] = 0.0;
-      plane.n[1] = 0.0;
-      plane.n[2] = 0.0;
-      plane.d = 1.0;
-     }
-     else
-     {
-      alg::LinePlaneFit lpf;
-    
-      // Iterate the window and add all relevant pixels...
-       real32 distMult = 1.0/real32(radius+1);
-       for (int32 v=math::Max<int32>(y-radius,0);v<=math::Min<int32>(y+radius,int32(seg.Size(1))-1);v++)
-       {
-        for (int32 u=math::Max<int32>(x-radius,0);u<=math::Min<int32>(x+radius,int32(seg.Size(0))-1);u++)
-        {
-         if (seg.Get(u,v)==s)
-         {
-          for (nat32 i=0;i<spos->Size(u,v);i++)
-          {
-           real32 dist = math::Sqrt(math::Sqr(u-x)+math::Sqr(v-y));
-           real32 mult = math::Max(0.0,1.0-distMult*dist);
-           lpf.Add(spos->Start(u,v,i),spos->End(u,v,i),mult*math::Exp(-spos->Cost(u,v,i)));
-          }
-         }
-        }
-       }
-    
-      // Find the plane...
-       lpf.Run();
-       plane = lpf.Plane();
-       plane.Normalise();
-     }
-
-    // Calculate and store the position and orientation...
-     // Calculate ray - we have the centre, we now need another point, which may
-     // be provided by the psuedo inverse, after un-rectification of course...
-      math::Vect<3,real64> rp;
-       rp[0] = x;
-       rp[1] = y;
-       rp[2] = 1.0;
-     
-      math::Vect<3,real64> urp;
-      math::MultVect(pair.unRectLeft,rp,urp);
-     
-      math::Vect<4,real64> to;
-      math::MultVect(invLP,urp,to);
-      if (!math::IsZero(to[3])) to /= to[3];
-    
-     // Intercept with plane...
-      math::Vect<4,real64> loc;
-      plane.LineIntercept(centre,to,loc);
-      data.Get(x,y).pos = loc;
-      if (!math::IsZero(data.Get(x,y).pos[3])) data.Get(x,y).pos /= data.Get(x,y).pos[3];
-      
-     // Orientation from plane is somewhat easier...
-      data.Get(x,y).dir = plane.n;
-      if (plane.n[2]<0.0) data.Get(x,y).dir *= -1.0;
+    for (int32 u=-radius;u<=radius;u++)
+    {
+     real32 dist = math::Sqrt(math::Sqr(u)+math::Sqr(v));
+     kernel[(v+radius)*kernelStride + u+radius] = math::Max(0.0,1.0-distMult*dist);
+    }
    }
-  }
+
+
+ // Iterate every single pixel, for each do a plane fitting, rows in
+ // parallel...
+  data.Resize(seg.Size(0),seg.Size(1));
+  FitRows fitRows(*this,centre,invLP,kernel.Ptr());
+  mt::ParallelFor(nat32(0),seg.Size(1),fitRows);
  
  prog->Pop();
 }
@@ -1392,6 +1540,96 @@ void OrientSparsePlane::Duds(bit enable)
  duds = enable;
 }
 
+class OrientSparsePlane::FitRows
+{
+ public:
+  FitRows(OrientSparsePlane & s,const math::Vect<4,real64> & c,const math::Mat<4,3,real64> & il)
+  :self(s),centre(c),invLP(il)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   const SparsePos & spos = *self.spos;
+   const svt::Field<nat32> & seg = self.seg;
+   int32 radius = self.radius;
+
+   alg::DepthPlane lpf;
+   for (int32 y=int32(begin);y<int32(end);y++)
+   {
+    for (int32 x=0;x<int32(seg.Size(0));x++)
+    {
+     nat32 s = seg.Get(x,y);
+     
+     // Set or calculate the plane...
+      bs::Plane plane;
+      if (self.duds&&(s==0))
+      {
+       plane.n[0] = 0.0;
+       plane.n[1] = 0.0;
+       plane.n[2] = 0.0;
+       plane.d = 1.0;
+      }
+      else
+      {
+       lpf.Reset();
+       lpf.Set(self.needle.Get(x,y));
+     
+       // Iterate the window and add all relevant pixels...
+        for (int32 v=math::Max<int32>(y-radius,0);v<=math::Min<int32>(y+radius,int32(seg.Size(1))-1);v++)
+        {
+         for (int32 u=math::Max<int32>(x-radius,0);u<=math::Min<int32>(x+radius,int32(seg.Size(0))-1);u++)
+         {
+          if (seg.Get(u,v)==s)
+          {
+           for (nat32 i=0;i<spos.Size(u,v);i++)
+           {
+            lpf.Add(spos.Centre(x,y,i));
+           }
+          }
+         }
+        }
+     
+       // Find the plane...
+        lpf.Run();
+        plane = lpf.Plane();
+        plane.Normalise();
+      }
+
+     // Calculate and store the position and orientation...
+      // Calculate ray - we have the centre, we now need another point, which may
+      // be provided by the psuedo inverse, after un-rectification of course...
+       math::Vect<3,real64> rp;
+        rp[0] = x;
+        rp[1] = y;
+        rp[2] = 1.0;
+      
+       math::Vect<3,real64> urp;
+       math::MultVect(self.pair.unRectLeft,rp,urp);
+      
+       math::Vect<4,real64> to;
+       math::MultVect(invLP,urp,to);
+       if (!math::IsZero(to[3])) to /= to[3];
+     
+      // Intercept with plane...
+       bs::PosDir & out = self.data.Get(x,y);
+       math::Vect<4,real64> loc;
+       plane.LineIntercept(centre,to,loc);
+       out.pos = loc;
+       if (!math::IsZero(out.pos[3])) out.pos /= out.pos[3];
+       
+      // Orientation from plane is somewhat easier...
+       out.dir = plane.n;
+       if (plane.n[2]<0.0) out.dir *= -1.0;
+    }
+   }
+  }
+
+ private:
+  OrientSparsePlane & self;
+  const math::Vect<4,real64> & centre;
+  const math::Mat<4,3,real64> & invLP;
+};
+
 void OrientSparsePlane::Run(time::Progress * prog)
 {
  prog->Push();
@@ -1407,76 +1645,11 @@ void OrientSparsePlane::Run(time::Progress * prog)
    math::PseudoInverse(pair.lp,invLP);
 
 
- // Iterate every single pixel, for each do a plane fitting...
+ // Iterate every single pixel, for each do a plane fitting, rows in
+ // parallel...
   data.Resize(seg.Size(0),seg.Size(1));
-  for (int32 y=0;y<int32(seg.Size(1));y++)
-  {
-   prog->Report(y,seg.Size(1));
-   for (int32 x=0;x<int32(seg.Size(0));x++)
-   {
-    nat32 s = seg.Get(x,y);
-    
-    // Set or calculate the plane...
-     bs::Plane plane;
-     if (duds&&(s==0))
-     {
-      plane.n[0] = 0.0;
-      plane.n[1] = 0.0;
-      plane.n[2] = 0.0;
-      plane.d = 1.0;
-     }
-     else
-     {
-      alg::DepthPlane lpf;
-      lpf.Set(needle.Get(x,y));
-    
-      // Iterate the window and add all relevant pixels...
-       for (int32 v=math::Max<int32>(y-radius,0);v<=math::Min<int32>(y+radius,int32(seg.Size(1))-1);v++)
-       {
-        for (int32 u=math::Max<int32>(x-radius,0);u<=math::Min<int32>(x+radius,int32(seg.Size(0))-1);u++)
-        {
-         if (seg.Get(u,v)==s)
-         {
-          for (nat32 i=0;i<spos->Size(u,v);i++)
-          {
-           lpf.Add(spos->Centre(x,y,i));
-          }
-         }
-        }
-       }
-    
-      // Find the plane...
-       lpf.Run();
-       plane = lpf.Plane();
-       plane.Normalise();
-     }
-
-    // Calculate and store the position and orientation...
-     // Calculate ray - we have the centre, we now need another point, which may
-     // be provided by the psuedo inverse, after un-rectification of course...
-      math::Vect<3,real64> rp;
-       rp[0] = x;
-       rp[1] = y;
-       rp[2] = 1.0;
-     
-      math::Vect<3,real64> urp;
-      math::MultVect(pair.unRectLeft,rp,urp);
-     
-      math::Vect<4,real64> to;
-      math::MultVect(invLP,urp,to);
-      if (!math::IsZero(to[3])) to /= to[3];
-    
-     // Intercept with plane...
-      math::Vect<4,real64> loc;
-      plane.LineIntercept(centre,to,loc);
-      data.Get(x,y).pos = loc;
-      if (!math::IsZero(data.Get(x,y).pos[3])) data.Get(x,y).pos /= data.Get(x,y).pos[3];
-      
-     // Orientation from plane is somewhat easier...
-      data.Get(x,y).dir = plane.n;
-      if (plane.n[2]<0.0) data.Get(x,y).dir *= -1.0;
-   }
-  }
+  FitRows fitRows(*this,centre,invLP);
+  mt::ParallelFor(nat32(0),seg.Size(1),fitRows);
  
  prog->Pop();
 }
@@ -98,6 +98,12 @@ class EOS_CLASS SparseDSI : public DSI
   /// Sets the DSC which defines the cost of each match. Its cloned and internaly stored.
    void Set(DSC * dsc);
 
+  /// If enabled the result is stored in a CompactDSI, each row going into it as
+  /// its finished, so only two rows are ever held at full precision. Costs
+  /// then have 16 bit precision relative to the largest in their row. All the
+  /// accessors work as before. Defaults to off.
+   void Compact(bit enable) {compact = enable;}
+
 
   /// Runs the algorithm.
    void Run(time::Progress * prog = null<time::Progress*>());
@@ -152,6 +158,8 @@ class EOS_CLASS SparseDSI : public DSI
   real32 errLim; // This is multiplied by the number of pixels in a scanline before use.
   
   DSC * dsc;
+  bit compact;
+  CompactDSI store; // Used instead of data when compact.
 
 
   // The structure used for final storage once the class has finished running.
@@ -187,7 +195,7 @@ class EOS_CLASS SparseDSI : public DSI
   // All the data, a bit hairy but required to be done this way so it can all work.
    nat32 width;
    nat32 height;
-   ds::ArrayDel<Scanline> data; // height scanline objects, each with indexes width+1.
+   ds::ArrayDel<Scanline> data; // height scanline objects, each with indexes width+1, or just the last two rows when compact.
    
   // Can prove useful to store this for future use...
    nat32 widthRight;
@@ -235,6 +243,28 @@ class EOS_CLASS SparseDSI : public DSI
    // position, just need to be pruned down to size and indexed.
      void ExtractPass(nat32 level,ds::ArrayNS<Node> & prog);
 
+   // Fills in the cost of each node of prog for a level, from the colour
+   // range hierachies of this row and the last. d is the DSC as its concrete
+   // type, so the cost inlines - see dsc_dispatch.h...
+    template <typename T>
+    void LevelCosts(const T & d,nat32 level,nat32 y,byte ** col[2],byte ** oldCol[2],
+                    ds::ArrayNS<Node> & prog,ds::ArrayDel<Scanline> & prevRow);
+
+   // Functor given to DispatchDSC to call the above...
+    struct CostFunc
+    {
+     SparseDSI * self;
+     nat32 level;
+     nat32 y;
+     byte *** col;
+     byte *** oldCol;
+     ds::ArrayNS<Node> * prog;
+     ds::ArrayDel<Scanline> * prevRow;
+
+     template <typename T>
+     void operator()(const T & d) {self->LevelCosts(d,level,y,col,oldCol,*prog,*prevRow);}
+    };
+
    // Given a prog this converts from an offset prog to a set of disparities, 
    // whilst increasing the size. Called between levels. Will change the size 
    // of prog. (It detects and handles the special case of either side being 
@@ -318,6 +348,14 @@ class EOS_CLASS DispSelect
   /// Sets the SparseDSI to use.
    void Set(const SparseDSI & sdsi);
 
+  /// Alternative to the above, sets a dense fixed point cost volume to use,
+  /// such as Sad writes, with index d of the third dimension being disparity
+  /// minDisp+d. As every pixel has every disparity the window always hits
+  /// exactly and mult is irrelevant - each disparities window is summed
+  /// directly from the volume, in integers, so the scale it was written with
+  /// doesn't matter either.
+   void Set(const svt::Field<nat16> & cost,int32 minDisp);
+
 
   /// Runs the algorithm.
    void Run(time::Progress * prog = null<time::Progress*>());
@@ -336,9 +374,14 @@ class EOS_CLASS DispSelect
    nat32 radius;
    real32 mult;
    const SparseDSI * sdsi;
-  
+   svt::Field<nat16> dense; // Used instead of sdsi if valid.
+   int32 denseMin;
+
   // Out...
    ds::Array2D<real32> disp;
+
+  // Run for the dense volume...
+   void RunDense(time::Progress * prog);
 };
 
 //------------------------------------------------------------------------------
@@ -545,6 +588,10 @@ class EOS_CLASS LocalSparsePlane
 
   // Output...
    ds::Array2D<bs::PosDir> data;
+
+  // Functor that fits the planes for a range of rows, each thread keeps one
+  // fitter which it resets for every pixel...
+   class FitRows;
 };
 
 //------------------------------------------------------------------------------
@@ -617,6 +664,10 @@ class EOS_CLASS OrientSparsePlane
 
   // Output...
    ds::Array2D<bs::PosDir> data;
+
+  // Functor that fits the planes for a range of rows, each thread keeps one
+  // fitter which it resets for every pixel...
+   class FitRows;
 };
 
 //------------------------------------------------------------------------------
@@ -186,12 +186,57 @@ BasicDSR::BasicDSR(const DSI & rhs)
  }
 }
 
+BasicDSR::BasicDSR(const svt::Field<nat16> & cost,int32 minDisp,nat16 tol)
+:data(cost.Size(0),cost.Size(1))
+{
+ nat32 depth = cost.Size(2);
+ for (nat32 y=0;y<data.Height();y++)
+ {
+  for (nat32 x=0;x<data.Width();x++)
+  {
+   // Find the minimum, and from it the threshold...
+    nat32 low = cost.Get(x,y,0);
+    for (nat32 d=1;d<depth;d++) low = math::Min<nat32>(low,cost.Get(x,y,d));
+    nat32 limit = low + tol;
+
+   // First pass to count the number of ranges required...
+    nat32 rangeCount = 0;
+    bit prev = false;
+    for (nat32 d=0;d<depth;d++)
+    {
+     bit in = cost.Get(x,y,d)<=limit;
+     if (in&&(!prev)) ++rangeCount;
+     prev = in;
+    }
+
+   // Second pass to extract the ranges...
+    ds::Array<Range> & targ = data.Get(x,y);
+    targ.Size(rangeCount);
+
+    nat32 range = 0;
+    prev = false;
+    for (nat32 d=0;d<depth;d++)
+    {
+     bit in = cost.Get(x,y,d)<=limit;
+     if (in)
+     {
+      if (!prev) targ[range].start = int32(d) + minDisp;
+      targ[range].end = int32(d) + minDisp;
+     }
+     else if (prev) ++range;
+     prev = in;
+    }
+  }
+ }
+}
+
 BasicDSR::~BasicDSR()
 {}
 
 DSR * BasicDSR::Clone() const
 {
- return new BasicDSR(*this);
+ // Go via the DSR constructor, the implicit copy constructor would share the arrays...
+  return new BasicDSR(static_cast<const DSR&>(*this));
 }
 
 void BasicDSR::Add(nat32 x,nat32 y,int32 start,int32 end)
@@ -145,6 +145,13 @@ class EOS_CLASS BasicDSR : public DSR
   /// marks every pixel which has a DSI entry in its range.
    BasicDSR(const DSI & rhs);
 
+  /// Extracts a DSR from a dense fixed point cost volume, as Sad writes, where
+  /// index d of the third dimension is disparity minDisp+d. For each pixel
+  /// every disparity with a cost within tol of that pixels minimum is marked,
+  /// so a cheap local method can bootstrap an expensive one without a volume
+  /// of reals ever existing.
+   BasicDSR(const svt::Field<nat16> & cost,int32 minDisp,nat16 tol);
+
   /// &nbsp;
    ~BasicDSR();
    
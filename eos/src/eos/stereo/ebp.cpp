@@ -21,6 +21,8 @@
 #include "eos/math/functions.h"
 #include "eos/mem/functions.h"
 #include "eos/ds/priority_queues.h"
+#include "eos/log/profile.h"
+#include "eos/stereo/dsc_dispatch.h"
 
 namespace eos
 {
@@ -29,7 +31,7 @@ namespace eos
 //------------------------------------------------------------------------------
 EBP::EBP()
 :occCostBase(1.0),occCostMult(-0.1),occLimMult(2.0),iters(8),outCount(1),
-dsr(null<DSR*>()),dsc(null<DSC*>()),dscOcc(null<DSC*>())
+dsr(null<DSR*>()),dsc(null<DSC*>()),dscOcc(null<DSC*>()),pool(null<mt::TaskPool*>())
 {}
 
 EBP::~EBP()
@@ -67,10 +69,17 @@ void EBP::SetOcc(const DSC * d)
  dscOcc = d->Clone();
 }
 
+void EBP::SetParallel(bit enable,mt::TaskPool & p)
+{
+ if (enable) pool = &p;
+        else pool = null<mt::TaskPool*>();
+}
+
 void EBP::Run(time::Progress * prog)
 {
  LogBlock("eos::stereo::EBP::Run","");
- prog->Push();
+ mem::MemScope memScope("eos::stereo::EBP");
+ prog->Push("eos::stereo::EBP::Run");
 
  // Asserts...
   log::Assert(dsc->HeightLeft()==dsc->HeightRight());
@@ -87,13 +96,21 @@ void EBP::Run(time::Progress * prog)
             << dsc->WidthLeft() << LogDiv() << dsc->HeightLeft() << LogDiv()
             << levels << LogDiv() << dsr->Matches());
 
+ // Rows per task, so each task has a decent number of pixels to chew on...
+  nat32 grain = math::Max(nat32(1),nat32(2048/math::Max(dsc->WidthLeft(),nat32(1))));
+
 
 
  // Phase 1 - construct the hierachy of data structures in which messages will be
  // passed...
-  // Create the indexes and memory allocator...
+  // Create the indexes and memory allocators, one allocator for the base layer
+  // and one for each band of the further layers, so each thread has its own...
    prog->Report(0,levels*2 + 3);
    ds::ArrayDel< ds::Array2D<Pixel*> > index(levels);
+   nat32 bands = pool?pool->Concurrency():1;
+   ds::Array<mem::Packer*> bandMem(bands);
+   for (nat32 i=0;i<bands;i++) bandMem[i] = new mem::Packer(math::Max(blockSize/bands,nat32(1024*1024)));
+
    mem::Packer mem(blockSize);
 
    index[0].Resize(dsc->WidthLeft(),dsc->HeightLeft());
@@ -107,10 +124,8 @@ void EBP::Run(time::Progress * prog)
    }
 
 
-  // Build the base layer, with costs...
-   mem::StackPtr<byte,mem::KillDelArray<byte> > pixA = new byte[dscOcc->Bytes()];
-   mem::StackPtr<byte,mem::KillDelArray<byte> > pixB = new byte[dscOcc->Bytes()];
-
+  // Build the base layer structure, single threaded as the DSR may not be
+  // thread safe...
    prog->Report(1,levels*2 + 3);
    prog->Push();
    for (nat32 y=0;y<index[0].Height();y++)
@@ -141,88 +156,37 @@ void EBP::Run(time::Progress * prog)
       pix->msgSize = msgSize;
       pix->sections = dsr->Ranges(x,y);
 
-     // Fill in the occCost array...
-      dscOcc->Left(x,y,pixA.Ptr());
-      for (nat32 i=0;i<4;i++)
-      {
-       pix->occCost[i] = occCostBase;
-
-       nat32 xp = x;
-       nat32 yp = y;
-       bit done = false;
-       switch (i)
-       {
-        case 0: ++xp; if (xp==index[0].Width()) done = true; break;
-        case 1: ++yp; if (yp==index[0].Height()) done = true; break;
-        case 2: if (xp==0) done = true; else --xp; break;
-        case 3: if (yp==0) done = true; else --yp; break;
-       }
-       if (done) continue;
-
-       dscOcc->Left(xp,yp,pixB.Ptr());
-       real32 diff = dscOcc->Cost(pixA.Ptr(),pixB.Ptr());
-       pix->occCost[i] += diff * occCostMult;
-      }
-
-
      // Fill in the sections...
       for (nat32 i=0;i<dsr->Ranges(x,y);i++)
       {
        pix->GetSec(i)->startDisp = dsr->Start(x,y,i);
        pix->GetSec(i)->runLength = 1 + dsr->End(x,y,i) - dsr->Start(x,y,i);
       }
-
-     // Fill in the matching costs taken from the DSC...
-     // (Because we allow matches outside the image range we have to do bound checking.)
-      nat32 offset = 0;
-      for (nat32 i=0;i<pix->sections;i++)
-      {
-       for (int32 d=dsr->Start(x,y,i);d<=dsr->End(x,y,i);d++)
-       {
-        int32 ux2 = int32(x) + d;
-        int32 x2 = math::Clamp(ux2,int32(0),int32(dsc->WidthRight())-1);
-        pix->Start()[offset] = dsc->Cost(x,x2,y) + occCostBase*math::Abs(ux2-x2);
-        ++offset;
-       }
-      }
-
-     // Null the messages...
-      for (nat32 i=pix->msgSize;i<pix->msgSize*5;i++) pix->Start()[i] = 0.0;
     }
    }
    prog->Pop();
 
+  // Fill in the base layer costs...
+   {
+    BaseKernel kernel;
+    kernel.self = this;
+    kernel.index = &index[0];
+    kernel.grain = grain;
+    DispatchDSC(*dscOcc,kernel);
+   }
+
 
   // Create further layers...
    for (int32 l=1;l<levels;l++)
    {
     prog->Report(l+1,levels*2 + 3);
-    prog->Push();
-    for (nat32 y=0;y<index[l].Height();y++)
-    {
-     prog->Report(y,index[l].Height());
-     for (nat32 x=0;x<index[l].Width();x++)
-     {
-      nat32 fromX = x*2;
-      nat32 fromY = y*2;
-
-      bit okX = (fromX+1)!=index[l-1].Width();
-      bit okY = (fromY+1)!=index[l-1].Height();
-
-      Pixel * pix[4];
 
-      pix[0] = index[l-1].Get(fromX,fromY);
-      if (okX) pix[1] = index[l-1].Get(fromX+1,fromY);
-          else pix[1] = null<Pixel*>();
-      if (okY) pix[2] = index[l-1].Get(fromX,fromY+1);
-          else pix[2] = null<Pixel*>();
-      if (okX&&okY) pix[3] = index[l-1].Get(fromX+1,fromY+1);
-               else pix[3] = null<Pixel*>();
-
-      index[l].Get(x,y) = Union(pix,&mem);
-     }
-    }
-    prog->Pop();
+    UnionFunc func;
+    func.self = this;
+    func.from = &index[l-1];
+    func.to = &index[l];
+    func.memAlloc = &bandMem;
+    ForRows(0,bands,func,1);
    }
 
 
@@ -315,12 +279,12 @@ void EBP::Run(time::Progress * prog)
 
     // Transfer from above to current level of hierachy...
      prog->Report(0,iters+1);
-     for (nat32 y=0;y<index[l].Height();y++)
      {
-      for (nat32 x=0;x<index[l].Width();x++)
-      {
-       if (index[l].Get(x,y)) GetMessages(index[l].Get(x,y),index[l+1].Get(x/2,y/2));
-      }
+      TransferFunc func;
+      func.self = this;
+      func.to = &index[l];
+      func.from = &index[l+1];
+      ForRows(0,index[l].Height(),func,grain);
      }
 
 
@@ -338,88 +302,17 @@ void EBP::Run(time::Progress * prog)
 
  // Auxilary pass - extract the results...
   prog->Report(levels*2 + 2,levels*2 + 3);
-  prog->Push();
-
-  ds::PriorityQueue<Match> dispHeap(outCount);
-  ds::Array<Match> dispArray(outCount);
-
   disp.Size(index[0].Height());
-  for (nat32 y=0;y<disp.Size();y++)
   {
-   prog->Report(y,disp.Size());
-
-   // First pass to count how many disparities we will actually be outputting,
-   // for this scanline. Index is filled in during this process...
-    disp[y].index.Size(index[0].Width()+1);
-    disp[y].index[0] = 0;
-    for (nat32 x=0;x<index[0].Width();x++)
-    {
-     if (index[0].Get(x,y)) disp[y].index[x+1] = disp[y].index[x] + math::Min(index[0].Get(x,y)->msgSize,outCount);
-                       else disp[y].index[x+1] = disp[y].index[x];
-    }
-
-
-   // Second pass to fill in the data structure with the actual disparities
-   // and costs...
-    disp[y].data.Size(disp[y].index[disp[y].index.Size()-1]);
-    for (nat32 x=0;x<index[0].Width();x++)
-    {
-     Pixel * targ = index[0].Get(x,y);
-     if ((targ!=null<Pixel*>())&&(targ->sections!=0))
-     {
-      // Find the best matches...
-       dispHeap.MakeEmpty();
-       DispIter di;
-       targ->MakeIter(di);
-
-       for (nat32 i=0;i<targ->msgSize;i++)
-       {
-        real32 cost = di.Value(0) + di.Value(1) + di.Value(2) + di.Value(3) + di.Value(4);
-        if (dispHeap.Size()<outCount)
-        {
-         // No competition - just store it...
-          Match m;
-          m.disp = di.Disparity();
-          m.cost = cost;
-          dispHeap.Add(m);
-        }
-        else
-        {
-         // Check if its good enough to be included, and include it if so, removing the member it superceded...
-          if (cost<dispHeap.Peek().cost)
-          {
-           dispHeap.Rem();
-           Match m;
-           m.disp = di.Disparity();
-           m.cost = cost;
-           dispHeap.Add(m);
-          }
-        }
-        di.ToNext();
-       }
-
-
-      // Sort them by disparity...
-       nat32 num = 0;
-       while (dispHeap.Size()!=0)
-       {
-        dispArray[num] = dispHeap.Peek();
-        ++num;
-        dispHeap.Rem();
-       }
-
-       dispArray.SortRange<DispSort>(0,num-1);
+   ExtractFunc func;
+   func.self = this;
+   func.index = &index[0];
+   ForRows(0,index[0].Height(),func,grain);
+  }
 
 
-      // Write them into the correct scanline positions...
-       for (nat32 i=0;i<num;i++)
-       {
-        disp[y].data[disp[y].index[x]+i] = dispArray[i];
-       }
-     }
-    }
-  }
-  prog->Pop();
+ // Clean up...
+  for (nat32 i=0;i<bands;i++) delete bandMem[i];
 
  prog->Pop();
 }
@@ -463,7 +356,19 @@ cstrconst EBP::TypeString() const
 void EBP::Iter(ds::Array2D<Pixel*> & index,nat32 iter)
 {
  LogTime("eos::stereo::EBP::Iter");
- for (nat32 y=0;y<index.Height();y++)
+ IterFunc func;
+ func.self = this;
+ func.index = &index;
+ func.iter = iter;
+ ForRows(0,index.Height(),func,math::Max(nat32(1),nat32(2048/index.Width())));
+}
+
+void EBP::IterRows(ds::Array2D<Pixel*> & index,nat32 iter,nat32 y0,nat32 y1)
+{
+ nat64 messages = 0; // Counted locally and reported once, as this is the hot loop.
+ nat64 entries = 0;
+
+ for (nat32 y=y0;y<y1;y++)
  {
   for (nat32 x=((y+iter)%2);x<index.Width();x+=2)
   {
@@ -491,6 +396,8 @@ void EBP::Iter(ds::Array2D<Pixel*> & index,nat32 iter)
        if (out.msgSize==0) continue; // This shouldn't be required. Bug, presumably, means it is however.
 
        nat32 outInd = 1 + ((md+2)%4);
+       messages += 1;
+       entries += out.msgSize;
 
 
       // Forward pass - calculate the minimum cost, fill in the output message
@@ -587,6 +494,200 @@ void EBP::Iter(ds::Array2D<Pixel*> & index,nat32 iter)
     }
   }
  }
+
+ LogCount("eos::stereo::EBP message",messages);
+ LogCount("eos::stereo::EBP message entry",entries);
+}
+
+template <typename T>
+void EBP::BaseRows(const T & occ,ds::Array2D<Pixel*> & index,nat32 y0,nat32 y1)
+{
+ nat64 costs = 0;
+
+ mem::StackPtr<byte,mem::KillDelArray<byte> > pixA = new byte[DSCOps<T>::Bytes(occ)];
+ mem::StackPtr<byte,mem::KillDelArray<byte> > pixB = new byte[DSCOps<T>::Bytes(occ)];
+
+ for (nat32 y=y0;y<y1;y++)
+ {
+  for (nat32 x=0;x<index.Width();x++)
+  {
+   Pixel * pix = index.Get(x,y);
+   if (pix==null<Pixel*>()) continue;
+
+   // Fill in the occCost array...
+    DSCOps<T>::Left(occ,x,y,pixA.Ptr());
+    for (nat32 i=0;i<4;i++)
+    {
+     pix->occCost[i] = occCostBase;
+
+     nat32 xp = x;
+     nat32 yp = y;
+     bit done = false;
+     switch (i)
+     {
+      case 0: ++xp; if (xp==index.Width()) done = true; break;
+      case 1: ++yp; if (yp==index.Height()) done = true; break;
+      case 2: if (xp==0) done = true; else --xp; break;
+      case 3: if (yp==0) done = true; else --yp; break;
+     }
+     if (done) continue;
+
+     DSCOps<T>::Left(occ,xp,yp,pixB.Ptr());
+     real32 diff = DSCOps<T>::Cost(occ,pixA.Ptr(),pixB.Ptr());
+     pix->occCost[i] += diff * occCostMult;
+    }
+
+   // Fill in the matching costs taken from the DSC, a run at a time...
+   // (Because we allow matches outside the image range we have to do bound checking.)
+    nat32 offset = 0;
+    for (nat32 i=0;i<pix->sections;i++)
+    {
+     Section * sec = pix->GetSec(i);
+     int32 start = int32(x) + sec->startDisp;
+     int32 end = start + int32(sec->runLength);
+     int32 inStart = math::Clamp(start,int32(0),int32(dsc->WidthRight()));
+     int32 inEnd = math::Clamp(end,int32(0),int32(dsc->WidthRight()));
+
+     if (inStart<inEnd) dsc->CostRun(x,inStart,y,inEnd-inStart,pix->Start() + offset + (inStart-start));
+
+     for (int32 ux2=start;ux2<end;ux2++)
+     {
+      if ((ux2<inStart)||(ux2>=inEnd))
+      {
+       int32 x2 = math::Clamp(ux2,int32(0),int32(dsc->WidthRight())-1);
+       pix->Start()[offset] = dsc->Cost(x,x2,y) + occCostBase*math::Abs(ux2-x2);
+      }
+      ++offset;
+     }
+    }
+
+   // Null the messages...
+    for (nat32 i=pix->msgSize;i<pix->msgSize*5;i++) pix->Start()[i] = 0.0;
+
+   costs += pix->msgSize;
+   LogSample("eos::stereo::EBP disparities",pix->msgSize);
+  }
+ }
+
+ LogCount("eos::stereo::DSC cost",costs);
+}
+
+void EBP::UnionRows(ds::Array2D<Pixel*> & from,ds::Array2D<Pixel*> & to,nat32 y0,nat32 y1,mem::Packer * memAlloc)
+{
+ for (nat32 y=y0;y<y1;y++)
+ {
+  for (nat32 x=0;x<to.Width();x++)
+  {
+   nat32 fromX = x*2;
+   nat32 fromY = y*2;
+
+   bit okX = (fromX+1)!=from.Width();
+   bit okY = (fromY+1)!=from.Height();
+
+   Pixel * pix[4];
+
+   pix[0] = from.Get(fromX,fromY);
+   if (okX) pix[1] = from.Get(fromX+1,fromY);
+       else pix[1] = null<Pixel*>();
+   if (okY) pix[2] = from.Get(fromX,fromY+1);
+       else pix[2] = null<Pixel*>();
+   if (okX&&okY) pix[3] = from.Get(fromX+1,fromY+1);
+            else pix[3] = null<Pixel*>();
+
+   to.Get(x,y) = Union(pix,memAlloc);
+  }
+ }
+}
+
+void EBP::TransferRows(ds::Array2D<Pixel*> & to,ds::Array2D<Pixel*> & from,nat32 y0,nat32 y1)
+{
+ for (nat32 y=y0;y<y1;y++)
+ {
+  for (nat32 x=0;x<to.Width();x++)
+  {
+   if (to.Get(x,y)) GetMessages(to.Get(x,y),from.Get(x/2,y/2));
+  }
+ }
+}
+
+void EBP::ExtractRows(ds::Array2D<Pixel*> & index,nat32 y0,nat32 y1)
+{
+ ds::PriorityQueue<Match> dispHeap(outCount);
+ ds::Array<Match> dispArray(outCount);
+
+ for (nat32 y=y0;y<y1;y++)
+ {
+  // First pass to count how many disparities we will actually be outputting,
+  // for this scanline. Index is filled in during this process...
+   disp[y].index.Size(index.Width()+1);
+   disp[y].index[0] = 0;
+   for (nat32 x=0;x<index.Width();x++)
+   {
+    if (index.Get(x,y)) disp[y].index[x+1] = disp[y].index[x] + math::Min(index.Get(x,y)->msgSize,outCount);
+                   else disp[y].index[x+1] = disp[y].index[x];
+   }
+
+
+  // Second pass to fill in the data structure with the actual disparities
+  // and costs...
+   disp[y].data.Size(disp[y].index[disp[y].index.Size()-1]);
+   for (nat32 x=0;x<index.Width();x++)
+   {
+    Pixel * targ = index.Get(x,y);
+    if ((targ!=null<Pixel*>())&&(targ->sections!=0))
+    {
+     // Find the best matches...
+      dispHeap.MakeEmpty();
+      DispIter di;
+      targ->MakeIter(di);
+
+      for (nat32 i=0;i<targ->msgSize;i++)
+      {
+       real32 cost = di.Value(0) + di.Value(1) + di.Value(2) + di.Value(3) + di.Value(4);
+       if (dispHeap.Size()<outCount)
+       {
+        // No competition - just store it...
+         Match m;
+         m.disp = di.Disparity();
+         m.cost = cost;
+         dispHeap.Add(m);
+       }
+       else
+       {
+        // Check if its good enough to be included, and include it if so, removing the member it superceded...
+         if (cost<dispHeap.Peek().cost)
+         {
+          dispHeap.Rem();
+          Match m;
+          m.disp = di.Disparity();
+          m.cost = cost;
+          dispHeap.Add(m);
+         }
+       }
+       di.ToNext();
+      }
+
+
+     // Sort them by disparity...
+      nat32 num = 0;
+      while (dispHeap.Size()!=0)
+      {
+       dispArray[num] = dispHeap.Peek();
+       ++num;
+       dispHeap.Rem();
+      }
+
+      dispArray.SortRange<DispSort>(0,num-1);
+
+
+     // Write them into the correct scanline positions...
+      for (nat32 i=0;i<num;i++)
+      {
+       disp[y].data[disp[y].index[x]+i] = dispArray[i];
+      }
+    }
+   }
+ }
 }
 
 EBP::Pixel * EBP::Union(Pixel * pix[4],mem::Packer * memAlloc)
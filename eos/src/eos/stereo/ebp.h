@@ -29,6 +29,7 @@
 #include "eos/stereo/dsi.h"
 #include "eos/stereo/dsr.h"
 #include "eos/mem/packer.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -76,6 +77,17 @@ class EOS_CLASS EBP : public DSI
   /// If not set then it defaults back to the other DSC for this purpose.
    void SetOcc(const DSC * dsc);
 
+  /// Switches on the multi-threaded mode, in which building the hierachy,
+  /// the message passing at each level and extracting the results are all
+  /// split into bands of rows and handed to the given pool. Message passing
+  /// uses a checkerboard pattern, so the rows of a single pass never write to
+  /// a message another row reads, and the bands can run at the same time
+  /// without any locking or copying of borders. Each band of the hierachy
+  /// gets its own memory block, so the threads never fight over allocation.
+  /// The output is always bit-identical to the single threaded version.
+  /// Defaults to off.
+   void SetParallel(bit enable = true,mt::TaskPool & pool = mt::DefaultPool());
+
 
   /// Runs the algorithm.
    void Run(time::Progress * prog = null<time::Progress*>());
@@ -118,6 +130,8 @@ class EOS_CLASS EBP : public DSI
    DSC * dsc;
    DSC * dscOcc;
    
+   mt::TaskPool * pool; // null if not running in parallel.
+   
   // Out...
    struct Match
    {
@@ -237,6 +251,99 @@ class EOS_CLASS EBP : public DSI
    // Method to do a single iteration, given the index of a layer.
    // Also given the iteration number, to suport a checkerboard message passing pattern.
     void Iter(ds::Array2D<Pixel*> & index,nat32 iter);
+
+   // Does the rows [y0,y1) of an iteration, for the above...
+    void IterRows(ds::Array2D<Pixel*> & index,nat32 iter,nat32 y0,nat32 y1);
+
+   // Fills in the occlusion costs, matching costs and nulled messages for the
+   // rows [y0,y1) of the base layer, after the structure has been set. occ is
+   // dscOcc as its concrete type, so its costs inline - see dsc_dispatch.h...
+    template <typename T>
+    void BaseRows(const T & occ,ds::Array2D<Pixel*> & index,nat32 y0,nat32 y1);
+
+   // Fills in the rows [y0,y1) of a layer by unioning the layer below...
+    void UnionRows(ds::Array2D<Pixel*> & from,ds::Array2D<Pixel*> & to,nat32 y0,nat32 y1,mem::Packer * memAlloc);
+
+   // Transfers the messages from the layer above for the rows [y0,y1)...
+    void TransferRows(ds::Array2D<Pixel*> & to,ds::Array2D<Pixel*> & from,nat32 y0,nat32 y1);
+
+   // Extracts the output for the rows [y0,y1) of the base layer...
+    void ExtractRows(ds::Array2D<Pixel*> & index,nat32 y0,nat32 y1);
+
+   // Calls func(y0,y1) to cover the rows [begin,end), via the pool if there
+   // is one. grain is the smallest number of rows worth giving a thread...
+    template <typename F>
+    void ForRows(nat32 begin,nat32 end,F & func,nat32 grain)
+    {
+     if (pool) mt::ParallelFor(begin,end,func,grain,*pool);
+          else func(begin,end);
+    }
+
+   // Functors for the above...
+    struct IterFunc
+    {
+     EBP * self;
+     ds::Array2D<Pixel*> * index;
+     nat32 iter;
+     void operator()(nat32 y0,nat32 y1) {self->IterRows(*index,iter,y0,y1);}
+    };
+
+    template <typename T>
+    struct BaseFunc
+    {
+     EBP * self;
+     const T * occ;
+     ds::Array2D<Pixel*> * index;
+     void operator()(nat32 y0,nat32 y1) {self->BaseRows(*occ,*index,y0,y1);}
+    };
+
+    struct BaseKernel // Given to DispatchDSC with dscOcc, runs the matching BaseFunc.
+    {
+     EBP * self;
+     ds::Array2D<Pixel*> * index;
+     nat32 grain;
+     template <typename T>
+     void operator()(const T & occ)
+     {
+      BaseFunc<T> func;
+      func.self = self;
+      func.occ = &occ;
+      func.index = index;
+      self->ForRows(0,index->Height(),func,grain);
+     }
+    };
+
+    struct UnionFunc // Works in bands, each with its own memory allocator.
+    {
+     EBP * self;
+     ds::Array2D<Pixel*> * from;
+     ds::Array2D<Pixel*> * to;
+     ds::Array<mem::Packer*> * memAlloc;
+     void operator()(nat32 b0,nat32 b1)
+     {
+      for (nat32 b=b0;b<b1;b++)
+      {
+       nat32 y0 = (to->Height()*b)/memAlloc->Size();
+       nat32 y1 = (to->Height()*(b+1))/memAlloc->Size();
+       self->UnionRows(*from,*to,y0,y1,(*memAlloc)[b]);
+      }
+     }
+    };
+
+    struct TransferFunc
+    {
+     EBP * self;
+     ds::Array2D<Pixel*> * to;
+     ds::Array2D<Pixel*> * from;
+     void operator()(nat32 y0,nat32 y1) {self->TransferRows(*to,*from,y0,y1);}
+    };
+
+    struct ExtractFunc
+    {
+     EBP * self;
+     ds::Array2D<Pixel*> * index;
+     void operator()(nat32 y0,nat32 y1) {self->ExtractRows(*index,y0,y1);}
+    };
     
    // This method unions upto 4 Pixels, returning a new pixel allocated with 
    // the given mem::Packer. Given pointers can be null, they will not then be
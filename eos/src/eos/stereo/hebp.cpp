@@ -26,7 +26,7 @@ namespace eos
 //------------------------------------------------------------------------------
 HEBP::HEBP()
 :occCostBase(1.0),occCostMult(-0.1),occLimMult(2.0),iters(8),outCount(1),
-dsc(null<DSC*>()),dscOcc(null<DSC*>()),ebp(null<EBP*>())
+dsc(null<DSC*>()),dscOcc(null<DSC*>()),pool(null<mt::TaskPool*>()),ebp(null<EBP*>())
 {}
 
 HEBP::~HEBP()
@@ -63,10 +63,17 @@ void HEBP::Set(const svt::Field<bit> & lMask,const svt::Field<bit> & rMask)
  rightMask = rMask;
 }
 
+void HEBP::SetParallel(bit enable,mt::TaskPool & p)
+{
+ if (enable) pool = &p;
+        else pool = null<mt::TaskPool*>();
+}
+
 void HEBP::Run(time::Progress * prog)
 {
  LogBlock("eos::stereo::HEBP::Run","");
- prog->Push();
+ mem::MemScope memScope("eos::stereo::HEBP");
+ prog->Push("eos::stereo::HEBP::Run");
 
  // Build the dsc hierachy...
   HierarchyDSC hdsc;
@@ -125,6 +132,7 @@ void HEBP::Run(time::Progress * prog)
    {
     ll[i] = new EBP();
     ll[i]->Set(occCostBase,occCostMult,occLimMult,iters,outCount);
+    if (pool) ll[i]->SetParallel(true,*pool);
    }
    
   // Do the highest entry...
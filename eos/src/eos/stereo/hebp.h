@@ -58,6 +58,11 @@ class EOS_CLASS HEBP : public DSI
   /// Optional, sets the masks.
    void Set(const svt::Field<bit> & leftMask,const svt::Field<bit> & rightMask);
 
+  /// Switches on the multi-threaded mode of the EBP run at each level, see
+  /// EBP::SetParallel(). The output is bit-identical either way. Defaults to
+  /// off.
+   void SetParallel(bit enable = true,mt::TaskPool & pool = mt::DefaultPool());
+
 
   /// Runs the algorithm.
    void Run(time::Progress * prog = null<time::Progress*>());
@@ -101,6 +106,8 @@ class EOS_CLASS HEBP : public DSI
    DSC * dscOcc;
    svt::Field<bit> leftMask;
    svt::Field<bit> rightMask;
+   
+   mt::TaskPool * pool; // null if not running in parallel.
 
   // Output (Just pass through for the EBP of the last layer.)...
    EBP * ebp;
@@ -19,6 +19,7 @@
 
 #include "eos/alg/mean_shift.h"
 #include "eos/bs/geo_algs.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
@@ -158,25 +159,56 @@ void LayerMaker::Setup(svt::Core & core,PlaneSeg & planeSeg,real32 radius,time::
  prog->Pop();
 }
 
+class LayerMaker::Refit
+{
+ public:
+  Refit(LayerMaker & s,PlaneSeg & ps,const ds::Array<nat32> & st,const ds::Array<nat32> & m)
+  :self(s),planeSeg(ps),start(st),member(m)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 i=begin;i<end;i++)
+   {
+    LayerSeg layerSeg;
+    planeSeg.PrepLayerSeg(layerSeg);
+
+    for (nat32 j=start[i];j<start[i+1];j++) layerSeg.AddSegment(member[j]);
+
+    layerSeg.Run();
+    layerSeg.Result(self.layer[i]);
+   }
+  }
+
+
+ private:
+  LayerMaker & self;
+  PlaneSeg & planeSeg;
+  const ds::Array<nat32> & start;
+  const ds::Array<nat32> & member;
+};
+
 void LayerMaker::Rebuild(PlaneSeg & planeSeg,time::Progress * prog)
 {
  prog->Push();
+ prog->Report(0,1);
 
- for (nat32 i=0;i<layer.Size();i++)
- {
-  prog->Report(i,layer.Size());
-
-  LayerSeg layerSeg;
-  planeSeg.PrepLayerSeg(layerSeg);
+ // Bucket the segments by layer, so each fit only visits its own...
+  ds::Array<nat32> start(layer.Size()+1);
+  for (nat32 i=0;i<start.Size();i++) start[i] = 0;
+  for (nat32 i=0;i<sed.Size();i++) start[sed[i]+1] += 1;
+  for (nat32 i=0;i<layer.Size();i++) start[i+1] += start[i];
 
-  for (nat32 j=0;j<sed.Size();j++)
+  ds::Array<nat32> member(sed.Size());
   {
-   if (sed[j]==i) layerSeg.AddSegment(j);
+   ds::Array<nat32> pos(layer.Size());
+   for (nat32 i=0;i<layer.Size();i++) pos[i] = start[i];
+   for (nat32 i=0;i<sed.Size();i++) member[pos[sed[i]]++] = i;
   }
 
-  layerSeg.Run();
-  layerSeg.Result(layer[i]);
- }
+ // Each layer is fitted independently, so do them in parallel...
+  Refit refit(*this,planeSeg,start,member);
+  mt::ParallelFor(nat32(0),layer.Size(),refit);
 
  prog->Pop();
 }
@@ -60,6 +60,7 @@ class EOS_CLASS LayerMaker
    void Setup(svt::Core & core,PlaneSeg & planeSeg,real32 radius,time::Progress * prog = null<time::Progress*>());
 
   /// After editting by assignment to SegToLayer call this to rebuild the planes.
+  /// The layers are fitted in parallel.
    void Rebuild(PlaneSeg & planeSeg,time::Progress * prog = null<time::Progress*>());
    
   /// This merges together layers, in the same way that Setup merges together segments.
@@ -115,6 +116,9 @@ class EOS_CLASS LayerMaker
     return parent;
    }
   };
+
+ // Fits the planes for a range of layers, so Rebuild can do them in parallel...
+  class Refit;
 };
 
 //------------------------------------------------------------------------------
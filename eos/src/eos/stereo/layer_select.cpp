@@ -17,6 +17,8 @@
 
 #include "eos/stereo/layer_select.h"
 
+#include "eos/mt/tasks.h"
+
 namespace eos
 {
  namespace stereo
@@ -25,7 +27,7 @@ namespace eos
 LayerSelect::LayerSelect()
 :layerMaker(null<LayerMaker*>()),
 segCount(0),occCost(0.1),disCost(0.1),
-checkRuns(12)
+checkRuns(12),cached(false)
 {}
 
 LayerSelect::~LayerSelect()
@@ -34,30 +36,35 @@ LayerSelect::~LayerSelect()
 void LayerSelect::SetMaker(LayerMaker * lm)
 {
  layerMaker = lm;
+ cached = false;
 }
 
 void LayerSelect::SetSegs(nat32 sc,const svt::Field<nat32> & s)
 {
  segCount = sc;
  segs = s;
+ cached = false;
 }
 
 void LayerSelect::SetImages(const svt::Field<bs::ColourRGB> & l,const svt::Field<bs::ColourRGB> & r)
 {
  left = l;
  right = r;
+ cached = false;
 }
 
 void LayerSelect::SetMasks(const svt::Field<bit> & lm,const svt::Field<bit> & rm)
 {
  leftMask = lm;
  rightMask = rm;
+ cached = false;
 }
 
 void LayerSelect::SetCosts(real32 occ,real32 dis)
 {
  occCost = occ;
  disCost = dis;
+ cached = false;
 }
 
 void LayerSelect::SetBailOut(nat32 bo)
@@ -65,6 +72,139 @@ void LayerSelect::SetBailOut(nat32 bo)
  checkRuns = bo;
 }
 
+class LayerSelect::Rerender
+{
+ public:
+  Rerender(LayerSelect & s,ds::Array<WarpInc*> & w,const nat32 * sg,nat32 size)
+  :self(s),warp(w),seg(sg),segs(size)
+  {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 w=begin;w<end;w++)
+   {
+    for (nat32 i=0;i<segs;i++)
+    {
+     warp[w]->Remove(seg[i]);
+     if (w==0)
+     {
+      self.curBox[seg[i]].Clear();
+      self.RenderSegment(*warp[w],seg[i],&self.curBox[seg[i]]);
+     }
+     else self.RenderSegment(*warp[w],seg[i]);
+    }
+   }
+  }
+
+
+ private:
+  LayerSelect & self;
+  ds::Array<WarpInc*> & warp;
+  const nat32 * seg;
+  nat32 segs;
+};
+
+//------------------------------------------------------------------------------
+class LayerSelect::Evaluate
+{
+ public:
+  Evaluate(LayerSelect & s,filter::SegGraph & sg,ds::Array<WarpInc*> & w,nat32 * ul)
+  :self(s),segGraph(sg),warp(w),useLay(ul),seg(null<nat32*>()),segs(0)
+  {}
+
+  // Sets the segments to evaluate, none of which may be neighbours...
+   void Set(const nat32 * s,nat32 size)
+   {
+    seg = s;
+    segs = size;
+   }
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   LayerMaker * layerMaker = self.layerMaker;
+   bit * layF = new bit[layerMaker->Layers()];
+
+   for (nat32 w=begin;w<end;w++)
+   {
+    // Each warp image does its own share of the segments...
+     WarpInc & wi = *warp[w];
+     nat32 first = nat32((nat64(segs)*nat64(w))/nat64(warp.Size()));
+     nat32 last = nat32((nat64(segs)*nat64(w+1))/nat64(warp.Size()));
+
+     for (nat32 k=first;k<last;k++)
+     {
+      nat32 i = seg[k];
+
+      // Work out which layers we need to try...
+       for (nat32 j=0;j<layerMaker->Layers();j++) layF[j] = false;
+       for (nat32 j=0;j<segGraph.NeighbourCount(i);j++)
+       {
+        layF[layerMaker->SegToLayer(segGraph.Neighbour(i,j))] = true;
+       }
+       layF[layerMaker->SegToLayer(i)] = false;
+
+      // For each layer check if its an improvment on the last, relative to the
+      // current score. Moves are taken from the cache where possible, only
+      // rendered when not - the first render stashes the starting state...
+       nat32 startLayer = layerMaker->SegToLayer(i);
+       nat32 bestLayer = startLayer;
+       real32 bestCost = 0.0;
+
+       bit stashed = false;
+       real32 base = 0.0;
+       for (nat32 j=0;j<layerMaker->Layers();j++)
+       {
+        if (layF[j])
+        {
+         real32 delta;
+         if (!self.Lookup(i,j,delta))
+         {
+          if (stashed) wi.Remove(i);
+          else
+          {
+           base = wi.Score();
+           wi.Stash(i);
+           stashed = true;
+          }
+
+          layerMaker->SegToLayer(i) = j;
+          self.RenderSegment(wi,i,&self.box[i]);
+          layerMaker->SegToLayer(i) = startLayer;
+
+          delta = wi.Score() - base;
+          self.Store(i,j,delta);
+         }
+
+         real32 cost = delta + self.DiscDelta(segGraph,i,j)*self.disCost;
+         if (cost<bestCost)
+         {
+          bestLayer = j;
+          bestCost = cost;
+         }
+        }
+       }
+
+      // Store the change for future application and revert to the starting state...
+       useLay[i] = bestLayer;
+       if (stashed) wi.Restore(i);
+     }
+   }
+
+   delete[] layF;
+  }
+
+
+ private:
+  LayerSelect & self;
+  filter::SegGraph & segGraph;
+  ds::Array<WarpInc*> & warp;
+  nat32 * useLay;
+
+  const nat32 * seg;
+  nat32 segs;
+};
+
+//------------------------------------------------------------------------------
 bit LayerSelect::Run(time::Progress * prog)
 {
  prog->Push();
@@ -99,15 +239,92 @@ bit LayerSelect::Run(time::Progress * prog)
   }
 
 
- // Initialise and build the warp image, with all the segments/layers...
-  WarpInc warp(right,segCount);
-  warp.SetMask(rightMask);
-  warp.Weights(occCost);
-  for (nat32 i=0;i<segCount;i++) RenderSegment(warp,i);
+ // Initialise and build the warp images, with all the segments/layers. There
+ // is one per thread, all kept in the same state, so candidate moves can be
+ // tried out in parallel - the first doubles as the master copy...
+  nat32 warps = math::Clamp<nat32>(mt::DefaultPool().Concurrency(),1,math::Max<nat32>(segCount,1));
+  ds::Array<WarpInc*> warp(warps);
+  for (nat32 w=0;w<warps;w++)
+  {
+   warp[w] = new WarpInc(right,segCount);
+   warp[w]->SetMask(rightMask);
+   warp[w]->Weights(occCost);
+  }
+
+  ds::Array<nat32> changed(segCount);
+  for (nat32 i=0;i<segCount;i++) changed[i] = i;
+  {
+   curBox.Size(segCount);
+   Rerender rerender(*this,warp,changed.Ptr(),segCount);
+   mt::ParallelFor(nat32(0),warps,rerender);
+  }
 
  // Create a graph so we can iterate the adjacent segments of any one segment quickly.
   filter::SegGraph segGraph(segs,segCount);
 
+ // Prepare the cache of moves - if its left over from a previous run only the
+ // segments now rendered with a different plane invalidate it...
+  if (!cached)
+  {
+   slotStart.Size(segCount+1);
+   slotStart[0] = 0;
+   for (nat32 i=0;i<segCount;i++) slotStart[i+1] = slotStart[i] + segGraph.NeighbourCount(i);
+   slot.Size(slotStart[segCount]);
+   for (nat32 i=0;i<slot.Size();i++) slot[i].layer = emptySlot;
+
+   box.Size(segCount);
+   for (nat32 i=0;i<segCount;i++) box[i] = curBox[i];
+   segPlane.Size(segCount);
+  }
+  else
+  {
+   nat32 changes = 0;
+   for (nat32 i=0;i<segCount;i++)
+   {
+    const bs::PlaneABC & p = layerMaker->Plane(layerMaker->SegToLayer(i));
+    if ((!math::Equal(p.a,segPlane[i].a))||(!math::Equal(p.b,segPlane[i].b))||(!math::Equal(p.c,segPlane[i].c))) changed[changes++] = i;
+   }
+   Invalidate(changed.Ptr(),changes,right.Size(0),right.Size(1));
+  }
+
+  for (nat32 i=0;i<segCount;i++) segPlane[i] = layerMaker->Plane(layerMaker->SegToLayer(i));
+  cached = true;
+
+ // Greedily colour the segment graph, so no two segments of the same colour are
+ // neighbours - the segments of a colour can then all be evaluated at once, as
+ // the layer change being tried for one does not effect the discontinuity cost
+ // of the others. Stored as a list of segments sorted by colour...
+  ds::Array<nat32> colour(segCount);
+  nat32 colours = 0;
+  {
+   ds::Array<nat32> used(segCount+1);
+   for (nat32 i=0;i<used.Size();i++) used[i] = segCount+1;
+   for (nat32 i=0;i<segCount;i++)
+   {
+    for (nat32 j=0;j<segGraph.NeighbourCount(i);j++)
+    {
+     nat32 n = segGraph.Neighbour(i,j);
+     if (n<i) used[colour[n]] = i;
+    }
+
+    colour[i] = 0;
+    while (used[colour[i]]==i) colour[i] += 1;
+    colours = math::Max(colours,colour[i]+1);
+   }
+  }
+
+  ds::Array<nat32> colStart(colours+1);
+  for (nat32 c=0;c<colStart.Size();c++) colStart[c] = 0;
+  for (nat32 i=0;i<segCount;i++) colStart[colour[i]+1] += 1;
+  for (nat32 c=0;c<colours;c++) colStart[c+1] += colStart[c];
+
+  ds::Array<nat32> bycol(segCount);
+  {
+   ds::Array<nat32> pos(colours);
+   for (nat32 c=0;c<colours;c++) pos[c] = colStart[c];
+   for (nat32 i=0;i<segCount;i++) bycol[pos[colour[i]]++] = i;
+  }
+
  // Create a discontinuity count variable, which we incrimentally update as we go,
  // fill it with the starting discontinuity...
   nat32 discCount = 0;
@@ -122,12 +339,9 @@ bit LayerSelect::Run(time::Progress * prog)
    }
   }
 
- // A tempory lump of memory used below for keeping track of which layers we need to try...
-  bit * layF = new bit[layerMaker->Layers()];
-
  // A tempory lump of memory, this once for tracking the new layer for each segment, we have
  // two, due to tracking the last few and using the last best when no improvment happens for x.
-  real32 lowestScore = warp.Score() + discCount*disCost;
+  real32 lowestScore = warp[0]->Score() + discCount*disCost;
   nat32 * bestLay = new nat32[segCount];
   for (nat32 i=0;i<segCount;i++) bestLay[i] = layerMaker->SegToLayer(i);
   bit ret = false;
@@ -135,76 +349,46 @@ bit LayerSelect::Run(time::Progress * prog)
   nat32 * useLay = new nat32[segCount];
   nat32 bailOut = 0;
 
+  Evaluate evaluate(*this,segGraph,warp,useLay);
+
 
  // Iterate until no changes found...
   while (bailOut<checkRuns)
   {
-   // For each segment try layer re-alignments, set it to the one which reduces
-   // the cost the most...
-    for (nat32 i=0;i<segCount;i++)
+   // For each segment try layer re-alignments, recording the one which reduces
+   // the cost the most. Every segment is tried against the same starting state,
+   // a colour at a time...
+    for (nat32 c=0;c<colours;c++)
     {
-     // Work out which layers we need to try...
-      for (nat32 j=0;j<layerMaker->Layers();j++) layF[j] = false;
-      for (nat32 j=0;j<segGraph.NeighbourCount(i);j++)
-      {
-       layF[layerMaker->SegToLayer(segGraph.Neighbour(i,j))] = true;
-      }
-      layF[layerMaker->SegToLayer(i)] = false;
-
-     // For each layer check if its an improvment on the last...
-      nat32 startLayer = layerMaker->SegToLayer(i);
-      nat32 bestLayer = startLayer;
-      real32 bestScore = warp.Score() + discCount*disCost;
-
-      for (nat32 j=0;j<layerMaker->Layers();j++)
-      {
-       if (layF[j])
-       {
-	// We have a layer to try out, update the warp image as required...
-	 warp.Remove(i);
-	 discCount += DiscDelta(segGraph,i,j);
-	 layerMaker->SegToLayer(i) = j;
-	 RenderSegment(warp,i);
-
-	// If the score has improved, record it, otherwise we don't give a dam...
-	 real32 score = warp.Score() + discCount*disCost;
-
-	 if (score<bestScore)
-         {
-	  bestLayer = j;
-	  bestScore = score;
-         }
-       }
-      }
-
-     // Store the change for future application and revert to the starting state...
-      useLay[i] = bestLayer;
-      if (layerMaker->SegToLayer(i)!=startLayer)
-      {
-       warp.Remove(i);
-       discCount += DiscDelta(segGraph,i,startLayer);
-       layerMaker->SegToLayer(i) = startLayer;
-       RenderSegment(warp,i);
-      }
+     evaluate.Set(bycol.Ptr() + colStart[c],colStart[c+1]-colStart[c]);
+     mt::ParallelFor(nat32(0),warps,evaluate);
     }
     prog->Report(segCount,segCount);
 
 
-   // Update the segments with there new layer allocations...
+   // Update the segments with there new layer allocations, in every warp image...
+    nat32 changes = 0;
     for (nat32 i=0;i<segCount;i++)
     {
      if (layerMaker->SegToLayer(i)!=useLay[i])
      {
-      warp.Remove(i);
       discCount += DiscDelta(segGraph,i,useLay[i]);
       layerMaker->SegToLayer(i) = useLay[i];
-      RenderSegment(warp,i);
+      changed[changes++] = i;
      }
     }
 
+    {
+     Rerender rerender(*this,warp,changed.Ptr(),changes);
+     mt::ParallelFor(nat32(0),warps,rerender);
+    }
+
+    Invalidate(changed.Ptr(),changes,right.Size(0),right.Size(1));
+    for (nat32 i=0;i<changes;i++) segPlane[changed[i]] = layerMaker->Plane(layerMaker->SegToLayer(changed[i]));
+
    // Check if the score is an improvment, if so store it, if not indicate
    // were getting close to bailing out...
-    real32 finScore = warp.Score() + discCount*disCost;
+    real32 finScore = warp[0]->Score() + discCount*disCost;
     if (lowestScore<=finScore) bailOut++;
     else
     {
@@ -226,7 +410,8 @@ bit LayerSelect::Run(time::Progress * prog)
 
  // Clean up...
   delete[] useLay;
-  delete[] layF;
+  delete[] bestLay;
+  for (nat32 w=0;w<warps;w++) delete warp[w];
 
   for (nat32 i=0;i<segCount;i++)
   {
@@ -244,7 +429,7 @@ bit LayerSelect::Run(time::Progress * prog)
  return ret;
 }
 
-void LayerSelect::RenderSegment(WarpInc & warp,nat32 segment)
+void LayerSelect::RenderSegment(WarpInc & warp,nat32 segment,Box * box)
 {
  Node * targ = sed[segment];
  const bs::PlaneABC & plane = layerMaker->Plane(layerMaker->SegToLayer(segment));
@@ -274,12 +459,96 @@ void LayerSelect::RenderSegment(WarpInc & warp,nat32 segment)
       colour.b = (1.0-t)*targ->colour.b + t*targ->next->colour.b;
 
      warp.Add(i,targ->y,plane.Z(targ->x+t,targ->y),colour,segment);
+     if (box) box->Add(i,targ->y);
     }
   }
   targ = targ->next;
  }
 }
 
+bit LayerSelect::Lookup(nat32 seg,nat32 layer,real32 & delta)
+{
+ const bs::PlaneABC & p = layerMaker->Plane(layer);
+ for (nat32 i=slotStart[seg];i<slotStart[seg+1];i++)
+ {
+  Slot & targ = slot[i];
+  if ((targ.layer==layer)&&math::Equal(targ.plane.a,p.a)&&math::Equal(targ.plane.b,p.b)&&math::Equal(targ.plane.c,p.c))
+  {
+   delta = targ.delta;
+   return true;
+  }
+ }
+ return false;
+}
+
+void LayerSelect::Store(nat32 seg,nat32 layer,real32 delta)
+{
+ nat32 count = slotStart[seg+1] - slotStart[seg];
+ if (count==0) return;
+
+ // Use a free slot or one for the same layer, failing that evict one...
+  Slot * targ = &slot[slotStart[seg] + layer%count];
+  for (nat32 i=slotStart[seg];i<slotStart[seg+1];i++)
+  {
+   if ((slot[i].layer==emptySlot)||(slot[i].layer==layer)||(slot[i].layer>=layerMaker->Layers()))
+   {
+    targ = &slot[i];
+    break;
+   }
+  }
+
+ targ->layer = layer;
+ targ->plane = layerMaker->Plane(layer);
+ targ->delta = delta;
+}
+
+void LayerSelect::Clear(nat32 seg)
+{
+ for (nat32 i=slotStart[seg];i<slotStart[seg+1];i++) slot[i].layer = emptySlot;
+ box[seg] = curBox[seg];
+}
+
+void LayerSelect::Invalidate(const nat32 * dirty,nat32 count,nat32 width,nat32 height)
+{
+ if (count==0) return;
+
+ // Mark the tiles covered by the old and new renderings of the changed segments...
+  int32 tw = (int32(width)+tileSize-1)/tileSize;
+  int32 th = (int32(height)+tileSize-1)/tileSize;
+  ds::Array<bit> tile(tw*th);
+  for (nat32 i=0;i<tile.Size();i++) tile[i] = false;
+
+  for (nat32 i=0;i<count;i++)
+  {
+   Box b = box[dirty[i]];
+   b.Add(curBox[dirty[i]]);
+   Clear(dirty[i]);
+   if (b.Empty()) continue;
+
+   for (int32 y=b.minY/tileSize;y<=b.maxY/tileSize;y++)
+   {
+    for (int32 x=b.minX/tileSize;x<=b.maxX/tileSize;x++) tile[y*tw + x] = true;
+   }
+  }
+
+ // Drop the entries of every segment that depends on a marked tile...
+  for (nat32 s=0;s<segCount;s++)
+  {
+   const Box & b = box[s];
+   if (b.Empty()) continue;
+
+   bit hit = false;
+   for (int32 y=b.minY/tileSize;(y<=b.maxY/tileSize)&&(!hit);y++)
+   {
+    for (int32 x=b.minX/tileSize;x<=b.maxX/tileSize;x++)
+    {
+     if (tile[y*tw + x]) {hit = true; break;}
+    }
+   }
+   if (hit) Clear(s);
+  }
+}
+
 int32 LayerSelect::DiscDelta(filter::SegGraph & segGraph,nat32 seg,nat32 toLayer)
 {
  nat32 fromLayer = layerMaker->SegToLayer(seg);
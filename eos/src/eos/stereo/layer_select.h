@@ -31,6 +31,7 @@
 #include "eos/filter/seg_graph.h"
 #include "eos/time/progress.h"
 #include "eos/bs/colours.h"
+#include "eos/math/functions.h"
 
 namespace eos
 {
@@ -82,7 +83,15 @@ class EOS_CLASS LayerSelect
   /// Runs the algorithm, it edits directly the LayerMaker passed in, returns
   /// true if changes were made, false if no improvment could be found. If
   /// changes were made you ushally re-fit the layer maker and then call this
-  /// again.
+  /// again. The candidate moves are evaluated in parallel, with a warp image
+  /// per thread and the segments done in batches where no two neighbour.
+  /// (Each pass evaluates every segment against the same starting state, so
+  /// this gives the same moves as doing them one at a time, up to rounding.)
+  /// The change in warp score for each move tried is cached, along with the
+  /// region of the warp image it depends on, and reused until something
+  /// rendered in that region changes - this includes between calls, so after a
+  /// refit of the LayerMaker only the moves near effected segments, or to
+  /// layers with new planes, are re-evaluated.
    bit Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -116,12 +125,70 @@ class EOS_CLASS LayerSelect
    };
    Node ** sed; // Array of segCount size, points to first in each list.
 
-  // Renders the given segment...
-   void RenderSegment(WarpInc & warp,nat32 segment);
+  // Bounding box of the warp pixels that a segment renders to, empty when
+  // minX>maxX...
+   struct Box
+   {
+    int32 minX,maxX,minY,maxY;
+
+    void Clear() {minX = 1; maxX = 0; minY = 1; maxY = 0;}
+    bit Empty() const {return minX>maxX;}
+    void Add(int32 x,int32 y)
+    {
+     if (Empty()) {minX = x; maxX = x; minY = y; maxY = y; return;}
+     minX = math::Min(minX,x); maxX = math::Max(maxX,x);
+     minY = math::Min(minY,y); maxY = math::Max(maxY,y);
+    }
+    void Add(const Box & rhs)
+    {
+     if (rhs.Empty()) return;
+     Add(rhs.minX,rhs.minY);
+     Add(rhs.maxX,rhs.maxY);
+    }
+   };
+
+  // Renders the given segment, optionally recording where it went...
+   void RenderSegment(WarpInc & warp,nat32 segment,Box * box = null<Box*>());
+
+  // The cache of warp score changes for moving segments to layers. Each
+  // segment has a slot per neighbour, as that bounds how many layers it can be
+  // offered at once; entries are dropped when anything rendered within the box
+  // of the segment changes, the box covering every rendering of the segment
+  // used to calculate an entry...
+   static const nat32 emptySlot = 0xFFFFFFFF;
+   static const int32 tileSize = 8; // Granularity of the invalidation.
+
+   struct Slot
+   {
+    nat32 layer; // Layer moved to, emptySlot if unused.
+    bs::PlaneABC plane; // Plane of the layer when calculated, so refits can be detected.
+    real32 delta; // Change in warp score caused by the move.
+   };
+
+   bit cached; // False if the below need building from scratch.
+   ds::Array<nat32> slotStart; // Index of first slot for each segment, plus one past the end.
+   ds::Array<Slot> slot;
+   ds::Array<Box> curBox; // Each segment as currently rendered.
+   ds::Array<Box> box; // Each segment over every rendering its slots depend on.
+   ds::Array<bs::PlaneABC> segPlane; // Plane each segment is rendered with.
+
+   bit Lookup(nat32 seg,nat32 layer,real32 & delta);
+   void Store(nat32 seg,nat32 layer,real32 delta);
+   void Clear(nat32 seg);
+
+  // Given segments whose rendering has changed, from box to curBox, this drops
+  // every cache entry that could depend on them...
+   void Invalidate(const nat32 * dirty,nat32 count,nat32 width,nat32 height);
 
   // Given various bits of information calculates the change in discontinuity
   // count given a segment changing its layer to another...
    int32 DiscDelta(filter::SegGraph & segGraph,nat32 seg,nat32 toLayer);
+
+  // Functors for doing the work in parallel - the first re-renders a list of
+  // segments into every warp image, the second evaluates the moves for a batch
+  // of segments...
+   class Rerender;
+   class Evaluate;
 };
 
 //------------------------------------------------------------------------------
@@ -18,11 +18,214 @@
 #include "eos/stereo/orient_stereo.h"
 
 #include "eos/inf/fig_factors.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace stereo
  {
+//------------------------------------------------------------------------------
+// Fills in a band of rows of the DSI and the disparity to location table used
+// by OrientStereo::RunHalf...
+class OrientDsiRows
+{
+ public:
+  OrientDsiRows(const svt::Field<bs::ColourLuv> & l,const svt::Field<bs::ColourLuv> & r,const cam::DispConv & dc,
+                int32 mD,int32 dR,real32 gM,real32 gX,real32 * d,bs::Vertex * dtl)
+  :left(l),right(r),dispConv(dc),minDisp(mD),dispRange(dR),gammaMult(gM),gammaMax(gX),dsi(d),dispToLoc(dtl)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<left.Size(0);x++)
+    {
+     real32 * out = dsi + dispRange*(left.Size(0)*y + x);
+     bs::Vertex * loc = dispToLoc + dispRange*(left.Size(0)*y + x);
+     for (int32 d=0;d<dispRange;d++)
+     {
+      int32 x2 = int32(x) + d + minDisp;
+      if ((x2<0)||(x2>=int32(right.Size(0)))) out[d] = gammaMax;
+      else
+      {
+       out[d] = math::Min(gammaMax,gammaMult*math::Abs(left.Get(x,y).l-right.Get(x2,y).l));
+      }
+
+      dispConv.DispToPos(x,y,d+minDisp,loc[d]);
+     }
+    }
+   }
+  }
+
+ private:
+  const svt::Field<bs::ColourLuv> & left;
+  const svt::Field<bs::ColourLuv> & right;
+  const cam::DispConv & dispConv;
+  int32 minDisp;
+  int32 dispRange;
+  real32 gammaMult;
+  real32 gammaMax;
+  real32 * dsi;
+  bs::Vertex * dispToLoc;
+};
+
+// Does a range of irradiance values of the irradiance/albedo/orient to
+// surface orientation table...
+class OrientAngToDir
+{
+ public:
+  OrientAngToDir(const bs::Normal & tl,nat32 aR,nat32 oR,bs::Normal * o)
+  :toLight(tl),albRes(aR),orientRes(oR),out(o)
+  {
+   math::CrossProduct(toLight,bs::Normal(1.0,0.0,0.0),axis);
+   axis.Normalise();
+  }
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   bs::Normal tl = toLight; // Local copies, as AngAxisToRotMat takes non-const.
+   bs::Normal ax = axis;
+   for (nat32 i=begin;i<end;i++)
+   {
+    real32 irVal = 100.0*real32(i+1)/real32(albRes);
+    for (nat32 a=0;a<albRes;a++)
+    {
+     real32 albVal = 100.0*real32(a+1)/real32(albRes);
+     real32 cosAng = math::Min<real32>(irVal/albVal,1.0);
+
+     math::Mat<3> rot1;
+     math::AngAxisToRotMat(ax,math::InvCos(cosAng),rot1);
+
+     for (nat32 o=0;o<orientRes;o++)
+     {
+      real32 orientVal = 2.0*math::pi*real32(o)/real32(orientRes);
+
+      math::Mat<3> rot2;
+      math::AngAxisToRotMat(tl,orientVal,rot2);
+
+      math::Mat<3> rot3;
+      math::Mult(rot2,rot1,rot3);
+      math::MultVect(rot3,tl,out[orientRes*(albRes*i + a) + o]);
+     }
+    }
+   }
+  }
+
+ private:
+  bs::Normal toLight;
+  nat32 albRes;
+  nat32 orientRes;
+  bs::Normal * out;
+  bs::Normal axis;
+};
+
+// Fills in a band of rows of the albedo-orientation joint distribution, the
+// painful step of OrientStereo::RunHalf...
+class OrientJointRows
+{
+ public:
+  OrientJointRows(const svt::Field<bs::ColourLuv> & l,const cam::DispConv & dc,int32 mD,int32 dR,
+                  nat32 aR,nat32 oR,real32 gX,const real32 * d,const bs::Vertex * dtl,const bs::Normal * atd,
+                  inf::GridJointPair2D & ao,nat32 * iR)
+  :left(l),dispConv(dc),minDisp(mD),dispRange(dR),albRes(aR),orientRes(oR),gammaMax(gX),
+  dsi(d),dispToLoc(dtl),angToDir(atd),albOrient(ao),inRange(iR)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   nat32 width = left.Size(0);
+   for (nat32 y=begin;y<end;y++)
+   {
+    #ifdef EOS_DEBUG
+    inRange[y] = 0;
+    #endif
+    for (nat32 x=0;x<width;x++)
+    {
+     // Per pixel constants - the irradiance index, the ray of the adjacent
+     // pixel and the dsi entries of both...
+      nat32 irInd = math::Clamp<nat32>(nat32(albRes*left.Get(x,y).l/100.0),0,albRes-1);
+
+      bs::Vertex start;
+      bs::Vertex offset;
+      dispConv.Ray(x+1.0,y,start,offset);
+      bs::Vert st(start);
+      bs::Vert of(offset);
+
+      const real32 * locDSI = dsi + dispRange*(width*y + x);
+      const real32 * adjDSI = (x+1<width)?(locDSI+dispRange):locDSI;
+      const bs::Vertex * locPos = dispToLoc + dispRange*(width*y + x);
+
+     for (nat32 o=0;o<orientRes;o++)
+     {
+      for (nat32 a=0;a<albRes;a++)
+      {
+       // First convert the alb/orient into a surface orientation...
+        const bs::Normal & norm = angToDir[orientRes*(albRes*irInd + a) + o];
+        real32 ofDotN = of*norm;
+
+       // Now iterate the current pixels dsi, for each calculate the change in 
+       // disparity due to the surface orientation and get the resulting dsi value 
+       // from the adjuacent pixel. The sum of these two dsi's is the relevant cost.
+        real32 minCost = gammaMax*2.0;
+        for (int32 d=0;d<dispRange;d++)
+        {
+         // Intercept the plane created by the 3D location/orientation with the 
+         // ray to get another location...
+          bs::Vert lo(locPos[d]);
+          lo -= st;
+          real32 lambda = (lo*norm)/ofDotN;
+
+          bs::Vertex loc;
+          loc[0] = st[0] + lambda*of[0];
+          loc[1] = st[1] + lambda*of[1];
+          loc[2] = st[2] + lambda*of[2];
+          loc[3] = 1.0;
+
+         // Convert the location into a disparity...
+          real32 lx;
+          real32 ly;
+          real32 disp;
+          dispConv.PosToDisp(loc,lx,ly,disp);
+
+         // Grab the relevent DSI scores, add them, set minCost if the new cost 
+         // is lower...
+          real32 score = locDSI[d];
+
+          disp -= minDisp;
+          nat32 base = nat32(math::Clamp<int32>(int32(disp),0,dispRange-1));
+          nat32 baseP = math::Min<nat32>(dispRange-1,base+1);
+          real32 t = math::Mod1(disp);
+
+          score += (1.0-t)*adjDSI[base] + t*adjDSI[baseP];
+
+          minCost = math::Min(minCost,score);
+          #ifdef EOS_DEBUG
+          if (base!=baseP) inRange[y] += 1;
+          #endif
+        }
+        albOrient.Val(x,y,a,o) = minCost;
+      }
+     }
+    }
+   }
+  }
+
+ private:
+  const svt::Field<bs::ColourLuv> & left;
+  const cam::DispConv & dispConv;
+  int32 minDisp;
+  int32 dispRange;
+  nat32 albRes;
+  nat32 orientRes;
+  real32 gammaMax;
+  const real32 * dsi;
+  const bs::Vertex * dispToLoc;
+  const bs::Normal * angToDir;
+  inf::GridJointPair2D & albOrient;
+  nat32 * inRange; // Per row count of interpolated lookups, only used with EOS_DEBUG.
+};
+
 //------------------------------------------------------------------------------
 OrientStereo::OrientStereo()
 :minDisp(-30),maxDisp(30),albRes(100),orientRes(180),
@@ -134,27 +337,16 @@ void OrientStereo::RunHalf(time::Progress * prog,nat32 leftInd)
   nat32 handSmoOrient = fg.NewFP(smoOrient);
 
 
- // Create DSI, ready for creating the albedo-orientation joint distribution...
+ // Create DSI, ready for creating the albedo-orientation joint distribution,
+ // and the location/disparity to location lookup table...
   prog->Report(1,8);
   
   int32 dispRange = locMaxDisp-locMinDisp+1;
   real32 * dsi = new real32[ir[leftInd].Size(0)*ir[leftInd].Size(1)*dispRange];
-  for (nat32 y=0;y<ir[leftInd].Size(1);y++)
+  bs::Vertex * dispToLoc = new bs::Vertex[ir[leftInd].Size(0)*ir[leftInd].Size(1)*dispRange];
   {
-   for (nat32 x=0;x<ir[leftInd].Size(0);x++)
-   {
-    for (int32 d=0;d<dispRange;d++)
-    {
-     real32 & out = dsi[dispRange*(ir[leftInd].Size(0)*y + x) + d];
-
-     int32 x2 = int32(x) + d - locMinDisp;
-     if ((x2<0)||(x2>=int32(ir[rightInd].Size(0)))) out = gammaMax;
-     else
-     {
-      out = math::Min(gammaMax,gammaMult*math::Abs(ir[leftInd].Get(x,y).l-ir[rightInd].Get(x2,y).l));
-     }
-    }
-   }
+   OrientDsiRows dsiRows(ir[leftInd],ir[rightInd],*dispConv[leftInd],locMinDisp,dispRange,gammaMult,gammaMax,dsi,dispToLoc);
+   mt::ParallelFor(nat32(0),ir[leftInd].Size(1),dsiRows);
   }
 
 
@@ -162,146 +354,38 @@ void OrientStereo::RunHalf(time::Progress * prog,nat32 leftInd)
  // (We use albRes as the iradiance resolution as well.)
   prog->Report(2,8);
   bs::Normal * angToDir = new bs::Normal[albRes*albRes*orientRes];
-  
-  prog->Push();
-  for (nat32 i=0;i<albRes;i++)
-  {
-   prog->Report(i,albRes);
-   for (nat32 a=0;a<albRes;a++)
-   {
-    for (nat32 o=0;o<orientRes;o++)
-    {
-     bs::Normal & out = angToDir[orientRes*(albRes*i + a) + o];
-
-     real32 irVal = 100.0*real32(i+1)/real32(albRes);
-     real32 albVal = 100.0*real32(a+1)/real32(albRes);
-     real32 orientVal = 2.0*math::pi*real32(o)/real32(orientRes);
-     real32 cosAng = math::Min<real32>(irVal/albVal,1.0);
-
-     bs::Normal axis;
-     math::CrossProduct(toLight[leftInd],bs::Normal(1.0,0.0,0.0),axis);
-     axis.Normalise();
-     math::Mat<3> rot1;
-     math::AngAxisToRotMat(axis,math::InvCos(cosAng),rot1);
-     
-     math::Mat<3> rot2;
-     math::AngAxisToRotMat(toLight[leftInd],orientVal,rot2);
-     
-     math::Mat<3> rot3;
-     math::Mult(rot2,rot1,rot3);
-     math::MultVect(rot3,toLight[leftInd],out);
-    }
-   }
-  }
-  prog->Pop();
-
-  
- // Create location/disparity to location lookup table...
-  prog->Report(3,8);
-  prog->Push();
-  bs::Vertex * dispToLoc = new bs::Vertex[ir[leftInd].Size(0)*ir[leftInd].Size(1)*dispRange];
-  for (nat32 y=0;y<ir[leftInd].Size(1);y++)
   {
-   prog->Report(y,ir[leftInd].Size(1));
-   for (nat32 x=0;x<ir[leftInd].Size(0);x++)
-   {
-    for (int32 d=0;d<dispRange;d++)
-    {
-     bs::Vertex & out = dispToLoc[dispRange*(ir[leftInd].Size(0)*y + x) + d];
-     dispConv[leftInd]->DispToPos(x,y,d+locMinDisp,out);
-    }
-   }
+   OrientAngToDir atd(toLight[leftInd],albRes,orientRes,angToDir);
+   mt::ParallelFor(nat32(0),albRes,atd);
   }
-  prog->Pop();
 
 
- // Create the albedo-orientation joint distributions (Painful step)...
+ // Create the albedo-orientation joint distributions (Painful step), rows in
+ // parallel...
   prog->Report(4,8);
   
   inf::GridJointPair2D * albOrient = new inf::GridJointPair2D(albRes,orientRes,
                                                               ir[leftInd].Size(0),ir[leftInd].Size(1),
                                                               true);
-
   LogDebug("[OrientStereo.cache] Starting generation");
-  #ifdef EOS_DEBUG
-  nat32 caughtInRange = 0;
-  #endif
-  prog->Push();
-  for (nat32 y=0;y<ir[leftInd].Size(1);y++)
   {
-   for (nat32 x=0;x<ir[leftInd].Size(0);x++)
-   {
-    prog->Report(y*ir[leftInd].Size(0)+x,ir[leftInd].Size(0)*ir[leftInd].Size(1));
-    for (nat32 a=0;a<albRes;a++)
-    {
-     for (nat32 o=0;o<orientRes;o++)
-     {
-      // First convert the alb/orient into a surface orientation...
-       nat32 irInd = math::Clamp<nat32>(nat32(albRes*ir[leftInd].Get(x,y).l/100.0),0,albRes-1);
-       bs::Normal norm = angToDir[orientRes*(albRes*irInd + a) + o];
-
-      // Convert the adjacent pixel into a ray, ready for the below...
-       bs::Vertex start;
-       bs::Vertex offset;
-       dispConv[leftInd]->Ray(x+1.0,y,start,offset);
-
-      // Now iterate the current pixels dsi, for each calculate the change in 
-      // disparity due to the surface orientation and get the resulting dsi value 
-      // from the adjuacent pixel. The sum of these two dsi's is the relevant cost.
-       real32 minCost = gammaMax*2.0;
-       for (int32 d=locMinDisp;d<=locMaxDisp;d++)
-       {
-        // Convert the disparity to a 3D location...
-         bs::Vertex loc = dispToLoc[dispRange*(ir[leftInd].Size(0)*y + x) + locMinDisp+d];
-
-        // Intercept the plane created by the 3D location/orientation with the 
-        // ray to get another location...
-         bs::Vert lo(loc);
-         bs::Vert st(start);
-         bs::Vert of(offset);
-         
-         lo -= st;
-         real32 lambda = (lo*norm)/(of*norm);
-         loc[0] = st[0] + lambda*of[0];
-         loc[1] = st[1] + lambda*of[1];
-         loc[2] = st[2] + lambda*of[2];
-         loc[3] = 1.0;
-
-        // Convert the location into a disparity...
-         real32 lx;
-         real32 ly;
-         real32 disp;
-         dispConv[leftInd]->PosToDisp(loc,lx,ly,disp);
-        
-        // Grab the relevent DSI scores, add them, set minCost if the new cost 
-        // is lower...
-         real32 * locDSI = dsi + dispRange*(ir[leftInd].Size(0)*y + x);
-         real32 score = locDSI[locMinDisp+d];
-         
-         disp += locMinDisp;
-         nat32 base = nat32(math::Clamp<int32>(int32(disp+locMinDisp),0,dispRange-1));
-         nat32 baseP = math::Min<nat32>(dispRange-1,base+1);
-         real32 t = math::Mod1(disp);
-
-         score += (1.0-t)*locDSI[base] + t*locDSI[baseP];
-
-         minCost = math::Min(minCost,score);
-         #ifdef EOS_DEBUG
-         if (base!=baseP) caughtInRange += 1;
-         #endif
-       }
-       albOrient->Val(x,y,a,o) = minCost;
-     }
-    }
-   }
+   ds::Array<nat32> inRange(ir[leftInd].Size(1));
+   OrientJointRows joint(ir[leftInd],*dispConv[leftInd],locMinDisp,dispRange,albRes,orientRes,gammaMax,
+                         dsi,dispToLoc,angToDir,*albOrient,inRange.Ptr());
+   mt::ParallelFor(nat32(0),ir[leftInd].Size(1),joint);
+
+   #ifdef EOS_DEBUG
+   nat32 caughtInRange = 0;
+   for (nat32 y=0;y<inRange.Size();y++) caughtInRange += inRange[y];
+   #endif
+   LogDebug("[OrientStereo.cache] {in-range,in-total}" << LogDiv()
+            << caughtInRange << LogDiv() 
+            << ir[leftInd].Size(0)*ir[leftInd].Size(1)*albRes*orientRes*dispRange);
   }
-  prog->Pop();
-  LogDebug("[OrientStereo.cache] {in-range,in-total}" << LogDiv()
-           << caughtInRange << LogDiv() 
-           << ir[leftInd].Size(0)*ir[leftInd].Size(1)*albRes*orientRes*dispRange);
 
   nat32 handAlbOrient = fg.NewFP(albOrient);
   delete[] angToDir;
+  delete[] dispToLoc;
   delete[] dsi;
 
 
@@ -17,6 +17,8 @@
 
 #include "eos/stereo/plane_seg.h"
 
+#include "eos/mt/tasks.h"
+
 namespace eos
 {
  namespace stereo
@@ -44,107 +46,123 @@ void PlaneSeg::SetSegs(nat32 segCount,const svt::Field<nat32> & s)
  segs = s;
 }
 
-void PlaneSeg::MakePlanes()
+class PlaneSeg::Fit
 {
- // Create and initialise data...
-  ds::Array<SedInt> sedInt(sed.Size());
-  for (nat32 i=0;i<sed.Size();i++)
-  {
-   sed[i].x = 0.0;
-   sed[i].y = 0.0;
-   sed[i].pix = 0;
-   sed[i].area = 0;
-   sedInt[i].planeFit.Reset();
-   sedInt[i].done = false;
-  }
+ public:
+  Fit(PlaneSeg & s)
+  :self(s),start(s.start),pixel(s.pixel)
+  {}
 
- // Iterate and improve the current fit for all data...
-  bit firstPass = true;
-  while (true)
+  void operator () (nat32 begin,nat32 end)
   {
-   // Iterate all valid pixels and store the values...
-    for (nat32 y=0;y<disp.Size(1);y++)
-    {
-     for (nat32 x=0;x<disp.Size(0);x++)
+   for (nat32 s=begin;s<end;s++)
+   {
+    Sed & targ = self.sed[s];
+    const Pixel * pix = pixel.Ptr() + start[s];
+    nat32 count = start[s+1] - start[s];
+
+    // First pass, every valid pixel...
+     alg::PlaneFit planeFit;
+     for (nat32 i=0;i<count;i++)
      {
-      if (valid.Get(x,y))
-      {
-       nat32 s = segs.Get(x,y);       
-       if (firstPass)
-       {
-        sed[s].x += x;
-        sed[s].y += y;
-        sed[s].pix += 1;
-        sed[s].area += 1;
-        sedInt[s].planeFit.Add(x,y,disp.Get(x,y));
-       }
-       else
-       {
-        if (!sedInt[s].done)
-        {
-         real32 d = disp.Get(x,y);
-         if (math::Abs(d-sed[s].plane.Z(x,y))<=outlier)
-         {
-          sedInt[s].planeFit.Add(x,y,d);
-         }
-        }
-       }       
-      }
-      else if (firstPass)
-      {
-       sed[segs.Get(x,y)].area += 1;       
-      }
+      targ.x += pix[i].x;
+      targ.y += pix[i].y;
+      planeFit.Add(pix[i].x,pix[i].y,pix[i].d);
      }
-    }
+     targ.fit = planeFit;
 
-   // Iterate the segments and integrate the data collected, reset for 
-   // next iteration and break if no more work is required...
-    bit timeToDie = !firstPass;
-    for (nat32 s=0;s<sed.Size();s++)
-    {
-     if (firstPass)
+     if (!planeFit.Valid())
      {
-      if (sedInt[s].planeFit.Valid())
-      {
-       sed[s].x /= sed[s].pix;
-       sed[s].y /= sed[s].pix;
-       sedInt[s].planeFit.Get(sed[s].plane);
-      }
-      else
-      {
-       sed[s].plane.a = 0.0;
-       sed[s].plane.b = 0.0;
-       sed[s].plane.c = 0.0;
-       sedInt[s].done = true;
-      }
+      targ.plane.a = 0.0;
+      targ.plane.b = 0.0;
+      targ.plane.c = 0.0;
+      continue;
      }
-     else
+
+     targ.x /= targ.pix;
+     targ.y /= targ.pix;
+     planeFit.Get(targ.plane);
+
+    // Further passes, adding in the inliers, until convergence. Note that the
+    // first passes data is not reset before the second pass...
+     for (nat32 iter=0;iter<maxIters;iter++)
      {
-      if (sedInt[s].done==false)
+      for (nat32 i=0;i<count;i++)
       {
-       if (sedInt[s].planeFit.Valid())
+       if (math::Abs(pix[i].d-targ.plane.Z(pix[i].x,pix[i].y))<=outlier)
        {
-        bs::PlaneABC np;
-        sedInt[s].planeFit.Get(np);
-        real32 diff = math::Sqr(np.a-sed[s].plane.a) + math::Sqr(np.b-sed[s].plane.b) + math::Sqr(np.c-sed[s].plane.c);
-        sed[s].plane = np;
-        if (diff<=convergence) sedInt[s].done = true;
-        else
-        {
-         timeToDie = false;
-         sedInt[s].planeFit.Reset();
-        }
+        planeFit.Add(pix[i].x,pix[i].y,pix[i].d);
        }
-       else sedInt[s].done = true;
       }
+
+      if (!planeFit.Valid()) break;
+      bs::PlaneABC np;
+      planeFit.Get(np);
+      real32 diff = math::Sqr(np.a-targ.plane.a) + math::Sqr(np.b-targ.plane.b) + math::Sqr(np.c-targ.plane.c);
+      targ.plane = np;
+      if (diff<=convergence) break;
+      planeFit.Reset();
      }
+   }
+  }
+
+
+ private:
+  PlaneSeg & self;
+  const ds::Array<nat32> & start;
+  ds::Array<Pixel> & pixel;
+};
+
+void PlaneSeg::MakePlanes()
+{
+ // Initialise and count the pixels of each segment...
+  for (nat32 i=0;i<sed.Size();i++)
+  {
+   sed[i].x = 0.0;
+   sed[i].y = 0.0;
+   sed[i].pix = 0;
+   sed[i].area = 0;
+  }
+
+  for (nat32 y=0;y<disp.Size(1);y++)
+  {
+   for (nat32 x=0;x<disp.Size(0);x++)
+   {
+    nat32 s = segs.Get(x,y);
+    sed[s].area += 1;
+    if (valid.Get(x,y)) sed[s].pix += 1;
+   }
+  }
+
+ // Sort the valid pixels by segment, keeping them in raster order within each
+ // segment so the sums come out as they would from scanning the image...
+  start.Size(sed.Size()+1);
+  start[0] = 0;
+  for (nat32 i=0;i<sed.Size();i++) start[i+1] = start[i] + sed[i].pix;
+
+  ds::Array<nat32> pos(sed.Size());
+  for (nat32 i=0;i<sed.Size();i++) pos[i] = start[i];
+
+  pixel.Size(start[sed.Size()]);
+  for (nat32 y=0;y<disp.Size(1);y++)
+  {
+   for (nat32 x=0;x<disp.Size(0);x++)
+   {
+    if (valid.Get(x,y))
+    {
+     Pixel & targ = pixel[pos[segs.Get(x,y)]++];
+     targ.x = x;
+     targ.y = y;
+     targ.d = disp.Get(x,y);
     }
-    if (timeToDie) break;
-    firstPass = false;
+   }
   }
-  
- // We now have a problem - various segments will have not had planes fitted, simply because
- // they lacked enough information.
+
+ // Fit each segment, they are independent so can be done in parallel. (Various
+ // segments will not have had planes fitted, simply because they lacked enough
+ // information.)...
+  Fit fit(*this);
+  mt::ParallelFor(nat32(0),sed.Size(),fit,16);
 }
 
 void PlaneSeg::Extract(svt::Field<real32> & d)
@@ -184,10 +202,12 @@ void PlaneSeg::PrepLayerSeg(class LayerSeg & out)
  out.SetDisparity(disp);
  out.SetValidity(valid);
  out.SetSegs(sed.Size(),segs);
+ if (start.Size()==sed.Size()+1) out.Share(*this);
 }
 
 //------------------------------------------------------------------------------
 LayerSeg::LayerSeg()
+:pixel(null<const PlaneSeg::Pixel*>()),start(null<const nat32*>()),shared(null<const PlaneSeg::Sed*>()),gathered(false)
 {}
 
 LayerSeg::~LayerSeg()
@@ -196,11 +216,13 @@ LayerSeg::~LayerSeg()
 void LayerSeg::SetDisparity(svt::Field<real32> & d)
 {
  disp = d;
+ gathered = false;
 }
 
 void LayerSeg::SetValidity(svt::Field<bit> & v)
 {
  valid = v;
+ gathered = false;
 }
 
 void LayerSeg::SetSegs(nat32 segCount, svt::Field<nat32> & s)
@@ -208,33 +230,31 @@ void LayerSeg::SetSegs(nat32 segCount, svt::Field<nat32> & s)
  gas.Size(segCount);
  for (nat32 i=0;i<gas.Size();i++) gas[i] = false;
  segs = s;
+ gathered = false;
+ total.Reset();
 }
 
 void LayerSeg::AddSegment(nat32 seg)
 {
+ if (gas[seg]) return;
+ Gather();
  gas[seg] = true;
+ total += SegFit(seg);
 }
 
 void LayerSeg::RemSegment(nat32 seg)
 {
+ if (!gas[seg]) return;
  gas[seg] = false;
+ total -= SegFit(seg);
 }
 
 void LayerSeg::Run()
 {
- // Do a first pass to fit the initial plane...
-  alg::PlaneFit planeFit;
-  for (nat32 y=0;y<disp.Size(1);y++)
-  {
-   for (nat32 x=0;x<disp.Size(0);x++)
-   {
-    nat32 s = segs.Get(x,y);
-    if (gas[s]&&valid.Get(x,y))
-    {
-     planeFit.Add(x,y,disp.Get(x,y));
-    }
-   }
-  }
+ Gather();
+
+ // The first pass, fitting to every pixel, is simply the kept moments...
+  alg::PlaneFit planeFit = total;
   if (planeFit.Valid()) planeFit.Get(plane);
   else
   {
@@ -246,20 +266,17 @@ void LayerSeg::Run()
 
 
  // Do further passes to refine it, losing outliers...
-  while (true)
+  for (nat32 iter=0;iter<maxIters;iter++)
   {
    // Fit again, excluding outliers...
     planeFit.Reset();
-    for (nat32 y=0;y<disp.Size(1);y++)
+    for (nat32 s=0;s<gas.Size();s++)
     {
-     for (nat32 x=0;x<disp.Size(0);x++)
+     if (!gas[s]) continue;
+     for (nat32 i=start[s];i<start[s+1];i++)
      {
-      nat32 s = segs.Get(x,y);
-      if (gas[s]&&valid.Get(x,y))
-      {
-       real32 d = disp.Get(x,y);
-       if (math::Abs(d-plane.Z(x,y))<=outlier) planeFit.Add(x,y,d);
-      }
+      const PlaneSeg::Pixel & pix = pixel[i];
+      if (math::Abs(pix.d-plane.Z(pix.x,pix.y))<=outlier) planeFit.Add(pix.x,pix.y,pix.d);
      }
     }
 
@@ -278,6 +295,69 @@ void LayerSeg::Result(bs::PlaneABC & p)
  p = plane;
 }
 
+void LayerSeg::Gather()
+{
+ if (gathered) return;
+ gathered = true;
+ shared = null<const PlaneSeg::Sed*>();
+
+ // Count the valid pixels of each segment, then scatter them into place in a
+ // second sweep, in raster order within each segment...
+  ownStart.Size(gas.Size()+1);
+  for (nat32 i=0;i<ownStart.Size();i++) ownStart[i] = 0;
+  for (nat32 y=0;y<disp.Size(1);y++)
+  {
+   for (nat32 x=0;x<disp.Size(0);x++)
+   {
+    if (valid.Get(x,y)) ownStart[segs.Get(x,y)+1] += 1;
+   }
+  }
+  for (nat32 i=0;i<gas.Size();i++) ownStart[i+1] += ownStart[i];
+
+  ds::Array<nat32> pos(gas.Size());
+  for (nat32 i=0;i<gas.Size();i++) pos[i] = ownStart[i];
+
+  ownPixel.Size(ownStart[gas.Size()]);
+  segFit.Size(gas.Size());
+  for (nat32 i=0;i<segFit.Size();i++) segFit[i].Reset();
+  for (nat32 y=0;y<disp.Size(1);y++)
+  {
+   for (nat32 x=0;x<disp.Size(0);x++)
+   {
+    if (valid.Get(x,y))
+    {
+     nat32 s = segs.Get(x,y);
+     PlaneSeg::Pixel & targ = ownPixel[pos[s]++];
+     targ.x = x;
+     targ.y = y;
+     targ.d = disp.Get(x,y);
+     segFit[s].Add(x,y,targ.d);
+    }
+   }
+  }
+
+ pixel = ownPixel.Ptr();
+ start = ownStart.Ptr();
+
+ // Any segments allready included need their moments...
+  total.Reset();
+  for (nat32 i=0;i<gas.Size();i++) if (gas[i]) total += segFit[i];
+}
+
+void LayerSeg::Share(const PlaneSeg & source)
+{
+ gathered = true;
+ pixel = source.pixel.Ptr();
+ start = source.start.Ptr();
+ shared = source.sed.Ptr();
+ segFit.Size(0);
+ ownPixel.Size(0);
+ ownStart.Size(0);
+
+ total.Reset();
+ for (nat32 i=0;i<gas.Size();i++) if (gas[i]) total += shared[i].fit;
+}
+
 //------------------------------------------------------------------------------
  };
 };
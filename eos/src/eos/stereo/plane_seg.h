@@ -68,7 +68,8 @@ class EOS_CLASS PlaneSeg
   /// is fitted with outlier detection capability, so noise can be handled quite
   /// well. The details of how this is done are in the paper 'A layered stereo
   /// matching algorithm using image segmentation and global visibility constraints'
-  /// by Michael Bleyer & Margrit Gelautz.
+  /// by Michael Bleyer & Margrit Gelautz. The segments are independent, so are
+  /// fitted in parallel.
    void MakePlanes();
    
   /// Extracts a disparity map based on the planes assigned to each segment.
@@ -92,7 +93,9 @@ class EOS_CLASS PlaneSeg
    void GetArea(nat32 seg,nat32 & out);
 
   /// Given a LayerSeg this fills in the layerSeg from this, so its 
-  /// working with the same data set.
+  /// working with the same data set. If MakePlanes has been called the
+  /// LayerSeg also shares the pixels gathered by segment and their moments,
+  /// rather than collecting its own, so this object must then outlive it.
    void PrepLayerSeg(class LayerSeg & out);
 
 
@@ -104,6 +107,7 @@ class EOS_CLASS PlaneSeg
   // Constant parameters...
    static const real32 outlier = 1.0;
    static const real32 convergence = 10e-6;
+   static const nat32 maxIters = 100; // The inlier set can oscillate, so convergence is not guaranteed.
 
   // Inputs...
    svt::Field<real32> disp;
@@ -117,16 +121,22 @@ class EOS_CLASS PlaneSeg
     real32 x,y; // Center of segment.
     nat32 pix; // Number of valid pixels in segment.
     nat32 area; // Number of pixels in segment, regardless of validity.
+    alg::PlaneFit fit; // Moments of all its valid pixels, for LayerSeg.
    };
    ds::Array<Sed> sed; // Size of this is number of segments.
 
  // Internal...
-  struct SedInt // Structure used during calculation in conjunction with above.
+  struct Pixel // A valid pixel, these are sorted by segment so each segment can be fitted on its own.
   {
-   public:
-    alg::PlaneFit planeFit;
-    bit done; // true once we are satisfied with the quality of the fit.
+   nat32 x,y;
+   real32 d;
   };
+
+  ds::Array<Pixel> pixel; // Valid pixels sorted by segment, kept for LayerSeg.
+  ds::Array<nat32> start; // Index into pixel of the first of each segment, plus one past the end.
+
+  class Fit; // Does the fitting for a range of segments, so they can be done in parallel.
+  friend class LayerSeg;
 };
 
 //------------------------------------------------------------------------------
@@ -134,7 +144,9 @@ class EOS_CLASS PlaneSeg
 /// segments, plus the same data as LayerSeg, and then fits a plane to those 
 /// segments, with the same outlier managment techneque. Essentially 'just'
 /// a simpler version, but very useful for certain classes of algorithm when
-/// used in conjunction with PlaneSeg.
+/// used in conjunction with PlaneSeg. The valid pixels are gathered by segment
+/// once, and the moments of the included segments are kept as they are added
+/// and removed, so each Run only visits the pixels of the included segments.
 class EOS_CLASS LayerSeg
 {
  public:
@@ -182,6 +194,7 @@ class EOS_CLASS LayerSeg
   // Constant parameters...
    static const real32 outlier = 1.0;
    static const real32 convergence = 10e-6;
+   static const nat32 maxIters = 100; // The inlier set can oscillate, so convergence is not guaranteed.
 
   // Inputs...
    svt::Field<real32> disp;
@@ -190,6 +203,24 @@ class EOS_CLASS LayerSeg
 
    ds::Array<bit> gas; // A flag for each segment, indicating if it gives a shit or not.
 
+  // The valid pixels by segment, with per segment moments - either borrowed
+  // from a PlaneSeg or gathered here on first use...
+   const PlaneSeg::Pixel * pixel;
+   const nat32 * start;
+   const PlaneSeg::Sed * shared; // If not null the moments are in here.
+   ds::Array<alg::PlaneFit> segFit; // Otherwise they are in here.
+
+   bit gathered;
+   ds::Array<PlaneSeg::Pixel> ownPixel;
+   ds::Array<nat32> ownStart;
+
+   alg::PlaneFit total; // Moments of every valid pixel of the included segments.
+
+   void Gather(); // Builds the pixel store if its not ready yet.
+   void Share(const PlaneSeg & source); // Makes it use the store of a PlaneSeg.
+   const alg::PlaneFit & SegFit(nat32 seg) const {return shared?shared[seg].fit:segFit[seg];}
+   friend class PlaneSeg;
+
   // Outputs...
    bs::PlaneABC plane; // The fitted plane.
 };
@@ -18,11 +18,238 @@
 #include "eos/stereo/refine_norm.h"
 
 #include "eos/inf/gauss_integration.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace stereo
  {
+//------------------------------------------------------------------------------
+class RefineNorm::SummaryRows
+{
+ public:
+  SummaryRows(RefineNorm & s,inf::IntegrateBP & i)
+  :self(s),ibp(i)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   const DSI & dsi = *self.dsi;
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<dsi.Width();x++)
+    {
+     if (dsi.Size(x,y)!=0)
+     {
+      // Find the minimum cost assigned to the pixel so we can zero it...
+       real32 minCost = dsi.Cost(x,y,0);
+       for (nat32 i=1;i<dsi.Size(x,y);i++) minCost = math::Min(minCost,dsi.Cost(x,y,i));
+
+      // Calculate mean...
+       real32 mean = 0.0;
+       real32 sum = 0.0;
+       for (nat32 i=0;i<dsi.Size(x,y);i++)
+       {
+        real32 weight = math::Exp(-self.costBase*(dsi.Cost(x,y,i)-minCost));
+        mean += dsi.Disp(x,y,i)*weight;
+        sum += weight;
+       }
+       mean /= sum;
+
+      // Calculate sd, have to consider that the disparities represent ranges,
+      // which kinda causes a mild headache...
+       real32 sd = 0.0;
+       for (nat32 i=0;i<dsi.Size(x,y);i++)
+       {
+        real32 dispSd = 0.5*(math::Abs(dsi.Disp(x,y,i)+dsi.DispWidth(x,y,i) - mean) +
+                             math::Abs(dsi.Disp(x,y,i)-dsi.DispWidth(x,y,i) - mean));
+        real32 weight = math::Exp(-self.costBase*(dsi.Cost(x,y,i)-minCost));
+        sd += dispSd*weight;
+       }
+       sd /= sum;
+
+      // Store the relevant output...
+       ibp.SetVal(x,y,mean,1.0/sd);
+       self.disp.Get(x,y) = mean;
+     }
+     else
+     {
+      ibp.SetVal(x,y,0.0,0.0);
+      self.disp.Get(x,y) = math::Infinity<real32>(); // Used to indicate its unknown - such pixels revert to basic smoothing.
+     }
+    }
+   }
+  }
+
+ private:
+  RefineNorm & self;
+  inf::IntegrateBP & ibp;
+};
+
+//------------------------------------------------------------------------------
+// Each row writes its own entries plus invSd[3] of the row below, which no
+// other row touches, so rows may be done in parallel...
+class RefineNorm::InvSdRows
+{
+ public:
+  InvSdRows(const RefineNorm & s,ds::Array2D<PreCalc> & pc)
+  :self(s),preCalc(pc)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   const DSC * dsc = self.dsc;
+   real32 coMult = 1.0/self.normVar;
+   byte * tempA = mem::Malloc<byte>(dsc?dsc->Bytes():0);
+   byte * tempB = mem::Malloc<byte>(dsc?dsc->Bytes():0);
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<preCalc.Width();x++)
+    {
+     // X direction...
+      if (preCalc.Get(x,y).pass[0])
+      {
+       real32 val = coMult;
+        if (dsc)
+        {
+         dsc->Left(x,y,tempA);
+         dsc->Left(x+1,y,tempB);
+         val *= math::SigmoidCutoff(dsc->Cost(tempA,tempB),self.dsc_threshold,self.dsc_width);
+        }
+       preCalc.Get(x,y).invSd[0] = val;
+       preCalc.Get(x+1,y).invSd[2] = val;
+      }
+
+     // Y direction...
+      if (preCalc.Get(x,y).pass[1])
+      {
+       real32 val = coMult;
+        if (dsc)
+        {
+         dsc->Left(x,y,tempA);
+         dsc->Left(x,y+1,tempB);
+         val *= math::SigmoidCutoff(dsc->Cost(tempA,tempB),self.dsc_threshold,self.dsc_width);
+        }
+       preCalc.Get(x,y).invSd[1] = val;
+       preCalc.Get(x,y+1).invSd[3] = val;
+      }
+    }
+   }
+   mem::Free(tempA);
+   mem::Free(tempB);
+  }
+
+ private:
+  const RefineNorm & self;
+  ds::Array2D<PreCalc> & preCalc;
+};
+
+//------------------------------------------------------------------------------
+class RefineNorm::RelRows
+{
+ public:
+  RelRows(RefineNorm & s,const ds::Array2D<PreCalc> & pc,inf::IntegrateBP & i,
+          const math::Vect<4,real64> & lc,const math::Mat<4,3,real64> & ilp,
+          const math::Mat<3,3,real64> & rl,const math::Mat<3,3,real64> & rr)
+  :self(s),preCalc(pc),ibp(i),leftCent(lc),inverseLP(ilp),rectLeft(rl),rectRight(rr)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   const cam::CameraPair & pair = self.pair;
+   ds::Array2D<real32> & disp = self.disp;
+   const svt::Field<bs::Normal> & needle = self.needle;
+   real32 maxD = self.maxD;
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<disp.Width();x++)
+    {
+     if (math::IsFinite(disp.Get(x,y)))
+     {
+      // Triangulate the current point, then re-project it back and update the
+      // disparity. This is needed as there can be quite a lot of numerical
+      // error, and the below code is very sensitive...
+       math::Vect<4,real64> pos;
+       pair.Triangulate(x,y,disp.Get(x,y),pos);
+       pos /= pos[3];
+       real32 oX,oY;
+       pair.Project(pos,oX,oY,disp.Get(x,y),&rectLeft,&rectRight);
+
+      // Create a plane going through the current point with the normal of the needle map...
+       bs::Plane plane;
+       plane.n = needle.Get(x,y);
+       plane.d = -(pos[0]*plane.n[0] + pos[1]*plane.n[1] + pos[2]*plane.n[2]);
+
+      // Iterate the neighbours...
+       for (nat32 i=0;i<4;i++)
+       {
+        if (preCalc.Get(x,y).pass[i])
+        {
+         // Calculate the neighbours coordinates...
+          int32 nx = int32(x);
+          int32 ny = int32(y);
+          switch (i)
+          {
+           case 0: nx += 1; break;
+           case 1: ny += 1; break;
+           case 2: nx -= 1; break;
+           case 3: ny -= 1; break;
+          }
+
+         // Calculate a point on the neighbours line other than the centre...
+          math::Vect<4,real64> nPos;
+          {
+           math::Vect<3,real64> loc;
+           loc[0] = nx;
+           loc[1] = ny;
+           loc[2] = 1.0;
+
+           math::MultVect(inverseLP,loc,nPos);
+          }
+
+         // Intercept the plane with the neighbours line...
+          math::Vect<4,real64> inter;
+          plane.LineIntercept(leftCent,nPos,inter);
+
+         // Project the point of intersection back to the left image, take the
+         // difference in x to get the disparity difference we desire...
+          real32 prX,prY,prD;
+          pair.Project(inter,prX,prY,prD,&rectLeft,&rectRight);
+          real32 mean = prD - disp.Get(x,y);
+
+          if (!math::IsFinite(mean)) ibp.SetRel(x,y,i,1.0,0.0,0.0);
+          else
+          {
+           mean = math::Clamp(mean,-maxD,maxD);
+           ibp.SetRel(x,y,i,1.0,mean,preCalc.Get(x,y).invSd[i]);
+          }
+        }
+        else
+        {
+         ibp.SetRel(x,y,i,1.0,0.0,0.0);
+        }
+       }
+     }
+     else
+     {
+      // We don't know the disparity, we therefore can't work out the details -
+      // simply set the changes to zero as a basic smoothing operation...
+       for (nat32 i=0;i<4;i++) ibp.SetRel(x,y,i,1.0,0.0,preCalc.Get(x,y).invSd[i]);
+     }
+    }
+   }
+  }
+
+ private:
+  RefineNorm & self;
+  const ds::Array2D<PreCalc> & preCalc;
+  inf::IntegrateBP & ibp;
+  const math::Vect<4,real64> & leftCent;
+  const math::Mat<4,3,real64> & inverseLP;
+  const math::Mat<3,3,real64> & rectLeft;
+  const math::Mat<3,3,real64> & rectRight;
+};
+
 //------------------------------------------------------------------------------
 RefineNorm::RefineNorm()
 :iters(100),dsiSd(1.0),costBase(1.0),normVar(0.1),maxD(5.0),
@@ -85,53 +312,10 @@ void RefineNorm::Run(time::Progress * prog)
  // representing the probability of each disparity without consideration of
  // the needle map. A sumary of the DSI if you will...
   prog->Report(1,7);
-  prog->Push();
-  for (nat32 y=0;y<dsi->Height();y++)
   {
-   prog->Report(y,dsi->Height());
-   for (nat32 x=0;x<dsi->Width();x++)
-   {
-    if (dsi->Size(x,y)!=0)
-    {
-     // Find the minimum cost assigned to the pixel so we can zero it...
-      real32 minCost = dsi->Cost(x,y,0);
-      for (nat32 i=1;i<dsi->Size(x,y);i++) minCost = math::Min(minCost,dsi->Cost(x,y,i));
-
-     // Calculate mean...
-      real32 mean = 0.0;
-      real32 sum = 0.0;
-      for (nat32 i=0;i<dsi->Size(x,y);i++)
-      {
-       real32 weight = math::Exp(-costBase*(dsi->Cost(x,y,i)-minCost));
-       mean += dsi->Disp(x,y,i)*weight;
-       sum += weight;
-      }
-      mean /= sum;
-
-     // Calculate sd, have to consider that the disparities represent ranges,
-     // which kinda causes a mild headache...
-      real32 sd = 0.0;
-      for (nat32 i=0;i<dsi->Size(x,y);i++)
-      {
-       real32 dispSd = 0.5*(math::Abs(dsi->Disp(x,y,i)+dsi->DispWidth(x,y,i) - mean) +
-                            math::Abs(dsi->Disp(x,y,i)-dsi->DispWidth(x,y,i) - mean));
-       real32 weight = math::Exp(-costBase*(dsi->Cost(x,y,i)-minCost));
-       sd += dispSd*weight;
-      }
-      sd /= sum;
-
-     // Store the relevant output...
-      ibp.SetVal(x,y,mean,1.0/sd);
-      disp.Get(x,y) = mean;
-    }
-    else
-    {
-     ibp.SetVal(x,y,0.0,0.0);
-     disp.Get(x,y) = math::Infinity<real32>(); // Used to indicate its unknown - such pixels revert to basic smoothing.
-    }
-   }
+   SummaryRows summaryRows(*this,ibp);
+   mt::ParallelFor(nat32(0),dsi->Height(),summaryRows);
   }
-  prog->Pop();
 
 
 
@@ -216,136 +400,20 @@ void RefineNorm::Run(time::Progress * prog)
  // Iterate and fill in the invSd parameter to indicate the standard deviation
  // used for the difference when calculating each message...
  prog->Report(3,7);
- prog->Push();
  {
-  real32 coMult = 1.0/normVar;
-  byte * tempA = mem::Malloc<byte>(dsc?dsc->Bytes():0);
-  byte * tempB = mem::Malloc<byte>(dsc?dsc->Bytes():0);
-  for (nat32 y=0;y<preCalc.Height();y++)
-  {
-   prog->Report(y,preCalc.Height());
-   for (nat32 x=0;x<preCalc.Width();x++)
-   {
-    // X direction...
-     if (preCalc.Get(x,y).pass[0])
-     {
-      real32 val = coMult;
-       if (dsc)
-       {
-        dsc->Left(x,y,tempA);
-        dsc->Left(x+1,y,tempB);
-        val *= math::SigmoidCutoff(dsc->Cost(tempA,tempB),dsc_threshold,dsc_width);
-       }
-      preCalc.Get(x,y).invSd[0] = val;
-      preCalc.Get(x+1,y).invSd[2] = val;
-     }
-
-    // Y direction...
-     if (preCalc.Get(x,y).pass[1])
-     {
-      real32 val = coMult;
-       if (dsc)
-       {
-        dsc->Left(x,y,tempA);
-        dsc->Left(x,y+1,tempB);
-        val *= math::SigmoidCutoff(dsc->Cost(tempA,tempB),dsc_threshold,dsc_width);
-       }
-      preCalc.Get(x,y).invSd[1] = val;
-      preCalc.Get(x,y+1).invSd[3] = val;
-     }
-   }
-  }
-  mem::Free(tempA);
-  mem::Free(tempB);
+  InvSdRows invSdRows(*this,preCalc);
+  mt::ParallelFor(nat32(0),preCalc.Height(),invSdRows);
  }
- prog->Pop();
 
 
 
  // Fill in the differences between disparities, and there confidence,
  // using the needle map and the initialisation disparities...
   prog->Report(4,7);
-  prog->Push();
-  for (nat32 y=0;y<dsi->Height();y++)
   {
-   prog->Report(y,dsi->Height());
-   for (nat32 x=0;x<dsi->Width();x++)
-   {
-    if (math::IsFinite(disp.Get(x,y)))
-    {
-     // Triangulate the current point, then re-project it back and update the
-     // disparity. This is needed as there can be quite a lot of numerical
-     // error, and the below code is very sensitive...
-      math::Vect<4,real64> pos;
-      pair.Triangulate(x,y,disp.Get(x,y),pos);
-      pos /= pos[3];
-      real32 oX,oY;
-      pair.Project(pos,oX,oY,disp.Get(x,y),&rectLeft,&rectRight);
-
-     // Create a plane going through the current point with the normal of the needle map...
-      bs::Plane plane;
-      plane.n = needle.Get(x,y);
-      plane.d = -(pos[0]*plane.n[0] + pos[1]*plane.n[1] + pos[2]*plane.n[2]);
-
-     // Iterate the neighbours...
-      for (nat32 i=0;i<4;i++)
-      {
-       if (preCalc.Get(x,y).pass[i])
-       {
-        // Calculate the neighbours coordinates...
-         int32 nx = int32(x);
-         int32 ny = int32(y);
-         switch (i)
-         {
-          case 0: nx += 1; break;
-          case 1: ny += 1; break;
-          case 2: nx -= 1; break;
-          case 3: ny -= 1; break;
-         }
-
-        // Calculate a point on the neighbours line other than the centre...
-         math::Vect<4,real64> nPos;
-         {
-          math::Vect<3,real64> loc;
-          loc[0] = nx;
-          loc[1] = ny;
-          loc[2] = 1.0;
-
-          math::MultVect(inverseLP,loc,nPos);
-         }
-
-        // Intercept the plane with the neighbours line...
-         math::Vect<4,real64> inter;
-         plane.LineIntercept(leftCent,nPos,inter);
-
-        // Project the point of intersection back to the left image, take the
-        // difference in x to get the disparity difference we desire...
-         real32 prX,prY,prD;
-         pair.Project(inter,prX,prY,prD,&rectLeft,&rectRight);
-         real32 mean = prD - disp.Get(x,y);
-
-         if (!math::IsFinite(mean)) ibp.SetRel(x,y,i,1.0,0.0,0.0);
-         else
-         {
-          mean = math::Clamp(mean,-maxD,maxD);
-          ibp.SetRel(x,y,i,1.0,mean,preCalc.Get(x,y).invSd[i]);
-         }
-       }
-       else
-       {
-        ibp.SetRel(x,y,i,1.0,0.0,0.0);
-       }
-      }
-    }
-    else
-    {
-     // We don't know the disparity, we therefore can't work out the details -
-     // simply set the changes to zero as a basic smoothing operation...
-      for (nat32 i=0;i<4;i++) ibp.SetRel(x,y,i,1.0,0.0,preCalc.Get(x,y).invSd[i]);
-    }
-   }
+   RelRows relRows(*this,preCalc,ibp,leftCent,inverseLP,rectLeft,rectRight);
+   mt::ParallelFor(nat32(0),dsi->Height(),relRows);
   }
-  prog->Pop();
 
 
 
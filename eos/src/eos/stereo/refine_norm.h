@@ -127,6 +127,13 @@ class EOS_CLASS RefineNorm
     bit pass[4]; // true if a message is passed, false if not.
     real32 invSd[4]; // For each direction, calculated seperatly hence requirement to cache.
    };
+
+  // Functors for doing the per-pixel passes in parallel by rows - summarising
+  // the dsi, calculating the difference confidences and setting the relative
+  // distributions...
+   class SummaryRows;
+   class InvSdRows;
+   class RelRows;
 };
 
 //------------------------------------------------------------------------------
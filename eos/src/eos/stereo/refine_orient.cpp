@@ -20,11 +20,110 @@
 #include "eos/filter/kernel.h"
 #include "eos/alg/fitting.h"
 #include "eos/math/gaussian_mix.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace stereo
  {
+//------------------------------------------------------------------------------
+// Runs the plane fitters for a range of segments...
+class RefineOrientFitSegs
+{
+ public:
+  RefineOrientFitSegs(ds::ArrayDel<alg::LinePlaneFit> & pf)
+  :planeFit(pf)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   for (nat32 i=begin;i<end;i++) planeFit[i].Run();
+  }
+
+ private:
+  ds::ArrayDel<alg::LinePlaneFit> & planeFit;
+};
+
+//------------------------------------------------------------------------------
+class RefineOrient::WeightRows
+{
+ public:
+  WeightRows(const RefineOrient & s,const math::Mat<3,4> & pr,const ds::Array2D<bs::Vertex> & i,
+             ds::Array2D<int32> & pd,ds::Array2D<real32> & w)
+  :self(s),projRight(pr),in(i),prevDisp(pd),weight(w)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<in.Width();x++)
+    {
+     if ((self.duds==false)||(self.seg.Get(x,y)!=0))
+     {
+      // Project to the right image to discover the disparity...
+       math::Vect<3> pp;
+       math::MultVect(projRight,in.Get(x,y),pp);
+       pp /= pp[2];
+       int32 disp = int32(math::Round(pp[0]-real32(x)));
+       
+      // If the disparity doesn't match the cached disparity we need to
+      // re-calculate the weight...
+       if (prevDisp.Get(x,y)!=disp)
+       {
+        prevDisp.Get(x,y) = disp;
+        
+        real32 best = math::Infinity<real32>();
+        for (nat32 j=0;j<self.dsi->Size(x,y);j++)
+        {
+         real32 cost = self.dsi->Cost(x,y,j) + self.stepCost*math::Abs(self.dsi->Disp(x,y,j)-real32(disp));
+         best = math::Min(best,cost);
+        }
+        weight.Get(x,y) = math::Exp(-best);
+       }
+     }
+    }
+   }
+  }
+
+ private:
+  const RefineOrient & self;
+  const math::Mat<3,4> & projRight;
+  const ds::Array2D<bs::Vertex> & in;
+  ds::Array2D<int32> & prevDisp;
+  ds::Array2D<real32> & weight;
+};
+
+//------------------------------------------------------------------------------
+class RefineOrient::PosRows
+{
+ public:
+  PosRows(const RefineOrient & s,const ds::Array2D<bs::Vertex> & i,const ds::Array2D<bs::Normal> & n,
+          const math::Vect<4> & c,const ds::Array2D<real32> & w,ds::Array2D<bs::Vertex> & o)
+  :self(s),in(i),norm(n),centre(c),weight(w),out(o)
+  {}
+
+  void operator () (nat32 begin,nat32 end) const
+  {
+   for (nat32 y=begin;y<end;y++)
+   {
+    for (nat32 x=0;x<out.Width();x++)
+    {
+     if (self.duds&&(self.seg.Get(x,y)==0)) out.Get(x,y) = in.Get(x,y);
+                                       else self.CalcPos(x,y,in,norm,centre,weight,out.Get(x,y));
+    }
+   }
+  }
+
+ private:
+  const RefineOrient & self;
+  const ds::Array2D<bs::Vertex> & in;
+  const ds::Array2D<bs::Normal> & norm;
+  const math::Vect<4> & centre;
+  const ds::Array2D<real32> & weight;
+  ds::Array2D<bs::Vertex> & out;
+};
+
 //------------------------------------------------------------------------------
 RefineOrient::RefineOrient()
 :radius(2),damping(1.0),stepCost(0.5),iters(100),duds(false)
@@ -86,7 +185,11 @@ void RefineOrient::Run(time::Progress * prog)
      real32 best = math::Infinity<real32>();
      for (nat32 i=0;i<spos->Size(x,y);i++)
      {
-      if (spos->Cost(x,y,i)<best) data.Get(x,y) = spos->Centre(x,y,i);
+      if (spos->Cost(x,y,i)<best)
+      {
+       best = spos->Cost(x,y,i);
+       data.Get(x,y) = spos->Centre(x,y,i);
+      }
      }
     }
    }
@@ -128,14 +231,11 @@ void RefineOrient::Run(time::Progress * prog)
       for (nat32 x=0;x<seg.Size(0);x++) planeFit[seg.Get(x,y)].Add(data.Get(x,y),data.Get(x,y),1.0);
      }
 
-    // Run the fitters...
-     prog->Push();
-      for (nat32 i=0;i<segCount;i++)
-      {
-       prog->Report(i,segCount);
-       planeFit[i].Run();
-      }
-     prog->Pop();
+    // Run the fitters, in parallel...
+    {
+     RefineOrientFitSegs fitSegs(planeFit);
+     mt::ParallelFor(nat32(0),segCount,fitSegs);
+    }
 
     // Assign the normals...
      for (nat32 y=0;y<seg.Size(1);y++)
@@ -211,47 +311,18 @@ void RefineOrient::Run(time::Progress * prog)
    // Iterate the entire image and calculate the weight assigned to each pixel, 
    // as we don't want to have to calcalate such a thing repeatedly in the 
    // below...
-    for (nat32 y=0;y<out->Height();y++)
+    prog->Report(0,2);
     {
-     prog->Report(y,out->Height()*2);
-     for (nat32 x=0;x<out->Width();x++)
-     {
-      if ((duds==false)||(seg.Get(x,y)!=0))
-      {
-       // Project to the right image to discover the disparity...
-        math::Vect<3> pp;
-        math::MultVect(projRight,in->Get(x,y),pp);
-        pp /= pp[2];
-        int32 disp = int32(math::Round(pp[0]-real32(x)));
-        
-       // If the disparity doesn't match the cached disparity we need to
-       // re-calculate the weight...
-        if (prevDisp.Get(x,y)!=disp)
-        {
-         prevDisp.Get(x,y) = disp;
-         
-         weight.Get(x,y) = math::Infinity<real32>();
-         for (nat32 j=0;j<dsi->Size(x,y);j++)
-         {
-          real32 cost = dsi->Cost(x,y,j) + stepCost*math::Abs(dsi->Disp(x,y,j)-real32(disp));
-          weight.Get(x,y) = math::Min(weight.Get(x,y),cost);
-         }
-         weight.Get(x,y) = math::Exp(-weight.Get(x,y));
-        }
-      }
-     }
+     WeightRows weightRows(*this,projRight,*in,prevDisp,weight);
+     mt::ParallelFor(nat32(0),out->Height(),weightRows);
     }
 
 
    // Iterate the entire image and for each pixel optimise its position...
-    for (nat32 y=0;y<out->Height();y++)
+    prog->Report(1,2);
     {
-     prog->Report(out->Height()+y,out->Height()*2);
-     for (nat32 x=0;x<out->Width();x++)
-     {
-      if (duds&&(seg.Get(x,y)==0)) out->Get(x,y) = in->Get(x,y);
-                              else CalcPos(x,y,*in,norm,leftCentre,weight,out->Get(x,y));
-     }
+     PosRows posRows(*this,*in,norm,leftCentre,weight,*out);
+     mt::ParallelFor(nat32(0),out->Height(),posRows);
     }
    prog->Pop();
   }
@@ -370,8 +441,6 @@ void RefineOrient::CalcPos(nat32 x,nat32 y,
                            const math::Vect<4> & centre,const ds::Array2D<real32> & weight,
                            bs::Vertex & out) const
 {
- LogTime("eos::stereo::RefineOrient::CalcPos");
- 
  // Calculate a direction vector from are starting position, this with pos will
  // define the axis which we are working along...
   math::Vect<3> linePos;
@@ -126,6 +126,12 @@ class EOS_CLASS RefineOrient
                 const ds::Array2D<bs::Vertex> & pos,const ds::Array2D<bs::Normal> & norm,
                 const math::Vect<4> & centre,const ds::Array2D<real32> & weight,
                 bs::Vertex & out) const;
+
+  // Functors for doing each iteration in parallel by rows - the first updates
+  // the weights, the second the positions, which only read the last
+  // iterations positions so rows are independent...
+   class WeightRows;
+   class PosRows;
 };
 
 //------------------------------------------------------------------------------
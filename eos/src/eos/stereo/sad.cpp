@@ -23,7 +23,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 Sad::Sad()
-:radius(1),minDisp(-30),maxDisp(30),maxDiff(1e2)
+:radius(1),minDisp(-30),maxDisp(30),maxDiff(1e2),outScale(1.0),pool(null<mt::TaskPool*>()),compute(false)
 {}
 
 Sad::~Sad()
@@ -61,12 +61,81 @@ void Sad::SetMaxDiff(real32 maxD)
 void Sad::SetOutput(svt::Field<real32> & o)
 {
  out = o;
+ outFix = svt::Field<nat16>();
+}
+
+void Sad::SetOutput(svt::Field<nat16> & o,real32 scale)
+{
+ out = svt::Field<real32>();
+ outFix = o;
+ outScale = scale;
+}
+
+void Sad::SetParallel(bit enable,mt::TaskPool & p)
+{
+ if (enable) pool = &p;
+        else pool = null<mt::TaskPool*>();
+}
+
+void Sad::SetCompute(bit enable)
+{
+ compute = enable;
 }
 
 void Sad::Run(time::Progress * prog)
 {
  prog->Push();
 
+ if (compute&&os::Compute::Default().Active())
+ {
+  os::ComputeBuffer vol;
+  Run(vol,prog);
+
+  if (outFix.Valid())
+  {
+   // Quantise a slice at a time, to avoid a second volume in main memory...
+    nat32 width = in[0].first.Size(0);
+    nat32 height = in[0].first.Size(1);
+    ds::Array<real32> slice(width*height);
+    for (nat32 d=0;d<Depth();d++)
+    {
+     vol.Read(slice.Ptr(),width*height,d*width*height);
+     for (nat32 y=0;y<height;y++)
+     {
+      for (nat32 x=0;x<width;x++) Write(x,y,d,slice[y*width + x]);
+     }
+    }
+  }
+  else vol.Download(out);
+
+  prog->Pop();
+  return;
+ }
+
+ if (pool)
+ {
+  Slices slices;
+  slices.self = this;
+  mt::ParallelFor(0,Depth(),slices,1,*pool);
+
+  prog->Pop();
+  return;
+ }
+
+ // The fixed point output can't hold the intermediate sums, so goes through
+ // the slice version, which keeps them in a buffer of its own...
+  if (outFix.Valid())
+  {
+   for (nat32 d=0;d<Depth();d++)
+   {
+    prog->Report(d,Depth());
+    RunSlices(d,d+1);
+   }
+
+   prog->Pop();
+   return;
+  }
+
  // Some variables...
   nat32 width = in[0].first.Size(0);
   nat32 height = in[0].first.Size(1);
@@ -145,6 +214,108 @@ void Sad::Run(time::Progress * prog)
  prog->Pop();
 }
 
+void Sad::Run(os::ComputeBuffer & vol,time::Progress * prog)
+{
+ prog->Push();
+
+ nat32 width = in[0].first.Size(0);
+ nat32 widthRight = in[0].second.Size(0);
+ nat32 height = in[0].first.Size(1);
+
+ prog->Report(0,2);
+ os::ComputeBuffer left(width*height*in.Size());
+ os::ComputeBuffer right(widthRight*height*in.Size());
+ for (nat32 i=0;i<in.Size();i++)
+ {
+  left.Upload(in[i].first,i*width*height);
+  right.Upload(in[i].second,i*widthRight*height);
+ }
+
+ prog->Report(1,2);
+ vol.Resize(width*height*Depth());
+ os::Compute::Default().SadVolume(left,right,in.Size(),width,widthRight,height,
+                                  minDisp,Depth(),radius,maxDiff,vol);
+
+ prog->Pop();
+}
+
+void Sad::RunSlices(nat32 d0,nat32 d1)
+{
+ nat32 width = in[0].first.Size(0);
+ nat32 height = in[0].first.Size(1);
+ bit fixed = outFix.Valid();
+
+ // Per-column running sums and a circular buffer of the last radius+1 rows
+ // of horizontal sums, replacing the per-column window of the serial version.
+ // The horizontal sums go into the output when its real, otherwise into a
+ // slice sized buffer...
+  const real32 maxSliceDiff = 0.0;
+  ds::Array<real64> colSum(width);
+  ds::Array<real32> window(width*(radius+1));
+  ds::Array<real32> slice(fixed?(width*height):0);
+
+ for (nat32 dd=d0;dd<d1;dd++)
+ {
+  int32 d = int32(dd) + minDisp;
+
+  // Horizontal pass, exactly as for the serial version...
+   for (nat32 y=0;y<height;y++)
+   {
+    real64 lastValue = 0.0;
+    for (int32 u=-radius;u<=int32(radius);u++)
+    {
+     lastValue += AD(0 + u,y,d);
+    }
+    Hor(slice,0,y,dd) = lastValue;
+
+    for (nat32 x=1;x<width;x++)
+    {
+     lastValue -= AD(x - radius - 1,y,d);
+     lastValue += AD(x + radius,y,d);
+     Hor(slice,x,y,dd) = lastValue;
+    }
+   }
+
+  // Vertical pass, done a row at a time for all columns. Each column sees the
+  // same operations in the same order as the serial version...
+   for (nat32 i=0;i<radius;i++)
+   {
+    real32 * win = &window[i*width];
+    for (nat32 x=0;x<width;x++) win[x] = maxSliceDiff;
+   }
+
+   {
+    real32 * win = &window[radius*width];
+    nat32 top = math::Min(radius,height-1);
+    for (nat32 x=0;x<width;x++)
+    {
+     win[x] = Hor(slice,x,0,dd);
+
+     real64 lastValue = maxSliceDiff*radius;
+     for (nat32 i=0;i<=top;i++) lastValue += Hor(slice,x,i,dd);
+     colSum[x] = lastValue;
+     Write(x,0,dd,lastValue);
+    }
+   }
+
+   for (nat32 y=1;y<height;y++)
+   {
+    real32 * win = &window[((radius+y)%(radius+1))*width];
+    bit inside = (y+radius)<height;
+    for (nat32 x=0;x<width;x++)
+    {
+     real64 lastValue = colSum[x];
+     lastValue -= win[x];
+     win[x] = Hor(slice,x,y,dd);
+     if (inside) lastValue += Hor(slice,x,y+radius,dd);
+            else lastValue += maxSliceDiff;
+     colSum[x] = lastValue;
+     Write(x,y,dd,lastValue);
+    }
+   }
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -31,6 +31,8 @@
 #include "eos/time/progress.h"
 #include "eos/ds/arrays.h"
 #include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+#include "eos/os/compute.h"
 
 namespace eos
 {
@@ -86,11 +88,39 @@ class EOS_CLASS Sad
   /// from it.
    void SetOutput(svt::Field<real32> & out);
 
+  /// Alternative to the above, for a fixed point volume at half the memory.
+  /// Each sum is multiplied by scale, rounded and saturated to 65535, so
+  /// scale wants to be such that the interesting costs land well inside the
+  /// range - costs that saturate were never going to win. The sums are still
+  /// calculated in floating point, a slice at a time, so the only loss is
+  /// the quantisation. Only one of the two outputs is used, whichever was set
+  /// last.
+   void SetOutput(svt::Field<nat16> & out,real32 scale);
+
+
+  /// Switches on the multi-threaded mode, which hands sets of disparity slices
+  /// of the output volume to the given pool. Each slice is calculated with the
+  /// exact same sequence of floating point operations as the single threaded
+  /// version, so the output is bit-identical. Defaults to off.
+   void SetParallel(bit enable = true,mt::TaskPool & pool = mt::DefaultPool());
+
+  /// Switches on the use of os::Compute, so Run calculates the volume on the
+  /// GPU when there is one, leaving the above to decide how its done when
+  /// there isn't. The results differ from the CPU by floating point ordering
+  /// only. Defaults to off.
+   void SetCompute(bit enable = true);
+
 
   /// This takes the given inputs and calculates and stores the output, provides a
   /// progress bar capability as it can take some time.
    void Run(time::Progress * prog = null<time::Progress*>());
 
+  /// Alternative to SetOutput and the above, calculates the volume into a
+  /// compute buffer, laid out as for os::Compute, so further operations can
+  /// follow without it leaving the device. Always uses os::Compute, with its
+  /// own CPU fallback, regardless of SetCompute.
+   void Run(os::ComputeBuffer & out,time::Progress * prog = null<time::Progress*>());
+
 
   /// &nbsp;
    inline cstrconst TypeString() const {return "eos::stereo::Sad";}
@@ -104,8 +134,44 @@ class EOS_CLASS Sad
 
   ds::Array< Pair< svt::Field<real32>, svt::Field<real32> > > in;
   svt::Field<real32> out;
+  svt::Field<nat16> outFix; // Used instead of out if valid.
+  real32 outScale;
+
+  mt::TaskPool * pool; // null if not running in parallel.
+  bit compute;
+
+  // Does the calculation for the disparity slices [d0,d1), offset from minDisp.
+  // Used by the parallel and fixed point modes, processes each slice row by
+  // row using a set of per-column running sums, to be kind to the cache.
+   void RunSlices(nat32 d0,nat32 d1);
+
+  // Functor to run the above from a ParallelFor...
+   struct Slices
+   {
+    Sad * self;
+    void operator()(nat32 d0,nat32 d1) {self->RunSlices(d0,d1);}
+   };
 
   // Internal stuff...
+   // Where RunSlices keeps its horizontal sums - the output if its real,
+   // otherwise the given slice buffer...
+    real32 & Hor(ds::Array<real32> & slice,nat32 x,nat32 y,nat32 d)
+    {
+     if (outFix.Valid()) return slice[y*in[0].first.Size(0) + x];
+                    else return out.Get(x,y,d);
+    }
+
+   // Writes a final sum to whichever output is in use...
+    void Write(nat32 x,nat32 y,nat32 d,real64 v)
+    {
+     if (outFix.Valid())
+     {
+      real64 q = v*outScale + 0.5;
+      outFix.Get(x,y,d) = (q<65535.0)?((q>0.0)?nat16(q):0):65535;
+     }
+     else out.Get(x,y,d) = v;
+    }
+
    // Returns the absolute difference for the given coordinate, handles out of range values.
    // (For x and y only, not d)
     real32 AD(int32 x,int32 y,int32 d)
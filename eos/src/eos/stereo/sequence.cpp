@@ -0,0 +1,355 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/stereo/sequence.h"
+
+#include "eos/math/functions.h"
+#include "eos/time/times.h"
+#include "eos/file/csv.h"
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+Sequence::Sequence()
+:dsc(null<DSC*>()),solver(null<LevelSolver*>()),minDisp(-32),maxDisp(32),levels(2),
+threshold(1.0),halo(4),track(1),period(30),limit(0.5),
+frames(0),bytes(0),prevWidthRight(0),
+result(null<DSI*>()),full(false),changed(0.0),volume(0),ms(0)
+{}
+
+Sequence::~Sequence()
+{
+ delete dsc;
+ delete solver;
+ delete result;
+}
+
+void Sequence::Set(const DSC * d)
+{
+ delete dsc;
+ dsc = d->Clone();
+}
+
+void Sequence::Set(const svt::Field<bit> & lm,const svt::Field<bit> & rm)
+{
+ leftMask = lm;
+ rightMask = rm;
+}
+
+void Sequence::Set(const LevelSolver * s)
+{
+ delete solver;
+ solver = s->Clone();
+}
+
+void Sequence::SetRange(int32 minD,int32 maxD)
+{
+ minDisp = math::Min(minD,maxD);
+ maxDisp = math::Max(minD,maxD);
+}
+
+void Sequence::SetLevels(nat32 l)
+{
+ levels = l;
+}
+
+void Sequence::SetChange(real32 t,nat32 h)
+{
+ threshold = t;
+ halo = h;
+}
+
+void Sequence::SetTrack(nat32 t)
+{
+ track = t;
+}
+
+void Sequence::SetRefresh(nat32 p,real32 l)
+{
+ period = p;
+ limit = l;
+}
+
+void Sequence::Reset()
+{
+ frames = 0;
+}
+
+void Sequence::Run(time::Progress * prog)
+{
+ LogBlock("eos::stereo::Sequence::Run","");
+ mem::MemScope memScope("eos::stereo::Sequence");
+ prog->Push("eos::stereo::Sequence::Run");
+ nat64 start = time::MilliTime();
+
+ delete result;
+ result = null<DSI*>();
+
+ nat32 width = dsc->WidthLeft();
+ nat32 height = dsc->HeightLeft();
+ int32 widthRight = int32(dsc->WidthRight());
+
+ // Decide if a full solve is needed, either because the previous frame is
+ // missing or incompatible, its time for a refresh or too much has changed...
+  full = (frames==0)||(bytes!=dsc->Bytes())||
+         (prevDisp.Width()!=width)||(prevDisp.Height()!=height)||
+         (prevWidthRight!=dsc->WidthRight())||(prevRight.Size()!=dsc->WidthRight()*dsc->HeightRight()*bytes)||
+         ((period!=0)&&(frames>=period));
+
+  ds::Array2D<bit> mask;
+  if (!full)
+  {
+   mask.Resize(width,height);
+   changed = real32(Detect(mask))/real32(width*height);
+   if (changed>limit) full = true;
+  }
+
+
+ if (full)
+ {
+  // From scratch...
+   CoarseToFine * ctf = new CoarseToFine();
+   ctf->Set(dsc);
+   ctf->Set(leftMask,rightMask);
+   ctf->Set(solver);
+   ctf->SetRange(minDisp,maxDisp);
+   ctf->SetLevels(levels);
+   ctf->Run(prog);
+
+   result = ctf;
+   changed = 1.0;
+   volume = ctf->Volume(0);
+   frames = 1;
+ }
+ else
+ {
+  // Changed pixels get the entire range, everything else tracks its previous
+  // disparity...
+   BasicDSR dsr(width,height);
+   for (nat32 y=0;y<height;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     if (leftMask.Valid()&&(!leftMask.Get(x,y))) continue;
+
+     int32 low = math::Max(minDisp,-int32(x));
+     int32 high = math::Min(maxDisp,widthRight-1-int32(x));
+     if (!mask.Get(x,y))
+     {
+      int32 prev = prevDisp.Get(x,y);
+      int32 tLow = math::Max(low,prev-int32(track));
+      int32 tHigh = math::Min(high,prev+int32(track));
+      if (tLow<=tHigh)
+      {
+       low = tLow;
+       high = tHigh;
+      }
+     }
+
+     if (low<=high) dsr.Add(x,y,low,high);
+    }
+   }
+
+   volume = dsr.Matches();
+   result = solver->Solve(*dsc,dsr,leftMask,rightMask,prog);
+   frames += 1;
+ }
+
+ Remember();
+
+ ms = nat32(time::MilliTime() - start);
+ LogDebug("[sequence] {full,changed,volume,ms}" << LogDiv()
+          << full << LogDiv() << changed << LogDiv() << volume << LogDiv() << ms);
+
+ prog->Pop();
+}
+
+nat32 Sequence::Width() const
+{
+ return result->Width();
+}
+
+nat32 Sequence::Height() const
+{
+ return result->Height();
+}
+
+nat32 Sequence::Size(nat32 x, nat32 y) const
+{
+ return result->Size(x,y);
+}
+
+real32 Sequence::Disp(nat32 x, nat32 y, nat32 i) const
+{
+ return result->Disp(x,y,i);
+}
+
+real32 Sequence::Cost(nat32 x, nat32 y, nat32 i) const
+{
+ return result->Cost(x,y,i);
+}
+
+real32 Sequence::DispWidth(nat32 x, nat32 y, nat32 i) const
+{
+ return result->DispWidth(x,y,i);
+}
+
+cstrconst Sequence::TypeString() const
+{
+ return "eos::stereo::Sequence";
+}
+
+nat32 Sequence::Detect(ds::Array2D<bit> & mask) const
+{
+ nat32 width = mask.Width();
+ nat32 height = mask.Height();
+ nat32 widthRight = dsc->WidthRight();
+ nat32 heightRight = dsc->HeightRight();
+ ds::Array<byte> cur(bytes);
+
+ // Which right pixels have changed...
+  ds::Array<bit> rightChange(widthRight*heightRight);
+  for (nat32 y=0;y<heightRight;y++)
+  {
+   for (nat32 x=0;x<widthRight;x++)
+   {
+    nat32 ind = y*widthRight + x;
+    dsc->Right(x,y,cur.Ptr());
+    rightChange[ind] = dsc->Cost(prevRight.Ptr() + ind*bytes,cur.Ptr())>threshold;
+   }
+  }
+
+ // Left pixels that have changed, or whose match has, or that had no match...
+  ds::Array2D<bit> seed(width,height);
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    bit & targ = seed.Get(x,y);
+    targ = false;
+    if (leftMask.Valid()&&(!leftMask.Get(x,y))) continue;
+
+    int32 prev = prevDisp.Get(x,y);
+    if (prev==noDisp) {targ = true; continue;}
+
+    int32 rx = int32(x) + prev;
+    if ((rx>=0)&&(rx<int32(widthRight))&&(y<heightRight)&&rightChange[y*widthRight + rx]) {targ = true; continue;}
+
+    dsc->Left(x,y,cur.Ptr());
+    targ = dsc->Cost(prevLeft.Ptr() + (y*width + x)*bytes,cur.Ptr())>threshold;
+   }
+  }
+
+ // Grow by the halo, horizontally into mask then vertically back into seed,
+ // each as a pass in either direction tracking the distance to the last
+ // changed pixel...
+  int32 h = int32(halo);
+  for (nat32 y=0;y<height;y++)
+  {
+   int32 last = -h-1;
+   for (nat32 x=0;x<width;x++)
+   {
+    if (seed.Get(x,y)) last = x;
+    mask.Get(x,y) = (int32(x)-last)<=h;
+   }
+
+   last = int32(width)+h;
+   for (int32 x=int32(width)-1;x>=0;x--)
+   {
+    if (seed.Get(x,y)) last = x;
+    if ((last-x)<=h) mask.Get(x,y) = true;
+   }
+  }
+
+  for (nat32 x=0;x<width;x++)
+  {
+   int32 last = -h-1;
+   for (nat32 y=0;y<height;y++)
+   {
+    if (mask.Get(x,y)) last = y;
+    seed.Get(x,y) = (int32(y)-last)<=h;
+   }
+
+   last = int32(height)+h;
+   for (int32 y=int32(height)-1;y>=0;y--)
+   {
+    if (mask.Get(x,y)) last = y;
+    if ((last-y)<=h) seed.Get(x,y) = true;
+   }
+  }
+
+ // Copy back, counting...
+  nat32 ret = 0;
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    mask.Get(x,y) = seed.Get(x,y);
+    if (seed.Get(x,y)) ++ret;
+   }
+  }
+
+ return ret;
+}
+
+void Sequence::Remember()
+{
+ nat32 width = dsc->WidthLeft();
+ nat32 height = dsc->HeightLeft();
+ nat32 widthRight = dsc->WidthRight();
+ nat32 heightRight = dsc->HeightRight();
+ bytes = dsc->Bytes();
+ prevWidthRight = widthRight;
+
+ prevLeft.Size(width*height*bytes);
+ for (nat32 y=0;y<height;y++)
+ {
+  for (nat32 x=0;x<width;x++) dsc->Left(x,y,prevLeft.Ptr() + (y*width + x)*bytes);
+ }
+
+ prevRight.Size(widthRight*heightRight*bytes);
+ for (nat32 y=0;y<heightRight;y++)
+ {
+  for (nat32 x=0;x<widthRight;x++) dsc->Right(x,y,prevRight.Ptr() + (y*widthRight + x)*bytes);
+ }
+
+ // The lowest cost disparity of each pixel...
+  prevDisp.Resize(width,height);
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    int32 & targ = prevDisp.Get(x,y);
+    targ = noDisp;
+    real32 best = 0.0;
+    for (nat32 i=0;i<result->Size(x,y);i++)
+    {
+     if ((targ==noDisp)||(result->Cost(x,y,i)<best))
+     {
+      targ = int32(math::Round(result->Disp(x,y,i)));
+      best = result->Cost(x,y,i);
+     }
+    }
+   }
+  }
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,186 @@
+#ifndef EOS_STEREO_SEQUENCE_H
+#define EOS_STEREO_SEQUENCE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file sequence.h
+/// Provides stereo for video from a fixed rig, where each frame reuses the
+/// disparities of the last wherever the scene hasn't changed.
+
+#include "eos/types.h"
+
+#include "eos/stereo/dsi.h"
+#include "eos/stereo/dsr.h"
+#include "eos/stereo/coarse_to_fine.h"
+#include "eos/ds/arrays.h"
+#include "eos/ds/arrays2d.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+/// Temporally coherent stereo for a sequence of frames from a fixed rig. You
+/// give it the DSC of each frame in turn, calling Run after each, and it
+/// outputs that frames disparities as a DSI. The first frame is solved in
+/// full, with a CoarseToFine using the given LevelSolver. Each frame after
+/// that is compared with the last, pixel by pixel, using the DSC's own cost
+/// between the old and new value representations of each pixel - a left pixel
+/// is changed if it, or the right pixel it previously matched, differs by
+/// more than a threshold. Changed pixels are grown by a halo and searched
+/// over the entire disparity range, whilst everything else only searches a
+/// few disparities arround its previous answer, all in a single run of the
+/// LevelSolver. As the solvers only visit the ranges given most of the work
+/// disappears for mostly static scenes. A full solve is done every so many
+/// frames regardless, to stop errors accumulating, and whenever too much of
+/// the frame has changed for the incremental solve to be worth it.
+class EOS_CLASS Sequence : public DSI
+{
+ public:
+  /// &nbsp;
+   Sequence();
+
+  /// &nbsp;
+   ~Sequence();
+
+
+  /// Sets the DSC of the next frame, cloned. Must be called before each Run,
+  /// the frames must all be the same size or the next frame is solved in full.
+   void Set(const DSC * dsc);
+
+  /// Optional, sets the masks, which apply to every frame.
+   void Set(const svt::Field<bit> & leftMask,const svt::Field<bit> & rightMask);
+
+  /// Sets the algorithm to run, cloned. Must be called before Run.
+   void Set(const LevelSolver * solver);
+
+  /// Sets the inclusive disparity range, defaults to [-32,32].
+   void SetRange(int32 minDisp,int32 maxDisp);
+
+  /// Sets how many reduced resolution levels the full solves use, as for
+  /// CoarseToFine::SetLevels. Defaults to 2.
+   void SetLevels(nat32 levels);
+
+  /// Sets when a pixel is considered changed - threshold is compared with
+  /// the DSC cost between a pixels value in the last frame and this one, so
+  /// is in the units of the DSC, and halo is how many pixels the changed
+  /// regions are then grown by, to catch the edges of moving objects.
+  /// Defaults to 1 and 4.
+   void SetChange(real32 threshold,nat32 halo);
+
+  /// Sets how far either side of its previous disparity an unchanged pixel
+  /// is searched. Defaults to 1.
+   void SetTrack(nat32 track);
+
+  /// Sets how often a full solve is done - every period frames, 0 for only
+  /// when needed, and whenever more than limit of the pixels have changed.
+  /// Defaults to 30 and 0.5.
+   void SetRefresh(nat32 period,real32 limit);
+
+  /// Forgets the previous frame, so the next is solved in full.
+   void Reset();
+
+
+  /// Solves the current frame.
+   void Run(time::Progress * prog = null<time::Progress*>());
+
+
+  /// Returns true if the last Run did a full solve.
+   bit Full() const {return full;}
+
+  /// Returns the fraction of pixels that were considered changed by the last
+  /// Run, after growing by the halo. 1 for a full solve.
+   real32 Changed() const {return changed;}
+
+  /// Returns how many pixel/disparity pairs the last Run searched, at full
+  /// resolution.
+   nat32 Volume() const {return volume;}
+
+  /// Returns how many milliseconds the last Run took.
+   nat32 Time() const {return ms;}
+
+
+  /// &nbsp;
+   nat32 Width() const;
+
+  /// &nbsp;
+   nat32 Height() const;
+
+  /// &nbsp;
+   nat32 Size(nat32 x, nat32 y) const;
+
+  /// &nbsp;
+   real32 Disp(nat32 x, nat32 y, nat32 i) const;
+
+  /// &nbsp;
+   real32 Cost(nat32 x, nat32 y, nat32 i) const;
+
+  /// &nbsp;
+   real32 DispWidth(nat32 x, nat32 y, nat32 i) const;
+
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  // Input...
+   DSC * dsc;
+   LevelSolver * solver;
+   svt::Field<bit> leftMask;
+   svt::Field<bit> rightMask;
+
+   int32 minDisp;
+   int32 maxDisp;
+   nat32 levels;
+   real32 threshold;
+   nat32 halo;
+   nat32 track;
+   nat32 period;
+   real32 limit;
+
+  // The previous frame - the value representations of both images and the
+  // best disparity of each left pixel, with noDisp for none...
+   static const int32 noDisp = 0x7FFFFFFF;
+   nat32 frames; // Frames since the last full solve, 0 if there is no previous frame.
+   nat32 bytes;
+   ds::Array<byte> prevLeft;
+   ds::Array<byte> prevRight;
+   nat32 prevWidthRight;
+   ds::Array2D<int32> prevDisp;
+
+  // Output...
+   DSI * result;
+   bit full;
+   real32 changed;
+   nat32 volume;
+   nat32 ms;
+
+  // Helpers for Run...
+   // Marks the changed pixels, growing them by the halo, returns how many.
+    nat32 Detect(ds::Array2D<bit> & mask) const;
+
+   // Stores the representations and disparities of the current frame.
+    void Remember();
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
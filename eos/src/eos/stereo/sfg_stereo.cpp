@@ -1626,7 +1626,8 @@ diffErrLevel(0.1),
 smoothMult(0.5),smoothMax(2.0),smoothOverride(false),
 albedoOverride(false),saCost(1.0),saAngRes(45),bruteAlbedo(false),bruteIrrRes(255),
 orientOverride(false),orientsubDivs(2),orientMaxCost(1.0),orientAngMult(1.0),orientEqCost(2.0),
-orientOverrideSFS(false),orientSFSangAlias(0.25),orientSFSmaxCost(1.0),orientSFSangRes(90)
+orientOverrideSFS(false),orientSFSangAlias(0.25),orientSFSmaxCost(1.0),orientSFSangRes(90),
+compact(false),tolerance(0.0),residual(false),peak(0)
 {
  dc[0] = null<cam::DispConv*>();
  dc[1] = null<cam::DispConv*>();
@@ -1750,10 +1751,22 @@ void SfgsDisparity1::SetNeedle(const svt::Field<bs::Normal> & left,const svt::Fi
  needle[1] = right;
 }
 
+void SfgsDisparity1::SetCompact(bit enable)
+{
+ compact = enable;
+}
+
+void SfgsDisparity1::SetTolerance(real32 tol,bit res)
+{
+ tolerance = tol;
+ residual = res;
+}
+
 void SfgsDisparity1::Run(time::Progress * prog)
 {
  LogBlock("void SfgsDisparity1::Run(...)","-");
  prog->Push();
+  peak = 0;
   prog->Report(0,2);
   RunSingle(0,prog);
   prog->Report(1,2);  
@@ -1785,6 +1798,8 @@ void SfgsDisparity1::RunSingle(nat32 which,time::Progress * prog)
 
  // Make a field graph with which to construct the relevent factor graph...
   inf::FieldGraph fg(true);
+  fg.SetCompact(compact);
+  fg.SetTolerance(tolerance,residual);
 
 
  // Create the matching cost function (DSI)...
@@ -2072,6 +2087,9 @@ void SfgsDisparity1::RunSingle(nat32 which,time::Progress * prog)
     }
   }
 
+ peak = math::Max(peak,fg.PeakMemory());
+ LogDebug("[sfgs] {which,peak bytes}" << LogDiv() << which << LogDiv() << fg.PeakMemory());
+
  prog->Pop();
 }
 
@@ -2080,7 +2098,7 @@ SfgsAlbedo1::SfgsAlbedo1()
 :labels(100),
 albedoSd(3.0),albedoMinCorruption(0.2),albedoCorruptionAngle(math::pi*0.1),
 neighbourMinProb(1.1),neighbourMaxProb(2.0),neighbourAlpha(0.5),neighbourBeta(0.5),
-toLight(0.0,0.0,1.0)
+toLight(0.0,0.0,1.0),compact(false),tolerance(0.0),residual(false),peak(0)
 {}
 
 SfgsAlbedo1::~SfgsAlbedo1()
@@ -2126,6 +2144,17 @@ void SfgsAlbedo1::SetAlbedo(svt::Field<real32> & a)
  albedo = a;
 }
 
+void SfgsAlbedo1::SetCompact(bit enable)
+{
+ compact = enable;
+}
+
+void SfgsAlbedo1::SetTolerance(real32 tol,bit res)
+{
+ tolerance = tol;
+ residual = res;
+}
+
 void SfgsAlbedo1::Run(time::Progress * prog)
 {
  LogBlock("void SfgsAlbedo1::Run(...)","-");
@@ -2145,6 +2174,8 @@ void SfgsAlbedo1::Run(time::Progress * prog)
 
  // Create a field graph object...
   inf::FieldGraph fg(true);
+  fg.SetCompact(compact);
+  fg.SetTolerance(tolerance,residual);
   
  
  // Create the distribution field...
@@ -2245,6 +2276,7 @@ void SfgsAlbedo1::Run(time::Progress * prog)
     albedo.Get(x,y) = freq.Maximum() * albMult;
    }
   }
+  peak = fg.PeakMemory();
 
 
  prog->Pop();
@@ -2254,7 +2286,7 @@ void SfgsAlbedo1::Run(time::Progress * prog)
 Sfgs1::Sfgs1()
 :iCount(3),
 dcLeft(null<cam::DispConv*>()),dcRight(null<cam::DispConv*>()),
-needleSmooth(0.0)
+needleSmooth(0.0),peak(0)
 {}
 
 Sfgs1::~Sfgs1()
@@ -2378,6 +2410,18 @@ void Sfgs1::SetIterCount(nat32 iC)
  iCount = iC;
 }
 
+void Sfgs1::SetCompact(bit enable)
+{
+ disp.SetCompact(enable);
+ alb.SetCompact(enable);
+}
+
+void Sfgs1::SetTolerance(real32 tol,bit residual)
+{
+ disp.SetTolerance(tol,residual);
+ alb.SetTolerance(tol,residual);
+}
+
 void Sfgs1::SetNeedleCreator(cam::DispConv * dcL,cam::DispConv * dcR)
 {
  delete dcLeft;  dcLeft = dcL;
@@ -2403,10 +2447,12 @@ void Sfgs1::Run(time::Progress * prog)
 
 
   // Do the iterations, shape estmation then albedo estimation...
+   peak = 0;
    for (nat32 i=0;i<iCount;i++)
    {
     prog->Report(i*2+1,iCount*2+2);
     disp.Run(prog);
+    peak = math::Max(peak,disp.PeakMemory());
 
     prog->Report(i*2+2,iCount*2+2);
     {
@@ -2467,12 +2513,14 @@ void Sfgs1::Run(time::Progress * prog)
        alb.SetNeedle(leftNeedle);
        alb.SetAlbedo(leftAlbedo);
        alb.Run(prog);      
+       peak = math::Max(peak,alb.PeakMemory());
       prog->Report(2,3);
        alb.SetLight(rightLight);
        alb.SetIr(rightIr);
        alb.SetNeedle(rightNeedle);
        alb.SetAlbedo(rightAlbedo);
        alb.Run(prog);           
+       peak = math::Max(peak,alb.PeakMemory());
      
      prog->Pop();
     }
@@ -2483,6 +2531,8 @@ void Sfgs1::Run(time::Progress * prog)
    prog->Report(iCount*2+1,iCount*2+2);
    if (iCount==0) disp.SetNeedle(leftNeedle,rightNeedle);
    disp.Run(prog);
+   peak = math::Max(peak,disp.PeakMemory());
+   LogDebug("[sfgs] {peak bytes}" << LogDiv() << peak);
  
  prog->Pop();
 }
@@ -735,10 +735,24 @@ class EOS_CLASS SfgsDisparity1
   /// Sets the needle map for output, only then used as output when running in orient mode.
    void SetNeedle(const svt::Field<bs::Normal> & left,const svt::Field<bs::Normal> & right);
 
+  /// Switches on storing the factor graph messages as halfs, see
+  /// inf::FieldGraph::SetCompact, which about halves the memory used for a
+  /// small loss of precision. Defaults to off.
+   void SetCompact(bit enable = true);
+
+  /// Sets a convergence tolerance, in message cost, and optionally residual
+  /// scheduling, so the factor graph stops iterating once it has converged,
+  /// see inf::FieldGraph::SetTolerance. Defaults to 0 and false, i.e. off.
+   void SetTolerance(real32 tol,bit residual = false);
+
 
   /// This runs the algorithm, after this has returned the output fields will have
   /// been set it the most probable solution it has found.
    void Run(time::Progress * prog = null<time::Progress*>());
+
+  /// Returns the most bytes used by the factor graphs during the last Run,
+  /// as reported by inf::FieldGraph::PeakMemory.
+   nat64 PeakMemory() const {return peak;}
   
 
   /// &nbsp;
@@ -789,6 +803,11 @@ class EOS_CLASS SfgsDisparity1
   svt::Field<real32> dispDy[2];
   svt::Field<bs::Normal> needle[2];
 
+  bit compact;
+  real32 tolerance;
+  bit residual;
+  nat64 peak;
+
  // Actual Run method, only does one image so run itself calls this twice.
   void RunSingle(nat32 which,time::Progress * prog);
 };
@@ -840,9 +859,20 @@ class EOS_CLASS SfgsAlbedo1
    void SetAlbedo(svt::Field<real32> & albedo);
 
 
+  /// Switches on storing the factor graph messages as halfs, as for
+  /// SfgsDisparity1::SetCompact. Defaults to off.
+   void SetCompact(bit enable = true);
+
+  /// As for SfgsDisparity1::SetTolerance.
+   void SetTolerance(real32 tol,bit residual = false);
+
+
   /// Runs the algorithm. Sets the albedo map from all the other information.
    void Run(time::Progress * prog = null<time::Progress*>());
 
+  /// Returns the most bytes used by the factor graph during the last Run.
+   nat64 PeakMemory() const {return peak;}
+
 
   /// &nbsp;
    static inline cstrconst TypeString() {return "eos::stereo::SfgsAlbedo1";}
@@ -867,6 +897,11 @@ class EOS_CLASS SfgsAlbedo1
   svt::Field<bs::Normal> needle;
 
   svt::Field<real32> albedo;
+
+  bit compact;
+  real32 tolerance;
+  bit residual;
+  nat64 peak;
 };
 
 //------------------------------------------------------------------------------
@@ -960,9 +995,22 @@ class EOS_CLASS Sfgs1
    void SetNeedleCreator(cam::DispConv * dcLeft,cam::DispConv * dcRight);
 
 
+  /// Stores the factor graph messages as halfs, for both steps, see
+  /// SfgsDisparity1::SetCompact. Defaults to off.
+   void SetCompact(bit enable = true);
+
+  /// Sets the convergence tolerance for both steps, see
+  /// SfgsDisparity1::SetTolerance.
+   void SetTolerance(real32 tol,bit residual = false);
+
   /// Runs the algorithm.
    void Run(time::Progress * prog = null<time::Progress*>());
 
+  /// Returns the most bytes used by any of the factor graphs during the last
+  /// Run, which is the memory high-water mark bar the images and the factors
+  /// data.
+   nat64 PeakMemory() const {return peak;}
+
 
   /// &nbsp;
    static inline cstrconst TypeString() {return "eos::stereo::Sfgs1";}
@@ -990,6 +1038,8 @@ class EOS_CLASS Sfgs1
 
   SfgsDisparity1 disp;
   SfgsAlbedo1 alb;
+
+  nat64 peak;
 };
 
 //------------------------------------------------------------------------------
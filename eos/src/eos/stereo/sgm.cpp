@@ -0,0 +1,698 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/stereo/sgm.h"
+
+#include "eos/mem/alloc.h"
+#include "eos/mem/functions.h"
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+#include "eos/log/profile.h"
+
+#ifdef __SSE2__
+ #include <emmintrin.h>
+#endif
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+// The 16 bit cost vectors used throughout have a layout of stride = dp+2
+// entrys per pixel - a guard, the disparities padded up to a multiple of 8,
+// then another guard. The guards and padding are set to big, which can never
+// win a min, so the disparity neighbours of the ends need no special casing...
+static const int16 big = 0x3FFF;
+static const int16 costMax = 1023;
+
+// The path directions, the previous pixel on a path being p - (dx,dy). The
+// first 3 are for 8 paths, all 7 for 16 paths, the upward paths being these
+// with dy negated. The horizontal paths are handled seperatly...
+static const int32 pathX[7] = {0,1,-1,2,-2,1,-1};
+static const int32 pathY[7] = {1,1, 1,1, 1,2, 2};
+
+// One step along a path, for a single pixel...
+static inline int16 PathStep(const int16 * prev,int16 prevMin,const int16 * c,int16 * out,nat32 dp,int16 p1,int16 p2)
+{
+ #ifdef __SSE2__
+  __m128i vp1 = _mm_set1_epi16(p1);
+  __m128i vpm = _mm_set1_epi16(prevMin);
+  __m128i vjump = _mm_adds_epi16(vpm,_mm_set1_epi16(p2));
+  __m128i vmin = _mm_set1_epi16(0x7FFF);
+  for (nat32 i=1;i<=dp;i+=8)
+  {
+   __m128i same = _mm_loadu_si128((const __m128i*)(const void*)(prev+i));
+   __m128i down = _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(const void*)(prev+i-1)),vp1);
+   __m128i up = _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(const void*)(prev+i+1)),vp1);
+   __m128i m = _mm_min_epi16(_mm_min_epi16(same,down),_mm_min_epi16(up,vjump));
+   m = _mm_adds_epi16(_mm_subs_epi16(m,vpm),_mm_loadu_si128((const __m128i*)(const void*)(c+i)));
+   _mm_storeu_si128((__m128i*)(void*)(out+i),m);
+   vmin = _mm_min_epi16(vmin,m);
+  }
+  vmin = _mm_min_epi16(vmin,_mm_srli_si128(vmin,8));
+  vmin = _mm_min_epi16(vmin,_mm_srli_si128(vmin,4));
+  vmin = _mm_min_epi16(vmin,_mm_srli_si128(vmin,2));
+  return int16(_mm_extract_epi16(vmin,0));
+ #else
+  int32 jump = math::Min<int32>(int32(prevMin)+int32(p2),0x7FFF);
+  int16 ret = 0x7FFF;
+  for (nat32 i=1;i<=dp;i++)
+  {
+   int32 m = math::Min<int32>(prev[i],jump);
+   m = math::Min<int32>(m,int32(prev[i-1])+int32(p1));
+   m = math::Min<int32>(m,int32(prev[i+1])+int32(p1));
+   m = math::Min<int32>(m - int32(prevMin) + int32(c[i]),0x7FFF);
+   out[i] = int16(m);
+   ret = math::Min(ret,out[i]);
+  }
+  return ret;
+ #endif
+}
+
+// The start of a path, where there is no previous pixel...
+static inline int16 PathStart(const int16 * c,int16 * out,nat32 dp)
+{
+ int16 ret = 0x7FFF;
+ for (nat32 i=1;i<=dp;i++)
+ {
+  out[i] = c[i];
+  ret = math::Min(ret,c[i]);
+ }
+ return ret;
+}
+
+// Saturating sum of a pixels cost vectors...
+static inline void PathSum(int16 * out,const int16 * in,nat32 dp)
+{
+ #ifdef __SSE2__
+  for (nat32 i=1;i<=dp;i+=8)
+  {
+   __m128i a = _mm_loadu_si128((const __m128i*)(const void*)(out+i));
+   __m128i b = _mm_loadu_si128((const __m128i*)(const void*)(in+i));
+   _mm_storeu_si128((__m128i*)(void*)(out+i),_mm_adds_epi16(a,b));
+  }
+ #else
+  for (nat32 i=1;i<=dp;i++) out[i] = int16(math::Min<int32>(int32(out[i])+int32(in[i]),0x7FFF));
+ #endif
+}
+
+//------------------------------------------------------------------------------
+// All the state of a single run...
+class SGM::Engine
+{
+ public:
+  Engine(SGM & self);
+  ~Engine();
+
+  void Run(time::Progress * prog);
+
+
+ private:
+  SGM & self;
+
+  nat32 width;
+  nat32 height;
+  nat32 disps; // Number of disparities.
+  nat32 dp; // disps rounded up to a multiple of 8.
+  nat32 stride; // dp+2.
+  nat32 paths; // Non-horizontal paths in each direction, 3 or 7.
+  nat32 rows; // Rows of path state needed, 1 or 2, plus the current one.
+
+  real32 scale;
+  int16 p1;
+  int16 p2;
+
+  nat32 block; // Rows per block.
+  nat32 blocks;
+
+  int16 * cost; // block rows of costs.
+  int16 * upSum; // block rows of the sum of the upward paths.
+  int16 * rowSum; // A row of the sum of all paths.
+  int16 * horiz[2]; // A row each for the two horizontal paths.
+
+  // For each non-horizontal path, downward then upward, rows+1 rows of state
+  // and the minimum at each pixel, used cyclicly by row...
+   int16 * ring[14];
+   int16 * ringMin[14];
+
+  // Checkpoints of the upward paths, for every block bar the last...
+   int16 * check;
+   int16 * checkMin;
+
+
+  int16 * Vec(int16 * base,nat32 x) const {return base + x*stride;}
+  nat32 Slot(nat32 y) const {return y%(rows+1);}
+
+  void CostRow(nat32 y,int16 * out,nat32 x0,nat32 x1,real32 * temp) const;
+  nat32 CostSpan(nat32 x,nat32 y,int16 * o,int32 base,int32 lo,int32 hi,real32 * temp) const; // Returns how many costs it evaluated.
+  void PathRow(nat32 p,bit upward,nat32 y,const int16 * c,nat32 x0,nat32 x1);
+  void Horizontal(nat32 which,const int16 * c);
+  void Select(nat32 y,nat32 x0,nat32 x1);
+
+  void Checkpoint(nat32 k,nat32 y,bit save);
+
+  class Costs;
+  class Row;
+  class Horiz;
+};
+
+//------------------------------------------------------------------------------
+// Calculates the costs of a set of rows, each row a job...
+class SGM::Engine::Costs
+{
+ public:
+  Costs(Engine & e,nat32 y,int16 * o):self(e),y0(y),out(o) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   real32 * temp = new real32[self.disps];
+   for (nat32 i=begin;i<end;i++)
+   {
+    self.CostRow(y0+i,out + i*self.width*self.stride,0,self.width,temp);
+   }
+   delete[] temp;
+  }
+
+ private:
+  Engine & self;
+  nat32 y0;
+  int16 * out;
+};
+
+// Does the non-horizontal paths for a row, split by x. When going up the
+// upward paths are done and optionally summed into upRow, when going down the
+// downward paths are done and summed, along with upRow, into rowSum...
+class SGM::Engine::Row
+{
+ public:
+  Row(Engine & e,bit up,nat32 yy,const int16 * cr,int16 * ur)
+  :self(e),upward(up),y(yy),c(cr),upRow(ur) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 p=0;p<self.paths;p++) self.PathRow(p,upward,y,c,begin,end);
+
+   int16 * targ = upward ? upRow : self.rowSum;
+   if (targ==null<int16*>()) return;
+
+   nat32 base = upward ? self.paths : 0;
+   nat32 slot = self.Slot(y);
+   for (nat32 x=begin;x<end;x++)
+   {
+    int16 * t = self.Vec(targ,x);
+    if (upward) mem::Copy(t,self.Vec(self.ring[base] + slot*self.width*self.stride,x),self.stride);
+           else mem::Copy(t,self.Vec(upRow,x),self.stride);
+
+    for (nat32 p=(upward?1:0);p<self.paths;p++)
+    {
+     PathSum(t,self.Vec(self.ring[base+p] + slot*self.width*self.stride,x),self.dp);
+    }
+   }
+  }
+
+ private:
+  Engine & self;
+  bit upward;
+  nat32 y;
+  const int16 * c;
+  int16 * upRow;
+};
+
+// Does the two horizontal paths of a row, one per job...
+class SGM::Engine::Horiz
+{
+ public:
+  Horiz(Engine & e,const int16 * cr):self(e),c(cr) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   for (nat32 i=begin;i<end;i++) self.Horizontal(i,c);
+  }
+
+ private:
+  Engine & self;
+  const int16 * c;
+};
+
+//------------------------------------------------------------------------------
+SGM::Engine::Engine(SGM & s)
+:self(s)
+{
+ width = self.Width();
+ height = self.Height();
+ disps = nat32(self.maxDisp - self.minDisp + 1);
+ dp = ((disps+7)/8)*8;
+ stride = dp+2;
+ paths = (self.paths==16)?7:3;
+ rows = (self.paths==16)?2:1;
+
+ scale = real32(costMax)/self.costCap;
+ p1 = int16(math::Clamp<real32>(self.p1*scale + 0.5,0.0,4095.0));
+ p2 = int16(math::Clamp<real32>(math::Max(self.p1,self.p2)*scale + 0.5,real32(p1),4095.0));
+
+ // Pick the block size to minimise memory - two blocks of rows against the
+ // checkpoints...
+  block = nat32(math::Sqrt(real32(height*paths*rows)*0.5));
+  block = math::Clamp<nat32>(block,1,height);
+  blocks = (height+block-1)/block;
+
+ // Allocate and fill everything with big, so the guards and padding are set...
+  nat32 rowSize = width*stride;
+  cost = mem::Malloc<int16>(block*rowSize);
+  upSum = mem::Malloc<int16>(block*rowSize);
+  rowSum = mem::Malloc<int16>(rowSize);
+  horiz[0] = mem::Malloc<int16>(rowSize);
+  horiz[1] = mem::Malloc<int16>(rowSize);
+  for (nat32 i=0;i<block*rowSize;i++) {cost[i] = big; upSum[i] = big;}
+  for (nat32 i=0;i<rowSize;i++) {rowSum[i] = big; horiz[0][i] = big; horiz[1][i] = big;}
+
+  for (nat32 p=0;p<paths*2;p++)
+  {
+   ring[p] = mem::Malloc<int16>((rows+1)*rowSize);
+   ringMin[p] = mem::Malloc<int16>((rows+1)*width);
+   for (nat32 i=0;i<(rows+1)*rowSize;i++) ring[p][i] = big;
+  }
+
+  nat32 checks = (blocks-1)*paths*rows;
+  check = mem::Malloc<int16>(checks*rowSize);
+  checkMin = mem::Malloc<int16>(checks*width);
+}
+
+SGM::Engine::~Engine()
+{
+ mem::Free(cost);
+ mem::Free(upSum);
+ mem::Free(rowSum);
+ mem::Free(horiz[0]);
+ mem::Free(horiz[1]);
+ for (nat32 p=0;p<paths*2;p++)
+ {
+  mem::Free(ring[p]);
+  mem::Free(ringMin[p]);
+ }
+ mem::Free(check);
+ mem::Free(checkMin);
+}
+
+void SGM::Engine::Run(time::Progress * prog)
+{
+ prog->Push("eos::stereo::SGM::Run");
+ nat32 rowSize = width*stride;
+ nat32 grain = math::Max<nat32>(width/64,16);
+
+ // Bottom up pass, doing only the upward paths, to create the checkpoints.
+ // Not needed for the first block, as nothing is above it...
+  prog->Report(0,blocks+1);
+  if (blocks>1)
+  {
+   prog->Push();
+   for (nat32 y=height-1;y>=block;y--)
+   {
+    prog->Report(height-1-y,height-block);
+    Costs costs(*this,y,cost);
+    costs(0,1);
+
+    Row row(*this,true,y,cost,null<int16*>());
+    mt::ParallelFor(0,width,row,grain);
+
+    if ((y%block)==0) Checkpoint(y/block-1,y,true);
+   }
+   prog->Pop();
+  }
+
+
+ // Top down, a block at a time - recompute the upward paths for the block from
+ // its checkpoint, then sweep down doing the downward and horizontal paths and
+ // selecting the output...
+  for (nat32 k=0;k<blocks;k++)
+  {
+   prog->Report(k+1,blocks+1);
+   nat32 start = k*block;
+   nat32 end = math::Min(start+block,height);
+
+   Costs costs(*this,start,cost);
+   mt::ParallelFor(0,end-start,costs,1);
+
+   if (end<height) Checkpoint(k,end,false);
+   for (nat32 y=end;y>start;y--)
+   {
+    Row row(*this,true,y-1,cost + (y-1-start)*rowSize,upSum + (y-1-start)*rowSize);
+    mt::ParallelFor(0,width,row,grain);
+   }
+
+   for (nat32 y=start;y<end;y++)
+   {
+    const int16 * c = cost + (y-start)*rowSize;
+
+    Row row(*this,false,y,c,upSum + (y-start)*rowSize);
+    mt::ParallelFor(0,width,row,grain);
+
+    Horiz hor(*this,c);
+    mt::ParallelFor(0,2,hor,1);
+
+    Select(y,0,width);
+   }
+  }
+
+ prog->Pop();
+}
+
+void SGM::Engine::CostRow(nat32 y,int16 * out,nat32 x0,nat32 x1,real32 * temp) const
+{
+ int32 widthRight = int32(self.dsc ? self.dsc->WidthRight() : width);
+ bit valid = self.dsc ? (y<self.dsc->HeightRight()) : true;
+ nat64 costs = 0;
+ for (nat32 x=x0;x<x1;x++)
+ {
+  int16 * o = Vec(out,x);
+  for (nat32 i=1;i<=disps;i++) o[i] = costMax;
+  if (!valid) continue;
+
+  // Range of disparities that land in the right image...
+   int32 base = int32(x) + self.minDisp;
+   int32 lo = math::Max<int32>(0,-base);
+   int32 hi = math::Min<int32>(int32(disps),widthRight-base);
+
+  if (self.dsr)
+  {
+   for (nat32 r=0;r<self.dsr->Ranges(x,y);r++)
+   {
+    costs += CostSpan(x,y,o,base,math::Max<int32>(lo,self.dsr->Start(x,y,r)-self.minDisp),
+                        math::Min<int32>(hi,self.dsr->End(x,y,r)-self.minDisp+1),temp);
+   }
+  }
+  else costs += CostSpan(x,y,o,base,lo,hi,temp);
+ }
+
+ LogCount("eos::stereo::DSC cost",costs);
+}
+
+nat32 SGM::Engine::CostSpan(nat32 x,nat32 y,int16 * o,int32 base,int32 lo,int32 hi,real32 * temp) const
+{
+ if (hi<=lo) return 0;
+
+ if (self.vol.Valid())
+ {
+  // Straight from the volume, anything it doesn't cover staying at the cap...
+   real32 mult = scale/self.volScale;
+   int32 vo = self.minDisp - self.volMin;
+   int32 depth = int32(self.vol.Size(2));
+   for (int32 i=math::Max<int32>(lo,-vo);i<math::Min<int32>(hi,depth-vo);i++)
+   {
+    if (self.rightMask.Valid()&&(!self.rightMask.Get(base+i,y))) continue;
+    real32 v = real32(self.vol.Get(x,y,i+vo))*mult;
+    if (v<real32(costMax)) o[1+i] = int16(v+0.5);
+   }
+   return nat32(hi-lo);
+ }
+
+ self.dsc->CostRun(x,nat32(base+lo),y,nat32(hi-lo),temp);
+ for (int32 i=0;i<hi-lo;i++)
+ {
+  if (self.rightMask.Valid()&&(!self.rightMask.Get(base+lo+i,y))) continue;
+  real32 v = temp[i]*scale;
+  if (v<real32(costMax)) o[1+lo+i] = int16((v>0.0)?(v+0.5):0.0);
+ }
+ return nat32(hi-lo);
+}
+
+void SGM::Engine::PathRow(nat32 p,bit upward,nat32 y,const int16 * c,nat32 x0,nat32 x1)
+{
+ nat32 ind = upward ? (paths+p) : p;
+ int32 dx = upward ? -pathX[p] : pathX[p];
+ int32 dy = upward ? -pathY[p] : pathY[p];
+
+ int32 sy = int32(y) - dy;
+ bit rowOk = (sy>=0)&&(sy<int32(height));
+
+ int16 * out = ring[ind] + Slot(y)*width*stride;
+ int16 * outMin = ringMin[ind] + Slot(y)*width;
+ const int16 * src = rowOk ? (ring[ind] + Slot(sy)*width*stride) : null<int16*>();
+ const int16 * srcMin = rowOk ? (ringMin[ind] + Slot(sy)*width) : null<int16*>();
+
+ for (nat32 x=x0;x<x1;x++)
+ {
+  int32 sx = int32(x) - dx;
+  if (rowOk&&(sx>=0)&&(sx<int32(width)))
+  {
+   outMin[x] = PathStep(Vec((int16*)src,sx),srcMin[sx],Vec((int16*)c,x),Vec(out,x),dp,p1,p2);
+  }
+  else
+  {
+   outMin[x] = PathStart(Vec((int16*)c,x),Vec(out,x),dp);
+  }
+ }
+}
+
+void SGM::Engine::Horizontal(nat32 which,const int16 * c)
+{
+ int16 * out = horiz[which];
+ if (which==0)
+ {
+  int16 m = PathStart(Vec((int16*)c,0),Vec(out,0),dp);
+  for (nat32 x=1;x<width;x++) m = PathStep(Vec(out,x-1),m,Vec((int16*)c,x),Vec(out,x),dp,p1,p2);
+ }
+ else
+ {
+  int16 m = PathStart(Vec((int16*)c,width-1),Vec(out,width-1),dp);
+  for (nat32 x=width-1;x>0;x--) m = PathStep(Vec(out,x),m,Vec((int16*)c,x-1),Vec(out,x-1),dp,p1,p2);
+ }
+}
+
+void SGM::Engine::Select(nat32 y,nat32 x0,nat32 x1)
+{
+ nat32 count = self.used;
+ for (nat32 x=x0;x<x1;x++)
+ {
+  nat32 ind = y*width + x;
+  if (self.leftMask.Valid()&&(!self.leftMask.Get(x,y)))
+  {
+   self.outMask[ind] = false;
+   continue;
+  }
+  self.outMask[ind] = true;
+
+  int16 * s = Vec(rowSum,x);
+  PathSum(s,Vec(horiz[0],x),dp);
+  PathSum(s,Vec(horiz[1],x),dp);
+
+  // Insertion into the sorted list of the best so far...
+   int32 * od = &self.outDisp[ind*count];
+   real32 * oc = &self.outCost[ind*count];
+   nat32 have = 0;
+   for (nat32 d=0;d<disps;d++)
+   {
+    real32 v = real32(s[d+1]);
+    if ((have==count)&&(v>=oc[count-1])) continue;
+
+    nat32 pos = (have<count)?have:(count-1);
+    while ((pos>0)&&(oc[pos-1]>v))
+    {
+     oc[pos] = oc[pos-1];
+     od[pos] = od[pos-1];
+     --pos;
+    }
+    oc[pos] = v;
+    od[pos] = self.minDisp + int32(d);
+    if (have<count) ++have;
+   }
+
+   for (nat32 i=0;i<count;i++) oc[i] /= scale;
+ }
+}
+
+void SGM::Engine::Checkpoint(nat32 k,nat32 y,bit save)
+{
+ nat32 rowSize = width*stride;
+ for (nat32 p=0;p<paths;p++)
+ {
+  for (nat32 r=0;r<rows;r++)
+  {
+   if (y+r>=height) continue;
+   nat32 slot = Slot(y+r);
+   nat32 ci = (k*paths + p)*rows + r;
+   int16 * rs = ring[paths+p] + slot*rowSize;
+   int16 * rm = ringMin[paths+p] + slot*width;
+   if (save)
+   {
+    mem::Copy(check + ci*rowSize,rs,rowSize);
+    mem::Copy(checkMin + ci*width,rm,width);
+   }
+   else
+   {
+    mem::Copy(rs,check + ci*rowSize,rowSize);
+    mem::Copy(rm,checkMin + ci*width,width);
+   }
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+SGM::SGM()
+:dsc(null<DSC*>()),volMin(0),volScale(1.0),dsr(null<DSR*>()),minDisp(-32),maxDisp(32),p1(1.0),p2(8.0),costCap(32.0),paths(8),outCount(1),
+width(0),height(0),used(0)
+{}
+
+SGM::~SGM()
+{
+ delete dsc;
+ delete dsr;
+}
+
+void SGM::Set(const DSC * d)
+{
+ delete dsc;
+ dsc = d->Clone();
+ vol = svt::Field<nat16>();
+}
+
+void SGM::Set(const svt::Field<nat16> & cost,int32 mD,real32 scale)
+{
+ delete dsc;
+ dsc = null<DSC*>();
+ vol = cost;
+ volMin = mD;
+ volScale = scale;
+}
+
+void SGM::Set(const DSR * d)
+{
+ delete dsr;
+ dsr = d ? d->Clone() : null<DSR*>();
+}
+
+void SGM::Set(const svt::Field<bit> & lm,const svt::Field<bit> & rm)
+{
+ leftMask = lm;
+ rightMask = rm;
+}
+
+void SGM::SetRange(int32 minD,int32 maxD)
+{
+ minDisp = math::Min(minD,maxD);
+ maxDisp = math::Max(minD,maxD);
+}
+
+void SGM::SetSmooth(real32 pp1,real32 pp2)
+{
+ p1 = pp1;
+ p2 = pp2;
+}
+
+void SGM::SetCost(real32 cap)
+{
+ costCap = cap;
+}
+
+void SGM::SetPaths(nat32 p)
+{
+ paths = (p>8)?16:8;
+}
+
+void SGM::SetOutput(nat32 oc)
+{
+ outCount = math::Max<nat32>(oc,1);
+}
+
+void SGM::Run(time::Progress * prog)
+{
+ LogTime("eos::stereo::SGM::Run");
+ mem::MemScope memScope("eos::stereo::SGM");
+
+ width = vol.Valid() ? vol.Size(0) : dsc->WidthLeft();
+ height = vol.Valid() ? vol.Size(1) : dsc->HeightLeft();
+
+ // If there is a DSR swap in its range for the duration...
+  int32 userMin = minDisp;
+  int32 userMax = maxDisp;
+  if (dsr)
+  {
+   bit first = true;
+   for (nat32 y=0;y<dsr->Height();y++)
+   {
+    for (nat32 x=0;x<dsr->Width();x++)
+    {
+     nat32 ranges = dsr->Ranges(x,y);
+     if (ranges==0) continue;
+     if (first)
+     {
+      minDisp = dsr->Start(x,y,0);
+      maxDisp = dsr->End(x,y,ranges-1);
+      first = false;
+     }
+     else
+     {
+      minDisp = math::Min(minDisp,dsr->Start(x,y,0));
+      maxDisp = math::Max(maxDisp,dsr->End(x,y,ranges-1));
+     }
+    }
+   }
+  }
+
+ used = math::Min<nat32>(outCount,nat32(maxDisp-minDisp+1));
+
+ outDisp.Size(width*height*used);
+ outCost.Size(width*height*used);
+ outMask.Size(width*height);
+
+ {
+  Engine engine(*this);
+  engine.Run(prog);
+ }
+
+ minDisp = userMin;
+ maxDisp = userMax;
+}
+
+nat32 SGM::Width() const
+{
+ return width;
+}
+
+nat32 SGM::Height() const
+{
+ return height;
+}
+
+nat32 SGM::Size(nat32 x, nat32 y) const
+{
+ return outMask[y*width + x]?used:0;
+}
+
+real32 SGM::Disp(nat32 x, nat32 y, nat32 i) const
+{
+ return outDisp[(y*width + x)*used + i];
+}
+
+real32 SGM::Cost(nat32 x, nat32 y, nat32 i) const
+{
+ return outCost[(y*width + x)*used + i];
+}
+
+real32 SGM::DispWidth(nat32 x, nat32 y, nat32 i) const
+{
+ return 0.5;
+}
+
+cstrconst SGM::TypeString() const
+{
+ return "eos::stereo::SGM";
+}
+
+//------------------------------------------------------------------------------
+ };
+};
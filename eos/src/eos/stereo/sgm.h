@@ -0,0 +1,172 @@
+#ifndef EOS_STEREO_SGM_H
+#define EOS_STEREO_SGM_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file sgm.h
+/// Provides semi-global matching, a stereo algorithm with a predictable run
+/// time that doesn't depend on the image content.
+
+#include "eos/types.h"
+
+#include "eos/stereo/dsi.h"
+#include "eos/stereo/dsr.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace stereo
+ {
+//------------------------------------------------------------------------------
+/// Semi-global matching, as introduced by Hirschmuller. The matching costs are
+/// aggregated along 8 or 16 straight line paths through every pixel, each
+/// path being a 1D dynamic programming problem with a penalty of P1 for a
+/// disparity change of 1 and P2 for anything larger, and each pixel takes the
+/// disparity that minimises the sum over the paths. Takes any DSC to provide
+/// the matching costs, or a fixed point cost volume.
+///
+/// Costs are converted to 16 bit integers, with the cost cap given to SetCost
+/// mapped to 1023, and all aggregation is done with saturating arithmetic,
+/// 8 disparities at a time with SSE2 when avaliable. Path state is held in
+/// rolling buffers of a few rows, so the aggregation never holds a volume the
+/// size of the image. The downward half of the paths and the upward half
+/// can't both be swept at once though, so the upward state is checkpointed
+/// every sqrt(height) rows during a bottom up pass and recomputed a block at a
+/// time during the top down pass - memory is O(width*disparities*sqrt(height))
+/// for the price of calculating the costs and upward paths twice. The output
+/// is exact regardless. Rows are split between threads.
+///
+/// Disparities follow the convention of the other algorithms, a disparity of
+/// d matches left pixel x with right pixel x+d.
+class EOS_CLASS SGM : public DSI
+{
+ public:
+  /// &nbsp;
+   SGM();
+
+  /// &nbsp;
+   ~SGM();
+
+
+  /// Sets the DSC which defines the cost of each match. Its cloned and
+  /// internaly stored. Must be called before Run.
+   void Set(const DSC * dsc);
+
+  /// Alternative to the above, sets a dense fixed point cost volume to take
+  /// the costs from, such as Sad writes, with index d of the third dimension
+  /// being disparity minDisp+d, each cost having been multiplied by scale.
+  /// The costs are used directly, rescaled to the 16 bit costs used within,
+  /// so no DSC is consulted. Disparities searched outside the volume cost the
+  /// cap. Only one of the two cost sources is used, whichever was set last.
+   void Set(const svt::Field<nat16> & cost,int32 minDisp,real32 scale);
+
+  /// Optional, sets a DSR to limit the search. Its cloned and internaly
+  /// stored, null to go back to not using one. When set the range given to
+  /// SetRange is replaced by the extremes of the DSR, and the DSC is only
+  /// consulted within each pixels ranges, the cap being used elsewhere - the
+  /// aggregation is unchanged, but with an expensive DSC this saves most of
+  /// the time.
+   void Set(const DSR * dsr);
+
+  /// Optional, sets the masks. Pixels masked out in the left image get no
+  /// output, matches to pixels masked out in the right image cost the cap.
+   void Set(const svt::Field<bit> & leftMask,const svt::Field<bit> & rightMask);
+
+  /// Sets the inclusive range of disparities to search, defaults to [-32,32].
+   void SetRange(int32 minDisp,int32 maxDisp);
+
+  /// Sets the smoothing penalties, in the same units as the DSC costs - p1 is
+  /// charged for a disparity change of one between neighbours, p2 for any
+  /// larger change. p2 is raised to p1 if smaller. Defaults to 1 and 8.
+   void SetSmooth(real32 p1,real32 p2);
+
+  /// Sets the cost cap, DSC costs above it are clamped to it. Also sets the
+  /// resolution of the 16 bit costs, as the cap is mapped to 1023. Defaults
+  /// to 32.
+   void SetCost(real32 cap);
+
+  /// Sets how many paths to aggregate over, 8 or 16, defaults to 8.
+   void SetPaths(nat32 paths);
+
+  /// Sets how many disparities to output for each pixel, the lowest cost
+  /// ones. Defaults to 1.
+   void SetOutput(nat32 outCount);
+
+
+  /// Runs the algorithm.
+   void Run(time::Progress * prog = null<time::Progress*>());
+
+
+  /// &nbsp;
+   nat32 Width() const;
+
+  /// &nbsp;
+   nat32 Height() const;
+
+  /// &nbsp;
+   nat32 Size(nat32 x, nat32 y) const;
+
+  /// &nbsp;
+   real32 Disp(nat32 x, nat32 y, nat32 i) const;
+
+  /// &nbsp;
+   real32 Cost(nat32 x, nat32 y, nat32 i) const;
+
+  /// &nbsp;
+   real32 DispWidth(nat32 x, nat32 y, nat32 i) const;
+
+
+  /// &nbsp;
+   cstrconst TypeString() const;
+
+
+ private:
+  // Input...
+   DSC * dsc;
+   svt::Field<nat16> vol; // Used instead of dsc if valid.
+   int32 volMin;
+   real32 volScale;
+   DSR * dsr;
+   svt::Field<bit> leftMask;
+   svt::Field<bit> rightMask;
+
+   int32 minDisp;
+   int32 maxDisp;
+   real32 p1;
+   real32 p2;
+   real32 costCap;
+   nat32 paths;
+   nat32 outCount;
+
+  // Output - outCount entrys per pixel, with the count actually used...
+   nat32 width;
+   nat32 height;
+   nat32 used;
+   ds::Array<int32> outDisp;
+   ds::Array<real32> outCost;
+   ds::Array<bit> outMask;
+
+
+  // Everything to do with a run is in here, so the class itself stays small...
+   class Engine;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
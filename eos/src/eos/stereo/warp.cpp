@@ -19,6 +19,7 @@
 
 #include "eos/file/csv.h"
 #include "eos/math/functions.h"
+#include "eos/log/logs.h"
 
 namespace eos
 {
@@ -89,8 +90,9 @@ EOS_FUNC void ForwardWarp(const svt::Field<bs::ColourRGB> & image,const svt::Fie
 //------------------------------------------------------------------------------
 WarpInc::WarpInc(const svt::Field<bs::ColourRGB> & base,nat32 s)
 :width(base.Size(0)),height(base.Size(1)),pixel(new Node[base.Size(0)*base.Size(1)]),
-segments(s),segs(new Node*[s]),
-occCost(0.1),diffSum(0.0),occCount(base.Size(0)*base.Size(1))
+segments(s),segs(new Node*[s]),stash(new Node*[s]),
+occCost(0.1),check(false),diffSum(0.0),occCount(base.Size(0)*base.Size(1)),
+segDiff(new real64[s]),segOcc(new nat32[s])
 {
  Node * targ = pixel;
  for (nat32 y=0;y<height;y++)
@@ -107,14 +109,27 @@ occCost(0.1),diffSum(0.0),occCount(base.Size(0)*base.Size(1))
   }
  }
 
- for (nat32 i=0;i<segments;i++) segs[i] = null<Node*>();
+ for (nat32 i=0;i<segments;i++)
+ {
+  segs[i] = null<Node*>();
+  stash[i] = null<Node*>();
+  segDiff[i] = 0.0;
+  segOcc[i] = 0;
+ }
 }
 
 WarpInc::~WarpInc()
 {
- for (nat32 i=0;i<segments;i++) Remove(i);
+ for (nat32 i=0;i<segments;i++)
+ {
+  Remove(i);
+  Forget(i);
+ }
  delete[] pixel;
  delete[] segs;
+ delete[] stash;
+ delete[] segDiff;
+ delete[] segOcc;
 }
 
 void WarpInc::SetMask(const svt::Field<bit> & mask)
@@ -124,7 +139,13 @@ void WarpInc::SetMask(const svt::Field<bit> & mask)
  {
   for (nat32 x=0;x<width;x++)
   {
-   targ->count = mask.Get(x,y);
+   if (targ->count!=mask.Get(x,y))
+   {
+    // Masked pixels are never an occlusion, so the count has to follow...
+     if (targ->count) --occCount;
+                 else ++occCount;
+     targ->count = mask.Get(x,y);
+   }
    targ++;
   }
  }
@@ -147,64 +168,20 @@ nat32 WarpInc::Height()
 
 void WarpInc::Add(nat32 x,nat32 y,real32 disp,const bs::ColourRGB & colour,nat32 segment)
 {
- disp = math::Abs(disp);
-
- // Add it in...
-  Node * head = &pixel[y*width + x];
-  if (!head->count) return; // Break out if its a masked pixel.
-  Node * nn = nodeAlloc.Malloc<Node>();
-
-  Node * targ = head;
-  while (true)
-  {
-   if ((targ->next==head)||(targ->next->disp<disp))
-   {
-    nn->next = targ->next;
-    nn->last = targ;
-
-    nn->next->last = nn;
-    nn->last->next = nn;
-    break;
-   }
-   targ = targ->next;
-  }
+ Node * head = &pixel[y*width + x];
+ if (!head->count) return; // Break out if its a masked pixel.
+ Node * nn = nodeAlloc.Malloc<Node>();
 
-  nn->segNext = segs[segment];
-  segs[segment] = nn;
+ nn->segNext = segs[segment];
+ segs[segment] = nn;
 
-  nn->head = head;
-  nn->colour = colour;
-  nn->disp = disp;
+ nn->head = head;
+ nn->colour = colour;
+ nn->disp = math::Abs(disp);
+ nn->diff = math::Abs(colour.r-head->colour.r) + math::Abs(colour.g-head->colour.g) + math::Abs(colour.b-head->colour.b);
+ nn->segment = segment;
 
- // Update the scores...
-  if (targ==head) // Its the top dog.
-  {
-   if (nn->next->head==null<Node*>())
-   {
-    // We have filled in a gap, only slightly hairy...
-     // Remove occlusion score...
-      --occCount;
-
-     // Add in new score...
-      diffSum += math::Abs(nn->colour.r-head->colour.r) + math::Abs(nn->colour.g-head->colour.g) + math::Abs(nn->colour.b-head->colour.b);
-   }
-   else
-   {
-    // We have replaced the top node and are now the new king of the hill - very, very hairy...
-     // Remove the old king, making him a humble occlusion...
-      Node * ot = nn->next;
-      ++occCount;
-      diffSum -= math::Abs(ot->colour.r-head->colour.r) + math::Abs(ot->colour.g-head->colour.g) + math::Abs(ot->colour.b-head->colour.b);
-
-     // Add in new score...
-      diffSum += math::Abs(nn->colour.r-head->colour.r) + math::Abs(nn->colour.g-head->colour.g) + math::Abs(nn->colour.b-head->colour.b);
-   }
-  }
-  else
-  {
-   // Slipped in behind existing data - just another occlusion...
-    ++occCount;
-  }
+ Insert(nn);
 }
 
 void WarpInc::Remove(nat32 segment)
@@ -214,43 +191,77 @@ void WarpInc::Remove(nat32 segment)
 
  while (targ)
  {
-  // Get next victim...
+  Node * victim = targ;
+  targ = targ->segNext;
+
+  Unlink(victim);
+  nodeAlloc.Free<Node>(victim);
+ }
+
+ // All of its nodes are gone, so zero its tallies rather than leave rounding behind...
+  segDiff[segment] = 0.0;
+  segOcc[segment] = 0;
+}
+
+void WarpInc::Stash(nat32 segment)
+{
+ Forget(segment);
+
+ // The segment list is newest first, reverse it into the stash so Restore
+ // re-adds in the original order...
+  Node * targ = segs[segment];
+  segs[segment] = null<Node*>();
+  while (targ)
+  {
    Node * victim = targ;
    targ = targ->segNext;
 
-  // Adjust score...
-   if (victim->head==victim->last)
-   {
-    // Its the top node - some serious work is required:-(..
-     // Remove its effect...
-      diffSum -= math::Abs(victim->colour.r-victim->head->colour.r) + math::Abs(victim->colour.g-victim->head->colour.g) + math::Abs(victim->colour.b-victim->head->colour.b);
+   Unlink(victim);
+   victim->segNext = stash[segment];
+   stash[segment] = victim;
+  }
 
-     // Add in the new kings effect...
-      if (victim->next->head!=null<Node*>())
-      {
-       diffSum += math::Abs(victim->next->colour.r-victim->head->colour.r) + math::Abs(victim->next->colour.g-victim->head->colour.g) + math::Abs(victim->next->colour.b-victim->head->colour.b);
-       --occCount;
-      }
-      else ++occCount;
-   }
-   else
-   {
-    // Its not visible - just another occlusion...
-     --occCount;
-   }
+ segDiff[segment] = 0.0;
+ segOcc[segment] = 0;
+}
+
+void WarpInc::Restore(nat32 segment)
+{
+ Remove(segment);
 
-  // Remove from data structure...
-   victim->next->last = victim->last;
-   victim->last->next = victim->next;
+ // Re-insert in the order they were added, so the result is exactly the
+ // state before the Stash...
+  Node * targ = stash[segment];
+  stash[segment] = null<Node*>();
+  while (targ)
+  {
+   Node * nn = targ;
+   targ = targ->segNext;
 
-  // Kill the victim...
-   nodeAlloc.Free<Node>(victim);
- }
+   nn->segNext = segs[segment];
+   segs[segment] = nn;
+   Insert(nn);
+  }
+}
+
+void WarpInc::Forget(nat32 segment)
+{
+ Free(stash[segment]);
+ stash[segment] = null<Node*>();
 }
 
 real32 WarpInc::Score() const
 {
- return diffSum + real32(occCount)*occCost;
+ real32 ret = diffSum + real32(occCount)*occCost;
+ if (check)
+ {
+  real32 raw = RawScore();
+  if (math::Abs(raw-ret)>1e-3*math::Max<real32>(1.0,math::Abs(raw)))
+  {
+   LogError("[stereo.warp] Incrimental score disagrees with full recalculation {incrimental,raw}" << LogDiv() << ret << LogDiv() << raw);
+  }
+ }
+ return ret;
 }
 
 real32 WarpInc::ScoreDiff() const
@@ -263,12 +274,22 @@ real32 WarpInc::ScoreOcc() const
  return real32(occCount)*occCost;
 }
 
+real32 WarpInc::ScoreSeg(nat32 segment) const
+{
+ return segDiff[segment] + real32(segOcc[segment])*occCost;
+}
+
+void WarpInc::SetCheck(bit enable)
+{
+ check = enable;
+}
+
 real32 WarpInc::RawScore() const
 {
  real32 ret = 0.0;
  nat32 retCount = 0;
  Node * targ = pixel;
- for (nat32 i=0;i<width*height;i++)
+ for (nat32 i=0;i<width*height;i++,targ++)
  {
   // If theres nothing in this node we add in an oclusion cost, otherwise we
   // have the cost of the top pixel plus all occluded pixels hiding under it...
@@ -291,7 +312,6 @@ real32 WarpInc::RawScore() const
       st = st->next;
      }
    }
-  ++targ;
  }
  return ret + real32(retCount)*occCost;
 }
@@ -308,6 +328,95 @@ void WarpInc::GetImage(svt::Field<bs::ColourRGB> & out)
  }
 }
 
+void WarpInc::Insert(Node * nn)
+{
+ // Find its place in the pixels list, highest disparity first. Ties go by
+ // segment then order of addition, so the order does not depend on the history
+ // of removals and a Stash/Restore pair leaves everything as it was...
+  Node * head = nn->head;
+  Node * targ = head;
+  while (targ->next!=head)
+  {
+   Node * cand = targ->next;
+   if ((cand->disp<nn->disp)||((!(nn->disp<cand->disp))&&(cand->segment>nn->segment))) break;
+   targ = cand;
+  }
+
+  nn->next = targ->next;
+  nn->last = targ;
+  nn->next->last = nn;
+  nn->last->next = nn;
+
+ // Update the scores...
+  if (targ==head) // Its the top dog.
+  {
+   if (nn->next->head==null<Node*>())
+   {
+    // We have filled in a gap, so one less occlusion...
+     --occCount;
+   }
+   else
+   {
+    // We have replaced the top node - the old king becomes a humble occlusion...
+     Node * ot = nn->next;
+     ++occCount;
+     ++segOcc[ot->segment];
+     diffSum -= ot->diff;
+     segDiff[ot->segment] -= ot->diff;
+   }
+
+   diffSum += nn->diff;
+   segDiff[nn->segment] += nn->diff;
+  }
+  else
+  {
+   // Slipped in behind existing data - just another occlusion...
+    ++occCount;
+    ++segOcc[nn->segment];
+  }
+}
+
+void WarpInc::Unlink(Node * victim)
+{
+ // Adjust score...
+  if (victim->head==victim->last)
+  {
+   // Its the top node, remove its effect and add in the new kings...
+    diffSum -= victim->diff;
+    segDiff[victim->segment] -= victim->diff;
+
+    Node * nk = victim->next;
+    if (nk->head!=null<Node*>())
+    {
+     diffSum += nk->diff;
+     segDiff[nk->segment] += nk->diff;
+     --segOcc[nk->segment];
+     --occCount;
+    }
+    else ++occCount;
+  }
+  else
+  {
+   // Its not visible - just another occlusion...
+    --occCount;
+    --segOcc[victim->segment];
+  }
+
+ // Remove from data structure...
+  victim->next->last = victim->last;
+  victim->last->next = victim->next;
+}
+
+void WarpInc::Free(Node * targ)
+{
+ while (targ)
+ {
+  Node * victim = targ;
+  targ = targ->segNext;
+  nodeAlloc.Free<Node>(victim);
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -50,6 +50,8 @@ EOS_FUNC void ForwardWarp(const svt::Field<bs::ColourRGB> & image,const svt::Fie
 /// Each pixel also has an associated true colour, a cost is calculated,
 /// incrimentally with each change, which can be obtained at any time, so a
 /// change can be tested for improving the results without any serious computation.
+/// Adding or removing a segment costs time proportional to its pixels, and
+/// the contribution of each segment to the cost is tallied as it goes.
 /// The cost function consists of the following terms:
 /// - Sum of absolute differences of actual image, the difference between the true colour and rendered colour. (Excluding areas with no pixels.)
 /// - Sum of occlusion weight multiplied by the number of occlusions in both the left and right images.
@@ -92,6 +94,20 @@ class EOS_CLASS WarpInc
   /// Removes all pixels in a segment.
    void Remove(nat32 segment);
 
+  /// Removes all pixels in a segment as Remove does, but keeps them aside so
+  /// Restore can put them back without the caller re-rendering the segment.
+  /// Any previously stashed pixels for the segment are discarded.
+   void Stash(nat32 segment);
+
+  /// Removes whatever the segment currently has rendered and replaces it with
+  /// the pixels last stashed for it, emptying the stash. If nothing is stashed
+  /// this is the same as Remove.
+   void Restore(nat32 segment);
+
+  /// Discards the stashed pixels for a segment, for when the change they
+  /// would revert is being kept.
+   void Forget(nat32 segment);
+
 
   /// Returns the score for the class in its current state.
    real32 Score() const;
@@ -102,6 +118,16 @@ class EOS_CLASS WarpInc
   /// Returns the score for just the occlusion cost.
    real32 ScoreOcc() const;
 
+  /// Returns the part of the score due to a single segment - the colour
+  /// difference of its visible pixels plus the occlusion cost of its hidden
+  /// ones. Pixels that nothing is rendered to are not attributed to anything.
+   real32 ScoreSeg(nat32 segment) const;
+
+  /// Switches on a debugging mode, where every call to Score() compares the
+  /// incrimental result against RawScore() and logs an error if they disagree
+  /// beyond rounding. Very slow, off by default.
+   void SetCheck(bit enable);
+
   /// Returns the score for the class in its current state, except instead of using
   /// the incrimental calculation it calculates it directly. This is far slower to
   /// Score() but has the advantage of simpler code, so its less likelly to be wrong.
@@ -121,7 +147,7 @@ class EOS_CLASS WarpInc
    struct Node
    {
     Node * next; // Circular linked list with dummy node as pixel,
-    Node * last; // kept sorted with highest disparity first in the list.
+    Node * last; // kept sorted with highest disparity first in the list, ties by segment.
 
     Node * segNext; // Singerly linked list of nodes that are a member of the same segment.
 
@@ -129,8 +155,17 @@ class EOS_CLASS WarpInc
     bs::ColourRGB colour; // True colour if in the dummy node.
     bit count; // True to count it, false to ignore this pixel for costs. Relevant for dummy only.
     real32 disp;
+    real32 diff; // Absolute difference from the true colour, cached for the score updates.
+    nat32 segment; // Segment its a member of.
    };
 
+  // Links a node into its pixel and unlinks it again, updating all the scores...
+   void Insert(Node * nn);
+   void Unlink(Node * victim);
+
+  // Frees a singerly linked list of nodes that are not linked into any pixel...
+   void Free(Node * targ);
+
   // A memory allocator - used by the code to speed up memory allocations, as there bloody slow otherwise...
    mem::PreAlloc<sizeof(Node),300000> nodeAlloc; // Consumes a bit over 10 meg, about enough for a 640x480 image.
 
@@ -139,15 +174,20 @@ class EOS_CLASS WarpInc
     nat32 width;
     nat32 height;
     Node * pixel;
-   // Pointers to first node for each segment...
+   // Pointers to first node for each segment, and to removed nodes kept for Restore...
     nat32 segments;
     Node ** segs;
+    Node ** stash;
 
   // Incrimental score stuff...
    real32 occCost;
+   bit check;
 
-   real32 diffSum; // Sum of all differences from true colour.
+   real64 diffSum; // Sum of all differences from true colour.
    nat32 occCount; // Number of occlusions.
+
+   real64 * segDiff; // Per segment sums of the differences of visible nodes.
+   nat32 * segOcc; // Per segment counts of hidden nodes.
 };
 
 //------------------------------------------------------------------------------
@@ -259,11 +259,12 @@ inline void ToStr<bit>(const bit & obj,cstr out)
 template <typename T> 
 inline void IntToHex(T val,cstr res)
 {
- const nat32 maxSize = sizeof(T)*2 + 1;
- nat32 shift = sizeof(T);
+ const nat32 maxSize = sizeof(T)*2;
+ nat32 shift = sizeof(T)*8;
  for (nat32 i=0;i<maxSize;i+=2)
  {
-  byte p = byte(val>>(--shift));
+  shift -= 8;
+  byte p = byte(val>>shift);
   res[i]   = "0123456789ABCDEF"[p>>4];
   res[i+1] = "0123456789ABCDEF"[p&0x0F];
  }
@@ -339,6 +340,105 @@ inline real32 ToReal32(cstrconst str)
  return real32(atof(str));
 }
 
+//------------------------------------------------------------------------------
+/// Skips spaces, tabs and carriage returns, but not new lines, advancing ptr to
+/// the first other character or end.
+inline void SkipSpace(cstrconst & ptr,cstrconst end)
+{
+ while ((ptr!=end)&&((*ptr==' ')||(*ptr=='\t')||(*ptr=='\r'))) ++ptr;
+}
+
+/// Parses an unsigned integer from a character range that need not be null
+/// terminated, after skipping spaces as SkipSpace. Advances ptr past it and
+/// returns true, or returns false, with ptr after the spaces, if there is no
+/// number. For fast parsing of big text files, without any allocation.
+inline bit ParseNat(cstrconst & ptr,cstrconst end,nat64 & out)
+{
+ SkipSpace(ptr,end);
+ if ((ptr==end)||(*ptr<'0')||(*ptr>'9')) return false;
+
+ out = 0;
+ while ((ptr!=end)&&(*ptr>='0')&&(*ptr<='9'))
+ {
+  out = out*10 + nat64(*ptr - '0');
+  ++ptr;
+ }
+ return true;
+}
+
+/// As ParseNat, but for a signed integer.
+inline bit ParseInt(cstrconst & ptr,cstrconst end,int64 & out)
+{
+ SkipSpace(ptr,end);
+ bit neg = false;
+ cstrconst start = ptr;
+ if ((ptr!=end)&&((*ptr=='-')||(*ptr=='+'))) {neg = *ptr=='-'; ++ptr;}
+
+ nat64 val;
+ if (!ParseNat(ptr,end,val)) {ptr = start; return false;}
+ out = neg?-int64(val):int64(val);
+ return true;
+}
+
+/// As ParseNat, but for a real, in the usual c format with optional sign,
+/// fraction and exponent. Accurate to about 1 in 10^15, so not quite as
+/// good as atof, but plenty for real32.
+inline bit ParseReal(cstrconst & ptr,cstrconst end,real64 & out)
+{
+ static const real64 pow10[23] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+                                  1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+
+ SkipSpace(ptr,end);
+ cstrconst start = ptr;
+ bit neg = false;
+ if ((ptr!=end)&&((*ptr=='-')||(*ptr=='+'))) {neg = *ptr=='-'; ++ptr;}
+
+ // Mantissa, only keeping the first 18 digits, which is all a nat64 can
+ // hold and more than a real64 can...
+  nat64 mant = 0;
+  int32 exp = 0;
+  nat32 digits = 0;
+  nat32 kept = 0;
+  while ((ptr!=end)&&(*ptr>='0')&&(*ptr<='9'))
+  {
+   if (kept<18) {mant = mant*10 + nat64(*ptr - '0'); if (mant!=0) ++kept;}
+           else ++exp;
+   ++digits;
+   ++ptr;
+  }
+
+  if ((ptr!=end)&&(*ptr=='.'))
+  {
+   ++ptr;
+   while ((ptr!=end)&&(*ptr>='0')&&(*ptr<='9'))
+   {
+    if (kept<18) {mant = mant*10 + nat64(*ptr - '0'); --exp; if (mant!=0) ++kept;}
+    ++digits;
+    ++ptr;
+   }
+  }
+  if (digits==0) {ptr = start; return false;}
+
+ // Exponent...
+  if ((ptr!=end)&&((*ptr=='e')||(*ptr=='E')))
+  {
+   cstrconst expStart = ptr;
+   ++ptr;
+   int64 e;
+   if ((ptr!=end)&&(*ptr!=' ')&&(*ptr!='\t')&&ParseInt(ptr,end,e)) exp += int32(e);
+                                                               else ptr = expStart;
+  }
+
+ // Combine...
+  out = real64(mant);
+  while (exp>22) {out *= 1e22; exp -= 22;}
+  while (exp<-22) {out /= 1e22; exp += 22;}
+  if (exp>0) out *= pow10[exp];
+  if (exp<0) out /= pow10[-exp];
+  if (neg) out = -out;
+ return true;
+}
+
 //------------------------------------------------------------------------------
  };
 };
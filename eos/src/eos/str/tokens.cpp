@@ -22,6 +22,8 @@
 
 #include "eos/file/csv.h" // Delete me!
 
+#include <stdio.h>
+
 namespace eos
 {
  namespace str
@@ -93,20 +95,15 @@ Token TokenTable::operator()(cstrconst s) const
   cstrconst targ = s;
   while (*targ) {hash += (nat8)*targ; targ++;}
 
- // Now we get its node...
-  nat32 depth = 0;
-  Node * node = top[hash].Get(s,depth);
-
- // Detect if its a new node, and setup as needed...
-  if (node->str==0)
-  {
-   cstr str = str::Duplicate(s);
-   node->str = str+depth;
-   node->num = AssignNum(str);
-  }
+ // Try without the lock, which is the ushal case...
+  Entry * e = top[hash].Find(s,0);
+  if (e) return e->num;
 
- // Return the value req...
-  return node->num;
+ // Not there - get its node with the lock held, and setup as needed...
+  mt::AutoLock al(const_cast<mt::OwnedLock&>(lock));
+  Node * node = top[hash].Get(s,0);
+  if (node->entry) return node->entry->num; // Someone else got there first.
+  return Add(node,str::Duplicate(s));
 }
 
 Token TokenTable::operator()(nat32 length,cstrconst s) const
@@ -115,22 +112,30 @@ Token TokenTable::operator()(nat32 length,cstrconst s) const
   nat8 hash = 0;
   for (nat32 i=0;i<length;i++) {hash += (nat8)s[i];}
 
- // Now we get its node...
-  nat32 depth = 0;
-  Node * node = top[hash].Get(length,s,depth);
+ // Try without the lock...
+  Entry * e = top[hash].Find(length,s,0);
+  if (e) return e->num;
 
- // Detect if its a new node, and setup as needed...
-  if (node->str==0)
-  {
-   cstr str = mem::Malloc<cstrchar>(length+1);
-    mem::Copy(str,s,length);
-    str[length] = 0;
-   node->str = str+depth;
-   node->num = AssignNum(str);
-  }
+ // Get its node with the lock held, and setup as needed...
+  mt::AutoLock al(const_cast<mt::OwnedLock&>(lock));
+  Node * node = top[hash].Get(length,s,0);
+  if (node->entry) return node->entry->num;
 
- // Return the value req...
-  return node->num;
+  cstr str = mem::Malloc<cstrchar>(length+1);
+   mem::Copy(str,s,length);
+   str[length] = 0;
+  return Add(node,str);
+}
+
+nat32 TokenTable::Add(Node * node,cstr s) const
+{
+ Entry * e = new Entry;
+ e->str = s;
+ e->num = AssignNum(s);
+
+ __sync_synchronize(); // Entry must be complete before its visible.
+ node->entry = e;
+ return e->num;
 }
 
 Token TokenTable::operator()(const String & rhs) const // Inefficient by laziness, set on fire when needed/bored.
@@ -256,6 +261,7 @@ nat32 TokenTable::AssignNum(cstr s) const
   ((cstr*)((cstr*)((cstr*)str[0][max>>24])[(max>>16)&0xFF])[(max>>8)&0xFF])[max&0xFF] = s;
  }
 
+ __sync_synchronize(); // The string must be in place before max says it exists.
  return const_cast<TokenTable*>(this)->max++;
 }
 
@@ -267,76 +273,177 @@ bit TokenTable::Exists(cstrconst s,Token & out) const
   while (*targ) {hash += (nat8)*targ; targ++;}
 
  // Now check for its existance...
-  Node * node = top[hash].Exists(s);
-  if (node)
+  Entry * e = top[hash].Find(s,0);
+  if (e)
   {
-   out = node->num;
+   out = e->num;
    return true;
   }
   else return false;
 }
 
+// Snapshot files are a header, a count, then each string as a length followed 
+// by that many bytes, the count and lengths being native nat32's...
+static const char tokenMagic[8] = {'e','o','s','t','o','k','s','1'};
+
+bit TokenTable::Save(cstrconst fn) const
+{
+ FILE * f = fopen(fn,"wb");
+ if (f==0) return false;
+
+ nat32 count = max;
+ bit ok = (fwrite(tokenMagic,8,1,f)==1) && (fwrite(&count,sizeof(nat32),1,f)==1);
+ for (nat32 i=1;ok&&(i<count);i++) // Token 0 is allways NullToken, so skipped.
+ {
+  cstrconst s = Str(i);
+  nat32 length = str::Length(s);
+  ok = (fwrite(&length,sizeof(nat32),1,f)==1);
+  if (ok&&(length!=0)) ok = (fwrite(s,length,1,f)==1);
+ }
+
+ if (fclose(f)!=0) ok = false;
+ return ok;
+}
+
+bit TokenTable::Load(cstrconst fn)
+{
+ FILE * f = fopen(fn,"rb");
+ if (f==0) return false;
+ 
+ char magic[8];
+ nat32 count = 0;
+ bit ok = (fread(magic,8,1,f)==1) && mem::Compare(magic,tokenMagic,8)==0 &&
+           (fread(&count,sizeof(nat32),1,f)==1);
+
+ nat32 size = 0;
+ cstr buf = null<cstr>();
+ for (nat32 i=1;ok&&(i<count);i++)
+ {
+  nat32 length;
+  if (fread(&length,sizeof(nat32),1,f)!=1) {ok = false; break;}
+  if (length+1>size)
+  {
+   mem::Free(buf);
+   size = length+1;
+   buf = mem::Malloc<cstrchar>(size);
+  }
+  if ((length!=0)&&(fread(buf,length,1,f)!=1)) {ok = false; break;}
+  
+  if ((*this)(length,buf)!=i) ok = false;
+ }
+ 
+ mem::Free(buf);
+ fclose(f);
+ return ok;
+}
+
 //------------------------------------------------------------------------------
+// Returns true if str, which is null terminated, is the first length 
+// characters of s...
+static inline bit Match(cstrconst str,cstrconst s,nat32 length)
+{
+ for (nat32 i=0;i<length;i++)
+ {
+  if (str[i]!=s[i]) return false;
+ }
+ return str[length]==0;
+}
+
 TokenTable::Node::Node()
-:str(null<cstr>()),child(null<Node*>())
+:entry(null<Entry*>()),child(null<Node*>())
 {}
 
 TokenTable::Node::~Node()
 {
+ delete entry;
  delete[] child;
 }
 
-TokenTable::Node * TokenTable::Node::Get(nat32 remainder,cstrconst s,nat32 & depth)
+TokenTable::Node * TokenTable::Node::Get(nat32 remainder,cstrconst s,nat32 depth)
 {
- if (str==null<cstr>()) return this;
- if (mem::Compare(str,s,remainder)==0) return this;
+ Entry * e = entry;
+ if (e==null<Entry*>()) return this;
+ if (Match(e->str+depth,s,remainder)) return this;
 
- if (child==null<Node*>()) child = new Node[256];
+ if (child==null<Node*>())
+ {
+  Node * c = new Node[256];
+  __sync_synchronize();
+  child = c;
+ }
 
  if (remainder==0)
  {
-  nat32 d = 1;
-  Node * node = child[nat8(*str)].Get(str+1,d);
-  node->str = str+d;
-  node->num = num;
-
-  str = null<cstr>();
-  return this;
+  // The new string ends here - move the current entry down a level. Its put
+  // in its new home before being removed from here, so a reader allways finds
+  // it in one or the other...
+   Node * node = child[nat8(e->str[depth])].Get(e->str+depth+1,depth+1);
+   node->entry = e;
+   __sync_synchronize();
+   entry = null<Entry*>();
+   return this;
  }
 
- depth++;
- return child[nat8(*s)].Get(remainder-1,s+1,depth);
+ return child[nat8(*s)].Get(remainder-1,s+1,depth+1);
 }
 
-TokenTable::Node * TokenTable::Node::Get(cstrconst s,nat32 & depth)
+TokenTable::Node * TokenTable::Node::Get(cstrconst s,nat32 depth)
 {
- if (str==null<cstr>()) return this;
- if (str::Compare(str,s)==0) return this;
+ Entry * e = entry;
+ if (e==null<Entry*>()) return this;
+ if (str::Compare(e->str+depth,s)==0) return this;
 
- if (child==null<Node*>()) child = new Node[256];
+ if (child==null<Node*>())
+ {
+  Node * c = new Node[256];
+  __sync_synchronize();
+  child = c;
+ }
 
  if (*s==0)
  {
-  nat32 d = 1;
-  Node * node = child[nat8(*str)].Get(str+1,d);
-  node->str = str+d;
-  node->num = num;
-
-  str = null<cstr>();
-  return this;
+  // As above...
+   Node * node = child[nat8(e->str[depth])].Get(e->str+depth+1,depth+1);
+   node->entry = e;
+   __sync_synchronize();
+   entry = null<Entry*>();
+   return this;
  }
 
- depth++;
- return child[nat8(*s)].Get(s+1,depth);
+ return child[nat8(*s)].Get(s+1,depth+1);
+}
+
+TokenTable::Entry * TokenTable::Node::Find(cstrconst s,nat32 depth) const
+{
+ Entry * e = entry;
+ if (e && (str::Compare(e->str+depth,s)==0)) return e;
+
+ Node * c = child;
+ if ((c==null<Node*>())||(*s==0)) return null<Entry*>();
+ return c[nat8(*s)].Find(s+1,depth+1);
 }
 
-TokenTable::Node * TokenTable::Node::Exists(cstrconst s)
+TokenTable::Entry * TokenTable::Node::Find(nat32 remainder,cstrconst s,nat32 depth) const
 {
- if (str::Compare(str,s)==0) return this;
- if (child==null<Node*>()) return null<Node*>();
- if (*s==0) return null<Node*>();
+ Entry * e = entry;
+ if (e && Match(e->str+depth,s,remainder)) return e;
+
+ Node * c = child;
+ if ((c==null<Node*>())||(remainder==0)) return null<Entry*>();
+ return c[nat8(*s)].Find(remainder-1,s+1,depth+1);
+}
 
- return child[nat8(*s)].Exists(s+1);
+//------------------------------------------------------------------------------
+Token TokenCache::Fill(const TokenTable & t) const
+{
+ Token ret = t(str);
+ if (claimed.CompareSwap(0,1))
+ {
+  tok = ret;
+  __sync_synchronize();
+  tt = &t;
+ }
+ return ret;
 }
 
 //------------------------------------------------------------------------------
@@ -24,6 +24,7 @@
 
 #include "eos/types.h"
 #include "eos/str/strings.h"
+#include "eos/mt/locks.h"
 
 namespace eos
 {
@@ -44,6 +45,13 @@ static const Token NullToken = 0;
 /// be a bit of a memory hog. (Internally a 256 way digital tree with data stored
 /// as close to the root as possible, and hashing at the top level to mix up strings
 /// with similar starts.)
+///
+/// It is thread safe. Looking up strings that allready have tokens, and 
+/// converting tokens back to strings, take no locks, so any number of threads
+/// can do so at once; only adding a new string takes a lock, so new strings
+/// are serialised. As nothing is ever removed from the table entries, once 
+/// visible, never change, so readers racing with an insert allways see either
+/// the state before or after it.
 class EOS_CLASS TokenTable
 {
  public:
@@ -77,33 +85,104 @@ class EOS_CLASS TokenTable
   /// of it not allready being defined it just returns false, without
   /// adding it in. If it returns true then out is set to the relevent Token.
    bit Exists(cstrconst str,Token & out) const;
+   
+  /// Returns how many tokens exist, which is one more than the largest Token
+  /// handed out so far.
+   nat32 Tokens() const {return max;}
+
+
+  /// Writes every string in the table to the given file, in Token order, so it
+  /// can be reloaded by Load. Returns true on success.
+   bit Save(cstrconst fn) const;
+
+  /// Adds every string in a file written by Save. Loaded into a fresh table,
+  /// before anything else, each string gets the same Token it had when saved,
+  /// so a program can start with all the strings it will want allready in 
+  /// place and avoid taking the lock to add them one at a time as it runs. 
+  /// Returns false if the file could not be read or if any string ended up 
+  /// with a different Token to when it was saved, which happens if the table 
+  /// was not fresh - the strings are all added regardless.
+   bit Load(cstrconst fn);
 
  private:
   // Number to string...
    inline nat32 AssignNum(cstr str) const; // str must last beyond the methods return.
-   nat32 max;
+   volatile nat32 max; // Only incrimented once the entry it covers is in place.
    cstr * str[4]; // 3 is low, high not initialised till needed.
 
   // String to number...
+   // A string and its token, never changes once created so it can be passed
+   // arround the nodes without readers seeing it half done...
+    struct Entry
+    {
+     cstr str; // The whole string, owned by the number to string structure.
+     nat32 num;
+    };
+
    class Node
    {
     public:
       Node();
      ~Node();
 
-     Node * Get(cstrconst s,nat32 & depth);
-     Node * Get(nat32 remainder,cstrconst s,nat32 & depth);
+     // For adding; these return the node where s is or should be placed, 
+     // restructuring as needed. s is the string from depth onwards. Must be 
+     // called with the lock held...
+      Node * Get(cstrconst s,nat32 depth);
+      Node * Get(nat32 remainder,cstrconst s,nat32 depth);
 
-     // Returns the relevent node if it exists, otherwise null - identical to Get
-     // except it dosn't create...
-      Node * Exists(cstrconst s);
+     // Returns the relevent entry if it exists, otherwise null - does not 
+     // create and needs no lock...
+      Entry * Find(cstrconst s,nat32 depth) const;
+      Entry * Find(nat32 remainder,cstrconst s,nat32 depth) const;
 
-    cstr str;
-    nat32 num;
-    Node * child; // Points to an array of 256 children.
+    Entry * volatile entry; // null if empty.
+    Node * volatile child; // Points to an array of 256 children, null if none.
    };
 
    Node * top; // Points to an array of 256, hashed by sum of chars.
+   mt::OwnedLock lock; // Held whilst adding.
+
+  // Adds a new entry into the given node, which must be empty, taking 
+  // ownership of s. Lock must be held...
+   nat32 Add(Node * node,cstr s) const;
+};
+
+//------------------------------------------------------------------------------
+/// Caches the Token of a string, for hot code that would otherwise look up the
+/// same string over and over; ushally a static with a compile time constant 
+/// string, e.g. <code>static str::TokenCache rgb("rgb"); var->ByName(rgb(tt),f);</code>
+/// It remembers the Token for the first TokenTable its used with, and simply 
+/// does the lookup for any other. Thread safe.
+class EOS_CLASS TokenCache
+{
+ public:
+  /// The string must last as long as this object.
+   TokenCache(cstrconst s):str(s),tt(null<const TokenTable*>()),tok(NullToken),claimed(0) {}
+
+  /// &nbsp;
+   ~TokenCache() {}
+
+
+  /// Returns the Token for the string from the given table.
+   Token operator()(const TokenTable & t) const
+   {
+    if (tt==&t) return tok;
+    return Fill(t);
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::str::TokenCache";}
+
+
+ private:
+  cstrconst str;
+  mutable const TokenTable * volatile tt; // Set once tok is valid for it.
+  mutable volatile Token tok;
+  mutable mt::Atomic claimed; // Whoever sets this to 1 gets to fill in tok and tt.
+
+  Token Fill(const TokenTable & t) const;
 };
 
 
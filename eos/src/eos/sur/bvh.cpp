@@ -0,0 +1,1082 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos/sur/bvh.h"
+
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+
+#ifdef __SSE__
+ #include <xmmintrin.h>
+#endif
+
+namespace eos
+{
+ namespace sur
+ {
+//------------------------------------------------------------------------------
+// Tree building constants - number of bins for the surface area heuristic, the
+// biggest leaf we are happy to make and the deepest we let it go, so the
+// traversal stacks are never overflowed...
+static const nat32 bvhBins = 16;
+static const nat32 bvhMaxLeaf = 8;
+static const nat32 bvhMaxDepth = 60;
+
+// Half the surface area of a box...
+inline real32 BoxArea(const real32 * min,const real32 * max)
+{
+ real32 dx = max[0]-min[0];
+ real32 dy = max[1]-min[1];
+ real32 dz = max[2]-min[2];
+ return dx*dy + dy*dz + dz*dx;
+}
+
+inline void BoxEmpty(real32 * min,real32 * max)
+{
+ for (nat32 d=0;d<3;d++)
+ {
+  min[d] = math::Infinity<real32>();
+  max[d] = -math::Infinity<real32>();
+ }
+}
+
+inline void BoxGrow(real32 * min,real32 * max,const real32 * omin,const real32 * omax)
+{
+ for (nat32 d=0;d<3;d++)
+ {
+  min[d] = math::Min(min[d],omin[d]);
+  max[d] = math::Max(max[d],omax[d]);
+ }
+}
+
+// Slab test of a ray against a box, given 1 over the direction. Outputs the
+// entry distance, which is clamped to 0...
+inline bit BoxHit(const real32 * min,const real32 * max,const bs::Ray & ray,const real32 * inv,real32 limit,real32 & entry)
+{
+ real32 low = 0.0;
+ real32 high = limit;
+ for (nat32 d=0;d<3;d++)
+ {
+  real32 t0 = (min[d] - ray.s[d]) * inv[d];
+  real32 t1 = (max[d] - ray.s[d]) * inv[d];
+  if (t0>t1) math::Swap(t0,t1);
+  low = math::Max(low,t0);
+  high = math::Min(high,t1);
+ }
+ entry = low;
+ return low<=high;
+}
+
+// Ray against a triangle stored as a corner and two edges, the Moller-Trumbore
+// test. Double sided, distances must be positive, as for RayTriIntersect...
+inline bit TriHit(const real32 * t,const bs::Ray & ray,real32 & dist,real32 & u,real32 & v)
+{
+ const real32 * e1 = t + 3;
+ const real32 * e2 = t + 6;
+
+ real32 p[3];
+ p[0] = ray.n[1]*e2[2] - ray.n[2]*e2[1];
+ p[1] = ray.n[2]*e2[0] - ray.n[0]*e2[2];
+ p[2] = ray.n[0]*e2[1] - ray.n[1]*e2[0];
+
+ real32 det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+ if (math::IsZero(det)) return false;
+ real32 inv = 1.0/det;
+
+ real32 s[3] = {ray.s[0]-t[0],ray.s[1]-t[1],ray.s[2]-t[2]};
+ u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * inv;
+ if ((u<0.0)||(u>1.0)) return false;
+
+ real32 q[3];
+ q[0] = s[1]*e1[2] - s[2]*e1[1];
+ q[1] = s[2]*e1[0] - s[0]*e1[2];
+ q[2] = s[0]*e1[1] - s[1]*e1[0];
+
+ v = (ray.n[0]*q[0] + ray.n[1]*q[1] + ray.n[2]*q[2]) * inv;
+ if ((v<0.0)||(u+v>1.0)) return false;
+
+ dist = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * inv;
+ return dist>0.0;
+}
+
+inline void RayInv(const bs::Ray & ray,real32 * inv)
+{
+ for (nat32 d=0;d<3;d++) inv[d] = 1.0/ray.n[d]; // Infinities for zeros are fine.
+}
+
+#ifdef __SSE__
+// TriHit for 4 rays at once, given as seperate arrays of the components.
+// Returns a mask of the rays that hit closer than best, outputting dist, u and
+// v for all 4, only valid where the mask is set. The determinant test matches
+// the math::IsZero in TriHit...
+inline nat32 TriHit4(const real32 * t,const real32 * const * rs,const real32 * const * rn,const real32 * best,
+                     real32 * distOut,real32 * uOut,real32 * vOut)
+{
+ static const int32 zeroBits = 1000;
+ __m128 zero = _mm_setzero_ps();
+ __m128 one = _mm_set1_ps(1.0);
+ __m128 tiny = _mm_set1_ps(*(const real32*)(const void*)&zeroBits);
+ __m128 absMask = _mm_set1_ps(-0.0);
+
+ __m128 e1x = _mm_set1_ps(t[3]), e1y = _mm_set1_ps(t[4]), e1z = _mm_set1_ps(t[5]);
+ __m128 e2x = _mm_set1_ps(t[6]), e2y = _mm_set1_ps(t[7]), e2z = _mm_set1_ps(t[8]);
+
+ __m128 nx = _mm_loadu_ps(rn[0]), ny = _mm_loadu_ps(rn[1]), nz = _mm_loadu_ps(rn[2]);
+
+ __m128 px = _mm_sub_ps(_mm_mul_ps(ny,e2z),_mm_mul_ps(nz,e2y));
+ __m128 py = _mm_sub_ps(_mm_mul_ps(nz,e2x),_mm_mul_ps(nx,e2z));
+ __m128 pz = _mm_sub_ps(_mm_mul_ps(nx,e2y),_mm_mul_ps(ny,e2x));
+
+ __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x,px),_mm_mul_ps(e1y,py)),_mm_mul_ps(e1z,pz));
+ __m128 ok = _mm_cmpgt_ps(_mm_andnot_ps(absMask,det),tiny);
+ __m128 inv = _mm_div_ps(one,det);
+
+ __m128 sx = _mm_sub_ps(_mm_loadu_ps(rs[0]),_mm_set1_ps(t[0]));
+ __m128 sy = _mm_sub_ps(_mm_loadu_ps(rs[1]),_mm_set1_ps(t[1]));
+ __m128 sz = _mm_sub_ps(_mm_loadu_ps(rs[2]),_mm_set1_ps(t[2]));
+
+ __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx,px),_mm_mul_ps(sy,py)),_mm_mul_ps(sz,pz)),inv);
+ ok = _mm_and_ps(ok,_mm_and_ps(_mm_cmpge_ps(u,zero),_mm_cmple_ps(u,one)));
+
+ __m128 qx = _mm_sub_ps(_mm_mul_ps(sy,e1z),_mm_mul_ps(sz,e1y));
+ __m128 qy = _mm_sub_ps(_mm_mul_ps(sz,e1x),_mm_mul_ps(sx,e1z));
+ __m128 qz = _mm_sub_ps(_mm_mul_ps(sx,e1y),_mm_mul_ps(sy,e1x));
+
+ __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx,qx),_mm_mul_ps(ny,qy)),_mm_mul_ps(nz,qz)),inv);
+ ok = _mm_and_ps(ok,_mm_and_ps(_mm_cmpge_ps(v,zero),_mm_cmple_ps(_mm_add_ps(u,v),one)));
+
+ __m128 dist = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x,qx),_mm_mul_ps(e2y,qy)),_mm_mul_ps(e2z,qz)),inv);
+ ok = _mm_and_ps(ok,_mm_and_ps(_mm_cmpgt_ps(dist,zero),_mm_cmplt_ps(dist,_mm_loadu_ps(best))));
+
+ _mm_storeu_ps(distOut,dist);
+ _mm_storeu_ps(uOut,u);
+ _mm_storeu_ps(vOut,v);
+ return _mm_movemask_ps(ok);
+}
+
+// BoxHit for 4 rays at once, as seperate arrays of start and 1 over direction
+// components; returns the mask of the rays that hit within their limits...
+inline nat32 BoxHit4(const real32 * min,const real32 * max,const real32 * const * rs,const real32 * const * ri,const real32 * limit)
+{
+ __m128 low = _mm_setzero_ps();
+ __m128 high = _mm_loadu_ps(limit);
+ for (nat32 d=0;d<3;d++)
+ {
+  __m128 s = _mm_loadu_ps(rs[d]);
+  __m128 inv = _mm_loadu_ps(ri[d]);
+  __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(min[d]),s),inv);
+  __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(max[d]),s),inv);
+  low = _mm_max_ps(low,_mm_min_ps(t0,t1));
+  high = _mm_min_ps(high,_mm_max_ps(t0,t1));
+ }
+ return _mm_movemask_ps(_mm_cmple_ps(low,high));
+}
+#endif
+
+// Squared distance from a point to a box, 0 if inside...
+inline real32 BoxDistSqr(const real32 * min,const real32 * max,const real32 * p)
+{
+ real32 ret = 0.0;
+ for (nat32 d=0;d<3;d++)
+ {
+  real32 o = 0.0;
+  if (p[d]<min[d]) o = min[d] - p[d];
+  else if (p[d]>max[d]) o = p[d] - max[d];
+  ret += o*o;
+ }
+ return ret;
+}
+
+// Closest point on a triangle stored as a corner and two edges to a point, by
+// working out which of the 7 regions, the inside, 3 edges or 3 corners, it is
+// nearest - see Ericson's Real-Time Collision Detection. Outputs the weights of
+// the second and third corners, returns the squared distance...
+inline real32 TriClosest(const real32 * t,const real32 * p,real32 & u,real32 & v)
+{
+ const real32 * e1 = t + 3;
+ const real32 * e2 = t + 6;
+ real32 ap[3] = {p[0]-t[0],p[1]-t[1],p[2]-t[2]};
+
+ real32 d1 = e1[0]*ap[0] + e1[1]*ap[1] + e1[2]*ap[2];
+ real32 d2 = e2[0]*ap[0] + e2[1]*ap[1] + e2[2]*ap[2];
+ real32 e11 = e1[0]*e1[0] + e1[1]*e1[1] + e1[2]*e1[2];
+ real32 e12 = e1[0]*e2[0] + e1[1]*e2[1] + e1[2]*e2[2];
+ real32 e22 = e2[0]*e2[0] + e2[1]*e2[1] + e2[2]*e2[2];
+
+ real32 d3 = d1 - e11; // Same again relative to corner b...
+ real32 d4 = d2 - e12;
+ real32 d5 = d1 - e12; // ...and relative to corner c.
+ real32 d6 = d2 - e22;
+
+ if ((d1<=0.0)&&(d2<=0.0)) {u = 0.0; v = 0.0;}
+ else if ((d3>=0.0)&&(d4<=d3)) {u = 1.0; v = 0.0;}
+ else if ((d6>=0.0)&&(d5<=d6)) {u = 0.0; v = 1.0;}
+ else
+ {
+  real32 vc = d1*d4 - d3*d2;
+  real32 vb = d5*d2 - d1*d6;
+  real32 va = d3*d6 - d5*d4;
+  if ((vc<=0.0)&&(d1>=0.0)&&(d3<=0.0)) {u = d1/(d1-d3); v = 0.0;}
+  else if ((vb<=0.0)&&(d2>=0.0)&&(d6<=0.0)) {u = 0.0; v = d2/(d2-d6);}
+  else if ((va<=0.0)&&(d4>=d3)&&(d5>=d6))
+  {
+   v = (d4-d3)/((d4-d3)+(d5-d6));
+   u = 1.0 - v;
+  }
+  else
+  {
+   real32 denom = 1.0/(va+vb+vc);
+   u = vb*denom;
+   v = vc*denom;
+  }
+ }
+
+ real32 ret = 0.0;
+ for (nat32 d=0;d<3;d++)
+ {
+  real32 o = ap[d] - u*e1[d] - v*e2[d];
+  ret += o*o;
+ }
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// Builds the tree. Works out the box and centre of every triangle then splits
+// recursively; the top of the tree is done serially, stopping at nodes small
+// enough, which are then built in parallel each into their own node array, and
+// copied in at the end...
+class BvhBuilder
+{
+ public:
+  BvhBuilder(Bvh & b):bvh(b) {}
+
+  void Run(const IndexedMesh & mesh)
+  {
+   nat32 n = mesh.TriCount();
+   bvh.order.Size(n);
+   if (n==0)
+   {
+    bvh.nodes.Size(0);
+    bvh.tri.Size(0);
+    return;
+   }
+   for (nat32 i=0;i<n;i++) bvh.order[i] = i;
+   bvh.Gather(mesh);
+
+   triMin.Size(n*3);
+   triMax.Size(n*3);
+   centre.Size(n*3);
+   pass = 0;
+   mt::ParallelFor(nat32(0),n,*this,1024);
+
+   // The top of the tree...
+    Nodes top;
+    top.Add(1);
+    nat32 jobSize = 0;
+    nat32 threads = mt::DefaultPool().Concurrency();
+    if ((threads>1)&&(n>4096)) jobSize = math::Max(n/(threads*8),nat32(1024));
+    jobs = 0;
+    Split(top,0,0,n,0,jobSize);
+
+   // The subtrees...
+    sub.Size(jobs);
+    pass = 1;
+    mt::ParallelFor(nat32(0),jobs,*this,1);
+
+   // Put it all together...
+    nat32 total = top.size;
+    for (nat32 j=0;j<jobs;j++) total += sub[j].size - 1;
+    bvh.nodes.Size(total);
+    for (nat32 i=0;i<top.size;i++) bvh.nodes[i] = top.data[i];
+
+    nat32 offset = top.size;
+    for (nat32 j=0;j<jobs;j++)
+    {
+     Nodes & part = sub[j];
+     for (nat32 i=0;i<part.size;i++)
+     {
+      Bvh::Node node = part.data[i];
+      if (node.count==0) node.first += offset - 1;
+      bvh.nodes[(i==0)?job[j].node:(offset+i-1)] = node;
+     }
+     offset += part.size - 1;
+    }
+    sub.Size(0);
+
+   // The triangles were in the order given, now they need to be in leaf
+   // order...
+    bvh.Gather(mesh);
+  }
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   if (pass==0)
+   {
+    for (nat32 i=b0;i<b1;i++)
+    {
+     const real32 * t = &bvh.tri[i*9];
+     for (nat32 d=0;d<3;d++)
+     {
+      real32 a = t[d];
+      real32 b = a + t[3+d];
+      real32 c = a + t[6+d];
+      triMin[i*3+d] = math::Min(a,b,c);
+      triMax[i*3+d] = math::Max(a,b,c);
+      centre[i*3+d] = 0.5*(triMin[i*3+d] + triMax[i*3+d]);
+     }
+    }
+   }
+   else
+   {
+    for (nat32 j=b0;j<b1;j++)
+    {
+     sub[j].Add(1);
+     Split(sub[j],0,job[j].begin,job[j].end,job[j].depth,0);
+    }
+   }
+  }
+
+
+ private:
+  Bvh & bvh;
+  nat32 pass;
+
+  ds::Array<real32> triMin; // 3 per triangle, by triangle index.
+  ds::Array<real32> triMax;
+  ds::Array<real32> centre;
+
+  // Growing array of nodes...
+   struct Nodes
+   {
+    Nodes():size(0) {}
+
+    ds::Array<Bvh::Node> data;
+    nat32 size;
+
+    nat32 Add(nat32 count)
+    {
+     nat32 ret = size;
+     size += count;
+     if (size>data.Size()) data.Size(math::Max(size,data.Size()*2));
+     return ret;
+    }
+   };
+
+  // A subtree waiting to be built - the node in the top of the tree it
+  // replaces and the range of triangles...
+   struct Job
+   {
+    nat32 node;
+    nat32 begin;
+    nat32 end;
+    nat32 depth;
+   };
+   nat32 jobs;
+   ds::Array<Job> job; // Capacity doubles as needed, jobs in use.
+   ds::ArrayDel<Nodes> sub; // Nodes of each job, root first.
+
+  // Makes node ni of the given triangle range, and all below it...
+   void Split(Nodes & nodes,nat32 ni,nat32 begin,nat32 end,nat32 depth,nat32 jobSize)
+   {
+    nat32 n = end - begin;
+    nat32 * order = bvh.order.Ptr();
+
+    // Bounds, of the triangles and their centres...
+     real32 min[3],max[3],cMin[3],cMax[3];
+     BoxEmpty(min,max);
+     BoxEmpty(cMin,cMax);
+     for (nat32 i=begin;i<end;i++)
+     {
+      nat32 t = order[i];
+      BoxGrow(min,max,&triMin[t*3],&triMax[t*3]);
+      BoxGrow(cMin,cMax,&centre[t*3],&centre[t*3]);
+     }
+     for (nat32 d=0;d<3;d++)
+     {
+      nodes.data[ni].min[d] = min[d];
+      nodes.data[ni].max[d] = max[d];
+     }
+
+    // Hand big enough nodes to the parallel stage...
+     if (n<=jobSize)
+     {
+      if (jobs==job.Size()) job.Size(math::Max(jobs*2,nat32(16)));
+      job[jobs].node = ni;
+      job[jobs].begin = begin;
+      job[jobs].end = end;
+      job[jobs].depth = depth;
+      ++jobs;
+      nodes.data[ni].first = 0;
+      nodes.data[ni].count = 0;
+      return;
+     }
+
+    // Small enough to just be a leaf...
+     if ((n<=2)||(depth>=bvhMaxDepth))
+     {
+      nodes.data[ni].first = begin;
+      nodes.data[ni].count = n;
+      return;
+     }
+
+    // Bin by centre on each axis, finding the best split...
+     nat32 bestAxis = 3;
+     nat32 bestBin = 0;
+     real32 bestCost = math::Infinity<real32>();
+     for (nat32 axis=0;axis<3;axis++)
+     {
+      real32 extent = cMax[axis] - cMin[axis];
+      if (!(extent>0.0)) continue;
+      real32 scale = real32(bvhBins)*0.9999/extent;
+
+      nat32 count[bvhBins];
+      real32 bMin[bvhBins][3];
+      real32 bMax[bvhBins][3];
+      for (nat32 b=0;b<bvhBins;b++)
+      {
+       count[b] = 0;
+       BoxEmpty(bMin[b],bMax[b]);
+      }
+
+      for (nat32 i=begin;i<end;i++)
+      {
+       nat32 t = order[i];
+       nat32 b = math::Min(nat32((centre[t*3+axis] - cMin[axis])*scale),bvhBins-1);
+       count[b] += 1;
+       BoxGrow(bMin[b],bMax[b],&triMin[t*3],&triMax[t*3]);
+      }
+
+      // Sweep from the right, storing area times count, then from the left...
+       real32 right[bvhBins];
+       real32 rMin[3],rMax[3];
+       BoxEmpty(rMin,rMax);
+       nat32 rCount = 0;
+       for (nat32 b=bvhBins-1;b>0;b--)
+       {
+        BoxGrow(rMin,rMax,bMin[b],bMax[b]);
+        rCount += count[b];
+        right[b] = (rCount==0)?0.0:(BoxArea(rMin,rMax)*real32(rCount));
+       }
+
+       real32 lMin[3],lMax[3];
+       BoxEmpty(lMin,lMax);
+       nat32 lCount = 0;
+       for (nat32 b=1;b<bvhBins;b++)
+       {
+        BoxGrow(lMin,lMax,bMin[b-1],bMax[b-1]);
+        lCount += count[b-1];
+        if ((lCount==0)||(lCount==n)) continue;
+
+        real32 cost = BoxArea(lMin,lMax)*real32(lCount) + right[b];
+        if (cost<bestCost)
+        {
+         bestCost = cost;
+         bestAxis = axis;
+         bestBin = b;
+        }
+       }
+     }
+
+    // Decide if its worth splitting - the cost of a leaf is the number of
+    // triangles, the cost of a split a box test plus the expected number of
+    // triangles tested, all relative to the area of this box...
+     nat32 mid;
+     if (bestAxis==3)
+     {
+      // All centres in the same place - split in half if too big...
+       if (n<=bvhMaxLeaf)
+       {
+        nodes.data[ni].first = begin;
+        nodes.data[ni].count = n;
+        return;
+       }
+       mid = begin + n/2;
+     }
+     else
+     {
+      real32 area = BoxArea(min,max);
+      real32 splitCost = (area>0.0)?(1.0 + bestCost/area):real32(n);
+      if ((splitCost>=real32(n))&&(n<=bvhMaxLeaf))
+      {
+       nodes.data[ni].first = begin;
+       nodes.data[ni].count = n;
+       return;
+      }
+
+      real32 extent = cMax[bestAxis] - cMin[bestAxis];
+      real32 scale = real32(bvhBins)*0.9999/extent;
+      nat32 i = begin;
+      nat32 j = end;
+      while (i<j)
+      {
+       nat32 t = order[i];
+       nat32 b = math::Min(nat32((centre[t*3+bestAxis] - cMin[bestAxis])*scale),bvhBins-1);
+       if (b<bestBin) ++i;
+       else
+       {
+        --j;
+        math::Swap(order[i],order[j]);
+       }
+      }
+      mid = i;
+     }
+
+    // Recurse...
+     nat32 c = nodes.Add(2);
+     nodes.data[ni].first = c;
+     nodes.data[ni].count = 0;
+     Split(nodes,c,begin,mid,depth+1,jobSize);
+     Split(nodes,c+1,mid,end,depth+1,jobSize);
+   }
+};
+
+//------------------------------------------------------------------------------
+// Copies the triangles into leaf order...
+class BvhGather
+{
+ public:
+  BvhGather(const IndexedMesh & m,const ds::Array<nat32> & o,ds::Array<real32> & t)
+  :mesh(m),order(o),tri(t)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   const real32 * x = mesh.X();
+   const real32 * y = mesh.Y();
+   const real32 * z = mesh.Z();
+   for (nat32 i=b0;i<b1;i++)
+   {
+    nat32 t = order[i];
+    nat32 a = mesh.Corner(t,0);
+    nat32 b = mesh.Corner(t,1);
+    nat32 c = mesh.Corner(t,2);
+
+    real32 * out = &tri[i*9];
+    out[0] = x[a]; out[1] = y[a]; out[2] = z[a];
+    out[3] = x[b]-x[a]; out[4] = y[b]-y[a]; out[5] = z[b]-z[a];
+    out[6] = x[c]-x[a]; out[7] = y[c]-y[a]; out[8] = z[c]-z[a];
+   }
+  }
+
+ private:
+  const IndexedMesh & mesh;
+  const ds::Array<nat32> & order;
+  ds::Array<real32> & tri;
+};
+
+// Recalculates the boxes of the leaves...
+class BvhLeafBoxes
+{
+ public:
+  BvhLeafBoxes(ds::Array<Bvh::Node> & n,const ds::Array<real32> & t)
+  :nodes(n),tri(t)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++)
+   {
+    Bvh::Node & node = nodes[i];
+    if (node.count==0) continue;
+
+    BoxEmpty(node.min,node.max);
+    for (nat32 j=node.first;j<node.first+node.count;j++)
+    {
+     const real32 * t = &tri[j*9];
+     for (nat32 d=0;d<3;d++)
+     {
+      real32 a = t[d];
+      node.min[d] = math::Min(node.min[d],a,a+t[3+d],a+t[6+d]);
+      node.max[d] = math::Max(node.max[d],a,a+t[3+d],a+t[6+d]);
+     }
+    }
+   }
+  }
+
+ private:
+  ds::Array<Bvh::Node> & nodes;
+  const ds::Array<real32> & tri;
+};
+
+// Does the packets in parallel...
+class BvhClosest
+{
+ public:
+  BvhClosest(const Bvh & b,const bs::Vert * p,Bvh::Hit * h,real32 md)
+  :bvh(b),point(p),hit(h),maxDist(md)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++)
+   {
+    if (!bvh.Closest(point[i],hit[i],maxDist)) hit[i].tri = nat32(-1);
+   }
+  }
+
+ private:
+  const Bvh & bvh;
+  const bs::Vert * point;
+  Bvh::Hit * hit;
+  real32 maxDist;
+};
+
+class BvhPackets
+{
+ public:
+  BvhPackets(const Bvh & b,nat32 c,const bs::Ray * r,Bvh::Hit * h,bit * a,real32 md)
+  :bvh(b),count(c),ray(r),hit(h),any(a),maxDist(md)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   Bvh::Hit temp[8];
+   for (nat32 p=b0;p<b1;p++)
+   {
+    nat32 first = p*8;
+    nat32 size = math::Min(count-first,nat32(8));
+    if (any)
+    {
+     bvh.Packet(size,ray+first,temp,maxDist,true);
+     for (nat32 i=0;i<size;i++) any[first+i] = temp[i].tri!=nat32(-1);
+    }
+    else bvh.Packet(size,ray+first,hit+first,maxDist,false);
+   }
+  }
+
+ private:
+  const Bvh & bvh;
+  nat32 count;
+  const bs::Ray * ray;
+  Bvh::Hit * hit;
+  bit * any;
+  real32 maxDist;
+};
+
+//------------------------------------------------------------------------------
+Bvh::Bvh()
+{}
+
+Bvh::~Bvh()
+{}
+
+void Bvh::Build(const IndexedMesh & mesh)
+{
+ LogTime("eos::sur::Bvh::Build");
+ BvhBuilder builder(*this);
+ builder.Run(mesh);
+}
+
+void Bvh::Build(const Mesh & mesh)
+{
+ IndexedMesh im;
+ im.FromMesh(mesh);
+ Build(im);
+}
+
+void Bvh::Refit(const IndexedMesh & mesh)
+{
+ LogTime("eos::sur::Bvh::Refit");
+ log::Assert(mesh.TriCount()==order.Size());
+ Gather(mesh);
+ Boxes();
+}
+
+void Bvh::Refit(const Mesh & mesh)
+{
+ IndexedMesh im;
+ im.FromMesh(mesh);
+ Refit(im);
+}
+
+nat64 Bvh::Memory() const
+{
+ nat64 ret = sizeof(Bvh);
+ ret += nat64(nodes.Size())*sizeof(Node);
+ ret += nat64(order.Size())*sizeof(nat32);
+ ret += nat64(tri.Size())*sizeof(real32);
+ return ret;
+}
+
+bit Bvh::Nearest(const bs::Ray & ray,Hit & out,real32 maxDist) const
+{
+ if (nodes.Size()==0) return false;
+
+ real32 inv[3];
+ RayInv(ray,inv);
+
+ real32 entry;
+ if (!BoxHit(nodes[0].min,nodes[0].max,ray,inv,maxDist,entry)) return false;
+
+ // Stack of nodes still to do, with their entry distance so they can be
+ // skipped if something closer turns up...
+  nat32 stack[bvhMaxDepth+4];
+  real32 stackEntry[bvhMaxDepth+4];
+  nat32 size = 0;
+
+  bit ret = false;
+  real32 best = maxDist;
+  nat32 ni = 0;
+  while (true)
+  {
+   const Node & node = nodes[ni];
+   if (node.count!=0)
+   {
+    for (nat32 i=node.first;i<node.first+node.count;i++)
+    {
+     real32 dist,u,v;
+     if (TriHit(&tri[i*9],ray,dist,u,v)&&(dist<best))
+     {
+      best = dist;
+      ret = true;
+      out.tri = order[i];
+      out.dist = dist;
+      out.w[0] = 1.0 - u - v;
+      out.w[1] = u;
+      out.w[2] = v;
+     }
+    }
+   }
+   else
+   {
+    real32 e0,e1;
+    bit h0 = BoxHit(nodes[node.first].min,nodes[node.first].max,ray,inv,best,e0);
+    bit h1 = BoxHit(nodes[node.first+1].min,nodes[node.first+1].max,ray,inv,best,e1);
+    if (h0&&h1)
+    {
+     if (e1<e0)
+     {
+      stack[size] = node.first; stackEntry[size] = e0; ++size;
+      ni = node.first+1;
+     }
+     else
+     {
+      stack[size] = node.first+1; stackEntry[size] = e1; ++size;
+      ni = node.first;
+     }
+     continue;
+    }
+    if (h0) {ni = node.first; continue;}
+    if (h1) {ni = node.first+1; continue;}
+   }
+
+   // Pop the next node that could still have something closer...
+    while ((size!=0)&&(stackEntry[size-1]>best)) --size;
+    if (size==0) break;
+    --size;
+    ni = stack[size];
+  }
+
+ return ret;
+}
+
+bit Bvh::Any(const bs::Ray & ray,real32 maxDist) const
+{
+ if (nodes.Size()==0) return false;
+
+ real32 inv[3];
+ RayInv(ray,inv);
+
+ nat32 stack[bvhMaxDepth+4];
+ nat32 size = 1;
+ stack[0] = 0;
+ while (size!=0)
+ {
+  --size;
+  const Node & node = nodes[stack[size]];
+
+  real32 entry;
+  if (!BoxHit(node.min,node.max,ray,inv,maxDist,entry)) continue;
+
+  if (node.count!=0)
+  {
+   for (nat32 i=node.first;i<node.first+node.count;i++)
+   {
+    real32 dist,u,v;
+    if (TriHit(&tri[i*9],ray,dist,u,v)&&(dist<maxDist)) return true;
+   }
+  }
+  else
+  {
+   stack[size++] = node.first+1;
+   stack[size++] = node.first;
+  }
+ }
+
+ return false;
+}
+
+bit Bvh::Closest(const bs::Vert & point,Hit & out,real32 maxDist) const
+{
+ if (nodes.Size()==0) return false;
+
+ real32 p[3] = {point[0],point[1],point[2]};
+ real32 best = (maxDist<math::Infinity<real32>())?(maxDist*maxDist):maxDist;
+ real32 entry = BoxDistSqr(nodes[0].min,nodes[0].max,p);
+ if (entry>=best) return false;
+
+ // Stack of nodes still to do, with their squared distance so they can be 
+ // skipped if something closer turns up. The nearer child is always done
+ // first...
+  nat32 stack[bvhMaxDepth+4];
+  real32 stackDist[bvhMaxDepth+4];
+  nat32 size = 0;
+
+  bit ret = false;
+  nat32 ni = 0;
+  while (true)
+  {
+   const Node & node = nodes[ni];
+   if (node.count!=0)
+   {
+    for (nat32 i=node.first;i<node.first+node.count;i++)
+    {
+     real32 u,v;
+     real32 dist = TriClosest(&tri[i*9],p,u,v);
+     if (dist<best)
+     {
+      best = dist;
+      ret = true;
+      out.tri = order[i];
+      out.dist = dist;
+      out.w[0] = 1.0 - u - v;
+      out.w[1] = u;
+      out.w[2] = v;
+     }
+    }
+   }
+   else
+   {
+    real32 e0 = BoxDistSqr(nodes[node.first].min,nodes[node.first].max,p);
+    real32 e1 = BoxDistSqr(nodes[node.first+1].min,nodes[node.first+1].max,p);
+    bit h0 = e0<best;
+    bit h1 = e1<best;
+    if (h0&&h1)
+    {
+     if (e1<e0)
+     {
+      stack[size] = node.first; stackDist[size] = e0; ++size;
+      ni = node.first+1;
+     }
+     else
+     {
+      stack[size] = node.first+1; stackDist[size] = e1; ++size;
+      ni = node.first;
+     }
+     continue;
+    }
+    if (h0) {ni = node.first; continue;}
+    if (h1) {ni = node.first+1; continue;}
+   }
+
+   // Pop the next node that could still have something closer...
+    while ((size!=0)&&(stackDist[size-1]>=best)) --size;
+    if (size==0) break;
+    --size;
+    ni = stack[size];
+  }
+
+ if (ret) out.dist = math::Sqrt(out.dist);
+ return ret;
+}
+
+void Bvh::Nearest(nat32 count,const bs::Ray * ray,Hit * out,real32 maxDist) const
+{
+ BvhPackets bp(*this,count,ray,out,null<bit*>(),maxDist);
+ mt::ParallelFor(nat32(0),(count+7)/8,bp,8);
+}
+
+void Bvh::Any(nat32 count,const bs::Ray * ray,bit * out,real32 maxDist) const
+{
+ BvhPackets bp(*this,count,ray,null<Hit*>(),out,maxDist);
+ mt::ParallelFor(nat32(0),(count+7)/8,bp,8);
+}
+
+void Bvh::Closest(nat32 count,const bs::Vert * point,Hit * out,real32 maxDist) const
+{
+ BvhClosest bc(*this,point,out,maxDist);
+ mt::ParallelFor(nat32(0),count,bc,256);
+}
+
+void Bvh::Gather(const IndexedMesh & mesh)
+{
+ tri.Size(order.Size()*9);
+ BvhGather bg(mesh,order,tri);
+ mt::ParallelFor(nat32(0),order.Size(),bg,1024);
+}
+
+void Bvh::Boxes()
+{
+ BvhLeafBoxes blb(nodes,tri);
+ mt::ParallelFor(nat32(0),nodes.Size(),blb,1024);
+
+ // Children are always after their parents, so going backwards does the
+ // children first...
+  for (int32 i=int32(nodes.Size())-1;i>=0;i--)
+  {
+   Node & node = nodes[i];
+   if (node.count!=0) continue;
+
+   for (nat32 d=0;d<3;d++)
+   {
+    node.min[d] = math::Min(nodes[node.first].min[d],nodes[node.first+1].min[d]);
+    node.max[d] = math::Max(nodes[node.first].max[d],nodes[node.first+1].max[d]);
+   }
+  }
+}
+
+void Bvh::Packet(nat32 count,const bs::Ray * ray,Hit * out,real32 maxDist,bit any) const
+{
+ real32 inv[8][3];
+ real32 best[8];
+ nat32 active = 0; // Bit mask of rays still going.
+ for (nat32 r=0;r<count;r++)
+ {
+  RayInv(ray[r],inv[r]);
+  best[r] = maxDist;
+  out[r].tri = nat32(-1);
+  active |= 1<<r;
+ }
+ if (nodes.Size()==0) return;
+
+ #ifdef __SSE__
+  // The rays as seperate component arrays - start, direction then 1 over
+  // direction - padded to 8 with copies of the first, for testing 4 at a time
+  // against each box and triangle...
+   real32 comp[9][8];
+   for (nat32 r=count;r<8;r++) best[r] = maxDist;
+   for (nat32 r=0;r<8;r++)
+   {
+    nat32 src = (r<count)?r:0;
+    for (nat32 d=0;d<3;d++)
+    {
+     comp[d][r] = ray[src].s[d];
+     comp[3+d][r] = ray[src].n[d];
+     comp[6+d][r] = inv[src][d];
+    }
+   }
+   const real32 * rs[2][3] = {{comp[0],comp[1],comp[2]},{comp[0]+4,comp[1]+4,comp[2]+4}};
+   const real32 * rn[2][3] = {{comp[3],comp[4],comp[5]},{comp[3]+4,comp[4]+4,comp[5]+4}};
+   const real32 * ri[2][3] = {{comp[6],comp[7],comp[8]},{comp[6]+4,comp[7]+4,comp[8]+4}};
+ #endif
+
+ // Each node is tested against every active ray, the ones that hit it being
+ // the ones that go further...
+  nat32 stack[bvhMaxDepth+4];
+  nat32 size = 1;
+  stack[0] = 0;
+  while ((size!=0)&&(active!=0))
+  {
+   --size;
+   const Node & node = nodes[stack[size]];
+
+   #ifdef __SSE__
+    nat32 mask = BoxHit4(node.min,node.max,rs[0],ri[0],best);
+    if (count>4) mask |= BoxHit4(node.min,node.max,rs[1],ri[1],best+4)<<4;
+    mask &= active;
+    if (mask==0) continue;
+    nat32 lead = 0;
+    while ((mask&(1<<lead))==0) ++lead;
+   #else
+    nat32 mask = 0;
+    nat32 lead = 8;
+    real32 entry;
+    for (nat32 r=0;r<count;r++)
+    {
+     if ((active&(1<<r))&&BoxHit(node.min,node.max,ray[r],inv[r],best[r],entry))
+     {
+      mask |= 1<<r;
+      if (lead==8) lead = r;
+     }
+    }
+    if (mask==0) continue;
+   #endif
+
+   if (node.count!=0)
+   {
+    for (nat32 i=node.first;i<node.first+node.count;i++)
+    {
+     #ifdef __SSE__
+      for (nat32 g=0;g<count;g+=4)
+      {
+       if (((mask>>g)&0xF)==0) continue;
+       real32 dist[4],u[4],v[4];
+       nat32 hit = TriHit4(&tri[i*9],rs[g/4],rn[g/4],best+g,dist,u,v) & (mask>>g) & 0xF;
+       for (nat32 j=0;hit!=0;j++,hit>>=1)
+       {
+        if ((hit&1)==0) continue;
+        nat32 r = g + j;
+        best[r] = dist[j];
+        out[r].tri = order[i];
+        out[r].dist = dist[j];
+        out[r].w[0] = 1.0 - u[j] - v[j];
+        out[r].w[1] = u[j];
+        out[r].w[2] = v[j];
+        if (any)
+        {
+         active &= ~(1<<r);
+         mask &= ~(1<<r);
+        }
+       }
+      }
+     #else
+      for (nat32 r=0;r<count;r++)
+      {
+       if ((mask&(1<<r))==0) continue;
+       real32 dist,u,v;
+       if (TriHit(&tri[i*9],ray[r],dist,u,v)&&(dist<best[r]))
+       {
+        best[r] = dist;
+        out[r].tri = order[i];
+        out[r].dist = dist;
+        out[r].w[0] = 1.0 - u - v;
+        out[r].w[1] = u;
+        out[r].w[2] = v;
+        if (any)
+        {
+         active &= ~(1<<r);
+         mask &= ~(1<<r);
+        }
+       }
+      }
+     #endif
+    }
+   }
+   else
+   {
+    // Do the child the first ray enters first first...
+     real32 e0,e1;
+     bit h0 = BoxHit(nodes[node.first].min,nodes[node.first].max,ray[lead],inv[lead],best[lead],e0);
+     bit h1 = BoxHit(nodes[node.first+1].min,nodes[node.first+1].max,ray[lead],inv[lead],best[lead],e1);
+     if (h1&&((!h0)||(e1<e0)))
+     {
+      stack[size++] = node.first;
+      stack[size++] = node.first+1;
+     }
+     else
+     {
+      stack[size++] = node.first+1;
+      stack[size++] = node.first;
+     }
+   }
+  }
+}
+
+//------------------------------------------------------------------------------
+ };
+};
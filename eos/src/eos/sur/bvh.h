@@ -0,0 +1,168 @@
+#ifndef EOS_SUR_BVH_H
+#define EOS_SUR_BVH_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file bvh.h
+/// Provides a bounding volume hierarchy over the triangles of a mesh, for fast
+/// ray casting and closest point queries.
+
+#include "eos/types.h"
+
+#include "eos/bs/geo3d.h"
+#include "eos/ds/arrays.h"
+#include "eos/sur/mesh.h"
+#include "eos/sur/indexed_mesh.h"
+
+namespace eos
+{
+ namespace sur
+ {
+//------------------------------------------------------------------------------
+/// A bounding volume hierarchy of axis aligned boxes over the triangles of a
+/// mesh, for intersecting rays with it, or finding the closest point on it, in
+/// logarithmic rather than linear time.
+/// Built top down using the surface area heuristic, binned, with the top of
+/// the tree done serially and the subtrees under it in parallel. It keeps its
+/// own copy of the triangles, so the mesh can go away after building, and
+/// stores them in the order the leaves need them, as a corner and two edges.
+///
+/// Triangles are numbered as in the IndexedMesh it was made from; when
+/// built from a Mesh they are numbered as IndexedMesh::FromMesh would number
+/// them, i.e. with bigger faces split into fans. Results match
+/// RayTriIntersect - double sided, distances in multiples of the length of
+/// the rays direction (which is normally 1), with the weights of the 3 corners.
+///
+/// If only the vertex positions change, e.g. when animating or smoothing, call
+/// Refit, which keeps the tree and recalculates the boxes - much faster than
+/// rebuilding, though the tree gets worse if vertices move a long way.
+class EOS_CLASS Bvh
+{
+ public:
+  /// The result of a ray cast or closest point query.
+   struct Hit
+   {
+    nat32 tri; ///< Index of the triangle hit, nat32(-1) for a miss.
+    real32 dist; ///< Distance along the ray, or from the point for Closest.
+    real32 w[3]; ///< Weights of the 3 corners of the triangle, sum to 1.
+   };
+
+
+  /// Starts empty, where nothing is ever hit.
+   Bvh();
+
+  /// &nbsp;
+   ~Bvh();
+
+
+  /// Builds it for the given mesh, replacing whatever it had.
+   void Build(const IndexedMesh & mesh);
+
+  /// Builds it for the given mesh, replacing whatever it had.
+   void Build(const Mesh & mesh);
+
+  /// Updates the triangle positions and boxes after the vertices of the mesh
+  /// it was built from have moved. The triangles must be unchanged.
+   void Refit(const IndexedMesh & mesh);
+
+  /// Updates the triangle positions and boxes after the vertices of the mesh
+  /// it was built from have moved. The faces must be unchanged.
+   void Refit(const Mesh & mesh);
+
+
+  /// Returns how many triangles it contains.
+   nat32 TriCount() const {return order.Size();}
+
+  /// Returns how many nodes it has, for the curious.
+   nat32 NodeCount() const {return nodes.Size();}
+
+  /// Returns how many bytes it is using, roughly.
+   nat64 Memory() const;
+
+
+  /// Finds the closest triangle a ray hits, closer than maxDist. Returns true
+  /// and fills in out if there is one, returns false and leaves out alone if
+  /// there is not.
+   bit Nearest(const bs::Ray & ray,Hit & out,real32 maxDist = math::Infinity<real32>()) const;
+
+  /// Returns true if the ray hits any triangle closer than maxDist, for
+  /// shadow rays and visibility tests. Faster than Nearest as it stops at the
+  /// first hit found.
+   bit Any(const bs::Ray & ray,real32 maxDist = math::Infinity<real32>()) const;
+
+  /// Nearest for lots of rays at once - they are traced in packets of 8, each
+  /// packet going through the tree together, with the packets done in
+  /// parallel. Packets work best when neighbouring rays go to similar places,
+  /// e.g. rays from a camera in scanline order. Misses get a tri of
+  /// nat32(-1).
+   void Nearest(nat32 count,const bs::Ray * ray,Hit * out,real32 maxDist = math::Infinity<real32>()) const;
+
+  /// Any for lots of rays at once, as for the packet version of Nearest.
+   void Any(nat32 count,const bs::Ray * ray,bit * out,real32 maxDist = math::Infinity<real32>()) const;
+
+
+  /// Finds the closest point on the surface to the given point, nearer than
+  /// maxDist. Returns true and fills in out if there is one, with dist being
+  /// the distance from the point to the surface and the weights giving the
+  /// closest point on the triangle. Returns false and leaves out alone if
+  /// nothing is within range.
+   bit Closest(const bs::Vert & point,Hit & out,real32 maxDist = math::Infinity<real32>()) const;
+
+  /// Closest for lots of points at once, done in parallel. Points with nothing
+  /// in range get a tri of nat32(-1).
+   void Closest(nat32 count,const bs::Vert * point,Hit * out,real32 maxDist = math::Infinity<real32>()) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::sur::Bvh";}
+
+
+ private:
+  friend class BvhBuilder;
+  friend class BvhPackets;
+  friend class BvhLeafBoxes;
+
+  // A node is a box, and either a leaf with count triangles from first, or has
+  // two children, at first and first+1, if count is 0. Children are always
+  // after their parent...
+   struct Node
+   {
+    real32 min[3];
+    real32 max[3];
+    nat32 first;
+    nat32 count;
+   };
+
+  ds::Array<Node> nodes;
+  ds::Array<nat32> order; // Index of each triangle as given, in leaf order.
+  ds::Array<real32> tri; // 9 per triangle in leaf order - corner a, then b-a, then c-a.
+
+  // Fills in tri from the given mesh, in parallel...
+   void Gather(const IndexedMesh & mesh);
+
+  // Recalculates the boxes of every node from tri...
+   void Boxes();
+
+  // Traces upto 8 rays together, for the packet versions...
+   void Packet(nat32 count,const bs::Ray * ray,Hit * out,real32 maxDist,bit any) const;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -38,6 +38,8 @@ namespace eos
 /// the sd.vert field, so if you sub-divide again it will not have to commit and 
 /// break the handles from the layer above the layer being sub-divided.
 /// Don't forget to delete the returned mesh when you are done with it.
+/// If you don't need the handles CatmullClark in indexed_subdivide.h is much
+/// faster.
 EOS_FUNC Mesh * Subdivide(Mesh & mesh);
 
 //------------------------------------------------------------------------------
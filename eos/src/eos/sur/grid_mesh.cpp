@@ -0,0 +1,248 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos/sur/grid_mesh.h"
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+
+namespace eos
+{
+ namespace sur
+ {
+//------------------------------------------------------------------------------
+// Does the work of GridMesh, as a sequence of passes each run in parallel over
+// rows, by setting pass and handing it to ParallelFor. Pass 0 marks the valid 
+// grid points, pass 1 decides the triangles of each row of squares and counts 
+// them, pass 2 marks and counts the points actually used, pass 3 writes the
+// vertices and pass 4 the triangles...
+struct GridBuild
+{
+ GridBuild(const svt::Field<bs::Vert> & p,const svt::Field<bit> & va,const svt::Field<real32> & d,
+           real32 ms,nat32 s,IndexedMesh & o,bit u)
+ :pos(p),valid(va),depth(d),maxStep(ms),stride(s),out(o),uv(u)
+ {
+  width = pos.Size(0)/stride;
+  height = pos.Size(1)/stride;
+ }
+
+ const svt::Field<bs::Vert> & pos;
+ const svt::Field<bit> & valid;
+ const svt::Field<real32> & depth;
+ real32 maxStep;
+ nat32 stride;
+ IndexedMesh & out;
+ bit uv;
+
+ nat32 width;
+ nat32 height;
+
+ ds::Array<byte> ok; // Per grid point, valid after pass 0, used after pass 2.
+ ds::Array<byte> quad; // Per square, a bit for each possible triangle - 1=a-b-c, 2=a-c-d, 4=a-b-d, 8=b-c-d.
+ ds::Array<nat32> rowTri; // Triangles in each row of squares, then the offset of each row.
+ ds::Array<nat32> rowVert; // Vertices in each row, then the offset of each row.
+ ds::Array<nat32> index; // Vertex of each grid point, only set for those used.
+ 
+ nat32 pass;
+
+
+ // True if the depth range of 3 grid points is acceptable...
+  bit Close(nat32 ax,nat32 ay,nat32 bx,nat32 by,nat32 cx,nat32 cy) const
+  {
+   real32 a = depth.Get(ax*stride,ay*stride);
+   real32 b = depth.Get(bx*stride,by*stride);
+   real32 c = depth.Get(cx*stride,cy*stride);
+   return (math::Max(a,b,c) - math::Min(a,b,c))<=maxStep;
+  }
+ 
+ void operator () (nat32 b0,nat32 b1)
+ {
+  switch (pass)
+  {
+   case 0:
+    for (nat32 y=b0;y<b1;y++)
+    {
+     for (nat32 x=0;x<width;x++) ok[y*width+x] = valid.Get(x*stride,y*stride)?1:0;
+    }
+   break;
+   case 1:
+    for (nat32 y=b0;y<b1;y++)
+    {
+     nat32 count = 0;
+     for (nat32 x=0;x+1<width;x++)
+     {
+      const byte * top = &ok[y*width+x];
+      const byte * bot = top + width;
+      byte code = 0;
+      if (top[0]&&top[1]&&bot[1]&&bot[0])
+      {
+       if (Close(x,y,x+1,y,x+1,y+1)) code |= 1;
+       if (Close(x,y,x+1,y+1,x,y+1)) code |= 2;
+      }
+      else
+      {
+       if (top[1]&&bot[0])
+       {
+        if (top[0])
+        {
+         if (Close(x,y,x+1,y,x,y+1)) code |= 4;
+        }
+        else
+        {
+         if (bot[1]&&Close(x+1,y,x+1,y+1,x,y+1)) code |= 8;
+        }
+       }
+      }
+      
+      quad[y*(width-1)+x] = code;
+      count += ((code&1)?1:0) + ((code&2)?1:0) + ((code&4)?1:0) + ((code&8)?1:0);
+     }
+     rowTri[y] = count;
+    }
+   break;
+   case 2:
+    for (nat32 y=b0;y<b1;y++)
+    {
+     // A point is corner a of the square to its bottom right, b of the one to
+     // its bottom left, c of the one to its top left and d of the one to its
+     // top right - check if any of the triangles that use it exist...
+      nat32 count = 0;
+      for (nat32 x=0;x<width;x++)
+      {
+       byte used = 0;
+       if (y+1<height)
+       {
+        if (x+1<width) used |= quad[y*(width-1)+x] & (1|2|4);
+        if (x!=0) used |= quad[y*(width-1)+x-1] & (1|4|8);
+       }
+       if (y!=0)
+       {
+        if (x!=0) used |= quad[(y-1)*(width-1)+x-1] & (1|2|8);
+        if (x+1<width) used |= quad[(y-1)*(width-1)+x] & (2|4|8);
+       }
+
+       ok[y*width+x] = (used!=0)?1:0;
+       if (used) ++count;
+      }
+      rowVert[y] = count;
+    }
+   break;
+   case 3:
+    for (nat32 y=b0;y<b1;y++)
+    {
+     nat32 v = rowVert[y];
+     for (nat32 x=0;x<width;x++)
+     {
+      if (ok[y*width+x]==0) continue;
+      index[y*width+x] = v;
+      out.SetPos(v,pos.Get(x*stride,y*stride));
+      if (uv) out.SetUV(v,bs::Tex2D(real32(x)/real32(width),1.0 - real32(y)/real32(height)));
+      ++v;
+     }
+    }
+   break;
+   case 4:
+    for (nat32 y=b0;y<b1;y++)
+    {
+     nat32 t = rowTri[y];
+     for (nat32 x=0;x+1<width;x++)
+     {
+      byte code = quad[y*(width-1)+x];
+      if (code==0) continue;
+
+      nat32 a = index[y*width+x];
+      nat32 b = index[y*width+x+1];
+      nat32 c = index[(y+1)*width+x+1];
+      nat32 d = index[(y+1)*width+x];
+      
+      if (code&1) out.SetTri(t++,a,b,c);
+      if (code&2) out.SetTri(t++,a,c,d);
+      if (code&4) out.SetTri(t++,a,b,d);
+      if (code&8) out.SetTri(t++,b,c,d);
+     }
+    }
+   break;
+  }
+ }
+ 
+ void Run()
+ {
+  if ((width<2)||(height<2))
+  {
+   out.Setup(0,0);
+   return;
+  }
+  
+  ok.Size(width*height);
+  quad.Size((width-1)*(height-1));
+  rowTri.Size(height);
+  rowVert.Size(height);
+  index.Size(width*height);
+  
+  pass = 0;
+  mt::ParallelFor(nat32(0),height,*this,8);
+  
+  pass = 1;
+  mt::ParallelFor(nat32(0),height-1,*this,8);
+  
+  pass = 2;
+  mt::ParallelFor(nat32(0),height,*this,8);
+  
+  // Offsets...
+   nat32 tris = 0;
+   for (nat32 y=0;y+1<height;y++)
+   {
+    nat32 c = rowTri[y];
+    rowTri[y] = tris;
+    tris += c;
+   }
+   
+   nat32 verts = 0;
+   for (nat32 y=0;y<height;y++)
+   {
+    nat32 c = rowVert[y];
+    rowVert[y] = verts;
+    verts += c;
+   }
+ 
+  out.Setup(verts,tris);
+  if (uv) out.EnableUV();
+  
+  pass = 3;
+  mt::ParallelFor(nat32(0),height,*this,8);
+  
+  pass = 4;
+  mt::ParallelFor(nat32(0),height-1,*this,8);
+  
+  out.BuildAdjacency();
+ }
+};
+
+//------------------------------------------------------------------------------
+EOS_FUNC void GridMesh(const svt::Field<bs::Vert> & pos,const svt::Field<bit> & valid,
+                       const svt::Field<real32> & depth,real32 maxStep,nat32 stride,
+                       IndexedMesh & out,bit uv)
+{
+ LogTime("eos::sur::GridMesh");
+ 
+ GridBuild gb(pos,valid,depth,maxStep,stride,out,uv);
+ gb.Run();
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,56 @@
+#ifndef EOS_SUR_GRID_MESH_H
+#define EOS_SUR_GRID_MESH_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+/// \file grid_mesh.h
+/// Provides conversion of a grid of 3D points, as made from a disparity or
+/// depth map, directly into an IndexedMesh, in parallel.
+
+#include "eos/types.h"
+#include "eos/svt/field.h"
+#include "eos/sur/indexed_mesh.h"
+
+namespace eos
+{
+ namespace sur
+ {
+//------------------------------------------------------------------------------
+/// Triangulates a grid of 3D points, such as a disparity map converted to
+/// positions, writing the result into out. Every stride'th point in each
+/// dimension is used, i.e. grid point (x,y) is at (x*stride,y*stride) in the
+/// fields, and is only used if valid is true for it. Each grid square is 
+/// split into two triangles, a-b-c and a-c-d where a is the top left and the 
+/// rest go round from there; when a or c is invalid but the other three are
+/// valid then the square becomes the single triangle b-d makes with them
+/// instead. A triangle is only made if its three corners are valid and the 
+/// range of depth values at its corners is no more than maxStep, so
+/// triangles are not made between the sides of a discontinuity. depth is
+/// typically the disparity. Only vertices used by a triangle are output, in
+/// grid order. If uv is true texture coordinates are set from the grid 
+/// position, u=x/width and v=1-y/height, width and height being the grid size.
+/// Done in parallel by rows, with the output allocated once at its final size. 
+EOS_FUNC void GridMesh(const svt::Field<bs::Vert> & pos,const svt::Field<bit> & valid,
+                       const svt::Field<real32> & depth,real32 maxStep,nat32 stride,
+                       IndexedMesh & out,bit uv = true);
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
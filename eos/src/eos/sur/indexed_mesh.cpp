@@ -0,0 +1,396 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos/sur/indexed_mesh.h"
+
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+
+namespace eos
+{
+ namespace sur
+ {
+//------------------------------------------------------------------------------
+// Calculates the area weighted normal of a range of triangles, i.e. the
+// unnormalised cross product...
+class TriNormalRange
+{
+ public:
+  TriNormalRange(const IndexedMesh & m,ds::Array<real32> & o)
+  :mesh(m),out(o)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   const real32 * x = mesh.X();
+   const real32 * y = mesh.Y();
+   const real32 * z = mesh.Z();
+   const nat32 * tri = mesh.Tris();
+   for (nat32 t=b0;t<b1;t++)
+   {
+    nat32 a = tri[t*3];
+    nat32 b = tri[t*3+1];
+    nat32 c = tri[t*3+2];
+
+    real32 ab[3] = {x[b]-x[a],y[b]-y[a],z[b]-z[a]};
+    real32 ac[3] = {x[c]-x[a],y[c]-y[a],z[c]-z[a]};
+
+    out[t*3]   = ab[1]*ac[2] - ab[2]*ac[1];
+    out[t*3+1] = ab[2]*ac[0] - ab[0]*ac[2];
+    out[t*3+2] = ab[0]*ac[1] - ab[1]*ac[0];
+   }
+  }
+
+ private:
+  const IndexedMesh & mesh;
+  ds::Array<real32> & out;
+};
+
+// Sums the triangle normals around each vertex in a range, using the
+// adjacency so each vertex is only written by one range...
+class VertNormalRange
+{
+ public:
+  VertNormalRange(IndexedMesh & m,const ds::Array<real32> & tn)
+  :mesh(m),triNorm(tn)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 v=b0;v<b1;v++)
+   {
+    real64 n[3] = {0.0,0.0,0.0};
+    nat32 count = mesh.FaceCount(v);
+    for (nat32 i=0;i<count;i++)
+    {
+     nat32 t = mesh.Face(v,i);
+     n[0] += triNorm[t*3];
+     n[1] += triNorm[t*3+1];
+     n[2] += triNorm[t*3+2];
+    }
+
+    real64 len = math::Sqrt(math::Sqr(n[0]) + math::Sqr(n[1]) + math::Sqr(n[2]));
+    if (!math::IsZero(len))
+    {
+     n[0] /= len; n[1] /= len; n[2] /= len;
+    }
+    mesh.SetNorm(v,bs::Normal(n[0],n[1],n[2]));
+   }
+  }
+
+ private:
+  IndexedMesh & mesh;
+  const ds::Array<real32> & triNorm;
+};
+
+//------------------------------------------------------------------------------
+IndexedMesh::IndexedMesh()
+{}
+
+IndexedMesh::~IndexedMesh()
+{}
+
+void IndexedMesh::Setup(nat32 vertices,nat32 triangles)
+{
+ x.Size(vertices);
+ y.Size(vertices);
+ z.Size(vertices);
+
+ if (HasNormals())
+ {
+  nx.Size(vertices);
+  ny.Size(vertices);
+  nz.Size(vertices);
+ }
+
+ if (HasUV())
+ {
+  u.Size(vertices);
+  v.Size(vertices);
+ }
+
+ tri.Size(triangles*3);
+
+ adjStart.Size(0);
+ adjFace.Size(0);
+}
+
+void IndexedMesh::Clear()
+{
+ x.Size(0); y.Size(0); z.Size(0);
+ nx.Size(0); ny.Size(0); nz.Size(0);
+ u.Size(0); v.Size(0);
+ tri.Size(0);
+ adjStart.Size(0);
+ adjFace.Size(0);
+}
+
+void IndexedMesh::EnableNormals()
+{
+ if (HasNormals()) return;
+ nx.Size(x.Size());
+ ny.Size(x.Size());
+ nz.Size(x.Size());
+}
+
+void IndexedMesh::CalcNormals()
+{
+ LogTime("eos::sur::IndexedMesh::CalcNormals");
+ EnableNormals();
+ if (!HasAdjacency()) BuildAdjacency();
+
+ ds::Array<real32> triNorm(tri.Size());
+ TriNormalRange tnr(*this,triNorm);
+ mt::ParallelFor(nat32(0),TriCount(),tnr,1024);
+
+ VertNormalRange vnr(*this,triNorm);
+ mt::ParallelFor(nat32(0),VertexCount(),vnr,1024);
+}
+
+void IndexedMesh::EnableUV()
+{
+ if (HasUV()) return;
+ u.Size(x.Size());
+ v.Size(x.Size());
+ for (nat32 i=0;i<u.Size();i++)
+ {
+  u[i] = 0.0;
+  v[i] = 0.0;
+ }
+}
+
+void IndexedMesh::BuildAdjacency()
+{
+ LogTime("eos::sur::IndexedMesh::BuildAdjacency");
+
+ // Count the users of each vertex, offset by one...
+  adjStart.Size(x.Size()+1);
+  for (nat32 i=0;i<adjStart.Size();i++) adjStart[i] = 0;
+  for (nat32 i=0;i<tri.Size();i++) adjStart[tri[i]+1] += 1;
+
+ // Convert to offsets...
+  for (nat32 i=1;i<adjStart.Size();i++) adjStart[i] += adjStart[i-1];
+
+ // Fill in, going through the triangles in order so each list is sorted...
+  adjFace.Size(tri.Size());
+  ds::Array<nat32> pos(x.Size());
+  for (nat32 i=0;i<pos.Size();i++) pos[i] = adjStart[i];
+  for (nat32 i=0;i<tri.Size();i++)
+  {
+   nat32 & p = pos[tri[i]];
+   adjFace[p] = i/3;
+   ++p;
+  }
+}
+
+void IndexedMesh::FromMesh(const Mesh & in)
+{
+ LogTime("eos::sur::IndexedMesh::FromMesh");
+ Clear();
+
+ // Vertices, using the index field so faces can find them...
+  nat32 vertCount = in.verts.Size();
+  x.Size(vertCount);
+  y.Size(vertCount);
+  z.Size(vertCount);
+
+  data::Property<sur::Vertex,real32> propU;
+  data::Property<sur::Vertex,real32> propV;
+  if (in.tt&&in.ExistsVertProp("u")&&in.ExistsVertProp("v"))
+  {
+   propU = in.GetVertProp<real32>("u");
+   propV = in.GetVertProp<real32>("v");
+   u.Size(vertCount);
+   v.Size(vertCount);
+  }
+
+  {
+   ds::SortList<Mesh::Vertex*>::Cursor targ = in.verts.FrontPtr();
+   for (nat32 i=0;i<vertCount;i++)
+   {
+    Mesh::Vertex * vert = *targ;
+    vert->ind = i;
+    x[i] = vert->pos[0];
+    y[i] = vert->pos[1];
+    z[i] = vert->pos[2];
+    if (HasUV())
+    {
+     u[i] = propU.Get(sur::Vertex(vert));
+     v[i] = propV.Get(sur::Vertex(vert));
+    }
+    ++targ;
+   }
+  }
+
+
+ // Faces, fanning out anything bigger than a triangle...
+  nat32 triCount = 0;
+  {
+   ds::SortList<Mesh::Face*>::Cursor targ = in.faces.FrontPtr();
+   while (!targ.Bad())
+   {
+    if ((*targ)->size>2) triCount += (*targ)->size - 2;
+    ++targ;
+   }
+  }
+
+  tri.Size(triCount*3);
+  {
+   nat32 t = 0;
+   ds::SortList<Mesh::Face*>::Cursor targ = in.faces.FrontPtr();
+   while (!targ.Bad())
+   {
+    Mesh::HalfEdge * start = (*targ)->edge;
+    nat32 first = start->edge->to->ind;
+    Mesh::HalfEdge * he = start->chain;
+    nat32 prev = he->edge->to->ind;
+    he = he->chain;
+    while (he!=start)
+    {
+     nat32 curr = he->edge->to->ind;
+     tri[t*3] = first;
+     tri[t*3+1] = prev;
+     tri[t*3+2] = curr;
+     ++t;
+
+     prev = curr;
+     he = he->chain;
+    }
+    ++targ;
+   }
+  }
+
+
+ BuildAdjacency();
+}
+
+void IndexedMesh::ToMesh(Mesh & out) const
+{
+ LogTime("eos::sur::IndexedMesh::ToMesh");
+
+ // Make sure the properties exist before creating anything, as the commit
+ // invalidates handles...
+  bit doUV = HasUV() && (out.tt!=null<str::TokenTable*>());
+  if (doUV)
+  {
+   real32 realIni = 0.0;
+   bit change = false;
+   if (!out.ExistsVertProp("u")) {out.AddVertProp("u",realIni); change = true;}
+   if (!out.ExistsVertProp("v")) {out.AddVertProp("v",realIni); change = true;}
+   if (change) out.Commit();
+  }
+
+  data::Property<sur::Vertex,real32> propU;
+  data::Property<sur::Vertex,real32> propV;
+  if (doUV)
+  {
+   propU = out.GetVertProp<real32>("u");
+   propV = out.GetVertProp<real32>("v");
+  }
+
+
+ // Vertices...
+  ds::Array<sur::Vertex> vert(VertexCount());
+  for (nat32 i=0;i<vert.Size();i++)
+  {
+   vert[i] = out.NewVertex(Pos(i));
+   if (doUV)
+   {
+    propU.Get(vert[i]) = u[i];
+    propV.Get(vert[i]) = v[i];
+   }
+  }
+
+
+ // Faces...
+  for (nat32 t=0;t<TriCount();t++)
+  {
+   out.NewFace(vert[tri[t*3]],vert[tri[t*3+1]],vert[tri[t*3+2]]);
+  }
+}
+
+void IndexedMesh::Store(file::Wavefront & out) const
+{
+ if (VertexCount()==0) return;
+
+ // Vertices and their extras, remembering the first index of each as the
+ // file numbers from 1...
+  nat32 baseVert = 0;
+  nat32 baseNorm = 0;
+  nat32 baseUV = 0;
+  for (nat32 i=0;i<VertexCount();i++)
+  {
+   nat32 ind = out.Add(Pos(i));
+   if (i==0) baseVert = ind;
+   if (HasNormals())
+   {
+    ind = out.Add(Norm(i));
+    if (i==0) baseNorm = ind;
+   }
+   if (HasUV())
+   {
+    ind = out.Add(UV(i));
+    if (i==0) baseUV = ind;
+   }
+  }
+
+
+ // Faces...
+  for (nat32 t=0;t<TriCount();t++)
+  {
+   for (nat32 c=0;c<3;c++)
+   {
+    nat32 vi = tri[t*3+c];
+    out.Add(baseVert+vi,HasNormals()?(baseNorm+vi):0,HasUV()?(baseUV+vi):0);
+   }
+   out.Face();
+  }
+}
+
+void IndexedMesh::Store(file::Ply & out) const
+{
+ if (VertexCount()==0) return;
+
+ // Vertices...
+  nat32 base = 0;
+  for (nat32 i=0;i<VertexCount();i++)
+  {
+   nat32 ind = out.Add(Pos(i),HasUV()?UV(i):bs::Tex2D(0.0,0.0));
+   if (i==0) base = ind;
+  }
+
+
+ // Faces...
+  for (nat32 t=0;t<TriCount();t++)
+  {
+   for (nat32 c=0;c<3;c++) out.Add(base+tri[t*3+c]);
+   out.Face();
+  }
+}
+
+nat64 IndexedMesh::Memory() const
+{
+ nat64 ret = sizeof(IndexedMesh);
+ ret += nat64(x.Size() + nx.Size() + u.Size())*nat64(sizeof(real32)*3);
+ ret += nat64(tri.Size() + adjStart.Size() + adjFace.Size())*nat64(sizeof(nat32));
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,208 @@
+#ifndef EOS_SUR_INDEXED_MESH_H
+#define EOS_SUR_INDEXED_MESH_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file indexed_mesh.h
+/// Provides a compact triangle mesh, of flat arrays indexed by vertex and
+/// triangle number. The opposite of Mesh - next to useless for editting, but
+/// cheap to store and fast to traverse, for rendering, saving and the like.
+
+#include "eos/types.h"
+
+#include "eos/bs/geo3d.h"
+#include "eos/ds/arrays.h"
+#include "eos/sur/mesh.h"
+#include "eos/file/wavefront.h"
+#include "eos/file/ply.h"
+
+namespace eos
+{
+ namespace sur
+ {
+//------------------------------------------------------------------------------
+/// A triangle mesh stored as flat arrays. Vertex positions are stored as
+/// seperate x, y and z arrays, as are the optional normals, with optional
+/// texture coordinates; triangles are 3 vertex indices each, anti-clockwise.
+/// Optionally it also stores the faces that use each vertex, in compressed
+/// row form - an offset per vertex into one big array of triangle indices.
+/// About 12 bytes a vertex and 12 a triangle without the extras, against
+/// several hundred for a Mesh.
+///
+/// Converts to and from a Mesh, which is also how you load one. Anything that
+/// changes the triangles invalidates the adjacency, which has to be rebuilt
+/// with BuildAdjacency, though CalcNormals does this itself if needed.
+class EOS_CLASS IndexedMesh
+{
+ public:
+  /// Starts empty.
+   IndexedMesh();
+
+  /// &nbsp;
+   ~IndexedMesh();
+
+
+  /// Resizes to the given number of vertices and triangles, with all contents
+  /// arbitary. Normals and texture coordinates are kept or dropped as they
+  /// were, resized to match, and the adjacency is dropped.
+   void Setup(nat32 vertices,nat32 triangles);
+
+  /// Empties it, including dropping normals and texture coordinates.
+   void Clear();
+
+
+  /// &nbsp;
+   nat32 VertexCount() const {return x.Size();}
+
+  /// &nbsp;
+   nat32 TriCount() const {return tri.Size()/3;}
+
+
+  /// Returns the position of a vertex.
+   bs::Vert Pos(nat32 v) const {return bs::Vert(x[v],y[v],z[v]);}
+
+  /// Sets the position of a vertex.
+   void SetPos(nat32 v,const bs::Vert & pos) {x[v] = pos[0]; y[v] = pos[1]; z[v] = pos[2];}
+
+  /// The x coordinates of the vertices, VertexCount() of them.
+   const real32 * X() const {return x.Ptr();}
+
+  /// The y coordinates of the vertices, VertexCount() of them.
+   const real32 * Y() const {return y.Ptr();}
+
+  /// The z coordinates of the vertices, VertexCount() of them.
+   const real32 * Z() const {return z.Ptr();}
+
+
+  /// Returns the index of corner c, of 0..2, of triangle t.
+   nat32 Corner(nat32 t,nat32 c) const {return tri[t*3+c];}
+
+  /// Sets a triangle, anti-clockwise. Invalidates the adjacency.
+   void SetTri(nat32 t,nat32 a,nat32 b,nat32 c)
+   {
+    tri[t*3] = a; tri[t*3+1] = b; tri[t*3+2] = c;
+    adjStart.Size(0);
+   }
+
+  /// All the triangles, 3 indices each, TriCount()*3 of them.
+   const nat32 * Tris() const {return tri.Ptr();}
+
+  /// Outputs the positions of the corners of a triangle.
+   void GetTri(nat32 t,bs::Vert & a,bs::Vert & b,bs::Vert & c) const
+   {
+    a = Pos(tri[t*3]); b = Pos(tri[t*3+1]); c = Pos(tri[t*3+2]);
+   }
+
+
+  /// Returns true if there are normals.
+   bit HasNormals() const {return nx.Size()!=0;}
+
+  /// Creates normals, with arbitary values, if there are none.
+   void EnableNormals();
+
+  /// Calculates the normal of every vertex, as the area weighted average of
+  /// the triangles that use it, with zero length for unused vertices. Creates
+  /// them if need be, and builds the adjacency if its not valid.
+   void CalcNormals();
+
+  /// Returns the normal of a vertex. Only valid if HasNormals().
+   bs::Normal Norm(nat32 v) const {return bs::Normal(nx[v],ny[v],nz[v]);}
+
+  /// Sets the normal of a vertex. Only valid if HasNormals().
+   void SetNorm(nat32 v,const bs::Normal & norm) {nx[v] = norm[0]; ny[v] = norm[1]; nz[v] = norm[2];}
+
+
+  /// Returns true if there are texture coordinates.
+   bit HasUV() const {return u.Size()!=0;}
+
+  /// Creates texture coordinates, all zero, if there are none.
+   void EnableUV();
+
+  /// Returns the texture coordinate of a vertex. Only valid if HasUV().
+   bs::Tex2D UV(nat32 v) const {return bs::Tex2D(u[v],this->v[v]);}
+
+  /// Sets the texture coordinate of a vertex. Only valid if HasUV().
+   void SetUV(nat32 vert,const bs::Tex2D & uv) {u[vert] = uv[0]; v[vert] = uv[1];}
+
+
+  /// Builds the vertex to triangle adjacency.
+   void BuildAdjacency();
+
+  /// Returns true if the adjacency is valid.
+   bit HasAdjacency() const {return (adjStart.Size()!=0)||(x.Size()==0);}
+
+  /// Returns how many triangles use a vertex. Only valid if HasAdjacency().
+   nat32 FaceCount(nat32 v) const {return adjStart[v+1] - adjStart[v];}
+
+  /// Returns the i-th triangle to use a vertex, in increasing order. Only
+  /// valid if HasAdjacency().
+   nat32 Face(nat32 v,nat32 i) const {return adjFace[adjStart[v]+i];}
+
+
+  /// Replaces the contents with the given Mesh, in the order of its vertices
+  /// and faces. Faces with more than 3 sides are split into a fan of
+  /// triangles, as Mesh::Triangulate would. If the mesh has "u" and "v"
+  /// properties they become texture coordinates, otherwise there are none.
+  /// Normals are dropped, and the adjacency is built.
+   void FromMesh(const Mesh & in);
+
+  /// Adds the contents to the given Mesh - it does not have to be empty. If
+  /// there are texture coordinates and the Mesh has a token table they are
+  /// put in "u" and "v" vertex properties, which are created if need be.
+   void ToMesh(Mesh & out) const;
+
+
+  /// Writes the mesh to the wavefront file object, with normals and texture
+  /// coordinates if present.
+   void Store(file::Wavefront & out) const;
+
+  /// Writes the mesh to the ply file object, with texture coordinates if
+  /// present.
+   void Store(file::Ply & out) const;
+
+
+  /// Returns how many bytes of memory it is using, roughly.
+   nat64 Memory() const;
+
+
+  /// &nbsp;
+   static cstrconst TypeString() {return "eos::sur::IndexedMesh";}
+
+
+ private:
+  ds::Array<real32> x;
+  ds::Array<real32> y;
+  ds::Array<real32> z;
+
+  ds::Array<real32> nx; // Empty if no normals.
+  ds::Array<real32> ny;
+  ds::Array<real32> nz;
+
+  ds::Array<real32> u; // Empty if no texture coordinates.
+  ds::Array<real32> v;
+
+  ds::Array<nat32> tri; // 3 per triangle.
+
+  ds::Array<nat32> adjStart; // VertexCount()+1 if valid, empty if not.
+  ds::Array<nat32> adjFace;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
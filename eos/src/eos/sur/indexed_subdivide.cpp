@@ -0,0 +1,668 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos/sur/indexed_subdivide.h"
+
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
+
+namespace eos
+{
+ namespace sur
+ {
+//------------------------------------------------------------------------------
+// Calls a method of an object for each range, so the steps below can be
+// methods rather than a class each...
+template <typename T,void (T::*M)(nat32,nat32)>
+class RangeCall
+{
+ public:
+  RangeCall(T & o):obj(o) {}
+
+  void operator () (nat32 b0,nat32 b1) {(obj.*M)(b0,b1);}
+
+ private:
+  T & obj;
+};
+
+template <typename T,void (T::*M)(nat32,nat32)>
+inline void ParallelCall(T & obj,nat32 size,nat32 grain)
+{
+ RangeCall<T,M> rc(obj);
+ mt::ParallelFor(nat32(0),size,rc,grain);
+}
+
+//------------------------------------------------------------------------------
+// A polygon mesh with all the connectivity subdivision needs, in compressed
+// row form - the faces using each vertex and the edges, each stored with its
+// lowest vertex and numbered in that order. Used for each level in turn...
+class SubMesh
+{
+ public:
+  SubMesh():hasUV(false) {}
+
+  // Vertex data, 3 or 2 per vertex...
+   ds::Array<real32> pos;
+   bit hasUV;
+   ds::Array<real32> uv;
+
+  // Faces, as the offset of each ones first corner, plus the end...
+   ds::Array<nat32> faceStart;
+   ds::Array<nat32> corner; // Vertex of each corner.
+
+  // Connectivity, made by Build...
+   ds::Array<nat32> cornerFace; // Face of each corner.
+   ds::Array<nat32> cornerEdge; // Edge from each corner to the next.
+   ds::Array<nat32> vertStart; // Offsets into vertCorner, VertexCount()+1.
+   ds::Array<nat32> vertCorner; // Corners that use each vertex.
+   ds::Array<nat32> edgeStart; // Offsets into edgeOther, VertexCount()+1.
+   ds::Array<nat32> edgeOther; // Higher vertex of each edge, sorted per vertex.
+   ds::Array<nat32> edgeFaces; // How many faces use each edge.
+
+
+  nat32 VertexCount() const {return pos.Size()/3;}
+  nat32 FaceCount() const {return faceStart.Size()-1;}
+  nat32 CornerCount() const {return corner.Size();}
+  nat32 EdgeCount() const {return edgeOther.Size();}
+
+  // The corners after and before a corner in its face...
+   nat32 Next(nat32 c) const
+   {
+    nat32 f = cornerFace[c];
+    return (c+1==faceStart[f+1])?faceStart[f]:(c+1);
+   }
+
+   nat32 Prev(nat32 c) const
+   {
+    nat32 f = cornerFace[c];
+    return (c==faceStart[f])?(faceStart[f+1]-1):(c-1);
+   }
+
+  // Returns the edge between two vertices, which must exist...
+   nat32 FindEdge(nat32 a,nat32 b) const
+   {
+    if (a>b) math::Swap(a,b);
+    nat32 low = edgeStart[a];
+    nat32 high = edgeStart[a+1];
+    while (low+1<high)
+    {
+     nat32 half = (low+high)/2;
+     if (edgeOther[half]>b) high = half;
+                       else low = half;
+    }
+    return low;
+   }
+
+  // Fills in the sorted, unique, neighbours of a vertex, returning how many...
+   nat32 Neighbours(nat32 v,ds::Array<nat32> & out) const
+   {
+    nat32 size = 0;
+    nat32 need = 2*(vertStart[v+1]-vertStart[v]);
+    if (out.Size()<need) out.Size(need*2);
+
+    for (nat32 i=vertStart[v];i<vertStart[v+1];i++)
+    {
+     nat32 c = vertCorner[i];
+     out[size++] = corner[Next(c)];
+     out[size++] = corner[Prev(c)];
+    }
+
+    // Insertion sort, as its normally about a dozen...
+     for (nat32 i=1;i<size;i++)
+     {
+      nat32 val = out[i];
+      nat32 j = i;
+      while ((j>0)&&(out[j-1]>val)) {out[j] = out[j-1]; --j;}
+      out[j] = val;
+     }
+
+    nat32 unique = 0;
+    for (nat32 i=0;i<size;i++)
+    {
+     if ((out[i]!=v)&&((unique==0)||(out[unique-1]!=out[i]))) out[unique++] = out[i];
+    }
+    return unique;
+   }
+
+
+  // Builds all the connectivity from the vertices and faces...
+   void Build()
+   {
+    // Face of each corner...
+     cornerFace.Size(CornerCount());
+     ParallelCall<SubMesh,&SubMesh::FillCornerFace>(*this,FaceCount(),1024);
+
+    // Corners of each vertex, a counting sort so they stay in order...
+     vertStart.Size(VertexCount()+1);
+     for (nat32 i=0;i<vertStart.Size();i++) vertStart[i] = 0;
+     for (nat32 i=0;i<corner.Size();i++) vertStart[corner[i]+1] += 1;
+     for (nat32 i=1;i<vertStart.Size();i++) vertStart[i] += vertStart[i-1];
+
+     vertCorner.Size(CornerCount());
+     {
+      ds::Array<nat32> fill(VertexCount());
+      for (nat32 i=0;i<fill.Size();i++) fill[i] = vertStart[i];
+      for (nat32 i=0;i<corner.Size();i++) vertCorner[fill[corner[i]]++] = i;
+     }
+
+    // Edges, counting then filling in...
+     edgeStart.Size(VertexCount()+1);
+     edgeStart[0] = 0;
+     fillEdges = false;
+     ParallelCall<SubMesh,&SubMesh::FillEdges>(*this,VertexCount(),256);
+     for (nat32 i=1;i<edgeStart.Size();i++) edgeStart[i] += edgeStart[i-1];
+
+     edgeOther.Size(edgeStart[VertexCount()]);
+     fillEdges = true;
+     ParallelCall<SubMesh,&SubMesh::FillEdges>(*this,VertexCount(),256);
+
+    // Edge of each corner, and how many faces each edge has...
+     cornerEdge.Size(CornerCount());
+     ParallelCall<SubMesh,&SubMesh::FillCornerEdge>(*this,FaceCount(),1024);
+
+     edgeFaces.Size(EdgeCount());
+     ParallelCall<SubMesh,&SubMesh::FillEdgeFaces>(*this,VertexCount(),1024);
+   }
+
+
+ private:
+  bit fillEdges; // Which pass FillEdges is doing.
+
+  void FillCornerFace(nat32 b0,nat32 b1)
+  {
+   for (nat32 f=b0;f<b1;f++)
+   {
+    for (nat32 c=faceStart[f];c<faceStart[f+1];c++) cornerFace[c] = f;
+   }
+  }
+
+  void FillEdges(nat32 b0,nat32 b1)
+  {
+   ds::Array<nat32> temp;
+   for (nat32 v=b0;v<b1;v++)
+   {
+    nat32 size = Neighbours(v,temp);
+    nat32 first = 0;
+    while ((first<size)&&(temp[first]<v)) ++first;
+
+    if (fillEdges)
+    {
+     for (nat32 i=first;i<size;i++) edgeOther[edgeStart[v]+i-first] = temp[i];
+    }
+    else edgeStart[v+1] = size - first;
+   }
+  }
+
+  void FillCornerEdge(nat32 b0,nat32 b1)
+  {
+   for (nat32 f=b0;f<b1;f++)
+   {
+    for (nat32 c=faceStart[f];c<faceStart[f+1];c++)
+    {
+     cornerEdge[c] = FindEdge(corner[c],corner[Next(c)]);
+    }
+   }
+  }
+
+  // Done by vertex, each doing the edges its the lower end of, so no two
+  // threads write the same edge...
+   void FillEdgeFaces(nat32 b0,nat32 b1)
+   {
+    for (nat32 v=b0;v<b1;v++)
+    {
+     for (nat32 e=edgeStart[v];e<edgeStart[v+1];e++) edgeFaces[e] = 0;
+     for (nat32 i=vertStart[v];i<vertStart[v+1];i++)
+     {
+      nat32 c = vertCorner[i];
+      nat32 next = corner[Next(c)];
+      nat32 prev = corner[Prev(c)];
+      if (next>v) edgeFaces[FindEdge(v,next)] += 1;
+      if ((prev>v)&&(prev!=next)) edgeFaces[FindEdge(v,prev)] += 1;
+     }
+    }
+   }
+};
+
+//------------------------------------------------------------------------------
+// Fills a SubMesh from an IndexedMesh, including the connectivity...
+void ToSubMesh(const IndexedMesh & in,SubMesh & out)
+{
+ out.pos.Size(in.VertexCount()*3);
+ for (nat32 i=0;i<in.VertexCount();i++)
+ {
+  out.pos[i*3]   = in.X()[i];
+  out.pos[i*3+1] = in.Y()[i];
+  out.pos[i*3+2] = in.Z()[i];
+ }
+
+ out.hasUV = in.HasUV();
+ out.uv.Size(out.hasUV?(in.VertexCount()*2):0);
+ if (out.hasUV)
+ {
+  for (nat32 i=0;i<in.VertexCount();i++)
+  {
+   bs::Tex2D uv = in.UV(i);
+   out.uv[i*2]   = uv[0];
+   out.uv[i*2+1] = uv[1];
+  }
+ }
+
+ out.faceStart.Size(in.TriCount()+1);
+ for (nat32 i=0;i<out.faceStart.Size();i++) out.faceStart[i] = i*3;
+ out.corner.Size(in.TriCount()*3);
+ for (nat32 i=0;i<out.corner.Size();i++) out.corner[i] = in.Tris()[i];
+
+ out.Build();
+}
+
+// Writes a SubMesh into an IndexedMesh, fanning out each face...
+void FromSubMesh(const SubMesh & in,IndexedMesh & out,bit normals)
+{
+ nat32 tris = 0;
+ for (nat32 f=0;f<in.FaceCount();f++)
+ {
+  nat32 size = in.faceStart[f+1] - in.faceStart[f];
+  if (size>2) tris += size-2;
+ }
+
+ out.Clear();
+ out.Setup(in.VertexCount(),tris);
+ if (in.hasUV) out.EnableUV();
+
+ for (nat32 i=0;i<in.VertexCount();i++)
+ {
+  out.SetPos(i,bs::Vert(in.pos[i*3],in.pos[i*3+1],in.pos[i*3+2]));
+  if (in.hasUV) out.SetUV(i,bs::Tex2D(in.uv[i*2],in.uv[i*2+1]));
+ }
+
+ nat32 t = 0;
+ for (nat32 f=0;f<in.FaceCount();f++)
+ {
+  nat32 first = in.faceStart[f];
+  for (nat32 c=first+2;c<in.faceStart[f+1];c++)
+  {
+   out.SetTri(t,in.corner[first],in.corner[c-1],in.corner[c]);
+   ++t;
+  }
+ }
+
+ if (normals) out.CalcNormals();
+         else out.BuildAdjacency();
+}
+
+//------------------------------------------------------------------------------
+// One level of catmull clark, from one SubMesh to another. The new vertices are
+// the old vertices, then a vertex per edge, then a vertex per face; each corner
+// of the old mesh becomes a quad, in the same order...
+class CatmullClarkLevel
+{
+ public:
+  CatmullClarkLevel(const SubMesh & i,SubMesh & o)
+  :in(i),out(o)
+  {
+   baseEdge = in.VertexCount();
+   baseFace = baseEdge + in.EdgeCount();
+  }
+
+  void Run()
+  {
+   nat32 verts = baseFace + in.FaceCount();
+   out.pos.Size(verts*3);
+   out.hasUV = in.hasUV;
+   out.uv.Size(in.hasUV?(verts*2):0);
+
+   out.faceStart.Size(in.CornerCount()+1);
+   for (nat32 i=0;i<out.faceStart.Size();i++) out.faceStart[i] = i*4;
+   out.corner.Size(in.CornerCount()*4);
+
+   // Order matters - edge points need the face points, vertex points both...
+    ParallelCall<CatmullClarkLevel,&CatmullClarkLevel::Faces>(*this,in.FaceCount(),256);
+    ParallelCall<CatmullClarkLevel,&CatmullClarkLevel::Edges>(*this,in.VertexCount(),256);
+    ParallelCall<CatmullClarkLevel,&CatmullClarkLevel::Vertices>(*this,in.VertexCount(),256);
+
+   out.Build();
+  }
+
+
+ private:
+  const SubMesh & in;
+  SubMesh & out;
+  nat32 baseEdge;
+  nat32 baseFace;
+
+  void Set(nat32 v,const real32 * p,real32 mult)
+  {
+   for (nat32 d=0;d<3;d++) out.pos[v*3+d] = p[d]*mult;
+  }
+
+  void Add(nat32 v,const real32 * p,real32 mult)
+  {
+   for (nat32 d=0;d<3;d++) out.pos[v*3+d] += p[d]*mult;
+  }
+
+  // Face points, face uv and the new quads...
+   void Faces(nat32 b0,nat32 b1)
+   {
+    for (nat32 f=b0;f<b1;f++)
+    {
+     nat32 start = in.faceStart[f];
+     nat32 end = in.faceStart[f+1];
+     real32 mult = 1.0/real32(end-start);
+     nat32 fv = baseFace + f;
+
+     for (nat32 d=0;d<3;d++) out.pos[fv*3+d] = 0.0;
+     if (in.hasUV) {out.uv[fv*2] = 0.0; out.uv[fv*2+1] = 0.0;}
+
+     for (nat32 c=start;c<end;c++)
+     {
+      nat32 v = in.corner[c];
+      Add(fv,&in.pos[v*3],mult);
+      if (in.hasUV)
+      {
+       out.uv[fv*2]   += in.uv[v*2]*mult;
+       out.uv[fv*2+1] += in.uv[v*2+1]*mult;
+      }
+
+      nat32 * quad = &out.corner[c*4];
+      quad[0] = fv;
+      quad[1] = baseEdge + in.cornerEdge[in.Prev(c)];
+      quad[2] = v;
+      quad[3] = baseEdge + in.cornerEdge[c];
+     }
+    }
+   }
+
+  // Edge points, done by lower vertex so each edge is written by one range...
+   void Edges(nat32 b0,nat32 b1)
+   {
+    for (nat32 v=b0;v<b1;v++)
+    {
+     // Start with the end points, ready for the face points to be added...
+      for (nat32 e=in.edgeStart[v];e<in.edgeStart[v+1];e++)
+      {
+       nat32 ev = baseEdge + e;
+       nat32 other = in.edgeOther[e];
+       real32 mult = (in.edgeFaces[e]<2)?0.5:0.25;
+       Set(ev,&in.pos[v*3],mult);
+       Add(ev,&in.pos[other*3],mult);
+
+       if (in.hasUV)
+       {
+        out.uv[ev*2]   = 0.5*(in.uv[v*2] + in.uv[other*2]);
+        out.uv[ev*2+1] = 0.5*(in.uv[v*2+1] + in.uv[other*2+1]);
+       }
+      }
+
+     // Add the face points, for edges with two or more faces...
+      for (nat32 i=in.vertStart[v];i<in.vertStart[v+1];i++)
+      {
+       nat32 c = in.vertCorner[i];
+       nat32 fv = baseFace + in.cornerFace[c];
+       nat32 next = in.corner[in.Next(c)];
+       nat32 prev = in.corner[in.Prev(c)];
+
+       if (next>v) AddFace(in.FindEdge(v,next),fv);
+       if ((prev>v)&&(prev!=next)) AddFace(in.FindEdge(v,prev),fv);
+      }
+    }
+   }
+
+   void AddFace(nat32 e,nat32 fv)
+   {
+    nat32 faces = in.edgeFaces[e];
+    if (faces<2) return;
+    Add(baseEdge+e,&out.pos[fv*3],1.0/real32(2*faces));
+   }
+
+  // Vertex points...
+   void Vertices(nat32 b0,nat32 b1)
+   {
+    ds::Array<nat32> temp;
+    for (nat32 v=b0;v<b1;v++)
+    {
+     nat32 edges = in.Neighbours(v,temp);
+     nat32 faces = in.vertStart[v+1] - in.vertStart[v];
+
+     if (in.hasUV)
+     {
+      out.uv[v*2]   = in.uv[v*2];
+      out.uv[v*2+1] = in.uv[v*2+1];
+     }
+
+     if (edges==0)
+     {
+      Set(v,&in.pos[v*3],1.0);
+     }
+     else if (edges==faces)
+     {
+      // Normal rule...
+       Set(v,&in.pos[v*3],real32(edges-2)/real32(edges));
+
+       real32 mult = 1.0/real32(math::Sqr(edges));
+       for (nat32 i=0;i<edges;i++)
+       {
+        Add(v,&out.pos[(baseEdge+in.FindEdge(v,temp[i]))*3],mult);
+       }
+       for (nat32 i=in.vertStart[v];i<in.vertStart[v+1];i++)
+       {
+        Add(v,&out.pos[(baseFace+in.cornerFace[in.vertCorner[i]])*3],mult);
+       }
+     }
+     else
+     {
+      // Boundary rule, from all neighbours along edges with less than two
+      // faces...
+       nat32 divisor = 0;
+       for (nat32 i=0;i<edges;i++)
+       {
+        if (in.edgeFaces[in.FindEdge(v,temp[i])]<2) ++divisor;
+       }
+
+       if (divisor==0) Set(v,&in.pos[v*3],1.0);
+       else
+       {
+        Set(v,&in.pos[v*3],0.75);
+        real32 mult = 1.0/real32(4*divisor);
+        for (nat32 i=0;i<edges;i++)
+        {
+         if (in.edgeFaces[in.FindEdge(v,temp[i])]<2) Add(v,&in.pos[temp[i]*3],mult);
+        }
+       }
+     }
+    }
+   }
+};
+
+//------------------------------------------------------------------------------
+// Flat subdivision, straight from a SubMesh of triangles to an IndexedMesh. The
+// new vertices are the old vertices, then divs per edge, in order from its
+// lower vertex, then the inside vertices of each triangle. Each triangle is
+// a triangular grid of points (j,k), 0<=k<=j<=divs+1, with corners at (0,0),
+// (divs+1,0) and (divs+1,divs+1)...
+class FlatLevel
+{
+ public:
+  FlatLevel(const SubMesh & i,nat32 d,IndexedMesh & o)
+  :in(i),divs(d),side(d+1),out(o)
+  {
+   inside = (divs*(divs-1))/2;
+   baseEdge = in.VertexCount();
+   baseFace = baseEdge + in.EdgeCount()*divs;
+  }
+
+  void Run()
+  {
+   out.Clear();
+   out.Setup(baseFace + in.FaceCount()*inside,in.FaceCount()*side*side);
+   if (in.hasUV) out.EnableUV();
+
+   ParallelCall<FlatLevel,&FlatLevel::Vertices>(*this,in.VertexCount(),1024);
+   ParallelCall<FlatLevel,&FlatLevel::Edges>(*this,in.EdgeCount(),256);
+   ParallelCall<FlatLevel,&FlatLevel::Faces>(*this,in.FaceCount(),64);
+  }
+
+
+ private:
+  const SubMesh & in;
+  nat32 divs;
+  nat32 side;
+  nat32 inside;
+  IndexedMesh & out;
+  nat32 baseEdge;
+  nat32 baseFace;
+
+  // Sets a new vertex to a weighted sum of up to three old ones...
+   void Mix(nat32 nv,nat32 a,nat32 b,nat32 c,real32 wa,real32 wb,real32 wc)
+   {
+    bs::Vert p;
+    for (nat32 d=0;d<3;d++) p[d] = wa*in.pos[a*3+d] + wb*in.pos[b*3+d] + wc*in.pos[c*3+d];
+    out.SetPos(nv,p);
+
+    if (in.hasUV)
+    {
+     bs::Tex2D uv;
+     for (nat32 d=0;d<2;d++) uv[d] = wa*in.uv[a*2+d] + wb*in.uv[b*2+d] + wc*in.uv[c*2+d];
+     out.SetUV(nv,uv);
+    }
+   }
+
+  void Vertices(nat32 b0,nat32 b1)
+  {
+   for (nat32 v=b0;v<b1;v++) Mix(v,v,v,v,1.0,0.0,0.0);
+  }
+
+  // Needs the lower end of each edge, so found by searching edgeStart...
+   void Edges(nat32 b0,nat32 b1)
+   {
+    nat32 low = 0;
+    nat32 high = in.VertexCount();
+    while (low+1<high)
+    {
+     nat32 half = (low+high)/2;
+     if (in.edgeStart[half]>b0) high = half;
+                           else low = half;
+    }
+
+    nat32 a = low;
+    for (nat32 e=b0;e<b1;e++)
+    {
+     while (in.edgeStart[a+1]<=e) ++a;
+     nat32 b = in.edgeOther[e];
+     for (nat32 i=0;i<divs;i++)
+     {
+      real32 t = real32(i+1)/real32(side);
+      Mix(baseEdge + e*divs + i,a,b,b,1.0-t,t,0.0);
+     }
+    }
+   }
+
+  // Returns the new vertex at (j,k) in the given face...
+   nat32 Point(nat32 f,nat32 j,nat32 k) const
+   {
+    nat32 c0 = in.faceStart[f];
+    if (k==0)
+    {
+     if (j==0) return in.corner[c0];
+     if (j==side) return in.corner[c0+1];
+     return OnEdge(c0,j);
+    }
+    if (j==side)
+    {
+     if (k==side) return in.corner[c0+2];
+     return OnEdge(c0+1,k);
+    }
+    if (j==k) return OnEdge(c0+2,side-j);
+
+    return baseFace + f*inside + ((j-1)*(j-2))/2 + (k-1);
+   }
+
+   // Vertex on the edge leaving corner c, dist steps along from it...
+    nat32 OnEdge(nat32 c,nat32 dist) const
+    {
+     nat32 e = in.cornerEdge[c];
+     bit fromLow = in.corner[c]<in.corner[in.Next(c)];
+     return baseEdge + e*divs + (fromLow?(dist-1):(side-1-dist));
+    }
+
+  void Faces(nat32 b0,nat32 b1)
+  {
+   for (nat32 f=b0;f<b1;f++)
+   {
+    nat32 c0 = in.faceStart[f];
+    nat32 va = in.corner[c0];
+    nat32 vb = in.corner[c0+1];
+    nat32 vc = in.corner[c0+2];
+
+    // Inside vertices...
+     for (nat32 j=2;j<side;j++)
+     {
+      for (nat32 k=1;k<j;k++)
+      {
+       Mix(Point(f,j,k),va,vb,vc,real32(side-j)/real32(side),
+                                 real32(j-k)/real32(side),
+                                 real32(k)/real32(side));
+      }
+     }
+
+    // Triangles, row by row...
+     nat32 t = f*side*side;
+     for (nat32 j=0;j<side;j++)
+     {
+      for (nat32 k=0;k<=j;k++)
+      {
+       out.SetTri(t++,Point(f,j,k),Point(f,j+1,k),Point(f,j+1,k+1));
+       if (k!=j) out.SetTri(t++,Point(f,j,k),Point(f,j+1,k+1),Point(f,j,k+1));
+      }
+     }
+   }
+  }
+};
+
+//------------------------------------------------------------------------------
+EOS_FUNC void CatmullClark(const IndexedMesh & in,nat32 levels,IndexedMesh & out)
+{
+ LogTime("eos::sur::CatmullClark");
+
+ SubMesh buf[2];
+ ToSubMesh(in,buf[0]);
+ for (nat32 i=0;i<levels;i++)
+ {
+  CatmullClarkLevel ccl(buf[i%2],buf[(i+1)%2]);
+  ccl.Run();
+ }
+
+ FromSubMesh(buf[levels%2],out,in.HasNormals());
+}
+
+EOS_FUNC void Subdivide(const IndexedMesh & in,nat32 divs,IndexedMesh & out)
+{
+ LogTime("eos::sur::Subdivide");
+
+ SubMesh sub;
+ ToSubMesh(in,sub);
+
+ FlatLevel fl(sub,divs,out);
+ fl.Run();
+
+ if (in.HasNormals()) out.CalcNormals();
+                 else out.BuildAdjacency();
+}
+
+//------------------------------------------------------------------------------
+ };
+};
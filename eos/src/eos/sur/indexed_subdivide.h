@@ -0,0 +1,58 @@
+#ifndef EOS_SUR_INDEXED_SUBDIVIDE_H
+#define EOS_SUR_INDEXED_SUBDIVIDE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file indexed_subdivide.h
+/// Provides subdivision of IndexedMesh-s, both catmull clark and flat, done in
+/// parallel. Much faster than the Mesh versions in catmull_clark.h and
+/// subdivide.h, being for when you just want the result.
+
+#include "eos/types.h"
+#include "eos/sur/indexed_mesh.h"
+
+namespace eos
+{
+ namespace sur
+ {
+//------------------------------------------------------------------------------
+/// Applies the given number of levels of catmull clark subdivision to a mesh,
+/// writing the result into out, which must not be the input. Uses the same
+/// rules as Subdivide(Mesh&), including for borders and non-manifold bits. The
+/// levels are done one after another without making IndexedMesh-s in-between,
+/// the connectivity being worked out as each level is made, and every step is
+/// done in parallel. As subdivision produces quads but an IndexedMesh can only
+/// store triangles each final quad is split in two - this does not effect the
+/// shape of further levels as they are done before the split. Texture
+/// coordinates, if present, are interpolated linearly; normals, if present, are
+/// recalculated. The number of faces grows by a factor of 4 per level, after
+/// the first which gives 3 quads, so 6 triangles, per input triangle.
+EOS_FUNC void CatmullClark(const IndexedMesh & in,nat32 levels,IndexedMesh & out);
+
+/// Flat subdivision of every triangle of a mesh, writing into out, which must
+/// not be the input. Each edge is split into divs+1 equal lengths and each
+/// triangle into (divs+1)^2 triangles, the shape not changing. Vertices along
+/// edges are shared between the triangles either side. Texture coordinates
+/// are interpolated, normals recalculated if present. Done in parallel, with
+/// the output allocated once at its final size.
+EOS_FUNC void Subdivide(const IndexedMesh & in,nat32 divs,IndexedMesh & out);
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -17,6 +17,8 @@
 
 #include "eos/sur/intersection.h"
 
+#include "eos/sur/indexed_mesh.h"
+
 #include "eos/math/mat_ops.h"
 #include "eos/file/csv.h"
 
@@ -75,6 +77,30 @@ EOS_FUNC bit RayTriIntersect(bs::Ray & ray,
  return true;
 }
 
+EOS_FUNC bit RayMeshIntersect(bs::Ray & ray,const IndexedMesh & mesh,
+                              nat32 & tri,real32 & dist,real32 & wa,real32 & wb,real32 & wc)
+{
+ bit ret = false;
+ for (nat32 t=0;t<mesh.TriCount();t++)
+ {
+  bs::Vert a,b,c;
+  mesh.GetTri(t,a,b,c);
+
+  real32 d,ta,tb,tc;
+  if (RayTriIntersect(ray,a,b,c,d,ta,tb,tc))
+  {
+   if ((!ret)||(d<dist))
+   {
+    ret = true;
+    tri = t;
+    dist = d;
+    wa = ta; wb = tb; wc = tc;
+   }
+  }
+ }
+ return ret;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -28,6 +28,9 @@ namespace eos
 {
  namespace sur
  {
+//------------------------------------------------------------------------------
+class EOS_CLASS IndexedMesh;
+
 //------------------------------------------------------------------------------
 /// This intersects a ray with a triangle. Returns true on success, false on
 /// failure. On returning true it also supply the distance traveled along the
@@ -38,6 +41,13 @@ EOS_FUNC bit RayTriIntersect(bs::Ray & ray,
                              const bs::Vert & a,const bs::Vert & b,const bs::Vert & c,
                              real32 & dist,real32 & wa,real32 & wb,real32 & wc);
 
+/// Intersects a ray with every triangle of an IndexedMesh, finding the nearest
+/// collision. Returns true if there is one, in which case it outputs the index
+/// of the triangle and the distance and weights as for RayTriIntersect. A brute
+/// force search, so only for when you have a few rays - for lots build a Bvh.
+EOS_FUNC bit RayMeshIntersect(bs::Ray & ray,const IndexedMesh & mesh,
+                              nat32 & tri,real32 & dist,real32 & wa,real32 & wb,real32 & wc);
+
 //------------------------------------------------------------------------------
  };
 };
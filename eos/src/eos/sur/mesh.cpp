@@ -26,9 +26,12 @@ namespace eos
 //------------------------------------------------------------------------------
 Mesh::Mesh(str::TokenTable * t)
 :tt(t),
-vertPropChanged(false),edgePropChanged(false),facePropChanged(false),
-vertPropSize(sizeof(Vertex)),edgePropSize(sizeof(DirEdge)*2),facePropSize(sizeof(Face))
-{}
+vertPropChanged(false),edgePropChanged(false),facePropChanged(false)
+{
+ vertIds.next = 0; vertIds.capacity = 0; vertIds.spare = 0;
+ edgeIds.next = 0; edgeIds.capacity = 0; edgeIds.spare = 0;
+ faceIds.next = 0; faceIds.capacity = 0; faceIds.spare = 0;
+}
 
 Mesh::~Mesh()
 {
@@ -43,9 +46,9 @@ Mesh::~Mesh()
   }
  }
 
- for (nat32 i=0;i<vertProp.Size();i++) mem::Free(vertProp[i].ini);
- for (nat32 i=0;i<edgeProp.Size();i++) mem::Free(edgeProp[i].ini);
- for (nat32 i=0;i<faceProp.Size();i++) mem::Free(faceProp[i].ini);
+ WipeProp(vertProp);
+ WipeProp(edgeProp);
+ WipeProp(faceProp);
 }
 
 void Mesh::SetTT(str::TokenTable * t)
@@ -150,15 +153,7 @@ void Mesh::GetFaces(ds::Array<sur::Face> & out) const
 
 sur::Vertex Mesh::NewVertex(const bs::Vert & pos)
 {
- Vertex * nv = (Vertex*)(void*)mem::Malloc<byte>(vertPropSize);
- for (nat32 i=0;i<vertProp.Size();i++)
- {
-  if (vertProp[i].state!=Prop::Added)
-  {
-   mem::Copy((byte*)nv + vertProp[i].offset,vertProp[i].ini,vertProp[i].size);
-  }
- }
-
+ Vertex * nv = AllocVertex();
  verts.Add(nv);
 
  nv->edge = null<DirEdge*>();
@@ -172,15 +167,8 @@ sur::Edge Mesh::NewEdge(sur::Vertex a,sur::Vertex b)
  sur::Edge ret = a.Link(b);
   if (!ret.Valid())
   {
-   DirEdge * a2b = (DirEdge*)(void*)mem::Malloc<byte>(edgePropSize);
+   DirEdge * a2b = AllocEdge();
    DirEdge * b2a = a2b + 1;
-   for (nat32 i=0;i<edgeProp.Size();i++)
-   {
-    if (edgeProp[i].state!=Prop::Added)
-    {
-     mem::Copy((byte*)a2b + edgeProp[i].offset,edgeProp[i].ini,edgeProp[i].size);
-    }
-   }
    edges.Add(a2b);
 
    a2b->to = b.vert;
@@ -227,14 +215,7 @@ sur::Face Mesh::NewFace(const ds::Array<sur::Vertex> & verts)
  log::Assert(verts.Size()>=3,"Mesh::NewFace");
 
  // Create the face so we know its pointer...
-  Face * nf = (Face*)(void*)mem::Malloc<byte>(facePropSize);
-  for (nat32 i=0;i<faceProp.Size();i++)
-  {
-   if (faceProp[i].state!=Prop::Added)
-   {
-    mem::Copy((byte*)nf + faceProp[i].offset,faceProp[i].ini,faceProp[i].size);
-   }
-  }
+  Face * nf = AllocFace();
   faces.Add(nf);
   nf->size = verts.Size();
 
@@ -291,14 +272,7 @@ sur::Face Mesh::NewFace(sur::Vertex a,sur::Vertex b,sur::Vertex c)
  v[2] = c;
 
  // Create the face so we know its pointer...
-  Face * nf = (Face*)(void*)mem::Malloc<byte>(facePropSize);
-  for (nat32 i=0;i<faceProp.Size();i++)
-  {
-   if (faceProp[i].state!=Prop::Added)
-   {
-    mem::Copy((byte*)nf + faceProp[i].offset,faceProp[i].ini,faceProp[i].size);
-   }
-  }
+  Face * nf = AllocFace();
   faces.Add(nf);
   nf->size = 3;
 
@@ -343,14 +317,7 @@ sur::Face Mesh::NewFace(sur::Vertex a,sur::Vertex b,sur::Vertex c,sur::Vertex d)
  v[3] = d;
 
  // Create the face so we know its pointer...
-  Face * nf = (Face*)(void*)mem::Malloc<byte>(facePropSize);
-  for (nat32 i=0;i<faceProp.Size();i++)
-  {
-   if (faceProp[i].state!=Prop::Added)
-   {
-    mem::Copy((byte*)nf + faceProp[i].offset,faceProp[i].ini,faceProp[i].size);
-   }
-  }
+  Face * nf = AllocFace();
   faces.Add(nf);
   nf->size = 4;
 
@@ -391,7 +358,7 @@ void Mesh::Del(sur::Vertex vert)
  while (vert.vert->edge) Del(sur::Edge(vert.vert->edge));
 
  verts.Rem(vert.vert);
- mem::Free(vert.vert);
+ FreeVertex(vert.vert);
 }
 
 void Mesh::Del(sur::Edge edge)
@@ -426,7 +393,7 @@ void Mesh::Del(sur::Edge edge)
  // Deletion...
   DirEdge * first = math::Min(e1,e2); // Yeah, think about it... :-P
   edges.Rem(first);
-  mem::Free(first); // They share storage.
+  FreeEdge(first); // They share storage.
 }
 
 void Mesh::Del(sur::Face face)
@@ -452,7 +419,7 @@ void Mesh::Del(sur::Face face)
 
  // Remove the face...
   faces.Rem(face.face);
-  mem::Free(face.face);
+  FreeFace(face.face);
 }
 
 void Mesh::Fire(sur::Vertex toDie,sur::Vertex replacement)
@@ -477,7 +444,7 @@ void Mesh::Fire(sur::Vertex toDie,sur::Vertex replacement)
    
    // Delete the old vertex...
     verts.Rem(toDie.vert);
-    mem::Free(toDie.vert);
+    FreeVertex(toDie.vert);
   
    return;
   }
@@ -521,7 +488,7 @@ void Mesh::Fire(sur::Vertex toDie,sur::Vertex replacement)
 
  // Terminate...
   verts.Rem(toDie.vert);
-  mem::Free(toDie.vert);
+  FreeVertex(toDie.vert);
 
 
 
@@ -631,7 +598,7 @@ void Mesh::Fire(sur::Vertex toDie,sur::Vertex replacement)
            mem::Free(face->edge->chain);
            mem::Free(face->edge);
            faces.Rem(face);
-           mem::Free(face);
+           FreeFace(face);
          }
        }
 
@@ -640,7 +607,7 @@ void Mesh::Fire(sur::Vertex toDie,sur::Vertex replacement)
       {
        DirEdge * first = math::Min(targ,targ->partner);
        edges.Rem(first);
-       mem::Free(first);
+       FreeEdge(first);
       }
       
       penguin = false;
@@ -724,7 +691,7 @@ void Mesh::Fire(sur::Vertex toDie,sur::Vertex replacement)
         {
          DirEdge * first = math::Min(targ,targ->partner);
          edges.Rem(first);
-         mem::Free(first);
+         FreeEdge(first);
         }
 
                
@@ -804,7 +771,7 @@ void Mesh::Fire(sur::Vertex toDie,sur::Vertex replacement)
              
                // Terminate the face...
                 faces.Rem(face);
-                mem::Free(face);
+                FreeFace(face);
               }
             }
             t = nextT;
@@ -905,7 +872,7 @@ svt::Node * Mesh::AsSvt(svt::Core & core) const
   for (nat32 i=0;i<hspv.Size();i++)
   {
    hspv[i].size = vertProp[i].size;
-   hspv[i].fromOffset = vertProp[i].offset;
+   hspv[i].column = vertProp[i].column;
    vt->GetIndex(core.GetTT()(tt->Str(vertProp[i].name)),hspv[i].toInd);
   }
 
@@ -918,7 +885,7 @@ svt::Node * Mesh::AsSvt(svt::Core & core) const
 
     for (nat32 j=0;j<hspv.Size();j++)
     {
-     mem::Copy((byte*)vt->Ptr(hspv[j].toInd,i),(byte*)(*in) + hspv[j].fromOffset,hspv[j].size);
+     mem::Copy((byte*)vt->Ptr(hspv[j].toInd,i),*hspv[j].column + (*in)->id*hspv[j].size,hspv[j].size);
     }
 
     ++in;
@@ -945,7 +912,7 @@ svt::Node * Mesh::AsSvt(svt::Core & core) const
   for (nat32 i=0;i<hspe.Size();i++)
   {
    hspe[i].size = edgeProp[i].size;
-   hspe[i].fromOffset = edgeProp[i].offset;
+   hspe[i].column = edgeProp[i].column;
    ve->GetIndex(core.GetTT()(tt->Str(edgeProp[i].name)),hspe[i].toInd);
   }
 
@@ -960,7 +927,7 @@ svt::Node * Mesh::AsSvt(svt::Core & core) const
 
     for (nat32 j=0;j<hspe.Size();j++)
     {
-     mem::Copy((byte*)ve->Ptr(hspe[j].toInd,i),(byte*)(*in) + hspe[j].fromOffset,hspe[j].size);
+     mem::Copy((byte*)ve->Ptr(hspe[j].toInd,i),*hspe[j].column + (*in)->id*hspe[j].size,hspe[j].size);
     }
 
     log::Assert((oa.Get(i)!=nat32(-1))&&(ob.Get(i)!=nat32(-1)),"Mesh::AsSvt");
@@ -986,7 +953,7 @@ svt::Node * Mesh::AsSvt(svt::Core & core) const
   for (nat32 i=0;i<hspf.Size();i++)
   {
    hspf[i].size = faceProp[i].size;
-   hspf[i].fromOffset = faceProp[i].offset;
+   hspf[i].column = faceProp[i].column;
    vf->GetIndex(core.GetTT()(tt->Str(faceProp[i].name)),hspf[i].toInd);
   }
 
@@ -1001,7 +968,7 @@ svt::Node * Mesh::AsSvt(svt::Core & core) const
 
     for (nat32 j=0;j<hspf.Size();j++)
     {
-     mem::Copy((byte*)vf->Ptr(hspf[j].toInd,i),(byte*)(*in) + hspf[j].fromOffset,hspf[j].size);
+     mem::Copy((byte*)vf->Ptr(hspf[j].toInd,i),*hspf[j].column + (*in)->id*hspf[j].size,hspf[j].size);
     }
 
     ++in;
@@ -1065,17 +1032,13 @@ bit Mesh::FromSvt(svt::Node * root)
   edgePropChanged = false;
   facePropChanged = false;
 
-  vertPropSize = sizeof(Vertex);
-  edgePropSize = sizeof(DirEdge) * 2;
-  facePropSize = sizeof(Face);
-
-  for (nat32 i=0;i<vertProp.Size();i++) mem::Free(vertProp[i].ini);
-  for (nat32 i=0;i<edgeProp.Size();i++) mem::Free(edgeProp[i].ini);
-  for (nat32 i=0;i<faceProp.Size();i++) mem::Free(faceProp[i].ini);
-
-  vertProp.Size(0);
-  edgeProp.Size(0);
-  faceProp.Size(0);
+  WipeProp(vertProp);
+  WipeProp(edgeProp);
+  WipeProp(faceProp);
+  
+  vertIds.next = 0; vertIds.capacity = 0; vertIds.spare = 0;
+  edgeIds.next = 0; edgeIds.capacity = 0; edgeIds.spare = 0;
+  faceIds.next = 0; faceIds.capacity = 0; faceIds.spare = 0;
 
   vertByName.Reset();
   edgeByName.Reset();
@@ -1169,7 +1132,7 @@ bit Mesh::FromSvt(svt::Node * root)
   for (nat32 i=0;i<hsrv.Size();i++)
   {
    hsrv[i].size = vertProp[i].size;
-   hsrv[i].fromOffset = vertProp[i].offset;
+   hsrv[i].column = vertProp[i].column;
    vt->GetIndex(svtTT(tt->Str(vertProp[i].name)),hsrv[i].toInd);
   }
 
@@ -1178,7 +1141,7 @@ bit Mesh::FromSvt(svt::Node * root)
    dict[i] = NewVertex(vf.Get(i));
    for (nat32 j=0;j<hsrv.Size();j++)
    {
-    mem::Copy((byte*)(void*)dict[i].vert + hsrv[j].fromOffset,(byte*)vt->Ptr(hsrv[j].toInd,i),hsrv[j].size);
+    mem::Copy(*hsrv[j].column + dict[i].vert->id*hsrv[j].size,(byte*)vt->Ptr(hsrv[j].toInd,i),hsrv[j].size);
    }
   }
  }
@@ -1190,7 +1153,7 @@ bit Mesh::FromSvt(svt::Node * root)
   for (nat32 i=0;i<hsre.Size();i++)
   {
    hsre[i].size = edgeProp[i].size;
-   hsre[i].fromOffset = edgeProp[i].offset;
+   hsre[i].column = edgeProp[i].column;
    et->GetIndex(svtTT(tt->Str(edgeProp[i].name)),hsre[i].toInd);
   }
 
@@ -1199,7 +1162,7 @@ bit Mesh::FromSvt(svt::Node * root)
    sur::Edge edge = NewEdge(dict[eaf.Get(i)],dict[ebf.Get(i)]);
    for (nat32 j=0;j<hsre.Size();j++)
    {
-    mem::Copy((byte*)(void*)edge.edge + hsre[j].fromOffset,(byte*)et->Ptr(hsre[j].toInd,i),hsre[j].size);
+    mem::Copy(*hsre[j].column + edge.edge->id*hsre[j].size,(byte*)et->Ptr(hsre[j].toInd,i),hsre[j].size);
    }
   }
  }
@@ -1211,7 +1174,7 @@ bit Mesh::FromSvt(svt::Node * root)
   for (nat32 i=0;i<hsrf.Size();i++)
   {
    hsrf[i].size = faceProp[i].size;
-   hsrf[i].fromOffset = faceProp[i].offset;
+   hsrf[i].column = faceProp[i].column;
    ft->GetIndex(svtTT(tt->Str(faceProp[i].name)),hsrf[i].toInd);
   }
 
@@ -1226,7 +1189,7 @@ bit Mesh::FromSvt(svt::Node * root)
    sur::Face face = NewFace(temp);
    for (nat32 j=0;j<hsrf.Size();j++)
    {
-    mem::Copy((byte*)(void*)face.face + hsrf[j].fromOffset,(byte*)ft->Ptr(hsrf[j].toInd,i),hsrf[j].size);
+    mem::Copy(*hsrf[j].column + face.face->id*hsrf[j].size,(byte*)ft->Ptr(hsrf[j].toInd,i),hsrf[j].size);
    }
   }
  }
@@ -1360,7 +1323,7 @@ void Mesh::AddVertProp(str::Token name,str::Token type,nat32 size,const void * i
  vertProp[ind].ini = mem::Malloc<byte>(size);
  mem::Copy(vertProp[ind].ini,(byte*)ini,size);
 
- vertProp[ind].offset = 0;
+ vertProp[ind].column = null<byte**>();
  vertProp[ind].state = Prop::Added;
 }
 
@@ -1378,7 +1341,7 @@ void Mesh::AddEdgeProp(str::Token name,str::Token type,nat32 size,const void * i
  edgeProp[ind].ini = mem::Malloc<byte>(size);
  mem::Copy(edgeProp[ind].ini,(byte*)ini,size);
 
- edgeProp[ind].offset = 0;
+ edgeProp[ind].column = null<byte**>();
  edgeProp[ind].state = Prop::Added;
 }
 
@@ -1396,7 +1359,7 @@ void Mesh::AddFaceProp(str::Token name,str::Token type,nat32 size,const void * i
  faceProp[ind].ini = mem::Malloc<byte>(size);
  mem::Copy(faceProp[ind].ini,(byte*)ini,size);
 
- faceProp[ind].offset = 0;
+ faceProp[ind].column = null<byte**>();
  faceProp[ind].state = Prop::Added;
 }
 
@@ -1440,19 +1403,19 @@ void Mesh::Commit(bit useDefault)
 {
  if (vertPropChanged)
  {
-  CommitVertex(useDefault);
+  CommitProp(vertIds,vertProp,vertByName);
   vertPropChanged = false;
  }
 
  if (edgePropChanged)
  {
-  CommitEdge(useDefault);
+  CommitProp(edgeIds,edgeProp,edgeByName);
   edgePropChanged = false;
  }
 
  if (facePropChanged)
  {
-  CommitFace(useDefault);
+  CommitProp(faceIds,faceProp,faceByName);
   facePropChanged = false;
  }
 }
@@ -1555,23 +1518,35 @@ const void * Mesh::DefaultFaceProp(nat32 i) const
 
 void Mesh::Transfer(sur::Vertex & to,const sur::Vertex & from)
 {
- mem::Copy(((byte*)(to.vert))+sizeof(Mesh::Vertex),
-           ((byte*)(from.vert))+sizeof(Mesh::Vertex),
-           vertPropSize-sizeof(Mesh::Vertex));
+ for (nat32 i=0;i<vertProp.Size();i++)
+ {
+  if (vertProp[i].column==null<byte**>()) continue;
+  byte * col = *vertProp[i].column;
+  nat32 size = vertProp[i].size;
+  mem::Copy(col + to.vert->id*size,col + from.vert->id*size,size);
+ }
 }
 
 void Mesh::Transfer(sur::Edge & to,const sur::Edge & from)
 {
- mem::Copy(((byte*)(to.edge))+sizeof(Mesh::DirEdge)*2,
-           ((byte*)(from.edge))+sizeof(Mesh::DirEdge)*2,
-           edgePropSize-sizeof(Mesh::DirEdge)*2);
+ for (nat32 i=0;i<edgeProp.Size();i++)
+ {
+  if (edgeProp[i].column==null<byte**>()) continue;
+  byte * col = *edgeProp[i].column;
+  nat32 size = edgeProp[i].size;
+  mem::Copy(col + to.edge->id*size,col + from.edge->id*size,size);
+ }
 }
 
 void Mesh::Transfer(sur::Face & to,const sur::Face & from)
 {
- mem::Copy(((byte*)(to.face))+sizeof(Mesh::Face),
-           ((byte*)(from.face))+sizeof(Mesh::Face),
-           facePropSize-sizeof(Mesh::Face)); 
+ for (nat32 i=0;i<faceProp.Size();i++)
+ {
+  if (faceProp[i].column==null<byte**>()) continue;
+  byte * col = *faceProp[i].column;
+  nat32 size = faceProp[i].size;
+  mem::Copy(col + to.face->id*size,col + from.face->id*size,size);
+ }
 }
 
 bit Mesh::SafeContraction(const Edge & edge,const bs::Vert & newPos)
@@ -1679,425 +1654,160 @@ bit Mesh::Invariant(const sur::Vertex & test) const
  return true;
 }
 
-void Mesh::CommitVertex(bit useDefault)
+Mesh::Vertex * Mesh::AllocVertex()
 {
- // Create a data structure of operations that need to be applied to every
- // vertex, byte code style, simultaneously edit the prop array...
-  ds::List<Op> opList;
-  nat32 ci = 0;
-  nat32 memOffset = sizeof(Vertex);
-  for (nat32 i=0;i<vertProp.Size();i++)
-  {
-   switch (vertProp[i].state)
-   {
-    case Prop::Stored:
-    {
-     // Create the operation...
-      Op op;
-       op.op = false;
-       op.offset = memOffset;
-       op.size = vertProp[i].size;
-       op.oldOffset = vertProp[i].offset;
-      opList.AddBack(op);
-
-     // Update the entry...
-      vertProp[i].offset = memOffset;
-      memOffset += vertProp[i].size;
-
-     // Re-arrange the array...
-      if (ci!=i) vertProp[ci] = vertProp[i];
-      ++ci;
-    }
-    break;
-    case Prop::Added:
-    {
-     // Create the operation...
-      if (!useDefault)
-      {
-       Op op;
-        op.op = true;
-        op.offset = memOffset;
-        op.size = vertProp[i].size;
-        op.ini = vertProp[i].ini;
-       opList.AddBack(op);
-      }
-
-     // Update the entry...
-      vertProp[i].offset = memOffset;
-      memOffset += vertProp[i].size;
-      vertProp[i].state = Prop::Stored;
-
-     // Re-arrange the array...
-      if (ci!=i) vertProp[ci] = vertProp[i];
-      ++ci;
-    }
-    break;
-    case Prop::Deleted:
-    {
-     // Do nothing and it will not be copied over (Well, free its ini memory.)...
-      mem::Free(vertProp[i].ini);
-    }
-    break;
-   }
-  }
-  vertProp.Size(ci);
-  vertPropSize = memOffset;
-
-
- // Convert the list of operations into an array of operations - speed of access matters...
-  ds::Array<Op> prog(opList.Size());
-  {
-   ds::List<Op>::Cursor targ = opList.FrontPtr();
-   for (nat32 i=0;i<prog.Size();i++)
-   {
-    prog[i] = *targ;
-    ++targ;
-   }
-  }
-
-
- // Go through the entire list and apply the operation sequence to all...
- // (Rebuild the list afterwards, to make iteration possible.)
-  if (verts.Size()!=0)
-  {
-   ds::SortList<Vertex*> newVerts;
-   ds::SortList<Vertex*>::Cursor targ = verts.FrontPtr();
-   while (!targ.Bad())
-   {
-    // Create the new data, re-arrange the pointers...
-     Vertex * to = (Vertex*)(void*)mem::Malloc<byte>(vertPropSize);
-     newVerts.Add(to);
-     RepointVertex(*targ,to);
-
-    // Run the mini-program...
-     for (nat32 i=0;i<prog.Size();i++)
-     {
-      if (prog[i].op) mem::Copy(((byte*)(void*)to) + prog[i].offset,prog[i].ini,prog[i].size);
-      else mem::Copy(((byte*)(void*)to) + prog[i].offset,(byte*)(void*)(*targ) + prog[i].oldOffset,prog[i].size);
-     }
-
-    // Terminate, move to next...
-     mem::Free(*targ);
-     ++targ;
-   }
-   verts.Take(newVerts);
-  }
-
+ Vertex * ret = mem::Malloc<Vertex>();
+ ret->id = NewId(vertIds,vertProp);
+ return ret;
+}
 
- // Re-index the names...
-  vertByName.Reset();
-  for (nat32 i=0;i<vertProp.Size();i++)
-  {
-   vertByName.Set(vertProp[i].name,i);
-  }
+Mesh::DirEdge * Mesh::AllocEdge()
+{
+ DirEdge * ret = mem::Malloc<DirEdge>(2);
+ ret[0].id = NewId(edgeIds,edgeProp);
+ ret[1].id = ret[0].id;
+ return ret;
 }
 
-void Mesh::CommitEdge(bit useDefault)
+Mesh::Face * Mesh::AllocFace()
 {
- // Create a data structure of operations that need to be applied to every
- // edge, byte code style, simultaneously edit the prop array...
-  ds::List<Op> opList;
-  nat32 ci = 0;
-  nat32 memOffset = sizeof(DirEdge)*2;
-  for (nat32 i=0;i<edgeProp.Size();i++)
-  {
-   switch (edgeProp[i].state)
-   {
-    case Prop::Stored:
-    {
-     // Create the operation...
-      Op op;
-       op.op = false;
-       op.offset = memOffset;
-       op.size = edgeProp[i].size;
-       op.oldOffset = edgeProp[i].offset;
-      opList.AddBack(op);
-
-     // Update the entry...
-      edgeProp[i].offset = memOffset;
-      memOffset += edgeProp[i].size;
-
-     // Re-arrange the array...
-      if (ci!=i) edgeProp[ci] = edgeProp[i];
-      ++ci;
-    }
-    break;
-    case Prop::Added:
-    {
-     // Create the operation...
-      if (!useDefault)
-      {
-       Op op;
-        op.op = true;
-        op.offset = memOffset;
-        op.size = edgeProp[i].size;
-        op.ini = edgeProp[i].ini;
-       opList.AddBack(op);
-      }
+ Face * ret = mem::Malloc<Face>();
+ ret->id = NewId(faceIds,faceProp);
+ return ret;
+}
 
-     // Update the entry...
-      edgeProp[i].offset = memOffset;
-      memOffset += edgeProp[i].size;
-      edgeProp[i].state = Prop::Stored;
+void Mesh::FreeVertex(Vertex * vert)
+{
+ FreeId(vertIds,vert->id);
+ mem::Free(vert);
+}
 
-     // Re-arrange the array...
-      if (ci!=i) edgeProp[ci] = edgeProp[i];
-      ++ci;
-    }
-    break;
-    case Prop::Deleted:
-    {
-     // Do nothing and it will not be copied over (Well, free its ini memory.)...
-      mem::Free(edgeProp[i].ini);
-    }
-    break;
-   }
-  }
-  edgeProp.Size(ci);
-  edgePropSize = memOffset;
+void Mesh::FreeEdge(DirEdge * first)
+{
+ FreeId(edgeIds,first->id);
+ mem::Free(first);
+}
 
+void Mesh::FreeFace(Face * face)
+{
+ FreeId(faceIds,face->id);
+ mem::Free(face);
+}
 
- // Convert the list of operations into an array of operations - speed of access matters...
-  ds::Array<Op> prog(opList.Size());
+nat32 Mesh::NewId(IdPool & pool,ds::Array<Prop> & prop)
+{
+ // Get the id, recycling if possible...
+  nat32 ret;
+  if (pool.spare!=0)
   {
-   ds::List<Op>::Cursor targ = opList.FrontPtr();
-   for (nat32 i=0;i<prog.Size();i++)
-   {
-    prog[i] = *targ;
-    ++targ;
-   }
+   pool.spare -= 1;
+   ret = pool.free[pool.spare];
   }
-
-
- // Go through the entire list and apply the operation sequence to all...
- // (Rebuild the list afterwards, to make iteration possible.)
-  if (edges.Size()!=0)
+  else
   {
-   ds::SortList<DirEdge*> newEdges;
-   ds::SortList<DirEdge*>::Cursor targ = edges.FrontPtr();
-   while (!targ.Bad())
+   if (pool.next==pool.capacity)
    {
-    // Create the new data, re-arrange the pointers...
-     DirEdge * to = (DirEdge*)(void*)mem::Malloc<byte>(edgePropSize);
-     newEdges.Add(to);
-     RepointEdge(*targ,to);
-
-    // Run the mini-program...
-     for (nat32 i=0;i<prog.Size();i++)
+    // Out of space - double all the columns...
+     nat32 newCap = math::Max(pool.capacity*2,nat32(64));
+     for (nat32 i=0;i<prop.Size();i++)
      {
-      if (prog[i].op) mem::Copy(((byte*)(void*)to) + prog[i].offset,prog[i].ini,prog[i].size);
-      else mem::Copy(((byte*)(void*)to) + prog[i].offset,(byte*)(void*)(*targ) + prog[i].oldOffset,prog[i].size);
+      if (prop[i].column==null<byte**>()) continue;
+      byte * col = mem::Malloc<byte>(nat64(newCap)*nat64(prop[i].size));
+      mem::Copy(col,*prop[i].column,nat64(pool.next)*nat64(prop[i].size));
+      mem::Free(*prop[i].column);
+      *prop[i].column = col;
      }
-
-    // Terminate, move to next...
-     mem::Free(*targ);
-     ++targ;
+     pool.capacity = newCap;
    }
-   edges.Take(newEdges);
+   
+   ret = pool.next;
+   pool.next += 1;
   }
 
-
- // Re-index the names...
-  edgeByName.Reset();
-  for (nat32 i=0;i<edgeProp.Size();i++)
+ // Write in the defaults - this includes properties that are to be deleted 
+ // but not those that are still to be added...
+  for (nat32 i=0;i<prop.Size();i++)
   {
-   edgeByName.Set(edgeProp[i].name,i);
+   if (prop[i].column==null<byte**>()) continue;
+   mem::Copy(*prop[i].column + ret*prop[i].size,prop[i].ini,prop[i].size);
   }
+
+ return ret;
+}
+
+void Mesh::FreeId(IdPool & pool,nat32 id)
+{
+ if (pool.spare==pool.free.Size()) pool.free.Size(math::Max(pool.free.Size()*2,nat32(64)));
+ pool.free[pool.spare] = id;
+ pool.spare += 1;
 }
 
-void Mesh::CommitFace(bit useDefault)
+void Mesh::CommitProp(IdPool & pool,ds::Array<Prop> & prop,ds::FlatHash<nat32> & byName)
 {
- // Create a data structure of operations that need to be applied to every
- // face, byte code style, simultaneously edit the prop array...
-  ds::List<Op> opList;
+ // Create columns for the added, free the deleted and compact the array...
   nat32 ci = 0;
-  nat32 memOffset = sizeof(Face);
-  for (nat32 i=0;i<faceProp.Size();i++)
+  for (nat32 i=0;i<prop.Size();i++)
   {
-   switch (faceProp[i].state)
+   switch (prop[i].state)
    {
     case Prop::Stored:
     {
-     // Create the operation...
-      Op op;
-       op.op = false;
-       op.offset = memOffset;
-       op.size = faceProp[i].size;
-       op.oldOffset = faceProp[i].offset;
-      opList.AddBack(op);
-
-     // Update the entry...
-      faceProp[i].offset = memOffset;
-      memOffset += faceProp[i].size;
-
-     // Re-arrange the array...
-      if (ci!=i) faceProp[ci] = faceProp[i];
-      ++ci;
+     if (ci!=i) prop[ci] = prop[i];
+     ++ci;
     }
     break;
     case Prop::Added:
     {
-     // Create the operation...
-      if (!useDefault)
+     // Create the column, filled with the default for every id that could be 
+     // in use...
+      prop[i].column = mem::Malloc<byte*>();
+      *prop[i].column = mem::Malloc<byte>(nat64(pool.capacity)*nat64(prop[i].size));
+      for (nat32 j=0;j<pool.next;j++)
       {
-       Op op;
-        op.op = true;
-        op.offset = memOffset;
-        op.size = faceProp[i].size;
-        op.ini = faceProp[i].ini;
-       opList.AddBack(op);
+       mem::Copy(*prop[i].column + j*prop[i].size,prop[i].ini,prop[i].size);
       }
+      prop[i].state = Prop::Stored;
 
-     // Update the entry...
-      faceProp[i].offset = memOffset;
-      memOffset += faceProp[i].size;
-      faceProp[i].state = Prop::Stored;
-
-     // Re-arrange the array...
-      if (ci!=i) faceProp[ci] = faceProp[i];
-      ++ci;
+     if (ci!=i) prop[ci] = prop[i];
+     ++ci;
     }
     break;
     case Prop::Deleted:
     {
-     // Do nothing and it will not be copied over (Well, free its ini memory.)...
-      mem::Free(faceProp[i].ini);
+     // Free its memory and it will not be copied over...
+      if (prop[i].column)
+      {
+       mem::Free(*prop[i].column);
+       mem::Free(prop[i].column);
+      }
+      mem::Free(prop[i].ini);
     }
     break;
    }
   }
-  faceProp.Size(ci);
-  facePropSize = memOffset;
-
-
- // Convert the list of operations into an array of operations - speed of access matters...
-  ds::Array<Op> prog(opList.Size());
-  {
-   ds::List<Op>::Cursor targ = opList.FrontPtr();
-   for (nat32 i=0;i<prog.Size();i++)
-   {
-    prog[i] = *targ;
-    ++targ;
-   }
-  }
-
-
- // Go through the entire list and apply the operation sequence to all...
- // (Rebuild the list afterwards, to make iteration possible.)
-  if (faces.Size()!=0)
-  {
-   ds::SortList<Face*> newFaces;
-   ds::SortList<Face*>::Cursor targ = faces.FrontPtr();
-   while (!targ.Bad())
-   {
-    // Create the new data, re-arrange the pointers...
-     Face * to = (Face*)(void*)mem::Malloc<byte>(facePropSize);
-     newFaces.Add(to);
-     RepointFace(*targ,to);
-
-    // Run the mini-program...
-     for (nat32 i=0;i<prog.Size();i++)
-     {
-      if (prog[i].op) mem::Copy(((byte*)(void*)to) + prog[i].offset,prog[i].ini,prog[i].size);
-      else mem::Copy(((byte*)(void*)to) + prog[i].offset,(byte*)(void*)(*targ) + prog[i].oldOffset,prog[i].size);
-     }
-
-    // Terminate, move to next...
-     mem::Free(*targ);
-     ++targ;
-   }
-   faces.Take(newFaces);
-  }
+  prop.Size(ci);
 
 
  // Re-index the names...
-  faceByName.Reset();
-  for (nat32 i=0;i<faceProp.Size();i++)
+  byName.Reset();
+  for (nat32 i=0;i<prop.Size();i++)
   {
-   faceByName.Set(faceProp[i].name,i);
+   byName.Set(prop[i].name,i);
   }
 }
 
-void Mesh::RepointVertex(Vertex * from,Vertex * to)
+void Mesh::WipeProp(ds::Array<Prop> & prop)
 {
- to->edge = from->edge;
- to->pos = from->pos;
-
- DirEdge * targ = to->edge;
- if (targ)
+ for (nat32 i=0;i<prop.Size();i++)
  {
-  do
+  if (prop[i].column)
   {
-   targ->partner->to = to;
-   targ = targ->next;
-  } while (targ!=to->edge);
- }
-}
-
-void Mesh::RepointEdge(DirEdge * from,DirEdge * to)
-{
- DirEdge * from2 = from + 1;
- DirEdge * to2 = to + 1;
-
- to->to = from->to;
- to->partner = to2;
- to->next = from->next;
- to->prev = from->prev;
- to->user = from->user;
-
- to2->to = from2->to;
- to2->partner = to;
- to2->next = from2->next;
- to2->prev = from2->prev;
- to2->user = from2->user;
-
-
- // Repoint vertices...
-  to->to->edge = to2;
-  to2->to->edge = to;
-
-
- // Repoint other DirEdges...
-  to->next->prev = to;
-  to->prev->next = to;
-
-  to2->next->prev = to2;
-  to2->prev->next = to2;
-
-
- // Repoint HalfEdges...
-  if (to->user)
-  {
-   HalfEdge * targ = to->user;
-   do
-   {
-    targ->edge = to;
-    targ = targ->next;
-   } while (targ!=to->user);
+   mem::Free(*prop[i].column);
+   mem::Free(prop[i].column);
   }
-
-  if (to2->user)
-  {
-   HalfEdge * targ = to2->user;
-   do
-   {
-    targ->edge = to2;
-    targ = targ->next;
-   } while (targ!=to2->user);
-  }
-}
-
-void Mesh::RepointFace(Face * from,Face * to)
-{
- to->edge = from->edge;
- to->size = from->size;
-
- HalfEdge * targ = to->edge;
- do
- {
-  targ->face = to;
-  targ = targ->chain;
- } while(targ!=to->edge);
+  mem::Free(prop[i].ini);
+ }
+ prop.Size(0);
 }
 
 void Mesh::CheckDegenFace(Face * face)
@@ -2176,7 +1886,7 @@ void Mesh::CheckDegenFace(Face * face)
     // Terminate e2...
      DirEdge * first = math::Min(e2,e2->partner);
      edges.Rem(first);
-     mem::Free(first);
+     FreeEdge(first);
    }
    
   // Remove the half edges...
@@ -2200,7 +1910,7 @@ void Mesh::CheckDegenFace(Face * face)
 
   // Terminate...
    faces.Rem(face);
-   mem::Free(face); 
+   FreeFace(face); 
  }
 }
 
@@ -2367,9 +2077,9 @@ bit Vertex::SafeMove(const bs::Vert & newPos) const
  return true;
 }
 
-void * Vertex::PropPtr(Vertex * ptr)
+nat32 Vertex::PropId(Vertex * ptr)
 {
- return ptr->vert;
+ return ptr->vert->id;
 }
 
 //------------------------------------------------------------------------------
@@ -2538,9 +2248,9 @@ Vertex Edge::Link(Edge other) const
   return Vertex();
 }
 
-void * Edge::PropPtr(Edge * ptr)
+nat32 Edge::PropId(Edge * ptr)
 {
- return ptr->edge;
+ return ptr->edge->id;
 }
 
 //------------------------------------------------------------------------------
@@ -2794,9 +2504,9 @@ void Face::Reverse()
   targ->chain = prevTarg;
 }
 
-void * Face::PropPtr(Face * ptr)
+nat32 Face::PropId(Face * ptr)
 {
- return ptr->face;
+ return ptr->face->id;
 }
 
 //------------------------------------------------------------------------------
@@ -38,6 +38,7 @@
 #include "eos/bs/geo3d.h"
 #include "eos/ds/arrays.h"
 #include "eos/ds/sort_lists.h"
+#include "eos/ds/flat_hash.h"
 #include "eos/svt/node.h"
 #include "eos/str/tokens.h"
 #include "eos/data/property.h"
@@ -55,6 +56,7 @@ class EOS_CLASS IterVertexEdges;
 class EOS_CLASS IterVertexFaces;
 
 class EOS_CLASS MeshTransfer;
+class EOS_CLASS IndexedMesh;
 
 //------------------------------------------------------------------------------
 /// An editable mesh, suports non-manifold topology and all standard querys and
@@ -67,6 +69,9 @@ class EOS_CLASS MeshTransfer;
 /// vertices/edges/faces, you can then do as you will with this data.
 /// Note that when naming properties all names begining with $ are reserved for
 /// internal use, so do not create any properties that start as such.
+/// Each property is stored as its own column, indexed by the id of the 
+/// vertex/edge/face, so adding or removing one only touches that column and
+/// bulk operations can run straight down a column.
 class EOS_CLASS Mesh
 {
  public:
@@ -255,11 +260,14 @@ class EOS_CLASS Mesh
    
   /// The Add and Rem methods for properties do not cause an imediate affect for
   /// efficiency reasons, so you call the operations you want to do and then 
-  /// call this method. This will then go through the entire data structure and
-  /// apply every change made. After this all data::Property will be invalid and
-  /// all handles will be invalid, unless no changes were made to that particular
-  /// class. From the moment you call a Add/Rem method you shouldn't access 
-  /// properties again until you have called commit.
+  /// call this method. This creates a column for each added property, filled
+  /// with its default, and frees the column of each removed property, so its
+  /// cost depends only on the columns changed. Handles remain valid, as do
+  /// data::Property for properties that were neither added nor removed, though
+  /// indices may change. From the moment you call a Add/Rem method you 
+  /// shouldn't access properties again until you have called commit.
+  /// (useDefault is retained for compatibility, new columns are always 
+  /// initialised with the default.)
    void Commit(bit useDefault = true);
 
 
@@ -269,11 +277,11 @@ class EOS_CLASS Mesh
 
   /// This returns how many properties have been assigned to edges.
   /// Does not work during an edit/commit call sequence.
-   nat32 CountEdgeProp() const {return vertProp.Size();}
+   nat32 CountEdgeProp() const {return edgeProp.Size();}
    
   /// This returns how many properties have been assigned to faces.
   /// Does not work during an edit/commit call sequence.
-   nat32 CountFaceProp() const {return vertProp.Size();}
+   nat32 CountFaceProp() const {return faceProp.Size();}
 
 
   /// This returns true if the given vertex property exists, false if it does not.
@@ -395,6 +403,30 @@ class EOS_CLASS Mesh
   /// Templated on the type of the property.
    template <typename T>
    data::Property<sur::Face,T> GetFaceProp(cstrconst name) const;
+
+
+  /// Returns the column of the indexed vertex property, for bulk operations.
+  /// It is indexed by sur::Vertex::Id(), entries for ids not currently in use
+  /// are junk. Only valid until the next vertex is created or Commit called.
+   void * VertPropColumn(nat32 i) const {return *vertProp[i].column;}
+
+  /// Returns the column of the indexed edge property, indexed by 
+  /// sur::Edge::Id(). Same rules as VertPropColumn.
+   void * EdgePropColumn(nat32 i) const {return *edgeProp[i].column;}
+
+  /// Returns the column of the indexed face property, indexed by 
+  /// sur::Face::Id(). Same rules as VertPropColumn.
+   void * FacePropColumn(nat32 i) const {return *faceProp[i].column;}
+
+  /// Returns one more than the largest vertex id that has been used, i.e. the
+  /// range to run over when processing a vertex column.
+   nat32 VertIdRange() const {return vertIds.next;}
+
+  /// Returns one more than the largest edge id that has been used.
+   nat32 EdgeIdRange() const {return edgeIds.next;}
+
+  /// Returns one more than the largest face id that has been used.
+   nat32 FaceIdRange() const {return faceIds.next;}
    
    
   /// Transfers all vertex properties from one vertex handle to another.
@@ -440,6 +472,7 @@ class EOS_CLASS Mesh
    DirEdge * edge; // Any DirEdge escaping from the vertex. (edge->to!=this)
    bs::Vert pos;
    nat32 ind; // Index within the data structure. Only valid at certain points.
+   nat32 id; // Entry in the property columns, fixed for its lifetime.
   };
   
   struct DirEdge
@@ -452,6 +485,7 @@ class EOS_CLASS Mesh
    
    HalfEdge * user; // Any half edge thats in the same direction as this DirEdge.
    nat32 ind; // Index within the data structure. Only valid at certain points.
+   nat32 id; // Entry in the property columns, the same for both of a pair.
   };
   
   struct HalfEdge
@@ -469,6 +503,7 @@ class EOS_CLASS Mesh
    HalfEdge * edge; // Any half edge that makes up the faces edge ring.
    nat32 size; // How many vertices/edges it has.
    nat32 ind; // Index within the data structure. Only valid at certain points.
+   nat32 id; // Entry in the property columns, fixed for its lifetime.
   };
 
 
@@ -481,6 +516,7 @@ class EOS_CLASS Mesh
   friend class sur::IterVertexEdges;
   friend class sur::IterVertexFaces;
   friend class sur::MeshTransfer;
+  friend class sur::IndexedMesh;
 
 
  // Storage for all the contained things, so we can iterate them and delete them...
@@ -497,7 +533,7 @@ class EOS_CLASS Mesh
    nat32 size;
    byte * ini; // Malloc'ed.
 
-   nat32 offset; // Offset into any given set of fields to get to this one, allways from start of data structure.
+   byte ** column; // Malloc'ed, points to the malloc'ed column so it can grow without invalidating data::Property's. null until Added is commited.
 
    enum State {Stored, // It is currently in the data structure, no change needed.
                Added, // It does not currently exist and must be added next Commit.
@@ -511,55 +547,62 @@ class EOS_CLASS Mesh
   bit vertPropChanged;
   bit edgePropChanged;
   bit facePropChanged;
-  
-  nat32 vertPropSize;
-  nat32 edgePropSize;
-  nat32 facePropSize;
 
   ds::Array<Prop> vertProp;
   ds::Array<Prop> edgeProp;
   ds::Array<Prop> faceProp;
   
-  ds::SparseHash<nat32> vertByName;
-  ds::SparseHash<nat32> edgeByName;
-  ds::SparseHash<nat32> faceByName;
+  ds::FlatHash<nat32> vertByName;
+  ds::FlatHash<nat32> edgeByName;
+  ds::FlatHash<nat32> faceByName;
+
+
+ // Hands out the ids used to index the columns, reusing the ids of deleted 
+ // elements so the columns stay dense...
+  struct IdPool
+  {
+   nat32 next; // Ids from this upwards have never been used.
+   nat32 capacity; // Entries allocated in every column of this kind.
+   nat32 spare; // How many ids are waiting in free.
+   ds::Array<nat32> free; // Grows by doubling.
+  };
+  
+  IdPool vertIds;
+  IdPool edgeIds;
+  IdPool faceIds;
 
 
  // Structure used in the conversion from/to svt...
   struct HopSkip
   {
    nat32 size;
-   nat32 fromOffset;
+   byte ** column;
    nat32 toInd;
   };
  
  
- // Structure used to represent operations in the below stuff...
-  struct Op
-  {
-   bit op; // false==offset copy, true==memory block copy.
-   nat32 offset;
-   nat32 size;
-   union
-   {
-    nat32 oldOffset; // op==false.
-    byte * ini; // op==true.
-   };
-  };
- 
- // Suport methods for the property system, used by the commit method...
-  // The commit method is broken into 3, for obvious reasons...
-   void CommitVertex(bit useDefault);
-   void CommitEdge(bit useDefault);
-   void CommitFace(bit useDefault);
-
-  // These edit all pointers in other objects given the old pointer so that they 
-  // point to the new pointer. Also copies over all data from the previous 
-  // data, so all you have to worry about is copying over properties.
-  // (This is for replacement, not merging, as merging requires degenracy checking.)
-   void RepointVertex(Vertex * from,Vertex * to);
-   void RepointEdge(DirEdge * from,DirEdge * to); // Does the partner as well, must be given the first in memory of each.
-   void RepointFace(Face * from,Face * to);
+ // Suport methods for the property system...
+  // Creates and destroys elements, handing out and reclaiming there ids, 
+  // with the defaults written into the columns of new elements...
+   Vertex * AllocVertex();
+   DirEdge * AllocEdge(); // Returns a pair, the second directly after the first.
+   Face * AllocFace();
+   
+   void FreeVertex(Vertex * vert);
+   void FreeEdge(DirEdge * first); // Must be given the first in memory of the pair.
+   void FreeFace(Face * face);
+
+  // Gets an id from a pool, growing all the columns if needed and writing in
+  // the defaults, and returns an id to a pool...
+   static nat32 NewId(IdPool & pool,ds::Array<Prop> & prop);
+   static void FreeId(IdPool & pool,nat32 id);
+
+  // Applys the changes to one kind of property, the commit method is broken 
+  // into 3 for obvious reasons...
+   static void CommitProp(IdPool & pool,ds::Array<Prop> & prop,ds::FlatHash<nat32> & byName);
+   
+  // Frees all the columns of a property list, and empties it...
+   static void WipeProp(ds::Array<Prop> & prop);
    
   // This is given a face, it checks if its degenerate, if it is it deletes it.
   // It also handles the fact that this will usually mean duplicate storage of an
@@ -626,6 +669,11 @@ class EOS_CLASS Vertex
   /// &nbsp;
    const nat32 & Index() const {return vert->ind;}  
 
+  /// Returns the id of the vertex, which indexes the columns returned by 
+  /// Mesh::VertPropColumn. Fixed for the life of the vertex, but may be reused
+  /// after it is deleted.
+   nat32 Id() const {return vert->id;}
+
 
   /// Returns the position of the vertex. You may edit it directly.
    bs::Vert & Pos() {return vert->pos;}
@@ -679,9 +727,10 @@ class EOS_CLASS Vertex
   friend class sur::IterVertexEdges;
   friend class sur::IterVertexFaces;
   friend class sur::MeshTransfer;
+  friend class sur::IndexedMesh;
   
   Vertex(Mesh::Vertex * v):vert(v) {}
-  static void * PropPtr(Vertex * ptr);
+  static nat32 PropId(Vertex * ptr);
 
   Mesh::Vertex * vert;
 };
@@ -717,6 +766,11 @@ class EOS_CLASS Edge
   /// &nbsp;
    const nat32 & Index() const {return edge->ind;}
 
+  /// Returns the id of the edge, which indexes the columns returned by 
+  /// Mesh::EdgePropColumn. Fixed for the life of the edge, but may be reused
+  /// after it is deleted.
+   nat32 Id() const {return edge->id;}
+
 
   /// Returns how many faces the edge has.
    nat32 FaceCount() const;
@@ -790,7 +844,7 @@ class EOS_CLASS Edge
   {
    if (edge->partner<edge) edge = edge->partner;
   }
-  static void * PropPtr(Edge * ptr);
+  static nat32 PropId(Edge * ptr);
 
   Mesh::DirEdge * edge;
 };
@@ -825,6 +879,11 @@ class EOS_CLASS Face
 
   /// &nbsp;
    const nat32 & Index() const {return face->ind;}
+
+  /// Returns the id of the face, which indexes the columns returned by 
+  /// Mesh::FacePropColumn. Fixed for the life of the face, but may be reused
+  /// after it is deleted.
+   nat32 Id() const {return face->id;}
    
    
   /// Outputs the normal and distance from the origin of the face, assumes the 
@@ -898,7 +957,7 @@ class EOS_CLASS Face
   friend class sur::MeshTransfer;
 
   Face(Mesh::Face * f):face(f) {}
-  static void * PropPtr(Face * ptr);
+  static nat32 PropId(Face * ptr);
 
   Mesh::Face * face;
 };
@@ -907,14 +966,14 @@ class EOS_CLASS Face
 template <typename T>
 inline data::Property<sur::Vertex,T> Mesh::GetIndVertProp(nat32 i) const
 {
- return data::Property<sur::Vertex,T>(vertProp[i].offset,sur::Vertex::PropPtr);
+ return data::Property<sur::Vertex,T>(vertProp[i].column,vertProp[i].size,sur::Vertex::PropId);
 }
 
 template <typename T>
 inline data::Property<sur::Vertex,T> Mesh::GetVertProp(str::Token name) const
 {
  nat32 * ind = vertByName.Get(name);
- if (ind) return data::Property<sur::Vertex,T>(vertProp[*ind].offset,sur::Vertex::PropPtr);
+ if (ind) return data::Property<sur::Vertex,T>(vertProp[*ind].column,vertProp[*ind].size,sur::Vertex::PropId);
      else return data::Property<sur::Vertex,T>();
 }
 
@@ -922,21 +981,21 @@ template <typename T>
 inline data::Property<sur::Vertex,T> Mesh::GetVertProp(cstrconst name) const
 {
  nat32 * ind = vertByName.Get((*tt)(name));
- if (ind) return data::Property<sur::Vertex,T>(vertProp[*ind].offset,sur::Vertex::PropPtr);
+ if (ind) return data::Property<sur::Vertex,T>(vertProp[*ind].column,vertProp[*ind].size,sur::Vertex::PropId);
      else return data::Property<sur::Vertex,T>();
 }
 
 template <typename T>
 inline data::Property<sur::Edge,T> Mesh::GetIndEdgeProp(nat32 i) const
 {
- return data::Property<sur::Edge,T>(edgeProp[i].offset,sur::Edge::PropPtr);
+ return data::Property<sur::Edge,T>(edgeProp[i].column,edgeProp[i].size,sur::Edge::PropId);
 }
 
 template <typename T>
 inline data::Property<sur::Edge,T> Mesh::GetEdgeProp(str::Token name) const
 {
  nat32 * ind = edgeByName.Get(name);
- if (ind) return data::Property<sur::Edge,T>(edgeProp[*ind].offset,sur::Edge::PropPtr);
+ if (ind) return data::Property<sur::Edge,T>(edgeProp[*ind].column,edgeProp[*ind].size,sur::Edge::PropId);
      else return data::Property<sur::Edge,T>();
 }
 
@@ -944,21 +1003,21 @@ template <typename T>
 inline data::Property<sur::Edge,T> Mesh::GetEdgeProp(cstrconst name) const
 {
  nat32 * ind = edgeByName.Get((*tt)(name));
- if (ind) return data::Property<sur::Edge,T>(edgeProp[*ind].offset,sur::Edge::PropPtr);
+ if (ind) return data::Property<sur::Edge,T>(edgeProp[*ind].column,edgeProp[*ind].size,sur::Edge::PropId);
      else return data::Property<sur::Edge,T>();
 }
 
 template <typename T>
 inline data::Property<sur::Face,T> Mesh::GetIndFaceProp(nat32 i) const
 {
- return data::Property<sur::Face,T>(faceProp[i].offset,sur::Face::PropPtr);
+ return data::Property<sur::Face,T>(faceProp[i].column,faceProp[i].size,sur::Face::PropId);
 }
 
 template <typename T>
 inline data::Property<sur::Face,T> Mesh::GetFaceProp(str::Token name) const
 {
  nat32 * ind = faceByName.Get(name);
- if (ind) return data::Property<sur::Face,T>(faceProp[*ind].offset,sur::Face::PropPtr);
+ if (ind) return data::Property<sur::Face,T>(faceProp[*ind].column,faceProp[*ind].size,sur::Face::PropId);
      else return data::Property<sur::Face,T>();
 }
 
@@ -966,7 +1025,7 @@ template <typename T>
 inline data::Property<sur::Face,T> Mesh::GetFaceProp(cstrconst name) const
 {
  nat32 * ind = faceByName.Get((*tt)(name));
- if (ind) return data::Property<sur::Face,T>(faceProp[*ind].offset,sur::Face::PropPtr);
+ if (ind) return data::Property<sur::Face,T>(faceProp[*ind].column,faceProp[*ind].size,sur::Face::PropId);
      else return data::Property<sur::Face,T>();
 }
 
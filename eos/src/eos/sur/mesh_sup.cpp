@@ -17,26 +17,25 @@
 
 #include "eos/sur/mesh_sup.h"
 
+#include "eos/mt/tasks.h"
+#include "eos/sur/indexed_mesh.h"
+#include "eos/sur/bvh.h"
+
 namespace eos
 {
  namespace sur
  {
 //------------------------------------------------------------------------------
-MeshTransfer::MeshTransfer(const Mesh & from,Mesh & ttoo)
-:to(ttoo)
+MeshTransfer::MeshTransfer(const Mesh & ffrom,Mesh & ttoo)
+:from(ffrom),to(ttoo)
 {
  // Create the 3 op arrays...
   Build(from.vertProp,from.vertByName,to.vertProp,vertOp);
   Build(from.edgeProp,from.edgeByName,to.edgeProp,edgeOp);
   Build(from.faceProp,from.faceByName,to.faceProp,faceOp);
  
- // Optimise them...
-  Optimise(vertOp);
-  Optimise(edgeOp);
-  Optimise(faceOp);
- 
  // Create the interpolation info...
-  str::Token realType = (*to.tt)("real32"); 
+  str::Token realType = (*to.tt)(typestring<real32>());
   // Count...
    nat32 size = 0;
    for (nat32 i=0;i<to.vertProp.Size();i++)
@@ -58,8 +57,8 @@ MeshTransfer::MeshTransfer(const Mesh & from,Mesh & ttoo)
         (from.vertByName.Exists(to.vertProp[i].name))&&
         (from.vertProp[*from.vertByName.Get(to.vertProp[i].name)].type==realType))
     {
-     vertReal[size].fromOffset = from.vertProp[*from.vertByName.Get(to.vertProp[i].name)].offset;
-     vertReal[size].toOffset = to.vertProp[i].offset;
+     vertReal[size].fromCol = from.vertProp[*from.vertByName.Get(to.vertProp[i].name)].column;
+     vertReal[size].toCol = to.vertProp[i].column;
      ++size;
     }
    }   
@@ -70,17 +69,17 @@ MeshTransfer::~MeshTransfer()
 
 void MeshTransfer::Transfer(sur::Vertex to,const sur::Vertex from)
 {
- for (nat32 i=0;i<vertOp.Size();i++) vertOp[i].DoTra((byte*)to.vert,(byte*)from.vert);
+ for (nat32 i=0;i<vertOp.Size();i++) vertOp[i].DoTra(to.vert->id,from.vert->id);
 }
 
 void MeshTransfer::Transfer(sur::Edge to,const sur::Edge from)
 {
- for (nat32 i=0;i<edgeOp.Size();i++) edgeOp[i].DoTra((byte*)to.edge,(byte*)from.edge);
+ for (nat32 i=0;i<edgeOp.Size();i++) edgeOp[i].DoTra(to.edge->id,from.edge->id);
 }
 
 void MeshTransfer::Transfer(sur::Face to,const sur::Face from)
 {
- for (nat32 i=0;i<faceOp.Size();i++) faceOp[i].DoTra((byte*)to.face,(byte*)from.face);
+ for (nat32 i=0;i<faceOp.Size();i++) faceOp[i].DoTra(to.face->id,from.face->id);
 }
 
 sur::Vertex MeshTransfer::Interpolate(nat32 n,sur::Vertex * v,real32 * weight)
@@ -105,34 +104,128 @@ sur::Vertex MeshTransfer::Interpolate(nat32 n,sur::Vertex * v,real32 * weight)
   sur::Vertex ret = to.NewVertex(pos);
  
  // Transfer over from the first vertex all normal stuff...
-  for (nat32 i=0;i<vertOp.Size();i++) vertOp[i].DoTra((byte*)ret.vert,(byte*)v[0].vert);
+  for (nat32 i=0;i<vertOp.Size();i++) vertOp[i].DoTra(ret.vert->id,v[0].vert->id);
  
  // Interpolate real32 fields...
   for (nat32 i=0;i<vertReal.Size();i++)
   {
+   const real32 * from = (real32*)(void*)*vertReal[i].fromCol;
    real32 val = 0.0;
-   for (nat32 j=0;j<n;j++) val += weight[j] * (*(real32*)(void*)(((byte*)v[j].vert)+vertReal[i].fromOffset));
+   for (nat32 j=0;j<n;j++) val += weight[j] * from[v[j].vert->id];
    val /= weightSum;
    
-   (*(real32*)(void*)(((byte*)ret.vert)+vertReal[i].toOffset)) = val;
+   ((real32*)(void*)*vertReal[i].toCol)[ret.vert->id] = val;
   }
  
  // Return the new vertex...
   return ret;
 }
 
-void MeshTransfer::Build(const ds::Array<Mesh::Prop> & from,const ds::SparseHash<nat32> & index,
+//------------------------------------------------------------------------------
+// Does the transfers for Project, a range of 'to' vertices at a time...
+class MeshProject
+{
+ public:
+  MeshProject(MeshTransfer & s,const nat32 * tt,const Bvh::Hit * h,const nat32 * t,const nat32 * fi)
+  :self(s),toId(tt),hit(h),tri(t),fromId(fi) {}
+
+  void operator()(nat32 begin,nat32 end)
+  {
+   for (nat32 i=begin;i<end;i++)
+   {
+    const Bvh::Hit & h = hit[i];
+    if (h.tri==nat32(-1)) continue;
+
+    nat32 corner[3];
+    for (nat32 c=0;c<3;c++) corner[c] = fromId[tri[h.tri*3+c]];
+
+    nat32 nearest = 0;
+    if (h.w[1]>h.w[nearest]) nearest = 1;
+    if (h.w[2]>h.w[nearest]) nearest = 2;
+
+    for (nat32 j=0;j<self.vertOp.Size();j++) self.vertOp[j].DoTra(toId[i],corner[nearest]);
+
+    for (nat32 j=0;j<self.vertReal.Size();j++)
+    {
+     const real32 * f = (real32*)(void*)*self.vertReal[j].fromCol;
+     real32 val = h.w[0]*f[corner[0]] + h.w[1]*f[corner[1]] + h.w[2]*f[corner[2]];
+     ((real32*)(void*)*self.vertReal[j].toCol)[toId[i]] = val;
+    }
+   }
+  }
+
+  MeshTransfer & self;
+  const nat32 * toId;
+  const Bvh::Hit * hit;
+  const nat32 * tri;
+  const nat32 * fromId;
+};
+
+nat32 MeshTransfer::Project(real32 maxDist)
+{
+ LogTime("eos::sur::MeshTransfer::Project");
+
+ // Build the search structure for the from mesh, and remember the id of each
+ // of its vertices by index...
+  IndexedMesh im;
+  im.FromMesh(from);
+  Bvh bvh;
+  bvh.Build(im);
+
+  ds::Array<nat32> fromId(from.verts.Size());
+  {
+   ds::SortList<Mesh::Vertex*>::Cursor targ = from.verts.FrontPtr();
+   for (nat32 i=0;i<fromId.Size();i++)
+   {
+    fromId[i] = (*targ)->id;
+    ++targ;
+   }
+  }
+
+
+ // Collect the to vertices, and find the closest point for each...
+  nat32 count = to.verts.Size();
+  ds::Array<nat32> toId(count);
+  ds::Array<bs::Vert> point(count);
+  {
+   ds::SortList<Mesh::Vertex*>::Cursor targ = to.verts.FrontPtr();
+   for (nat32 i=0;i<count;i++)
+   {
+    toId[i] = (*targ)->id;
+    point[i] = (*targ)->pos;
+    ++targ;
+   }
+  }
+
+  ds::Array<Bvh::Hit> hit(count);
+  bvh.Closest(count,point.Ptr(),hit.Ptr(),maxDist);
+
+
+ // Do the transfers...
+  MeshProject mp(*this,toId.Ptr(),hit.Ptr(),im.Tris(),fromId.Ptr());
+  mt::ParallelFor(nat32(0),count,mp,1024);
+
+  nat32 ret = 0;
+  for (nat32 i=0;i<count;i++)
+  {
+   if (hit[i].tri!=nat32(-1)) ++ret;
+  }
+
+ return ret;
+}
+
+void MeshTransfer::Build(const ds::Array<Mesh::Prop> & from,const ds::FlatHash<nat32> & index,
                          const ds::Array<Mesh::Prop> & to,ds::Array<Op> & out)
 {
  out.Size(to.Size());
  for (nat32 i=0;i<out.Size();i++)
  {
-  out[i].toOffset = to[i].offset;
+  out[i].toCol = to[i].column;
   out[i].size = to[i].size;
   if ((index.Exists(to[i].name))&&(from[*index.Get(to[i].name)].size==to[i].size))
   {
    out[i].type = true;
-   out[i].fromOffset = from[*index.Get(to[i].name)].offset;
+   out[i].fromCol = from[*index.Get(to[i].name)].column;
   }
   else
   {
@@ -142,34 +235,6 @@ void MeshTransfer::Build(const ds::Array<Mesh::Prop> & from,const ds::SparseHash
  }
 }
 
-void MeshTransfer::Optimise(ds::Array<MeshTransfer::Op> & ops)
-{
- // Firstly sort the operations by there 'to' offset...
-  ops.SortNorm();
- 
- // Now check for operations that can be merged...
-  nat32 newLength = ops.Size();
-  nat32 last = 0;
-  for (nat32 i=1;i<ops.Size();i++)
-  {
-   if ((ops[last].type==true)&&(ops[i].type==true)&& // Check there both the right kind of copys.
-      ((ops[last].toOffset+ops[last].size)==ops[i].toOffset)&& // Check they copy to adjacent locations.
-      ((ops[last].fromOffset+ops[last].size)==ops[i].fromOffset)) // Check they copy from adjacent locations.
-   {
-    // They can be merged...
-     ops[last].size += ops[i].size;
-     --newLength;
-   }
-   else
-   {
-    // They can't be merged...
-     ++last;
-     if (last!=i) ops[last] = ops[i];
-   }
-  }
-  ops.Size(newLength);
-}
-
 //------------------------------------------------------------------------------
  };
 };
@@ -22,6 +22,7 @@
 /// Mesh support tools, to assist in manipulating meshes.
 
 #include "eos/types.h"
+#include "eos/math/functions.h"
 #include "eos/sur/mesh.h"
 
 namespace eos
@@ -42,6 +43,10 @@ namespace eos
 /// involved meshes then have Commit() called again the structure will become
 /// wrong and a new one of these will need constructing, unless you want a crash.
 /// Do not use it whilst adding/deleting fields before you have commited.
+///
+/// It can also project the vertex properties of the 'from' mesh onto the
+/// 'to' mesh wholesale, by finding the closest point on the 'from' surface for
+/// every 'to' vertex. This uses a Bvh, so is fine for big meshes.
 class EOS_CLASS MeshTransfer
 {
  public:
@@ -68,6 +73,16 @@ class EOS_CLASS MeshTransfer
   /// Returns the new vertex handle.
   /// The non interpolatable properties are copied from the first entry.
    sur::Vertex Interpolate(nat32 n,sur::Vertex * v,real32 * weight);
+
+
+  /// For every vertex in the 'to' mesh finds the closest point on the surface
+  /// of the 'from' mesh, within maxDist, and sets its properties from there.
+  /// real32 properties are interpolated with the barycentric weights of the
+  /// closest point, the rest are copied from the nearest corner of the
+  /// triangle. Positions are left alone. Done in parallel; the two meshes
+  /// should not be the same mesh. Returns how many vertices were projected,
+  /// those without a surface in range are left unchanged.
+   nat32 Project(real32 maxDist = math::Infinity<real32>());
    
    
   /// &nbsp;
@@ -75,34 +90,32 @@ class EOS_CLASS MeshTransfer
 
 
  private:
+  friend class MeshProject;
+
+  const Mesh & from;
   Mesh & to;
  
-  // A transfer consists of a sequence of operations, represented by an array of these. Each translates to a mem::Copy.
+  // A transfer consists of a sequence of operations, represented by an array of these. Each translates to a mem::Copy between columns.
    struct Op
    {
-    nat32 toOffset; // Offset in target to transfer to.
-    nat32 size; // How large the transfer should be.
-    bit type; // If false from is a fixed pointer, if true its an offset into the from memory.
+    byte ** toCol; // Column in target to transfer to.
+    nat32 size; // How large each entry is.
+    bit type; // If false from is a fixed pointer, if true its a column in the from mesh.
     union
     {
-     nat32 fromOffset;
+     byte ** fromCol;
      byte * fromPtr;
     };
    
-    void Do(byte * to,byte * from)
+    void Do(nat32 toId,nat32 fromId)
     {
-     if (type) mem::Copy(to+toOffset,from+fromOffset,size);
-          else mem::Copy(to+toOffset,fromPtr,size);
+     if (type) mem::Copy(*toCol + toId*size,*fromCol + fromId*size,size);
+          else mem::Copy(*toCol + toId*size,fromPtr,size);
     }
     
-    void DoTra(byte * to,byte * from)
+    void DoTra(nat32 toId,nat32 fromId)
     {
-     if (type) mem::Copy(to+toOffset,from+fromOffset,size);
-    }
-        
-    bit operator < (const Op & rhs) const
-    {
-     return toOffset < rhs.toOffset;
+     if (type) mem::Copy(*toCol + toId*size,*fromCol + fromId*size,size);
     }
    };
   
@@ -112,12 +125,12 @@ class EOS_CLASS MeshTransfer
    ds::Array<Op> faceOp;
 
 
-  // Information for doing interpolation - offsets of matching real32's in the
+  // Information for doing interpolation - columns of matching real32's in the
   // two sides, for vertices alone as only they are interpolatable...
    struct Match
    {
-    nat32 fromOffset;
-    nat32 toOffset;
+    byte ** fromCol;
+    byte ** toCol;
    };
    ds::Array<Match> vertReal;
 
@@ -126,11 +139,8 @@ class EOS_CLASS MeshTransfer
   // Helper methods...
    // This is given a from property list,its index, a to property list and an output
    // op array - it fills the array accordingly...
-    void Build(const ds::Array<Mesh::Prop> & from,const ds::SparseHash<nat32> & index,
+    void Build(const ds::Array<Mesh::Prop> & from,const ds::FlatHash<nat32> & index,
                const ds::Array<Mesh::Prop> & to,ds::Array<Op> & out);
-    
-   // This optimises an op array to make it as efficiant as possible...
-    void Optimise(ds::Array<Op> & ops);
 };
 
 //------------------------------------------------------------------------------
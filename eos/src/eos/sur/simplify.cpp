@@ -18,10 +18,10 @@
 #include "eos/sur/simplify.h"
 
 #include "eos/ds/sort_lists.h"
-#include "eos/ds/kd_tree.h"
 #include "eos/sur/mesh_iter.h"
 #include "eos/sur/mesh_sup.h"
 #include "eos/math/iter_min.h"
+#include "eos/mt/tasks.h"
 
 
 namespace eos
@@ -29,11 +29,135 @@ namespace eos
  namespace sur
  {
 //------------------------------------------------------------------------------
-// Position accessor for putting Mesh::Vertex objects into a KD tree...
-real64 VertexPos(const Vertex * v,nat32 dim)
+// Finds every pair of vertices within a given range of each other, range
+// being per axis as for a box query, using a uniform spatial hash with cells
+// the size of the range, so each vertex only has to check the 27 cells around
+// it. The cells are hashed into a table twice the size of the vertex count,
+// with the vertices sorted into buckets by counting, so its expected linear
+// time; the neighbour searches run in parallel. Outputs, for each vertex, the
+// vertices after it in the array that are within range, in compressed row
+// form, in an order that only depends on the input...
+class VertexWeld
 {
- return v->Pos()[dim];
-}
+ public:
+  VertexWeld(const ds::Array<Vertex> & v,real32 r)
+  :vert(v),range(r),cellSize((r>0.0)?r:1.0)
+  {}
+
+  void Run()
+  {
+   // Cell and bucket for each vertex...
+    buckets = 1;
+    while (buckets<vert.Size()*2) buckets *= 2;
+
+    cell.Size(vert.Size()*3);
+    bucket.Size(vert.Size());
+    pass = 0;
+    mt::ParallelFor(nat32(0),vert.Size(),*this,1024);
+
+   // Counting sort into buckets, which keeps each bucket in index order...
+    start.Size(buckets+1);
+    for (nat32 i=0;i<start.Size();i++) start[i] = 0;
+    for (nat32 i=0;i<bucket.Size();i++) start[bucket[i]+1] += 1;
+    for (nat32 i=1;i<start.Size();i++) start[i] += start[i-1];
+
+    member.Size(vert.Size());
+    {
+     ds::Array<nat32> pos(buckets);
+     for (nat32 i=0;i<buckets;i++) pos[i] = start[i];
+     for (nat32 i=0;i<vert.Size();i++) member[pos[bucket[i]]++] = i;
+    }
+
+   // Count the neighbours of each vertex, then fill them in...
+    pairStart.Size(vert.Size()+1);
+    pairStart[0] = 0;
+    pass = 1;
+    mt::ParallelFor(nat32(0),vert.Size(),*this,256);
+    for (nat32 i=1;i<pairStart.Size();i++) pairStart[i] += pairStart[i-1];
+
+    pair.Size(pairStart[vert.Size()]);
+    pass = 2;
+    mt::ParallelFor(nat32(0),vert.Size(),*this,256);
+  }
+
+  // Number of vertices after i within range...
+   nat32 Count(nat32 i) const {return pairStart[i+1] - pairStart[i];}
+
+  // The j-th vertex after i within range...
+   nat32 Pair(nat32 i,nat32 j) const {return pair[pairStart[i]+j];}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++)
+   {
+    if (pass==0)
+    {
+     const bs::Vert & p = vert[i].Pos();
+     for (nat32 d=0;d<3;d++) cell[i*3+d] = int32(math::RoundDown(p[d]/cellSize));
+     bucket[i] = Hash(cell[i*3],cell[i*3+1],cell[i*3+2]);
+    }
+    else
+    {
+     nat32 count = 0;
+     nat32 out = (pass==2)?pairStart[i]:0;
+     const bs::Vert & p = vert[i].Pos();
+
+     for (int32 dz=-1;dz<=1;dz++)
+     {
+      for (int32 dy=-1;dy<=1;dy++)
+      {
+       for (int32 dx=-1;dx<=1;dx++)
+       {
+        int32 cx = cell[i*3] + dx;
+        int32 cy = cell[i*3+1] + dy;
+        int32 cz = cell[i*3+2] + dz;
+        nat32 b = Hash(cx,cy,cz);
+
+        for (nat32 k=start[b];k<start[b+1];k++)
+        {
+         nat32 j = member[k];
+         if (j<=i) continue;
+         if ((cell[j*3]!=cx)||(cell[j*3+1]!=cy)||(cell[j*3+2]!=cz)) continue; // Hash collision.
+
+         const bs::Vert & q = vert[j].Pos();
+         if ((math::Abs(q[0]-p[0])<=range)&&
+             (math::Abs(q[1]-p[1])<=range)&&
+             (math::Abs(q[2]-p[2])<=range))
+         {
+          if (pass==2) pair[out++] = j;
+          ++count;
+         }
+        }
+       }
+      }
+     }
+
+     if (pass==1) pairStart[i+1] = count;
+    }
+   }
+  }
+
+ private:
+  const ds::Array<Vertex> & vert;
+  real32 range;
+  real32 cellSize;
+
+  nat32 pass; // Which of the parallel passes is being done.
+  nat32 buckets; // Power of 2.
+  ds::Array<int32> cell; // 3 per vertex.
+  ds::Array<nat32> bucket; // Per vertex.
+  ds::Array<nat32> start; // Offset of each bucket in member, buckets+1.
+  ds::Array<nat32> member; // Vertex indices, sorted by bucket.
+
+  ds::Array<nat32> pairStart;
+  ds::Array<nat32> pair;
+
+  nat32 Hash(int32 x,int32 y,int32 z) const
+  {
+   nat32 h = (nat32(x)*73856093) ^ (nat32(y)*19349663) ^ (nat32(z)*83492791);
+   return h & (buckets-1);
+  }
+};
 
 // Structure used for a forest...
 struct RemDupNode
@@ -46,19 +170,18 @@ struct RemDupNode
 EOS_FUNC void RemDups(Mesh * mesh,real32 range,time::Progress * prog)
 {
  prog->Push();
- // Put all the vertices into a KD tree...
+ // Find all the pairs of vertices in range...
   prog->Report(0,4);
-  ds::KdTree<Vertex,3,VertexPos> kd;
   ds::Array<Vertex> vert;
-  {
-   mesh->GetVertices(vert);
-   for (nat32 i=0;i<vert.Size();i++) kd.Add(vert[i]);
-   kd.Rebalance();
-  }
+  mesh->GetVertices(vert);
+  VertexWeld weld(vert,range);
+  weld.Run();
 
 
  // Create a forest to store the merges - can't do them at the same time as
- // finding them as that causes problems...
+ // finding them as that causes problems. Done in vertex order, so the result
+ // is always the same...
+  prog->Report(1,4);
   ds::Array<RemDupNode> forest(vert.Size());
   for (nat32 i=0;i<forest.Size();i++)
   {
@@ -66,54 +189,25 @@ EOS_FUNC void RemDups(Mesh * mesh,real32 range,time::Progress * prog)
    forest[i].size = 1;
   }
 
-
- // For each vertex check the KD tree for nearby vertices and store if need be...
-  prog->Report(1,4);
-  prog->Push();
-  math::Vector<real64> min(3);
-  math::Vector<real64> max(3);
   for (nat32 i=0;i<vert.Size();i++)
   {
-   prog->Report(i,vert.Size());
-   if (vert[i].Valid())
+   for (nat32 j=0;j<weld.Count(i);j++)
    {
-    // Get the vertexes in the relevant range, should include once self...
-     ds::List<Vertex> list;
-     for (nat32 j=0;j<3;j++)
+    // Get parents...
+     nat32 parA = forest[weld.Pair(i,j)].parent;
+     nat32 parB = forest[i].parent;
+
+     while (forest[parA].parent!=parA) parA = forest[parA].parent;
+     while (forest[parB].parent!=parB) parB = forest[parB].parent;
+
+    // If different then merge...
+     if (parA!=parB)
      {
-      min[j] = vert[i].Pos()[j] - range;
-      max[j] = vert[i].Pos()[j] + range;
+      forest[parB].parent = parA;
+      forest[parA].size += forest[parB].size;
      }
-     kd.GetRange(min,max,list);
-   
-    // Iterate and merge them all...
-     ds::List<Vertex>::Cursor targ = list.FrontPtr();
-     real32 div = 1.0;
-     while (!targ.Bad())
-     {
-      if ((*targ)!=vert[i])
-      {
-       // Its a merge - combine in the forest...
-        // Get parents...
-         nat32 parA = forest[targ->Index()].parent;
-         nat32 parB = forest[vert[i].Index()].parent;
-        
-         while (forest[parA].parent!=parA) parA = forest[parA].parent;
-         while (forest[parB].parent!=parB) parB = forest[parB].parent;
-         
-        // If different then merge...
-         if (parA!=parB)
-         {
-          forest[parB].parent = parA;
-          forest[parA].size += forest[parB].size;
-         }
-      }
-      ++targ;
-     }
-     vert[i].Pos() /= div;
    }
   }
-  prog->Pop();
 
 
  // Iterate the forest and do the merges...
@@ -155,54 +249,127 @@ EOS_FUNC void RemDups(Mesh * mesh,real32 range,time::Progress * prog)
 EOS_FUNC void AddEdges(Mesh * mesh,real32 range,time::Progress * prog)
 {
  prog->Push();
- // Put all the vertices into a KD tree...
+ // Find all the pairs of vertices in range...
   prog->Report(0,2);
-  ds::KdTree<Vertex,3,VertexPos> kd;
   ds::Array<Vertex> vert;
-  {
-   mesh->GetVertices(vert);
-   for (nat32 i=0;i<vert.Size();i++) kd.Add(vert[i]);
-   kd.Rebalance();
-  }
+  mesh->GetVertices(vert);
+  VertexWeld weld(vert,range);
+  weld.Run();
  
- // For each vertex check the KD tree for nearby vertices and make edges if need
- // be...
+ // Make sure they all have edges, in vertex order...
   prog->Report(1,2);
   prog->Push();
-  math::Vector<real64> min(3);
-  math::Vector<real64> max(3);
   for (nat32 i=0;i<vert.Size();i++)
   {
    prog->Report(i,vert.Size());
-   
-   // Get the vertexes in the relevant range, should include once self...
-    ds::List<Vertex> list;
-    for (nat32 j=0;j<3;j++)
-    {
-     min[j] = vert[i].Pos()[j] - range;
-     max[j] = vert[i].Pos()[j] + range;
-    }
-    kd.GetRange(min,max,list);
-   
-   // Iterate and make sure there are edges for all...
-    ds::List<Vertex>::Cursor targ = list.FrontPtr();
-    while (!targ.Bad())
-    {
-     if ((*targ)!=vert[i]) // Not the same vertex.
-     {
-      mesh->NewEdge(*targ,vert[i]); // Only creates edges if they don't already exist.
-     }
-     ++targ;
-    }
+   for (nat32 j=0;j<weld.Count(i);j++)
+   {
+    mesh->NewEdge(vert[weld.Pair(i,j)],vert[i]); // Only creates edges if they don't already exist.
+   }
   }
   prog->Pop();
  
  prog->Pop();
 }
 
+//------------------------------------------------------------------------------
+// Calculates the error matrix of a range of vertices...
+class SimplifyVertRange
+{
+ public:
+  SimplifyVertRange(Simplify & s,const ds::Array<Vertex> & v)
+  :simp(s),vert(v)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++) simp.CalcError(vert[i],simp.vertError[i]);
+  }
+
+ private:
+  Simplify & simp;
+  const ds::Array<Vertex> & vert;
+};
+
+// Evaluates the contraction of a range of edges...
+class SimplifyEdgeRange
+{
+ public:
+  SimplifyEdgeRange(const Simplify & s,const ds::Array<Edge> & e,
+                    ds::Array<Simplify::ContractE> & c,ds::Array<bit> & o)
+  :simp(s),edge(e),ce(c),ok(o)
+  {}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 i=b0;i<b1;i++) ok[i] = simp.Evaluate(edge[i],ce[i]);
+  }
+
+ private:
+  const Simplify & simp;
+  const ds::Array<Edge> & edge;
+  ds::Array<Simplify::ContractE> & ce;
+  ds::Array<bit> & ok;
+};
+
+// Does the work for a range of patches - either building their heaps or
+// running a round of contractions...
+class SimplifyPatchRange
+{
+ public:
+  SimplifyPatchRange(Simplify & s,ds::Array<Simplify::Heap*> & h,ds::Array<Simplify::Heap*> & pa,
+                     ds::ArrayDel< ds::Array<Edge> > & e,mt::Atomic & d,int32 l)
+  :simp(s),heap(h),parked(pa),edge(e),done(d),limit(l),build(true),ceiling(0.0)
+  {}
+
+  void Round(real32 c) {build = false; ceiling = c;}
+
+  void operator () (nat32 b0,nat32 b1)
+  {
+   for (nat32 p=b0;p<b1;p++)
+   {
+    if (build)
+    {
+     for (nat32 i=0;i<edge[p].Size();i++)
+     {
+      Simplify::ContractE ce;
+      if (simp.Evaluate(edge[p][i],ce)) heap[p]->Add(edge[p][i].Index(),ce);
+     }
+     edge[p].Size(0);
+    }
+    else simp.Contract(*heap[p],parked[p],p,ceiling,done,limit);
+   }
+  }
+
+ private:
+  Simplify & simp;
+  ds::Array<Simplify::Heap*> & heap;
+  ds::Array<Simplify::Heap*> & parked;
+  ds::ArrayDel< ds::Array<Edge> > & edge;
+  mt::Atomic & done;
+  int32 limit;
+
+  bit build;
+  real32 ceiling;
+};
+
+// For sorting vertices along an axis...
+struct SimplifyAxisPos
+{
+ real32 pos;
+ nat32 ind;
+
+ bit operator < (const SimplifyAxisPos & rhs) const
+ {
+  if (pos<rhs.pos) return true;
+  if (pos>rhs.pos) return false;
+  return ind<rhs.ind;
+ }
+};
+
 //------------------------------------------------------------------------------
 Simplify::Simplify()
-:mesh(null<Mesh*>()),mergeDist(0.01),edgeCost(1.0)
+:mesh(null<Mesh*>()),mergeDist(0.01),edgeCost(1.0),patches(1),mTra(null<MeshTransfer*>())
 {}
 
 Simplify::~Simplify()
@@ -223,6 +390,11 @@ void Simplify::SetEdge(real32 cost)
  edgeCost = cost;
 }
 
+void Simplify::SetPatches(nat32 p)
+{
+ patches = p;
+}
+
 void Simplify::Run(nat32 targVerts,time::Progress * prog)
 {
  LogTime("eos::sur::Simplify::Run");
@@ -230,6 +402,10 @@ void Simplify::Run(nat32 targVerts,time::Progress * prog)
  prog->Push(); 
  nat32 steps = 3;
  nat32 step = 0;
+
+ nat32 patchCount = patches;
+ if (patchCount==0) patchCount = mt::DefaultPool().Concurrency()*4;
+ if (patchCount>1) steps += 1;
  
  // If needed add edges between near vertices...
   if (!math::IsZero(mergeDist))
@@ -240,226 +416,462 @@ void Simplify::Run(nat32 targVerts,time::Progress * prog)
   }
 
 
- // Calculate the error matrix for each vertex...
+ // Calculate the error matrix for each vertex, which is then mantained
+ // throughout the algorithm...
   prog->Report(step++,steps);
-  prog->Push();
   ds::Array<Vertex> startVerts(mesh->VertexCount());
   mesh->GetVertices(startVerts);
   
-  ds::Array<ErrorV> vertError(startVerts.Size()); // This is mantained throughout the algorithm.
-  for (nat32 i=0;i<startVerts.Size();i++)
+  vertError.Size(startVerts.Size());
   {
-   LogTime("eos::sur::Simplify::Run vert");
-   prog->Report(i,startVerts.Size());
-   vertError[i].Zero();
+   SimplifyVertRange svr(*this,startVerts);
+   mt::ParallelFor(nat32(0),startVerts.Size(),svr,256);
+  }
+
+
+ // Do the actual algorithm - do edge contractions till the mesh is simple
+ // enough. First in parallel if requested, which gets most of the way...
+  MeshTransfer transfer(*mesh,*mesh);
+  mTra = &transfer;
+
+  bit stitching = (patchCount>1)&&(mesh->VertexCount()>targVerts);
+  ds::List<Edge> stitch;
+  if (stitching)
+  {
+   prog->Report(step++,steps);
+   RunPatches(patchCount,mesh->VertexCount()-targVerts,stitch,prog);
+  }
+
+
+ // Then serially, which for the parallel version stitches the patches
+ // together, using only the edges the serial version would still be
+ // considering...
+  Heap heap;
+  prog->Report(step++,steps);
+  BuildHeap(heap,stitching?&stitch:null<ds::List<Edge>*>());
+
+  prog->Report(step++,steps);
+  mt::Atomic done;
+  int32 limit = (mesh->VertexCount()>targVerts)?int32(mesh->VertexCount()-targVerts):0;
+  Contract(heap,null<Heap*>(),nat32(-1),math::Infinity<real32>(),done,limit,prog);
+  mTra = null<MeshTransfer*>();
+  vertError.Size(0);
+  label.Size(0);
+
+
+ // If needed remove unused edges...
+  if (!math::IsZero(mergeDist))
+  {
+   prog->Report(step++,steps);
+   mesh->Prune();
+  }
+
+ prog->Pop();
+}
    
-   // Iterate all faces using the target vertex and add in there contribution...
-    IterVertexFaces iter(startVerts[i]);
-    while (iter.Valid())
+void Simplify::RunP(real32 num,time::Progress * prog)
+{
+ log::Assert(mesh!=null<Mesh*>());
+ Run(nat32(real32(mesh->VertexCount())*num),prog);
+}
+
+void Simplify::CalcError(Vertex vert,ErrorV & out) const
+{
+ out.Zero();
+
+ // Iterate all faces using the target vertex and add in there contribution...
+  IterVertexFaces iter(vert);
+  while (iter.Valid())
+  {
+   bs::Normal norm;
+   real32 dist;
+   iter.Targ().Eq(norm,dist);
+   out.Add(norm,dist);
+   iter.Next();
+  }
+
+
+ // Iterate the edges that use the target vertex, for each one that is on
+ // a boundary add in its edge constraint effect...
+  if (!math::IsZero(edgeCost))
+  {
+   IterVertexEdges iter(vert);
+   while (iter.Valid())
+   {
+    Edge edge = iter.Targ();
+    if (edge.Boundary())
     {
-     // Get the plane equation...
+     // Get the relevant normals...
+      bs::Normal faceNorm;
+      {
+       real32 dist;
+       edge.AnyFace().Eq(faceNorm,dist);
+      }
+
+      bs::Normal edgeNorm;
+      for (nat32 j=0;j<3;j++) edgeNorm[j] = edge.VertexA().Pos()[j] - edge.VertexB().Pos()[j];
+
+     // Calculate the plane parameters...
       bs::Normal norm;
-      real32 dist;
-      iter.Targ().Eq(norm,dist);
-     
-     // Update the matrix...
-      vertError[i].r0[0] += math::Sqr(norm[0]);
-      vertError[i].r0[1] += norm[0]*norm[1];
-      vertError[i].r0[2] += norm[0]*norm[2];
-      vertError[i].r0[3] += norm[0]*dist;
-      vertError[i].r1[0] += math::Sqr(norm[1]);
-      vertError[i].r1[1] += norm[1]*norm[2];
-      vertError[i].r1[2] += norm[1]*dist;
-      vertError[i].r2[0] += math::Sqr(norm[2]);
-      vertError[i].r2[1] += norm[2]*dist;
-      vertError[i].r3[0] += math::Sqr(dist);
-      
-     iter.Next();
-    }
-    
-   
-   // Iterate the edges that use the target vertex, for each one that is on
-   // a boundary add in its edge constraint effect...
-    if (!math::IsZero(edgeCost))
-    {
-     IterVertexEdges iter(startVerts[i]);
-     while (iter.Valid())
-     {
-      Edge edge = iter.Targ();
-      if (edge.Boundary())
+      math::CrossProduct(faceNorm,edgeNorm,norm);
+      if (!math::IsZero(norm.LengthSqr()))
       {
-       // Get the relevant normals...
-        bs::Normal faceNorm;
-        {
-         real32 dist;
-         edge.AnyFace().Eq(faceNorm,dist);
-        }
-    
-        bs::Normal edgeNorm;
-        for (nat32 j=0;j<3;j++) edgeNorm[j] = edge.VertexA().Pos()[j] - edge.VertexB().Pos()[j];
-    
-       // Calculate the plane parameters...
-        bs::Normal norm;
-        math::CrossProduct(faceNorm,edgeNorm,norm);
-        if (!math::IsZero(norm.LengthSqr()))
-        {
-         norm.Normalise();
-         real32 dist = -(norm * edge.VertexA().Pos());
-     
-         // Update the matrix...
-          vertError[i].r0[0] += edgeCost*math::Sqr(norm[0]);
-          vertError[i].r0[1] += edgeCost*norm[0]*norm[1];
-          vertError[i].r0[2] += edgeCost*norm[0]*norm[2];
-          vertError[i].r0[3] += edgeCost*norm[0]*dist;
-          vertError[i].r1[0] += edgeCost*math::Sqr(norm[1]);
-          vertError[i].r1[1] += edgeCost*norm[1]*norm[2];
-          vertError[i].r1[2] += edgeCost*norm[1]*dist;
-          vertError[i].r2[0] += edgeCost*math::Sqr(norm[2]);
-          vertError[i].r2[1] += edgeCost*norm[2]*dist;
-          vertError[i].r3[0] += edgeCost*math::Sqr(dist);
-        }
+       norm.Normalise();
+       real32 dist = -(norm * edge.VertexA().Pos());
+       out.Add(norm,dist,edgeCost);
       }
-      iter.Next();
-     }
     }
+    iter.Next();
+   }
   }
-  prog->Pop();
+}
 
+bit Simplify::Evaluate(Edge edge,ContractE & out) const
+{
+ out.edge = edge;
+ Vertex a = edge.VertexA();
+ Vertex b = edge.VertexB();
+ out.FillIn(a.Pos(),vertError[a.Index()],b.Pos(),vertError[b.Index()]);
+ return out.Safe();
+}
 
- 
- // Create the data structure - this is a touch complicated...
-  ds::SortList<ContractE,IndexSortContractE> byIndex; // Contains actual data.
-  ds::SortList<ContractE*,CostSortContractE> byCost; // Contains pointers to actual data, as stored in above.
+bit Simplify::InPatch(Edge edge,nat32 patch) const
+{
+ return (label[edge.VertexA().Index()]==patch)&&(label[edge.VertexB().Index()]==patch);
+}
 
+bit Simplify::Deep(Edge edge,nat32 patch) const
+{
+ // Check the vertices one edge away, and the vertices one edge away from them,
+ // plus the face sizes, as faces bigger than 4 go beyond the two rings...
+  Vertex end[2];
+  end[0] = edge.VertexA();
+  end[1] = edge.VertexB();
+  for (nat32 e=0;e<2;e++)
+  {
+   IterVertexEdges iter(end[e]);
+   while (iter.Valid())
+   {
+    Edge near = iter.Targ();
+    if (!InPatch(near,patch)) return false;
 
+    Vertex other = near.VertexA();
+    if (other==end[e]) other = near.VertexB();
 
- // Calculate the edge data...
- // This involves filling the above data structure with its initial data set.
- prog->Report(step++,steps);
- {
-  prog->Push();
-  ds::Array<Edge> startEdges(mesh->EdgeCount());
-  mesh->GetEdges(startEdges);
-  
-  for (nat32 i=0;i<startEdges.Size();i++)
-  {
-   LogTime("eos::sur::Simplify::Run edge");
-   prog->Report(i,startEdges.Size());
-   // Construct the contraction...
-    ContractE ce;
-    ce.edge = startEdges[i];
-    Vertex a = ce.edge.VertexA();
-    Vertex b = ce.edge.VertexB();
-    ce.FillIn(a.Pos(),vertError[a.Index()],b.Pos(),vertError[b.Index()]);
-    
-   // Add to data structure, but only if safe...
-    if (ce.Safe())
+    IterVertexEdges iter2(other);
+    while (iter2.Valid())
     {
-     byIndex.Add(ce);
-     byCost.Add(byIndex.Get(ce));
+     if (!InPatch(iter2.Targ(),patch)) return false;
+     iter2.Next();
     }
+    iter.Next();
+   }
+
+   IterVertexFaces iterF(end[e]);
+   while (iterF.Valid())
+   {
+    if (iterF.Targ().Size()>4) return false;
+    iterF.Next();
+   }
   }
-  prog->Pop();
- }
 
+ return true;
+}
 
+void Simplify::Contract(Heap & heap,Heap * parked,nat32 patch,real32 ceiling,mt::Atomic & done,
+                        int32 limit,time::Progress * prog)
+{
+ LogTime("eos::sur::Simplify::Contract");
+ bit usePatch = patch!=nat32(-1);
+ if (prog) prog->Push();
+ int32 start = done.Get();
 
- // Do the actual algorithm - do edge contractions till the mesh is simple enough...
-  prog->Report(step++,steps);
-  prog->Push();
-  MeshTransfer mTra(*mesh,*mesh);
-  nat32 startSize = mesh->VertexCount();
-  while ((mesh->VertexCount()>targVerts)&&(byCost.Size()>0))
-  {
-   LogTime("eos::sur::Simplify::Run contract");
-   prog->Report(startSize-mesh->VertexCount(),startSize-targVerts);
-   // Get and remove the lowest cost contraction...
-    ContractE job = *byCost.First();
-    byCost.Rem(&job);
-    byIndex.Rem(job);
-    
-    Vertex vert[2];
-    vert[0] = job.edge.VertexA();
-    vert[1] = job.edge.VertexB();
+ while ((heap.Size()>0)&&(done.Get()<limit))
+ {
+  if (prog) prog->Report(done.Get()-start,limit-start);
 
+  // Get and remove the lowest cost contraction...
+   nat32 key;
+   if (heap.Peek(key).cost>ceiling) break;
+   ContractE job;
+   heap.Pop(key,job);
 
-   // Remove from the data structure all contractions involving the two vertices...
-    for (nat32 i=0;i<2;i++)
+   if (usePatch&&(!Deep(job.edge,patch)))
+   {
+    parked->Add(key,job);
+    continue;
+   }
+
+   Vertex vert[2];
+   vert[0] = job.edge.VertexA();
+   vert[1] = job.edge.VertexB();
+
+
+  // Remove from the heap all contractions involving the two vertices...
+   for (nat32 i=0;i<2;i++)
+   {
+    IterVertexEdges iter(vert[i]);
+    while(iter.Valid())
     {
-     IterVertexEdges iter(vert[i]);
-     while(iter.Valid())
-     {
-      ContractE dummy; dummy.edge = iter.Targ();
-      ContractE * targ = byIndex.Get(dummy);
-      if (targ)
-      {
-       byCost.Rem(targ);
-       byIndex.Rem(*targ);
-      }
-      iter.Next();
-     }
+     heap.Rem(iter.Targ().Index());
+     if (usePatch) parked->Rem(iter.Targ().Index());
+     iter.Next();
     }
+   }
 
 
-   // Do the contraction, update the vertex error array...
-    // Work out the interpolation weights...
-     real32 weight[2];
-     for (nat32 i=0;i<2;i++) weight[i] = job.newPos.DistanceTo(vert[(i+1)%2].Pos());
+  // Do the contraction, update the vertex error array...
+   // Work out the interpolation weights...
+    real32 weight[2];
+    for (nat32 i=0;i<2;i++) weight[i] = job.newPos.DistanceTo(vert[(i+1)%2].Pos());
 
-    // Create the new vertex...
-     Vertex nv = mTra.Interpolate(2,vert,weight);
+   // Create the new vertex and merge the two old vertices into it...
+    Vertex nv;
+    {
+     if (usePatch) meshLock.Lock();
+     nv = mTra->Interpolate(2,vert,weight);
      nv.Pos() = job.newPos;
-    
-    // Update the vertex array...
      nv.Index() = math::Min(vert[0].Index(),vert[1].Index());
      vertError[nv.Index()] += vertError[math::Max(vert[0].Index(),vert[1].Index())];
-    
-    // Merge the two old vertices into this new vertex...
+
      for (nat32 i=0;i<2;i++) mesh->Fire(vert[i],nv);
+     if (usePatch) meshLock.Unlock();
+    }
+    done.Inc();
 
 
-   // Iterate the associate edges, recalculate there costs, reinsert into data structure...
+  // Iterate the associate edges, recalculate there costs, reinsert into the heap...
+   IterVertexEdges iter(nv);
+   while (iter.Valid())
    {
-    IterVertexEdges iter(nv);
-    while (iter.Valid())
+    Edge edge = iter.Targ();
+    if ((!usePatch)||InPatch(edge,patch))
     {
      ContractE nce;
-     nce.edge = iter.Targ();
-
-     Vertex a = nce.edge.VertexA();
-     Vertex b = nce.edge.VertexB();
-       
-     nce.FillIn(a.Pos(),vertError[a.Index()],b.Pos(),vertError[b.Index()]);
-     
-     if (nce.Safe())
+     if (Evaluate(edge,nce)) heap.Add(edge.Index(),nce);
+    }
+    iter.Next();
+   }
+ }
+
+ if (prog) prog->Pop();
+}
+
+void Simplify::BuildHeap(Heap & heap,const ds::List<Edge> * only)
+{
+ LogTime("eos::sur::Simplify::BuildHeap");
+ ds::Array<Edge> edge(mesh->EdgeCount());
+ mesh->GetEdges(edge); // Gives every edge its key.
+
+ if (only)
+ {
+  ds::Array<bit> want(edge.Size());
+  for (nat32 i=0;i<want.Size();i++) want[i] = false;
+
+  ds::List<Edge>::Cursor targ = only->FrontPtr();
+  while (!targ.Bad())
+  {
+   Edge e = *targ;
+   want[e.Index()] = true;
+   ++targ;
+  }
+
+  nat32 out = 0;
+  for (nat32 i=0;i<edge.Size();i++)
+  {
+   if (want[i]) edge[out++] = edge[i];
+  }
+  edge.Size(out);
+ }
+
+ ds::Array<ContractE> ce(edge.Size());
+ ds::Array<bit> ok(edge.Size());
+ SimplifyEdgeRange ser(*this,edge,ce,ok);
+ mt::ParallelFor(nat32(0),edge.Size(),ser,256);
+
+ for (nat32 i=0;i<edge.Size();i++)
+ {
+  if (ok[i]) heap.Add(edge[i].Index(),ce[i]);
+ }
+}
+
+void Simplify::RunPatches(nat32 count,nat32 reduction,ds::List<Edge> & stitch,time::Progress * prog)
+{
+ LogTime("eos::sur::Simplify::RunPatches");
+ prog->Push();
+
+ // Cut the vertices into slabs along the longest axis, with equal numbers in
+ // each...
+  prog->Report(0,3);
+  ds::Array<Vertex> vert(mesh->VertexCount());
+  mesh->GetVertices(vert); // Leaves Index() matching vertError.
+  if (vert.Size()==0) {prog->Pop(); return;}
+
+  bs::Vert low = vert[0].Pos();
+  bs::Vert high = vert[0].Pos();
+  for (nat32 i=1;i<vert.Size();i++)
+  {
+   for (nat32 j=0;j<3;j++)
+   {
+    low[j] = math::Min(low[j],vert[i].Pos()[j]);
+    high[j] = math::Max(high[j],vert[i].Pos()[j]);
+   }
+  }
+
+  nat32 axis = 0;
+  for (nat32 j=1;j<3;j++)
+  {
+   if ((high[j]-low[j])>(high[axis]-low[axis])) axis = j;
+  }
+
+  ds::Array<SimplifyAxisPos> order(vert.Size());
+  for (nat32 i=0;i<vert.Size();i++)
+  {
+   order[i].pos = vert[i].Pos()[axis];
+   order[i].ind = i;
+  }
+  order.SortNorm();
+
+  label.Size(vert.Size());
+  for (nat32 i=0;i<order.Size();i++)
+  {
+   label[order[i].ind] = nat32((nat64(i)*nat64(count))/nat64(order.Size()));
+  }
+
+
+ // Give each patch its edges, renumbering them within the patch so each has
+ // a compact set of keys - edges that cross patches are left to the stitching...
+  prog->Report(1,3);
+  int32 limit;
+  {
+   // Vertices near the borders can not be removed by the patches, so they get
+   // a share of the reduction in proportion to the vertices that are deep
+   // within them, leaving the rest, and a bit more, for the stitching, which
+   // can choose the best contractions from all of the mesh...
+    const real32 parallelShare = 0.9;
+
+    ds::Array<bit> core(vert.Size()); // True if all neighbours share its patch.
+    for (nat32 i=0;i<vert.Size();i++)
+    {
+     core[i] = true;
+     IterVertexEdges iter(vert[i]);
+     while (iter.Valid())
      {
-      byIndex.Add(nce);      
-      byCost.Add(byIndex.Get(nce));
+      if (!InPatch(iter.Targ(),label[i])) {core[i] = false; break;}
+      iter.Next();
      }
+    }
 
-     iter.Next();
+    nat32 deep = 0;
+    for (nat32 i=0;i<vert.Size();i++)
+    {
+     if (!core[i]) continue;
+     bit ok = true;
+     IterVertexEdges iter(vert[i]);
+     while (iter.Valid())
+     {
+      Edge e = iter.Targ();
+      if (!(core[e.VertexA().Index()]&&core[e.VertexB().Index()])) {ok = false; break;}
+      iter.Next();
+     }
+     if (ok) deep += 1;
+    }
+
+    limit = int32(parallelShare*real32(reduction)*real32(deep)/real32(vert.Size()));
+  }
+
+  ds::ArrayDel< ds::Array<Edge> > edge(count);
+  {
+   ds::Array<Edge> all(mesh->EdgeCount());
+   mesh->GetEdges(all);
+
+   ds::Array<nat32> size(count);
+   for (nat32 p=0;p<count;p++) size[p] = 0;
+   for (nat32 i=0;i<all.Size();i++)
+   {
+    nat32 p = label[all[i].VertexA().Index()];
+    if (p==label[all[i].VertexB().Index()]) size[p] += 1;
+   }
+
+   for (nat32 p=0;p<count;p++)
+   {
+    edge[p].Size(size[p]);
+    size[p] = 0;
+   }
+
+   for (nat32 i=0;i<all.Size();i++)
+   {
+    nat32 p = label[all[i].VertexA().Index()];
+    if (p==label[all[i].VertexB().Index()])
+    {
+     all[i].Index() = size[p];
+     edge[p][size[p]] = all[i];
+     size[p] += 1;
     }
+    else stitch.AddBack(all[i]);
    }
   }
+
+
+ // Build the heaps in parallel...
+  ds::Array<Heap*> heap(count);
+  ds::Array<Heap*> parked(count); // Contractions popped but not deep enough.
+  for (nat32 p=0;p<count;p++)
+  {
+   heap[p] = new Heap();
+   parked[p] = new Heap();
+  }
+
+  mt::Atomic done;
+  SimplifyPatchRange spr(*this,heap,parked,edge,done,limit);
+  mt::ParallelFor(nat32(0),count,spr,1);
+
+
+ // Do rounds of contraction, doubling the cost ceiling each time, until enough
+ // has been done...
+  prog->Report(2,3);
+  prog->Push();
+  real32 ceiling = -math::Infinity<real32>();
+  while (done.Get()<limit)
+  {
+   prog->Report(done.Get(),limit);
+
+   // Find the cheapest contraction, and hence the ceiling...
+    bit any = false;
+    real32 cheap = math::Infinity<real32>();
+    for (nat32 p=0;p<count;p++)
+    {
+     if (heap[p]->Size()!=0)
+     {
+      nat32 key;
+      any = true;
+      cheap = math::Min(cheap,heap[p]->Peek(key).cost);
+     }
+    }
+    if (!any) break;
+
+    ceiling = math::Max(cheap,real32(2.0)*math::Max(ceiling,real32(1e-12)));
+
+   // Do the round...
+    spr.Round(ceiling);
+    mt::ParallelFor(nat32(0),count,spr,1);
+  }
   prog->Pop();
-  
 
 
- // If needed remove unused edges...
-  if (!math::IsZero(mergeDist))
+ // Hand everything left in the heaps on to the stitching, and clean up...
+  for (nat32 p=0;p<count;p++)
   {
-   prog->Report(step++,steps);
-   mesh->Prune();
+   nat32 key;
+   ContractE job;
+   while (heap[p]->Pop(key,job)) stitch.AddBack(job.edge);
+   while (parked[p]->Pop(key,job)) stitch.AddBack(job.edge);
+   delete heap[p];
+   delete parked[p];
   }
 
  prog->Pop();
 }
-   
-void Simplify::RunP(real32 num,time::Progress * prog)
-{
- log::Assert(mesh!=null<Mesh*>());
- Run(nat32(real32(mesh->VertexCount())*num),prog);
-}
 
 void Simplify::ContractE::FillIn(const bs::Vert & pa,const Simplify::ErrorV & ea,
                                  const bs::Vert & pb,const Simplify::ErrorV & eb)
@@ -24,7 +24,10 @@
 
 #include "eos/types.h"
 #include "eos/sur/mesh.h"
+#include "eos/sur/mesh_sup.h"
 #include "eos/ds/sorting.h"
+#include "eos/ds/index_heaps.h"
+#include "eos/mt/locks.h"
 
 namespace eos
 {
@@ -32,7 +35,9 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 /// This merges all vertices that are within a given distance of each other
-/// together to remove duplicates.
+/// together to remove duplicates. Uses a spatial hash of cells the size of the
+/// range, so runs in expected linear time, and the result is the same every
+/// time for the same input.
 EOS_FUNC void RemDups(Mesh * mesh,real32 range,time::Progress * prog = null<time::Progress*>());
 
 //------------------------------------------------------------------------------
@@ -40,14 +45,30 @@ EOS_FUNC void RemDups(Mesh * mesh,real32 range,time::Progress * prog = null<time
 /// distance this checks all vertices in a mesh and makes sure that all vertices
 /// within the given range are connected by a egde, adding edges to make this so.
 /// Used by the simplification algorithm as a pre-processor so it will consider
-/// connecting vertices that arn't actually part of the same mesh chunk.
+/// connecting vertices that arn't actually part of the same mesh chunk. Uses
+/// the same spatial hash as RemDups, and adds edges in vertex order.
 EOS_FUNC void AddEdges(Mesh * mesh,real32 range,time::Progress * prog = null<time::Progress*>());
 
+//------------------------------------------------------------------------------
+class SimplifyVertRange;
+class SimplifyEdgeRange;
+class SimplifyPatchRange;
+
 //------------------------------------------------------------------------------
 /// Mesh simplification algorithm, based on 'Surface Simplification Using 
 /// Quadric Error Metrics' by Michael Garland and Paul S. Heckbert.
 /// Implimented as a class due to the internal complexity of it, as this makes
 /// implimentation neater.
+///
+/// The error quadrics and initial contraction costs are calculated in
+/// parallel, after which the contractions happen in cost order from an indexed
+/// heap. Optionally the contractions can run in parallel as well - the mesh is
+/// cut into patches, slabs along its longest axis, and each patch contracts
+/// the edges deep within it concurrently, in rounds with a shared cost ceiling
+/// that doubles each round so the patches stay roughly in step with the global
+/// cost order. The patch borders are then stitched by a final serial pass over
+/// every edge that remains, which does the last part of the reduction,
+/// stopping at exactly the same vertex count as the serial version would.
 class EOS_CLASS Simplify
 {
  public:
@@ -69,6 +90,12 @@ class EOS_CLASS Simplify
   /// Sets the cost of moving a mesh edge - all edges used by only 1 edge have this
   /// cost applied for moving away from that edge. Defaults to 1.0
   void SetEdge(real32 cost);
+
+  /// Sets how many patches to cut the mesh into for parallel contraction. 1,
+  /// the default, is the purely serial algorithm, 0 selects 4 per core. The
+  /// parallel version expects faces with at most 4 sides, larger faces
+  /// simply being left to the serial stitching pass.
+   void SetPatches(nat32 patches);
    
   /// Runs the algorithm, simplifying to the specified number of vertices.
    void Run(nat32 verts,time::Progress * prog = null<time::Progress*>());
@@ -82,9 +109,14 @@ class EOS_CLASS Simplify
  
  
  private:
+  friend class SimplifyVertRange;
+  friend class SimplifyEdgeRange;
+  friend class SimplifyPatchRange;
+
   Mesh * mesh;
   real32 mergeDist;
   real32 edgeCost;
+  nat32 patches;
   
   // Symetric 4x4 matrix, used as a measure of error for each vertex.
    struct ErrorV
@@ -110,6 +142,21 @@ class EOS_CLASS Simplify
      for (nat32 i=0;i<1;i++) r3[i] += rhs.r3[i];     
      return *this;
     }
+
+    // Adds in a plane, with the given weight...
+     void Add(const bs::Normal & norm,real32 dist,real32 weight = 1.0)
+     {
+      r0[0] += weight*math::Sqr(norm[0]);
+      r0[1] += weight*norm[0]*norm[1];
+      r0[2] += weight*norm[0]*norm[2];
+      r0[3] += weight*norm[0]*dist;
+      r1[0] += weight*math::Sqr(norm[1]);
+      r1[1] += weight*norm[1]*norm[2];
+      r1[2] += weight*norm[1]*dist;
+      r2[0] += weight*math::Sqr(norm[2]);
+      r2[1] += weight*norm[2]*dist;
+      r3[0] += weight*math::Sqr(dist);
+     }
     
     real32 Cost(const bs::Vert & pos) const
     {
@@ -130,7 +177,8 @@ class EOS_CLASS Simplify
     }
    };
    
-  // Stores edge contractions info (Has two sorters, as we need to be able to index it by two systems.)...
+  // Stores edge contractions info, as kept in the heap keyed by the edges
+  // index...
    struct ContractE
    {
     Edge edge;
@@ -147,22 +195,53 @@ class EOS_CLASS Simplify
    };
    
    struct CostSortContractE : public ds::Sort
-   {
-    static bit LessThan(ContractE * const & lhs,ContractE * const & rhs)
-    {
-     if (lhs->cost<rhs->cost) return true;
-     if (lhs->cost>rhs->cost) return false;
-     return lhs->edge.Index()<rhs->edge.Index();
-    }
-   };
-
-   struct IndexSortContractE : public ds::Sort
    {
     static bit LessThan(const ContractE & lhs,const ContractE & rhs)
     {
-     return lhs.edge.Index()<rhs.edge.Index();
+     return lhs.cost<rhs.cost;
     }
    };
+
+   typedef ds::IndexHeap<ContractE,CostSortContractE> Heap;
+
+
+  // State during a run...
+   ds::Array<ErrorV> vertError; // Indexed by vertex Index(), mantained throughout.
+   ds::Array<nat32> label; // Patch of each vertex, by Index(), only when running patches.
+   MeshTransfer * mTra;
+   mt::OwnedLock meshLock; // Held whilst editting the mesh when running patches.
+
+  // Calculates the error matrix for a vertex...
+   void CalcError(Vertex vert,ErrorV & out) const;
+
+  // Fills in the contraction for an edge, returning true if its safe...
+   bit Evaluate(Edge edge,ContractE & out) const;
+
+  // Returns true if an edge has both ends in the given patch...
+   bit InPatch(Edge edge,nat32 patch) const;
+
+  // Returns true if an edge is deep enough within a patch to contract it
+  // without touching anything another patch might be using - every vertex
+  // within two edges of either end must be in the patch...
+   bit Deep(Edge edge,nat32 patch) const;
+
+  // Does contractions from the heap, cheapest first, until it is empty, the
+  // cheapest costs more than ceiling or done reaches limit, done being
+  // incrimented for each vertex removed. If patch is not nat32(-1) only edges
+  // deep within the patch are contracted, with the rest parked for the
+  // stitching pass, and the mesh is locked whilst being editted so that
+  // patches can be run in parallel...
+   void Contract(Heap & heap,Heap * parked,nat32 patch,real32 ceiling,mt::Atomic & done,
+                 int32 limit,time::Progress * prog = null<time::Progress*>());
+
+  // Builds a heap of every edge in the mesh, or only those given, in
+  // parallel. Renumbers the edges...
+   void BuildHeap(Heap & heap,const ds::List<Edge> * only = null<const ds::List<Edge>*>());
+
+  // The parallel contraction, does the patches but not the stitching, for the
+  // given number of patches and the total number of vertices to be removed.
+  // Outputs the edges to be considered by the stitching...
+   void RunPatches(nat32 count,nat32 reduction,ds::List<Edge> & stitch,time::Progress * prog);
 };
 
 //------------------------------------------------------------------------------
@@ -35,7 +35,8 @@ namespace eos
 /// with the centres filled in accordingly.
 /// (divs==0 will result in the original input.)
 /// The subdivisions are flat, so the mesh remains the same shape.
-/// Remember to delete the returned mesh.
+/// Remember to delete the returned mesh. There is a faster version for
+/// IndexedMesh-s in indexed_subdivide.h.
 EOS_FUNC Mesh * Subdivide(Mesh & in,nat32 divs);
 
 //------------------------------------------------------------------------------
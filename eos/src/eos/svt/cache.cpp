@@ -0,0 +1,221 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/svt/cache.h"
+
+#include "eos/io/to_virt.h"
+#include "eos/math/functions.h"
+#include "eos/ds/arrays.h"
+#include "eos/file/dirs.h"
+#include "eos/file/files.h"
+#include "eos/mt/locks.h"
+#include "eos/svt/file.h"
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+
+#ifdef EOS_WIN32
+ #include <process.h>
+#else
+ #include <unistd.h>
+#endif
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+EOS_FUNC void Hash(data::Md5 & md5,const Node * node)
+{
+ if (node==null<const Node*>()) {md5.Write("null",4); return;}
+
+ io::VirtOut<data::Md5> out(md5);
+ node->Write(out);
+}
+
+EOS_FUNC void Hash(data::Md5 & md5,cstrconst s)
+{
+ md5.Write(s,str::Length(s)+1);
+}
+
+//------------------------------------------------------------------------------
+// Helper for the Cache - an entry found in the directory...
+struct CacheEntry
+{
+ cstr fn;
+ nat64 size;
+ nat64 time;
+
+ bit operator < (const CacheEntry & rhs) const {return time<rhs.time;}
+};
+
+// Fills in the entries of a directory, the caller must free the filenames...
+static void CacheEntries(const str::String & path,ds::Array<CacheEntry> & out)
+{
+ nat32 count = 0;
+ cstr p = path.ToStr();
+ DIR * dir = opendir(p);
+ if (dir)
+ {
+  nat32 pLength = str::Length(p);
+  while (true)
+  {
+   dirent * ent = readdir(dir);
+   if (ent==0) break;
+   if ((str::Length(ent->d_name)!=36)||(!str::AtEnd(ent->d_name,".svt"))) continue;
+
+   cstr fn = mem::Malloc<cstrchar>(pLength+str::Length(ent->d_name)+1);
+   str::Copy(fn,p);
+   str::Copy(fn+pLength,ent->d_name);
+
+   struct stat info;
+   if (stat(fn,&info)!=0) {mem::Free(fn); continue;}
+
+   if (count==out.Size()) out.Size(math::Max<nat32>(2*count,64));
+   CacheEntry & targ = out[count++];
+   targ.fn = fn;
+   targ.size = info.st_size;
+   targ.time = info.st_mtime;
+  }
+  closedir(dir);
+ }
+ out.Size(count);
+ mem::Free(p);
+}
+
+//------------------------------------------------------------------------------
+Cache::Cache(cstrconst d,nat64 ms,bit c)
+:dir(d),maxSize(ms),compress(c)
+{
+ file::Dir loc(d);
+ if (!loc.Valid()) loc.Create();
+}
+
+Cache::~Cache()
+{}
+
+bit Cache::Has(const data::Md5 & key) const
+{
+ cstr fn = Filename(key);
+  struct stat info;
+  bit ret = stat(fn,&info)==0;
+ mem::Free(fn);
+ return ret;
+}
+
+Node * Cache::Get(Core & core,const data::Md5 & key) const
+{
+ cstr fn = Filename(key);
+  Node * ret = null<Node*>();
+  struct stat info;
+  if (stat(fn,&info)==0)
+  {
+   if (compress) ret = Load(core,fn);
+            else ret = LoadMapped(core,fn);
+   if (ret) utime(fn,null<struct utimbuf*>()); // Marks it as recently used, for eviction.
+  }
+ mem::Free(fn);
+ return ret;
+}
+
+// Counts calls to Put, to make temporary names unique between threads...
+static mt::Atomic putCount;
+
+bit Cache::Put(const data::Md5 & key,Node * node)
+{
+ cstr fn = Filename(key);
+
+ // Save under a temporary name unique to this process and call, as threads
+ // can share a Cache, then rename, so a reader never sees half a file...
+  str::String tempName(fn);
+  tempName << "." << nat32(getpid()) << "." << nat32(putCount.Inc()) << ".part";
+  cstr temp = tempName.ToStr();
+
+  bit ret = Save(temp,node,true,!compress,compress);
+  if (ret)
+  {
+   #ifdef EOS_WIN32
+    remove(fn);
+   #endif
+   ret = rename(temp,fn)==0;
+  }
+  if (!ret) file::DeleteFile(temp);
+
+ mem::Free(temp);
+ mem::Free(fn);
+
+ Evict(maxSize);
+ return ret;
+}
+
+void Cache::Evict(nat64 size)
+{
+ ds::Array<CacheEntry> entry;
+ CacheEntries(dir,entry);
+
+ nat64 total = 0;
+ for (nat32 i=0;i<entry.Size();i++) total += entry[i].size;
+
+ if (total>size)
+ {
+  entry.SortNorm();
+  for (nat32 i=0;(i<entry.Size())&&(total>size);i++)
+  {
+   file::DeleteFile(entry[i].fn);
+   total -= entry[i].size;
+  }
+ }
+
+ for (nat32 i=0;i<entry.Size();i++) mem::Free(entry[i].fn);
+}
+
+nat64 Cache::Size() const
+{
+ ds::Array<CacheEntry> entry;
+ CacheEntries(dir,entry);
+
+ nat64 ret = 0;
+ for (nat32 i=0;i<entry.Size();i++)
+ {
+  ret += entry[i].size;
+  mem::Free(entry[i].fn);
+ }
+ return ret;
+}
+
+cstr Cache::Filename(const data::Md5 & key) const
+{
+ nat32 md5[4];
+ key.Get(md5);
+
+ str::String ret(dir);
+ for (nat32 i=0;i<4;i++)
+ {
+  cstrchar hex[9];
+  str::ToHex(md5[i],hex);
+  ret << hex;
+ }
+ ret << ".svt";
+ return ret.ToStr();
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,107 @@
+#ifndef EOS_SVT_CACHE_H
+#define EOS_SVT_CACHE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file svt/cache.h
+/// Provides an on disk cache of intermediate results, keyed by a hash of
+/// everything that went into making them, so a pipeline rerun with a late
+/// stage tweak can skip straight past the stages that have not changed.
+
+#include "eos/types.h"
+#include "eos/data/checksums.h"
+#include "eos/str/strings.h"
+#include "eos/svt/node.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+/// Adds a Node and all of its children to a hash, by streaming its serialised
+/// form through it. Two nodes with the same contents give the same hash. A null
+/// node is hashed as a marker, so optional inputs can be included.
+EOS_FUNC void Hash(data::Md5 & md5,const Node * node);
+
+/// Adds a null terminated string to a hash, terminator included so consecutive
+/// strings can not run into each other.
+EOS_FUNC void Hash(data::Md5 & md5,cstrconst s);
+
+//------------------------------------------------------------------------------
+/// A directory of svt files, each containing a set of results and named after
+/// the md5 key they were stored under. The key should be made from everything
+/// that decides the result - typically the TypeString of the operation, its
+/// parameters and the Hash of each of its inputs. A size limit is enforced by
+/// evicting the least recently used files after each Put. Files are saved
+/// mappable and loaded with LoadMapped, so a hit costs almost nothing until the
+/// data is used, or compressed if disk space matters more than speed. Any
+/// number of Cache objects, in any number of processes, can share a directory,
+/// as files are written under a temporary name and then renamed into place, and
+/// a single Cache can be used by several threads at once.
+class EOS_CLASS Cache
+{
+ public:
+  /// The directory is created if it does not exist, and must end with a '/'.
+  /// maxSize is in bytes, the total size the directory is kept under.
+   Cache(cstrconst dir,nat64 maxSize = nat64(1024)*1024*1024,bit compress = false);
+
+  /// &nbsp;
+   ~Cache();
+
+
+  /// Returns true if there is an entry for the given key.
+   bit Has(const data::Md5 & key) const;
+
+  /// Returns the result stored for the given key, null if there is none. The
+  /// caller is responsible for deleting it. Marks the entry as recently used.
+   Node * Get(Core & core,const data::Md5 & key) const;
+
+  /// Stores a result under the given key, replacing anything already there,
+  /// then evicts until the directory is within its size limit. Returns false
+  /// on failure to write, which is harmless beyond the lost entry.
+   bit Put(const data::Md5 & key,Node * node);
+
+
+  /// Deletes the least recently used entries until the directory is no larger
+  /// than the given size, in bytes.
+   void Evict(nat64 size);
+
+  /// Deletes every entry.
+   void Clear() {Evict(0);}
+
+  /// Returns the total size of the entries in the directory, in bytes.
+   nat64 Size() const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::svt::Cache";}
+
+
+ private:
+  str::String dir;
+  nat64 maxSize;
+  bit compress;
+
+  // Returns the filename for a key, to be mem::Free-ed...
+   cstr Filename(const data::Md5 & key) const;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
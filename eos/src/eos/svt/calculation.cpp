@@ -51,6 +51,63 @@ void Algorithm::SetOutput(nat32 output,Node * node)
  io[inputs+output] = node;
 }
 
+void Algorithm::RunCached(Cache & cache,Core & core,time::Progress * prog)
+{
+ data::Md5 key;
+ Hash(key,TypeString());
+ if (!CacheKey(key)) {Run(prog); return;}
+ for (nat32 i=0;i<inputs;i++) Hash(key,io[i]);
+
+ // The cached file has a child per output, which in turn has the output as
+ // its only child, or no child if it was null...
+  nat32 outputs = io.Size() - inputs;
+  Node * root = cache.Get(core,key);
+  if (root)
+  {
+   if (root->ChildCount()==outputs)
+   {
+    Node * wrap = root->Child();
+    for (nat32 i=0;i<outputs;i++)
+    {
+     Node * out = wrap->Child();
+     if (out) out->Detach();
+     io[inputs+i] = out;
+     wrap = wrap->Next();
+    }
+    delete root;
+    return;
+   }
+   delete root;
+  }
+
+ // Not cached, so run and store...
+  Run(prog);
+
+  root = new Node(core);
+  for (nat32 i=0;i<outputs;i++)
+  {
+   Node * wrap = new Node(core);
+   wrap->AttachParent(root);
+   if (io[inputs+i]) io[inputs+i]->AttachParent(wrap);
+  }
+
+  cache.Put(key,root);
+
+  for (nat32 i=0;i<outputs;i++)
+  {
+   if (io[inputs+i]) io[inputs+i]->Detach();
+  }
+  delete root;
+}
+
+void Algorithm::Configure(const bs::Element & elem)
+{}
+
+bit Algorithm::CacheKey(data::Md5 & key) const
+{
+ return false;
+}
+
 //------------------------------------------------------------------------------
 MetaAlgorithm::~MetaAlgorithm()
 {}
@@ -30,6 +30,7 @@
 #include "eos/time/progress.h"
 #include "eos/bs/dom.h"
 #include "eos/ds/arrays.h"
+#include "eos/svt/cache.h"
 
 namespace eos
 {
@@ -55,9 +56,20 @@ class EOS_CLASS Algorithm : public Deletable
   /// The given pointer must remain valid until after Run has returned.
    void SetInput(nat32 input,Node * node);
 
+  /// Sets the parameters of the algorithm from the element that states it,
+  /// as checked by MetaAlgorithm::GoodDom, e.g. a step of a Pipeline. Called
+  /// before Run, the default does nothing, for algorithms without parameters.
+   virtual void Configure(const bs::Element & elem);
+
   /// Runs the algorithm, you supply a progress feedback object.
    virtual void Run(time::Progress * prog = null<time::Progress*>()) = 0;
 
+  /// Identical to Run, except the outputs come from the given cache if a
+  /// previous run with the same inputs and parameters left them there, and
+  /// are put there otherwise. Algorithms that do not override CacheKey are
+  /// simply run. Outputs loaded from the cache belong to the given core.
+   void RunCached(Cache & cache,Core & core,time::Progress * prog = null<time::Progress*>());
+
   /// Returns the output of the algorithm for the given index.
   /// Must be called after Run, its just an array access but the user is
   /// responsible for deleting all outputs so ultimatly each output must have
@@ -74,6 +86,12 @@ class EOS_CLASS Algorithm : public Deletable
   /// repetadly, its just an array lookup.
    Node * GetInput(nat32 input);
 
+  /// Opts the algorithm into caching, by adding everything other than its
+  /// inputs that decides its outputs, typically its parameters, to the given
+  /// hash and returning true. The TypeString and inputs are added by the
+  /// caller. The default returns false, so the algorithm is never cached.
+   virtual bit CacheKey(data::Md5 & key) const;
+
   /// Allows the Run implimentation to set its outputs, must be done for all
   /// non-optional outputs, not doing so is considered an error.
   /// Must be done once for each as otherwise a memory leak will occur.
@@ -26,7 +26,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 Core::Core(str::TokenTable & t)
-:tt(t)
+:tt(t),writePos(null<nat64*>()),writeCompress(false),readMap(null<MapIn*>()),readRevision(1)
 {
  AddType("HON",0,CreateNode,LoadNode);
  AddType("SID","HON",CreateMeta,LoadMeta);
@@ -110,8 +110,8 @@ Node * Core::LoadObject(io::InVirt<io::Binary> & in)
         if (in.Read(&highSize,1)!=1) {delete ret; ret = null<Node*>(); break;}
         if (in.Skip(5)!=5) {delete ret; ret = null<Node*>(); break;}
         
-        if (highSize!=0) {delete ret; ret = null<Node*>(); break;}
-        if (in.Skip(lowSize-16)!=(lowSize-16)) {delete ret; ret = null<Node*>(); break;}
+        nat64 size = BlockSize(lowSize,highSize);
+        if (SkipLarge(in,size-16)!=(size-16)) {delete ret; ret = null<Node*>(); break;}
        
        // Break if this was the final block...
         if ((head.bm[0]==head.om[0])&&(head.bm[1]==head.om[1])&&(head.bm[2]==head.om[2])) break;
@@ -135,6 +135,62 @@ Node * Core::LoadObject(io::InVirt<io::Binary> & in)
  ltl.Add(lt);
 }
 
+//------------------------------------------------------------------------------
+// Largest piece handed to the stream in one go...
+static const nat64 largePiece = 1<<30;
+
+EOS_FUNC nat32 WriteBlockSize(io::OutVirt<io::Binary> & out,nat64 size)
+{
+ log::Assert((size>>40)==0,"svt block over a terabyte");
+ nat32 low = nat32(size);
+ nat8 high = nat8(size>>32);
+ 
+ nat32 ret = out.Write(&low,4);
+ ret += out.Write(&high,1);
+ return ret;
+}
+
+EOS_FUNC nat64 WriteLarge(io::OutVirt<io::Binary> & out,const void * data,nat64 bytes)
+{
+ const byte * targ = (const byte*)data;
+ nat64 ret = 0;
+ while (ret<bytes)
+ {
+  nat32 amount = nat32(math::Min(bytes-ret,largePiece));
+  nat32 done = out.Write(targ+ret,amount);
+  ret += done;
+  if (done!=amount) break;
+ }
+ return ret;
+}
+
+EOS_FUNC nat64 ReadLarge(io::InVirt<io::Binary> & in,void * data,nat64 bytes)
+{
+ byte * targ = (byte*)data;
+ nat64 ret = 0;
+ while (ret<bytes)
+ {
+  nat32 amount = nat32(math::Min(bytes-ret,largePiece));
+  nat32 done = in.Read(targ+ret,amount);
+  ret += done;
+  if (done!=amount) break;
+ }
+ return ret;
+}
+
+EOS_FUNC nat64 SkipLarge(io::InVirt<io::Binary> & in,nat64 bytes)
+{
+ nat64 ret = 0;
+ while (ret<bytes)
+ {
+  nat32 amount = nat32(math::Min(bytes-ret,largePiece));
+  nat32 done = in.Skip(amount);
+  ret += done;
+  if (done!=amount) break;
+ }
+ return ret;
+}
+
 //------------------------------------------------------------------------------
  };
 };
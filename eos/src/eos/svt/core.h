@@ -41,7 +41,7 @@
 #include "eos/types.h"
 #include "eos/io/inout.h"
 #include "eos/str/tokens.h"
-#include "eos/ds/sparse_hash.h"
+#include "eos/ds/flat_hash.h"
 #include "eos/ds/sort_lists.h"
 
 namespace eos
@@ -55,6 +55,9 @@ class Type;
 // Ditto on the node class.
 class Node;
 
+// And the stream used for loading from a file mapping.
+class MapIn;
+
 //------------------------------------------------------------------------------
 /// The Core of the SVT system, almost every object within it has a pointer to 
 /// this. It provide a database of types and access to a central token table,
@@ -123,13 +126,36 @@ class EOS_CLASS Core
                 Node * (*Load)(Core & core,io::InVirt<io::Binary> & in,Node * self));
 
 
+  // Used internally by Save when writting a mappable file, points to the 
+  // current position in the file whilst writting, so Var can align its data.
+  // null when not writting a mappable file.
+   nat64 * WritePos() const {return writePos;}
+   void SetWritePos(nat64 * wp) {writePos = wp;}
+
+  // Used internally by Save when writting a compressed file, true whilst 
+  // writting so Var compresses its data.
+   bit WriteCompress() const {return writeCompress;}
+   void SetWriteCompress(bit wc) {writeCompress = wc;}
+   
+  // Used internally by LoadMapped, points to the stream being loaded from
+  // whilst loading from a file mapping, so Var can point its data into the
+  // mapping rather than copying it out. null otherwise.
+   MapIn * ReadMap() const {return readMap;}
+   void SetReadMap(MapIn * rm) {readMap = rm;}
+
+  // Used internally by TaV, the revision of the file being loaded, so Var 
+  // knows if its data could be compressed. 1 when not loading a file.
+   nat32 ReadRevision() const {return readRevision;}
+   void SetReadRevision(nat32 rr) {readRevision = rr;}
+
+
   /// &nbsp;
    static inline cstrconst TypeString() {return "eos::svt::Core";}
 
 
  protected:
   str::TokenTable & tt;
-  ds::SparseHash<Type*,mem::KillDel<Type> > types;
+  ds::FlatHash<Type*,mem::KillDel<Type> > types;
   
   struct LoadType
   {
@@ -147,8 +173,30 @@ class EOS_CLASS Core
   };
   
   ds::SortList<LoadType> ltl;
+  
+  nat64 * writePos;
+  bit writeCompress;
+  MapIn * readMap;
+  nat32 readRevision;
 };
 
+//------------------------------------------------------------------------------
+// Helpers for the 5 byte block and object sizes in the headers of the svt
+// file format, which are a 4 byte low part followed by a 1 byte high part, and
+// for moving the resulting, potentially over 4 gig, blocks of data about...
+
+// Combines the two parts of a header size...
+inline nat64 BlockSize(nat32 low,nat8 high) {return nat64(low) | (nat64(high)<<32);}
+
+// Writes a size in the header format, returning how many bytes were written, i.e. 5...
+EOS_FUNC nat32 WriteBlockSize(io::OutVirt<io::Binary> & out,nat64 size);
+
+// Writes/reads/skips the given number of bytes, in pieces that fit the 32 bit
+// stream interface. Returns how many bytes were actually done...
+EOS_FUNC nat64 WriteLarge(io::OutVirt<io::Binary> & out,const void * data,nat64 bytes);
+EOS_FUNC nat64 ReadLarge(io::InVirt<io::Binary> & in,void * data,nat64 bytes);
+EOS_FUNC nat64 SkipLarge(io::InVirt<io::Binary> & in,nat64 bytes);
+
 //------------------------------------------------------------------------------
  };
 };
@@ -38,6 +38,9 @@ namespace eos
 // As its used below we pre-declare it here...
 class Var;
 
+template <typename T>
+class View;
+
 //------------------------------------------------------------------------------
 /// An accessor to a particular field within a Var, templated on the type for it
 /// to return. It supplies several getters with different numbers of indexes, for
@@ -51,7 +54,7 @@ class EOS_CLASS Field
  public:
   /// Whilst you can create a field with this constructor do not use 
   /// it until you have passed it into Var, i.e. until Valid().
-   Field():var(null<Var*>()),data(null<byte*>()),stride(null<nat32*>()) {}
+   Field():var(null<Var*>()),data(null<byte*>()),stride(null<nat64*>()),size(null<nat32*>()) {}
    
   /// This constructs a field directly from a Var on being given a token of the
   /// field to extract. If the field does not exist the field will not be valid,
@@ -64,40 +67,45 @@ class EOS_CLASS Field
    Field(Var * var,cstrconst f);
 
   /// &nbsp;
-   Field(const Field<T> & rhs):var(rhs.var),data(rhs.data),stride(rhs.stride) {}
+   Field(const Field<T> & rhs):var(rhs.var),data(rhs.data),stride(rhs.stride) {SetSizes(rhs.size);}
 
   /// &nbsp;
    ~Field() {}
 
 
   /// &nbsp;
-   Field<T> & operator = (const Field<T> & rhs) {var = rhs.var; data = rhs.data; stride = rhs.stride; return *this;}
+   Field<T> & operator = (const Field<T> & rhs) {var = rhs.var; data = rhs.data; stride = rhs.stride; SetSizes(rhs.size); return *this;}
+
+  // Undocumented, as only for internal use.
+   void Set(Var * v,byte * d, nat64 * s);
 
   // Undocumented, as only for internal use.
-   void Set(Var * v,byte * d, nat32 * s) {var = v; data = d; stride = s;}
+   void Set(const Var * v,byte * d, nat64 * s) const;
 
   // Undocumented, as only for internal use.
-   void Set(const Var * v,byte * d, nat32 * s) const {var = v; data = d; stride = s;}
+   void Set(Var * v,byte * d,nat64 * s,const nat32 * sz) {var = v; data = d; stride = s; SetSizes(sz);}
 
   /// &nbsp;
    bit operator == (const Field<T> & rhs) {return data==rhs.data;}
 
 
   /// Returns true if the field has been set and is ready for action.
-   bit Valid() const {return (data!=null<byte*>()) && (stride!=null<nat32*>());}
+   bit Valid() const {return (data!=null<byte*>()) && (stride!=null<nat64*>());}
    
   /// Makes Valid()==false, call this if you delete the Var its pointing to.
-   void SetInvalid() {var = null<Var*>(); data = null<byte*>(); stride = null<nat32*>();}
+   void SetInvalid() {var = null<Var*>(); data = null<byte*>(); stride = null<nat64*>(); size = null<nat32*>();}
 
 
-  /// Returns the var which this field links to.
+  /// Returns the var which this field links to. Note that for a View the Var
+  /// has the sizes of the whole, not the view, so ask the Field for sizes.
    Var * GetVar() const {return var;}
 
   /// This allows you to get a field within the field given, for instance if this field 
   /// consists of 3 floating point values this allows you to offset to internal
-  /// values and create a field of 1 floating point value.
+  /// values and create a field of 1 floating point value. If this is a View the
+  /// output covers the same region.
    template <typename S>
-   void SubField(nat32 offset,Field<S> & out) const {out.Set(var,data+offset,stride);}
+   void SubField(nat32 offset,Field<S> & out) const {out.Set(var,data+offset,stride,size);}
 
 
   /// Returns how many dimensions it has.
@@ -108,16 +116,40 @@ class EOS_CLASS Field
   /// Returns a pointer to an array of sizes.
    const nat32 * Sizes() const;
 
-  /// Returns the stride of a given dimension.
-   nat32 Stride(nat32 dim) const;
+  /// Returns the stride of a given dimension. 64 bit, so the data can be
+  /// over 4 gig. Note that these are specific to the field, and can differ
+  /// from those of the Var when its planar.
+   nat64 Stride(nat32 dim) const;
       
   // Returns a pointer to an array of stride sizes.
   // Entry 0 is the gap between each item.
-   const nat32 * Strides() const;
+   const nat64 * Strides() const;
 
   /// Returns the number of items in the data structure.
    nat32 Count() const;
 
+  /// Returns true if the items are stored contiguously, without gaps, i.e. 
+  /// the Var is planar or only contains this field, its rows are not 
+  /// padded and it is not a View of part of the rows.
+   bit Contiguous() const
+   {
+    if (stride[0]!=sizeof(T)) return false;
+    nat32 dims = Dims();
+    for (nat32 i=1;i<dims;i++)
+    {
+     if (stride[i]!=stride[i-1]*size[i-1]) return false;
+    }
+    return true;
+   }
+
+  /// If Contiguous() this returns a pointer to the data as a simple array of
+  /// Count() items, in the obvious order, so inner loops can be tight. 
+  /// Otherwise returns null.
+   T * Dense() {return Contiguous()?(T*)data:null<T*>();}
+
+  /// &nbsp;
+   const T * Dense() const {return Contiguous()?(T*)data:null<T*>();}
+
 
   /// 0 dimension accessor, provided only for completness, in 
   /// principal it could be used.
@@ -203,6 +235,13 @@ class EOS_CLASS Field
   /// have the same number of dimensions and equal or larger sizes.
    void CopyFrom(const Field<T> & rhs)
    {
+    // If both are dense and the same size its a simple copy...
+     if (Contiguous()&&rhs.Contiguous()&&(Count()==rhs.Count()))
+     {
+      mem::Copy(data,rhs.data,nat64(Count())*sizeof(T));
+      return;
+     }
+
     // Setup position variable...
      nat32 posTemp[4];
      nat32 dims = Dims();
@@ -248,9 +287,85 @@ class EOS_CLASS Field
 
 
  private:
-  Var * var; // Pointer to the relevent Var, so it can returns dims and size.
+  template <typename S> friend class View;
+
+  Var * var; // Pointer to the relevent Var, so it can returns dims.
   byte * data; // Pointer to the first item.
-  nat32 * stride; // Pointer to an array of numbers, dim[0] is the stride, dim[1] is the stride * the size of the first dimension, etc.
+  nat64 * stride; // Pointer to an array of numbers, dim[0] is the stride, dim[1] is the stride * the size of the first dimension, etc.
+  const nat32 * size; // Pointer to the size of each dimension, the Var's or local.
+  nat32 local[4]; // The sizes when they are not the Var's, for a View, so copies carry them with them.
+
+  // Points size at the given sizes, unless they are not the Var's, in which 
+  // case they are copied into local...
+   void SetSizes(const nat32 * sz);
+};
+
+//------------------------------------------------------------------------------
+/// A rectangular region of a Field, i.e. a box given by an origin and a size 
+/// in each dimension. It shares the data and strides of the Field it is taken
+/// from, so making one is cheap and writting to it writes to the original. As
+/// it is a Field it can be passed to anything that takes one, which will see 
+/// only the region, with coordinates relative to its origin; useful for tiling
+/// work between threads, processing with overlapping halos and restricting 
+/// an algorithm to a region of interest. Like any Field it doesn't own the
+/// data, so is only good for as long as the Var is; a Field copied from a View
+/// carries the sizes of the region with it, so has the same lifetime. Views can
+/// be taken of Views, of upto 4 dimensions, as for the Field accessors. Dense()
+/// will return null unless the region covers whole rows.
+template <typename T>
+class EOS_CLASS View : public Field<T>
+{
+ public:
+  /// Invalid until assigned to.
+   View() {}
+
+  /// Creates a view of the given field, origin and size are arrays of 
+  /// Dims() entries. The region must be inside the field.
+   View(const Field<T> & f,const nat32 * origin,const nat32 * size)
+   {Setup(f,origin,size);}
+
+  /// Creates a view of the first two dimensions of a field, any further 
+  /// dimensions are left whole. The region must be inside the field.
+   View(const Field<T> & f,nat32 x,nat32 y,nat32 width,nat32 height)
+   {
+    nat32 dims = f.Dims();
+    nat32 o[4]; nat32 s[4];
+    for (nat32 i=0;(i<dims)&&(i<4);i++) {o[i] = 0; s[i] = f.Size(i);}
+    if (dims>0) {o[0] = x; s[0] = width;}
+    if (dims>1) {o[1] = y; s[1] = height;}
+
+    Setup(f,o,s);
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() 
+   {
+    static GlueStr ret(GlueStr() << "eos::svt::View<" << typestring<T>() << ">");
+    return ret;
+   }
+
+
+ private:
+  // Does the work for the constructors...
+   void Setup(const Field<T> & f,const nat32 * origin,const nat32 * size)
+   {
+    nat32 dims = f.Dims();
+    log::Assert(dims<=4,"svt::View of more than 4 dimensions");
+
+    byte * d = f.data;
+    for (nat32 i=0;i<dims;i++)
+    {
+     log::Assert(origin[i]+size[i]<=f.Size(i),"svt::View outside of its field");
+     d += origin[i]*f.stride[i];
+     this->local[i] = size[i];
+    }
+
+    this->var = f.var;
+    this->data = d;
+    this->stride = f.stride;
+    this->size = this->local;
+   }
 };
 
 //------------------------------------------------------------------------------
@@ -262,37 +377,59 @@ class EOS_CLASS Field
 
 template <typename T>
 eos::svt::Field<T>::Field(eos::svt::Var * var,eos::str::Token f)
-:var(null<Var*>()),data(null<byte*>()),stride(null<nat32*>())
+:var(null<Var*>()),data(null<byte*>()),stride(null<nat64*>()),size(null<nat32*>())
 {var->ByName(f,*this);}
 
 template <typename T>
 eos::svt::Field<T>::Field(eos::svt::Var * var,eos::cstrconst f)
-:var(null<Var*>()),data(null<byte*>()),stride(null<nat32*>())
+:var(null<Var*>()),data(null<byte*>()),stride(null<nat64*>()),size(null<nat32*>())
 {var->ByName(f,*this);}
    
+template <typename T>
+inline void eos::svt::Field<T>::Set(eos::svt::Var * v,eos::byte * d,eos::nat64 * s)
+{var = v; data = d; stride = s; size = v->Sizes();}
+
+template <typename T>
+inline void eos::svt::Field<T>::Set(const eos::svt::Var * v,eos::byte * d,eos::nat64 * s) const
+{var = v; data = d; stride = s; size = v->Sizes();}
+
+template <typename T>
+inline void eos::svt::Field<T>::SetSizes(const eos::nat32 * sz)
+{
+ if ((var==null<Var*>())||(sz==null<nat32*>())||(sz==var->Sizes())) {size = sz; return;}
+ eos::nat32 dims = eos::math::Min(var->Dims(),eos::nat32(4));
+ for (eos::nat32 i=0;i<dims;i++) local[i] = sz[i];
+ size = local;
+}
+
 template <typename T>
 inline eos::nat32 eos::svt::Field<T>::Dims() const 
 {return var->Dims();}
 
 template <typename T>
 inline eos::nat32 eos::svt::Field<T>::Size(eos::nat32 dim) const 
-{return var->Size(dim);}
+{return size[dim];}
 
 template <typename T>
 inline const eos::nat32 * eos::svt::Field<T>::Sizes() const
-{return var->Sizes();}
+{return size;}
 
 template <typename T>
-inline eos::nat32 eos::svt::Field<T>::Stride(eos::nat32 dim) const 
-{return var->Stride(dim);}
+inline eos::nat64 eos::svt::Field<T>::Stride(eos::nat32 dim) const 
+{return stride[dim];}
 
 template <typename T>
-inline const eos::nat32 * eos::svt::Field<T>::Strides() const
-{return var->Strides();}
+inline const eos::nat64 * eos::svt::Field<T>::Strides() const
+{return stride;}
 
 template <typename T>
 inline eos::nat32 eos::svt::Field<T>::Count() const
-{return var->Count();}
+{
+ eos::nat32 ret = 1;
+ eos::nat32 dims = Dims();
+ for (eos::nat32 i=0;i<dims;i++) ret *= size[i];
+ return ret;
+}
 
 template <typename T>
 void eos::svt::Field<T>::CopyFrom(T * d,eos::nat32 s)
@@ -305,7 +442,7 @@ void eos::svt::Field<T>::CopyFrom(T * d,eos::nat32 s)
   for (eos::nat32 i=0;i<dims;i++) pos[i] = 0;
 
  // Iterate every last field entry...
-  eos::nat32 count = var->Count();
+  eos::nat32 count = Count();
   for (eos::nat32 i=0;i<count;i++)
   {
    byte * to = data; for (eos::nat32 j=0;j<dims;j++) to += pos[j]*stride[j];
@@ -48,7 +48,7 @@ TaV::~TaV()
 
 bit TaV::Check() const
 {
- return (magic[0]=='J')&&(magic[1]=='S')&&(magic[2]=='V')&&(magic[3]=='T')&&(revision==1)&&(extension<=0);
+ return (magic[0]=='J')&&(magic[1]=='S')&&(magic[2]=='V')&&(magic[3]=='T')&&(revision>=1)&&(revision<=4)&&(extension<=0);
 }
 
 bit TaV::Write(io::OutVirt<io::Binary> & out)
@@ -60,14 +60,35 @@ bit TaV::Write(io::OutVirt<io::Binary> & out)
  if (out.Write("TAV",3)!=3) return false;
  
  nat16 progLength = str::Length(prog);
- nat32 rootLength = root->TotalWriteSize();
+ nat64 rootLength = root->TotalWriteSize();
   
- nat32 size = 16;
+ nat64 size = 16;
   size += 4+4+4;
   size += 2+progLength;
   size += rootLength;
- if (out.Write(&size,4)!=4) return false;
- if (out.Write(&size,4)!=4) return false;
+
+ // Files that fit in 4 gig are written as revision 1, so older loaders can
+ // still read them, bigger files need revision 2...
+  nat32 sizeLow = nat32(size);
+  nat32 sizeHigh = nat32(size>>32);
+  if (root->GetCore().WriteCompress()||root->GetCore().WritePos())
+  {
+   revision = root->GetCore().WriteCompress()?4:3;
+   if (out.Write(&sizeLow,4)!=4) return false;
+   if (out.Write(&sizeHigh,4)!=4) return false;
+  }
+  else if (sizeHigh==0)
+  {
+   revision = 1;
+   if (out.Write(&sizeLow,4)!=4) return false;
+   if (out.Write(&sizeLow,4)!=4) return false;
+  }
+  else
+  {
+   revision = 2;
+   if (out.Write(&sizeLow,4)!=4) return false;
+   if (out.Write(&sizeHigh,4)!=4) return false;
+  }
  
  if (out.Write(magic,4)!=4) return false;
  if (out.Write(&revision,4)!=4) return false;
@@ -92,11 +113,11 @@ bit TaV::Read(Core & core,io::InVirt<io::Binary> & in)
  nat32 size2;
  if (in.Read(&size,4)!=4) return false;
  if (in.Read(&size2,4)!=4) return false;
- if (size!=size2) return false;
  
  if (in.Read(magic,4)!=4) return false; 
  if (in.Read(&revision,4)!=4) return false; 
  if (in.Read(&extension,4)!=4) return false;
+ if ((revision==1)&&(size!=size2)) return false; // Later revisions store the high bits in size2.
  
  nat16 progSize;
  if (in.Read(&progSize,2)!=2) return false; 
@@ -105,7 +126,10 @@ bit TaV::Read(Core & core,io::InVirt<io::Binary> & in)
  if (in.Read(prog,progSize)!=progSize) return false; 
  prog[progSize] = 0;
  
- root = core.LoadObject(in);
+ nat32 prevRevision = core.ReadRevision();
+ core.SetReadRevision(revision);
+  root = core.LoadObject(in);
+ core.SetReadRevision(prevRevision);
 
  return (root!=null<Node*>())&&Check();
 }
@@ -183,6 +207,76 @@ EOS_FUNC Node * LoadVar(Core & core,io::InVirt<io::Binary> & in,Node * self)
  }
 }
 
+//------------------------------------------------------------------------------
+MapIn::MapIn(file::FileMap * m)
+:map(m),pos(0)
+{
+ map->Acquire();
+}
+
+MapIn::~MapIn()
+{
+ map->Release();
+}
+
+nat32 MapIn::Read(void * out,nat32 bytes)
+{
+ nat32 ret = Peek(out,bytes);
+ pos += ret;
+ return ret;
+}
+
+nat32 MapIn::Peek(void * out,nat32 bytes) const
+{
+ nat32 ret = nat32(math::Min<nat64>(bytes,map->Size()-pos));
+ mem::Copy((byte*)out,map->Ptr()+pos,ret);
+ return ret;
+}
+
+nat32 MapIn::Skip(nat32 bytes)
+{
+ return nat32(Advance(bytes));
+}
+
+nat64 MapIn::Advance(nat64 bytes)
+{
+ nat64 ret = math::Min<nat64>(bytes,map->Size()-pos);
+ pos += ret;
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// Wraps an output stream, keeping track of the position in the file, as used 
+// by Save to write mappable files...
+class PosOut : public io::OutVirt<io::Binary>
+{
+ public:
+   PosOut(io::OutVirt<io::Binary> & o,nat64 & p):out(o),pos(p) {}
+  ~PosOut() {}
+
+   nat32 Write(const void * in,nat32 bytes)
+   {
+    nat32 ret = out.Write(in,bytes);
+    pos += ret;
+    if (out.Error()) SetError(true);
+    return ret;
+   }
+
+   nat32 Pad(nat32 bytes)
+   {
+    nat32 ret = out.Pad(bytes);
+    pos += ret;
+    if (out.Error()) SetError(true);
+    return ret;
+   }
+
+   cstrconst TypeString() const {return "eos::svt::PosOut";}
+
+ private:
+  io::OutVirt<io::Binary> & out;
+  nat64 & pos;
+};
+
 //------------------------------------------------------------------------------
 EOS_FUNC Node * Load(Core & core,cstrconst fn, bit * warning)
 {
@@ -190,8 +284,8 @@ EOS_FUNC Node * Load(Core & core,cstrconst fn, bit * warning)
  file::File<io::Binary> file(fn,file::way_edit,file::mode_read);
  if (file.Active()==false) return null<Node*>();
  
- file::Cursor<io::Binary> cursor = file.GetCursor();
- io::VirtIn<file::Cursor<io::Binary> > vFile(cursor);
+ file::ReadBuffer<io::Binary> buffer(file);
+ io::VirtIn<file::ReadBuffer<io::Binary> > vFile(buffer);
  
  TaV tav;
  bit success = tav.Read(core,vFile);
@@ -200,19 +294,83 @@ EOS_FUNC Node * Load(Core & core,cstrconst fn, bit * warning)
  return tav.root;
 }
 
-EOS_FUNC bit Save(cstrconst fn,Node * root,bit overwrite)
+EOS_FUNC Node * LoadMapped(Core & core,cstrconst fn,bit * warning,bit copyOnWrite)
+{
+ LogBlock("Node * eos::svt::LoadMapped(...)","-");
+ file::FileMap * map = new file::FileMap(fn,copyOnWrite);
+ if (map->Active()==false) {delete map; return null<Node*>();}
+ 
+ MapIn in(map);
+ 
+ TaV tav;
+ core.SetReadMap(&in);
+  bit success = tav.Read(core,in);
+ core.SetReadMap(null<MapIn*>());
+ if (warning) *warning = !success;
+ 
+ return tav.root;
+}
+
+EOS_FUNC bit Save(cstrconst fn,Node * root,bit overwrite,bit mappable,bit compress)
 {
  LogBlock("bit eos::svt::Save(...)","-");
  file::File<io::Binary> file(fn,overwrite?file::way_ow:file::way_new,file::mode_write);
  if (file.Active()==false) return false; 
 
- file::Cursor<io::Binary> cursor = file.GetCursor();
- io::VirtOut<file::Cursor<io::Binary> > vFile(cursor);
+ // Written from a second thread, so serialising the next block overlaps with
+ // writting the last...
+  file::WriteBuffer<io::Binary> buffer(file,0,1024*1024,true);
+  io::VirtOut<file::WriteBuffer<io::Binary> > vFile(buffer);
 
  TaV tav;
  tav.root = root;
  
- return tav.Write(vFile);
+ bit ret;
+ if (mappable&&!compress)
+ {
+  nat64 pos = 0;
+  PosOut pFile(vFile,pos);
+  root->GetCore().SetWritePos(&pos);
+   ret = tav.Write(pFile);
+  root->GetCore().SetWritePos(null<nat64*>());
+ }
+ else if (compress)
+ {
+  root->GetCore().SetWriteCompress(true);
+   ret = tav.Write(vFile);
+  root->GetCore().SetWriteCompress(false);
+ }
+ else ret = tav.Write(vFile);
+ 
+ return buffer.Flush() && ret;
+}
+
+EOS_FUNC bit Write(io::OutVirt<io::Binary> & out,Node * root,bit compress)
+{
+ LogBlock("bit eos::svt::Write(...)","-");
+ TaV tav;
+ tav.root = root;
+
+ bit ret;
+ if (compress)
+ {
+  root->GetCore().SetWriteCompress(true);
+   ret = tav.Write(out);
+  root->GetCore().SetWriteCompress(false);
+ }
+ else ret = tav.Write(out);
+
+ return ret;
+}
+
+EOS_FUNC Node * Read(Core & core,io::InVirt<io::Binary> & in,bit * warning)
+{
+ LogBlock("Node * eos::svt::Read(...)","-");
+ TaV tav;
+ bit success = tav.Read(core,in);
+ if (warning) *warning = !success;
+
+ return tav.root;
 }
 
 //------------------------------------------------------------------------------
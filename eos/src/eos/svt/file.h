@@ -112,6 +112,33 @@
 /// given. The field data is then a tightly packed linear array, the size being the product of
 /// all the dimension sizes given. If looping over the array for each dimension the inner loop
 /// is the first dimension given in the dimension list.
+/// As each item is stored at the size of its type, fields of the compact types, such as 
+/// "eos::math::Half", "eos::math::Unorm8" or "eos::bs::ColourRGBh", take a half or a quarter
+/// of the space of their real32 equivalents on disk as well as in memory.
+///
+/// In a mappable file, revision 3, the field data is surrounded by exactly 64
+/// bytes of padding, so that it starts at a multiple of 64 bytes from the start
+/// of the file. This consists of a 1 byte pad count, p, followed by p zero bytes,
+/// then the field data, followed by 63-p zero bytes. As the padding only makes
+/// sense relative to the file this is only done when a whole file is saved as 
+/// mappable, loaders recognise it by the block size being 64 bytes larger than
+/// it would otherwise be.
+///
+/// In a compressed file, revision 4, the field data is instead split into
+/// chunks of whole items, each compressed independently with zlib (The 
+/// compress2 function, so each chunk has a zlib header.). This consists of:
+/// - 4 bytes, ZLIB.
+/// - 4 byte number of items per chunk, the last chunk can have less.
+/// - 4 byte chunk count.
+/// - 4 bytes for each chunk, its compressed size.
+/// - The compressed chunks, in order.
+///
+/// The chunk index is there so a region of the array could be decompressed
+/// without decompressing everything, but no loader does this yet - Load and
+/// LoadMapped always decompress every chunk. Only revision 4 files contain 
+/// compressed data, and a Var whose data could not be compressed is written as
+/// normal; loaders tell the two apart by the block size, which the compressed
+/// data never matches.
 ///
 /// \section File Structure
 /// A file containing a SVT hierachy is given the extension .svt.
@@ -129,7 +156,15 @@
 /// - The true root of the file, an SVT object, either a HON, SID or MID.
 ///
 /// The revision number changes if the actual file format changes fundamentally, 
-/// such that no previous program can reliably open it. Should be 1.
+/// such that no previous program can reliably open it. Should be 1, unless the 
+/// file is over 4 gig, in which case it is 2. A revision 2 file is identical 
+/// except that the TAV header, which normally repeats its 4 byte size twice, 
+/// instead has the low 4 bytes followed by the high 4 bytes of its size, and that
+/// the 5th byte of the header sizes will be in use. Files that fit are always
+/// written as revision 1, so older loaders can still read them. Revision 3 is 
+/// the same as revision 2 but with the padding of Var data described above, so 
+/// it can be memory mapped; it is only written when requested. Revision 4 is likewise,
+/// but with the compressed Var data described above instead of the padding.
 /// The extension number is incrimented for each change that adds something 
 /// without breaking previous loaders of the current revision. This is ushally 
 /// taken to indicate that the file could contain unrecognised blocks, or blocks with 
@@ -143,6 +178,7 @@
 
 #include "eos/types.h"
 #include "eos/svt/var.h"
+#include "eos/file/files.h"
 
 namespace eos
 {
@@ -177,7 +213,8 @@ class EOS_CLASS TaV : public Deletable
   /// Should be "JSVT".
    cstrchar magic[4];
 
-  /// The revision number, should be 1.
+  /// The revision number, should be 1, or 2 for files over 4 gig, or 3 for 
+  /// mappable files, or 4 for compressed files. Set by Write().
    nat32 revision;
 
   /// The extension number, should be 0.
@@ -206,6 +243,59 @@ EOS_FUNC Node * LoadMeta(Core & core,io::InVirt<io::Binary> & in,Node * self);
 EOS_FUNC Node * CreateVar(Core & core,Node * parent);
 EOS_FUNC Node * LoadVar(Core & core,io::InVirt<io::Binary> & in,Node * self);
 
+//------------------------------------------------------------------------------
+/// The input stream used by LoadMapped, reads from a file::FileMap. Provides
+/// access to the mapping so Var can point its data into it directly. Acquires
+/// the mapping, and releases it when done.
+class EOS_CLASS MapIn : public io::InVirt<io::Binary>
+{
+ public:
+  /// &nbsp;
+   MapIn(file::FileMap * map);
+   
+  /// &nbsp;
+  ~MapIn();
+
+
+  /// &nbsp;
+   bit EOS() const {return pos>=map->Size();}
+
+  /// Files over 4 gig report 0xFFFFFFFF.
+   nat32 Avaliable() const {return nat32(math::Min<nat64>(map->Size()-pos,0xFFFFFFFF));}
+
+  /// &nbsp;
+   nat32 Read(void * out,nat32 bytes);
+
+  /// &nbsp;
+   nat32 Peek(void * out,nat32 bytes) const;
+
+  /// &nbsp;
+   nat32 Skip(nat32 bytes);
+
+
+  /// Returns the mapping being read.
+   file::FileMap * Map() const {return map;}
+
+  /// Returns the current position in the mapping.
+   nat64 Pos() const {return pos;}
+
+  /// Returns a pointer to the current position in the mapping.
+   byte * Here() const {return map->Ptr() + pos;}
+   
+  /// Moves the position along by the given amount, returns how far it actually moved.
+   nat64 Advance(nat64 bytes);
+
+
+  /// &nbsp;
+   cstrconst TypeString() const {return "eos::svt::MapIn";}
+
+
+ private:
+  file::FileMap * map;
+  nat64 pos;
+};
+
+
 //------------------------------------------------------------------------------
 /// Loads an SVT file. (Traditionally a .svt extension.)
 /// Returns the root of the newly loaded hierachy on success or null on total 
@@ -214,8 +304,36 @@ EOS_FUNC Node * LoadVar(Core & core,io::InVirt<io::Binary> & in,Node * self);
 /// were unsuported and have hence been ignored.
 EOS_FUNC Node * Load(Core & core,cstrconst fn, bit * warning = null<bit*>());
 
+/// Identical to Load, except the file is memory mapped, and for files saved as
+/// mappable the data of each Var points straight into the mapping rather than 
+/// being copied out, so loading is almost instant and the data is only paged in
+/// as it is used. Other files load as normal. The mapping lives until the last
+/// Var using it is deleted or re-Commit()-ed to a new structure.
+/// \param copyOnWrite If true the Var data can be editted, with the changes 
+///                    never reaching the file. If false it is read only, and 
+///                    writting to it will crash, but no memory is ever 
+///                    allocated for it.
+EOS_FUNC Node * LoadMapped(Core & core,cstrconst fn,bit * warning = null<bit*>(),bit copyOnWrite = true);
+
 /// Saves a SVT file, returns true on success and false on failure.
-EOS_FUNC bit Save(cstrconst fn,Node * root,bit overwrite = false);
+/// If mappable is true it is written as revision 3, with the Var data aligned 
+/// so LoadMapped can use it in place.
+/// If compress is true it is written as revision 4, with the Var data 
+/// compressed using zlib, in parallel. This overrides mappable. If zlib can't
+/// be loaded the data is written uncompressed. Load and LoadMapped detect
+/// compressed data automatically.
+EOS_FUNC bit Save(cstrconst fn,Node * root,bit overwrite = false,bit mappable = false,bit compress = false);
+
+/// Writes an SVT file to a stream rather than a file, e.g. to send it over a
+/// network. compress is as for Save, mappable makes no sense for a stream so is
+/// not offered. As with Save the compress flag is held by the Core, so two
+/// threads must not write the nodes of the same Core with different settings
+/// at once. Returns true on success.
+EOS_FUNC bit Write(io::OutVirt<io::Binary> & out,Node * root,bit compress = false);
+
+/// Reads an SVT file from a stream, as written by Write or Save. Returns null
+/// on total failure, warning is as for Load.
+EOS_FUNC Node * Read(Core & core,io::InVirt<io::Binary> & in,bit * warning = null<bit*>());
 
 //------------------------------------------------------------------------------
  };
@@ -104,14 +104,14 @@ Meta::Item & Meta::Entry(nat32 i)
  else return *list[i-ExportSize()];
 }
 
-nat32 Meta::Memory() const
+nat64 Meta::Memory() const
 {
  memory = Node::Memory() + list.Memory() + sizeof(nat32) + sizeof(Item)*list.Size();
  list.Iter<Meta,&Meta::SumMem>((Meta*)this);
  return memory;
 }
 
-nat32 Meta::WriteSize() const
+nat64 Meta::WriteSize() const
 {
  memory = Node::WriteSize();
   memory += 16 + 4;
@@ -119,7 +119,7 @@ nat32 Meta::WriteSize() const
  return memory;
 }
 
-nat32 Meta::TotalWriteSize() const
+nat64 Meta::TotalWriteSize() const
 {
  return WriteSize();
 }
@@ -129,22 +129,19 @@ cstrconst Meta::MagicString() const
  return "SID";
 }
 
-nat32 Meta::Write(io::OutVirt<io::Binary> & out) const
+nat64 Meta::Write(io::OutVirt<io::Binary> & out) const
 {
- nat32 ret = Node::Write(out);
+ nat64 ret = Node::Write(out);
 
   // Header...
-   nat32 ws = WriteSize();
-   nat32 bs = ws - ret;
-   nat32 os = TotalWriteSize()-ret;
-   nat8 zb = 0;
+   nat64 ws = WriteSize();
+   nat64 bs = ws - ret;
+   nat64 os = TotalWriteSize()-ret;
 
    ret += out.Write("SID",3);
    ret += out.Write(MagicString(),3);
-   ret += out.Write(&bs,4);
-   ret += out.Write(&zb,1);
-   ret += out.Write(&os,4);
-   ret += out.Write(&zb,1);
+   ret += WriteBlockSize(out,bs);
+   ret += WriteBlockSize(out,os);
 
   // Field count...
    nat32 fc = list.Size();
@@ -237,7 +234,6 @@ void Meta::ReadBlock(io::InVirt<io::Binary> & in)
   rsf += in.Read(&head.oExt,1);
   
   if ((head.bm[0]!='S')||(head.bm[1]!='I')||(head.bm[2]!='D')) {in.SetError(true); return;}
-  if ((head.bExt!=0)||(head.oExt!=0)) {in.SetError(true); return;}
 
   // Loaded header, time for the body...
    nat32 fields;
@@ -288,7 +284,7 @@ void Meta::ReadBlock(io::InVirt<io::Binary> & in)
      }
    }
 
- in.SetError(rsf!=head.bSize);
+ in.SetError(rsf!=BlockSize(head.bSize,head.bExt));
 }
 
 //------------------------------------------------------------------------------
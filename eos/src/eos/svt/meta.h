@@ -187,20 +187,20 @@ class EOS_CLASS Meta : public Node
 
  
   /// &nbsp;
-   nat32 Memory() const;
+   nat64 Memory() const;
    
   /// &nbsp;
-   nat32 WriteSize() const;
+   nat64 WriteSize() const;
    
   /// &nbsp;
-   nat32 TotalWriteSize() const;
+   nat64 TotalWriteSize() const;
 
 
   /// &nbsp;
    cstrconst MagicString() const;
   
   /// &nbsp;
-   nat32 Write(io::OutVirt<io::Binary> & out) const;
+   nat64 Write(io::OutVirt<io::Binary> & out) const;
    
   /// &nbsp;
    void ReadBlock(io::InVirt<io::Binary> & in);
@@ -278,7 +278,7 @@ class EOS_CLASS Meta : public Node
   mutable ds::SortList<Item*,ds::SortPtrOp<Item*>,mem::KillDel<Item> > expList; // Export list, stores the exported nodes that have been constructed.
 
  // Helpers for the memory method, as its quite hard to calculate...
-  mutable nat32 memory;
+  mutable nat64 memory;
   void SumMem(Item *& item) {if (item->is==Astring) memory += item->asStr->Memory();}
   
  // Another helper, similar to above, for the WriteSize method.
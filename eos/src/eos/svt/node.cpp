@@ -162,9 +162,9 @@ void Node::AttachAfter(Node * l)
  last->next = this;
 }
 
-nat32 Node::TotalMemory() const
+nat64 Node::TotalMemory() const
 {
- nat32 ret = Memory();
+ nat64 ret = Memory();
  if (child)
  {
   Node * targ = child;
@@ -177,9 +177,9 @@ nat32 Node::TotalMemory() const
  return ret;
 }
 
-nat32 Node::WriteSize() const
+nat64 Node::WriteSize() const
 {
- nat32 ret = 16 + 4;
+ nat64 ret = 16 + 4;
  if (child)
  {
   Node * targ = child;
@@ -192,7 +192,7 @@ nat32 Node::WriteSize() const
  return ret;
 }
 
-nat32 Node::TotalWriteSize() const
+nat64 Node::TotalWriteSize() const
 {
  return WriteSize();
 }
@@ -202,20 +202,17 @@ cstrconst Node::MagicString() const
  return "HON";
 }
 
-nat32 Node::Write(io::OutVirt<io::Binary> & out) const
+nat64 Node::Write(io::OutVirt<io::Binary> & out) const
 {
- nat32 ret = 0;
+ nat64 ret = 0;
   // Header...
-   nat32 bs = WriteSize();
-   nat32 os = TotalWriteSize();
-   nat8 zb = 0;
+   nat64 bs = WriteSize();
+   nat64 os = TotalWriteSize();
 
    ret += out.Write("HON",3);
    ret += out.Write(MagicString(),3);
-   ret += out.Write(&bs,4);
-   ret += out.Write(&zb,1);
-   ret += out.Write(&os,4);
-   ret += out.Write(&zb,1);
+   ret += WriteBlockSize(out,bs);
+   ret += WriteBlockSize(out,os);
 ;
   // Child count...
    nat32 childCount = ChildCount();
@@ -257,7 +254,6 @@ void Node::ReadBlock(io::InVirt<io::Binary> & in)
   rsf += in.Read(&head.oExt,1);
   
   if ((head.bm[0]!='H')||(head.bm[1]!='O')||(head.bm[2]!='N')) {in.SetError(true); return;}
-  if ((head.bExt!=0)||(head.oExt!=0)) {in.SetError(true); return;}
 
   // Header is loaded, time for the children...
    nat32 children;
@@ -271,7 +267,7 @@ void Node::ReadBlock(io::InVirt<io::Binary> & in)
     nc->AttachParent(this);
    }
 
- in.SetError(rsf!=head.bSize);
+ in.SetError(rsf!=BlockSize(head.bSize,head.bExt));
 }
 
 //------------------------------------------------------------------------------
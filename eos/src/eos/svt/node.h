@@ -114,19 +114,19 @@ class EOS_CLASS Node : public Deletable
   /// The Memory() method I am so fond of is made virtual here, so size can
   /// be determined. Only includes current node, to get size of object plus 
   /// children the TotalMemory() method is provided.
-   virtual nat32 Memory() const {return sizeof(Node);}
+   virtual nat64 Memory() const {return sizeof(Node);}
 
   /// This extends Memory() to include children as well, so the size of an 
   /// entire structure can be determined.
-   nat32 TotalMemory() const;
+   nat64 TotalMemory() const;
    
   /// Similar to Memory(), this returns how many bytes the object would consume if 
   /// serialised, including the BOF header.
-   nat32 WriteSize() const;
+   nat64 WriteSize() const;
    
   /// This is a virtual version of WriteSize, so the correct version is called.
   /// Both versions are required to get header sizes right when writting.
-   virtual nat32 TotalWriteSize() const;
+   virtual nat64 TotalWriteSize() const;
 
 
   /// Supports the write method, returns the 3 character magic string for this object.
@@ -134,7 +134,7 @@ class EOS_CLASS Node : public Deletable
   
   /// This Writes the object, including parent blocks, to a stream.
   /// Returns how many bytes have been written.
-   virtual nat32 Write(io::OutVirt<io::Binary> & out) const;
+   virtual nat64 Write(io::OutVirt<io::Binary> & out) const;
    
   /// This reads from the given stream into this object, assuming this object to 
   /// be 'just constructed' and empty. Does not call any parent type Read's, 
@@ -0,0 +1,558 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/svt/pipeline.h"
+
+#include "eos/svt/file.h"
+#include "eos/file/xml.h"
+#include "eos/mt/tasks.h"
+#include "eos/time/times.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+// Marks an input that is not connected...
+static const nat32 unconnected = nat32(-1);
+
+//------------------------------------------------------------------------------
+// A step of the graph, the load of a file if meta is null, the run of an
+// algorithm otherwise...
+class PipelineStep
+{
+ public:
+  // Takes ownership of the name...
+   PipelineStep(cstr n,const MetaAlgorithm * m,const bs::Element & e)
+   :name(n),file(null<cstr>()),meta(m),elem(new bs::Element(e)),keep(false),
+   from(m?m->Inputs():0),fromOut(m?m->Inputs():0),
+   save(m?m->Outputs():1),uses(m?m->Outputs():1),
+   refs(new mt::Atomic[m?m->Outputs():1]),out(m?m->Outputs():1),
+   failed(false),done(false),time(0.0)
+   {
+    for (nat32 i=0;i<from.Size();i++) from[i] = unconnected;
+    for (nat32 i=0;i<save.Size();i++)
+    {
+     save[i] = null<cstr>();
+     uses[i] = 0;
+     out[i] = null<Node*>();
+    }
+   }
+
+  // Deletes any outputs still held...
+  ~PipelineStep()
+   {
+    for (nat32 i=0;i<out.Size();i++) delete out[i];
+    for (nat32 i=0;i<save.Size();i++) mem::Free(save[i]);
+    delete[] refs;
+    delete elem;
+    mem::Free(file);
+    mem::Free(name);
+   }
+
+   nat32 Outputs() const {return out.Size();}
+
+  // Returns the index of the named output, or Outputs() if there is no such
+  // output. An empty name is accepted if there is only one...
+   nat32 FindOutput(const str::String & n) const
+   {
+    if (n.Size()==0) return (Outputs()==1)?0:Outputs();
+    if (meta==null<const MetaAlgorithm*>()) return Outputs();
+    for (nat32 i=0;i<Outputs();i++)
+    {
+     if (n==meta->OutputName(i)) return i;
+    }
+    return Outputs();
+   }
+
+  // The description...
+   cstr name;
+   cstr file; // For a load.
+   const MetaAlgorithm * meta;
+   bs::Element * elem; // A copy, for Configure.
+   bit keep;
+
+   ds::Array<nat32> from; // Step each input comes from, unconnected if none.
+   ds::Array<nat32> fromOut; // Output of that step.
+   ds::Array<cstr> save; // Filename for each output, null to not save it.
+
+   ds::Array<nat32> consumer; // Steps that use an output of this, once for each input connected.
+   ds::Array<nat32> uses; // For each output the number of inputs connected to it.
+
+  // The state of a run...
+   mt::Atomic pending; // Inputs not yet available - the step is started when it hits 0.
+   mt::Atomic * refs; // For each output the inputs that have not finished with it.
+   ds::Array<Node*> out;
+   bit failed;
+   bit done;
+   real32 time;
+};
+
+//------------------------------------------------------------------------------
+// Runs a step, then starts any steps that were waiting only on it...
+class PipelineTask : public mt::Task
+{
+ public:
+  Pipeline * pipe;
+  nat32 index;
+  PipelineTask * all; // Array of the tasks of every step, indexed as steps are.
+
+  Core * core;
+  Cache * cache;
+  time::Progress * prog;
+  time::ProgressCounter * counter;
+  mt::TaskGroup * group;
+
+  void Execute();
+};
+
+void PipelineTask::Execute()
+{
+ PipelineStep & s = *pipe->step[index];
+ real64 start = time::UltraTime();
+
+ // Skip if cancelled or an input failed...
+  bit ok = !prog->Cancelled();
+  for (nat32 i=0;ok&&(i<s.from.Size());i++)
+  {
+   if ((s.from[i]!=unconnected)&&(pipe->step[s.from[i]]->failed)) ok = false;
+  }
+
+ // Do it...
+  if (ok)
+  {
+   if (s.meta==null<const MetaAlgorithm*>())
+   {
+    s.out[0] = Load(*core,s.file);
+    ok = s.out[0]!=null<Node*>();
+   }
+   else
+   {
+    Algorithm * alg = s.meta->Make();
+    if (alg)
+    {
+     alg->Configure(*s.elem);
+     for (nat32 i=0;i<s.from.Size();i++)
+     {
+      if (s.from[i]!=unconnected) alg->SetInput(i,pipe->step[s.from[i]]->out[s.fromOut[i]]);
+     }
+
+     if (cache) alg->RunCached(*cache,*core);
+           else alg->Run();
+
+     for (nat32 i=0;i<s.Outputs();i++)
+     {
+      s.out[i] = alg->GetOutput(i);
+      if ((s.out[i]==null<Node*>())&&(!s.meta->OutputOptional(i))) ok = false;
+     }
+     delete alg;
+    }
+    else ok = false;
+   }
+
+   for (nat32 i=0;ok&&(i<s.Outputs());i++)
+   {
+    if (s.save[i]&&s.out[i]) ok = Save(s.save[i],s.out[i],true);
+   }
+  }
+
+  s.failed = !ok;
+  s.time = time::UltraTime() - start;
+  s.done = true;
+
+ // Release the inputs this was the last user of, and any outputs nothing
+ // uses...
+  for (nat32 i=0;i<s.from.Size();i++)
+  {
+   if (s.from[i]==unconnected) continue;
+   PipelineStep & src = *pipe->step[s.from[i]];
+   if ((src.refs[s.fromOut[i]].Dec()==0)&&(!src.keep))
+   {
+    delete src.out[s.fromOut[i]];
+    src.out[s.fromOut[i]] = null<Node*>();
+   }
+  }
+
+  for (nat32 i=0;i<s.Outputs();i++)
+  {
+   if ((s.uses[i]==0)&&(!s.keep))
+   {
+    delete s.out[i];
+    s.out[i] = null<Node*>();
+   }
+  }
+
+  counter->Add(1);
+
+ // Start the steps that were only waiting for this one...
+  for (nat32 i=0;i<s.consumer.Size();i++)
+  {
+   if (pipe->step[s.consumer[i]]->pending.Dec()==0) group->Add(&all[s.consumer[i]]);
+  }
+}
+
+//------------------------------------------------------------------------------
+Pipeline::Pipeline()
+:error(null<cstr>())
+{}
+
+Pipeline::~Pipeline()
+{
+ Clear();
+}
+
+void Pipeline::Register(const MetaAlgorithm & ma)
+{
+ meta.AddBack(&ma);
+}
+
+void Pipeline::Register(const Plugins & plugins)
+{
+ for (nat32 i=0;i<plugins.Size();i++) meta.AddBack(&plugins[i]);
+}
+
+bit Pipeline::Load(const bs::Element & root)
+{
+ Clear();
+
+ // Create the steps...
+  ds::List<PipelineStep*> made;
+  for (bs::Element * e = root.Front();e!=root.Bad();e = e->Next())
+  {
+   str::String name = e->GetString("name",str::String(""));
+   cstr n = name.ToStr();
+   bit dup = (name.Size()==0);
+   {
+    ds::List<PipelineStep*>::Cursor targ = made.FrontPtr();
+    while (!targ.Bad())
+    {
+     if (str::Compare((*targ)->name,n)==0) dup = true;
+     ++targ;
+    }
+   }
+   mem::Free(n);
+   if (dup)
+   {
+    while (made.Size()!=0) {delete made.Front(); made.RemFront();}
+    str::String msg("Missing or duplicate step name ");
+    msg << name;
+    return Fail(msg);
+   }
+
+   PipelineStep * s = null<PipelineStep*>();
+   if (e->Name()==root.TokTab()("load"))
+   {
+    s = new PipelineStep(name.ToStr(),null<const MetaAlgorithm*>(),*e);
+    s->file = e->GetString("file",str::String("")).ToStr();
+   }
+   else if (e->Name()==root.TokTab()("run"))
+   {
+    cstr algName = e->GetString("alg",str::String("")).ToStr();
+    const MetaAlgorithm * ma = FindMeta(algName);
+    mem::Free(algName);
+    if (ma) s = new PipelineStep(name.ToStr(),ma,*e);
+   }
+
+   if (s==null<PipelineStep*>())
+   {
+    while (made.Size()!=0) {delete made.Front(); made.RemFront();}
+    str::String msg("Unknown element or algorithm for step ");
+    msg << name;
+    return Fail(msg);
+   }
+
+   s->keep = e->GetBit("keep",false);
+   made.AddBack(s);
+  }
+
+  step.Size(made.Size());
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   step[i] = made.Front();
+   made.RemFront();
+  }
+
+ // Connect them up...
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   PipelineStep & s = *step[i];
+   if (s.meta==null<const MetaAlgorithm*>()) continue;
+
+   if (!s.meta->GoodDom(s.elem))
+   {
+    str::String msg("Bad parameters for step ");
+    msg << s.name;
+    return Fail(msg);
+   }
+
+   for (bs::Element * e = s.elem->Front();e!=s.elem->Bad();e = e->Next())
+   {
+    if (e->Name()==root.TokTab()("input"))
+    {
+     str::String inName = e->GetString("name",str::String(""));
+     nat32 in = 0;
+     while ((in<s.from.Size())&&(inName!=s.meta->InputName(in))) ++in;
+     if ((in==s.from.Size())||(s.from[in]!=unconnected))
+     {
+      str::String msg("Unknown or repeated input ");
+      msg << inName << " of step " << s.name;
+      return Fail(msg);
+     }
+
+     cstr fromName = e->GetString("from",str::String("")).ToStr();
+     nat32 src = FindStep(fromName);
+     mem::Free(fromName);
+     if (src==step.Size())
+     {
+      str::String msg("Input ");
+      msg << inName << " of step " << s.name << " comes from an unknown step";
+      return Fail(msg);
+     }
+
+     nat32 o = step[src]->FindOutput(e->GetString("output",str::String("")));
+     if (o==step[src]->Outputs())
+     {
+      str::String msg("Input ");
+      msg << inName << " of step " << s.name << " comes from an unknown output";
+      return Fail(msg);
+     }
+
+     s.from[in] = src;
+     s.fromOut[in] = o;
+     step[src]->uses[o] += 1;
+     nat32 c = step[src]->consumer.Size();
+     step[src]->consumer.Size(c+1);
+     step[src]->consumer[c] = i;
+    }
+   }
+
+   for (nat32 j=0;j<s.from.Size();j++)
+   {
+    if ((s.from[j]==unconnected)&&(!s.meta->InputOptional(j)))
+    {
+     str::String msg("Required input ");
+     msg << s.meta->InputName(j) << " of step " << s.name << " is not connected";
+     return Fail(msg);
+    }
+   }
+  }
+
+ // Saves, which can be given for loads as well...
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   PipelineStep & s = *step[i];
+   for (bs::Element * e = s.elem->Front();e!=s.elem->Bad();e = e->Next())
+   {
+    if (e->Name()!=root.TokTab()("save")) continue;
+
+    nat32 o = s.FindOutput(e->GetString("output",str::String("")));
+    if (o==s.Outputs())
+    {
+     str::String msg("Save of an unknown output of step ");
+     msg << s.name;
+     return Fail(msg);
+    }
+
+    mem::Free(s.save[o]);
+    s.save[o] = e->GetString("file",str::String("")).ToStr();
+   }
+  }
+
+ // Check there are no cycles, by removing steps with no remaining inputs until
+ // there are none left to remove...
+  {
+   ds::Array<nat32> waiting(step.Size());
+   ds::List<nat32> ready;
+   for (nat32 i=0;i<step.Size();i++)
+   {
+    waiting[i] = 0;
+    for (nat32 j=0;j<step[i]->from.Size();j++)
+    {
+     if (step[i]->from[j]!=unconnected) waiting[i] += 1;
+    }
+    if (waiting[i]==0) ready.AddBack(i);
+   }
+
+   nat32 removed = 0;
+   while (ready.Size()!=0)
+   {
+    nat32 i = ready.Front();
+    ready.RemFront();
+    removed += 1;
+    for (nat32 j=0;j<step[i]->consumer.Size();j++)
+    {
+     nat32 c = step[i]->consumer[j];
+     waiting[c] -= 1;
+     if (waiting[c]==0) ready.AddBack(c);
+    }
+   }
+
+   if (removed!=step.Size()) return Fail(str::String("The steps contain a cycle"));
+  }
+
+ return true;
+}
+
+bit Pipeline::Load(str::TokenTable & tt,cstrconst fn)
+{
+ bs::Element * root = file::LoadXML(tt,fn);
+ if (root==null<bs::Element*>())
+ {
+  Clear();
+  str::String msg("Could not load ");
+  msg << fn;
+  return Fail(msg);
+ }
+
+ bit ret = Load(*root);
+ delete root;
+ return ret;
+}
+
+bit Pipeline::Run(Core & core,Cache * cache,time::Progress * prog)
+{
+ ReleaseOutputs();
+
+ // Reset the state...
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   PipelineStep & s = *step[i];
+   nat32 inputs = 0;
+   for (nat32 j=0;j<s.from.Size();j++)
+   {
+    if (s.from[j]!=unconnected) inputs += 1;
+   }
+   s.pending.Set(inputs);
+   for (nat32 j=0;j<s.Outputs();j++) s.refs[j].Set(s.uses[j]);
+   s.failed = false;
+   s.done = false;
+   s.time = 0.0;
+  }
+
+ // Start every step without inputs, which start the rest as they finish...
+  time::ProgressCounter counter(prog,step.Size());
+  mt::TaskGroup group;
+
+  PipelineTask * task = new PipelineTask[step.Size()];
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   task[i].pipe = this;
+   task[i].index = i;
+   task[i].all = task;
+   task[i].core = &core;
+   task[i].cache = cache;
+   task[i].prog = prog;
+   task[i].counter = &counter;
+   task[i].group = &group;
+  }
+
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   if (step[i]->pending.Get()==0) group.Add(&task[i]);
+  }
+  group.Wait();
+  delete[] task;
+
+ // A step that threw never handed on to the steps after it, so they never
+ // ran - count them as failed...
+  bit ret = true;
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   if (!step[i]->done) step[i]->failed = true;
+   if (step[i]->failed) ret = false;
+  }
+ return ret;
+}
+
+cstrconst Pipeline::StepName(nat32 i) const
+{
+ return step[i]->name;
+}
+
+bit Pipeline::StepFailed(nat32 i) const
+{
+ return step[i]->failed;
+}
+
+real32 Pipeline::StepTime(nat32 i) const
+{
+ return step[i]->time;
+}
+
+Node * Pipeline::Output(cstrconst stepName,cstrconst output) const
+{
+ nat32 i = FindStep(stepName);
+ if (i==step.Size()) return null<Node*>();
+ if ((!step[i]->keep)||(step[i]->failed)) return null<Node*>();
+
+ nat32 o = step[i]->FindOutput(str::String(output?output:""));
+ if (o==step[i]->Outputs()) return null<Node*>();
+ return step[i]->out[o];
+}
+
+const MetaAlgorithm * Pipeline::FindMeta(cstrconst name) const
+{
+ ds::List<const MetaAlgorithm*>::Cursor targ = meta.FrontPtr();
+ while (!targ.Bad())
+ {
+  if (str::Compare((*targ)->Name(),name)==0) return *targ;
+  ++targ;
+ }
+ return null<const MetaAlgorithm*>();
+}
+
+nat32 Pipeline::FindStep(cstrconst name) const
+{
+ for (nat32 i=0;i<step.Size();i++)
+ {
+  if (str::Compare(step[i]->name,name)==0) return i;
+ }
+ return step.Size();
+}
+
+void Pipeline::Clear()
+{
+ for (nat32 i=0;i<step.Size();i++) delete step[i];
+ step.Size(0);
+ mem::Free(error);
+ error = null<cstr>();
+}
+
+bit Pipeline::Fail(const str::String & msg)
+{
+ for (nat32 i=0;i<step.Size();i++) delete step[i];
+ step.Size(0);
+ mem::Free(error);
+ error = msg.ToStr();
+ return false;
+}
+
+void Pipeline::ReleaseOutputs()
+{
+ for (nat32 i=0;i<step.Size();i++)
+ {
+  for (nat32 j=0;j<step[i]->Outputs();j++)
+  {
+   delete step[i]->out[j];
+   step[i]->out[j] = null<Node*>();
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,153 @@
+#ifndef EOS_SVT_PIPELINE_H
+#define EOS_SVT_PIPELINE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file pipeline.h
+/// Provides an executor for graphs of Algorithm's, as described by an xml
+/// file, which runs every algorithm whose inputs are ready at the same time.
+/// This is the engine of aegle.
+
+#include "eos/types.h"
+#include "eos/svt/calculation.h"
+#include "eos/svt/plugins.h"
+#include "eos/svt/cache.h"
+#include "eos/bs/dom.h"
+#include "eos/ds/arrays.h"
+#include "eos/ds/lists.h"
+#include "eos/str/strings.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+// Predeclaration of the internals of Pipeline...
+class PipelineStep;
+
+//------------------------------------------------------------------------------
+/// A directed acyclic graph of steps, each of which is either the loading of
+/// an svt file or the running of an Algorithm. Loaded from xml, as the children
+/// of the root element in any order:
+/// \code
+/// <load name="left" file="left.svt"/>
+/// <run name="disp" alg="stereo.sgm" keep="false">
+///  <input name="left" from="left"/>
+///  <input name="right" from="rect" output="right"/>
+///  <save output="disp" file="disp.svt"/>
+///  ...anything else, for Algorithm::Configure...
+/// </run>
+/// \endcode
+/// Step names must be unique. An input names the step it comes from, plus the
+/// output of that step, which can be omitted if it only has one. A load step
+/// has the one output, the loaded file. Inputs the algorithm marks as optional
+/// can be left unconnected. Any output can be saved, and a step marked keep has
+/// its outputs held after the run for Output() to return.
+///
+/// Run hands every step whose inputs are available to the task pool, so
+/// independent branches run at the same time, and as each step finishes it
+/// hands on any steps that were only waiting for it. An output is deleted as
+/// soon as the last step that uses it has finished, unless kept, so only the
+/// results on the frontier are in memory at once. Given a Cache each algorithm
+/// is run through RunCached, so a rerun only does the steps whose inputs or
+/// parameters have changed, as far as the algorithms support it.
+class EOS_CLASS Pipeline
+{
+ public:
+  /// &nbsp;
+   Pipeline();
+
+  /// &nbsp;
+   ~Pipeline();
+
+
+  /// Adds an algorithm that steps can use, by its Name(). The caller keeps
+  /// ownership, and it must outlive the Pipeline.
+   void Register(const MetaAlgorithm & meta);
+
+  /// Adds all the algorithms of a plugin registry, as above.
+   void Register(const Plugins & plugins);
+
+
+  /// Builds the graph from the given element, replacing any previous one.
+  /// Returns false on a bad description, such as an unknown algorithm, a
+  /// duplicate step name, an input or output that does not exist, a missing
+  /// required input or a cycle, with a description in Error(). GoodDom of each
+  /// algorithm is checked as well. Nothing is run or loaded.
+   bit Load(const bs::Element & root);
+
+  /// As above, but loads the xml from the given file first.
+   bit Load(str::TokenTable & tt,cstrconst fn);
+
+
+  /// Runs the graph, returning true if every step succeeded. A step fails if
+  /// its file will not load, its algorithm does not set a non-optional output,
+  /// it throws or a save fails; steps that depend on a failed step are skipped
+  /// and count as failed too, but everything else is still run. The progress
+  /// is the fraction of steps done, cancelling it skips the steps that have not
+  /// yet started. Outputs kept from a previous run are deleted first.
+   bit Run(Core & core,Cache * cache = null<Cache*>(),time::Progress * prog = null<time::Progress*>());
+
+
+  /// Returns the error of the last Load, an empty string if it succeeded.
+   cstrconst Error() const {return error?error:"";}
+
+  /// Returns how many steps there are.
+   nat32 Steps() const {return step.Size();}
+
+  /// Returns the name of a step, in the order they appeared in the xml.
+   cstrconst StepName(nat32 i) const;
+
+  /// Returns true if the given step failed, or was skipped, in the last Run.
+   bit StepFailed(nat32 i) const;
+
+  /// Returns how long the given step took in the last Run, in seconds.
+   real32 StepTime(nat32 i) const;
+
+
+  /// Returns an output of a step marked keep, null if there is no such step or
+  /// output, it was not kept or it failed. The output is named as for an
+  /// input, so can be omitted if the step has only one. The Pipeline owns the
+  /// returned node, it lasts until the next Run or Load.
+   Node * Output(cstrconst stepName,cstrconst output = null<cstrconst>()) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::svt::Pipeline";}
+
+
+ private:
+  friend class PipelineTask;
+
+  ds::List<const MetaAlgorithm*> meta;
+  ds::Array<PipelineStep*> step; // In xml order.
+  cstr error; // null if there isn't one.
+
+  // Helpers...
+   const MetaAlgorithm * FindMeta(cstrconst name) const;
+   nat32 FindStep(cstrconst name) const; // Returns step.Size() if not found.
+   void Clear();
+   bit Fail(const str::String & msg); // Sets error, returns false.
+   void ReleaseOutputs();
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -0,0 +1,589 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/svt/plugins.h"
+
+#include "eos/mem/alloc.h"
+#include "eos/str/functions.h"
+#include "eos/math/functions.h"
+#include "eos/file/files.h"
+#include "eos/io/to_virt.h"
+#include "eos/data/checksums.h"
+#include "eos/mt/locks.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+// Identifies an index file, and its version...
+static const nat32 pluginMagic = 0x50494E31; // "PIN1"
+
+// The file handles used for the index...
+typedef io::VirtIn<file::Cursor<io::Binary> > IndexIn;
+typedef io::VirtOut<file::Cursor<io::Binary> > IndexOut;
+
+// Strings are stored with their length in front...
+static cstr ReadStr(IndexIn & in,bit & ok)
+{
+ nat32 length = 0;
+ if (in.Read(&length,sizeof(nat32))!=sizeof(nat32)) {ok = false; length = 0;}
+ if (length>0x00FFFFFF) {ok = false; length = 0;}
+ cstr ret = mem::Malloc<cstrchar>(length+1);
+ if (in.Read(ret,length)!=length) ok = false;
+ ret[length] = 0;
+ return ret;
+}
+
+static bit WriteStr(IndexOut & out,cstrconst s)
+{
+ nat32 length = str::Length(s);
+ return (out.Write(&length,sizeof(nat32))==sizeof(nat32)) && (out.Write(s,length)==length);
+}
+
+//------------------------------------------------------------------------------
+// A plugin module, loaded only on demand...
+class PluginModule
+{
+ public:
+  PluginModule():fn(null<cstr>()),leaf(null<cstr>()),size(0),time(0),hash(0),loaded(false),reals(0) {}
+
+  ~PluginModule()
+  {
+   for (nat32 i=0;i<reals;i++) delete real[i];
+   dll.Unload();
+   mem::Free(fn);
+   mem::Free(leaf);
+  }
+
+  cstr fn; // Full path.
+  cstr leaf; // Filename only, as stored in the index.
+  nat64 size;
+  nat64 time;
+  nat64 hash;
+
+  // Loads the module, if it hasn't been allready. Returns false if it can't
+  // be loaded...
+   bit Load()
+   {
+    mt::AutoLock al(lock);
+    if (loaded) return dll.Active();
+    loaded = true;
+
+    LogDebug("[svt::Plugins] Loading plugin module {fn}" << LogDiv() << fn);
+    dll.LoadPath(fn,true);
+    if (!dll.Active()) return false;
+
+    PluginEntry entry = (PluginEntry)dll.Get("EosAlgorithm");
+    if (entry==null<PluginEntry>()) {dll.Unload(); return false;}
+
+    while (true)
+    {
+     MetaAlgorithm * ma = entry(reals);
+     if (ma==null<MetaAlgorithm*>()) break;
+     if (reals==real.Size()) real.Size(math::Max<nat32>(2*reals,8));
+     real[reals++] = ma;
+    }
+    return true;
+   }
+
+  // Returns the real version of an algorithm, loading if need be, null on
+  // failure...
+   MetaAlgorithm * Real(cstrconst name)
+   {
+    if (!Load()) return null<MetaAlgorithm*>();
+    for (nat32 i=0;i<reals;i++)
+    {
+     if (str::Compare(real[i]->Name(),name)==0) return real[i];
+    }
+    return null<MetaAlgorithm*>();
+   }
+
+  // Returns true if it has been loaded...
+   bit Loaded() const {return loaded;}
+
+  // Allows the real algorithms to be looked at, after a Load...
+   nat32 Reals() const {return reals;}
+   const MetaAlgorithm & RealAt(nat32 i) const {return *real[i];}
+
+
+ private:
+  file::Dll dll;
+  mt::OwnedLock lock;
+  bit loaded;
+  ds::Array<MetaAlgorithm*> real;
+  nat32 reals;
+};
+
+//------------------------------------------------------------------------------
+// A stand in for an algorithm in a plugin module, which holds its descriptions
+// and only loads the module when they are not enough...
+class PluginAlgorithm : public MetaAlgorithm
+{
+ public:
+  struct Port
+  {
+   cstr name;
+   cstr help;
+   bit optional;
+  };
+
+
+  // Creates an empty one, to be filled by Read...
+   PluginAlgorithm(PluginModule * m)
+   :mod(m),name(null<cstr>()),help(null<cstr>()),inputs(0),outputs(0)
+   {}
+
+  // Creates one that copys its descriptions from the real algorithm...
+   PluginAlgorithm(PluginModule * m,const MetaAlgorithm & ma)
+   :mod(m),name(str::Duplicate(ma.Name())),help(str::Duplicate(ma.Help())),
+   inputs(ma.Inputs()),outputs(ma.Outputs())
+   {
+    in.Size(inputs);
+    for (nat32 i=0;i<inputs;i++)
+    {
+     in[i].name = str::Duplicate(ma.InputName(i));
+     in[i].help = str::Duplicate(ma.InputHelp(i));
+     in[i].optional = ma.InputOptional(i);
+    }
+
+    out.Size(outputs);
+    for (nat32 i=0;i<outputs;i++)
+    {
+     out[i].name = str::Duplicate(ma.OutputName(i));
+     out[i].help = str::Duplicate(ma.OutputHelp(i));
+     out[i].optional = ma.OutputOptional(i);
+    }
+   }
+
+  ~PluginAlgorithm()
+  {
+   mem::Free(name);
+   mem::Free(help);
+   for (nat32 i=0;i<in.Size();i++) {mem::Free(in[i].name); mem::Free(in[i].help);}
+   for (nat32 i=0;i<out.Size();i++) {mem::Free(out[i].name); mem::Free(out[i].help);}
+  }
+
+
+  // Index io...
+   bit Read(IndexIn & input)
+   {
+    bit ok = true;
+    name = ReadStr(input,ok);
+    help = ReadStr(input,ok);
+
+    nat32 count[2];
+    if (input.Read(count,sizeof(count))!=sizeof(count)) return false;
+    if ((count[0]>0xFFFF)||(count[1]>0xFFFF)) return false;
+    inputs = count[0];
+    outputs = count[1];
+
+    in.Size(inputs);
+    for (nat32 i=0;i<inputs;i++) {in[i].name = null<cstr>(); in[i].help = null<cstr>();}
+    out.Size(outputs);
+    for (nat32 i=0;i<outputs;i++) {out[i].name = null<cstr>(); out[i].help = null<cstr>();}
+
+    for (nat32 i=0;ok&&(i<inputs+outputs);i++)
+    {
+     Port & targ = (i<inputs)?in[i]:out[i-inputs];
+     targ.name = ReadStr(input,ok);
+     targ.help = ReadStr(input,ok);
+     byte opt = 0;
+     ok = ok && (input.Read(&opt,1)==1);
+     targ.optional = opt!=0;
+    }
+    return ok;
+   }
+
+   bit Write(IndexOut & output) const
+   {
+    bit ok = WriteStr(output,name) && WriteStr(output,help);
+
+    nat32 count[2];
+    count[0] = inputs;
+    count[1] = outputs;
+    ok = ok && (output.Write(count,sizeof(count))==sizeof(count));
+
+    for (nat32 i=0;ok&&(i<inputs+outputs);i++)
+    {
+     const Port & targ = (i<inputs)?in[i]:out[i-inputs];
+     byte opt = targ.optional?1:0;
+     ok = WriteStr(output,targ.name) && WriteStr(output,targ.help) && (output.Write(&opt,1)==1);
+    }
+    return ok;
+   }
+
+
+  // The module it belongs to...
+   PluginModule * Module() const {return mod;}
+   void SetModule(PluginModule * m) {mod = m;}
+
+
+  // The MetaAlgorithm interface, answered without loading where possible...
+   Algorithm * Make() const
+   {
+    MetaAlgorithm * ma = mod->Real(name);
+    return ma?ma->Make():null<Algorithm*>();
+   }
+
+   cstrconst Name() const {return name;}
+   cstrconst Help() const {return help;}
+
+   nat32 Inputs() const {return inputs;}
+   cstrconst InputName(nat32 input) const {return in[input].name;}
+   bit InputOptional(nat32 input) const {return in[input].optional;}
+   cstrconst InputHelp(nat32 input) const {return in[input].help;}
+   const Type * InputType(nat32 input) const
+   {
+    MetaAlgorithm * ma = mod->Real(name);
+    return ma?ma->InputType(input):null<const Type*>();
+   }
+
+   nat32 Outputs() const {return outputs;}
+   cstrconst OutputName(nat32 output) const {return out[output].name;}
+   bit OutputOptional(nat32 output) const {return out[output].optional;}
+   cstrconst OutputHelp(nat32 output) const {return out[output].help;}
+   const Type * OutputType(nat32 output) const
+   {
+    MetaAlgorithm * ma = mod->Real(name);
+    return ma?ma->OutputType(output):null<const Type*>();
+   }
+
+   bit GoodDom(bs::Element * elem) const
+   {
+    MetaAlgorithm * ma = mod->Real(name);
+    return ma?ma->GoodDom(elem):false;
+   }
+
+   cstrconst TypeString() const {return "eos::svt::PluginAlgorithm";}
+
+
+ private:
+  PluginModule * mod;
+  cstr name;
+  cstr help;
+  nat32 inputs;
+  nat32 outputs;
+  ds::Array<Port> in;
+  ds::Array<Port> out;
+};
+
+//------------------------------------------------------------------------------
+// For sorting algorithms by name...
+struct PluginRef
+{
+ PluginAlgorithm * pa;
+
+ bit operator < (const PluginRef & rhs) const {return str::Compare(pa->Name(),rhs.pa->Name())<0;}
+};
+
+// A module as found in the index, with its algorithms...
+struct IndexModule
+{
+ IndexModule():mod(null<PluginModule*>()),algs(0) {}
+ ~IndexModule()
+ {
+  for (nat32 i=0;i<algs;i++) delete alg[i];
+  delete mod;
+ }
+
+ PluginModule * mod;
+ ds::Array<PluginAlgorithm*> alg;
+ nat32 algs;
+};
+
+//------------------------------------------------------------------------------
+Plugins::Plugins()
+{}
+
+Plugins::~Plugins()
+{
+ for (nat32 i=0;i<alg.Size();i++) delete alg[i];
+ for (nat32 i=0;i<module.Size();i++) delete module[i];
+}
+
+nat32 Plugins::AddDir(const file::Dir & dir,cstrconst index,time::Progress * prog)
+{
+ LogTime("eos::svt::Plugins::AddDir");
+ prog->Push();
+
+ // The path of the directory, with a trailing '/'...
+  str::String path(dir.RealPath());
+  {
+   cstr p = path.ToStr();
+   nat32 pLength = str::Length(p);
+   if ((pLength==0)||(p[pLength-1]!='/')) path << "/";
+   mem::Free(p);
+  }
+
+  str::String indexPath(path);
+  indexPath << index;
+  cstr indexFn = indexPath.ToStr();
+
+ // Load the index, if there is one...
+  IndexModule * old = null<IndexModule*>();
+  nat32 olds = 0;
+  {
+   file::File<io::Binary> f(indexFn,file::way_edit,file::mode_read);
+   if (f.Active())
+   {
+    file::Cursor<io::Binary> cursor = f.GetCursor();
+    IndexIn in(cursor);
+
+    nat32 head[2];
+    if ((in.Read(head,sizeof(head))==sizeof(head))&&(head[0]==pluginMagic)&&(head[1]<0x00FFFFFF))
+    {
+     olds = head[1];
+     old = new IndexModule[olds];
+     bit ok = true;
+     for (nat32 i=0;ok&&(i<olds);i++)
+     {
+      IndexModule & targ = old[i];
+      targ.mod = new PluginModule();
+      targ.mod->leaf = ReadStr(in,ok);
+
+      nat64 info[3];
+      nat32 count = 0;
+      ok = ok && (in.Read(info,sizeof(info))==sizeof(info)) && (in.Read(&count,sizeof(nat32))==sizeof(nat32));
+      ok = ok && (count<0xFFFF);
+      if (!ok) break;
+      targ.mod->size = info[0];
+      targ.mod->time = info[1];
+      targ.mod->hash = info[2];
+
+      targ.alg.Size(count);
+      for (nat32 j=0;j<count;j++)
+      {
+       targ.alg[j] = new PluginAlgorithm(targ.mod);
+       ++targ.algs;
+       if (!targ.alg[j]->Read(in)) {ok = false; break;}
+      }
+     }
+
+     if (!ok)
+     {
+      LogDebug("[svt::Plugins] Ignoring corrupt plugin index {fn}" << LogDiv() << indexFn);
+      delete[] old;
+      old = null<IndexModule*>();
+      olds = 0;
+     }
+    }
+   }
+  }
+
+ // Find the modules...
+  ds::List<cstr,mem::KillFree<char> > found;
+  {
+   file::Dir d(dir);
+   #ifdef EOS_WIN32
+    d.Children(found,"*.dll",file::TypeFile);
+   #else
+    d.Children(found,"*.so",file::TypeFile);
+   #endif
+  }
+
+ // Go through them, taking their details from the index where possible, and
+ // loading them to get their details where not...
+  bit changed = false;
+  nat32 added = 0;
+  nat32 first = module.Size();
+  nat32 step = 0;
+  ds::List<cstr,mem::KillFree<char> >::Cursor targ = found.FrontPtr();
+  while (!targ.Bad())
+  {
+   prog->Report(step++,found.Size());
+
+   str::String fullPath(path);
+   fullPath << *targ;
+   cstr fn = fullPath.ToStr();
+
+   struct stat info;
+   if (stat(fn,&info)!=0) {mem::Free(fn); ++targ; continue;}
+
+   // Look for it in the index...
+    IndexModule * im = null<IndexModule*>();
+    for (nat32 i=0;i<olds;i++)
+    {
+     if (old[i].mod&&(str::Compare(old[i].mod->leaf,*targ)==0)) {im = &old[i]; break;}
+    }
+
+   // Decide if the index is current, hashing if the size or time has changed...
+    bit current = false;
+    nat64 hash = 0;
+    if (im&&(im->mod->size==nat64(info.st_size))&&(im->mod->time==nat64(info.st_mtime)))
+    {
+     current = true;
+     hash = im->mod->hash;
+    }
+    else
+    {
+     changed = true;
+     file::FileMap map(fn,false);
+     if (map.Active()) hash = data::TreeHash(map.Ptr(),map.Size());
+     if (im&&(im->mod->hash==hash)) current = true;
+    }
+
+   // Move it into the registry...
+    if (current)
+    {
+     PluginModule * mod = im->mod;
+     im->mod = null<PluginModule*>();
+     mod->fn = fn;
+     mod->size = info.st_size;
+     mod->time = info.st_mtime;
+
+     nat32 base = module.Size();
+     module.Size(base+1);
+     module[base] = mod;
+
+     base = alg.Size();
+     alg.Size(base+im->algs);
+     for (nat32 i=0;i<im->algs;i++) alg[base+i] = im->alg[i];
+     added += im->algs;
+     im->algs = 0;
+    }
+    else
+    {
+     PluginModule * mod = new PluginModule();
+     mod->fn = fn;
+     mod->leaf = str::Duplicate(*targ);
+     mod->size = info.st_size;
+     mod->time = info.st_mtime;
+     mod->hash = hash;
+
+     nat32 base = module.Size();
+     module.Size(base+1);
+     module[base] = mod;
+
+     if (mod->Load())
+     {
+      base = alg.Size();
+      alg.Size(base+mod->Reals());
+      for (nat32 i=0;i<mod->Reals();i++) alg[base+i] = new PluginAlgorithm(mod,mod->RealAt(i));
+      added += mod->Reals();
+     }
+     else LogDebug("[svt::Plugins] Failed to load plugin module {fn}" << LogDiv() << fn);
+    }
+
+   ++targ;
+  }
+
+ // Anything left in the index has been removed...
+  for (nat32 i=0;i<olds;i++)
+  {
+   if (old[i].mod) changed = true;
+  }
+  delete[] old;
+
+ // Sort the algorithms by name...
+  {
+   ds::Array<PluginRef> order(alg.Size());
+   for (nat32 i=0;i<alg.Size();i++) order[i].pa = alg[i];
+   order.SortNorm();
+   for (nat32 i=0;i<alg.Size();i++) alg[i] = order[i].pa;
+  }
+
+ // Rewrite the index if it has changed, covering the modules of this
+ // directory, which are those added above...
+  if (changed)
+  {
+   file::File<io::Binary> f(indexFn,file::way_ow,file::mode_write);
+   if (f.Active())
+   {
+    file::Cursor<io::Binary> cursor = f.GetCursor();
+    IndexOut out(cursor);
+
+    nat32 head[2];
+    head[0] = pluginMagic;
+    head[1] = module.Size() - first;
+    bit ok = out.Write(head,sizeof(head))==sizeof(head);
+
+    for (nat32 i=first;ok&&(i<module.Size());i++)
+    {
+     PluginModule * mod = module[i];
+
+     nat32 count = 0;
+     for (nat32 j=0;j<alg.Size();j++)
+     {
+      if (alg[j]->Module()==mod) ++count;
+     }
+
+     nat64 info[3];
+     info[0] = mod->size;
+     info[1] = mod->time;
+     info[2] = mod->hash;
+     ok = WriteStr(out,mod->leaf) &&
+          (out.Write(info,sizeof(info))==sizeof(info)) &&
+          (out.Write(&count,sizeof(nat32))==sizeof(nat32));
+
+     for (nat32 j=0;ok&&(j<alg.Size());j++)
+     {
+      if (alg[j]->Module()==mod) ok = alg[j]->Write(out);
+     }
+    }
+
+    if (!ok) LogDebug("[svt::Plugins] Failed to write plugin index {fn}" << LogDiv() << indexFn);
+   }
+  }
+
+ mem::Free(indexFn);
+ prog->Pop();
+ return added;
+}
+
+const MetaAlgorithm & Plugins::operator[] (nat32 i) const
+{
+ return *alg[i];
+}
+
+const MetaAlgorithm * Plugins::Find(cstrconst name) const
+{
+ nat32 low = 0;
+ nat32 high = alg.Size();
+ while (low<high)
+ {
+  nat32 mid = (low+high)/2;
+  int32 c = str::Compare(alg[mid]->Name(),name);
+  if (c==0) return alg[mid];
+  if (c<0) low = mid+1;
+      else high = mid;
+ }
+ return null<const MetaAlgorithm*>();
+}
+
+Algorithm * Plugins::Make(cstrconst name) const
+{
+ const MetaAlgorithm * ma = Find(name);
+ return ma?ma->Make():null<Algorithm*>();
+}
+
+nat32 Plugins::Loaded() const
+{
+ nat32 ret = 0;
+ for (nat32 i=0;i<module.Size();i++)
+ {
+  if (module[i]->Loaded()) ++ret;
+ }
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
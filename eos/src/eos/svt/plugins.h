@@ -0,0 +1,112 @@
+#ifndef EOS_SVT_PLUGINS_H
+#define EOS_SVT_PLUGINS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file plugins.h
+/// Provides a registry of the algorithms in plugin modules, that only loads a
+/// module when one of its algorithms is actually used.
+
+#include "eos/types.h"
+#include "eos/svt/calculation.h"
+#include "eos/file/dirs.h"
+#include "eos/file/dlls.h"
+#include "eos/ds/arrays.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+// Predeclarations of the internals of Plugins...
+class PluginModule;
+class PluginAlgorithm;
+
+//------------------------------------------------------------------------------
+/// The function a plugin module must export, as extern "C" under the name
+/// EosAlgorithm. Returns a new MetaAlgorithm for each index from 0 upwards, and
+/// null once past the last. The caller owns the returned objects.
+typedef MetaAlgorithm * (*PluginEntry)(nat32 index);
+
+//------------------------------------------------------------------------------
+/// A registry of the algorithms in a set of plugin modules. Adding a directory
+/// finds its modules, but rather than loading each to ask it what it contains
+/// the descriptions are taken from an index file kept in the directory, which
+/// records the size, modification time and a Hash64 of every module. Only a
+/// module that is new or whose size or time has changed is hashed, and only
+/// one whose hash has changed is loaded, so adding a directory of unchanged
+/// modules loads none of them.
+///
+/// The registry hands out MetaAlgorithm's that answer name, help and input and
+/// output details from the index. The module is loaded, with delayed symbol
+/// resolution, the first time something needs it - Make, the Type methods or
+/// GoodDom. A module stays loaded until the registry is deleted, which must
+/// not happen before the algorithms made from it are.
+class EOS_CLASS Plugins
+{
+ public:
+  /// &nbsp;
+   Plugins();
+
+  /// Deletes all the MetaAlgorithm's, then unloads the modules.
+   ~Plugins();
+
+
+  /// Adds every module in the given directory, i.e. every file ending .so, or
+  /// .dll under windows. The index file is read from the directory and
+  /// rewritten if it had to be updated; failing to write it is harmless.
+  /// Returns how many algorithms were added.
+   nat32 AddDir(const file::Dir & dir,cstrconst index = "plugins.index",time::Progress * prog = null<time::Progress*>());
+
+
+  /// Returns how many algorithms there are.
+   nat32 Size() const {return alg.Size();}
+
+  /// Returns an algorithm, the registry owns it.
+   const MetaAlgorithm & operator[] (nat32 i) const;
+
+  /// Returns the algorithm with the given name, or null if there is none.
+   const MetaAlgorithm * Find(cstrconst name) const;
+
+  /// Makes an instance of the algorithm with the given name, null if there is
+  /// no such algorithm or its module fails to load.
+   Algorithm * Make(cstrconst name) const;
+
+
+  /// Returns how many modules there are.
+   nat32 Modules() const {return module.Size();}
+
+  /// Returns how many modules have been loaded, either to update the index or
+  /// because an algorithm in them was used.
+   nat32 Loaded() const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::svt::Plugins";}
+
+
+ private:
+  ds::Array<PluginModule*> module;
+  ds::Array<PluginAlgorithm*> alg; // Sorted by name.
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -0,0 +1,948 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/svt/remote.h"
+
+#include "eos/svt/file.h"
+#include "eos/svt/var.h"
+#include "eos/os/sockets.h"
+#include "eos/file/xml.h"
+#include "eos/mt/threads.h"
+#include "eos/time/times.h"
+#include "eos/math/functions.h"
+#include "eos/str/strings.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+// The protocol. Every message is a header followed by size bytes of payload:
+// - job: the algorithm name, its xml, the input count then the inputs.
+// - result: the seconds spent computing and packing, the output count then
+//   the outputs.
+// - failed: the seconds spent computing and packing.
+// - alive: nothing, sent every second whilst a job runs.
+// Strings are a nat32 length then the characters, nodes a nat64 length then an
+// svt file, with a length of 0 for null. Everything is in the byte order of
+// the machine, as all the supported platforms are little endian...
+static const nat32 remoteMagic = 0x494C4548; // "HELI"
+static const nat32 remoteJob = 1;
+static const nat32 remoteResult = 2;
+static const nat32 remoteFailed = 3;
+static const nat32 remoteAlive = 4;
+
+// Largest message body accepted, a header claiming more is taken as garbage and
+// the connection dropped rather than allocating whatever it asks for...
+static const nat64 remoteMaxSize = nat64(1)<<30;
+
+struct RemoteHeader
+{
+ nat32 magic;
+ nat32 type;
+ nat64 size;
+};
+
+// Compressed svt data is written via a flag in the Core, so only one thread
+// can be packing at once...
+static mt::OwnedLock remotePack;
+
+//------------------------------------------------------------------------------
+// A message being built in memory...
+class RemoteOut : public io::OutVirt<io::Binary>
+{
+ public:
+  RemoteOut():data(null<byte*>()),size(0),capacity(0) {}
+  ~RemoteOut() {mem::Free(data);}
+
+  nat32 Write(const void * in,nat32 bytes)
+  {
+   Reserve(size+bytes);
+   mem::Copy(data+size,(const byte*)in,bytes);
+   size += bytes;
+   return bytes;
+  }
+
+  nat32 Pad(nat32 bytes)
+  {
+   Reserve(size+bytes);
+   mem::Null(data+size,bytes);
+   size += bytes;
+   return bytes;
+  }
+
+  void Put(cstrconst s,nat32 length)
+  {
+   Write(&length,sizeof(nat32));
+   Write(s,length);
+  }
+
+  // Writes a node, compressed, returns false on failure. Must be called with
+  // remotePack locked...
+   bit Put(Node * node)
+   {
+    nat64 start = size;
+    nat64 length = 0;
+    Write(&length,sizeof(nat64));
+    if (node==null<Node*>()) return true;
+
+    if (!svt::Write(*this,node,true)) return false;
+    length = size - start - sizeof(nat64);
+    mem::Copy(data+start,(byte*)&length,sizeof(nat64));
+    return true;
+   }
+
+  const byte * Data() const {return data;}
+  nat64 Size() const {return size;}
+
+  cstrconst TypeString() const {return "eos::svt::RemoteOut";}
+
+
+ private:
+  byte * data;
+  nat64 size;
+  nat64 capacity;
+
+  void Reserve(nat64 s)
+  {
+   if (s<=capacity) return;
+   capacity = math::Max<nat64>(s,capacity*2+4096);
+   byte * nd = mem::Malloc<byte>(capacity);
+   mem::Copy(nd,data,size);
+   mem::Free(data);
+   data = nd;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Reads a message held in memory...
+class RemoteIn : public io::InVirt<io::Binary>
+{
+ public:
+  RemoteIn(const byte * d,nat64 s):data(d),size(s),pos(0) {}
+  ~RemoteIn() {}
+
+  bit EOS() const {return pos>=size;}
+  nat32 Avaliable() const {return nat32(math::Min<nat64>(size-pos,0xFFFFFFFF));}
+
+  nat32 Read(void * out,nat32 bytes)
+  {
+   nat32 ret = Peek(out,bytes);
+   pos += ret;
+   return ret;
+  }
+
+  nat32 Peek(void * out,nat32 bytes) const
+  {
+   nat32 ret = nat32(math::Min<nat64>(bytes,size-pos));
+   mem::Copy((byte*)out,data+pos,ret);
+   return ret;
+  }
+
+  nat32 Skip(nat32 bytes)
+  {
+   nat32 ret = nat32(math::Min<nat64>(bytes,size-pos));
+   pos += ret;
+   return ret;
+  }
+
+  // Gets a string, returning a pointer into the message, null on error...
+   cstrconst Get(nat32 & length)
+   {
+    if (Read(&length,sizeof(nat32))!=sizeof(nat32)) return null<cstrconst>();
+    if (length>size-pos) return null<cstrconst>();
+    cstrconst ret = (cstrconst)(data+pos);
+    pos += length;
+    return ret;
+   }
+
+  // Gets a node, returns false on error, with node set to null if a null was
+  // sent...
+   bit Get(Core & core,Node *& node)
+   {
+    node = null<Node*>();
+    nat64 length;
+    if (Read(&length,sizeof(nat64))!=sizeof(nat64)) return false;
+    if (length==0) return true;
+    if (length>size-pos) return false;
+
+    RemoteIn sub(data+pos,length);
+    node = svt::Read(core,sub);
+    pos += length;
+    return node!=null<Node*>();
+   }
+
+  cstrconst TypeString() const {return "eos::svt::RemoteIn";}
+
+
+ private:
+  const byte * data;
+  nat64 size;
+  nat64 pos;
+};
+
+//------------------------------------------------------------------------------
+// Sends a message, body can be null for an empty one...
+static bit SendMsg(os::Socket & sock,nat32 type,const RemoteOut * body)
+{
+ RemoteHeader head;
+ head.magic = remoteMagic;
+ head.type = type;
+ head.size = body?body->Size():0;
+
+ if (!sock.Send(&head,sizeof(head))) return false;
+ return (body==null<const RemoteOut*>())||sock.Send(body->Data(),body->Size());
+}
+
+// Receives a message, skipping heartbeats. On success data must be mem::Free-d...
+static bit RecvMsg(os::Socket & sock,nat32 & type,byte *& data,nat64 & size)
+{
+ data = null<byte*>();
+ while (true)
+ {
+  RemoteHeader head;
+  if (!sock.Recv(&head,sizeof(head))) return false;
+  if (head.magic!=remoteMagic) {sock.Close(); return false;}
+  if ((head.type==remoteAlive)&&(head.size==0)) continue;
+  if (head.size>remoteMaxSize) {sock.Close(); return false;}
+
+  type = head.type;
+  size = head.size;
+  data = mem::Malloc<byte>(math::Max<nat64>(size,1));
+  if (!sock.Recv(data,size))
+  {
+   mem::Free(data);
+   data = null<byte*>();
+   return false;
+  }
+  return true;
+ }
+}
+
+//------------------------------------------------------------------------------
+// Helpers for splitting into bands and stitching back together...
+
+// Returns true if the node is a 2D Var with the given number of rows, any
+// number if rows is 0...
+static bit IsRows(Node * node,nat32 rows)
+{
+ if (node==null<Node*>()) return false;
+ if (str::Compare(typestring(*node),"eos::svt::Var")!=0) return false;
+ Var * var = static_cast<Var*>(node);
+ return (var->Dims()==2)&&((rows==0)||(var->Size(1)==rows));
+}
+
+// Makes a 2D Var with the same fields as another, of the given size...
+static Var * MakeLike(Core & core,Var * like,nat32 width,nat32 height)
+{
+ Var * ret = new Var(core);
+ ret->Setup2D(width,height);
+ for (nat32 f=0;f<like->Fields();f++)
+ {
+  ret->Add(like->FieldName(f),like->FieldType(f),like->FieldSize(f),like->FieldDef(f));
+ }
+ ret->Commit(false);
+ return ret;
+}
+
+// Copies rows between Var's with the same fields and width...
+static void CopyRows(Var * from,nat32 fromRow,Var * to,nat32 toRow,nat32 rows)
+{
+ for (nat32 f=0;f<to->Fields();f++)
+ {
+  nat32 ff;
+  if (!from->GetIndex(to->FieldName(f),ff)) continue;
+  nat32 size = to->FieldSize(f);
+  for (nat32 y=0;y<rows;y++)
+  {
+   for (nat32 x=0;x<to->Size(0);x++)
+   {
+    mem::Copy((byte*)to->Ptr(f,x,toRow+y),(const byte*)from->Ptr(ff,x,fromRow+y),size);
+   }
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+// Runs the algorithm of a connection in a thread of its own, so the connection
+// can keep sending heartbeats...
+class RemoteCompute : public mt::Thread
+{
+ public:
+  RemoteCompute(Algorithm * a):alg(a) {}
+
+  void Execute()
+  {
+   alg->Run(&prog);
+   done.Set(1);
+  }
+
+  Algorithm * alg;
+  time::Progress prog;
+  mt::Atomic done;
+};
+
+//------------------------------------------------------------------------------
+// Handles a single connection to a RemoteServer...
+class RemoteConnection : public mt::Thread
+{
+ public:
+  RemoteConnection(RemoteServer & s,os::Socket * so):server(s),sock(so) {}
+  ~RemoteConnection() {delete sock;}
+
+  void Execute()
+  {
+   if (Handle()) server.jobs.Inc();
+            else server.failures.Inc();
+   finished.Set(1);
+  }
+
+  mt::Atomic finished;
+
+
+ private:
+  RemoteServer & server;
+  os::Socket * sock;
+
+  // Does the job, returns true on success...
+   bit Handle();
+};
+
+bit RemoteConnection::Handle()
+{
+ nat32 type;
+ byte * data;
+ nat64 size;
+ if (!RecvMsg(*sock,type,data,size)) return false;
+ if (type!=remoteJob) {mem::Free(data); return false;}
+
+ real64 packStart = time::UltraTime();
+ real64 compute = 0.0;
+
+ // Unpack...
+  RemoteIn in(data,size);
+  const MetaAlgorithm * ma = null<const MetaAlgorithm*>();
+  {
+   nat32 length;
+   cstrconst name = in.Get(length);
+   if (name)
+   {
+    cstr n = mem::Malloc<cstrchar>(length+1);
+    mem::Copy(n,name,length);
+    n[length] = 0;
+    ma = server.FindMeta(n);
+    mem::Free(n);
+   }
+  }
+
+  bs::Element * params = null<bs::Element*>();
+  {
+   nat32 length;
+   cstrconst xml = in.Get(length);
+   if (xml&&(length!=0)) params = file::LoadXML(server.core.GetTT(),xml,length);
+  }
+
+  nat32 inputs = 0;
+  in.Read(&inputs,sizeof(nat32));
+  bit ok = (ma!=null<const MetaAlgorithm*>())&&(inputs==ma->Inputs());
+
+  ds::Array<Node*> input(ok?inputs:0);
+  for (nat32 i=0;i<input.Size();i++) input[i] = null<Node*>();
+  for (nat32 i=0;ok&&(i<input.Size());i++) ok = in.Get(server.core,input[i]);
+
+  mem::Free(data);
+
+ // Run, sending a heartbeat every second. If the other end goes away the
+ // algorithm is cancelled...
+  RemoteOut out;
+  real64 pack = time::UltraTime() - packStart;
+
+  if (ok)
+  {
+   Algorithm * alg = ma->Make();
+   if (alg)
+   {
+    if (params) alg->Configure(*params);
+    for (nat32 i=0;i<input.Size();i++) alg->SetInput(i,input[i]);
+
+    real64 computeStart = time::UltraTime();
+    RemoteCompute comp(alg);
+    comp.Run();
+    real64 lastBeat = computeStart;
+    while (comp.done.Get()==0)
+    {
+     mt::Sleep(50);
+     real64 now = time::UltraTime();
+     if (now-lastBeat>=1.0)
+     {
+      lastBeat = now;
+      if ((!SendMsg(*sock,remoteAlive,null<const RemoteOut*>()))&&(!comp.prog.Cancelled())) comp.prog.Cancel();
+     }
+    }
+    comp.Wait();
+    compute = time::UltraTime() - computeStart;
+    if (comp.prog.Cancelled()) ok = false;
+
+   // Pack the outputs...
+    packStart = time::UltraTime();
+    out.Write(&compute,sizeof(real64));
+    out.Write(&pack,sizeof(real64)); // Overwritten below, once known.
+    nat32 outputs = ma->Outputs();
+    out.Write(&outputs,sizeof(nat32));
+
+    remotePack.Lock();
+     for (nat32 i=0;i<outputs;i++)
+     {
+      Node * node = alg->GetOutput(i);
+      if ((node==null<Node*>())&&(!ma->OutputOptional(i))) ok = false;
+      if (ok&&(!out.Put(node))) ok = false;
+      delete node;
+     }
+    remotePack.Unlock();
+    delete alg;
+
+    pack += time::UltraTime() - packStart;
+    mem::Copy((byte*)out.Data()+sizeof(real64),(byte*)&pack,sizeof(real64));
+   }
+   else ok = false;
+  }
+
+  for (nat32 i=0;i<input.Size();i++) delete input[i];
+  delete params;
+
+ // Reply...
+  if (!ok)
+  {
+   RemoteOut fail;
+   fail.Write(&compute,sizeof(real64));
+   fail.Write(&pack,sizeof(real64));
+   SendMsg(*sock,remoteFailed,&fail);
+   return false;
+  }
+
+ return SendMsg(*sock,remoteResult,&out);
+}
+
+//------------------------------------------------------------------------------
+RemoteServer::RemoteServer(Core & c)
+:core(c)
+{}
+
+RemoteServer::~RemoteServer()
+{}
+
+void RemoteServer::Register(const MetaAlgorithm & ma)
+{
+ meta.AddBack(&ma);
+}
+
+void RemoteServer::Register(const Plugins & plugins)
+{
+ for (nat32 i=0;i<plugins.Size();i++) meta.AddBack(&plugins[i]);
+}
+
+bit RemoteServer::Serve(nat32 port,cstrconst iface,time::Progress * prog)
+{
+ os::Socket listener;
+ listener.SetTimeout(500);
+ if (!listener.Listen(port,iface)) return false;
+
+ ds::List<RemoteConnection*> active;
+ while (!prog->Cancelled())
+ {
+  os::Socket * sock = listener.Accept();
+  if (sock)
+  {
+   sock->SetTimeout(30000);
+   RemoteConnection * con = new RemoteConnection(*this,sock);
+   active.AddBack(con);
+   con->Run();
+  }
+
+  // Tidy up finished connections...
+   for (nat32 i=active.Size();i!=0;i--)
+   {
+    RemoteConnection * con = active.Front();
+    active.RemFront();
+    if (con->finished.Get()!=0)
+    {
+     con->Wait();
+     delete con;
+    }
+    else active.AddBack(con);
+   }
+ }
+
+ while (active.Size()!=0)
+ {
+  active.Front()->Wait();
+  delete active.Front();
+  active.RemFront();
+ }
+ return true;
+}
+
+const MetaAlgorithm * RemoteServer::FindMeta(cstrconst name) const
+{
+ ds::List<const MetaAlgorithm*>::Cursor targ = meta.FrontPtr();
+ while (!targ.Bad())
+ {
+  if (str::Compare((*targ)->Name(),name)==0) return *targ;
+  ++targ;
+ }
+ return null<const MetaAlgorithm*>();
+}
+
+//------------------------------------------------------------------------------
+// A worker machine...
+class RemoteHost
+{
+ public:
+  RemoteHost(cstrconst n,nat32 p):name(str::Duplicate(n)),port(p) {}
+  ~RemoteHost() {mem::Free(name);}
+
+  cstr name;
+  nat32 port;
+  mt::OwnedLock busy; // Held whilst a band is with it, so concurrent Run's queue rather than overload it.
+};
+
+//------------------------------------------------------------------------------
+// The state shared by the threads of a RemoteDispatcher::Run...
+class RemoteJob
+{
+ public:
+  RemoteJob():done(0),inFlight(0),failed(false) {}
+
+  cstrconst alg;
+  cstrconst xml;
+  nat32 xmlSize;
+  nat32 inputs;
+  Node * const * in;
+  nat32 outputs;
+
+  nat32 height; // Rows of the inputs being split, 0 if they are not.
+  nat32 rows;
+  nat32 overlap;
+  nat32 bands;
+
+  mt::OwnedLock lock; // Protects everything below.
+   ds::List<nat32> pending; // Bands waiting to be sent.
+   ds::Array<nat32> attempts; // Failed attempts of each band.
+   ds::Array<Node*> result; // Outputs of each band, band major.
+   nat32 done;
+   nat32 inFlight;
+   bit failed;
+   RemoteStats stats;
+
+  // Gets the rows of a band, those it produces as [first,last) and those sent
+  // as [low,high)...
+   void Extent(nat32 band,nat32 & first,nat32 & last,nat32 & low,nat32 & high) const
+   {
+    first = band*rows;
+    last = math::Min(first+rows,height);
+    low = (first>overlap)?(first-overlap):0;
+    high = math::Min(last+overlap,height);
+   }
+};
+
+//------------------------------------------------------------------------------
+// Sends bands to a single worker, until there are none left or it fails...
+class RemoteWorker : public mt::Thread
+{
+ public:
+  RemoteWorker(RemoteDispatcher & d,RemoteJob & j,RemoteHost & h):dispatcher(d),job(j),host(h) {}
+
+  void Execute();
+
+
+ private:
+  RemoteDispatcher & dispatcher;
+  RemoteJob & job;
+  RemoteHost & host;
+
+  // Sends a band and gets the result, returns 0 on success, 1 if the worker
+  // was lost and 2 if the algorithm failed...
+   nat32 Exchange(nat32 band);
+};
+
+void RemoteWorker::Execute()
+{
+ while (true)
+ {
+  job.lock.Lock();
+   if (job.failed||((job.pending.Size()==0)&&(job.inFlight==0)))
+   {
+    job.lock.Unlock();
+    break;
+   }
+
+   // Another worker might yet drop its band, so wait around...
+    if (job.pending.Size()==0)
+    {
+     job.lock.Unlock();
+     mt::Sleep(50);
+     continue;
+    }
+
+   nat32 band = job.pending.Front();
+   job.pending.RemFront();
+   job.inFlight += 1;
+  job.lock.Unlock();
+
+  nat32 res = Exchange(band);
+
+  job.lock.Lock();
+   job.inFlight -= 1;
+   if (res==0) job.done += 1;
+   else if (res==2) job.failed = true;
+   else
+   {
+    job.attempts[band] += 1;
+    if (job.attempts[band]>dispatcher.retries) job.failed = true;
+    else
+    {
+     job.pending.AddFront(band);
+     job.stats.retries += 1;
+    }
+   }
+  job.lock.Unlock();
+
+  if (res!=0) break;
+ }
+}
+
+nat32 RemoteWorker::Exchange(nat32 band)
+{
+ real64 start = time::UltraTime();
+
+ // Pack...
+  RemoteOut body;
+  body.Put(job.alg,str::Length(job.alg));
+  body.Put(job.xml,job.xmlSize);
+  body.Write(&job.inputs,sizeof(nat32));
+
+  nat32 first = 0,last = 0,low = 0,high = 0;
+  if (job.height!=0) job.Extent(band,first,last,low,high);
+
+  bit ok = true;
+  remotePack.Lock();
+   for (nat32 i=0;ok&&(i<job.inputs);i++)
+   {
+    Node * node = job.in[i];
+    if ((job.height!=0)&&IsRows(node,job.height))
+    {
+     Var * var = static_cast<Var*>(node);
+     Var * part = MakeLike(dispatcher.core,var,var->Size(0),high-low);
+     CopyRows(var,low,part,0,high-low);
+     ok = body.Put(part);
+     delete part;
+    }
+    else ok = body.Put(node);
+   }
+  remotePack.Unlock();
+  if (!ok) return 2;
+
+ // Send it and wait for the reply...
+  real64 sendStart = time::UltraTime();
+
+  nat32 type = remoteFailed;
+  byte * data = null<byte*>();
+  nat64 size = 0;
+
+  host.busy.Lock();
+   os::Socket sock;
+   sock.SetTimeout(dispatcher.timeout);
+   bit got = sock.Connect(host.name,host.port) &&
+             SendMsg(sock,remoteJob,&body) &&
+             RecvMsg(sock,type,data,size);
+   sock.Close();
+  host.busy.Unlock();
+
+  real64 recvEnd = time::UltraTime();
+
+ // Unpack...
+  real64 compute = 0.0;
+  real64 remotePacking = 0.0;
+  nat32 ret = got?0:1;
+  if (got)
+  {
+   RemoteIn msg(data,size);
+   msg.Read(&compute,sizeof(real64));
+   msg.Read(&remotePacking,sizeof(real64));
+
+   if (type==remoteResult)
+   {
+    nat32 outputs = 0;
+    msg.Read(&outputs,sizeof(nat32));
+    if (outputs==job.outputs)
+    {
+     for (nat32 i=0;i<outputs;i++)
+     {
+      Node *& targ = job.result[band*job.outputs+i];
+      delete targ;
+      if (!msg.Get(dispatcher.core,targ)) ret = 1;
+     }
+    }
+    else ret = 2;
+   }
+   else ret = 2;
+   mem::Free(data);
+  }
+
+  real64 end = time::UltraTime();
+
+ // Record where the time went...
+  job.lock.Lock();
+   job.stats.sent += sock.Sent();
+   job.stats.received += sock.Received();
+   job.stats.pack += (sendStart-start) + (end-recvEnd) + remotePacking;
+   job.stats.network += math::Max(0.0,(recvEnd-sendStart) - compute - remotePacking);
+   job.stats.compute += compute;
+  job.lock.Unlock();
+
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+RemoteDispatcher::RemoteDispatcher(Core & c)
+:core(c),retries(3),timeout(30000)
+{}
+
+RemoteDispatcher::~RemoteDispatcher()
+{
+ for (nat32 i=0;i<host.Size();i++) delete host[i];
+}
+
+void RemoteDispatcher::AddWorker(cstrconst name,nat32 port)
+{
+ nat32 i = host.Size();
+ host.Size(i+1);
+ host[i] = new RemoteHost(name,port);
+}
+
+bit RemoteDispatcher::Run(cstrconst alg,const bs::Element * params,nat32 inputs,Node * const * in,
+                          nat32 outputs,Node ** out,nat32 rows,nat32 overlap,
+                          RemoteStats * stats,time::Progress * prog)
+{
+ real64 start = time::UltraTime();
+
+ // Setup the job, deciding on the bands...
+  RemoteJob job;
+  job.alg = alg;
+  job.inputs = inputs;
+  job.in = in;
+  job.outputs = outputs;
+  job.rows = rows;
+  job.overlap = overlap;
+
+  job.height = 0;
+  if (rows!=0)
+  {
+   for (nat32 i=0;i<inputs;i++)
+   {
+    if (IsRows(in[i],0)) {job.height = static_cast<Var*>(in[i])->Size(1); break;}
+   }
+  }
+  if (job.height<=rows) job.height = 0;
+  job.bands = (job.height==0)?1:((job.height+rows-1)/rows);
+
+  str::String xmlStr;
+  if (params) xmlStr << *params;
+  cstr xml = xmlStr.ToStr();
+  job.xml = xml;
+  job.xmlSize = str::Length(xml);
+
+  job.attempts.Size(job.bands);
+  job.result.Size(job.bands*outputs);
+  for (nat32 i=0;i<job.bands;i++)
+  {
+   job.pending.AddBack(i);
+   job.attempts[i] = 0;
+  }
+  for (nat32 i=0;i<job.result.Size();i++) job.result[i] = null<Node*>();
+
+  job.stats.alg = core.GetTT()(alg);
+  job.stats.tiles = job.bands;
+  job.stats.retries = 0;
+  job.stats.sent = 0;
+  job.stats.received = 0;
+  job.stats.pack = 0.0;
+  job.stats.network = 0.0;
+  job.stats.compute = 0.0;
+
+ // Start a thread per worker, then wait, reporting progress and passing on
+ // cancels...
+  ds::Array<RemoteWorker*> worker(host.Size());
+  for (nat32 i=0;i<worker.Size();i++)
+  {
+   worker[i] = new RemoteWorker(*this,job,*host[i]);
+   worker[i]->Run();
+  }
+
+  while (true)
+  {
+   bit running = false;
+   for (nat32 i=0;i<worker.Size();i++)
+   {
+    if (worker[i]->Running()) running = true;
+   }
+   if (!running) break;
+
+   job.lock.Lock();
+    if (prog->Cancelled()) job.failed = true;
+    nat32 done = job.done;
+   job.lock.Unlock();
+   prog->Report(done,job.bands);
+
+   mt::Sleep(100);
+  }
+
+  for (nat32 i=0;i<worker.Size();i++)
+  {
+   worker[i]->Wait();
+   delete worker[i];
+  }
+  mem::Free(xml);
+
+ // Stitch the bands back together...
+  bit ok = (!job.failed)&&(job.done==job.bands);
+  real64 stitchStart = time::UltraTime();
+  for (nat32 o=0;o<outputs;o++)
+  {
+   out[o] = null<Node*>();
+   if (!ok) continue;
+
+   Node * first = job.result[o];
+   nat32 f = 0,l = 0,low = 0,high = 0;
+   if (job.height!=0) job.Extent(0,f,l,low,high);
+
+   if ((job.height!=0)&&IsRows(first,high-low))
+   {
+    Var * firstVar = static_cast<Var*>(first);
+    Var * var = MakeLike(core,firstVar,firstVar->Size(0),job.height);
+    for (nat32 b=0;b<job.bands;b++)
+    {
+     job.Extent(b,f,l,low,high);
+     Node * part = job.result[b*outputs+o];
+     if ((!IsRows(part,high-low))||(static_cast<Var*>(part)->Size(0)!=var->Size(0))) {ok = false; break;}
+     CopyRows(static_cast<Var*>(part),f-low,var,f,l-f);
+    }
+
+    if (ok) out[o] = var;
+       else delete var;
+   }
+   else
+   {
+    out[o] = first;
+    job.result[o] = null<Node*>();
+   }
+  }
+
+  if (!ok)
+  {
+   for (nat32 o=0;o<outputs;o++)
+   {
+    delete out[o];
+    out[o] = null<Node*>();
+   }
+  }
+  for (nat32 i=0;i<job.result.Size();i++) delete job.result[i];
+
+  job.stats.pack += time::UltraTime() - stitchStart;
+  job.stats.wall = time::UltraTime() - start;
+
+ // Record the statistics...
+  historyLock.Lock();
+   nat32 h = history.Size();
+   history.Size(h+1);
+   history[h] = job.stats;
+  historyLock.Unlock();
+  if (stats) *stats = job.stats;
+
+ return ok;
+}
+
+nat32 RemoteDispatcher::History() const
+{
+ historyLock.Lock();
+  nat32 ret = history.Size();
+ historyLock.Unlock();
+ return ret;
+}
+
+RemoteStats RemoteDispatcher::History(nat32 i) const
+{
+ historyLock.Lock();
+  RemoteStats ret = history[i];
+ historyLock.Unlock();
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// The Algorithm made by RemoteMeta...
+class RemoteAlg : public Algorithm
+{
+ public:
+  RemoteAlg(RemoteDispatcher & d,const MetaAlgorithm & m,nat32 r,nat32 o)
+  :Algorithm(m.Inputs(),m.Outputs()),dispatcher(d),meta(m),rows(r),overlap(o),params(null<bs::Element*>())
+  {}
+
+  ~RemoteAlg() {delete params;}
+
+  void Configure(const bs::Element & elem)
+  {
+   delete params;
+   params = new bs::Element(elem);
+  }
+
+  void Run(time::Progress * prog)
+  {
+   ds::Array<Node*> in(meta.Inputs());
+   for (nat32 i=0;i<in.Size();i++) in[i] = GetInput(i);
+   ds::Array<Node*> out(meta.Outputs());
+
+   dispatcher.Run(meta.Name(),params,in.Size(),in.Ptr(),out.Size(),out.Ptr(),rows,overlap,null<RemoteStats*>(),prog);
+   for (nat32 i=0;i<out.Size();i++) SetOutput(i,out[i]);
+  }
+
+  cstrconst TypeString() const {return "eos::svt::RemoteAlg";}
+
+
+ private:
+  RemoteDispatcher & dispatcher;
+  const MetaAlgorithm & meta;
+  nat32 rows;
+  nat32 overlap;
+  bs::Element * params;
+};
+
+//------------------------------------------------------------------------------
+RemoteMeta::RemoteMeta(RemoteDispatcher & d,const MetaAlgorithm & l,nat32 r,nat32 o)
+:dispatcher(d),local(l),rows(r),overlap(o)
+{}
+
+RemoteMeta::~RemoteMeta()
+{}
+
+Algorithm * RemoteMeta::Make() const
+{
+ return new RemoteAlg(dispatcher,local,rows,overlap);
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,274 @@
+#ifndef EOS_SVT_REMOTE_H
+#define EOS_SVT_REMOTE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file remote.h
+/// Provides the running of Algorithm's on other machines, with a server to run
+/// on each worker and a dispatcher that farms jobs out to them, splitting big
+/// images into bands of rows. This is the core of helios.
+
+#include "eos/types.h"
+#include "eos/svt/calculation.h"
+#include "eos/svt/plugins.h"
+#include "eos/bs/dom.h"
+#include "eos/ds/arrays.h"
+#include "eos/ds/lists.h"
+#include "eos/mt/locks.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+// Predeclarations of the internals...
+class RemoteHost;
+
+//------------------------------------------------------------------------------
+/// Serves jobs to RemoteDispatcher's, running algorithms by name from those
+/// registered with it. Each connection is one job, handled on its own thread:
+/// the inputs arrive as compressed svt data, along with the xml the algorithm
+/// is configured with, the algorithm is run and the outputs sent back the same
+/// way. Whilst running it sends a heartbeat every second, so the dispatcher
+/// can tell a slow job from a dead machine. There is no authentication, it is
+/// for use on a trusted cluster only.
+class EOS_CLASS RemoteServer
+{
+ public:
+  /// Everything received is loaded into the given core.
+   RemoteServer(Core & core);
+
+  /// &nbsp;
+   ~RemoteServer();
+
+
+  /// Adds an algorithm that can be run, by its Name(). The caller keeps
+  /// ownership, and it must outlive the server.
+   void Register(const MetaAlgorithm & meta);
+
+  /// Adds all the algorithms of a plugin registry, as above.
+   void Register(const Plugins & plugins);
+
+
+  /// Listens on the given port and serves jobs until the progress object is
+  /// cancelled, which is checked twice a second, then waits for the jobs in
+  /// progress to finish. Returns false if it could not listen. Only listens on
+  /// loopback unless given an interface, as for os::Socket::Listen, null for
+  /// all of them. The progress is never reported to, only used for cancelling.
+   bit Serve(nat32 port,cstrconst iface = "127.0.0.1",time::Progress * prog = null<time::Progress*>());
+
+
+  /// Returns how many jobs have been completed successfully.
+   nat32 Jobs() const {return nat32(jobs.Get());}
+
+  /// Returns how many jobs have failed, including those where the
+  /// connection was lost.
+   nat32 Failures() const {return nat32(failures.Get());}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::svt::RemoteServer";}
+
+
+ private:
+  friend class RemoteConnection;
+
+  Core & core;
+  ds::List<const MetaAlgorithm*> meta;
+  mt::Atomic jobs;
+  mt::Atomic failures;
+
+  const MetaAlgorithm * FindMeta(cstrconst name) const;
+};
+
+//------------------------------------------------------------------------------
+/// Where the time went for one RemoteDispatcher::Run, to see whether
+/// distributing it paid off. The times are summed over the tiles, so with
+/// several workers they can add up to more than wall.
+struct EOS_CLASS RemoteStats
+{
+ str::Token alg; ///< The algorithm that was run.
+ nat32 tiles; ///< How many bands the job was split into.
+ nat32 retries; ///< How many times a tile was sent again after a worker was lost.
+
+ nat64 sent; ///< Bytes sent, over all tiles.
+ nat64 received; ///< Bytes received, over all tiles.
+
+ real64 pack; ///< Seconds spent serialising, compressing and stitching, at both ends.
+ real64 network; ///< Seconds waiting on the network, i.e. round trip minus the time the worker was busy.
+ real64 compute; ///< Seconds the workers spent running the algorithm.
+ real64 wall; ///< Seconds from start to finish.
+
+
+ /// &nbsp;
+  static inline cstrconst TypeString() {return "eos::svt::RemoteStats";}
+};
+
+//------------------------------------------------------------------------------
+/// Runs algorithms on a set of machines running RemoteServer. A job can be
+/// split into horizontal bands of rows, each sent with some extra rows above
+/// and below so the algorithm has context at the edges, with only the middle
+/// of each band kept when stitching the outputs back together. Bands of rows
+/// suit stereo algorithms on rectified images, as the scanlines stay whole;
+/// the overlap should cover the reach of any smoothing, e.g. a few times the
+/// cost aggregation window for DSI based methods or the spread of messages for
+/// belief propagation.
+///
+/// Each machine gets one band at a time, the next being handed out as soon as
+/// it returns one. If a machine fails to respond, or stops sending heartbeats,
+/// its band is sent to another and it is not used again for that Run.
+class EOS_CLASS RemoteDispatcher
+{
+ public:
+  /// Results are loaded into the given core.
+   RemoteDispatcher(Core & core);
+
+  /// &nbsp;
+   ~RemoteDispatcher();
+
+
+  /// Adds a worker machine, by name or dotted address, and port.
+   void AddWorker(cstrconst host,nat32 port);
+
+  /// Returns how many workers have been added.
+   nat32 Workers() const {return host.Size();}
+
+  /// Sets how many times a band is retried after a worker is lost before the
+  /// job fails, defaults to 3.
+   void SetRetries(nat32 r) {retries = r;}
+
+  /// Sets how long to wait for a worker to respond, in milliseconds, before
+  /// giving up on it. Defaults to 30 seconds.
+   void SetTimeout(nat32 ms) {timeout = ms;}
+
+
+  /// Runs the named algorithm remotely. params is the element the algorithm is
+  /// configured with, can be null. in is the array of inputs, some of which
+  /// can be null, out is filled with the outputs, which the caller then owns.
+  /// If rows is not 0 every input that is a 2D Var with the same number of rows
+  /// as the first such input is split into bands of that many rows, plus
+  /// overlap rows either side; other inputs are sent whole with every band.
+  /// Outputs that are 2D Var's the size of the band sent are stitched back
+  /// together, other outputs are taken from the first band only. Thread safe,
+  /// so it can be used by the steps of a Pipeline. Returns true on success,
+  /// with stats filled in if its not null, whether it worked or not.
+   bit Run(cstrconst alg,const bs::Element * params,nat32 inputs,Node * const * in,
+           nat32 outputs,Node ** out,nat32 rows = 0,nat32 overlap = 0,
+           RemoteStats * stats = null<RemoteStats*>(),time::Progress * prog = null<time::Progress*>());
+
+
+  /// Returns how many Run's have been done.
+   nat32 History() const;
+
+  /// Returns the statistics of a previous Run, in the order they finished.
+   RemoteStats History(nat32 i) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::svt::RemoteDispatcher";}
+
+
+ private:
+  friend class RemoteWorker;
+
+  Core & core;
+  ds::Array<RemoteHost*> host;
+  nat32 retries;
+  nat32 timeout;
+
+  mt::OwnedLock historyLock;
+  ds::Array<RemoteStats> history;
+};
+
+//------------------------------------------------------------------------------
+/// Makes a local MetaAlgorithm run remotely, via a RemoteDispatcher. It
+/// describes itself exactly as the local one does, but the Algorithm's it makes
+/// send their inputs, and the element given to Configure, to the workers.
+/// Registering these with a Pipeline, instead of the local ones, distributes
+/// the steps of the pipeline over the workers, whilst the pipeline still runs
+/// the independent steps at the same time.
+class EOS_CLASS RemoteMeta : public MetaAlgorithm
+{
+ public:
+  /// rows and overlap are as for RemoteDispatcher::Run. Both the dispatcher
+  /// and the local description must outlive this.
+   RemoteMeta(RemoteDispatcher & dispatcher,const MetaAlgorithm & local,nat32 rows = 0,nat32 overlap = 0);
+
+  /// &nbsp;
+   ~RemoteMeta();
+
+
+  /// &nbsp;
+   Algorithm * Make() const;
+
+  /// &nbsp;
+   cstrconst Name() const {return local.Name();}
+
+  /// &nbsp;
+   cstrconst Help() const {return local.Help();}
+
+  /// &nbsp;
+   nat32 Inputs() const {return local.Inputs();}
+
+  /// &nbsp;
+   cstrconst InputName(nat32 input) const {return local.InputName(input);}
+
+  /// &nbsp;
+   bit InputOptional(nat32 input) const {return local.InputOptional(input);}
+
+  /// &nbsp;
+   cstrconst InputHelp(nat32 input) const {return local.InputHelp(input);}
+
+  /// &nbsp;
+   const Type * InputType(nat32 input) const {return local.InputType(input);}
+
+  /// &nbsp;
+   nat32 Outputs() const {return local.Outputs();}
+
+  /// &nbsp;
+   cstrconst OutputName(nat32 output) const {return local.OutputName(output);}
+
+  /// &nbsp;
+   bit OutputOptional(nat32 output) const {return local.OutputOptional(output);}
+
+  /// &nbsp;
+   cstrconst OutputHelp(nat32 output) const {return local.OutputHelp(output);}
+
+  /// &nbsp;
+   const Type * OutputType(nat32 output) const {return local.OutputType(output);}
+
+  /// &nbsp;
+   bit GoodDom(bs::Element * elem) const {return local.GoodDom(elem);}
+
+
+  /// &nbsp;
+   cstrconst TypeString() const {return "eos::svt::RemoteMeta";}
+
+
+ private:
+  RemoteDispatcher & dispatcher;
+  const MetaAlgorithm & local;
+  nat32 rows;
+  nat32 overlap;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
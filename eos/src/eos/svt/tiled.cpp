@@ -0,0 +1,167 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/svt/tiled.h"
+
+#include "eos/str/functions.h"
+#include "eos/log/profile.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+TiledCode::TiledCode(nat32 es,nat32 width,nat32 height,nat32 depth,
+                     nat32 tileWidth,nat32 tileHeight,nat32 tileDepth,nat64 cacheBytes,cstrconst f)
+:elementSize(es),head(0),lastTile(0xFFFFFFFF),lastSlot(0),hits(0),misses(0),reported(0)
+{
+ size[0] = width; size[1] = height; size[2] = depth;
+ tileSize[0] = math::Max<nat32>(tileWidth,1);
+ tileSize[1] = math::Max<nat32>(tileHeight,1);
+ tileSize[2] = math::Max<nat32>(tileDepth,1);
+
+ tileBytes = elementSize;
+ nat32 totalTiles = 1;
+ for (nat32 d=0;d<3;d++)
+ {
+  tiles[d] = (size[d]+tileSize[d]-1)/tileSize[d];
+  tileBytes *= tileSize[d];
+  totalTiles *= tiles[d];
+ }
+
+ cacheTiles = math::Max<nat64>(cacheBytes/tileBytes,2);
+ cacheTiles = math::Min(cacheTiles,math::Max<nat32>(totalTiles,1));
+ tail = cacheTiles-1;
+
+ // Open the backing file...
+  if (f) fn = str::Duplicate(f);
+    else fn = file::TemporyFilename();
+  bf.Open(fn,file::way_ow,file::mode_wr);
+
+ // Create the cache, all slots empty and linked in order...
+  cache = mem::Malloc<byte>(cacheTiles*tileBytes);
+  slot = mem::Malloc<Slot>(cacheTiles);
+  for (nat32 i=0;i<cacheTiles;i++)
+  {
+   slot[i].tile = 0xFFFFFFFF;
+   slot[i].dirty = false;
+   slot[i].prev = (i==0)?0xFFFFFFFF:(i-1);
+   slot[i].next = (i+1==cacheTiles)?0xFFFFFFFF:(i+1);
+   slot[i].data = cache + nat64(i)*tileBytes;
+  }
+
+  where = mem::Malloc<nat32>(totalTiles);
+  for (nat32 i=0;i<totalTiles;i++) where[i] = 0xFFFFFFFF;
+}
+
+TiledCode::~TiledCode()
+{
+ if (hits!=reported) log::DefaultProfiler().Count("eos::svt::Tiled hit",hits-reported);
+
+ bf.Close();
+ file::DeleteFile(fn);
+
+ mem::Free(fn);
+ mem::Free(where);
+ mem::Free(slot);
+ mem::Free(cache);
+}
+
+void TiledCode::Flush()
+{
+ for (nat32 i=0;i<cacheTiles;i++) WriteBack(i);
+ bf.Flush();
+
+ if (hits!=reported)
+ {
+  log::DefaultProfiler().Count("eos::svt::Tiled hit",hits-reported);
+  reported = hits;
+ }
+}
+
+byte * TiledCode::Fetch(nat32 ind,bit write)
+{
+ nat32 s = where[ind];
+ if (s!=0xFFFFFFFF)
+ {
+  // Hit...
+   ++hits;
+   Touch(s);
+ }
+ else
+ {
+  // Miss - page out the least recently used tile and page in the requested...
+   ++misses;
+   log::Profiler & prof = log::DefaultProfiler();
+   bit profile = prof.Enabled();
+   if (profile)
+   {
+    prof.Count("eos::svt::Tiled hit",hits-reported);
+    prof.Count("eos::svt::Tiled miss");
+    reported = hits;
+    prof.Enter("eos::svt::Tiled::Page");
+   }
+
+   s = tail;
+   WriteBack(s);
+   if (slot[s].tile!=0xFFFFFFFF) where[slot[s].tile] = 0xFFFFFFFF;
+
+   nat32 got = bf.Read(nat64(ind)*tileBytes,slot[s].data,tileBytes);
+   if (got<tileBytes) mem::Null(slot[s].data + got,tileBytes-got);
+
+   slot[s].tile = ind;
+   slot[s].dirty = false;
+   where[ind] = s;
+   Touch(s);
+
+   if (profile) prof.Leave();
+ }
+
+ if (write) slot[s].dirty = true;
+ lastTile = ind;
+ lastSlot = s;
+ return slot[s].data;
+}
+
+void TiledCode::WriteBack(nat32 s)
+{
+ if (slot[s].dirty)
+ {
+  bf.Write(nat64(slot[s].tile)*tileBytes,slot[s].data,tileBytes);
+  slot[s].dirty = false;
+ }
+}
+
+void TiledCode::Touch(nat32 s)
+{
+ if (s==head) return;
+
+ // Unlink...
+  slot[slot[s].prev].next = slot[s].next;
+  if (slot[s].next!=0xFFFFFFFF) slot[slot[s].next].prev = slot[s].prev;
+                           else tail = slot[s].prev;
+
+ // Link at the head...
+  slot[s].prev = 0xFFFFFFFF;
+  slot[s].next = head;
+  slot[head].prev = s;
+  head = s;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,267 @@
+#ifndef EOS_SVT_TILED_H
+#define EOS_SVT_TILED_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file tiled.h
+/// Provides an out of core 3D array, for data sets such as full disparity 
+/// space volumes that don't fit in memory. The data lives on disk in fixed 
+/// size tiles, which are paged through a bounded cache.
+
+#include "eos/types.h"
+#include "eos/typestring.h"
+#include "eos/math/functions.h"
+#include "eos/file/files.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+/// The code behind the Tiled template, does all the work with untyped elements.
+/// The array is split into tiles of a fixed size, each stored contiguously in a
+/// backing file, x fastest, then y, then z. A fixed number of tiles are kept in
+/// memory, the least recently used being written back and replaced when a tile
+/// not in memory is requested. Data never written is zero.
+///
+/// Cache hits and misses are counted, and are also sent to the DefaultProfiler()
+/// as the counters "eos::svt::Tiled hit" and "eos::svt::Tiled miss", with the
+/// paging done on a miss recorded as the block "eos::svt::Tiled::Page".
+///
+/// Not thread safe - each thread should have its own, or access should be locked.
+class EOS_CLASS TiledCode
+{
+ public:
+  /// &nbsp;
+  /// \param elementSize Size of each element in bytes.
+  /// \param width Size of dimension 0.
+  /// \param height Size of dimension 1.
+  /// \param depth Size of dimension 2, set unused dimensions to 1.
+  /// \param tileWidth Tile size of dimension 0.
+  /// \param tileHeight Tile size of dimension 1.
+  /// \param tileDepth Tile size of dimension 2.
+  /// \param cacheBytes How much memory the cache can use, allways at least 2 tiles.
+  /// \param fn Filename for the backing file, null to use a temporary file. Its deleted when this class is.
+   TiledCode(nat32 elementSize,nat32 width,nat32 height,nat32 depth,
+             nat32 tileWidth,nat32 tileHeight,nat32 tileDepth,nat64 cacheBytes,cstrconst fn);
+
+  /// Writes nothing back, as the file is deleted anyway.
+   ~TiledCode();
+
+
+  /// Returns true if the backing file was opened.
+   bit Active() const {return bf.Active();}
+
+  /// Returns the size of the given dimension, 0..2.
+   nat32 Size(nat32 d) const {return size[d];}
+
+  /// Returns the tile size of the given dimension, 0..2.
+   nat32 TileSize(nat32 d) const {return tileSize[d];}
+
+  /// Returns how many tiles there are in the given dimension, 0..2.
+   nat32 Tiles(nat32 d) const {return tiles[d];}
+
+  /// Returns how many tiles can be held in memory at once.
+   nat32 CacheTiles() const {return cacheTiles;}
+
+
+  /// Returns how many tile requests were satisfied from memory.
+   nat64 Hits() const {return hits;}
+
+  /// Returns how many tile requests had to page from disk.
+   nat64 Misses() const {return misses;}
+
+  /// Writes every modified tile in memory back to disk, also sends any 
+  /// outstanding hit/miss counts to the profiler.
+   void Flush();
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::svt::TiledCode";}
+
+
+ protected:
+  // Returns a pointer to the given tile, in memory, paging it in if need be. 
+  // If write is true the tile is marked as modified. The pointer remains 
+  // valid until CacheTiles()-1 other tiles have been requested...
+   byte * Tile(nat32 tx,nat32 ty,nat32 tz,bit write)
+   {
+    nat32 ind = tx + tiles[0]*(ty + tiles[1]*tz);
+    if (ind==lastTile)
+    {
+     ++hits;
+     if (write) slot[lastSlot].dirty = true;
+     return slot[lastSlot].data;
+    }
+    return Fetch(ind,write);
+   }
+
+  // Returns a pointer to the given element...
+   byte * Element(nat32 x,nat32 y,nat32 z,bit write)
+   {
+    nat32 tx = x/tileSize[0];
+    nat32 ty = y/tileSize[1];
+    nat32 tz = z/tileSize[2];
+    byte * t = Tile(tx,ty,tz,write);
+    return t + elementSize*((x-tx*tileSize[0]) + tileSize[0]*((y-ty*tileSize[1]) + tileSize[1]*(z-tz*tileSize[2])));
+   }
+
+
+ private:
+  nat32 elementSize;
+  nat32 size[3];
+  nat32 tileSize[3];
+  nat32 tiles[3];
+  nat64 tileBytes;
+
+  file::FileCode bf; // Backing file.
+  cstr fn; // mem::Malloc-ed, so it can be deleted.
+
+  struct Slot
+  {
+   nat32 tile; // 0xFFFFFFFF if empty.
+   bit dirty;
+   nat32 prev; // Linked list in order of use, most recent first, 0xFFFFFFFF terminated.
+   nat32 next;
+   byte * data; // Points into the cache block.
+  };
+
+  nat32 cacheTiles;
+  Slot * slot;
+  byte * cache;
+  nat32 * where; // For each tile its slot, or 0xFFFFFFFF if not in memory.
+  nat32 head; // Most recently used slot.
+  nat32 tail; // Least recently used slot, next to be replaced.
+
+  nat32 lastTile; // The last tile requested and its slot, for a quick path.
+  nat32 lastSlot;
+
+  nat64 hits;
+  nat64 misses;
+  nat64 reported; // Hits already sent to the profiler.
+
+  // Handles the case where the tile is not the last one requested...
+   byte * Fetch(nat32 ind,bit write);
+
+  // Writes a slot back to disk if modified...
+   void WriteBack(nat32 s);
+
+  // Moves a slot to the head of the use list...
+   void Touch(nat32 s);
+};
+
+//------------------------------------------------------------------------------
+/// An out of core 3D array of type T, as described for TiledCode. To stream 
+/// through it efficiently use the Iter class, which visits a tile at a time, so
+/// each tile is paged in at most once; random access via Get() works but will
+/// thrash the cache if it jumps arround to much. T must be a plain type that 
+/// can be copied as bytes and for which all zeros is a sensible initial value.
+template <typename T>
+class EOS_CLASS Tiled : public TiledCode
+{
+ public:
+  /// &nbsp;
+  /// \param width Size of dimension 0.
+  /// \param height Size of dimension 1.
+  /// \param depth Size of dimension 2.
+  /// \param cacheBytes How much memory to use for the cache, defaults to 256 meg.
+  /// \param tileWidth Tile size of dimension 0.
+  /// \param tileHeight Tile size of dimension 1.
+  /// \param tileDepth Tile size of dimension 2, defaults to the whole of it.
+  /// \param fn The backing file, null for a temporary.
+   Tiled(nat32 width,nat32 height,nat32 depth,nat64 cacheBytes = 256*1024*1024,
+         nat32 tileWidth = 32,nat32 tileHeight = 32,nat32 tileDepth = 0,cstrconst fn = null<cstrconst>())
+   :TiledCode(sizeof(T),width,height,depth,tileWidth,tileHeight,(tileDepth==0)?depth:tileDepth,cacheBytes,fn)
+   {}
+
+  /// &nbsp;
+   ~Tiled() {}
+
+
+  /// Returns the given element, marking its tile as modified.
+   T & Get(nat32 x,nat32 y,nat32 z) {return *(T*)(void*)Element(x,y,z,true);}
+
+  /// Returns the given element, for reading only.
+   const T & Read(nat32 x,nat32 y,nat32 z) {return *(T*)(void*)Element(x,y,z,false);}
+
+
+  /// Walks the tiles of a Tiled in storage order, giving access to each in 
+  /// turn via coordinates local to the tile.
+   class Iter;
+   friend class Iter;
+
+   class Iter
+   {
+    public:
+     /// If write is false the tiles are not marked as modified, so they won't be written back.
+      Iter(Tiled<T> & t,bit w = true):tiled(t),write(w),tx(0),ty(0),tz(0) {Fetch();}
+
+     /// &nbsp;
+      ~Iter() {}
+
+
+     /// Returns false once all tiles have been visited.
+      bit Valid() const {return tz<tiled.Tiles(2);}
+
+     /// Moves to the next tile.
+      void Next()
+      {
+       ++tx;
+       if (tx==tiled.Tiles(0)) {tx = 0; ++ty;}
+       if (ty==tiled.Tiles(1)) {ty = 0; ++tz;}
+       if (Valid()) Fetch();
+      }
+
+
+     /// Returns the position of the tiles origin in the array, in dimension d.
+      nat32 Origin(nat32 d) const {return ((d==0)?tx:((d==1)?ty:tz))*tiled.TileSize(d);}
+
+     /// Returns how much of the tile is in the array in dimension d, can be less than the tile size for the last tile.
+      nat32 Extent(nat32 d) const {return math::Min(tiled.TileSize(d),tiled.Size(d)-Origin(d));}
+
+     /// Returns an element of the current tile, using coordinates relative to Origin().
+      T & Get(nat32 x,nat32 y,nat32 z) const {return ptr[x + tiled.TileSize(0)*(y + tiled.TileSize(1)*z)];}
+
+     /// Returns the tile as a simple array, indexed x + TileSize(0)*(y + TileSize(1)*z).
+      T * Ptr() const {return ptr;}
+
+
+    private:
+     Tiled<T> & tiled;
+     bit write;
+     nat32 tx;
+     nat32 ty;
+     nat32 tz;
+     T * ptr;
+
+     void Fetch() {ptr = (T*)(void*)tiled.Tile(tx,ty,tz,write);}
+   };
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString()
+   {
+    static GlueStr ret(GlueStr() << "eos::svt::Tiled<" << typestring<T>() << ">");
+    return ret;
+   }
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
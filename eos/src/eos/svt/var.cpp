@@ -17,50 +17,117 @@
 
 #include "eos/svt/var.h"
 
+#include "eos/svt/file.h"
 #include "eos/str/functions.h"
 #include "eos/data/blocks.h"
+#include "eos/file/zlib_funcs.h"
+#include "eos/math/functions.h"
+#include "eos/mt/tasks.h"
 
 namespace eos
 {
  namespace svt
  {
+//------------------------------------------------------------------------------
+// What rows are padded to a multiple of, when requested...
+static const nat64 rowAlign = 64;
+
+// Bytes below which copies are done by the calling thread alone...
+static const nat64 parallelCopy = 1024*1024;
+
+// Copies rows [begin,end) of a field between two layouts, each given as the
+// step between items and the step between rows, with width items to a row. An
+// input step of 0 replicates a single item, for filling in defaults...
+class CopyRows
+{
+ public:
+  byte * out; nat64 outStep; nat64 outRow;
+  const byte * in; nat64 inStep; nat64 inRow;
+  nat32 elem; nat32 width;
+
+  void operator()(nat32 begin,nat32 end)
+  {
+   for (nat32 r=begin;r<end;r++)
+   {
+    byte * o = out + r*outRow;
+    const byte * i = in + r*inRow;
+    if ((outStep==elem)&&(inStep==elem)) mem::Copy(o,i,nat64(width)*elem);
+    else
+    {
+     for (nat32 x=0;x<width;x++)
+     {
+      mem::Copy(o,i,elem);
+      o += outStep;
+      i += inStep;
+     }
+    }
+   }
+  }
+};
+
+// Copies a whole field with the above, in bands with mt::ParallelFor when its
+// large enough to matter. This is how fresh allocations are first written, so
+// on a NUMA machine each band's pages end up on the node of the worker that
+// wrote them, which is where later ParallelFor-s over the rows will run...
+static void CopyItems(byte * out,nat64 outStep,nat64 outRow,
+                      const byte * in,nat64 inStep,nat64 inRow,
+                      nat32 elem,nat32 width,nat32 rows)
+{
+ CopyRows cr;
+ cr.out = out; cr.outStep = outStep; cr.outRow = outRow;
+ cr.in = in; cr.inStep = inStep; cr.inRow = inRow;
+ cr.elem = elem; cr.width = width;
+
+ nat64 rowBytes = math::Max(nat64(width)*elem,nat64(1));
+ if (rowBytes*rows<parallelCopy) cr(0,rows);
+ else mt::ParallelFor(0,rows,cr,nat32(math::Max(parallelCopy/(16*rowBytes),nat64(1))));
+}
+
 //------------------------------------------------------------------------------
 Var::Var(Core & c)
 :Meta(c),
-changed(true),dims(0),size(null<nat32*>()),stride(null<nat32*>()),
-fields(0),fi(null<Entry**>()),byName(3),
-data(null<byte*>())
+changed(true),dims(0),size(null<nat32*>()),stride(null<nat64*>()),padRows(false),
+planar(false),nextPlanar(false),numa(mem::numa_first_touch),numaNode(0),
+fields(0),fi(null<Entry**>()),byName(),
+data(null<byte*>()),dataSize(0),map(null<file::FileMap*>()),
+zItems(0),zChunks(0),zData(null<byte**>()),zSize(null<nat32*>())
 {}
 
 Var::Var(Meta * meta)
 :Meta(meta),
-changed(true),dims(0),size(null<nat32*>()),stride(null<nat32*>()),
-fields(0),fi(null<Entry**>()),byName(3),
-data(null<byte*>())
+changed(true),dims(0),size(null<nat32*>()),stride(null<nat64*>()),padRows(false),
+planar(false),nextPlanar(false),numa(mem::numa_first_touch),numaNode(0),
+fields(0),fi(null<Entry**>()),byName(),
+data(null<byte*>()),dataSize(0),map(null<file::FileMap*>()),
+zItems(0),zChunks(0),zData(null<byte**>()),zSize(null<nat32*>())
 {}
 
 Var::Var(Var * var)
 :Meta(static_cast<Meta*>(var)),
-changed(var->changed),dims(var->dims),size(var->size),stride(var->stride),
+changed(var->changed),dims(var->dims),size(var->size),stride(var->stride),padRows(var->padRows),
+planar(var->planar),nextPlanar(var->nextPlanar),numa(var->numa),numaNode(var->numaNode),
 fields(var->fields),fi(var->fi),byName(var->byName),
-data(var->data)
+data(var->data),dataSize(var->dataSize),map(var->map),
+zItems(0),zChunks(0),zData(null<byte**>()),zSize(null<nat32*>())
 {
  var->size = null<nat32*>();
- var->stride = null<nat32*>();
+ var->stride = null<nat64*>();
  var->fields = 0;
  var->fi = null<Entry**>();
  var->data = null<byte*>();
+ var->map = null<file::FileMap*>();
 }
 
 Var::~Var()
 {
+ FreeCompressed();
  delete[] size;
  delete[] stride;
 
  for (nat32 i=0;i<fields;i++) delete fi[i];
  delete[] fi;
 
- mem::Free(data);
+ FreeData();
 }
 
 Var & Var::operator= (const Var & rhs)
@@ -72,37 +139,66 @@ Var & Var::operator= (const Var & rhs)
   for (nat32 i=0;i<fields;i++) delete fi[i];
   delete[] fi;
 
-  mem::Free(data);
+  FreeData();
+  FreeCompressed();
   
  // Copy over the (meta-) data...
   changed = rhs.changed;
   dims = rhs.dims;
   size = new nat32[dims];
   for (nat32 i=0;i<dims;i++) size[i] = rhs.size[i];
-  stride = new nat32[dims+1];
+  stride = new nat64[dims+1];
   for (nat32 i=0;i<=dims;i++) stride[i] = rhs.stride[i];
+  padRows = rhs.padRows;
+
+  planar = rhs.planar;
+  nextPlanar = rhs.nextPlanar;
+  numa = rhs.numa;
+  numaNode = rhs.numaNode;
 
   fields = rhs.fields;
   fi = new Entry*[fields];
   for (nat32 i=0;i<fields;i++)
   {
    fi[i] = new Entry(*rhs.fi[i]);
+   if (planar)
+   {
+    MakePlane(fi[i],false);
+    mem::Copy(fi[i]->plane,rhs.fi[i]->plane,fi[i]->fStride[dims]);
+   }
   }
   byName = rhs.byName;
 
-  data = mem::Malloc<byte>(stride[dims]);
-  mem::Copy(data,rhs.data,stride[dims]);
+  dataSize = rhs.dataSize;
+  if (planar) data = null<byte*>();
+  else
+  {
+   data = Allocate(dataSize);
+   mem::Copy(data,rhs.data,dataSize);
+  }
 
  return *this;
 }
 
-void Var::Setup(nat32 d,const nat32 * s)
+void Var::FreeData()
+{
+ if (map)
+ {
+  map->Release();
+  map = null<file::FileMap*>();
+ }
+ else mem::AlignedFree(data);
+ data = null<byte*>();
+}
+
+void Var::Setup(nat32 d,const nat32 * s,bit pad)
 {
  changed = true;
  dims = d;
+ padRows = pad;
 
  delete[] size; size = new nat32[dims];
- delete[] stride; stride = new nat32[dims+1];
+ delete[] stride; stride = new nat64[dims+1];
 
  for (nat32 i=0;i<dims;i++) size[i] = s[i];
  // stride is ignored, as it will be recalculated on Commit().
@@ -115,25 +211,25 @@ void Var::Setup1D(nat32 a)
  Setup(1,s);
 }
 
-void Var::Setup2D(nat32 a,nat32 b)
+void Var::Setup2D(nat32 a,nat32 b,bit pad)
 {
  nat32 s[2];
  s[0] = a; s[1] = b;
- Setup(2,s);
+ Setup(2,s,pad);
 }
 
-void Var::Setup3D(nat32 a,nat32 b,nat32 c)
+void Var::Setup3D(nat32 a,nat32 b,nat32 c,bit pad)
 {
  nat32 s[3];
  s[0] = a; s[1] = b; s[2] = c;
- Setup(3,s);
+ Setup(3,s,pad);
 }
 
-void Var::Setup4D(nat32 a,nat32 b,nat32 c,nat32 d)
+void Var::Setup4D(nat32 a,nat32 b,nat32 c,nat32 d,bit pad)
 {
  nat32 s[4];
  s[0] = a; s[1] = b; s[2] = c; s[3] = d;
- Setup(4,s);
+ Setup(4,s,pad);
 }
 
 void Var::Add(str::Token name,str::Token type,nat32 size,const void * ini)
@@ -202,33 +298,75 @@ void Var::Commit(bit useDefault)
     }
 
    // Rebuild the stride data structure...
-    stride[0] = offset;
-    for (nat32 i=0;i<dims;i++) stride[i+1] = stride[i]*size[i];
+    planar = nextPlanar;
+    Layout();
 
    // Make new data structrue...
-    mem::Free(data);
-    data = mem::Malloc<byte>(stride[dims]);
-
-   // Copy in defaults...
-    if (useDefault)
+    FreeData();
+    for (nat32 i=0;i<fields;i++) fi[i]->FreePlane();
+    if (planar)
+    {
+     for (nat32 i=0;i<fields;i++) MakePlane(fi[i],useDefault);
+    }
+    else
     {
-     byte * temp = mem::Malloc<byte>(stride[0]);
-     for (nat32 i=0;i<fields;i++) mem::Copy(temp+fi[i]->offset,fi[i]->ini,fi[i]->size);
-      nat32 n = 1; for (nat32 i=0;i<dims;i++) n *= size[i];
-      byte * targ = data;
-      for (nat32 i=0;i<n;i++)
+     data = Allocate(dataSize);
+
+     // Copy in defaults...
+      if (useDefault)
       {
-       mem::Copy(targ,temp,stride[0]);
-       targ += stride[0];
+       nat32 width,rows; Shape(width,rows);
+       for (nat32 i=0;i<fields;i++)
+       {
+        CopyItems(data + fi[i]->offset,stride[0],RowStep(stride),
+                  fi[i]->ini,0,0,fi[i]->size,width,rows);
+       }
       }
-     mem::Free(temp);
-    }   
+    }
+ }
+ else if (planar&&nextPlanar)
+ {
+  // Planar and staying that way - each field has its own plane, so we only
+  // have to make planes for the added and free the planes of the deleted, 
+  // leaving the rest, and any Field-s pointing at them, alone.
+   nat32 targ = 0;
+   nat32 offset = 0;
+   for (nat32 i=0;i<fields;i++)
+   {
+    switch (fi[i]->state)
+    {
+     case Entry::Stored: 
+      fi[i]->offset = offset; offset += fi[i]->size; 
+      fi[targ] = fi[i]; ++targ; 
+     break;
+     case Entry::Added: 
+      fi[i]->state = Entry::Stored;
+      fi[i]->offset = offset; offset += fi[i]->size; 
+      MakePlane(fi[i],useDefault);
+      fi[targ] = fi[i]; ++targ; 
+     break;
+     case Entry::Deleted:
+      delete fi[i];
+     break;
+    }
+   }
+   if (targ<fields)
+   {
+    fields = targ;
+    Entry ** nfi = new Entry*[fields];
+    for (nat32 i=0;i<fields;i++) nfi[i] = fi[i];
+    delete[] fi;
+    fi = nfi;
+   }
+
+   Layout();
  }
  else
  {
   // We have some serious work to do. We start by calculating a copy list, of data to be copied
   // over for each field, and of defaults to copy over if required. We then rebuild the field
-  // table and make the new data structure, running the copy list on it.
+  // table and make the new data structure, running the copy list on it. This also
+  // handles changing between interleaved and planar.
    // Calculate copy list...
     nat32 cls = 0; // Size of copy list, will be the size of the fields table when done.
     for (nat32 i=0;i<fields;i++) if (fi[i]->state!=Entry::Deleted) ++cls;
@@ -236,18 +374,20 @@ void Var::Commit(bit useDefault)
     struct CLcode
     {
      bit op; // false == copy in the default, true == copy in from the previous entry.
-     nat32 prevOffset; // Offset for previous entry, for when op==true.    
+     byte * prev; // First instance of the previous entry, for when op==true.
+     nat64 prevStep; // Step between instances of the previous entry, for when op==true.
+     nat64 prevRow; // Step between rows of the previous entry, for when op==true.
     } * code = new CLcode[cls]; // This will match the field structure to be, so all the other data needed comes from there.
 
     cls = 0;
-    nat32 prevStride = 0;
     for (nat32 i=0;i<fields;i++)
     {
      if (fi[i]->state==Entry::Stored)
      {
       code[cls].op = true;
-      code[cls].prevOffset = fi[i]->offset;
-      prevStride += fi[i]->size;
+      code[cls].prev = FieldData(i);
+      code[cls].prevStep = FieldStrides(i)[0];
+      code[cls].prevRow = RowStep(FieldStrides(i));
       ++cls;
      }
      else if (fi[i]->state==Entry::Added)
@@ -255,15 +395,14 @@ void Var::Commit(bit useDefault)
       code[cls].op = false;
       ++cls;
      }
-     else // Deleted
-     {
-      prevStride += fi[i]->size;
-     }
     }
 
-   // Recalculate field table...
+   // Recalculate field table, keeping the old planes of deleted fields until 
+   // the copy is done...
     nat32 targ = 0;
     nat32 offset = 0;
+    nat32 dels = 0;
+    Entry ** del = new Entry*[fields];
     for (nat32 i=0;i<fields;i++)
     {
      switch (fi[i]->state)
@@ -278,7 +417,7 @@ void Var::Commit(bit useDefault)
        fi[targ] = fi[i]; ++targ; 
       break;
       case Entry::Deleted:
-       delete fi[i];
+       del[dels] = fi[i]; ++dels;
       break;
      }
     }
@@ -291,95 +430,302 @@ void Var::Commit(bit useDefault)
      fi = nfi;
     }
 
-   // Rebuild the stride data structure...
-    stride[0] = offset;
-    for (nat32 i=0;i<dims;i++) stride[i+1] = stride[i]*size[i];
+   // Rebuild the stride data structure, keeping the old planes arround for the
+   // copy...
+    bit wasPlanar = planar;
+    byte ** oldPlane = new byte*[fields];
+    for (nat32 i=0;i<fields;i++)
+    {
+     oldPlane[i] = fi[i]->plane;
+     fi[i]->plane = null<byte*>();
+     delete[] fi[i]->fStride;
+     fi[i]->fStride = null<nat64*>();
+    }
+
+    planar = nextPlanar;
+    Layout();
 
    // Build new data structure...
-    byte * newData = mem::Malloc<byte>(stride[dims]);
+    byte * newData = null<byte*>();
+    if (planar)
+    {
+     for (nat32 i=0;i<fields;i++) MakePlane(fi[i],false);
+    }
+    else newData = Allocate(dataSize);
 
-   // Copy over data...
-    byte * targIn = data;
-    byte * targOut = newData;
-    nat32 n = 1; for (nat32 i=0;i<dims;i++) n *= size[i];
-    for (nat32 i=0;i<n;i++)
+   // Copy over data, a field at a time...
+    nat32 width,rows; Shape(width,rows);
+    for (nat32 i=0;i<fields;i++)
     {
-     for (nat32 i=0;i<fields;i++)
+     byte * targOut = planar?fi[i]->plane:(newData + fi[i]->offset);
+     nat64 * stepOut = planar?fi[i]->fStride:stride;
+     if (code[i].op)
      {
-      if (code[i].op)
-      {
-       // Copy from old data...
-        mem::Copy(targOut+fi[i]->offset,targIn+code[i].prevOffset,fi[i]->size);
-      }
-      else if (useDefault)
-      {
-       // Copy in the default...
-        mem::Copy(targOut+fi[i]->offset,fi[i]->ini,fi[i]->size);
-      }
+      // Copy from old data...
+       CopyItems(targOut,stepOut[0],RowStep(stepOut),
+                 code[i].prev,code[i].prevStep,code[i].prevRow,fi[i]->size,width,rows);
+     }
+     else if (useDefault)
+     {
+      // Copy in the default...
+       CopyItems(targOut,stepOut[0],RowStep(stepOut),
+                 fi[i]->ini,0,0,fi[i]->size,width,rows);
      }
-     targIn += prevStride;
-     targOut += stride[0];
     }
 
    // Copy in the new structure, terminating the old one...
-    mem::Free(data);
+    if (wasPlanar)
+    {
+     for (nat32 i=0;i<fields;i++) mem::AlignedFree(oldPlane[i]);
+    }
+    FreeData();
     data = newData;
 
    // Clean up...
+    for (nat32 i=0;i<dels;i++) delete del[i];
+    delete[] del;
+    delete[] oldPlane;
     delete[] code;
  }
 
  // Final step in the algorithm - create the byName hash table so the dam 
  // interface works...
-  byName.Reset(3);
+  byName.Reset(fields);
   for (nat32 i=0;i<fields;i++)
   {
    byName.Set(fi[i]->name,i);
   }
 }
 
-nat32 Var::FieldMemory(nat32 ind) const
+byte * Var::Allocate(nat64 size)
+{
+ byte * ret = mem::AlignedMalloc<byte>(size);
+ if ((numa!=mem::numa_first_touch)&&(mt::NodeCount()>1)) mem::Place(ret,size,numa,numaNode);
+ return ret;
+}
+
+void Var::Layout()
+{
+ // The interleaved strides, which are allways maintained...
+  stride[0] = 0;
+  for (nat32 i=0;i<fields;i++) stride[0] += fi[i]->size;
+  MakeStrides(stride);
+
+ dataSize = planar?0:stride[dims];
+}
+
+void Var::MakeStrides(nat64 * s) const
+{
+ for (nat32 i=0;i<dims;i++)
+ {
+  s[i+1] = s[i]*size[i];
+  if ((i==0)&&padRows) s[1] = (s[1] + rowAlign - 1) & ~(rowAlign - 1);
+ }
+}
+
+void Var::MakePlane(Entry * e,bit useDefault)
+{
+ e->fStride = new nat64[dims+1];
+ e->fStride[0] = e->size;
+ MakeStrides(e->fStride);
+
+ e->plane = Allocate(e->fStride[dims]);
+ if (useDefault)
+ {
+  nat32 width,rows; Shape(width,rows);
+  CopyItems(e->plane,e->fStride[0],RowStep(e->fStride),e->ini,0,0,e->size,width,rows);
+ }
+}
+
+void Var::Shape(nat32 & width,nat32 & rows) const
+{
+ width = (dims>0)?size[0]:1;
+ rows = 1;
+ for (nat32 i=1;i<dims;i++) rows *= size[i];
+}
+
+nat64 Var::FieldMemory(nat32 ind) const
 {
- nat32 ret = fi[ind]->size;
+ nat64 ret = fi[ind]->size;
  for (nat32 i=0;i<dims;i++) ret *= size[i];
  return ret;
 }
 
 void Var::GetRaw(nat32 ind,byte * out) const
 {
- byte * targ = data + fi[ind]->offset;
- 
- nat32 num = 1;
- for (nat32 i=0;i<dims;i++) num *= size[i];
- 
- for (nat32 i=0;i<num;i++)
+ byte * targ = FieldData(ind);
+ nat64 * fs = FieldStrides(ind);
+
+ if (fs[dims]==FieldMemory(ind)) mem::Copy(out,targ,FieldMemory(ind));
+ else
  {
-  mem::Copy(out,targ,fi[ind]->size);
-  
-  out += fi[ind]->size;
-  targ += stride[0];
+  nat32 width,rows; Shape(width,rows);
+  CopyItems(out,fi[ind]->size,nat64(width)*fi[ind]->size,
+            targ,fs[0],RowStep(fs),fi[ind]->size,width,rows);
+ }
+}
+
+void Var::Gather(nat32 first,nat32 num,byte * out) const
+{
+ if (num==0) return;
+ nat32 width,rows; Shape(width,rows);
+
+ for (nat32 f=0;f<fields;f++)
+ {
+  nat64 * fs = FieldStrides(f);
+  nat64 rowStep = RowStep(fs);
+  byte * base = FieldData(f);
+  byte * targOut = out + fi[f]->offset;
+
+  nat32 x = first%width;
+  nat32 r = first/width;
+  for (nat32 j=0;j<num;j++)
+  {
+   mem::Copy(targOut,base + x*fs[0] + r*rowStep,fi[f]->size);
+   targOut += stride[0];
+   ++x;
+   if (x==width) {x = 0; ++r;}
+  }
+ }
+}
+
+bit Var::Packed() const
+{
+ return (!planar) && (stride[dims]==nat64(Count())*stride[0]);
+}
+
+//------------------------------------------------------------------------------
+// Functor for compressing/decompressing the chunks in parallel, in which case
+// the chunks are in a single block with the given offsets...
+class VarZip
+{
+ public:
+  VarZip(const Var & v,byte * c = null<byte*>(),nat64 * o = null<nat64*>())
+  :var(v),comp(c),offset(o),fails(0) {}
+
+  void operator () (nat32 begin,nat32 end)
+  {
+   nat32 n = var.Count();
+   nat64 itemSize = var.stride[0];
+   byte * temp = null<byte*>();
+   if (comp==null<byte*>()&&(!var.Packed())) temp = mem::Malloc<byte>(nat64(var.zItems)*itemSize);
+
+   for (nat32 i=begin;i<end;i++)
+   {
+    nat32 first = i*var.zItems;
+    nat32 num = math::Min(var.zItems,n-first);
+    unsigned long rawSize = num*itemSize;
+    
+    if (comp)
+    {
+     // Decompress...
+      unsigned long outSize = rawSize;
+      int res = file::zUncompress(var.data + nat64(first)*itemSize,&outSize,comp+offset[i],var.zSize[i]);
+      if ((res!=file::ZLIB_OK)||(outSize!=rawSize)) fails.Inc();
+    }
+    else
+    {
+     // Compress...
+      byte * raw = var.data + nat64(first)*itemSize;
+      if (temp) {var.Gather(first,num,temp); raw = temp;}
+      
+      unsigned long outSize = file::zCompressBound(rawSize);
+      var.zData[i] = mem::Malloc<byte>(outSize);
+      int res = file::zCompress2(var.zData[i],&outSize,raw,rawSize,file::ZLIB_DEFAULT_COMPRESSION);
+      if (res!=file::ZLIB_OK) fails.Inc();
+      var.zSize[i] = outSize;
+    }
+   }
+
+   mem::Free(temp);
+  }
+
+  const Var & var;
+  byte * comp;
+  nat64 * offset;
+  mt::Atomic fails;
+};
+
+void Var::Compress() const
+{
+ static const nat64 chunkSize = 1<<20;
+
+ FreeCompressed();
+ if (!file::ZlibActive()) return;
+
+ nat32 n = 1; for (nat32 i=0;i<dims;i++) n *= size[i];
+ zItems = nat32(math::Max(nat64(1),chunkSize/math::Max(nat64(1),stride[0])));
+ zChunks = (n+zItems-1)/zItems;
+ zData = new byte*[zChunks];
+ zSize = new nat32[zChunks];
+ for (nat32 i=0;i<zChunks;i++) zData[i] = null<byte*>();
+
+ VarZip vz(*this);
+ mt::ParallelFor(0,zChunks,vz);
+ if (vz.fails.Get()!=0) {FreeCompressed(); return;}
+
+ // Loaders tell compressed data apart by its size, so it can't be the same
+ // as the raw data...
+  nat64 total = 12 + 4*nat64(zChunks);
+  for (nat32 i=0;i<zChunks;i++) total += zSize[i];
+  if (total==nat64(n)*stride[0]) FreeCompressed();
+}
+
+void Var::FreeCompressed() const
+{
+ if (zData)
+ {
+  for (nat32 i=0;i<zChunks;i++) mem::Free(zData[i]);
+  delete[] zData;
+  delete[] zSize;
+  zData = null<byte**>();
+  zSize = null<nat32*>();
+ }
+ zChunks = 0;
+}
+
+nat64 Var::DataWriteSize() const
+{
+ if (core.WriteCompress())
+ {
+  if (zData==null<byte**>()) Compress();
+  if (zData)
+  {
+   nat64 ret = 12 + 4*zChunks;
+   for (nat32 i=0;i<zChunks;i++) ret += zSize[i];
+   return ret;
+  }
  }
+ else FreeCompressed();
+
+ nat64 ret = nat64(Count())*stride[0];
+ if (core.WritePos()) ret += 64; // Alignment padding for a mappable file.
+ return ret;
 }
 
-nat32 Var::Memory() const
+nat64 Var::Memory() const
 {
- nat32 ret = sizeof(Var);
+ nat64 ret = sizeof(Var);
  ret += sizeof(nat32)*dims;
- ret += sizeof(nat32)*(dims+1);
+ ret += sizeof(nat64)*(dims+1);
  
  ret += (sizeof(Entry*)+sizeof(Entry))*fields;
  for (nat32 i=0;i<fields;i++) ret += fi[i]->size;
 
  ret += byName.Memory() - sizeof(byName);
 
- ret += stride[dims];
+ if (planar)
+ {
+  for (nat32 i=0;i<fields;i++) ret += sizeof(nat64)*(dims+1) + fi[i]->fStride[dims];
+ }
+ else ret += dataSize;
 
  return ret;
 }
 
-nat32 Var::WriteSize() const
+nat64 Var::WriteSize() const
 {
- nat32 ret = Meta::WriteSize();
+ nat64 ret = Meta::WriteSize();
   ret += 16;
   ret += 4*(dims+1);
 
@@ -391,11 +737,11 @@ nat32 Var::WriteSize() const
           fi[i]->size;
   }
   
-  ret += stride[dims];
+  ret += DataWriteSize();
  return ret;
 }
 
-nat32 Var::TotalWriteSize() const
+nat64 Var::TotalWriteSize() const
 {
  return WriteSize();
 }
@@ -405,22 +751,19 @@ cstrconst Var::MagicString() const
  return "MID";
 }
 
-nat32 Var::Write(io::OutVirt<io::Binary> & out) const
+nat64 Var::Write(io::OutVirt<io::Binary> & out) const
 {
- nat32 ret = Meta::Write(out);
+ nat64 ret = Meta::Write(out);
 
   // Header...
-   nat32 ws = WriteSize();
-   nat32 bs = ws - ret;
-   nat32 os = TotalWriteSize() - ret;
-   nat8 zb = 0;
+   nat64 ws = WriteSize();
+   nat64 bs = ws - ret;
+   nat64 os = TotalWriteSize() - ret;
 
    ret += out.Write("MID",3);
    ret += out.Write(MagicString(),3);
-   ret += out.Write(&bs,4);
-   ret += out.Write(&zb,1);
-   ret += out.Write(&os,4);
-   ret += out.Write(&zb,1);
+   ret += WriteBlockSize(out,bs);
+   ret += WriteBlockSize(out,os);
 
   // Array structure...
    ret += out.Write(&dims,4);
@@ -446,7 +789,48 @@ nat32 Var::Write(io::OutVirt<io::Binary> & out) const
    }
 
   // Data...
-   ret += out.Write(data,stride[dims]);
+   if (zData)
+   {
+    // Compressed, the header and index followed by the chunks...
+     ret += out.Write("ZLIB",4);
+     ret += out.Write(&zItems,4);
+     ret += out.Write(&zChunks,4);
+     for (nat32 i=0;i<zChunks;i++) ret += out.Write(&zSize[i],4);
+     for (nat32 i=0;i<zChunks;i++) ret += out.Write(zData[i],zSize[i]);
+     FreeCompressed();
+   }
+   else
+   {
+    // Padding before the data, for mappable files...
+     nat8 pad = 0;
+     if (core.WritePos())
+     {
+      pad = nat8((64 - (*core.WritePos()+1)%64)%64);
+      ret += out.Write(&pad,1);
+      ret += out.Pad(pad);
+     }
+
+    // The data, which is allways written interleaved and unpadded...
+     if (!Packed())
+     {
+      // Gather a run of items at a time into a buffer and write that...
+       static const nat32 runSize = 1<<20;
+       nat32 n = Count();
+       nat32 run = math::Max(nat32(1),nat32(runSize/math::Max(nat64(1),stride[0])));
+       byte * buf = mem::Malloc<byte>(run*stride[0]);
+       for (nat32 i=0;i<n;i+=run)
+       {
+        nat32 num = math::Min(run,n-i);
+        Gather(i,num,buf);
+        ret += WriteLarge(out,buf,nat64(num)*stride[0]);
+       }
+       mem::Free(buf);
+     }
+     else ret += WriteLarge(out,data,stride[dims]);
+
+    // Padding after the data, for mappable files...
+     if (core.WritePos()) ret += out.Pad(63-pad);
+   }
 
  if (ret!=ws) out.SetError(true);
  return ret;
@@ -464,7 +848,7 @@ void Var::ReadBlock(io::InVirt<io::Binary> & in)
   nat8 oExt;
  } head;
  
- nat32 rsf = 0;
+ nat64 rsf = 0;
   rsf += in.Read(head.bm,3);
   rsf += in.Read(head.om,3);
   rsf += in.Read(&head.bSize,4);
@@ -473,21 +857,23 @@ void Var::ReadBlock(io::InVirt<io::Binary> & in)
   rsf += in.Read(&head.oExt,1);
   
   if ((head.bm[0]!='M')||(head.bm[1]!='I')||(head.bm[2]!='D')) {in.SetError(true); return;}
-  if ((head.bExt!=0)||(head.oExt!=0)) {in.SetError(true); return;}
 
   // Loaded header, time for the body...
    // Wipe out any previous storage...
     changed = false;
     delete[] size;
     delete[] stride;
+    planar = false;
+    padRows = false;
+    nextPlanar = false;
     for (nat32 i=0;i<fields;i++) delete fi[i];
     delete[] fi;
-    mem::Free(data);
+    FreeData();
     
    // The array data...
     rsf += in.Read(&dims,4);
     size = new nat32[dims];
-    stride = new nat32[dims+1];
+    stride = new nat64[dims+1];
     for (nat32 i=0;i<dims;i++) rsf += in.Read(&size[i],4);
    
    // The field data...
@@ -531,14 +917,93 @@ void Var::ReadBlock(io::InVirt<io::Binary> & in)
     for (nat32 i=0;i<dims;i++) stride[i+1] = stride[i]*size[i];
    
    // Update byName index...
-    byName.Reset(3);
+    byName.Reset(fields);
     for (nat32 i=0;i<fields;i++) byName.Set(fi[i]->name,i);
    
-   // The actual data...
-    data = mem::Malloc<byte>(stride[dims]);
-    rsf += in.Read(data,stride[dims]);
+   // The actual data, with its padding if from a mappable file, or 
+   // compressed if from a compressed file and not the size of the raw data...
+    dataSize = stride[dims];
+    nat64 remain = BlockSize(head.bSize,head.bExt) - rsf;
+    if ((core.ReadRevision()==4)&&(remain!=dataSize))
+    {
+     data = Allocate(dataSize);
+     rsf += ReadCompressed(in,remain);
+     in.SetError(rsf!=BlockSize(head.bSize,head.bExt));
+     return;
+    }
+    bit padded = (remain==dataSize+64);
+    nat8 pad = 0;
+    if (padded)
+    {
+     rsf += in.Read(&pad,1);
+     rsf += in.Skip(pad);
+    }
+
+    if (padded && core.ReadMap() && (core.ReadMap()->Pos()+dataSize<=core.ReadMap()->Map()->Size()))
+    {
+     // Point into the mapping...
+      map = core.ReadMap()->Map();
+      map->Acquire();
+      data = core.ReadMap()->Here();
+      rsf += core.ReadMap()->Advance(dataSize);
+    }
+    else
+    {
+     data = Allocate(dataSize);
+     rsf += ReadLarge(in,data,dataSize);
+    }
+
+    if (padded) rsf += SkipLarge(in,63-pad);
+  
+ in.SetError(rsf!=BlockSize(head.bSize,head.bExt));
+}
+
+nat64 Var::ReadCompressed(io::InVirt<io::Binary> & in,nat64 remain)
+{
+ nat64 ret = 0;
+ 
+ // Header...
+  cstrchar magic[4];
+  ret += in.Read(magic,4);
+  if ((ret!=4)||(magic[0]!='Z')||(magic[1]!='L')||(magic[2]!='I')||(magic[3]!='B')||(!file::ZlibActive()))
+  {
+   in.SetError(true);
+   return ret + SkipLarge(in,remain-ret);
+  }
+  ret += in.Read(&zItems,4);
+  ret += in.Read(&zChunks,4);
+  if (zItems==0) {in.SetError(true); return ret + SkipLarge(in,remain-ret);}
+ 
+ // Index...
+  nat32 n = 1; for (nat32 i=0;i<dims;i++) n *= size[i];
+  if (zChunks!=(n+zItems-1)/zItems) {zChunks = 0; in.SetError(true); return ret + SkipLarge(in,remain-ret);}
+
+  zSize = new nat32[zChunks];
+  nat64 * offset = new nat64[zChunks];
+  nat64 total = 0;
+  for (nat32 i=0;i<zChunks;i++)
+  {
+   ret += in.Read(&zSize[i],4);
+   offset[i] = total;
+   total += zSize[i];
+  }
+ 
+ // Chunks, read in then decompressed in parallel...
+  byte * comp = mem::Malloc<byte>(total);
+  ret += ReadLarge(in,comp,total);
   
- in.SetError(rsf!=head.bSize);
+  VarZip vz(*this,comp,offset);
+  mt::ParallelFor(0,zChunks,vz);
+  if (vz.fails.Get()!=0) in.SetError(true);
+ 
+ // Clean up...
+  mem::Free(comp);
+  delete[] offset;
+  delete[] zSize;
+  zSize = null<nat32*>();
+  zChunks = 0;
+  
+ return ret;
 }
 
 //------------------------------------------------------------------------------
@@ -712,7 +1177,7 @@ bit Var::OnGetInt(str::Token tok,int32 & out) const
    nat32 ind = (nat32)str::ToInt32(str+7); // 7 = chars in 'stride['.
    if (ind<=dims)
    {
-    out = stride[ind];
+    out = int32(stride[ind]);
     return true;
    }
   }
@@ -24,11 +24,16 @@
 
 #include "eos/types.h"
 #include "eos/typestring.h"
-#include "eos/ds/sparse_hash.h"
+#include "eos/ds/flat_hash.h"
 #include "eos/svt/meta.h"
 
 namespace eos
 {
+ namespace file
+ {
+  class FileMap;
+ }
+
  namespace svt
  {
 //------------------------------------------------------------------------------
@@ -60,13 +65,41 @@ class Field;
 /// includes the following list:
 /// - dims - the number of dimensions of the class, int.
 /// - size[x] - the size of each dimensions, using array notation, int.
-/// - stride[x] - stride[0] provides the sum of all the field sizes, stride[1] is stride[0]*size[0], stride[2] is stride[1]*size[1] and so on, upto the total memory consumption of the data part of the structure as a whole.
+/// - stride[x] - (64 bit, but exported as ints, so only useful for small arrays) stride[0] provides the sum of all the field sizes, stride[1] is stride[0]*size[0], rounded up to a multiple of 64 if rows are padded, stride[2] is stride[1]*size[1] and so on, upto the total memory consumption of the data part of the structure as a whole.
 /// - fields - how many fields exist.
 /// - field[x].name - name of each field, the array is in storage order, token.
 /// - field[x].type - the type of each field, token.
 /// - field[x].size - the size of each field, int.
 /// - field[x].default - the default data in each field, as a string, in hex.
 ///
+/// By default the fields of each item are interleaved, i.e. all the fields of 
+/// one item are followed by all the fields of the next. Alternativly the Var can 
+/// be set to be planar with SetPlanar(), in which case each field gets its own
+/// contiguous block of memory, a plane, allocated seperatly. This makes walking
+/// over a single field far faster, at the expense of accessing all fields of a 
+/// single item, and allows Field::Dense() to provide a simple array for the 
+/// inner loops. It also makes adding and removing fields cheap, as only the 
+/// planes involved are touched. The layout is only an in memory thing - the 
+/// stride meta-data and the file format are allways as though it were 
+/// interleaved.
+///
+/// The data, or each plane, is allocated aligned to 64 bytes. Setup() can 
+/// optionally pad each row, so stride[1] is a multiple of 64 and every row 
+/// starts on a cache line, for kernels that want aligned SIMD loads. Padding
+/// is also an in memory thing - files are never padded.
+///
+/// On a machine with more than one NUMA node a fresh allocation is, by default,
+/// initialised in bands with mt::ParallelFor, so its pages land on the nodes
+/// whose workers will process those rows. SetNuma() can instead interleave it
+/// across the nodes or bind it to one.
+///
+/// When saved compressed the data is split into chunks that are compressed
+/// with zlib, in parallel, using mt::DefaultPool().
+///
+/// When loaded with LoadMapped() from a mappable file the data points into the
+/// file mapping, rather than being allocated, until the next Commit() that
+/// changes the structure.
+///
 /// See the \link svt_io SVT IO page \endlink for details on the results of
 /// IO with this class.
 class EOS_CLASS Var : public Meta
@@ -107,19 +140,20 @@ class EOS_CLASS Var : public Meta
   /// maintained over this operation.
   /// \param dims Number of dimensions.
   /// \param size Pointer to an array of sizes, where size[0] is the size of the first dimension etc.
-   void Setup(nat32 dims,const nat32 * size);
+  /// \param padRows If true the row stride, stride[1], is rounded up to a multiple of 64 bytes, so each row is aligned.
+   void Setup(nat32 dims,const nat32 * size,bit padRows = false);
 
   /// Shortcut version of Setup, for 1D.
    void Setup1D(nat32 a);
 
   /// Shortcut version of Setup, for 2D.
-   void Setup2D(nat32 a,nat32 b);
+   void Setup2D(nat32 a,nat32 b,bit padRows = false);
 
   /// Shortcut version of Setup, for 3D.
-   void Setup3D(nat32 a,nat32 b,nat32 c);
+   void Setup3D(nat32 a,nat32 b,nat32 c,bit padRows = false);
 
   /// Shortcut version of Setup, for 4D.
-   void Setup4D(nat32 a,nat32 b,nat32 c,nat32 d);
+   void Setup4D(nat32 a,nat32 b,nat32 c,nat32 d,bit padRows = false);
 
 
   /// This adds a field, the direct access version, you will ushally use the
@@ -167,8 +201,28 @@ class EOS_CLASS Var : public Meta
   /// details as before will cause all data to be wipped and this to run faster, so if 
   /// just adjusting the structure ready for a complete blit of new data which happens 
   /// to be the same dimensions/size call Setup anyway, as it will be faster overall.
+  /// The exception is when planar, and staying planar, without a Setup - then an
+  /// added field simply gets a new plane and a removed field has its plane freed,
+  /// with all other fields left alone, so any Field-s for them remain valid.
    void Commit(bit useDefault = true);
 
+  /// Sets the layout to be used, planar if true, interleaved if false. As with
+  /// the other structure changing methods this only takes effect on the next
+  /// call to Commit(), which will convert the current data over if need be.
+  /// New Var-s, including loaded ones, are interleaved.
+   void SetPlanar(bit p = true) {nextPlanar = p;}
+
+  /// Returns true if the data is currently stored planar, false if interleaved.
+   bit Planar() const {return planar;}
+
+  /// Sets how the memory is placed on a NUMA machine, see mem::Place(). Only
+  /// takes effect when Commit() next allocates, and does nothing when the
+  /// machine has a single node. Defaults to mem::numa_first_touch.
+   void SetNuma(mem::NumaPolicy policy,nat32 node = 0) {numa = policy; numaNode = node;}
+
+  /// Returns true if rows are padded to a multiple of 64 bytes.
+   bit PadRows() const {return padRows;}
+
 
   /// Returns the number of dimensions.
    nat32 Dims() const{return dims;}
@@ -184,16 +238,20 @@ class EOS_CLASS Var : public Meta
   /// array. For further levels it is first the size of an entire row in bytes, then a 
   /// plane, then a cube and so on, assuming it actually gets that far. The highest
   /// requestable is Stride(Dims()), which returns how many bytes of memory the data 
-  /// alone is consuming. If this is not a large number you are not using this class 
-  /// right.
-   nat32 Stride(nat32 l) const {return stride[l];}
+  /// alone is consuming, including any row padding. If this is not a large number 
+  /// you are not using this class right.
+  /// When planar these are the strides the data would have if interleaved, use
+  /// Field::Stride() for the actual strides of a field.
+  /// Strides are 64 bit, as a large multi-dimensional array, such as a cost
+  /// volume, can easilly go over 4 gig.
+   nat64 Stride(nat32 l) const {return stride[l];}
    
   /// Returns an array of strides. See Stride() for explanation.
-   nat32 * Strides() const {return stride;}
+   nat64 * Strides() const {return stride;}
 
   /// Returns how many items are being stored in the Var, i.e. what you get if you multiply
   /// Size(0..Dims()-1) together.
-   nat32 Count() const {return stride[dims]/stride[0];}
+   nat32 Count() const {nat32 ret = 1; for (nat32 i=0;i<dims;i++) ret *= size[i]; return ret;}
 
 
   /// Returns the number of fields provided.
@@ -281,7 +339,7 @@ class EOS_CLASS Var : public Meta
    
    
   /// Returns the size of the given field index, in bytes...
-   nat32 FieldMemory(nat32 ind) const;
+   nat64 FieldMemory(nat32 ind) const;
    
   /// Given a data block of FieldMemory size this writes out the entire field, 
   /// raw, into that data block.
@@ -291,39 +349,39 @@ class EOS_CLASS Var : public Meta
   /// Returns a pointer to the given field index at the given 1D offset.
   /// Obviously not safe, play nice.
    void * Ptr(nat32 ind,nat32 x)
-   {return data + fi[ind]->offset + x*stride[0];}
+   {nat64 * fs = FieldStrides(ind); return FieldData(ind) + x*fs[0];}
    
   /// Returns a pointer to the given field index at the given 1D offset.
   /// Obviously not safe, play nice.
    void * Ptr(nat32 ind,nat32 x,nat32 y)
-   {return data + fi[ind]->offset + x*stride[0] + y*stride[1];}
+   {nat64 * fs = FieldStrides(ind); return FieldData(ind) + x*fs[0] + y*fs[1];}
    
   /// Returns a pointer to the given field index at the given 1D offset.
   /// Obviously not safe, play nice.
    void * Ptr(nat32 ind,nat32 x,nat32 y,nat32 z)
-   {return data + fi[ind]->offset + x*stride[0] + y*stride[1] + z*stride[2];}
+   {nat64 * fs = FieldStrides(ind); return FieldData(ind) + x*fs[0] + y*fs[1] + z*fs[2];}
 
   /// Returns a pointer to the given field index at the given 1D offset.
   /// Obviously not safe, play nice.
    void * Ptr(nat32 ind,nat32 x,nat32 y,nat32 z,nat32 t)
-   {return data + fi[ind]->offset + x*stride[0] + y*stride[1] + z*stride[2] + t*stride[3];}
+   {nat64 * fs = FieldStrides(ind); return FieldData(ind) + x*fs[0] + y*fs[1] + z*fs[2] + t*fs[3];}
 
 
   /// &nbsp;
-   nat32 Memory() const;
+   nat64 Memory() const;
    
   /// &nbsp;
-   nat32 WriteSize() const;
+   nat64 WriteSize() const;
    
   /// &nbsp;
-   nat32 TotalWriteSize() const;
+   nat64 TotalWriteSize() const;
    
 
   /// &nbsp;
    cstrconst MagicString() const;
   
   /// &nbsp;
-   nat32 Write(io::OutVirt<io::Binary> & out) const;
+   nat64 Write(io::OutVirt<io::Binary> & out) const;
    
   /// &nbsp;
    void ReadBlock(io::InVirt<io::Binary> & in);
@@ -357,21 +415,33 @@ class EOS_CLASS Var : public Meta
    bit changed; // Set to true when a change is made, set back to false when the change is commited.
    nat32 dims; // How many dism there are.
    nat32 * size; // An array of size dims, size of each dimension.
-   nat32 * stride; // An array of size dims+1, contains the pre-multiplied up skip sizes, to make access fast.
+   nat64 * stride; // An array of size dims+1, contains the pre-multiplied up skip sizes, to make access fast.
+   bit padRows; // If true stride[1] is rounded up to a multiple of 64, as are the row strides of planes.
+
+  // Layout...
+   bit planar; // true if the data is currently planar, false if interleaved.
+   bit nextPlanar; // What planar will become on the next Commit.
+
+  // Placement...
+   mem::NumaPolicy numa; // Applied to each new allocation.
+   nat32 numaNode; // For numa_bind.
 
 
   // Fields meta-data...
    class Entry // represents a field, not called that as it would be a name clash.
    {
     public:
-      Entry():ini(null<byte*>()) {}
+      Entry():ini(null<byte*>()),plane(null<byte*>()),fStride(null<nat64*>()) {}
 
+      // Does not copy the plane.
       Entry(const Entry & rhs)
       :name(rhs.name),type(rhs.type),size(rhs.size),ini(mem::Malloc<byte>(rhs.size)),
-      offset(rhs.offset),state(rhs.state)
+      offset(rhs.offset),plane(null<byte*>()),fStride(null<nat64*>()),state(rhs.state)
       {mem::Copy(ini,rhs.ini,size);}
 
-     ~Entry() {mem::Free(ini);}
+     ~Entry() {mem::Free(ini); FreePlane();}
+
+     void FreePlane() {mem::AlignedFree(plane); plane = null<byte*>(); delete[] fStride; fStride = null<nat64*>();}
 
      str::Token name;
      str::Token type;
@@ -379,6 +449,8 @@ class EOS_CLASS Var : public Meta
      byte * ini; // Malloc'ed.
 
      nat32 offset; // Offset into any given set of fields to get to this one.
+     byte * plane; // AlignedMalloc'ed, null if interleaved, otherwise this fields data.
+     nat64 * fStride; // null if interleaved, otherwise the dims+1 strides for the plane.
 
      enum State {Stored, // It is currently in the data structure, no change needed.
                  Added, // It does not currently exist and must be added next Commit.
@@ -389,11 +461,66 @@ class EOS_CLASS Var : public Meta
    nat32 fields; // Number of fields contained within.
    Entry ** fi; // Pointer to an array containing all the fields.
 
-   ds::SparseHash<nat32> byName; // Indexes into the fi array indexed by the names of fields, so ByName can be implimented.
+   ds::FlatHash<nat32> byName; // Indexes into the fi array indexed by the names of fields, so ByName can be implimented.
+
+
+  // Actual data, when interleaved everything is stored in a single buffer,
+  // when planar its in the planes of the fields...
+   byte * data; // AlignedMalloc'ed, null if planar.
+   nat64 dataSize; // Size of data, 0 if planar.
+   file::FileMap * map; // If not null data points into this mapping, which we have Acquire()-ed, rather than being Malloc'ed.
+
+  // Frees data, or releases the mapping its in...
+   void FreeData();
+
+  // AlignedMalloc-s a block for data or a plane, placing it as requested...
+   byte * Allocate(nat64 size);
+
+  // Outputs the size of dimension 0 and how many rows there are, i.e. the 
+  // product of the other dimensions, for walking the data a row at a time...
+   void Shape(nat32 & width,nat32 & rows) const;
+
+  // Writes num items starting from item first into out, interleaved without 
+  // padding, for when planar or padded...
+   void Gather(nat32 first,nat32 num,byte * out) const;
+
+  // Returns true if the data is a single interleaved block without padding,
+  // i.e. as it is in a file...
+   bit Packed() const;
+
+  // Compressed data, made by WriteSize() when writting a compressed file and
+  // freed by Write(), so the size is known before writting. zData is null if
+  // there is none...
+   mutable nat32 zItems; // Items per chunk.
+   mutable nat32 zChunks; // Number of chunks.
+   mutable byte ** zData; // Array of Malloc'ed compressed chunks.
+   mutable nat32 * zSize; // Compressed size of each chunk.
+
+   friend class VarZip; // Functor in var.cpp that does the chunks in parallel.
+   void Compress() const;
+   void FreeCompressed() const;
+   nat64 DataWriteSize() const;
+   nat64 ReadCompressed(io::InVirt<io::Binary> & in,nat64 remain); // Returns bytes read, sets the error of in on failure.
+
+  // Returns the stride array to use for the given field...
+   nat64 * FieldStrides(nat32 ind) const {return planar?fi[ind]->fStride:stride;}
+
+  // Returns a pointer to the first instance of the given field...
+   byte * FieldData(nat32 ind) const {return planar?fi[ind]->plane:(data + fi[ind]->offset);}
+
+  // Given the field table calculates the interleaved strides and dataSize for
+  // the layout indicated by planar...
+   void Layout();
+
+  // Given s[0] fills in the rest of a stride array, padding rows if need be...
+   void MakeStrides(nat64 * s) const;
 
+  // Returns the step between rows for a stride array, 0 if there are no rows...
+   nat64 RowStep(const nat64 * s) const {return (dims>0)?s[1]:0;}
 
-  // Actual data, everything is stored in a single buffer...
-   byte * data; // Malloc'ed.
+  // Allocates the plane of a field and its strides, filling it with the 
+  // default if requested...
+   void MakePlane(Entry * e,bit useDefault);
 };
 
 //------------------------------------------------------------------------------
@@ -410,9 +537,11 @@ namespace eos
   template <typename T>
   Var::Var(const Field<T> & f)
   :Meta(f.GetVar()->GetCore()),
-  changed(true),dims(0),size(null<nat32*>()),stride(null<nat32*>()),
+  changed(true),dims(0),size(null<nat32*>()),stride(null<nat64*>()),padRows(false),
+  planar(false),nextPlanar(false),numa(mem::numa_first_touch),numaNode(0),
   fields(0),fi(null<Entry**>()),byName(3),
-  data(null<byte*>())
+  data(null<byte*>()),dataSize(0),map(null<file::FileMap*>()),
+  zItems(0),zChunks(0),zData(null<byte**>()),zSize(null<nat32*>())
   {
    Setup(f.Dims(),f.Sizes());
   }
@@ -421,7 +550,7 @@ namespace eos
   bit Var::ByName(str::Token name,Field<T> & out)
   {
    nat32 * ind = byName.Get(name);
-   if (ind) {out.Set(this,data+fi[*ind]->offset,stride); return true;}
+   if (ind) {out.Set(this,FieldData(*ind),FieldStrides(*ind)); return true;}
        else {out.SetInvalid(); return false;}
   }
 
@@ -429,7 +558,7 @@ namespace eos
   bit Var::ByName(str::Token name,const Field<T> & out) const
   {
    nat32 * ind = byName.Get(name);
-   if (ind) {out.Set(this,data+fi[*ind]->offset,stride); return true;}
+   if (ind) {out.Set(this,FieldData(*ind),FieldStrides(*ind)); return true;}
        else {out.SetInvalid(); return false;}
   }
   
@@ -448,13 +577,13 @@ namespace eos
   template <typename T>
   void Var::ByInd(nat32 ind,Field<T> & out)
   {
-   out.Set(this,data+fi[ind]->offset,stride);
+   out.Set(this,FieldData(ind),FieldStrides(ind));
   }
 
   template <typename T>
   void Var::ByInd(nat32 ind,const Field<T> & out) const
   {
-   out.Set(this,data+fi[ind]->offset,stride);
+   out.Set(this,FieldData(ind),FieldStrides(ind));
   }
 
  };
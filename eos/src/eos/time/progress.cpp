@@ -18,6 +18,7 @@
 #include "eos/time/progress.h"
 
 #include "eos/mem/alloc.h"
+#include "eos/mt/threads.h"
 #include "eos/file/csv.h"
 
 namespace eos
@@ -26,7 +27,9 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 Progress::Progress(nat32 d,bit sp)
-:paused(false),time(0.0),size(0),depth(0),data(null< Pair<nat32,nat32>* >())
+:paused(false),time(0.0),size(0),depth(0),data(null<Level*>()),
+stages(0),stageSize(0),stage(null<StageStats*>()),
+interval(0),lastChange(0)
 {
  Reset(d,sp);	
 }
@@ -34,26 +37,36 @@ Progress::Progress(nat32 d,bit sp)
 Progress::~Progress()
 {
  delete[] data;	
+ delete[] stage;
 }
 
 void Progress::Reset(nat32 d,bit startPaused)
 {
+ if (d==0) d = 1;
  if (size<d)
  {
   delete[] data;
-  data = new Pair<nat32,nat32>[d];	 
+  data = new Level[d];	 
+  size = d;
  }
  
- data[0].first = 0;
- data[0].second = 1;
+ data[0].x = 0;
+ data[0].y = 1;
+ data[0].start = 0.0;
+ data[0].name = null<cstrconst>();
+ data[0].step = 0;
+ data[0].of = 1;
  
  depth = 0;
+ stages = 0;
+ lastChange = 0;
+ cancelled.Set(0);
  paused = startPaused;
  if (paused) time = 0.0;
         else time = UltraTime();	
 }
 
-void Progress::Push()
+void Progress::Push(cstrconst name)
 {
  if (this==null<Progress*>()) return;
  ++depth;
@@ -62,20 +75,26 @@ void Progress::Push()
  {
   const nat32 sizeInc = 8;
   	 
-  Pair<nat32,nat32> * newData = new Pair<nat32,nat32>[size + sizeInc];
+  Level * newData = new Level[size + sizeInc];
   for (nat32 i=0;i<depth;i++) newData[i] = data[i];
   delete[] data;
   data = newData;
   size += sizeInc;	 
  }
  
- data[depth].first = 0;	
- data[depth].second = 1;
+ data[depth].x = 0;	
+ data[depth].y = 1;
+ data[depth].start = Now();
+ data[depth].name = name;
+ data[depth].step = data[depth-1].x;
+ data[depth].of = data[depth-1].y;
 }
 
 void Progress::Pop()
 {
  if (this==null<Progress*>()) return;
+ if (depth==0) return;
+ RecordStage(Now());
  --depth;
 }
 
@@ -83,16 +102,16 @@ void Progress::Report(nat32 x,nat32 y)
 {
  if (this==null<Progress*>()) return;
  log::Assert((x<=y)&&(y!=0));
- data[depth].first  = x;	
- data[depth].second = y;
- OnChange();
+ data[depth].x = x;	
+ data[depth].y = y;
+ if (Due()) OnChange();
 }
 
 void Progress::Next()
 {
  if (this==null<Progress*>()) return;
- data[depth].first += 1;
- OnChange();
+ data[depth].x += 1;
+ if (Due()) OnChange();
 }
 
 real32 Progress::Prog()
@@ -101,10 +120,10 @@ real32 Progress::Prog()
  real32 fact = 1.0;
  for (nat32 i=0;i<=depth;i++)
  {
-  if (data[i].second!=0)
+  if (data[i].y!=0)
   {
-   ret += fact * real32(data[i].first)/real32(data[i].second);
-   fact *= 1.0/real32(data[i].second);
+   ret += fact * real32(data[i].x)/real32(data[i].y);
+   fact *= 1.0/real32(data[i].y);
   }
  }
  return ret;	
@@ -117,20 +136,121 @@ nat32 Progress::Depth()
 
 void Progress::Part(nat32 index,nat32 & xOut,nat32 & yOut)
 {
- xOut = data[index].first;	
- yOut = data[index].second;
+ xOut = data[index].x;	
+ yOut = data[index].y;
 }
 
 void Progress::Time(real64 & done,real64 & remaining)
 {
- if (paused) done = time; 
-        else done = UltraTime()-time;	 
+ done = Now();
  
  real32 prog = Prog();
  if (math::IsZero(prog)) remaining = -1.0;
                     else remaining = (done/prog)*(1.0-prog);
 }
 
+void Progress::Stage(nat32 index,real64 & elapsed,real64 & remaining,real64 & rate)
+{
+ elapsed = Now() - data[index].start;
+
+ // Fraction of the level done, working up from the deepest...
+  real64 frac = 0.0;
+  for (nat32 i=depth+1;i>index;i--)
+  {
+   const Level & targ = data[i-1];
+   frac = (targ.y==0)?0.0:((real64(targ.x)+frac)/real64(targ.y));
+  }
+
+ if ((frac<=0.0)||(elapsed<=0.0)) remaining = -1.0;
+                               else remaining = (elapsed/frac)*(1.0-frac);
+ rate = (elapsed>0.0)?(real64(data[index].x)/elapsed):0.0;
+}
+
+bit Progress::WriteStages(cstrconst fn,cstrconst job,bit overwrite) const
+{
+ bit header = overwrite;
+ if (!header)
+ {
+  file::File<io::Text> existing(fn,file::way_edit,file::mode_read);
+  header = (!existing.Active())||(existing.Size()==0);
+ }
+
+ file::Csv out(fn,overwrite);
+ if (!out.Active()) return false;
+
+ if (header)
+ {
+  out << "job" << file::EndField()
+      << "depth" << file::EndField()
+      << "step" << file::EndField()
+      << "of" << file::EndField()
+      << "name" << file::EndField()
+      << "count" << file::EndField()
+      << "time" << file::EndField()
+      << "items" << file::EndField()
+      << "items per second" << file::EndRow();
+ }
+
+ for (nat32 i=0;i<stages;i++)
+ {
+  const StageStats & targ = stage[i];
+  out << job << file::EndField()
+      << targ.depth << file::EndField()
+      << targ.step << file::EndField()
+      << targ.of << file::EndField()
+      << (targ.name?targ.name:"") << file::EndField()
+      << targ.count << file::EndField()
+      << targ.time << file::EndField()
+      << targ.items << file::EndField()
+      << targ.Rate() << file::EndRow();
+ }
+
+ out.Flush();
+ return true;
+}
+
+void Progress::RecordStage(real64 now)
+{
+ const Level & lev = data[depth];
+
+ // Find the matching record, names are ushally compile time constants so
+ // compare the pointers before the strings...
+  nat32 i = 0;
+  for (;i<stages;i++)
+  {
+   const StageStats & targ = stage[i];
+   if ((targ.depth==depth)&&(targ.step==lev.step)&&(targ.of==lev.of)&&
+       ((targ.name==lev.name)||(targ.name&&lev.name&&(str::Compare(targ.name,lev.name)==0)))) break;
+  }
+
+ if (i==stages)
+ {
+  if (stages==maxStages) return;
+  if (stages==stageSize)
+  {
+   stageSize = (stageSize==0)?16:(stageSize*2);
+   StageStats * ns = new StageStats[stageSize];
+   for (nat32 j=0;j<stages;j++) ns[j] = stage[j];
+   delete[] stage;
+   stage = ns;
+  }
+
+  StageStats & targ = stage[stages++];
+  targ.name = lev.name;
+  targ.depth = depth;
+  targ.step = lev.step;
+  targ.of = lev.of;
+  targ.count = 0;
+  targ.time = 0.0;
+  targ.items = 0;
+ }
+
+ StageStats & targ = stage[i];
+ targ.count += 1;
+ targ.time += now - lev.start;
+ targ.items += lev.y;
+}
+
 void Progress::Pause()
 {
  if (!paused)
@@ -155,9 +275,31 @@ void Progress::Continue()
  }	
 }
 
+void Progress::SetInterval(nat32 ms)
+{
+ interval = ms;
+}
+
 void Progress::OnChange()
 {}
 
+//------------------------------------------------------------------------------
+ProgressCounter::ProgressCounter(Progress * p,nat32 t)
+:prog(p),total(t),step(t/100),owner(mt::ThreadID()),reported(0)
+{
+ if (step==0) step = 1;
+}
+
+void ProgressCounter::Add(nat32 n)
+{
+ nat32 now = nat32(done.Add(int32(n)));
+ if ((prog!=null<Progress*>())&&(now>=reported+step)&&(mt::ThreadID()==owner))
+ {
+  reported = now;
+  prog->Report(math::Min(now,total),total);
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -24,6 +24,7 @@
 
 #include "eos/types.h"
 #include "eos/time/times.h"
+#include "eos/mt/locks.h"
 
 namespace eos
 {
@@ -41,6 +42,12 @@ namespace eos
 /// This can continue to an arbitary depth of algorithm nesting. There should be 
 /// a call to report between each sub algorithm, as the reported progress behaves
 /// badly. Needless to say an algorithm should neevr report a loss of work.
+///
+/// It also times each level, so Stage() can say how long each level of the
+/// current position has taken and is predicted to take, and records every
+/// Push/Pop pair as a stage, so at the end of a job the stage timings can be
+/// had with GetStage() or WriteStages() to see which part was slow. Stages
+/// can optionally be named by Push(name).
 class EOS_CLASS Progress
 {
  public:
@@ -59,9 +66,10 @@ class EOS_CLASS Progress
    void Reset(nat32 depth = 8,bit startPaused = false);
   
    
-  /// Push to indicate entering a sub-level of proccessing.  
-  /// Safe when this is set to null.
-   void Push();
+  /// Push to indicate entering a sub-level of proccessing. The optional name,
+  /// which must be a compile time constant string, labels the stage in the
+  /// timings. Safe when this is set to null.
+   void Push(cstrconst name = null<cstrconst>());
    
   /// Pop to indicate exiting a sub-level of proccessing.
   /// Safe when this is set to null.
@@ -104,6 +112,49 @@ class EOS_CLASS Progress
    void Time(real64 & done,real64 & remaining);
   
   
+  /// Outputs the timing of a level of the current position, given an index
+  /// from 0 to Depth()-1 inclusive. elapsed is the seconds since that level
+  /// was entered, remaining the predicted seconds to finish it, negative if
+  /// no prediction can be given, and rate the work modules done per second
+  /// at that level. The prediction factors in the deeper levels.
+   void Stage(nat32 index,real64 & elapsed,real64 & remaining,real64 & rate);
+
+  /// Returns the name given to Push for a level of the current position,
+  /// null if none was given, as is always the case for level 0.
+   cstrconst StageName(nat32 index) const {return data[index].name;}
+
+
+  /// The totals for a stage, a Push/Pop pair, combined with every other
+  /// stage at the same depth and position in its parent with the same name.
+   struct StageStats
+   {
+    cstrconst name; ///< As given to Push, can be null.
+    nat32 depth; ///< 1 for a stage pushed from the top level.
+    nat32 step; ///< The work modules done by the parent level when it was pushed.
+    nat32 of; ///< The work modules of the parent level when it was pushed.
+    nat32 count; ///< How many times the stage has run.
+    real64 time; ///< Total seconds.
+    nat64 items; ///< Total work modules, as last given to Report within it.
+
+    /// Returns the work modules done per second.
+     real64 Rate() const {return (time>0.0)?(real64(items)/time):0.0;}
+   };
+
+  /// Returns how many stages have been recorded since the last Reset(), in
+  /// the order they were first completed. Recording stops at 4096 distinct
+  /// stages, as that means Push is being used in an inner loop.
+   nat32 Stages() const {return stages;}
+
+  /// &nbsp;
+   const StageStats & GetStage(nat32 i) const {return stage[i];}
+
+  /// Writes the stage timings to a csv file, one row per stage, appending if
+  /// the file exists and overwrite is false, in which case the header is not
+  /// repeated. The job column is filled with the given string, so the stages
+  /// of several jobs can go in one file. Returns true on success.
+   bit WriteStages(cstrconst fn,cstrconst job = "",bit overwrite = true) const;
+
+
   /// If an algorithm is paused then this can be called to Stop the timer
   /// so the predicted time continues to make some sense. To impliment
   /// pausing ushally involves implimenting a child class and editting 
@@ -119,7 +170,28 @@ class EOS_CLASS Progress
    void Continue();
    
    
-  /// This method is called every time Report(...) is called. Does nothing by
+  /// Asks whatever is reporting to this to stop, for cooperative cancellation.
+  /// Can be called from any thread, e.g. by a GUI to stop a background render.
+  /// Algorithms that suport it check Cancelled() between units of work and
+  /// return early, leaving their output partial but valid; it is up to them
+  /// to document if they do. Cleared by Reset().
+   void Cancel() {cancelled.Set(1);}
+
+  /// Returns true if Cancel() has been called. Safe when this is set to null,
+  /// returning false.
+   bit Cancelled() const {return (this!=null<const Progress*>())&&(cancelled.Get()!=0);}
+
+
+  /// Sets the minimum number of milliseconds between calls to OnChange(),
+  /// Report(...) and Next() calls in between just update the state. Defaults
+  /// to 0, i.e. OnChange() gets called every time. Anything that renders
+  /// the progress should set this, as algorithms report progress from inner
+  /// loops which would otherwise spend more time updating than working.
+   void SetInterval(nat32 ms);
+
+
+  /// This method is called every time Report(...) is called, subject to the
+  /// SetInterval(...) limit. Does nothing by
   /// default but a child class can use this to respond as needed. If stopping
   /// an algorithm is a requirement then making this method throw will accheive 
   /// that effect. Remember to impliment the algorithms such that memory leaks 
@@ -137,8 +209,89 @@ class EOS_CLASS Progress
   
   nat32 size; // How large the array is.
   nat32 depth; // How deep in the stack we currently are.
+
+  struct Level
+  {
+   nat32 x;
+   nat32 y;
+   real64 start; // Running time when entered.
+   cstrconst name;
+   nat32 step; // x and y of the parent when entered.
+   nat32 of;
+  };
+  Level * data;
+
+  static const nat32 maxStages = 4096;
+  nat32 stages;
+  nat32 stageSize;
+  StageStats * stage;
+
+  nat32 interval; // Milliseconds between OnChange calls.
+  nat64 lastChange; // MilliTime() of the last OnChange call.
+
+  mt::Atomic cancelled; // Non-zero once Cancel() has been called.
+
+  // Returns the running time, i.e. excluding pauses...
+   real64 Now() const {return paused?time:(UltraTime()-time);}
+
+  // Adds the level at the current depth to the stage records...
+   void RecordStage(real64 now);
   
-  Pair<nat32,nat32> * data; // first is x, second is y.
+  // Returns true if its time to call OnChange()...
+   bit Due()
+   {
+    if (interval==0) return true;
+    nat64 now = MilliTime();
+    if (now<lastChange+interval) return false;
+    lastChange = now;
+    return true;
+   }
+};
+
+//------------------------------------------------------------------------------
+/// For reporting progress from a loop that has been split between several
+/// threads. A Progress object can only be touched by the thread that owns it,
+/// so instead the workers all incriment this, which is lock free, and whenever
+/// the thread that created it does so it passes the total on to the Progress
+/// object, at its current level. As long as the creating thread takes part in
+/// the work, which is the case with mt::ParallelFor, the progress bar keeps
+/// moving. Reports are limited to about one per percent, so workers can call
+/// Add() every few items without it costing anything to speak of.
+class EOS_CLASS ProgressCounter
+{
+ public:
+  /// Reports to the given progress object, which can be null, out of the given
+  /// total. Must be constructed by the thread that owns prog.
+   ProgressCounter(Progress * prog,nat32 total);
+
+  /// &nbsp;
+   ~ProgressCounter() {}
+
+
+  /// Indicates that another n items have been done, can be called from any
+  /// thread.
+   void Add(nat32 n = 1);
+
+
+  /// Returns how many items have been done so far.
+   nat32 Done() const {return nat32(done.Get());}
+
+  /// Returns the total given to the constructor.
+   nat32 Total() const {return total;}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::time::ProgressCounter";}
+
+
+ private:
+  Progress * prog;
+  nat32 total;
+  nat32 step; // Minimum change before the Progress is told.
+  nat32 owner; // Thread id of the creator.
+
+  mt::Atomic done;
+  nat32 reported; // Only touched by the owner.
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,181 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/time/startup.h"
+
+#include "eos/time/times.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+ #include <windows.h>
+#else
+ #include <unistd.h>
+#endif
+
+namespace eos
+{
+ namespace time
+ {
+//------------------------------------------------------------------------------
+// State for the marks - all plain data so it is zero before any static 
+// constructor runs, as marks can be made from other static constructors...
+static const nat32 maxMarks = 256;
+
+static volatile int32 markLock = 0;
+static bit markBased = false; // true once the below two are set.
+static real64 markBaseAge; // ProcessAge() when the first mark was made.
+static real64 markBaseUltra; // UltraTime() at the same moment.
+
+static nat32 markCount = 0;
+static cstrconst markName[maxMarks];
+static real64 markTime[maxMarks];
+
+//------------------------------------------------------------------------------
+EOS_FUNC real64 ProcessAge()
+{
+ #ifdef WIN32
+  FILETIME create, exit, kernel, user, now;
+  if (GetProcessTimes(GetCurrentProcess(),&create,&exit,&kernel,&user)==0) return -1.0;
+  GetSystemTimeAsFileTime(&now);
+  
+  nat64 c = (nat64(create.dwHighDateTime)<<32) | nat64(create.dwLowDateTime);
+  nat64 n = (nat64(now.dwHighDateTime)<<32) | nat64(now.dwLowDateTime);
+  if (n<c) return 0.0;
+  return real64(n-c)*1e-7;
+ #else
+  // The start time is field 22 of /proc/self/stat, in clock ticks since boot;
+  // the command name in field 2 can contain anything, so count from its end...
+   char buf[1024];
+   FILE * f = fopen("/proc/self/stat","r");
+   if (f==0) return -1.0;
+   size_t len = fread(buf,1,sizeof(buf)-1,f);
+   fclose(f);
+   buf[len] = 0;
+   
+   char * pos = strrchr(buf,')');
+   if (pos==0) return -1.0;
+   for (nat32 i=0;i<20;i++)
+   {
+    pos = strchr(pos+1,' ');
+    if (pos==0) return -1.0;
+   }
+   real64 start = real64(strtoull(pos+1,0,10));
+   
+   long ticks = sysconf(_SC_CLK_TCK);
+   if (ticks<=0) return -1.0;
+   start /= real64(ticks);
+
+  // And the time since boot...
+   f = fopen("/proc/uptime","r");
+   if (f==0) return -1.0;
+   double uptime = 0.0;
+   int got = fscanf(f,"%lf",&uptime);
+   fclose(f);
+   if (got!=1) return -1.0;
+   
+  if (uptime<start) return 0.0;
+  return uptime - start;
+ #endif
+}
+
+EOS_FUNC void StartupMark(cstrconst name)
+{
+ real64 now = UltraTime();
+ while (__sync_lock_test_and_set(&markLock,1)) {}
+ 
+ if (!markBased)
+ {
+  markBaseAge = ProcessAge();
+  markBaseUltra = now;
+  markBased = true;
+ }
+ 
+ if (markCount<maxMarks)
+ {
+  markName[markCount] = name;
+  markTime[markCount] = markBaseAge + (now - markBaseUltra);
+  markCount += 1;
+ }
+ 
+ __sync_lock_release(&markLock);
+}
+
+EOS_FUNC nat32 StartupMarks()
+{
+ return markCount;
+}
+
+EOS_FUNC cstrconst StartupName(nat32 index)
+{
+ return markName[index];
+}
+
+EOS_FUNC real64 StartupTime(nat32 index)
+{
+ return markTime[index];
+}
+
+EOS_FUNC bit WriteStartup(cstrconst fn)
+{
+ FILE * f = fopen(fn,"w");
+ if (f==0) return false;
+ 
+ fprintf(f,"mark, age, step\n");
+ real64 prev = 0.0;
+ for (nat32 i=0;i<markCount;i++)
+ {
+  fprintf(f,"\"%s\", %.6f, %.6f\n",markName[i],markTime[i],markTime[i]-prev);
+  prev = markTime[i];
+ }
+ 
+ return fclose(f)==0;
+}
+
+EOS_FUNC void PrintStartup()
+{
+ fprintf(stderr,"start up (seconds since process creation):\n");
+ real64 prev = 0.0;
+ for (nat32 i=0;i<markCount;i++)
+ {
+  fprintf(stderr,"  %-32s %9.4f  (+%.4f)\n",markName[i],markTime[i],markTime[i]-prev);
+  prev = markTime[i];
+ }
+}
+
+//------------------------------------------------------------------------------
+// Makes the library load mark, and arranges for the breakdown to be printed
+// on exit if requested...
+static void PrintStartupAtExit()
+{
+ PrintStartup();
+}
+
+static struct StartupInit
+{
+ StartupInit()
+ {
+  StartupMark("eos");
+  if (getenv("EOS_STARTUP")) atexit(PrintStartupAtExit);
+ }
+} startupInit;
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,74 @@
+#ifndef EOS_TIME_STARTUP_H
+#define EOS_TIME_STARTUP_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+/// \file startup.h
+/// Provides a breakdown of where the time goes when a process starts up, for
+/// finding out why a tool takes a while before doing anything useful.
+
+#include "eos/types.h"
+
+namespace eos
+{
+ namespace time
+ {
+//------------------------------------------------------------------------------
+/// Returns the number of seconds since the process was created, as reported by
+/// the operating system. This includes the time spent loading and linking 
+/// shared libraries and running static constructors, which is invisible to any
+/// timer started in main. The granularity is that of the OS, which on linux is
+/// the scheduler tick, typically 10ms. Returns a negative value if unknown.
+EOS_FUNC real64 ProcessAge();
+
+/// Records a named point in the start up of the process, at the current time.
+/// Called by the library when it first loads, and again by the subsystems that 
+/// are brought up on demand, such as image loading and the gui, so that their
+/// cost can be seen. Applications should call it once they are ready to do 
+/// work, with a name such as "ready". The name is not copied, so should be a 
+/// string literal. Thread safe. After the first 256 marks further marks are
+/// ignored.
+EOS_FUNC void StartupMark(cstrconst name);
+
+/// Returns how many start up marks have been recorded.
+EOS_FUNC nat32 StartupMarks();
+
+/// Returns the name of the given start up mark.
+EOS_FUNC cstrconst StartupName(nat32 index);
+
+/// Returns the age of the process, in seconds, when the given mark was made.
+/// The mark "eos" is made when the library is loaded, so its age is the cost of
+/// getting that far; differencing consecutive marks gives the cost of each 
+/// step.
+EOS_FUNC real64 StartupTime(nat32 index);
+
+/// Writes the start up marks to the given file as a csv of name, seconds since
+/// process creation and seconds since the previous mark. Returns true on 
+/// success.
+EOS_FUNC bit WriteStartup(cstrconst fn);
+
+/// Prints the start up marks to stderr, as a small table. If the environment
+/// variable EOS_STARTUP is set this is done automatically when the process
+/// exits, so any application can be checked without rebuilding it.
+EOS_FUNC void PrintStartup();
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif